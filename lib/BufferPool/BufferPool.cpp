@@ -0,0 +1,118 @@
+#include "BufferPool.h"
+
+#include <Logging.h>
+#include <Metrics.h>
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+// Filled by reserve() at boot, before any other task runs; only the in-use flags change afterwards
+uint8_t* slabs[BufferPool::MAX_SLABS] = {};
+size_t slabSizes[BufferPool::MAX_SLABS] = {};
+std::atomic<bool> slabTaken[BufferPool::MAX_SLABS] = {};
+int slabCount = 0;
+
+std::atomic<int> inUse{0};
+std::atomic<int> peakInUse{0};
+
+void returnSlab(const int slab) {
+  slabTaken[slab].store(false, std::memory_order_release);
+  inUse.fetch_sub(1, std::memory_order_relaxed);
+}
+}  // namespace
+
+BufferLease::BufferLease(BufferLease&& other) noexcept
+    : bytes(other.bytes), length(other.length), slab(other.slab) {
+  other.bytes = nullptr;
+  other.length = 0;
+  other.slab = -1;
+}
+
+BufferLease& BufferLease::operator=(BufferLease&& other) noexcept {
+  if (this != &other) {
+    release();
+    bytes = other.bytes;
+    length = other.length;
+    slab = other.slab;
+    other.bytes = nullptr;
+    other.length = 0;
+    other.slab = -1;
+  }
+  return *this;
+}
+
+void BufferLease::release() {
+  if (slab >= 0) {
+    returnSlab(slab);
+  } else {
+    free(bytes);
+  }
+  bytes = nullptr;
+  length = 0;
+  slab = -1;
+}
+
+int BufferPool::reserve(const size_t size, const int count) {
+  int reserved = 0;
+  while (reserved < count && slabCount < MAX_SLABS) {
+    auto* slab = static_cast<uint8_t*>(malloc(size));
+    if (!slab) {
+      LOG_ERR("POOL", "Failed to reserve a %zu byte slab", size);
+      break;
+    }
+    slabs[slabCount] = slab;
+    slabSizes[slabCount] = size;
+    slabCount++;
+    reserved++;
+  }
+  LOG_DBG("POOL", "Reserved %d slab(s) of %zu bytes", reserved, size);
+  return reserved;
+}
+
+BufferLease BufferPool::lease(const size_t size, const bool heapFallback) {
+  BufferLease lease;
+  if (size == 0) {
+    return lease;
+  }
+
+  while (true) {
+    int best = -1;
+    for (int i = 0; i < slabCount; i++) {
+      if (slabSizes[i] >= size && !slabTaken[i].load(std::memory_order_relaxed) &&
+          (best < 0 || slabSizes[i] < slabSizes[best])) {
+        best = i;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    bool expected = false;
+    if (slabTaken[best].compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      lease.bytes = slabs[best];
+      lease.length = size;
+      lease.slab = static_cast<int8_t>(best);
+      const int now = inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+      int peak = peakInUse.load(std::memory_order_relaxed);
+      while (now > peak && !peakInUse.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+      }
+      metrics::add(metrics::POOL_LEASES);
+      return lease;
+    }
+    // Another task took that slab in the meantime, look again
+  }
+
+  if (heapFallback) {
+    lease.bytes = static_cast<uint8_t*>(malloc(size));
+    if (lease.bytes) {
+      lease.length = size;
+    }
+    metrics::add(metrics::POOL_FALLBACKS);
+    LOG_DBG("POOL", "No free slab for %zu bytes, %s", size, lease.bytes ? "using the heap" : "out of memory");
+  }
+  return lease;
+}
+
+int BufferPool::slabsInUse() { return inUse.load(std::memory_order_relaxed); }
+
+int BufferPool::peakSlabsInUse() { return peakInUse.load(std::memory_order_relaxed); }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Fixed-size slabs for the firmware's large transient buffers (the streaming inflate window, the BW frame snapshot,
+the home screen's cover copy, XTC page buffers, image cache windows, the TXT read window). They are reserved once at
+boot, while the heap is still in one piece, and then leased out and handed back, so these buffers keep working
+however fragmented the heap gets later on:
+
+    BufferLease window = BufferPool::lease(32 * 1024);
+    if (!window) { ... }          // Only when no slab fits and the heap has no room either
+    inflate(window.data(), ...);  // Back in the pool when window goes out of scope
+
+A lease takes the smallest free slab of at least the requested size. When every fitting slab is taken, or the
+request is bigger than any slab, it comes from the heap instead (unless the caller opts out), so callers keep their
+handling of a failed allocation for that case. Slabs are never freed; leasing one is a flag flip, safe from any task.
+metrics::POOL_LEASES and POOL_FALLBACKS count how often the pool covered a request.
+*/
+
+class BufferLease {
+ public:
+  BufferLease() = default;
+  ~BufferLease() { release(); }
+  BufferLease(BufferLease&& other) noexcept;
+  BufferLease& operator=(BufferLease&& other) noexcept;
+  BufferLease(const BufferLease&) = delete;
+  BufferLease& operator=(const BufferLease&) = delete;
+
+  uint8_t* data() const { return bytes; }
+  // The requested size; a slab may be larger
+  size_t size() const { return length; }
+  bool isPooled() const { return slab >= 0; }
+  explicit operator bool() const { return bytes != nullptr; }
+
+  // Return the buffer to its slab or the heap
+  void release();
+
+ private:
+  friend class BufferPool;
+
+  uint8_t* bytes = nullptr;
+  size_t length = 0;
+  int8_t slab = -1;  // Index of the leased slab, or -1 if bytes came from malloc
+};
+
+class BufferPool {
+ public:
+  // The slab sizes reserved at boot, see main.cpp
+  static constexpr size_t SMALL_SLAB = 8 * 1024;
+  static constexpr size_t WINDOW_SLAB = 32 * 1024;  // A deflate window
+  static constexpr size_t FRAME_SLAB = 48000;       // HalDisplay::BUFFER_SIZE
+  static constexpr int MAX_SLABS = 8;
+
+  // Reserve count slabs of size bytes. Call at boot, before the heap gets fragmented. Returns the number reserved.
+  static int reserve(size_t size, int count);
+
+  // A buffer of at least size bytes: the smallest free slab that fits, else from the heap if heapFallback is set.
+  // Check the lease before use; it is empty if neither had room.
+  static BufferLease lease(size_t size, bool heapFallback = true);
+
+  // Slabs leased right now, and the most that ever were at once
+  static int slabsInUse();
+  static int peakSlabsInUse();
+};
@@ -0,0 +1,763 @@
+#include "Dictionary.h"
+
+#include <InflateReader.h>
+#include <Logging.h>
+#include <Utf8.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace {
+constexpr char INDEX_MAGIC[4] = {'C', 'P', 'D', 'I'};
+constexpr uint8_t INDEX_VERSION = 1;
+constexpr char INDEX_EXTENSION[] = ".cpidx";
+constexpr char IFO_MAGIC[] = "StarDict's dict ifo file";
+// Headwords are at most 255 bytes, then the NUL and up to 12 bytes of offset and size
+constexpr size_t MAX_IDX_ENTRY = 256 + 12;
+constexpr size_t IDX_READ_SIZE = 4096;
+constexpr size_t INFLATE_READ_SIZE = 1024;
+constexpr size_t INFLATE_SKIP_SIZE = 512;
+// Headwords differing only in case (noun and name, say) are shown together, up to this many
+constexpr int MAX_MATCHES = 4;
+
+uint32_t readBigEndian(const uint8_t* bytes, const int count) {
+  uint32_t value = 0;
+  for (int i = 0; i < count; i++) {
+    value = value << 8 | bytes[i];
+  }
+  return value;
+}
+
+uint16_t readLittleEndian16(const uint8_t* bytes) { return bytes[0] | bytes[1] << 8; }
+
+char asciiLower(const char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+bool endsWith(const char* name, const char* suffix) {
+  const size_t nameLen = strlen(name);
+  const size_t suffixLen = strlen(suffix);
+  return nameLen >= suffixLen && strcasecmp(name + nameLen - suffixLen, suffix) == 0;
+}
+
+// Quotes, dashes and other punctuation that sticks to words, besides ASCII
+bool isPunctuation(const uint32_t cp) {
+  if (cp < 0x80) {
+    return !((cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z'));
+  }
+  return cp == 0x00A1 || cp == 0x00AB || cp == 0x00AD || cp == 0x00BB || cp == 0x00BF ||
+         (cp >= 0x2010 && cp <= 0x205E) || (cp >= 0x3000 && cp <= 0x303F);
+}
+
+// File name of the .ifo in dir without its extension, empty when there is none
+std::string findIfo(const std::string& dir) {
+  HalFile folder = Storage.open(dir.c_str());
+  if (!folder || !folder.isDirectory()) {
+    return "";
+  }
+  char name[128];
+  for (auto file = folder.openNextFile(); file; file = folder.openNextFile()) {
+    file.getName(name, sizeof(name));
+    if (!file.isDirectory() && name[0] != '.' && endsWith(name, ".ifo")) {
+      return std::string(name, strlen(name) - 4);
+    }
+  }
+  return "";
+}
+
+// Appends markup (HTML, XDXF, Pango) as text: tags dropped, line breaks and block ends turned into newlines, the
+// common entities decoded
+void appendMarkup(const char* text, const size_t len, std::string& out) {
+  static constexpr struct {
+    const char* name;
+    char value;
+  } ENTITIES[] = {{"lt;", '<'}, {"gt;", '>'}, {"amp;", '&'}, {"quot;", '"'}, {"apos;", '\''}, {"nbsp;", ' '}};
+
+  size_t i = 0;
+  while (i < len) {
+    if (text[i] == '<') {
+      const char* end = static_cast<const char*>(memchr(text + i, '>', len - i));
+      if (!end) {
+        break;
+      }
+      const char* tag = text + i + 1;
+      const bool closing = *tag == '/';
+      if (closing) {
+        tag++;
+      }
+      const size_t tagLen = end - tag;
+      const auto isTag = [tag, tagLen](const char* name) {
+        const size_t nameLen = strlen(name);
+        return tagLen >= nameLen && strncasecmp(tag, name, nameLen) == 0 &&
+               (tagLen == nameLen || tag[nameLen] == ' ' || tag[nameLen] == '/' || tag[nameLen] == '>');
+      };
+      if (isTag("br") || (closing && (isTag("p") || isTag("div") || isTag("li") || isTag("def")))) {
+        out += '\n';
+      }
+      i = end - text + 1;
+    } else if (text[i] == '&') {
+      bool decoded = false;
+      for (const auto& entity : ENTITIES) {
+        const size_t nameLen = strlen(entity.name);
+        if (len - i - 1 >= nameLen && strncmp(text + i + 1, entity.name, nameLen) == 0) {
+          out += entity.value;
+          i += nameLen + 1;
+          decoded = true;
+          break;
+        }
+      }
+      if (!decoded) {
+        out += text[i++];
+      }
+    } else {
+      out += text[i++];
+    }
+  }
+}
+
+struct ChunkInflateCtx {
+  InflateReader reader;  // Must be first, see InflateReader
+  FsFile* file = nullptr;
+  uint32_t remaining = 0;
+  uint8_t readBuffer[INFLATE_READ_SIZE];
+  uint8_t skipBuffer[INFLATE_SKIP_SIZE];
+};
+
+int chunkReadCallback(uzlib_uncomp* uncomp) {
+  auto* ctx = reinterpret_cast<ChunkInflateCtx*>(uncomp);
+  if (ctx->remaining == 0) return -1;
+
+  const size_t toRead = std::min<size_t>(ctx->remaining, sizeof(ctx->readBuffer));
+  const size_t bytesRead = ctx->file->read(ctx->readBuffer, toRead);
+  if (bytesRead == 0) return -1;
+  ctx->remaining -= bytesRead;
+
+  uncomp->source = ctx->readBuffer + 1;
+  uncomp->source_limit = ctx->readBuffer + bytesRead;
+  return ctx->readBuffer[0];
+}
+}  // namespace
+
+std::string Dictionary::findInstalled() {
+  HalFile root = Storage.open(DICTIONARIES_DIR);
+  if (!root || !root.isDirectory()) {
+    return "";
+  }
+  char name[64];
+  for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
+    const bool isDirectory = file.isDirectory();
+    file.getName(name, sizeof(name));
+    if (isDirectory && name[0] != '.') {
+      const std::string dir = std::string(DICTIONARIES_DIR) + "/" + name;
+      if (!findIfo(dir).empty()) {
+        return dir;
+      }
+    }
+  }
+  return "";
+}
+
+std::string Dictionary::lookupForm(const char* word, const size_t len) {
+  // Byte range from the first to the last character that isn't punctuation
+  size_t start = len;
+  size_t end = 0;
+  const auto* cursor = reinterpret_cast<const unsigned char*>(word);
+  const auto* limit = cursor + len;
+  while (cursor < limit) {
+    const size_t offset = cursor - reinterpret_cast<const unsigned char*>(word);
+    const uint32_t cp = utf8NextCodepoint(&cursor);
+    if (cp == 0) {
+      break;
+    }
+    if (!isPunctuation(cp)) {
+      start = std::min(start, offset);
+      end = cursor - reinterpret_cast<const unsigned char*>(word);
+    }
+  }
+  return start < end ? std::string(word + start, end - start) : std::string();
+}
+
+void Dictionary::makeKey(const char* word, char* key) {
+  size_t i = 0;
+  for (; i < KEY_WIDTH && word[i]; i++) {
+    key[i] = asciiLower(word[i]);
+  }
+  memset(key + i, 0, KEY_WIDTH - i);
+}
+
+bool Dictionary::open(const std::string& dir, const std::function<void()>& popupFn) {
+  const std::string ifoName = findIfo(dir);
+  if (ifoName.empty()) {
+    LOG_ERR("DIC", "No .ifo in %s", dir.c_str());
+    return false;
+  }
+  basePath = dir + "/" + ifoName;
+  if (!readInfo(basePath + ".ifo")) {
+    return false;
+  }
+
+  const std::string indexPath = basePath + INDEX_EXTENSION;
+  if (!loadIndex(indexPath)) {
+    if (popupFn) {
+      popupFn();
+    }
+    const unsigned long start = millis();
+    if (!buildIndex(indexPath) || !loadIndex(indexPath)) {
+      LOG_ERR("DIC", "Failed to build the index of %s", basePath.c_str());
+      Storage.remove(indexPath.c_str());
+      return false;
+    }
+    LOG_INF("DIC", "Indexed %u words in %lu ms", static_cast<unsigned>(recordCount), millis() - start);
+  }
+
+  if (!openDictData()) {
+    indexFile.close();
+    tableKeys.clear();
+    return false;
+  }
+  LOG_DBG("DIC", "Opened %s (%u words)", bookName.c_str(), static_cast<unsigned>(recordCount));
+  return true;
+}
+
+bool Dictionary::readInfo(const std::string& ifoPath) {
+  FsFile file;
+  if (!Storage.openFileForRead("DIC", ifoPath, file)) {
+    return false;
+  }
+
+  std::string line;
+  bool first = true;
+  bool valid = false;
+  const auto parseLine = [&]() {
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+      line.pop_back();
+    }
+    if (first) {
+      valid = line == IFO_MAGIC;
+      first = false;
+      return;
+    }
+    const size_t equals = line.find('=');
+    if (equals == std::string::npos) {
+      return;
+    }
+    const std::string key = line.substr(0, equals);
+    const std::string value = line.substr(equals + 1);
+    if (key == "bookname") {
+      bookName = value;
+    } else if (key == "wordcount") {
+      wordCount = strtoul(value.c_str(), nullptr, 10);
+    } else if (key == "idxfilesize") {
+      idxFileSize = strtoul(value.c_str(), nullptr, 10);
+    } else if (key == "idxoffsetbits") {
+      offsetBits = static_cast<uint8_t>(strtoul(value.c_str(), nullptr, 10));
+    } else if (key == "sametypesequence") {
+      sameTypeSequence = value;
+    }
+  };
+
+  char buffer[256];
+  size_t bytesRead;
+  while ((bytesRead = file.read(buffer, sizeof(buffer))) > 0) {
+    for (size_t i = 0; i < bytesRead; i++) {
+      if (buffer[i] == '\n') {
+        parseLine();
+        line.clear();
+      } else if (line.size() < 512) {
+        line += buffer[i];
+      }
+    }
+  }
+  parseLine();
+
+  if (!valid || wordCount == 0 || (offsetBits != 32 && offsetBits != 64)) {
+    LOG_ERR("DIC", "%s is not a usable StarDict .ifo", ifoPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Dictionary::loadIndex(const std::string& indexPath) {
+  if (!Storage.exists(indexPath.c_str()) || !Storage.openFileForRead("DIC", indexPath, indexFile)) {
+    return false;
+  }
+
+  auto* page = static_cast<uint8_t*>(malloc(PAGE_SIZE));
+  if (!page) {
+    LOG_ERR("DIC", "No memory for an index page");
+    indexFile.close();
+    return false;
+  }
+
+  IndexHeader header;
+  const bool readOk = readPage(0, page);
+  memcpy(&header, page, sizeof(header));
+  const uint32_t expectedLeaves = (wordCount + RECORDS_PER_LEAF - 1) / RECORDS_PER_LEAF;
+  const uint32_t expectedTablePages = (expectedLeaves + KEYS_PER_TABLE_PAGE - 1) / KEYS_PER_TABLE_PAGE;
+  const bool valid = readOk && memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                     header.version == INDEX_VERSION && header.keyWidth == KEY_WIDTH &&
+                     header.offsetBits == offsetBits && header.idxFileSize == idxFileSize &&
+                     header.recordCount == wordCount && header.leafCount == expectedLeaves &&
+                     header.tablePageCount == expectedTablePages &&
+                     sizeof(header) + expectedTablePages * KEY_WIDTH <= PAGE_SIZE &&
+                     indexFile.size() == (1 + expectedLeaves + expectedTablePages) * PAGE_SIZE;
+  if (!valid) {
+    LOG_DBG("DIC", "Index %s is missing or stale", indexPath.c_str());
+    free(page);
+    indexFile.close();
+    return false;
+  }
+
+  recordCount = header.recordCount;
+  leafCount = header.leafCount;
+  tableKeys.assign(page + sizeof(header), page + sizeof(header) + header.tablePageCount * KEY_WIDTH);
+  free(page);
+  return true;
+}
+
+bool Dictionary::buildIndex(const std::string& indexPath) {
+  FsFile idx;
+  if (!Storage.openFileForRead("DIC", basePath + ".idx", idx)) {
+    return false;
+  }
+  if (idx.size() != idxFileSize) {
+    LOG_ERR("DIC", ".idx is %u bytes, the .ifo says %u", static_cast<unsigned>(idx.size()),
+            static_cast<unsigned>(idxFileSize));
+    return false;
+  }
+
+  const uint32_t leaves = (wordCount + RECORDS_PER_LEAF - 1) / RECORDS_PER_LEAF;
+  const uint32_t tablePages = (leaves + KEYS_PER_TABLE_PAGE - 1) / KEYS_PER_TABLE_PAGE;
+  if (sizeof(IndexHeader) + tablePages * KEY_WIDTH > PAGE_SIZE) {
+    LOG_ERR("DIC", "Too many words for the index: %u", static_cast<unsigned>(wordCount));
+    return false;
+  }
+
+  const std::string tmpPath = indexPath + ".tmp";
+  FsFile out;
+  if (!Storage.openFileForWrite("DIC", tmpPath, out)) {
+    return false;
+  }
+
+  auto* page = static_cast<uint8_t*>(calloc(1, PAGE_SIZE));
+  auto* input = static_cast<uint8_t*>(malloc(IDX_READ_SIZE + MAX_IDX_ENTRY));
+  if (!page || !input) {
+    LOG_ERR("DIC", "No memory to build the index");
+    free(page);
+    free(input);
+    out.close();
+    Storage.remove(tmpPath.c_str());
+    return false;
+  }
+
+  // Page 0 is written last, once the table keys are known
+  bool ok = out.write(page, PAGE_SIZE) == PAGE_SIZE;
+
+  // Leaves, straight from the .idx: it is sorted already, which is checked on the way
+  const int offsetBytes = offsetBits / 8;
+  size_t inputLen = 0;
+  size_t inputPos = 0;
+  uint32_t inputFileOffset = 0;  // Of input[0]
+  uint32_t count = 0;
+  char previousKey[KEY_WIDTH] = {};
+  while (ok) {
+    if (inputLen - inputPos < MAX_IDX_ENTRY) {
+      memmove(input, input + inputPos, inputLen - inputPos);
+      inputFileOffset += inputPos;
+      inputLen -= inputPos;
+      inputPos = 0;
+      inputLen += idx.read(input + inputLen, IDX_READ_SIZE + MAX_IDX_ENTRY - inputLen);
+      if (inputLen == 0) {
+        break;
+      }
+    }
+
+    const uint8_t* entry = input + inputPos;
+    const size_t available = inputLen - inputPos;
+    const auto* nul = static_cast<const uint8_t*>(memchr(entry, 0, std::min<size_t>(available, 256)));
+    const size_t entryLen = nul ? nul - entry + 1 + offsetBytes + 4 : 0;
+    if (!nul || entryLen > available || count == wordCount) {
+      LOG_ERR("DIC", "Malformed .idx at %u", static_cast<unsigned>(inputFileOffset + inputPos));
+      ok = false;
+      break;
+    }
+
+    Record record;
+    makeKey(reinterpret_cast<const char*>(entry), record.key);
+    if (memcmp(record.key, previousKey, KEY_WIDTH) < 0) {
+      LOG_ERR("DIC", "The .idx is not sorted at \"%s\"", reinterpret_cast<const char*>(entry));
+      ok = false;
+      break;
+    }
+    memcpy(previousKey, record.key, KEY_WIDTH);
+
+    const uint8_t* numbers = nul + 1;
+    if (offsetBytes == 8 && readBigEndian(numbers, 4) != 0) {
+      LOG_ERR("DIC", "Definitions past 4 GB are not supported");
+      ok = false;
+      break;
+    }
+    record.idxOffset = inputFileOffset + inputPos;
+    record.dataOffset = readBigEndian(numbers + offsetBytes - 4, 4);
+    record.dataSize = readBigEndian(numbers + offsetBytes, 4);
+    inputPos += entryLen;
+
+    memcpy(page + (count % RECORDS_PER_LEAF) * sizeof(Record), &record, sizeof(Record));
+    count++;
+    if (count % RECORDS_PER_LEAF == 0) {
+      ok = out.write(page, PAGE_SIZE) == PAGE_SIZE;
+      memset(page, 0, PAGE_SIZE);
+    }
+  }
+  if (ok && count % RECORDS_PER_LEAF != 0) {
+    ok = out.write(page, PAGE_SIZE) == PAGE_SIZE;
+  }
+  if (ok && count != wordCount) {
+    LOG_ERR("DIC", "The .idx has %u words, the .ifo says %u", static_cast<unsigned>(count),
+            static_cast<unsigned>(wordCount));
+    ok = false;
+  }
+
+  // Table pages: the first key of every leaf, read back from the leaves just written. The header page collects the
+  // first key of every table page.
+  IndexHeader header = {};
+  memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.version = INDEX_VERSION;
+  header.keyWidth = KEY_WIDTH;
+  header.offsetBits = offsetBits;
+  header.idxFileSize = idxFileSize;
+  header.recordCount = count;
+  header.leafCount = leaves;
+  header.tablePageCount = tablePages;
+  auto* headerPage = input;  // Done with the .idx
+  memset(headerPage, 0, PAGE_SIZE);
+  memcpy(headerPage, &header, sizeof(header));
+
+  for (uint32_t tablePage = 0; ok && tablePage < tablePages; tablePage++) {
+    memset(page, 0, PAGE_SIZE);
+    const uint32_t firstLeaf = tablePage * KEYS_PER_TABLE_PAGE;
+    const uint32_t lastLeaf = std::min<uint32_t>(firstLeaf + KEYS_PER_TABLE_PAGE, leaves);
+    for (uint32_t leaf = firstLeaf; ok && leaf < lastLeaf; leaf++) {
+      ok = out.seek((1 + leaf) * PAGE_SIZE) &&
+           out.read(page + (leaf - firstLeaf) * KEY_WIDTH, KEY_WIDTH) == static_cast<int>(KEY_WIDTH);
+    }
+    memcpy(headerPage + sizeof(header) + tablePage * KEY_WIDTH, page, KEY_WIDTH);
+    ok = ok && out.seek((1 + leaves + tablePage) * PAGE_SIZE) && out.write(page, PAGE_SIZE) == PAGE_SIZE;
+  }
+  ok = ok && out.seek(0) && out.write(headerPage, PAGE_SIZE) == PAGE_SIZE;
+
+  free(page);
+  free(input);
+  out.close();
+  if (!ok) {
+    Storage.remove(tmpPath.c_str());
+    return false;
+  }
+  Storage.remove(indexPath.c_str());
+  return Storage.rename(tmpPath.c_str(), indexPath.c_str());
+}
+
+bool Dictionary::openDictData() {
+  chunkOffsets.clear();
+  if (Storage.exists((basePath + ".dict").c_str())) {
+    return Storage.openFileForRead("DIC", basePath + ".dict", dictFile);
+  }
+  if (Storage.openFileForRead("DIC", basePath + ".dict.dz", dictFile)) {
+    return readDictzipHeader();
+  }
+  LOG_ERR("DIC", "No .dict or .dict.dz for %s", basePath.c_str());
+  return false;
+}
+
+bool Dictionary::readDictzipHeader() {
+  // gzip header with the FEXTRA field, which holds dictzip's "RA" subfield: version, chunk length, chunk count and
+  // the compressed size of every chunk
+  uint8_t head[12];
+  if (dictFile.read(head, sizeof(head)) != sizeof(head) || head[0] != 0x1f || head[1] != 0x8b || head[2] != 8 ||
+      !(head[3] & 0x04)) {
+    LOG_ERR("DIC", "%s.dict.dz is not a dictzip file", basePath.c_str());
+    return false;
+  }
+  const uint8_t flags = head[3];
+  const uint16_t extraLen = readLittleEndian16(head + 10);
+  std::vector<uint8_t> extra(extraLen);
+  if (dictFile.read(extra.data(), extraLen) != extraLen) {
+    return false;
+  }
+
+  uint32_t chunkCount = 0;
+  size_t pos = 0;
+  while (pos + 4 <= extraLen) {
+    const uint16_t fieldLen = readLittleEndian16(&extra[pos + 2]);
+    const uint8_t* field = &extra[pos + 4];
+    if (extra[pos] == 'R' && extra[pos + 1] == 'A' && fieldLen >= 6 && pos + 4 + fieldLen <= extraLen) {
+      chunkLength = readLittleEndian16(field + 2);
+      chunkCount = readLittleEndian16(field + 4);
+      if (chunkLength == 0 || 6 + chunkCount * 2u > fieldLen) {
+        chunkCount = 0;
+        break;
+      }
+      chunkOffsets.resize(chunkCount + 1);
+      for (uint32_t i = 0; i < chunkCount; i++) {
+        chunkOffsets[i + 1] = readLittleEndian16(field + 6 + i * 2);
+      }
+      break;
+    }
+    pos += 4 + fieldLen;
+  }
+  if (chunkCount == 0) {
+    LOG_ERR("DIC", "%s.dict.dz has no random access table, recompress it with dictzip", basePath.c_str());
+    chunkOffsets.clear();
+    return false;
+  }
+
+  // Optional file name and comment, then the header CRC
+  uint32_t dataStart = sizeof(head) + extraLen;
+  for (const uint8_t flag : {0x08, 0x10}) {
+    if (flags & flag) {
+      uint8_t c;
+      do {
+        if (dictFile.read(&c, 1) != 1) {
+          return false;
+        }
+        dataStart++;
+      } while (c != 0);
+    }
+  }
+  if (flags & 0x02) {
+    dataStart += 2;
+  }
+
+  // Compressed sizes to file offsets
+  chunkOffsets[0] = dataStart;
+  for (uint32_t i = 1; i <= chunkCount; i++) {
+    chunkOffsets[i] += chunkOffsets[i - 1];
+  }
+  return true;
+}
+
+bool Dictionary::readPage(const uint32_t page, uint8_t* buffer) {
+  return indexFile.seek(page * PAGE_SIZE) && indexFile.read(buffer, PAGE_SIZE) == static_cast<int>(PAGE_SIZE);
+}
+
+bool Dictionary::headwordMatches(const Record& record, const std::string& word) {
+  if (word.size() < KEY_WIDTH) {
+    return true;  // The key holds the whole headword
+  }
+  if (!idxFile && !Storage.openFileForRead("DIC", basePath + ".idx", idxFile)) {
+    return false;
+  }
+  char headword[257];
+  if (!idxFile.seek(record.idxOffset)) {
+    return false;
+  }
+  const int bytesRead = idxFile.read(headword, sizeof(headword) - 1);
+  if (bytesRead <= 0) {
+    return false;
+  }
+  headword[bytesRead] = '\0';
+  return strcasecmp(headword, word.c_str()) == 0;
+}
+
+bool Dictionary::lookup(const std::string& word, std::string& definition) {
+  definition.clear();
+  if (!isOpen() || word.empty()) {
+    return false;
+  }
+  const unsigned long start = millis();
+
+  char key[KEY_WIDTH];
+  makeKey(word.c_str(), key);
+  // The last of keys that is below key, or the first: equal keys may begin at the end of the one before
+  const auto lastBelow = [&key](const char* keys, const uint32_t count) -> uint32_t {
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high) {
+      const uint32_t mid = (low + high) / 2;
+      if (memcmp(keys + mid * KEY_WIDTH, key, KEY_WIDTH) < 0) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return low > 0 ? low - 1 : 0;
+  };
+
+  auto* page = static_cast<uint8_t*>(malloc(PAGE_SIZE));
+  if (!page) {
+    LOG_ERR("DIC", "No memory for an index page");
+    return false;
+  }
+
+  const uint32_t tablePageCount = tableKeys.size() / KEY_WIDTH;
+  const uint32_t tablePage = lastBelow(tableKeys.data(), tablePageCount);
+  const uint32_t firstLeaf = tablePage * KEYS_PER_TABLE_PAGE;
+  if (!readPage(1 + leafCount + tablePage, page)) {
+    free(page);
+    return false;
+  }
+  uint32_t leaf =
+      firstLeaf + lastBelow(reinterpret_cast<const char*>(page),
+                            std::min<uint32_t>(KEYS_PER_TABLE_PAGE, leafCount - firstLeaf));
+
+  // First record at or past key, then every record with the same key, into the next leaf if need be
+  int matches = 0;
+  bool done = false;
+  for (; leaf < leafCount && !done; leaf++) {
+    if (!readPage(1 + leaf, page)) {
+      break;
+    }
+    const auto* records = reinterpret_cast<const Record*>(page);
+    const uint32_t count = std::min<uint32_t>(RECORDS_PER_LEAF, recordCount - leaf * RECORDS_PER_LEAF);
+    const Record* record = std::lower_bound(records, records + count, key, [](const Record& r, const char* k) {
+      return memcmp(r.key, k, KEY_WIDTH) < 0;
+    });
+    for (; record < records + count; record++) {
+      if (memcmp(record->key, key, KEY_WIDTH) != 0 || matches == MAX_MATCHES ||
+          definition.size() >= MAX_DEFINITION_SIZE) {
+        done = true;
+        break;
+      }
+      std::string data;
+      if (!headwordMatches(*record, word) || !readData(record->dataOffset, record->dataSize, data)) {
+        continue;
+      }
+      if (!definition.empty()) {
+        definition += "\n\n";
+      }
+      appendDefinition(data, definition);
+      matches++;
+    }
+  }
+  free(page);
+
+  LOG_DBG("DIC", "Looked up \"%s\": %d match(es) in %lu ms", word.c_str(), matches, millis() - start);
+  return matches > 0;
+}
+
+bool Dictionary::readData(const uint32_t offset, uint32_t size, std::string& out) {
+  size = std::min<uint32_t>(size, MAX_DEFINITION_SIZE);
+  if (!chunkOffsets.empty()) {
+    return inflateData(offset, size, out);
+  }
+  out.resize(size);
+  return dictFile.seek(offset) && dictFile.read(&out[0], size) == static_cast<int>(size);
+}
+
+bool Dictionary::inflateData(const uint32_t offset, const uint32_t size, std::string& out) {
+  out.resize(size);
+  std::unique_ptr<ChunkInflateCtx> ctx(new (std::nothrow) ChunkInflateCtx());
+  if (!ctx) {
+    return false;
+  }
+
+  // Chunks are flushed independently, so each one inflates from its own start
+  uint32_t chunk = offset / chunkLength;
+  uint32_t inChunk = offset % chunkLength;
+  size_t produced = 0;
+  while (produced < size) {
+    if (chunk + 1 >= chunkOffsets.size() || !dictFile.seek(chunkOffsets[chunk])) {
+      return false;
+    }
+    ctx->file = &dictFile;
+    ctx->remaining = chunkOffsets[chunk + 1] - chunkOffsets[chunk];
+    if (!ctx->reader.init(true)) {
+      return false;
+    }
+    ctx->reader.setReadCallback(chunkReadCallback);
+
+    for (uint32_t skipped = 0; skipped < inChunk;) {
+      size_t got = 0;
+      const size_t want = std::min<size_t>(inChunk - skipped, sizeof(ctx->skipBuffer));
+      if (ctx->reader.readAtMost(ctx->skipBuffer, want, &got) == InflateStatus::Error || got != want) {
+        return false;
+      }
+      skipped += got;
+    }
+
+    const size_t want = std::min<size_t>(size - produced, chunkLength - inChunk);
+    size_t got = 0;
+    if (ctx->reader.readAtMost(reinterpret_cast<uint8_t*>(&out[produced]), want, &got) == InflateStatus::Error ||
+        got != want) {
+      return false;
+    }
+    produced += got;
+    chunk++;
+    inChunk = 0;
+  }
+  return true;
+}
+
+void Dictionary::appendDefinition(const std::string& data, std::string& definition) const {
+  const char* cursor = data.data();
+  const char* const end = cursor + data.size();
+
+  const auto appendField = [&definition](const char type, const char* text, const size_t len) {
+    switch (type) {
+      case 'm':
+      case 'l':
+      case 'y':
+      case 'n':
+        definition.append(text, len);
+        break;
+      case 't':
+        definition += '[';
+        definition.append(text, len);
+        definition += ']';
+        break;
+      case 'g':
+      case 'x':
+      case 'h':
+      case 'k':
+      case 'w':
+        appendMarkup(text, len, definition);
+        break;
+      default:
+        return;  // Sounds, pictures, resource lists
+    }
+    while (!definition.empty() && (definition.back() == '\n' || definition.back() == ' ')) {
+      definition.pop_back();
+    }
+    definition += '\n';
+  };
+
+  // Fields come as a type byte and the data when the .ifo has no sametypesequence, else in that order without the
+  // type bytes, the last one spanning what is left. Lowercase types are NUL-terminated text, uppercase ones are
+  // prefixed with their size.
+  size_t field = 0;
+  while (cursor < end) {
+    const bool typed = sameTypeSequence.empty();
+    if (!typed && field >= sameTypeSequence.size()) {
+      break;
+    }
+    const char type = typed ? *cursor++ : sameTypeSequence[field];
+    const bool last = !typed && field + 1 == sameTypeSequence.size();
+    field++;
+    if (cursor >= end) {
+      break;
+    }
+
+    size_t len;
+    const char* text = cursor;
+    if (last) {
+      len = end - cursor;
+      cursor = end;
+    } else if (type >= 'a' && type <= 'z') {
+      const auto* nul = static_cast<const char*>(memchr(cursor, 0, end - cursor));
+      len = nul ? nul - cursor : end - cursor;
+      cursor += len + (nul ? 1 : 0);
+    } else {
+      if (end - cursor < 4) {
+        break;
+      }
+      len = std::min<size_t>(readBigEndian(reinterpret_cast<const uint8_t*>(cursor), 4), end - cursor - 4);
+      text = cursor + 4;
+      cursor = text + len;
+    }
+    appendField(type, text, len);
+  }
+
+  while (!definition.empty() && definition.back() == '\n') {
+    definition.pop_back();
+  }
+}
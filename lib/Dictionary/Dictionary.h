@@ -0,0 +1,112 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+StarDict dictionary on the SD card, in a folder of its own under /dictionaries: the .ifo, the .idx and either the
+.dict or its dictzip'ed .dict.dz.
+
+The .idx is only read once, to convert it into a lookup index next to it (.cpidx) made of 4 KB pages:
+
+    page 0                 header, then the first key of every table page
+    pages 1 .. leafCount   leaves: 128 records of 32 bytes (key prefix, .idx entry, definition offset and size)
+    then                   table pages: the first key of every leaf, 204 per page
+
+Keys are the headwords lowercased (ASCII only, the same order as StarDict's g_ascii_strcasecmp) and cut to
+KEY_WIDTH bytes. The first key of every table page stays in memory, so a lookup is a binary search there, one table
+page read, one leaf read and a binary search in each. Headwords that don't fit in a key are checked against the
+.idx entry of the record. Definitions are then read straight from the .dict, or from the dictzip chunks that hold
+them, each of which inflates on its own.
+*/
+class Dictionary {
+ public:
+  static constexpr char DICTIONARIES_DIR[] = "/dictionaries";
+  // Definitions are cut to this many bytes, more than a screen holds
+  static constexpr size_t MAX_DEFINITION_SIZE = 4096;
+
+  // Folder of the first dictionary under DICTIONARIES_DIR, empty when there is none
+  static std::string findInstalled();
+
+  // The part of a word from the page that is looked up: leading and trailing punctuation and quotes removed.
+  // Empty when nothing but punctuation is left.
+  static std::string lookupForm(const char* word, size_t len);
+
+  Dictionary() = default;
+  ~Dictionary() = default;
+  Dictionary(const Dictionary&) = delete;
+  Dictionary& operator=(const Dictionary&) = delete;
+
+  // Opens the dictionary in dir, building its lookup index first when there is none yet (or the .idx changed);
+  // popupFn is called before that, since it takes a few seconds for a large dictionary
+  bool open(const std::string& dir, const std::function<void()>& popupFn = nullptr);
+  bool isOpen() const { return !tableKeys.empty(); }
+  const std::string& getName() const { return bookName; }
+
+  // Definitions of word as plain text, paragraphs separated by newlines. Headwords are matched regardless of
+  // (ASCII) case; when several match, their definitions follow each other. False when the word isn't in the
+  // dictionary.
+  bool lookup(const std::string& word, std::string& definition);
+
+ private:
+  static constexpr size_t PAGE_SIZE = 4096;
+  static constexpr size_t KEY_WIDTH = 20;
+  static constexpr size_t RECORDS_PER_LEAF = 128;
+  static constexpr size_t KEYS_PER_TABLE_PAGE = PAGE_SIZE / KEY_WIDTH;
+
+  struct Record {
+    char key[KEY_WIDTH];  // NUL-padded, not terminated when the headword fills it
+    uint32_t idxOffset;   // Of the headword's .idx entry
+    uint32_t dataOffset;
+    uint32_t dataSize;
+  };
+  static_assert(sizeof(Record) * RECORDS_PER_LEAF == PAGE_SIZE, "Leaves must fill a page");
+
+  struct IndexHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t keyWidth;
+    uint8_t offsetBits;  // Of the .idx the index was built from
+    uint8_t reserved;
+    uint32_t idxFileSize;
+    uint32_t recordCount;
+    uint32_t leafCount;
+    uint32_t tablePageCount;
+  };
+
+  std::string basePath;  // dir + the .ifo name without extension
+  std::string bookName;
+  std::string sameTypeSequence;
+  uint32_t wordCount = 0;
+  uint32_t idxFileSize = 0;
+  uint8_t offsetBits = 32;
+
+  FsFile indexFile;
+  FsFile idxFile;  // Opened on the first headword longer than a key
+  FsFile dictFile;
+  uint32_t recordCount = 0;
+  uint32_t leafCount = 0;
+  std::vector<char> tableKeys;  // First key of every table page
+
+  // dictzip: uncompressed chunk length and where each chunk starts in the file; empty for a plain .dict
+  uint32_t chunkLength = 0;
+  std::vector<uint32_t> chunkOffsets;
+
+  static void makeKey(const char* word, char* key);
+
+  bool readInfo(const std::string& ifoPath);
+  bool loadIndex(const std::string& indexPath);
+  bool buildIndex(const std::string& indexPath);
+  bool openDictData();
+  bool readDictzipHeader();
+
+  bool readPage(uint32_t page, uint8_t* buffer);
+  bool headwordMatches(const Record& record, const std::string& word);
+  bool readData(uint32_t offset, uint32_t size, std::string& out);
+  bool inflateData(uint32_t offset, uint32_t size, std::string& out);
+  void appendDefinition(const std::string& data, std::string& definition) const;
+};
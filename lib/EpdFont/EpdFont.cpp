@@ -3,6 +3,8 @@
 #include <Utf8.h>
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 void EpdFont::getTextBounds(const char* string, const int startX, const int startY, int* minX, int* minY, int* maxX,
                             int* maxY) const {
@@ -21,13 +23,14 @@ void EpdFont::getTextBounds(const char* string, const int startX, const int star
   int lastBaseAdvance = 0;
   int lastBaseTop = 0;
   constexpr int MIN_COMBINING_GAP_PX = 1;
-  uint32_t cp;
   uint32_t prevCp = 0;
-  while ((cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&string)))) {
+  const Utf8Codepoints codepoints(string);
+  for (const uint32_t* next = codepoints.begin(); next < codepoints.end();) {
+    uint32_t cp = *next++;
     const bool isCombining = utf8IsCombiningMark(cp);
 
     if (!isCombining) {
-      cp = applyLigatures(cp, string);
+      cp = applyLigatures(cp, next, codepoints.end());
     }
 
     const EpdGlyph* glyph = getGlyph(cp);
@@ -76,6 +79,88 @@ void EpdFont::getTextDimensions(const char* string, int* w, int* h) const {
   *h = maxY - minY;
 }
 
+size_t EpdFont::fitTextPrefix(const char* string, const int maxWidth, const uint32_t suffixCp) const {
+  const char* const start = string;
+  const EpdGlyph* suffix = suffixCp ? getGlyph(suffixCp) : nullptr;
+
+  // Horizontal half of getTextBounds()
+  struct Line {
+    int minX = 0;
+    int maxX = 0;
+    int cursorX = 0;
+    int lastBaseX = 0;
+    int lastBaseAdvance = 0;
+    uint32_t prevCp = 0;
+  };
+  const auto addCodepoint = [this](Line& line, uint32_t cp, const char*& text) {
+    const bool isCombining = utf8IsCombiningMark(cp);
+    if (!isCombining) {
+      cp = applyLigatures(cp, text);
+    }
+    const EpdGlyph* glyph = getGlyph(cp);
+    if (!glyph) {
+      line.prevCp = 0;
+      return;
+    }
+    if (!isCombining && line.prevCp != 0) {
+      line.cursorX += getKerning(line.prevCp, cp);
+    }
+    const int glyphBaseX = isCombining ? (line.lastBaseX + line.lastBaseAdvance / 2) : line.cursorX;
+    line.minX = std::min(line.minX, glyphBaseX + glyph->left);
+    line.maxX = std::max(line.maxX, glyphBaseX + glyph->left + glyph->width);
+    if (!isCombining) {
+      line.lastBaseX = line.cursorX;
+      line.lastBaseAdvance = glyph->advanceX;
+      line.cursorX += glyph->advanceX;
+      line.prevCp = cp;
+    }
+  };
+  const auto fits = [&](const Line& line) {
+    if (!suffix) {
+      return line.maxX - line.minX <= maxWidth;
+    }
+    const int suffixX = line.cursorX + (line.prevCp != 0 ? getKerning(line.prevCp, suffixCp) : 0) + suffix->left;
+    return std::max(line.maxX, suffixX + suffix->width) - std::min(line.minX, suffixX) <= maxWidth;
+  };
+
+  Line line;
+  size_t fit = 0;
+  while (*string) {
+    const char* unitStart = string;
+    const Line before = line;
+    const uint32_t cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&string));
+    const char* firstEnd = string;
+    addCodepoint(line, cp, string);
+
+    // A ligature swallowed the following codepoints. Cutting inside it leaves the first part unligated (or a shorter
+    // ligature), so measure those cut points on their own, as the shorter string would be measured.
+    char part[32];
+    for (const char* cut = firstEnd; cut < string && cut - unitStart < static_cast<ptrdiff_t>(sizeof(part));) {
+      memcpy(part, unitStart, cut - unitStart);
+      part[cut - unitStart] = '\0';
+      Line partLine = before;
+      const char* text = part;
+      uint32_t partCp;
+      while ((partCp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&text)))) {
+        addCodepoint(partLine, partCp, text);
+      }
+      if (fits(partLine)) {
+        fit = cut - start;
+      }
+      utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&cut));
+    }
+
+    // The bounds only grow as codepoints are added, so the first prefix that is too wide on its own ends the search
+    if (line.maxX - line.minX > maxWidth) {
+      break;
+    }
+    if (fits(line)) {
+      fit = string - start;
+    }
+  }
+  return fit;
+}
+
 static uint8_t lookupKernClass(const EpdKernClassEntry* entries, const uint16_t count, const uint32_t cp) {
   if (!entries || count == 0 || cp > 0xFFFF) {
     return 0;
@@ -102,11 +187,38 @@ int8_t EpdFont::getKerning(const uint32_t leftCp, const uint32_t rightCp) const
   if (!data->kernMatrix) {
     return 0;
   }
-  const uint8_t lc = lookupKernClass(data->kernLeftClasses, data->kernLeftEntryCount, leftCp);
-  if (lc == 0) return 0;
-  const uint8_t rc = lookupKernClass(data->kernRightClasses, data->kernRightEntryCount, rightCp);
-  if (rc == 0) return 0;
-  return data->kernMatrix[(lc - 1) * data->kernRightClassCount + (rc - 1)];
+  return getClassKerning(getKernLeftClass(leftCp), getKernRightClass(rightCp));
+}
+
+uint8_t EpdFont::getKernLeftClass(const uint32_t cp) const {
+  if (!data->kernMatrix) {
+    return 0;
+  }
+  const int slot = hotSlot(cp);
+  const HotTable* table = slot >= 0 ? getHotTable() : nullptr;
+  if (table) {
+    return table->glyphs[slot].kernLeftClass;
+  }
+  return lookupKernClass(data->kernLeftClasses, data->kernLeftEntryCount, cp);
+}
+
+uint8_t EpdFont::getKernRightClass(const uint32_t cp) const {
+  if (!data->kernMatrix) {
+    return 0;
+  }
+  const int slot = hotSlot(cp);
+  const HotTable* table = slot >= 0 ? getHotTable() : nullptr;
+  if (table) {
+    return table->glyphs[slot].kernRightClass;
+  }
+  return lookupKernClass(data->kernRightClasses, data->kernRightEntryCount, cp);
+}
+
+int8_t EpdFont::getClassKerning(const uint8_t leftClass, const uint8_t rightClass) const {
+  if (leftClass == 0 || rightClass == 0) {
+    return 0;
+  }
+  return data->kernMatrix[(leftClass - 1) * data->kernRightClassCount + (rightClass - 1)];
 }
 
 uint32_t EpdFont::getLigature(const uint32_t leftCp, const uint32_t rightCp) const {
@@ -135,8 +247,18 @@ uint32_t EpdFont::getLigature(const uint32_t leftCp, const uint32_t rightCp) con
   return 0;
 }
 
-uint32_t EpdFont::applyLigatures(uint32_t cp, const char*& text) const {
+bool EpdFont::mayStartLigature(const uint32_t cp) const {
   if (!data->ligaturePairs || data->ligaturePairCount == 0) {
+    return false;
+  }
+  // Most letters start no ligature, which spares decoding the next codepoint and searching the pairs
+  const int slot = hotSlot(cp);
+  const HotTable* table = slot >= 0 ? getHotTable() : nullptr;
+  return !table || (table->ligatureStart[slot / 8] & (1 << (slot % 8)));
+}
+
+uint32_t EpdFont::applyLigatures(uint32_t cp, const char*& text) const {
+  if (!mayStartLigature(cp)) {
     return cp;
   }
   while (true) {
@@ -153,12 +275,71 @@ uint32_t EpdFont::applyLigatures(uint32_t cp, const char*& text) const {
   return cp;
 }
 
-const EpdGlyph* EpdFont::getGlyph(const uint32_t cp) const {
+uint32_t EpdFont::applyLigatures(uint32_t cp, const uint32_t*& next, const uint32_t* end) const {
+  if (!mayStartLigature(cp)) {
+    return cp;
+  }
+  for (; next < end; ++next) {
+    const uint32_t lig = getLigature(cp, *next);
+    if (lig == 0) {
+      break;
+    }
+    cp = lig;
+  }
+  return cp;
+}
+
+EpdFont::~EpdFont() { free(const_cast<HotTable*>(hotTable.load())); }
+
+int EpdFont::hotSlot(const uint32_t cp) {
+  if (cp < HOT_LATIN_END) {
+    return static_cast<int>(cp);
+  }
+  if (cp >= HOT_PUNCT_FIRST && cp < HOT_PUNCT_END) {
+    return static_cast<int>(HOT_LATIN_END + (cp - HOT_PUNCT_FIRST));
+  }
+  return -1;
+}
+
+const EpdFont::HotTable* EpdFont::getHotTable() const {
+  const HotTable* table = hotTable.load(std::memory_order_acquire);
+  if (table) {
+    return table;
+  }
+
+  auto* built = static_cast<HotTable*>(malloc(sizeof(HotTable)));
+  if (!built) {
+    // Out of memory: a table with no glyphs and no kerning classes would be wrong, so keep searching each time
+    return nullptr;
+  }
+  for (uint32_t slot = 0; slot < HOT_GLYPH_COUNT; slot++) {
+    const uint32_t cp = slot < HOT_LATIN_END ? slot : HOT_PUNCT_FIRST + (slot - HOT_LATIN_END);
+    const EpdGlyph* glyph = findGlyph(cp);
+    const ptrdiff_t index = glyph ? glyph - data->glyph : NO_HOT_GLYPH;
+    HotGlyph& hot = built->glyphs[slot];
+    hot.glyphIndex = index < NO_HOT_GLYPH ? static_cast<uint16_t>(index) : NO_HOT_GLYPH;
+    hot.kernLeftClass = lookupKernClass(data->kernLeftClasses, data->kernLeftEntryCount, cp);
+    hot.kernRightClass = lookupKernClass(data->kernRightClasses, data->kernRightEntryCount, cp);
+  }
+  memset(built->ligatureStart, 0, sizeof(built->ligatureStart));
+  for (uint32_t i = 0; i < data->ligaturePairCount; i++) {
+    const int slot = hotSlot(data->ligaturePairs[i].pair >> 16);
+    if (slot >= 0) {
+      built->ligatureStart[slot / 8] |= 1 << (slot % 8);
+    }
+  }
+
+  if (!hotTable.compare_exchange_strong(table, built, std::memory_order_acq_rel)) {
+    free(built);
+    return table;
+  }
+  return built;
+}
+
+const EpdGlyph* EpdFont::findGlyph(const uint32_t cp) const {
   const EpdUnicodeInterval* intervals = data->intervals;
   const int count = data->intervalCount;
 
-  if (count == 0) return nullptr;
-
   // Binary search for O(log n) lookup instead of O(n)
   // Critical for Korean fonts with many unicode intervals
   int left = 0;
@@ -177,6 +358,22 @@ const EpdGlyph* EpdFont::getGlyph(const uint32_t cp) const {
       return &data->glyph[interval->offset + (cp - interval->first)];
     }
   }
+  return nullptr;
+}
+
+const EpdGlyph* EpdFont::getGlyph(const uint32_t cp) const {
+  if (data->intervalCount == 0) return nullptr;
+
+  const int slot = hotSlot(cp);
+  const HotTable* table = slot >= 0 ? getHotTable() : nullptr;
+  if (table && table->glyphs[slot].glyphIndex != NO_HOT_GLYPH) {
+    return &data->glyph[table->glyphs[slot].glyphIndex];
+  }
+
+  const EpdGlyph* glyph = findGlyph(cp);
+  if (glyph) {
+    return glyph;
+  }
   if (cp != REPLACEMENT_GLYPH) {
     return getGlyph(REPLACEMENT_GLYPH);
   }
@@ -1,14 +1,49 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
+
 #include "EpdFontData.h"
 
 class EpdFont {
+  // Direct-index table for the codepoints most text is made of: Latin-1, Latin Extended-A and the General
+  // Punctuation quotes and dashes. Each slot holds what getGlyph(), getKerning() and applyLigatures() would
+  // otherwise binary-search for. Built on the first lookup, so only fonts that are actually drawn pay its RAM.
+  struct HotGlyph {
+    uint16_t glyphIndex;  // Index into data->glyph, NO_HOT_GLYPH to take the binary search
+    uint8_t kernLeftClass;
+    uint8_t kernRightClass;
+  };
+  static constexpr uint16_t NO_HOT_GLYPH = 0xFFFF;
+  static constexpr uint32_t HOT_LATIN_END = 0x180;
+  static constexpr uint32_t HOT_PUNCT_FIRST = 0x2010;
+  static constexpr uint32_t HOT_PUNCT_END = 0x2040;
+  static constexpr uint32_t HOT_GLYPH_COUNT = HOT_LATIN_END + (HOT_PUNCT_END - HOT_PUNCT_FIRST);
+
+  struct HotTable {
+    HotGlyph glyphs[HOT_GLYPH_COUNT];
+    uint8_t ligatureStart[(HOT_GLYPH_COUNT + 7) / 8];  // Bit set when the codepoint begins a ligature pair
+  };
+
+  // Render and prefetch tasks can race to build it; the loser frees its copy
+  mutable std::atomic<const HotTable*> hotTable{nullptr};
+
+  static int hotSlot(uint32_t cp);
+  const HotTable* getHotTable() const;
+  // False when cp certainly starts no ligature
+  bool mayStartLigature(uint32_t cp) const;
+  const EpdGlyph* findGlyph(uint32_t cp) const;
   void getTextBounds(const char* string, int startX, int startY, int* minX, int* minY, int* maxX, int* maxY) const;
 
  public:
   const EpdFontData* data;
   explicit EpdFont(const EpdFontData* data) : data(data) {}
-  ~EpdFont() = default;
+  ~EpdFont();
+  EpdFont(const EpdFont&) = delete;
+  EpdFont& operator=(const EpdFont&) = delete;
   void getTextDimensions(const char* string, int* w, int* h) const;
+  /// Length in bytes of the longest prefix of string whose width, with suffixCp drawn after it (0 for none), is at
+  /// most maxWidth. Measured in one forward pass, cutting only between codepoints (ligatures stay whole).
+  size_t fitTextPrefix(const char* string, int maxWidth, uint32_t suffixCp = 0) const;
 
   const EpdGlyph* getGlyph(uint32_t cp) const;
 
@@ -16,6 +51,12 @@ class EpdFont {
   /// Returns 0 if no kerning data exists for the pair.
   int8_t getKerning(uint32_t leftCp, uint32_t rightCp) const;
 
+  /// getKerning() in two steps, for callers that look up the classes of a codepoint once and reuse them.
+  /// Class 0 means the codepoint has no kerning on that side.
+  uint8_t getKernLeftClass(uint32_t cp) const;
+  uint8_t getKernRightClass(uint32_t cp) const;
+  int8_t getClassKerning(uint8_t leftClass, uint8_t rightClass) const;
+
   /// Returns the ligature codepoint for a pair, or 0 if no ligature exists.
   uint32_t getLigature(uint32_t leftCp, uint32_t rightCp) const;
 
@@ -23,4 +64,7 @@ class EpdFont {
   /// as many following codepoints from text as possible. Returns the
   /// (possibly substituted) codepoint; advances text past consumed chars.
   uint32_t applyLigatures(uint32_t cp, const char*& text) const;
+  /// The same over decoded codepoints (see Utf8Codepoints): next points just
+  /// past cp and is advanced past the codepoints the ligature swallowed.
+  uint32_t applyLigatures(uint32_t cp, const uint32_t*& next, const uint32_t* end) const;
 };
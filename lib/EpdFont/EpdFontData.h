@@ -45,6 +45,14 @@ typedef struct {
   uint32_t ligatureCp;  ///< Codepoint of the replacement ligature glyph
 } __attribute__((packed)) EpdLigaturePair;
 
+/// Supplies the compressed glyph groups of a font whose bitmaps are not memory mapped (SD card fonts, see SdFont)
+class EpdFontSource {
+ public:
+  virtual ~EpdFontSource() = default;
+  /// Pointer to size bytes at offset into the font's bitmap data, valid until the next call. nullptr on a read error.
+  virtual const uint8_t* readBitmap(uint32_t offset, uint32_t size) = 0;
+};
+
 /// Data stored for FONT AS A WHOLE
 typedef struct {
   const uint8_t* bitmap;                ///< Glyph bitmaps, concatenated
@@ -66,4 +74,5 @@ typedef struct {
   uint8_t kernRightClassCount;                ///< Number of distinct right classes (matrix cols)
   const EpdLigaturePair* ligaturePairs;       ///< Sorted ligature pair table (nullptr if none)
   uint32_t ligaturePairCount;                 ///< Number of entries in ligaturePairs
+  EpdFontSource* source;                      ///< Reads bitmap instead when set (nullptr for builtin fonts)
 } EpdFontData;
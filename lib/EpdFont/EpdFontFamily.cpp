@@ -22,6 +22,11 @@ void EpdFontFamily::getTextDimensions(const char* string, int* w, int* h, const
   getFont(style)->getTextDimensions(string, w, h);
 }
 
+size_t EpdFontFamily::fitTextPrefix(const char* string, const int maxWidth, const uint32_t suffixCp,
+                                    const Style style) const {
+  return getFont(style)->fitTextPrefix(string, maxWidth, suffixCp);
+}
+
 const EpdFontData* EpdFontFamily::getData(const Style style) const { return getFont(style)->data; }
 
 const EpdGlyph* EpdFontFamily::getGlyph(const uint32_t cp, const Style style) const {
@@ -35,3 +40,8 @@ int8_t EpdFontFamily::getKerning(const uint32_t leftCp, const uint32_t rightCp,
 uint32_t EpdFontFamily::applyLigatures(const uint32_t cp, const char*& text, const Style style) const {
   return getFont(style)->applyLigatures(cp, text);
 }
+
+uint32_t EpdFontFamily::applyLigatures(const uint32_t cp, const uint32_t*& next, const uint32_t* end,
+                                       const Style style) const {
+  return getFont(style)->applyLigatures(cp, next, end);
+}
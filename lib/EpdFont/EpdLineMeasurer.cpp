@@ -0,0 +1,71 @@
+#include "EpdLineMeasurer.h"
+
+#include <Utf8.h>
+
+#include <algorithm>
+
+void EpdLineMeasurer::setFont(const EpdFont* font) {
+  this->font = font;
+  for (int i = 0; i < ASCII_COUNT; i++) {
+    const uint32_t cp = ASCII_FIRST + i;
+    asciiGlyphs[i] = font ? font->getGlyph(cp) : nullptr;
+    asciiLeftClasses[i] = font ? font->getKernLeftClass(cp) : 0;
+    asciiRightClasses[i] = font ? font->getKernRightClass(cp) : 0;
+  }
+  reset();
+}
+
+void EpdLineMeasurer::reset() {
+  cursorX = 0;
+  minX = 0;
+  maxX = 0;
+  lastBaseX = 0;
+  lastBaseAdvance = 0;
+  prevLeftClass = 0;
+  hasPrev = false;
+}
+
+bool EpdLineMeasurer::addNext(const char*& text) {
+  uint32_t cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&text));
+  if (cp == 0) {
+    return false;
+  }
+  if (!font) {
+    return true;
+  }
+
+  // Same steps as EpdFont::getTextBounds, horizontal only
+  const bool isCombining = utf8IsCombiningMark(cp);
+  if (!isCombining) {
+    cp = font->applyLigatures(cp, text);
+  }
+
+  const bool ascii = cp >= ASCII_FIRST && cp <= ASCII_LAST;
+  const EpdGlyph* glyph = ascii ? asciiGlyphs[cp - ASCII_FIRST] : font->getGlyph(cp);
+  if (!glyph) {
+    hasPrev = false;
+    return true;
+  }
+
+  if (isCombining) {
+    const int glyphBaseX = lastBaseX + lastBaseAdvance / 2;
+    minX = std::min(minX, glyphBaseX + glyph->left);
+    maxX = std::max(maxX, glyphBaseX + glyph->left + glyph->width);
+    return true;
+  }
+
+  if (hasPrev) {
+    cursorX += font->getClassKerning(prevLeftClass,
+                                     ascii ? asciiRightClasses[cp - ASCII_FIRST] : font->getKernRightClass(cp));
+  }
+
+  minX = std::min(minX, cursorX + glyph->left);
+  maxX = std::max(maxX, cursorX + glyph->left + glyph->width);
+
+  lastBaseX = cursorX;
+  lastBaseAdvance = glyph->advanceX;
+  cursorX += glyph->advanceX;
+  prevLeftClass = ascii ? asciiLeftClasses[cp - ASCII_FIRST] : font->getKernLeftClass(cp);
+  hasPrev = true;
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+#include "EpdFont.h"
+
+/// Measures text a character at a time, so that wrapping a line needs one pass over it instead of re-measuring
+/// every candidate prefix. getWidth() after each character is the width EpdFont::getTextDimensions would give for
+/// everything added so far. Glyphs and kerning classes of printable ASCII are looked up once per font.
+class EpdLineMeasurer {
+ public:
+  EpdLineMeasurer() = default;
+
+  void setFont(const EpdFont* font);
+
+  /// Start a new line
+  void reset();
+
+  /// Add the next character of text (a codepoint plus anything a ligature merges into it) and advance text past it.
+  /// Returns false at the end of the string.
+  bool addNext(const char*& text);
+
+  int getWidth() const { return maxX - minX; }
+
+ private:
+  static constexpr uint32_t ASCII_FIRST = 0x20;
+  static constexpr uint32_t ASCII_LAST = 0x7E;
+  static constexpr int ASCII_COUNT = ASCII_LAST - ASCII_FIRST + 1;
+
+  const EpdFont* font = nullptr;
+  const EpdGlyph* asciiGlyphs[ASCII_COUNT] = {};
+  uint8_t asciiLeftClasses[ASCII_COUNT] = {};
+  uint8_t asciiRightClasses[ASCII_COUNT] = {};
+
+  int cursorX = 0;
+  int minX = 0;
+  int maxX = 0;
+  int lastBaseX = 0;
+  int lastBaseAdvance = 0;
+  uint8_t prevLeftClass = 0;
+  bool hasPrev = false;
+};
@@ -1,39 +1,78 @@
 #include "FontDecompressor.h"
 
 #include <Logging.h>
+#include <Metrics.h>
 
 #include <cstdlib>
 
-bool FontDecompressor::init() {
+bool FontDecompressor::init(const uint32_t cacheBudget) {
   clearCache();
+  this->cacheBudget = cacheBudget;
   return true;
 }
 
+void FontDecompressor::freeEntry(CacheEntry* entry) {
+  if (entry->data) {
+    free(entry->data);
+    entry->data = nullptr;
+  }
+  if (entry->valid) {
+    cachedBytes -= entry->dataSize;
+  }
+  entry->dataSize = 0;
+  entry->valid = false;
+}
+
 void FontDecompressor::freeAllEntries() {
   for (auto& entry : cache) {
-    if (entry.data) {
-      free(entry.data);
-      entry.data = nullptr;
-    }
-    entry.valid = false;
+    freeEntry(&entry);
   }
+  cachedBytes = 0;
 }
 
-void FontDecompressor::deinit() { freeAllEntries(); }
+void FontDecompressor::deinit() {
+  freeAllEntries();
+  glyphCache.release();
+}
 
 void FontDecompressor::clearCache() {
   freeAllEntries();
+  glyphCache.release();
   accessCounter = 0;
+  windowLookups = 0;
+  windowInflations = 0;
+}
+
+void FontDecompressor::setCacheBudget(const uint32_t bytes) {
+  cacheBudget = bytes;
+  if (glyphCache.isActive() && glyphCache.getArenaBytes() >= bytes) {
+    glyphCache.release();
+  }
+  while (cachedBytes > groupBudget()) {
+    freeEntry(findLruEntry());
+  }
 }
 
 uint16_t FontDecompressor::getGroupIndex(const EpdFontData* fontData, uint16_t glyphIndex) {
-  for (uint16_t i = 0; i < fontData->groupCount; i++) {
-    uint16_t first = fontData->groups[i].firstGlyphIndex;
-    if (glyphIndex >= first && glyphIndex < first + fontData->groups[i].glyphCount) {
-      return i;
+  // Groups are generated in glyph order, so find the last group starting at or before the glyph
+  uint16_t lo = 0;
+  uint16_t hi = fontData->groupCount;
+  while (lo < hi) {
+    const uint16_t mid = lo + (hi - lo) / 2;
+    if (fontData->groups[mid].firstGlyphIndex <= glyphIndex) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
   }
-  return fontData->groupCount;  // sentinel = not found
+  if (lo == 0) {
+    return fontData->groupCount;  // sentinel = not found
+  }
+  const EpdFontGroup& group = fontData->groups[lo - 1];
+  if (glyphIndex >= group.firstGlyphIndex + group.glyphCount) {
+    return fontData->groupCount;
+  }
+  return lo - 1;
 }
 
 FontDecompressor::CacheEntry* FontDecompressor::findInCache(const EpdFontData* fontData, uint16_t groupIndex) {
@@ -45,42 +84,65 @@ FontDecompressor::CacheEntry* FontDecompressor::findInCache(const EpdFontData* f
   return nullptr;
 }
 
-FontDecompressor::CacheEntry* FontDecompressor::findEvictionCandidate() {
-  // Find an invalid slot first
+FontDecompressor::CacheEntry* FontDecompressor::findFreeEntry() {
   for (auto& entry : cache) {
     if (!entry.valid) {
       return &entry;
     }
   }
-  // Otherwise evict LRU
-  CacheEntry* lru = &cache[0];
+  return nullptr;
+}
+
+FontDecompressor::CacheEntry* FontDecompressor::findLruEntry() {
+  CacheEntry* lru = nullptr;
   for (auto& entry : cache) {
-    if (entry.lastUsed < lru->lastUsed) {
+    if (entry.valid && (!lru || entry.lastUsed < lru->lastUsed)) {
       lru = &entry;
     }
   }
   return lru;
 }
 
-bool FontDecompressor::decompressGroup(const EpdFontData* fontData, uint16_t groupIndex, CacheEntry* entry) {
-  const EpdFontGroup& group = fontData->groups[groupIndex];
-
-  // Free old buffer if reusing a slot
-  if (entry->data) {
-    free(entry->data);
-    entry->data = nullptr;
+FontDecompressor::CacheEntry* FontDecompressor::makeRoom(const uint32_t size) {
+  // Evict LRU groups until the new one fits the budget and a slot is free. A group larger than the whole budget
+  // still gets decoded (into an otherwise empty cache) so rendering never fails because of the budget.
+  while (cachedBytes > 0 && cachedBytes + size > groupBudget()) {
+    freeEntry(findLruEntry());
   }
-  entry->valid = false;
+  CacheEntry* entry = findFreeEntry();
+  if (!entry) {
+    entry = findLruEntry();
+    freeEntry(entry);
+  }
+  return entry;
+}
+
+bool FontDecompressor::decompressGroup(const EpdFontData* fontData, uint16_t groupIndex, CacheEntry* entry,
+                                       const bool mayEvict) {
+  const EpdFontGroup& group = fontData->groups[groupIndex];
 
-  // Allocate output buffer
+  // Allocate output buffer, giving back cached groups if the heap is tight
   auto* outBuf = static_cast<uint8_t*>(malloc(group.uncompressedSize));
+  while (!outBuf && mayEvict && cachedBytes > 0) {
+    freeEntry(findLruEntry());
+    outBuf = static_cast<uint8_t*>(malloc(group.uncompressedSize));
+  }
   if (!outBuf) {
     LOG_ERR("FDC", "Failed to allocate %u bytes for group %u", group.uncompressedSize, groupIndex);
     return false;
   }
 
+  const uint8_t* compressed = fontData->source
+                                  ? fontData->source->readBitmap(group.compressedOffset, group.compressedSize)
+                                  : &fontData->bitmap[group.compressedOffset];
+  if (!compressed) {
+    LOG_ERR("FDC", "Failed to read group %u", groupIndex);
+    free(outBuf);
+    return false;
+  }
+
   inflateReader.init(false);
-  inflateReader.setSource(&fontData->bitmap[group.compressedOffset], group.compressedSize);
+  inflateReader.setSource(compressed, group.compressedSize);
   if (!inflateReader.read(outBuf, group.uncompressedSize)) {
     LOG_ERR("FDC", "Decompression failed for group %u", groupIndex);
     free(outBuf);
@@ -92,9 +154,19 @@ bool FontDecompressor::decompressGroup(const EpdFontData* fontData, uint16_t gro
   entry->data = outBuf;
   entry->dataSize = group.uncompressedSize;
   entry->valid = true;
+  cachedBytes += entry->dataSize;
   return true;
 }
 
+const uint8_t* FontDecompressor::glyphData(const CacheEntry* entry, const EpdGlyph* glyph) const {
+  if (glyph->dataOffset + glyph->dataLength > entry->dataSize) {
+    LOG_ERR("FDC", "dataOffset %u + dataLength %u out of bounds for group %u (size %u)", glyph->dataOffset,
+            glyph->dataLength, entry->groupIndex, entry->dataSize);
+    return nullptr;
+  }
+  return &entry->data[glyph->dataOffset];
+}
+
 const uint8_t* FontDecompressor::getBitmap(const EpdFontData* fontData, const EpdGlyph* glyph, uint16_t glyphIndex) {
   if (!fontData->groups || fontData->groupCount == 0) {
     return &fontData->bitmap[glyph->dataOffset];
@@ -110,25 +182,69 @@ const uint8_t* FontDecompressor::getBitmap(const EpdFontData* fontData, const Ep
   CacheEntry* entry = findInCache(fontData, groupIndex);
   if (entry) {
     entry->lastUsed = ++accessCounter;
-    if (glyph->dataOffset + glyph->dataLength > entry->dataSize) {
-      LOG_ERR("FDC", "dataOffset %u + dataLength %u out of bounds for group %u (size %u)", glyph->dataOffset,
-              glyph->dataLength, groupIndex, entry->dataSize);
-      return nullptr;
-    }
-    return &entry->data[glyph->dataOffset];
+    countLookup(false);
+    return glyphData(entry, glyph);
+  }
+
+  if (const uint8_t* bitmap = glyphCache.find(fontData, glyphIndex)) {
+    countLookup(false);
+    return bitmap;
   }
 
   // Cache miss - decompress
-  entry = findEvictionCandidate();
-  if (!decompressGroup(fontData, groupIndex, entry)) {
+  entry = makeRoom(fontData->groups[groupIndex].uncompressedSize);
+  if (!decompressGroup(fontData, groupIndex, entry, true)) {
     return nullptr;
   }
 
   entry->lastUsed = ++accessCounter;
-  if (glyph->dataOffset + glyph->dataLength > entry->dataSize) {
-    LOG_ERR("FDC", "dataOffset %u + dataLength %u out of bounds for group %u (size %u)", glyph->dataOffset,
-            glyph->dataLength, groupIndex, entry->dataSize);
-    return nullptr;
+  countLookup(true);
+  const uint8_t* bitmap = glyphData(entry, glyph);
+  if (bitmap && glyphCache.isActive()) {
+    glyphCache.insert(fontData, glyphIndex, bitmap, glyph->dataLength);
+  }
+  return bitmap;
+}
+
+void FontDecompressor::countLookup(const bool inflated) {
+  metrics::add(inflated ? metrics::FONT_GROUP_MISSES : metrics::FONT_GROUP_HITS);
+  if (glyphCache.isActive()) {
+    return;
+  }
+  windowInflations += inflated;
+  if (++windowLookups < THRASH_WINDOW) {
+    return;
+  }
+  // The page draws from more groups than fit, and every render pass would inflate them all again: keep single glyphs
+  if (windowInflations > THRASH_INFLATIONS) {
+    const uint32_t arenaBytes = cacheBudget / 100 * GLYPH_CACHE_SHARE_PERCENT;
+    while (cachedBytes > 0 && cachedBytes + arenaBytes > cacheBudget) {
+      freeEntry(findLruEntry());
+    }
+    if (glyphCache.activate(arenaBytes)) {
+      LOG_DBG("FDC", "%u of %u glyphs inflated a group, caching single glyphs", windowInflations, windowLookups);
+    }
+  }
+  windowLookups = 0;
+  windowInflations = 0;
+}
+
+void FontDecompressor::prefetchGroup(const EpdFontData* fontData, const uint16_t groupIndex) {
+  if (!fontData->groups || groupIndex >= fontData->groupCount) {
+    return;
+  }
+
+  CacheEntry* entry = findInCache(fontData, groupIndex);
+  if (entry) {
+    entry->lastUsed = ++accessCounter;
+    return;
+  }
+
+  if (cachedBytes + fontData->groups[groupIndex].uncompressedSize > groupBudget()) {
+    return;
+  }
+  entry = findFreeEntry();
+  if (entry && decompressGroup(fontData, groupIndex, entry, false)) {
+    entry->lastUsed = ++accessCounter;
   }
-  return &entry->data[glyph->dataOffset];
 }
@@ -3,21 +3,42 @@
 #include <InflateReader.h>
 
 #include "EpdFontData.h"
+#include "GlyphBitmapCache.h"
 
 class FontDecompressor {
  public:
-  bool init();
+  static constexpr uint32_t DEFAULT_CACHE_BUDGET = 48 * 1024;
+
+  bool init(uint32_t cacheBudget = DEFAULT_CACHE_BUDGET);
   void deinit();
 
   // Returns pointer to decompressed bitmap data for the given glyph.
   // Valid until LRU eviction (safe for the duration of one glyph render).
   const uint8_t* getBitmap(const EpdFontData* fontData, const EpdGlyph* glyph, uint16_t glyphIndex);
 
-  // Evict all cached decompressed groups (call between pages for within-page-only caching).
+  // Decompress a glyph group ahead of rendering. Only fills free budget, never evicts, so a page whose glyphs
+  // don't all fit can't push out groups that are still needed.
+  void prefetchGroup(const EpdFontData* fontData, uint16_t groupIndex);
+
+  // Index of the group holding the glyph, or fontData->groupCount if there is none
+  static uint16_t getGroupIndex(const EpdFontData* fontData, uint16_t glyphIndex);
+
+  // Evict all cached decompressed groups and glyphs (call when the working set changes, e.g. a new section or
+  // leaving the reader, to give the memory back).
   void clearCache();
 
+  // Upper bound for the decompressed groups kept in memory. Shrinking evicts LRU groups right away.
+  void setCacheBudget(uint32_t bytes);
+  uint32_t getCachedBytes() const { return cachedBytes; }
+
  private:
-  static constexpr uint8_t CACHE_SLOTS = 4;
+  static constexpr uint8_t MAX_CACHE_ENTRIES = 16;
+  // Part of the budget given to single glyph bitmaps once more than THRASH_INFLATIONS of THRASH_WINDOW lookups had
+  // to inflate a group (CJK text, where a page touches a group for almost every glyph). Groups then mostly serve one
+  // glyph before they are evicted, so the glyphs are what is worth keeping.
+  static constexpr uint32_t GLYPH_CACHE_SHARE_PERCENT = 75;
+  static constexpr uint16_t THRASH_WINDOW = 256;
+  static constexpr uint16_t THRASH_INFLATIONS = 32;
 
   struct CacheEntry {
     const EpdFontData* font = nullptr;
@@ -29,12 +50,22 @@ class FontDecompressor {
   };
 
   InflateReader inflateReader;
-  CacheEntry cache[CACHE_SLOTS] = {};
+  CacheEntry cache[MAX_CACHE_ENTRIES] = {};
+  GlyphBitmapCache glyphCache;
   uint32_t accessCounter = 0;
+  uint32_t cacheBudget = DEFAULT_CACHE_BUDGET;
+  uint32_t cachedBytes = 0;
+  uint16_t windowLookups = 0;
+  uint16_t windowInflations = 0;
 
+  uint32_t groupBudget() const { return cacheBudget - glyphCache.getArenaBytes(); }
+  void countLookup(bool inflated);
   void freeAllEntries();
-  uint16_t getGroupIndex(const EpdFontData* fontData, uint16_t glyphIndex);
+  void freeEntry(CacheEntry* entry);
   CacheEntry* findInCache(const EpdFontData* fontData, uint16_t groupIndex);
-  CacheEntry* findEvictionCandidate();
-  bool decompressGroup(const EpdFontData* fontData, uint16_t groupIndex, CacheEntry* entry);
+  CacheEntry* findFreeEntry();
+  CacheEntry* findLruEntry();
+  CacheEntry* makeRoom(uint32_t size);
+  bool decompressGroup(const EpdFontData* fontData, uint16_t groupIndex, CacheEntry* entry, bool mayEvict);
+  const uint8_t* glyphData(const CacheEntry* entry, const EpdGlyph* glyph) const;
 };
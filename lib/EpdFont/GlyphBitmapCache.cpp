@@ -0,0 +1,78 @@
+#include "GlyphBitmapCache.h"
+
+#include <cstdlib>
+#include <cstring>
+
+bool GlyphBitmapCache::activate(const uint32_t bytes) {
+  if (arena) {
+    return true;
+  }
+  slots = static_cast<Slot*>(malloc(SLOT_COUNT * sizeof(Slot)));
+  arena = static_cast<uint8_t*>(malloc(bytes));
+  if (!slots || !arena) {
+    release();
+    return false;
+  }
+  arenaBytes = bytes;
+  reset();
+  return true;
+}
+
+void GlyphBitmapCache::release() {
+  free(slots);
+  free(arena);
+  slots = nullptr;
+  arena = nullptr;
+  arenaBytes = 0;
+  arenaUsed = 0;
+  entryCount = 0;
+}
+
+void GlyphBitmapCache::reset() {
+  memset(slots, 0, SLOT_COUNT * sizeof(Slot));
+  arenaUsed = 0;
+  entryCount = 0;
+}
+
+size_t GlyphBitmapCache::homeSlot(const EpdFontData* font, const uint16_t glyphIndex) {
+  const auto mixed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(font) >> 2) * 0x9E3779B1u ^ glyphIndex;
+  return (mixed * 0x85EBCA6Bu >> 16) & (SLOT_COUNT - 1);
+}
+
+const uint8_t* GlyphBitmapCache::find(const EpdFontData* font, const uint16_t glyphIndex) const {
+  if (!arena) {
+    return nullptr;
+  }
+  for (size_t index = homeSlot(font, glyphIndex);; index = (index + 1) & (SLOT_COUNT - 1)) {
+    const Slot& slot = slots[index];
+    if (!slot.font) {
+      return nullptr;
+    }
+    if (slot.font == font && slot.glyphIndex == glyphIndex) {
+      return arena + slot.offset;
+    }
+  }
+}
+
+const uint8_t* GlyphBitmapCache::insert(const EpdFontData* font, const uint16_t glyphIndex, const uint8_t* bitmap,
+                                        const uint16_t length) {
+  if (!arena || length > arenaBytes) {
+    return nullptr;
+  }
+  if (arenaUsed + length > arenaBytes || entryCount == MAX_ENTRIES) {
+    reset();
+  }
+
+  size_t index = homeSlot(font, glyphIndex);
+  while (slots[index].font && !(slots[index].font == font && slots[index].glyphIndex == glyphIndex)) {
+    index = (index + 1) & (SLOT_COUNT - 1);
+  }
+  Slot& slot = slots[index];
+  if (!slot.font) {
+    entryCount++;
+  }
+  slot = {font, arenaUsed, glyphIndex, length};
+  memcpy(arena + arenaUsed, bitmap, length);
+  arenaUsed += length;
+  return arena + slot.offset;
+}
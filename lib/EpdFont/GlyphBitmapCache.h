@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "EpdFontData.h"
+
+// Decompressed bitmaps of single glyphs, for pages whose glyphs come from more groups than FontDecompressor can keep
+// inflated at once (CJK text touches a different group for almost every character). Without it every render pass
+// of such a page (BW, then the grayscale planes) inflates a whole group per glyph again.
+//
+// Entries are bump allocated from one arena and dropped all together when the arena or the index fills up, so there
+// is no fragmentation and no per-entry bookkeeping beyond the index slot.
+class GlyphBitmapCache {
+ public:
+  ~GlyphBitmapCache() { release(); }
+
+  // Allocates the index and an arena of arenaBytes. Returns false (and stays inactive) if the heap can't spare it.
+  bool activate(uint32_t arenaBytes);
+  void release();
+  bool isActive() const { return arena != nullptr; }
+  uint32_t getArenaBytes() const { return arenaBytes; }
+
+  const uint8_t* find(const EpdFontData* font, uint16_t glyphIndex) const;
+  // Copies the bitmap in. The returned pointer, like any from find(), is valid until the next insert.
+  const uint8_t* insert(const EpdFontData* font, uint16_t glyphIndex, const uint8_t* bitmap, uint16_t length);
+
+ private:
+  static constexpr size_t SLOT_COUNT = 512;
+  static constexpr size_t MAX_ENTRIES = SLOT_COUNT * 3 / 4;
+
+  struct Slot {
+    const EpdFontData* font;
+    uint32_t offset;
+    uint16_t glyphIndex;
+    uint16_t length;
+  };
+
+  Slot* slots = nullptr;
+  uint8_t* arena = nullptr;
+  uint32_t arenaBytes = 0;
+  uint32_t arenaUsed = 0;
+  size_t entryCount = 0;
+
+  static size_t homeSlot(const EpdFontData* font, uint16_t glyphIndex);
+  void reset();
+};
@@ -0,0 +1,241 @@
+#include "SdFont.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr char MAGIC[4] = {'E', 'P', 'D', 'F'};
+constexpr uint16_t VERSION = 1;
+constexpr uint8_t FLAG_2BIT = 0x01;
+constexpr size_t FILE_GLYPH_SIZE = 13;
+constexpr size_t GLYPH_READ_BATCH = 32;
+
+struct FileHeader {
+  char magic[4];
+  uint16_t version;
+  uint8_t flags;
+  uint8_t advanceY;
+  int16_t ascender;
+  int16_t descender;
+  uint32_t contentHash;
+  uint32_t intervalCount;
+  uint32_t glyphCount;
+  uint16_t groupCount;
+  uint16_t kernLeftEntryCount;
+  uint16_t kernRightEntryCount;
+  uint8_t kernLeftClassCount;
+  uint8_t kernRightClassCount;
+  uint32_t ligaturePairCount;
+  uint32_t bitmapSize;
+} __attribute__((packed));
+static_assert(sizeof(FileHeader) == 40, "SD font header layout changed");
+static_assert(sizeof(EpdUnicodeInterval) == 12 && sizeof(EpdFontGroup) == 16 && sizeof(EpdKernClassEntry) == 3 &&
+                  sizeof(EpdLigaturePair) == 8,
+              "SD font tables are read straight into these structs");
+
+size_t align4(const size_t size) { return (size + 3) & ~static_cast<size_t>(3); }
+
+bool readExactly(HalFile& file, void* out, const size_t size) {
+  return size == 0 || file.read(out, size) == static_cast<int>(size);
+}
+
+// One bitmap window for all SD fonts: FontDecompressor inflates a group straight after reading it, so a pointer
+// into the window never has to survive a read for another font
+uint8_t* sharedWindow = nullptr;
+uint32_t sharedWindowCapacity = 0;
+const SdFont* windowOwner = nullptr;
+uint32_t windowOffset = 0;
+uint32_t windowLength = 0;
+int loadedFonts = 0;
+}  // namespace
+
+SdFont::~SdFont() { unload(); }
+
+void SdFont::unload() {
+  if (!tables) {
+    return;
+  }
+  free(tables);
+  tables = nullptr;
+  data = {};
+  if (windowOwner == this) {
+    windowOwner = nullptr;
+  }
+  if (--loadedFonts == 0) {
+    free(sharedWindow);
+    sharedWindow = nullptr;
+    sharedWindowCapacity = 0;
+  }
+}
+
+bool SdFont::load(const std::string& filePath) {
+  unload();
+  path = filePath;
+
+  HalFile file;
+  if (!Storage.openFileForRead("SDF", path, file)) {
+    return false;
+  }
+  FileHeader header;
+  if (!readExactly(file, &header, sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    LOG_ERR("SDF", "%s is not a font file", path.c_str());
+    return false;
+  }
+  if (header.version != VERSION) {
+    LOG_ERR("SDF", "%s has version %u, expected %u", path.c_str(), header.version, VERSION);
+    return false;
+  }
+  // Glyph indices are 16 bits in the renderer, and bitmaps must come in compressed groups to be streamed
+  if (header.glyphCount == 0 || header.glyphCount > UINT16_MAX || header.groupCount == 0) {
+    LOG_ERR("SDF", "%s: %u glyphs in %u groups not supported", path.c_str(), header.glyphCount, header.groupCount);
+    return false;
+  }
+
+  const size_t kernMatrixSize = static_cast<size_t>(header.kernLeftClassCount) * header.kernRightClassCount;
+  const size_t intervalsSize = align4(header.intervalCount * sizeof(EpdUnicodeInterval));
+  const size_t glyphsSize = align4(header.glyphCount * sizeof(EpdGlyph));
+  const size_t groupsSize = align4(header.groupCount * sizeof(EpdFontGroup));
+  const size_t kernLeftSize = align4(header.kernLeftEntryCount * sizeof(EpdKernClassEntry));
+  const size_t kernRightSize = align4(header.kernRightEntryCount * sizeof(EpdKernClassEntry));
+  const size_t kernMatrixAligned = align4(kernMatrixSize);
+  const size_t ligaturesSize = header.ligaturePairCount * sizeof(EpdLigaturePair);
+  const size_t tablesSize =
+      intervalsSize + glyphsSize + groupsSize + kernLeftSize + kernRightSize + kernMatrixAligned + ligaturesSize;
+
+  const size_t fileTablesSize = header.intervalCount * sizeof(EpdUnicodeInterval) +
+                                header.glyphCount * FILE_GLYPH_SIZE + header.groupCount * sizeof(EpdFontGroup) +
+                                (header.kernLeftEntryCount + header.kernRightEntryCount) * sizeof(EpdKernClassEntry) +
+                                kernMatrixSize + header.ligaturePairCount * sizeof(EpdLigaturePair);
+  if (sizeof(header) + fileTablesSize + header.bitmapSize != file.size()) {
+    LOG_ERR("SDF", "%s is truncated or corrupt", path.c_str());
+    return false;
+  }
+  if (tablesSize > MAX_TABLE_BYTES) {
+    LOG_ERR("SDF", "%s needs %u bytes of tables, limit is %u", path.c_str(), static_cast<unsigned>(tablesSize),
+            MAX_TABLE_BYTES);
+    return false;
+  }
+
+  auto* memory = static_cast<uint8_t*>(malloc(tablesSize));
+  if (!memory) {
+    LOG_ERR("SDF", "Failed to allocate %u bytes for %s", static_cast<unsigned>(tablesSize), path.c_str());
+    return false;
+  }
+  uint8_t* cursor = memory;
+  const auto take = [&cursor](const size_t size) {
+    uint8_t* section = cursor;
+    cursor += size;
+    return section;
+  };
+  auto* intervals = reinterpret_cast<EpdUnicodeInterval*>(take(intervalsSize));
+  auto* glyphs = reinterpret_cast<EpdGlyph*>(take(glyphsSize));
+  auto* groups = reinterpret_cast<EpdFontGroup*>(take(groupsSize));
+  auto* kernLeft = reinterpret_cast<EpdKernClassEntry*>(take(kernLeftSize));
+  auto* kernRight = reinterpret_cast<EpdKernClassEntry*>(take(kernRightSize));
+  auto* kernMatrix = reinterpret_cast<int8_t*>(take(kernMatrixAligned));
+  auto* ligatures = reinterpret_cast<EpdLigaturePair*>(take(ligaturesSize));
+
+  bool ok = readExactly(file, intervals, header.intervalCount * sizeof(EpdUnicodeInterval));
+  uint8_t packed[GLYPH_READ_BATCH * FILE_GLYPH_SIZE];
+  for (uint32_t first = 0; ok && first < header.glyphCount; first += GLYPH_READ_BATCH) {
+    const uint32_t count = std::min<uint32_t>(GLYPH_READ_BATCH, header.glyphCount - first);
+    ok = readExactly(file, packed, count * FILE_GLYPH_SIZE);
+    for (uint32_t i = 0; ok && i < count; i++) {
+      const uint8_t* p = packed + i * FILE_GLYPH_SIZE;
+      EpdGlyph& glyph = glyphs[first + i];
+      glyph.width = p[0];
+      glyph.height = p[1];
+      glyph.advanceX = p[2];
+      memcpy(&glyph.left, p + 3, sizeof(glyph.left));
+      memcpy(&glyph.top, p + 5, sizeof(glyph.top));
+      memcpy(&glyph.dataLength, p + 7, sizeof(glyph.dataLength));
+      memcpy(&glyph.dataOffset, p + 9, sizeof(glyph.dataOffset));
+    }
+  }
+  ok = ok && readExactly(file, groups, header.groupCount * sizeof(EpdFontGroup)) &&
+       readExactly(file, kernLeft, header.kernLeftEntryCount * sizeof(EpdKernClassEntry)) &&
+       readExactly(file, kernRight, header.kernRightEntryCount * sizeof(EpdKernClassEntry)) &&
+       readExactly(file, kernMatrix, kernMatrixSize) &&
+       readExactly(file, ligatures, header.ligaturePairCount * sizeof(EpdLigaturePair));
+  for (uint16_t i = 0; ok && i < header.groupCount; i++) {
+    ok = groups[i].compressedOffset + groups[i].compressedSize <= header.bitmapSize &&
+         groups[i].firstGlyphIndex + groups[i].glyphCount <= header.glyphCount;
+  }
+  if (!ok) {
+    LOG_ERR("SDF", "Failed to read the tables of %s", path.c_str());
+    free(memory);
+    return false;
+  }
+
+  tables = memory;
+  loadedFonts++;
+  contentHash = header.contentHash;
+  bitmapStart = sizeof(header) + fileTablesSize;
+  bitmapSize = header.bitmapSize;
+  const bool hasKerning = kernMatrixSize > 0;
+  data = {
+      nullptr,
+      glyphs,
+      intervals,
+      header.intervalCount,
+      header.advanceY,
+      header.ascender,
+      header.descender,
+      (header.flags & FLAG_2BIT) != 0,
+      groups,
+      header.groupCount,
+      hasKerning ? kernLeft : nullptr,
+      hasKerning ? kernRight : nullptr,
+      hasKerning ? kernMatrix : nullptr,
+      header.kernLeftEntryCount,
+      header.kernRightEntryCount,
+      header.kernLeftClassCount,
+      header.kernRightClassCount,
+      header.ligaturePairCount > 0 ? ligatures : nullptr,
+      header.ligaturePairCount,
+      this,
+  };
+  LOG_INF("SDF", "Loaded %s: %u glyphs, %u groups, %u bytes of tables", path.c_str(), header.glyphCount,
+          header.groupCount, static_cast<unsigned>(tablesSize));
+  return true;
+}
+
+const uint8_t* SdFont::readBitmap(const uint32_t offset, const uint32_t size) {
+  if (!tables || offset + size > bitmapSize) {
+    return nullptr;
+  }
+  if (windowOwner == this && offset >= windowOffset && offset + size <= windowOffset + windowLength) {
+    return sharedWindow + (offset - windowOffset);
+  }
+
+  // Refill from this group on: the groups after it are the following Unicode blocks, likely needed next
+  if (sharedWindowCapacity < size) {
+    const uint32_t capacity = std::max(READ_AHEAD_BYTES, size);
+    free(sharedWindow);
+    sharedWindow = static_cast<uint8_t*>(malloc(capacity));
+    sharedWindowCapacity = sharedWindow ? capacity : 0;
+    windowOwner = nullptr;
+    if (!sharedWindow) {
+      LOG_ERR("SDF", "Failed to allocate a %u byte read window", capacity);
+      return nullptr;
+    }
+  }
+  windowOwner = nullptr;
+  HalFile file;
+  if (!Storage.openFileForRead("SDF", path, file) || !file.seekSet(bitmapStart + offset)) {
+    return nullptr;
+  }
+  const uint32_t length = std::min(sharedWindowCapacity, bitmapSize - offset);
+  if (!readExactly(file, sharedWindow, length)) {
+    LOG_ERR("SDF", "Failed to read %u bytes of %s", length, path.c_str());
+    return nullptr;
+  }
+  windowOwner = this;
+  windowOffset = offset;
+  windowLength = length;
+  return sharedWindow;
+}
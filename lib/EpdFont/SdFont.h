@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include "EpdFontData.h"
+
+// A font in the binary container written by `fontconvert.py --binary`, read from the SD card. The tables EpdFont
+// searches (intervals, glyphs, kerning, ligatures) are loaded into RAM; the compressed glyph groups stay on the card
+// and FontDecompressor pulls them through readBitmap(), which reads ahead so that neighbouring groups (the next
+// Unicode block) usually come from the same card read.
+//
+// Container layout, little endian: a 40-byte header (see SdFont.cpp), then intervals (12 bytes each), glyphs
+// (13 bytes each: width, height, advanceX, left, top, dataLength, dataOffset), groups (16 bytes each, as
+// EpdFontGroup), left and right kerning class entries (3 bytes each), the kerning matrix, ligature pairs (8 bytes
+// each) and last the compressed bitmap data.
+class SdFont final : public EpdFontSource {
+ public:
+  static constexpr char EXTENSION[] = ".epdfont";
+  // Tables larger than this are refused rather than squeezing the heap (a full CJK font needs paged glyph tables)
+  static constexpr uint32_t MAX_TABLE_BYTES = 64 * 1024;
+  static constexpr uint32_t READ_AHEAD_BYTES = 8 * 1024;
+
+  SdFont() = default;
+  ~SdFont() override;
+  SdFont(const SdFont&) = delete;
+  SdFont& operator=(const SdFont&) = delete;
+
+  bool load(const std::string& filePath);
+  const EpdFontData* getData() const { return &data; }
+  // Hash of the file contents written by the converter, for building a font id that changes with the font
+  uint32_t getContentHash() const { return contentHash; }
+
+  const uint8_t* readBitmap(uint32_t offset, uint32_t size) override;
+
+ private:
+  std::string path;
+  EpdFontData data = {};
+  uint32_t contentHash = 0;
+  uint8_t* tables = nullptr;
+  uint32_t bitmapStart = 0;  // File offset of the compressed bitmap data
+  uint32_t bitmapSize = 0;
+
+  void unload();
+};
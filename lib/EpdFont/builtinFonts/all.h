@@ -1,5 +1,14 @@
 #pragma once
 
+// Reader fonts: the full set, or the per-market subset a build selects with -DFONT_SUBSET_<MARKET>. Subsets are
+// generated by lib/EpdFont/scripts/convert-builtin-fonts.sh <market>.
+#if defined(FONT_SUBSET_LATIN)
+#include <builtinFonts/subsets/latin/all.h>
+#elif defined(FONT_SUBSET_CYRILLIC)
+#include <builtinFonts/subsets/cyrillic/all.h>
+#elif defined(FONT_SUBSET_VIETNAMESE)
+#include <builtinFonts/subsets/vietnamese/all.h>
+#else
 #include <builtinFonts/bookerly_12_bold.h>
 #include <builtinFonts/bookerly_12_bolditalic.h>
 #include <builtinFonts/bookerly_12_italic.h>
@@ -16,7 +25,6 @@
 #include <builtinFonts/bookerly_18_bolditalic.h>
 #include <builtinFonts/bookerly_18_italic.h>
 #include <builtinFonts/bookerly_18_regular.h>
-#include <builtinFonts/notosans_8_regular.h>
 #include <builtinFonts/notosans_12_bold.h>
 #include <builtinFonts/notosans_12_bolditalic.h>
 #include <builtinFonts/notosans_12_italic.h>
@@ -49,6 +57,10 @@
 #include <builtinFonts/opendyslexic_8_bolditalic.h>
 #include <builtinFonts/opendyslexic_8_italic.h>
 #include <builtinFonts/opendyslexic_8_regular.h>
+#endif
+
+// UI fonts, complete in every build so the language menu can show every language name
+#include <builtinFonts/notosans_8_regular.h>
 #include <builtinFonts/ubuntu_10_bold.h>
 #include <builtinFonts/ubuntu_10_regular.h>
 #include <builtinFonts/ubuntu_12_bold.h>
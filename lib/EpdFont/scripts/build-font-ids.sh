@@ -4,134 +4,61 @@ set -e
 
 cd "$(dirname "$0")/../builtinFonts"
 
+# Usage: build-font-ids.sh [market] > ../../../src/fontIds.h
+# Without an argument, prints src/fontIds.h. With a market (see convert-builtin-fonts.sh), prints the reader font IDs
+# of that subset, which convert-builtin-fonts.sh writes to subsets/<market>/fontIds.h.
+SUBSET=$1
+
+# font_id NAME FILE... prints the define for a font family, a hash over the contents of its headers
+font_id() {
+  local name=$1
+  shift
+  echo "#define ${name}_FONT_ID ($(
+  ruby -rdigest -e 'puts ARGV.map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)' "$@"
+  ))"
+}
+
+reader_font_ids() {
+  local dir=$1
+  for size in 12 14 16 18; do
+    font_id "BOOKERLY_${size}" "$dir/bookerly_${size}_regular.h" "$dir/bookerly_${size}_bold.h" \
+      "$dir/bookerly_${size}_bolditalic.h" "$dir/bookerly_${size}_italic.h"
+  done
+  for size in 12 14 16 18; do
+    font_id "NOTOSANS_${size}" "$dir/notosans_${size}_regular.h" "$dir/notosans_${size}_bold.h" \
+      "$dir/notosans_${size}_bolditalic.h" "$dir/notosans_${size}_italic.h"
+  done
+  for size in 8 10 12 14; do
+    font_id "OPENDYSLEXIC_${size}" "$dir/opendyslexic_${size}_regular.h" "$dir/opendyslexic_${size}_bold.h" \
+      "$dir/opendyslexic_${size}_bolditalic.h" "$dir/opendyslexic_${size}_italic.h"
+  done
+}
+
+if [ -n "$SUBSET" ]; then
+  echo "// The contents of this file are generated by ./lib/EpdFont/scripts/build-font-ids.sh $SUBSET"
+  echo "#pragma once"
+  echo ""
+  reader_font_ids "./subsets/$SUBSET"
+  exit 0
+fi
+
 echo "// The contents of this file are generated by ./lib/EpdFont/scripts/build-font-ids.sh"
 echo "#pragma once"
 echo ""
 
-echo "#define BOOKERLY_12_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./bookerly_12_regular.h",
-  "./bookerly_12_bold.h",
-  "./bookerly_12_bolditalic.h",
-  "./bookerly_12_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define BOOKERLY_14_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./bookerly_14_regular.h",
-  "./bookerly_14_bold.h",
-  "./bookerly_14_bolditalic.h",
-  "./bookerly_14_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define BOOKERLY_16_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./bookerly_16_regular.h",
-  "./bookerly_16_bold.h",
-  "./bookerly_16_bolditalic.h",
-  "./bookerly_16_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define BOOKERLY_18_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./bookerly_18_regular.h",
-  "./bookerly_18_bold.h",
-  "./bookerly_18_bolditalic.h",
-  "./bookerly_18_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define NOTOSANS_12_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./notosans_12_regular.h",
-  "./notosans_12_bold.h",
-  "./notosans_12_bolditalic.h",
-  "./notosans_12_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define NOTOSANS_14_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./notosans_14_regular.h",
-  "./notosans_14_bold.h",
-  "./notosans_14_bolditalic.h",
-  "./notosans_14_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define NOTOSANS_16_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./notosans_16_regular.h",
-  "./notosans_16_bold.h",
-  "./notosans_16_bolditalic.h",
-  "./notosans_16_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define NOTOSANS_18_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./notosans_18_regular.h",
-  "./notosans_18_bold.h",
-  "./notosans_18_bolditalic.h",
-  "./notosans_18_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define OPENDYSLEXIC_8_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./opendyslexic_8_regular.h",
-  "./opendyslexic_8_bold.h",
-  "./opendyslexic_8_bolditalic.h",
-  "./opendyslexic_8_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define OPENDYSLEXIC_10_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./opendyslexic_10_regular.h",
-  "./opendyslexic_10_bold.h",
-  "./opendyslexic_10_bolditalic.h",
-  "./opendyslexic_10_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define OPENDYSLEXIC_12_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./opendyslexic_12_regular.h",
-  "./opendyslexic_12_bold.h",
-  "./opendyslexic_12_bolditalic.h",
-  "./opendyslexic_12_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define OPENDYSLEXIC_14_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./opendyslexic_14_regular.h",
-  "./opendyslexic_14_bold.h",
-  "./opendyslexic_14_bolditalic.h",
-  "./opendyslexic_14_italic.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define UI_10_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./ubuntu_10_regular.h",
-  "./ubuntu_10_bold.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
-
-echo "#define UI_12_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./ubuntu_12_regular.h",
-  "./ubuntu_12_bold.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
+# Reader fonts, full or the subset the build selects (see builtinFonts/all.h). The IDs differ, so section caches
+# laid out with one set of glyphs are never reused with another.
+echo "#if defined(FONT_SUBSET_LATIN)"
+echo "#include <builtinFonts/subsets/latin/fontIds.h>"
+echo "#elif defined(FONT_SUBSET_CYRILLIC)"
+echo "#include <builtinFonts/subsets/cyrillic/fontIds.h>"
+echo "#elif defined(FONT_SUBSET_VIETNAMESE)"
+echo "#include <builtinFonts/subsets/vietnamese/fontIds.h>"
+echo "#else"
+reader_font_ids "."
+echo "#endif"
+echo ""
 
-echo "#define SMALL_FONT_ID ($(
-ruby -rdigest -e 'puts [
-  "./notosans_8_regular.h",
-].map{|f| Digest::SHA256.hexdigest(File.read(f)).to_i(16) }.sum % (2 ** 32) - (2 ** 31)'
-))"
+font_id "UI_10" "./ubuntu_10_regular.h" "./ubuntu_10_bold.h"
+font_id "UI_12" "./ubuntu_12_regular.h" "./ubuntu_12_bold.h"
+font_id "SMALL" "./notosans_8_regular.h"
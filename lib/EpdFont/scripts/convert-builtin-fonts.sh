@@ -4,6 +4,40 @@ set -e
 
 cd "$(dirname "$0")"
 
+# Usage: convert-builtin-fonts.sh [latin|cyrillic|vietnamese]
+# Without an argument, regenerates every builtin font with the full character range. With a market, regenerates only
+# the reader fonts, cut down to that market's scripts plus the alphabets of its UI languages, into
+# ../builtinFonts/subsets/<market>/; a build selects them with -DFONT_SUBSET_<MARKET> (see platformio.ini). UI fonts
+# stay complete in every build, so the language menu can show every language name.
+SUBSET=$1
+case "$SUBSET" in
+  "")
+    READER_DIR="../builtinFonts"
+    SUBSET_ARGS=()
+    ;;
+  latin)
+    LANGUAGES=(english catalan czech danish dutch finnish french german italian polish portuguese romanian spanish swedish)
+    ;;
+  cyrillic)
+    LANGUAGES=(english russian ukrainian belarusian)
+    ;;
+  vietnamese)
+    LANGUAGES=(english)
+    ;;
+  *)
+    echo "Unknown market '$SUBSET', expected latin, cyrillic or vietnamese" >&2
+    exit 1
+    ;;
+esac
+if [ -n "$SUBSET" ]; then
+  READER_DIR="../builtinFonts/subsets/$SUBSET"
+  SUBSET_ARGS=(--subset "$SUBSET")
+  for language in ${LANGUAGES[@]}; do
+    SUBSET_ARGS+=(--include-chars "../../I18n/translations/${language}.yaml")
+  done
+  mkdir -p "$READER_DIR"
+fi
+
 READER_FONT_STYLES=("Regular" "Italic" "Bold" "BoldItalic")
 BOOKERLY_FONT_SIZES=(12 14 16 18)
 NOTOSANS_FONT_SIZES=(12 14 16 18)
@@ -13,8 +47,8 @@ for size in ${BOOKERLY_FONT_SIZES[@]}; do
   for style in ${READER_FONT_STYLES[@]}; do
     font_name="bookerly_${size}_$(echo $style | tr '[:upper:]' '[:lower:]')"
     font_path="../builtinFonts/source/Bookerly/Bookerly-${style}.ttf"
-    output_path="../builtinFonts/${font_name}.h"
-    python fontconvert.py $font_name $size $font_path --2bit --compress --force-autohint > $output_path
+    output_path="${READER_DIR}/${font_name}.h"
+    python fontconvert.py $font_name $size $font_path --2bit --compress --force-autohint "${SUBSET_ARGS[@]}" > $output_path
     echo "Generated $output_path"
   done
 done
@@ -23,8 +57,8 @@ for size in ${NOTOSANS_FONT_SIZES[@]}; do
   for style in ${READER_FONT_STYLES[@]}; do
     font_name="notosans_${size}_$(echo $style | tr '[:upper:]' '[:lower:]')"
     font_path="../builtinFonts/source/NotoSans/NotoSans-${style}.ttf"
-    output_path="../builtinFonts/${font_name}.h"
-    python fontconvert.py $font_name $size $font_path --2bit --compress > $output_path
+    output_path="${READER_DIR}/${font_name}.h"
+    python fontconvert.py $font_name $size $font_path --2bit --compress "${SUBSET_ARGS[@]}" > $output_path
     echo "Generated $output_path"
   done
 done
@@ -33,12 +67,31 @@ for size in ${OPENDYSLEXIC_FONT_SIZES[@]}; do
   for style in ${READER_FONT_STYLES[@]}; do
     font_name="opendyslexic_${size}_$(echo $style | tr '[:upper:]' '[:lower:]')"
     font_path="../builtinFonts/source/OpenDyslexic/OpenDyslexic-${style}.otf"
-    output_path="../builtinFonts/${font_name}.h"
-    python fontconvert.py $font_name $size $font_path --2bit --compress > $output_path
+    output_path="${READER_DIR}/${font_name}.h"
+    python fontconvert.py $font_name $size $font_path --2bit --compress "${SUBSET_ARGS[@]}" > $output_path
     echo "Generated $output_path"
   done
 done
 
+if [ -n "$SUBSET" ]; then
+  # The subset's own all.h and font IDs, picked up through builtinFonts/all.h and src/fontIds.h
+  {
+    echo "// The contents of this file are generated by ./lib/EpdFont/scripts/convert-builtin-fonts.sh $SUBSET"
+    echo "#pragma once"
+    echo ""
+    for header in $(cd "$READER_DIR" && ls *_*.h | sort); do
+      echo "#include <builtinFonts/subsets/$SUBSET/$header>"
+    done
+  } > "$READER_DIR/all.h"
+  ./build-font-ids.sh "$SUBSET" > "$READER_DIR/fontIds.h"
+  echo "Generated $READER_DIR/all.h and $READER_DIR/fontIds.h"
+
+  echo ""
+  echo "Running compression verification..."
+  python verify_compression.py "$READER_DIR"
+  exit 0
+fi
+
 UI_FONT_SIZES=(10 12)
 UI_FONT_STYLES=("Regular" "Bold")
 
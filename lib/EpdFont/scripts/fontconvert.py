@@ -5,6 +5,8 @@ import sys
 import re
 import math
 import argparse
+import hashlib
+import struct
 from collections import namedtuple
 from fontTools.ttLib import TTFont
 
@@ -16,8 +18,14 @@ parser.add_argument("size", type=int, help="font size to use.")
 parser.add_argument("fontstack", action="store", nargs='+', help="list of font files, ordered by descending priority.")
 parser.add_argument("--2bit", dest="is2Bit", action="store_true", help="generate 2-bit greyscale bitmap instead of 1-bit black and white.")
 parser.add_argument("--additional-intervals", dest="additional_intervals", action="append", help="Additional code point intervals to export as min,max. This argument can be repeated.")
+parser.add_argument("--subset", dest="subset", choices=["latin", "cyrillic", "vietnamese"], help="Only export the scripts read in one market, on top of Latin-1, punctuation and symbols (see SUBSET_RANGES).")
+parser.add_argument("--include-chars", dest="include_chars", action="append", metavar="FILE", help="Also export every character in this UTF-8 file, e.g. the translations of the languages a subset is for. This argument can be repeated.")
 parser.add_argument("--compress", dest="compress", action="store_true", help="Compress glyph bitmaps using DEFLATE with group-based compression.")
+parser.add_argument("--frequency-groups", dest="frequency_groups", action="store", metavar="LANGS", help="Put the glyphs most frequent in the given comma-separated languages (en, de, fr, es, it, pt, nl, pl, ru) in the first compressed group, so most pages inflate only that group. Other glyphs keep their per-script groups.")
+parser.add_argument("--frequency-corpus", dest="frequency_corpus", action="append", metavar="FILE", help="Rank glyphs by their frequency in this UTF-8 text instead of the built-in language profiles. Implies frequency groups; can be repeated.")
+parser.add_argument("--frequency-glyphs", dest="frequency_glyphs", type=int, default=150, help="Glyphs in the frequency group (default: 150).")
 parser.add_argument("--force-autohint", dest="force_autohint", action="store_true", help="Force FreeType auto-hinter instead of native font hinting. Improves stem width consistency for fonts with weak or no native TrueType hints.")
+parser.add_argument("--binary", dest="binary", action="store", metavar="FILE", help="Write a compressed .epdfont file for the SD card fonts folder instead of a header.")
 args = parser.parse_args()
 
 GlyphProps = namedtuple("GlyphProps", ["width", "height", "advance_x", "left", "top", "data_length", "data_offset", "code_point"])
@@ -152,11 +160,29 @@ def load_glyph(code_point):
         face_index += 1
     return None
 
+# What every --subset keeps: Latin-1, combining marks, punctuation, currency and math symbols, ligatures, U+FFFD
+SUBSET_SHARED_RANGES = [(0x0000, 0x00FF), (0x0300, 0x036F), (0x2000, 0x22FF), (0xFB00, 0xFB06), (0xFFFD, 0xFFFD)]
+# And the scripts of each market
+SUBSET_RANGES = {
+    "latin": [(0x0100, 0x024F)],
+    "cyrillic": [(0x0400, 0x04FF)],
+    "vietnamese": [(0x0100, 0x017F), (0x01A0, 0x01B0), (0x1EA0, 0x1EF9)],
+}
+
+if args.subset:
+    kept = SUBSET_SHARED_RANGES + SUBSET_RANGES[args.subset]
+    intervals = [(max(a, c), min(b, d)) for a, b in intervals for c, d in kept if max(a, c) <= min(b, d)]
+
+if args.include_chars:
+    for path in args.include_chars:
+        with open(path, encoding="utf-8") as f:
+            add_ints.extend((ord(c), ord(c)) for c in set(f.read()) if ord(c) >= 0x20)
+
 unmerged_intervals = sorted(intervals + add_ints)
 intervals = []
 unvalidated_intervals = []
 for i_start, i_end in unmerged_intervals:
-    if len(unvalidated_intervals) > 0 and i_start + 1 <= unvalidated_intervals[-1][1]:
+    if len(unvalidated_intervals) > 0 and i_start <= unvalidated_intervals[-1][1]:
         unvalidated_intervals[-1] = (unvalidated_intervals[-1][0], max(unvalidated_intervals[-1][1], i_end))
         continue
     unvalidated_intervals.append((i_start, i_end))
@@ -659,7 +685,102 @@ for packed, lig_cp in ligature_pairs:
 ligature_pairs = sorted(unique_ligature_pairs, key=lambda p: p[0])
 print(f"ligatures: {len(ligature_pairs)} pairs extracted", file=sys.stderr)
 
-compress = args.compress
+compress = args.compress or args.binary is not None
+frequency_grouping = args.frequency_groups is not None or args.frequency_corpus is not None
+if frequency_grouping and not compress:
+    sys.exit("Frequency groups need --compress or --binary")
+
+# Groups are streamed from the card one at a time when binary, so keep them small
+MAX_BINARY_GROUP_GLYPHS = 128
+
+# Letters of each language, most frequent first, and the punctuation its typesetting adds to COMMON_PUNCTUATION.
+# Only the rank matters: the top glyphs over all requested languages form the frequency group.
+FREQUENCY_PROFILES = {
+    "en": ("etaoinshrdlcumwfgypbvkjxqz", "’“”—"),
+    "de": ("enisratdhulcgmobwfkzvüpäßjöyxq", "„“‚‘–"),
+    "fr": ("esaitnrulodcpméèvqfbghàjxyêçzôùâîûœëï", "«»’—"),
+    "es": ("eaosrnidlctumpbgvyqóhfzjéáíñxúüwk", "«»¿¡—"),
+    "it": ("eaionlrtscdupmvghfbqzàèùòìéó", "«»’—"),
+    "pt": ("aeosrindmutclpvgqhfbãçéjáêxóõíôàúzwky", "«»“”—"),
+    "nl": ("enatirodslghvkmubpwjzcfxyëéq", "‘’“”"),
+    "pl": ("aioeznrwcstykdpmuljłęgbąhśżóćńfźx", "„”—"),
+    "ru": ("оеаинтсрвлкмдпуяызьбгчйхжшюцщэфъё", "«»—„“"),
+}
+COMMON_PUNCTUATION = " .,'\"-;:!?()…–"
+DIGITS = "0123456789"
+LIGATURES = "\uFB01\uFB02\uFB00\uFB03\uFB04"
+ASCII_SYMBOLS = "/&*%#@[]_+=<>|~^`{}$\\"
+
+
+def profile_ranking(language):
+    """Code points of one language, most frequent first: lowercase, punctuation, digits, capitals, ligatures, symbols."""
+    if language not in FREQUENCY_PROFILES:
+        sys.exit(f"No frequency profile for '{language}', known: {', '.join(FREQUENCY_PROFILES)}")
+    letters, punctuation = FREQUENCY_PROFILES[language]
+    capitals = "".join(c.upper() for c in letters if len(c.upper()) == 1 and c.upper() != c)
+    return [ord(c) for c in letters + COMMON_PUNCTUATION + punctuation + DIGITS + capitals + LIGATURES + ASCII_SYMBOLS]
+
+
+def corpus_ranking(paths):
+    """Code points by their count in the corpus files; a ligature counts every pair it replaces."""
+    counts = {}
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            text = " ".join(f.read().split())
+        for c in text:
+            counts[ord(c)] = counts.get(ord(c), 0) + 1
+        for packed, lig_cp in ligature_pairs:
+            left, right = packed >> 16, packed & 0xFFFF
+            if not 0xFB00 <= left <= 0xFB06:  # Chained through a shorter ligature
+                counts[lig_cp] = counts.get(lig_cp, 0) + text.count(chr(left) + chr(right))
+    return [cp for cp, count in sorted(counts.items(), key=lambda item: (-item[1], item[0])) if count > 0]
+
+
+def frequent_code_points(available, limit):
+    """The limit most frequent code points the font has, merging several languages rank by rank."""
+    if args.frequency_corpus:
+        rankings = [corpus_ranking(args.frequency_corpus)]
+    else:
+        rankings = [profile_ranking(language.strip()) for language in args.frequency_groups.split(",")]
+    best_rank = {}
+    for ranking in rankings:
+        for rank, cp in enumerate(ranking):
+            if cp in available and rank < best_rank.get(cp, len(ranking) + 1):
+                best_rank[cp] = rank
+    ordered = sorted(best_rank, key=lambda cp: (best_rank[cp], cp))
+    return set(ordered[:limit])
+
+
+# (first code point, last code point, glyph index of the first) per interval
+interval_table = []
+glyph_offset = 0
+for i_start, i_end in intervals:
+    interval_table.append((i_start, i_end, glyph_offset))
+    glyph_offset += i_end - i_start + 1
+
+# Glyphs of the frequency group, moved to the front of the glyph array
+frequent_count = 0
+if compress and frequency_grouping:
+    frequency_limit = args.frequency_glyphs
+    if args.binary and frequency_limit > MAX_BINARY_GROUP_GLYPHS:
+        frequency_limit = MAX_BINARY_GROUP_GLYPHS
+    frequent = frequent_code_points({props.code_point for props, _ in all_glyphs}, frequency_limit)
+    order = sorted(range(len(all_glyphs)), key=lambda i: (all_glyphs[i][0].code_point not in frequent, i))
+    all_glyphs = [all_glyphs[i] for i in order]
+    glyph_props = [glyph_props[i] for i in order]
+    frequent_count = len(frequent)
+
+    # The intervals stay sorted by code point for the lookup, but now break wherever the glyph order jumps
+    glyph_index = {props.code_point: i for i, (props, _) in enumerate(all_glyphs)}
+    interval_table = []
+    for cp in sorted(glyph_index):
+        if interval_table and cp == interval_table[-1][1] + 1 and \
+                glyph_index[cp] == interval_table[-1][2] + cp - interval_table[-1][0]:
+            interval_table[-1] = (interval_table[-1][0], cp, interval_table[-1][2])
+        else:
+            interval_table.append((cp, cp, glyph_index[cp]))
+    print(f"frequency group: {frequent_count} glyphs, {len(intervals)} -> {len(interval_table)} intervals",
+          file=sys.stderr)
 
 # Build groups for compression
 if compress:
@@ -680,7 +801,14 @@ if compress:
         (0x20A0, 0x20CF),   # Currency Symbols
         (0x2190, 0x21FF),   # Arrows
         (0x2200, 0x22FF),   # Math Operators
+        (0x3000, 0x303F),   # CJK Symbols & Punctuation
+        (0x3040, 0x30FF),   # Hiragana & Katakana
+        (0x3400, 0x4DBF),   # CJK Extension A
+        (0x4E00, 0x9FFF),   # CJK Unified Ideographs
+        (0xAC00, 0xD7AF),   # Hangul Syllables
+        (0xF900, 0xFAFF),   # CJK Compatibility Ideographs
         (0xFB00, 0xFB06),   # Alphabetic Presentation Forms (ligatures)
+        (0xFF00, 0xFFEF),   # Halfwidth & Fullwidth Forms
         (0xFFFD, 0xFFFD),   # Replacement Character
     ]
 
@@ -695,8 +823,10 @@ if compress:
     group_start = 0
     group_count = 0
 
+    # The frequency group first, then the rest by script (still in code point order)
+    FREQUENCY_GROUP = -2
     for i, (props, packed) in enumerate(all_glyphs):
-        sg = get_script_group(props.code_point)
+        sg = FREQUENCY_GROUP if i < frequent_count else get_script_group(props.code_point)
         if sg != current_group_id:
             if group_count > 0:
                 groups.append((group_start, group_count))
@@ -709,6 +839,21 @@ if compress:
     if group_count > 0:
         groups.append((group_start, group_count))
 
+    # A page of ideographic text draws a few hundred glyphs spread over tens of thousands of codepoints, so those
+    # blocks are cut into small groups: a page then inflates little beyond the glyphs it draws.
+    CJK_GROUP_GLYPHS = 32
+
+    def max_group_glyphs(code_point):
+        if 0x3000 <= code_point <= 0xD7AF or 0xF900 <= code_point <= 0xFAFF or 0xFF00 <= code_point <= 0xFFEF:
+            return CJK_GROUP_GLYPHS
+        return MAX_BINARY_GROUP_GLYPHS if args.binary else None
+
+    split_groups = []
+    for first, count in groups:
+        limit = count if first < frequent_count else max_group_glyphs(all_glyphs[first][0].code_point) or count
+        split_groups.extend((first + start, min(limit, count - start)) for start in range(0, count, limit))
+    groups = split_groups
+
     # Compress each group
     compressed_groups = []  # list of (compressed_bytes, uncompressed_size, glyph_count, first_glyph_index)
     compressed_bitmap_data = []
@@ -750,6 +895,42 @@ if compress:
     total_uncompressed = len(glyph_data)
     print(f"// Compression: {total_uncompressed} -> {total_compressed} bytes ({100*total_compressed/total_uncompressed:.1f}%), {len(groups)} groups", file=sys.stderr)
 
+if args.binary:
+    # Layout matches SdFont.cpp: 40-byte header, then the tables in EpdFontData order, then the bitmap data
+    body = bytearray()
+    for i_start, i_end, offset in interval_table:
+        body += struct.pack("<III", i_start, i_end, offset)
+    for g in glyph_props:
+        body += struct.pack("<BBBhhHI", *g[:-1])
+    compressed_offset = 0
+    for compressed, uncompressed_size, count, first_idx in compressed_groups:
+        body += struct.pack("<IIIHH", compressed_offset, len(compressed), uncompressed_size, count, first_idx)
+        compressed_offset += len(compressed)
+    left_classes = kern_left_classes if kern_map else []
+    right_classes = kern_right_classes if kern_map else []
+    for cp, cls in left_classes + right_classes:
+        body += struct.pack("<HB", cp, cls)
+    if kern_map:
+        body += struct.pack(f"<{len(kern_matrix)}b", *kern_matrix)
+    for packed_pair, lig_cp in ligature_pairs:
+        body += struct.pack("<II", packed_pair, lig_cp)
+    body += bytes(compressed_bitmap_data)
+
+    if len(all_glyphs) > 0xFFFF or len(compressed_groups) > 0xFFFF:
+        sys.exit(f"{len(all_glyphs)} glyphs in {len(compressed_groups)} groups do not fit the binary format")
+    content_hash = int.from_bytes(hashlib.sha256(body).digest()[:4], "little")
+    header = struct.pack("<4sHBBhhIIIHHHBBII", b"EPDF", 1, 1 if is2Bit else 0, norm_ceil(face.size.height),
+                         norm_ceil(face.size.ascender), norm_floor(face.size.descender), content_hash,
+                         len(interval_table), len(glyph_props), len(compressed_groups), len(left_classes),
+                         len(right_classes), kern_left_class_count if kern_map else 0,
+                         kern_right_class_count if kern_map else 0, len(ligature_pairs),
+                         len(compressed_bitmap_data))
+    assert len(header) == 40
+    with open(args.binary, "wb") as f:
+        f.write(header + body)
+    print(f"wrote {args.binary}: {len(header) + len(body)} bytes", file=sys.stderr)
+    sys.exit(0)
+
 print(f"""/**
  * generated by fontconvert.py
  * name: {font_name}
@@ -783,10 +964,8 @@ for i, g in enumerate(glyph_props):
 print ("};\n");
 
 print(f"static const EpdUnicodeInterval {font_name}Intervals[] = {{")
-offset = 0
-for i_start, i_end in intervals:
+for i_start, i_end, offset in interval_table:
     print (f"    {{ 0x{i_start:X}, 0x{i_end:X}, 0x{offset:X} }},")
-    offset += i_end - i_start + 1
 print ("};\n");
 
 if compress:
@@ -825,7 +1004,7 @@ print(f"static const EpdFontData {font_name} = {{")
 print(f"    {font_name}Bitmaps,")
 print(f"    {font_name}Glyphs,")
 print(f"    {font_name}Intervals,")
-print(f"    {len(intervals)},")
+print(f"    {len(interval_table)},")
 print(f"    {norm_ceil(face.size.height)},")
 print(f"    {norm_ceil(face.size.ascender)},")
 print(f"    {norm_floor(face.size.descender)},")
@@ -1,17 +1,72 @@
 #include "Epub.h"
 
+#include <BmpRowWriter.h>
 #include <FsHelpers.h>
 #include <HalStorage.h>
 #include <JpegToBmpConverter.h>
 #include <Logging.h>
 #include <PngToBmpConverter.h>
+#include <Serialization.h>
 #include <ZipFile.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
 #include "Epub/parsers/ContainerParser.h"
 #include "Epub/parsers/ContentOpfParser.h"
 #include "Epub/parsers/TocNavParser.h"
 #include "Epub/parsers/TocNcxParser.h"
 
+namespace {
+// Layouts whose section files are kept per book, most recently used first in sections/layouts.bin
+constexpr uint8_t MAX_SECTION_LAYOUTS = 3;
+constexpr uint8_t SECTION_LAYOUTS_VERSION = 1;
+
+std::string sectionLayoutDir(const std::string& cachePath, const uint32_t layoutKey) {
+  char name[20];
+  snprintf(name, sizeof(name), "/sections/%08lx", static_cast<unsigned long>(layoutKey));
+  return cachePath + name;
+}
+
+// Section files from before they were kept per layout sat directly in sections/; they can't be matched to a layout
+// any more
+void removeUnkeyedSectionFiles(const std::string& sectionsDir) {
+  std::vector<std::string> stale;
+  auto dir = Storage.open(sectionsDir.c_str());
+  if (dir && dir.isDirectory()) {
+    char name[64];
+    for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
+      file.getName(name, sizeof(name));
+      const size_t length = strlen(name);
+      if (!file.isDirectory() && length > 3 &&
+          (strcmp(name + length - 4, ".bin") == 0 || strcmp(name + length - 3, ".xp") == 0)) {
+        stale.emplace_back(name);
+      }
+      file.close();
+    }
+  }
+  if (dir) {
+    dir.close();
+  }
+  for (const auto& name : stale) {
+    Storage.remove((sectionsDir + "/" + name).c_str());
+  }
+}
+
+// Routes an Epub's item reads through an already open archive handle for as long as it lives
+class IndexingZip {
+ public:
+  IndexingZip(ZipFile*& slot, ZipFile& zip) : slot(slot) { slot = &zip; }
+  ~IndexingZip() { slot = nullptr; }
+  IndexingZip(const IndexingZip&) = delete;
+  IndexingZip& operator=(const IndexingZip&) = delete;
+
+ private:
+  ZipFile*& slot;
+};
+}  // namespace
+
 bool Epub::findContentOpfFile(std::string* contentOpfFile) const {
   const auto containerPath = "META-INF/container.xml";
   size_t containerSize;
@@ -76,6 +131,8 @@ bool Epub::parseContentOpf(BookMetadataCache::BookMetadata& bookMetadata) {
   bookMetadata.title = opfParser.title;
   bookMetadata.author = opfParser.author;
   bookMetadata.language = opfParser.language;
+  bookMetadata.uuid = opfParser.uuid;
+  bookMetadata.series = opfParser.series;
   bookMetadata.coverItemHref = opfParser.coverItemHref;
 
   // Guide-based cover fallback: if no cover found via metadata/properties,
@@ -152,50 +209,25 @@ bool Epub::parseTocNcxFile() const {
 
   LOG_DBG("EBP", "Parsing toc ncx file: %s", tocNcxItem.c_str());
 
-  const auto tmpNcxPath = getCachePath() + "/toc.ncx";
-  FsFile tempNcxFile;
-  if (!Storage.openFileForWrite("EBP", tmpNcxPath, tempNcxFile)) {
-    return false;
-  }
-  readItemContentsToStream(tocNcxItem, tempNcxFile, 1024);
-  tempNcxFile.close();
-  if (!Storage.openFileForRead("EBP", tmpNcxPath, tempNcxFile)) {
+  size_t ncxSize;
+  if (!getItemSize(tocNcxItem, &ncxSize)) {
+    LOG_ERR("EBP", "Could not find or size toc ncx file");
     return false;
   }
-  const auto ncxSize = tempNcxFile.size();
 
   TocNcxParser ncxParser(contentBasePath, ncxSize, bookMetadataCache.get());
 
   if (!ncxParser.setup()) {
     LOG_ERR("EBP", "Could not setup toc ncx parser");
-    tempNcxFile.close();
     return false;
   }
 
-  const auto ncxBuffer = static_cast<uint8_t*>(malloc(1024));
-  if (!ncxBuffer) {
-    LOG_ERR("EBP", "Could not allocate memory for toc ncx parser");
-    tempNcxFile.close();
+  // Inflated straight into the parser, like content.opf
+  if (!readItemContentsToStream(tocNcxItem, ncxParser, 1024)) {
+    LOG_ERR("EBP", "Could not read toc ncx file");
     return false;
   }
 
-  while (tempNcxFile.available()) {
-    const auto readSize = tempNcxFile.read(ncxBuffer, 1024);
-    if (readSize == 0) break;
-    const auto processedSize = ncxParser.write(ncxBuffer, readSize);
-
-    if (processedSize != readSize) {
-      LOG_ERR("EBP", "Could not process all toc ncx data");
-      free(ncxBuffer);
-      tempNcxFile.close();
-      return false;
-    }
-  }
-
-  free(ncxBuffer);
-  tempNcxFile.close();
-  Storage.remove(tmpNcxPath.c_str());
-
   LOG_DBG("EBP", "Parsed TOC items");
   return true;
 }
@@ -209,17 +241,11 @@ bool Epub::parseTocNavFile() const {
 
   LOG_DBG("EBP", "Parsing toc nav file: %s", tocNavItem.c_str());
 
-  const auto tmpNavPath = getCachePath() + "/toc.nav";
-  FsFile tempNavFile;
-  if (!Storage.openFileForWrite("EBP", tmpNavPath, tempNavFile)) {
+  size_t navSize;
+  if (!getItemSize(tocNavItem, &navSize)) {
+    LOG_ERR("EBP", "Could not find or size toc nav file");
     return false;
   }
-  readItemContentsToStream(tocNavItem, tempNavFile, 1024);
-  tempNavFile.close();
-  if (!Storage.openFileForRead("EBP", tmpNavPath, tempNavFile)) {
-    return false;
-  }
-  const auto navSize = tempNavFile.size();
 
   // Note: We can't use `contentBasePath` here as the nav file may be in a different folder to the content.opf
   // and the HTMLX nav file will have hrefs relative to itself
@@ -231,28 +257,11 @@ bool Epub::parseTocNavFile() const {
     return false;
   }
 
-  const auto navBuffer = static_cast<uint8_t*>(malloc(1024));
-  if (!navBuffer) {
-    LOG_ERR("EBP", "Could not allocate memory for toc nav parser");
+  if (!readItemContentsToStream(tocNavItem, navParser, 1024)) {
+    LOG_ERR("EBP", "Could not read toc nav file");
     return false;
   }
 
-  while (tempNavFile.available()) {
-    const auto readSize = tempNavFile.read(navBuffer, 1024);
-    const auto processedSize = navParser.write(navBuffer, readSize);
-
-    if (processedSize != readSize) {
-      LOG_ERR("EBP", "Could not process all toc nav data");
-      free(navBuffer);
-      tempNavFile.close();
-      return false;
-    }
-  }
-
-  free(navBuffer);
-  tempNavFile.close();
-  Storage.remove(tmpNavPath.c_str());
-
   LOG_DBG("EBP", "Parsed TOC nav items");
   return true;
 }
@@ -276,7 +285,12 @@ void Epub::parseCssFiles() const {
     return;
   }
 
-  // No cache yet - parse CSS files
+  // No cache yet - parse CSS files, one cache block per stylesheet so sections only load what they link to
+  if (!cssParser->beginCacheWrite()) {
+    LOG_ERR("EBP", "Failed to create CSS rules cache");
+    return;
+  }
+  size_t totalRules = 0;
   for (const auto& cssPath : cssFiles) {
     LOG_DBG("EBP", "Parsing CSS file: %s", cssPath.c_str());
 
@@ -285,6 +299,7 @@ void Epub::parseCssFiles() const {
     if (freeHeap < MIN_HEAP_FOR_CSS_PARSING) {
       LOG_ERR("EBP", "Insufficient heap for CSS parsing (%u bytes free, need %zu), skipping: %s", freeHeap,
               MIN_HEAP_FOR_CSS_PARSING, cssPath.c_str());
+      cssParser->writeStylesheetToCache(cssPath);
       continue;
     }
 
@@ -294,6 +309,7 @@ void Epub::parseCssFiles() const {
       if (cssFileSize > MAX_CSS_FILE_SIZE) {
         LOG_ERR("EBP", "CSS file too large (%zu bytes > %zu max), skipping: %s", cssFileSize, MAX_CSS_FILE_SIZE,
                 cssPath.c_str());
+        cssParser->writeStylesheetToCache(cssPath);
         continue;
       }
     }
@@ -303,12 +319,14 @@ void Epub::parseCssFiles() const {
     FsFile tempCssFile;
     if (!Storage.openFileForWrite("EBP", tmpCssPath, tempCssFile)) {
       LOG_ERR("EBP", "Could not create temp CSS file");
+      cssParser->writeStylesheetToCache(cssPath);
       continue;
     }
-    if (!readItemContentsToStream(cssPath, tempCssFile, 1024)) {
+    if (!readItemContentsToStream(cssPath, tempCssFile, Storage.profile().writeChunk)) {
       LOG_ERR("EBP", "Could not read CSS file: %s", cssPath.c_str());
       tempCssFile.close();
       Storage.remove(tmpCssPath.c_str());
+      cssParser->writeStylesheetToCache(cssPath);
       continue;
     }
     tempCssFile.close();
@@ -317,20 +335,22 @@ void Epub::parseCssFiles() const {
     if (!Storage.openFileForRead("EBP", tmpCssPath, tempCssFile)) {
       LOG_ERR("EBP", "Could not open temp CSS file for reading");
       Storage.remove(tmpCssPath.c_str());
+      cssParser->writeStylesheetToCache(cssPath);
       continue;
     }
     cssParser->loadFromStream(tempCssFile);
     tempCssFile.close();
     Storage.remove(tmpCssPath.c_str());
+    totalRules += cssParser->ruleCount();
+    cssParser->writeStylesheetToCache(cssPath);
   }
 
   // Save to cache for next time
-  if (!cssParser->saveToCache()) {
+  if (!cssParser->endCacheWrite()) {
     LOG_ERR("EBP", "Failed to save CSS rules to cache");
   }
-  cssParser->clear();
 
-  LOG_DBG("EBP", "Loaded %zu CSS style rules from %zu files", cssParser->ruleCount(), cssFiles.size());
+  LOG_DBG("EBP", "Loaded %zu CSS style rules from %zu files", totalRules, cssFiles.size());
 }
 
 // load in the meta data for the epub file
@@ -345,11 +365,17 @@ bool Epub::load(const bool buildIfMissing, const bool skipLoadingCss) {
   // Try to load existing cache first
   if (bookMetadataCache->load()) {
     if (!skipLoadingCss) {
-      // Rebuild CSS cache when missing or when cache version changed (loadFromCache removes stale file)
-      if (!cssParser->hasCache() || !cssParser->loadFromCache()) {
+      // Rebuild CSS cache when missing or when cache version changed (loadCacheIndex removes stale file).
+      // Only the stylesheet table is checked here; rules are loaded per section build.
+      const bool cssCacheValid = cssParser->hasCache() && cssParser->loadCacheIndex();
+      cssParser->clear();
+      if (!cssCacheValid) {
         LOG_DBG("EBP", "CSS rules cache missing or stale, attempting to parse CSS files");
         cssParser->deleteCache();
 
+        ZipFile zip(filepath, getZipIndexPath());
+        const IndexingZip indexing(indexingZip, zip);
+
         if (!parseContentOpf(bookMetadataCache->coreMetadata)) {
           LOG_ERR("EBP", "Could not parse content.opf from cached bookMetadata for CSS files");
           // continue anyway - book will work without CSS and we'll still load any inline style CSS
@@ -357,6 +383,9 @@ bool Epub::load(const bool buildIfMissing, const bool skipLoadingCss) {
         parseCssFiles();
         // Invalidate section caches so they are rebuilt with the new CSS
         Storage.removeDir((cachePath + "/sections").c_str());
+        sectionPack->forget();
+        hasSectionLayout = false;
+        sectionLayouts.clear();
       }
     }
     LOG_DBG("EBP", "Loaded ePub: %s", filepath.c_str());
@@ -374,6 +403,15 @@ bool Epub::load(const bool buildIfMissing, const bool skipLoadingCss) {
 
   const uint32_t indexingStart = millis();
 
+  // One handle on the archive for the whole indexing: the OPF, TOC, size and CSS passes share its directory
+  // details, central directory index and open file instead of each read reopening and re-locating them
+  ZipFile zip(filepath, getZipIndexPath());
+  if (!zip.open()) {
+    LOG_ERR("EBP", "Could not open ePub: %s", filepath.c_str());
+    return false;
+  }
+  const IndexingZip indexing(indexingZip, zip);
+
   // Begin building cache - stream entries to disk immediately
   if (!bookMetadataCache->beginWrite()) {
     LOG_ERR("EBP", "Could not begin writing cache");
@@ -437,7 +475,7 @@ bool Epub::load(const bool buildIfMissing, const bool skipLoadingCss) {
 
   // Build final book.bin
   const uint32_t buildStart = millis();
-  if (!bookMetadataCache->buildBookBin(filepath, bookMetadata)) {
+  if (!bookMetadataCache->buildBookBin(zip, bookMetadata)) {
     LOG_ERR("EBP", "Could not update mappings and sizes");
     return false;
   }
@@ -459,6 +497,9 @@ bool Epub::load(const bool buildIfMissing, const bool skipLoadingCss) {
     // Parse CSS files after cache reload
     parseCssFiles();
     Storage.removeDir((cachePath + "/sections").c_str());
+    sectionPack->forget();
+    hasSectionLayout = false;
+    sectionLayouts.clear();
   }
 
   LOG_DBG("EBP", "Loaded ePub: %s", filepath.c_str());
@@ -480,6 +521,28 @@ bool Epub::clearCache() const {
   return true;
 }
 
+bool Epub::moveCache(const std::string& newFilepath) const {
+  if (!Storage.exists(cachePath.c_str())) {
+    return true;
+  }
+
+  const std::string cacheDir = cachePath.substr(0, cachePath.rfind('/'));
+  const std::string newCachePath = Epub(newFilepath, cacheDir).getCachePath();
+  if (newCachePath == cachePath) {
+    return true;
+  }
+  if (Storage.exists(newCachePath.c_str())) {
+    Storage.removeDir(newCachePath.c_str());
+  }
+  if (!Storage.rename(cachePath.c_str(), newCachePath.c_str())) {
+    LOG_ERR("EPB", "Failed to move cache, clearing it instead");
+    return clearCache();
+  }
+
+  LOG_DBG("EPB", "Cache moved to %s", newCachePath.c_str());
+  return true;
+}
+
 void Epub::setupCacheDir() const {
   if (Storage.exists(cachePath.c_str())) {
     return;
@@ -490,6 +553,74 @@ void Epub::setupCacheDir() const {
 
 const std::string& Epub::getCachePath() const { return cachePath; }
 
+std::string Epub::getSectionDir(const uint32_t layoutKey) {
+  const std::string dir = sectionLayoutDir(cachePath, layoutKey);
+  if (hasSectionLayout && layoutKey == lastSectionLayout) {
+    return dir;
+  }
+  const bool firstSectionOpen = !hasSectionLayout;
+  hasSectionLayout = true;
+  lastSectionLayout = layoutKey;
+
+  const std::string sectionsDir = cachePath + "/sections";
+  const std::string listPath = sectionsDir + "/layouts.bin";
+  std::vector<uint32_t> layouts;
+  FsFile file;
+  if (Storage.exists(listPath.c_str()) && Storage.openFileForRead("EBP", listPath, file)) {
+    uint8_t version = 0;
+    uint8_t count = 0;
+    serialization::readPod(file, version);
+    serialization::readPod(file, count);
+    if (version == SECTION_LAYOUTS_VERSION && count <= MAX_SECTION_LAYOUTS) {
+      layouts.resize(count);
+      const int bytes = count * sizeof(uint32_t);
+      if (count > 0 && file.read(reinterpret_cast<uint8_t*>(layouts.data()), bytes) != bytes) {
+        layouts.clear();
+      }
+    }
+    file.close();
+    if (firstSectionOpen) {
+      // No section has a file of the pack open yet
+      sectionPack->compact();
+    }
+  } else {
+    removeUnkeyedSectionFiles(sectionsDir);
+  }
+
+  if (!layouts.empty() && layouts.front() == layoutKey) {
+    sectionLayouts = std::move(layouts);
+    return dir;
+  }
+  layouts.erase(std::remove(layouts.begin(), layouts.end(), layoutKey), layouts.end());
+  layouts.insert(layouts.begin(), layoutKey);
+  while (layouts.size() > MAX_SECTION_LAYOUTS) {
+    LOG_DBG("EBP", "Dropping sections of layout %08lx", static_cast<unsigned long>(layouts.back()));
+    sectionPack->removeGroup(layouts.back());
+    Storage.removeDir(sectionLayoutDir(cachePath, layouts.back()).c_str());
+    layouts.pop_back();
+  }
+
+  Storage.mkdir(sectionsDir.c_str());
+  if (Storage.openFileForWrite("EBP", listPath, file)) {
+    serialization::writePod(file, SECTION_LAYOUTS_VERSION);
+    serialization::writePod(file, static_cast<uint8_t>(layouts.size()));
+    file.write(reinterpret_cast<const uint8_t*>(layouts.data()), layouts.size() * sizeof(uint32_t));
+    file.close();
+  }
+  sectionLayouts = std::move(layouts);
+  return dir;
+}
+
+std::string Epub::getZipIndexPath() const { return cachePath + "/zip_index.bin"; }
+
+std::string Epub::getWordWidthCachePath() const { return cachePath + "/word_widths.bin"; }
+
+std::string Epub::getFootnoteStorePath(const int spineIndex) const {
+  return cachePath + "/sections/" + std::to_string(spineIndex) + ".fn";
+}
+
+std::string Epub::getPageCountsPath() const { return cachePath + "/page_counts.bin"; }
+
 const std::string& Epub::getPath() const { return filepath; }
 
 const std::string& Epub::getTitle() const {
@@ -519,196 +650,124 @@ const std::string& Epub::getLanguage() const {
   return bookMetadataCache->coreMetadata.language;
 }
 
-std::string Epub::getCoverBmpPath(bool cropped) const {
-  const auto coverFileName = std::string("cover") + (cropped ? "_crop" : "");
-  return cachePath + "/" + coverFileName + ".bmp";
-}
-
-bool Epub::generateCoverBmp(bool cropped) const {
-  // Already generated, return true
-  if (Storage.exists(getCoverBmpPath(cropped).c_str())) {
-    return true;
-  }
-
+const std::string& Epub::getUuid() const {
+  static std::string blank;
   if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
-    LOG_ERR("EBP", "Cannot generate cover BMP, cache not loaded");
-    return false;
-  }
-
-  const auto coverImageHref = bookMetadataCache->coreMetadata.coverItemHref;
-  if (coverImageHref.empty()) {
-    LOG_ERR("EBP", "No known cover image");
-    return false;
+    return blank;
   }
 
-  if (coverImageHref.substr(coverImageHref.length() - 4) == ".jpg" ||
-      coverImageHref.substr(coverImageHref.length() - 5) == ".jpeg") {
-    LOG_DBG("EBP", "Generating BMP from JPG cover image (%s mode)", cropped ? "cropped" : "fit");
-    const auto coverJpgTempPath = getCachePath() + "/.cover.jpg";
-
-    FsFile coverJpg;
-    if (!Storage.openFileForWrite("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverJpg, 1024);
-    coverJpg.close();
-
-    if (!Storage.openFileForRead("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
-    }
+  return bookMetadataCache->coreMetadata.uuid;
+}
 
-    FsFile coverBmp;
-    if (!Storage.openFileForWrite("EBP", getCoverBmpPath(cropped), coverBmp)) {
-      coverJpg.close();
-      return false;
-    }
-    const bool success = JpegToBmpConverter::jpegFileToBmpStream(coverJpg, coverBmp, cropped);
-    coverJpg.close();
-    coverBmp.close();
-    Storage.remove(coverJpgTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate BMP from cover image");
-      Storage.remove(getCoverBmpPath(cropped).c_str());
-    }
-    LOG_DBG("EBP", "Generated BMP from JPG cover image, success: %s", success ? "yes" : "no");
-    return success;
+const std::string& Epub::getSeries() const {
+  static std::string blank;
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    return blank;
   }
 
-  if (coverImageHref.substr(coverImageHref.length() - 4) == ".png") {
-    LOG_DBG("EBP", "Generating BMP from PNG cover image (%s mode)", cropped ? "cropped" : "fit");
-    const auto coverPngTempPath = getCachePath() + "/.cover.png";
-
-    FsFile coverPng;
-    if (!Storage.openFileForWrite("EBP", coverPngTempPath, coverPng)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverPng, 1024);
-    coverPng.close();
-
-    if (!Storage.openFileForRead("EBP", coverPngTempPath, coverPng)) {
-      return false;
-    }
-
-    FsFile coverBmp;
-    if (!Storage.openFileForWrite("EBP", getCoverBmpPath(cropped), coverBmp)) {
-      coverPng.close();
-      return false;
-    }
-    const bool success = PngToBmpConverter::pngFileToBmpStream(coverPng, coverBmp, cropped);
-    coverPng.close();
-    coverBmp.close();
-    Storage.remove(coverPngTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate BMP from PNG cover image");
-      Storage.remove(getCoverBmpPath(cropped).c_str());
-    }
-    LOG_DBG("EBP", "Generated BMP from PNG cover image, success: %s", success ? "yes" : "no");
-    return success;
-  }
+  return bookMetadataCache->coreMetadata.series;
+}
 
-  LOG_ERR("EBP", "Cover image is not a supported format, skipping");
-  return false;
+std::string Epub::getCoverBmpPath(bool cropped) const {
+  const auto coverFileName = std::string("cover") + (cropped ? "_crop" : "");
+  return cachePath + "/" + coverFileName + ".bmp";
 }
 
+bool Epub::generateCoverBmp(bool cropped) const { return generateCoverBmps(!cropped, cropped, {}); }
+
 std::string Epub::getThumbBmpPath() const { return cachePath + "/thumb_[HEIGHT].bmp"; }
 std::string Epub::getThumbBmpPath(int height) const { return cachePath + "/thumb_" + std::to_string(height) + ".bmp"; }
 
-bool Epub::generateThumbBmp(int height) const {
+bool Epub::generateThumbBmp(int height) const { return generateCoverBmps(false, false, {height}); }
+
+bool Epub::generateCoverBmps(const bool fitCover, const bool croppedCover, const std::vector<int>& thumbHeights) const {
+  // Only the files not generated yet are written
+  std::string paths[BmpOutputSet::MAX_OUTPUTS];
+  bool isThumb[BmpOutputSet::MAX_OUTPUTS];
+  FsFile files[BmpOutputSet::MAX_OUTPUTS];
+  BmpOutput outputs[BmpOutputSet::MAX_OUTPUTS];
+  int count = 0;
+  const auto addOutput = [&](std::string path, const bool thumb, const BmpOutput& output) {
+    if (count == BmpOutputSet::MAX_OUTPUTS || Storage.exists(path.c_str())) return;
+    paths[count] = std::move(path);
+    isThumb[count] = thumb;
+    outputs[count] = output;
+    count++;
+  };
+  if (fitCover) addOutput(getCoverBmpPath(false), false, BmpOutput::cover(files[count], false));
+  if (croppedCover) addOutput(getCoverBmpPath(true), false, BmpOutput::cover(files[count], true));
+  for (const int height : thumbHeights) {
+    addOutput(getThumbBmpPath(height), true, BmpOutput::thumbnail(files[count], height));
+  }
   // Already generated, return true
-  if (Storage.exists(getThumbBmpPath(height).c_str())) {
+  if (count == 0) {
     return true;
   }
 
   if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
-    LOG_ERR("EBP", "Cannot generate thumb BMP, cache not loaded");
+    LOG_ERR("EBP", "Cannot generate cover BMP, cache not loaded");
     return false;
   }
 
-  const auto coverImageHref = bookMetadataCache->coreMetadata.coverItemHref;
-  if (coverImageHref.empty()) {
-    LOG_DBG("EBP", "No known cover image for thumbnail");
-  } else if (coverImageHref.substr(coverImageHref.length() - 4) == ".jpg" ||
-             coverImageHref.substr(coverImageHref.length() - 5) == ".jpeg") {
-    LOG_DBG("EBP", "Generating thumb BMP from JPG cover image");
-    const auto coverJpgTempPath = getCachePath() + "/.cover.jpg";
-
-    FsFile coverJpg;
-    if (!Storage.openFileForWrite("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
+  const auto& coverImageHref = bookMetadataCache->coreMetadata.coverItemHref;
+  const auto hasExtension = [&](const std::string& extension) {
+    return coverImageHref.length() > extension.length() &&
+           coverImageHref.compare(coverImageHref.length() - extension.length(), extension.length(), extension) == 0;
+  };
+  const bool isJpg = hasExtension(".jpg") || hasExtension(".jpeg");
+  const bool isPng = hasExtension(".png");
+  if (!isJpg && !isPng) {
+    if (coverImageHref.empty()) {
+      LOG_ERR("EBP", "No known cover image");
+    } else {
+      LOG_ERR("EBP", "Cover image is not a supported format, skipping");
     }
-    readItemContentsToStream(coverImageHref, coverJpg, 1024);
-    coverJpg.close();
-
-    if (!Storage.openFileForRead("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
+    // Write empty thumbnail files to avoid generation attempts in the future
+    for (int i = 0; i < count; i++) {
+      if (isThumb[i] && Storage.openFileForWrite("EBP", paths[i], files[i])) {
+        files[i].close();
+      }
     }
+    return false;
+  }
 
-    FsFile thumbBmp;
-    if (!Storage.openFileForWrite("EBP", getThumbBmpPath(height), thumbBmp)) {
-      coverJpg.close();
-      return false;
-    }
-    // Use smaller target size for Continue Reading card (half of screen: 240x400)
-    // Generate 1-bit BMP for fast home screen rendering (no gray passes needed)
-    int THUMB_TARGET_WIDTH = height * 0.6;
-    int THUMB_TARGET_HEIGHT = height;
-    const bool success = JpegToBmpConverter::jpegFileTo1BitBmpStreamWithSize(coverJpg, thumbBmp, THUMB_TARGET_WIDTH,
-                                                                             THUMB_TARGET_HEIGHT);
-    coverJpg.close();
-    thumbBmp.close();
-    Storage.remove(coverJpgTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate thumb BMP from JPG cover image");
-      Storage.remove(getThumbBmpPath(height).c_str());
-    }
-    LOG_DBG("EBP", "Generated thumb BMP from JPG cover image, success: %s", success ? "yes" : "no");
-    return success;
-  } else if (coverImageHref.substr(coverImageHref.length() - 4) == ".png") {
-    LOG_DBG("EBP", "Generating thumb BMP from PNG cover image");
-    const auto coverPngTempPath = getCachePath() + "/.cover.png";
-
-    FsFile coverPng;
-    if (!Storage.openFileForWrite("EBP", coverPngTempPath, coverPng)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverPng, 1024);
-    coverPng.close();
+  LOG_DBG("EBP", "Generating %d BMP(s) from %s cover image", count, isJpg ? "JPG" : "PNG");
+  const auto coverTempPath = getCachePath() + (isJpg ? "/.cover.jpg" : "/.cover.png");
 
-    if (!Storage.openFileForRead("EBP", coverPngTempPath, coverPng)) {
-      return false;
-    }
+  // Extract the cover once for all outputs
+  FsFile coverImage;
+  if (!Storage.openFileForWrite("EBP", coverTempPath, coverImage)) {
+    return false;
+  }
+  readItemContentsToStream(coverImageHref, coverImage, Storage.profile().writeChunk);
+  coverImage.close();
 
-    FsFile thumbBmp;
-    if (!Storage.openFileForWrite("EBP", getThumbBmpPath(height), thumbBmp)) {
-      coverPng.close();
-      return false;
-    }
-    int THUMB_TARGET_WIDTH = height * 0.6;
-    int THUMB_TARGET_HEIGHT = height;
-    const bool success =
-        PngToBmpConverter::pngFileTo1BitBmpStreamWithSize(coverPng, thumbBmp, THUMB_TARGET_WIDTH, THUMB_TARGET_HEIGHT);
-    coverPng.close();
-    thumbBmp.close();
-    Storage.remove(coverPngTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate thumb BMP from PNG cover image");
-      Storage.remove(getThumbBmpPath(height).c_str());
-    }
-    LOG_DBG("EBP", "Generated thumb BMP from PNG cover image, success: %s", success ? "yes" : "no");
-    return success;
-  } else {
-    LOG_ERR("EBP", "Cover image is not a supported format, skipping thumbnail");
+  if (!Storage.openFileForRead("EBP", coverTempPath, coverImage)) {
+    return false;
+  }
+
+  bool success = true;
+  for (int i = 0; i < count && success; i++) {
+    success = Storage.openFileForWrite("EBP", paths[i], files[i]);
   }
+  if (success) {
+    success = isJpg ? JpegToBmpConverter::jpegFileToBmpStreams(coverImage, outputs, count)
+                    : PngToBmpConverter::pngFileToBmpStreams(coverImage, outputs, count);
+  }
+  coverImage.close();
+  Storage.remove(coverTempPath.c_str());
 
-  // Write an empty bmp file to avoid generation attempts in the future
-  FsFile thumbBmp;
-  Storage.openFileForWrite("EBP", getThumbBmpPath(height), thumbBmp);
-  thumbBmp.close();
-  return false;
+  for (int i = 0; i < count; i++) {
+    if (files[i]) {
+      files[i].close();
+      if (!success) Storage.remove(paths[i].c_str());
+    }
+  }
+  if (!success) {
+    LOG_ERR("EBP", "Failed to generate BMP from cover image");
+  }
+  LOG_DBG("EBP", "Generated BMP from cover image, success: %s", success ? "yes" : "no");
+  return success;
 }
 
 uint8_t* Epub::readItemContentsToBytes(const std::string& itemHref, size_t* size, const bool trailingNullByte) const {
@@ -719,7 +778,8 @@ uint8_t* Epub::readItemContentsToBytes(const std::string& itemHref, size_t* size
 
   const std::string path = FsHelpers::normalisePath(itemHref);
 
-  const auto content = ZipFile(filepath).readFileToMemory(path.c_str(), size, trailingNullByte);
+  ZipFile ownZip(filepath, getZipIndexPath());
+  const auto content = (indexingZip ? *indexingZip : ownZip).readFileToMemory(path.c_str(), size, trailingNullByte);
   if (!content) {
     LOG_DBG("EBP", "Failed to read item %s", path.c_str());
     return nullptr;
@@ -735,12 +795,35 @@ bool Epub::readItemContentsToStream(const std::string& itemHref, Print& out, con
   }
 
   const std::string path = FsHelpers::normalisePath(itemHref);
-  return ZipFile(filepath).readFileToStream(path.c_str(), out, chunkSize);
+  ZipFile ownZip(filepath, getZipIndexPath());
+  return (indexingZip ? *indexingZip : ownZip).readFileToStream(path.c_str(), out, chunkSize);
+}
+
+size_t Epub::readItemPrefix(const std::string& itemHref, uint8_t* dest, const size_t maxLen) const {
+  if (itemHref.empty()) {
+    LOG_DBG("EBP", "Failed to read item, empty href");
+    return 0;
+  }
+
+  const std::string path = FsHelpers::normalisePath(itemHref);
+  ZipFile ownZip(filepath, getZipIndexPath());
+  return (indexingZip ? *indexingZip : ownZip).readFilePrefix(path.c_str(), dest, maxLen);
+}
+
+bool Epub::openItemReader(const std::string& itemHref, ZipEntryReader& reader) const {
+  if (itemHref.empty()) {
+    LOG_DBG("EBP", "Failed to open item, empty href");
+    return false;
+  }
+
+  const std::string path = FsHelpers::normalisePath(itemHref);
+  return reader.open(path.c_str());
 }
 
 bool Epub::getItemSize(const std::string& itemHref, size_t* size) const {
   const std::string path = FsHelpers::normalisePath(itemHref);
-  return ZipFile(filepath).getInflatedFileSize(path.c_str(), size);
+  ZipFile ownZip(filepath, getZipIndexPath());
+  return (indexingZip ? *indexingZip : ownZip).getInflatedFileSize(path.c_str(), size);
 }
 
 int Epub::getSpineItemsCount() const {
@@ -750,7 +833,14 @@ int Epub::getSpineItemsCount() const {
   return bookMetadataCache->getSpineCount();
 }
 
-size_t Epub::getCumulativeSpineItemSize(const int spineIndex) const { return getSpineItem(spineIndex).cumulativeSize; }
+size_t Epub::getCumulativeSpineItemSize(const int spineIndex) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    return 0;
+  }
+  // Out of range indices map to the first spine item, as in getSpineItem()
+  const int index = (spineIndex >= 0 && spineIndex < bookMetadataCache->getSpineCount()) ? spineIndex : 0;
+  return bookMetadataCache->getSpineStats(index).cumulativeSize;
+}
 
 BookMetadataCache::SpineEntry Epub::getSpineItem(const int spineIndex) const {
   if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
@@ -780,6 +870,21 @@ BookMetadataCache::TocEntry Epub::getTocItem(const int tocIndex) const {
   return bookMetadataCache->getTocEntry(tocIndex);
 }
 
+bool Epub::getTocItems(const int first, const int count, std::vector<BookMetadataCache::TocEntry>& out) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    LOG_DBG("EBP", "getTocItems called but cache not loaded");
+    return false;
+  }
+  return bookMetadataCache->readTocWindow(first, count, out);
+}
+
+bool Epub::getTocLevels(std::vector<uint8_t>& out) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    return false;
+  }
+  return bookMetadataCache->readTocLevels(out);
+}
+
 int Epub::getTocItemsCount() const {
   if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
     return 0;
@@ -809,13 +914,19 @@ int Epub::getSpineIndexForTocIndex(const int tocIndex) const {
   return spineIndex;
 }
 
-int Epub::getTocIndexForSpineIndex(const int spineIndex) const { return getSpineItem(spineIndex).tocIndex; }
+int Epub::getTocIndexForSpineIndex(const int spineIndex) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    return -1;
+  }
+  const int index = (spineIndex >= 0 && spineIndex < bookMetadataCache->getSpineCount()) ? spineIndex : 0;
+  return bookMetadataCache->getSpineStats(index).tocIndex;
+}
 
 size_t Epub::getBookSize() const {
-  if (!bookMetadataCache || !bookMetadataCache->isLoaded() || bookMetadataCache->getSpineCount() == 0) {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
     return 0;
   }
-  return getCumulativeSpineItemSize(getSpineItemsCount() - 1);
+  return bookMetadataCache->getBookSize();
 }
 
 int Epub::getSpineIndexForTextReference() const {
@@ -833,13 +944,11 @@ int Epub::getSpineIndexForTextReference() const {
     return 0;
   }
 
-  // loop through spine items to get the correct index matching the text href
-  for (size_t i = 0; i < getSpineItemsCount(); i++) {
-    if (getSpineItem(i).href == bookMetadataCache->coreMetadata.textReferenceHref) {
-      LOG_DBG("EBP", "Text reference %s found at index %d", bookMetadataCache->coreMetadata.textReferenceHref.c_str(),
-              i);
-      return i;
-    }
+  const int index = bookMetadataCache->findSpineIndex(bookMetadataCache->coreMetadata.textReferenceHref, true);
+  if (index >= 0) {
+    LOG_DBG("EBP", "Text reference %s found at index %d", bookMetadataCache->coreMetadata.textReferenceHref.c_str(),
+            index);
+    return index;
   }
   // This should not happen, as we checked for empty textReferenceHref earlier
   LOG_DBG("EBP", "Section not found for text reference");
@@ -870,18 +979,6 @@ int Epub::resolveHrefToSpineIndex(const std::string& href) const {
   // Same-file reference (anchor-only)
   if (target.empty()) return -1;
 
-  // Extract just the filename for comparison
-  size_t targetSlash = target.find_last_of('/');
-  std::string targetFilename = (targetSlash != std::string::npos) ? target.substr(targetSlash + 1) : target;
-
-  for (int i = 0; i < getSpineItemsCount(); i++) {
-    const auto& spineHref = getSpineItem(i).href;
-    // Try exact match first
-    if (spineHref == target) return i;
-    // Then filename-only match
-    size_t spineSlash = spineHref.find_last_of('/');
-    std::string spineFilename = (spineSlash != std::string::npos) ? spineHref.substr(spineSlash + 1) : spineHref;
-    if (spineFilename == targetFilename) return i;
-  }
-  return -1;
+  // Links are relative to the chapter they're in, so they are matched by file name; an exact match has the same one
+  return bookMetadataCache->findSpineIndex(target, false);
 }
@@ -8,9 +8,11 @@
 #include <vector>
 
 #include "Epub/BookMetadataCache.h"
+#include "Epub/BookPack.h"
 #include "Epub/css/CssParser.h"
 
 class ZipFile;
+class ZipEntryReader;
 
 class Epub {
   // the ncx file (EPUB 2)
@@ -29,6 +31,15 @@ class Epub {
   std::unique_ptr<CssParser> cssParser;
   // CSS files
   std::vector<std::string> cssFiles;
+  // Archive handle kept open while load() indexes the book; item reads use it instead of opening their own
+  ZipFile* indexingZip = nullptr;
+  // Finished section files of every kept layout, see BookPack
+  std::unique_ptr<BookPack> sectionPack;
+  // Layout of the last getSectionDir() call, so the layout list is only rewritten when the layout changes
+  uint32_t lastSectionLayout = 0;
+  bool hasSectionLayout = false;
+  // Kept layouts, most recently used first, as of the last getSectionDir() call
+  std::vector<uint32_t> sectionLayouts;
 
   bool findContentOpfFile(std::string* contentOpfFile) const;
   bool parseContentOpf(BookMetadataCache::BookMetadata& bookMetadata);
@@ -40,28 +51,69 @@ class Epub {
   explicit Epub(std::string filepath, const std::string& cacheDir) : filepath(std::move(filepath)) {
     // create a cache key based on the filepath
     cachePath = cacheDir + "/epub_" + std::to_string(std::hash<std::string>{}(this->filepath));
+    sectionPack.reset(new BookPack(cachePath + "/sections/book.pack"));
+  }
+  // Cache at a given path rather than the one keyed by filepath. The key is std::hash, which differs between
+  // standard libraries, so a cache built off the device (test/preindex) goes where the device says it looks.
+  struct CacheAt {
+    std::string path;
+  };
+  Epub(std::string filepath, CacheAt cache) : filepath(std::move(filepath)), cachePath(std::move(cache.path)) {
+    sectionPack.reset(new BookPack(cachePath + "/sections/book.pack"));
   }
   ~Epub() = default;
   std::string& getBasePath() { return contentBasePath; }
   bool load(bool buildIfMissing = true, bool skipLoadingCss = false);
   bool clearCache() const;
+  // Re-key the cache for the same book at a new path (after a move or rename), so its indexing work is kept
+  bool moveCache(const std::string& newFilepath) const;
   void setupCacheDir() const;
   const std::string& getCachePath() const;
+  // Central directory index of the EPUB archive, see ZipFile::setIndexPath
+  std::string getZipIndexPath() const;
+  // Measured word widths shared by all section builds, see WordWidthCache
+  std::string getWordWidthCachePath() const;
+  // Preview text of the footnotes in a spine item, see FootnoteStore
+  std::string getFootnoteStorePath(int spineIndex) const;
+  // Section files laid out with the given Section::layoutKey(). The few most recently used layouts are kept side by
+  // side, so switching back to one (another font size, the other orientation) reuses its pages.
+  std::string getSectionDir(uint32_t layoutKey);
+  // Where finished section files end up, keyed by layout and spine index. Section builds write them into
+  // getSectionDir() first.
+  BookPack& getSectionPack() const { return *sectionPack; }
+  // Layouts whose sections are kept, most recently used first; filled in by getSectionDir()
+  const std::vector<uint32_t>& getSectionLayouts() const { return sectionLayouts; }
+  // Page count of every built section under the current layout, see SectionPageCounts
+  std::string getPageCountsPath() const;
   const std::string& getPath() const;
   const std::string& getTitle() const;
   const std::string& getAuthor() const;
   const std::string& getLanguage() const;
+  // Calibre's uuid for the book, if the package declares one
+  const std::string& getUuid() const;
+  // Calibre series name, empty for books outside one
+  const std::string& getSeries() const;
   std::string getCoverBmpPath(bool cropped = false) const;
   bool generateCoverBmp(bool cropped = false) const;
   std::string getThumbBmpPath() const;
   std::string getThumbBmpPath(int height) const;
   bool generateThumbBmp(int height) const;
+  // Writes the missing ones of the fit and cropped covers and the thumbnails of each height from a single decode of
+  // the cover image. True if all the requested files exist afterwards.
+  bool generateCoverBmps(bool fitCover, bool croppedCover, const std::vector<int>& thumbHeights) const;
   uint8_t* readItemContentsToBytes(const std::string& itemHref, size_t* size = nullptr,
                                    bool trailingNullByte = false) const;
   bool readItemContentsToStream(const std::string& itemHref, Print& out, size_t chunkSize) const;
+  // First maxLen bytes of an item, for probing its header. Returns the number of bytes read, 0 on error.
+  size_t readItemPrefix(const std::string& itemHref, uint8_t* dest, size_t maxLen) const;
+  // Open a pull-based reader on an item; the reader must be constructed with getPath() and getZipIndexPath()
+  bool openItemReader(const std::string& itemHref, ZipEntryReader& reader) const;
   bool getItemSize(const std::string& itemHref, size_t* size) const;
   BookMetadataCache::SpineEntry getSpineItem(int spineIndex) const;
   BookMetadataCache::TocEntry getTocItem(int tocIndex) const;
+  // Consecutive TOC entries [first, first + count) in one sequential read, see BookMetadataCache::readTocWindow
+  bool getTocItems(int first, int count, std::vector<BookMetadataCache::TocEntry>& out) const;
+  bool getTocLevels(std::vector<uint8_t>& out) const;
   int getSpineItemsCount() const;
   int getTocItemsCount() const;
   int getSpineIndexForTocIndex(int tocIndex) const;
@@ -9,10 +9,30 @@
 #include "FsHelpers.h"
 
 namespace {
-constexpr uint8_t BOOK_CACHE_VERSION = 5;
+constexpr uint8_t BOOK_CACHE_VERSION = 10;
 constexpr char bookBinFile[] = "/book.bin";
 constexpr char tmpSpineBinFile[] = "/spine.bin.tmp";
 constexpr char tmpTocBinFile[] = "/toc.bin.tmp";
+
+// Start of the file name in an href: everything after the last '/'
+size_t fileNameStart(const std::string& href) {
+  const size_t slash = href.find_last_of('/');
+  return slash == std::string::npos ? 0 : slash + 1;
+}
+
+// Step over one TOC entry (as written by writeTocEntry) without reading its strings, returning its level
+uint8_t skipTocEntry(FsFile& file) {
+  for (int i = 0; i < 3; i++) {
+    uint32_t len;
+    serialization::readPod(file, len);
+    file.seekCur(len);
+  }
+  uint8_t level;
+  int16_t spineIndex;
+  serialization::readPod(file, level);
+  serialization::readPod(file, spineIndex);
+  return level;
+}
 }  // namespace
 
 /* ============= WRITING / BUILDING FUNCTIONS ================ */
@@ -29,7 +49,11 @@ bool BookMetadataCache::beginContentOpfPass() {
   LOG_DBG("BMC", "Beginning content opf pass");
 
   // Open spine file for writing
-  return Storage.openFileForWrite("BMC", cachePath + tmpSpineBinFile, spineFile);
+  if (!Storage.openFileForWrite("BMC", cachePath + tmpSpineBinFile, spineFile)) {
+    return false;
+  }
+  spineFile.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
+  return true;
 }
 
 bool BookMetadataCache::endContentOpfPass() {
@@ -47,29 +71,29 @@ bool BookMetadataCache::beginTocPass() {
     spineFile.close();
     return false;
   }
+  tocFile.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
 
-  if (spineCount >= LARGE_SPINE_THRESHOLD) {
-    spineHrefIndex.clear();
-    spineHrefIndex.reserve(spineCount);
-    spineFile.seek(0);
-    for (int i = 0; i < spineCount; i++) {
-      auto entry = readSpineEntry(spineFile);
-      SpineHrefIndexEntry idx;
-      idx.hrefHash = fnvHash64(entry.href);
-      idx.hrefLen = static_cast<uint16_t>(entry.href.size());
-      idx.spineIndex = static_cast<int16_t>(i);
-      spineHrefIndex.push_back(idx);
-    }
-    std::sort(spineHrefIndex.begin(), spineHrefIndex.end(),
-              [](const SpineHrefIndexEntry& a, const SpineHrefIndexEntry& b) {
-                return a.hrefHash < b.hrefHash || (a.hrefHash == b.hrefHash && a.hrefLen < b.hrefLen);
-              });
-    spineFile.seek(0);
-    useSpineHrefIndex = true;
-    LOG_DBG("BMC", "Using fast index for %d spine items", spineCount);
-  } else {
-    useSpineHrefIndex = false;
+  // Hash index of the spine hrefs, so resolving a TOC entry's spine item is a binary search rather than a pass over
+  // the spine file. Ties keep spine order, so an href listed twice resolves to its first spine item.
+  spineHrefIndex.clear();
+  spineHrefIndex.reserve(spineCount);
+  spineFile.seek(0);
+  for (int i = 0; i < spineCount; i++) {
+    auto entry = readSpineEntry(spineFile);
+    SpineHrefIndexEntry idx;
+    idx.hrefHash = fnvHash64(entry.href);
+    idx.hrefLen = static_cast<uint16_t>(entry.href.size());
+    idx.spineIndex = static_cast<int16_t>(i);
+    spineHrefIndex.push_back(idx);
   }
+  std::sort(spineHrefIndex.begin(), spineHrefIndex.end(),
+            [](const SpineHrefIndexEntry& a, const SpineHrefIndexEntry& b) {
+              return a.hrefHash < b.hrefHash || (a.hrefHash == b.hrefHash && a.hrefLen < b.hrefLen) ||
+                     (a.hrefHash == b.hrefHash && a.hrefLen == b.hrefLen && a.spineIndex < b.spineIndex);
+            });
+  spineFile.seek(0);
+
+  spineToTocIndex.assign(spineCount, -1);
 
   return true;
 }
@@ -80,7 +104,6 @@ bool BookMetadataCache::endTocPass() {
 
   spineHrefIndex.clear();
   spineHrefIndex.shrink_to_fit();
-  useSpineHrefIndex = false;
 
   return true;
 }
@@ -96,11 +119,12 @@ bool BookMetadataCache::endWrite() {
   return true;
 }
 
-bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMetadata& metadata) {
+bool BookMetadataCache::buildBookBin(ZipFile& zip, const BookMetadata& metadata) {
   // Open all three files, writing to meta, reading from spine and toc
   if (!Storage.openFileForWrite("BMC", cachePath + bookBinFile, bookFile)) {
     return false;
   }
+  bookFile.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
 
   if (!Storage.openFileForRead("BMC", cachePath + tmpSpineBinFile, spineFile)) {
     bookFile.close();
@@ -113,17 +137,21 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     return false;
   }
 
-  constexpr uint32_t headerASize =
-      sizeof(BOOK_CACHE_VERSION) + /* LUT Offset */ sizeof(uint32_t) + sizeof(spineCount) + sizeof(tocCount);
+  constexpr uint32_t headerASize = sizeof(BOOK_CACHE_VERSION) + /* LUT Offset */ sizeof(uint32_t) +
+                                   /* Spine stats offset */ sizeof(uint32_t) + sizeof(spineCount) + sizeof(tocCount);
   const uint32_t metadataSize = metadata.title.size() + metadata.author.size() + metadata.language.size() +
                                 metadata.coverItemHref.size() + metadata.textReferenceHref.size() +
-                                sizeof(uint32_t) * 5;
+                                metadata.uuid.size() + metadata.series.size() + sizeof(uint32_t) * 7;
   const uint32_t lutSize = sizeof(uint32_t) * spineCount + sizeof(uint32_t) * tocCount;
   const uint32_t lutOffset = headerASize + metadataSize;
+  // Spine and TOC entries are copied verbatim from the temp files, so the stats table after them lands here
+  const uint32_t spineStatsOffset =
+      lutOffset + lutSize + static_cast<uint32_t>(spineFile.size()) + static_cast<uint32_t>(tocFile.size());
 
   // Header A
   serialization::writePod(bookFile, BOOK_CACHE_VERSION);
   serialization::writePod(bookFile, lutOffset);
+  serialization::writePod(bookFile, spineStatsOffset);
   serialization::writePod(bookFile, spineCount);
   serialization::writePod(bookFile, tocCount);
   // Metadata
@@ -132,6 +160,8 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   serialization::writeString(bookFile, metadata.language);
   serialization::writeString(bookFile, metadata.coverItemHref);
   serialization::writeString(bookFile, metadata.textReferenceHref);
+  serialization::writeString(bookFile, metadata.uuid);
+  serialization::writeString(bookFile, metadata.series);
 
   // Loop through spine entries, writing LUT positions
   spineFile.seek(0);
@@ -145,28 +175,19 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   tocFile.seek(0);
   for (int i = 0; i < tocCount; i++) {
     uint32_t pos = tocFile.position();
-    auto tocEntry = readTocEntry(tocFile);
+    skipTocEntry(tocFile);
     serialization::writePod(bookFile, pos + lutOffset + lutSize + static_cast<uint32_t>(spineFile.position()));
   }
 
   // LUTs complete
   // Loop through spines from spine file matching up TOC indexes, calculating cumulative size and writing to book.bin
 
-  // Build spineIndex->tocIndex mapping in one pass (O(n) instead of O(n*m))
-  std::vector<int16_t> spineToTocIndex(spineCount, -1);
-  tocFile.seek(0);
-  for (int j = 0; j < tocCount; j++) {
-    auto tocEntry = readTocEntry(tocFile);
-    if (tocEntry.spineIndex >= 0 && tocEntry.spineIndex < spineCount) {
-      if (spineToTocIndex[tocEntry.spineIndex] == -1) {
-        spineToTocIndex[tocEntry.spineIndex] = static_cast<int16_t>(j);
-      }
-    }
-  }
+  // spineToTocIndex was filled in while the TOC was built
+  spineToTocIndex.resize(spineCount, -1);
 
-  ZipFile zip(epubPath);
-  // Pre-open zip file to speed up size calculations
-  if (!zip.open()) {
+  // The caller's handle, kept open across indexing, so sizes come from the central directory index it built
+  const bool zipWasOpen = zip.isOpen();
+  if (!zipWasOpen && !zip.open()) {
     LOG_ERR("BMC", "Could not open EPUB zip for size calculations");
     bookFile.close();
     spineFile.close();
@@ -176,8 +197,8 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   // NOTE: We intentionally skip calling loadAllFileStatSlims() here.
   // For large EPUBs (2000+ chapters), pre-loading all ZIP central directory entries
   // into memory causes OOM crashes on ESP32-C3's limited ~380KB RAM.
-  // Instead, for large books we use a one-pass batch lookup that scans the ZIP
-  // central directory once and matches against spine targets using hash comparison.
+  // Instead, for large books we use a one-pass batch lookup that walks the ZIP
+  // central directory (or its index) once and matches against spine targets using hash comparison.
   // This is O(n*log(m)) instead of O(n*m) while avoiding memory exhaustion.
   // See: https://github.com/crosspoint-reader/crosspoint-reader/issues/134
 
@@ -217,6 +238,9 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   }
 
   uint32_t cumSize = 0;
+  std::vector<uint32_t> cumulativeSizes(spineCount, 0);
+  std::vector<SpineNameRecord> spineNames;
+  spineNames.reserve(spineCount);
   spineFile.seek(0);
   int lastSpineTocIndex = -1;
   for (int i = 0; i < spineCount; i++) {
@@ -233,6 +257,11 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     }
     lastSpineTocIndex = spineEntry.tocIndex;
 
+    const size_t nameStart = fileNameStart(spineEntry.href);
+    const size_t nameLen = spineEntry.href.size() - nameStart;
+    spineNames.push_back({ZipFile::fnvHash64(spineEntry.href.data() + nameStart, nameLen),
+                          static_cast<uint16_t>(nameLen), static_cast<int16_t>(i), 0});
+
     size_t itemSize = 0;
     if (useBatchSizes) {
       itemSize = spineSizes[i];
@@ -251,18 +280,52 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
 
     cumSize += itemSize;
     spineEntry.cumulativeSize = cumSize;
+    cumulativeSizes[i] = cumSize;
+    spineToTocIndex[i] = spineEntry.tocIndex;
 
     // Write out spine data to book.bin
     writeSpineEntry(bookFile, spineEntry);
   }
-  // Close opened zip file
-  zip.close();
+  if (!zipWasOpen) {
+    zip.close();
+  }
+
+  // TOC entries go into book.bin unchanged, so they are copied as bytes
+  tocFile.seek(0);
+  uint8_t copyBuffer[512];
+  while (tocFile.available()) {
+    const int read = tocFile.read(copyBuffer, sizeof(copyBuffer));
+    if (read <= 0) {
+      break;
+    }
+    bookFile.write(copyBuffer, read);
+  }
+
+  // Fixed-stride spine stats table
+  if (bookFile.position() != spineStatsOffset) {
+    LOG_ERR("BMC", "Spine stats offset mismatch (%u != %u)", static_cast<uint32_t>(bookFile.position()),
+            spineStatsOffset);
+  }
+  for (int i = 0; i < spineCount; i++) {
+    const SpineStats stats = {cumulativeSizes[i], spineToTocIndex[i], 0};
+    serialization::writePod(bookFile, stats);
+  }
+  spineToTocIndex.clear();
+  spineToTocIndex.shrink_to_fit();
 
-  // Loop through toc entries from toc file writing to book.bin
+  // TOC levels table (one byte per entry), right after the spine stats
   tocFile.seek(0);
   for (int i = 0; i < tocCount; i++) {
-    auto tocEntry = readTocEntry(tocFile);
-    writeTocEntry(bookFile, tocEntry);
+    serialization::writePod(bookFile, skipTocEntry(tocFile));
+  }
+
+  // Spine name index, right after the TOC levels
+  std::sort(spineNames.begin(), spineNames.end(), [](const SpineNameRecord& a, const SpineNameRecord& b) {
+    return a.nameHash < b.nameHash || (a.nameHash == b.nameHash && a.nameLen < b.nameLen) ||
+           (a.nameHash == b.nameHash && a.nameLen == b.nameLen && a.spineIndex < b.spineIndex);
+  });
+  for (const auto& record : spineNames) {
+    serialization::writePod(bookFile, record);
   }
 
   bookFile.close();
@@ -314,45 +377,42 @@ void BookMetadataCache::createSpineEntry(const std::string& href) {
   spineCount++;
 }
 
+void BookMetadataCache::appendTocTitle(std::string& title, const char* text, size_t len) {
+  if (title.size() >= MAX_TOC_TITLE_BYTES) {
+    return;
+  }
+  if (title.size() + len > MAX_TOC_TITLE_BYTES) {
+    len = MAX_TOC_TITLE_BYTES - title.size();
+    // Don't cut a UTF-8 sequence: back up to the lead byte of the first character that doesn't fit
+    while (len > 0 && (static_cast<uint8_t>(text[len]) & 0xC0) == 0x80) {
+      len--;
+    }
+  }
+  title.append(text, len);
+}
+
 void BookMetadataCache::createTocEntry(const std::string& title, const std::string& href, const std::string& anchor,
                                        const uint8_t level) {
-  if (!buildMode || !tocFile || !spineFile) {
+  if (!buildMode || !tocFile) {
     LOG_DBG("BMC", "createTocEntry called but not in build mode");
     return;
   }
 
   int16_t spineIndex = -1;
-
-  if (useSpineHrefIndex) {
-    uint64_t targetHash = fnvHash64(href);
-    uint16_t targetLen = static_cast<uint16_t>(href.size());
-
-    auto it =
-        std::lower_bound(spineHrefIndex.begin(), spineHrefIndex.end(), SpineHrefIndexEntry{targetHash, targetLen, 0},
-                         [](const SpineHrefIndexEntry& a, const SpineHrefIndexEntry& b) {
-                           return a.hrefHash < b.hrefHash || (a.hrefHash == b.hrefHash && a.hrefLen < b.hrefLen);
-                         });
-
-    while (it != spineHrefIndex.end() && it->hrefHash == targetHash && it->hrefLen == targetLen) {
-      spineIndex = it->spineIndex;
-      break;
-    }
-
-    if (spineIndex == -1) {
-      LOG_DBG("BMC", "createTocEntry: Could not find spine item for TOC href %s", href.c_str());
+  const uint64_t targetHash = fnvHash64(href);
+  const auto targetLen = static_cast<uint16_t>(href.size());
+  const auto it =
+      std::lower_bound(spineHrefIndex.begin(), spineHrefIndex.end(), SpineHrefIndexEntry{targetHash, targetLen, -1},
+                       [](const SpineHrefIndexEntry& a, const SpineHrefIndexEntry& b) {
+                         return a.hrefHash < b.hrefHash || (a.hrefHash == b.hrefHash && a.hrefLen < b.hrefLen);
+                       });
+  if (it != spineHrefIndex.end() && it->hrefHash == targetHash && it->hrefLen == targetLen) {
+    spineIndex = it->spineIndex;
+    if (spineToTocIndex[spineIndex] == -1) {
+      spineToTocIndex[spineIndex] = static_cast<int16_t>(tocCount);
     }
   } else {
-    spineFile.seek(0);
-    for (int i = 0; i < spineCount; i++) {
-      auto spineEntry = readSpineEntry(spineFile);
-      if (spineEntry.href == href) {
-        spineIndex = static_cast<int16_t>(i);
-        break;
-      }
-    }
-    if (spineIndex == -1) {
-      LOG_DBG("BMC", "createTocEntry: Could not find spine item for TOC href %s", href.c_str());
-    }
+    LOG_DBG("BMC", "createTocEntry: Could not find spine item for TOC href %s", href.c_str());
   }
 
   const TocEntry entry(title, href, anchor, level, spineIndex);
@@ -366,6 +426,8 @@ bool BookMetadataCache::load() {
   if (!Storage.openFileForRead("BMC", cachePath + bookBinFile, bookFile)) {
     return false;
   }
+  // Spine and TOC entries are read field by field; a window turns most of those reads into a memcpy
+  bookFile.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
 
   uint8_t version;
   serialization::readPod(bookFile, version);
@@ -376,6 +438,7 @@ bool BookMetadataCache::load() {
   }
 
   serialization::readPod(bookFile, lutOffset);
+  serialization::readPod(bookFile, spineStatsOffset);
   serialization::readPod(bookFile, spineCount);
   serialization::readPod(bookFile, tocCount);
 
@@ -384,8 +447,12 @@ bool BookMetadataCache::load() {
   serialization::readString(bookFile, coreMetadata.language);
   serialization::readString(bookFile, coreMetadata.coverItemHref);
   serialization::readString(bookFile, coreMetadata.textReferenceHref);
+  serialization::readString(bookFile, coreMetadata.uuid);
+  serialization::readString(bookFile, coreMetadata.series);
 
   loaded = true;
+  spineStatsBlockStart = -1;
+  bookSize = spineCount > 0 ? getSpineStats(spineCount - 1).cumulativeSize : 0;
   LOG_DBG("BMC", "Loaded cache data: %d spine, %d TOC entries", spineCount, tocCount);
   return true;
 }
@@ -409,6 +476,114 @@ BookMetadataCache::SpineEntry BookMetadataCache::getSpineEntry(const int index)
   return readSpineEntry(bookFile);
 }
 
+int BookMetadataCache::findSpineIndex(const std::string& href, const bool exactPath) {
+  if (!loaded || spineCount == 0) {
+    return -1;
+  }
+
+  const size_t nameStart = fileNameStart(href);
+  const size_t nameLen = href.size() - nameStart;
+  const uint64_t nameHash = ZipFile::fnvHash64(href.data() + nameStart, nameLen);
+  const uint32_t indexOffset = spineStatsOffset + spineCount * sizeof(SpineStats) + tocCount;
+  const auto readRecord = [this, indexOffset](const int slot, SpineNameRecord& record) {
+    bookFile.seek(indexOffset + slot * sizeof(SpineNameRecord));
+    return bookFile.read(&record, sizeof(record)) == static_cast<int>(sizeof(record));
+  };
+
+  // First record with this name, which is the lowest spine index carrying it
+  int lo = 0;
+  int hi = spineCount;
+  SpineNameRecord record;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (!readRecord(mid, record)) {
+      LOG_ERR("BMC", "Failed to read spine name index");
+      return -1;
+    }
+    if (record.nameHash < nameHash || (record.nameHash == nameHash && record.nameLen < nameLen)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  // Confirm against the stored href, which also steps past hash collisions
+  for (int slot = lo; slot < spineCount && readRecord(slot, record); slot++) {
+    if (record.nameHash != nameHash || record.nameLen != nameLen) {
+      break;
+    }
+    const std::string spineHref = getSpineEntry(record.spineIndex).href;
+    if (exactPath ? spineHref == href
+                  : spineHref.compare(fileNameStart(spineHref), std::string::npos, href, nameStart) == 0) {
+      return record.spineIndex;
+    }
+  }
+  return -1;
+}
+
+BookMetadataCache::SpineStats BookMetadataCache::getSpineStats(const int index) {
+  if (!loaded || index < 0 || index >= static_cast<int>(spineCount)) {
+    return {0, -1, 0};
+  }
+
+  const int blockStart = index - index % SPINE_STATS_BLOCK;
+  if (blockStart != spineStatsBlockStart) {
+    const int records = std::min(SPINE_STATS_BLOCK, static_cast<int>(spineCount) - blockStart);
+    const size_t bytes = records * sizeof(SpineStats);
+    bookFile.seek(spineStatsOffset + blockStart * sizeof(SpineStats));
+    if (bookFile.read(spineStatsBlock, bytes) != static_cast<int>(bytes)) {
+      LOG_ERR("BMC", "Failed to read spine stats block at %d", blockStart);
+      spineStatsBlockStart = -1;
+      return {0, -1, 0};
+    }
+    spineStatsBlockStart = blockStart;
+  }
+  return spineStatsBlock[index - blockStart];
+}
+
+bool BookMetadataCache::readTocWindow(const int first, const int count, std::vector<TocEntry>& out) {
+  if (!loaded || first < 0 || count < 0 || first + count > static_cast<int>(tocCount)) {
+    return false;
+  }
+  out.resize(count);
+  if (count == 0) {
+    return true;
+  }
+
+  // TOC entries are stored back to back in index order, so one LUT lookup positions the whole window
+  bookFile.seek(lutOffset + sizeof(uint32_t) * spineCount + sizeof(uint32_t) * first);
+  uint32_t tocEntryPos;
+  serialization::readPod(bookFile, tocEntryPos);
+  bookFile.seek(tocEntryPos);
+  for (auto& entry : out) {
+    serialization::readString(bookFile, entry.title);
+    serialization::readString(bookFile, entry.href);
+    serialization::readString(bookFile, entry.anchor);
+    serialization::readPod(bookFile, entry.level);
+    serialization::readPod(bookFile, entry.spineIndex);
+  }
+  return true;
+}
+
+bool BookMetadataCache::readTocLevels(std::vector<uint8_t>& out) {
+  out.clear();
+  if (!loaded) {
+    return false;
+  }
+  out.resize(tocCount);
+  if (tocCount == 0) {
+    return true;
+  }
+
+  bookFile.seek(spineStatsOffset + spineCount * sizeof(SpineStats));
+  if (bookFile.read(out.data(), tocCount) != static_cast<int>(tocCount)) {
+    LOG_ERR("BMC", "Failed to read TOC levels");
+    out.clear();
+    return false;
+  }
+  return true;
+}
+
 BookMetadataCache::TocEntry BookMetadataCache::getTocEntry(const int index) {
   if (!loaded) {
     LOG_ERR("BMC", "getTocEntry called but cache not loaded");
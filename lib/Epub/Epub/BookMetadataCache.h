@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+class ZipFile;
+
 class BookMetadataCache {
  public:
   struct BookMetadata {
@@ -14,6 +16,8 @@ class BookMetadataCache {
     std::string language;
     std::string coverItemHref;
     std::string textReferenceHref;
+    std::string uuid;
+    std::string series;
   };
 
   struct SpineEntry {
@@ -26,6 +30,24 @@ class BookMetadataCache {
         : href(std::move(href)), cumulativeSize(cumulativeSize), tocIndex(tocIndex) {}
   };
 
+  // Fixed-stride per-spine record in book.bin, for the fields read on every page turn
+  struct SpineStats {
+    uint32_t cumulativeSize;
+    int16_t tocIndex;
+    uint16_t reserved;
+  };
+  static_assert(sizeof(SpineStats) == 8, "SpineStats is stored as-is in book.bin");
+
+  // Spine name index in book.bin, after the TOC levels: one record per spine item, sorted by the hash of the href's
+  // file name, then by spine index
+  struct SpineNameRecord {
+    uint64_t nameHash;  // FNV-1a 64-bit hash of the part after the last '/'
+    uint16_t nameLen;
+    int16_t spineIndex;
+    uint32_t reserved;
+  };
+  static_assert(sizeof(SpineNameRecord) == 16, "SpineNameRecord is stored as-is in book.bin");
+
   struct TocEntry {
     std::string title;
     std::string href;
@@ -44,7 +66,9 @@ class BookMetadataCache {
 
  private:
   std::string cachePath;
-  size_t lutOffset;
+  uint32_t lutOffset;
+  uint32_t spineStatsOffset = 0;
+  uint32_t bookSize = 0;
   uint16_t spineCount;
   uint16_t tocCount;
   bool loaded;
@@ -55,17 +79,23 @@ class BookMetadataCache {
   FsFile spineFile;
   FsFile tocFile;
 
-  // Index for fast href→spineIndex lookup (used only for large EPUBs)
+  // Index for fast href→spineIndex lookup while the TOC is built
   struct SpineHrefIndexEntry {
     uint64_t hrefHash;  // FNV-1a 64-bit hash
     uint16_t hrefLen;   // length for collision reduction
     int16_t spineIndex;
   };
   std::vector<SpineHrefIndexEntry> spineHrefIndex;
-  bool useSpineHrefIndex = false;
+  // First TOC entry of each spine item, filled in as TOC entries are created and consumed by buildBookBin
+  std::vector<int16_t> spineToTocIndex;
 
   static constexpr uint16_t LARGE_SPINE_THRESHOLD = 400;
 
+  // Read-through cache of one aligned block of SpineStats records
+  static constexpr int SPINE_STATS_BLOCK = 32;
+  SpineStats spineStatsBlock[SPINE_STATS_BLOCK] = {};
+  int spineStatsBlockStart = -1;
+
   // FNV-1a 64-bit hash function
   static uint64_t fnvHash64(const std::string& s) {
     uint64_t hash = 14695981039346656037ull;
@@ -88,6 +118,11 @@ class BookMetadataCache {
       : cachePath(std::move(cachePath)), lutOffset(0), spineCount(0), tocCount(0), loaded(false), buildMode(false) {}
   ~BookMetadataCache() = default;
 
+  // TOC titles are kept to this many bytes, so the parsers collect them in a fixed buffer however large the TOC
+  static constexpr size_t MAX_TOC_TITLE_BYTES = 256;
+  // Append to a TOC title being collected, dropping what goes past MAX_TOC_TITLE_BYTES at a character boundary
+  static void appendTocTitle(std::string& title, const char* text, size_t len);
+
   // Building phase (stream to disk immediately)
   bool beginWrite();
   bool beginContentOpfPass();
@@ -100,12 +135,24 @@ class BookMetadataCache {
   bool cleanupTmpFiles() const;
 
   // Post-processing to update mappings and sizes
-  bool buildBookBin(const std::string& epubPath, const BookMetadata& metadata);
+  bool buildBookBin(ZipFile& zip, const BookMetadata& metadata);
 
   // Reading phase (read mode)
   bool load();
   SpineEntry getSpineEntry(int index);
   TocEntry getTocEntry(int index);
+  // Allocation-free access to the hot spine fields; out of range indices return an empty record
+  SpineStats getSpineStats(int index);
+  // Lowest spine index whose href has the same file name as href, or with exactPath the same whole href. A binary
+  // search of the spine name index, so resolving a link doesn't walk the spine. -1 if there is none.
+  int findSpineIndex(const std::string& href, bool exactPath);
+  // Read `count` consecutive TOC entries starting at `first` with a single seek. Entries already in `out` are reused
+  // so their string buffers don't have to be reallocated.
+  bool readTocWindow(int first, int count, std::vector<TocEntry>& out);
+  // The level of every TOC entry, one byte each
+  bool readTocLevels(std::vector<uint8_t>& out);
+  // Cumulative size of the last spine item
+  size_t getBookSize() const { return bookSize; }
   int getSpineCount() const { return spineCount; }
   int getTocCount() const { return tocCount; }
   bool isLoaded() const { return loaded; }
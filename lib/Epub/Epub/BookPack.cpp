@@ -0,0 +1,391 @@
+#include "BookPack.h"
+
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr char PACK_MAGIC[4] = {'C', 'P', 'P', 'K'};
+constexpr char RECORD_MAGIC[4] = {'C', 'P', 'R', 'C'};
+constexpr char INDEX_MAGIC[4] = {'C', 'P', 'I', 'X'};
+constexpr uint8_t PACK_VERSION = 1;
+constexpr uint32_t PACK_HEADER_SIZE = 8;  // Magic, version, three reserved bytes
+// Below this much dead data a rewrite costs more card time than the space is worth
+constexpr uint32_t MIN_COMPACT_BYTES = 64 * 1024;
+
+struct RecordHeader {
+  char magic[4];
+  uint8_t type;
+  uint8_t live;  // Cleared in place when the entry is replaced or removed
+  uint16_t id;
+  uint32_t group;
+  uint32_t size;  // Bytes following the header
+};
+static_assert(sizeof(RecordHeader) == 16, "Record header layout is part of the file format");
+
+struct IndexFooter {
+  uint32_t count;
+  uint32_t indexOffset;
+  char magic[4];
+};
+
+class PackLock {
+ public:
+  explicit PackLock(SemaphoreHandle_t mutex) : mutex(mutex) { xSemaphoreTake(mutex, portMAX_DELAY); }
+  ~PackLock() { xSemaphoreGive(mutex); }
+  PackLock(const PackLock&) = delete;
+  PackLock& operator=(const PackLock&) = delete;
+
+ private:
+  SemaphoreHandle_t mutex;
+};
+
+bool writeHeader(FsFile& file) {
+  uint8_t header[PACK_HEADER_SIZE] = {};
+  memcpy(header, PACK_MAGIC, sizeof(PACK_MAGIC));
+  header[sizeof(PACK_MAGIC)] = PACK_VERSION;
+  return file.seekSet(0) && file.write(header, sizeof(header)) == sizeof(header);
+}
+
+// Copies size bytes from the current position of source to the current position of target
+bool copyBytes(FsFile& source, FsFile& target, size_t size) {
+  const size_t chunkSize = Storage.profile().writeChunk;
+  auto* chunk = static_cast<uint8_t*>(malloc(chunkSize));
+  if (!chunk) {
+    LOG_ERR("PAK", "Not enough memory for a %u byte copy buffer", static_cast<unsigned>(chunkSize));
+    return false;
+  }
+  bool ok = true;
+  while (ok && size > 0) {
+    const int n = source.read(chunk, std::min(chunkSize, size));
+    ok = n > 0 && target.write(chunk, n) == static_cast<size_t>(n);
+    size -= ok ? n : 0;
+  }
+  free(chunk);
+  return ok;
+}
+}  // namespace
+
+BookPack::BookPack(std::string path) : path(std::move(path)), mutex(xSemaphoreCreateMutex()) {}
+
+BookPack::~BookPack() { vSemaphoreDelete(mutex); }
+
+void BookPack::load() {
+  loaded = true;
+  entries.clear();
+  dataEnd = 0;
+  deadBytes = 0;
+  packSize = 0;
+
+  FsFile file;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("PAK", path, file)) {
+    return;
+  }
+  const size_t size = file.size();
+  if (size == 0) {
+    file.close();
+    return;
+  }
+  uint8_t header[PACK_HEADER_SIZE];
+  if (size < PACK_HEADER_SIZE || file.read(header, sizeof(header)) != sizeof(header) ||
+      memcmp(header, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header[sizeof(PACK_MAGIC)] != PACK_VERSION) {
+    file.close();
+    LOG_ERR("PAK", "Unknown pack format, dropping %s", path.c_str());
+    Storage.remove(path.c_str());
+    return;
+  }
+  if (!readIndex(file, size)) {
+    scanRecords(file, size);
+  }
+  file.close();
+  packSize = size;
+
+  uint32_t liveBytes = 0;
+  for (const Entry& entry : entries) {
+    liveBytes += sizeof(RecordHeader) + entry.size;
+  }
+  deadBytes = dataEnd - PACK_HEADER_SIZE - std::min(liveBytes, dataEnd - PACK_HEADER_SIZE);
+  LOG_DBG("PAK", "Loaded %u entries of %s, %lu dead bytes", static_cast<unsigned>(entries.size()), path.c_str(),
+          static_cast<unsigned long>(deadBytes));
+}
+
+bool BookPack::readIndex(FsFile& file, const size_t size) {
+  IndexFooter footer;
+  if (size < PACK_HEADER_SIZE + sizeof(footer) || !file.seekSet(size - sizeof(footer)) ||
+      file.read(&footer, sizeof(footer)) != sizeof(footer) ||
+      memcmp(footer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || footer.indexOffset < PACK_HEADER_SIZE ||
+      footer.indexOffset + static_cast<uint64_t>(footer.count) * sizeof(Entry) + sizeof(footer) != size) {
+    return false;
+  }
+  entries.resize(footer.count);
+  const int bytes = footer.count * sizeof(Entry);
+  if (!file.seekSet(footer.indexOffset) ||
+      (bytes > 0 && file.read(reinterpret_cast<uint8_t*>(entries.data()), bytes) != bytes)) {
+    entries.clear();
+    return false;
+  }
+  for (const Entry& entry : entries) {
+    if (entry.offset < PACK_HEADER_SIZE + sizeof(RecordHeader) ||
+        static_cast<uint64_t>(entry.offset) + entry.size > footer.indexOffset) {
+      entries.clear();
+      return false;
+    }
+  }
+  dataEnd = footer.indexOffset;
+  return true;
+}
+
+void BookPack::scanRecords(FsFile& file, const size_t size) {
+  entries.clear();
+  uint32_t offset = PACK_HEADER_SIZE;
+  RecordHeader header;
+  // Stops at the first record that isn't complete, which is where an interrupted append left off
+  while (offset + sizeof(header) <= size && file.seekSet(offset) &&
+         file.read(&header, sizeof(header)) == sizeof(header) &&
+         memcmp(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) == 0 &&
+         offset + sizeof(header) + static_cast<uint64_t>(header.size) <= size) {
+    if (header.live) {
+      entries.push_back({header.type, 0, header.id, header.group, static_cast<uint32_t>(offset + sizeof(header)),
+                         header.size});
+    }
+    offset += sizeof(header) + header.size;
+  }
+  dataEnd = offset;
+  LOG_ERR("PAK", "Index of %s lost, rebuilt %u entries from the records", path.c_str(),
+          static_cast<unsigned>(entries.size()));
+}
+
+int BookPack::find(const Type type, const uint32_t group, const uint16_t id) const {
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].type == type && entries[i].group == group && entries[i].id == id) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+bool BookPack::openForUpdate(FsFile& file) {
+  if (!loaded) {
+    load();
+  }
+  file = Storage.open(path.c_str(), O_RDWR | O_CREAT);
+  if (file && file.size() != packSize) {
+    // Removed or replaced behind our back; go by what is on the card now
+    file.close();
+    load();
+    file = Storage.open(path.c_str(), O_RDWR | O_CREAT);
+  }
+  if (!file) {
+    LOG_ERR("PAK", "Failed to open %s for writing", path.c_str());
+    return false;
+  }
+  if (dataEnd == 0) {
+    if (!writeHeader(file)) {
+      file.close();
+      return false;
+    }
+    dataEnd = PACK_HEADER_SIZE;
+  }
+  return true;
+}
+
+bool BookPack::markDead(FsFile& file, const Entry& entry) {
+  const uint8_t dead = 0;
+  deadBytes += sizeof(RecordHeader) + entry.size;
+  return file.seekSet(entry.offset - sizeof(RecordHeader) + offsetof(RecordHeader, live)) &&
+         file.write(&dead, sizeof(dead)) == sizeof(dead);
+}
+
+bool BookPack::writeIndex(FsFile& file) {
+  IndexFooter footer;
+  footer.count = entries.size();
+  footer.indexOffset = dataEnd;
+  memcpy(footer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  const size_t bytes = entries.size() * sizeof(Entry);
+  const bool ok = file.seekSet(dataEnd) &&
+                  (bytes == 0 || file.write(reinterpret_cast<const uint8_t*>(entries.data()), bytes) == bytes) &&
+                  file.write(&footer, sizeof(footer)) == sizeof(footer) &&
+                  file.truncate(dataEnd + bytes + sizeof(footer));
+  packSize = ok ? dataEnd + bytes + sizeof(footer) : file.size();
+  return ok;
+}
+
+bool BookPack::import(const Type type, const uint32_t group, const uint16_t id, const std::string& sourcePath) {
+  FsFile source;
+  if (!Storage.openFileForRead("PAK", sourcePath, source)) {
+    return false;
+  }
+  const size_t size = source.size();
+
+  bool ok;
+  {
+    PackLock lock(mutex);
+    FsFile file;
+    if (!openForUpdate(file)) {
+      source.close();
+      return false;
+    }
+    const int existing = find(type, group, id);
+    if (existing >= 0) {
+      markDead(file, entries[existing]);
+      entries.erase(entries.begin() + existing);
+    }
+
+    RecordHeader header;
+    memcpy(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    header.type = type;
+    header.live = 1;
+    header.id = id;
+    header.group = group;
+    header.size = size;
+    ok = file.seekSet(dataEnd) && file.write(&header, sizeof(header)) == sizeof(header) &&
+         copyBytes(source, file, size);
+    if (ok) {
+      entries.push_back({type, 0, id, group, static_cast<uint32_t>(dataEnd + sizeof(header)), header.size});
+      dataEnd += sizeof(header) + size;
+    }
+    // A failed copy is overwritten by the index, which still lists the entries from before
+    ok = writeIndex(file) && ok;
+    file.close();
+  }
+  source.close();
+  if (!ok) {
+    LOG_ERR("PAK", "Failed to add %s to %s", sourcePath.c_str(), path.c_str());
+    return false;
+  }
+  Storage.remove(sourcePath.c_str());
+  return true;
+}
+
+bool BookPack::open(const Type type, const uint32_t group, const uint16_t id, FsFile& file) {
+  PackLock lock(mutex);
+  if (!loaded) {
+    load();
+  }
+  // A second pass if the file on the card isn't the one the index was read from
+  for (int attempt = 0; attempt < 2; attempt++) {
+    const int index = find(type, group, id);
+    if (index < 0 || !Storage.openFileForRead("PAK", path, file)) {
+      return false;
+    }
+    if (file.size() == packSize) {
+      return file.restrictTo(entries[index].offset, entries[index].size);
+    }
+    file.close();
+    load();
+  }
+  return false;
+}
+
+bool BookPack::remove(const Type type, const uint32_t group, const uint16_t id) {
+  PackLock lock(mutex);
+  if (!loaded) {
+    load();
+  }
+  if (find(type, group, id) < 0) {
+    return false;
+  }
+  FsFile file;
+  if (!openForUpdate(file)) {
+    return false;
+  }
+  // The index may have been reloaded
+  const int index = find(type, group, id);
+  if (index >= 0) {
+    markDead(file, entries[index]);
+    entries.erase(entries.begin() + index);
+    writeIndex(file);
+  }
+  file.close();
+  return index >= 0;
+}
+
+void BookPack::removeGroup(const uint32_t group) {
+  PackLock lock(mutex);
+  if (!loaded) {
+    load();
+  }
+  const auto inGroup = [group](const Entry& entry) { return entry.group == group; };
+  if (std::none_of(entries.begin(), entries.end(), inGroup)) {
+    return;
+  }
+  FsFile file;
+  if (!openForUpdate(file)) {
+    return;
+  }
+  for (const Entry& entry : entries) {
+    if (inGroup(entry)) {
+      markDead(file, entry);
+    }
+  }
+  entries.erase(std::remove_if(entries.begin(), entries.end(), inGroup), entries.end());
+  writeIndex(file);
+  file.close();
+}
+
+void BookPack::compact() {
+  PackLock lock(mutex);
+  if (!loaded) {
+    load();
+  }
+  if (deadBytes < MIN_COMPACT_BYTES || deadBytes < (dataEnd - PACK_HEADER_SIZE) / 2) {
+    return;
+  }
+
+  // Only logged
+  [[maybe_unused]] const uint32_t start = millis();
+  [[maybe_unused]] const uint32_t oldSize = packSize;
+  const std::string tmpPath = path + ".tmp";
+  FsFile source;
+  FsFile target;
+  if (!Storage.openFileForRead("PAK", path, source)) {
+    return;
+  }
+  if (!Storage.openFileForWrite("PAK", tmpPath, target)) {
+    source.close();
+    return;
+  }
+  bool ok = writeHeader(target);
+  uint32_t end = PACK_HEADER_SIZE;
+  for (Entry& entry : entries) {
+    if (!ok) {
+      break;
+    }
+    RecordHeader header;
+    memcpy(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    header.type = entry.type;
+    header.live = 1;
+    header.id = entry.id;
+    header.group = entry.group;
+    header.size = entry.size;
+    ok = target.write(&header, sizeof(header)) == sizeof(header) && source.seekSet(entry.offset) &&
+         copyBytes(source, target, entry.size);
+    entry.offset = end + sizeof(header);
+    end += sizeof(header) + entry.size;
+  }
+  source.close();
+  if (ok) {
+    dataEnd = end;
+    ok = writeIndex(target);
+  }
+  target.close();
+  // The old file goes first; until the rename the pack is just missing, which only costs rebuilds
+  ok = ok && Storage.remove(path.c_str()) && Storage.rename(tmpPath.c_str(), path.c_str());
+  if (!ok) {
+    LOG_ERR("PAK", "Failed to compact %s", path.c_str());
+    Storage.remove(tmpPath.c_str());
+    loaded = false;
+    return;
+  }
+  deadBytes = 0;
+  LOG_DBG("PAK", "Compacted %s from %lu to %lu bytes in %lu ms", path.c_str(), static_cast<unsigned long>(oldSize),
+          static_cast<unsigned long>(packSize), millis() - start);
+}
+
+void BookPack::forget() {
+  PackLock lock(mutex);
+  loaded = false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Container for a book's finished section files and their landmark sidecars, so a long book cached under a few layouts
+is one file in sections/ instead of hundreds, and clearing, sizing or listing the cache doesn't walk them one by one.
+
+The file is append-only. An entry goes in as a record header and its bytes after the last record, followed by a
+fresh index of the live entries (type, group, id, offset, size) and a footer pointing at it; the next append writes
+over that index. A replaced or removed entry is only flagged dead in its record header, so if an append is cut short
+and the index is lost, scanning the records rebuilds it. compact() reclaims the dead records once they take up half
+of the file.
+
+Entries are built as standalone files and moved in whole with import(), so an interrupted build never leaves a torn
+entry in the pack. open() hands an entry out as a file restricted to its bytes (see HalFile::restrictTo), which reads
+exactly like the standalone file did.
+*/
+class BookPack {
+ public:
+  enum Type : uint8_t { SECTION = 1, LANDMARKS = 2, FLOW = 3 };
+
+  explicit BookPack(std::string path);
+  ~BookPack();
+  BookPack(const BookPack&) = delete;
+  BookPack& operator=(const BookPack&) = delete;
+
+  // Move the file at sourcePath in as the entry (type, group, id), replacing an older one. The source is removed once
+  // the entry is on the card; on failure it is left alone.
+  bool import(Type type, uint32_t group, uint16_t id, const std::string& sourcePath);
+  // Open the entry for reading. False if the pack doesn't hold it.
+  bool open(Type type, uint32_t group, uint16_t id, FsFile& file);
+  // True if the pack held the entry
+  bool remove(Type type, uint32_t group, uint16_t id);
+  // Remove all entries of group, e.g. every section of a layout
+  void removeGroup(uint32_t group);
+  // Rewrite the pack without its dead records if they make up half of it. The pack file is replaced, so no file
+  // handed out by open() may still be open.
+  void compact();
+  // Drop the index read into memory, after the pack file was removed together with its directory
+  void forget();
+
+ private:
+  struct Entry {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t id;
+    uint32_t group;
+    uint32_t offset;  // Of the entry's bytes, right after its record header
+    uint32_t size;
+  };
+
+  std::string path;
+  SemaphoreHandle_t mutex;
+  // Everything below is guarded by the mutex and loaded on first use
+  bool loaded = false;
+  std::vector<Entry> entries;
+  uint32_t dataEnd = 0;    // End of the last record, where the index starts; 0 while there is no pack file
+  uint32_t deadBytes = 0;  // Records flagged dead, headers included
+  uint32_t packSize = 0;   // File size after our last write, to notice the file changing under us
+
+  void load();
+  bool readIndex(FsFile& file, size_t size);
+  void scanRecords(FsFile& file, size_t size);
+  int find(Type type, uint32_t group, uint16_t id) const;
+  bool openForUpdate(FsFile& file);
+  bool markDead(FsFile& file, const Entry& entry);
+  bool writeIndex(FsFile& file);
+};
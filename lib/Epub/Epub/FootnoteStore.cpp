@@ -0,0 +1,61 @@
+#include "FootnoteStore.h"
+
+#include <Logging.h>
+#include <Serialization.h>
+
+#include "Page.h"
+#include "parsers/ChapterHtmlSlimParser.h"
+
+void FootnoteStore::begin() {
+  if (Storage.exists(path.c_str())) {
+    Storage.remove(path.c_str());
+  }
+}
+
+void FootnoteStore::add(const uint32_t idHash, const std::string& text) {
+  if (failed || text.empty()) {
+    return;
+  }
+  if (!file && !Storage.openFileForWrite("FNS", path, file)) {
+    failed = true;
+    return;
+  }
+  serialization::writePod(file, idHash);
+  serialization::writeString(file, text);
+}
+
+void FootnoteStore::finish() {
+  if (file) {
+    file.close();
+  }
+}
+
+bool FootnoteStore::find(const std::string& path, const char* id, std::string& text) {
+  const uint32_t idHash = ChapterHtmlSlimParser::idHash(id);
+  FsFile file;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("FNS", path, file)) {
+    return false;
+  }
+
+  const size_t size = file.size();
+  while (file.position() + sizeof(uint32_t) + sizeof(uint32_t) <= size) {
+    uint32_t recordHash;
+    uint32_t len;
+    serialization::readPod(file, recordHash);
+    serialization::readPod(file, len);
+    if (len > MAX_TEXT_LEN || file.position() + len > size) {
+      LOG_ERR("FNS", "Corrupt footnote store %s", path.c_str());
+      break;
+    }
+    if (recordHash != idHash) {
+      file.seek(file.position() + len);
+      continue;
+    }
+    text.resize(len);
+    const bool ok = len == 0 || file.read(reinterpret_cast<uint8_t*>(&text[0]), len) == static_cast<int>(len);
+    file.close();
+    return ok;
+  }
+  file.close();
+  return false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstdint>
+#include <string>
+
+// Plain text of the footnote and endnote targets in one spine item, captured while the chapter is laid out. A
+// footnote can then be previewed with one small file scan instead of loading and laying out the chapter holding it.
+// Records (id hash, text) are appended as the parser finds them; the file is only created for chapters with notes.
+class FootnoteStore {
+ public:
+  static constexpr size_t MAX_TEXT_LEN = 480;
+
+  explicit FootnoteStore(std::string path) : path(std::move(path)) {}
+  ~FootnoteStore() { finish(); }
+
+  FootnoteStore(const FootnoteStore&) = delete;
+  FootnoteStore& operator=(const FootnoteStore&) = delete;
+
+  // Drop the notes of an earlier build, before the parser starts adding
+  void begin();
+  void add(uint32_t idHash, const std::string& text);
+  void finish();
+
+  // Text of the note with the given element id in the store at path
+  static bool find(const std::string& path, const char* id, std::string& text);
+
+ private:
+  std::string path;
+  FsFile file;
+  bool failed = false;
+};
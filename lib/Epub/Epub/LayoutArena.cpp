@@ -0,0 +1,133 @@
+#include "LayoutArena.h"
+
+#include <cstdlib>
+
+// No logging here: this file is also built into the host-side hyphenation test. A failed block allocation is not
+// fatal anyway, ArenaAllocator falls back to the regular heap.
+
+LayoutArena::~LayoutArena() { release(); }
+
+LayoutArena::Block* LayoutArena::newBlock(const size_t minSize) {
+  const size_t size = minSize > BLOCK_SIZE ? minSize : BLOCK_SIZE;
+  auto* block = static_cast<Block*>(malloc(sizeof(Block) + size));
+  if (!block) {
+    return nullptr;
+  }
+  block->next = nullptr;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+void* LayoutArena::allocate(const size_t bytes, const size_t align) {
+  if (bytes == 0) {
+    return nullptr;
+  }
+
+  // Continue in the current block, then in any retained blocks after it, before asking the heap for more
+  Block* block = current ? current : head;
+  while (block) {
+    const auto base = reinterpret_cast<uintptr_t>(block->data());
+    const uintptr_t start = (base + block->used + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+    if (start + bytes <= base + block->size) {
+      block->used = start + bytes - base;
+      current = block;
+      return reinterpret_cast<void*>(start);
+    }
+    if (!block->next) {
+      break;
+    }
+    block = block->next;
+    block->used = 0;
+  }
+
+  Block* fresh = newBlock(bytes + align);
+  if (!fresh) {
+    return nullptr;
+  }
+  if (block) {
+    block->next = fresh;
+  } else {
+    head = fresh;
+  }
+  current = fresh;
+  return allocate(bytes, align);
+}
+
+void LayoutArena::deallocate(void* ptr, const size_t bytes) {
+  if (!current || !ptr) {
+    return;
+  }
+  auto* p = static_cast<uint8_t*>(ptr);
+  if (p + bytes == current->data() + current->used) {
+    current->used = static_cast<size_t>(p - current->data());
+  }
+}
+
+bool LayoutArena::owns(const void* ptr) const {
+  const auto* p = static_cast<const uint8_t*>(ptr);
+  for (const Block* block = head; block; block = block->next) {
+    if (p >= block->data() && p < block->data() + block->size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+LayoutArena::Mark LayoutArena::mark() const { return {current, current ? current->used : 0}; }
+
+void LayoutArena::rewind(const Mark& mark) {
+  if (!mark.block || (mark.block == head && mark.used == 0)) {
+    // Marked while empty: same as a reset, which also frees any oversized blocks picked up since
+    reset();
+    return;
+  }
+  current = static_cast<Block*>(mark.block);
+  current->used = mark.used;
+}
+
+void LayoutArena::reset() {
+  int retained = 0;
+  Block** link = &head;
+  while (*link) {
+    Block* block = *link;
+    if (retained < MAX_RETAINED_BLOCKS && block->size == BLOCK_SIZE) {
+      block->used = 0;
+      retained++;
+      link = &block->next;
+    } else {
+      *link = block->next;
+      free(block);
+    }
+  }
+  current = head;
+}
+
+void LayoutArena::release() {
+  while (head) {
+    Block* next = head->next;
+    free(head);
+    head = next;
+  }
+  current = nullptr;
+}
+
+void LayoutArena::trim() {
+  if (!current) {
+    release();
+    return;
+  }
+  while (current->next) {
+    Block* next = current->next->next;
+    free(current->next);
+    current->next = next;
+  }
+}
+
+size_t LayoutArena::getAllocatedBytes() const {
+  size_t total = 0;
+  for (const Block* block = head; block; block = block->next) {
+    total += block->size;
+  }
+  return total;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump allocator for the short-lived data produced while laying out a section: line break scratch vectors and the
+// TextBlocks of the page being filled. Individual frees are (mostly) no-ops; everything is released in bulk with
+// reset() or rewind(), and the backing blocks are kept for the next page so indexing doesn't churn the heap with
+// thousands of small allocations.
+class LayoutArena {
+ public:
+  struct Mark {
+    void* block = nullptr;
+    size_t used = 0;
+  };
+
+  LayoutArena() = default;
+  ~LayoutArena();
+
+  LayoutArena(const LayoutArena&) = delete;
+  LayoutArena& operator=(const LayoutArena&) = delete;
+
+  // Returns nullptr only if a new backing block could not be allocated
+  void* allocate(size_t bytes, size_t align);
+  // Gives the memory back only if it is the most recent allocation (the common vector growth/shrink case)
+  void deallocate(void* ptr, size_t bytes);
+  bool owns(const void* ptr) const;
+
+  // Release everything allocated after the mark; blocks stay attached for reuse (a mark taken on an empty arena
+  // behaves like reset())
+  Mark mark() const;
+  void rewind(const Mark& mark);
+  // Release everything and hand all but the first few blocks back to the heap
+  void reset();
+  // Hand every block back to the heap
+  void release();
+  // Hand the blocks after the one in use back to the heap, e.g. after a rewind()
+  void trim();
+
+  size_t getAllocatedBytes() const;
+
+ private:
+  static constexpr size_t BLOCK_SIZE = 4096;
+  static constexpr int MAX_RETAINED_BLOCKS = 2;
+
+  struct Block {
+    Block* next;
+    size_t size;
+    size_t used;
+    uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+  };
+
+  Block* newBlock(size_t minSize);
+
+  Block* head = nullptr;
+  Block* current = nullptr;
+};
+
+// Arenas for one section build. `scratch` is rewound after every paragraph layout. TextBlocks go to `lines()`, which
+// alternates between two arenas per completed page: the line that overflows a page is allocated before the page is
+// handed off, so the arena being reset always belongs to the page before the one just completed.
+struct SectionBuildArenas {
+  LayoutArena scratch;
+  LayoutArena linePages[2];
+  uint8_t currentLinePage = 0;
+
+  LayoutArena& lines() { return linePages[currentLinePage]; }
+  // Call after a page (and with it every TextBlock it referenced) has been handed to completePageFn
+  void pageCompleted() {
+    currentLinePage ^= 1;
+    linePages[currentLinePage].reset();
+  }
+};
+
+// std allocator adaptor; a null arena (or an exhausted heap while growing the arena) falls back to operator new
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(LayoutArena* arena = nullptr) noexcept : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+  T* allocate(const size_t n) {
+    if (arena) {
+      if (void* ptr = arena->allocate(n * sizeof(T), alignof(T))) {
+        return static_cast<T*>(ptr);
+      }
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, const size_t n) noexcept {
+    if (arena && arena->owns(ptr)) {
+      arena->deallocate(ptr, n * sizeof(T));
+      return;
+    }
+    ::operator delete(ptr);
+  }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept {
+    return arena == other.arena;
+  }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+    return arena != other.arena;
+  }
+
+  LayoutArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Sole owner of an object placed with makeArenaUnique(): no control block or reference count, and destroying it
+// hands the memory back the way ArenaAllocator does
+template <typename T>
+struct ArenaDeleter {
+  LayoutArena* arena = nullptr;
+
+  void operator()(T* ptr) const {
+    ptr->~T();
+    ArenaAllocator<T>(arena).deallocate(ptr, 1);
+  }
+};
+
+template <typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDeleter<T>>;
+
+template <typename T, typename... Args>
+ArenaPtr<T> makeArenaUnique(LayoutArena* arena, Args&&... args) {
+  T* ptr = ArenaAllocator<T>(arena).allocate(1);
+  return ArenaPtr<T>(::new (static_cast<void*>(ptr)) T(std::forward<Args>(args)...), ArenaDeleter<T>{arena});
+}
@@ -1,5 +1,7 @@
 #include "Page.h"
 
+#include <AllocProfile.h>
+#include <GfxRenderer.h>
 #include <Logging.h>
 #include <Serialization.h>
 
@@ -7,66 +9,322 @@ void PageLine::render(GfxRenderer& renderer, const int fontId, const int xOffset
   block->render(renderer, fontId, xPos + xOffset, yPos + yOffset);
 }
 
-bool PageLine::serialize(FsFile& file) {
-  serialization::writePod(file, xPos);
-  serialization::writePod(file, yPos);
+void PageImage::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset) {
+  // Images don't use fontId or text rendering
+  imageBlock->render(renderer, xPos + xOffset, yPos + yOffset);
+}
+
+void Page::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset,
+                  const bool imagePreviews) const {
+  for (auto& element : elements) {
+    element->render(renderer, fontId, xOffset, yOffset);
+  }
+  if (!movedLines.empty()) {
+    renderLineRecords(renderer, fontId, xOffset, yOffset, movedLines.data(), movedLines.size(), movedWords.data(),
+                      movedPool.c_str());
+  }
+
+  if (!arena) {
+    return;
+  }
 
-  // serialize TextBlock pointed to by PageLine
-  return block->serialize(file);
+  const char* pool = stringPool();
+  for (uint16_t i = 0; i < imageCount; i++) {
+    const auto& img = imageRecords()[i];
+    ImageBlock block(std::string(pool + img.pathOffset, img.pathLen), img.width, img.height);
+    block.render(renderer, img.xPos + xOffset, img.yPos + yOffset, imagePreviews);
+  }
+
+  renderLineRecords(renderer, fontId, xOffset, yOffset, lineRecords(), lineCount, wordRecords(), pool);
 }
 
-std::unique_ptr<PageLine> PageLine::deserialize(FsFile& file) {
-  int16_t xPos;
-  int16_t yPos;
-  serialization::readPod(file, xPos);
-  serialization::readPod(file, yPos);
+std::vector<ImageBlock> Page::getUncachedImages(const GfxRenderer& renderer) const {
+  std::vector<ImageBlock> images;
+  if (!arena) {
+    return images;
+  }
+  const char* pool = stringPool();
+  for (uint16_t i = 0; i < imageCount; i++) {
+    const auto& img = imageRecords()[i];
+    ImageBlock block(std::string(pool + img.pathOffset, img.pathLen), img.width, img.height);
+    if (!block.isCached(renderer)) {
+      images.push_back(std::move(block));
+    }
+  }
+  return images;
+}
 
-  auto tb = TextBlock::deserialize(file);
-  return std::unique_ptr<PageLine>(new PageLine(std::move(tb), xPos, yPos));
+void Page::renderLineRecords(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset,
+                             const PageLineRecord* lines, const uint16_t lineTotal, const PageWordRecord* words,
+                             const char* pool) {
+  GfxRenderer::TextRunItem run[TextBlock::RUN_CHUNK];
+  for (uint16_t i = 0; i < lineTotal; i++) {
+    const auto& line = lines[i];
+    const int x = line.xPos + xOffset;
+    const int y = line.yPos + yOffset;
+    const uint16_t end = line.firstWord + line.wordCount;
+    for (uint16_t first = line.firstWord; first < end; first += TextBlock::RUN_CHUNK) {
+      const size_t count = std::min<size_t>(TextBlock::RUN_CHUNK, end - first);
+      for (size_t r = 0; r < count; r++) {
+        const PageWordRecord& word = words[first + r];
+        run[r] = {x + word.xPos, pool + word.textOffset, static_cast<EpdFontFamily::Style>(word.style)};
+      }
+      renderer.drawTextRun(fontId, y, run, count);
+    }
+    for (uint16_t w = line.firstWord; w < end; w++) {
+      TextBlock::renderUnderline(renderer, fontId, x + words[w].xPos, y, pool + words[w].textOffset,
+                                 words[w].textLen, static_cast<EpdFontFamily::Style>(words[w].style));
+    }
+  }
 }
 
-void PageImage::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset) {
-  // Images don't use fontId or text rendering
-  imageBlock->render(renderer, xPos + xOffset, yPos + yOffset);
+void Page::addGlyphGroups(const GfxRenderer& renderer, const int fontId, const TextBlock& line, const int16_t xPos,
+                          const int16_t yPos) {
+  const auto& styles = line.getWordStyles();
+  const auto& xpos = line.getWordXpos();
+  size_t firstGray = SIZE_MAX;
+  size_t lastGray = 0;
+  for (size_t i = 0; i < line.wordCount() && i < styles.size(); i++) {
+    const uint8_t fontStyle = styles[i] & (EpdFontFamily::BOLD | EpdFontFamily::ITALIC);
+    glyphGroupMasks[fontStyle] |= renderer.getGlyphGroupMask(fontId, line.getWord(i), styles[i]);
+    if (i < xpos.size() && renderer.isAntiAliased(fontId, styles[i])) {
+      firstGray = std::min(firstGray, i);
+      lastGray = i;
+    }
+  }
+  if (firstGray == SIZE_MAX) {
+    return;
+  }
+
+  // Words are laid out left to right, so the first and last anti-aliased word bound the line. Vertically the line
+  // box gets a quarter line of slack for accents and descenders that reach past it.
+  const int lineHeight = renderer.getLineHeight(fontId);
+  const int right = xPos + xpos[lastGray] + renderer.getTextWidth(fontId, line.getWord(lastGray), styles[lastGray]);
+  grayTextLeft = std::min<int16_t>(grayTextLeft, xPos + xpos[firstGray]);
+  grayTextRight = std::max<int16_t>(grayTextRight, right);
+  grayTextTop = std::min<int16_t>(grayTextTop, yPos - lineHeight / 4);
+  grayTextBottom = std::max<int16_t>(grayTextBottom, yPos + lineHeight + lineHeight / 4);
 }
 
-bool PageImage::serialize(FsFile& file) {
-  serialization::writePod(file, xPos);
-  serialization::writePod(file, yPos);
+bool Page::appendLine(const GfxRenderer& renderer, const int fontId, const Page& source, const uint16_t lineIndex,
+                      const int16_t yPos) {
+  if (lineIndex >= source.lineCount) {
+    return false;
+  }
+  const PageLineRecord& from = source.lineRecords()[lineIndex];
+  const PageWordRecord* sourceWords = source.wordRecords() + from.firstWord;
+  const char* sourcePool = source.stringPool();
+  if (movedWords.size() + from.wordCount > UINT16_MAX) {
+    return false;
+  }
+
+  movedLines.push_back({from.xPos, yPos, static_cast<uint16_t>(movedWords.size()), from.wordCount});
+  int firstGray = -1;
+  int lastGray = -1;
+  for (uint16_t i = 0; i < from.wordCount; i++) {
+    PageWordRecord word = sourceWords[i];
+    const char* text = sourcePool + word.textOffset;
+    if (movedPool.size() + word.textLen + 1 > UINT16_MAX) {
+      LOG_ERR("PGE", "Relayout failed: string pool overflow");
+      return false;
+    }
+    word.textOffset = static_cast<uint16_t>(movedPool.size());
+    movedPool.append(text, word.textLen);
+    movedPool.push_back('\0');
+    movedWords.push_back(word);
+
+    // Same bookkeeping as addGlyphGroups(), from the records instead of the text block
+    const auto style = static_cast<EpdFontFamily::Style>(word.style);
+    glyphGroupMasks[word.style & (EpdFontFamily::BOLD | EpdFontFamily::ITALIC)] |=
+        renderer.getGlyphGroupMask(fontId, text, style);
+    if (renderer.isAntiAliased(fontId, style)) {
+      if (firstGray < 0) {
+        firstGray = i;
+      }
+      lastGray = i;
+    }
+  }
+  if (firstGray < 0) {
+    return true;
+  }
 
-  // serialize ImageBlock
-  return imageBlock->serialize(file);
+  const int lineHeight = renderer.getLineHeight(fontId);
+  const PageWordRecord& last = sourceWords[lastGray];
+  const int right = from.xPos + last.xPos + renderer.getTextWidth(fontId, sourcePool + last.textOffset,
+                                                                  static_cast<EpdFontFamily::Style>(last.style));
+  grayTextLeft = std::min<int16_t>(grayTextLeft, from.xPos + sourceWords[firstGray].xPos);
+  grayTextRight = std::max<int16_t>(grayTextRight, right);
+  grayTextTop = std::min<int16_t>(grayTextTop, yPos - lineHeight / 4);
+  grayTextBottom = std::max<int16_t>(grayTextBottom, yPos + lineHeight + lineHeight / 4);
+  return true;
 }
 
-std::unique_ptr<PageImage> PageImage::deserialize(FsFile& file) {
-  int16_t xPos;
-  int16_t yPos;
-  serialization::readPod(file, xPos);
-  serialization::readPod(file, yPos);
+void Page::prefetchGlyphs(const GfxRenderer& renderer, const int fontId) const {
+  for (uint8_t style = 0; style < GLYPH_GROUP_STYLES; style++) {
+    renderer.prefetchGlyphGroups(fontId, static_cast<EpdFontFamily::Style>(style), glyphGroupMasks[style]);
+  }
+}
 
-  auto ib = ImageBlock::deserialize(file);
-  return std::unique_ptr<PageImage>(new PageImage(std::move(ib), xPos, yPos));
+PageCost Page::getCost() const {
+  PageCost cost;
+  uint32_t glyphs = 0;
+  forEachWord([&glyphs](const char* word, const size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      // Every byte but UTF-8 continuation bytes starts a codepoint
+      glyphs += (static_cast<uint8_t>(word[i]) & 0xC0) != 0x80;
+    }
+  });
+  cost.glyphs = static_cast<uint16_t>(std::min<uint32_t>(glyphs, UINT16_MAX));
+
+  int groups = 0;
+  for (const uint32_t mask : glyphGroupMasks) {
+    groups += __builtin_popcount(mask);
+  }
+  cost.fontGroups = static_cast<uint8_t>(std::min(groups, static_cast<int>(UINT8_MAX)));
+
+  const auto area = [](const int16_t width, const int16_t height) {
+    return width > 0 && height > 0 ? static_cast<uint32_t>(width) * static_cast<uint32_t>(height) : 0;
+  };
+  for (const auto& el : elements) {
+    if (el->getTag() == TAG_PageImage) {
+      const auto& block = static_cast<const PageImage&>(*el).getImageBlock();
+      cost.imageArea += area(block.getWidth(), block.getHeight());
+    }
+  }
+  for (uint16_t i = 0; i < imageCount; i++) {
+    cost.imageArea += area(imageRecords()[i].width, imageRecords()[i].height);
+  }
+
+  if (hasImages()) {
+    cost.flags |= PageCost::HAS_IMAGES;
+  }
+  if (hasGrayContent()) {
+    cost.flags |= PageCost::HAS_GRAY;
+  }
+  return cost;
 }
 
-void Page::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset) const {
-  for (auto& element : elements) {
-    element->render(renderer, fontId, xOffset, yOffset);
+void Page::forEachWord(const FunctionRef<void(const char* word, size_t len)> fn) const {
+  for (const auto& el : elements) {
+    if (el->getTag() == TAG_PageLine) {
+      const auto& line = static_cast<const PageLine&>(*el);
+      if (const auto& block = line.getBlock()) {
+        for (size_t i = 0; i < block->wordCount(); i++) {
+          fn(block->getWord(i), block->getWordLen(i));
+        }
+      }
+    }
+  }
+
+  if (arena) {
+    const char* pool = stringPool();
+    for (uint16_t i = 0; i < wordCount; i++) {
+      fn(pool + wordRecords()[i].textOffset, wordRecords()[i].textLen);
+    }
+  }
+
+  for (const auto& word : movedWords) {
+    fn(movedPool.c_str() + word.textOffset, word.textLen);
   }
 }
 
+std::string Page::getText() const {
+  std::string text;
+  forEachWord([&text](const char* word, const size_t len) {
+    if (!text.empty()) text += ' ';
+    text.append(word, len);
+  });
+  return text;
+}
+
 bool Page::serialize(FsFile& file) const {
-  const uint16_t count = elements.size();
-  serialization::writePod(file, count);
+  // Flatten the elements into the record arrays and string pool, after any lines moved in by appendLine()
+  std::vector<PageLineRecord> lines = movedLines;
+  std::vector<PageWordRecord> words = movedWords;
+  std::vector<PageImageRecord> images;
+  std::string pool = movedPool;
+  lines.reserve(lines.size() + elements.size());
+
+  const auto addString = [&pool](const char* str, const size_t len, uint16_t& outOffset) {
+    if (pool.size() + len + 1 > UINT16_MAX) {
+      return false;
+    }
+    outOffset = static_cast<uint16_t>(pool.size());
+    pool.append(str, len);
+    pool.push_back('\0');
+    return true;
+  };
 
   for (const auto& el : elements) {
-    // Use getTag() method to determine type
-    serialization::writePod(file, static_cast<uint8_t>(el->getTag()));
+    if (el->getTag() == TAG_PageLine) {
+      const auto& block = static_cast<const PageLine&>(*el).getBlock();
+      const size_t blockWordCount = block->wordCount();
+      const auto& wordXpos = block->getWordXpos();
+      const auto& wordStyles = block->getWordStyles();
+      if (blockWordCount != wordXpos.size() || blockWordCount != wordStyles.size()) {
+        LOG_ERR("PGE", "Serialization failed: size mismatch (words=%u, xpos=%u, styles=%u)", blockWordCount,
+                wordXpos.size(), wordStyles.size());
+        return false;
+      }
 
-    if (!el->serialize(file)) {
-      return false;
+      lines.push_back(
+          {el->xPos, el->yPos, static_cast<uint16_t>(words.size()), static_cast<uint16_t>(blockWordCount)});
+      for (size_t i = 0; i < blockWordCount; i++) {
+        PageWordRecord word = {};
+        if (!addString(block->getWord(i), block->getWordLen(i), word.textOffset)) {
+          LOG_ERR("PGE", "Serialization failed: string pool overflow");
+          return false;
+        }
+        word.textLen = block->getWordLen(i);
+        word.xPos = wordXpos[i];
+        word.style = static_cast<uint8_t>(wordStyles[i]);
+        words.push_back(word);
+      }
+    } else if (el->getTag() == TAG_PageImage) {
+      const auto& block = static_cast<const PageImage&>(*el).getImageBlock();
+      PageImageRecord image = {};
+      image.xPos = el->xPos;
+      image.yPos = el->yPos;
+      image.width = block.getWidth();
+      image.height = block.getHeight();
+      image.pathLen = static_cast<uint16_t>(block.getImagePath().size());
+      if (!addString(block.getImagePath().c_str(), block.getImagePath().size(), image.pathOffset)) {
+        LOG_ERR("PGE", "Serialization failed: string pool overflow");
+        return false;
+      }
+      images.push_back(image);
     }
   }
 
+  if (words.size() > UINT16_MAX) {
+    LOG_ERR("PGE", "Serialization failed: too many words (%u)", words.size());
+    return false;
+  }
+
+  serialization::writePod(file, static_cast<uint16_t>(lines.size()));
+  serialization::writePod(file, static_cast<uint16_t>(words.size()));
+  serialization::writePod(file, static_cast<uint16_t>(images.size()));
+  serialization::writePod(file, static_cast<uint16_t>(pool.size()));
+
+  const size_t linesBytes = sizeof(PageLineRecord) * lines.size();
+  const size_t wordsBytes = sizeof(PageWordRecord) * words.size();
+  const size_t imagesBytes = sizeof(PageImageRecord) * images.size();
+  if (file.write(reinterpret_cast<const uint8_t*>(lines.data()), linesBytes) != linesBytes ||
+      file.write(reinterpret_cast<const uint8_t*>(words.data()), wordsBytes) != wordsBytes ||
+      file.write(reinterpret_cast<const uint8_t*>(images.data()), imagesBytes) != imagesBytes ||
+      file.write(reinterpret_cast<const uint8_t*>(pool.data()), pool.size()) != pool.size()) {
+    LOG_ERR("PGE", "Failed to write page records");
+    return false;
+  }
+
+  for (const uint32_t mask : glyphGroupMasks) {
+    serialization::writePod(file, mask);
+  }
+  serialization::writePod(file, grayTextLeft);
+  serialization::writePod(file, grayTextTop);
+  serialization::writePod(file, grayTextRight);
+  serialization::writePod(file, grayTextBottom);
+
   // Serialize footnotes (clamp to MAX_FOOTNOTES_PER_PAGE to match addFootnote/deserialize limits)
   const uint16_t fnCount = std::min<uint16_t>(footnotes.size(), MAX_FOOTNOTES_PER_PAGE);
   serialization::writePod(file, fnCount);
@@ -83,27 +341,63 @@ bool Page::serialize(FsFile& file) const {
 }
 
 std::unique_ptr<Page> Page::deserialize(FsFile& file) {
+  ALLOC_SCOPE("page.load");
   auto page = std::unique_ptr<Page>(new Page());
 
-  uint16_t count;
-  serialization::readPod(file, count);
-
-  for (uint16_t i = 0; i < count; i++) {
-    uint8_t tag;
-    serialization::readPod(file, tag);
-
-    if (tag == TAG_PageLine) {
-      auto pl = PageLine::deserialize(file);
-      page->elements.push_back(std::move(pl));
-    } else if (tag == TAG_PageImage) {
-      auto pi = PageImage::deserialize(file);
-      page->elements.push_back(std::move(pi));
-    } else {
-      LOG_ERR("PGE", "Deserialization failed: Unknown tag %u", tag);
+  serialization::readPod(file, page->lineCount);
+  serialization::readPod(file, page->wordCount);
+  serialization::readPod(file, page->imageCount);
+  serialization::readPod(file, page->stringPoolSize);
+
+  const size_t arenaSize = sizeof(PageLineRecord) * page->lineCount + sizeof(PageWordRecord) * page->wordCount +
+                           sizeof(PageImageRecord) * page->imageCount + page->stringPoolSize;
+  if (arenaSize > 0) {
+    page->arena = static_cast<uint8_t*>(malloc(arenaSize));
+    if (!page->arena) {
+      LOG_ERR("PGE", "Failed to allocate page arena (%u bytes)", arenaSize);
+      return nullptr;
+    }
+    if (file.read(page->arena, arenaSize) != static_cast<int>(arenaSize)) {
+      LOG_ERR("PGE", "Deserialization failed: truncated page records");
       return nullptr;
     }
   }
 
+  // Validate record references so rendering can trust the arena
+  const char* pool = page->stringPool();
+  const auto validString = [&page, pool](const uint16_t offset, const uint16_t len) {
+    return static_cast<uint32_t>(offset) + len < page->stringPoolSize && pool[offset + len] == '\0';
+  };
+  for (uint16_t i = 0; i < page->lineCount; i++) {
+    const auto& line = page->lineRecords()[i];
+    if (static_cast<uint32_t>(line.firstWord) + line.wordCount > page->wordCount) {
+      LOG_ERR("PGE", "Deserialization failed: line %u references missing words", i);
+      return nullptr;
+    }
+  }
+  for (uint16_t i = 0; i < page->wordCount; i++) {
+    const auto& word = page->wordRecords()[i];
+    if (!validString(word.textOffset, word.textLen)) {
+      LOG_ERR("PGE", "Deserialization failed: word %u outside string pool", i);
+      return nullptr;
+    }
+  }
+  for (uint16_t i = 0; i < page->imageCount; i++) {
+    const auto& image = page->imageRecords()[i];
+    if (!validString(image.pathOffset, image.pathLen)) {
+      LOG_ERR("PGE", "Deserialization failed: image %u outside string pool", i);
+      return nullptr;
+    }
+  }
+
+  for (auto& mask : page->glyphGroupMasks) {
+    serialization::readPod(file, mask);
+  }
+  serialization::readPod(file, page->grayTextLeft);
+  serialization::readPod(file, page->grayTextTop);
+  serialization::readPod(file, page->grayTextRight);
+  serialization::readPod(file, page->grayTextBottom);
+
   // Deserialize footnotes
   uint16_t fnCount;
   serialization::readPod(file, fnCount);
@@ -1,7 +1,10 @@
 #pragma once
+#include <FunctionRef.h>
 #include <HalStorage.h>
 
 #include <algorithm>
+#include <cstdlib>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -22,22 +25,19 @@ class PageElement {
   explicit PageElement(const int16_t xPos, const int16_t yPos) : xPos(xPos), yPos(yPos) {}
   virtual ~PageElement() = default;
   virtual void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) = 0;
-  virtual bool serialize(FsFile& file) = 0;
   virtual PageElementTag getTag() const = 0;  // Add type identification
 };
 
 // a line from a block element
 class PageLine final : public PageElement {
-  std::shared_ptr<TextBlock> block;
+  ArenaPtr<TextBlock> block;
 
  public:
-  PageLine(std::shared_ptr<TextBlock> block, const int16_t xPos, const int16_t yPos)
+  PageLine(ArenaPtr<TextBlock> block, const int16_t xPos, const int16_t yPos)
       : PageElement(xPos, yPos), block(std::move(block)) {}
-  const std::shared_ptr<TextBlock>& getBlock() const { return block; }
+  const ArenaPtr<TextBlock>& getBlock() const { return block; }
   void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) override;
-  bool serialize(FsFile& file) override;
   PageElementTag getTag() const override { return TAG_PageLine; }
-  static std::unique_ptr<PageLine> deserialize(FsFile& file);
 };
 
 // New PageImage class
@@ -48,19 +48,124 @@ class PageImage final : public PageElement {
   PageImage(std::shared_ptr<ImageBlock> block, const int16_t xPos, const int16_t yPos)
       : PageElement(xPos, yPos), imageBlock(std::move(block)) {}
   void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) override;
-  bool serialize(FsFile& file) override;
   PageElementTag getTag() const override { return TAG_PageImage; }
-  static std::unique_ptr<PageImage> deserialize(FsFile& file);
   const ImageBlock& getImageBlock() const { return *imageBlock; }
 };
 
+// On-disk page layout: a small header with the record counts, then the line, word and image record arrays and
+// the string pool (NUL-terminated words and image paths), followed by the glyph group manifest, the anti-aliased
+// text area and the footnotes. Everything up to the end of the string pool is read into one allocation as-is, so a
+// loaded page renders straight from the file bytes.
+struct PageLineRecord {
+  int16_t xPos;
+  int16_t yPos;
+  uint16_t firstWord;
+  uint16_t wordCount;
+};
+
+struct PageWordRecord {
+  uint16_t textOffset;  // into the string pool
+  uint16_t textLen;
+  uint16_t xPos;  // relative to the line
+  uint8_t style;  // EpdFontFamily::Style
+  uint8_t reserved;
+};
+
+struct PageImageRecord {
+  int16_t xPos;
+  int16_t yPos;
+  int16_t width;
+  int16_t height;
+  uint16_t pathOffset;  // into the string pool
+  uint16_t pathLen;
+};
+
+// Position of a page's first word in the chapter text, independent of layout: paragraphs (text blocks) are counted
+// from the start of the chapter and words from the start of their paragraph. Anchors only grow from page to page.
+struct PageAnchor {
+  uint32_t paragraph = 0;
+  uint32_t word = 0;
+
+  bool operator==(const PageAnchor& other) const { return paragraph == other.paragraph && word == other.word; }
+  bool operator!=(const PageAnchor& other) const { return !(*this == other); }
+  bool operator<(const PageAnchor& other) const {
+    return paragraph < other.paragraph || (paragraph == other.paragraph && word < other.word);
+  }
+};
+
+// Rough cost of drawing a page, kept per page in the section file (see Section::getPageCost) so the reader can plan a
+// page turn without loading the page: whether rendering it ahead pays off, and what to decompress before it.
+struct PageCost {
+  enum Flags : uint8_t { HAS_IMAGES = 1, HAS_GRAY = 2 };
+
+  uint16_t glyphs = 0;     // codepoints of the page's words, saturating
+  uint8_t fontGroups = 0;  // glyph groups used, summed over the styles; each is an inflate unless it is cached
+  uint8_t flags = 0;
+  uint32_t imageArea = 0;  // pixels covered by images, overlaps counted twice
+
+  bool hasImages() const { return flags & HAS_IMAGES; }
+  bool hasGray() const { return flags & HAS_GRAY; }
+};
+
+static_assert(sizeof(PageLineRecord) == 8 && sizeof(PageWordRecord) == 8 && sizeof(PageImageRecord) == 12,
+              "Page records must stay packed, they are read straight from the section file");
+static_assert(sizeof(PageCost) == 8, "Page costs are stored as-is in the section file");
+
 class Page {
+  static constexpr uint8_t GLYPH_GROUP_STYLES = 4;  // REGULAR, BOLD, ITALIC, BOLD_ITALIC
+
+  // Loaded pages (see deserialize) keep their content in this single arena instead of `elements`
+  uint8_t* arena = nullptr;
+  uint16_t lineCount = 0;
+  uint16_t wordCount = 0;
+  uint16_t imageCount = 0;
+  uint16_t stringPoolSize = 0;
+  // Glyph group manifest: one bitmask of used font groups per style (see GfxRenderer::getGlyphGroupMask)
+  uint32_t glyphGroupMasks[GLYPH_GROUP_STYLES] = {};
+  // Area holding anti-aliased (2-bit) text, relative to the page origin; empty (left > right) when there is none.
+  // Images aren't included, they are taken from the page content (see getGrayBoundingBox).
+  int16_t grayTextLeft = INT16_MAX;
+  int16_t grayTextTop = INT16_MAX;
+  int16_t grayTextRight = INT16_MIN;
+  int16_t grayTextBottom = INT16_MIN;
+
+  const PageLineRecord* lineRecords() const { return reinterpret_cast<const PageLineRecord*>(arena); }
+  const PageWordRecord* wordRecords() const {
+    return reinterpret_cast<const PageWordRecord*>(arena + sizeof(PageLineRecord) * lineCount);
+  }
+  const PageImageRecord* imageRecords() const {
+    return reinterpret_cast<const PageImageRecord*>(arena + sizeof(PageLineRecord) * lineCount +
+                                                    sizeof(PageWordRecord) * wordCount);
+  }
+  const char* stringPool() const {
+    return reinterpret_cast<const char*>(arena + sizeof(PageLineRecord) * lineCount +
+                                         sizeof(PageWordRecord) * wordCount + sizeof(PageImageRecord) * imageCount);
+  }
+
+  // Lines taken over from loaded pages by appendLine(), kept in the record format until the page is serialized
+  std::vector<PageLineRecord> movedLines;
+  std::vector<PageWordRecord> movedWords;
+  std::string movedPool;
+
+  static void renderLineRecords(GfxRenderer& renderer, int fontId, int xOffset, int yOffset,
+                                const PageLineRecord* lines, uint16_t lineTotal, const PageWordRecord* words,
+                                const char* pool);
+
  public:
-  // the list of block index and line numbers on this page
+  // the list of block index and line numbers on this page (only populated while building a section)
   std::vector<std::shared_ptr<PageElement>> elements;
   std::vector<FootnoteEntry> footnotes;
+  // Set while building a section; stored in the section's anchor table rather than with the page
+  PageAnchor anchor;
+  // DOM path below <body> of the block holding the first word, also build-time only (see Section::getPageLandmark)
+  std::string landmark;
   static constexpr uint16_t MAX_FOOTNOTES_PER_PAGE = 16;
 
+  Page() = default;
+  ~Page() { free(arena); }
+  Page(const Page&) = delete;
+  Page& operator=(const Page&) = delete;
+
   void addFootnote(const char* number, const char* href) {
     if (footnotes.size() >= MAX_FOOTNOTES_PER_PAGE) return;  // Cap per-page footnotes
     FootnoteEntry entry;
@@ -71,13 +176,33 @@ class Page {
     footnotes.push_back(entry);
   }
 
-  void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) const;
+  // imagePreviews: images not decoded yet are drawn as quick previews, see ImageBlock::render and getUncachedImages
+  void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset, bool imagePreviews = false) const;
+  // Images of a loaded page that have no decoded copy for the renderer's orientation yet
+  std::vector<ImageBlock> getUncachedImages(const GfxRenderer& renderer) const;
+  // Record the glyph groups used by a line placed at (xPos, yPos) while the page is being laid out, and the area
+  // its anti-aliased words cover
+  void addGlyphGroups(const GfxRenderer& renderer, int fontId, const TextBlock& line, int16_t xPos, int16_t yPos);
+  // Copy a line of a loaded page onto this one at yPos, glyph groups and anti-aliased area included. Lets a section
+  // be cut into pages of another height from the pages of an existing layout, see Section::relayoutSection.
+  bool appendLine(const GfxRenderer& renderer, int fontId, const Page& source, uint16_t lineIndex, int16_t yPos);
+  uint16_t getLineCount() const { return lineCount; }
+  // Decompress the glyph groups in the manifest up front, so render() time isn't spent inflating
+  void prefetchGlyphs(const GfxRenderer& renderer, int fontId) const;
+  // Cost estimate of the page, built or loaded
+  PageCost getCost() const;
   bool serialize(FsFile& file) const;
   static std::unique_ptr<Page> deserialize(FsFile& file);
 
+  // Calls fn with every word on the page, in reading order
+  void forEachWord(FunctionRef<void(const char* word, size_t len)> fn) const;
+  // All words on the page joined by single spaces
+  std::string getText() const;
+
   // Check if page contains any images (used to force full refresh)
   bool hasImages() const {
-    return std::any_of(elements.begin(), elements.end(),
+    return imageCount > 0 ||
+           std::any_of(elements.begin(), elements.end(),
                        [](const std::shared_ptr<PageElement>& el) { return el->getTag() == TAG_PageImage; });
   }
 
@@ -100,6 +225,14 @@ class Page {
         found = true;
       }
     }
+    for (uint16_t i = 0; i < imageCount; i++) {
+      const auto& img = imageRecords()[i];
+      minX = std::min(minX, img.xPos);
+      minY = std::min(minY, img.yPos);
+      maxX = std::max(maxX, static_cast<int16_t>(img.xPos + img.width));
+      maxY = std::max(maxY, static_cast<int16_t>(img.yPos + img.height));
+      found = true;
+    }
     if (found) {
       outX = minX;
       outY = minY;
@@ -108,4 +241,31 @@ class Page {
     }
     return found;
   }
+
+  // Get bounding box of everything the grayscale passes draw: anti-aliased text and images
+  // Returns false if there is none, so the page needs no anti-aliasing refresh. Coordinates are relative to page
+  // origin.
+  bool getGrayBoundingBox(int16_t& outX, int16_t& outY, int16_t& outW, int16_t& outH) const {
+    int16_t minX = grayTextLeft, minY = grayTextTop, maxX = grayTextRight, maxY = grayTextBottom;
+    int16_t imgX, imgY, imgW, imgH;
+    if (getImageBoundingBox(imgX, imgY, imgW, imgH)) {
+      minX = std::min(minX, imgX);
+      minY = std::min(minY, imgY);
+      maxX = std::max(maxX, static_cast<int16_t>(imgX + imgW));
+      maxY = std::max(maxY, static_cast<int16_t>(imgY + imgH));
+    }
+    if (minX > maxX) {
+      return false;
+    }
+    outX = minX;
+    outY = minY;
+    outW = maxX - minX;
+    outH = maxY - minY;
+    return true;
+  }
+
+  bool hasGrayContent() const {
+    int16_t x, y, w, h;
+    return getGrayBoundingBox(x, y, w, h);
+  }
 };
@@ -1,17 +1,23 @@
 #include "ParsedText.h"
 
+#include <AllocProfile.h>
 #include <GfxRenderer.h>
+#include <HotPath.h>
 #include <Utf8.h>
 
 #include <algorithm>
 #include <cmath>
-#include <functional>
+#include <cstring>
 #include <limits>
+#include <string_view>
 #include <vector>
 
 #include "hyphenation/Hyphenator.h"
 
 constexpr int MAX_COST = std::numeric_limits<int>::max();
+// Line breaking DP window for very long paragraphs (see computeLineBreaks)
+constexpr size_t DP_WINDOW_WORDS = 512;
+constexpr size_t DP_LOOKAHEAD_WORDS = 128;
 
 namespace {
 
@@ -19,9 +25,12 @@ namespace {
 constexpr char SOFT_HYPHEN_UTF8[] = "\xC2\xAD";
 constexpr size_t SOFT_HYPHEN_BYTES = 2;
 
+// Longest word the stack buffers below have to hold: a full parser word buffer plus an EmSpace indent and a hyphen.
+constexpr size_t MAX_WORD_BYTES = 256;
+
 // Returns the first rendered codepoint of a word (skipping leading soft hyphens).
-uint32_t firstCodepoint(const std::string& word) {
-  const auto* ptr = reinterpret_cast<const unsigned char*>(word.c_str());
+uint32_t firstCodepoint(const char* word) {
+  const auto* ptr = reinterpret_cast<const unsigned char*>(word);
   while (true) {
     const uint32_t cp = utf8NextCodepoint(&ptr);
     if (cp == 0) return 0;
@@ -30,57 +39,103 @@ uint32_t firstCodepoint(const std::string& word) {
 }
 
 // Returns the last codepoint of a word by scanning backward for the start of the last UTF-8 sequence.
-uint32_t lastCodepoint(const std::string& word) {
-  if (word.empty()) return 0;
+uint32_t lastCodepoint(const char* word, const size_t len) {
+  if (len == 0) return 0;
   // UTF-8 continuation bytes start with 10xxxxxx; scan backward to find the leading byte.
-  size_t i = word.size() - 1;
+  size_t i = len - 1;
   while (i > 0 && (static_cast<uint8_t>(word[i]) & 0xC0) == 0x80) {
     --i;
   }
-  const auto* ptr = reinterpret_cast<const unsigned char*>(word.c_str() + i);
+  const auto* ptr = reinterpret_cast<const unsigned char*>(word + i);
   return utf8NextCodepoint(&ptr);
 }
 
-bool containsSoftHyphen(const std::string& word) { return word.find(SOFT_HYPHEN_UTF8) != std::string::npos; }
+bool containsSoftHyphen(const char* word, const size_t len) {
+  return std::string_view(word, len).find(SOFT_HYPHEN_UTF8) != std::string_view::npos;
+}
 
-// Removes every soft hyphen in-place so rendered glyphs match measured widths.
-void stripSoftHyphensInPlace(std::string& word) {
-  size_t pos = 0;
-  while ((pos = word.find(SOFT_HYPHEN_UTF8, pos)) != std::string::npos) {
-    word.erase(pos, SOFT_HYPHEN_BYTES);
+// Copies a word without its soft hyphens so rendered glyphs match measured widths. Returns the copied length;
+// dest is not NUL-terminated.
+size_t copyWithoutSoftHyphens(char* dest, const char* word, const size_t len) {
+  size_t out = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (i + 1 < len && word[i] == SOFT_HYPHEN_UTF8[0] && word[i + 1] == SOFT_HYPHEN_UTF8[1]) {
+      i += SOFT_HYPHEN_BYTES - 1;
+      continue;
+    }
+    dest[out++] = word[i];
   }
+  return out;
 }
 
 // Returns the advance width for a word while ignoring soft hyphen glyphs and optionally appending a visible hyphen.
 // Uses advance width (sum of glyph advances + kerning) rather than bounding box width so that italic glyph overhangs
-// don't inflate inter-word spacing.
-uint16_t measureWordWidth(const GfxRenderer& renderer, const int fontId, const std::string& word,
+// don't inflate inter-word spacing. `word` does not need to be NUL-terminated at `len` (hyphenation prefixes).
+uint16_t measureWordWidth(const GfxRenderer& renderer, const int fontId, const char* word, const size_t len,
                           const EpdFontFamily::Style style, const bool appendHyphen = false) {
-  if (word.size() == 1 && word[0] == ' ' && !appendHyphen) {
+  if (len == 1 && word[0] == ' ' && !appendHyphen) {
     return renderer.getSpaceWidth(fontId, style);
   }
-  const bool hasSoftHyphen = containsSoftHyphen(word);
-  if (!hasSoftHyphen && !appendHyphen) {
-    return renderer.getTextAdvanceX(fontId, word.c_str(), style);
+  const bool hasSoftHyphen = containsSoftHyphen(word, len);
+  if (!hasSoftHyphen && !appendHyphen && word[len] == '\0') {
+    return renderer.getTextAdvanceX(fontId, word, style);
   }
 
-  std::string sanitized = word;
+  char sanitized[MAX_WORD_BYTES];
+  const size_t maxCopy = std::min(len, sizeof(sanitized) - 2);
+  size_t sanitizedLen = maxCopy;
   if (hasSoftHyphen) {
-    stripSoftHyphensInPlace(sanitized);
+    sanitizedLen = copyWithoutSoftHyphens(sanitized, word, maxCopy);
+  } else {
+    memcpy(sanitized, word, maxCopy);
   }
   if (appendHyphen) {
-    sanitized.push_back('-');
+    sanitized[sanitizedLen++] = '-';
   }
-  return renderer.getTextAdvanceX(fontId, sanitized.c_str(), style);
+  sanitized[sanitizedLen] = '\0';
+  return renderer.getTextAdvanceX(fontId, sanitized, style);
 }
 
 }  // namespace
 
-void ParsedText::addWord(std::string word, const EpdFontFamily::Style fontStyle, const bool underline,
-                         const bool attachToPrevious) {
-  if (word.empty()) return;
+ParsedText::WordRef ParsedText::storeWord(const char* text, const size_t len) {
+  const WordRef ref = {static_cast<uint32_t>(wordBytes.size()), static_cast<uint16_t>(len)};
+  wordBytes.insert(wordBytes.end(), text, text + len);
+  wordBytes.push_back('\0');
+  return ref;
+}
+
+void ParsedText::compactWordBytes() {
+  if (words.empty()) {
+    wordBytes.clear();
+    return;
+  }
+
+  std::vector<char> compacted;
+  size_t total = 0;
+  for (const auto& ref : words) {
+    total += ref.len + 1;
+  }
+  compacted.reserve(total);
+  for (auto& ref : words) {
+    const char* text = wordBytes.data() + ref.offset;
+    ref.offset = static_cast<uint32_t>(compacted.size());
+    compacted.insert(compacted.end(), text, text + ref.len + 1);
+  }
+  wordBytes.swap(compacted);
+}
+
+uint32_t ParsedText::firstCodepointOf(const size_t index) const { return firstCodepoint(wordText(index)); }
 
-  words.push_back(std::move(word));
+uint32_t ParsedText::lastCodepointOf(const size_t index) const {
+  return lastCodepoint(wordText(index), words[index].len);
+}
+
+void ParsedText::addWord(const char* word, const size_t len, const EpdFontFamily::Style fontStyle,
+                         const bool underline, const bool attachToPrevious) {
+  if (len == 0) return;
+
+  words.push_back(storeWord(word, len));
   EpdFontFamily::Style combinedStyle = fontStyle;
   if (underline) {
     combinedStyle = static_cast<EpdFontFamily::Style>(combinedStyle | EpdFontFamily::UNDERLINE);
@@ -91,8 +146,9 @@ void ParsedText::addWord(std::string word, const EpdFontFamily::Style fontStyle,
 
 // Consumes data to minimize memory usage
 void ParsedText::layoutAndExtractLines(const GfxRenderer& renderer, const int fontId, const uint16_t viewportWidth,
-                                       const std::function<void(std::shared_ptr<TextBlock>)>& processLine,
+                                       const FunctionRef<void(ArenaPtr<TextBlock>)> processLine,
                                        const bool includeLastLine) {
+  ALLOC_SCOPE("text.layout");
   if (words.empty()) {
     return;
   }
@@ -102,46 +158,73 @@ void ParsedText::layoutAndExtractLines(const GfxRenderer& renderer, const int fo
 
   const int pageWidth = viewportWidth;
   const int spaceWidth = renderer.getSpaceWidth(fontId, EpdFontFamily::REGULAR);
-  auto wordWidths = calculateWordWidths(renderer, fontId);
 
-  std::vector<size_t> lineBreakIndices;
-  if (hyphenationEnabled) {
-    // Use greedy layout that can split words mid-loop when a hyphenated prefix fits.
-    lineBreakIndices = computeHyphenatedLineBreaks(renderer, fontId, pageWidth, spaceWidth, wordWidths, wordContinues);
-  } else {
-    lineBreakIndices = computeLineBreaks(renderer, fontId, pageWidth, spaceWidth, wordWidths, wordContinues);
-  }
-  const size_t lineCount = includeLastLine ? lineBreakIndices.size() : lineBreakIndices.size() - 1;
+  // All scratch below is released in one go once the paragraph (or this chunk of it) has been laid out
+  LayoutArena* scratch = scratchArena();
+  const LayoutArena::Mark scratchMark = scratch ? scratch->mark() : LayoutArena::Mark{};
+  size_t consumed = 0;
+  {
+    auto wordWidths = calculateWordWidths(renderer, fontId);
+
+    ArenaVector<size_t> lineBreakIndices{ArenaAllocator<size_t>(scratch)};
+    if (hyphenationEnabled) {
+      // Use greedy layout that can split words mid-loop when a hyphenated prefix fits.
+      lineBreakIndices =
+          computeHyphenatedLineBreaks(renderer, fontId, pageWidth, spaceWidth, wordWidths, wordContinues);
+    } else {
+      lineBreakIndices = computeLineBreaks(renderer, fontId, pageWidth, spaceWidth, wordWidths, wordContinues);
+    }
+    const size_t lineCount = includeLastLine ? lineBreakIndices.size() : lineBreakIndices.size() - 1;
 
-  for (size_t i = 0; i < lineCount; ++i) {
-    extractLine(i, pageWidth, spaceWidth, wordWidths, wordContinues, lineBreakIndices, processLine, renderer, fontId);
+    for (size_t i = 0; i < lineCount; ++i) {
+      extractLine(i, pageWidth, spaceWidth, wordWidths, wordContinues, lineBreakIndices, processLine, renderer,
+                  fontId);
+    }
+    if (lineCount > 0) {
+      consumed = lineBreakIndices[lineCount - 1];
+    }
+  }
+  if (scratch) {
+    scratch->rewind(scratchMark);
   }
 
   // Remove consumed words so size() reflects only remaining words
-  if (lineCount > 0) {
-    const size_t consumed = lineBreakIndices[lineCount - 1];
+  if (consumed > 0) {
     words.erase(words.begin(), words.begin() + consumed);
     wordStyles.erase(wordStyles.begin(), wordStyles.begin() + consumed);
     wordContinues.erase(wordContinues.begin(), wordContinues.begin() + consumed);
+    compactWordBytes();
   }
 }
 
-std::vector<uint16_t> ParsedText::calculateWordWidths(const GfxRenderer& renderer, const int fontId) {
-  std::vector<uint16_t> wordWidths;
+ArenaVector<uint16_t> ParsedText::calculateWordWidths(const GfxRenderer& renderer, const int fontId) {
+  ArenaVector<uint16_t> wordWidths{ArenaAllocator<uint16_t>(scratchArena())};
   wordWidths.reserve(words.size());
 
   for (size_t i = 0; i < words.size(); ++i) {
-    wordWidths.push_back(measureWordWidth(renderer, fontId, words[i], wordStyles[i]));
+    uint16_t width;
+    if (widthCache && widthCache->lookup(fontId, wordStyles[i], wordText(i), words[i].len, width)) {
+      wordWidths.push_back(width);
+      continue;
+    }
+    width = measureWordWidth(renderer, fontId, wordText(i), words[i].len, wordStyles[i]);
+    if (widthCache) {
+      widthCache->store(fontId, wordStyles[i], wordText(i), words[i].len, width);
+    }
+    wordWidths.push_back(width);
   }
 
   return wordWidths;
 }
 
-std::vector<size_t> ParsedText::computeLineBreaks(const GfxRenderer& renderer, const int fontId, const int pageWidth,
-                                                  const int spaceWidth, std::vector<uint16_t>& wordWidths,
-                                                  std::vector<bool>& continuesVec) {
+ArenaVector<size_t> HOT_PATH ParsedText::computeLineBreaks(const GfxRenderer& renderer, const int fontId,
+                                                           const int pageWidth, const int spaceWidth,
+                                                           ArenaVector<uint16_t>& wordWidths,
+                                                           std::vector<bool>& continuesVec) {
+  // Stores the index of the word that starts the next line (last_word_index + 1)
+  ArenaVector<size_t> lineBreakIndices{ArenaAllocator<size_t>(scratchArena())};
   if (words.empty()) {
-    return {};
+    return lineBreakIndices;
   }
 
   // Calculate first line indent (only for left/justified text without extra paragraph spacing)
@@ -164,93 +247,107 @@ std::vector<size_t> ParsedText::computeLineBreaks(const GfxRenderer& renderer, c
 
   const size_t totalWordCount = words.size();
 
-  // DP table to store the minimum badness (cost) of lines starting at index i
-  std::vector<int> dp(totalWordCount);
+  // Paragraphs longer than one window are broken window by window: the DP runs over DP_WINDOW_WORDS words, the
+  // lines starting in the first part of the window are committed and the next window starts at the first
+  // uncommitted line. Memory and time per paragraph stay bounded; paragraphs that fit in a window get the exact
+  // same breaks as a single DP over the whole paragraph.
+  const size_t tableSize = std::min(totalWordCount, DP_WINDOW_WORDS);
+  // DP table to store the minimum badness (cost) of lines starting at index i (relative to the window start)
+  ArenaVector<int> dp(tableSize, ArenaAllocator<int>(scratchArena()));
   // 'ans[i]' stores the index 'j' of the *last word* in the optimal line starting at 'i'
-  std::vector<size_t> ans(totalWordCount);
-
-  // Base Case
-  dp[totalWordCount - 1] = 0;
-  ans[totalWordCount - 1] = totalWordCount - 1;
-
-  for (int i = totalWordCount - 2; i >= 0; --i) {
-    int currlen = 0;
-    dp[i] = MAX_COST;
-
-    // First line has reduced width due to text-indent
-    const int effectivePageWidth = i == 0 ? pageWidth - firstLineIndent : pageWidth;
-
-    for (size_t j = i; j < totalWordCount; ++j) {
-      // Add space before word j, unless it's the first word on the line or a continuation
-      int gap = 0;
-      if (j > static_cast<size_t>(i) && !continuesVec[j]) {
-        gap = spaceWidth;
-        gap += renderer.getSpaceKernAdjust(fontId, lastCodepoint(words[j - 1]), firstCodepoint(words[j]),
-                                           wordStyles[j - 1]);
-      } else if (j > static_cast<size_t>(i) && continuesVec[j]) {
-        // Cross-boundary kerning for continuation words (e.g. nonbreaking spaces, attached punctuation)
-        gap = renderer.getKerning(fontId, lastCodepoint(words[j - 1]), firstCodepoint(words[j]), wordStyles[j - 1]);
-      }
-      currlen += wordWidths[j] + gap;
-
-      if (currlen > effectivePageWidth) {
-        break;
-      }
+  ArenaVector<size_t> ans(tableSize, ArenaAllocator<size_t>(scratchArena()));
+
+  size_t windowStart = 0;
+  while (windowStart < totalWordCount) {
+    const size_t windowEnd = std::min(totalWordCount, windowStart + DP_WINDOW_WORDS);
+    const bool finalWindow = windowEnd == totalWordCount;
+
+    // Base Case
+    dp[windowEnd - 1 - windowStart] = 0;
+    ans[windowEnd - 1 - windowStart] = windowEnd - 1;
+
+    for (int i = static_cast<int>(windowEnd) - 2; i >= static_cast<int>(windowStart); --i) {
+      const size_t row = i - windowStart;
+      int currlen = 0;
+      dp[row] = MAX_COST;
+
+      // First line has reduced width due to text-indent
+      const int effectivePageWidth = i == 0 ? pageWidth - firstLineIndent : pageWidth;
+
+      for (size_t j = i; j < windowEnd; ++j) {
+        // Add space before word j, unless it's the first word on the line or a continuation
+        int gap = 0;
+        if (j > static_cast<size_t>(i) && !continuesVec[j]) {
+          gap = spaceWidth;
+          gap += renderer.getSpaceKernAdjust(fontId, lastCodepointOf(j - 1), firstCodepointOf(j), wordStyles[j - 1]);
+        } else if (j > static_cast<size_t>(i) && continuesVec[j]) {
+          // Cross-boundary kerning for continuation words (e.g. nonbreaking spaces, attached punctuation)
+          gap = renderer.getKerning(fontId, lastCodepointOf(j - 1), firstCodepointOf(j), wordStyles[j - 1]);
+        }
+        currlen += wordWidths[j] + gap;
 
-      // Cannot break after word j if the next word attaches to it (continuation group)
-      if (j + 1 < totalWordCount && continuesVec[j + 1]) {
-        continue;
-      }
+        if (currlen > effectivePageWidth) {
+          break;
+        }
 
-      int cost;
-      if (j == totalWordCount - 1) {
-        cost = 0;  // Last line
-      } else {
-        const int remainingSpace = effectivePageWidth - currlen;
-        // Use long long for the square to prevent overflow
-        const long long cost_ll = static_cast<long long>(remainingSpace) * remainingSpace + dp[j + 1];
+        // Cannot break after word j if the next word attaches to it (continuation group)
+        if (j + 1 < totalWordCount && continuesVec[j + 1]) {
+          continue;
+        }
 
-        if (cost_ll > MAX_COST) {
-          cost = MAX_COST;
+        int cost;
+        if (j == totalWordCount - 1) {
+          cost = 0;  // Last line
         } else {
-          cost = static_cast<int>(cost_ll);
+          const int remainingSpace = effectivePageWidth - currlen;
+          // Past the window end the rest of the paragraph is unknown, so score that line on its own
+          const int rest = j + 1 < windowEnd ? dp[j + 1 - windowStart] : 0;
+          // Use long long for the square to prevent overflow
+          const long long cost_ll = static_cast<long long>(remainingSpace) * remainingSpace + rest;
+
+          if (cost_ll > MAX_COST) {
+            cost = MAX_COST;
+          } else {
+            cost = static_cast<int>(cost_ll);
+          }
         }
-      }
 
-      if (cost < dp[i]) {
-        dp[i] = cost;
-        ans[i] = j;  // j is the index of the last word in this optimal line
+        if (cost < dp[row]) {
+          dp[row] = cost;
+          ans[row] = j;  // j is the index of the last word in this optimal line
+        }
       }
-    }
 
-    // Handle oversized word: if no valid configuration found, force single-word line
-    // This prevents cascade failure where one oversized word breaks all preceding words
-    if (dp[i] == MAX_COST) {
-      ans[i] = i;  // Just this word on its own line
-      // Inherit cost from next word to allow subsequent words to find valid configurations
-      if (i + 1 < static_cast<int>(totalWordCount)) {
-        dp[i] = dp[i + 1];
-      } else {
-        dp[i] = 0;
+      // Handle oversized word: if no valid configuration found, force single-word line
+      // This prevents cascade failure where one oversized word breaks all preceding words
+      if (dp[row] == MAX_COST) {
+        ans[row] = i;  // Just this word on its own line
+        // Inherit cost from next word to allow subsequent words to find valid configurations
+        if (i + 1 < static_cast<int>(windowEnd)) {
+          dp[row] = dp[row + 1];
+        } else {
+          dp[row] = 0;
+        }
       }
     }
-  }
 
-  // Stores the index of the word that starts the next line (last_word_index + 1)
-  std::vector<size_t> lineBreakIndices;
-  size_t currentWordIndex = 0;
+    // Commit the lines that start before the lookahead part of the window (all of them in the final window)
+    const size_t commitLimit = finalWindow ? windowEnd : windowEnd - DP_LOOKAHEAD_WORDS;
+    size_t currentWordIndex = windowStart;
+    do {
+      size_t nextBreakIndex = ans[currentWordIndex - windowStart] + 1;
 
-  while (currentWordIndex < totalWordCount) {
-    size_t nextBreakIndex = ans[currentWordIndex] + 1;
+      // Safety check: prevent infinite loop if nextBreakIndex doesn't advance
+      if (nextBreakIndex <= currentWordIndex) {
+        // Force advance by at least one word to avoid infinite loop
+        nextBreakIndex = currentWordIndex + 1;
+      }
 
-    // Safety check: prevent infinite loop if nextBreakIndex doesn't advance
-    if (nextBreakIndex <= currentWordIndex) {
-      // Force advance by at least one word to avoid infinite loop
-      nextBreakIndex = currentWordIndex + 1;
-    }
+      lineBreakIndices.push_back(nextBreakIndex);
+      currentWordIndex = nextBreakIndex;
+    } while (currentWordIndex < commitLimit);
 
-    lineBreakIndices.push_back(nextBreakIndex);
-    currentWordIndex = nextBreakIndex;
+    windowStart = currentWordIndex;
   }
 
   return lineBreakIndices;
@@ -266,14 +363,19 @@ void ParsedText::applyParagraphIndent() {
     // The actual indent positioning is handled in extractLine()
   } else if (blockStyle.alignment == CssTextAlign::Justify || blockStyle.alignment == CssTextAlign::Left) {
     // No CSS text-indent defined - use EmSpace fallback for visual indent
-    words.front().insert(0, "\xe2\x80\x83");
+    char indented[MAX_WORD_BYTES];
+    constexpr size_t EM_SPACE_BYTES = 3;
+    const size_t len = std::min<size_t>(words.front().len, sizeof(indented) - EM_SPACE_BYTES - 1);
+    memcpy(indented, "\xe2\x80\x83", EM_SPACE_BYTES);
+    memcpy(indented + EM_SPACE_BYTES, wordText(0), len);
+    words.front() = storeWord(indented, EM_SPACE_BYTES + len);
   }
 }
 
 // Builds break indices while opportunistically splitting the word that would overflow the current line.
-std::vector<size_t> ParsedText::computeHyphenatedLineBreaks(const GfxRenderer& renderer, const int fontId,
+ArenaVector<size_t> ParsedText::computeHyphenatedLineBreaks(const GfxRenderer& renderer, const int fontId,
                                                             const int pageWidth, const int spaceWidth,
-                                                            std::vector<uint16_t>& wordWidths,
+                                                            ArenaVector<uint16_t>& wordWidths,
                                                             std::vector<bool>& continuesVec) {
   // Calculate first line indent (only for left/justified text without extra paragraph spacing)
   const int firstLineIndent =
@@ -282,7 +384,7 @@ std::vector<size_t> ParsedText::computeHyphenatedLineBreaks(const GfxRenderer& r
           ? blockStyle.textIndent
           : 0;
 
-  std::vector<size_t> lineBreakIndices;
+  ArenaVector<size_t> lineBreakIndices{ArenaAllocator<size_t>(scratchArena())};
   size_t currentIndex = 0;
   bool isFirstLine = true;
 
@@ -299,12 +401,12 @@ std::vector<size_t> ParsedText::computeHyphenatedLineBreaks(const GfxRenderer& r
       int spacing = 0;
       if (!isFirstWord && !continuesVec[currentIndex]) {
         spacing = spaceWidth;
-        spacing += renderer.getSpaceKernAdjust(fontId, lastCodepoint(words[currentIndex - 1]),
-                                               firstCodepoint(words[currentIndex]), wordStyles[currentIndex - 1]);
+        spacing += renderer.getSpaceKernAdjust(fontId, lastCodepointOf(currentIndex - 1),
+                                               firstCodepointOf(currentIndex), wordStyles[currentIndex - 1]);
       } else if (!isFirstWord && continuesVec[currentIndex]) {
         // Cross-boundary kerning for continuation words (e.g. nonbreaking spaces, attached punctuation)
-        spacing = renderer.getKerning(fontId, lastCodepoint(words[currentIndex - 1]),
-                                      firstCodepoint(words[currentIndex]), wordStyles[currentIndex - 1]);
+        spacing = renderer.getKerning(fontId, lastCodepointOf(currentIndex - 1), firstCodepointOf(currentIndex),
+                                      wordStyles[currentIndex - 1]);
       }
       const int candidateWidth = spacing + wordWidths[currentIndex];
 
@@ -351,18 +453,18 @@ std::vector<size_t> ParsedText::computeHyphenatedLineBreaks(const GfxRenderer& r
 // Splits words[wordIndex] into prefix (adding a hyphen only when needed) and remainder when a legal breakpoint fits the
 // available width.
 bool ParsedText::hyphenateWordAtIndex(const size_t wordIndex, const int availableWidth, const GfxRenderer& renderer,
-                                      const int fontId, std::vector<uint16_t>& wordWidths,
+                                      const int fontId, ArenaVector<uint16_t>& wordWidths,
                                       const bool allowFallbackBreaks) {
   // Guard against invalid indices or zero available width before attempting to split.
   if (availableWidth <= 0 || wordIndex >= words.size()) {
     return false;
   }
 
-  const std::string& word = words[wordIndex];
+  const WordRef wordRef = words[wordIndex];
   const auto style = wordStyles[wordIndex];
 
   // Collect candidate breakpoints (byte offsets and hyphen requirements).
-  auto breakInfos = Hyphenator::breakOffsets(word, allowFallbackBreaks);
+  auto breakInfos = Hyphenator::breakOffsets(wordText(wordIndex), allowFallbackBreaks, scratchArena());
   if (breakInfos.empty()) {
     return false;
   }
@@ -374,12 +476,12 @@ bool ParsedText::hyphenateWordAtIndex(const size_t wordIndex, const int availabl
   // Iterate over each legal breakpoint and retain the widest prefix that still fits.
   for (const auto& info : breakInfos) {
     const size_t offset = info.byteOffset;
-    if (offset == 0 || offset >= word.size()) {
+    if (offset == 0 || offset >= wordRef.len) {
       continue;
     }
 
     const bool needsHyphen = info.requiresInsertedHyphen;
-    const int prefixWidth = measureWordWidth(renderer, fontId, word.substr(0, offset), style, needsHyphen);
+    const int prefixWidth = measureWordWidth(renderer, fontId, wordText(wordIndex), offset, style, needsHyphen);
     if (prefixWidth > availableWidth || prefixWidth <= chosenWidth) {
       continue;  // Skip if too wide or not an improvement
     }
@@ -394,12 +496,17 @@ bool ParsedText::hyphenateWordAtIndex(const size_t wordIndex, const int availabl
     return false;
   }
 
-  // Split the word at the selected breakpoint and append a hyphen if required.
-  std::string remainder = word.substr(chosenOffset);
-  words[wordIndex].resize(chosenOffset);
+  // Split the word at the selected breakpoint. The remainder keeps pointing at the tail of the original bytes (which
+  // are still NUL-terminated); the prefix needs its own terminator and possibly a hyphen, so it is stored again.
+  const WordRef remainder = {wordRef.offset + static_cast<uint32_t>(chosenOffset),
+                             static_cast<uint16_t>(wordRef.len - chosenOffset)};
+  char prefix[MAX_WORD_BYTES];
+  size_t prefixLen = std::min(chosenOffset, sizeof(prefix) - 1);
+  memcpy(prefix, wordText(wordIndex), prefixLen);
   if (chosenNeedsHyphen) {
-    words[wordIndex].push_back('-');
+    prefix[prefixLen++] = '-';
   }
+  words[wordIndex] = storeWord(prefix, prefixLen);
 
   // Insert the remainder word (with matching style and continuation flag) directly after the prefix.
   words.insert(words.begin() + wordIndex + 1, remainder);
@@ -429,16 +536,16 @@ bool ParsedText::hyphenateWordAtIndex(const size_t wordIndex, const int availabl
 
   // Update cached widths to reflect the new prefix/remainder pairing.
   wordWidths[wordIndex] = static_cast<uint16_t>(chosenWidth);
-  const uint16_t remainderWidth = measureWordWidth(renderer, fontId, remainder, style);
+  const uint16_t remainderWidth = measureWordWidth(renderer, fontId, wordText(wordIndex + 1), remainder.len, style);
   wordWidths.insert(wordWidths.begin() + wordIndex + 1, remainderWidth);
   return true;
 }
 
 void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const int spaceWidth,
-                             const std::vector<uint16_t>& wordWidths, const std::vector<bool>& continuesVec,
-                             const std::vector<size_t>& lineBreakIndices,
-                             const std::function<void(std::shared_ptr<TextBlock>)>& processLine,
-                             const GfxRenderer& renderer, const int fontId) {
+                             const ArenaVector<uint16_t>& wordWidths, const std::vector<bool>& continuesVec,
+                             const ArenaVector<size_t>& lineBreakIndices,
+                             const FunctionRef<void(ArenaPtr<TextBlock>)> processLine, const GfxRenderer& renderer,
+                             const int fontId) {
   const size_t lineBreak = lineBreakIndices[breakIndex];
   const size_t lastBreakAt = breakIndex > 0 ? lineBreakIndices[breakIndex - 1] : 0;
   const size_t lineWordCount = lineBreak - lastBreakAt;
@@ -463,15 +570,15 @@ void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const
     if (wordIdx > 0 && !continuesVec[lastBreakAt + wordIdx]) {
       actualGapCount++;
       int naturalGap = spaceWidth;
-      naturalGap += renderer.getSpaceKernAdjust(fontId, lastCodepoint(words[lastBreakAt + wordIdx - 1]),
-                                                firstCodepoint(words[lastBreakAt + wordIdx]),
+      naturalGap += renderer.getSpaceKernAdjust(fontId, lastCodepointOf(lastBreakAt + wordIdx - 1),
+                                                firstCodepointOf(lastBreakAt + wordIdx),
                                                 wordStyles[lastBreakAt + wordIdx - 1]);
       totalNaturalGaps += naturalGap;
     } else if (wordIdx > 0 && continuesVec[lastBreakAt + wordIdx]) {
       // Cross-boundary kerning for continuation words (e.g. nonbreaking spaces, attached punctuation)
-      totalNaturalGaps +=
-          renderer.getKerning(fontId, lastCodepoint(words[lastBreakAt + wordIdx - 1]),
-                              firstCodepoint(words[lastBreakAt + wordIdx]), wordStyles[lastBreakAt + wordIdx - 1]);
+      totalNaturalGaps += renderer.getKerning(fontId, lastCodepointOf(lastBreakAt + wordIdx - 1),
+                                              firstCodepointOf(lastBreakAt + wordIdx),
+                                              wordStyles[lastBreakAt + wordIdx - 1]);
     }
   }
 
@@ -493,9 +600,12 @@ void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const
     xpos = (effectivePageWidth - lineWordWidthSum - totalNaturalGaps) / 2;
   }
 
+  // The line data lives as long as the page it ends up on, so it goes to the line arena rather than the scratch
+  LayoutArena* lineArena = arenas ? &arenas->lines() : nullptr;
+
   // Pre-calculate X positions for words
   // Continuation words attach to the previous word with no space before them
-  std::vector<uint16_t> lineXPos;
+  ArenaVector<uint16_t> lineXPos{ArenaAllocator<uint16_t>(lineArena)};
   lineXPos.reserve(lineWordCount);
 
   for (size_t wordIdx = 0; wordIdx < lineWordCount; wordIdx++) {
@@ -505,15 +615,14 @@ void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const
     if (nextIsContinuation) {
       int advance = wordWidths[lastBreakAt + wordIdx];
       // Cross-boundary kerning for continuation words (e.g. nonbreaking spaces, attached punctuation)
-      advance +=
-          renderer.getKerning(fontId, lastCodepoint(words[lastBreakAt + wordIdx]),
-                              firstCodepoint(words[lastBreakAt + wordIdx + 1]), wordStyles[lastBreakAt + wordIdx]);
+      advance += renderer.getKerning(fontId, lastCodepointOf(lastBreakAt + wordIdx),
+                                     firstCodepointOf(lastBreakAt + wordIdx + 1), wordStyles[lastBreakAt + wordIdx]);
       xpos += advance;
     } else {
       int gap = spaceWidth;
       if (wordIdx + 1 < lineWordCount) {
-        gap += renderer.getSpaceKernAdjust(fontId, lastCodepoint(words[lastBreakAt + wordIdx]),
-                                           firstCodepoint(words[lastBreakAt + wordIdx + 1]),
+        gap += renderer.getSpaceKernAdjust(fontId, lastCodepointOf(lastBreakAt + wordIdx),
+                                           firstCodepointOf(lastBreakAt + wordIdx + 1),
                                            wordStyles[lastBreakAt + wordIdx]);
       }
       if (blockStyle.alignment == CssTextAlign::Justify && !isLastLine) {
@@ -523,17 +632,26 @@ void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const
     }
   }
 
-  // Build line data by moving from the original vectors using index range
-  std::vector<std::string> lineWords(std::make_move_iterator(words.begin() + lastBreakAt),
-                                     std::make_move_iterator(words.begin() + lineBreak));
-  std::vector<EpdFontFamily::Style> lineWordStyles(wordStyles.begin() + lastBreakAt, wordStyles.begin() + lineBreak);
-
-  for (auto& word : lineWords) {
-    if (containsSoftHyphen(word)) {
-      stripSoftHyphensInPlace(word);
-    }
+  // Copy the line's words into one NUL-separated buffer, dropping soft hyphens on the way
+  size_t lineTextSize = 0;
+  for (size_t i = lastBreakAt; i < lineBreak; i++) {
+    lineTextSize += words[i].len + 1;
+  }
+  ArenaVector<char> lineText(lineTextSize, ArenaAllocator<char>(lineArena));
+  ArenaVector<TextBlock::WordSpan> lineWords{ArenaAllocator<TextBlock::WordSpan>(lineArena)};
+  lineWords.reserve(lineWordCount);
+  size_t textPos = 0;
+  for (size_t i = lastBreakAt; i < lineBreak; i++) {
+    const size_t len = copyWithoutSoftHyphens(lineText.data() + textPos, wordText(i), words[i].len);
+    lineText[textPos + len] = '\0';
+    lineWords.push_back({static_cast<uint16_t>(textPos), static_cast<uint16_t>(len)});
+    textPos += len + 1;
   }
+  lineText.resize(textPos);
+
+  ArenaVector<EpdFontFamily::Style> lineWordStyles(wordStyles.begin() + lastBreakAt, wordStyles.begin() + lineBreak,
+                                                   ArenaAllocator<EpdFontFamily::Style>(lineArena));
 
-  processLine(
-      std::make_shared<TextBlock>(std::move(lineWords), std::move(lineXPos), std::move(lineWordStyles), blockStyle));
+  processLine(makeArenaUnique<TextBlock>(lineArena, std::move(lineText), std::move(lineWords), std::move(lineXPos),
+                                         std::move(lineWordStyles), blockStyle));
 }
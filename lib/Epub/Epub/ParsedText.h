@@ -1,51 +1,75 @@
 #pragma once
 
 #include <EpdFontFamily.h>
+#include <FunctionRef.h>
 
-#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "LayoutArena.h"
+#include "WordWidthCache.h"
 #include "blocks/BlockStyle.h"
 #include "blocks/TextBlock.h"
 
 class GfxRenderer;
 
 class ParsedText {
-  std::vector<std::string> words;
+  // Every word of the paragraph is stored NUL-terminated in wordBytes and referenced by offset, so adding a word
+  // doesn't allocate on its own; the bytes are copied once more only into the finished TextBlock.
+  struct WordRef {
+    uint32_t offset;
+    uint16_t len;
+  };
+  std::vector<char> wordBytes;
+  std::vector<WordRef> words;
   std::vector<EpdFontFamily::Style> wordStyles;
   std::vector<bool> wordContinues;  // true = word attaches to previous (no space before it)
   BlockStyle blockStyle;
   bool extraParagraphSpacing;
   bool hyphenationEnabled;
+  // Layout scratch and the extracted TextBlocks come from here when set (see SectionBuildArenas)
+  SectionBuildArenas* arenas;
+  WordWidthCache* widthCache;
 
+  LayoutArena* scratchArena() const { return arenas ? &arenas->scratch : nullptr; }
+  const char* wordText(const size_t index) const { return wordBytes.data() + words[index].offset; }
+  uint32_t firstCodepointOf(size_t index) const;
+  uint32_t lastCodepointOf(size_t index) const;
+  // Append a word's bytes (which must not point into wordBytes) plus a terminator
+  WordRef storeWord(const char* text, size_t len);
+  // Drop the bytes of words that have already been extracted into lines
+  void compactWordBytes();
   void applyParagraphIndent();
-  std::vector<size_t> computeLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth, int spaceWidth,
-                                        std::vector<uint16_t>& wordWidths, std::vector<bool>& continuesVec);
-  std::vector<size_t> computeHyphenatedLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth,
-                                                  int spaceWidth, std::vector<uint16_t>& wordWidths,
+  ArenaVector<size_t> computeLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth, int spaceWidth,
+                                        ArenaVector<uint16_t>& wordWidths, std::vector<bool>& continuesVec);
+  ArenaVector<size_t> computeHyphenatedLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth,
+                                                  int spaceWidth, ArenaVector<uint16_t>& wordWidths,
                                                   std::vector<bool>& continuesVec);
   bool hyphenateWordAtIndex(size_t wordIndex, int availableWidth, const GfxRenderer& renderer, int fontId,
-                            std::vector<uint16_t>& wordWidths, bool allowFallbackBreaks);
-  void extractLine(size_t breakIndex, int pageWidth, int spaceWidth, const std::vector<uint16_t>& wordWidths,
-                   const std::vector<bool>& continuesVec, const std::vector<size_t>& lineBreakIndices,
-                   const std::function<void(std::shared_ptr<TextBlock>)>& processLine, const GfxRenderer& renderer,
-                   int fontId);
-  std::vector<uint16_t> calculateWordWidths(const GfxRenderer& renderer, int fontId);
+                            ArenaVector<uint16_t>& wordWidths, bool allowFallbackBreaks);
+  void extractLine(size_t breakIndex, int pageWidth, int spaceWidth, const ArenaVector<uint16_t>& wordWidths,
+                   const std::vector<bool>& continuesVec, const ArenaVector<size_t>& lineBreakIndices,
+                   FunctionRef<void(ArenaPtr<TextBlock>)> processLine, const GfxRenderer& renderer, int fontId);
+  ArenaVector<uint16_t> calculateWordWidths(const GfxRenderer& renderer, int fontId);
 
  public:
   explicit ParsedText(const bool extraParagraphSpacing, const bool hyphenationEnabled = false,
-                      const BlockStyle& blockStyle = BlockStyle())
-      : blockStyle(blockStyle), extraParagraphSpacing(extraParagraphSpacing), hyphenationEnabled(hyphenationEnabled) {}
+                      const BlockStyle& blockStyle = BlockStyle(), SectionBuildArenas* arenas = nullptr,
+                      WordWidthCache* widthCache = nullptr)
+      : blockStyle(blockStyle),
+        extraParagraphSpacing(extraParagraphSpacing),
+        hyphenationEnabled(hyphenationEnabled),
+        arenas(arenas),
+        widthCache(widthCache) {}
   ~ParsedText() = default;
 
-  void addWord(std::string word, EpdFontFamily::Style fontStyle, bool underline = false, bool attachToPrevious = false);
+  void addWord(const char* word, size_t len, EpdFontFamily::Style fontStyle, bool underline = false,
+               bool attachToPrevious = false);
   void setBlockStyle(const BlockStyle& blockStyle) { this->blockStyle = blockStyle; }
   BlockStyle& getBlockStyle() { return blockStyle; }
   size_t size() const { return words.size(); }
   bool isEmpty() const { return words.empty(); }
   void layoutAndExtractLines(const GfxRenderer& renderer, int fontId, uint16_t viewportWidth,
-                             const std::function<void(std::shared_ptr<TextBlock>)>& processLine,
-                             bool includeLastLine = true);
+                             FunctionRef<void(ArenaPtr<TextBlock>)> processLine, bool includeLastLine = true);
 };
\ No newline at end of file
@@ -1,22 +1,98 @@
 #include "Section.h"
 
+#include <AllocProfile.h>
+#include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <Logging.h>
+#include <Metrics.h>
 #include <Serialization.h>
+#include <Trace.h>
+#include <ZipFile.h>
+
+#include <algorithm>
+#include <cstring>
 
 #include "Epub/css/CssParser.h"
+#include "FootnoteStore.h"
 #include "Page.h"
+#include "SectionFlow.h"
+#include "SectionPageCounts.h"
+#include "WordWidthCache.h"
+#include "hyphenation/BreakSidecar.h"
 #include "hyphenation/Hyphenator.h"
 #include "parsers/ChapterHtmlSlimParser.h"
 
 namespace {
-constexpr uint8_t SECTION_FILE_VERSION = 14;
+constexpr uint8_t SECTION_FILE_VERSION = 22;
+constexpr uint8_t LANDMARK_FILE_VERSION = 1;
+constexpr uint8_t CHECKPOINT_FILE_VERSION = 2;
+// Pages between two checkpoints of a section build
+constexpr uint16_t CHECKPOINT_PAGES = 8;
+// Interrupted builds of a chapter after which the pages they completed are kept as the whole chapter
+constexpr uint8_t MAX_BUILD_ATTEMPTS = 2;
+// Page offset, anchor and cost, one per page in a checkpoint batch
+constexpr size_t CHECKPOINT_RECORD_SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(PageCost);
+// Per page after the page data: LUT entry, then anchor record, then cost record (each a table of its own)
+constexpr size_t ANCHOR_RECORD_SIZE = sizeof(uint32_t) + sizeof(uint32_t);
+
+// Parse the next "/name[index]" segment of a DOM path; a missing index counts as 1 as in KOReader xpointers
+bool nextPathSegment(const std::string& path, size_t& pos, std::string& name, int& index) {
+  if (pos >= path.size() || path[pos] != '/') {
+    return false;
+  }
+  const size_t nameStart = pos + 1;
+  size_t nameEnd = nameStart;
+  while (nameEnd < path.size() && path[nameEnd] != '/' && path[nameEnd] != '[') {
+    nameEnd++;
+  }
+  name.assign(path, nameStart, nameEnd - nameStart);
+  index = 1;
+  pos = nameEnd;
+  if (pos < path.size() && path[pos] == '[') {
+    index = atoi(path.c_str() + pos + 1);
+    while (pos < path.size() && path[pos] != ']') {
+      pos++;
+    }
+    pos++;
+  }
+  return !name.empty();
+}
+
+// Document order of two DOM paths: -1/0/1, or 2 when siblings with different tag names leave it undecided
+int compareDomPaths(const std::string& a, const std::string& b) {
+  size_t posA = 0, posB = 0;
+  std::string nameA, nameB;
+  int indexA, indexB;
+  while (true) {
+    const bool hasA = nextPathSegment(a, posA, nameA, indexA);
+    const bool hasB = nextPathSegment(b, posB, nameB, indexB);
+    if (!hasA || !hasB) {
+      // An ancestor starts before its descendants
+      return hasA == hasB ? 0 : (hasA ? 1 : -1);
+    }
+    if (nameA != nameB) {
+      return 2;
+    }
+    if (indexA != indexB) {
+      return indexA < indexB ? -1 : 1;
+    }
+  }
+}
+// FNV-1a over the bytes of a layout parameter, for layoutKey() and flowKey()
+void addToHash(uint32_t& hash, const void* data, const size_t size) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+}
+
 constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + sizeof(int) + sizeof(float) + sizeof(bool) + sizeof(uint8_t) +
                                  sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(bool) + sizeof(bool) +
                                  sizeof(uint32_t);
 }  // namespace
 
-uint32_t Section::onPageComplete(std::unique_ptr<Page> page) {
+uint32_t Section::onPageComplete(std::unique_ptr<Page> page, std::vector<PageAnchor>& anchors,
+                                 std::vector<PageCost>& costs) {
   if (!file) {
     LOG_ERR("SCT", "File not open for writing page %d", pageCount);
     return 0;
@@ -27,6 +103,11 @@ uint32_t Section::onPageComplete(std::unique_ptr<Page> page) {
     LOG_ERR("SCT", "Failed to serialize page %d", pageCount);
     return 0;
   }
+  anchors.push_back(page->anchor);
+  costs.push_back(page->getCost());
+  if (landmarkFile) {
+    serialization::writeString(landmarkFile, page->landmark);
+  }
   LOG_DBG("SCT", "Page %d processed", pageCount);
 
   pageCount++;
@@ -59,10 +140,52 @@ void Section::writeSectionFileHeader(const int fontId, const float lineCompressi
   serialization::writePod(file, static_cast<uint32_t>(0));  // Placeholder for LUT offset
 }
 
+uint32_t Section::layoutKey(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                            const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                            const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle) {
+  uint32_t hash = 2166136261u;
+  const auto add = [&hash](const void* data, const size_t size) { addToHash(hash, data, size); };
+  add(&SECTION_FILE_VERSION, sizeof(SECTION_FILE_VERSION));
+  add(&fontId, sizeof(fontId));
+  add(&lineCompression, sizeof(lineCompression));
+  add(&extraParagraphSpacing, sizeof(extraParagraphSpacing));
+  add(&paragraphAlignment, sizeof(paragraphAlignment));
+  add(&viewportWidth, sizeof(viewportWidth));
+  add(&viewportHeight, sizeof(viewportHeight));
+  add(&hyphenationEnabled, sizeof(hyphenationEnabled));
+  add(&embeddedStyle, sizeof(embeddedStyle));
+  return hash;
+}
+
+uint32_t Section::flowKey(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                          const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                          const bool hyphenationEnabled, const bool embeddedStyle) {
+  uint32_t hash = 2166136261u;
+  const auto add = [&hash](const void* data, const size_t size) { addToHash(hash, data, size); };
+  add(&SECTION_FILE_VERSION, sizeof(SECTION_FILE_VERSION));
+  add(&fontId, sizeof(fontId));
+  add(&lineCompression, sizeof(lineCompression));
+  add(&extraParagraphSpacing, sizeof(extraParagraphSpacing));
+  add(&paragraphAlignment, sizeof(paragraphAlignment));
+  add(&viewportWidth, sizeof(viewportWidth));
+  add(&hyphenationEnabled, sizeof(hyphenationEnabled));
+  add(&embeddedStyle, sizeof(embeddedStyle));
+  return hash;
+}
+
+void Section::recordPageCount() const {
+  SectionPageCounts::record(epub->getPageCountsPath(), builtLayoutKey, epub->getSpineItemsCount(), spineIndex,
+                            pageCount);
+}
+
 bool Section::loadSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
                               const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                               const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle) {
-  if (!Storage.openFileForRead("SCT", filePath, file)) {
+  TRACE("sect.load");
+  const uint32_t key = layoutKey(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                                 viewportHeight, hyphenationEnabled, embeddedStyle);
+  useLayout(key);
+  if (!openSectionFile()) {
     return false;
   }
 
@@ -105,15 +228,99 @@ bool Section::loadSectionFile(const int fontId, const float lineCompression, con
   }
 
   serialization::readPod(file, pageCount);
-  file.close();
+  uint32_t lutOffset;
+  serialization::readPod(file, lutOffset);
+  if (lutOffset == 0) {
+    // The build writing it was cut short; leave it to createSectionFile, which may salvage its pages
+    file.close();
+    pageCount = 0;
+    LOG_ERR("SCT", "Deserialization failed: Section build was interrupted");
+    return false;
+  }
+  pageDataEnd = lutOffset;
+
+  pageLut.resize(pageCount);
+  file.seek(lutOffset);
+  const size_t lutBytes = sizeof(uint32_t) * pageCount;
+  if (lutBytes > 0 && file.read(reinterpret_cast<uint8_t*>(pageLut.data()), lutBytes) != static_cast<int>(lutBytes)) {
+    file.close();
+    pageLut.clear();
+    LOG_ERR("SCT", "Deserialization failed: Truncated page LUT");
+    clearCache();
+    return false;
+  }
+
+  builtLayoutKey = key;
+  recordPageCount();
+
+  // Keep the file open for subsequent page loads
   LOG_DBG("SCT", "Deserialization succeeded: %d pages", pageCount);
+  metrics::add(metrics::SECTION_CACHE_HITS);
   return true;
 }
 
+void Section::useLayout(const uint32_t key) {
+  usedLayoutKey = key;
+  const std::string dir = epub->getSectionDir(key);
+  filePath = dir + "/" + std::to_string(spineIndex) + ".bin";
+  landmarkPath = dir + "/" + std::to_string(spineIndex) + ".xp";
+  checkpointPath = dir + "/" + std::to_string(spineIndex) + ".ckp";
+  flowPath = dir + "/" + std::to_string(spineIndex) + ".flw";
+}
+
+bool Section::openForReading() {
+  if (file) {
+    return true;
+  }
+  return openSectionFile();
+}
+
+bool Section::openSectionFile() {
+  if (!epub->getSectionPack().open(BookPack::SECTION, usedLayoutKey, spineIndex, file) &&
+      !Storage.openFileForRead("SCT", filePath, file)) {
+    return false;
+  }
+  // Pages are deserialized a few bytes at a time; read them through a window instead of one card call per field
+  file.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
+  return true;
+}
+
+void Section::packSectionFiles() const {
+  BookPack& pack = epub->getSectionPack();
+  if (!pack.import(BookPack::SECTION, usedLayoutKey, spineIndex, filePath)) {
+    // Read from where it was built instead
+    return;
+  }
+  if (Storage.exists(landmarkPath.c_str())) {
+    pack.import(BookPack::LANDMARKS, usedLayoutKey, spineIndex, landmarkPath);
+  } else {
+    // Landmarks of an earlier build must not be taken for this one's
+    pack.remove(BookPack::LANDMARKS, usedLayoutKey, spineIndex);
+  }
+  if (Storage.exists(flowPath.c_str())) {
+    pack.import(BookPack::FLOW, usedLayoutKey, spineIndex, flowPath);
+  } else {
+    pack.remove(BookPack::FLOW, usedLayoutKey, spineIndex);
+  }
+}
+
 // Your updated class method (assuming you are using the 'SD' object, which is a wrapper for a specific filesystem)
-bool Section::clearCache() const {
-  if (!Storage.exists(filePath.c_str())) {
-    LOG_DBG("SCT", "Cache does not exist, no action needed");
+bool Section::clearCache() {
+  if (file) {
+    file.close();
+  }
+  pageLut.clear();
+
+  [[maybe_unused]] bool packed = false;  // Only logged
+  if (!filePath.empty()) {
+    BookPack& pack = epub->getSectionPack();
+    packed = pack.remove(BookPack::SECTION, usedLayoutKey, spineIndex);
+    pack.remove(BookPack::LANDMARKS, usedLayoutKey, spineIndex);
+    pack.remove(BookPack::FLOW, usedLayoutKey, spineIndex);
+  }
+
+  if (filePath.empty() || !Storage.exists(filePath.c_str())) {
+    LOG_DBG("SCT", "%s", packed ? "Cache cleared successfully" : "Cache does not exist, no action needed");
     return true;
   }
 
@@ -121,24 +328,21 @@ bool Section::clearCache() const {
     LOG_ERR("SCT", "Failed to clear cache");
     return false;
   }
+  if (Storage.exists(landmarkPath.c_str())) {
+    Storage.remove(landmarkPath.c_str());
+  }
+  if (Storage.exists(checkpointPath.c_str())) {
+    Storage.remove(checkpointPath.c_str());
+  }
+  if (Storage.exists(flowPath.c_str())) {
+    Storage.remove(flowPath.c_str());
+  }
 
   LOG_DBG("SCT", "Cache cleared successfully");
   return true;
 }
 
-bool Section::createSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
-                                const uint8_t paragraphAlignment, const uint16_t viewportWidth,
-                                const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle,
-                                const std::function<void()>& popupFn) {
-  const auto localPath = epub->getSpineItem(spineIndex).href;
-  const auto tmpHtmlPath = epub->getCachePath() + "/.tmp_" + std::to_string(spineIndex) + ".html";
-
-  // Create cache directory if it doesn't exist
-  {
-    const auto sectionsDir = epub->getCachePath() + "/sections";
-    Storage.mkdir(sectionsDir.c_str());
-  }
-
+bool Section::extractToTempFile(const std::string& localPath, const std::string& tmpHtmlPath) const {
   // Retry logic for SD card timing issues
   bool success = false;
   uint32_t fileSize = 0;
@@ -157,7 +361,7 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
     if (!Storage.openFileForWrite("SCT", tmpHtmlPath, tmpHtml)) {
       continue;
     }
-    success = epub->readItemContentsToStream(localPath, tmpHtml, 1024);
+    success = epub->readItemContentsToStream(localPath, tmpHtml, Storage.profile().writeChunk);
     fileSize = tmpHtml.size();
     tmpHtml.close();
 
@@ -174,48 +378,271 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
   }
 
   LOG_DBG("SCT", "Streamed temp HTML to %s (%d bytes)", tmpHtmlPath.c_str(), fileSize);
+  return true;
+}
+
+// Everything a build keeps from beginSectionFile() to its end. The parser comes last, it refers to the rest.
+struct Section::Build {
+  Build(Epub& epub, const int spineIndex, const std::string& flowPath)
+      : localPath(epub.getSpineItem(spineIndex).href),
+        tmpHtmlPath(epub.getCachePath() + "/.tmp_" + std::to_string(spineIndex) + ".html"),
+        breakSidecarPath(epub.getCachePath() + "/sections/" + std::to_string(spineIndex) + ".brk"),
+        itemReader(epub.getPath(), epub.getZipIndexPath()),
+        footnoteStore(epub.getFootnoteStorePath(spineIndex)),
+        flow(flowPath),
+        widthCache(epub.getWordWidthCachePath()) {}
+
+  const std::string localPath;
+  const std::string tmpHtmlPath;
+  const std::string breakSidecarPath;
+  uint32_t key = 0;
+  bool hyphenationEnabled = false;
+  bool streamItem = false;
+  ZipEntryReader itemReader;
+  FootnoteStore footnoteStore;
+  SectionFlow flow;
+  WordWidthCache widthCache;
+  CssParser* cssParser = nullptr;
+  std::vector<uint32_t> lut;
+  std::vector<PageAnchor> anchors;
+  std::vector<PageCost> costs;
+  std::vector<ElementIdPage> idPages;
+  std::function<void(int, const Page&)> pageReadyFn;
+  std::unique_ptr<ChapterHtmlSlimParser> visitor;
+};
+
+Section::Section(const std::shared_ptr<Epub>& epub, const int spineIndex, GfxRenderer& renderer)
+    : epub(epub), spineIndex(spineIndex), renderer(renderer) {}
+
+Section::~Section() {
+  abortSectionFile();
+  if (file) {
+    file.close();
+  }
+}
+
+bool Section::createSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                                const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                                const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle,
+                                const std::function<void()>& popupFn,
+                                const std::function<bool()>& shouldAbortFn,
+                                const std::function<void(int, const Page&)>& pageReadyFn) {
+  TRACE("sect.build");
+  ALLOC_SESSION("sect.build");
+  ALLOC_SCOPE("sect.build");
+  BuildStep step = beginSectionFile(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                                    viewportHeight, hyphenationEnabled, embeddedStyle, popupFn, shouldAbortFn,
+                                    pageReadyFn);
+  while (step == BuildStep::More) {
+    if (shouldAbortFn && shouldAbortFn()) {
+      LOG_DBG("SCT", "Build aborted");
+      abortSectionFile();
+      return false;
+    }
+    step = stepSectionFile();
+  }
+  return step == BuildStep::Done;
+}
+
+Section::BuildStep Section::beginSectionFile(const int fontId, const float lineCompression,
+                                             const bool extraParagraphSpacing, const uint8_t paragraphAlignment,
+                                             const uint16_t viewportWidth, const uint16_t viewportHeight,
+                                             const bool hyphenationEnabled, const bool embeddedStyle,
+                                             const std::function<void()>& popupFn,
+                                             const std::function<bool()>& shouldAbortFn,
+                                             const std::function<void(int, const Page&)>& pageReadyFn) {
+  abortSectionFile();
+  const uint32_t key = layoutKey(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                                 viewportHeight, hyphenationEnabled, embeddedStyle);
+  useLayout(key);
+  // Create the layout's directory (and sections/ above it) if it doesn't exist
+  Storage.mkdir(epub->getSectionDir(key).c_str());
+
+  uint8_t attempts = 0;
+  if (salvageInterruptedBuild(attempts)) {
+    builtLayoutKey = key;
+    recordPageCount();
+    metrics::add(metrics::SECTION_BUILDS);
+    return BuildStep::Done;
+  }
+  if (relayoutSection(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth, viewportHeight,
+                      hyphenationEnabled, embeddedStyle, shouldAbortFn, pageReadyFn)) {
+    builtLayoutKey = key;
+    recordPageCount();
+    metrics::add(metrics::SECTION_RELAYOUTS);
+    return BuildStep::Done;
+  }
+
+  auto next = std::unique_ptr<Build>(new Build(*epub, spineIndex, flowPath));
+  next->key = key;
+  next->hyphenationEnabled = hyphenationEnabled;
+  next->pageReadyFn = pageReadyFn;
+
+  // Inflate the chapter straight into the parser. Only if the inflate state can't be allocated fall back to
+  // extracting it to a temp file first, which needs the memory only until parsing starts.
+  next->streamItem = epub->openItemReader(next->localPath, next->itemReader);
+  if (!next->streamItem) {
+    LOG_DBG("SCT", "Can't stream item, extracting to temp file");
+    if (!extractToTempFile(next->localPath, next->tmpHtmlPath)) {
+      return BuildStep::Failed;
+    }
+  }
+
+  if (shouldAbortFn && shouldAbortFn()) {
+    if (!next->streamItem) {
+      Storage.remove(next->tmpHtmlPath.c_str());
+    }
+    return BuildStep::Failed;
+  }
 
   if (!Storage.openFileForWrite("SCT", filePath, file)) {
-    return false;
+    return BuildStep::Failed;
   }
+  file.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
   writeSectionFileHeader(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
                          viewportHeight, hyphenationEnabled, embeddedStyle);
-  std::vector<uint32_t> lut = {};
+  checkpointedPages = 0;
+  if (Storage.openFileForWrite("SCT", checkpointPath, checkpointFile)) {
+    serialization::writePod(checkpointFile, CHECKPOINT_FILE_VERSION);
+    serialization::writePod(checkpointFile, static_cast<uint8_t>(std::min<int>(attempts + 1, UINT8_MAX)));
+    checkpointFile.flush();
+  }
 
   // Derive the content base directory and image cache path prefix for the parser
+  const std::string& localPath = next->localPath;
   size_t lastSlash = localPath.find_last_of('/');
   std::string contentBase = (lastSlash != std::string::npos) ? localPath.substr(0, lastSlash + 1) : "";
-  std::string imageBasePath = epub->getCachePath() + "/img_" + std::to_string(spineIndex) + "_";
+  std::string imageBasePath = epub->getCachePath() + "/img_";
 
-  CssParser* cssParser = nullptr;
   if (embeddedStyle) {
-    cssParser = epub->getCssParser();
-    if (cssParser) {
-      if (!cssParser->loadFromCache()) {
+    next->cssParser = epub->getCssParser();
+    if (next->cssParser) {
+      // Rules themselves are merged in as the parser meets the chapter's <link rel="stylesheet"> elements
+      if (!next->cssParser->loadCacheIndex()) {
         LOG_ERR("SCT", "Failed to load CSS from cache");
       }
     }
   }
 
-  ChapterHtmlSlimParser visitor(
-      epub, tmpHtmlPath, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+  Build& b = *next;
+  build = std::move(next);
+  // Builds poll for aborts between steps, so the parser gets no shouldAbortFn of its own
+  b.visitor.reset(new ChapterHtmlSlimParser(
+      epub, b.tmpHtmlPath, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
       viewportHeight, hyphenationEnabled,
-      [this, &lut](std::unique_ptr<Page> page) { lut.emplace_back(this->onPageComplete(std::move(page))); },
-      embeddedStyle, contentBase, imageBasePath, popupFn, cssParser);
+      [this, &b](std::unique_ptr<Page> page) {
+        if (b.pageReadyFn) {
+          b.pageReadyFn(pageCount, *page);
+        }
+        b.lut.emplace_back(this->onPageComplete(std::move(page), b.anchors, b.costs));
+        if (b.lut.size() % CHECKPOINT_PAGES == 0) {
+          writeCheckpoint(b.lut, b.anchors, b.costs);
+        }
+      },
+      embeddedStyle, contentBase, imageBasePath, popupFn, b.cssParser));
+  if (b.streamItem) {
+    b.visitor->setItemReader(&b.itemReader);
+  }
+  b.visitor->setIdPages(&b.idPages);
+  if (Storage.openFileForWrite("SCT", landmarkPath, landmarkFile)) {
+    serialization::writePod(landmarkFile, LANDMARK_FILE_VERSION);
+    serialization::writePod(landmarkFile, static_cast<uint16_t>(0));  // Placeholder for page count
+  }
+  b.footnoteStore.begin();
+  b.visitor->setFootnoteStore(&b.footnoteStore);
+  if (b.flow.begin(flowKey(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                           hyphenationEnabled, embeddedStyle))) {
+    b.visitor->setFlow(&b.flow);
+  }
+  if (b.widthCache.load()) {
+    b.visitor->setWordWidthCache(&b.widthCache);
+  }
   Hyphenator::setPreferredLanguage(epub->getLanguage());
-  success = visitor.parseAndBuildPages();
+  if (hyphenationEnabled) {
+    BreakSidecar::begin(b.breakSidecarPath);
+  }
+  if (!b.visitor->beginParse()) {
+    finishBuild(false);
+    return BuildStep::Failed;
+  }
+  return BuildStep::More;
+}
 
-  Storage.remove(tmpHtmlPath.c_str());
-  if (!success) {
+Section::BuildStep Section::stepSectionFile() {
+  if (!build) {
+    return BuildStep::Failed;
+  }
+  ChapterHtmlSlimParser::ParseStep step;
+  {
+    // Inflate, XML parse, layout and page serialization of one buffer
+    TRACE("sect.parse");
+    step = build->visitor->parseNext();
+  }
+  if (step == ChapterHtmlSlimParser::ParseStep::More) {
+    return BuildStep::More;
+  }
+  return finishBuild(step == ChapterHtmlSlimParser::ParseStep::Done) ? BuildStep::Done : BuildStep::Failed;
+}
+
+void Section::abortSectionFile() {
+  if (build) {
+    finishBuild(false);
+  }
+}
+
+bool Section::finishBuild(const bool parsed) {
+  Build& b = *build;
+  // Lets go of the XML parser and the chapter file if the parse was cut short
+  b.visitor.reset();
+  b.footnoteStore.finish();
+  if (!parsed) {
+    b.flow.discard();
+  }
+  b.flow.finish();
+  if (landmarkFile) {
+    landmarkFile.seek(sizeof(LANDMARK_FILE_VERSION));
+    serialization::writePod(landmarkFile, parsed ? pageCount : static_cast<uint16_t>(0));
+    landmarkFile.close();
+  }
+  // Widths and breaks computed before a failure or cancellation are still valid
+  b.widthCache.save();
+  if (b.hyphenationEnabled) {
+    BreakSidecar::finish(b.breakSidecarPath);
+  }
+
+  b.itemReader.close();
+  if (!b.streamItem) {
+    Storage.remove(b.tmpHtmlPath.c_str());
+  }
+  // Only an interrupted build leaves its checkpoint behind; a failed or cancelled one starts over next time
+  if (checkpointFile) {
+    checkpointFile.close();
+  }
+  Storage.remove(checkpointPath.c_str());
+
+  bool ok = parsed;
+  if (!parsed) {
     LOG_ERR("SCT", "Failed to parse XML and build pages");
     file.close();
     Storage.remove(filePath.c_str());
-    if (cssParser) {
-      cssParser->clear();
-    }
-    return false;
+  } else if (!finishSectionFile(b.lut, b.anchors, b.costs, b.idPages)) {
+    Storage.remove(filePath.c_str());
+    ok = false;
+  } else {
+    packSectionFiles();
+    builtLayoutKey = b.key;
+    recordPageCount();
+    metrics::add(metrics::SECTION_BUILDS);
+  }
+  if (b.cssParser) {
+    b.cssParser->clear();
   }
+  build.reset();
+  return ok;
+}
 
+bool Section::finishSectionFile(std::vector<uint32_t>& lut, const std::vector<PageAnchor>& anchors,
+                                const std::vector<PageCost>& costs, std::vector<ElementIdPage>& idPages) {
   const uint32_t lutOffset = file.position();
   bool hasFailedLutRecords = false;
   // Write LUT
@@ -230,35 +657,480 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
   if (hasFailedLutRecords) {
     LOG_ERR("SCT", "Failed to write LUT due to invalid page positions");
     file.close();
-    Storage.remove(filePath.c_str());
     return false;
   }
+  // Anchor table, one record per page straight after the LUT
+  for (const PageAnchor& anchor : anchors) {
+    serialization::writePod(file, anchor.paragraph);
+    serialization::writePod(file, anchor.word);
+  }
+  // Cost table, one record per page after the anchors
+  for (const PageCost& cost : costs) {
+    serialization::writePod(file, cost);
+  }
+  // Id table, sorted by hash so a lookup is one read and a binary search. Stable, so a repeated id keeps its first page.
+  std::stable_sort(idPages.begin(), idPages.end(),
+                   [](const ElementIdPage& a, const ElementIdPage& b) { return a.idHash < b.idHash; });
+  serialization::writePod(file, static_cast<uint16_t>(idPages.size()));
+  for (const ElementIdPage& entry : idPages) {
+    serialization::writePod(file, entry.idHash);
+    serialization::writePod(file, std::min(entry.page, static_cast<uint16_t>(pageCount > 0 ? pageCount - 1 : 0)));
+  }
 
   // Go back and write LUT offset
   file.seek(HEADER_SIZE - sizeof(uint32_t) - sizeof(pageCount));
   serialization::writePod(file, pageCount);
   serialization::writePod(file, lutOffset);
   file.close();
-  if (cssParser) {
-    cssParser->clear();
+  pageLut = std::move(lut);
+  pageDataEnd = lutOffset;
+  return true;
+}
+
+void Section::writeCheckpoint(const std::vector<uint32_t>& lut, const std::vector<PageAnchor>& anchors,
+                              const std::vector<PageCost>& costs) {
+  if (!checkpointFile || lut.size() <= checkpointedPages) {
+    return;
+  }
+  // The pages have to be on the card before the records pointing at them
+  file.flush();
+  serialization::writePod(checkpointFile, static_cast<uint16_t>(lut.size() - checkpointedPages));
+  serialization::writePod(checkpointFile, static_cast<uint32_t>(file.position()));
+  for (size_t i = checkpointedPages; i < lut.size(); i++) {
+    serialization::writePod(checkpointFile, lut[i]);
+    serialization::writePod(checkpointFile, anchors[i].paragraph);
+    serialization::writePod(checkpointFile, anchors[i].word);
+    serialization::writePod(checkpointFile, costs[i]);
   }
+  checkpointFile.flush();
+  checkpointedPages = lut.size();
+}
+
+bool Section::salvageInterruptedBuild(uint8_t& attempts) {
+  attempts = 0;
+  FsFile checkpoint;
+  if (!Storage.exists(checkpointPath.c_str()) || !Storage.openFileForRead("SCT", checkpointPath, checkpoint)) {
+    return false;
+  }
+  uint8_t version = 0;
+  serialization::readPod(checkpoint, version);
+  serialization::readPod(checkpoint, attempts);
+  if (version != CHECKPOINT_FILE_VERSION) {
+    attempts = 0;
+    return false;
+  }
+  LOG_ERR("SCT", "Section build was interrupted %u time(s)", attempts);
+  if (attempts < MAX_BUILD_ATTEMPTS) {
+    return false;
+  }
+
+  // Batches are appended whole and flushed; a torn last one is ignored
+  std::vector<uint32_t> lut;
+  std::vector<PageAnchor> anchors;
+  std::vector<PageCost> costs;
+  uint32_t dataEnd = 0;
+  uint8_t record[CHECKPOINT_RECORD_SIZE];
+  while (true) {
+    uint16_t count = 0;
+    uint32_t batchEnd = 0;
+    if (checkpoint.read(reinterpret_cast<uint8_t*>(&count), sizeof(count)) != sizeof(count) ||
+        checkpoint.read(reinterpret_cast<uint8_t*>(&batchEnd), sizeof(batchEnd)) != sizeof(batchEnd) ||
+        checkpoint.available() < static_cast<int>(count * CHECKPOINT_RECORD_SIZE)) {
+      break;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+      checkpoint.read(record, sizeof(record));
+      PageAnchor anchor;
+      PageCost cost;
+      uint32_t position;
+      memcpy(&position, record, sizeof(position));
+      memcpy(&anchor.paragraph, record + 4, sizeof(anchor.paragraph));
+      memcpy(&anchor.word, record + 8, sizeof(anchor.word));
+      memcpy(&cost, record + 12, sizeof(cost));
+      lut.push_back(position);
+      anchors.push_back(anchor);
+      costs.push_back(cost);
+    }
+    dataEnd = batchEnd;
+  }
+  checkpoint.close();
+  if (lut.empty()) {
+    return false;
+  }
+
+  file = Storage.open(filePath.c_str(), O_RDWR);
+  uint8_t fileVersion = 0;
+  if (!file || file.size() < dataEnd || file.read(&fileVersion, 1) != 1 || fileVersion != SECTION_FILE_VERSION) {
+    if (file) {
+      file.close();
+    }
+    return false;
+  }
+  file.seek(dataEnd);
+  pageCount = lut.size();
+  std::vector<ElementIdPage> noIds;
+  if (!finishSectionFile(lut, anchors, costs, noIds)) {
+    pageCount = 0;
+    return false;
+  }
+  Storage.remove(checkpointPath.c_str());
+  // The interrupted build's flow runs past the pages kept
+  Storage.remove(flowPath.c_str());
+  packSectionFiles();
+  LOG_ERR("SCT", "Kept the %u pages built before the interruptions", pageCount);
   return true;
 }
 
-std::unique_ptr<Page> Section::loadPageFromSectionFile() {
-  if (!Storage.openFileForRead("SCT", filePath, file)) {
-    return nullptr;
+bool Section::relayoutSection(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                              const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                              const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle,
+                              const std::function<bool()>& shouldAbortFn,
+                              const std::function<void(int, const Page&)>& pageReadyFn) {
+  const uint32_t key = flowKey(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                               hyphenationEnabled, embeddedStyle);
+  BookPack& pack = epub->getSectionPack();
+  FsFile flow;
+  FsFile source;
+  uint32_t lineTotal = 0;
+  for (const uint32_t layout : epub->getSectionLayouts()) {
+    if (layout == usedLayoutKey || !pack.open(BookPack::FLOW, layout, spineIndex, flow)) {
+      continue;
+    }
+    if (SectionFlow::readHeader(flow, key, lineTotal) && pack.open(BookPack::SECTION, layout, spineIndex, source)) {
+      break;
+    }
+    flow.close();
+  }
+  if (!source) {
+    return false;
   }
 
-  file.seek(HEADER_SIZE - sizeof(uint32_t));
-  uint32_t lutOffset;
-  serialization::readPod(file, lutOffset);
-  file.seek(lutOffset + sizeof(uint32_t) * currentPage);
-  uint32_t pagePos;
-  serialization::readPod(file, pagePos);
-  file.seek(pagePos);
+  TRACE("sect.relayout");
+  source.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
+  bool success = false;
+  if (Storage.openFileForWrite("SCT", filePath, file)) {
+    file.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
+    pageCount = 0;
+    writeSectionFileHeader(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                           viewportHeight, hyphenationEnabled, embeddedStyle);
+    success = cutPages(source, flow, lineTotal, fontId, lineCompression, viewportHeight, shouldAbortFn, pageReadyFn);
+  }
+  source.close();
+
+  // The lines are the same for every viewport height, so the new layout gets a copy of the flow
+  if (success && flow.seek(0)) {
+    FsFile copy;
+    success = Storage.openFileForWrite("SCT", flowPath, copy);
+    uint8_t buffer[512];
+    int read;
+    while (success && (read = flow.read(buffer, sizeof(buffer))) > 0) {
+      success = copy.write(buffer, read) == static_cast<size_t>(read);
+    }
+    if (copy) {
+      copy.close();
+    }
+  }
+  flow.close();
+
+  if (!success) {
+    if (file) {
+      file.close();
+    }
+    pageCount = 0;
+    Storage.remove(filePath.c_str());
+    Storage.remove(landmarkPath.c_str());
+    Storage.remove(flowPath.c_str());
+    return false;
+  }
+  if (Storage.exists(checkpointPath.c_str())) {
+    Storage.remove(checkpointPath.c_str());
+  }
+  packSectionFiles();
+  LOG_DBG("SCT", "Cut %u pages from the lines of another layout", pageCount);
+  return true;
+}
+
+bool Section::cutPages(FsFile& source, FsFile& flow, const uint32_t lineTotal, const int fontId,
+                       const float lineCompression, const uint16_t viewportHeight,
+                       const std::function<bool()>& shouldAbortFn,
+                       const std::function<void(int, const Page&)>& pageReadyFn) {
+  uint8_t version = 0;
+  uint16_t sourcePageCount = 0;
+  uint32_t sourceLutOffset = 0;
+  serialization::readPod(source, version);
+  source.seek(HEADER_SIZE - sizeof(uint32_t) - sizeof(pageCount));
+  serialization::readPod(source, sourcePageCount);
+  serialization::readPod(source, sourceLutOffset);
+  if (version != SECTION_FILE_VERSION || sourceLutOffset == 0 || sourcePageCount == 0) {
+    return false;
+  }
+  std::vector<uint32_t> sourceLut(sourcePageCount);
+  const size_t lutBytes = sizeof(uint32_t) * sourcePageCount;
+  source.seek(sourceLutOffset);
+  if (source.read(reinterpret_cast<uint8_t*>(sourceLut.data()), lutBytes) != static_cast<int>(lutBytes)) {
+    return false;
+  }
+
+  if (Storage.openFileForWrite("SCT", landmarkPath, landmarkFile)) {
+    serialization::writePod(landmarkFile, LANDMARK_FILE_VERSION);
+    serialization::writePod(landmarkFile, static_cast<uint16_t>(0));  // Placeholder for page count
+  }
+  std::vector<uint32_t> lut;
+  std::vector<PageAnchor> anchors;
+  std::vector<PageCost> costs;
+  std::vector<uint32_t> pageFirstLines = {0};
+  auto page = std::unique_ptr<Page>(new Page());
+  size_t pageLines = 0;
+  const auto completePage = [&]() {
+    if (pageReadyFn) {
+      pageReadyFn(pageCount, *page);
+    }
+    lut.emplace_back(onPageComplete(std::move(page), anchors, costs));
+    page.reset(new Page());
+    pageLines = 0;
+  };
+
+  // Same placement as ChapterHtmlSlimParser::addLineToPage, with the spacing and anchors the flow recorded
+  const int lineHeight = renderer.getLineHeight(fontId) * lineCompression;
+  SectionFlow::Line line;
+  uint32_t lineIndex = 0;
+  int y = 0;
+  bool ok = true;
+  for (uint16_t sourcePage = 0; ok && sourcePage < sourcePageCount; sourcePage++) {
+    source.seek(sourceLut[sourcePage]);
+    const auto from = Page::deserialize(source);
+    if (!from || (shouldAbortFn && shouldAbortFn())) {
+      ok = false;
+      break;
+    }
+    size_t footnote = 0;
+    for (uint16_t i = 0; i < from->getLineCount(); i++) {
+      if (lineIndex >= lineTotal || !SectionFlow::readLine(flow, line)) {
+        ok = false;
+        break;
+      }
+      y += line.gap;
+      if (y + lineHeight > viewportHeight) {
+        completePage();
+        pageFirstLines.push_back(lineIndex);
+        y = 0;
+      }
+      if (pageLines == 0) {
+        page->anchor = line.anchor;
+        page->landmark = line.landmark;
+      }
+      for (uint8_t f = 0; f < line.footnotes && footnote < from->footnotes.size(); f++, footnote++) {
+        page->addFootnote(from->footnotes[footnote].number, from->footnotes[footnote].href);
+      }
+      if (!page->appendLine(renderer, fontId, *from, i, static_cast<int16_t>(y))) {
+        ok = false;
+        break;
+      }
+      pageLines++;
+      y += lineHeight;
+      lineIndex++;
+    }
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> ids;
+  ok = ok && lineIndex == lineTotal && SectionFlow::readIds(flow, ids);
+  if (ok) {
+    completePage();
+  }
+  if (landmarkFile) {
+    landmarkFile.seek(sizeof(LANDMARK_FILE_VERSION));
+    serialization::writePod(landmarkFile, ok ? pageCount : static_cast<uint16_t>(0));
+    landmarkFile.close();
+  }
+  if (!ok) {
+    LOG_ERR("SCT", "Flow doesn't match the pages of its layout");
+    return false;
+  }
+
+  // An id recorded after the last line belongs to the last page
+  std::vector<ElementIdPage> idPages;
+  idPages.reserve(ids.size());
+  for (const auto& id : ids) {
+    const auto it = std::upper_bound(pageFirstLines.begin(), pageFirstLines.end(), id.second);
+    const auto idPage = id.second < lineTotal ? it - pageFirstLines.begin() - 1 : pageCount - 1;
+    idPages.push_back({id.first, static_cast<uint16_t>(idPage)});
+  }
+  return finishSectionFile(lut, anchors, costs, idPages);
+}
+
+
+
+int Section::getPageForProgress(const float progress) const {
+  if (pageLut.empty()) {
+    return 0;
+  }
+  const uint32_t start = pageLut.front();
+  const uint32_t end = std::max(pageDataEnd, pageLut.back());
+  const float clamped = std::min(std::max(progress, 0.0f), 1.0f);
+  const auto target = start + static_cast<uint32_t>(clamped * static_cast<float>(end - start));
+  const auto it = std::upper_bound(pageLut.begin(), pageLut.end(), target);
+  return std::max(0, static_cast<int>(it - pageLut.begin()) - 1);
+}
 
+bool Section::getPageAnchor(const int pageIndex, PageAnchor& anchor) {
+  if (pageIndex < 0 || pageIndex >= static_cast<int>(pageLut.size()) || !openForReading()) {
+    return false;
+  }
+  // Anchor records sit right after the LUT, which starts where the page data ends
+  file.seek(pageDataEnd + sizeof(uint32_t) * pageCount + ANCHOR_RECORD_SIZE * pageIndex);
+  serialization::readPod(file, anchor.paragraph);
+  serialization::readPod(file, anchor.word);
+  return true;
+}
+
+bool Section::getPageCost(const int pageIndex, PageCost& cost) {
+  if (pageIndex < 0 || pageIndex >= static_cast<int>(pageLut.size()) || !openForReading()) {
+    return false;
+  }
+  file.seek(pageDataEnd + (sizeof(uint32_t) + ANCHOR_RECORD_SIZE) * pageCount + sizeof(PageCost) * pageIndex);
+  return file.read(reinterpret_cast<uint8_t*>(&cost), sizeof(cost)) == sizeof(cost);
+}
+
+int Section::getPageForAnchor(const PageAnchor& anchor) {
+  // Last page whose first word is at or before the anchor
+  int lo = 0;
+  int hi = static_cast<int>(pageLut.size()) - 1;
+  int page = 0;
+  while (lo <= hi) {
+    const int mid = lo + (hi - lo) / 2;
+    PageAnchor midAnchor;
+    if (!getPageAnchor(mid, midAnchor)) {
+      break;
+    }
+    if (anchor < midAnchor) {
+      hi = mid - 1;
+    } else {
+      page = mid;
+      lo = mid + 1;
+    }
+  }
+  return page;
+}
+
+bool Section::openLandmarks(FsFile& landmarks, uint16_t& count) const {
+  if (!epub->getSectionPack().open(BookPack::LANDMARKS, usedLayoutKey, spineIndex, landmarks) &&
+      (!Storage.exists(landmarkPath.c_str()) || !Storage.openFileForRead("SCT", landmarkPath, landmarks))) {
+    return false;
+  }
+  uint8_t version = 0;
+  count = 0;
+  serialization::readPod(landmarks, version);
+  serialization::readPod(landmarks, count);
+  // A sidecar left from another layout of the chapter has another page count
+  if (version != LANDMARK_FILE_VERSION || count != pageCount) {
+    landmarks.close();
+    return false;
+  }
+  return true;
+}
+
+bool Section::getPageLandmark(const int pageIndex, std::string& landmark) const {
+  FsFile landmarks;
+  uint16_t count;
+  if (pageIndex < 0 || !openLandmarks(landmarks, count) || pageIndex >= count) {
+    return false;
+  }
+  uint32_t len = 0;
+  for (int i = 0; i < pageIndex; i++) {
+    serialization::readPod(landmarks, len);
+    landmarks.seek(landmarks.position() + len);
+  }
+  serialization::readString(landmarks, landmark);
+  landmarks.close();
+  return true;
+}
+
+int Section::getPageForLandmark(const std::string& landmark) const {
+  FsFile landmarks;
+  uint16_t count;
+  if (landmark.empty() || !openLandmarks(landmarks, count)) {
+    return -1;
+  }
+  // Landmarks follow document order, so the answer is the last page that definitely starts at or before the
+  // target. Pages whose order can't be decided from the paths alone are passed over.
+  int page = -1;
+  std::string pageLandmark;
+  for (int i = 0; i < count; i++) {
+    serialization::readString(landmarks, pageLandmark);
+    const int order = compareDomPaths(pageLandmark, landmark);
+    if (order == 1) {
+      break;
+    }
+    if (order != 2) {
+      page = i;
+    }
+  }
+  landmarks.close();
+  return page;
+}
+
+int Section::getPageForId(const std::string& id) {
+  if (id.empty() || pageLut.empty() || !openForReading()) {
+    return -1;
+  }
+  file.seek(pageDataEnd + (sizeof(uint32_t) + ANCHOR_RECORD_SIZE + sizeof(PageCost)) * pageCount);
+  uint16_t count = 0;
+  serialization::readPod(file, count);
+  if (count == 0) {
+    return -1;
+  }
+
+  constexpr size_t RECORD_SIZE = sizeof(uint32_t) + sizeof(uint16_t);
+  std::vector<uint8_t> table(RECORD_SIZE * count);
+  if (file.read(table.data(), table.size()) != static_cast<int>(table.size())) {
+    LOG_ERR("SCT", "Truncated id table");
+    return -1;
+  }
+
+  // Lower bound on the hash, so the first of any repeated id wins
+  const uint32_t hash = ChapterHtmlSlimParser::idHash(id.c_str());
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    uint32_t midHash;
+    memcpy(&midHash, table.data() + RECORD_SIZE * mid, sizeof(midHash));
+    if (midHash < hash) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo >= count) {
+    return -1;
+  }
+  uint32_t foundHash;
+  memcpy(&foundHash, table.data() + RECORD_SIZE * lo, sizeof(foundHash));
+  if (foundHash != hash) {
+    return -1;
+  }
+  uint16_t page;
+  memcpy(&page, table.data() + RECORD_SIZE * lo + sizeof(uint32_t), sizeof(page));
+  return page;
+}
+
+std::unique_ptr<Page> Section::loadPageFromSectionFile() { return loadPageFromSectionFile(currentPage); }
+
+std::unique_ptr<Page> Section::loadPageFromSectionFile(const int pageIndex) {
+  TRACE("page.load");
+  if (pageIndex < 0 || pageIndex >= static_cast<int>(pageLut.size())) {
+    LOG_ERR("SCT", "Page %d not in LUT (%zu pages)", pageIndex, pageLut.size());
+    return nullptr;
+  }
+  if (!openForReading()) {
+    return nullptr;
+  }
+
+  file.seek(pageLut[pageIndex]);
   auto page = Page::deserialize(file);
-  file.close();
+  if (!page) {
+    // Drop the handle so a retry starts from a fresh open
+    file.close();
+  }
   return page;
 }
@@ -1,39 +1,135 @@
 #pragma once
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "Epub.h"
 
 class Page;
 class GfxRenderer;
+struct PageAnchor;
+struct PageCost;
+struct ElementIdPage;
 
 class Section {
   std::shared_ptr<Epub> epub;
   const int spineIndex;
   GfxRenderer& renderer;
+  // Set by useLayout(): the layout's key, and where a build writes the section before it moves into the book's pack
+  uint32_t usedLayoutKey = 0;
   std::string filePath;
   FsFile file;
+  // Page offsets, loaded once so page turns only need a single seek on the (kept open) section file
+  std::vector<uint32_t> pageLut;
+  // End of the page records (start of the LUT)
+  uint32_t pageDataEnd = 0;
 
   void writeSectionFileHeader(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                               uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled,
                               bool embeddedStyle);
-  uint32_t onPageComplete(std::unique_ptr<Page> page);
+  // Per-page DOM landmarks for KOReader sync live in a sidecar written alongside the pages, so they never pile up
+  // in RAM during the build
+  std::string landmarkPath;
+  FsFile landmarkFile;
+
+  // Layout the pages were built for, see layoutKey()
+  uint32_t builtLayoutKey = 0;
+
+  // Pages of a build in progress that have reached the card, appended every few pages. If the build is cut short
+  // (power loss, watchdog), the next one knows how far it got, and a chapter whose builds keep getting cut short is
+  // served with the pages completed so far instead of being rebuilt forever.
+  std::string checkpointPath;
+  FsFile checkpointFile;
+  // Line flow recorded by a build, so a layout differing only in viewport height can be cut from this one's pages
+  std::string flowPath;
+  uint16_t checkpointedPages = 0;
+  void writeCheckpoint(const std::vector<uint32_t>& lut, const std::vector<PageAnchor>& anchors,
+                       const std::vector<PageCost>& costs);
+  bool salvageInterruptedBuild(uint8_t& attempts);
+  // Cut the pages from the lines of a kept layout that only differs in viewport height (e.g. another status bar),
+  // instead of parsing and laying out the chapter again. False if there is none or its flow wasn't recorded.
+  bool relayoutSection(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                       uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled, bool embeddedStyle,
+                       const std::function<bool()>& shouldAbortFn,
+                       const std::function<void(int pageIndex, const Page& page)>& pageReadyFn);
+  bool cutPages(FsFile& source, FsFile& flow, uint32_t lineTotal, int fontId, float lineCompression,
+                uint16_t viewportHeight, const std::function<bool()>& shouldAbortFn,
+                const std::function<void(int pageIndex, const Page& page)>& pageReadyFn);
+  // Write the LUT, anchor, cost and id tables after the pages and fill in the header; closes the file
+  bool finishSectionFile(std::vector<uint32_t>& lut, const std::vector<PageAnchor>& anchors,
+                         const std::vector<PageCost>& costs, std::vector<ElementIdPage>& idPages);
+
+  void recordPageCount() const;
+  uint32_t onPageComplete(std::unique_ptr<Page> page, std::vector<PageAnchor>& anchors, std::vector<PageCost>& costs);
+  bool openLandmarks(FsFile& landmarks, uint16_t& count) const;
+  bool extractToTempFile(const std::string& localPath, const std::string& tmpHtmlPath) const;
+  bool openForReading();
+  // The finished section from the book's pack, or the standalone file of a build that hasn't moved in (yet)
+  bool openSectionFile();
+  // Move the finished section file and its landmarks into the book's pack
+  void packSectionFiles() const;
+  void useLayout(uint32_t key);
+
+  // Build in progress between stepSectionFile() calls, see beginSectionFile()
+  struct Build;
+  std::unique_ptr<Build> build;
+  // Close the files of the build and, if the chapter was parsed to the end, write out the section; else drop it
+  bool finishBuild(bool parsed);
 
  public:
   uint16_t pageCount = 0;
   int currentPage = 0;
 
-  explicit Section(const std::shared_ptr<Epub>& epub, const int spineIndex, GfxRenderer& renderer)
-      : epub(epub),
-        spineIndex(spineIndex),
-        renderer(renderer),
-        filePath(epub->getCachePath() + "/sections/" + std::to_string(spineIndex) + ".bin") {}
-  ~Section() = default;
+  explicit Section(const std::shared_ptr<Epub>& epub, const int spineIndex, GfxRenderer& renderer);
+  ~Section();
+  // Hash of the parameters a section's pages depend on, the same for every spine item
+  static uint32_t layoutKey(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                            uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled,
+                            bool embeddedStyle);
+  // layoutKey() without the viewport height: layouts with the same flow key break the chapter into the same lines.
+  // Line compression and extra paragraph spacing stay in, they change line breaks too (see SectionFlow).
+  static uint32_t flowKey(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                          uint16_t viewportWidth, bool hyphenationEnabled, bool embeddedStyle);
+  uint32_t getLayoutKey() const { return builtLayoutKey; }
+
   bool loadSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                        uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled, bool embeddedStyle);
-  bool clearCache() const;
+  bool clearCache();
+  // pageReadyFn sees each page as soon as it is laid out, before the rest of the chapter, so the page a reader waits
+  // for can go on screen while the build carries on
   bool createSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                          uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled, bool embeddedStyle,
-                         const std::function<void()>& popupFn = nullptr);
+                         const std::function<void()>& popupFn = nullptr,
+                         const std::function<bool()>& shouldAbortFn = nullptr,
+                         const std::function<void(int pageIndex, const Page& page)>& pageReadyFn = nullptr);
+  // createSectionFile() in steps of one parse buffer, for a build that pauses in between. beginSectionFile() sets
+  // the build up; a section salvaged or cut from another layout is Done right there. While it returns More,
+  // stepSectionFile() parses the next buffer. abortSectionFile() (or destroying the section) drops an unfinished
+  // build and its partial output.
+  enum class BuildStep : uint8_t { More, Done, Failed };
+  BuildStep beginSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                             uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled,
+                             bool embeddedStyle, const std::function<void()>& popupFn = nullptr,
+                             const std::function<bool()>& shouldAbortFn = nullptr,
+                             const std::function<void(int pageIndex, const Page& page)>& pageReadyFn = nullptr);
+  BuildStep stepSectionFile();
+  void abortSectionFile();
+  // Page holding the given fraction (0-1) of the chapter, estimated from how the page records divide the file
+  int getPageForProgress(float progress) const;
+  // Where the given page starts in the chapter text; read from the anchor table that follows the page LUT
+  bool getPageAnchor(int pageIndex, PageAnchor& anchor);
+  // Page of this layout containing the given anchor, found by binary search over the anchor table. Lets a
+  // position saved under another font or viewport land on the page holding the same word.
+  int getPageForAnchor(const PageAnchor& anchor);
+  // Render cost estimate of the given page, from the cost table after the anchors; one small read, the page itself
+  // isn't loaded
+  bool getPageCost(int pageIndex, PageCost& cost);
+  // DOM path below <body> of the block the page starts in ("/div[1]/p[3]"), the xpointer KOReader sync sends
+  bool getPageLandmark(int pageIndex, std::string& landmark) const;
+  // Last page starting at or before the given DOM path, -1 if the landmarks can't place it
+  int getPageForLandmark(const std::string& landmark) const;
+  // Page on which the element with the given id starts, -1 if the chapter has no such id
+  int getPageForId(const std::string& id);
   std::unique_ptr<Page> loadPageFromSectionFile();
+  std::unique_ptr<Page> loadPageFromSectionFile(int pageIndex);
 };
@@ -0,0 +1,139 @@
+#include "SectionFlow.h"
+
+#include <Logging.h>
+#include <Serialization.h>
+
+namespace {
+constexpr uint8_t FLOW_FILE_VERSION = 1;
+constexpr uint8_t FLAG_LANDMARK = 1 << 0;
+// Line record without the landmark: gap, footnotes, flags, anchor paragraph and word
+constexpr size_t LINE_RECORD_SIZE =
+    sizeof(int16_t) + sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t);
+// Longer DOM paths than this are taken for a damaged file
+constexpr uint32_t MAX_LANDMARK_LEN = 1024;
+}  // namespace
+
+bool SectionFlow::begin(const uint32_t flowKey) {
+  if (!Storage.openFileForWrite("FLW", path, file)) {
+    failed = true;
+    return false;
+  }
+  file.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
+  serialization::writePod(file, FLOW_FILE_VERSION);
+  serialization::writePod(file, flowKey);
+  serialization::writePod(file, static_cast<uint32_t>(0));  // Placeholder for the line count
+  return true;
+}
+
+void SectionFlow::writePending() {
+  if (!hasPending) {
+    return;
+  }
+  const bool newLandmark = lineCount == 0 || pending.landmark != writtenLandmark;
+  serialization::writePod(file, pending.gap);
+  serialization::writePod(file, pending.footnotes);
+  serialization::writePod(file, static_cast<uint8_t>(newLandmark ? FLAG_LANDMARK : 0));
+  serialization::writePod(file, pending.anchor.paragraph);
+  serialization::writePod(file, pending.anchor.word);
+  if (newLandmark) {
+    serialization::writeString(file, pending.landmark);
+    writtenLandmark = pending.landmark;
+  }
+  lineCount++;
+  hasPending = false;
+}
+
+void SectionFlow::addLine(const int16_t gap, const PageAnchor& anchor, const std::string& landmark) {
+  if (!file || discarded) {
+    return;
+  }
+  writePending();
+  pending.gap = gap;
+  pending.footnotes = 0;
+  pending.anchor = anchor;
+  pending.landmark = landmark;
+  hasPending = true;
+}
+
+void SectionFlow::addFootnotes(const uint8_t count) {
+  if (hasPending) {
+    pending.footnotes += count;
+  }
+}
+
+void SectionFlow::addId(const uint32_t idHash) {
+  if (!file || discarded || ids.size() >= MAX_IDS) {
+    return;
+  }
+  ids.emplace_back(idHash, lineCount + (hasPending ? 1 : 0));
+}
+
+bool SectionFlow::finish() {
+  if (!file) {
+    return false;
+  }
+  if (discarded || failed) {
+    file.close();
+    Storage.remove(path.c_str());
+    return false;
+  }
+  writePending();
+  serialization::writePod(file, static_cast<uint16_t>(ids.size()));
+  for (const auto& id : ids) {
+    serialization::writePod(file, id.first);
+    serialization::writePod(file, id.second);
+  }
+  file.seek(sizeof(FLOW_FILE_VERSION) + sizeof(uint32_t));
+  serialization::writePod(file, lineCount);
+  file.close();
+  return true;
+}
+
+bool SectionFlow::readHeader(FsFile& flow, const uint32_t flowKey, uint32_t& lineCount) {
+  uint8_t version = 0;
+  uint32_t fileFlowKey = 0;
+  lineCount = 0;
+  serialization::readPod(flow, version);
+  serialization::readPod(flow, fileFlowKey);
+  serialization::readPod(flow, lineCount);
+  return version == FLOW_FILE_VERSION && fileFlowKey == flowKey && lineCount > 0;
+}
+
+bool SectionFlow::readLine(FsFile& flow, Line& line) {
+  if (flow.available() < static_cast<int>(LINE_RECORD_SIZE)) {
+    return false;
+  }
+  uint8_t flags = 0;
+  serialization::readPod(flow, line.gap);
+  serialization::readPod(flow, line.footnotes);
+  serialization::readPod(flow, flags);
+  serialization::readPod(flow, line.anchor.paragraph);
+  serialization::readPod(flow, line.anchor.word);
+  if (flags & FLAG_LANDMARK) {
+    uint32_t len = 0;
+    serialization::readPod(flow, len);
+    if (len > MAX_LANDMARK_LEN || flow.available() < static_cast<int>(len)) {
+      LOG_ERR("FLW", "Corrupt landmark in flow");
+      return false;
+    }
+    line.landmark.resize(len);
+    if (len > 0 && flow.read(reinterpret_cast<uint8_t*>(&line.landmark[0]), len) != static_cast<int>(len)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SectionFlow::readIds(FsFile& flow, std::vector<std::pair<uint32_t, uint32_t>>& ids) {
+  uint16_t count = 0;
+  serialization::readPod(flow, count);
+  if (count > MAX_IDS || flow.available() < static_cast<int>(count * (sizeof(uint32_t) + sizeof(uint32_t)))) {
+    return false;
+  }
+  ids.resize(count);
+  for (auto& id : ids) {
+    serialization::readPod(flow, id.first);
+    serialization::readPod(flow, id.second);
+  }
+  return true;
+}
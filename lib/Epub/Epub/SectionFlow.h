@@ -0,0 +1,81 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Page.h"
+
+/*
+Vertical flow of a chapter's lines, recorded alongside its section file. Every line of a layout is one line height
+tall, so the section's pages only depend on the viewport height through where they are cut. For each line in reading
+order the flow keeps the block spacing above it, where it starts in the chapter text, the DOM path of its block and
+how many footnotes went onto the page with it; then the line each element id lands on. With the pages of one layout
+and this flow, a layout differing only in viewport height (another status bar) is cut without parsing, measuring or
+breaking a single line again, see Section::relayoutSection.
+
+Of the layout parameters only the viewport height is left to the cut. The others all change the lines themselves:
+the line height (font, line compression) is also the em that CSS lengths such as text-indent and side margins are
+resolved with, extra paragraph spacing turns first-line indents off, and width, alignment, hyphenation and embedded
+styles move the breaks. Chapters with images aren't recorded either, how big an image is drawn depends on the
+viewport height.
+
+File layout: version, flow key and line count, then the line records (gap, footnote count, flags, anchor and, when it
+differs from the line before, the landmark string) and the id table (count, then id hash and line index pairs).
+*/
+class SectionFlow {
+ public:
+  struct Line {
+    int16_t gap = 0;        // Spacing between the end of the previous line and this one, dropped at a page break
+    uint8_t footnotes = 0;  // Footnotes that went onto the page together with this line
+    PageAnchor anchor;
+    std::string landmark;
+  };
+
+  explicit SectionFlow(std::string path) : path(std::move(path)) {}
+  ~SectionFlow() {
+    if (file) {
+      file.close();
+    }
+  }
+
+  SectionFlow(const SectionFlow&) = delete;
+  SectionFlow& operator=(const SectionFlow&) = delete;
+
+  // Writing, while the parser places lines
+  bool begin(uint32_t flowKey);
+  void addLine(int16_t gap, const PageAnchor& anchor, const std::string& landmark);
+  // Footnotes added to the page after its last line was placed
+  void addFootnotes(uint8_t count);
+  // Element id that lands on the page of the next line placed (the last page if there is none)
+  void addId(uint32_t idHash);
+  // The chapter can't be cut from its lines alone; nothing is kept
+  void discard() { discarded = true; }
+  // Complete the file, or remove it after discard() or a failed write. True if a usable flow is on the card.
+  bool finish();
+
+  // Reading, sequentially from a file opened on the flow: the header, then every line in order, then the ids.
+  // readLine() leaves line.landmark alone for lines in the same block as the one before, so pass the same Line.
+  static bool readHeader(FsFile& flow, uint32_t flowKey, uint32_t& lineCount);
+  static bool readLine(FsFile& flow, Line& line);
+  static bool readIds(FsFile& flow, std::vector<std::pair<uint32_t, uint32_t>>& ids);
+
+ private:
+  static constexpr size_t MAX_IDS = 1024;
+
+  std::string path;
+  FsFile file;
+  bool discarded = false;
+  bool failed = false;
+  uint32_t lineCount = 0;
+  // The last line is held back until the next one, so footnotes that follow it can still be counted in
+  bool hasPending = false;
+  Line pending;
+  std::string writtenLandmark;
+  std::vector<std::pair<uint32_t, uint32_t>> ids;  // <idHash, line>
+
+  void writePending();
+};
@@ -0,0 +1,101 @@
+#include "SectionPageCounts.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+
+namespace {
+constexpr uint8_t PAGE_COUNTS_FILE_VERSION = 1;
+constexpr size_t HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t);
+
+bool readHeader(FsFile& file, const uint32_t layoutKey, const int spineCount) {
+  uint8_t version;
+  uint32_t fileLayoutKey;
+  uint16_t fileSpineCount;
+  serialization::readPod(file, version);
+  serialization::readPod(file, fileLayoutKey);
+  serialization::readPod(file, fileSpineCount);
+  return version == PAGE_COUNTS_FILE_VERSION && fileLayoutKey == layoutKey && fileSpineCount == spineCount &&
+         file.size() == HEADER_SIZE + sizeof(uint16_t) * spineCount;
+}
+}  // namespace
+
+void SectionPageCounts::record(const std::string& path, const uint32_t layoutKey, const int spineCount,
+                               const int spineIndex, const uint16_t pageCount) {
+  if (spineIndex < 0 || spineIndex >= spineCount || spineCount > UINT16_MAX) {
+    return;
+  }
+
+  FsFile file;
+  if (Storage.exists(path.c_str()) && (file = Storage.open(path.c_str(), O_RDWR))) {
+    if (readHeader(file, layoutKey, spineCount)) {
+      const size_t offset = HEADER_SIZE + sizeof(uint16_t) * spineIndex;
+      uint16_t stored;
+      file.seek(offset);
+      serialization::readPod(file, stored);
+      if (stored != pageCount) {
+        file.seek(offset);
+        serialization::writePod(file, pageCount);
+      }
+      file.close();
+      return;
+    }
+    file.close();
+  }
+
+  // No counts for this layout yet
+  if (!Storage.openFileForWrite("SPC", path, file)) {
+    return;
+  }
+  std::vector<uint16_t> counts(spineCount, UNKNOWN);
+  counts[spineIndex] = pageCount;
+  serialization::writePod(file, PAGE_COUNTS_FILE_VERSION);
+  serialization::writePod(file, layoutKey);
+  serialization::writePod(file, static_cast<uint16_t>(spineCount));
+  file.write(reinterpret_cast<const uint8_t*>(counts.data()), sizeof(uint16_t) * counts.size());
+  file.close();
+}
+
+bool SectionPageCounts::load(const std::string& path, const uint32_t layoutKey, const int spineCount) {
+  firstPages.clear();
+  missing = 0;
+
+  FsFile file;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("SPC", path, file)) {
+    return false;
+  }
+  if (!readHeader(file, layoutKey, spineCount)) {
+    file.close();
+    return false;
+  }
+  std::vector<uint16_t> counts(spineCount);
+  const size_t bytes = sizeof(uint16_t) * counts.size();
+  const bool complete = file.read(reinterpret_cast<uint8_t*>(counts.data()), bytes) == static_cast<int>(bytes);
+  file.close();
+  if (!complete) {
+    return false;
+  }
+
+  firstPages.resize(spineCount + 1);
+  uint32_t pages = 0;
+  for (int i = 0; i < spineCount; i++) {
+    firstPages[i] = pages;
+    if (counts[i] == UNKNOWN) {
+      missing++;
+    } else {
+      pages += counts[i];
+    }
+  }
+  firstPages[spineCount] = pages;
+  LOG_DBG("SPC", "%u pages in %d sections, %d not built yet", pages, spineCount, missing);
+  return true;
+}
+
+uint32_t SectionPageCounts::pagesBefore(const int spineIndex) const {
+  if (firstPages.empty() || spineIndex < 0) {
+    return 0;
+  }
+  return firstPages[std::min<size_t>(spineIndex, firstPages.size() - 1)];
+}
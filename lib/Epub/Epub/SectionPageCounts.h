@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Page count of each section of a book under one layout, so the reader can number pages across the whole book
+// without laying out the chapters it hasn't opened. Every section load or build records its count (whichever task
+// does it: the reader, the prefetcher or the library preparer), and the index is usable once each spine item has
+// been seen.
+//
+// The file is {u8 version, u32 layout key, u16 spine count, u16 count per spine item, UNKNOWN if not built yet}.
+// Recording a count is one 2-byte write in place; a count under another layout starts the file over.
+class SectionPageCounts {
+ public:
+  static constexpr uint16_t UNKNOWN = 0xFFFF;
+
+  static void record(const std::string& path, uint32_t layoutKey, int spineCount, int spineIndex, uint16_t pageCount);
+
+  // Read the counts stored under layoutKey. Returns false if there are none (another layout, or no file yet).
+  bool load(const std::string& path, uint32_t layoutKey, int spineCount);
+  // Whether every spine item's count is known, which the totals below need
+  bool isComplete() const { return !firstPages.empty() && missing == 0; }
+  // Pages of the book before spineIndex
+  uint32_t pagesBefore(int spineIndex) const;
+  uint32_t totalPages() const { return firstPages.empty() ? 0 : firstPages.back(); }
+
+ private:
+  // Running sum of the counts: first book page of each spine item, then the total
+  std::vector<uint32_t> firstPages;
+  int missing = 0;
+};
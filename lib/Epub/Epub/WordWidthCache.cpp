@@ -0,0 +1,122 @@
+#include "WordWidthCache.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <cstdlib>
+#include <cstring>
+
+WordWidthCache::~WordWidthCache() { free(entries); }
+
+uint32_t WordWidthCache::makeKey(const int fontId, const EpdFontFamily::Style style, const char* word,
+                                 const size_t len) {
+  // FNV-1a over the font, the style and the word bytes
+  uint32_t hash = 2166136261u;
+  const auto mix = [&hash](const uint8_t byte) {
+    hash ^= byte;
+    hash *= 16777619u;
+  };
+  for (size_t i = 0; i < sizeof(fontId); i++) {
+    mix(static_cast<uint8_t>(static_cast<uint32_t>(fontId) >> (i * 8)));
+  }
+  mix(static_cast<uint8_t>(style));
+  for (size_t i = 0; i < len; i++) {
+    mix(static_cast<uint8_t>(word[i]));
+  }
+  return hash ? hash : 1;  // 0 marks an empty slot
+}
+
+bool WordWidthCache::load() {
+  if (!entries) {
+    entries = static_cast<Entry*>(calloc(CAPACITY, sizeof(Entry)));
+    if (!entries) {
+      LOG_ERR("WWC", "Failed to allocate word width table");
+      return false;
+    }
+  }
+  dirty = false;
+
+  if (!Storage.exists(path.c_str())) {
+    return true;
+  }
+
+  FsFile file;
+  if (!Storage.openFileForRead("WWC", path, file)) {
+    return true;
+  }
+
+  uint8_t version = 0;
+  uint16_t capacity = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, capacity);
+  const size_t tableBytes = sizeof(Entry) * CAPACITY;
+  if (version != FILE_VERSION || capacity != CAPACITY ||
+      file.read(reinterpret_cast<uint8_t*>(entries), tableBytes) != static_cast<int>(tableBytes)) {
+    LOG_DBG("WWC", "Ignoring stale word width cache");
+    memset(entries, 0, tableBytes);
+  }
+  file.close();
+  return true;
+}
+
+bool WordWidthCache::save() {
+  if (!entries || !dirty) {
+    return true;
+  }
+
+  FsFile file;
+  if (!Storage.openFileForWrite("WWC", path, file)) {
+    return false;
+  }
+  serialization::writePod(file, FILE_VERSION);
+  serialization::writePod(file, CAPACITY);
+  const size_t tableBytes = sizeof(Entry) * CAPACITY;
+  const bool ok = file.write(reinterpret_cast<const uint8_t*>(entries), tableBytes) == tableBytes;
+  file.close();
+  if (!ok) {
+    LOG_ERR("WWC", "Failed to write word width cache");
+    Storage.remove(path.c_str());
+    return false;
+  }
+  dirty = false;
+  return true;
+}
+
+bool WordWidthCache::lookup(const int fontId, const EpdFontFamily::Style style, const char* word, const size_t len,
+                            uint16_t& width) const {
+  if (!entries || len > UINT8_MAX) {
+    return false;
+  }
+  const uint32_t key = makeKey(fontId, style, word, len);
+  for (uint8_t probe = 0; probe < MAX_PROBES; probe++) {
+    const Entry& entry = entries[(key + probe) & (CAPACITY - 1)];
+    if (entry.key == 0) {
+      return false;
+    }
+    if (entry.key == key && entry.len == len) {
+      width = entry.width;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WordWidthCache::store(const int fontId, const EpdFontFamily::Style style, const char* word, const size_t len,
+                           const uint16_t width) {
+  if (!entries || len > UINT8_MAX) {
+    return;
+  }
+  const uint32_t key = makeKey(fontId, style, word, len);
+  // Take the first free slot in the probe window; when the window is full, overwrite its first entry
+  Entry* slot = &entries[key & (CAPACITY - 1)];
+  for (uint8_t probe = 0; probe < MAX_PROBES; probe++) {
+    Entry& entry = entries[(key + probe) & (CAPACITY - 1)];
+    if (entry.key == 0 || (entry.key == key && entry.len == len)) {
+      slot = &entry;
+      break;
+    }
+  }
+  *slot = {key, width, static_cast<uint8_t>(len), 0};
+  dirty = true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <EpdFontFamily.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Per-book cache of measured word advance widths, keyed by (fontId, style, word). Widths don't depend on the
+// viewport, margins or line spacing, so rebuilding a section after such a change can skip measuring the words it
+// has seen before and go straight to line breaking. Fixed-size open addressing table, loaded from and saved to the
+// book cache directory around each section build.
+class WordWidthCache {
+ public:
+  explicit WordWidthCache(std::string path) : path(std::move(path)) {}
+  ~WordWidthCache();
+
+  WordWidthCache(const WordWidthCache&) = delete;
+  WordWidthCache& operator=(const WordWidthCache&) = delete;
+
+  // Allocate the table and fill it from the cache file if there is a valid one. Returns false only if the table
+  // could not be allocated, in which case lookups miss and stores are ignored.
+  bool load();
+  // Write the table back if anything was added since load()
+  bool save();
+
+  bool lookup(int fontId, EpdFontFamily::Style style, const char* word, size_t len, uint16_t& width) const;
+  void store(int fontId, EpdFontFamily::Style style, const char* word, size_t len, uint16_t width);
+
+ private:
+  static constexpr uint8_t FILE_VERSION = 1;
+  static constexpr uint16_t CAPACITY = 2048;  // Power of two; 16KB of entries
+  static constexpr uint8_t MAX_PROBES = 8;
+
+  struct Entry {
+    uint32_t key;  // 0 = empty slot
+    uint16_t width;
+    uint8_t len;
+    uint8_t reserved;
+  };
+  static_assert(sizeof(Entry) == 8, "Entries are written to the cache file as-is");
+
+  static uint32_t makeKey(int fontId, EpdFontFamily::Style style, const char* word, size_t len);
+
+  std::string path;
+  Entry* entries = nullptr;
+  bool dirty = false;
+};
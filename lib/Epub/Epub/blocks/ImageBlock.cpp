@@ -2,10 +2,13 @@
 
 #include <GfxRenderer.h>
 #include <Logging.h>
-#include <Serialization.h>
+
+#include <algorithm>
 
 #include "../converters/DitherUtils.h"
 #include "../converters/ImageDecoderFactory.h"
+#include "../converters/ImagePlaneCache.h"
+#include "../converters/ImageSource.h"
 
 // Cache file format:
 // - uint16_t width
@@ -57,30 +60,34 @@ bool renderFromCache(GfxRenderer& renderer, const std::string& cachePath, int x,
 
   LOG_DBG("IMG", "Loading from cache: %s (%dx%d)", cachePath.c_str(), cachedWidth, cachedHeight);
 
-  // Read and render row by row to minimize memory usage
+  // Read and render a band of rows at a time to minimize memory usage
   const int bytesPerRow = (cachedWidth + 3) / 4;  // 2 bits per pixel, 4 pixels per byte
-  uint8_t* rowBuffer = (uint8_t*)malloc(bytesPerRow);
+  uint8_t* rowBuffer = (uint8_t*)malloc(bytesPerRow * ImagePlaneCache::BAND_ROWS);
   if (!rowBuffer) {
     LOG_ERR("IMG", "Failed to allocate row buffer");
     cacheFile.close();
     return false;
   }
 
-  for (int row = 0; row < cachedHeight; row++) {
-    if (cacheFile.read(rowBuffer, bytesPerRow) != bytesPerRow) {
-      LOG_ERR("IMG", "Cache read error at row %d", row);
+  for (int bandY = 0; bandY < cachedHeight; bandY += ImagePlaneCache::BAND_ROWS) {
+    const int rows = std::min<int>(ImagePlaneCache::BAND_ROWS, cachedHeight - bandY);
+    if (cacheFile.read(rowBuffer, bytesPerRow * rows) != bytesPerRow * rows) {
+      LOG_ERR("IMG", "Cache read error at row %d", bandY);
       free(rowBuffer);
       cacheFile.close();
       return false;
     }
 
-    int destY = y + row;
-    for (int col = 0; col < cachedWidth; col++) {
-      int byteIdx = col / 4;
-      int bitShift = 6 - (col % 4) * 2;  // MSB first within byte
-      uint8_t pixelValue = (rowBuffer[byteIdx] >> bitShift) & 0x03;
+    for (int row = 0; row < rows; row++) {
+      const uint8_t* rowPixels = rowBuffer + row * bytesPerRow;
+      int destY = y + bandY + row;
+      for (int col = 0; col < cachedWidth; col++) {
+        int byteIdx = col / 4;
+        int bitShift = 6 - (col % 4) * 2;  // MSB first within byte
+        uint8_t pixelValue = (rowPixels[byteIdx] >> bitShift) & 0x03;
 
-      drawPixelWithRenderMode(renderer, x + col, destY, pixelValue);
+        drawPixelWithRenderMode(renderer, x + col, destY, pixelValue);
+      }
     }
   }
 
@@ -92,7 +99,13 @@ bool renderFromCache(GfxRenderer& renderer, const std::string& cachePath, int x,
 
 }  // namespace
 
-void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
+bool ImageBlock::isCached(const GfxRenderer& renderer) const {
+  const auto orientation = renderer.getOrientation();
+  return ImagePlaneCache::matches(ImagePlaneCache::getPath(imagePath, orientation), orientation, width, height) ||
+         Storage.exists(getCachePath(imagePath).c_str());
+}
+
+void ImageBlock::render(GfxRenderer& renderer, const int x, const int y, const bool preview) {
   LOG_DBG("IMG", "Rendering image at %d,%d: %s (%dx%d)", x, y, imagePath.c_str(), width, height);
 
   const int screenWidth = renderer.getScreenWidth();
@@ -105,7 +118,11 @@ void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
     return;
   }
 
-  // Try to render from cache first
+  // Frame buffer planes for this orientation are cheapest, then the 2-bit pixel cache
+  const std::string planeCachePath = ImagePlaneCache::getPath(imagePath, renderer.getOrientation());
+  if (ImagePlaneCache::render(renderer, planeCachePath, x, y, width, height)) {
+    return;
+  }
   std::string cachePath = getCachePath(imagePath);
   if (renderFromCache(renderer, cachePath, x, y, width, height)) {
     return;  // Successfully rendered from cache
@@ -126,6 +143,30 @@ void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
     return;
   }
 
+  if (preview) {
+    // A 1-bit preview has nothing for the grayscale passes
+    if (renderer.getRenderMode() != GfxRenderer::BW) {
+      return;
+    }
+    RenderConfig config;
+    config.x = x;
+    config.y = y;
+    config.maxWidth = width;
+    config.maxHeight = height;
+    config.useGrayscale = false;
+    config.useDithering = false;
+    config.performanceMode = true;
+    config.useExactDimensions = true;
+
+    ImageDecoderFactory::DecodeLock decodeLock;
+    ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(imagePath);
+    if (decoder && decoder->decodeToFramebuffer(imagePath, renderer, config)) {
+      LOG_DBG("IMG", "Drew preview of %s", imagePath.c_str());
+      return;
+    }
+    // No cheap decode for this image, it is decoded in full right away
+  }
+
   LOG_DBG("IMG", "Decoding and caching: %s", imagePath.c_str());
 
   RenderConfig config;
@@ -138,7 +179,10 @@ void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
   config.performanceMode = false;
   config.useExactDimensions = true;  // Use pre-calculated dimensions to avoid rounding mismatches
   config.cachePath = cachePath;      // Enable caching during decode
+  config.planeCachePath = planeCachePath;
+  config.planeOrientation = renderer.getOrientation();
 
+  ImageDecoderFactory::DecodeLock decodeLock;
   ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(imagePath);
   if (!decoder) {
     LOG_ERR("IMG", "No decoder found for image: %s", imagePath.c_str());
@@ -156,18 +200,47 @@ void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
   LOG_DBG("IMG", "Decode successful");
 }
 
-bool ImageBlock::serialize(FsFile& file) {
-  serialization::writeString(file, imagePath);
-  serialization::writePod(file, width);
-  serialization::writePod(file, height);
-  return true;
-}
+bool ImageBlock::prerender(GfxRenderer& renderer, ImageSource* source) const {
+  const auto orientation = renderer.getOrientation();
+  const std::string planeCachePath = ImagePlaneCache::getPath(imagePath, orientation);
+  if (ImagePlaneCache::matches(planeCachePath, orientation, width, height)) {
+    return true;
+  }
+
+  // The decoders clip to the logical screen, so a section laid out for another orientation (e.g. built from the
+  // Prepare Library screen) is left to the first render
+  if (width > renderer.getScreenWidth() || height > renderer.getScreenHeight()) {
+    return false;
+  }
 
-std::unique_ptr<ImageBlock> ImageBlock::deserialize(FsFile& file) {
-  std::string path;
-  serialization::readString(file, path);
-  int16_t w, h;
-  serialization::readPod(file, w);
-  serialization::readPod(file, h);
-  return std::unique_ptr<ImageBlock>(new ImageBlock(path, w, h));
+  ImageDecoderFactory::DecodeLock decodeLock;
+  ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(imagePath);
+  if (!decoder) {
+    LOG_ERR("IMG", "No decoder found for image: %s", imagePath.c_str());
+    return false;
+  }
+
+  const uint32_t start = millis();
+  RenderConfig config;
+  config.x = 0;
+  config.y = 0;
+  config.maxWidth = width;
+  config.maxHeight = height;
+  config.useGrayscale = true;
+  config.useDithering = true;
+  config.performanceMode = false;
+  config.useExactDimensions = true;
+  config.cachePath = getCachePath(imagePath);
+  config.planeCachePath = planeCachePath;
+  config.planeOrientation = orientation;
+  config.drawToFramebuffer = false;
+
+  const bool decoded = source ? decoder->decodeSource(*source, renderer, config)
+                              : decoder->decodeToFramebuffer(imagePath, renderer, config);
+  if (!decoded) {
+    LOG_ERR("IMG", "Failed to pre-render image: %s", imagePath.c_str());
+    return false;
+  }
+  LOG_DBG("IMG", "Pre-rendered %s (%dx%d) in %lu ms", imagePath.c_str(), width, height, millis() - start);
+  return ImagePlaneCache::matches(planeCachePath, orientation, width, height);
 }
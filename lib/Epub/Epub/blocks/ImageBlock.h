@@ -6,6 +6,8 @@
 
 #include "Block.h"
 
+class ImageSource;
+
 class ImageBlock final : public Block {
  public:
   ImageBlock(const std::string& imagePath, int16_t width, int16_t height);
@@ -20,9 +22,16 @@ class ImageBlock final : public Block {
   BlockType getType() override { return IMAGE_BLOCK; }
   bool isEmpty() override { return false; }
 
-  void render(GfxRenderer& renderer, const int x, const int y);
-  bool serialize(FsFile& file);
-  static std::unique_ptr<ImageBlock> deserialize(FsFile& file);
+  // Draws the image from its caches, or decodes it now and writes them. With preview, an image without caches is
+  // drawn as a quick 1-bit preview instead where its format has a cheap decode (see RenderConfig::performanceMode);
+  // the grayscale passes leave it out and prerender() does the full decode later.
+  void render(GfxRenderer& renderer, int x, int y, bool preview = false);
+  // True if a decoded copy for the renderer's orientation is on the card, so render() has nothing to decode
+  bool isCached(const GfxRenderer& renderer) const;
+  // Decode, scale and dither the image now and store it as frame buffer planes for the renderer's orientation,
+  // so the first render of its page is a row copy. Called while the section is built. Decodes from source when
+  // given (the image's archive entry, which then never needs extracting), else from the file at the image path.
+  bool prerender(GfxRenderer& renderer, ImageSource* source = nullptr) const;
 
  private:
   std::string imagePath;
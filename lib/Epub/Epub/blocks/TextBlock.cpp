@@ -2,7 +2,8 @@
 
 #include <GfxRenderer.h>
 #include <Logging.h>
-#include <Serialization.h>
+
+#include <algorithm>
 
 void TextBlock::render(const GfxRenderer& renderer, const int fontId, const int x, const int y) const {
   // Validate iterator bounds before rendering
@@ -12,103 +13,39 @@ void TextBlock::render(const GfxRenderer& renderer, const int fontId, const int
     return;
   }
 
-  for (size_t i = 0; i < words.size(); i++) {
-    const int wordX = wordXpos[i] + x;
-    const EpdFontFamily::Style currentStyle = wordStyles[i];
-    renderer.drawText(fontId, wordX, y, words[i].c_str(), true, currentStyle);
-
-    if ((currentStyle & EpdFontFamily::UNDERLINE) != 0) {
-      const std::string& w = words[i];
-      const int fullWordWidth = renderer.getTextWidth(fontId, w.c_str(), currentStyle);
-      // y is the top of the text line; add ascender to reach baseline, then offset 2px below
-      const int underlineY = y + renderer.getFontAscenderSize(fontId) + 2;
-
-      int startX = wordX;
-      int underlineWidth = fullWordWidth;
-
-      // if word starts with em-space ("\xe2\x80\x83"), account for the additional indent before drawing the line
-      if (w.size() >= 3 && static_cast<uint8_t>(w[0]) == 0xE2 && static_cast<uint8_t>(w[1]) == 0x80 &&
-          static_cast<uint8_t>(w[2]) == 0x83) {
-        const char* visiblePtr = w.c_str() + 3;
-        const int prefixWidth = renderer.getTextAdvanceX(fontId, "\xe2\x80\x83", currentStyle);
-        const int visibleWidth = renderer.getTextWidth(fontId, visiblePtr, currentStyle);
-        startX = wordX + prefixWidth;
-        underlineWidth = visibleWidth;
-      }
-
-      renderer.drawLine(startX, underlineY, startX + underlineWidth, underlineY, true);
+  GfxRenderer::TextRunItem run[RUN_CHUNK];
+  for (size_t first = 0; first < words.size(); first += RUN_CHUNK) {
+    const size_t count = std::min(RUN_CHUNK, words.size() - first);
+    for (size_t i = 0; i < count; i++) {
+      run[i] = {wordXpos[first + i] + x, getWord(first + i), wordStyles[first + i]};
     }
+    renderer.drawTextRun(fontId, y, run, count);
   }
-}
-
-bool TextBlock::serialize(FsFile& file) const {
-  if (words.size() != wordXpos.size() || words.size() != wordStyles.size()) {
-    LOG_ERR("TXB", "Serialization failed: size mismatch (words=%u, xpos=%u, styles=%u)\n", words.size(),
-            wordXpos.size(), wordStyles.size());
-    return false;
+  for (size_t i = 0; i < words.size(); i++) {
+    renderUnderline(renderer, fontId, wordXpos[i] + x, y, getWord(i), words[i].len, wordStyles[i]);
   }
-
-  // Word data
-  serialization::writePod(file, static_cast<uint16_t>(words.size()));
-  for (const auto& w : words) serialization::writeString(file, w);
-  for (auto x : wordXpos) serialization::writePod(file, x);
-  for (auto s : wordStyles) serialization::writePod(file, s);
-
-  // Style (alignment + margins/padding/indent)
-  serialization::writePod(file, blockStyle.alignment);
-  serialization::writePod(file, blockStyle.textAlignDefined);
-  serialization::writePod(file, blockStyle.marginTop);
-  serialization::writePod(file, blockStyle.marginBottom);
-  serialization::writePod(file, blockStyle.marginLeft);
-  serialization::writePod(file, blockStyle.marginRight);
-  serialization::writePod(file, blockStyle.paddingTop);
-  serialization::writePod(file, blockStyle.paddingBottom);
-  serialization::writePod(file, blockStyle.paddingLeft);
-  serialization::writePod(file, blockStyle.paddingRight);
-  serialization::writePod(file, blockStyle.textIndent);
-  serialization::writePod(file, blockStyle.textIndentDefined);
-
-  return true;
 }
 
-std::unique_ptr<TextBlock> TextBlock::deserialize(FsFile& file) {
-  uint16_t wc;
-  std::vector<std::string> words;
-  std::vector<uint16_t> wordXpos;
-  std::vector<EpdFontFamily::Style> wordStyles;
-  BlockStyle blockStyle;
-
-  // Word count
-  serialization::readPod(file, wc);
+void TextBlock::renderUnderline(const GfxRenderer& renderer, const int fontId, const int x, const int y,
+                                const char* word, const size_t len, const EpdFontFamily::Style style) {
+  if ((style & EpdFontFamily::UNDERLINE) != 0) {
+    const int fullWordWidth = renderer.getTextWidth(fontId, word, style);
+    // y is the top of the text line; add ascender to reach baseline, then offset 2px below
+    const int underlineY = y + renderer.getFontAscenderSize(fontId) + 2;
+
+    int startX = x;
+    int underlineWidth = fullWordWidth;
+
+    // if word starts with em-space ("\xe2\x80\x83"), account for the additional indent before drawing the line
+    if (len >= 3 && static_cast<uint8_t>(word[0]) == 0xE2 && static_cast<uint8_t>(word[1]) == 0x80 &&
+        static_cast<uint8_t>(word[2]) == 0x83) {
+      const char* visiblePtr = word + 3;
+      const int prefixWidth = renderer.getTextAdvanceX(fontId, "\xe2\x80\x83", style);
+      const int visibleWidth = renderer.getTextWidth(fontId, visiblePtr, style);
+      startX = x + prefixWidth;
+      underlineWidth = visibleWidth;
+    }
 
-  // Sanity check: prevent allocation of unreasonably large vectors (max 10000 words per block)
-  if (wc > 10000) {
-    LOG_ERR("TXB", "Deserialization failed: word count %u exceeds maximum", wc);
-    return nullptr;
+    renderer.drawLine(startX, underlineY, startX + underlineWidth, underlineY, true);
   }
-
-  // Word data
-  words.resize(wc);
-  wordXpos.resize(wc);
-  wordStyles.resize(wc);
-  for (auto& w : words) serialization::readString(file, w);
-  for (auto& x : wordXpos) serialization::readPod(file, x);
-  for (auto& s : wordStyles) serialization::readPod(file, s);
-
-  // Style (alignment + margins/padding/indent)
-  serialization::readPod(file, blockStyle.alignment);
-  serialization::readPod(file, blockStyle.textAlignDefined);
-  serialization::readPod(file, blockStyle.marginTop);
-  serialization::readPod(file, blockStyle.marginBottom);
-  serialization::readPod(file, blockStyle.marginLeft);
-  serialization::readPod(file, blockStyle.marginRight);
-  serialization::readPod(file, blockStyle.paddingTop);
-  serialization::readPod(file, blockStyle.paddingBottom);
-  serialization::readPod(file, blockStyle.paddingLeft);
-  serialization::readPod(file, blockStyle.paddingRight);
-  serialization::readPod(file, blockStyle.textIndent);
-  serialization::readPod(file, blockStyle.textIndentDefined);
-
-  return std::unique_ptr<TextBlock>(
-      new TextBlock(std::move(words), std::move(wordXpos), std::move(wordStyles), blockStyle));
 }
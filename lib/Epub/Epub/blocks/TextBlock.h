@@ -6,33 +6,48 @@
 #include <string>
 #include <vector>
 
+#include "../LayoutArena.h"
 #include "Block.h"
 #include "BlockStyle.h"
 
 // Represents a line of text on a page
 class TextBlock final : public Block {
+ public:
+  struct WordSpan {
+    uint16_t offset;  // into the line text, where every word is NUL-terminated
+    uint16_t len;
+  };
+
  private:
-  std::vector<std::string> words;
-  std::vector<uint16_t> wordXpos;
-  std::vector<EpdFontFamily::Style> wordStyles;
+  ArenaVector<char> text;
+  ArenaVector<WordSpan> words;
+  ArenaVector<uint16_t> wordXpos;
+  ArenaVector<EpdFontFamily::Style> wordStyles;
   BlockStyle blockStyle;
 
  public:
-  explicit TextBlock(std::vector<std::string> words, std::vector<uint16_t> word_xpos,
-                     std::vector<EpdFontFamily::Style> word_styles, const BlockStyle& blockStyle = BlockStyle())
-      : words(std::move(words)),
+  explicit TextBlock(ArenaVector<char> text, ArenaVector<WordSpan> words, ArenaVector<uint16_t> word_xpos,
+                     ArenaVector<EpdFontFamily::Style> word_styles, const BlockStyle& blockStyle = BlockStyle())
+      : text(std::move(text)),
+        words(std::move(words)),
         wordXpos(std::move(word_xpos)),
         wordStyles(std::move(word_styles)),
         blockStyle(blockStyle) {}
   ~TextBlock() override = default;
   void setBlockStyle(const BlockStyle& blockStyle) { this->blockStyle = blockStyle; }
   const BlockStyle& getBlockStyle() const { return blockStyle; }
-  const std::vector<std::string>& getWords() const { return words; }
+  const char* getWord(const size_t index) const { return text.data() + words[index].offset; }
+  uint16_t getWordLen(const size_t index) const { return words[index].len; }
+  const ArenaVector<uint16_t>& getWordXpos() const { return wordXpos; }
+  const ArenaVector<EpdFontFamily::Style>& getWordStyles() const { return wordStyles; }
   bool isEmpty() override { return words.empty(); }
   size_t wordCount() const { return words.size(); }
   // given a renderer works out where to break the words into lines
   void render(const GfxRenderer& renderer, int fontId, int x, int y) const;
+  // Words drawn per GfxRenderer::drawTextRun call; lines rarely hold more
+  static constexpr size_t RUN_CHUNK = 32;
+  // The underline of a word drawn at the given line position, if it is styled so
+  static void renderUnderline(const GfxRenderer& renderer, int fontId, int x, int y, const char* word, size_t len,
+                              EpdFontFamily::Style style);
   BlockType getType() override { return TEXT_BLOCK; }
-  bool serialize(FsFile& file) const;
-  static std::unique_ptr<TextBlock> deserialize(FsFile& file);
 };
@@ -21,12 +21,13 @@ inline uint8_t applyBayerDither4Level(uint8_t gray, int x, int y) {
   if (adjusted < 0) adjusted = 0;
   if (adjusted > 255) adjusted = 255;
 
-  if (adjusted < 64) return 0;
-  if (adjusted < 128) return 1;
-  if (adjusted < 192) return 2;
-  return 3;
+  // Levels split at 64, 128 and 192
+  return adjusted >> 6;
 }
 
+// Quantize to 4 levels (0-3) without dithering: gray / 85 without the division
+inline uint8_t quantize4Level(uint8_t gray) { return (gray * 772) >> 16; }
+
 // Draw a pixel respecting the current render mode for grayscale support
 inline void drawPixelWithRenderMode(GfxRenderer& renderer, int x, int y, uint8_t pixelValue) {
   GfxRenderer::RenderMode renderMode = renderer.getRenderMode();
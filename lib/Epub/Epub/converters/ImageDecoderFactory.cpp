@@ -1,6 +1,8 @@
 #include "ImageDecoderFactory.h"
 
 #include <Logging.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 #include <memory>
 #include <string>
@@ -11,6 +13,17 @@
 std::unique_ptr<JpegToFramebufferConverter> ImageDecoderFactory::jpegDecoder = nullptr;
 std::unique_ptr<PngToFramebufferConverter> ImageDecoderFactory::pngDecoder = nullptr;
 
+namespace {
+SemaphoreHandle_t getDecodeMutex() {
+  static SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+  return mutex;
+}
+}  // namespace
+
+ImageDecoderFactory::DecodeLock::DecodeLock() { xSemaphoreTake(getDecodeMutex(), portMAX_DELAY); }
+
+ImageDecoderFactory::DecodeLock::~DecodeLock() { xSemaphoreGive(getDecodeMutex()); }
+
 ImageToFramebufferDecoder* ImageDecoderFactory::getDecoder(const std::string& imagePath) {
   std::string ext = imagePath;
   size_t dotPos = ext.rfind('.');
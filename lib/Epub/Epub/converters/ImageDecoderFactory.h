@@ -14,6 +14,16 @@ class ImageDecoderFactory {
   static ImageToFramebufferDecoder* getDecoder(const std::string& imagePath);
   static bool isFormatSupported(const std::string& imagePath);
 
+  // The decoders are shared and picojpeg keeps global state, while images are decoded both by the render task and
+  // by sections being built in the background. Hold this around getDecoder() and the decode.
+  class DecodeLock {
+   public:
+    DecodeLock();
+    ~DecodeLock();
+    DecodeLock(const DecodeLock&) = delete;
+    DecodeLock& operator=(const DecodeLock&) = delete;
+  };
+
  private:
   static std::unique_ptr<JpegToFramebufferConverter> jpegDecoder;
   static std::unique_ptr<PngToFramebufferConverter> pngDecoder;
@@ -0,0 +1,88 @@
+#include "ImageHeaderProbe.h"
+
+#include <cstring>
+
+namespace {
+uint16_t be16(const uint8_t* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+uint32_t be32(const uint8_t* p) { return static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+uint32_t le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24; }
+
+bool setDimensions(const uint32_t width, const uint32_t height, ImageDimensions& out) {
+  if (width == 0 || height == 0 || width > INT16_MAX || height > INT16_MAX) {
+    return false;
+  }
+  out.width = static_cast<int16_t>(width);
+  out.height = static_cast<int16_t>(height);
+  return true;
+}
+}  // namespace
+
+bool ImageHeaderProbe::probe(const uint8_t* data, const size_t len, ImageDimensions& out) {
+  return probeJpeg(data, len, out) || probePng(data, len, out) || probeGif(data, len, out) ||
+         probeBmp(data, len, out);
+}
+
+bool ImageHeaderProbe::probeJpeg(const uint8_t* data, const size_t len, ImageDimensions& out) {
+  if (len < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+  size_t pos = 2;
+  while (pos + 4 <= len) {
+    if (data[pos] != 0xFF) {
+      return false;
+    }
+    const uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {
+      pos++;  // Fill byte
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+      pos += 2;  // Standalone markers carry no length
+      continue;
+    }
+    if (marker == 0xD9 || marker == 0xDA) {
+      return false;  // End of image or start of scan before any frame header
+    }
+    const uint16_t segmentLength = be16(data + pos + 2);
+    // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC) which share the range
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      if (pos + 9 > len) {
+        return false;
+      }
+      return setDimensions(be16(data + pos + 7), be16(data + pos + 5), out);
+    }
+    pos += 2 + segmentLength;
+  }
+  return false;
+}
+
+bool ImageHeaderProbe::probePng(const uint8_t* data, const size_t len, ImageDimensions& out) {
+  static constexpr uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  // The IHDR chunk must come first: length, "IHDR", width, height
+  if (len < 24 || memcmp(data, SIGNATURE, sizeof(SIGNATURE)) != 0 || memcmp(data + 12, "IHDR", 4) != 0) {
+    return false;
+  }
+  return setDimensions(be32(data + 16), be32(data + 20), out);
+}
+
+bool ImageHeaderProbe::probeGif(const uint8_t* data, const size_t len, ImageDimensions& out) {
+  if (len < 10 || (memcmp(data, "GIF87a", 6) != 0 && memcmp(data, "GIF89a", 6) != 0)) {
+    return false;
+  }
+  return setDimensions(le16(data + 6), le16(data + 8), out);
+}
+
+bool ImageHeaderProbe::probeBmp(const uint8_t* data, const size_t len, ImageDimensions& out) {
+  if (len < 26 || data[0] != 'B' || data[1] != 'M') {
+    return false;
+  }
+  const uint32_t headerSize = le32(data + 14);
+  if (headerSize == 12) {
+    // OS/2 BITMAPCOREHEADER: 16-bit sizes
+    return setDimensions(le16(data + 18), le16(data + 20), out);
+  }
+  // BITMAPINFOHEADER and later: signed 32-bit sizes, negative height for top-down rows
+  const auto height = static_cast<int32_t>(le32(data + 22));
+  return setDimensions(le32(data + 18), static_cast<uint32_t>(height < 0 ? -height : height), out);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "ImageToFramebufferDecoder.h"
+
+// Image size read straight from the first bytes of a JPEG, PNG, GIF or BMP file, so layout can size an image
+// without extracting it or starting a decoder. JPEG keeps its size in the SOF segment, which large EXIF or ICC
+// segments can push past the probed prefix; callers fall back to the decoder then.
+class ImageHeaderProbe {
+ public:
+  // Enough for the SOF of JPEGs without an embedded thumbnail and every fixed-position header
+  static constexpr size_t PREFIX_BYTES = 1024;
+
+  static bool probe(const uint8_t* data, size_t len, ImageDimensions& out);
+
+ private:
+  static bool probeJpeg(const uint8_t* data, size_t len, ImageDimensions& out);
+  static bool probePng(const uint8_t* data, size_t len, ImageDimensions& out);
+  static bool probeGif(const uint8_t* data, size_t len, ImageDimensions& out);
+  static bool probeBmp(const uint8_t* data, size_t len, ImageDimensions& out);
+};
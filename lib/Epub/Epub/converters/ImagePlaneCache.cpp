@@ -0,0 +1,211 @@
+#include "ImagePlaneCache.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+enum Plane : uint8_t { BW_PLANE, LSB_PLANE, MSB_PLANE, PLANE_COUNT };
+
+// Whether a 2-bit pixel (0 = black .. 3 = white) is drawn in a pass, same rules as drawPixelWithRenderMode
+bool inPlane(const uint8_t value, const int plane) {
+  switch (plane) {
+    case BW_PLANE:
+      return value < 3;
+    case LSB_PLANE:
+      return value == 1;
+    default:
+      return value == 1 || value == 2;
+  }
+}
+
+bool isPortrait(const GfxRenderer::Orientation orientation) {
+  return orientation == GfxRenderer::Portrait || orientation == GfxRenderer::PortraitInverted;
+}
+
+// Image pixel shown at (px, py) of the image's rectangle on the panel: the inverse of GfxRenderer's rotation,
+// relative to the rectangle's top left panel corner
+void panelToImage(const GfxRenderer::Orientation orientation, const int width, const int height, const int px,
+                  const int py, int* x, int* y) {
+  switch (orientation) {
+    case GfxRenderer::Portrait:
+      *x = width - 1 - py;
+      *y = px;
+      break;
+    case GfxRenderer::LandscapeClockwise:
+      *x = width - 1 - px;
+      *y = height - 1 - py;
+      break;
+    case GfxRenderer::PortraitInverted:
+      *x = py;
+      *y = height - 1 - px;
+      break;
+    case GfxRenderer::LandscapeCounterClockwise:
+      *x = px;
+      *y = py;
+      break;
+    default:
+      // Not an orientation; the first pixel keeps the lookup inside the image
+      *x = 0;
+      *y = 0;
+      break;
+  }
+}
+}  // namespace
+
+std::string ImagePlaneCache::getPath(const std::string& imagePath, const GfxRenderer::Orientation orientation) {
+  // Replace extension with .pl<orientation> (panel planes), next to the .pxc pixel cache
+  const std::string suffix = ".pl" + std::to_string(static_cast<int>(orientation));
+  const size_t dotPos = imagePath.rfind('.');
+  if (dotPos != std::string::npos) {
+    return imagePath.substr(0, dotPos) + suffix;
+  }
+  return imagePath + suffix;
+}
+
+bool ImagePlaneCache::matches(const std::string& path, const GfxRenderer::Orientation orientation, const int width,
+                              const int height) {
+  FsFile file;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("IMG", path, file)) {
+    return false;
+  }
+
+  uint8_t version, cachedOrientation;
+  uint16_t cachedWidth, cachedHeight;
+  serialization::readPod(file, version);
+  serialization::readPod(file, cachedOrientation);
+  serialization::readPod(file, cachedWidth);
+  serialization::readPod(file, cachedHeight);
+  file.close();
+  return version == FILE_VERSION && cachedOrientation == orientation && cachedWidth == width &&
+         cachedHeight == height;
+}
+
+size_t ImagePlaneCache::getBandPlaneSize(const GfxRenderer::Orientation orientation, const int width,
+                                         const int rows) {
+  const int panelWidth = isPortrait(orientation) ? rows : width;
+  const int panelRows = isPortrait(orientation) ? width : rows;
+  return static_cast<size_t>(panelRows) * ((panelWidth + 7) / 8);
+}
+
+void ImagePlaneCache::writeHeader(FsFile& file, const GfxRenderer::Orientation orientation, const int width,
+                                  const int height) {
+  serialization::writePod(file, FILE_VERSION);
+  serialization::writePod(file, static_cast<uint8_t>(orientation));
+  serialization::writePod(file, static_cast<uint16_t>(width));
+  serialization::writePod(file, static_cast<uint16_t>(height));
+}
+
+bool ImagePlaneCache::writeBand(FsFile& file, const uint8_t* pixels, const int bytesPerRow, const int width,
+                                const int rows, const GfxRenderer::Orientation orientation) {
+  const int panelWidth = isPortrait(orientation) ? rows : width;
+  const int panelRows = isPortrait(orientation) ? width : rows;
+  const int panelRowBytes = (panelWidth + 7) / 8;
+  const size_t planeSize = getBandPlaneSize(orientation, width, rows);
+  auto* plane = static_cast<uint8_t*>(malloc(planeSize));
+  if (!plane) {
+    LOG_ERR("IMG", "Failed to allocate plane band buffer");
+    return false;
+  }
+
+  bool ok = true;
+  for (int p = 0; p < PLANE_COUNT && ok; p++) {
+    memset(plane, 0, planeSize);
+    for (int py = 0; py < panelRows; py++) {
+      uint8_t* row = plane + py * panelRowBytes;
+      for (int px = 0; px < panelWidth; px++) {
+        int x = 0;
+        int y = 0;
+        panelToImage(orientation, width, rows, px, py, &x, &y);
+        const uint8_t value = (pixels[y * bytesPerRow + x / 4] >> (6 - (x % 4) * 2)) & 0x03;
+        if (inPlane(value, p)) {
+          row[px >> 3] |= 0x80 >> (px & 7);
+        }
+      }
+    }
+    ok = file.write(plane, planeSize) == planeSize;
+  }
+  free(plane);
+  return ok;
+}
+
+bool ImagePlaneCache::render(const GfxRenderer& renderer, const std::string& path, const int x, const int y,
+                             const int width, const int height) {
+  int plane;
+  switch (renderer.getRenderMode()) {
+    case GfxRenderer::BW:
+      plane = BW_PLANE;
+      break;
+    case GfxRenderer::GRAYSCALE_LSB:
+      plane = LSB_PLANE;
+      break;
+    case GfxRenderer::GRAYSCALE_MSB:
+      plane = MSB_PLANE;
+      break;
+    default:
+      return false;
+  }
+
+  FsFile file;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("IMG", path, file)) {
+    return false;
+  }
+
+  const auto orientation = renderer.getOrientation();
+  uint8_t version, cachedOrientation;
+  uint16_t cachedWidth, cachedHeight;
+  serialization::readPod(file, version);
+  serialization::readPod(file, cachedOrientation);
+  serialization::readPod(file, cachedWidth);
+  serialization::readPod(file, cachedHeight);
+
+  const size_t fullBandSize = getBandPlaneSize(orientation, width, BAND_ROWS);
+  const int fullBands = height / BAND_ROWS;
+  const int lastRows = height % BAND_ROWS;
+  const size_t lastBandSize = lastRows ? getBandPlaneSize(orientation, width, lastRows) : 0;
+  const size_t expectedSize = HEADER_SIZE + PLANE_COUNT * (fullBands * fullBandSize + lastBandSize);
+  if (version != FILE_VERSION || cachedOrientation != orientation || cachedWidth != width || cachedHeight != height ||
+      file.size() < expectedSize) {
+    LOG_DBG("IMG", "Plane cache does not match %dx%d in this orientation: %s", width, height, path.c_str());
+    file.close();
+    return false;
+  }
+
+  auto* buffer = static_cast<uint8_t*>(malloc(fullBandSize));
+  if (!buffer) {
+    LOG_ERR("IMG", "Failed to allocate plane read buffer");
+    file.close();
+    return false;
+  }
+
+  bool ok = true;
+  for (int bandY = 0; bandY < height && ok; bandY += BAND_ROWS) {
+    const int rows = std::min(BAND_ROWS, height - bandY);
+    const size_t bandSize = getBandPlaneSize(orientation, width, rows);
+    const uint32_t offset = HEADER_SIZE + (bandY / BAND_ROWS) * PLANE_COUNT * fullBandSize + plane * bandSize;
+    ok = file.seek(offset) && file.read(buffer, bandSize) == static_cast<int>(bandSize);
+    if (!ok) {
+      break;
+    }
+
+    int phyX, phyY, phyWidth, phyHeight;
+    renderer.getPanelRect(x, y + bandY, width, rows, &phyX, &phyY, &phyWidth, &phyHeight);
+    const int rowBytes = (phyWidth + 7) / 8;
+    for (int row = 0; row < phyHeight; row++) {
+      renderer.blitPanelRow(buffer + row * rowBytes, phyX, phyY + row, phyWidth);
+    }
+  }
+  free(buffer);
+  file.close();
+
+  if (!ok) {
+    // Bands drawn so far stay; the caller redraws the whole image from the other caches
+    LOG_ERR("IMG", "Plane cache read error: %s", path.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GfxRenderer.h>
+#include <HalStorage.h>
+
+#include <cstdint>
+#include <string>
+
+// Decoded image stored in the frame buffer's own layout for one orientation, packed 1 bit per pixel MSB first, once
+// per render pass (BW, grayscale LSB, grayscale MSB). Drawing it is one OR/AND per stored row into the frame buffer,
+// with no decoding, dithering or per-pixel rotation.
+//
+// The image is split into bands of BAND_ROWS rows so it can be written while decoding. Each band is rotated onto
+// the panel as its own rectangle (a few full panel rows in landscape, a one byte wide column in portrait).
+//
+// File format:
+// - uint8_t version
+// - uint8_t orientation
+// - uint16_t width, height - logical image size
+// - per band: uint8_t planes[3][panelRows][panelRowBytes] - BW, LSB, MSB; bit set = pixel drawn in that pass,
+//   rows bit 0 aligned
+class ImagePlaneCache {
+ public:
+  static constexpr int BAND_ROWS = 8;
+
+  static std::string getPath(const std::string& imagePath, GfxRenderer::Orientation orientation);
+
+  // True if the file holds planes for this orientation and size
+  static bool matches(const std::string& path, GfxRenderer::Orientation orientation, int width, int height);
+
+  // Writing, used by PixelCache: the header, then every band in order. pixels: 2-bit rows, bytesPerRow apart.
+  static void writeHeader(FsFile& file, GfxRenderer::Orientation orientation, int width, int height);
+  static bool writeBand(FsFile& file, const uint8_t* pixels, int bytesPerRow, int width, int rows,
+                        GfxRenderer::Orientation orientation);
+
+  // Draw the plane for the current render mode with the image's top left corner at logical (x, y), band by band.
+  // Returns false if the file is missing, was built for another orientation or size, or the render mode is
+  // GRAYSCALE_PLANES.
+  static bool render(const GfxRenderer& renderer, const std::string& path, int x, int y, int width, int height);
+
+ private:
+  static constexpr uint8_t FILE_VERSION = 2;
+  static constexpr uint32_t HEADER_SIZE = 2 * sizeof(uint8_t) + 2 * sizeof(uint16_t);
+
+  // Bytes of one plane of a band holding the given number of image rows
+  static size_t getBandPlaneSize(GfxRenderer::Orientation orientation, int width, int rows);
+};
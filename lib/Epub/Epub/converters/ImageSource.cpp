@@ -0,0 +1,91 @@
+#include "ImageSource.h"
+
+#include <Logging.h>
+
+#include <algorithm>
+#include <new>
+
+namespace {
+// Input buffer of the inflater for deflated entries, next to its 32 KB window
+constexpr size_t ENTRY_READ_BUFFER = 1024;
+}  // namespace
+
+bool ImageSource::openFile(const std::string& path) {
+  close();
+  if (!Storage.openFileForRead("IMG", path, cardFile)) {
+    return false;
+  }
+  label = path;
+  length = cardFile.size();
+  return true;
+}
+
+bool ImageSource::openZipEntry(const std::string& zipPath, const std::string& indexPath,
+                               const std::string& entryPath) {
+  close();
+  entry.reset(new (std::nothrow) ZipEntryReader(zipPath, indexPath));
+  if (!entry || !entry->open(entryPath.c_str(), ENTRY_READ_BUFFER)) {
+    LOG_DBG("IMG", "Could not open %s in the archive", entryPath.c_str());
+    entry.reset();
+    return false;
+  }
+  label = entryPath;
+  length = entry->size();
+  return true;
+}
+
+void ImageSource::close() {
+  if (entry) {
+    entry.reset();
+  } else if (cardFile) {
+    cardFile.close();
+  }
+  length = 0;
+  pos = 0;
+}
+
+int ImageSource::read(uint8_t* dest, const size_t maxLen) {
+  const int count = entry ? entry->read(dest, maxLen) : cardFile.read(dest, maxLen);
+  if (count > 0) {
+    pos += count;
+  }
+  return count;
+}
+
+bool ImageSource::seek(const size_t target) {
+  if (target > length) {
+    return false;
+  }
+  if (!entry) {
+    if (!cardFile.seek(target)) {
+      return false;
+    }
+    pos = target;
+    return true;
+  }
+  if (target < pos && !restartEntry()) {
+    return false;
+  }
+  return skip(target - pos);
+}
+
+bool ImageSource::restartEntry() {
+  if (!entry->open(label.c_str(), ENTRY_READ_BUFFER)) {
+    LOG_ERR("IMG", "Failed to restart %s", label.c_str());
+    return false;
+  }
+  pos = 0;
+  return true;
+}
+
+bool ImageSource::skip(size_t count) {
+  uint8_t scratch[256];
+  while (count > 0) {
+    const int got = read(scratch, std::min(count, sizeof(scratch)));
+    if (got <= 0) {
+      return false;
+    }
+    count -= got;
+  }
+  return true;
+}
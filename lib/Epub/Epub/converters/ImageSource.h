@@ -0,0 +1,46 @@
+#pragma once
+#include <HalStorage.h>
+#include <ZipFile.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Byte stream an image decoder reads from: an extracted file on the card or an entry of the EPUB archive, inflated
+// on the fly. Decoding straight from the entry spares writing the image to the card and reading it back at section
+// build time. Entries only stream forward, so seeking backwards restarts the entry (PNGdec returns to the first
+// chunk once after reading the header; stored entries make that cheap).
+class ImageSource {
+ public:
+  ImageSource() = default;
+  ~ImageSource() { close(); }
+
+  ImageSource(const ImageSource&) = delete;
+  ImageSource& operator=(const ImageSource&) = delete;
+
+  bool openFile(const std::string& path);
+  bool openZipEntry(const std::string& zipPath, const std::string& indexPath, const std::string& entryPath);
+  void close();
+
+  // Returns the number of bytes read, 0 at the end or -1 on a read/decompression error
+  int read(uint8_t* dest, size_t maxLen);
+  bool seek(size_t pos);
+  size_t size() const { return length; }
+  size_t position() const { return pos; }
+
+  // The card file for decoders that need random access (progressive JPEG), nullptr for archive entries
+  FsFile* file() { return entry ? nullptr : &cardFile; }
+  // Card path or entry name, for log messages
+  const std::string& name() const { return label; }
+
+ private:
+  bool restartEntry();
+  bool skip(size_t count);
+
+  FsFile cardFile;
+  std::unique_ptr<ZipEntryReader> entry;
+  std::string label;
+  size_t length = 0;
+  size_t pos = 0;
+};
@@ -1,7 +1,20 @@
 #include "ImageToFramebufferDecoder.h"
 
+#include <GrayResampler.h>
 #include <Logging.h>
 
+#include "ImageSource.h"
+
+bool ImageToFramebufferDecoder::decodeToFramebuffer(const std::string& imagePath, GfxRenderer& renderer,
+                                                    const RenderConfig& config) {
+  ImageSource source;
+  if (!source.openFile(imagePath)) {
+    LOG_ERR("IMG", "Failed to open image: %s", imagePath.c_str());
+    return false;
+  }
+  return decodeSource(source, renderer, config);
+}
+
 bool ImageToFramebufferDecoder::validateImageDimensions(int width, int height, const std::string& format) {
   if (width * height > MAX_SOURCE_PIXELS) {
     LOG_ERR("IMG", "Image too large (%dx%d = %d pixels %s), max supported: %d pixels", width, height, width * height,
@@ -15,3 +28,22 @@ void ImageToFramebufferDecoder::warnUnsupportedFeature(const std::string& featur
   LOG_ERR("IMG", "Warning: Unsupported feature '%s' in image '%s'. Image may not display correctly.", feature.c_str(),
           imagePath.c_str());
 }
+
+void ImageToFramebufferDecoder::getOutputSize(const int srcWidth, const int srcHeight, const RenderConfig& config,
+                                              int* outWidth, int* outHeight) {
+  if (config.useExactDimensions && config.maxWidth > 0 && config.maxHeight > 0) {
+    // Use exact dimensions as specified (avoids rounding mismatches with pre-calculated sizes)
+    *outWidth = config.maxWidth;
+    *outHeight = config.maxHeight;
+    return;
+  }
+
+  const int maxWidth = config.maxWidth > 0 ? config.maxWidth : srcWidth;
+  const int maxHeight = config.maxHeight > 0 ? config.maxHeight : srcHeight;
+  if (srcWidth <= maxWidth && srcHeight <= maxHeight) {
+    *outWidth = srcWidth;
+    *outHeight = srcHeight;
+    return;
+  }
+  GrayResampler::fitSize(srcWidth, srcHeight, maxWidth, maxHeight, false, outWidth, outHeight);
+}
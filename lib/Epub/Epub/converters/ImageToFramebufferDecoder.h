@@ -1,10 +1,11 @@
 #pragma once
+#include <GfxRenderer.h>
 #include <HalStorage.h>
 
 #include <memory>
 #include <string>
 
-class GfxRenderer;
+class ImageSource;
 
 struct ImageDimensions {
   int16_t width;
@@ -16,16 +17,27 @@ struct RenderConfig {
   int maxWidth, maxHeight;
   bool useGrayscale = true;
   bool useDithering = true;
+  // Quick 1-bit preview: the cheapest decode the format has, thresholded instead of dithered and never cached.
+  // Decoders without a cheaper path (PNG, progressive JPEG) return false without drawing anything.
   bool performanceMode = false;
   bool useExactDimensions = false;  // If true, use maxWidth/maxHeight as exact output size (no recalculation)
   std::string cachePath;            // If non-empty, decoder will write pixel cache to this path
+  std::string planeCachePath;       // If non-empty, decoder will write frame buffer planes (see ImagePlaneCache)
+  GfxRenderer::Orientation planeOrientation = GfxRenderer::Portrait;
+  bool drawToFramebuffer = true;  // If false, only the caches are written (pre-rendering at section build time)
+
+  bool wantsCache() const { return !cachePath.empty() || !planeCachePath.empty(); }
 };
 
 class ImageToFramebufferDecoder {
  public:
   virtual ~ImageToFramebufferDecoder() = default;
 
-  virtual bool decodeToFramebuffer(const std::string& imagePath, GfxRenderer& renderer, const RenderConfig& config) = 0;
+  // Decodes the image file at imagePath
+  bool decodeToFramebuffer(const std::string& imagePath, GfxRenderer& renderer, const RenderConfig& config);
+  // Decodes from an open source, a card file or an archive entry. Returns false without side effects if the image
+  // needs random access the source can't give (progressive JPEG from an entry); callers then extract it to a file.
+  virtual bool decodeSource(ImageSource& source, GfxRenderer& renderer, const RenderConfig& config) = 0;
 
   virtual bool getDimensions(const std::string& imagePath, ImageDimensions& dims) const = 0;
 
@@ -36,5 +48,8 @@ class ImageToFramebufferDecoder {
   static constexpr int MAX_SOURCE_PIXELS = 3145728;  // 2048 * 1536
 
   bool validateImageDimensions(int width, int height, const std::string& format);
+  // Output size for a source image: exact dimensions if requested, else fit within maxWidth/maxHeight (0 = no
+  // limit) without upscaling
+  static void getOutputSize(int srcWidth, int srcHeight, const RenderConfig& config, int* outWidth, int* outHeight);
   void warnUnsupportedFeature(const std::string& feature, const std::string& imagePath);
 };
\ No newline at end of file
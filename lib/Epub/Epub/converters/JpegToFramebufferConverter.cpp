@@ -2,262 +2,161 @@
 
 #include <GfxRenderer.h>
 #include <HalStorage.h>
+#include <JpegScaledDecoder.h>
 #include <Logging.h>
+#include <ProgressiveJpegDecoder.h>
 #include <picojpeg.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <memory>
+#include <new>
 
 #include "DitherUtils.h"
+#include "ImageSource.h"
 #include "PixelCache.h"
 
 struct JpegContext {
-  FsFile& file;
+  ImageSource& source;
   uint8_t buffer[512];
   size_t bufferPos;
   size_t bufferFilled;
-  JpegContext(FsFile& f) : file(f), bufferPos(0), bufferFilled(0) {}
+  JpegContext(ImageSource& s) : source(s), bufferPos(0), bufferFilled(0) {}
 };
 
 bool JpegToFramebufferConverter::getDimensionsStatic(const std::string& imagePath, ImageDimensions& out) {
-  FsFile file;
-  if (!Storage.openFileForRead("JPG", imagePath, file)) {
+  ImageSource source;
+  if (!source.openFile(imagePath)) {
     LOG_ERR("JPG", "Failed to open file for dimensions: %s", imagePath.c_str());
     return false;
   }
+  FsFile& file = *source.file();
 
-  JpegContext context(file);
+  JpegContext context(source);
   pjpeg_image_info_t imageInfo;
 
   int status = pjpeg_decode_init(&imageInfo, jpegReadCallback, &context, 0);
-  file.close();
-
-  if (status != 0) {
+  if (status == 0) {
+    out.width = imageInfo.m_width;
+    out.height = imageInfo.m_height;
+  } else if (ProgressiveJpegDecoder::handlesPicojpegStatus(status)) {
+    std::unique_ptr<ProgressiveJpegDecoder> fallback(new (std::nothrow) ProgressiveJpegDecoder(file));
+    if (!fallback || !file.seek(0) || !fallback->readHeader()) {
+      LOG_ERR("JPG", "Failed to read progressive JPEG header for dimensions");
+      return false;
+    }
+    out.width = fallback->getWidth();
+    out.height = fallback->getHeight();
+  } else {
     LOG_ERR("JPG", "Failed to init JPEG for dimensions: %d", status);
     return false;
   }
 
-  out.width = imageInfo.m_width;
-  out.height = imageInfo.m_height;
   LOG_DBG("JPG", "Image dimensions: %dx%d", out.width, out.height);
   return true;
 }
 
-bool JpegToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath, GfxRenderer& renderer,
-                                                     const RenderConfig& config) {
-  LOG_DBG("JPG", "Decoding JPEG: %s", imagePath.c_str());
-
-  FsFile file;
-  if (!Storage.openFileForRead("JPG", imagePath, file)) {
-    LOG_ERR("JPG", "Failed to open file: %s", imagePath.c_str());
-    return false;
-  }
+bool JpegToFramebufferConverter::decodeSource(ImageSource& source, GfxRenderer& renderer, const RenderConfig& config) {
+  LOG_DBG("JPG", "Decoding JPEG: %s", source.name().c_str());
 
-  JpegContext context(file);
+  JpegContext context(source);
   pjpeg_image_info_t imageInfo;
 
+  // Progressive files and the baseline ones picojpeg cannot handle go to ProgressiveJpegDecoder
+  std::unique_ptr<ProgressiveJpegDecoder> fallback;
   int status = pjpeg_decode_init(&imageInfo, jpegReadCallback, &context, 0);
   if (status != 0) {
-    LOG_ERR("JPG", "picojpeg init failed: %d", status);
-    file.close();
-    return false;
+    if (!ProgressiveJpegDecoder::handlesPicojpegStatus(status)) {
+      LOG_ERR("JPG", "picojpeg init failed: %d", status);
+      return false;
+    }
+    if (config.performanceMode) {
+      LOG_DBG("JPG", "No quick preview of a progressive JPEG");
+      return false;
+    }
+    // The progressive decoder seeks around the file, which an archive entry can't do cheaply
+    FsFile* file = source.file();
+    if (!file) {
+      LOG_DBG("JPG", "Progressive JPEG needs a file, not decoding from the archive");
+      return false;
+    }
+    fallback.reset(new (std::nothrow) ProgressiveJpegDecoder(*file));
+    if (!fallback || !file->seek(0) || !fallback->readHeader()) {
+      LOG_ERR("JPG", "Progressive JPEG decoder failed to start");
+      return false;
+    }
   }
+  const int srcWidth = fallback ? fallback->getWidth() : imageInfo.m_width;
+  const int srcHeight = fallback ? fallback->getHeight() : imageInfo.m_height;
 
-  if (!validateImageDimensions(imageInfo.m_width, imageInfo.m_height, "JPEG")) {
-    file.close();
+  if (!validateImageDimensions(srcWidth, srcHeight, "JPEG")) {
     return false;
   }
 
   // Calculate output dimensions
   int destWidth, destHeight;
-  float scale;
+  getOutputSize(srcWidth, srcHeight, config, &destWidth, &destHeight);
 
-  if (config.useExactDimensions && config.maxWidth > 0 && config.maxHeight > 0) {
-    // Use exact dimensions as specified (avoids rounding mismatches with pre-calculated sizes)
-    destWidth = config.maxWidth;
-    destHeight = config.maxHeight;
-    scale = (float)destWidth / imageInfo.m_width;
+  if (fallback) {
+    LOG_DBG("JPG", "JPEG %dx%d -> %dx%d, picojpeg status %d: progressive decoder", srcWidth, srcHeight, destWidth,
+            destHeight, status);
   } else {
-    // Calculate scale factor to fit within maxWidth/maxHeight
-    float scaleX = (config.maxWidth > 0 && imageInfo.m_width > config.maxWidth)
-                       ? (float)config.maxWidth / imageInfo.m_width
-                       : 1.0f;
-    float scaleY = (config.maxHeight > 0 && imageInfo.m_height > config.maxHeight)
-                       ? (float)config.maxHeight / imageInfo.m_height
-                       : 1.0f;
-    scale = (scaleX < scaleY) ? scaleX : scaleY;
-    if (scale > 1.0f) scale = 1.0f;
-
-    destWidth = (int)(imageInfo.m_width * scale);
-    destHeight = (int)(imageInfo.m_height * scale);
+    LOG_DBG("JPG", "JPEG %dx%d -> %dx%d, scan type: %d, MCU: %dx%d", srcWidth, srcHeight, destWidth, destHeight,
+            imageInfo.m_scanType, imageInfo.m_MCUWidth, imageInfo.m_MCUHeight);
   }
 
-  LOG_DBG("JPG", "JPEG %dx%d -> %dx%d (scale %.2f), scan type: %d, MCU: %dx%d", imageInfo.m_width, imageInfo.m_height,
-          destWidth, destHeight, scale, imageInfo.m_scanType, imageInfo.m_MCUWidth, imageInfo.m_MCUHeight);
-
-  if (!imageInfo.m_pMCUBufR || !imageInfo.m_pMCUBufG || !imageInfo.m_pMCUBufB) {
+  if (!fallback && (!imageInfo.m_pMCUBufR || !imageInfo.m_pMCUBufG || !imageInfo.m_pMCUBufB)) {
     LOG_ERR("JPG", "Null buffer pointers in imageInfo");
-    file.close();
     return false;
   }
 
   const int screenWidth = renderer.getScreenWidth();
   const int screenHeight = renderer.getScreenHeight();
 
-  // Allocate pixel cache if cachePath is provided
+  // Stream to the pixel caches if requested
   PixelCache cache;
-  bool caching = !config.cachePath.empty();
+  bool caching = config.wantsCache() && !config.performanceMode;
   if (caching) {
-    if (!cache.allocate(destWidth, destHeight, config.x, config.y)) {
-      LOG_ERR("JPG", "Failed to allocate cache buffer, continuing without caching");
+    if (!cache.begin(destWidth, destHeight, config.x, config.y, 1, config)) {
+      LOG_ERR("JPG", "Failed to start image cache, continuing without caching");
       caching = false;
     }
   }
 
-  int mcuX = 0;
-  int mcuY = 0;
-
-  while (mcuY < imageInfo.m_MCUSPerCol) {
-    status = pjpeg_decode_mcu();
-    if (status == PJPG_NO_MORE_BLOCKS) {
-      break;
+  const bool draw = config.drawToFramebuffer;
+  const int visibleWidth = std::min(destWidth, screenWidth - config.x);
+  const auto drawRow = [&](const int row, const uint8_t* gray) {
+    const int destY = config.y + row;
+    if (destY >= screenHeight) {
+      return true;
     }
-    if (status != 0) {
-      LOG_ERR("JPG", "MCU decode failed: %d", status);
-      file.close();
-      return false;
-    }
-
-    // Source position in image coordinates
-    int srcStartX = mcuX * imageInfo.m_MCUWidth;
-    int srcStartY = mcuY * imageInfo.m_MCUHeight;
-
-    switch (imageInfo.m_scanType) {
-      case PJPG_GRAYSCALE:
-        for (int row = 0; row < 8; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 8; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            uint8_t gray = imageInfo.m_pMCUBufR[row * 8 + col];
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
-        }
-        break;
-
-      case PJPG_YH1V1:
-        for (int row = 0; row < 8; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 8; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            uint8_t r = imageInfo.m_pMCUBufR[row * 8 + col];
-            uint8_t g = imageInfo.m_pMCUBufG[row * 8 + col];
-            uint8_t b = imageInfo.m_pMCUBufB[row * 8 + col];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
-        }
-        break;
-
-      case PJPG_YH2V1:
-        for (int row = 0; row < 8; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 16; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            int blockIndex = (col < 8) ? 0 : 1;
-            int pixelIndex = row * 8 + (col % 8);
-            uint8_t r = imageInfo.m_pMCUBufR[blockIndex * 64 + pixelIndex];
-            uint8_t g = imageInfo.m_pMCUBufG[blockIndex * 64 + pixelIndex];
-            uint8_t b = imageInfo.m_pMCUBufB[blockIndex * 64 + pixelIndex];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
-        }
-        break;
-
-      case PJPG_YH1V2:
-        for (int row = 0; row < 16; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 8; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            int blockIndex = (row < 8) ? 0 : 1;
-            int pixelIndex = (row % 8) * 8 + col;
-            uint8_t r = imageInfo.m_pMCUBufR[blockIndex * 128 + pixelIndex];
-            uint8_t g = imageInfo.m_pMCUBufG[blockIndex * 128 + pixelIndex];
-            uint8_t b = imageInfo.m_pMCUBufB[blockIndex * 128 + pixelIndex];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
-        }
-        break;
-
-      case PJPG_YH2V2:
-        for (int row = 0; row < 16; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 16; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            int blockX = (col < 8) ? 0 : 1;
-            int blockY = (row < 8) ? 0 : 1;
-            int blockIndex = blockY * 2 + blockX;
-            int pixelIndex = (row % 8) * 8 + (col % 8);
-            int blockOffset = blockIndex * 64;
-            uint8_t r = imageInfo.m_pMCUBufR[blockOffset + pixelIndex];
-            uint8_t g = imageInfo.m_pMCUBufG[blockOffset + pixelIndex];
-            uint8_t b = imageInfo.m_pMCUBufB[blockOffset + pixelIndex];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
-        }
-        break;
-    }
-
-    mcuX++;
-    if (mcuX >= imageInfo.m_MCUSPerRow) {
-      mcuX = 0;
-      mcuY++;
+    for (int col = 0; col < visibleWidth; col++) {
+      const int destX = config.x + col;
+      uint8_t dithered;
+      if (config.performanceMode) {
+        dithered = gray[col] < 128 ? 0 : 3;
+      } else {
+        dithered = config.useDithering ? applyBayerDither4Level(gray[col], destX, destY) : quantize4Level(gray[col]);
+      }
+      if (draw) drawPixelWithRenderMode(renderer, destX, destY, dithered);
+      if (caching) cache.setPixel(destX, destY, dithered);
     }
+    return true;
+  };
+  const bool decoded = fallback ? fallback->decode(destWidth, destHeight, drawRow)
+                                : JpegScaledDecoder::decode(imageInfo, destWidth, destHeight, drawRow,
+                                                            config.performanceMode);
+  if (!decoded) {
+    LOG_ERR("JPG", "JPEG decode failed");
+    return false;
   }
 
   LOG_DBG("JPG", "Decoding complete");
-  file.close();
 
-  // Write cache file if caching was enabled
+  // Write the last rows of the cache files if caching was enabled
   if (caching) {
-    cache.writeToFile(config.cachePath);
+    cache.finish();
   }
 
   return true;
@@ -268,7 +167,7 @@ unsigned char JpegToFramebufferConverter::jpegReadCallback(unsigned char* pBuf,
   JpegContext* context = reinterpret_cast<JpegContext*>(pCallback_data);
 
   if (context->bufferPos >= context->bufferFilled) {
-    int readCount = context->file.read(context->buffer, sizeof(context->buffer));
+    int readCount = context->source.read(context->buffer, sizeof(context->buffer));
     if (readCount <= 0) {
       *pBytes_actually_read = 0;
       return 0;
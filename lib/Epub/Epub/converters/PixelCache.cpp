@@ -0,0 +1,128 @@
+#include "PixelCache.h"
+
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "ImagePlaneCache.h"
+#include "ImageToFramebufferDecoder.h"
+
+PixelCache::~PixelCache() {
+  // Never finished (decode failed): a partial cache must not be used
+  close(false);
+}
+
+bool PixelCache::begin(const int w, const int h, const int ox, const int oy, const int rowSpan,
+                       const RenderConfig& config) {
+  close(false);
+  width = w;
+  height = h;
+  originX = ox;
+  originY = oy;
+  bytesPerRow = (w + 3) / 4;  // 2 bits per pixel, 4 pixels per byte
+  // Room for the rows being decoded plus a band still waiting for its last rows
+  windowRows = rowSpan + ImagePlaneCache::BAND_ROWS;
+  windowStart = 0;
+  writeFailed = false;
+  planeOrientation = config.planeOrientation;
+
+  const size_t bufferSize = static_cast<size_t>(bytesPerRow) * windowRows;
+  window = BufferPool::lease(bufferSize);
+  if (!window) {
+    LOG_ERR("IMG", "Failed to allocate cache window: %d bytes", bufferSize);
+    return false;
+  }
+  memset(window.data(), 0, bufferSize);
+
+  if (!config.cachePath.empty()) {
+    if (Storage.openFileForWrite("IMG", config.cachePath, pixelFile)) {
+      pixelPath = config.cachePath;
+      const uint16_t cachedWidth = w;
+      const uint16_t cachedHeight = h;
+      pixelFile.write(&cachedWidth, 2);
+      pixelFile.write(&cachedHeight, 2);
+    } else {
+      LOG_ERR("IMG", "Failed to open cache file for writing: %s", config.cachePath.c_str());
+    }
+  }
+  if (!config.planeCachePath.empty()) {
+    if (Storage.openFileForWrite("IMG", config.planeCachePath, planeFile)) {
+      planePath = config.planeCachePath;
+      ImagePlaneCache::writeHeader(planeFile, planeOrientation, w, h);
+    } else {
+      LOG_ERR("IMG", "Failed to open plane cache for writing: %s", config.planeCachePath.c_str());
+    }
+  }
+
+  if (pixelPath.empty() && planePath.empty()) {
+    close(false);
+    return false;
+  }
+  LOG_DBG("IMG", "Caching %dx%d through a %d byte window", w, h, bufferSize);
+  return true;
+}
+
+void PixelCache::setPixel(const int screenX, const int screenY, const uint8_t value) {
+  if (!window) return;
+  const int localX = screenX - originX;
+  const int localY = screenY - originY;
+  if (localX < 0 || localX >= width || localY < windowStart || localY >= height) return;
+
+  // A row past the window means the rows at its top are done
+  while (localY >= windowStart + windowRows) {
+    flushBand(ImagePlaneCache::BAND_ROWS);
+  }
+
+  const int byteIdx = (localY - windowStart) * bytesPerRow + localX / 4;
+  const int bitShift = 6 - (localX % 4) * 2;  // MSB first: pixel 0 at bits 6-7
+  uint8_t* buffer = window.data();
+  buffer[byteIdx] = (buffer[byteIdx] & ~(0x03 << bitShift)) | ((value & 0x03) << bitShift);
+}
+
+void PixelCache::flushBand(const int rows) {
+  const size_t bandBytes = static_cast<size_t>(rows) * bytesPerRow;
+  uint8_t* buffer = window.data();
+  if (!pixelPath.empty() && pixelFile.write(buffer, bandBytes) != bandBytes) {
+    writeFailed = true;
+  }
+  if (!planePath.empty() &&
+      !ImagePlaneCache::writeBand(planeFile, buffer, bytesPerRow, width, rows, planeOrientation)) {
+    writeFailed = true;
+  }
+
+  const size_t windowBytes = static_cast<size_t>(windowRows) * bytesPerRow;
+  memmove(buffer, buffer + bandBytes, windowBytes - bandBytes);
+  memset(buffer + windowBytes - bandBytes, 0, bandBytes);
+  windowStart += rows;
+}
+
+bool PixelCache::finish() {
+  if (!window) return false;
+  while (windowStart < height) {
+    flushBand(std::min(ImagePlaneCache::BAND_ROWS, height - windowStart));
+  }
+
+  const bool ok = !writeFailed;
+  if (!ok) {
+    LOG_ERR("IMG", "Cache write failed, discarding %dx%d cache", width, height);
+  } else {
+    LOG_DBG("IMG", "Cache written (%dx%d)", width, height);
+  }
+  close(ok);
+  return ok;
+}
+
+void PixelCache::close(const bool keep) {
+  if (!pixelPath.empty()) {
+    pixelFile.close();
+    if (!keep) Storage.remove(pixelPath.c_str());
+    pixelPath.clear();
+  }
+  if (!planePath.empty()) {
+    planeFile.close();
+    if (!keep) Storage.remove(planePath.c_str());
+    planePath.clear();
+  }
+  window.release();
+}
@@ -3,19 +3,22 @@
 #include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <Logging.h>
+#include <GrayResampler.h>
 #include <PNGdec.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <new>
 
 #include "DitherUtils.h"
+#include "ImageSource.h"
 #include "PixelCache.h"
 
 namespace {
 
 // Context struct passed through PNGdec callbacks to avoid global mutable state.
 // The draw callback receives this via pDraw->pUser (set by png.decode()).
-// The file I/O callbacks receive the FsFile* via pFile->fHandle (set by pngOpen()).
+// The I/O callbacks receive the ImageSource* (or FsFile* for dimensions) via pFile->fHandle (set by pngOpen()).
 struct PngContext {
   GfxRenderer* renderer;
   const RenderConfig* config;
@@ -23,12 +26,12 @@ struct PngContext {
   int screenHeight;
 
   // Scaling state
-  float scale;
   int srcWidth;
   int srcHeight;
   int dstWidth;
   int dstHeight;
-  int lastDstY;  // Track last rendered destination Y to avoid duplicates
+  GrayResampler resampler;
+  GrayResampler::RowCallback drawRow;  // Built once per decode, gets each scaled row
 
   PixelCache cache;
   bool caching;
@@ -40,18 +43,38 @@ struct PngContext {
         config(nullptr),
         screenWidth(0),
         screenHeight(0),
-        scale(1.0f),
         srcWidth(0),
         srcHeight(0),
         dstWidth(0),
         dstHeight(0),
-        lastDstY(-1),
         caching(false),
         grayLineBuffer(nullptr) {}
 };
 
-// File I/O callbacks use pFile->fHandle to access the FsFile*,
-// avoiding the need for global file state.
+// PNGdec hands the "filename" given to open() to the open callback, which is how the ImageSource reaches it; the
+// other I/O callbacks get it back through pFile->fHandle. The caller owns the source, so close leaves it open.
+void* pngOpenSource(const char* filename, int32_t* size) {
+  ImageSource* source = const_cast<ImageSource*>(reinterpret_cast<const ImageSource*>(filename));
+  *size = static_cast<int32_t>(source->size());
+  return source;
+}
+
+void pngCloseSource(void*) {}
+
+int32_t pngReadSource(PNGFILE* pFile, uint8_t* pBuf, int32_t len) {
+  ImageSource* source = reinterpret_cast<ImageSource*>(pFile->fHandle);
+  if (!source) return 0;
+  const int count = source->read(pBuf, len);
+  return count < 0 ? 0 : count;
+}
+
+int32_t pngSeekSource(PNGFILE* pFile, int32_t pos) {
+  ImageSource* source = reinterpret_cast<ImageSource*>(pFile->fHandle);
+  if (!source || pos < 0 || !source->seek(pos)) return -1;
+  return pos;
+}
+
+// File I/O callbacks for dimension queries, which only get a path
 void* pngOpenWithHandle(const char* filename, int32_t* size) {
   FsFile* f = new FsFile();
   if (!Storage.openFileForRead("PNG", std::string(filename), *f)) {
@@ -175,64 +198,37 @@ void convertLineToGray(uint8_t* pPixels, uint8_t* grayLine, int width, int pixel
   }
 }
 
+// Dither and draw one scaled row at the image's destination
+bool drawScaledRow(PngContext* ctx, const int dstY, const uint8_t* gray) {
+  const int outY = ctx->config->y + dstY;
+  if (outY >= ctx->screenHeight) return true;
+
+  const int outXBase = ctx->config->x;
+  const int visibleWidth = std::min(ctx->dstWidth, ctx->screenWidth - outXBase);
+  const bool useDithering = ctx->config->useDithering;
+  const bool caching = ctx->caching;
+  const bool draw = ctx->config->drawToFramebuffer;
+
+  for (int dstX = 0; dstX < visibleWidth; dstX++) {
+    const int outX = outXBase + dstX;
+    const uint8_t ditheredGray =
+        useDithering ? applyBayerDither4Level(gray[dstX], outX, outY) : quantize4Level(gray[dstX]);
+    if (draw) drawPixelWithRenderMode(*ctx->renderer, outX, outY, ditheredGray);
+    if (caching) ctx->cache.setPixel(outX, outY, ditheredGray);
+  }
+  return true;
+}
+
 int pngDrawCallback(PNGDRAW* pDraw) {
   PngContext* ctx = reinterpret_cast<PngContext*>(pDraw->pUser);
   if (!ctx || !ctx->config || !ctx->renderer || !ctx->grayLineBuffer) return 0;
 
-  int srcY = pDraw->y;
-  int srcWidth = ctx->srcWidth;
-
-  // Calculate destination Y with scaling
-  int dstY = (int)(srcY * ctx->scale);
-
-  // Skip if we already rendered this destination row (multiple source rows map to same dest)
-  if (dstY == ctx->lastDstY) return 1;
-  ctx->lastDstY = dstY;
-
-  // Check bounds
-  if (dstY >= ctx->dstHeight) return 1;
-
-  int outY = ctx->config->y + dstY;
-  if (outY >= ctx->screenHeight) return 1;
-
   // Convert entire source line to grayscale (improves cache locality)
-  convertLineToGray(pDraw->pPixels, ctx->grayLineBuffer, srcWidth, pDraw->iPixelType, pDraw->pPalette,
+  convertLineToGray(pDraw->pPixels, ctx->grayLineBuffer, ctx->srcWidth, pDraw->iPixelType, pDraw->pPalette,
                     pDraw->iHasAlpha);
 
-  // Render scaled row using Bresenham-style integer stepping (no floating-point division)
-  int dstWidth = ctx->dstWidth;
-  int outXBase = ctx->config->x;
-  int screenWidth = ctx->screenWidth;
-  bool useDithering = ctx->config->useDithering;
-  bool caching = ctx->caching;
-
-  int srcX = 0;
-  int error = 0;
-
-  for (int dstX = 0; dstX < dstWidth; dstX++) {
-    int outX = outXBase + dstX;
-    if (outX < screenWidth) {
-      uint8_t gray = ctx->grayLineBuffer[srcX];
-
-      uint8_t ditheredGray;
-      if (useDithering) {
-        ditheredGray = applyBayerDither4Level(gray, outX, outY);
-      } else {
-        ditheredGray = gray / 85;
-        if (ditheredGray > 3) ditheredGray = 3;
-      }
-      drawPixelWithRenderMode(*ctx->renderer, outX, outY, ditheredGray);
-      if (caching) ctx->cache.setPixel(outX, outY, ditheredGray);
-    }
-
-    // Bresenham-style stepping: advance srcX based on ratio srcWidth/dstWidth
-    error += srcWidth;
-    while (error >= dstWidth) {
-      error -= dstWidth;
-      srcX++;
-    }
-  }
-
+  // Area averaged into the destination size; completed rows are drawn through drawRow
+  ctx->resampler.pushRow(ctx->grayLineBuffer, ctx->drawRow);
   return 1;
 }
 
@@ -268,9 +264,12 @@ bool PngToFramebufferConverter::getDimensionsStatic(const std::string& imagePath
   return true;
 }
 
-bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath, GfxRenderer& renderer,
-                                                    const RenderConfig& config) {
-  LOG_DBG("PNG", "Decoding PNG: %s", imagePath.c_str());
+bool PngToFramebufferConverter::decodeSource(ImageSource& source, GfxRenderer& renderer, const RenderConfig& config) {
+  // Inflating is most of the work and has no shortcut, a preview would cost as much as the image
+  if (config.performanceMode) {
+    return false;
+  }
+  LOG_DBG("PNG", "Decoding PNG: %s", source.name().c_str());
 
   size_t freeHeap = ESP.getFreeHeap();
   if (freeHeap < MIN_FREE_HEAP_FOR_PNG) {
@@ -291,8 +290,8 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
   ctx.screenWidth = renderer.getScreenWidth();
   ctx.screenHeight = renderer.getScreenHeight();
 
-  int rc = png->open(imagePath.c_str(), pngOpenWithHandle, pngCloseWithHandle, pngReadWithHandle, pngSeekWithHandle,
-                     pngDrawCallback);
+  int rc = png->open(reinterpret_cast<const char*>(&source), pngOpenSource, pngCloseSource, pngReadSource,
+                     pngSeekSource, pngDrawCallback);
   if (rc != PNG_SUCCESS) {
     LOG_ERR("PNG", "Failed to open PNG: %d", rc);
     delete png;
@@ -309,25 +308,10 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
   ctx.srcWidth = png->getWidth();
   ctx.srcHeight = png->getHeight();
 
-  if (config.useExactDimensions && config.maxWidth > 0 && config.maxHeight > 0) {
-    // Use exact dimensions as specified (avoids rounding mismatches with pre-calculated sizes)
-    ctx.dstWidth = config.maxWidth;
-    ctx.dstHeight = config.maxHeight;
-    ctx.scale = (float)ctx.dstWidth / ctx.srcWidth;
-  } else {
-    // Calculate scale factor to fit within maxWidth/maxHeight
-    float scaleX = (float)config.maxWidth / ctx.srcWidth;
-    float scaleY = (float)config.maxHeight / ctx.srcHeight;
-    ctx.scale = (scaleX < scaleY) ? scaleX : scaleY;
-    if (ctx.scale > 1.0f) ctx.scale = 1.0f;  // Don't upscale
-
-    ctx.dstWidth = (int)(ctx.srcWidth * ctx.scale);
-    ctx.dstHeight = (int)(ctx.srcHeight * ctx.scale);
-  }
-  ctx.lastDstY = -1;  // Reset row tracking
+  getOutputSize(ctx.srcWidth, ctx.srcHeight, config, &ctx.dstWidth, &ctx.dstHeight);
 
-  LOG_DBG("PNG", "PNG %dx%d -> %dx%d (scale %.2f), bpp: %d", ctx.srcWidth, ctx.srcHeight, ctx.dstWidth, ctx.dstHeight,
-          ctx.scale, png->getBpp());
+  LOG_DBG("PNG", "PNG %dx%d -> %dx%d, bpp: %d", ctx.srcWidth, ctx.srcHeight, ctx.dstWidth, ctx.dstHeight,
+          png->getBpp());
 
   const int pixelType = png->getPixelType();
   const int requiredInternal = requiredPngInternalBufferBytes(ctx.srcWidth, pixelType);
@@ -342,7 +326,7 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
   }
 
   if (png->getBpp() != 8) {
-    warnUnsupportedFeature("bit depth (" + std::to_string(png->getBpp()) + "bpp)", imagePath);
+    warnUnsupportedFeature("bit depth (" + std::to_string(png->getBpp()) + "bpp)", source.name());
   }
 
   // Allocate grayscale line buffer on demand (~3.2 KB) - freed after decode
@@ -355,17 +339,28 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
     return false;
   }
 
-  // Allocate cache buffer using SCALED dimensions
-  ctx.caching = !config.cachePath.empty();
+  if (!ctx.resampler.begin(ctx.srcWidth, ctx.srcHeight, ctx.dstWidth, ctx.dstHeight)) {
+    free(ctx.grayLineBuffer);
+    png->close();
+    delete png;
+    return false;
+  }
+  ctx.drawRow = [&ctx](const int dstY, const uint8_t* gray) { return drawScaledRow(&ctx, dstY, gray); };
+
+  // Stream to the pixel caches using SCALED dimensions
+  ctx.caching = config.wantsCache();
   if (ctx.caching) {
-    if (!ctx.cache.allocate(ctx.dstWidth, ctx.dstHeight, config.x, config.y)) {
-      LOG_ERR("PNG", "Failed to allocate cache buffer, continuing without caching");
+    if (!ctx.cache.begin(ctx.dstWidth, ctx.dstHeight, config.x, config.y, 1, config)) {
+      LOG_ERR("PNG", "Failed to start image cache, continuing without caching");
       ctx.caching = false;
     }
   }
 
   unsigned long decodeStart = millis();
   rc = png->decode(&ctx, 0);
+  if (rc == PNG_SUCCESS) {
+    ctx.resampler.finish(ctx.drawRow);
+  }
   unsigned long decodeTime = millis() - decodeStart;
 
   free(ctx.grayLineBuffer);
@@ -382,9 +377,9 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
   delete png;
   LOG_DBG("PNG", "PNG decoding complete - render time: %lu ms", decodeTime);
 
-  // Write cache file if caching was enabled and buffer was allocated
+  // Write the last rows of the cache files if caching was enabled
   if (ctx.caching) {
-    ctx.cache.writeToFile(config.cachePath);
+    ctx.cache.finish();
   }
 
   return true;
@@ -1,5 +1,6 @@
 #include "CssParser.h"
 
+#include <AllocProfile.h>
 #include <Arduino.h>
 #include <Logging.h>
 
@@ -45,6 +46,9 @@ constexpr size_t MAX_RULES = 1500;
 // If below this threshold, we skip CSS to avoid display artifacts.
 constexpr size_t MIN_FREE_HEAP_FOR_CSS = 48 * 1024;
 
+// Descendant and child rules applied to one element at most; more matches than this are ignored
+constexpr size_t MAX_MATCHED_ANCESTOR_RULES = 16;
+
 // Maximum length for a single selector string
 // Prevents parsing of extremely long or malformed selectors
 constexpr size_t MAX_SELECTOR_LENGTH = 256;
@@ -52,8 +56,106 @@ constexpr size_t MAX_SELECTOR_LENGTH = 256;
 // Check if character is CSS whitespace
 bool isCssWhitespace(const char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; }
 
+// Selector interning: FNV-1a over the lowercased selector text. Streaming, so "tag.class" can be hashed by
+// continuing from the hash of "tag" without building the combined string.
+constexpr uint32_t SELECTOR_HASH_SEED = 2166136261u;
+
+uint32_t hashSelector(uint32_t hash, const std::string_view text) {
+  for (const char c : text) {
+    hash ^= static_cast<uint8_t>(std::tolower(static_cast<unsigned char>(c)));
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Hash of ".", continued with a class name gives the selector hash of ".class"
+const uint32_t DOT_HASH = hashSelector(SELECTOR_HASH_SEED, ".");
+
+// Two bits of a CssAncestors bloom filter per tag or class hash
+uint64_t bloomBits(const uint32_t hash) { return (1ull << (hash & 63)) | (1ull << ((hash >> 6) & 63)); }
+
+// Calls fn for every whitespace separated class name in the attribute
+template <typename Fn>
+void forEachClass(const std::string_view classAttr, const Fn& fn) {
+  size_t pos = 0;
+  while (pos < classAttr.size()) {
+    while (pos < classAttr.size() && isCssWhitespace(classAttr[pos])) pos++;
+    const size_t start = pos;
+    while (pos < classAttr.size() && !isCssWhitespace(classAttr[pos])) pos++;
+    if (pos > start) {
+      fn(classAttr.substr(start, pos - start));
+    }
+  }
+}
+
+// "tag", ".class" or "tag.class"
+bool isSimpleCompound(const std::string_view compound) {
+  const size_t dot = compound.find('.');
+  return !compound.empty() && (dot == std::string_view::npos ||
+                               (dot + 1 < compound.size() && compound.find('.', dot + 1) == std::string_view::npos));
+}
+
+// Rewrites a normalized selector with descendant or child combinators as compounds joined by " " or " > ", so
+// "div>p" and "div > p" share a rule. False if a compound isn't simple or there are too many of them.
+bool canonicalCombinatorSelector(const std::string_view selector, std::string& out) {
+  out.clear();
+  size_t compounds = 0;
+  bool child = false;
+  size_t pos = 0;
+  while (pos < selector.size()) {
+    if (selector[pos] == ' ') {
+      pos++;
+      continue;
+    }
+    if (selector[pos] == '>') {
+      if (child || compounds == 0) {
+        return false;
+      }
+      child = true;
+      pos++;
+      continue;
+    }
+    const size_t start = pos;
+    while (pos < selector.size() && selector[pos] != ' ' && selector[pos] != '>') pos++;
+    const std::string_view compound = selector.substr(start, pos - start);
+    if (!isSimpleCompound(compound) || ++compounds > CssParser::MAX_ANCESTOR_STEPS + 1) {
+      return false;
+    }
+    if (!out.empty()) {
+      out += child ? " > " : " ";
+    }
+    out += compound;
+    child = false;
+  }
+  return compounds > 1 && !child;
+}
+
 }  // anonymous namespace
 
+// Ancestor stack
+
+void CssAncestors::push(const std::string_view tagName, const std::string_view classAttr) {
+  Element element;
+  element.tagHash = hashSelector(SELECTOR_HASH_SEED, tagName);
+  element.filter = (elements.empty() ? 0 : elements.back().filter) | bloomBits(element.tagHash);
+  element.classStart = static_cast<uint16_t>(classHashes.size());
+  forEachClass(classAttr, [&](const std::string_view cls) {
+    const uint32_t hash = hashSelector(DOT_HASH, cls);
+    classHashes.push_back(hash);
+    element.filter |= bloomBits(hash);
+  });
+  element.classEnd = static_cast<uint16_t>(classHashes.size());
+  elements.push_back(element);
+}
+
+void CssAncestors::pop() {
+  if (elements.empty()) {
+    return;
+  }
+  classHashes.resize(elements.back().classStart);
+  elements.pop_back();
+}
+
 // String utilities implementation
 
 std::string CssParser::normalized(const std::string& s) {
@@ -371,12 +473,6 @@ void CssParser::processRuleBlockWithStyle(const std::string& selectorGroup, cons
       continue;
     }
 
-    // TODO: Consider adding support for direct nested css selectors in the future
-    // Ensure no > in selector as we don't support nested CSS selectors for now
-    if (key.find('>') != std::string_view::npos) {
-      continue;
-    }
-
     // TODO: Consider adding support for attribute css selectors in the future
     // Ensure no [ in selector as we don't support attribute CSS selectors for now
     if (key.find('[') != std::string_view::npos) {
@@ -407,12 +503,13 @@ void CssParser::processRuleBlockWithStyle(const std::string& selectorGroup, cons
       continue;
     }
 
-    // TODO: Add support for more complex selectors in the future
-    // At the moment, we only ever check for `tag`, `tag.class1` or `.class1`
-    // If the selector has whitespace in it, then it's either a CSS selector for a descendant element (e.g. `tag1 tag2`)
-    // or some other slightly more advanced CSS selector which we don't support yet
-    if (key.find(' ') != std::string_view::npos) {
-      continue;
+    // Besides `tag`, `tag.class1` and `.class1`, descendant and child chains of them (`div p`, `blockquote > p`)
+    if (key.find_first_of(" >") != std::string_view::npos) {
+      std::string chain;
+      if (!canonicalCombinatorSelector(key, chain)) {
+        continue;
+      }
+      key = std::move(chain);
     }
 
     // Skip if this would exceed the rule limit
@@ -434,6 +531,7 @@ void CssParser::processRuleBlockWithStyle(const std::string& selectorGroup, cons
 // Main parsing entry point
 
 bool CssParser::loadFromStream(FsFile& source) {
+  ALLOC_SCOPE("css.parse");
   if (!source) {
     LOG_ERR("CSS", "Cannot read from invalid file");
     return false;
@@ -576,12 +674,148 @@ bool CssParser::loadFromStream(FsFile& source) {
   }
 
   LOG_DBG("CSS", "Parsed %zu rules from %zu bytes", rulesBySelector_.size(), totalRead);
+  compileRules();
+  return true;
+}
+
+namespace {
+// Ancestor rules of one selector hash are kept in a fixed order, so equal-specificity ties resolve the same way
+// on every build of the cache
+template <typename Rule>
+bool ancestorRuleBefore(const Rule& a, const Rule& b) {
+  if (a.selectorHash != b.selectorHash) return a.selectorHash < b.selectorHash;
+  if (a.specificity != b.specificity) return a.specificity < b.specificity;
+  return a.filter < b.filter;
+}
+}  // namespace
+
+bool CssParser::compileAncestorRule(const std::string& selector, AncestorRule& rule) {
+  // Compounds from the canonical form, rightmost (the styled element) first
+  std::string_view compounds[MAX_ANCESTOR_STEPS + 1];
+  bool childOf[MAX_ANCESTOR_STEPS + 1] = {};
+  size_t count = 0;
+  size_t end = selector.size();
+  while (end > 0 && count <= MAX_ANCESTOR_STEPS) {
+    const size_t space = selector.rfind(' ', end - 1);
+    const size_t start = space == std::string::npos ? 0 : space + 1;
+    const std::string_view token(selector.data() + start, end - start);
+    if (token == ">") {
+      if (count == 0) return false;
+      childOf[count - 1] = true;
+    } else {
+      compounds[count++] = token;
+    }
+    end = space == std::string::npos ? 0 : space;
+  }
+  if (end > 0 || count < 2) {
+    return false;
+  }
+
+  const auto specificityOf = [](const std::string_view compound) -> uint16_t {
+    const size_t dot = compound.find('.');
+    return (dot != std::string_view::npos ? 256 : 0) + (dot != 0 ? 1 : 0);
+  };
+
+  rule.selectorHash = hashSelector(SELECTOR_HASH_SEED, compounds[0]);
+  rule.stepCount = static_cast<uint8_t>(count - 1);
+  rule.filter = 0;
+  rule.specificity = specificityOf(compounds[0]);
+  for (size_t i = 1; i < count; i++) {
+    const std::string_view compound = compounds[i];
+    const size_t dot = compound.find('.');
+    AncestorStep& step = rule.steps[i - 1];
+    step.tagHash = dot == 0 ? 0 : hashSelector(SELECTOR_HASH_SEED, compound.substr(0, dot));
+    step.classHash = dot == std::string_view::npos ? 0 : hashSelector(DOT_HASH, compound.substr(dot + 1));
+    // The combinator between this compound and the one to its right
+    step.child = childOf[i - 1];
+    rule.filter |= (step.tagHash ? bloomBits(step.tagHash) : 0) | (step.classHash ? bloomBits(step.classHash) : 0);
+    rule.specificity += specificityOf(compound);
+  }
   return true;
 }
 
+void CssParser::compileRules() {
+  compiledRules_.clear();
+  compiledRules_.reserve(rulesBySelector_.size());
+  ancestorRules_.clear();
+  for (const auto& [selector, style] : rulesBySelector_) {
+    if (selector.find(' ') == std::string::npos) {
+      compiledRules_.push_back({hashSelector(SELECTOR_HASH_SEED, selector), style});
+      continue;
+    }
+    AncestorRule rule{};
+    if (compileAncestorRule(selector, rule)) {
+      rule.style = style;
+      ancestorRules_.push_back(rule);
+    }
+  }
+  std::sort(compiledRules_.begin(), compiledRules_.end(),
+            [](const CompiledRule& a, const CompiledRule& b) { return a.selectorHash < b.selectorHash; });
+  std::sort(ancestorRules_.begin(), ancestorRules_.end(), ancestorRuleBefore<AncestorRule>);
+
+  // Two selectors sharing a hash would be indistinguishable at lookup; keep the first and say so
+  const auto dup = std::adjacent_find(compiledRules_.begin(), compiledRules_.end(),
+                                      [](const CompiledRule& a, const CompiledRule& b) {
+                                        return a.selectorHash == b.selectorHash;
+                                      });
+  if (dup != compiledRules_.end()) {
+    LOG_DBG("CSS", "Selector hash collision, dropping duplicates");
+    compiledRules_.erase(std::unique(compiledRules_.begin(), compiledRules_.end(),
+                                     [](const CompiledRule& a, const CompiledRule& b) {
+                                       return a.selectorHash == b.selectorHash;
+                                     }),
+                         compiledRules_.end());
+  }
+}
+
+const CssStyle* CssParser::findRule(const uint32_t selectorHash) const {
+  const auto it = std::lower_bound(
+      compiledRules_.begin(), compiledRules_.end(), selectorHash,
+      [](const CompiledRule& rule, const uint32_t hash) { return rule.selectorHash < hash; });
+  return it != compiledRules_.end() && it->selectorHash == selectorHash ? &it->style : nullptr;
+}
+
 // Style resolution
 
-CssStyle CssParser::resolveStyle(const std::string& tagName, const std::string& classAttr) const {
+bool CssParser::matchesAncestors(const AncestorRule& rule, const CssAncestors& ancestors) {
+  const auto& elements = ancestors.elements;
+  // The styled element is on top; everything the rule needs must be in the filter of its parent
+  if (elements.size() < 2 || (elements[elements.size() - 2].filter & rule.filter) != rule.filter) {
+    return false;
+  }
+
+  const auto elementMatches = [&ancestors](const CssAncestors::Element& element, const AncestorStep& step) {
+    if (step.tagHash && element.tagHash != step.tagHash) {
+      return false;
+    }
+    const auto classesBegin = ancestors.classHashes.begin() + element.classStart;
+    const auto classesEnd = ancestors.classHashes.begin() + element.classEnd;
+    return !step.classHash || std::find(classesBegin, classesEnd, step.classHash) != classesEnd;
+  };
+
+  // Steps are matched right to left, each below the element the previous one matched. A descendant step takes the
+  // nearest matching ancestor first and tries farther ones if the steps left of it fail there.
+  const auto matchStep = [&](const auto& self, const size_t stepIndex, const size_t below) -> bool {
+    const AncestorStep& step = rule.steps[stepIndex];
+    for (size_t i = below; i-- > 0;) {
+      if (elementMatches(elements[i], step) &&
+          (stepIndex + 1 == rule.stepCount || self(self, stepIndex + 1, i))) {
+        return true;
+      }
+      if (step.child) {
+        return false;
+      }
+    }
+    return false;
+  };
+  return matchStep(matchStep, 0, elements.size() - 1);
+}
+
+CssStyle CssParser::resolveStyle(std::string_view tagName, const std::string_view classAttr,
+                                 const CssAncestors* ancestors, bool* contextual) const {
+  if (contextual) {
+    *contextual = false;
+  }
   static bool lowHeapWarningLogged = false;
   if (ESP.getFreeHeap() < MIN_FREE_HEAP_FOR_CSS) {
     if (!lowHeapWarningLogged) {
@@ -592,38 +826,77 @@ CssStyle CssParser::resolveStyle(const std::string& tagName, const std::string&
     return CssStyle{};
   }
   CssStyle result;
-  const std::string tag = normalized(tagName);
+  if (compiledRules_.empty() && ancestorRules_.empty()) {
+    return result;
+  }
 
-  // 1. Apply element-level style (lowest priority)
-  const auto tagIt = rulesBySelector_.find(tag);
-  if (tagIt != rulesBySelector_.end()) {
-    result.applyOver(tagIt->second);
+  // Trim the tag the same way selectors were normalized
+  while (!tagName.empty() && isCssWhitespace(tagName.front())) tagName.remove_prefix(1);
+  while (!tagName.empty() && isCssWhitespace(tagName.back())) tagName.remove_suffix(1);
+  const uint32_t tagHash = hashSelector(SELECTOR_HASH_SEED, tagName);
+  const uint32_t tagDotHash = hashSelector(tagHash, ".");
+
+  // Descendant and child rules filed under this element's tag, classes or tag.classes that match its ancestors,
+  // in specificity order. Only these rules look at the ancestors at all.
+  struct AncestorMatch {
+    uint16_t specificity;
+    const CssStyle* style;
+  };
+  AncestorMatch matched[MAX_MATCHED_ANCESTOR_RULES];
+  size_t matchedCount = 0;
+  const auto collectAncestorRules = [&](const uint32_t selectorHash) {
+    auto it = std::lower_bound(
+        ancestorRules_.begin(), ancestorRules_.end(), selectorHash,
+        [](const AncestorRule& rule, const uint32_t hash) { return rule.selectorHash < hash; });
+    for (; it != ancestorRules_.end() && it->selectorHash == selectorHash; ++it) {
+      if (contextual) {
+        *contextual = true;
+      }
+      if (!ancestors || matchedCount == MAX_MATCHED_ANCESTOR_RULES || !matchesAncestors(*it, *ancestors)) {
+        continue;
+      }
+      size_t pos = matchedCount++;
+      for (; pos > 0 && matched[pos - 1].specificity > it->specificity; pos--) {
+        matched[pos] = matched[pos - 1];
+      }
+      matched[pos] = {it->specificity, &it->style};
+    }
+  };
+  if (!ancestorRules_.empty()) {
+    collectAncestorRules(tagHash);
+    forEachClass(classAttr, [&](const std::string_view cls) {
+      collectAncestorRules(hashSelector(DOT_HASH, cls));
+      collectAncestorRules(hashSelector(tagDotHash, cls));
+    });
   }
 
+  // Applies a simple rule after the matched descendant and child rules that are less specific than it
+  size_t appliedCount = 0;
+  const auto apply = [&](const CssStyle* rule, const uint16_t specificity) {
+    for (; appliedCount < matchedCount && matched[appliedCount].specificity < specificity; appliedCount++) {
+      result.applyOver(*matched[appliedCount].style);
+    }
+    if (rule) {
+      result.applyOver(*rule);
+    }
+  };
+
+  // 1. Apply element-level style (lowest priority)
+  apply(findRule(tagHash), 1);
+
   // TODO: Support combinations of classes (e.g. style on .class1.class2)
   // 2. Apply class styles (medium priority)
   if (!classAttr.empty()) {
-    const auto classes = splitWhitespace(classAttr);
-
-    for (const auto& cls : classes) {
-      std::string classKey = "." + normalized(cls);
-
-      auto classIt = rulesBySelector_.find(classKey);
-      if (classIt != rulesBySelector_.end()) {
-        result.applyOver(classIt->second);
-      }
-    }
+    forEachClass(classAttr, [&](const std::string_view cls) { apply(findRule(hashSelector(DOT_HASH, cls)), 256); });
 
     // TODO: Support combinations of classes (e.g. style on p.class1.class2)
     // 3. Apply element.class styles (higher priority)
-    for (const auto& cls : classes) {
-      std::string combinedKey = tag + "." + normalized(cls);
-
-      auto combinedIt = rulesBySelector_.find(combinedKey);
-      if (combinedIt != rulesBySelector_.end()) {
-        result.applyOver(combinedIt->second);
-      }
-    }
+    forEachClass(classAttr,
+                 [&](const std::string_view cls) { apply(findRule(hashSelector(tagDotHash, cls)), 257); });
+  }
+  // Descendant and child rules left over are more specific than every simple rule that matched
+  for (; appliedCount < matchedCount; appliedCount++) {
+    result.applyOver(*matched[appliedCount].style);
   }
 
   return result;
@@ -638,87 +911,215 @@ CssStyle CssParser::parseInlineStyle(const std::string& styleValue) { return par
 // Cache file name (version is CssParser::CSS_CACHE_VERSION)
 constexpr char rulesCache[] = "/css_rules.cache";
 
+// Serialized style: 4 enum bytes, 11 lengths (float + unit), defined bits
+constexpr size_t STYLE_RECORD_SIZE = 4 + 11 * (sizeof(float) + 1) + sizeof(uint16_t);
+// Serialized rule: selector hash, style
+constexpr size_t RULE_RECORD_SIZE = sizeof(uint32_t) + STYLE_RECORD_SIZE;
+// Serialized descendant or child rule: selector hash, step count, steps (tag hash, class hash, child flag), bloom
+// filter, specificity, style
+constexpr size_t ANCESTOR_RULE_RECORD_SIZE = sizeof(uint32_t) + 1 +
+                                             CssParser::MAX_ANCESTOR_STEPS * (2 * sizeof(uint32_t) + 1) +
+                                             sizeof(uint64_t) + sizeof(uint16_t) + STYLE_RECORD_SIZE;
+
 bool CssParser::hasCache() const { return Storage.exists((cachePath + rulesCache).c_str()); }
 
 void CssParser::deleteCache() const {
   if (hasCache()) Storage.remove((cachePath + rulesCache).c_str());
 }
 
-bool CssParser::saveToCache() const {
+void CssParser::writeRule(FsFile& file, const CompiledRule& rule) {
+  file.write(reinterpret_cast<const uint8_t*>(&rule.selectorHash), sizeof(rule.selectorHash));
+  writeStyle(file, rule.style);
+}
+
+bool CssParser::readRule(FsFile& file, CompiledRule& rule) {
+  return file.read(&rule.selectorHash, sizeof(rule.selectorHash)) == sizeof(rule.selectorHash) &&
+         readStyle(file, rule.style);
+}
+
+void CssParser::writeAncestorRule(FsFile& file, const AncestorRule& rule) {
+  file.write(reinterpret_cast<const uint8_t*>(&rule.selectorHash), sizeof(rule.selectorHash));
+  file.write(rule.stepCount);
+  // Unused steps are written too, so every record has the same size
+  for (const AncestorStep& step : rule.steps) {
+    file.write(reinterpret_cast<const uint8_t*>(&step.tagHash), sizeof(step.tagHash));
+    file.write(reinterpret_cast<const uint8_t*>(&step.classHash), sizeof(step.classHash));
+    file.write(static_cast<uint8_t>(step.child));
+  }
+  file.write(reinterpret_cast<const uint8_t*>(&rule.filter), sizeof(rule.filter));
+  file.write(reinterpret_cast<const uint8_t*>(&rule.specificity), sizeof(rule.specificity));
+  writeStyle(file, rule.style);
+}
+
+bool CssParser::readAncestorRule(FsFile& file, AncestorRule& rule) {
+  if (file.read(&rule.selectorHash, sizeof(rule.selectorHash)) != sizeof(rule.selectorHash) ||
+      file.read(&rule.stepCount, 1) != 1) {
+    return false;
+  }
+  for (AncestorStep& step : rule.steps) {
+    uint8_t child = 0;
+    if (file.read(&step.tagHash, sizeof(step.tagHash)) != sizeof(step.tagHash) ||
+        file.read(&step.classHash, sizeof(step.classHash)) != sizeof(step.classHash) || file.read(&child, 1) != 1) {
+      return false;
+    }
+    step.child = child != 0;
+  }
+  return file.read(&rule.filter, sizeof(rule.filter)) == sizeof(rule.filter) &&
+         file.read(&rule.specificity, sizeof(rule.specificity)) == sizeof(rule.specificity) &&
+         rule.stepCount >= 1 && rule.stepCount <= MAX_ANCESTOR_STEPS && readStyle(file, rule.style);
+}
+
+void CssParser::writeStyle(FsFile& file, const CssStyle& style) {
+  // Write CssStyle fields (all are POD types)
+  file.write(static_cast<uint8_t>(style.textAlign));
+  file.write(static_cast<uint8_t>(style.fontStyle));
+  file.write(static_cast<uint8_t>(style.fontWeight));
+  file.write(static_cast<uint8_t>(style.textDecoration));
+
+  // Write CssLength fields (value + unit)
+  auto writeLength = [&file](const CssLength& len) {
+    file.write(reinterpret_cast<const uint8_t*>(&len.value), sizeof(len.value));
+    file.write(static_cast<uint8_t>(len.unit));
+  };
+
+  writeLength(style.textIndent);
+  writeLength(style.marginTop);
+  writeLength(style.marginBottom);
+  writeLength(style.marginLeft);
+  writeLength(style.marginRight);
+  writeLength(style.paddingTop);
+  writeLength(style.paddingBottom);
+  writeLength(style.paddingLeft);
+  writeLength(style.paddingRight);
+  writeLength(style.imageHeight);
+  writeLength(style.imageWidth);
+
+  // Write defined flags as uint16_t
+  uint16_t definedBits = 0;
+  if (style.defined.textAlign) definedBits |= 1 << 0;
+  if (style.defined.fontStyle) definedBits |= 1 << 1;
+  if (style.defined.fontWeight) definedBits |= 1 << 2;
+  if (style.defined.textDecoration) definedBits |= 1 << 3;
+  if (style.defined.textIndent) definedBits |= 1 << 4;
+  if (style.defined.marginTop) definedBits |= 1 << 5;
+  if (style.defined.marginBottom) definedBits |= 1 << 6;
+  if (style.defined.marginLeft) definedBits |= 1 << 7;
+  if (style.defined.marginRight) definedBits |= 1 << 8;
+  if (style.defined.paddingTop) definedBits |= 1 << 9;
+  if (style.defined.paddingBottom) definedBits |= 1 << 10;
+  if (style.defined.paddingLeft) definedBits |= 1 << 11;
+  if (style.defined.paddingRight) definedBits |= 1 << 12;
+  if (style.defined.imageHeight) definedBits |= 1 << 13;
+  if (style.defined.imageWidth) definedBits |= 1 << 14;
+  file.write(reinterpret_cast<const uint8_t*>(&definedBits), sizeof(definedBits));
+}
+
+bool CssParser::readStyle(FsFile& file, CssStyle& style) {
+  uint8_t enums[4];
+  if (file.read(enums, sizeof(enums)) != sizeof(enums)) {
+    return false;
+  }
+  style.textAlign = static_cast<CssTextAlign>(enums[0]);
+  style.fontStyle = static_cast<CssFontStyle>(enums[1]);
+  style.fontWeight = static_cast<CssFontWeight>(enums[2]);
+  style.textDecoration = static_cast<CssTextDecoration>(enums[3]);
+
+  // Read CssLength fields
+  auto readLength = [&file](CssLength& len) -> bool {
+    if (file.read(&len.value, sizeof(len.value)) != sizeof(len.value)) {
+      return false;
+    }
+    uint8_t unitVal;
+    if (file.read(&unitVal, 1) != 1) {
+      return false;
+    }
+    len.unit = static_cast<CssUnit>(unitVal);
+    return true;
+  };
+
+  if (!readLength(style.textIndent) || !readLength(style.marginTop) || !readLength(style.marginBottom) ||
+      !readLength(style.marginLeft) || !readLength(style.marginRight) || !readLength(style.paddingTop) ||
+      !readLength(style.paddingBottom) || !readLength(style.paddingLeft) || !readLength(style.paddingRight) ||
+      !readLength(style.imageHeight) || !readLength(style.imageWidth)) {
+    return false;
+  }
+
+  // Read defined flags
+  uint16_t definedBits = 0;
+  if (file.read(&definedBits, sizeof(definedBits)) != sizeof(definedBits)) {
+    return false;
+  }
+  style.defined.textAlign = (definedBits & 1 << 0) != 0;
+  style.defined.fontStyle = (definedBits & 1 << 1) != 0;
+  style.defined.fontWeight = (definedBits & 1 << 2) != 0;
+  style.defined.textDecoration = (definedBits & 1 << 3) != 0;
+  style.defined.textIndent = (definedBits & 1 << 4) != 0;
+  style.defined.marginTop = (definedBits & 1 << 5) != 0;
+  style.defined.marginBottom = (definedBits & 1 << 6) != 0;
+  style.defined.marginLeft = (definedBits & 1 << 7) != 0;
+  style.defined.marginRight = (definedBits & 1 << 8) != 0;
+  style.defined.paddingTop = (definedBits & 1 << 9) != 0;
+  style.defined.paddingBottom = (definedBits & 1 << 10) != 0;
+  style.defined.paddingLeft = (definedBits & 1 << 11) != 0;
+  style.defined.paddingRight = (definedBits & 1 << 12) != 0;
+  style.defined.imageHeight = (definedBits & 1 << 13) != 0;
+  style.defined.imageWidth = (definedBits & 1 << 14) != 0;
+  return true;
+}
+
+bool CssParser::beginCacheWrite() {
   if (cachePath.empty()) {
     return false;
   }
 
-  FsFile file;
-  if (!Storage.openFileForWrite("CSS", cachePath + rulesCache, file)) {
+  if (!Storage.openFileForWrite("CSS", cachePath + rulesCache, cacheWriteFile)) {
     return false;
   }
+  cacheWriteFile.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
 
   // Write version
-  file.write(CssParser::CSS_CACHE_VERSION);
-
-  // Write rule count
-  const auto ruleCount = static_cast<uint16_t>(rulesBySelector_.size());
-  file.write(reinterpret_cast<const uint8_t*>(&ruleCount), sizeof(ruleCount));
-
-  // Write each rule: selector string + CssStyle fields
-  for (const auto& pair : rulesBySelector_) {
-    // Write selector string (length-prefixed)
-    const auto selectorLen = static_cast<uint16_t>(pair.first.size());
-    file.write(reinterpret_cast<const uint8_t*>(&selectorLen), sizeof(selectorLen));
-    file.write(reinterpret_cast<const uint8_t*>(pair.first.data()), selectorLen);
-
-    // Write CssStyle fields (all are POD types)
-    const CssStyle& style = pair.second;
-    file.write(static_cast<uint8_t>(style.textAlign));
-    file.write(static_cast<uint8_t>(style.fontStyle));
-    file.write(static_cast<uint8_t>(style.fontWeight));
-    file.write(static_cast<uint8_t>(style.textDecoration));
-
-    // Write CssLength fields (value + unit)
-    auto writeLength = [&file](const CssLength& len) {
-      file.write(reinterpret_cast<const uint8_t*>(&len.value), sizeof(len.value));
-      file.write(static_cast<uint8_t>(len.unit));
-    };
-
-    writeLength(style.textIndent);
-    writeLength(style.marginTop);
-    writeLength(style.marginBottom);
-    writeLength(style.marginLeft);
-    writeLength(style.marginRight);
-    writeLength(style.paddingTop);
-    writeLength(style.paddingBottom);
-    writeLength(style.paddingLeft);
-    writeLength(style.paddingRight);
-    writeLength(style.imageHeight);
-    writeLength(style.imageWidth);
-
-    // Write defined flags as uint16_t
-    uint16_t definedBits = 0;
-    if (style.defined.textAlign) definedBits |= 1 << 0;
-    if (style.defined.fontStyle) definedBits |= 1 << 1;
-    if (style.defined.fontWeight) definedBits |= 1 << 2;
-    if (style.defined.textDecoration) definedBits |= 1 << 3;
-    if (style.defined.textIndent) definedBits |= 1 << 4;
-    if (style.defined.marginTop) definedBits |= 1 << 5;
-    if (style.defined.marginBottom) definedBits |= 1 << 6;
-    if (style.defined.marginLeft) definedBits |= 1 << 7;
-    if (style.defined.marginRight) definedBits |= 1 << 8;
-    if (style.defined.paddingTop) definedBits |= 1 << 9;
-    if (style.defined.paddingBottom) definedBits |= 1 << 10;
-    if (style.defined.paddingLeft) definedBits |= 1 << 11;
-    if (style.defined.paddingRight) definedBits |= 1 << 12;
-    if (style.defined.imageHeight) definedBits |= 1 << 13;
-    if (style.defined.imageWidth) definedBits |= 1 << 14;
-    file.write(reinterpret_cast<const uint8_t*>(&definedBits), sizeof(definedBits));
-  }
-
-  LOG_DBG("CSS", "Saved %u rules to cache", ruleCount);
-  file.close();
+  cacheWriteFile.write(CssParser::CSS_CACHE_VERSION);
+  return true;
+}
+
+bool CssParser::writeStylesheetToCache(const std::string& href) {
+  if (!cacheWriteFile) {
+    return false;
+  }
+
+  // Stylesheet header: href (length-prefixed) + rule count, then the rules in hash order, then the same for the
+  // descendant and child rules
+  const auto hrefLen = static_cast<uint16_t>(href.size());
+  cacheWriteFile.write(reinterpret_cast<const uint8_t*>(&hrefLen), sizeof(hrefLen));
+  cacheWriteFile.write(reinterpret_cast<const uint8_t*>(href.data()), hrefLen);
+
+  const auto ruleCount = static_cast<uint16_t>(compiledRules_.size());
+  cacheWriteFile.write(reinterpret_cast<const uint8_t*>(&ruleCount), sizeof(ruleCount));
+  for (const auto& rule : compiledRules_) {
+    writeRule(cacheWriteFile, rule);
+  }
+  const auto ancestorRuleCount = static_cast<uint16_t>(ancestorRules_.size());
+  cacheWriteFile.write(reinterpret_cast<const uint8_t*>(&ancestorRuleCount), sizeof(ancestorRuleCount));
+  for (const auto& rule : ancestorRules_) {
+    writeAncestorRule(cacheWriteFile, rule);
+  }
+
+  LOG_DBG("CSS", "Saved %u + %u rules for %s to cache", ruleCount, ancestorRuleCount, href.c_str());
+  clear();
   return true;
 }
 
-bool CssParser::loadFromCache() {
+bool CssParser::endCacheWrite() {
+  if (!cacheWriteFile) {
+    return false;
+  }
+  cacheWriteFile.close();
+  return true;
+}
+
+bool CssParser::loadCacheIndex() {
+  clear();
+  sheetIndex_.clear();
   if (cachePath.empty()) {
     return false;
   }
@@ -727,9 +1128,7 @@ bool CssParser::loadFromCache() {
   if (!Storage.openFileForRead("CSS", cachePath + rulesCache, file)) {
     return false;
   }
-
-  // Clear existing rules
-  clear();
+  file.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
 
   // Read and verify version
   uint8_t version = 0;
@@ -741,112 +1140,157 @@ bool CssParser::loadFromCache() {
     return false;
   }
 
-  // Read rule count
-  uint16_t ruleCount = 0;
-  if (file.read(&ruleCount, sizeof(ruleCount)) != sizeof(ruleCount)) {
-    file.close();
-    return false;
-  }
-
-  // Read each rule
-  for (uint16_t i = 0; i < ruleCount; ++i) {
-    // Read selector string
-    uint16_t selectorLen = 0;
-    if (file.read(&selectorLen, sizeof(selectorLen)) != sizeof(selectorLen)) {
-      rulesBySelector_.clear();
+  // Walk the stylesheet headers, skipping over the fixed size rule records
+  const size_t fileSize = file.size();
+  while (file.position() < fileSize) {
+    CachedStylesheet sheet;
+    uint16_t hrefLen = 0;
+    uint16_t ruleCount = 0;
+    bool headerOk = file.read(&hrefLen, sizeof(hrefLen)) == sizeof(hrefLen);
+    if (headerOk) {
+      sheet.href.resize(hrefLen);
+      headerOk = (hrefLen == 0 || file.read(&sheet.href[0], hrefLen) == hrefLen) &&
+                 file.read(&ruleCount, sizeof(ruleCount)) == sizeof(ruleCount);
+    }
+    if (!headerOk) {
+      LOG_ERR("CSS", "Truncated stylesheet header in cache");
+      sheetIndex_.clear();
       file.close();
       return false;
     }
-
-    std::string selector;
-    selector.resize(selectorLen);
-    if (file.read(&selector[0], selectorLen) != selectorLen) {
-      rulesBySelector_.clear();
+    sheet.rulesOffset = static_cast<uint32_t>(file.position());
+    sheet.ruleCount = ruleCount;
+    const size_t ancestorCountOffset = sheet.rulesOffset + ruleCount * RULE_RECORD_SIZE;
+    uint16_t ancestorRuleCount = 0;
+    const bool rulesOk = ancestorCountOffset + sizeof(ancestorRuleCount) <= fileSize &&
+                         file.seek(ancestorCountOffset) &&
+                         file.read(&ancestorRuleCount, sizeof(ancestorRuleCount)) == sizeof(ancestorRuleCount) &&
+                         file.position() + ancestorRuleCount * ANCESTOR_RULE_RECORD_SIZE <= fileSize;
+    if (!rulesOk) {
+      LOG_ERR("CSS", "Truncated rules for %s in cache", sheet.href.c_str());
+      sheetIndex_.clear();
       file.close();
       return false;
     }
+    sheet.ancestorRuleCount = ancestorRuleCount;
+    file.seek(file.position() + ancestorRuleCount * ANCESTOR_RULE_RECORD_SIZE);
+    sheetIndex_.push_back(std::move(sheet));
+  }
 
-    // Read CssStyle fields
-    CssStyle style;
-    uint8_t enumVal;
+  file.close();
+  LOG_DBG("CSS", "Indexed %zu stylesheets in cache", sheetIndex_.size());
+  return true;
+}
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
-    }
-    style.textAlign = static_cast<CssTextAlign>(enumVal);
+bool CssParser::applyStylesheets(const std::vector<size_t>& sheetIndices) {
+  ALLOC_SCOPE("css.apply");
+  if (sheetIndices.empty()) {
+    return true;
+  }
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
-    }
-    style.fontStyle = static_cast<CssFontStyle>(enumVal);
+  FsFile file;
+  if (!Storage.openFileForRead("CSS", cachePath + rulesCache, file)) {
+    return false;
+  }
+  file.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
+  for (const size_t index : sheetIndices) {
+    CachedStylesheet& sheet = sheetIndex_[index];
+    if (sheet.applied) {
+      continue;
     }
-    style.fontWeight = static_cast<CssFontWeight>(enumVal);
-
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
+    sheet.applied = true;
+
+    std::vector<CompiledRule> incoming;
+    incoming.reserve(sheet.ruleCount);
+    file.seek(sheet.rulesOffset);
+    for (uint16_t i = 0; i < sheet.ruleCount; ++i) {
+      CompiledRule rule;
+      if (!readRule(file, rule)) {
+        LOG_ERR("CSS", "Failed to read rules for %s from cache", sheet.href.c_str());
+        file.close();
+        return false;
+      }
+      incoming.push_back(rule);
     }
-    style.textDecoration = static_cast<CssTextDecoration>(enumVal);
 
-    // Read CssLength fields
-    auto readLength = [&file](CssLength& len) -> bool {
-      if (file.read(&len.value, sizeof(len.value)) != sizeof(len.value)) {
-        return false;
+    // Both tables are sorted by hash; later stylesheets cascade over earlier ones for the same selector
+    std::vector<CompiledRule> merged;
+    merged.reserve(compiledRules_.size() + incoming.size());
+    auto existing = compiledRules_.begin();
+    for (const auto& rule : incoming) {
+      while (existing != compiledRules_.end() && existing->selectorHash < rule.selectorHash) {
+        merged.push_back(*existing++);
+      }
+      if (existing != compiledRules_.end() && existing->selectorHash == rule.selectorHash) {
+        merged.push_back(*existing++);
+        merged.back().style.applyOver(rule.style);
+      } else {
+        merged.push_back(rule);
       }
-      uint8_t unitVal;
-      if (file.read(&unitVal, 1) != 1) {
+    }
+    merged.insert(merged.end(), existing, compiledRules_.end());
+    compiledRules_ = std::move(merged);
+
+    // Descendant and child rules follow the simple ones; there are few, so they are merged one by one
+    file.seek(sheet.rulesOffset + sheet.ruleCount * RULE_RECORD_SIZE + sizeof(uint16_t));
+    for (uint16_t i = 0; i < sheet.ancestorRuleCount; ++i) {
+      AncestorRule rule{};
+      if (!readAncestorRule(file, rule)) {
+        LOG_ERR("CSS", "Failed to read rules for %s from cache", sheet.href.c_str());
+        file.close();
         return false;
       }
-      len.unit = static_cast<CssUnit>(unitVal);
-      return true;
-    };
-
-    if (!readLength(style.textIndent) || !readLength(style.marginTop) || !readLength(style.marginBottom) ||
-        !readLength(style.marginLeft) || !readLength(style.marginRight) || !readLength(style.paddingTop) ||
-        !readLength(style.paddingBottom) || !readLength(style.paddingLeft) || !readLength(style.paddingRight) ||
-        !readLength(style.imageHeight) || !readLength(style.imageWidth)) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
+      const auto sameSelector = [&rule](const AncestorRule& other) {
+        if (other.selectorHash != rule.selectorHash || other.stepCount != rule.stepCount) {
+          return false;
+        }
+        for (uint8_t step = 0; step < rule.stepCount; step++) {
+          if (other.steps[step].tagHash != rule.steps[step].tagHash ||
+              other.steps[step].classHash != rule.steps[step].classHash ||
+              other.steps[step].child != rule.steps[step].child) {
+            return false;
+          }
+        }
+        return true;
+      };
+      const auto match = std::find_if(ancestorRules_.begin(), ancestorRules_.end(), sameSelector);
+      if (match != ancestorRules_.end()) {
+        match->style.applyOver(rule.style);
+      } else {
+        ancestorRules_.insert(
+            std::upper_bound(ancestorRules_.begin(), ancestorRules_.end(), rule, ancestorRuleBefore<AncestorRule>),
+            rule);
+      }
     }
+  }
 
-    // Read defined flags
-    uint16_t definedBits = 0;
-    if (file.read(&definedBits, sizeof(definedBits)) != sizeof(definedBits)) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
-    }
-    style.defined.textAlign = (definedBits & 1 << 0) != 0;
-    style.defined.fontStyle = (definedBits & 1 << 1) != 0;
-    style.defined.fontWeight = (definedBits & 1 << 2) != 0;
-    style.defined.textDecoration = (definedBits & 1 << 3) != 0;
-    style.defined.textIndent = (definedBits & 1 << 4) != 0;
-    style.defined.marginTop = (definedBits & 1 << 5) != 0;
-    style.defined.marginBottom = (definedBits & 1 << 6) != 0;
-    style.defined.marginLeft = (definedBits & 1 << 7) != 0;
-    style.defined.marginRight = (definedBits & 1 << 8) != 0;
-    style.defined.paddingTop = (definedBits & 1 << 9) != 0;
-    style.defined.paddingBottom = (definedBits & 1 << 10) != 0;
-    style.defined.paddingLeft = (definedBits & 1 << 11) != 0;
-    style.defined.paddingRight = (definedBits & 1 << 12) != 0;
-    style.defined.imageHeight = (definedBits & 1 << 13) != 0;
-    style.defined.imageWidth = (definedBits & 1 << 14) != 0;
-
-    rulesBySelector_[selector] = style;
-  }
-
-  LOG_DBG("CSS", "Loaded %u rules from cache", ruleCount);
   file.close();
   return true;
 }
+
+bool CssParser::useStylesheet(const std::string& href) {
+  for (size_t i = 0; i < sheetIndex_.size(); i++) {
+    if (sheetIndex_[i].href == href) {
+      stylesheetLinked_ = true;
+      return applyStylesheets({i});
+    }
+  }
+  LOG_DBG("CSS", "Linked stylesheet not in cache: %s", href.c_str());
+  return false;
+}
+
+bool CssParser::useAllStylesheets() {
+  std::vector<size_t> all(sheetIndex_.size());
+  for (size_t i = 0; i < all.size(); i++) {
+    all[i] = i;
+  }
+  if (!applyStylesheets(all)) {
+    return false;
+  }
+  LOG_DBG("CSS", "Loaded %zu rules from %zu stylesheets", compiledRules_.size() + ancestorRules_.size(),
+          sheetIndex_.size());
+  return true;
+}
+
+bool CssParser::loadFromCache() { return loadCacheIndex() && useAllStylesheets(); }
@@ -3,6 +3,7 @@
 #include <HalStorage.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -20,18 +21,51 @@
  *   - Element selectors: p, div, h1, etc.
  *   - Class selectors: .classname
  *   - Combined: element.classname
+ *   - Descendant and child selectors over those: .chapter p, blockquote > p (up to MAX_ANCESTOR_STEPS ancestors)
  *   - Grouped: selector1, selector2 { }
  *
  * Not supported (silently ignored):
- *   - Descendant/child selectors
+ *   - Sibling, attribute, id and universal selectors
  *   - Pseudo-classes and pseudo-elements
  *   - Media queries (content is skipped)
  *   - @import, @font-face, etc.
  */
+class CssParser;
+
+/**
+ * The elements open around the one being styled, for descendant and child selectors. The HTML parser pushes every
+ * element when it starts and pops it when it ends. Each depth also keeps a 64-bit bloom filter of the tags and
+ * classes open up to it, so a rule with ancestors is rejected with one AND unless all of them may be present; only
+ * then are the open elements walked.
+ */
+class CssAncestors {
+ public:
+  void push(std::string_view tagName, std::string_view classAttr);
+  void pop();
+  void clear() {
+    elements.clear();
+    classHashes.clear();
+  }
+
+ private:
+  friend class CssParser;
+
+  struct Element {
+    uint64_t filter;  // Tags and classes of this element and everything around it
+    uint32_t tagHash;
+    uint16_t classStart;  // Range of this element's classes in classHashes
+    uint16_t classEnd;
+  };
+  std::vector<Element> elements;
+  std::vector<uint32_t> classHashes;
+};
+
 class CssParser {
  public:
   // Bump when CSS cache format or rules change; section caches are invalidated when this changes
-  static constexpr uint8_t CSS_CACHE_VERSION = 3;
+  static constexpr uint8_t CSS_CACHE_VERSION = 6;
+  // Compounds left of the styled element in a descendant or child selector; longer selectors are ignored
+  static constexpr size_t MAX_ANCESTOR_STEPS = 4;
 
   explicit CssParser(std::string cachePath) : cachePath(std::move(cachePath)) {}
   ~CssParser() = default;
@@ -50,13 +84,19 @@ class CssParser {
 
   /**
    * Look up the style for an HTML element, considering tag name and class attributes.
-   * Applies CSS cascade: element style < class style < element.class style
+   * Applies CSS cascade: element style < class style < element.class style, with descendant and child rules
+   * placed among those by specificity (after them on a tie).
+   * Selectors are matched by hash against the compiled rule tables, without allocating.
    *
    * @param tagName The HTML element name (e.g., "p", "div")
    * @param classAttr The class attribute value (may contain multiple space-separated classes)
+   * @param ancestors Open elements, the one being styled on top; nullptr skips descendant and child rules
+   * @param contextual Set to whether a descendant or child rule targets this tag and class, i.e. whether the
+   *        result depends on the ancestors and may not be reused for the same tag and class elsewhere
    * @return Combined style with all applicable rules merged
    */
-  [[nodiscard]] CssStyle resolveStyle(const std::string& tagName, const std::string& classAttr) const;
+  [[nodiscard]] CssStyle resolveStyle(std::string_view tagName, std::string_view classAttr,
+                                      const CssAncestors* ancestors = nullptr, bool* contextual = nullptr) const;
 
   /**
    * Parse an inline style attribute string.
@@ -68,17 +108,30 @@ class CssParser {
   /**
    * Check if any rules have been loaded
    */
-  [[nodiscard]] bool empty() const { return rulesBySelector_.empty(); }
+  [[nodiscard]] bool empty() const {
+    return rulesBySelector_.empty() && compiledRules_.empty() && ancestorRules_.empty();
+  }
 
   /**
    * Get count of loaded rule sets
    */
-  [[nodiscard]] size_t ruleCount() const { return rulesBySelector_.size(); }
+  [[nodiscard]] size_t ruleCount() const {
+    return rulesBySelector_.empty() ? compiledRules_.size() + ancestorRules_.size() : rulesBySelector_.size();
+  }
 
   /**
-   * Clear all loaded rules
+   * Clear all loaded rules and the stylesheet index
    */
-  void clear() { rulesBySelector_.clear(); }
+  void clear() {
+    rulesBySelector_.clear();
+    compiledRules_.clear();
+    compiledRules_.shrink_to_fit();
+    ancestorRules_.clear();
+    ancestorRules_.shrink_to_fit();
+    sheetIndex_.clear();
+    sheetIndex_.shrink_to_fit();
+    stylesheetLinked_ = false;
+  }
 
   /**
    * Check if CSS rules cache file exists
@@ -91,22 +144,105 @@ class CssParser {
   void deleteCache() const;
 
   /**
-   * Save parsed CSS rules to a cache file.
-   * @return true if cache was written successfully
+   * Start writing the rules cache. The cache keeps every stylesheet separately, in compiled form (selector hashes,
+   * sorted), so a section build only loads the stylesheets its chapter links to.
+   * @return true if the cache file could be created
    */
-  bool saveToCache() const;
+  bool beginCacheWrite();
 
   /**
-   * Load CSS rules from a cache file.
+   * Append the rules parsed since the last call as the stylesheet `href` (archive path), then clear them.
+   * An empty rule set is still recorded so chapters linking to it don't fall back to all stylesheets.
+   */
+  bool writeStylesheetToCache(const std::string& href);
+
+  bool endCacheWrite();
+
+  /**
+   * Read the stylesheet table of the cache without loading any rules. Removes a stale cache on version mismatch.
+   * @return true if the cache is present and valid
+   */
+  bool loadCacheIndex();
+
+  /**
+   * Merge the cached rules of one stylesheet into the active rule set, after those already applied
+   * (later stylesheets win, as in the document cascade). Requires loadCacheIndex().
+   * @return false if the stylesheet is not in the cache or could not be read
+   */
+  bool useStylesheet(const std::string& href);
+
+  /**
+   * Merge every cached stylesheet not applied yet, in manifest order. Requires loadCacheIndex().
+   */
+  bool useAllStylesheets();
+
+  /**
+   * True once useStylesheet() matched a cached stylesheet since the last loadCacheIndex()/clear()
+   */
+  [[nodiscard]] bool hasLinkedStylesheet() const { return stylesheetLinked_; }
+
+  /**
+   * Load the rules of every cached stylesheet (loadCacheIndex() + useAllStylesheets()).
    * Clears any existing rules before loading.
    * @return true if cache was loaded successfully
    */
   bool loadFromCache();
 
  private:
-  // Storage: maps normalized selector -> style properties
+  // Rule with its normalized selector interned to a 32-bit hash (see hashSelector)
+  struct CompiledRule {
+    uint32_t selectorHash;
+    CssStyle style;
+  };
+
+  // One compound left of the styled element ("tag", ".class" or "tag.class"), hashes of 0 match anything
+  struct AncestorStep {
+    uint32_t tagHash;
+    uint32_t classHash;
+    bool child;  // Must be the parent of the compound to its right, not just an ancestor
+  };
+
+  // Descendant or child rule, filed under the hash of its rightmost compound like a simple rule
+  struct AncestorRule {
+    uint32_t selectorHash;
+    uint8_t stepCount;
+    AncestorStep steps[MAX_ANCESTOR_STEPS];  // Nearest ancestor first
+    uint64_t filter;                         // Bloom bits every step needs, see CssAncestors
+    uint16_t specificity;                    // Classes * 256 + tags, over all compounds
+    CssStyle style;
+  };
+
+  // Storage while parsing stylesheets: maps normalized selector -> style properties
   std::unordered_map<std::string, CssStyle> rulesBySelector_;
+  // Lookup tables used by resolveStyle, sorted by selectorHash. Rebuilt from rulesBySelector_ after parsing and
+  // loaded as-is from the cache file.
+  std::vector<CompiledRule> compiledRules_;
+  std::vector<AncestorRule> ancestorRules_;
+
+  // One stylesheet's block of rules in the cache file
+  struct CachedStylesheet {
+    std::string href;
+    uint32_t rulesOffset = 0;
+    uint16_t ruleCount = 0;
+    uint16_t ancestorRuleCount = 0;  // Follow the simple rules
+    bool applied = false;
+  };
+  std::vector<CachedStylesheet> sheetIndex_;
+  bool stylesheetLinked_ = false;
+  FsFile cacheWriteFile;
 
+  void compileRules();
+  // Parses a normalized selector with combinators; false if it isn't one this parser supports
+  static bool compileAncestorRule(const std::string& selector, AncestorRule& rule);
+  const CssStyle* findRule(uint32_t selectorHash) const;
+  static bool matchesAncestors(const AncestorRule& rule, const CssAncestors& ancestors);
+  bool applyStylesheets(const std::vector<size_t>& sheetIndices);
+  static void writeRule(FsFile& file, const CompiledRule& rule);
+  static bool readRule(FsFile& file, CompiledRule& rule);
+  static void writeAncestorRule(FsFile& file, const AncestorRule& rule);
+  static bool readAncestorRule(FsFile& file, AncestorRule& rule);
+  static void writeStyle(FsFile& file, const CssStyle& style);
+  static bool readStyle(FsFile& file, CssStyle& style);
   std::string cachePath;
 
   // Internal parsing helpers
@@ -0,0 +1,64 @@
+#include "BreakSidecar.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <vector>
+
+#include "Hyphenator.h"
+
+namespace {
+constexpr uint8_t SIDECAR_VERSION = 1;
+static_assert(sizeof(Hyphenator::StoredBreaks) == 20, "Sidecar records are written as-is");
+}  // namespace
+
+void BreakSidecar::begin(const std::string& path) {
+  std::vector<Hyphenator::StoredBreaks> entries;
+
+  FsFile file;
+  if (Storage.exists(path.c_str()) && Storage.openFileForRead("HYP", path, file)) {
+    uint8_t version = 0;
+    uint16_t count = 0;
+    serialization::readPod(file, version);
+    serialization::readPod(file, count);
+    if (version == SIDECAR_VERSION && count <= Hyphenator::MAX_SIDECAR_ENTRIES) {
+      entries.resize(count);
+      const size_t bytes = sizeof(Hyphenator::StoredBreaks) * count;
+      if (file.read(reinterpret_cast<uint8_t*>(entries.data()), bytes) != static_cast<int>(bytes)) {
+        LOG_ERR("HYP", "Failed to read break sidecar %s", path.c_str());
+        entries.clear();
+      }
+    } else {
+      LOG_DBG("HYP", "Ignoring stale break sidecar %s", path.c_str());
+    }
+    file.close();
+  }
+
+  LOG_DBG("HYP", "Loaded %u word breaks", entries.size());
+  Hyphenator::beginSidecar(std::move(entries));
+}
+
+bool BreakSidecar::finish(const std::string& path) {
+  std::vector<Hyphenator::StoredBreaks> merged;
+  if (!Hyphenator::endSidecar(merged)) {
+    return true;
+  }
+
+  FsFile file;
+  if (!Storage.openFileForWrite("HYP", path, file)) {
+    return false;
+  }
+  serialization::writePod(file, SIDECAR_VERSION);
+  serialization::writePod(file, static_cast<uint16_t>(merged.size()));
+  const size_t bytes = sizeof(Hyphenator::StoredBreaks) * merged.size();
+  const bool ok = file.write(reinterpret_cast<const uint8_t*>(merged.data()), bytes) == bytes;
+  file.close();
+  if (!ok) {
+    LOG_ERR("HYP", "Failed to write break sidecar %s", path.c_str());
+    Storage.remove(path.c_str());
+    return false;
+  }
+  LOG_DBG("HYP", "Saved %u word breaks", merged.size());
+  return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+// Per-spine-item file of hyphenation break offsets, stored next to the section file. Hyphenation only depends on
+// the word and the language, so a section rebuilt with other layout settings (font size, margins) reads the words
+// it has seen before instead of running the Liang patterns again. Words hyphenated for the first time are appended
+// when the build finishes.
+class BreakSidecar {
+ public:
+  // Load the file (if any) and hand it to the Hyphenator for the duration of a section build
+  static void begin(const std::string& path);
+  // Stop using the sidecar and write it back if the build added words
+  static bool finish(const std::string& path);
+};
@@ -22,4 +22,5 @@ bool isAsciiDigit(uint32_t cp);
 bool isExplicitHyphen(uint32_t cp);
 bool isSoftHyphen(uint32_t cp);
 void trimSurroundingPunctuationAndFootnote(std::vector<CodepointInfo>& cps);
-std::vector<CodepointInfo> collectCodepoints(const std::string& word);
+std::vector<CodepointInfo> collectCodepoints(const char* word);
+inline std::vector<CodepointInfo> collectCodepoints(const std::string& word) { return collectCodepoints(word.c_str()); }
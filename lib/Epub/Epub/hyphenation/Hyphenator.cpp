@@ -1,6 +1,7 @@
 #include "Hyphenator.h"
 
 #include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "HyphenationCommon.h"
@@ -44,8 +45,9 @@ size_t byteOffsetForIndex(const std::vector<CodepointInfo>& cps, const size_t in
 // Example: "Satel\u00ADliten" (soft-hyphen between 'l' and 'l')
 //   -> returns one BreakInfo with requiresInsertedHyphen=true (soft-hyphen
 //      is invisible and needs a visible '-' when the break is used).
-std::vector<Hyphenator::BreakInfo> buildExplicitBreakInfos(const std::vector<CodepointInfo>& cps) {
-  std::vector<Hyphenator::BreakInfo> breaks;
+ArenaVector<Hyphenator::BreakInfo> buildExplicitBreakInfos(const std::vector<CodepointInfo>& cps,
+                                                           LayoutArena* arena) {
+  ArenaVector<Hyphenator::BreakInfo> breaks{ArenaAllocator<Hyphenator::BreakInfo>(arena)};
 
   for (size_t i = 1; i + 1 < cps.size(); ++i) {
     const uint32_t cp = cps[i].value;
@@ -59,11 +61,134 @@ std::vector<Hyphenator::BreakInfo> buildExplicitBreakInfos(const std::vector<Cod
   return breaks;
 }
 
+// Results of recent breakOffsets() calls. Words repeat a lot within a chapter (German compounds especially), and
+// the table is static so caching doesn't add to heap fragmentation during section builds. Direct mapped; a
+// colliding word simply replaces the older one.
+using CachedBreaks = Hyphenator::StoredBreaks;
+
+constexpr size_t BREAK_CACHE_SIZE = 256;  // Power of two
+CachedBreaks breakCache[BREAK_CACHE_SIZE];
+
+// Break sidecar of the section being built (see Hyphenator::beginSidecar). `sidecarEntries` is what was loaded,
+// sorted by key; `sidecarAdditions` collects the words computed during this build so they can be merged in at the end.
+bool sidecarActive = false;
+std::vector<CachedBreaks> sidecarEntries;
+std::vector<CachedBreaks> sidecarAdditions;
+
+const CachedBreaks* findSidecarEntry(const uint32_t hash, const size_t len) {
+  auto it = std::lower_bound(sidecarEntries.begin(), sidecarEntries.end(), hash,
+                             [](const CachedBreaks& entry, const uint32_t h) { return entry.hash < h; });
+  // Entries with the same hash are ordered by length
+  for (; it != sidecarEntries.end() && it->hash == hash; ++it) {
+    if (it->wordLen == len) {
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+// Fill a cache entry; returns false if the result doesn't fit one
+template <typename Breaks>
+bool packBreaks(const Breaks& breaks, const uint32_t hash, const size_t len, CachedBreaks& out) {
+  if (len > UINT8_MAX || breaks.size() > sizeof(out.offsets)) {
+    return false;
+  }
+  out.hash = hash;
+  out.wordLen = static_cast<uint8_t>(len);
+  out.count = static_cast<uint8_t>(breaks.size());
+  out.hyphenMask = 0;
+  for (size_t i = 0; i < breaks.size(); i++) {
+    out.offsets[i] = static_cast<uint8_t>(breaks[i].byteOffset);
+    if (breaks[i].requiresInsertedHyphen) {
+      out.hyphenMask |= 1u << i;
+    }
+  }
+  return true;
+}
+
+ArenaVector<Hyphenator::BreakInfo> unpackBreaks(const CachedBreaks& cached, LayoutArena* arena) {
+  ArenaVector<Hyphenator::BreakInfo> breaks{ArenaAllocator<Hyphenator::BreakInfo>(arena)};
+  breaks.reserve(cached.count);
+  for (uint8_t i = 0; i < cached.count; i++) {
+    breaks.push_back({cached.offsets[i], (cached.hyphenMask & (1u << i)) != 0});
+  }
+  return breaks;
+}
+
+bool storedBreaksLess(const CachedBreaks& a, const CachedBreaks& b) {
+  return a.hash != b.hash ? a.hash < b.hash : a.wordLen < b.wordLen;
+}
+
+uint32_t breakCacheHash(const char* word, const size_t len, const bool includeFallback) {
+  uint32_t hash = includeFallback ? 2166136261u : 84696351u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= static_cast<uint8_t>(word[i]);
+    hash *= 16777619u;
+  }
+  return hash ? hash : 1;
+}
+
 }  // namespace
 
-std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const std::string& word, const bool includeFallback) {
-  if (word.empty()) {
-    return {};
+ArenaVector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const char* word, const bool includeFallback,
+                                                            LayoutArena* arena) {
+  const size_t len = strlen(word);
+  const uint32_t hash = breakCacheHash(word, len, includeFallback);
+  CachedBreaks& cached = breakCache[hash & (BREAK_CACHE_SIZE - 1)];
+  if (cached.hash == hash && cached.wordLen == len) {
+    return unpackBreaks(cached, arena);
+  }
+  if (sidecarActive) {
+    if (const CachedBreaks* stored = findSidecarEntry(hash, len)) {
+      cached = *stored;
+      return unpackBreaks(cached, arena);
+    }
+  }
+
+  auto breaks = computeBreakOffsets(word, includeFallback, arena);
+
+  // Offsets are byte positions inside the word, so anything up to 255 bytes fits the entry
+  if (packBreaks(breaks, hash, len, cached) && sidecarActive &&
+      sidecarEntries.size() + sidecarAdditions.size() < MAX_SIDECAR_ENTRIES) {
+    sidecarAdditions.push_back(cached);
+  }
+  return breaks;
+}
+
+void Hyphenator::beginSidecar(std::vector<StoredBreaks> sortedEntries) {
+  sidecarEntries = std::move(sortedEntries);
+  sidecarAdditions.clear();
+  sidecarActive = true;
+}
+
+bool Hyphenator::endSidecar(std::vector<StoredBreaks>& merged) {
+  sidecarActive = false;
+  merged.clear();
+  const bool changed = !sidecarAdditions.empty();
+  if (changed) {
+    // Merge this build's words into the sorted table, dropping duplicate keys
+    std::sort(sidecarAdditions.begin(), sidecarAdditions.end(), storedBreaksLess);
+    merged.reserve(sidecarEntries.size() + sidecarAdditions.size());
+    std::merge(sidecarEntries.begin(), sidecarEntries.end(), sidecarAdditions.begin(), sidecarAdditions.end(),
+               std::back_inserter(merged), storedBreaksLess);
+    merged.erase(std::unique(merged.begin(), merged.end(),
+                             [](const StoredBreaks& a, const StoredBreaks& b) {
+                               return a.hash == b.hash && a.wordLen == b.wordLen;
+                             }),
+                 merged.end());
+  }
+  std::vector<StoredBreaks>().swap(sidecarEntries);
+  std::vector<StoredBreaks>().swap(sidecarAdditions);
+  return changed;
+}
+
+void Hyphenator::clearCache() { memset(breakCache, 0, sizeof(breakCache)); }
+
+ArenaVector<Hyphenator::BreakInfo> Hyphenator::computeBreakOffsets(const char* word, const bool includeFallback,
+                                                                   LayoutArena* arena) {
+  ArenaVector<BreakInfo> breaks{ArenaAllocator<BreakInfo>(arena)};
+  if (*word == '\0') {
+    return breaks;
   }
 
   // Convert to codepoints and normalize word boundaries.
@@ -72,7 +197,7 @@ std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const std::string& w
   const auto* hyphenator = cachedHyphenator_;
 
   // Explicit hyphen markers (soft or hard) take precedence over language breaks.
-  auto explicitBreakInfos = buildExplicitBreakInfos(cps);
+  auto explicitBreakInfos = buildExplicitBreakInfos(cps, arena);
   if (!explicitBreakInfos.empty()) {
     // When a word contains explicit hyphens we also run Liang patterns on each alphabetic
     // segment between them. Without this, "US-Satellitensystems" would only offer one split
@@ -130,10 +255,9 @@ std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const std::string& w
   }
 
   if (indexes.empty()) {
-    return {};
+    return breaks;
   }
 
-  std::vector<Hyphenator::BreakInfo> breaks;
   breaks.reserve(indexes.size());
   for (const size_t idx : indexes) {
     breaks.push_back({byteOffsetForIndex(cps, idx), true});
@@ -142,4 +266,11 @@ std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const std::string& w
   return breaks;
 }
 
-void Hyphenator::setPreferredLanguage(const std::string& lang) { cachedHyphenator_ = hyphenatorForLanguage(lang); }
+void Hyphenator::setPreferredLanguage(const std::string& lang) {
+  cachedHyphenator_ = hyphenatorForLanguage(lang);
+  if (cachedHyphenator_) {
+    cachedHyphenator_->prepare();
+  }
+  // Called once per section build; cached breaks from another book's language would be wrong
+  clearCache();
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "../LayoutArena.h"
+
 class LanguageHyphenator;
 
 class Hyphenator {
@@ -27,11 +30,35 @@ class Hyphenator {
   //   3. Fallback every-N-chars splitting (only when includeFallback is true AND no
   //      pattern breaks were found). Used as a last resort to prevent a single oversized
   //      word from overflowing the page width.
-  static std::vector<BreakInfo> breakOffsets(const std::string& word, bool includeFallback);
+  //
+  // The returned vector is allocated from `arena` when one is given.
+  static ArenaVector<BreakInfo> breakOffsets(const char* word, bool includeFallback,
+                                             LayoutArena* arena = nullptr);
 
   // Provide a publication-level language hint (e.g. "en", "en-US", "ru") used to select hyphenation rules.
+  // Also clears the break cache.
   static void setPreferredLanguage(const std::string& lang);
 
+  // Forget the cached results of breakOffsets()
+  static void clearCache();
+
+  // Packed breakOffsets() result, as kept in the break cache and in break sidecar files (see BreakSidecar)
+  struct StoredBreaks {
+    uint32_t hash;  // of the word bytes and the fallback flag; 0 = empty cache slot
+    uint8_t wordLen;
+    uint8_t count;
+    uint16_t hyphenMask;  // bit i set = offsets[i] requires an inserted hyphen
+    uint8_t offsets[12];
+  };
+  static constexpr size_t MAX_SIDECAR_ENTRIES = 2048;
+
+  // Consult `sortedEntries` (sorted by hash, then word length) for words missing from the cache, and collect the
+  // words computed from now on. endSidecar() stops that and returns true with the merged table if anything was added.
+  static void beginSidecar(std::vector<StoredBreaks> sortedEntries);
+  static bool endSidecar(std::vector<StoredBreaks>& merged);
+
  private:
+  static ArenaVector<BreakInfo> computeBreakOffsets(const char* word, bool includeFallback, LayoutArena* arena);
+
   static const LanguageHyphenator* cachedHyphenator_;
 };
\ No newline at end of file
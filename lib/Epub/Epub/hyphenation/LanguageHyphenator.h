@@ -14,6 +14,9 @@ class LanguageHyphenator {
     return liangBreakIndexes(cps, patterns_, config_);
   }
 
+  // Called when this language is selected for a book (see Hyphenator::setPreferredLanguage)
+  void prepare() const { liangPrepareRoot(patterns_); }
+
   size_t minPrefix() const { return config_.minPrefix; }
   size_t minSuffix() const { return config_.minSuffix; }
 
@@ -1,6 +1,7 @@
 #include "LiangHyphenation.h"
 
 #include <algorithm>
+#include <iterator>
 #include <vector>
 
 /*
@@ -26,6 +27,11 @@
  *       flash memory; no heap allocations besides the stack-local AutomatonState
  *       structs. getAutomaton caches parseAutomaton results per blob pointer so
  *       multiple words hitting the same language only pay the cost once.
+ *     - Every start position begins at the root, so the root and its children
+ *       are the hottest nodes by far. liangPrepareRoot (called when a book's
+ *       language is selected) decodes them once into a 256-entry table indexed
+ *       by the first byte; walks then start one level down without touching the
+ *       variable-stride encoding of either node.
  *
  * 3.  Pattern application
  *     - We walk the augmented bytes left-to-right. For each starting byte we
@@ -309,6 +315,32 @@ bool transition(const EmbeddedAutomaton& automaton, const AutomatonState& state,
   return false;
 }
 
+// The root and its children of the most recently prepared trie, decoded (see liangPrepareRoot)
+struct RootTable {
+  static constexpr uint8_t NO_CHILD = 0xFF;
+
+  const SerializedHyphenationPatterns* patterns = nullptr;
+  AutomatonState root;
+  uint8_t childSlot[256];  // Index into children by first byte, NO_CHILD if the root has no such transition
+  std::vector<AutomatonState> children;
+};
+
+RootTable rootTable;
+
+// Step from the root on `letter`, through the table when it was prepared for this trie
+bool rootTransition(const EmbeddedAutomaton& automaton, const AutomatonState& root, const uint8_t letter,
+                    AutomatonState& out) {
+  if (rootTable.patterns != &automaton) {
+    return transition(automaton, root, letter, out);
+  }
+  const uint8_t slot = rootTable.childSlot[letter];
+  if (slot == RootTable::NO_CHILD) {
+    return false;
+  }
+  out = rootTable.children[slot];
+  return true;
+}
+
 // Converts odd score positions back into codepoint indexes, honoring min prefix/suffix constraints.
 // Each break corresponds to scores[breakIndex + 1] because of the leading '.' sentinel.
 // Convert odd score entries into hyphen positions while honoring prefix/suffix limits.
@@ -345,6 +377,32 @@ std::vector<size_t> collectBreakIndexes(const std::vector<CodepointInfo>& cps, c
 
 }  // namespace
 
+void liangPrepareRoot(const SerializedHyphenationPatterns& patterns) {
+  if (rootTable.patterns == &patterns) {
+    return;
+  }
+  rootTable.patterns = nullptr;
+  rootTable.children.clear();
+  std::fill(std::begin(rootTable.childSlot), std::end(rootTable.childSlot), RootTable::NO_CHILD);
+
+  const AutomatonState root = decodeState(patterns, patterns.rootOffset);
+  if (!root.valid() || root.childCount >= RootTable::NO_CHILD) {
+    return;
+  }
+  rootTable.children.reserve(root.childCount);
+  for (size_t idx = 0; idx < root.childCount; ++idx) {
+    const uint8_t letter = root.transitions[idx];
+    AutomatonState child;
+    if (rootTable.childSlot[letter] != RootTable::NO_CHILD || !transition(patterns, root, letter, child)) {
+      continue;
+    }
+    rootTable.childSlot[letter] = static_cast<uint8_t>(rootTable.children.size());
+    rootTable.children.push_back(child);
+  }
+  rootTable.root = root;
+  rootTable.patterns = &patterns;
+}
+
 // Entry point that runs the full Liang pipeline for a single word.
 std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
                                       const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config) {
@@ -357,7 +415,8 @@ std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
 
   const EmbeddedAutomaton& automaton = patterns;
 
-  const AutomatonState root = decodeState(automaton, automaton.rootOffset);
+  const AutomatonState root =
+      rootTable.patterns == &automaton ? rootTable.root : decodeState(automaton, automaton.rootOffset);
   if (!root.valid()) {
     return {};
   }
@@ -376,7 +435,9 @@ std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
 
     for (size_t cursor = byteStart; cursor < augmented.byteLen; ++cursor) {
       AutomatonState next;
-      if (!transition(automaton, state, augmented.bytes[cursor], next)) {
+      const bool matched = cursor == byteStart ? rootTransition(automaton, root, augmented.bytes[cursor], next)
+                                               : transition(automaton, state, augmented.bytes[cursor], next);
+      if (!matched) {
         break;  // No more matches for this prefix.
       }
       state = next;
@@ -33,6 +33,10 @@ struct LiangWordConfig {
       : isLetter(letterFn), toLower(lowerFn), minPrefix(prefix), minSuffix(suffix) {}
 };
 
+// Decode the root of `patterns` and its children once, so liangBreakIndexes can start every walk from a table instead
+// of the serialized nodes. Only the most recently prepared trie keeps its table; others take the regular path.
+void liangPrepareRoot(const SerializedHyphenationPatterns& patterns);
+
 // Shared Liang pattern evaluator used by every language-specific hyphenator.
 std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
                                       const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config);
@@ -4,13 +4,21 @@
 #include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <Logging.h>
+#include <ZipFile.h>
 #include <expat.h>
 
+#include <algorithm>
+
 #include "../../Epub.h"
+#include "../FootnoteStore.h"
 #include "../Page.h"
+#include "../SectionFlow.h"
 #include "../converters/ImageDecoderFactory.h"
+#include "../converters/ImageHeaderProbe.h"
+#include "../converters/ImageSource.h"
 #include "../converters/ImageToFramebufferDecoder.h"
 #include "../htmlEntities.h"
+#include "XmlParserPool.h"
 
 const char* HEADER_TAGS[] = {"h1", "h2", "h3", "h4", "h5", "h6"};
 constexpr int NUM_HEADER_TAGS = sizeof(HEADER_TAGS) / sizeof(HEADER_TAGS[0]);
@@ -39,6 +47,18 @@ constexpr int NUM_SKIP_TAGS = sizeof(SKIP_TAGS) / sizeof(SKIP_TAGS[0]);
 
 bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
 
+// Bytes characterData appends to the current word as they are: everything but whitespace and the lead bytes of the
+// no-break space and BOM sequences it handles itself. One table load per byte instead of seven compares.
+struct PlainWordBytes {
+  bool plain[256] = {};
+  constexpr PlainWordBytes() {
+    for (int c = 0; c < 256; c++) {
+      plain[c] = c != ' ' && c != '\r' && c != '\n' && c != '\t' && c != 0xC2 && c != 0xE2 && c != 0xEF;
+    }
+  }
+};
+constexpr PlainWordBytes PLAIN_WORD_BYTES;
+
 // given the start and end of a tag, check to see if it matches a known tag
 bool matches(const char* tag_name, const char* possible_tags[], const int possible_tag_count) {
   for (int i = 0; i < possible_tag_count; i++) {
@@ -76,6 +96,72 @@ bool isTableStructuralTag(const char* name) {
 }
 
 // Update effective bold/italic/underline based on block style and inline style stack
+CssStyle ChapterHtmlSlimParser::resolveCssStyle(const char* tagName, const std::string& classAttr) {
+  if (!cssParser) {
+    return CssStyle{};
+  }
+
+  // FNV-1a over "tag\0class"; the class length is stored alongside to make collisions even less likely
+  uint32_t key = 2166136261u;
+  for (const char* p = tagName; *p; p++) {
+    key = (key ^ static_cast<uint8_t>(*p)) * 16777619u;
+  }
+  key *= 16777619u;
+  for (const char c : classAttr) {
+    key = (key ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  const auto classLen = static_cast<uint16_t>(classAttr.size());
+
+  resolvedStyleClock++;
+  ResolvedStyleEntry* victim = nullptr;
+  for (auto& entry : resolvedStyles) {
+    if (entry.key == key && entry.classLen == classLen) {
+      entry.lastUse = resolvedStyleClock;
+      // A descendant or child rule targets this tag and class, the style depends on where the element is
+      return entry.contextual ? cssParser->resolveStyle(tagName, classAttr, &cssAncestors) : entry.style;
+    }
+    if (!victim || entry.lastUse < victim->lastUse) {
+      victim = &entry;
+    }
+  }
+
+  bool contextual = false;
+  const CssStyle style = cssParser->resolveStyle(tagName, classAttr, &cssAncestors, &contextual);
+  if (resolvedStyles.size() < RESOLVED_STYLE_CACHE_SIZE) {
+    if (resolvedStyles.empty()) {
+      resolvedStyles.reserve(RESOLVED_STYLE_CACHE_SIZE);
+    }
+    resolvedStyles.push_back({key, classLen, contextual, resolvedStyleClock, style});
+  } else {
+    *victim = {key, classLen, contextual, resolvedStyleClock, style};
+  }
+  return style;
+}
+
+void ChapterHtmlSlimParser::linkStylesheet(const XML_Char** atts) {
+  const char* rel = getAttribute(atts, "rel");
+  const char* href = getAttribute(atts, "href");
+  if (!rel || !href) {
+    return;
+  }
+  std::string relLower(rel);
+  for (char& c : relLower) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  if (relLower.find("stylesheet") == std::string::npos || relLower.find("alternate") != std::string::npos) {
+    return;
+  }
+
+  std::string path = contentBase + href;
+  const size_t fragment = path.find_first_of("?#");
+  if (fragment != std::string::npos) {
+    path.resize(fragment);
+  }
+  if (cssParser->useStylesheet(FsHelpers::normalisePath(path))) {
+    resolvedStyles.clear();
+  }
+}
+
 void ChapterHtmlSlimParser::updateEffectiveInlineStyle() {
   // Start with block-level styles
   effectiveBold = currentCssStyle.hasFontWeight() && currentCssStyle.fontWeight == CssFontWeight::Bold;
@@ -116,9 +202,18 @@ void ChapterHtmlSlimParser::flushPartWordBuffer() {
     fontStyle = static_cast<EpdFontFamily::Style>(fontStyle | EpdFontFamily::UNDERLINE);
   }
 
+  // Ids opened since the last word start at this one
+  if (!unplacedIds.empty()) {
+    const int wordIndex = wordsExtractedInBlock + static_cast<int>(currentTextBlock->size());
+    for (const uint32_t id : unplacedIds) {
+      placedIds.emplace_back(id, wordIndex);
+    }
+    unplacedIds.clear();
+  }
+
   // flush the buffer
   partWordBuffer[partWordBufferIndex] = '\0';
-  currentTextBlock->addWord(partWordBuffer, fontStyle, false, nextWordContinues);
+  currentTextBlock->addWord(partWordBuffer, partWordBufferIndex, fontStyle, false, nextWordContinues);
   partWordBufferIndex = 0;
   nextWordContinues = false;
 }
@@ -138,12 +233,30 @@ void ChapterHtmlSlimParser::startNewTextBlock(const BlockStyle& blockStyle) {
 
     makePages();
   }
-  currentTextBlock.reset(new ParsedText(extraParagraphSpacing, hyphenationEnabled, blockStyle));
+  currentTextBlock.reset(new ParsedText(extraParagraphSpacing, hyphenationEnabled, blockStyle, &arenas, widthCache));
   wordsExtractedInBlock = 0;
+  paragraphIndex++;
+  blockPath = domPath;
 }
 
 void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
   auto* self = static_cast<ChapterHtmlSlimParser*>(userData);
+  self->enterDomElement(name);
+  if (self->cssParser) {
+    const char* classAttr = getAttribute(atts, "class");
+    self->cssAncestors.push(name, classAttr ? classAttr : "");
+  }
+
+  // Stylesheets are scoped to the chapter: only those linked from <head> get loaded, before the first body element
+  // resolves its style. Chapters without a known link fall back to every stylesheet in the book.
+  if (self->cssParser) {
+    if (strcmp(name, "link") == 0) {
+      self->linkStylesheet(atts);
+    } else if (strcmp(name, "body") == 0 && !self->cssParser->hasLinkedStylesheet()) {
+      self->cssParser->useAllStylesheets();
+      self->resolvedStyles.clear();
+    }
+  }
 
   // Middle of skip
   if (self->skipUntilDepth < self->depth) {
@@ -154,15 +267,24 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
   // Extract class and style attributes for CSS processing
   std::string classAttr;
   std::string styleAttr;
+  const char* idAttr = nullptr;
   if (atts != nullptr) {
     for (int i = 0; atts[i]; i += 2) {
       if (strcmp(atts[i], "class") == 0) {
         classAttr = atts[i + 1];
       } else if (strcmp(atts[i], "style") == 0) {
         styleAttr = atts[i + 1];
+      } else if (strcmp(atts[i], "id") == 0) {
+        idAttr = atts[i + 1];
       }
     }
   }
+  if (idAttr && self->idPages) {
+    self->unplacedIds.push_back(idHash(idAttr));
+  }
+  if (self->footnoteStore) {
+    self->beginNoteCapture(name, atts, idAttr);
+  }
 
   auto centeredBlockStyle = BlockStyle();
   centeredBlockStyle.textAlignDefined = true;
@@ -251,161 +373,206 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
           std::string resolvedPath = FsHelpers::normalisePath(self->contentBase + src);
 
           if (ImageDecoderFactory::isFormatSupported(resolvedPath)) {
-            // Create a unique filename for the cached image
+            // Cached images are named by their path in the book, so an image used in several chapters (or
+            // several times in one) is extracted once and shares its decoded caches
             std::string ext;
             size_t extPos = resolvedPath.rfind('.');
             if (extPos != std::string::npos) {
               ext = resolvedPath.substr(extPos);
             }
-            std::string cachedImagePath = self->imageBasePath + std::to_string(self->imageCounter++) + ext;
+            char hashName[17];
+            snprintf(hashName, sizeof(hashName), "%016llx",
+                     static_cast<unsigned long long>(ZipFile::fnvHash64(resolvedPath.data(), resolvedPath.size())));
+            std::string cachedImagePath = self->imageBasePath + hashName + ext;
+
+            // Size from the first bytes of the entry, without inflating the rest of it
+            ImageDimensions dims = {0, 0};
+            bool hasDimensions = false;
+            if (auto* header = static_cast<uint8_t*>(malloc(ImageHeaderProbe::PREFIX_BYTES))) {
+              const size_t headerLen =
+                  self->epub->readItemPrefix(resolvedPath, header, ImageHeaderProbe::PREFIX_BYTES);
+              hasDimensions = ImageHeaderProbe::probe(header, headerLen, dims);
+              free(header);
+            }
 
-            // Extract image to cache file
-            FsFile cachedImageFile;
-            bool extractSuccess = false;
-            if (Storage.openFileForWrite("EHP", cachedImagePath, cachedImageFile)) {
-              extractSuccess = self->epub->readItemContentsToStream(resolvedPath, cachedImageFile, 4096);
+            // Extract image to cache file, through a temporary name so an interrupted build never leaves a
+            // truncated image that a later chapter would take as already extracted. Only needed when the image
+            // can't be sized or pre-rendered straight from its entry.
+            bool extracted = Storage.exists(cachedImagePath.c_str());
+            const auto extract = [&]() {
+              const std::string partPath = cachedImagePath + ".part";
+              FsFile cachedImageFile;
+              if (!Storage.openFileForWrite("EHP", partPath, cachedImageFile)) {
+                return false;
+              }
+              bool success = self->epub->readItemContentsToStream(resolvedPath, cachedImageFile, 4096);
               cachedImageFile.flush();
               cachedImageFile.close();
               delay(50);  // Give SD card time to sync
+              success = success && Storage.rename(partPath.c_str(), cachedImagePath.c_str());
+              if (!success) {
+                Storage.remove(partPath.c_str());
+                LOG_ERR("EHP", "Failed to extract image");
+              }
+              return success;
+            };
+            if (extracted) {
+              LOG_DBG("EHP", "Image already extracted: %s", cachedImagePath.c_str());
             }
 
-            if (extractSuccess) {
-              // Get image dimensions
-              ImageDimensions dims = {0, 0};
+            if (!hasDimensions && (extracted || (extracted = extract()))) {
+              // Frame header past the probed prefix (e.g. behind a JPEG's EXIF thumbnail): ask the decoder
               ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(cachedImagePath);
-              if (decoder && decoder->getDimensions(cachedImagePath, dims)) {
-                LOG_DBG("EHP", "Image dimensions: %dx%d", dims.width, dims.height);
-
-                int displayWidth = 0;
-                int displayHeight = 0;
-                const float emSize =
-                    static_cast<float>(self->renderer.getLineHeight(self->fontId)) * self->lineCompression;
-                CssStyle imgStyle = self->cssParser ? self->cssParser->resolveStyle("img", classAttr) : CssStyle{};
-                // Merge inline style (e.g. style="height: 2em") so it overrides stylesheet rules
-                if (!styleAttr.empty()) {
-                  imgStyle.applyOver(CssParser::parseInlineStyle(styleAttr));
-                }
-                const bool hasCssHeight = imgStyle.hasImageHeight();
-                const bool hasCssWidth = imgStyle.hasImageWidth();
-
-                if (hasCssHeight && hasCssWidth && dims.width > 0 && dims.height > 0) {
-                  // Both CSS height and width set: resolve both, then clamp to viewport preserving requested ratio
-                  displayHeight = static_cast<int>(
-                      imgStyle.imageHeight.toPixels(emSize, static_cast<float>(self->viewportHeight)) + 0.5f);
-                  displayWidth = static_cast<int>(
-                      imgStyle.imageWidth.toPixels(emSize, static_cast<float>(self->viewportWidth)) + 0.5f);
-                  if (displayHeight < 1) displayHeight = 1;
+              hasDimensions = decoder && decoder->getDimensions(cachedImagePath, dims);
+            }
+            if (hasDimensions) {
+              LOG_DBG("EHP", "Image dimensions: %dx%d", dims.width, dims.height);
+
+              int displayWidth = 0;
+              int displayHeight = 0;
+              const float emSize =
+                  static_cast<float>(self->renderer.getLineHeight(self->fontId)) * self->lineCompression;
+              CssStyle imgStyle = self->resolveCssStyle("img", classAttr);
+              // Merge inline style (e.g. style="height: 2em") so it overrides stylesheet rules
+              if (!styleAttr.empty()) {
+                imgStyle.applyOver(CssParser::parseInlineStyle(styleAttr));
+              }
+              const bool hasCssHeight = imgStyle.hasImageHeight();
+              const bool hasCssWidth = imgStyle.hasImageWidth();
+
+              if (hasCssHeight && hasCssWidth && dims.width > 0 && dims.height > 0) {
+                // Both CSS height and width set: resolve both, then clamp to viewport preserving requested ratio
+                displayHeight = static_cast<int>(
+                    imgStyle.imageHeight.toPixels(emSize, static_cast<float>(self->viewportHeight)) + 0.5f);
+                displayWidth = static_cast<int>(
+                    imgStyle.imageWidth.toPixels(emSize, static_cast<float>(self->viewportWidth)) + 0.5f);
+                if (displayHeight < 1) displayHeight = 1;
+                if (displayWidth < 1) displayWidth = 1;
+                if (displayWidth > self->viewportWidth || displayHeight > self->viewportHeight) {
+                  float scaleX = (displayWidth > self->viewportWidth)
+                                     ? static_cast<float>(self->viewportWidth) / displayWidth
+                                     : 1.0f;
+                  float scaleY = (displayHeight > self->viewportHeight)
+                                     ? static_cast<float>(self->viewportHeight) / displayHeight
+                                     : 1.0f;
+                  float scale = (scaleX < scaleY) ? scaleX : scaleY;
+                  displayWidth = static_cast<int>(displayWidth * scale + 0.5f);
+                  displayHeight = static_cast<int>(displayHeight * scale + 0.5f);
                   if (displayWidth < 1) displayWidth = 1;
-                  if (displayWidth > self->viewportWidth || displayHeight > self->viewportHeight) {
-                    float scaleX = (displayWidth > self->viewportWidth)
-                                       ? static_cast<float>(self->viewportWidth) / displayWidth
-                                       : 1.0f;
-                    float scaleY = (displayHeight > self->viewportHeight)
-                                       ? static_cast<float>(self->viewportHeight) / displayHeight
-                                       : 1.0f;
-                    float scale = (scaleX < scaleY) ? scaleX : scaleY;
-                    displayWidth = static_cast<int>(displayWidth * scale + 0.5f);
-                    displayHeight = static_cast<int>(displayHeight * scale + 0.5f);
-                    if (displayWidth < 1) displayWidth = 1;
-                    if (displayHeight < 1) displayHeight = 1;
-                  }
-                  LOG_DBG("EHP", "Display size from CSS height+width: %dx%d", displayWidth, displayHeight);
-                } else if (hasCssHeight && !hasCssWidth && dims.width > 0 && dims.height > 0) {
-                  // Use CSS height (resolve % against viewport height) and derive width from aspect ratio
-                  displayHeight = static_cast<int>(
-                      imgStyle.imageHeight.toPixels(emSize, static_cast<float>(self->viewportHeight)) + 0.5f);
                   if (displayHeight < 1) displayHeight = 1;
+                }
+                LOG_DBG("EHP", "Display size from CSS height+width: %dx%d", displayWidth, displayHeight);
+              } else if (hasCssHeight && !hasCssWidth && dims.width > 0 && dims.height > 0) {
+                // Use CSS height (resolve % against viewport height) and derive width from aspect ratio
+                displayHeight = static_cast<int>(
+                    imgStyle.imageHeight.toPixels(emSize, static_cast<float>(self->viewportHeight)) + 0.5f);
+                if (displayHeight < 1) displayHeight = 1;
+                displayWidth = static_cast<int>(displayHeight * (static_cast<float>(dims.width) / dims.height) + 0.5f);
+                if (displayHeight > self->viewportHeight) {
+                  displayHeight = self->viewportHeight;
+                  // Rescale width to preserve aspect ratio when height is clamped
                   displayWidth =
                       static_cast<int>(displayHeight * (static_cast<float>(dims.width) / dims.height) + 0.5f);
-                  if (displayHeight > self->viewportHeight) {
-                    displayHeight = self->viewportHeight;
-                    // Rescale width to preserve aspect ratio when height is clamped
-                    displayWidth =
-                        static_cast<int>(displayHeight * (static_cast<float>(dims.width) / dims.height) + 0.5f);
-                    if (displayWidth < 1) displayWidth = 1;
-                  }
-                  if (displayWidth > self->viewportWidth) {
-                    displayWidth = self->viewportWidth;
-                    // Rescale height to preserve aspect ratio when width is clamped
-                    displayHeight =
-                        static_cast<int>(displayWidth * (static_cast<float>(dims.height) / dims.width) + 0.5f);
-                    if (displayHeight < 1) displayHeight = 1;
-                  }
-                  if (displayWidth < 1) displayWidth = 1;
-                  LOG_DBG("EHP", "Display size from CSS height: %dx%d", displayWidth, displayHeight);
-                } else if (hasCssWidth && !hasCssHeight && dims.width > 0 && dims.height > 0) {
-                  // Use CSS width (resolve % against viewport width) and derive height from aspect ratio
-                  displayWidth = static_cast<int>(
-                      imgStyle.imageWidth.toPixels(emSize, static_cast<float>(self->viewportWidth)) + 0.5f);
-                  if (displayWidth > self->viewportWidth) displayWidth = self->viewportWidth;
                   if (displayWidth < 1) displayWidth = 1;
+                }
+                if (displayWidth > self->viewportWidth) {
+                  displayWidth = self->viewportWidth;
+                  // Rescale height to preserve aspect ratio when width is clamped
                   displayHeight =
                       static_cast<int>(displayWidth * (static_cast<float>(dims.height) / dims.width) + 0.5f);
-                  if (displayHeight > self->viewportHeight) {
-                    displayHeight = self->viewportHeight;
-                    // Rescale width to preserve aspect ratio when height is clamped
-                    displayWidth =
-                        static_cast<int>(displayHeight * (static_cast<float>(dims.width) / dims.height) + 0.5f);
-                    if (displayWidth < 1) displayWidth = 1;
-                  }
                   if (displayHeight < 1) displayHeight = 1;
-                  LOG_DBG("EHP", "Display size from CSS width: %dx%d", displayWidth, displayHeight);
-                } else {
-                  // Scale to fit viewport while maintaining aspect ratio
-                  int maxWidth = self->viewportWidth;
-                  int maxHeight = self->viewportHeight;
-                  float scaleX = (dims.width > maxWidth) ? (float)maxWidth / dims.width : 1.0f;
-                  float scaleY = (dims.height > maxHeight) ? (float)maxHeight / dims.height : 1.0f;
-                  float scale = (scaleX < scaleY) ? scaleX : scaleY;
-                  if (scale > 1.0f) scale = 1.0f;
-
-                  displayWidth = (int)(dims.width * scale);
-                  displayHeight = (int)(dims.height * scale);
-                  LOG_DBG("EHP", "Display size: %dx%d (scale %.2f)", displayWidth, displayHeight, scale);
                 }
-
-                // Create page for image - only break if image won't fit remaining space
-                if (self->currentPage && !self->currentPage->elements.empty() &&
-                    (self->currentPageNextY + displayHeight > self->viewportHeight)) {
-                  self->completePageFn(std::move(self->currentPage));
-                  self->currentPage.reset(new Page());
-                  if (!self->currentPage) {
-                    LOG_ERR("EHP", "Failed to create new page");
-                    return;
-                  }
-                  self->currentPageNextY = 0;
-                } else if (!self->currentPage) {
-                  self->currentPage.reset(new Page());
-                  if (!self->currentPage) {
-                    LOG_ERR("EHP", "Failed to create initial page");
-                    return;
-                  }
-                  self->currentPageNextY = 0;
+                if (displayWidth < 1) displayWidth = 1;
+                LOG_DBG("EHP", "Display size from CSS height: %dx%d", displayWidth, displayHeight);
+              } else if (hasCssWidth && !hasCssHeight && dims.width > 0 && dims.height > 0) {
+                // Use CSS width (resolve % against viewport width) and derive height from aspect ratio
+                displayWidth = static_cast<int>(
+                    imgStyle.imageWidth.toPixels(emSize, static_cast<float>(self->viewportWidth)) + 0.5f);
+                if (displayWidth > self->viewportWidth) displayWidth = self->viewportWidth;
+                if (displayWidth < 1) displayWidth = 1;
+                displayHeight = static_cast<int>(displayWidth * (static_cast<float>(dims.height) / dims.width) + 0.5f);
+                if (displayHeight > self->viewportHeight) {
+                  displayHeight = self->viewportHeight;
+                  // Rescale width to preserve aspect ratio when height is clamped
+                  displayWidth =
+                      static_cast<int>(displayHeight * (static_cast<float>(dims.width) / dims.height) + 0.5f);
+                  if (displayWidth < 1) displayWidth = 1;
                 }
+                if (displayHeight < 1) displayHeight = 1;
+                LOG_DBG("EHP", "Display size from CSS width: %dx%d", displayWidth, displayHeight);
+              } else {
+                // Scale to fit viewport while maintaining aspect ratio
+                int maxWidth = self->viewportWidth;
+                int maxHeight = self->viewportHeight;
+                float scaleX = (dims.width > maxWidth) ? (float)maxWidth / dims.width : 1.0f;
+                float scaleY = (dims.height > maxHeight) ? (float)maxHeight / dims.height : 1.0f;
+                float scale = (scaleX < scaleY) ? scaleX : scaleY;
+                if (scale > 1.0f) scale = 1.0f;
+
+                displayWidth = (int)(dims.width * scale);
+                displayHeight = (int)(dims.height * scale);
+                LOG_DBG("EHP", "Display size: %dx%d (scale %.2f)", displayWidth, displayHeight, scale);
+              }
 
-                // Create ImageBlock and add to page
-                auto imageBlock = std::make_shared<ImageBlock>(cachedImagePath, displayWidth, displayHeight);
-                if (!imageBlock) {
-                  LOG_ERR("EHP", "Failed to create ImageBlock");
+              // Create page for image - only break if image won't fit remaining space
+              if (self->currentPage && !self->currentPage->elements.empty() &&
+                  (self->currentPageNextY + displayHeight > self->viewportHeight)) {
+                self->completeCurrentPage();
+                self->currentPage.reset(new Page());
+                if (!self->currentPage) {
+                  LOG_ERR("EHP", "Failed to create new page");
                   return;
                 }
-                int xPos = (self->viewportWidth - displayWidth) / 2;
-                auto pageImage = std::make_shared<PageImage>(imageBlock, xPos, self->currentPageNextY);
-                if (!pageImage) {
-                  LOG_ERR("EHP", "Failed to create PageImage");
+                self->currentPageNextY = 0;
+              } else if (!self->currentPage) {
+                self->currentPage.reset(new Page());
+                if (!self->currentPage) {
+                  LOG_ERR("EHP", "Failed to create initial page");
                   return;
                 }
-                self->currentPage->elements.push_back(pageImage);
-                self->currentPageNextY += displayHeight;
+                self->currentPageNextY = 0;
+              }
 
-                self->depth += 1;
+              // Create ImageBlock and add to page
+              auto imageBlock = std::make_shared<ImageBlock>(cachedImagePath, displayWidth, displayHeight);
+              if (!imageBlock) {
+                LOG_ERR("EHP", "Failed to create ImageBlock");
                 return;
-              } else {
-                LOG_ERR("EHP", "Failed to get image dimensions");
-                Storage.remove(cachedImagePath.c_str());
               }
+              self->anchorCurrentPage();
+              self->resolvePendingIds();
+              // Decode now so the page draws from frame buffer planes, straight from the archive entry if the
+              // image isn't on the card yet. The pixel cache written alongside serves other orientations, so
+              // the image is only extracted when that decode fails (progressive JPEG, low heap) or is left to
+              // the first render (section laid out for another orientation); render() decodes the file then.
+              bool prerendered = false;
+              if (!extracted) {
+                ImageSource entry;
+                prerendered =
+                    entry.openZipEntry(self->epub->getPath(), self->epub->getZipIndexPath(), resolvedPath) &&
+                    imageBlock->prerender(self->renderer, &entry);
+              }
+              if (!prerendered && (extracted || extract())) {
+                imageBlock->prerender(self->renderer);
+              }
+              int xPos = (self->viewportWidth - displayWidth) / 2;
+              auto pageImage = std::make_shared<PageImage>(imageBlock, xPos, self->currentPageNextY);
+              if (!pageImage) {
+                LOG_ERR("EHP", "Failed to create PageImage");
+                return;
+              }
+              self->currentPage->elements.push_back(pageImage);
+              self->currentPageNextY += displayHeight;
+              if (self->flow) {
+                // Its size depends on the viewport height, so the pages can't be cut from the lines alone
+                self->flow->discard();
+              }
+
+              self->depth += 1;
+              return;
             } else {
-              LOG_ERR("EHP", "Failed to extract image");
+              LOG_ERR("EHP", "Failed to get image dimensions");
+              Storage.remove(cachedImagePath.c_str());
             }
           }  // isFormatSupported
         }
@@ -497,7 +664,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
   CssStyle cssStyle;
   if (self->cssParser) {
     // Get combined tag + class styles
-    cssStyle = self->cssParser->resolveStyle(name, classAttr);
+    cssStyle = self->resolveCssStyle(name, classAttr);
     // Merge inline style (highest priority)
     if (!styleAttr.empty()) {
       CssStyle inlineStyle = CssParser::parseInlineStyle(styleAttr);
@@ -532,7 +699,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
       self->updateEffectiveInlineStyle();
 
       if (strcmp(name, "li") == 0) {
-        self->currentTextBlock->addWord("\xe2\x80\xa2", EpdFontFamily::REGULAR);
+        self->currentTextBlock->addWord("\xe2\x80\xa2", 3, EpdFontFamily::REGULAR);
       }
     }
   } else if (matches(name, UNDERLINE_TAGS, NUM_UNDERLINE_TAGS)) {
@@ -640,6 +807,11 @@ void XMLCALL ChapterHtmlSlimParser::characterData(void* userData, const XML_Char
     return;
   }
 
+  // Notes hidden from the flow (display: none) still get their preview text
+  if (self->noteCaptureDepth < self->depth) {
+    self->appendNoteText(s, len);
+  }
+
   // Middle of skip
   if (self->skipUntilDepth < self->depth) {
     return;
@@ -659,6 +831,20 @@ void XMLCALL ChapterHtmlSlimParser::characterData(void* userData, const XML_Char
   }
 
   for (int i = 0; i < len; i++) {
+    // Copy the bytes up to the next whitespace or special sequence in one tight loop; locals, as every char store
+    // could otherwise alias the index
+    {
+      char* const word = self->partWordBuffer;
+      int index = self->partWordBufferIndex;
+      while (i < len && index < MAX_WORD_SIZE && PLAIN_WORD_BYTES.plain[static_cast<uint8_t>(s[i])]) {
+        word[index++] = s[i++];
+      }
+      self->partWordBufferIndex = index;
+      if (i == len) {
+        break;
+      }
+    }
+
     if (isWhitespace(s[i])) {
       // Currently looking at whitespace, if there's anything in the partWordBuffer, flush it
       if (self->partWordBufferIndex > 0) {
@@ -754,7 +940,7 @@ void XMLCALL ChapterHtmlSlimParser::characterData(void* userData, const XML_Char
     LOG_DBG("EHP", "Text block too long, splitting into multiple pages");
     self->currentTextBlock->layoutAndExtractLines(
         self->renderer, self->fontId, self->viewportWidth,
-        [self](const std::shared_ptr<TextBlock>& textBlock) { self->addLineToPage(textBlock); }, false);
+        [self](ArenaPtr<TextBlock> textBlock) { self->addLineToPage(std::move(textBlock)); }, false);
   }
 }
 
@@ -776,6 +962,10 @@ void XMLCALL ChapterHtmlSlimParser::defaultHandlerExpand(void* userData, const X
 
 void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* name) {
   auto* self = static_cast<ChapterHtmlSlimParser*>(userData);
+  self->leaveDomElement();
+  if (self->cssParser) {
+    self->cssAncestors.pop();
+  }
 
   // Check if any style state will change after we decrement depth
   // If so, we MUST flush the partWordBuffer with the CURRENT style first
@@ -830,10 +1020,23 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
       int wordIndex =
           self->wordsExtractedInBlock + (self->currentTextBlock ? static_cast<int>(self->currentTextBlock->size()) : 0);
       self->pendingFootnotes.push_back({wordIndex, entry});
+      if (self->footnoteStore && entry.href[0] == '#' && self->noteRefIds.size() < MAX_NOTE_REFS) {
+        self->noteRefIds.push_back(idHash(entry.href + 1));
+      }
     }
     self->insideFootnoteLink = false;
   }
 
+  // Closing a captured note
+  if (self->noteCaptureDepth == self->depth) {
+    while (!self->noteCaptureText.empty() && self->noteCaptureText.back() == ' ') {
+      self->noteCaptureText.pop_back();
+    }
+    self->footnoteStore->add(self->noteCaptureHash, self->noteCaptureText);
+    self->noteCaptureText.clear();
+    self->noteCaptureDepth = INT_MAX;
+  }
+
   // Leaving skip
   if (self->skipUntilDepth == self->depth) {
     self->skipUntilDepth = INT_MAX;
@@ -898,6 +1101,23 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
 }
 
 bool ChapterHtmlSlimParser::parseAndBuildPages() {
+  if (!beginParse()) {
+    return false;
+  }
+  while (true) {
+    if (shouldAbortFn && shouldAbortFn()) {
+      LOG_DBG("EHP", "Parse aborted");
+      releaseParser();
+      return false;
+    }
+    const ParseStep step = parseNext();
+    if (step != ParseStep::More) {
+      return step == ParseStep::Done;
+    }
+  }
+}
+
+bool ChapterHtmlSlimParser::beginParse() {
   auto paragraphAlignmentBlockStyle = BlockStyle();
   paragraphAlignmentBlockStyle.textAlignDefined = true;
   // Resolve None sentinel to Justify for initial block (no CSS context yet)
@@ -907,99 +1127,117 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
   paragraphAlignmentBlockStyle.alignment = align;
   startNewTextBlock(paragraphAlignmentBlockStyle);
 
-  const XML_Parser parser = XML_ParserCreate(nullptr);
-  int done;
-
-  if (!parser) {
+  xmlParser = XmlParserPool::acquire();
+  if (!xmlParser) {
     LOG_ERR("EHP", "Couldn't allocate memory for parser");
     return false;
   }
 
   // Handle HTML entities (like &nbsp;) that aren't in XML spec or DTD
   // Using DefaultHandlerExpand preserves normal entity expansion from DOCTYPE
-  XML_SetDefaultHandlerExpand(parser, defaultHandlerExpand);
+  XML_SetDefaultHandlerExpand(xmlParser, defaultHandlerExpand);
 
-  FsFile file;
-  if (!Storage.openFileForRead("EHP", filepath, file)) {
-    XML_ParserFree(parser);
+  if (!itemReader && !Storage.openFileForRead("EHP", filepath, file)) {
+    releaseParser();
     return false;
   }
 
   // Get file size to decide whether to show indexing popup.
-  if (popupFn && file.size() >= MIN_SIZE_FOR_POPUP) {
+  const size_t sourceSize = itemReader ? itemReader->size() : file.size();
+  if (popupFn && sourceSize >= MIN_SIZE_FOR_POPUP) {
     popupFn();
   }
 
-  XML_SetUserData(parser, this);
-  XML_SetElementHandler(parser, startElement, endElement);
-  XML_SetCharacterDataHandler(parser, characterData);
+  XML_SetUserData(xmlParser, this);
+  XML_SetElementHandler(xmlParser, startElement, endElement);
+  XML_SetCharacterDataHandler(xmlParser, characterData);
 
   // Compute the time taken to parse and build pages
-  const uint32_t chapterStartTime = millis();
-  do {
-    void* const buf = XML_GetBuffer(parser, PARSE_BUFFER_SIZE);
-    if (!buf) {
-      LOG_ERR("EHP", "Couldn't allocate memory for buffer");
-      XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-      XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-      XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
-      file.close();
-      return false;
-    }
+  parseStartTime = millis();
+  return true;
+}
+
+ChapterHtmlSlimParser::ParseStep ChapterHtmlSlimParser::parseNext() {
+  if (!xmlParser) {
+    return ParseStep::Failed;
+  }
 
-    const size_t len = file.read(buf, PARSE_BUFFER_SIZE);
+  void* const buf = XML_GetBuffer(xmlParser, PARSE_BUFFER_SIZE);
+  if (!buf) {
+    LOG_ERR("EHP", "Couldn't allocate memory for buffer");
+    releaseParser();
+    return ParseStep::Failed;
+  }
 
+  size_t len;
+  int done;
+  if (itemReader) {
+    const int produced = itemReader->read(static_cast<uint8_t*>(buf), PARSE_BUFFER_SIZE);
+    if (produced < 0) {
+      LOG_ERR("EHP", "Item read error");
+      releaseParser();
+      return ParseStep::Failed;
+    }
+    len = static_cast<size_t>(produced);
+    done = itemReader->isDone();
+  } else {
+    len = file.read(buf, PARSE_BUFFER_SIZE);
     if (len == 0 && file.available() > 0) {
       LOG_ERR("EHP", "File read error");
-      XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-      XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-      XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
-      file.close();
-      return false;
+      releaseParser();
+      return ParseStep::Failed;
     }
-
     done = file.available() == 0;
+  }
 
-    if (XML_ParseBuffer(parser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
-      LOG_ERR("EHP", "Parse error at line %lu:\n%s", XML_GetCurrentLineNumber(parser),
-              XML_ErrorString(XML_GetErrorCode(parser)));
-      XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-      XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-      XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
-      file.close();
-      return false;
-    }
-  } while (!done);
-  LOG_DBG("EHP", "Time to parse and build pages: %lu ms", millis() - chapterStartTime);
-
-  XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-  XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-  XML_SetCharacterDataHandler(parser, nullptr);
-  XML_ParserFree(parser);
-  file.close();
+  if (XML_ParseBuffer(xmlParser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
+    LOG_ERR("EHP", "Parse error at line %lu:\n%s", XML_GetCurrentLineNumber(xmlParser),
+            XML_ErrorString(XML_GetErrorCode(xmlParser)));
+    releaseParser();
+    return ParseStep::Failed;
+  }
+  if (!done) {
+    return ParseStep::More;
+  }
+  LOG_DBG("EHP", "Time to parse and build pages: %lu ms", millis() - parseStartTime);
+  releaseParser();
 
   // Process last page if there is still text
   if (currentTextBlock) {
     makePages();
-    completePageFn(std::move(currentPage));
-    currentPage.reset();
+    resolvePendingIds();
+    completeCurrentPage();
     currentTextBlock.reset();
   }
 
-  return true;
+  return ParseStep::Done;
+}
+
+void ChapterHtmlSlimParser::releaseParser() {
+  if (xmlParser) {
+    XML_StopParser(xmlParser, XML_FALSE);                // Stop any pending processing
+    XML_SetElementHandler(xmlParser, nullptr, nullptr);  // Clear callbacks
+    XML_SetCharacterDataHandler(xmlParser, nullptr);
+    XmlParserPool::release(xmlParser);
+    xmlParser = nullptr;
+  }
+  if (file) {
+    file.close();
+  }
 }
 
-void ChapterHtmlSlimParser::addLineToPage(std::shared_ptr<TextBlock> line) {
+void ChapterHtmlSlimParser::addLineToPage(ArenaPtr<TextBlock> line) {
   const int lineHeight = renderer.getLineHeight(fontId) * lineCompression;
+  const int16_t gap = currentPageNextY - lineEndY;
 
   if (currentPageNextY + lineHeight > viewportHeight) {
-    completePageFn(std::move(currentPage));
+    completeCurrentPage();
     currentPage.reset(new Page());
     currentPageNextY = 0;
   }
+  anchorCurrentPage();
+  const PageAnchor lineAnchor{paragraphIndex, static_cast<uint32_t>(wordsExtractedInBlock)};
+  const size_t footnotesBefore = currentPage->footnotes.size();
 
   // Track cumulative words to assign footnotes to the page containing their anchor
   wordsExtractedInBlock += line->wordCount();
@@ -1009,11 +1247,152 @@ void ChapterHtmlSlimParser::addLineToPage(std::shared_ptr<TextBlock> line) {
     ++footnoteIt;
   }
   pendingFootnotes.erase(pendingFootnotes.begin(), footnoteIt);
+  if (!placedIds.empty()) {
+    auto idIt = placedIds.begin();
+    while (idIt != placedIds.end() && idIt->second < wordsExtractedInBlock) {
+      recordIdPage(idIt->first);
+      ++idIt;
+    }
+    placedIds.erase(placedIds.begin(), idIt);
+  }
 
   // Apply horizontal left inset (margin + padding) as x position offset
   const int16_t xOffset = line->getBlockStyle().leftInset();
-  currentPage->elements.push_back(std::make_shared<PageLine>(line, xOffset, currentPageNextY));
+  currentPage->addGlyphGroups(renderer, fontId, *line, xOffset, currentPageNextY);
+  currentPage->elements.push_back(std::make_shared<PageLine>(std::move(line), xOffset, currentPageNextY));
   currentPageNextY += lineHeight;
+  lineEndY = currentPageNextY;
+  if (flow) {
+    flow->addLine(gap, lineAnchor, blockPath);
+    flow->addFootnotes(static_cast<uint8_t>(currentPage->footnotes.size() - footnotesBefore));
+  }
+}
+
+void ChapterHtmlSlimParser::anchorCurrentPage() {
+  if (currentPage && currentPage->elements.empty()) {
+    currentPage->anchor.paragraph = paragraphIndex;
+    currentPage->anchor.word = static_cast<uint32_t>(wordsExtractedInBlock);
+    currentPage->landmark = blockPath;
+  }
+}
+
+void ChapterHtmlSlimParser::enterDomElement(const char* name) {
+  if (domFrames.empty()) {
+    // Paths are relative to <body>, elements outside it aren't tracked
+    if (strcmp(name, "body") == 0) {
+      domPath.clear();
+      domChildCounts.clear();
+      domFrames.emplace_back(0, 0);
+    }
+    return;
+  }
+
+  // 1-based index among the siblings with the same tag name
+  const uint32_t nameHash = idHash(name);
+  uint16_t index = 1;
+  const auto siblingsBegin = domChildCounts.begin() + domFrames.back().second;
+  const auto it = std::find_if(siblingsBegin, domChildCounts.end(),
+                               [nameHash](const std::pair<uint32_t, uint16_t>& c) { return c.first == nameHash; });
+  if (it != domChildCounts.end()) {
+    index = ++it->second;
+  } else {
+    domChildCounts.emplace_back(nameHash, 1);
+  }
+
+  domFrames.emplace_back(domPath.size(), domChildCounts.size());
+  domPath += '/';
+  domPath += name;
+  domPath += '[';
+  domPath += std::to_string(index);
+  domPath += ']';
+}
+
+void ChapterHtmlSlimParser::leaveDomElement() {
+  if (domFrames.empty()) {
+    return;
+  }
+  domPath.resize(domFrames.back().first);
+  domChildCounts.resize(domFrames.back().second);
+  domFrames.pop_back();
+}
+
+void ChapterHtmlSlimParser::beginNoteCapture(const char* name, const XML_Char** atts, const char* id) {
+  if (noteCaptureDepth != INT_MAX) {
+    // Already inside a note: keep block boundaries as word breaks
+    if (isHeaderOrBlock(name) && !noteCaptureText.empty() && noteCaptureText.back() != ' ') {
+      noteCaptureText += ' ';
+    }
+    return;
+  }
+  if (!id) {
+    return;
+  }
+
+  const uint32_t hash = idHash(id);
+  bool isNote = std::find(noteRefIds.begin(), noteRefIds.end(), hash) != noteRefIds.end();
+  for (int i = 0; !isNote && atts[i]; i += 2) {
+    if (strcmp(atts[i], "epub:type") == 0 || strcmp(atts[i], "role") == 0) {
+      isNote = strstr(atts[i + 1], "footnote") || strstr(atts[i + 1], "endnote") || strstr(atts[i + 1], "rearnote");
+    }
+  }
+  if (isNote) {
+    noteCaptureDepth = depth;
+    noteCaptureHash = hash;
+    noteCaptureText.clear();
+    noteCaptureText.reserve(FootnoteStore::MAX_TEXT_LEN);
+  }
+}
+
+void ChapterHtmlSlimParser::appendNoteText(const char* s, const int len) {
+  for (int i = 0; i < len && noteCaptureText.size() < FootnoteStore::MAX_TEXT_LEN; i++) {
+    if (isWhitespace(s[i])) {
+      if (!noteCaptureText.empty() && noteCaptureText.back() != ' ') {
+        noteCaptureText += ' ';
+      }
+      continue;
+    }
+    noteCaptureText += s[i];
+  }
+  // Don't leave a split UTF-8 sequence at the cap
+  if (noteCaptureText.size() >= FootnoteStore::MAX_TEXT_LEN) {
+    while (!noteCaptureText.empty() && (static_cast<uint8_t>(noteCaptureText.back()) & 0xC0) == 0x80) {
+      noteCaptureText.pop_back();
+    }
+    if (!noteCaptureText.empty() && static_cast<uint8_t>(noteCaptureText.back()) >= 0xC0) {
+      noteCaptureText.pop_back();
+    }
+  }
+}
+
+void ChapterHtmlSlimParser::recordIdPage(const uint32_t idHash) {
+  if (flow) {
+    flow->addId(idHash);
+  }
+  if (idPages->size() >= MAX_ELEMENT_IDS) {
+    return;
+  }
+  idPages->push_back({idHash, completedPages});
+}
+
+void ChapterHtmlSlimParser::resolvePendingIds() {
+  if (!idPages) {
+    return;
+  }
+  for (const auto& placed : placedIds) {
+    recordIdPage(placed.first);
+  }
+  for (const uint32_t id : unplacedIds) {
+    recordIdPage(id);
+  }
+  placedIds.clear();
+  unplacedIds.clear();
+}
+
+void ChapterHtmlSlimParser::completeCurrentPage() {
+  completedPages++;
+  completePageFn(std::move(currentPage));
+  currentPage.reset();
+  arenas.pageCompleted();
 }
 
 void ChapterHtmlSlimParser::makePages() {
@@ -1045,16 +1424,20 @@ void ChapterHtmlSlimParser::makePages() {
 
   currentTextBlock->layoutAndExtractLines(
       renderer, fontId, effectiveWidth,
-      [this](const std::shared_ptr<TextBlock>& textBlock) { addLineToPage(textBlock); });
+      [this](ArenaPtr<TextBlock> textBlock) { addLineToPage(std::move(textBlock)); });
 
   // Fallback: transfer any remaining pending footnotes to current page.
   // Normally addLineToPage handles this via word-index tracking, but this catches
   // edge cases where a footnote's word index equals the exact block size.
   if (!pendingFootnotes.empty() && currentPage) {
+    const size_t footnotesBefore = currentPage->footnotes.size();
     for (const auto& [idx, fn] : pendingFootnotes) {
       currentPage->addFootnote(fn.number, fn.href);
     }
     pendingFootnotes.clear();
+    if (flow) {
+      flow->addFootnotes(static_cast<uint8_t>(currentPage->footnotes.size() - footnotesBefore));
+    }
   }
 
   // Apply bottom spacing after the paragraph (stored in pixels)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <HalStorage.h>
 #include <expat.h>
 
 #include <climits>
@@ -17,15 +18,31 @@
 class Page;
 class GfxRenderer;
 class Epub;
+class FootnoteStore;
+class SectionFlow;
+class ZipEntryReader;
 
 #define MAX_WORD_SIZE 200
 
+// Page on which an element with an id attribute starts, keyed by the FNV-1a hash of the id
+struct ElementIdPage {
+  uint32_t idHash;
+  uint16_t page;
+};
+
 class ChapterHtmlSlimParser {
   std::shared_ptr<Epub> epub;
   const std::string& filepath;
   GfxRenderer& renderer;
   std::function<void(std::unique_ptr<Page>)> completePageFn;
-  std::function<void()> popupFn;  // Popup callback
+  std::function<void()> popupFn;         // Popup callback
+  std::function<bool()> shouldAbortFn;  // Polled between parse buffers; returning true stops the build
+  ZipEntryReader* itemReader = nullptr;  // Read the chapter straight from the EPUB instead of filepath
+  // Between beginParse() and the end of the parse
+  XML_Parser xmlParser = nullptr;
+  FsFile file;
+  uint32_t parseStartTime = 0;
+  WordWidthCache* widthCache = nullptr;
   int depth = 0;
   int skipUntilDepth = INT_MAX;
   int boldUntilDepth = INT_MAX;
@@ -36,9 +53,13 @@ class ChapterHtmlSlimParser {
   char partWordBuffer[MAX_WORD_SIZE + 1] = {};
   int partWordBufferIndex = 0;
   bool nextWordContinues = false;  // true when next flushed word attaches to previous (inline element boundary)
+  // Layout scratch and TextBlock storage; declared before the text block and page so it outlives both
+  SectionBuildArenas arenas;
   std::unique_ptr<ParsedText> currentTextBlock = nullptr;
   std::unique_ptr<Page> currentPage = nullptr;
   int16_t currentPageNextY = 0;
+  // Bottom of the last line placed on the current page; what currentPageNextY is past it is block spacing
+  int16_t lineEndY = 0;
   int fontId;
   float lineCompression;
   bool extraParagraphSpacing;
@@ -46,11 +67,10 @@ class ChapterHtmlSlimParser {
   uint16_t viewportWidth;
   uint16_t viewportHeight;
   bool hyphenationEnabled;
-  const CssParser* cssParser;
+  CssParser* cssParser;
   bool embeddedStyle;
   std::string contentBase;
   std::string imageBasePath;
-  int imageCounter = 0;
 
   // Style tracking (replaces depth-based approach)
   struct StyleStackEntry {
@@ -61,6 +81,22 @@ class ChapterHtmlSlimParser {
   };
   std::vector<StyleStackEntry> inlineStyleStack;
   CssStyle currentCssStyle;
+
+  // Open elements, for the stylesheet's descendant and child selectors
+  CssAncestors cssAncestors;
+  // Stylesheet cascade results keyed by (tag, raw class attribute); the same few combinations repeat thousands of
+  // times per chapter. Allocated on first use, least recently used entry is replaced. Combinations that a
+  // descendant or child rule targets are marked contextual and resolved again each time.
+  struct ResolvedStyleEntry {
+    uint32_t key = 0;
+    uint16_t classLen = 0;
+    bool contextual = false;
+    uint32_t lastUse = 0;
+    CssStyle style;
+  };
+  static constexpr size_t RESOLVED_STYLE_CACHE_SIZE = 16;
+  std::vector<ResolvedStyleEntry> resolvedStyles;
+  uint32_t resolvedStyleClock = 0;
   bool effectiveBold = false;
   bool effectiveItalic = false;
   bool effectiveUnderline = false;
@@ -76,11 +112,53 @@ class ChapterHtmlSlimParser {
   char currentFootnoteLinkHref[64] = {};
   std::vector<std::pair<int, FootnoteEntry>> pendingFootnotes;  // <wordIndex, entry>
   int wordsExtractedInBlock = 0;
+  // Text blocks started so far, the paragraph part of each page's PageAnchor
+  uint32_t paragraphIndex = 0;
+  uint16_t completedPages = 0;
+
+  // Element ids: seen but not yet followed by a word, then waiting for the line holding their word to be placed
+  std::vector<ElementIdPage>* idPages = nullptr;
+  std::vector<uint32_t> unplacedIds;
+  std::vector<std::pair<uint32_t, int>> placedIds;  // <idHash, word index in the current block>
 
+  // Position in the DOM below <body> as xpointer segments ("/div[1]/p[3]"), for the per-page landmarks KOReader
+  // sync maps positions with. Each open element has a frame: where its segment starts in domPath and where the
+  // per-tag counts of its children start in domChildCounts.
+  std::string domPath;
+  std::vector<std::pair<uint32_t, uint32_t>> domFrames;         // <domPath length, domChildCounts start>
+  std::vector<std::pair<uint32_t, uint16_t>> domChildCounts;    // <tag name hash, children seen>
+  std::string blockPath;  // domPath of the element that started the current text block
+
+  // Footnote preview capture: plain text of the note element currently open, if any
+  FootnoteStore* footnoteStore = nullptr;
+  SectionFlow* flow = nullptr;
+  int noteCaptureDepth = INT_MAX;
+  uint32_t noteCaptureHash = 0;
+  std::string noteCaptureText;
+  std::vector<uint32_t> noteRefIds;  // #ids this chapter's footnote references point at
+  static constexpr size_t MAX_NOTE_REFS = 256;
+
+  CssStyle resolveCssStyle(const char* tagName, const std::string& classAttr);
+  // Merge the stylesheet of a <link rel="stylesheet"> into the active CSS rules
+  void linkStylesheet(const XML_Char** atts);
   void updateEffectiveInlineStyle();
   void startNewTextBlock(const BlockStyle& blockStyle);
   void flushPartWordBuffer();
   void makePages();
+  // Hand the current page to completePageFn and recycle the line storage of the one before it
+  void completeCurrentPage();
+  // Record where the current page starts if nothing has been placed on it yet
+  void anchorCurrentPage();
+  void recordIdPage(uint32_t idHash);
+  void enterDomElement(const char* name);
+  void leaveDomElement();
+  // Start capturing the text of an element with an id if it is a footnote target
+  void beginNoteCapture(const char* name, const XML_Char** atts, const char* id);
+  void appendNoteText(const char* s, int len);
+  // Pin ids still waiting for content to the current page (before an image, or at the end of the chapter)
+  void resolvePendingIds();
+  // Give the XML parser back to the pool and close the chapter file
+  void releaseParser();
   // XML callbacks
   static void XMLCALL startElement(void* userData, const XML_Char* name, const XML_Char** atts);
   static void XMLCALL characterData(void* userData, const XML_Char* s, int len);
@@ -95,7 +173,8 @@ class ChapterHtmlSlimParser {
                                  const std::function<void(std::unique_ptr<Page>)>& completePageFn,
                                  const bool embeddedStyle, const std::string& contentBase,
                                  const std::string& imageBasePath, const std::function<void()>& popupFn = nullptr,
-                                 const CssParser* cssParser = nullptr)
+                                 CssParser* cssParser = nullptr,
+                                 const std::function<bool()>& shouldAbortFn = nullptr)
 
       : epub(epub),
         filepath(filepath),
@@ -109,12 +188,41 @@ class ChapterHtmlSlimParser {
         hyphenationEnabled(hyphenationEnabled),
         completePageFn(completePageFn),
         popupFn(popupFn),
+        shouldAbortFn(shouldAbortFn),
         cssParser(cssParser),
         embeddedStyle(embeddedStyle),
         contentBase(contentBase),
         imageBasePath(imageBasePath) {}
 
-  ~ChapterHtmlSlimParser() = default;
+  ~ChapterHtmlSlimParser() { releaseParser(); }
+  // Parse from an already opened entry reader rather than the file at filepath
+  void setItemReader(ZipEntryReader* reader) { itemReader = reader; }
+  // Reuse word widths measured by earlier builds of this book
+  void setWordWidthCache(WordWidthCache* cache) { widthCache = cache; }
+  // Collect the page of every element id (capped at MAX_ELEMENT_IDS), for jumps to #fragment targets
+  void setIdPages(std::vector<ElementIdPage>* table) { idPages = table; }
+  static constexpr size_t MAX_ELEMENT_IDS = 1024;
+  // Store the text of footnote targets (epub:type/role footnote or endnote, or referenced from this chapter)
+  void setFootnoteStore(FootnoteStore* store) { footnoteStore = store; }
+  // Record the spacing, anchor and footnotes of every line placed, see SectionFlow
+  void setFlow(SectionFlow* lineFlow) { flow = lineFlow; }
+  // FNV-1a hash used for the id table
+  static uint32_t idHash(const char* id) {
+    uint32_t hash = 2166136261u;
+    for (; *id; id++) {
+      hash ^= static_cast<uint8_t>(*id);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
   bool parseAndBuildPages();
-  void addLineToPage(std::shared_ptr<TextBlock> line);
+
+  // parseAndBuildPages() in steps, for a build that pauses between parse buffers: beginParse(), then parseNext()
+  // until it returns Done or Failed. Destroying the parser in between drops the parse.
+  enum class ParseStep : uint8_t { More, Done, Failed };
+  bool beginParse();
+  // Parse one buffer of the chapter; Done once the last page has been handed to completePageFn
+  ParseStep parseNext();
+
+  void addLineToPage(ArenaPtr<TextBlock> line);
 };
@@ -0,0 +1,233 @@
+#include "ChapterTextSearcher.h"
+
+#include <Logging.h>
+#include <ZipFile.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "../htmlEntities.h"
+#include "XmlParserPool.h"
+
+namespace {
+const char* SKIPPED_TAGS[] = {"head", "script", "style"};
+// Elements that separate words even without whitespace in the markup (<p>a</p><p>b</p>)
+const char* BREAKING_TAGS[] = {"p", "div", "br", "li", "blockquote", "h1", "h2", "h3",
+                               "h4", "h5", "h6", "td", "th", "tr", "img"};
+
+template <size_t N>
+bool isOneOf(const char* name, const char* (&tags)[N]) {
+  for (const char* tag : tags) {
+    if (strcmp(name, tag) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isSpace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
+
+char foldCase(const char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+bool isContinuationByte(const char c) { return (static_cast<uint8_t>(c) & 0xC0) == 0x80; }
+
+// Drop a UTF-8 sequence cut off at the end of the snippet
+void trimPartialCodepoint(char* text, size_t& len) {
+  size_t start = len;
+  while (start > 0 && isContinuationByte(text[start - 1])) {
+    start--;
+  }
+  if (start == 0) {
+    return;
+  }
+  const auto lead = static_cast<uint8_t>(text[start - 1]);
+  const size_t expected = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+  if (len - (start - 1) < expected) {
+    len = start - 1;
+  }
+  text[len] = '\0';
+}
+}  // namespace
+
+ChapterTextSearcher::ChapterTextSearcher(const std::string& query) {
+  // Normalise the query the same way as the text: trimmed, single spaces, ASCII lower case
+  bool space = true;
+  for (const char c : query) {
+    if (queryLen == MAX_QUERY_LENGTH) {
+      break;
+    }
+    if (isSpace(c)) {
+      if (!space) {
+        this->query[queryLen++] = ' ';
+      }
+      space = true;
+    } else {
+      this->query[queryLen++] = foldCase(c);
+      space = false;
+    }
+  }
+  while (queryLen > 0 && this->query[queryLen - 1] == ' ') {
+    queryLen--;
+  }
+}
+
+void ChapterTextSearcher::flushPending() {
+  if (!hasPending) {
+    return;
+  }
+  trimPartialCodepoint(pendingHit.snippet, pendingLen);
+  (*onHitFn)(pendingHit);
+  hasPending = false;
+}
+
+void ChapterTextSearcher::appendChar(char c) {
+  if (isSpace(c)) {
+    if (lastWasSpace) {
+      return;
+    }
+    c = ' ';
+    lastWasSpace = true;
+  } else {
+    lastWasSpace = false;
+  }
+
+  history[textLength % HISTORY_SIZE] = c;
+  textLength++;
+
+  if (hasPending) {
+    pendingHit.snippet[pendingLen++] = c;
+    if (pendingLen == SNIPPET_SIZE - 1) {
+      flushPending();
+    }
+  }
+
+  if (textLength < queryLen || foldCase(c) != query[queryLen - 1]) {
+    return;
+  }
+  const uint32_t matchStart = textLength - queryLen;
+  for (size_t i = 0; i + 1 < queryLen; i++) {
+    if (foldCase(history[(matchStart + i) % HISTORY_SIZE]) != query[i]) {
+      return;
+    }
+  }
+
+  // A new match ends the trailing context of the previous one
+  flushPending();
+  const uint32_t leadIn = std::min<uint32_t>(matchStart, SNIPPET_CONTEXT_BEFORE);
+  uint32_t snippetStart = matchStart - leadIn;
+  // Don't start the snippet in the middle of a UTF-8 sequence
+  while (snippetStart < matchStart && isContinuationByte(history[snippetStart % HISTORY_SIZE])) {
+    snippetStart++;
+  }
+  pendingHit.textOffset = matchStart;
+  pendingLen = 0;
+  for (uint32_t i = snippetStart; i < textLength; i++) {
+    pendingHit.snippet[pendingLen++] = history[i % HISTORY_SIZE];
+  }
+  hasPending = true;
+}
+
+void XMLCALL ChapterTextSearcher::startElement(void* userData, const XML_Char* name, const XML_Char**) {
+  auto* self = static_cast<ChapterTextSearcher*>(userData);
+  if (self->skipUntilDepth == INT32_MAX && isOneOf(name, SKIPPED_TAGS)) {
+    self->skipUntilDepth = self->depth;
+  }
+  self->depth++;
+  if (self->skipUntilDepth == INT32_MAX && isOneOf(name, BREAKING_TAGS)) {
+    self->appendChar(' ');
+  }
+}
+
+void XMLCALL ChapterTextSearcher::endElement(void* userData, const XML_Char* name) {
+  auto* self = static_cast<ChapterTextSearcher*>(userData);
+  self->depth--;
+  if (self->skipUntilDepth == self->depth) {
+    self->skipUntilDepth = INT32_MAX;
+  } else if (self->skipUntilDepth == INT32_MAX && isOneOf(name, BREAKING_TAGS)) {
+    self->appendChar(' ');
+  }
+}
+
+void XMLCALL ChapterTextSearcher::characterData(void* userData, const XML_Char* s, const int len) {
+  auto* self = static_cast<ChapterTextSearcher*>(userData);
+  if (self->skipUntilDepth < self->depth) {
+    return;
+  }
+  for (int i = 0; i < len; i++) {
+    self->appendChar(s[i]);
+  }
+}
+
+void XMLCALL ChapterTextSearcher::defaultHandlerExpand(void* userData, const XML_Char* s, const int len) {
+  if (len >= 3 && s[0] == '&' && s[len - 1] == ';') {
+    const char* utf8Value = lookupHtmlEntity(s, static_cast<size_t>(len));
+    characterData(userData, utf8Value ? utf8Value : s, utf8Value ? static_cast<int>(strlen(utf8Value)) : len);
+  }
+}
+
+bool ChapterTextSearcher::search(ZipEntryReader& reader, const std::function<void(const Hit&)>& onHit,
+                                 const std::function<bool()>& shouldAbortFn) {
+  textLength = 0;
+  lastWasSpace = true;
+  depth = 0;
+  skipUntilDepth = INT32_MAX;
+  hasPending = false;
+  onHitFn = &onHit;
+
+  if (queryLen == 0) {
+    return true;
+  }
+
+  const XML_Parser parser = XmlParserPool::acquire();
+  if (!parser) {
+    LOG_ERR("SRC", "Couldn't allocate memory for parser");
+    return false;
+  }
+  XML_SetUserData(parser, this);
+  XML_SetDefaultHandlerExpand(parser, defaultHandlerExpand);
+  XML_SetElementHandler(parser, startElement, endElement);
+  XML_SetCharacterDataHandler(parser, characterData);
+
+  bool ok = true;
+  int done = 0;
+  do {
+    if (shouldAbortFn && shouldAbortFn()) {
+      ok = false;
+      break;
+    }
+
+    void* const buf = XML_GetBuffer(parser, PARSE_BUFFER_SIZE);
+    if (!buf) {
+      LOG_ERR("SRC", "Couldn't allocate memory for buffer");
+      ok = false;
+      break;
+    }
+
+    const int produced = reader.read(static_cast<uint8_t*>(buf), PARSE_BUFFER_SIZE);
+    if (produced < 0) {
+      LOG_ERR("SRC", "Item read error");
+      ok = false;
+      break;
+    }
+    done = reader.isDone();
+
+    if (XML_ParseBuffer(parser, produced, done) == XML_STATUS_ERROR) {
+      LOG_ERR("SRC", "Parse error at line %lu: %s", XML_GetCurrentLineNumber(parser),
+              XML_ErrorString(XML_GetErrorCode(parser)));
+      ok = false;
+      break;
+    }
+  } while (!done);
+
+  XML_StopParser(parser, XML_FALSE);
+  XML_SetElementHandler(parser, nullptr, nullptr);
+  XML_SetCharacterDataHandler(parser, nullptr);
+  XmlParserPool::release(parser);
+
+  if (ok) {
+    flushPending();
+  }
+  hasPending = false;
+  onHitFn = nullptr;
+  return ok;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <expat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class ZipEntryReader;
+
+// Streams one spine item through expat and reports every occurrence of a query in its text, without doing any
+// layout. Whitespace runs count as a single space and matching ignores ASCII case. Text inside <head>, <script>
+// and <style> is skipped, like the chapter parser does.
+class ChapterTextSearcher {
+ public:
+  static constexpr size_t MAX_QUERY_LENGTH = 32;
+  static constexpr size_t SNIPPET_SIZE = 64;
+  static constexpr size_t SNIPPET_CONTEXT_BEFORE = 20;
+
+  struct Hit {
+    uint32_t textOffset;  // Offset of the match within the chapter text, as counted by getTextLength()
+    char snippet[SNIPPET_SIZE];
+  };
+
+  explicit ChapterTextSearcher(const std::string& query);
+
+  // Returns false on a read or parse error, or when shouldAbortFn asked to stop
+  bool search(ZipEntryReader& reader, const std::function<void(const Hit&)>& onHit,
+              const std::function<bool()>& shouldAbortFn = nullptr);
+
+  // Length of the (whitespace collapsed) chapter text seen by the last search()
+  uint32_t getTextLength() const { return textLength; }
+  bool isValid() const { return queryLen > 0; }
+
+ private:
+  static constexpr size_t PARSE_BUFFER_SIZE = 1024;
+  // Recent text, long enough for the query plus the snippet lead-in
+  static constexpr size_t HISTORY_SIZE = 64;
+  static_assert(HISTORY_SIZE >= MAX_QUERY_LENGTH + SNIPPET_CONTEXT_BEFORE, "History must hold a snippet lead-in");
+
+  char query[MAX_QUERY_LENGTH] = {};
+  size_t queryLen = 0;
+
+  char history[HISTORY_SIZE] = {};
+  uint32_t textLength = 0;
+  bool lastWasSpace = true;
+  int depth = 0;
+  int skipUntilDepth = INT32_MAX;
+
+  // Match waiting for its trailing context
+  Hit pendingHit = {};
+  size_t pendingLen = 0;
+  bool hasPending = false;
+
+  const std::function<void(const Hit&)>* onHitFn = nullptr;
+
+  void appendChar(char c);
+  void flushPending();
+
+  static void XMLCALL startElement(void* userData, const XML_Char* name, const XML_Char** atts);
+  static void XMLCALL endElement(void* userData, const XML_Char* name);
+  static void XMLCALL characterData(void* userData, const XML_Char* s, int len);
+  static void XMLCALL defaultHandlerExpand(void* userData, const XML_Char* s, int len);
+};
@@ -2,8 +2,10 @@
 
 #include <Logging.h>
 
+#include "XmlParserPool.h"
+
 bool ContainerParser::setup() {
-  parser = XML_ParserCreate(nullptr);
+  parser = XmlParserPool::acquire();
   if (!parser) {
     LOG_ERR("CTR", "Couldn't allocate memory for parser");
     return false;
@@ -18,7 +20,7 @@ ContainerParser::~ContainerParser() {
   if (parser) {
     XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
     XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-    XML_ParserFree(parser);
+    XmlParserPool::release(parser);
     parser = nullptr;
   }
 }
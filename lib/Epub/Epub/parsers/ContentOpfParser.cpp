@@ -4,16 +4,28 @@
 #include <Logging.h>
 #include <Serialization.h>
 
+#include <strings.h>
+
 #include "../BookMetadataCache.h"
+#include "XmlParserPool.h"
 
 namespace {
 constexpr char MEDIA_TYPE_NCX[] = "application/x-dtbncx+xml";
 constexpr char MEDIA_TYPE_CSS[] = "text/css";
 constexpr char itemCacheFile[] = "/.items.bin";
+constexpr char itemIndexRunsFile[] = "/.itemidx.runs";
+constexpr char itemIndexFileName[] = "/.itemidx.bin";
+constexpr uint32_t MIN_INDEX_FENCE_STRIDE = 32;
+
+void removeIfExists(const std::string& path) {
+  if (Storage.exists(path.c_str())) {
+    Storage.remove(path.c_str());
+  }
+}
 }  // namespace
 
 bool ContentOpfParser::setup() {
-  parser = XML_ParserCreate(nullptr);
+  parser = XmlParserPool::acquire();
   if (!parser) {
     LOG_DBG("COF", "Couldn't allocate memory for parser");
     return false;
@@ -30,18 +42,217 @@ ContentOpfParser::~ContentOpfParser() {
     XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
     XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
     XML_SetCharacterDataHandler(parser, nullptr);
-    XML_ParserFree(parser);
+    XmlParserPool::release(parser);
     parser = nullptr;
   }
   if (tempItemStore) {
     tempItemStore.close();
   }
-  if (Storage.exists((cachePath + itemCacheFile).c_str())) {
-    Storage.remove((cachePath + itemCacheFile).c_str());
+  if (itemIndexRuns) {
+    itemIndexRuns.close();
+  }
+  if (itemIndexFile) {
+    itemIndexFile.close();
   }
+  removeIfExists(cachePath + itemCacheFile);
+  removeIfExists(cachePath + itemIndexRunsFile);
+  removeIfExists(cachePath + itemIndexFileName);
   itemIndex.clear();
   itemIndex.shrink_to_fit();
+  indexFences.clear();
+  indexFences.shrink_to_fit();
   useItemIndex = false;
+  useItemIndexFile = false;
+}
+
+void ContentOpfParser::addItemIndexEntry(const ItemIndexEntry& entry) {
+  if (itemIndexFailed) {
+    return;
+  }
+  itemIndex.push_back(entry);
+  if (itemIndex.size() >= ITEM_INDEX_RUN_SIZE && !spillItemIndexRun()) {
+    LOG_ERR("COF", "Couldn't spill the manifest index, falling back to scanning the manifest");
+    itemIndexFailed = true;
+    itemIndex.clear();
+    itemIndex.shrink_to_fit();
+  }
+}
+
+bool ContentOpfParser::spillItemIndexRun() {
+  if (itemIndex.empty()) {
+    return true;
+  }
+  if (!itemIndexRuns && !Storage.openFileForWrite("COF", cachePath + itemIndexRunsFile, itemIndexRuns)) {
+    return false;
+  }
+  // Stable, so entries of equal key stay in manifest order and the first item of a duplicated id wins, as in a scan
+  std::stable_sort(itemIndex.begin(), itemIndex.end(), indexLess);
+  const size_t bytes = itemIndex.size() * sizeof(ItemIndexEntry);
+  const bool ok = itemIndexRuns.write(itemIndex.data(), bytes) == bytes;
+  spilledItems += itemIndex.size();
+  itemIndex.clear();
+  return ok;
+}
+
+bool ContentOpfParser::mergeItemIndexRuns() {
+  itemIndexRuns.close();
+  FsFile runs;
+  if (!Storage.openFileForRead("COF", cachePath + itemIndexRunsFile, runs) ||
+      !Storage.openFileForWrite("COF", cachePath + itemIndexFileName, itemIndexFile)) {
+    return false;
+  }
+
+  // Every run is ITEM_INDEX_RUN_SIZE entries but the last. Each gets an equal share of one run's worth of RAM as its
+  // read buffer, in itemIndex.
+  struct Run {
+    uint32_t next;
+    uint32_t end;
+    uint16_t bufPos;
+    uint16_t bufLen;
+  };
+  const uint32_t runCount = (spilledItems + ITEM_INDEX_RUN_SIZE - 1) / ITEM_INDEX_RUN_SIZE;
+  const uint32_t perRun = std::max<uint32_t>(1, ITEM_INDEX_RUN_SIZE / runCount);
+  std::vector<Run> heads(runCount);
+  for (uint32_t i = 0; i < runCount; i++) {
+    heads[i] = {i * ITEM_INDEX_RUN_SIZE, std::min<uint32_t>((i + 1) * ITEM_INDEX_RUN_SIZE, spilledItems), 0, 0};
+  }
+  itemIndex.assign(runCount * perRun, ItemIndexEntry{});
+
+  indexFenceStride = std::max(MIN_INDEX_FENCE_STRIDE, (spilledItems + MAX_INDEX_FENCES - 1) / MAX_INDEX_FENCES);
+  indexFences.clear();
+  indexFences.reserve((spilledItems + indexFenceStride - 1) / indexFenceStride);
+  // Output goes out a fence block at a time; the first entry of each block is its fence
+  std::vector<ItemIndexEntry> block;
+  block.reserve(indexFenceStride);
+
+  auto refill = [&](const uint32_t i) {
+    Run& run = heads[i];
+    run.bufPos = 0;
+    run.bufLen = static_cast<uint16_t>(std::min(perRun, run.end - run.next));
+    if (run.bufLen == 0) {
+      return true;
+    }
+    const size_t bytes = run.bufLen * sizeof(ItemIndexEntry);
+    if (!runs.seek(run.next * sizeof(ItemIndexEntry)) ||
+        runs.read(&itemIndex[i * perRun], bytes) != static_cast<int>(bytes)) {
+      return false;
+    }
+    run.next += run.bufLen;
+    return true;
+  };
+  auto flushBlock = [&] {
+    if (block.empty()) {
+      return true;
+    }
+    indexFences.push_back(block.front());
+    const size_t bytes = block.size() * sizeof(ItemIndexEntry);
+    const bool ok = itemIndexFile.write(block.data(), bytes) == bytes;
+    block.clear();
+    return ok;
+  };
+
+  bool ok = true;
+  while (ok) {
+    // Smallest head; ties go to the earlier run, which keeps manifest order across runs
+    int best = -1;
+    for (uint32_t i = 0; i < runCount && ok; i++) {
+      Run& run = heads[i];
+      if (run.bufPos == run.bufLen) {
+        ok = refill(i);
+      }
+      if (run.bufLen == 0) {
+        continue;
+      }
+      if (best < 0 ||
+          indexLess(itemIndex[i * perRun + run.bufPos], itemIndex[best * perRun + heads[best].bufPos])) {
+        best = static_cast<int>(i);
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    block.push_back(itemIndex[best * perRun + heads[best].bufPos++]);
+    if (block.size() == indexFenceStride) {
+      ok = flushBlock();
+    }
+  }
+  ok = ok && flushBlock();
+
+  runs.close();
+  itemIndexFile.close();
+  removeIfExists(cachePath + itemIndexRunsFile);
+  itemIndex.clear();
+  itemIndex.shrink_to_fit();
+  if (!ok || !Storage.openFileForRead("COF", cachePath + itemIndexFileName, itemIndexFile)) {
+    indexFences.clear();
+    indexFences.shrink_to_fit();
+    return false;
+  }
+  // From here on itemIndex holds the fence block being searched
+  itemIndex.resize(indexFenceStride);
+  return true;
+}
+
+bool ContentOpfParser::readItemAt(const uint32_t offset, const std::string& idref, std::string& href) {
+  tempItemStore.seek(offset);
+  std::string itemId;
+  serialization::readString(tempItemStore, itemId);
+  if (itemId != idref) {
+    return false;
+  }
+  serialization::readString(tempItemStore, href);
+  return true;
+}
+
+bool ContentOpfParser::findItemHref(const std::string& idref, std::string& href) {
+  const ItemIndexEntry target{fnvHash(idref), static_cast<uint16_t>(idref.size()), 0};
+
+  if (useItemIndexFile) {
+    // Entries equal to the target can start in the block before the first fence that isn't less than it
+    const auto fence = std::lower_bound(indexFences.begin(), indexFences.end(), target, indexLess);
+    size_t blockIndex = fence == indexFences.begin() ? 0 : fence - indexFences.begin() - 1;
+    for (; blockIndex < indexFences.size(); blockIndex++) {
+      const uint32_t first = blockIndex * indexFenceStride;
+      const uint32_t count = std::min(indexFenceStride, spilledItems - first);
+      const size_t bytes = count * sizeof(ItemIndexEntry);
+      if (!itemIndexFile.seek(first * sizeof(ItemIndexEntry)) ||
+          itemIndexFile.read(itemIndex.data(), bytes) != static_cast<int>(bytes)) {
+        return false;
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        if (indexLess(target, itemIndex[i])) {
+          return false;
+        }
+        if (!indexLess(itemIndex[i], target) && readItemAt(itemIndex[i].fileOffset, idref, href)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  if (useItemIndex) {
+    // Binary search; check every entry of the key, the hash may collide
+    for (auto it = std::lower_bound(itemIndex.begin(), itemIndex.end(), target, indexLess);
+         it != itemIndex.end() && !indexLess(target, *it); ++it) {
+      if (readItemAt(it->fileOffset, idref, href)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Linear scan (for small manifests, keeps original behavior)
+  tempItemStore.seek(0);
+  std::string itemId;
+  while (tempItemStore.available()) {
+    serialization::readString(tempItemStore, itemId);
+    serialization::readString(tempItemStore, href);
+    if (itemId == idref) {
+      return true;
+    }
+  }
+  return false;
 }
 
 size_t ContentOpfParser::write(const uint8_t data) { return write(&data, 1); }
@@ -60,7 +271,7 @@ size_t ContentOpfParser::write(const uint8_t* buffer, const size_t size) {
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
+      XmlParserPool::release(parser);
       parser = nullptr;
       return 0;
     }
@@ -74,7 +285,7 @@ size_t ContentOpfParser::write(const uint8_t* buffer, const size_t size) {
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
+      XmlParserPool::release(parser);
       parser = nullptr;
       return 0;
     }
@@ -119,6 +330,20 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
     return;
   }
 
+  if (self->state == IN_METADATA && strcmp(name, "dc:identifier") == 0 && self->uuid.empty()) {
+    // Calibre writes <dc:identifier opf:scheme="uuid" id="uuid_id">; other tools use a urn:uuid: value
+    self->identifierText.clear();
+    self->identifierIsUuid = false;
+    for (int i = 0; atts[i]; i += 2) {
+      if ((strcmp(atts[i], "opf:scheme") == 0 && strcasecmp(atts[i + 1], "uuid") == 0) ||
+          (strcmp(atts[i], "id") == 0 && strcmp(atts[i + 1], "uuid_id") == 0)) {
+        self->identifierIsUuid = true;
+      }
+    }
+    self->state = IN_BOOK_IDENTIFIER;
+    return;
+  }
+
   if (self->state == IN_PACKAGE && (strcmp(name, "manifest") == 0 || strcmp(name, "opf:manifest") == 0)) {
     self->state = IN_MANIFEST;
     if (!Storage.openFileForWrite("COF", self->cachePath + itemCacheFile, self->tempItemStore)) {
@@ -133,11 +358,19 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
       LOG_ERR("COF", "Couldn't open temp items file for reading. This is probably going to be a fatal error.");
     }
 
-    // Sort item index for binary search if we have enough items
-    if (self->itemIndex.size() >= LARGE_SPINE_THRESHOLD) {
-      std::sort(self->itemIndex.begin(), self->itemIndex.end(), [](const ItemIndexEntry& a, const ItemIndexEntry& b) {
-        return a.idHash < b.idHash || (a.idHash == b.idHash && a.idLen < b.idLen);
-      });
+    if (self->spilledItems > 0 && !self->itemIndexFailed) {
+      // The manifest outgrew RAM: the remaining entries become the last run, then all runs become one sorted file
+      if (self->spillItemIndexRun() && self->mergeItemIndexRuns()) {
+        self->useItemIndexFile = true;
+        LOG_DBG("COF", "Using on-card index for %u manifest items", static_cast<unsigned>(self->spilledItems));
+      } else {
+        LOG_ERR("COF", "Couldn't build the manifest index, falling back to scanning the manifest");
+        self->itemIndex.clear();
+        self->itemIndex.shrink_to_fit();
+      }
+    } else if (self->itemIndex.size() >= LARGE_SPINE_THRESHOLD) {
+      // Sort item index for binary search if we have enough items
+      std::stable_sort(self->itemIndex.begin(), self->itemIndex.end(), indexLess);
       self->useItemIndex = true;
       LOG_DBG("COF", "Using fast index for %zu manifest items", self->itemIndex.size());
     }
@@ -156,18 +389,23 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
 
   if (self->state == IN_METADATA && (strcmp(name, "meta") == 0 || strcmp(name, "opf:meta") == 0)) {
     bool isCover = false;
-    std::string coverItemId;
+    bool isSeries = false;
+    std::string content;
 
     for (int i = 0; atts[i]; i += 2) {
       if (strcmp(atts[i], "name") == 0 && strcmp(atts[i + 1], "cover") == 0) {
         isCover = true;
+      } else if (strcmp(atts[i], "name") == 0 && strcmp(atts[i + 1], "calibre:series") == 0) {
+        isSeries = true;
       } else if (strcmp(atts[i], "content") == 0) {
-        coverItemId = atts[i + 1];
+        content = atts[i + 1];
       }
     }
 
     if (isCover) {
-      self->coverItemId = coverItemId;
+      self->coverItemId = content;
+    } else if (isSeries) {
+      self->series = content;
     }
     return;
   }
@@ -196,7 +434,7 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
       entry.idHash = fnvHash(itemId);
       entry.idLen = static_cast<uint16_t>(itemId.size());
       entry.fileOffset = static_cast<uint32_t>(self->tempItemStore.position());
-      self->itemIndex.push_back(entry);
+      self->addItemIndexEntry(entry);
     }
 
     // Write items down to SD card
@@ -247,46 +485,7 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
         if (strcmp(atts[i], "idref") == 0) {
           const std::string idref = atts[i + 1];
           std::string href;
-          bool found = false;
-
-          if (self->useItemIndex) {
-            // Fast path: binary search
-            uint32_t targetHash = fnvHash(idref);
-            uint16_t targetLen = static_cast<uint16_t>(idref.size());
-
-            auto it = std::lower_bound(self->itemIndex.begin(), self->itemIndex.end(),
-                                       ItemIndexEntry{targetHash, targetLen, 0},
-                                       [](const ItemIndexEntry& a, const ItemIndexEntry& b) {
-                                         return a.idHash < b.idHash || (a.idHash == b.idHash && a.idLen < b.idLen);
-                                       });
-
-            // Check for match (may need to check a few due to hash collisions)
-            while (it != self->itemIndex.end() && it->idHash == targetHash) {
-              self->tempItemStore.seek(it->fileOffset);
-              std::string itemId;
-              serialization::readString(self->tempItemStore, itemId);
-              if (itemId == idref) {
-                serialization::readString(self->tempItemStore, href);
-                found = true;
-                break;
-              }
-              ++it;
-            }
-          } else {
-            // Slow path: linear scan (for small manifests, keeps original behavior)
-            // TODO: This lookup is slow as need to scan through all items each time.
-            //       It can take up to 200ms per item when getting to 1500 items.
-            self->tempItemStore.seek(0);
-            std::string itemId;
-            while (self->tempItemStore.available()) {
-              serialization::readString(self->tempItemStore, itemId);
-              serialization::readString(self->tempItemStore, href);
-              if (itemId == idref) {
-                found = true;
-                break;
-              }
-            }
-          }
+          const bool found = self->findItemHref(idref, href);
 
           if (found && self->cache) {
             self->cache->createSpineEntry(href);
@@ -340,6 +539,11 @@ void XMLCALL ContentOpfParser::characterData(void* userData, const XML_Char* s,
     self->language.append(s, len);
     return;
   }
+
+  if (self->state == IN_BOOK_IDENTIFIER) {
+    self->identifierText.append(s, len);
+    return;
+  }
 }
 
 void XMLCALL ContentOpfParser::endElement(void* userData, const XML_Char* name) {
@@ -379,6 +583,19 @@ void XMLCALL ContentOpfParser::endElement(void* userData, const XML_Char* name)
     return;
   }
 
+  if (self->state == IN_BOOK_IDENTIFIER && strcmp(name, "dc:identifier") == 0) {
+    constexpr char URN_PREFIX[] = "urn:uuid:";
+    constexpr size_t URN_PREFIX_LENGTH = sizeof(URN_PREFIX) - 1;
+    if (strncasecmp(self->identifierText.c_str(), URN_PREFIX, URN_PREFIX_LENGTH) == 0) {
+      self->uuid = self->identifierText.substr(URN_PREFIX_LENGTH);
+    } else if (self->identifierIsUuid) {
+      self->uuid = self->identifierText;
+    }
+    self->identifierText.clear();
+    self->state = IN_METADATA;
+    return;
+  }
+
   if (self->state == IN_METADATA && (strcmp(name, "metadata") == 0 || strcmp(name, "opf:metadata") == 0)) {
     self->state = IN_PACKAGE;
     return;
@@ -17,6 +17,7 @@ class ContentOpfParser final : public Print {
     IN_BOOK_TITLE,
     IN_BOOK_AUTHOR,
     IN_BOOK_LANGUAGE,
+    IN_BOOK_IDENTIFIER,
     IN_MANIFEST,
     IN_SPINE,
     IN_GUIDE,
@@ -30,6 +31,8 @@ class ContentOpfParser final : public Print {
   BookMetadataCache* cache;
   FsFile tempItemStore;
   std::string coverItemId;
+  std::string identifierText;
+  bool identifierIsUuid = false;
 
   // Index for fast idref→href lookup (used only for large EPUBs)
   struct ItemIndexEntry {
@@ -39,8 +42,31 @@ class ContentOpfParser final : public Print {
   };
   std::vector<ItemIndexEntry> itemIndex;
   bool useItemIndex = false;
+  // Manifests too big for itemIndex spill it to the card as sorted runs of ITEM_INDEX_RUN_SIZE entries. The runs are
+  // merged into one sorted file before the spine, which is then searched through every indexFenceStride-th key kept in
+  // RAM (indexFences), so memory stays bounded whatever the manifest size.
+  FsFile itemIndexRuns;
+  FsFile itemIndexFile;
+  uint32_t spilledItems = 0;
+  uint32_t indexFenceStride = 0;
+  std::vector<ItemIndexEntry> indexFences;
+  bool useItemIndexFile = false;
+  bool itemIndexFailed = false;  // Spilling failed; the spine falls back to scanning .items.bin
 
   static constexpr uint16_t LARGE_SPINE_THRESHOLD = 400;
+  static constexpr uint16_t ITEM_INDEX_RUN_SIZE = 1024;
+  static constexpr uint16_t MAX_INDEX_FENCES = 1024;
+
+  static bool indexLess(const ItemIndexEntry& a, const ItemIndexEntry& b) {
+    return a.idHash < b.idHash || (a.idHash == b.idHash && a.idLen < b.idLen);
+  }
+  void addItemIndexEntry(const ItemIndexEntry& entry);
+  bool spillItemIndexRun();
+  bool mergeItemIndexRuns();
+  // Href of the manifest item with the given id, read back from .items.bin through whichever index is in use
+  bool findItemHref(const std::string& idref, std::string& href);
+  // True and href filled in if the item at offset in .items.bin has the given id
+  bool readItemAt(uint32_t offset, const std::string& idref, std::string& href);
 
   // FNV-1a hash function
   static uint32_t fnvHash(const std::string& s) {
@@ -60,6 +86,9 @@ class ContentOpfParser final : public Print {
   std::string title;
   std::string author;
   std::string language;
+  // Calibre's book uuid (or any urn:uuid identifier), without the urn prefix
+  std::string uuid;
+  std::string series;  // Calibre's series, when the book has one
   std::string tocNcxPath;
   std::string tocNavPath;  // EPUB 3 nav document path
   std::string coverItemHref;
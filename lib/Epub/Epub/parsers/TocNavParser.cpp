@@ -4,9 +4,10 @@
 #include <Logging.h>
 
 #include "../BookMetadataCache.h"
+#include "XmlParserPool.h"
 
 bool TocNavParser::setup() {
-  parser = XML_ParserCreate(nullptr);
+  parser = XmlParserPool::acquire();
   if (!parser) {
     LOG_DBG("NAV", "Couldn't allocate memory for parser");
     return false;
@@ -15,6 +16,8 @@ bool TocNavParser::setup() {
   XML_SetUserData(parser, this);
   XML_SetElementHandler(parser, startElement, endElement);
   XML_SetCharacterDataHandler(parser, characterData);
+  // Titles are capped, so this is the only allocation the label needs however many entries the TOC has
+  currentLabel.reserve(BookMetadataCache::MAX_TOC_TITLE_BYTES);
   return true;
 }
 
@@ -23,7 +26,7 @@ TocNavParser::~TocNavParser() {
     XML_StopParser(parser, XML_FALSE);
     XML_SetElementHandler(parser, nullptr, nullptr);
     XML_SetCharacterDataHandler(parser, nullptr);
-    XML_ParserFree(parser);
+    XmlParserPool::release(parser);
     parser = nullptr;
   }
 }
@@ -43,7 +46,7 @@ size_t TocNavParser::write(const uint8_t* buffer, const size_t size) {
       XML_StopParser(parser, XML_FALSE);
       XML_SetElementHandler(parser, nullptr, nullptr);
       XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
+      XmlParserPool::release(parser);
       parser = nullptr;
       return 0;
     }
@@ -57,7 +60,7 @@ size_t TocNavParser::write(const uint8_t* buffer, const size_t size) {
       XML_StopParser(parser, XML_FALSE);
       XML_SetElementHandler(parser, nullptr, nullptr);
       XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
+      XmlParserPool::release(parser);
       parser = nullptr;
       return 0;
     }
@@ -131,7 +134,7 @@ void XMLCALL TocNavParser::characterData(void* userData, const XML_Char* s, cons
 
   // Only collect text when inside an anchor within the TOC nav
   if (self->state == IN_ANCHOR) {
-    self->currentLabel.append(s, len);
+    BookMetadataCache::appendTocTitle(self->currentLabel, s, len);
   }
 }
 
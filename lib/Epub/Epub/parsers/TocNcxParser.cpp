@@ -4,9 +4,10 @@
 #include <Logging.h>
 
 #include "../BookMetadataCache.h"
+#include "XmlParserPool.h"
 
 bool TocNcxParser::setup() {
-  parser = XML_ParserCreate(nullptr);
+  parser = XmlParserPool::acquire();
   if (!parser) {
     LOG_DBG("TOC", "Couldn't allocate memory for parser");
     return false;
@@ -15,6 +16,8 @@ bool TocNcxParser::setup() {
   XML_SetUserData(parser, this);
   XML_SetElementHandler(parser, startElement, endElement);
   XML_SetCharacterDataHandler(parser, characterData);
+  // Titles are capped, so this is the only allocation the label needs however many entries the TOC has
+  currentLabel.reserve(BookMetadataCache::MAX_TOC_TITLE_BYTES);
   return true;
 }
 
@@ -23,7 +26,7 @@ TocNcxParser::~TocNcxParser() {
     XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
     XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
     XML_SetCharacterDataHandler(parser, nullptr);
-    XML_ParserFree(parser);
+    XmlParserPool::release(parser);
     parser = nullptr;
   }
 }
@@ -43,7 +46,7 @@ size_t TocNcxParser::write(const uint8_t* buffer, const size_t size) {
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
+      XmlParserPool::release(parser);
       parser = nullptr;
       return 0;
     }
@@ -57,7 +60,7 @@ size_t TocNcxParser::write(const uint8_t* buffer, const size_t size) {
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
+      XmlParserPool::release(parser);
       parser = nullptr;
       return 0;
     }
@@ -130,7 +133,7 @@ void XMLCALL TocNcxParser::startElement(void* userData, const XML_Char* name, co
 void XMLCALL TocNcxParser::characterData(void* userData, const XML_Char* s, const int len) {
   auto* self = static_cast<TocNcxParser*>(userData);
   if (self->state == IN_NAV_LABEL_TEXT) {
-    self->currentLabel.append(s, len);
+    BookMetadataCache::appendTocTitle(self->currentLabel, s, len);
   }
 }
 
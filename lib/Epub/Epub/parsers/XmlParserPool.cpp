@@ -0,0 +1,54 @@
+#include "XmlParserPool.h"
+
+#include <atomic>
+
+namespace {
+std::atomic<XML_Parser> pooled{nullptr};
+std::atomic<bool> leased{false};
+}  // namespace
+
+XML_Parser XmlParserPool::acquire() {
+  if (leased.exchange(true)) {
+    return XML_ParserCreate(nullptr);
+  }
+  XML_Parser parser = pooled.load();
+  if (parser && XML_ParserReset(parser, nullptr)) {
+    return parser;
+  }
+  if (parser) {
+    XML_ParserFree(parser);
+  }
+  parser = XML_ParserCreate(nullptr);
+  pooled = parser;
+  if (!parser) {
+    leased = false;
+  }
+  return parser;
+}
+
+void XmlParserPool::release(XML_Parser parser) {
+  if (!parser) {
+    return;
+  }
+  if (parser == pooled.load()) {
+    // Drop the handlers so nothing points at the finished parse; XML_ParserReset clears the rest on the next acquire
+    XML_SetUserData(parser, nullptr);
+    XML_SetElementHandler(parser, nullptr, nullptr);
+    XML_SetCharacterDataHandler(parser, nullptr);
+    XML_SetDefaultHandlerExpand(parser, nullptr);
+    leased = false;
+    return;
+  }
+  XML_ParserFree(parser);
+}
+
+void XmlParserPool::trim() {
+  if (leased.exchange(true)) {
+    return;
+  }
+  XML_Parser parser = pooled.exchange(nullptr);
+  if (parser) {
+    XML_ParserFree(parser);
+  }
+  leased = false;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "expat.h"
+
+// One expat parser kept from one parse to the next. Creating a parser allocates its state, DTD tables and input
+// buffer, and the first document grows the tag and binding lists; a pooled parser is reset with XML_ParserReset
+// instead, which keeps all of these. Book open parses container.xml, the OPF and the TOC back to back, and every
+// section build parses a chapter, so this takes the parser setup and its heap churn out of both.
+//
+// A parse takes the parser with acquire() and hands it back with release() in place of XML_ParserCreate and
+// XML_ParserFree. Only one parse holds the pooled parser at a time; one that overlaps it (the section prefetcher
+// while the reader builds a chapter) gets a parser of its own, freed again on release.
+namespace XmlParserPool {
+
+// A parser reset for a new document, with no handlers or user data set. nullptr if it can't be allocated.
+XML_Parser acquire();
+void release(XML_Parser parser);
+
+// Free the pooled parser unless a parse holds it, to hand its memory back while no parsing is going on
+void trim();
+
+}  // namespace XmlParserPool
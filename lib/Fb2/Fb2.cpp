@@ -0,0 +1,585 @@
+#include "Fb2.h"
+
+#include <BmpRowWriter.h>
+#include <HalStorage.h>
+#include <JpegToBmpConverter.h>
+#include <Logging.h>
+#include <PngToBmpConverter.h>
+#include <Serialization.h>
+#include <TxtEncoding.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr uint32_t CACHE_MAGIC = 0x46423242;  // "FB2B"
+constexpr uint8_t CACHE_VERSION = 1;          // Increment when the index changes
+constexpr size_t PARSE_BUFFER_SIZE = 1024;
+constexpr size_t COVER_CHUNK_SIZE = 512;
+constexpr size_t MAX_TITLE_BYTES = 96;
+
+// Element name without its namespace prefix
+const char* localName(const char* name) {
+  const char* colon = strrchr(name, ':');
+  return colon ? colon + 1 : name;
+}
+
+const char* findAttribute(const XML_Char** atts, const char* localAttrName) {
+  for (int i = 0; atts[i]; i += 2) {
+    if (strcmp(localName(atts[i]), localAttrName) == 0) {
+      return atts[i + 1];
+    }
+  }
+  return nullptr;
+}
+
+bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
+
+// Appends text with runs of whitespace collapsed to one space, up to a limit
+void appendCollapsed(std::string& out, const char* s, const int len, const size_t limit) {
+  for (int i = 0; i < len && out.size() < limit; i++) {
+    if (isWhitespace(s[i])) {
+      if (!out.empty() && out.back() != ' ') {
+        out.push_back(' ');
+      }
+    } else {
+      out.push_back(s[i]);
+    }
+  }
+}
+
+void trimTrailingSpace(std::string& s) {
+  while (!s.empty() && s.back() == ' ') {
+    s.pop_back();
+  }
+}
+
+// State of the single pass over the file that builds the book index
+struct IndexState {
+  XML_Parser parser = nullptr;
+  int depth = 0;
+  bool inTitleInfo = false;
+  bool titleInfoDone = false;
+  bool inAuthor = false;
+  bool authorDone = false;
+  bool inCoverpage = false;
+  std::string* capture = nullptr;  // Text of the element being read goes here
+  int captureDepth = 0;
+  std::string firstName;
+  std::string middleName;
+  std::string lastName;
+  std::string coverId;
+
+  // Body being scanned for sections
+  int bodyDepth = -1;
+  bool wholeBody = false;  // Notes and comments bodies are read as one section
+  bool sawSection = false;
+  bool preambleHasContent = false;
+  uint32_t bodyContentStart = 0;
+  Fb2::SectionEntry pending;
+  bool pendingTitleDone = false;
+
+  std::string* title = nullptr;
+  std::string* language = nullptr;
+  std::string* encoding = nullptr;
+  std::string* coverType = nullptr;
+  uint32_t* coverStart = nullptr;
+  uint32_t* coverEnd = nullptr;
+  bool inCoverBinary = false;
+  std::vector<Fb2::SectionEntry>* sections = nullptr;
+
+  uint32_t eventStart() const { return static_cast<uint32_t>(XML_GetCurrentByteIndex(parser)); }
+  uint32_t eventEnd() const { return eventStart() + static_cast<uint32_t>(XML_GetCurrentByteCount(parser)); }
+
+  void startCapture(std::string* target) {
+    capture = target;
+    captureDepth = depth;
+  }
+
+  void addSection(const uint32_t start, const uint32_t end, std::string sectionTitle) {
+    trimTrailingSpace(sectionTitle);
+    sections->push_back({start, end, std::move(sectionTitle)});
+  }
+};
+
+void XMLCALL xmlDecl(void* userData, const XML_Char*, const XML_Char* encoding, int) {
+  auto* state = static_cast<IndexState*>(userData);
+  if (encoding && strcasecmp(encoding, "utf-8") != 0) {
+    *state->encoding = encoding;
+  }
+}
+
+void XMLCALL indexStartElement(void* userData, const XML_Char* name, const XML_Char** atts) {
+  auto* state = static_cast<IndexState*>(userData);
+  state->depth++;
+  const char* local = localName(name);
+
+  if (strcmp(local, "title-info") == 0 && !state->titleInfoDone) {
+    state->inTitleInfo = true;
+  } else if (state->inTitleInfo) {
+    if (strcmp(local, "book-title") == 0) {
+      state->startCapture(state->title);
+    } else if (strcmp(local, "author") == 0 && !state->authorDone) {
+      state->inAuthor = true;
+    } else if (state->inAuthor && strcmp(local, "first-name") == 0) {
+      state->startCapture(&state->firstName);
+    } else if (state->inAuthor && strcmp(local, "middle-name") == 0) {
+      state->startCapture(&state->middleName);
+    } else if (state->inAuthor && strcmp(local, "last-name") == 0) {
+      state->startCapture(&state->lastName);
+    } else if (strcmp(local, "lang") == 0) {
+      state->startCapture(state->language);
+    } else if (strcmp(local, "coverpage") == 0) {
+      state->inCoverpage = true;
+    } else if (state->inCoverpage && strcmp(local, "image") == 0 && state->coverId.empty()) {
+      const char* href = findAttribute(atts, "href");
+      if (href) {
+        state->coverId = href[0] == '#' ? href + 1 : href;
+      }
+    }
+    return;
+  }
+
+  if (strcmp(local, "body") == 0 && state->bodyDepth < 0) {
+    const char* bodyName = findAttribute(atts, "name");
+    state->bodyDepth = state->depth;
+    state->wholeBody = bodyName && (strcmp(bodyName, "notes") == 0 || strcmp(bodyName, "comments") == 0);
+    state->sawSection = false;
+    state->preambleHasContent = false;
+    state->bodyContentStart = state->eventEnd();
+    state->pending = Fb2::SectionEntry();
+    state->pendingTitleDone = false;
+    return;
+  }
+
+  if (state->bodyDepth >= 0) {
+    if (state->depth == state->bodyDepth + 1 && !state->wholeBody) {
+      if (strcmp(local, "section") == 0) {
+        // Body title and epigraph before the first section make a section of their own
+        if (!state->sawSection && state->preambleHasContent) {
+          state->addSection(state->bodyContentStart, state->eventStart(), std::move(state->pending.title));
+        }
+        state->sawSection = true;
+        state->pending = Fb2::SectionEntry();
+        state->pending.start = state->eventStart();
+        state->pendingTitleDone = false;
+      } else if (!state->sawSection) {
+        state->preambleHasContent = true;
+      }
+    }
+
+    // The first title of a top level section (or of the body, for its preamble) names it in the chapter list
+    const int titleDepth = state->bodyDepth + (state->wholeBody || !state->sawSection ? 1 : 2);
+    if (!state->pendingTitleDone && state->depth == titleDepth && strcmp(local, "title") == 0) {
+      state->startCapture(&state->pending.title);
+    } else if (state->capture == &state->pending.title && strcmp(local, "p") == 0) {
+      if (!state->pending.title.empty() && state->pending.title.back() != ' ') {
+        state->pending.title.push_back(' ');
+      }
+    }
+    return;
+  }
+
+  if (strcmp(local, "binary") == 0 && !state->coverId.empty() && *state->coverEnd == 0) {
+    const char* id = findAttribute(atts, "id");
+    if (id && state->coverId == id) {
+      const char* contentType = findAttribute(atts, "content-type");
+      *state->coverType = contentType ? contentType : "";
+      *state->coverStart = state->eventEnd();
+      state->inCoverBinary = true;
+    }
+  }
+}
+
+void XMLCALL indexEndElement(void* userData, const XML_Char* name) {
+  auto* state = static_cast<IndexState*>(userData);
+  const char* local = localName(name);
+
+  if (state->capture && state->depth == state->captureDepth) {
+    if (state->capture == &state->pending.title) {
+      state->pendingTitleDone = true;
+    }
+    state->capture = nullptr;
+  }
+
+  if (state->inTitleInfo) {
+    if (strcmp(local, "title-info") == 0) {
+      state->inTitleInfo = false;
+      state->titleInfoDone = true;
+    } else if (state->inAuthor && strcmp(local, "author") == 0) {
+      state->inAuthor = false;
+      state->authorDone = true;
+    } else if (strcmp(local, "coverpage") == 0) {
+      state->inCoverpage = false;
+    }
+  } else if (state->bodyDepth >= 0) {
+    if (state->depth == state->bodyDepth + 1 && !state->wholeBody && strcmp(local, "section") == 0) {
+      state->addSection(state->pending.start, state->eventEnd(), std::move(state->pending.title));
+      state->pending = Fb2::SectionEntry();
+    } else if (state->depth == state->bodyDepth) {
+      if (state->wholeBody || (!state->sawSection && state->preambleHasContent)) {
+        state->addSection(state->bodyContentStart, state->eventStart(), std::move(state->pending.title));
+      }
+      state->bodyDepth = -1;
+    }
+  } else if (state->inCoverBinary) {
+    *state->coverEnd = state->eventStart();
+    state->inCoverBinary = false;
+  }
+  state->depth--;
+}
+
+void XMLCALL indexCharacterData(void* userData, const XML_Char* s, const int len) {
+  auto* state = static_cast<IndexState*>(userData);
+  if (state->capture) {
+    appendCollapsed(*state->capture, s, len, MAX_TITLE_BYTES);
+  }
+}
+
+int base64Value(const uint8_t c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+}  // namespace
+
+int XMLCALL Fb2::unknownEncodingHandler(void*, const XML_Char* name, XML_Encoding* info) {
+  TxtEncoding encoding;
+  if (strcasecmp(name, "windows-1251") == 0 || strcasecmp(name, "cp1251") == 0) {
+    encoding = TxtEncoding::Cp1251;
+  } else if (strcasecmp(name, "windows-1252") == 0 || strcasecmp(name, "cp1252") == 0) {
+    encoding = TxtEncoding::Cp1252;
+  } else {
+    LOG_ERR("FB2", "Unsupported encoding %s", name);
+    return XML_STATUS_ERROR;
+  }
+
+  for (int i = 0; i < 256; i++) {
+    info->map[i] = static_cast<int>(TxtTranscoder::singleByteCodepoint(encoding, static_cast<uint8_t>(i)));
+  }
+  info->data = nullptr;
+  info->convert = nullptr;
+  info->release = nullptr;
+  return XML_STATUS_OK;
+}
+
+bool Fb2::load() {
+  if (loaded) {
+    return true;
+  }
+
+  if (!loadMetadataCache()) {
+    setupCacheDir();
+    if (!buildMetadataCache()) {
+      return false;
+    }
+    saveMetadataCache();
+  }
+
+  loaded = true;
+  LOG_DBG("FB2", "Loaded %s: %d sections", filepath.c_str(), getSectionCount());
+  return true;
+}
+
+bool Fb2::loadMetadataCache() {
+  FsFile file;
+  if (!Storage.openFileForRead("FB2", cachePath + "/book.bin", file)) {
+    return false;
+  }
+
+  FsFile source;
+  if (!Storage.openFileForRead("FB2", filepath, source)) {
+    file.close();
+    return false;
+  }
+  const auto currentSize = static_cast<uint32_t>(source.size());
+  source.close();
+
+  uint32_t magic;
+  uint8_t version;
+  uint32_t cachedSize;
+  serialization::readPod(file, magic);
+  serialization::readPod(file, version);
+  serialization::readPod(file, cachedSize);
+  if (magic != CACHE_MAGIC || version != CACHE_VERSION || cachedSize != currentSize) {
+    LOG_DBG("FB2", "Book index out of date, rebuilding");
+    file.close();
+    return false;
+  }
+
+  fileSize = cachedSize;
+  serialization::readString(file, title);
+  serialization::readString(file, author);
+  serialization::readString(file, language);
+  serialization::readString(file, encoding);
+  serialization::readString(file, coverType);
+  serialization::readPod(file, coverStart);
+  serialization::readPod(file, coverEnd);
+
+  uint32_t count;
+  serialization::readPod(file, count);
+  sections.clear();
+  sections.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    SectionEntry entry;
+    serialization::readPod(file, entry.start);
+    serialization::readPod(file, entry.end);
+    serialization::readString(file, entry.title);
+    if (entry.end < entry.start || entry.end > fileSize) {
+      LOG_ERR("FB2", "Book index entry %u out of range", static_cast<unsigned>(i));
+      file.close();
+      sections.clear();
+      return false;
+    }
+    sections.push_back(std::move(entry));
+  }
+  file.close();
+  return true;
+}
+
+void Fb2::saveMetadataCache() const {
+  FsFile file;
+  if (!Storage.openFileForWrite("FB2", cachePath + "/book.bin", file)) {
+    return;
+  }
+  serialization::writePod(file, CACHE_MAGIC);
+  serialization::writePod(file, CACHE_VERSION);
+  serialization::writePod(file, fileSize);
+  serialization::writeString(file, title);
+  serialization::writeString(file, author);
+  serialization::writeString(file, language);
+  serialization::writeString(file, encoding);
+  serialization::writeString(file, coverType);
+  serialization::writePod(file, coverStart);
+  serialization::writePod(file, coverEnd);
+  serialization::writePod(file, static_cast<uint32_t>(sections.size()));
+  for (const auto& entry : sections) {
+    serialization::writePod(file, entry.start);
+    serialization::writePod(file, entry.end);
+    serialization::writeString(file, entry.title);
+  }
+  file.close();
+}
+
+bool Fb2::buildMetadataCache() {
+  FsFile file;
+  if (!Storage.openFileForRead("FB2", filepath, file)) {
+    return false;
+  }
+  fileSize = static_cast<uint32_t>(file.size());
+
+  const XML_Parser parser = XML_ParserCreate(nullptr);
+  if (!parser) {
+    LOG_ERR("FB2", "Couldn't allocate memory for parser");
+    file.close();
+    return false;
+  }
+
+  title.clear();
+  author.clear();
+  language.clear();
+  encoding.clear();
+  coverType.clear();
+  coverStart = coverEnd = 0;
+  sections.clear();
+
+  IndexState state;
+  state.parser = parser;
+  state.title = &title;
+  state.language = &language;
+  state.encoding = &encoding;
+  state.coverType = &coverType;
+  state.coverStart = &coverStart;
+  state.coverEnd = &coverEnd;
+  state.sections = &sections;
+
+  XML_SetUserData(parser, &state);
+  XML_SetXmlDeclHandler(parser, xmlDecl);
+  XML_SetUnknownEncodingHandler(parser, unknownEncodingHandler, nullptr);
+  XML_SetElementHandler(parser, indexStartElement, indexEndElement);
+  XML_SetCharacterDataHandler(parser, indexCharacterData);
+
+  const uint32_t startTime = millis();
+  bool success = true;
+  int done;
+  do {
+    void* const buf = XML_GetBuffer(parser, PARSE_BUFFER_SIZE);
+    if (!buf) {
+      LOG_ERR("FB2", "Couldn't allocate memory for buffer");
+      success = false;
+      break;
+    }
+    const int len = file.read(buf, PARSE_BUFFER_SIZE);
+    if (len < 0) {
+      LOG_ERR("FB2", "File read error");
+      success = false;
+      break;
+    }
+    done = file.available() == 0;
+    if (XML_ParseBuffer(parser, len, done) == XML_STATUS_ERROR) {
+      LOG_ERR("FB2", "Parse error at line %lu: %s", XML_GetCurrentLineNumber(parser),
+              XML_ErrorString(XML_GetErrorCode(parser)));
+      success = false;
+      break;
+    }
+  } while (!done);
+
+  XML_ParserFree(parser);
+  file.close();
+
+  // Sections found before an error are still readable
+  if (!success && sections.empty()) {
+    return false;
+  }
+
+  // Sections are parsed on their own later, wrapped in an ASCII root element that a UTF-16 text can't contain
+  if (strncasecmp(encoding.c_str(), "utf-16", 6) == 0) {
+    LOG_ERR("FB2", "UTF-16 FB2 files are not supported");
+    return false;
+  }
+
+  trimTrailingSpace(title);
+  trimTrailingSpace(language);
+  for (std::string* part : {&state.firstName, &state.middleName, &state.lastName}) {
+    trimTrailingSpace(*part);
+    if (!part->empty()) {
+      if (!author.empty()) {
+        author.push_back(' ');
+      }
+      author += *part;
+    }
+  }
+  if (coverEnd < coverStart) {
+    coverStart = coverEnd = 0;
+  }
+  LOG_DBG("FB2", "Indexed %u sections in %lu ms", static_cast<unsigned>(sections.size()), millis() - startTime);
+  return !sections.empty();
+}
+
+bool Fb2::clearCache() const {
+  if (!Storage.exists(cachePath.c_str())) {
+    LOG_DBG("FB2", "Cache does not exist, no action needed");
+    return true;
+  }
+
+  if (!Storage.removeDir(cachePath.c_str())) {
+    LOG_ERR("FB2", "Failed to clear cache");
+    return false;
+  }
+
+  LOG_DBG("FB2", "Cache cleared successfully");
+  return true;
+}
+
+void Fb2::setupCacheDir() const {
+  if (Storage.exists(cachePath.c_str())) {
+    return;
+  }
+
+  Storage.mkdir(cachePath.c_str());
+}
+
+float Fb2::calculateProgress(const int sectionIndex, const float sectionRead) const {
+  if (sections.empty() || sectionIndex < 0) {
+    return 0.0f;
+  }
+  if (sectionIndex >= getSectionCount()) {
+    return 1.0f;
+  }
+  const uint32_t first = sections.front().start;
+  const uint32_t total = sections.back().end - first;
+  if (total == 0) {
+    return 0.0f;
+  }
+  const SectionEntry& entry = sections[sectionIndex];
+  const float position = static_cast<float>(entry.start - first) + sectionRead * (entry.end - entry.start);
+  return position / static_cast<float>(total);
+}
+
+std::string Fb2::getCoverBmpPath() const { return cachePath + "/cover.bmp"; }
+
+bool Fb2::generateCoverBmp() const {
+  // Already generated, return true
+  if (Storage.exists(getCoverBmpPath().c_str())) {
+    return true;
+  }
+
+  if (coverEnd <= coverStart) {
+    LOG_DBG("FB2", "No cover image in FB2 file");
+    return false;
+  }
+
+  const bool isPng = coverType == "image/png";
+  if (!isPng && coverType != "image/jpeg" && coverType != "image/jpg") {
+    LOG_ERR("FB2", "Unsupported cover type %s", coverType.c_str());
+    return false;
+  }
+
+  setupCacheDir();
+
+  // Decode the base64 content into a plain image file the converters can read
+  const std::string imagePath = cachePath + (isPng ? "/cover.png" : "/cover.jpg");
+  FsFile source, image;
+  if (!Storage.openFileForRead("FB2", filepath, source)) {
+    return false;
+  }
+  if (!Storage.openFileForWrite("FB2", imagePath, image)) {
+    source.close();
+    return false;
+  }
+  source.seek(coverStart);
+  uint8_t in[COVER_CHUNK_SIZE];
+  uint8_t out[COVER_CHUNK_SIZE];
+  uint32_t remaining = coverEnd - coverStart;
+  uint32_t bits = 0;
+  int bitCount = 0;
+  while (remaining > 0) {
+    const int len = source.read(in, std::min<uint32_t>(remaining, sizeof(in)));
+    if (len <= 0) {
+      break;
+    }
+    remaining -= len;
+    size_t produced = 0;
+    for (int i = 0; i < len; i++) {
+      const int value = base64Value(in[i]);
+      if (value < 0) {
+        continue;  // Line breaks, padding
+      }
+      bits = (bits << 6) | value;
+      bitCount += 6;
+      if (bitCount >= 8) {
+        bitCount -= 8;
+        out[produced++] = static_cast<uint8_t>(bits >> bitCount);
+      }
+    }
+    image.write(out, produced);
+  }
+  source.close();
+  image.close();
+
+  FsFile coverImage, coverBmp;
+  if (!Storage.openFileForRead("FB2", imagePath, coverImage)) {
+    return false;
+  }
+  if (!Storage.openFileForWrite("FB2", getCoverBmpPath(), coverBmp)) {
+    coverImage.close();
+    return false;
+  }
+  const BmpOutput output = BmpOutput::cover(coverBmp, true);
+  const bool success = isPng ? PngToBmpConverter::pngFileToBmpStreams(coverImage, &output, 1)
+                             : JpegToBmpConverter::jpegFileToBmpStreams(coverImage, &output, 1);
+  coverImage.close();
+  coverBmp.close();
+  Storage.remove(imagePath.c_str());
+
+  if (!success) {
+    LOG_ERR("FB2", "Failed to generate BMP from cover image");
+    Storage.remove(getCoverBmpPath().c_str());
+    return false;
+  }
+  LOG_DBG("FB2", "Generated BMP from cover image");
+  return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <expat.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A FictionBook 2 file. The XML is streamed once on first open to find the metadata, the cover image and the byte
+// range of every top level section. That index is cached in book.bin, and each section is later laid out straight
+// from its range of the file into sections/N.bin (see Fb2Section), so the book reads like an EPUB spine.
+class Fb2 {
+ public:
+  struct SectionEntry {
+    uint32_t start = 0;  // First byte of the section, or of the body content for a body without sections
+    uint32_t end = 0;    // One past its last byte
+    std::string title;
+  };
+
+ private:
+  std::string filepath;
+  std::string cachePath;
+  std::string title;
+  std::string author;
+  std::string language;
+  std::string encoding;  // From the XML declaration, empty for UTF-8
+  std::string coverType;
+  uint32_t coverStart = 0;  // Base64 content of the cover <binary>, empty range if there is none
+  uint32_t coverEnd = 0;
+  uint32_t fileSize = 0;
+  std::vector<SectionEntry> sections;
+  bool loaded = false;
+
+  bool loadMetadataCache();
+  bool buildMetadataCache();
+  void saveMetadataCache() const;
+
+ public:
+  explicit Fb2(std::string filepath, const std::string& cacheDir) : filepath(std::move(filepath)) {
+    // Create cache key based on filepath (same as Epub)
+    cachePath = cacheDir + "/fb2_" + std::to_string(std::hash<std::string>{}(this->filepath));
+  }
+  ~Fb2() = default;
+
+  bool load();
+  bool clearCache() const;
+  void setupCacheDir() const;
+
+  const std::string& getPath() const { return filepath; }
+  const std::string& getCachePath() const { return cachePath; }
+  const std::string& getTitle() const { return title; }
+  const std::string& getAuthor() const { return author; }
+  const std::string& getLanguage() const { return language; }
+  // Encoding name to create a section parser with, nullptr for UTF-8
+  const char* getEncoding() const { return encoding.empty() ? nullptr : encoding.c_str(); }
+
+  int getSectionCount() const { return static_cast<int>(sections.size()); }
+  const SectionEntry& getSection(int index) const { return sections[index]; }
+  // Fraction (0-1) of the book read at the given fraction of a section, weighted by the sections' sizes in the file
+  float calculateProgress(int sectionIndex, float sectionRead) const;
+
+  // Cover image support (for sleep screen), decoded from the book's cover <binary>
+  std::string getCoverBmpPath() const;
+  bool generateCoverBmp() const;
+
+  // Maps the Windows code pages FB2 files are often saved in, which expat doesn't know itself
+  static int XMLCALL unknownEncodingHandler(void* data, const XML_Char* name, XML_Encoding* info);
+};
@@ -0,0 +1,182 @@
+#include "Fb2Section.h"
+
+#include <Epub/Page.h>
+#include <Epub/hyphenation/Hyphenator.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include "Fb2.h"
+#include "Fb2SectionParser.h"
+
+namespace {
+constexpr uint8_t SECTION_FILE_VERSION = 2;
+constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + sizeof(int) + sizeof(float) + sizeof(bool) + sizeof(uint8_t) +
+                                 sizeof(uint16_t) + sizeof(uint16_t) + sizeof(bool) + sizeof(uint16_t) +
+                                 sizeof(uint32_t);
+}  // namespace
+
+Fb2Section::Fb2Section(const Fb2& fb2, const int sectionIndex, GfxRenderer& renderer)
+    : fb2(fb2),
+      sectionIndex(sectionIndex),
+      renderer(renderer),
+      filePath(fb2.getCachePath() + "/sections/" + std::to_string(sectionIndex) + ".bin") {}
+
+uint32_t Fb2Section::onPageComplete(std::unique_ptr<Page> page) {
+  const uint32_t position = file.position();
+  if (!page->serialize(file)) {
+    LOG_ERR("FBS", "Failed to serialize page %d", pageCount);
+    return 0;
+  }
+  pageCount++;
+  return position;
+}
+
+void Fb2Section::writeSectionFileHeader(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                                        const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                                        const uint16_t viewportHeight, const bool hyphenationEnabled) {
+  static_assert(HEADER_SIZE == sizeof(SECTION_FILE_VERSION) + sizeof(fontId) + sizeof(lineCompression) +
+                                   sizeof(extraParagraphSpacing) + sizeof(paragraphAlignment) + sizeof(viewportWidth) +
+                                   sizeof(viewportHeight) + sizeof(hyphenationEnabled) + sizeof(pageCount) +
+                                   sizeof(uint32_t),
+                "Header size mismatch");
+  serialization::writePod(file, SECTION_FILE_VERSION);
+  serialization::writePod(file, fontId);
+  serialization::writePod(file, lineCompression);
+  serialization::writePod(file, extraParagraphSpacing);
+  serialization::writePod(file, paragraphAlignment);
+  serialization::writePod(file, viewportWidth);
+  serialization::writePod(file, viewportHeight);
+  serialization::writePod(file, hyphenationEnabled);
+  serialization::writePod(file, pageCount);                 // Placeholder for page count
+  serialization::writePod(file, static_cast<uint32_t>(0));  // Placeholder for LUT offset
+}
+
+bool Fb2Section::loadSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                                 const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                                 const uint16_t viewportHeight, const bool hyphenationEnabled) {
+  if (!Storage.openFileForRead("FBS", filePath, file)) {
+    return false;
+  }
+
+  uint8_t version;
+  int fileFontId;
+  float fileLineCompression;
+  bool fileExtraParagraphSpacing;
+  uint8_t fileParagraphAlignment;
+  uint16_t fileViewportWidth, fileViewportHeight;
+  bool fileHyphenationEnabled;
+  serialization::readPod(file, version);
+  serialization::readPod(file, fileFontId);
+  serialization::readPod(file, fileLineCompression);
+  serialization::readPod(file, fileExtraParagraphSpacing);
+  serialization::readPod(file, fileParagraphAlignment);
+  serialization::readPod(file, fileViewportWidth);
+  serialization::readPod(file, fileViewportHeight);
+  serialization::readPod(file, fileHyphenationEnabled);
+  if (version != SECTION_FILE_VERSION || fontId != fileFontId || lineCompression != fileLineCompression ||
+      extraParagraphSpacing != fileExtraParagraphSpacing || paragraphAlignment != fileParagraphAlignment ||
+      viewportWidth != fileViewportWidth || viewportHeight != fileViewportHeight ||
+      hyphenationEnabled != fileHyphenationEnabled) {
+    file.close();
+    LOG_DBG("FBS", "Section cache out of date");
+    clearCache();
+    return false;
+  }
+
+  uint32_t lutOffset;
+  serialization::readPod(file, pageCount);
+  serialization::readPod(file, lutOffset);
+  pageLut.resize(pageCount);
+  file.seek(lutOffset);
+  const size_t lutBytes = sizeof(uint32_t) * pageCount;
+  if (lutBytes > 0 && file.read(reinterpret_cast<uint8_t*>(pageLut.data()), lutBytes) != static_cast<int>(lutBytes)) {
+    file.close();
+    pageLut.clear();
+    LOG_ERR("FBS", "Deserialization failed: Truncated page LUT");
+    clearCache();
+    return false;
+  }
+
+  // Keep the file open for subsequent page loads
+  LOG_DBG("FBS", "Deserialization succeeded: %d pages", pageCount);
+  return true;
+}
+
+bool Fb2Section::clearCache() {
+  if (file) {
+    file.close();
+  }
+  pageLut.clear();
+  if (Storage.exists(filePath.c_str()) && !Storage.remove(filePath.c_str())) {
+    LOG_ERR("FBS", "Failed to clear cache");
+    return false;
+  }
+  return true;
+}
+
+bool Fb2Section::createSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                                   const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                                   const uint16_t viewportHeight, const bool hyphenationEnabled,
+                                   const std::function<void()>& popupFn) {
+  {
+    const auto sectionsDir = fb2.getCachePath() + "/sections";
+    Storage.mkdir(sectionsDir.c_str());
+  }
+
+  if (!Storage.openFileForWrite("FBS", filePath, file)) {
+    return false;
+  }
+  pageCount = 0;
+  writeSectionFileHeader(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                         viewportHeight, hyphenationEnabled);
+
+  std::vector<uint32_t> lut;
+  Hyphenator::setPreferredLanguage(fb2.getLanguage());
+  Fb2SectionParser parser(
+      fb2, sectionIndex, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+      viewportHeight, hyphenationEnabled,
+      [this, &lut](std::unique_ptr<Page> page) { lut.emplace_back(onPageComplete(std::move(page))); }, popupFn);
+  if (!parser.parseAndBuildPages()) {
+    LOG_ERR("FBS", "Failed to parse section %d", sectionIndex);
+    file.close();
+    Storage.remove(filePath.c_str());
+    return false;
+  }
+
+  const uint32_t lutOffset = file.position();
+  for (const uint32_t pos : lut) {
+    if (pos == 0) {
+      LOG_ERR("FBS", "Failed to write LUT due to invalid page positions");
+      file.close();
+      Storage.remove(filePath.c_str());
+      return false;
+    }
+    serialization::writePod(file, pos);
+  }
+
+  // Go back and write the page count and LUT offset
+  file.seek(HEADER_SIZE - sizeof(uint32_t) - sizeof(pageCount));
+  serialization::writePod(file, pageCount);
+  serialization::writePod(file, lutOffset);
+  file.close();
+  pageLut = std::move(lut);
+  return true;
+}
+
+std::unique_ptr<Page> Fb2Section::loadPageFromSectionFile() {
+  if (currentPage < 0 || currentPage >= static_cast<int>(pageLut.size())) {
+    LOG_ERR("FBS", "Page %d not in LUT (%zu pages)", currentPage, pageLut.size());
+    return nullptr;
+  }
+  if (!file && !Storage.openFileForRead("FBS", filePath, file)) {
+    return nullptr;
+  }
+
+  file.seek(pageLut[currentPage]);
+  auto page = Page::deserialize(file);
+  if (!page) {
+    // Drop the handle so a retry starts from a fresh open
+    file.close();
+  }
+  return page;
+}
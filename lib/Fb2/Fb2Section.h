@@ -0,0 +1,46 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Fb2;
+class GfxRenderer;
+class Page;
+
+// Page cache of one FB2 section in sections/N.bin, in the same layout as an EPUB Section file: a header with the
+// layout settings, the serialized pages and a table of their offsets.
+class Fb2Section {
+  const Fb2& fb2;
+  const int sectionIndex;
+  GfxRenderer& renderer;
+  std::string filePath;
+  FsFile file;
+  // Page offsets, loaded once so page turns only need a single seek on the (kept open) section file
+  std::vector<uint32_t> pageLut;
+
+  void writeSectionFileHeader(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                              uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled);
+  uint32_t onPageComplete(std::unique_ptr<Page> page);
+
+ public:
+  uint16_t pageCount = 0;
+  int currentPage = 0;
+
+  Fb2Section(const Fb2& fb2, int sectionIndex, GfxRenderer& renderer);
+  ~Fb2Section() {
+    if (file) {
+      file.close();
+    }
+  }
+  bool loadSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                       uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled);
+  bool clearCache();
+  bool createSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                         uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled,
+                         const std::function<void()>& popupFn = nullptr);
+  std::unique_ptr<Page> loadPageFromSectionFile();
+};
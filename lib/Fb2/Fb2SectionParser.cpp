@@ -0,0 +1,328 @@
+#include "Fb2SectionParser.h"
+
+#include <Epub/Page.h>
+#include <GfxRenderer.h>
+#include <HalStorage.h>
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "Fb2.h"
+
+namespace {
+constexpr size_t MIN_SIZE_FOR_POPUP = 10 * 1024;  // 10KB
+constexpr size_t PARSE_BUFFER_SIZE = 1024;
+constexpr size_t MAX_PENDING_WORDS = 750;  // Longer paragraphs are laid out early, all but their last line
+
+// The section is parsed on its own, so it gets a root element of its own
+constexpr char ROOT_OPEN[] = "<fb2-section>";
+constexpr char ROOT_CLOSE[] = "</fb2-section>";
+
+const char* BLOCK_TAGS[] = {"p",       "v",     "subtitle", "text-author", "title", "epigraph",  "cite", "poem",
+                            "stanza",  "table", "tr",       "td",          "th",    "annotation", "section"};
+constexpr int NUM_BLOCK_TAGS = sizeof(BLOCK_TAGS) / sizeof(BLOCK_TAGS[0]);
+
+const char* localName(const char* name) {
+  const char* colon = strrchr(name, ':');
+  return colon ? colon + 1 : name;
+}
+
+bool isBlockTag(const char* name) {
+  for (int i = 0; i < NUM_BLOCK_TAGS; i++) {
+    if (strcmp(name, BLOCK_TAGS[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
+}  // namespace
+
+int Fb2SectionParser::lineHeight() const { return static_cast<int>(renderer.getLineHeight(fontId) * lineCompression); }
+
+BlockStyle Fb2SectionParser::blockStyleForElement(const char* name) const {
+  BlockStyle style;
+  style.textAlignDefined = true;
+  style.alignment = paragraphAlignment == static_cast<uint8_t>(CssTextAlign::None)
+                        ? CssTextAlign::Justify
+                        : static_cast<CssTextAlign>(paragraphAlignment);
+
+  if (centerUntilDepth < depth || strcmp(name, "title") == 0 || strcmp(name, "subtitle") == 0) {
+    style.alignment = CssTextAlign::Center;
+    style.textIndentDefined = true;
+  } else if (strcmp(name, "text-author") == 0) {
+    style.alignment = CssTextAlign::Right;
+    style.textIndentDefined = true;
+  } else if (strcmp(name, "v") == 0) {
+    // Verse lines keep their own breaks
+    style.alignment = CssTextAlign::Left;
+    style.textIndentDefined = true;
+  }
+
+  if (insetUntilDepth < depth || strcmp(name, "epigraph") == 0 || strcmp(name, "cite") == 0 ||
+      strcmp(name, "poem") == 0) {
+    style.marginLeft = static_cast<int16_t>(std::min<int>(lineHeight() * 2, viewportWidth / 4));
+  }
+  return style;
+}
+
+void Fb2SectionParser::flushPartWordBuffer() {
+  EpdFontFamily::Style fontStyle = EpdFontFamily::REGULAR;
+  if (boldUntilDepth < depth || centerUntilDepth < depth) {
+    fontStyle = static_cast<EpdFontFamily::Style>(fontStyle | EpdFontFamily::BOLD);
+  }
+  if (italicUntilDepth < depth) {
+    fontStyle = static_cast<EpdFontFamily::Style>(fontStyle | EpdFontFamily::ITALIC);
+  }
+
+  partWordBuffer[partWordBufferIndex] = '\0';
+  currentTextBlock->addWord(partWordBuffer, partWordBufferIndex, fontStyle, false, nextWordContinues);
+  partWordBufferIndex = 0;
+  nextWordContinues = false;
+}
+
+void Fb2SectionParser::startNewTextBlock(const BlockStyle& blockStyle) {
+  nextWordContinues = false;
+  if (currentTextBlock) {
+    if (currentTextBlock->isEmpty()) {
+      currentTextBlock->setBlockStyle(blockStyle);
+      return;
+    }
+    makePages();
+  }
+  currentTextBlock.reset(new ParsedText(extraParagraphSpacing, hyphenationEnabled, blockStyle, &arenas));
+}
+
+void XMLCALL Fb2SectionParser::startElement(void* userData, const XML_Char* name, const XML_Char**) {
+  auto* self = static_cast<Fb2SectionParser*>(userData);
+  const char* local = localName(name);
+
+  if (self->partWordBufferIndex > 0) {
+    self->flushPartWordBuffer();
+    // An inline element inside a word continues it
+    self->nextWordContinues = !isBlockTag(local);
+  }
+
+  if (strcmp(local, "empty-line") == 0) {
+    self->startNewTextBlock(self->blockStyleForElement(local));
+    if (!self->currentPage) {
+      self->currentPage.reset(new Page());
+      self->currentPageNextY = 0;
+    }
+    self->currentPageNextY += self->lineHeight();
+  } else if (isBlockTag(local)) {
+    self->startNewTextBlock(self->blockStyleForElement(local));
+  }
+
+  if (strcmp(local, "strong") == 0) {
+    self->boldUntilDepth = std::min(self->boldUntilDepth, self->depth);
+  } else if (strcmp(local, "emphasis") == 0 || strcmp(local, "epigraph") == 0 ||
+             strcmp(local, "text-author") == 0) {
+    self->italicUntilDepth = std::min(self->italicUntilDepth, self->depth);
+  } else if (strcmp(local, "title") == 0 || strcmp(local, "subtitle") == 0) {
+    self->centerUntilDepth = std::min(self->centerUntilDepth, self->depth);
+  }
+  if (strcmp(local, "epigraph") == 0 || strcmp(local, "cite") == 0 || strcmp(local, "poem") == 0) {
+    self->insetUntilDepth = std::min(self->insetUntilDepth, self->depth);
+  }
+
+  self->depth += 1;
+}
+
+void XMLCALL Fb2SectionParser::endElement(void* userData, const XML_Char* name) {
+  auto* self = static_cast<Fb2SectionParser*>(userData);
+  const char* local = localName(name);
+
+  if (self->partWordBufferIndex > 0) {
+    self->flushPartWordBuffer();
+    self->nextWordContinues = !isBlockTag(local);
+  }
+
+  self->depth -= 1;
+
+  if (self->boldUntilDepth == self->depth) {
+    self->boldUntilDepth = INT_MAX;
+  }
+  if (self->italicUntilDepth == self->depth) {
+    self->italicUntilDepth = INT_MAX;
+  }
+  if (self->centerUntilDepth == self->depth) {
+    self->centerUntilDepth = INT_MAX;
+  }
+  if (self->insetUntilDepth == self->depth) {
+    self->insetUntilDepth = INT_MAX;
+  }
+
+  // Text following a block inside its parent (a title's tail, a stanza's text) gets the parent's style
+  if (isBlockTag(local)) {
+    self->startNewTextBlock(self->blockStyleForElement(""));
+  }
+}
+
+void XMLCALL Fb2SectionParser::characterData(void* userData, const XML_Char* s, const int len) {
+  auto* self = static_cast<Fb2SectionParser*>(userData);
+
+  for (int i = 0; i < len; i++) {
+    if (isWhitespace(s[i])) {
+      if (self->partWordBufferIndex > 0) {
+        self->flushPartWordBuffer();
+      }
+      self->nextWordContinues = false;
+      continue;
+    }
+
+    // A no-break space (U+00A0) holds the words around it together, as in ChapterHtmlSlimParser
+    if (static_cast<uint8_t>(s[i]) == 0xC2 && i + 1 < len && static_cast<uint8_t>(s[i + 1]) == 0xA0) {
+      if (self->partWordBufferIndex > 0) {
+        self->flushPartWordBuffer();
+      }
+      self->partWordBuffer[0] = ' ';
+      self->partWordBufferIndex = 1;
+      self->nextWordContinues = true;
+      self->flushPartWordBuffer();
+      self->nextWordContinues = true;
+      i++;
+      continue;
+    }
+
+    if (self->partWordBufferIndex >= MAX_WORD_SIZE) {
+      self->flushPartWordBuffer();
+    }
+    self->partWordBuffer[self->partWordBufferIndex++] = s[i];
+  }
+
+  if (self->currentTextBlock->size() > MAX_PENDING_WORDS) {
+    const int inset = self->currentTextBlock->getBlockStyle().totalHorizontalInset();
+    self->currentTextBlock->layoutAndExtractLines(
+        self->renderer, self->fontId, static_cast<uint16_t>(self->viewportWidth - inset),
+        [self](ArenaPtr<TextBlock> textBlock) { self->addLineToPage(std::move(textBlock)); }, false);
+  }
+}
+
+bool Fb2SectionParser::parseAndBuildPages() {
+  const Fb2::SectionEntry& entry = fb2.getSection(sectionIndex);
+  startNewTextBlock(blockStyleForElement(""));
+
+  FsFile file;
+  if (!Storage.openFileForRead("FBP", fb2.getPath(), file) || !file.seek(entry.start)) {
+    return false;
+  }
+
+  const XML_Parser parser = XML_ParserCreate(fb2.getEncoding());
+  if (!parser) {
+    LOG_ERR("FBP", "Couldn't allocate memory for parser");
+    file.close();
+    return false;
+  }
+  XML_SetUnknownEncodingHandler(parser, Fb2::unknownEncodingHandler, nullptr);
+  XML_SetUserData(parser, this);
+  XML_SetElementHandler(parser, startElement, endElement);
+  XML_SetCharacterDataHandler(parser, characterData);
+
+  if (popupFn && entry.end - entry.start >= MIN_SIZE_FOR_POPUP) {
+    popupFn();
+  }
+
+  const auto failParse = [&parser, &file]() {
+    XML_StopParser(parser, XML_FALSE);
+    XML_SetElementHandler(parser, nullptr, nullptr);
+    XML_SetCharacterDataHandler(parser, nullptr);
+    XML_ParserFree(parser);
+    file.close();
+    return false;
+  };
+
+  const uint32_t startTime = millis();
+  if (XML_Parse(parser, ROOT_OPEN, sizeof(ROOT_OPEN) - 1, XML_FALSE) == XML_STATUS_ERROR) {
+    return failParse();
+  }
+  uint32_t remaining = entry.end - entry.start;
+  while (remaining > 0) {
+    if (shouldAbortFn && shouldAbortFn()) {
+      LOG_DBG("FBP", "Parse aborted");
+      return failParse();
+    }
+
+    void* const buf = XML_GetBuffer(parser, PARSE_BUFFER_SIZE);
+    if (!buf) {
+      LOG_ERR("FBP", "Couldn't allocate memory for buffer");
+      return failParse();
+    }
+    const int len = file.read(buf, std::min<uint32_t>(remaining, PARSE_BUFFER_SIZE));
+    if (len <= 0) {
+      LOG_ERR("FBP", "File read error");
+      return failParse();
+    }
+    remaining -= len;
+    if (XML_ParseBuffer(parser, len, XML_FALSE) == XML_STATUS_ERROR) {
+      LOG_ERR("FBP", "Parse error at line %lu:\n%s", XML_GetCurrentLineNumber(parser),
+              XML_ErrorString(XML_GetErrorCode(parser)));
+      return failParse();
+    }
+  }
+  if (XML_Parse(parser, ROOT_CLOSE, sizeof(ROOT_CLOSE) - 1, XML_TRUE) == XML_STATUS_ERROR) {
+    LOG_ERR("FBP", "Parse error at section end: %s", XML_ErrorString(XML_GetErrorCode(parser)));
+    return failParse();
+  }
+  LOG_DBG("FBP", "Time to parse and build pages: %lu ms", millis() - startTime);
+
+  XML_SetElementHandler(parser, nullptr, nullptr);
+  XML_SetCharacterDataHandler(parser, nullptr);
+  XML_ParserFree(parser);
+  file.close();
+
+  // Process last page if there is still text
+  if (currentTextBlock && !currentTextBlock->isEmpty()) {
+    makePages();
+  }
+  currentTextBlock.reset();
+  if (currentPage && !currentPage->elements.empty()) {
+    completeCurrentPage();
+  }
+  return true;
+}
+
+void Fb2SectionParser::addLineToPage(ArenaPtr<TextBlock> line) {
+  const int height = lineHeight();
+  if (!currentPage) {
+    currentPage.reset(new Page());
+    currentPageNextY = 0;
+  } else if (currentPageNextY + height > viewportHeight) {
+    completeCurrentPage();
+    currentPage.reset(new Page());
+    currentPageNextY = 0;
+  }
+
+  const int16_t xOffset = line->getBlockStyle().leftInset();
+  currentPage->addGlyphGroups(renderer, fontId, *line, xOffset, currentPageNextY);
+  currentPage->elements.push_back(std::make_shared<PageLine>(std::move(line), xOffset, currentPageNextY));
+  currentPageNextY += height;
+}
+
+void Fb2SectionParser::completeCurrentPage() {
+  completePageFn(std::move(currentPage));
+  currentPage.reset();
+  arenas.pageCompleted();
+}
+
+void Fb2SectionParser::makePages() {
+  if (!currentPage) {
+    currentPage.reset(new Page());
+    currentPageNextY = 0;
+  }
+
+  const BlockStyle& blockStyle = currentTextBlock->getBlockStyle();
+  const int horizontalInset = blockStyle.totalHorizontalInset();
+  const uint16_t effectiveWidth =
+      (horizontalInset < viewportWidth) ? static_cast<uint16_t>(viewportWidth - horizontalInset) : viewportWidth;
+
+  currentTextBlock->layoutAndExtractLines(
+      renderer, fontId, effectiveWidth,
+      [this](ArenaPtr<TextBlock> textBlock) { addLineToPage(std::move(textBlock)); });
+
+  if (extraParagraphSpacing) {
+    currentPageNextY += lineHeight() / 2;
+  }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Epub/LayoutArena.h>
+#include <Epub/ParsedText.h>
+#include <expat.h>
+
+#include <climits>
+#include <functional>
+#include <memory>
+
+class Fb2;
+class GfxRenderer;
+class Page;
+class TextBlock;
+
+// Lays out one section of an FB2 file into Pages, the FB2 counterpart of ChapterHtmlSlimParser. The section's byte
+// range is read straight from the book and parsed inside a synthetic root element, so nothing is extracted first.
+// FB2 markup is fixed (no stylesheets), so every element maps directly to a block or inline style.
+class Fb2SectionParser {
+  static constexpr int MAX_WORD_SIZE = 200;
+
+  const Fb2& fb2;
+  const int sectionIndex;
+  GfxRenderer& renderer;
+  std::function<void(std::unique_ptr<Page>)> completePageFn;
+  std::function<void()> popupFn;
+  std::function<bool()> shouldAbortFn;
+  const int fontId;
+  const float lineCompression;
+  const bool extraParagraphSpacing;
+  const uint8_t paragraphAlignment;
+  const uint16_t viewportWidth;
+  const uint16_t viewportHeight;
+  const bool hyphenationEnabled;
+
+  int depth = 0;
+  int boldUntilDepth = INT_MAX;
+  int italicUntilDepth = INT_MAX;
+  int centerUntilDepth = INT_MAX;  // Titles and subtitles
+  int insetUntilDepth = INT_MAX;   // Epigraphs, citations and poems
+  char partWordBuffer[MAX_WORD_SIZE + 1] = {};
+  int partWordBufferIndex = 0;
+  bool nextWordContinues = false;
+  // Layout scratch and TextBlock storage; declared before the text block and page so it outlives both
+  SectionBuildArenas arenas;
+  std::unique_ptr<ParsedText> currentTextBlock;
+  std::unique_ptr<Page> currentPage;
+  int16_t currentPageNextY = 0;
+
+  int lineHeight() const;
+  BlockStyle blockStyleForElement(const char* name) const;
+  void flushPartWordBuffer();
+  void startNewTextBlock(const BlockStyle& blockStyle);
+  void makePages();
+  void addLineToPage(ArenaPtr<TextBlock> line);
+  void completeCurrentPage();
+  static void XMLCALL startElement(void* userData, const XML_Char* name, const XML_Char** atts);
+  static void XMLCALL endElement(void* userData, const XML_Char* name);
+  static void XMLCALL characterData(void* userData, const XML_Char* s, int len);
+
+ public:
+  Fb2SectionParser(const Fb2& fb2, int sectionIndex, GfxRenderer& renderer, int fontId, float lineCompression,
+                   bool extraParagraphSpacing, uint8_t paragraphAlignment, uint16_t viewportWidth,
+                   uint16_t viewportHeight, bool hyphenationEnabled,
+                   const std::function<void(std::unique_ptr<Page>)>& completePageFn,
+                   const std::function<void()>& popupFn = nullptr,
+                   const std::function<bool()>& shouldAbortFn = nullptr)
+      : fb2(fb2),
+        sectionIndex(sectionIndex),
+        renderer(renderer),
+        completePageFn(completePageFn),
+        popupFn(popupFn),
+        shouldAbortFn(shouldAbortFn),
+        fontId(fontId),
+        lineCompression(lineCompression),
+        extraParagraphSpacing(extraParagraphSpacing),
+        paragraphAlignment(paragraphAlignment),
+        viewportWidth(viewportWidth),
+        viewportHeight(viewportHeight),
+        hyphenationEnabled(hyphenationEnabled) {}
+
+  bool parseAndBuildPages();
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Non-owning reference to a callable, for callbacks that are only invoked while the call taking them runs (per line
+// of a layout, per chunk of a read). Unlike std::function it never allocates and calls through one plain function
+// pointer. It must not outlive the callable it refers to, so it only fits parameters, never stored members that a
+// temporary lambda could be bound to.
+template <typename Signature>
+class FunctionRef;
+
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+ public:
+  // Implicit, so a lambda can be passed where a FunctionRef parameter is expected
+  template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, FunctionRef>::value>>
+  FunctionRef(F&& callable) noexcept
+      : object(const_cast<void*>(static_cast<const void*>(std::addressof(callable)))),
+        invoke([](void* target, Args... args) -> R {
+          return (*static_cast<std::add_pointer_t<std::remove_reference_t<F>>>(target))(std::forward<Args>(args)...);
+        }) {}
+
+  R operator()(Args... args) const { return invoke(object, std::forward<Args>(args)...); }
+
+ private:
+  void* object;
+  R (*invoke)(void*, Args...);
+};
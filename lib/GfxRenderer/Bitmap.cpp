@@ -14,6 +14,9 @@ constexpr bool USE_ATKINSON = true;  // Use Atkinson dithering instead of Floyd-
 // ============================================================================
 
 Bitmap::~Bitmap() {
+  if (readBuffered && file) {
+    file.setBufferSize(0);
+  }
   delete[] errorCurRow;
   delete[] errorNextRow;
 
@@ -84,6 +87,10 @@ const char* Bitmap::errorToString(BmpReaderError err) {
 
 BmpReaderError Bitmap::parseHeaders() {
   if (!file) return BmpReaderError::FileInvalid;
+  // A full screen image is hundreds of rows; read them a block at a time
+  if (!readBuffered) {
+    readBuffered = file.setBufferSize(READ_BLOCK_SIZE);
+  }
   if (!file.seek(0)) return BmpReaderError::SeekStartFailed;
 
   // --- BMP FILE HEADER ---
@@ -66,7 +66,11 @@ class Bitmap {
 
   explicit Bitmap(FsFile& file, bool dithering = false) : file(file), dithering(dithering) {}
   ~Bitmap();
+  // Also gives the file a read-ahead buffer of READ_BLOCK_SIZE bytes (unless there's no memory for it), so the
+  // headers and rows come from a few block reads instead of a card access per row. It is dropped again with the
+  // Bitmap.
   BmpReaderError parseHeaders();
+  // Rows come in file order: bottom row first unless isTopDown()
   BmpReaderError readNextRow(uint8_t* data, uint8_t* rowBuffer) const;
   BmpReaderError rewindToData() const;
   int getWidth() const { return width; }
@@ -78,11 +82,14 @@ class Bitmap {
   uint16_t getBpp() const { return bpp; }
 
  private:
+  static constexpr size_t READ_BLOCK_SIZE = 8192;
+
   static uint16_t readLE16(FsFile& f);
   static uint32_t readLE32(FsFile& f);
 
   FsFile& file;
   bool dithering = false;
+  bool readBuffered = false;
   int width = 0;
   int height = 0;
   bool topDown = false;
@@ -14,6 +14,28 @@ int adjustPixel(int gray);
 // Populates a 1-bit BMP header in the provided memory.
 void createBmpHeader(BmpHeader* bmpHeader, int width, int height);
 
+// 2-bit level of an error diffused gray value; shown is the gray the panel actually displays for it, used for the
+// error. Original evenly spaced levels: < 43, < 128, < 213 shown as 0, 85, 170, 255.
+inline uint8_t quantizeDitherLevel(const int gray, int& shown) {
+  // Fine-tuned to the X4 eink display
+  if (gray < 30) {
+    shown = 15;
+    return 0;
+  }
+  if (gray < 50) {
+    shown = 30;
+    return 1;
+  }
+  if (gray < 140) {
+    shown = 80;
+    return 2;
+  }
+  shown = 210;
+  return 3;
+}
+
+inline int clampGray(const int gray) { return gray < 0 ? 0 : (gray > 255 ? 255 : gray); }
+
 // 1-bit Atkinson dithering - better quality than noise dithering for thumbnails
 // Error distribution pattern (same as 2-bit but quantizes to 2 levels):
 //     X  1/8 1/8
@@ -73,6 +95,37 @@ class Atkinson1BitDitherer {
     return quantized;
   }
 
+  // Dither a whole row (width gray values) into packed 1-bit pixels, MSB first, and move to the next row. Same
+  // result as processPixel() per pixel, but the errors for the pixels to the right and the row below are carried
+  // in locals, so each error entry is touched once and each output byte is written once.
+  void processRow(const uint8_t* gray, uint8_t* out) {
+    int right1 = 0, right2 = 0;  // This row's errors waiting for pixels x and x + 1
+    int below1 = 0, below2 = 0;  // Errors waiting for next row entries x + 1 and x + 2
+    uint8_t packed = 0;
+    for (int x = 0; x < width; x++) {
+      const int adjusted = clampGray(adjustPixel(gray[x]) + errorRow0[x + 2] + right1);
+      const uint8_t bit = adjusted < 128 ? 0 : 1;
+      const int error = (adjusted - (bit ? 255 : 0)) >> 3;
+
+      right1 = right2 + error;
+      right2 = error;
+      errorRow1[x + 1] += below1 + error;
+      below1 = below2 + error;
+      below2 = error;
+      errorRow2[x + 2] += error;
+
+      packed |= bit << (7 - (x & 7));
+      if ((x & 7) == 7) {
+        *out++ = packed;
+        packed = 0;
+      }
+    }
+    if (width & 7) *out = packed;
+    errorRow1[width + 1] += below1;
+    errorRow1[width + 2] += below2;
+    nextRow();
+  }
+
   void nextRow() {
     int16_t* temp = errorRow0;
     errorRow0 = errorRow1;
@@ -126,37 +179,8 @@ class AtkinsonDitherer {
     if (adjusted > 255) adjusted = 255;
 
     // Quantize to 4 levels
-    uint8_t quantized;
     int quantizedValue;
-    if (false) {  // original thresholds
-      if (adjusted < 43) {
-        quantized = 0;
-        quantizedValue = 0;
-      } else if (adjusted < 128) {
-        quantized = 1;
-        quantizedValue = 85;
-      } else if (adjusted < 213) {
-        quantized = 2;
-        quantizedValue = 170;
-      } else {
-        quantized = 3;
-        quantizedValue = 255;
-      }
-    } else {  // fine-tuned to X4 eink display
-      if (adjusted < 30) {
-        quantized = 0;
-        quantizedValue = 15;
-      } else if (adjusted < 50) {
-        quantized = 1;
-        quantizedValue = 30;
-      } else if (adjusted < 140) {
-        quantized = 2;
-        quantizedValue = 80;
-      } else {
-        quantized = 3;
-        quantizedValue = 210;
-      }
-    }
+    const uint8_t quantized = quantizeDitherLevel(adjusted, quantizedValue);
 
     // Calculate error (only distribute 6/8 = 75%)
     int error = (adjusted - quantizedValue) >> 3;  // error/8
@@ -172,6 +196,38 @@ class AtkinsonDitherer {
     return quantized;
   }
 
+  // Dither a whole row (width gray values) into packed 2-bit pixels (4 per byte, MSB first) and move to the next
+  // row. Same result as processPixel() per pixel, but the errors for the pixels to the right and the row below are
+  // carried in locals, so each error entry is touched once and each output byte is written once.
+  void processRow(const uint8_t* gray, uint8_t* out) {
+    int right1 = 0, right2 = 0;  // This row's errors waiting for pixels x and x + 1
+    int below1 = 0, below2 = 0;  // Errors waiting for next row entries x + 1 and x + 2
+    uint8_t packed = 0;
+    for (int x = 0; x < width; x++) {
+      const int adjusted = clampGray(gray[x] + errorRow0[x + 2] + right1);
+      int shown;
+      const uint8_t level = quantizeDitherLevel(adjusted, shown);
+      const int error = (adjusted - shown) >> 3;
+
+      right1 = right2 + error;
+      right2 = error;
+      errorRow1[x + 1] += below1 + error;
+      below1 = below2 + error;
+      below2 = error;
+      errorRow2[x + 2] += error;
+
+      packed |= level << (6 - (x & 3) * 2);
+      if ((x & 3) == 3) {
+        *out++ = packed;
+        packed = 0;
+      }
+    }
+    if (width & 3) *out = packed;
+    errorRow1[width + 1] += below1;
+    errorRow1[width + 2] += below2;
+    nextRow();
+  }
+
   void nextRow() {
     int16_t* temp = errorRow0;
     errorRow0 = errorRow1;
@@ -229,38 +285,9 @@ class FloydSteinbergDitherer {
     if (adjusted < 0) adjusted = 0;
     if (adjusted > 255) adjusted = 255;
 
-    // Quantize to 4 levels (0, 85, 170, 255)
-    uint8_t quantized;
+    // Quantize to 4 levels
     int quantizedValue;
-    if (false) {  // original thresholds
-      if (adjusted < 43) {
-        quantized = 0;
-        quantizedValue = 0;
-      } else if (adjusted < 128) {
-        quantized = 1;
-        quantizedValue = 85;
-      } else if (adjusted < 213) {
-        quantized = 2;
-        quantizedValue = 170;
-      } else {
-        quantized = 3;
-        quantizedValue = 255;
-      }
-    } else {  // fine-tuned to X4 eink display
-      if (adjusted < 30) {
-        quantized = 0;
-        quantizedValue = 15;
-      } else if (adjusted < 50) {
-        quantized = 1;
-        quantizedValue = 30;
-      } else if (adjusted < 140) {
-        quantized = 2;
-        quantizedValue = 80;
-      } else {
-        quantized = 3;
-        quantizedValue = 210;
-      }
-    }
+    const uint8_t quantized = quantizeDitherLevel(adjusted, quantizedValue);
 
     // Calculate error
     int error = adjusted - quantizedValue;
@@ -291,6 +318,35 @@ class FloydSteinbergDitherer {
     return quantized;
   }
 
+  // Dither a whole row (width gray values) into packed 2-bit pixels (4 per byte, MSB first) and move to the next
+  // row. Odd rows really run right to left (processPixel() leaves the order to the caller); the error for the next
+  // pixel is carried in a local and each output byte is written once.
+  void processRow(const uint8_t* gray, uint8_t* out) {
+    const bool reverse = isReverseRow();
+    const int step = reverse ? -1 : 1;
+    int ahead = 0;  // 7/16 of the previous pixel's error
+    uint8_t packed = 0;
+    for (int i = 0, x = reverse ? width - 1 : 0; i < width; i++, x += step) {
+      const int adjusted = clampGray(gray[x] + errorCurRow[x + 1] + ahead);
+      int shown;
+      const uint8_t level = quantizeDitherLevel(adjusted, shown);
+      const int error = adjusted - shown;
+
+      ahead = (error * 7) >> 4;
+      errorNextRow[x + 1 - step] += (error * 3) >> 4;
+      errorNextRow[x + 1] += (error * 5) >> 4;
+      errorNextRow[x + 1 + step] += error >> 4;
+
+      packed |= level << (6 - (x & 3) * 2);
+      // The byte is complete at its last pixel in scan order
+      if ((x & 3) == (reverse ? 0 : 3) || i == width - 1) {
+        out[x >> 2] = packed;
+        packed = 0;
+      }
+    }
+    nextRow();
+  }
+
   // Call at the end of each row to swap buffers
   void nextRow() {
     // Swap buffers
@@ -0,0 +1,250 @@
+#include "BmpRowWriter.h"
+
+#include <Logging.h>
+#include <Print.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "BitmapHelpers.h"
+
+// ============================================================================
+// IMAGE PROCESSING OPTIONS - Toggle these to test different configurations
+// ============================================================================
+constexpr bool USE_8BIT_OUTPUT = false;  // true: 8-bit grayscale (no quantization), false: 2-bit (4 levels)
+// Dithering method selection (only one should be true, or all false for simple quantization):
+constexpr bool USE_ATKINSON = true;          // Atkinson dithering (cleaner than F-S, less error diffusion)
+constexpr bool USE_FLOYD_STEINBERG = false;  // Floyd-Steinberg error diffusion (can cause "worm" artifacts)
+// ============================================================================
+
+namespace {
+inline void write16(Print& out, const uint16_t value) {
+  out.write(value & 0xFF);
+  out.write((value >> 8) & 0xFF);
+}
+
+inline void write32(Print& out, const uint32_t value) {
+  out.write(value & 0xFF);
+  out.write((value >> 8) & 0xFF);
+  out.write((value >> 16) & 0xFF);
+  out.write((value >> 24) & 0xFF);
+}
+
+inline void write32Signed(Print& out, const int32_t value) {
+  out.write(value & 0xFF);
+  out.write((value >> 8) & 0xFF);
+  out.write((value >> 16) & 0xFF);
+  out.write((value >> 24) & 0xFF);
+}
+
+// File and DIB headers of a top-down BMP, followed by its gray palette
+void writeBmpHeader(Print& bmpOut, const int width, const int height, const int bitsPerPixel, const int bytesPerRow) {
+  const uint32_t paletteSize = 1u << bitsPerPixel;
+  const uint32_t imageSize = bytesPerRow * height;
+  const uint32_t dataOffset = 14 + 40 + paletteSize * 4;
+
+  // BMP File Header (14 bytes)
+  bmpOut.write('B');
+  bmpOut.write('M');
+  write32(bmpOut, dataOffset + imageSize);  // File size
+  write32(bmpOut, 0);                       // Reserved
+  write32(bmpOut, dataOffset);              // Offset to pixel data
+
+  // DIB Header (BITMAPINFOHEADER - 40 bytes)
+  write32(bmpOut, 40);
+  write32Signed(bmpOut, width);
+  write32Signed(bmpOut, -height);  // Negative height = top-down bitmap
+  write16(bmpOut, 1);              // Color planes
+  write16(bmpOut, bitsPerPixel);   // Bits per pixel
+  write32(bmpOut, 0);              // BI_RGB (no compression)
+  write32(bmpOut, imageSize);      // Image size
+  write32(bmpOut, 2835);           // xPixelsPerMeter (72 DPI)
+  write32(bmpOut, 2835);           // yPixelsPerMeter (72 DPI)
+  write32(bmpOut, paletteSize);    // colorsUsed
+  write32(bmpOut, paletteSize);    // colorsImportant
+
+  // Evenly spaced grays, black first: 0/255 for 1-bit, 0/85/170/255 for 2-bit (BGRA)
+  for (uint32_t i = 0; i < paletteSize; i++) {
+    const auto gray = static_cast<uint8_t>(i * 255 / (paletteSize - 1));
+    bmpOut.write(gray);
+    bmpOut.write(gray);
+    bmpOut.write(gray);
+    bmpOut.write(static_cast<uint8_t>(0));
+  }
+}
+}  // namespace
+
+BmpRowWriter::~BmpRowWriter() { release(); }
+
+void BmpRowWriter::release() {
+  free(rowBuffer);
+  free(adjustedRow);
+  delete atkinsonDitherer;
+  delete fsDitherer;
+  delete atkinson1BitDitherer;
+  rowBuffer = nullptr;
+  adjustedRow = nullptr;
+  atkinsonDitherer = nullptr;
+  fsDitherer = nullptr;
+  atkinson1BitDitherer = nullptr;
+}
+
+void BmpRowWriter::getOutputSize(const BmpOutput& output, const int srcWidth, const int srcHeight, int* outWidth,
+                                 int* outHeight) {
+  *outWidth = srcWidth;
+  *outHeight = srcHeight;
+  if (output.targetWidth > 0 && output.targetHeight > 0 &&
+      (srcWidth != output.targetWidth || srcHeight != output.targetHeight)) {
+    // Fit/fill target dimensions while maintaining aspect ratio; fill (scale to the smaller ratio) when we will crop
+    GrayResampler::fitSize(srcWidth, srcHeight, output.targetWidth, output.targetHeight, output.crop, outWidth,
+                           outHeight);
+  }
+}
+
+void BmpRowWriter::writeHeader(const int outWidth, const int outHeight) {
+  if (USE_8BIT_OUTPUT && !oneBit) {
+    bytesPerRow = (outWidth + 3) / 4 * 4;
+    writeBmpHeader(*out, outWidth, outHeight, 8, bytesPerRow);
+  } else if (oneBit) {
+    bytesPerRow = (outWidth + 31) / 32 * 4;  // 1 bit per pixel, round up to 4-byte boundary
+    writeBmpHeader(*out, outWidth, outHeight, 1, bytesPerRow);
+  } else {
+    bytesPerRow = (outWidth * 2 + 31) / 32 * 4;  // 2 bits per pixel, round up
+    writeBmpHeader(*out, outWidth, outHeight, 2, bytesPerRow);
+  }
+}
+
+bool BmpRowWriter::begin(const BmpOutput& output, const int rowWidth, const int rowHeight, const int outWidth,
+                         const int outHeight) {
+  release();
+  out = output.out;
+  oneBit = output.oneBit;
+  width = outWidth;
+  if (!out || !resampler.begin(rowWidth, rowHeight, outWidth, outHeight)) {
+    return false;
+  }
+
+  writeHeader(outWidth, outHeight);
+
+  // Packed output and the adjusted gray row fed to the ditherer
+  rowBuffer = static_cast<uint8_t*>(malloc(bytesPerRow));
+  adjustedRow = static_cast<uint8_t*>(malloc(outWidth));
+  if (!rowBuffer || !adjustedRow) {
+    LOG_ERR("BMP", "Failed to allocate row buffer");
+    release();
+    return false;
+  }
+
+  // Dither at the output size (after prescaling)
+  if (oneBit) {
+    // For 1-bit output, use Atkinson dithering for better quality
+    atkinson1BitDitherer = new (std::nothrow) Atkinson1BitDitherer(outWidth);
+  } else if (!USE_8BIT_OUTPUT) {
+    if (USE_ATKINSON) {
+      atkinsonDitherer = new (std::nothrow) AtkinsonDitherer(outWidth);
+    } else if (USE_FLOYD_STEINBERG) {
+      fsDitherer = new (std::nothrow) FloydSteinbergDitherer(outWidth);
+    }
+  }
+
+  writeRow = [this](const int y, const uint8_t* gray) { return writeScaledRow(y, gray); };
+  return true;
+}
+
+bool BmpRowWriter::writeScaledRow(const int y, const uint8_t* gray) {
+  memset(rowBuffer, 0, bytesPerRow);
+
+  if (USE_8BIT_OUTPUT && !oneBit) {
+    for (int x = 0; x < width; x++) {
+      rowBuffer[x] = adjustPixel(gray[x]);
+    }
+  } else if (oneBit) {
+    // 1-bit output with Atkinson dithering for better quality, packed a row at a time
+    if (atkinson1BitDitherer) {
+      atkinson1BitDitherer->processRow(gray, rowBuffer);
+    } else {
+      for (int x = 0; x < width; x++) {
+        rowBuffer[x / 8] |= quantize1bit(gray[x], x, y) << (7 - (x % 8));
+      }
+    }
+  } else {
+    // 2-bit output
+    for (int x = 0; x < width; x++) {
+      adjustedRow[x] = adjustPixel(gray[x]);
+    }
+    if (atkinsonDitherer) {
+      atkinsonDitherer->processRow(adjustedRow, rowBuffer);
+    } else if (fsDitherer) {
+      fsDitherer->processRow(adjustedRow, rowBuffer);
+    } else {
+      for (int x = 0; x < width; x++) {
+        rowBuffer[x / 4] |= quantize(adjustedRow[x], x, y) << (6 - (x % 4) * 2);
+      }
+    }
+  }
+
+  out->write(rowBuffer, bytesPerRow);
+  return true;
+}
+
+bool BmpRowWriter::pushRow(const uint8_t* gray) { return rowBuffer && resampler.pushRow(gray, writeRow); }
+
+bool BmpRowWriter::finish() {
+  const bool ok = rowBuffer && resampler.finish(writeRow);
+  release();
+  return ok;
+}
+
+BmpOutputSet::BmpOutputSet(const BmpOutput* outputs, const int count)
+    : outputs(outputs), count(count < MAX_OUTPUTS ? count : MAX_OUTPUTS) {}
+
+bool BmpOutputSet::begin(const int srcWidth, const int srcHeight, const bool reduce) {
+  if (count <= 0) {
+    return false;
+  }
+
+  int outWidths[MAX_OUTPUTS];
+  int outHeights[MAX_OUTPUTS];
+  rowWidth = 0;
+  rowHeight = 0;
+  for (int i = 0; i < count; i++) {
+    BmpRowWriter::getOutputSize(outputs[i], srcWidth, srcHeight, &outWidths[i], &outHeights[i]);
+    rowWidth = outWidths[i] > rowWidth ? outWidths[i] : rowWidth;
+    rowHeight = outHeights[i] > rowHeight ? outHeights[i] : rowHeight;
+    LOG_DBG("BMP", "Output %d: %dx%d -> %dx%d (%s)", i, srcWidth, srcHeight, outWidths[i], outHeights[i],
+            outputs[i].oneBit ? "1-bit" : "2-bit");
+  }
+
+  // The outputs share an aspect ratio, so rows at the largest output size only ever shrink for the others. Never
+  // larger than the image though: upscaled outputs repeat source pixels themselves.
+  if (!reduce || rowWidth > srcWidth || rowHeight > srcHeight) {
+    rowWidth = srcWidth;
+    rowHeight = srcHeight;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (!writers[i].begin(outputs[i], rowWidth, rowHeight, outWidths[i], outHeights[i])) {
+      LOG_ERR("BMP", "Failed to start output %d", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BmpOutputSet::pushRow(int /*y*/, const uint8_t* gray) {
+  for (int i = 0; i < count; i++) {
+    if (!writers[i].pushRow(gray)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BmpOutputSet::finish() {
+  bool ok = true;
+  for (int i = 0; i < count; i++) {
+    ok = writers[i].finish() && ok;
+  }
+  return ok;
+}
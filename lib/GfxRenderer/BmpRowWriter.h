@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+#include "GrayResampler.h"
+
+class AtkinsonDitherer;
+class Atkinson1BitDitherer;
+class FloydSteinbergDitherer;
+class Print;
+
+// One BMP produced from a decoded image
+struct BmpOutput {
+  // Max size for cover images (portrait display size)
+  static constexpr int COVER_MAX_WIDTH = 480;
+  static constexpr int COVER_MAX_HEIGHT = 800;
+
+  Print* out = nullptr;
+  int targetWidth = 0;  // 0 keeps the image size
+  int targetHeight = 0;
+  bool oneBit = false;
+  bool crop = true;  // Fill the target instead of fitting inside it
+
+  // 2-bit sleep screen cover
+  static BmpOutput cover(Print& out, bool crop) { return {&out, COVER_MAX_WIDTH, COVER_MAX_HEIGHT, false, crop}; }
+  // 1-bit home screen thumbnail (no gray passes needed), filling a card of the given height
+  static BmpOutput thumbnail(Print& out, const int height) { return {&out, height * 3 / 5, height, true, true}; }
+};
+
+// Scales gray rows to one output's size, dithers them and writes the BMP, a row at a time
+class BmpRowWriter {
+ public:
+  BmpRowWriter() = default;
+  ~BmpRowWriter();
+  BmpRowWriter(const BmpRowWriter&) = delete;
+  BmpRowWriter& operator=(const BmpRowWriter&) = delete;
+
+  // Size of the BMP written for a srcWidth x srcHeight image
+  static void getOutputSize(const BmpOutput& output, int srcWidth, int srcHeight, int* outWidth, int* outHeight);
+
+  // Writes the header of an outWidth x outHeight BMP that gets rowWidth x rowHeight source rows
+  bool begin(const BmpOutput& output, int rowWidth, int rowHeight, int outWidth, int outHeight);
+  bool pushRow(const uint8_t* gray);
+  bool finish();
+
+ private:
+  Print* out = nullptr;
+  bool oneBit = false;
+  int width = 0;
+  int bytesPerRow = 0;
+  GrayResampler resampler;
+  GrayResampler::RowCallback writeRow;
+  uint8_t* rowBuffer = nullptr;
+  uint8_t* adjustedRow = nullptr;
+  AtkinsonDitherer* atkinsonDitherer = nullptr;
+  FloydSteinbergDitherer* fsDitherer = nullptr;
+  Atkinson1BitDitherer* atkinson1BitDitherer = nullptr;
+
+  void writeHeader(int outWidth, int outHeight);
+  bool writeScaledRow(int y, const uint8_t* gray);
+  void release();
+};
+
+// Several BMPs written from one decode: every output gets the same rows and keeps its own scaler and ditherer, so
+// the source only has to be read and decoded once
+class BmpOutputSet {
+ public:
+  static constexpr int MAX_OUTPUTS = 6;
+
+  BmpOutputSet(const BmpOutput* outputs, int count);
+
+  // Sizes the outputs for a srcWidth x srcHeight image and writes their headers. Decoders that can shrink while
+  // decoding (reduce) may produce rows at getRowWidth() x getRowHeight(), the largest output; others push
+  // source-sized rows.
+  bool begin(int srcWidth, int srcHeight, bool reduce);
+  int getRowWidth() const { return rowWidth; }
+  int getRowHeight() const { return rowHeight; }
+
+  // Called with each row, top to bottom; has the GrayResampler::RowCallback signature
+  bool pushRow(int y, const uint8_t* gray);
+  bool finish();
+
+ private:
+  const BmpOutput* outputs;
+  int count;
+  int rowWidth = 0;
+  int rowHeight = 0;
+  BmpRowWriter writers[MAX_OUTPUTS];
+};
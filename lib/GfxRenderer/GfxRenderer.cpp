@@ -1,8 +1,15 @@
 #include "GfxRenderer.h"
 
+#include <HotPath.h>
 #include <Logging.h>
+#include <PackBits.h>
+#include <Trace.h>
 #include <Utf8.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
 const uint8_t* GfxRenderer::getGlyphBitmap(const EpdFontData* fontData, const EpdGlyph* glyph) const {
   if (fontData->groups != nullptr) {
     if (!fontDecompressor) {
@@ -15,6 +22,54 @@ const uint8_t* GfxRenderer::getGlyphBitmap(const EpdFontData* fontData, const Ep
   return &fontData->bitmap[glyph->dataOffset];
 }
 
+uint32_t GfxRenderer::getGlyphGroupMask(const int fontId, const char* text, const EpdFontFamily::Style style) const {
+  if (text == nullptr) {
+    return 0;
+  }
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
+    return 0;
+  }
+  const auto& font = *family;
+  const EpdFontData* fontData = font.getData(style);
+  if (fontData->groups == nullptr) {
+    return 0;
+  }
+
+  uint32_t mask = 0;
+  uint32_t cp;
+  while ((cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&text)))) {
+    if (!utf8IsCombiningMark(cp)) {
+      cp = font.applyLigatures(cp, text, style);
+    }
+    const EpdGlyph* glyph = font.getGlyph(cp, style);
+    if (!glyph) {
+      continue;
+    }
+    const uint16_t group = FontDecompressor::getGroupIndex(fontData, static_cast<uint16_t>(glyph - fontData->glyph));
+    if (group < 32) {
+      mask |= 1u << group;
+    }
+  }
+  return mask;
+}
+
+void GfxRenderer::prefetchGlyphGroups(const int fontId, const EpdFontFamily::Style style, uint32_t groupMask) const {
+  if (!fontDecompressor || groupMask == 0) {
+    return;
+  }
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
+    return;
+  }
+  const EpdFontData* fontData = family->getData(style);
+  for (uint16_t group = 0; groupMask != 0; group++, groupMask >>= 1) {
+    if (groupMask & 1) {
+      fontDecompressor->prefetchGroup(fontData, group);
+    }
+  }
+}
+
 void GfxRenderer::begin() {
   frameBuffer = display.getFrameBuffer();
   if (!frameBuffer) {
@@ -23,7 +78,53 @@ void GfxRenderer::begin() {
   }
 }
 
-void GfxRenderer::insertFont(const int fontId, EpdFontFamily font) { fontMap.insert({fontId, font}); }
+void GfxRenderer::insertFont(const int fontId, EpdFontFamily font) {
+  if (findFont(fontId)) {
+    return;
+  }
+  if (fontCount == MAX_FONTS) {
+    LOG_ERR("GFX", "Font table full, dropping font %d", fontId);
+    return;
+  }
+  fonts[fontCount++] = {fontId, font};
+}
+
+void GfxRenderer::removeFont(const int fontId) {
+  for (size_t i = 0; i < fontCount; i++) {
+    if (fonts[i].id == fontId) {
+      fonts[i] = fonts[--fontCount];
+      fonts[fontCount] = {};
+      // Cached groups are keyed by font data address, which a font loaded later may reuse
+      clearFontCache();
+      return;
+    }
+  }
+}
+
+void GfxRenderer::enableGlyphAtlas(const int fontId) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
+    return;
+  }
+  for (const auto style : {EpdFontFamily::REGULAR, EpdFontFamily::BOLD, EpdFontFamily::ITALIC,
+                           EpdFontFamily::BOLD_ITALIC}) {
+    glyphAtlas.addFont(family->getData(style));
+  }
+}
+
+const EpdFontFamily* GfxRenderer::findFont(const int fontId) const {
+  const size_t hint = lastFontSlot.load(std::memory_order_relaxed);
+  if (hint < fontCount && fonts[hint].id == fontId) {
+    return &fonts[hint].family;
+  }
+  for (size_t i = 0; i < fontCount; i++) {
+    if (fonts[i].id == fontId) {
+      lastFontSlot.store(i, std::memory_order_relaxed);
+      return &fonts[i].family;
+    }
+  }
+  return nullptr;
+}
 
 // Translate logical (x,y) coordinates to physical panel coordinates based on current orientation
 // This should always be inlined for better performance
@@ -59,14 +160,259 @@ static inline void rotateCoordinates(const GfxRenderer::Orientation orientation,
   }
 }
 
+// Inverse of rotateCoordinates
+static inline void unrotateCoordinates(const GfxRenderer::Orientation orientation, const int phyX, const int phyY,
+                                       int* x, int* y) {
+  switch (orientation) {
+    case GfxRenderer::Portrait:
+      *x = HalDisplay::DISPLAY_HEIGHT - 1 - phyY;
+      *y = phyX;
+      break;
+    case GfxRenderer::LandscapeClockwise:
+      *x = HalDisplay::DISPLAY_WIDTH - 1 - phyX;
+      *y = HalDisplay::DISPLAY_HEIGHT - 1 - phyY;
+      break;
+    case GfxRenderer::PortraitInverted:
+      *x = phyY;
+      *y = HalDisplay::DISPLAY_WIDTH - 1 - phyX;
+      break;
+    case GfxRenderer::LandscapeCounterClockwise:
+      *x = phyX;
+      *y = phyY;
+      break;
+  }
+}
+
+// Framebuffer cursor that walks one logical row, left to right. Stepping to the next logical pixel is a fixed
+// pointer/mask move per orientation, so blitting a glyph needs no per-pixel rotation, bounds checks or divisions.
+template <GfxRenderer::Orientation orientation>
+struct LogicalRowCursor {
+  uint8_t* ptr;
+  uint8_t mask;
+
+  LogicalRowCursor(uint8_t* frameBuffer, const int x, const int y) {
+    int phyX, phyY;
+    rotateCoordinates(orientation, x, y, &phyX, &phyY);
+    ptr = frameBuffer + phyY * HalDisplay::DISPLAY_WIDTH_BYTES + (phyX >> 3);
+    mask = 0x80 >> (phyX & 7);
+  }
+
+  void write(const bool state) const {
+    if (state) {
+      *ptr &= ~mask;  // Clear bit
+    } else {
+      *ptr |= mask;  // Set bit
+    }
+  }
+
+  // Same position in the chunked MSB side buffer of GRAYSCALE_PLANES mode
+  void writeMsbPlane(uint8_t* const* msbChunks, const uint8_t* frameBuffer, const size_t chunkSize) const {
+    const size_t byteIndex = ptr - frameBuffer;
+    msbChunks[byteIndex / chunkSize][byteIndex % chunkSize] |= mask;
+  }
+
+  void next() {
+    if constexpr (orientation == GfxRenderer::Portrait) {
+      ptr -= HalDisplay::DISPLAY_WIDTH_BYTES;  // logical x+1 -> physical y-1
+    } else if constexpr (orientation == GfxRenderer::PortraitInverted) {
+      ptr += HalDisplay::DISPLAY_WIDTH_BYTES;  // logical x+1 -> physical y+1
+    } else if constexpr (orientation == GfxRenderer::LandscapeCounterClockwise) {
+      mask >>= 1;  // logical x+1 -> physical x+1
+      if (!mask) {
+        mask = 0x80;
+        ptr++;
+      }
+    } else {
+      mask <<= 1;  // logical x+1 -> physical x-1
+      if (!mask) {
+        mask = 0x01;
+        ptr--;
+      }
+    }
+  }
+};
+
+// Glyph blitter for the common case of upright text fully inside the screen, see renderCharImpl for the pixel rules.
+template <GfxRenderer::Orientation orientation>
+static void HOT_PATH blitGlyph(uint8_t* frameBuffer, uint8_t* const* msbChunks, const size_t msbChunkSize,
+                               const GfxRenderer::RenderMode renderMode, const uint8_t* bitmap, const bool is2Bit,
+                               const int x, const int y, const int width, const int height, const bool pixelState) {
+  int pixelPosition = 0;
+  for (int glyphY = 0; glyphY < height; glyphY++) {
+    LogicalRowCursor<orientation> cursor(frameBuffer, x, y + glyphY);
+    if (is2Bit) {
+      for (int glyphX = 0; glyphX < width; glyphX++, pixelPosition++, cursor.next()) {
+        const uint8_t bmpVal = 3 - ((bitmap[pixelPosition >> 2] >> ((3 - (pixelPosition & 3)) * 2)) & 0x3);
+        if (renderMode == GfxRenderer::BW && bmpVal < 3) {
+          cursor.write(pixelState);
+        } else if (renderMode == GfxRenderer::GRAYSCALE_MSB && (bmpVal == 1 || bmpVal == 2)) {
+          cursor.write(false);
+        } else if (renderMode == GfxRenderer::GRAYSCALE_LSB && bmpVal == 1) {
+          cursor.write(false);
+        } else if (renderMode == GfxRenderer::GRAYSCALE_PLANES && (bmpVal == 1 || bmpVal == 2)) {
+          if (bmpVal == 1) {
+            cursor.write(false);
+          }
+          cursor.writeMsbPlane(msbChunks, frameBuffer, msbChunkSize);
+        }
+      }
+    } else {
+      for (int glyphX = 0; glyphX < width; glyphX++, pixelPosition++, cursor.next()) {
+        if ((bitmap[pixelPosition >> 3] >> (7 - (pixelPosition & 7))) & 1) {
+          cursor.write(pixelState);
+        }
+      }
+    }
+  }
+}
+
+// Returns false if the glyph is (partially) off screen and has to go through the bounds-checked drawPixel path.
+static bool HOT_PATH blitGlyphFast(const GfxRenderer& renderer, const GfxRenderer::RenderMode renderMode,
+                                   const uint8_t* bitmap, const bool is2Bit, const int x, const int y,
+                                   const int width, const int height, const bool pixelState) {
+  if (x < 0 || y < 0 || x + width > renderer.getScreenWidth() || y + height > renderer.getScreenHeight()) {
+    return false;
+  }
+
+  uint8_t* frameBuffer = renderer.getFrameBuffer();
+  uint8_t* const* msbChunks = renderer.getMsbPlaneChunks();
+  constexpr size_t chunkSize = GfxRenderer::getBwBufferChunkSize();
+  switch (renderer.getOrientation()) {
+    case GfxRenderer::Portrait:
+      blitGlyph<GfxRenderer::Portrait>(frameBuffer, msbChunks, chunkSize, renderMode, bitmap, is2Bit, x, y, width,
+                                       height, pixelState);
+      break;
+    case GfxRenderer::LandscapeClockwise:
+      blitGlyph<GfxRenderer::LandscapeClockwise>(frameBuffer, msbChunks, chunkSize, renderMode, bitmap, is2Bit, x, y,
+                                                 width, height, pixelState);
+      break;
+    case GfxRenderer::PortraitInverted:
+      blitGlyph<GfxRenderer::PortraitInverted>(frameBuffer, msbChunks, chunkSize, renderMode, bitmap, is2Bit, x, y,
+                                               width, height, pixelState);
+      break;
+    case GfxRenderer::LandscapeCounterClockwise:
+      blitGlyph<GfxRenderer::LandscapeCounterClockwise>(frameBuffer, msbChunks, chunkSize, renderMode, bitmap, is2Bit,
+                                                        x, y, width, height, pixelState);
+      break;
+  }
+  return true;
+}
+
+// Atlas spans: one per physical row the glyph covers, holding its pixels in ascending physical x, MSB first. Portrait
+// orientations put a glyph column on a physical row, landscape ones a glyph row.
+static bool atlasSpansAreColumns(const GfxRenderer::Orientation orientation) {
+  return orientation == GfxRenderer::Portrait || orientation == GfxRenderer::PortraitInverted;
+}
+
+static void buildAtlasSpans(const GfxRenderer::Orientation orientation, const uint8_t* bitmap, const int width,
+                            const int height, uint8_t* spans) {
+  const int spanBytes = ((atlasSpansAreColumns(orientation) ? height : width) + 7) / 8;
+  int pixelPosition = 0;
+  for (int glyphY = 0; glyphY < height; glyphY++) {
+    for (int glyphX = 0; glyphX < width; glyphX++, pixelPosition++) {
+      if (!((bitmap[pixelPosition >> 3] >> (7 - (pixelPosition & 7))) & 1)) {
+        continue;
+      }
+      int span, bit;
+      switch (orientation) {
+        case GfxRenderer::Portrait:
+          span = glyphX;
+          bit = glyphY;
+          break;
+        case GfxRenderer::PortraitInverted:
+          span = glyphX;
+          bit = height - 1 - glyphY;
+          break;
+        case GfxRenderer::LandscapeCounterClockwise:
+          span = glyphY;
+          bit = glyphX;
+          break;
+        case GfxRenderer::LandscapeClockwise:
+        default:
+          span = glyphY;
+          bit = width - 1 - glyphX;
+          break;
+      }
+      spans[span * spanBytes + (bit >> 3)] |= 0x80 >> (bit & 7);
+    }
+  }
+}
+
+bool GfxRenderer::drawAtlasGlyph(const EpdFontData* fontData, const EpdGlyph* glyph, const int x, const int y,
+                                 const bool pixelState) const {
+  const int width = glyph->width;
+  const int height = glyph->height;
+  if (!glyphAtlas.covers(fontData) || x < 0 || y < 0 || x + width > getScreenWidth() ||
+      y + height > getScreenHeight()) {
+    return false;
+  }
+  const bool columns = atlasSpansAreColumns(orientation);
+  const int spanCount = columns ? width : height;
+  const int spanBits = columns ? height : width;
+  const int spanBytes = (spanBits + 7) / 8;
+  if (spanCount == 0 || spanBits == 0) {
+    return true;
+  }
+
+  const uint8_t* spans = glyphAtlas.find(glyph, orientation);
+  if (!spans) {
+    const uint8_t* bitmap = getGlyphBitmap(fontData, glyph);
+    uint8_t* entry = bitmap ? glyphAtlas.insert(glyph, orientation, spanCount * spanBytes) : nullptr;
+    if (!entry) {
+      return false;
+    }
+    buildAtlasSpans(orientation, bitmap, width, height, entry);
+    spans = entry;
+  }
+
+  for (int span = 0; span < spanCount; span++, spans += spanBytes) {
+    // Physical row and first physical x of the span, from rotateCoordinates
+    int phyY, phyX;
+    switch (orientation) {
+      case Portrait:
+        phyY = HalDisplay::DISPLAY_HEIGHT - 1 - (x + span);
+        phyX = y;
+        break;
+      case PortraitInverted:
+        phyY = x + span;
+        phyX = HalDisplay::DISPLAY_WIDTH - 1 - (y + height - 1);
+        break;
+      case LandscapeCounterClockwise:
+        phyY = y + span;
+        phyX = x;
+        break;
+      case LandscapeClockwise:
+      default:
+        phyY = HalDisplay::DISPLAY_HEIGHT - 1 - (y + span);
+        phyX = HalDisplay::DISPLAY_WIDTH - 1 - (x + width - 1);
+        break;
+    }
+    uint8_t* row = frameBuffer + phyY * HalDisplay::DISPLAY_WIDTH_BYTES;
+    const int shift = phyX & 7;
+    const int lastByte = (phyX + spanBits - 1) >> 3;
+    uint8_t carry = 0;
+    for (int byte = phyX >> 3, i = 0; byte <= lastByte; byte++, i++) {
+      const uint8_t source = i < spanBytes ? spans[i] : 0;
+      const uint8_t bits = (source >> shift) | carry;
+      carry = shift ? static_cast<uint8_t>(source << (8 - shift)) : 0;
+      if (pixelState) {
+        row[byte] &= ~bits;
+      } else {
+        row[byte] |= bits;
+      }
+    }
+  }
+  return true;
+}
+
 enum class TextRotation { None, Rotated90CW };
 
 // Shared glyph rendering logic for normal and rotated text.
 // Coordinate mapping and cursor advance direction are selected at compile time via the template parameter.
 template <TextRotation rotation>
-static void renderCharImpl(const GfxRenderer& renderer, GfxRenderer::RenderMode renderMode,
-                           const EpdFontFamily& fontFamily, const uint32_t cp, int* cursorX, int* cursorY,
-                           const bool pixelState, const EpdFontFamily::Style style) {
+static void HOT_PATH renderCharImpl(const GfxRenderer& renderer, GfxRenderer::RenderMode renderMode,
+                                    const EpdFontFamily& fontFamily, const uint32_t cp, int* cursorX, int* cursorY,
+                                    const bool pixelState, const EpdFontFamily::Style style) {
   const EpdGlyph* glyph = fontFamily.getGlyph(cp, style);
   if (!glyph) {
     LOG_ERR("GFX", "No glyph for codepoint %d", cp);
@@ -80,6 +426,13 @@ static void renderCharImpl(const GfxRenderer& renderer, GfxRenderer::RenderMode
   const int left = glyph->left;
   const int top = glyph->top;
 
+  if constexpr (rotation == TextRotation::None) {
+    if (!is2Bit && renderer.drawAtlasGlyph(fontData, glyph, *cursorX + left, *cursorY - top, pixelState)) {
+      *cursorX += glyph->advanceX;
+      return;
+    }
+  }
+
   const uint8_t* bitmap = renderer.getGlyphBitmap(fontData, glyph);
 
   if (bitmap != nullptr) {
@@ -92,6 +445,11 @@ static void renderCharImpl(const GfxRenderer& renderer, GfxRenderer::RenderMode
     } else {
       outerBase = *cursorY - top;   // screenY = outerBase + glyphY
       innerBase = *cursorX + left;  // screenX = innerBase + glyphX
+
+      if (blitGlyphFast(renderer, renderMode, bitmap, is2Bit, innerBase, outerBase, width, height, pixelState)) {
+        *cursorX += glyph->advanceX;
+        return;
+      }
     }
 
     if (is2Bit) {
@@ -125,6 +483,12 @@ static void renderCharImpl(const GfxRenderer& renderer, GfxRenderer::RenderMode
           } else if (renderMode == GfxRenderer::GRAYSCALE_LSB && bmpVal == 1) {
             // Dark gray
             renderer.drawPixel(screenX, screenY, false);
+          } else if (renderMode == GfxRenderer::GRAYSCALE_PLANES && (bmpVal == 1 || bmpVal == 2)) {
+            // Both of the above in one pass: LSB in the frame buffer, MSB in the side buffer
+            if (bmpVal == 1) {
+              renderer.drawPixel(screenX, screenY, false);
+            }
+            renderer.drawMsbPlanePixel(screenX, screenY);
           }
         }
       }
@@ -162,7 +526,7 @@ static void renderCharImpl(const GfxRenderer& renderer, GfxRenderer::RenderMode
 
 // IMPORTANT: This function is in critical rendering path and is called for every pixel. Please keep it as simple and
 // efficient as possible.
-void GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
+void HOT_PATH GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
   int phyX = 0;
   int phyY = 0;
 
@@ -187,14 +551,20 @@ void GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
 }
 
 int GfxRenderer::getTextWidth(const int fontId, const char* text, const EpdFontFamily::Style style) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return 0;
   }
 
-  int w = 0, h = 0;
-  fontIt->second.getTextDimensions(text, &w, &h, style);
+  const uint64_t key = TextWidthCache::makeKey(fontId, style, TextWidthCache::BOUNDS, text);
+  int w = 0;
+  if (textWidthCache.lookup(key, &w)) {
+    return w;
+  }
+  int h = 0;
+  family->getTextDimensions(text, &w, &h, style);
+  textWidthCache.store(key, w);
   return w;
 }
 
@@ -206,29 +576,48 @@ void GfxRenderer::drawCenteredText(const int fontId, const int y, const char* te
 
 void GfxRenderer::drawText(const int fontId, const int x, const int y, const char* text, const bool black,
                            const EpdFontFamily::Style style) const {
-  int yPos = y + getFontAscenderSize(fontId);
-  int xPos = x;
-  int lastBaseX = x;
-  int lastBaseY = yPos;
-  int lastBaseAdvance = 0;
-  int lastBaseTop = 0;
-
   // cannot draw a NULL / empty string
   if (text == nullptr || *text == '\0') {
     return;
   }
 
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
+    LOG_ERR("GFX", "Font %d not found", fontId);
+    return;
+  }
+  drawTextWith(*family, x, y + family->getData(EpdFontFamily::REGULAR)->ascender, text, black, style);
+}
+
+void GfxRenderer::drawTextRun(const int fontId, const int y, const TextRunItem* items, const size_t count,
+                              const bool black) const {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return;
   }
-  const auto& font = fontIt->second;
+  const int baseline = y + family->getData(EpdFontFamily::REGULAR)->ascender;
+  for (size_t i = 0; i < count; i++) {
+    if (items[i].text && *items[i].text != '\0') {
+      drawTextWith(*family, items[i].x, baseline, items[i].text, black, items[i].style);
+    }
+  }
+}
+
+void GfxRenderer::drawTextWith(const EpdFontFamily& font, const int x, const int baseline, const char* text,
+                               const bool black, const EpdFontFamily::Style style) const {
+  int yPos = baseline;
+  int xPos = x;
+  int lastBaseX = x;
+  int lastBaseY = yPos;
+  int lastBaseAdvance = 0;
+  int lastBaseTop = 0;
   constexpr int MIN_COMBINING_GAP_PX = 1;
 
-  uint32_t cp;
   uint32_t prevCp = 0;
-  while ((cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&text)))) {
+  const Utf8Codepoints codepoints(text);
+  for (const uint32_t* next = codepoints.begin(); next < codepoints.end();) {
+    uint32_t cp = *next++;
     if (utf8IsCombiningMark(cp)) {
       const EpdGlyph* combiningGlyph = font.getGlyph(cp, style);
       int raiseBy = 0;
@@ -245,7 +634,7 @@ void GfxRenderer::drawText(const int fontId, const int x, const int y, const cha
       continue;
     }
 
-    cp = font.applyLigatures(cp, text, style);
+    cp = font.applyLigatures(cp, next, codepoints.end(), style);
     if (prevCp != 0) {
       xPos += font.getKerning(prevCp, cp, style);
     }
@@ -267,16 +656,12 @@ void GfxRenderer::drawLine(int x1, int y1, int x2, int y2, const bool state) con
     if (y2 < y1) {
       std::swap(y1, y2);
     }
-    for (int y = y1; y <= y2; y++) {
-      drawPixel(x1, y, state);
-    }
+    fillRect(x1, y1, 1, y2 - y1 + 1, state);
   } else if (y1 == y2) {
     if (x2 < x1) {
       std::swap(x1, x2);
     }
-    for (int x = x1; x <= x2; x++) {
-      drawPixel(x, y1, state);
-    }
+    fillRect(x1, y1, x2 - x1 + 1, 1, state);
   } else {
     // Bresenham's line algorithm — integer arithmetic only
     int dx = x2 - x1;
@@ -304,6 +689,10 @@ void GfxRenderer::drawLine(int x1, int y1, int x2, int y2, const bool state) con
 }
 
 void GfxRenderer::drawLine(int x1, int y1, int x2, int y2, const int lineWidth, const bool state) const {
+  if (y1 == y2) {
+    fillRect(std::min(x1, x2), y1, std::abs(x2 - x1) + 1, lineWidth, state);
+    return;
+  }
   for (int i = 0; i < lineWidth; i++) {
     drawLine(x1, y1 + i, x2, y2 + i, state);
   }
@@ -333,15 +722,18 @@ void GfxRenderer::drawArc(const int maxRadius, const int cx, const int cy, const
   const int innerRadius = std::max(maxRadius - stroke, 0);
   const int outerRadiusSq = maxRadius * maxRadius;
   const int innerRadiusSq = innerRadius * innerRadius;
+  // Per row the ring covers one run of dx, whose ends only move inwards as dy grows
+  int minDx = innerRadius;
+  int maxDx = maxRadius;
   for (int dy = 0; dy <= maxRadius; ++dy) {
-    for (int dx = 0; dx <= maxRadius; ++dx) {
-      const int distSq = dx * dx + dy * dy;
-      if (distSq > outerRadiusSq || distSq < innerRadiusSq) {
-        continue;
-      }
-      const int px = cx + xDir * dx;
-      const int py = cy + yDir * dy;
-      drawPixel(px, py, state);
+    while (minDx > 0 && (minDx - 1) * (minDx - 1) + dy * dy >= innerRadiusSq) {
+      minDx--;
+    }
+    while (maxDx * maxDx + dy * dy > outerRadiusSq) {
+      maxDx--;
+    }
+    if (minDx <= maxDx) {
+      fillRect(xDir > 0 ? cx + minDx : cx - maxDx, cy + yDir * dy, maxDx - minDx + 1, 1, state);
     }
   }
 };
@@ -404,37 +796,48 @@ void GfxRenderer::drawRoundedRect(const int x, const int y, const int width, con
   }
 }
 
-void GfxRenderer::fillRect(const int x, const int y, const int width, const int height, const bool state) const {
-  for (int fillY = y; fillY < y + height; fillY++) {
-    drawLine(x, fillY, x + width - 1, fillY, state);
+// A logical rect is a panel rect in every orientation, so fills are written as byte spans along the panel rows. The
+// pattern byte of a row goes into every byte it covers, which works for the dither patterns too since their period
+// of two divides eight. Parts outside the screen are clipped.
+void GfxRenderer::fillPanelRect(int x, int y, int width, int height, const uint8_t rowPatterns[2]) const {
+  if (x < 0) {
+    width += x;
+    x = 0;
+  }
+  if (y < 0) {
+    height += y;
+    y = 0;
+  }
+  width = std::min(width, getScreenWidth() - x);
+  height = std::min(height, getScreenHeight() - y);
+  if (width <= 0 || height <= 0) {
+    return;
   }
-}
-
-// NOTE: Those are in critical path, and need to be templated to avoid runtime checks for every pixel.
-// Any branching must be done outside the loops to avoid performance degradation.
-template <>
-void GfxRenderer::drawPixelDither<Color::Clear>(const int x, const int y) const {
-  // Do nothing
-}
-
-template <>
-void GfxRenderer::drawPixelDither<Color::Black>(const int x, const int y) const {
-  drawPixel(x, y, true);
-}
-
-template <>
-void GfxRenderer::drawPixelDither<Color::White>(const int x, const int y) const {
-  drawPixel(x, y, false);
-}
 
-template <>
-void GfxRenderer::drawPixelDither<Color::LightGray>(const int x, const int y) const {
-  drawPixel(x, y, x % 2 == 0 && y % 2 == 0);
+  int phyX, phyY, phyWidth, phyHeight;
+  getPanelRect(x, y, width, height, &phyX, &phyY, &phyWidth, &phyHeight);
+  const int firstByte = phyX >> 3;
+  const int lastByte = (phyX + phyWidth - 1) >> 3;
+  const uint8_t headMask = 0xFF >> (phyX & 7);
+  const uint8_t tailMask = 0xFF << (7 - ((phyX + phyWidth - 1) & 7));
+  for (int row = phyY; row < phyY + phyHeight; row++) {
+    const uint8_t pattern = rowPatterns[row & 1];
+    uint8_t* line = frameBuffer + row * HalDisplay::DISPLAY_WIDTH_BYTES;
+    if (firstByte == lastByte) {
+      const uint8_t mask = headMask & tailMask;
+      line[firstByte] = (line[firstByte] & ~mask) | (pattern & mask);
+      continue;
+    }
+    line[firstByte] = (line[firstByte] & ~headMask) | (pattern & headMask);
+    memset(line + firstByte + 1, pattern, lastByte - firstByte - 1);
+    line[lastByte] = (line[lastByte] & ~tailMask) | (pattern & tailMask);
+  }
 }
 
-template <>
-void GfxRenderer::drawPixelDither<Color::DarkGray>(const int x, const int y) const {
-  drawPixel(x, y, (x + y) % 2 == 0);  // TODO: maybe find a better pattern?
+void GfxRenderer::fillRect(const int x, const int y, const int width, const int height, const bool state) const {
+  const uint8_t pattern = state ? 0x00 : 0xFF;
+  const uint8_t rowPatterns[2] = {pattern, pattern};
+  fillPanelRect(x, y, width, height, rowPatterns);
 }
 
 void GfxRenderer::fillRectDither(const int x, const int y, const int width, const int height, Color color) const {
@@ -443,33 +846,34 @@ void GfxRenderer::fillRectDither(const int x, const int y, const int width, cons
     fillRect(x, y, width, height, true);
   } else if (color == Color::White) {
     fillRect(x, y, width, height, false);
-  } else if (color == Color::LightGray) {
-    for (int fillY = y; fillY < y + height; fillY++) {
-      for (int fillX = x; fillX < x + width; fillX++) {
-        drawPixelDither<Color::LightGray>(fillX, fillY);
-      }
-    }
-  } else if (color == Color::DarkGray) {
-    for (int fillY = y; fillY < y + height; fillY++) {
-      for (int fillX = x; fillX < x + width; fillX++) {
-        drawPixelDither<Color::DarkGray>(fillX, fillY);
+  } else if (color == Color::LightGray || color == Color::DarkGray) {
+    // Pattern bytes for even and odd panel rows: light gray blackens even (x, y), dark gray even x + y
+    uint8_t rowPatterns[2] = {0xFF, 0xFF};
+    for (int row = 0; row < 2; row++) {
+      for (int bit = 0; bit < 8; bit++) {
+        int logicalX = 0;
+        int logicalY = 0;
+        unrotateCoordinates(orientation, bit, row, &logicalX, &logicalY);
+        const bool black = color == Color::LightGray ? (logicalX % 2 == 0 && logicalY % 2 == 0)
+                                                     : (logicalX + logicalY) % 2 == 0;
+        if (black) {
+          rowPatterns[row] &= ~(0x80 >> bit);
+        }
       }
     }
+    fillPanelRect(x, y, width, height, rowPatterns);
   }
 }
 
 template <Color color>
 void GfxRenderer::fillArc(const int maxRadius, const int cx, const int cy, const int xDir, const int yDir) const {
   const int radiusSq = maxRadius * maxRadius;
+  int maxDx = maxRadius;
   for (int dy = 0; dy <= maxRadius; ++dy) {
-    for (int dx = 0; dx <= maxRadius; ++dx) {
-      const int distSq = dx * dx + dy * dy;
-      const int px = cx + xDir * dx;
-      const int py = cy + yDir * dy;
-      if (distSq <= radiusSq) {
-        drawPixelDither<color>(px, py);
-      }
+    while (maxDx * maxDx + dy * dy > radiusSq) {
+      maxDx--;
     }
+    fillRectDither(xDir > 0 ? cx : cx - maxDx, cy + yDir * dy, maxDx + 1, 1, color);
   }
 }
 
@@ -573,6 +977,101 @@ void GfxRenderer::drawIcon(const uint8_t bitmap[], const int x, const int y, con
   display.drawImageTransparent(bitmap, y, getScreenWidth() - width - x, height, width);
 }
 
+// Bitmaps are only ever scaled down, by the ratio num/den. Each source column's logical x is computed once per
+// bitmap in integers, rather than a float multiply and floor per pixel. Columns left of the screen map to -1 and
+// columns right of it to screenWidth, so the map also gives the visible range.
+static void buildBitmapColumnMap(int16_t* columns, const int firstColumn, const int endColumn, const int x,
+                                 const int num, const int den, const int screenWidth) {
+  for (int bmpX = firstColumn; bmpX < endColumn; bmpX++) {
+    const int screenX = x + static_cast<int>(static_cast<int64_t>(bmpX - firstColumn) * num / den);
+    columns[bmpX] = static_cast<int16_t>(std::max(-1, std::min(screenX, screenWidth)));
+  }
+}
+
+// One bitmap row (2-bit, as Bitmap::readNextRow delivers it) onto logical row screenY, pixel rules as in
+// renderCharImpl. Downscaled source columns land on the same or the next logical x, so one LogicalRowCursor walks
+// the row without per-pixel rotation or bounds checks. 1-bit bitmaps draw black in every render mode.
+template <GfxRenderer::Orientation orientation>
+static void blitBitmapRow(uint8_t* frameBuffer, uint8_t* const* msbChunks, const GfxRenderer::RenderMode renderMode,
+                          const uint8_t* row, const int16_t* columns, const int first, const int end,
+                          const int screenY, const bool oneBit) {
+  LogicalRowCursor<orientation> cursor(frameBuffer, columns[first], screenY);
+  int screenX = columns[first];
+  for (int bmpX = first; bmpX < end; bmpX++) {
+    for (; screenX < columns[bmpX]; screenX++) {
+      cursor.next();
+    }
+    const uint8_t val = row[bmpX / 4] >> (6 - ((bmpX * 2) % 8)) & 0x3;
+    if (oneBit || renderMode == GfxRenderer::BW) {
+      if (val < 3) {
+        cursor.write(true);
+      }
+    } else if (renderMode == GfxRenderer::GRAYSCALE_MSB && (val == 1 || val == 2)) {
+      cursor.write(false);
+    } else if (renderMode == GfxRenderer::GRAYSCALE_LSB && val == 1) {
+      cursor.write(false);
+    } else if (renderMode == GfxRenderer::GRAYSCALE_PLANES && (val == 1 || val == 2)) {
+      if (val == 1) {
+        cursor.write(false);
+      }
+      cursor.writeMsbPlane(msbChunks, frameBuffer, GfxRenderer::getBwBufferChunkSize());
+    }
+  }
+}
+
+void GfxRenderer::drawBitmapRow(const uint8_t* row, const int16_t* columns, const int first, const int end,
+                                const int screenY, const bool oneBit) const {
+  if (first >= end) {
+    return;
+  }
+  switch (orientation) {
+    case Portrait:
+      blitBitmapRow<Portrait>(frameBuffer, msbPlaneChunks, renderMode, row, columns, first, end, screenY, oneBit);
+      break;
+    case LandscapeClockwise:
+      blitBitmapRow<LandscapeClockwise>(frameBuffer, msbPlaneChunks, renderMode, row, columns, first, end, screenY,
+                                        oneBit);
+      break;
+    case PortraitInverted:
+      blitBitmapRow<PortraitInverted>(frameBuffer, msbPlaneChunks, renderMode, row, columns, first, end, screenY,
+                                      oneBit);
+      break;
+    case LandscapeCounterClockwise:
+      blitBitmapRow<LandscapeCounterClockwise>(frameBuffer, msbPlaneChunks, renderMode, row, columns, first, end,
+                                               screenY, oneBit);
+      break;
+  }
+}
+
+// Fits width x height into maxWidth x maxHeight (0 = unbounded) by a scale of num/den, never scaling up
+static void fitBitmapScale(const int width, const int height, const int maxWidth, const int maxHeight, int* num,
+                           int* den) {
+  *num = 1;
+  *den = 1;
+  if (maxWidth > 0 && width > maxWidth) {
+    *num = maxWidth;
+    *den = width;
+  }
+  if (maxHeight > 0 && height > maxHeight &&
+      static_cast<int64_t>(maxHeight) * *den < static_cast<int64_t>(*num) * height) {
+    *num = maxHeight;
+    *den = height;
+  }
+}
+
+// Visible source column range [first, end) of a row, from its column map
+static void visibleBitmapColumns(const int16_t* columns, const int firstColumn, const int endColumn,
+                                 const int screenWidth, int* first, int* end) {
+  *first = firstColumn;
+  while (*first < endColumn && columns[*first] < 0) {
+    (*first)++;
+  }
+  *end = *first;
+  while (*end < endColumn && columns[*end] < screenWidth) {
+    (*end)++;
+  }
+}
+
 void GfxRenderer::drawBitmap(const Bitmap& bitmap, const int x, const int y, const int maxWidth, const int maxHeight,
                              const float cropX, const float cropY) const {
   // For 1-bit bitmaps, use optimized 1-bit rendering path (no crop support for 1-bit)
@@ -581,42 +1080,40 @@ void GfxRenderer::drawBitmap(const Bitmap& bitmap, const int x, const int y, con
     return;
   }
 
-  float scale = 1.0f;
-  bool isScaled = false;
   int cropPixX = std::floor(bitmap.getWidth() * cropX / 2.0f);
   int cropPixY = std::floor(bitmap.getHeight() * cropY / 2.0f);
   LOG_DBG("GFX", "Cropping %dx%d by %dx%d pix, is %s", bitmap.getWidth(), bitmap.getHeight(), cropPixX, cropPixY,
           bitmap.isTopDown() ? "top-down" : "bottom-up");
 
-  if (maxWidth > 0 && (1.0f - cropX) * bitmap.getWidth() > maxWidth) {
-    scale = static_cast<float>(maxWidth) / static_cast<float>((1.0f - cropX) * bitmap.getWidth());
-    isScaled = true;
-  }
-  if (maxHeight > 0 && (1.0f - cropY) * bitmap.getHeight() > maxHeight) {
-    scale = std::min(scale, static_cast<float>(maxHeight) / static_cast<float>((1.0f - cropY) * bitmap.getHeight()));
-    isScaled = true;
-  }
-  LOG_DBG("GFX", "Scaling by %f - %s", scale, isScaled ? "scaled" : "not scaled");
+  int num, den;
+  fitBitmapScale(bitmap.getWidth() - 2 * cropPixX, bitmap.getHeight() - 2 * cropPixY, maxWidth, maxHeight, &num,
+                 &den);
+  LOG_DBG("GFX", "Scaling by %d/%d", num, den);
 
   // Calculate output row size (2 bits per pixel, packed into bytes)
   // IMPORTANT: Use int, not uint8_t, to avoid overflow for images > 1020 pixels wide
   const int outputRowSize = (bitmap.getWidth() + 3) / 4;
-  auto* outputRow = static_cast<uint8_t*>(malloc(outputRowSize));
+  auto* columns = static_cast<int16_t*>(malloc(bitmap.getWidth() * sizeof(int16_t) + outputRowSize));
   auto* rowBytes = static_cast<uint8_t*>(malloc(bitmap.getRowBytes()));
 
-  if (!outputRow || !rowBytes) {
+  if (!columns || !rowBytes) {
     LOG_ERR("GFX", "!! Failed to allocate BMP row buffers");
-    free(outputRow);
+    free(columns);
     free(rowBytes);
     return;
   }
+  auto* outputRow = reinterpret_cast<uint8_t*>(columns + bitmap.getWidth());
+  const int screenWidth = getScreenWidth();
+  buildBitmapColumnMap(columns, cropPixX, bitmap.getWidth() - cropPixX, x, num, den, screenWidth);
+  int firstColumn, endColumn;
+  visibleBitmapColumns(columns, cropPixX, bitmap.getWidth() - cropPixX, screenWidth, &firstColumn, &endColumn);
 
   for (int bmpY = 0; bmpY < (bitmap.getHeight() - cropPixY); bmpY++) {
     // The BMP's (0, 0) is the bottom-left corner (if the height is positive, top-left if negative).
     // Screen's (0, 0) is the top-left corner.
     int screenY = -cropPixY + (bitmap.isTopDown() ? bmpY : bitmap.getHeight() - 1 - bmpY);
-    if (isScaled) {
-      screenY = std::floor(screenY * scale);
+    if (screenY > 0) {
+      screenY = static_cast<int>(static_cast<int64_t>(screenY) * num / den);
     }
     screenY += y;  // the offset should not be scaled
     if (screenY >= getScreenHeight()) {
@@ -625,7 +1122,7 @@ void GfxRenderer::drawBitmap(const Bitmap& bitmap, const int x, const int y, con
 
     if (bitmap.readNextRow(outputRow, rowBytes) != BmpReaderError::Ok) {
       LOG_ERR("GFX", "Failed to read row %d from bitmap", bmpY);
-      free(outputRow);
+      free(columns);
       free(rowBytes);
       return;
     }
@@ -639,72 +1136,47 @@ void GfxRenderer::drawBitmap(const Bitmap& bitmap, const int x, const int y, con
       continue;
     }
 
-    for (int bmpX = cropPixX; bmpX < bitmap.getWidth() - cropPixX; bmpX++) {
-      int screenX = bmpX - cropPixX;
-      if (isScaled) {
-        screenX = std::floor(screenX * scale);
-      }
-      screenX += x;  // the offset should not be scaled
-      if (screenX >= getScreenWidth()) {
-        break;
-      }
-      if (screenX < 0) {
-        continue;
-      }
-
-      const uint8_t val = outputRow[bmpX / 4] >> (6 - ((bmpX * 2) % 8)) & 0x3;
-
-      if (renderMode == BW && val < 3) {
-        drawPixel(screenX, screenY);
-      } else if (renderMode == GRAYSCALE_MSB && (val == 1 || val == 2)) {
-        drawPixel(screenX, screenY, false);
-      } else if (renderMode == GRAYSCALE_LSB && val == 1) {
-        drawPixel(screenX, screenY, false);
-      }
-    }
+    drawBitmapRow(outputRow, columns, firstColumn, endColumn, screenY, false);
   }
 
-  free(outputRow);
+  free(columns);
   free(rowBytes);
 }
 
 void GfxRenderer::drawBitmap1Bit(const Bitmap& bitmap, const int x, const int y, const int maxWidth,
                                  const int maxHeight) const {
-  float scale = 1.0f;
-  bool isScaled = false;
-  if (maxWidth > 0 && bitmap.getWidth() > maxWidth) {
-    scale = static_cast<float>(maxWidth) / static_cast<float>(bitmap.getWidth());
-    isScaled = true;
-  }
-  if (maxHeight > 0 && bitmap.getHeight() > maxHeight) {
-    scale = std::min(scale, static_cast<float>(maxHeight) / static_cast<float>(bitmap.getHeight()));
-    isScaled = true;
-  }
+  int num, den;
+  fitBitmapScale(bitmap.getWidth(), bitmap.getHeight(), maxWidth, maxHeight, &num, &den);
 
   // For 1-bit BMP, output is still 2-bit packed (for consistency with readNextRow)
   const int outputRowSize = (bitmap.getWidth() + 3) / 4;
-  auto* outputRow = static_cast<uint8_t*>(malloc(outputRowSize));
+  auto* columns = static_cast<int16_t*>(malloc(bitmap.getWidth() * sizeof(int16_t) + outputRowSize));
   auto* rowBytes = static_cast<uint8_t*>(malloc(bitmap.getRowBytes()));
 
-  if (!outputRow || !rowBytes) {
+  if (!columns || !rowBytes) {
     LOG_ERR("GFX", "!! Failed to allocate 1-bit BMP row buffers");
-    free(outputRow);
+    free(columns);
     free(rowBytes);
     return;
   }
+  auto* outputRow = reinterpret_cast<uint8_t*>(columns + bitmap.getWidth());
+  const int screenWidth = getScreenWidth();
+  buildBitmapColumnMap(columns, 0, bitmap.getWidth(), x, num, den, screenWidth);
+  int firstColumn, endColumn;
+  visibleBitmapColumns(columns, 0, bitmap.getWidth(), screenWidth, &firstColumn, &endColumn);
 
   for (int bmpY = 0; bmpY < bitmap.getHeight(); bmpY++) {
     // Read rows sequentially using readNextRow
     if (bitmap.readNextRow(outputRow, rowBytes) != BmpReaderError::Ok) {
       LOG_ERR("GFX", "Failed to read row %d from 1-bit bitmap", bmpY);
-      free(outputRow);
+      free(columns);
       free(rowBytes);
       return;
     }
 
     // Calculate screen Y based on whether BMP is top-down or bottom-up
     const int bmpYOffset = bitmap.isTopDown() ? bmpY : bitmap.getHeight() - 1 - bmpY;
-    int screenY = y + (isScaled ? static_cast<int>(std::floor(bmpYOffset * scale)) : bmpYOffset);
+    const int screenY = y + static_cast<int>(static_cast<int64_t>(bmpYOffset) * num / den);
     if (screenY >= getScreenHeight()) {
       continue;  // Continue reading to keep row counter in sync
     }
@@ -712,28 +1184,11 @@ void GfxRenderer::drawBitmap1Bit(const Bitmap& bitmap, const int x, const int y,
       continue;
     }
 
-    for (int bmpX = 0; bmpX < bitmap.getWidth(); bmpX++) {
-      int screenX = x + (isScaled ? static_cast<int>(std::floor(bmpX * scale)) : bmpX);
-      if (screenX >= getScreenWidth()) {
-        break;
-      }
-      if (screenX < 0) {
-        continue;
-      }
-
-      // Get 2-bit value (result of readNextRow quantization)
-      const uint8_t val = outputRow[bmpX / 4] >> (6 - ((bmpX * 2) % 8)) & 0x3;
-
-      // For 1-bit source: 0 or 1 -> map to black (0,1,2) or white (3)
-      // val < 3 means black pixel (draw it)
-      if (val < 3) {
-        drawPixel(screenX, screenY, true);
-      }
-      // White pixels (val == 3) are not drawn (leave background)
-    }
+    // For 1-bit source: 0 or 1 -> map to black (0,1,2) or white (3); white pixels leave the background
+    drawBitmapRow(outputRow, columns, firstColumn, endColumn, screenY, true);
   }
 
-  free(outputRow);
+  free(columns);
   free(rowBytes);
 }
 
@@ -795,10 +1250,7 @@ void GfxRenderer::fillPolygon(const int* xPoints, const int* yPoints, int numPoi
       if (startX < 0) startX = 0;
       if (endX >= getScreenWidth()) endX = getScreenWidth() - 1;
 
-      // Draw horizontal line
-      for (int x = startX; x <= endX; x++) {
-        drawPixel(x, scanY, state);
-      }
+      fillRect(startX, scanY, endX - startX + 1, 1, state);
     }
   }
 
@@ -822,27 +1274,199 @@ void GfxRenderer::invertScreen() const {
 void GfxRenderer::displayBuffer(const HalDisplay::RefreshMode refreshMode) const {
   auto elapsed = millis() - start_ms;
   LOG_DBG("GFX", "Time = %lu ms from clearScreen to displayBuffer", elapsed);
-  display.displayBuffer(refreshMode, fadingFix);
+  hashPendingTiles();
+  if (refreshMode == HalDisplay::FAST_REFRESH) {
+    ghostingDebt +=
+        shownTileHashesValid ? diffTiles().changedPixels : HalDisplay::DISPLAY_WIDTH * HalDisplay::DISPLAY_HEIGHT;
+  } else {
+    ghostingDebt = 0;
+  }
+  {
+    TRACE("display.refresh");
+    display.displayBuffer(refreshMode, fadingFix);
+  }
+  commitPendingTiles();
+}
+
+void GfxRenderer::displayBuffer() const {
+  if (!shownTileHashesValid) {
+    displayBuffer(HalDisplay::FAST_REFRESH);
+    return;
+  }
+
+  auto elapsed = millis() - start_ms;
+  LOG_DBG("GFX", "Time = %lu ms from clearScreen to displayBuffer", elapsed);
+  hashPendingTiles();
+  const FrameChanges changes = diffTiles();
+  if (changes.changedTiles == 0) {
+    LOG_DBG("GFX", "No changes to display");
+    return;
+  }
+
+  if (ghostingDebt + changes.changedPixels >= GHOSTING_PIXEL_BUDGET) {
+    LOG_DBG("GFX", "Ghosting budget reached, half refresh");
+    ghostingDebt = 0;
+    display.displayBuffer(HalDisplay::HALF_REFRESH, fadingFix);
+    commitPendingTiles();
+    return;
+  }
+  ghostingDebt += changes.changedPixels;
+
+  const int windowTiles = (changes.maxTx - changes.minTx + 1) * (changes.maxTy - changes.minTy + 1);
+  if (windowTiles > MAX_WINDOW_TILES) {
+    display.displayBuffer(HalDisplay::FAST_REFRESH, fadingFix);
+  } else {
+    constexpr int tileWidth = DIRTY_TILE_BYTES * 8;
+    LOG_DBG("GFX", "Window refresh of %d/%d tiles (~%u px changed)", windowTiles, DIRTY_TILE_COUNT,
+            changes.changedPixels);
+    display.displayWindow(changes.minTx * tileWidth, changes.minTy * DIRTY_TILE_ROWS,
+                          (changes.maxTx - changes.minTx + 1) * tileWidth,
+                          (changes.maxTy - changes.minTy + 1) * DIRTY_TILE_ROWS, fadingFix);
+  }
+  // Tiles outside the window were unchanged, so the new hashes describe the panel exactly
+  commitPendingTiles();
+}
+
+void GfxRenderer::getPanelRect(const int x, const int y, const int width, const int height, int* phyX, int* phyY,
+                               int* phyWidth, int* phyHeight) const {
+  int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  rotateCoordinates(orientation, x, y, &x0, &y0);
+  rotateCoordinates(orientation, x + width - 1, y + height - 1, &x1, &y1);
+  *phyX = std::min(x0, x1);
+  *phyY = std::min(y0, y1);
+  *phyWidth = std::abs(x1 - x0) + 1;
+  *phyHeight = std::abs(y1 - y0) + 1;
+}
+
+void GfxRenderer::blitPanelRow(const uint8_t* bits, const int phyX, const int phyY, const int phyWidth) const {
+  if (phyX < 0 || phyY < 0 || phyX + phyWidth > HalDisplay::DISPLAY_WIDTH || phyY >= HalDisplay::DISPLAY_HEIGHT) {
+    LOG_ERR("GFX", "!! Panel row outside range (%d, %d) width %d", phyX, phyY, phyWidth);
+    return;
+  }
+
+  // Source rows start at bit 0; shift them onto the destination byte boundary. Padding bits past phyWidth are
+  // zero, so the spill into the byte after the row never draws anything.
+  uint8_t* dst = frameBuffer + phyY * HalDisplay::DISPLAY_WIDTH_BYTES + (phyX >> 3);
+  const uint8_t* rowEnd = frameBuffer + (phyY + 1) * HalDisplay::DISPLAY_WIDTH_BYTES;
+  const int shift = phyX & 7;
+  const int srcBytes = (phyWidth + 7) / 8;
+  const bool clear = renderMode == BW;
+  for (int i = 0; i < srcBytes; i++, dst++) {
+    const uint8_t src = bits[i];
+    if (!src) {
+      continue;
+    }
+    const uint8_t hi = src >> shift;
+    const uint8_t lo = shift ? static_cast<uint8_t>(src << (8 - shift)) : 0;
+    if (clear) {
+      *dst &= ~hi;
+      if (lo && dst + 1 < rowEnd) dst[1] &= ~lo;
+    } else {
+      *dst |= hi;
+      if (lo && dst + 1 < rowEnd) dst[1] |= lo;
+    }
+  }
+}
+
+void GfxRenderer::displayWindow(const int x, const int y, const int width, const int height) const {
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+
+  int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  rotateCoordinates(orientation, x, y, &x0, &y0);
+  rotateCoordinates(orientation, x + width - 1, y + height - 1, &x1, &y1);
+  const int phyX = std::max(0, std::min(x0, x1));
+  const int phyY = std::max(0, std::min(y0, y1));
+  const int phyRight = std::min<int>(HalDisplay::DISPLAY_WIDTH - 1, std::max(x0, x1));
+  const int phyBottom = std::min<int>(HalDisplay::DISPLAY_HEIGHT - 1, std::max(y0, y1));
+  if (phyRight < phyX || phyBottom < phyY) {
+    return;
+  }
+
+  {
+    TRACE("display.window");
+    display.displayWindow(phyX, phyY, phyRight - phyX + 1, phyBottom - phyY + 1, fadingFix);
+  }
+  ghostingDebt += (phyRight - phyX + 1) * (phyBottom - phyY + 1);
+  // Anything outside the window may differ from the panel now, so the next automatic update starts over
+  shownTileHashesValid = false;
+}
+
+void GfxRenderer::hashPendingTiles() const {
+  for (int i = 0; i < DIRTY_TILE_COUNT; i++) {
+    pendingTileHashes[i] = 2166136261u;  // FNV-1a offset basis
+    pendingTileBlack[i] = 0;
+  }
+  const uint8_t* row = frameBuffer;
+  for (int y = 0; y < HalDisplay::DISPLAY_HEIGHT; y++) {
+    const int tileRow = (y / DIRTY_TILE_ROWS) * DIRTY_TILES_X;
+    for (int tx = 0; tx < DIRTY_TILES_X; tx++) {
+      uint32_t hash = pendingTileHashes[tileRow + tx];
+      int white = 0;
+      for (int b = 0; b < DIRTY_TILE_BYTES; b++) {
+        hash = (hash ^ *row) * 16777619u;
+        white += __builtin_popcount(*row++);
+      }
+      pendingTileHashes[tileRow + tx] = hash;
+      pendingTileBlack[tileRow + tx] += DIRTY_TILE_BYTES * 8 - white;
+    }
+  }
+}
+
+GfxRenderer::FrameChanges GfxRenderer::diffTiles() const {
+  FrameChanges changes;
+  for (int ty = 0; ty < DIRTY_TILES_Y; ty++) {
+    for (int tx = 0; tx < DIRTY_TILES_X; tx++) {
+      const int i = ty * DIRTY_TILES_X + tx;
+      if (pendingTileHashes[i] == shownTileHashes[i]) {
+        continue;
+      }
+      changes.changedTiles++;
+      changes.minTx = std::min(changes.minTx, tx);
+      changes.maxTx = std::max(changes.maxTx, tx);
+      changes.minTy = std::min(changes.minTy, ty);
+      changes.maxTy = std::max(changes.maxTy, ty);
+      // Only the old frame's hash is kept, so the exact number of flipped pixels is unknown. The change in black
+      // pixels is a lower bound; text replaced by text of similar density barely moves it, so each changed tile
+      // counts for at least an eighth of its area.
+      const uint32_t blackDelta = std::abs(static_cast<int>(pendingTileBlack[i]) - shownTileBlack[i]);
+      changes.changedPixels += std::max(blackDelta, DIRTY_TILE_PIXELS / 8);
+    }
+  }
+  return changes;
+}
+
+void GfxRenderer::commitPendingTiles() const {
+  memcpy(shownTileHashes, pendingTileHashes, sizeof(shownTileHashes));
+  memcpy(shownTileBlack, pendingTileBlack, sizeof(shownTileBlack));
+  shownTileHashesValid = true;
+}
+
+size_t GfxRenderer::fitTextPrefix(const int fontId, const char* text, const int maxWidth, const uint32_t suffixCp,
+                                  const EpdFontFamily::Style style) const {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
+    LOG_ERR("GFX", "Font %d not found", fontId);
+    return 0;
+  }
+  return family->fitTextPrefix(text, maxWidth, suffixCp, style);
 }
 
 std::string GfxRenderer::truncatedText(const int fontId, const char* text, const int maxWidth,
                                        const EpdFontFamily::Style style) const {
   if (!text || maxWidth <= 0) return "";
 
-  std::string item = text;
   // U+2026 HORIZONTAL ELLIPSIS (UTF-8: 0xE2 0x80 0xA6)
   const char* ellipsis = "\xe2\x80\xa6";
-  int textWidth = getTextWidth(fontId, item.c_str(), style);
-  if (textWidth <= maxWidth) {
+  if (getTextWidth(fontId, text, style) <= maxWidth) {
     // Text fits, return as is
-    return item;
+    return text;
   }
 
-  while (!item.empty() && getTextWidth(fontId, (item + ellipsis).c_str(), style) >= maxWidth) {
-    utf8RemoveLastChar(item);
-  }
-
-  return item.empty() ? ellipsis : item + ellipsis;
+  // The text plus ellipsis has to come out narrower than maxWidth, hence the - 1
+  const size_t fit = fitTextPrefix(fontId, text, maxWidth - 1, 0x2026, style);
+  return std::string(text, fit) + ellipsis;
 }
 
 std::vector<std::string> GfxRenderer::wrappedText(const int fontId, const char* text, const int maxWidth,
@@ -851,59 +1475,61 @@ std::vector<std::string> GfxRenderer::wrappedText(const int fontId, const char*
 
   if (!text || maxWidth <= 0 || maxLines <= 0) return lines;
 
-  std::string remaining = text;
-  std::string currentLine;
-
-  while (!remaining.empty()) {
+  // Each line is the longest run of whole space-separated words that fits, found with one measuring pass over the
+  // rest of the text instead of re-measuring the line as every word is added.
+  const char* remaining = text;
+  // Whether the previous line broke normally; an over-wide word right after such a break gets a line of its own,
+  // anywhere else it ends the text
+  bool afterBreak = false;
+
+  while (true) {
+    // Lines never start with the spaces they were broken at
+    while (*remaining == ' ') {
+      remaining++;
+    }
+    if (*remaining == '\0') {
+      break;
+    }
     if (static_cast<int>(lines.size()) == maxLines - 1) {
-      // Last available line: combine any word already started on this line with
-      // the rest of the text, then let truncatedText fit it with an ellipsis.
-      std::string lastContent = currentLine.empty() ? remaining : currentLine + " " + remaining;
-      lines.push_back(truncatedText(fontId, lastContent.c_str(), maxWidth, style));
+      // Last available line: let truncatedText fit the rest of the text with an ellipsis
+      lines.push_back(truncatedText(fontId, remaining, maxWidth, style));
       return lines;
     }
 
-    // Find next word
-    size_t spacePos = remaining.find(' ');
-    std::string word;
-
-    if (spacePos == std::string::npos) {
-      word = remaining;
-      remaining.clear();
-    } else {
-      word = remaining.substr(0, spacePos);
-      remaining.erase(0, spacePos + 1);
+    const size_t fit = fitTextPrefix(fontId, remaining, maxWidth, 0, style);
+    if (remaining[fit] == '\0') {
+      // The separator after the last word isn't kept
+      size_t length = fit;
+      if (remaining[length - 1] == ' ') {
+        length--;
+      }
+      if (length > 0) {
+        lines.emplace_back(remaining, length);
+      }
+      return lines;
     }
 
-    std::string testLine = currentLine.empty() ? word : currentLine + " " + word;
-
-    if (getTextWidth(fontId, testLine.c_str(), style) <= maxWidth) {
-      currentLine = testLine;
-    } else {
-      if (!currentLine.empty()) {
-        lines.push_back(currentLine);
-        // If the carried-over word itself exceeds maxWidth, truncate it and
-        // push it as a complete line immediately — storing it in currentLine
-        // would allow a subsequent short word to be appended after the ellipsis.
-        if (getTextWidth(fontId, word.c_str(), style) > maxWidth) {
-          lines.push_back(truncatedText(fontId, word.c_str(), maxWidth, style));
-          currentLine.clear();
-          if (static_cast<int>(lines.size()) >= maxLines) return lines;
-        } else {
-          currentLine = word;
-        }
-      } else {
-        // Single word wider than maxWidth: truncate and stop to avoid complicated
-        // splitting rules (different between languages). Results in an aesthetically
-        // pleasing end.
-        lines.push_back(truncatedText(fontId, word.c_str(), maxWidth, style));
-        return lines;
-      }
+    // Break at the last space the fitting prefix reaches, including one right after it
+    size_t breakAt = fit;
+    while (breakAt > 0 && remaining[breakAt] != ' ') {
+      breakAt--;
+    }
+    if (breakAt > 0) {
+      lines.emplace_back(remaining, breakAt);
+      remaining += breakAt + 1;
+      afterBreak = true;
+      continue;
     }
-  }
 
-  if (!currentLine.empty() && static_cast<int>(lines.size()) < maxLines) {
-    lines.push_back(currentLine);
+    // The first word alone is wider than maxWidth: truncate it rather than apply language-specific splitting rules
+    const char* space = strchr(remaining, ' ');
+    const std::string word = space ? std::string(remaining, space - remaining) : std::string(remaining);
+    lines.push_back(truncatedText(fontId, word.c_str(), maxWidth, style));
+    if (!afterBreak || !space || static_cast<int>(lines.size()) >= maxLines) {
+      return lines;
+    }
+    remaining = space + 1;
+    afterBreak = false;
   }
 
   return lines;
@@ -938,48 +1564,63 @@ int GfxRenderer::getScreenHeight() const {
   return HalDisplay::DISPLAY_WIDTH;
 }
 
+const EpdFont* GfxRenderer::getFont(const int fontId, const EpdFontFamily::Style style) const {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
+    LOG_ERR("GFX", "Font %d not found", fontId);
+    return nullptr;
+  }
+  return family->getFont(style);
+}
+
 int GfxRenderer::getSpaceWidth(const int fontId, const EpdFontFamily::Style style) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return 0;
   }
 
-  const EpdGlyph* spaceGlyph = fontIt->second.getGlyph(' ', style);
+  const EpdGlyph* spaceGlyph = family->getGlyph(' ', style);
   return spaceGlyph ? spaceGlyph->advanceX : 0;
 }
 
 int GfxRenderer::getSpaceKernAdjust(const int fontId, const uint32_t leftCp, const uint32_t rightCp,
                                     const EpdFontFamily::Style style) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) return 0;
-  const auto& font = fontIt->second;
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) return 0;
+  const auto& font = *family;
   return font.getKerning(leftCp, ' ', style) + font.getKerning(' ', rightCp, style);
 }
 
 int GfxRenderer::getKerning(const int fontId, const uint32_t leftCp, const uint32_t rightCp,
                             const EpdFontFamily::Style style) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) return 0;
-  return fontIt->second.getKerning(leftCp, rightCp, style);
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) return 0;
+  return family->getKerning(leftCp, rightCp, style);
 }
 
 int GfxRenderer::getTextAdvanceX(const int fontId, const char* text, EpdFontFamily::Style style) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return 0;
   }
 
-  uint32_t cp;
-  uint32_t prevCp = 0;
+  const uint64_t key = TextWidthCache::makeKey(fontId, style, TextWidthCache::ADVANCE, text);
   int width = 0;
-  const auto& font = fontIt->second;
-  while ((cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&text)))) {
+  if (textWidthCache.lookup(key, &width)) {
+    return width;
+  }
+
+  uint32_t prevCp = 0;
+  const auto& font = *family;
+  const Utf8Codepoints codepoints(text);
+  for (const uint32_t* next = codepoints.begin(); next < codepoints.end();) {
+    uint32_t cp = *next++;
     if (utf8IsCombiningMark(cp)) {
       continue;
     }
-    cp = font.applyLigatures(cp, text, style);
+    cp = font.applyLigatures(cp, next, codepoints.end(), style);
     if (prevCp != 0) {
       width += font.getKerning(prevCp, cp, style);
     }
@@ -987,36 +1628,42 @@ int GfxRenderer::getTextAdvanceX(const int fontId, const char* text, EpdFontFami
     if (glyph) width += glyph->advanceX;
     prevCp = cp;
   }
+  textWidthCache.store(key, width);
   return width;
 }
 
 int GfxRenderer::getFontAscenderSize(const int fontId) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return 0;
   }
 
-  return fontIt->second.getData(EpdFontFamily::REGULAR)->ascender;
+  return family->getData(EpdFontFamily::REGULAR)->ascender;
 }
 
 int GfxRenderer::getLineHeight(const int fontId) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return 0;
   }
 
-  return fontIt->second.getData(EpdFontFamily::REGULAR)->advanceY;
+  return family->getData(EpdFontFamily::REGULAR)->advanceY;
+}
+
+bool GfxRenderer::isAntiAliased(const int fontId, const EpdFontFamily::Style style) const {
+  const EpdFontFamily* family = findFont(fontId);
+  return family && family->getData(style)->is2Bit;
 }
 
 int GfxRenderer::getTextHeight(const int fontId) const {
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return 0;
   }
-  return fontIt->second.getData(EpdFontFamily::REGULAR)->ascender;
+  return family->getData(EpdFontFamily::REGULAR)->ascender;
 }
 
 void GfxRenderer::drawTextRotated90CW(const int fontId, const int x, const int y, const char* text, const bool black,
@@ -1026,13 +1673,13 @@ void GfxRenderer::drawTextRotated90CW(const int fontId, const int x, const int y
     return;
   }
 
-  const auto fontIt = fontMap.find(fontId);
-  if (fontIt == fontMap.end()) {
+  const EpdFontFamily* family = findFont(fontId);
+  if (!family) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return;
   }
 
-  const auto& font = fontIt->second;
+  const auto& font = *family;
 
   int xPos = x;
   int yPos = y;
@@ -1085,11 +1732,81 @@ size_t GfxRenderer::getBufferSize() { return HalDisplay::BUFFER_SIZE; }
 // unused
 // void GfxRenderer::grayscaleRevert() const { display.grayscaleRevert(); }
 
-void GfxRenderer::copyGrayscaleLsbBuffers() const { display.copyGrayscaleLsbBuffers(frameBuffer); }
+void GfxRenderer::copyGrayscaleLsbBuffers() const {
+  TRACE("gray.copy");
+  display.copyGrayscaleLsbBuffers(frameBuffer);
+}
+
+void GfxRenderer::copyGrayscaleMsbBuffers() const {
+  TRACE("gray.copy");
+  display.copyGrayscaleMsbBuffers(frameBuffer);
+}
+
+void GfxRenderer::displayGrayBuffer() const {
+  TRACE("display.gray");
+  display.displayGrayBuffer(fadingFix);
+  shownTileHashesValid = false;
+}
+
+HalDisplay::RefreshToken GfxRenderer::displayGrayBufferAsync() const {
+  shownTileHashesValid = false;
+  return display.displayGrayBufferAsync(fadingFix);
+}
 
-void GfxRenderer::copyGrayscaleMsbBuffers() const { display.copyGrayscaleMsbBuffers(frameBuffer); }
+void GfxRenderer::drawMsbPlanePixel(const int x, const int y) const {
+  int phyX = 0;
+  int phyY = 0;
+  rotateCoordinates(orientation, x, y, &phyX, &phyY);
+  if (phyX < 0 || phyX >= HalDisplay::DISPLAY_WIDTH || phyY < 0 || phyY >= HalDisplay::DISPLAY_HEIGHT ||
+      !msbPlaneChunks[0]) {
+    return;
+  }
+  const size_t byteIndex = phyY * HalDisplay::DISPLAY_WIDTH_BYTES + (phyX / 8);
+  msbPlaneChunks[byteIndex / BW_BUFFER_CHUNK_SIZE][byteIndex % BW_BUFFER_CHUNK_SIZE] |= 1 << (7 - (phyX % 8));
+}
+
+bool GfxRenderer::beginGrayscalePlanes() {
+  for (auto& chunk : msbPlaneChunks) {
+    if (chunk) {
+      LOG_ERR("GFX", "!! MSB plane chunk already allocated - this is likely a bug, reusing it");
+      memset(chunk, 0x00, BW_BUFFER_CHUNK_SIZE);
+      continue;
+    }
+    chunk = static_cast<uint8_t*>(calloc(1, BW_BUFFER_CHUNK_SIZE));
+    if (!chunk) {
+      LOG_DBG("GFX", "Not enough memory for single-pass grayscale, using separate passes");
+      freeMsbPlaneChunks();
+      return false;
+    }
+  }
 
-void GfxRenderer::displayGrayBuffer() const { display.displayGrayBuffer(fadingFix); }
+  clearScreen(0x00);
+  renderMode = GRAYSCALE_PLANES;
+  return true;
+}
+
+void GfxRenderer::endGrayscalePlanes() {
+  renderMode = BW;
+  if (!msbPlaneChunks[0]) {
+    return;
+  }
+
+  display.copyGrayscaleLsbBuffers(frameBuffer);
+  for (size_t i = 0; i < BW_BUFFER_NUM_CHUNKS; i++) {
+    memcpy(frameBuffer + i * BW_BUFFER_CHUNK_SIZE, msbPlaneChunks[i], BW_BUFFER_CHUNK_SIZE);
+  }
+  freeMsbPlaneChunks();
+  display.copyGrayscaleMsbBuffers(frameBuffer);
+}
+
+void GfxRenderer::freeMsbPlaneChunks() {
+  for (auto& chunk : msbPlaneChunks) {
+    if (chunk) {
+      free(chunk);
+      chunk = nullptr;
+    }
+  }
+}
 
 void GfxRenderer::freeBwBufferChunks() {
   for (auto& bwBufferChunk : bwBufferChunks) {
@@ -1098,15 +1815,115 @@ void GfxRenderer::freeBwBufferChunks() {
       bwBufferChunk = nullptr;
     }
   }
+  bwPackedSize = 0;
+  bwSnapshot.release();
+}
+
+// The packed snapshot runs down one byte column (8 pixels wide, full height) at a time. Text lines cross a column
+// with white line gaps in between, which gives about twice the compression of packing along the rows.
+static void readByteColumn(const uint8_t* frameBuffer, const size_t x, uint8_t* column) {
+  for (size_t y = 0; y < HalDisplay::DISPLAY_HEIGHT; y++) {
+    column[y] = frameBuffer[y * HalDisplay::DISPLAY_WIDTH_BYTES + x];
+  }
+}
+
+bool GfxRenderer::storePackedBwBuffer() {
+  if (bwBufferChunks[0]) {
+    return false;
+  }
+
+  uint8_t column[HalDisplay::DISPLAY_HEIGHT];
+  size_t packedSize = 0;
+  for (size_t x = 0; x < HalDisplay::DISPLAY_WIDTH_BYTES; x++) {
+    readByteColumn(frameBuffer, x, column);
+    packedSize += packbits::encode(column, sizeof(column), nullptr);
+  }
+  // Pages that don't save at least one chunk (images, dense small print) are cheaper to copy raw
+  const size_t chunkCount = (packedSize + BW_BUFFER_CHUNK_SIZE - 1) / BW_BUFFER_CHUNK_SIZE;
+  if (chunkCount >= BW_BUFFER_NUM_CHUNKS) {
+    return false;
+  }
+  for (size_t i = 0; i < chunkCount; i++) {
+    const size_t size = std::min(BW_BUFFER_CHUNK_SIZE, packedSize - i * BW_BUFFER_CHUNK_SIZE);
+    bwBufferChunks[i] = static_cast<uint8_t*>(malloc(size));
+    if (!bwBufferChunks[i]) {
+      freeBwBufferChunks();
+      return false;
+    }
+  }
+
+  uint8_t packed[packbits::maxEncodedSize(HalDisplay::DISPLAY_HEIGHT)];
+  size_t pos = 0;
+  for (size_t x = 0; x < HalDisplay::DISPLAY_WIDTH_BYTES; x++) {
+    readByteColumn(frameBuffer, x, column);
+    const size_t length = packbits::encode(column, sizeof(column), packed);
+    for (size_t done = 0; done < length;) {
+      const size_t offset = pos % BW_BUFFER_CHUNK_SIZE;
+      const size_t count = std::min(length - done, BW_BUFFER_CHUNK_SIZE - offset);
+      memcpy(bwBufferChunks[pos / BW_BUFFER_CHUNK_SIZE] + offset, packed + done, count);
+      done += count;
+      pos += count;
+    }
+  }
+  bwPackedSize = packedSize;
+  LOG_DBG("GFX", "Stored BW buffer packed in %zu chunks (%zu bytes)", chunkCount, packedSize);
+  return true;
+}
+
+// Decodes the packed snapshot straight into the frame buffer, reading across chunk boundaries byte by byte
+void GfxRenderer::restorePackedBwBuffer() {
+  size_t pos = 0;
+  const auto next = [this, &pos]() {
+    const uint8_t value = bwBufferChunks[pos / BW_BUFFER_CHUNK_SIZE][pos % BW_BUFFER_CHUNK_SIZE];
+    pos++;
+    return value;
+  };
+  for (size_t x = 0; x < HalDisplay::DISPLAY_WIDTH_BYTES; x++) {
+    uint8_t* out = frameBuffer + x;
+    size_t y = 0;
+    while (y < HalDisplay::DISPLAY_HEIGHT && pos < bwPackedSize) {
+      // PackBits, see PackBits.h; the encoder never writes the no-op 128
+      const uint8_t control = next();
+      if (control < 128) {
+        for (size_t end = y + control + 1; y < end && pos < bwPackedSize; y++) {
+          out[y * HalDisplay::DISPLAY_WIDTH_BYTES] = next();
+        }
+      } else if (pos < bwPackedSize) {
+        const uint8_t value = next();
+        for (size_t end = y + 257 - control; y < end; y++) {
+          out[y * HalDisplay::DISPLAY_WIDTH_BYTES] = value;
+        }
+      }
+    }
+  }
 }
 
 /**
  * This should be called before grayscale buffers are populated.
  * A `restoreBwBuffer` call should always follow the grayscale render if this method was called.
- * Uses chunked allocation to avoid needing 48KB of contiguous memory.
+ * Copies the buffer into the pool's frame slab when it is free. Otherwise uses chunked allocation to avoid needing
+ * 48KB of contiguous memory, and packs the buffer into as few chunks as it needs when that saves any (a full text
+ * page packs to about half).
  * Returns true if buffer was stored successfully, false if allocation failed.
  */
 bool GfxRenderer::storeBwBuffer() {
+  if (bwSnapshot) {
+    LOG_ERR("GFX", "!! BW buffer already stored - this is likely a bug, replacing it");
+    bwSnapshot.release();
+  }
+  if (!bwBufferChunks[0]) {
+    bwSnapshot = BufferPool::lease(HalDisplay::BUFFER_SIZE, false);
+    if (bwSnapshot) {
+      memcpy(bwSnapshot.data(), frameBuffer, HalDisplay::BUFFER_SIZE);
+      LOG_DBG("GFX", "Stored BW buffer in a pool slab");
+      return true;
+    }
+  }
+  if (storePackedBwBuffer()) {
+    return true;
+  }
+  bwPackedSize = 0;
+
   // Allocate and copy each chunk
   for (size_t i = 0; i < BW_BUFFER_NUM_CHUNKS; i++) {
     // Check if any chunks are already allocated
@@ -1137,8 +1954,30 @@ bool GfxRenderer::storeBwBuffer() {
  * This can only be called if `storeBwBuffer` was called prior to the grayscale render.
  * It should be called to restore the BW buffer state after grayscale rendering is complete.
  * Uses chunked restoration to match chunked storage.
+ * With syncDisplay false only the frame buffer is restored, and the caller syncs the controller with
+ * `cleanupGrayscaleWithFrameBuffer` later, e.g. once an asynchronous gray refresh is done.
  */
-void GfxRenderer::restoreBwBuffer() {
+void GfxRenderer::restoreBwBuffer(const bool syncDisplay) {
+  if (bwSnapshot) {
+    memcpy(frameBuffer, bwSnapshot.data(), HalDisplay::BUFFER_SIZE);
+    if (syncDisplay) {
+      display.cleanupGrayscaleBuffers(frameBuffer);
+    }
+    bwSnapshot.release();
+    LOG_DBG("GFX", "Restored BW buffer from its pool slab");
+    return;
+  }
+
+  if (bwPackedSize > 0) {
+    restorePackedBwBuffer();
+    if (syncDisplay) {
+      display.cleanupGrayscaleBuffers(frameBuffer);
+    }
+    freeBwBufferChunks();
+    LOG_DBG("GFX", "Restored and freed packed BW buffer");
+    return;
+  }
+
   // Check if all chunks are allocated
   bool missingChunks = false;
   for (const auto& bwBufferChunk : bwBufferChunks) {
@@ -1158,7 +1997,9 @@ void GfxRenderer::restoreBwBuffer() {
     memcpy(frameBuffer + offset, bwBufferChunks[i], BW_BUFFER_CHUNK_SIZE);
   }
 
-  display.cleanupGrayscaleBuffers(frameBuffer);
+  if (syncDisplay) {
+    display.cleanupGrayscaleBuffers(frameBuffer);
+  }
 
   freeBwBufferChunks();
   LOG_DBG("GFX", "Restored and freed BW buffer chunks");
@@ -1174,6 +2015,27 @@ void GfxRenderer::cleanupGrayscaleWithFrameBuffer() const {
   }
 }
 
+bool GfxRenderer::storeCompressedFrame(std::vector<uint8_t>& out, const size_t maxSize) const {
+  out.clear();
+  const size_t size = packbits::encode(frameBuffer, HalDisplay::BUFFER_SIZE, nullptr);
+  if (size > maxSize) {
+    LOG_DBG("GFX", "Compressed frame too large (%zu > %zu bytes)", size, maxSize);
+    return false;
+  }
+  out.resize(size);
+  packbits::encode(frameBuffer, HalDisplay::BUFFER_SIZE, out.data());
+  return true;
+}
+
+bool GfxRenderer::restoreCompressedFrame(const std::vector<uint8_t>& in) const {
+  const size_t out = packbits::decode(in.data(), in.size(), frameBuffer, HalDisplay::BUFFER_SIZE);
+  if (out != HalDisplay::BUFFER_SIZE) {
+    LOG_ERR("GFX", "Corrupt compressed frame (%zu of %zu bytes)", out, HalDisplay::BUFFER_SIZE);
+    return false;
+  }
+  return true;
+}
+
 void GfxRenderer::renderChar(const EpdFontFamily& fontFamily, uint32_t cp, int* x, int* y, bool pixelState,
                              EpdFontFamily::Style style) const {
   renderCharImpl<TextRotation::None>(*this, renderMode, fontFamily, cp, x, y, pixelState, style);
@@ -1,14 +1,17 @@
 #pragma once
 
+#include <BufferPool.h>
 #include <EpdFontFamily.h>
 #include <FontDecompressor.h>
 #include <HalDisplay.h>
 
-#include <map>
+#include <atomic>
 #include <string>
 #include <vector>
 
 #include "Bitmap.h"
+#include "GlyphAtlas.h"
+#include "TextWidthCache.h"
 
 // Color representation: uint8_t mapped to 4x4 Bayer matrix dithering levels
 // 0 = transparent, 1-16 = gray levels (white to black)
@@ -16,7 +19,9 @@ enum Color : uint8_t { Clear = 0x00, White = 0x01, LightGray = 0x05, DarkGray =
 
 class GfxRenderer {
  public:
-  enum RenderMode { BW, GRAYSCALE_LSB, GRAYSCALE_MSB };
+  // GRAYSCALE_PLANES writes the LSB plane to the frame buffer and the MSB plane to a side buffer in one pass (text
+  // only, see beginGrayscalePlanes)
+  enum RenderMode { BW, GRAYSCALE_LSB, GRAYSCALE_MSB, GRAYSCALE_PLANES };
 
   // Logical screen orientation from the perspective of callers
   enum Orientation {
@@ -31,6 +36,33 @@ class GfxRenderer {
   static constexpr size_t BW_BUFFER_NUM_CHUNKS = HalDisplay::BUFFER_SIZE / BW_BUFFER_CHUNK_SIZE;
   static_assert(BW_BUFFER_CHUNK_SIZE * BW_BUFFER_NUM_CHUNKS == HalDisplay::BUFFER_SIZE,
                 "BW buffer chunking does not line up with display buffer size");
+  static_assert(HalDisplay::BUFFER_SIZE <= BufferPool::FRAME_SLAB, "A frame doesn't fit the pool's frame slab");
+
+  // Change tracking for displayBuffer(): the physical frame is split into 80x16 pixel tiles and a hash and black
+  // pixel count of each tile is kept for the frame currently on the panel
+  static constexpr int DIRTY_TILE_BYTES = 10;
+  static constexpr int DIRTY_TILE_ROWS = 16;
+  static constexpr int DIRTY_TILES_X = HalDisplay::DISPLAY_WIDTH_BYTES / DIRTY_TILE_BYTES;
+  static constexpr int DIRTY_TILES_Y = HalDisplay::DISPLAY_HEIGHT / DIRTY_TILE_ROWS;
+  static constexpr int DIRTY_TILE_COUNT = DIRTY_TILES_X * DIRTY_TILES_Y;
+  static_assert(DIRTY_TILES_X * DIRTY_TILE_BYTES == HalDisplay::DISPLAY_WIDTH_BYTES &&
+                    DIRTY_TILES_Y * DIRTY_TILE_ROWS == HalDisplay::DISPLAY_HEIGHT,
+                "Dirty tiles do not line up with the display");
+  static constexpr uint32_t DIRTY_TILE_PIXELS = DIRTY_TILE_BYTES * 8 * DIRTY_TILE_ROWS;
+  // Above this many changed tiles a full fast refresh is used instead of a window
+  static constexpr int MAX_WINDOW_TILES = DIRTY_TILE_COUNT / 2;
+  // Fast refreshes leave ghosting behind; once roughly this many pixels have been flipped with them since the
+  // last half/full refresh, the next automatic update cleans the panel with a half refresh
+  static constexpr uint32_t GHOSTING_PIXEL_BUDGET = 2 * HalDisplay::DISPLAY_WIDTH * HalDisplay::DISPLAY_HEIGHT;
+
+  struct FrameChanges {
+    int changedTiles = 0;
+    int minTx = DIRTY_TILES_X;
+    int minTy = DIRTY_TILES_Y;
+    int maxTx = -1;
+    int maxTy = -1;
+    uint32_t changedPixels = 0;  // Estimate, see diffTiles()
+  };
 
   HalDisplay& display;
   RenderMode renderMode;
@@ -38,20 +70,55 @@ class GfxRenderer {
   bool fadingFix;
   uint8_t* frameBuffer = nullptr;
   uint8_t* bwBufferChunks[BW_BUFFER_NUM_CHUNKS] = {nullptr};
-  std::map<int, EpdFontFamily> fontMap;
+  size_t bwPackedSize = 0;  // Non-zero while bwBufferChunks hold a packed snapshot, see storeBwBuffer()
+  BufferLease bwSnapshot;   // Plain copy of the frame, when storeBwBuffer() got a pool slab
+  uint8_t* msbPlaneChunks[BW_BUFFER_NUM_CHUNKS] = {nullptr};
+  mutable uint32_t shownTileHashes[DIRTY_TILE_COUNT] = {};
+  mutable uint32_t pendingTileHashes[DIRTY_TILE_COUNT] = {};
+  mutable uint16_t shownTileBlack[DIRTY_TILE_COUNT] = {};
+  mutable uint16_t pendingTileBlack[DIRTY_TILE_COUNT] = {};
+  mutable bool shownTileHashesValid = false;
+  mutable uint32_t ghostingDebt = 0;
+  // Registered fonts, looked up on every text call. A flat table scanned linearly is cheaper than a tree walk for
+  // this many entries and costs no heap nodes at boot. The ids are content hashes, not indices, so the slot of the
+  // last hit is remembered: text calls come in long runs on one font (a page, a menu), which then skip the scan.
+  static constexpr size_t MAX_FONTS = 24;
+  struct FontSlot {
+    int id = 0;
+    EpdFontFamily family{nullptr};
+  };
+  FontSlot fonts[MAX_FONTS];
+  size_t fontCount = 0;
+  // Atomic: layout on the background tasks looks fonts up alongside the render task; a stale hint only costs a scan
+  mutable std::atomic<size_t> lastFontSlot{0};
+  const EpdFontFamily* findFont(int fontId) const;
   FontDecompressor* fontDecompressor = nullptr;
+  // Shared by layout (word widths) and UI (labels, truncation); see TextWidthCache
+  mutable TextWidthCache textWidthCache;
+  mutable GlyphAtlas glyphAtlas;
   void renderChar(const EpdFontFamily& fontFamily, uint32_t cp, int* x, int* y, bool pixelState,
                   EpdFontFamily::Style style) const;
+  void drawTextWith(const EpdFontFamily& font, int x, int baseline, const char* text, bool black,
+                    EpdFontFamily::Style style) const;
   void freeBwBufferChunks();
-  template <Color color>
-  void drawPixelDither(int x, int y) const;
+  void fillPanelRect(int x, int y, int width, int height, const uint8_t rowPatterns[2]) const;
+  void drawBitmapRow(const uint8_t* row, const int16_t* columns, int first, int end, int screenY, bool oneBit) const;
+  bool storePackedBwBuffer();
+  void restorePackedBwBuffer();
+  void freeMsbPlaneChunks();
+  void hashPendingTiles() const;
+  FrameChanges diffTiles() const;
+  void commitPendingTiles() const;
   template <Color color>
   void fillArc(int maxRadius, int cx, int cy, int xDir, int yDir) const;
 
  public:
   explicit GfxRenderer(HalDisplay& halDisplay)
       : display(halDisplay), renderMode(BW), orientation(Portrait), fadingFix(false) {}
-  ~GfxRenderer() { freeBwBufferChunks(); }
+  ~GfxRenderer() {
+    freeBwBufferChunks();
+    freeMsbPlaneChunks();
+  }
 
   static constexpr int VIEWABLE_MARGIN_TOP = 9;
   static constexpr int VIEWABLE_MARGIN_RIGHT = 3;
@@ -61,10 +128,19 @@ class GfxRenderer {
   // Setup
   void begin();  // must be called right after display.begin()
   void insertFont(int fontId, EpdFontFamily font);
+  // Unregisters a font whose EpdFont objects are about to be freed (SD card fonts)
+  void removeFont(int fontId);
+  // Draw the 1-bit styles of a registered font through the glyph atlas (see GlyphAtlas); meant for the UI fonts
+  void enableGlyphAtlas(int fontId);
   void setFontDecompressor(FontDecompressor* d) { fontDecompressor = d; }
   void clearFontCache() {
     if (fontDecompressor) fontDecompressor->clearCache();
   }
+  // Bit i is set if the text uses glyph group i of the font selected by style (groups past 31 aren't tracked).
+  // Zero for uncompressed fonts.
+  uint32_t getGlyphGroupMask(int fontId, const char* text, EpdFontFamily::Style style) const;
+  // Decompress the masked glyph groups before drawing, in flash order, see FontDecompressor::prefetchGroup
+  void prefetchGlyphGroups(int fontId, EpdFontFamily::Style style, uint32_t groupMask) const;
 
   // Orientation control (affects logical width/height and coordinate transforms)
   void setOrientation(const Orientation o) { orientation = o; }
@@ -76,9 +152,16 @@ class GfxRenderer {
   // Screen ops
   int getScreenWidth() const;
   int getScreenHeight() const;
-  void displayBuffer(HalDisplay::RefreshMode refreshMode = HalDisplay::FAST_REFRESH) const;
-  // EXPERIMENTAL: Windowed update - display only a rectangular region
-  // void displayWindow(int x, int y, int width, int height) const;
+  // Picks the refresh itself: compares the frame buffer against the frame on the panel and does a windowed fast
+  // refresh of the changed area, a full fast refresh when most of the screen changed (or the panel state is
+  // unknown, e.g. after a grayscale pass), or a half refresh once fast refreshes have built up enough ghosting.
+  // Nothing is sent if the frame is unchanged.
+  void displayBuffer() const;
+  // Full update with a fixed refresh mode, for screens that manage their own refresh cadence
+  void displayBuffer(HalDisplay::RefreshMode refreshMode) const;
+  // Fast refresh of a rectangle in logical coordinates. The rest of the frame buffer is not sent, so anything
+  // drawn outside the window stays off the panel until the next full update.
+  void displayWindow(int x, int y, int width, int height) const;
   void invertScreen() const;
   void clearScreen(uint8_t color = 0xFF) const;
   void getOrientedViewableTRBL(int* outTop, int* outRight, int* outBottom, int* outLeft) const;
@@ -104,6 +187,11 @@ class GfxRenderer {
                   float cropY = 0) const;
   void drawBitmap1Bit(const Bitmap& bitmap, int x, int y, int maxWidth, int maxHeight) const;
   void fillPolygon(const int* xPoints, const int* yPoints, int numPoints, bool state = true) const;
+  // Physical panel rectangle covered by a logical rectangle in the current orientation
+  void getPanelRect(int x, int y, int width, int height, int* phyX, int* phyY, int* phyWidth, int* phyHeight) const;
+  // Draw one row of pre-rotated 1-bit pixels (MSB first, bit set = draw) straight into the frame buffer at panel
+  // coordinates: BW clears the bits, the grayscale LSB/MSB passes set them. Not for GRAYSCALE_PLANES.
+  void blitPanelRow(const uint8_t* bits, int phyX, int phyY, int phyWidth) const;
 
   // Text
   int getTextWidth(int fontId, const char* text, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
@@ -111,6 +199,14 @@ class GfxRenderer {
                         EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   void drawText(int fontId, int x, int y, const char* text, bool black = true,
                 EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
+  // One word of a line for drawTextRun; text is NUL-terminated
+  struct TextRunItem {
+    int x;
+    const char* text;
+    EpdFontFamily::Style style;
+  };
+  // Draws the words of one line (y is its top, as for drawText), resolving the font and baseline once
+  void drawTextRun(int fontId, int y, const TextRunItem* items, size_t count, bool black = true) const;
   int getSpaceWidth(int fontId, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   /// Returns the kerning adjustment for a space between two codepoints:
   /// kern(leftCp, ' ') + kern(' ', rightCp). Returns 0 if kerning is unavailable.
@@ -120,6 +216,12 @@ class GfxRenderer {
   int getTextAdvanceX(int fontId, const char* text, EpdFontFamily::Style style) const;
   int getFontAscenderSize(int fontId) const;
   int getLineHeight(int fontId) const;
+  // True if the font selected by style has 2-bit glyphs, the only text the grayscale passes draw anything for
+  bool isAntiAliased(int fontId, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
+  /// Byte length of the longest prefix of \p text that, followed by \p suffixCp (0 for none), is no wider than
+  /// \p maxWidth. One measuring pass, for cutting text to a width without re-measuring shorter and shorter copies.
+  size_t fitTextPrefix(int fontId, const char* text, int maxWidth, uint32_t suffixCp = 0,
+                       EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   std::string truncatedText(int fontId, const char* text, int maxWidth,
                             EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   /// Word-wrap \p text into at most \p maxLines lines, each no wider than
@@ -139,14 +241,35 @@ class GfxRenderer {
   void copyGrayscaleLsbBuffers() const;
   void copyGrayscaleMsbBuffers() const;
   void displayGrayBuffer() const;
-  bool storeBwBuffer();    // Returns true if buffer was stored successfully
-  void restoreBwBuffer();  // Restore and free the stored buffer
+  // Start the gray refresh on the display task and return; the frame buffer can be drawn into right away
+  HalDisplay::RefreshToken displayGrayBufferAsync() const;
+  bool storeBwBuffer();                         // Returns true if buffer was stored successfully
+  void restoreBwBuffer(bool syncDisplay = true);  // Restore and free the stored buffer
   void cleanupGrayscaleWithFrameBuffer() const;
+  // Single-pass grayscale: clears both planes and switches to GRAYSCALE_PLANES. Returns false (and leaves the render
+  // mode alone) if the MSB side buffer can't be allocated, callers then fall back to separate LSB/MSB passes.
+  // Only glyphs and the plain pixel primitives support this mode, so don't use it for pages with images.
+  bool beginGrayscalePlanes();
+  // Upload both planes to the display, free the side buffer and switch back to BW
+  void endGrayscalePlanes();
+  // Mark a pixel in the MSB plane (GRAYSCALE_PLANES mode only)
+  void drawMsbPlanePixel(int x, int y) const;
+  // PackBits-compressed copies of the frame buffer. Mostly white text pages shrink to a fraction of the 48KB
+  // buffer, which makes it affordable to keep a rendered page around. Fails if the result would exceed maxSize.
+  bool storeCompressedFrame(std::vector<uint8_t>& out, size_t maxSize) const;
+  bool restoreCompressedFrame(const std::vector<uint8_t>& in) const;
 
   // Font helpers
   const uint8_t* getGlyphBitmap(const EpdFontData* fontData, const EpdGlyph* glyph) const;
+  // Draws an upright glyph of an atlas font with its top left at (x, y). False if the font has no atlas or the glyph
+  // is not fully on screen, in which case it has to be drawn the regular way.
+  bool drawAtlasGlyph(const EpdFontData* fontData, const EpdGlyph* glyph, int x, int y, bool pixelState) const;
+  // Font drawn for a font id and style, nullptr if the id is unknown
+  const EpdFont* getFont(int fontId, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
 
   // Low level functions
   uint8_t* getFrameBuffer() const;
+  uint8_t* const* getMsbPlaneChunks() const { return msbPlaneChunks; }
+  static constexpr size_t getBwBufferChunkSize() { return BW_BUFFER_CHUNK_SIZE; }
   static size_t getBufferSize();
 };
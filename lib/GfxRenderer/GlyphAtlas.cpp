@@ -0,0 +1,84 @@
+#include "GlyphAtlas.h"
+
+#include <cstdlib>
+#include <cstring>
+
+void GlyphAtlas::addFont(const EpdFontData* font) {
+  if (!font || font->is2Bit || covers(font) || fontCount == MAX_FONTS) {
+    return;
+  }
+  fonts[fontCount++] = font;
+}
+
+bool GlyphAtlas::covers(const EpdFontData* font) const {
+  for (size_t i = 0; i < fontCount; i++) {
+    if (fonts[i] == font) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t GlyphAtlas::homeSlot(const EpdGlyph* glyph, const uint8_t orientation) {
+  const auto mixed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(glyph) >> 2) ^ orientation;
+  return (mixed * 0x9E3779B1u >> 16) & (SLOT_COUNT - 1);
+}
+
+const uint8_t* GlyphAtlas::find(const EpdGlyph* glyph, const uint8_t orientation) const {
+  if (!arena) {
+    return nullptr;
+  }
+  for (size_t index = homeSlot(glyph, orientation);; index = (index + 1) & (SLOT_COUNT - 1)) {
+    const Slot& slot = slots[index];
+    if (!slot.glyph) {
+      return nullptr;
+    }
+    if (slot.glyph == glyph && slot.orientation == orientation) {
+      return arena + slot.offset;
+    }
+  }
+}
+
+uint8_t* GlyphAtlas::insert(const EpdGlyph* glyph, const uint8_t orientation, const size_t size) {
+  if (!arena) {
+    slots = static_cast<Slot*>(malloc(SLOT_COUNT * sizeof(Slot)));
+    arena = static_cast<uint8_t*>(malloc(ARENA_BYTES));
+    if (!slots || !arena) {
+      release();
+      return nullptr;
+    }
+    reset();
+  }
+  if (size > ARENA_BYTES) {
+    return nullptr;
+  }
+  if (arenaUsed + size > ARENA_BYTES || entryCount == MAX_ENTRIES) {
+    reset();
+  }
+
+  size_t index = homeSlot(glyph, orientation);
+  while (slots[index].glyph) {
+    index = (index + 1) & (SLOT_COUNT - 1);
+  }
+  slots[index] = {glyph, static_cast<uint16_t>(arenaUsed), orientation};
+  entryCount++;
+  uint8_t* entry = arena + arenaUsed;
+  memset(entry, 0, size);
+  arenaUsed += size;
+  return entry;
+}
+
+void GlyphAtlas::reset() {
+  memset(slots, 0, SLOT_COUNT * sizeof(Slot));
+  arenaUsed = 0;
+  entryCount = 0;
+}
+
+void GlyphAtlas::release() {
+  free(slots);
+  free(arena);
+  slots = nullptr;
+  arena = nullptr;
+  arenaUsed = 0;
+  entryCount = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <EpdFontData.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Glyphs of the hot 1-bit fonts (the UI fonts), kept pre-rotated into the frame buffer's bit order: one byte-aligned
+// span per physical row the glyph covers. Drawing one is then a shift and an AND/OR per frame buffer byte instead of
+// a rotation and bit test per pixel. Built as glyphs are first drawn, per orientation, so only the characters menus
+// actually use take memory.
+//
+// Entries are bump allocated from one arena and dropped all together when the arena or the index fills up.
+class GlyphAtlas {
+ public:
+  ~GlyphAtlas() { release(); }
+
+  void addFont(const EpdFontData* font);
+  bool covers(const EpdFontData* font) const;
+
+  const uint8_t* find(const EpdGlyph* glyph, uint8_t orientation) const;
+  // Zeroed space for a new entry, nullptr if the atlas can't be allocated. Valid until the next insert.
+  uint8_t* insert(const EpdGlyph* glyph, uint8_t orientation, size_t size);
+
+ private:
+  static constexpr size_t MAX_FONTS = 8;
+  // About 20 bytes per UI glyph, so this holds the couple of hundred characters menus use in 8 KB all told
+  static constexpr size_t SLOT_COUNT = 256;
+  static constexpr size_t MAX_ENTRIES = SLOT_COUNT * 3 / 4;
+  static constexpr uint32_t ARENA_BYTES = 6 * 1024;
+
+  struct Slot {
+    const EpdGlyph* glyph;
+    uint16_t offset;
+    uint8_t orientation;
+  };
+
+  const EpdFontData* fonts[MAX_FONTS] = {};
+  size_t fontCount = 0;
+  Slot* slots = nullptr;
+  uint8_t* arena = nullptr;
+  uint32_t arenaUsed = 0;
+  size_t entryCount = 0;
+
+  static size_t homeSlot(const EpdGlyph* glyph, uint8_t orientation);
+  void reset();
+  void release();
+};
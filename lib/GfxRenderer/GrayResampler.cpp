@@ -0,0 +1,150 @@
+#include "GrayResampler.h"
+
+#include <Logging.h>
+
+#include <cstdlib>
+#include <cstring>
+
+GrayResampler::~GrayResampler() { release(); }
+
+void GrayResampler::release() {
+  free(columnOf);
+  free(columnRecip);
+  free(sums);
+  free(outRow);
+  columnOf = nullptr;
+  columnRecip = nullptr;
+  sums = nullptr;
+  outRow = nullptr;
+}
+
+void GrayResampler::fitSize(const int srcWidth, const int srcHeight, const int targetWidth, const int targetHeight,
+                            const bool fill, int* outWidth, int* outHeight) {
+  // Width is the limiting side when the target is relatively narrower than the source (wider when filling)
+  const bool widthLimited = fill ? targetWidth * srcHeight >= targetHeight * srcWidth
+                                 : targetWidth * srcHeight <= targetHeight * srcWidth;
+  if (widthLimited) {
+    *outWidth = targetWidth;
+    *outHeight = srcHeight * targetWidth / srcWidth;
+  } else {
+    *outWidth = srcWidth * targetHeight / srcHeight;
+    *outHeight = targetHeight;
+  }
+  if (*outWidth < 1) *outWidth = 1;
+  if (*outHeight < 1) *outHeight = 1;
+}
+
+bool GrayResampler::begin(const int srcW, const int srcH, const int outW, const int outH) {
+  release();
+  srcWidth = srcW;
+  srcHeight = srcH;
+  outWidth = outW;
+  outHeight = outH;
+  identity = srcW == outW && srcH == outH;
+  srcY = 0;
+  currentOut = 0;
+  sumRows = 0;
+
+  if (srcW <= 0 || srcH <= 0 || outW <= 0 || outH <= 0) {
+    return false;
+  }
+  if (srcW > outW * MAX_COLUMNS_PER_OUTPUT) {
+    LOG_ERR("RSMP", "Cannot shrink %d columns to %d", srcW, outW);
+    return false;
+  }
+
+  columnOf = static_cast<uint16_t*>(malloc(srcW * sizeof(uint16_t)));
+  columnRecip = static_cast<uint32_t*>(calloc(outW, sizeof(uint32_t)));
+  sums = static_cast<uint32_t*>(calloc(outW, sizeof(uint32_t)));
+  outRow = static_cast<uint8_t*>(malloc(outW));
+  if (!columnOf || !columnRecip || !sums || !outRow) {
+    LOG_ERR("RSMP", "Failed to allocate resampler for %d px wide output", outW);
+    release();
+    return false;
+  }
+
+  // Stepping through the columns keeps the table build free of divisions as well
+  int column = 0;
+  int error = 0;
+  for (int x = 0; x < srcW; x++) {
+    columnOf[x] = static_cast<uint16_t>(column);
+    columnRecip[column]++;
+    error += outW;
+    while (error >= srcW) {
+      error -= srcW;
+      column++;
+    }
+  }
+  for (int x = 0; x < outW; x++) {
+    if (columnRecip[x]) {
+      columnRecip[x] = (65536 + columnRecip[x] / 2) / columnRecip[x];
+    }
+  }
+  return true;
+}
+
+bool GrayResampler::emitRowsUntil(const int nextOut, const RowCallback& onRow) {
+  const uint32_t rowRecip = (65536 + sumRows / 2) / sumRows;
+  for (int x = 0; x < outWidth; x++) {
+    if (columnRecip[x]) {
+      // sum * (1 / columns) * (1 / rows) in 32.32 fixed point, rounded
+      const uint32_t value = (static_cast<uint64_t>(sums[x]) * columnRecip[x] * rowRecip + (1ULL << 31)) >> 32;
+      outRow[x] = value > 255 ? 255 : value;
+    } else {
+      // Upscaled columns without a source column of their own repeat the one to the left
+      outRow[x] = x > 0 ? outRow[x - 1] : 0;
+    }
+  }
+  for (; currentOut < nextOut && currentOut < outHeight; currentOut++) {
+    if (!onRow(currentOut, outRow)) {
+      return false;
+    }
+  }
+  memset(sums, 0, outWidth * sizeof(uint32_t));
+  sumRows = 0;
+  return true;
+}
+
+bool GrayResampler::advance(const RowCallback& onRow) {
+  // One division per source row; the per-pixel work stays table driven
+  const int outY = srcY * outHeight / srcHeight;
+  srcY++;
+  if (outY != currentOut && sumRows > 0) {
+    return emitRowsUntil(outY, onRow);
+  }
+  return true;
+}
+
+bool GrayResampler::pushRow(const uint8_t* gray, const RowCallback& onRow) {
+  if (!sums || srcY >= srcHeight) return false;
+  if (identity) {
+    return onRow(srcY++, gray);
+  }
+  if (!advance(onRow)) {
+    return false;
+  }
+  for (int x = 0; x < srcWidth; x++) {
+    sums[columnOf[x]] += gray[x];
+  }
+  sumRows++;
+  return true;
+}
+
+bool GrayResampler::pushRowSums(const uint16_t* rowSums, const RowCallback& onRow) {
+  if (!sums || srcY >= srcHeight) return false;
+  if (!advance(onRow)) {
+    return false;
+  }
+  for (int x = 0; x < outWidth; x++) {
+    sums[x] += rowSums[x];
+  }
+  sumRows++;
+  return true;
+}
+
+bool GrayResampler::finish(const RowCallback& onRow) {
+  if (!sums) return false;
+  // Identity pushRow() emits as it goes; rows summed through pushRowSums() still have a pending one
+  if (sumRows == 0) return true;
+  return emitRowsUntil(outHeight, onRow);
+}
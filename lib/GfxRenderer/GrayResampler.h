@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Area averaging resampler for 8-bit gray images that arrive one source row at a time, shared by the JPEG and PNG
+// converters. Integer only (the C3 has no FPU): each source column's output column comes from a table built once,
+// a row is folded into per-column sums with one add per pixel, and the averages use per-column fixed-point
+// reciprocals instead of a division per pixel. Upscaling repeats pixels.
+class GrayResampler {
+ public:
+  // Gets each output row top to bottom, outWidth gray values. Return false to stop.
+  using RowCallback = std::function<bool(int y, const uint8_t* gray)>;
+
+  // Largest number of source columns averaged into one output column, so a row sum fits in 16 bits
+  static constexpr int MAX_COLUMNS_PER_OUTPUT = 256;
+
+  GrayResampler() = default;
+  ~GrayResampler();
+  GrayResampler(const GrayResampler&) = delete;
+  GrayResampler& operator=(const GrayResampler&) = delete;
+
+  // Largest size with the source's aspect ratio that fits in (fill: covers) the target, at least 1x1
+  static void fitSize(int srcWidth, int srcHeight, int targetWidth, int targetHeight, bool fill, int* outWidth,
+                      int* outHeight);
+
+  // Builds the column tables. Returns false on a failed allocation or a too large reduction.
+  bool begin(int srcWidth, int srcHeight, int outWidth, int outHeight);
+
+  // Output column of each source column, for callers that sum pixels themselves (see pushRowSums)
+  const uint16_t* getColumnTable() const { return columnOf; }
+
+  // Adds the next source row, emitting the output rows it completes
+  bool pushRow(const uint8_t* gray, const RowCallback& onRow);
+
+  // Same for a row already summed per output column through getColumnTable()
+  bool pushRowSums(const uint16_t* rowSums, const RowCallback& onRow);
+
+  // Emits the rows still pending after the last source row
+  bool finish(const RowCallback& onRow);
+
+ private:
+  int srcWidth = 0;
+  int srcHeight = 0;
+  int outWidth = 0;
+  int outHeight = 0;
+  bool identity = false;
+  int srcY = 0;        // Next source row
+  int currentOut = 0;  // Output row being accumulated
+  int sumRows = 0;     // Source rows in sums
+
+  uint16_t* columnOf = nullptr;
+  uint32_t* columnRecip = nullptr;  // 65536 / source columns per output column, 0 for repeated columns
+  uint32_t* sums = nullptr;
+  uint8_t* outRow = nullptr;
+
+  // Moves to the output row of the next source row, emitting the finished ones
+  bool advance(const RowCallback& onRow);
+  bool emitRowsUntil(int nextOut, const RowCallback& onRow);
+  void release();
+};
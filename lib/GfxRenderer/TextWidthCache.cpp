@@ -0,0 +1,55 @@
+#include "TextWidthCache.h"
+
+#include <limits>
+
+uint64_t TextWidthCache::makeKey(const int fontId, const uint8_t style, const Measure measure, const char* text) {
+  // FNV-1a, seeded with the font, style and measure so the same word in another font gets another key
+  uint64_t hash = 14695981039346656037ull;
+  const auto mix = [&hash](const uint8_t byte) { hash = (hash ^ byte) * 1099511628211ull; };
+  const auto id = static_cast<uint32_t>(fontId);
+  for (int shift = 0; shift < 32; shift += 8) {
+    mix(static_cast<uint8_t>(id >> shift));
+  }
+  mix(style);
+  mix(measure);
+  for (auto p = reinterpret_cast<const uint8_t*>(text); *p; p++) {
+    mix(*p);
+  }
+  return hash;
+}
+
+bool TextWidthCache::lookup(const uint64_t key, int* width) const {
+  const uint32_t expectedTag = tag(key);
+  const auto expectedCheck = static_cast<uint32_t>(key);
+  size_t index = homeSlot(key);
+  for (size_t probe = 0; probe < PROBE_LIMIT; probe++) {
+    const Slot& slot = slots[index];
+    const uint32_t data = slot.data.load(std::memory_order_relaxed);
+    if ((data >> 16) == expectedTag && (slot.check.load(std::memory_order_relaxed) ^ data) == expectedCheck) {
+      *width = static_cast<int16_t>(data & 0xFFFF);
+      return true;
+    }
+    index = (index + 1) & (SLOT_COUNT - 1);
+  }
+  return false;
+}
+
+void TextWidthCache::store(const uint64_t key, const int width) {
+  if (width < std::numeric_limits<int16_t>::min() || width > std::numeric_limits<int16_t>::max()) {
+    return;
+  }
+  // First empty slot in the probe window, else the home slot
+  size_t target = homeSlot(key);
+  size_t index = target;
+  for (size_t probe = 0; probe < PROBE_LIMIT; probe++) {
+    if (slots[index].data.load(std::memory_order_relaxed) == 0) {
+      target = index;
+      break;
+    }
+    index = (index + 1) & (SLOT_COUNT - 1);
+  }
+
+  const uint32_t data = (tag(key) << 16) | static_cast<uint16_t>(width);
+  slots[target].data.store(data, std::memory_order_relaxed);
+  slots[target].check.store(static_cast<uint32_t>(key) ^ data, std::memory_order_relaxed);
+}
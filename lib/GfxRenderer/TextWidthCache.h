@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size memo of measured text widths, keyed by a 64-bit hash of (font, style, measure, text). Layout measures
+// every word of a chapter and most of them are repeats, and UI code measures the same labels on every redraw.
+//
+// Open addressed with a short linear probe and no chaining, so memory never grows: a miss simply overwrites the
+// home slot. Layout on the prefetch task and UI on the render task can hit it at the same time without a lock;
+// each slot is two 32-bit words stored as (hash ^ data, data), so a slot torn by a concurrent store fails its check
+// and reads as a miss (the lockless hashing trick from chess transposition tables).
+class TextWidthCache {
+ public:
+  enum Measure : uint8_t { BOUNDS, ADVANCE };
+
+  static uint64_t makeKey(int fontId, uint8_t style, Measure measure, const char* text);
+
+  bool lookup(uint64_t key, int* width) const;
+  void store(uint64_t key, int width);
+
+ private:
+  static constexpr size_t SLOT_COUNT = 512;  // 4 KB
+  static constexpr size_t PROBE_LIMIT = 4;
+
+  struct Slot {
+    std::atomic<uint32_t> check{0};
+    std::atomic<uint32_t> data{0};
+  };
+  Slot slots[SLOT_COUNT];
+
+  static size_t homeSlot(const uint64_t key) { return static_cast<size_t>(key >> 32) & (SLOT_COUNT - 1); }
+  // High hash bits beside the width; never zero, so an empty slot can't match
+  static uint32_t tag(const uint64_t key) { return static_cast<uint32_t>(key >> 48) | 1; }
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+HOT_PATH marks the few functions that the profiles show at the top of page layout and rendering (per-pixel and
+per-glyph drawing, the inflate loop, XML tokenizing, line breaking). The C3 runs code from flash through a 16 KB
+instruction cache, which these loops share with everything else; in the hot_path build (ENABLE_HOT_PATH_IRAM, see
+[env:hot_path] in platformio.ini) they are placed in IRAM instead, so they never miss. IRAM comes out of the same
+SRAM as the heap, so each byte placed there is a byte less heap: keep the list short, and keep it to functions a
+benchmark run shows a gain for. scripts/hot_path.py reports what the build put in IRAM.
+
+    void HOT_PATH GfxRenderer::drawPixel(...) { ... }
+
+In every other build, and on the host, HOT_PATH expands to nothing. Usable from C.
+*/
+#if defined(ENABLE_HOT_PATH_IRAM) && defined(ESP_PLATFORM)
+#include <esp_attr.h>
+#define HOT_PATH IRAM_ATTR
+#else
+#define HOT_PATH
+#endif
@@ -1,36 +1,48 @@
 #include "InflateReader.h"
 
+#include <Logging.h>
+#include <Metrics.h>
+
+#include <cstdlib>
 #include <cstring>
 #include <type_traits>
 
 namespace {
 constexpr size_t INFLATE_DICT_SIZE = 32768;
-}
+}  // namespace
 
 // Guarantee the cast pattern in the header comment is valid.
 static_assert(std::is_standard_layout<InflateReader>::value,
               "InflateReader must be standard-layout for the uzlib callback cast to work");
 
-InflateReader::~InflateReader() { deinit(); }
+InflateReader::~InflateReader() {
+  deinit();
+  free(fastTable);
+}
 
 bool InflateReader::init(const bool streaming) {
-  deinit();  // free any previously allocated ring buffer and reset state
+  deinit();  // return any previously leased ring buffer and reset state
 
   if (streaming) {
-    ringBuffer = static_cast<uint8_t*>(malloc(INFLATE_DICT_SIZE));
+    ringBuffer = BufferPool::lease(INFLATE_DICT_SIZE);
     if (!ringBuffer) return false;
-    memset(ringBuffer, 0, INFLATE_DICT_SIZE);
+    memset(ringBuffer.data(), 0, INFLATE_DICT_SIZE);
   }
 
-  uzlib_uncompress_init(&decomp, ringBuffer, ringBuffer ? INFLATE_DICT_SIZE : 0);
+  if (!fastTable && UZLIB_FAST_TABLE_ENTRIES > 0) {
+    fastTable = static_cast<unsigned short*>(malloc(UZLIB_FAST_TABLE_ENTRIES * sizeof(unsigned short)));
+    if (!fastTable) {
+      LOG_DBG("INF", "No memory for Huffman lookup tables, decoding without them");
+    }
+  }
+
+  uzlib_uncompress_init(&decomp, ringBuffer.data(), ringBuffer ? INFLATE_DICT_SIZE : 0);
+  decomp.fast_table = fastTable;
   return true;
 }
 
 void InflateReader::deinit() {
-  if (ringBuffer) {
-    free(ringBuffer);
-    ringBuffer = nullptr;
-  }
+  ringBuffer.release();
   memset(&decomp, 0, sizeof(decomp));
 }
 
@@ -56,6 +68,7 @@ bool InflateReader::read(uint8_t* dest, size_t len) {
   decomp.dest_limit = dest + len;
 
   const int res = uzlib_uncompress(&decomp);
+  metrics::add(metrics::INFLATED_BYTES, decomp.dest - dest);
   if (res < 0) return false;
   return decomp.dest == decomp.dest_limit;
 }
@@ -71,6 +84,7 @@ InflateStatus InflateReader::readAtMost(uint8_t* dest, size_t maxLen, size_t* pr
 
   const int res = uzlib_uncompress(&decomp);
   *produced = static_cast<size_t>(decomp.dest - dest);
+  metrics::add(metrics::INFLATED_BYTES, *produced);
 
   if (res == TINF_DONE) return InflateStatus::Done;
   if (res < 0) return InflateStatus::Error;
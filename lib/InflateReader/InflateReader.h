@@ -1,5 +1,6 @@
 #pragma once
 
+#include <BufferPool.h>
 #include <uzlib.h>
 
 #include <cstddef>
@@ -15,9 +16,19 @@ enum class InflateStatus {
 //
 // Two modes:
 //   init(false)  — one-shot: input is a contiguous buffer, call read() once.
-//   init(true)   — streaming: allocates a 32KB ring buffer for back-references
+//   init(true)   — streaming: needs a 32KB ring buffer for back-references
 //                  across multiple read() / readAtMost() calls.
 //
+// Huffman codes are decoded through uzlib's lookup tables (sized by UZLIB_CONF_FAST_LIT_BITS and
+// UZLIB_CONF_FAST_DIST_BITS), allocated on the first init() and kept until the reader is destroyed,
+// so a reader reused for many streams allocates them once. Without them (allocation failure) uzlib
+// falls back to walking the code trees.
+//
+// Streaming windows are leased from the slabs reserved at boot (see BufferPool) and handed
+// back by deinit() / the destructor, so a streaming inflate does not depend on finding 32KB
+// of contiguous heap later on. When every fitting slab is in use the ring buffer falls back
+// to malloc.
+//
 // Streaming callback pattern:
 //   The uzlib read callback receives a `struct uzlib_uncomp*` with no separate
 //   context pointer. To attach context, make InflateReader the *first member* of
@@ -44,12 +55,13 @@ class InflateReader {
   InflateReader(const InflateReader&) = delete;
   InflateReader& operator=(const InflateReader&) = delete;
 
-  // Initialise decompressor. streaming=true allocates a 32KB ring buffer needed
+  // Initialise decompressor. streaming=true leases a 32KB ring buffer needed
   // when read() or readAtMost() will be called multiple times.
-  // Returns false only in streaming mode if the ring buffer allocation fails.
+  // Returns false only in streaming mode if no slab is free and the fallback
+  // allocation fails.
   bool init(bool streaming = false);
 
-  // Release the ring buffer and reset internal state.
+  // Return the ring buffer (to the pool or the heap) and reset internal state.
   void deinit();
 
   // Set the entire compressed input as a contiguous memory buffer.
@@ -81,5 +93,6 @@ class InflateReader {
 
  private:
   uzlib_uncomp decomp = {};
-  uint8_t* ringBuffer = nullptr;
+  BufferLease ringBuffer;
+  unsigned short* fastTable = nullptr;  // UZLIB_FAST_TABLE_ENTRIES long
 };
@@ -0,0 +1,114 @@
+#include "JpegScaledDecoder.h"
+
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+// Offset of full size pixel (x, y) of the current MCU in picojpeg's MCU buffers
+int getMcuOffset(const pjpeg_image_info_t& info, const int x, const int y) {
+  if (info.m_scanType == PJPG_YH1V2) {
+    return (y >> 3) * 128 + (y & 7) * 8 + x;
+  }
+  return ((y >> 3) * (info.m_MCUWidth >> 3) + (x >> 3)) * 64 + (y & 7) * 8 + (x & 7);
+}
+
+struct Buffers {
+  uint16_t* rowSums = nullptr;  // One row of horizontal sums per source row of the MCU row
+  uint16_t* mcuOffsets = nullptr;
+
+  ~Buffers() {
+    free(rowSums);
+    free(mcuOffsets);
+  }
+};
+}  // namespace
+
+uint8_t JpegScaledDecoder::getReduceMode(const pjpeg_image_info_t& info, const int outWidth, const int outHeight) {
+  // Both axes have to shrink by the factor, otherwise the less reduced one would lose detail
+  const auto shrinksBy = [&](const int factor) {
+    return outWidth * factor <= info.m_width && outHeight * factor <= info.m_height;
+  };
+  if (shrinksBy(8)) return PJPG_REDUCE_DC;
+  if (shrinksBy(4)) return PJPG_REDUCE_LOW_2X2;
+  if (shrinksBy(2)) return PJPG_REDUCE_LOW_4X4;
+  return PJPG_REDUCE_NONE;
+}
+
+bool JpegScaledDecoder::decode(const pjpeg_image_info_t& info, const int outWidth, const int outHeight,
+                               const RowCallback& onRow, const bool dcOnly) {
+  if (outWidth <= 0 || outHeight <= 0) {
+    return false;
+  }
+
+  const uint8_t reduce = dcOnly ? static_cast<uint8_t>(PJPG_REDUCE_DC) : getReduceMode(info, outWidth, outHeight);
+  pjpeg_set_reduce(reduce);
+
+  // Decoded pixels per block side: one per block in DC mode
+  const int step = reduce == PJPG_REDUCE_DC ? 8 : 1;
+  const int srcWidth = (info.m_width + step - 1) / step;
+  const int srcHeight = (info.m_height + step - 1) / step;
+  const int mcuWidth = info.m_MCUWidth / step;
+  const int mcuHeight = info.m_MCUHeight / step;
+
+  GrayResampler resampler;
+  if (!resampler.begin(srcWidth, srcHeight, outWidth, outHeight)) {
+    return false;
+  }
+
+  Buffers buffers;
+  buffers.rowSums = static_cast<uint16_t*>(malloc(mcuHeight * outWidth * sizeof(uint16_t)));
+  buffers.mcuOffsets = static_cast<uint16_t*>(malloc(mcuWidth * mcuHeight * sizeof(uint16_t)));
+  if (!buffers.rowSums || !buffers.mcuOffsets) {
+    LOG_ERR("JPG", "Failed to allocate scaling buffers for %d px wide output", outWidth);
+    return false;
+  }
+
+  for (int y = 0; y < mcuHeight; y++) {
+    for (int x = 0; x < mcuWidth; x++) {
+      buffers.mcuOffsets[y * mcuWidth + x] = getMcuOffset(info, x * step, y * step);
+    }
+  }
+
+  const bool grayscale = info.m_comps == 1;
+  for (int mcuY = 0; mcuY < info.m_MCUSPerCol; mcuY++) {
+    memset(buffers.rowSums, 0, mcuHeight * outWidth * sizeof(uint16_t));
+    const int rowStart = mcuY * mcuHeight;
+    const int rows = std::min(mcuHeight, srcHeight - rowStart);
+
+    for (int mcuX = 0; mcuX < info.m_MCUSPerRow; mcuX++) {
+      const unsigned char status = pjpeg_decode_mcu();
+      if (status != 0) {
+        LOG_ERR("JPG", "JPEG decode MCU failed at (%d, %d) with error code: %d", mcuX, mcuY, status);
+        return false;
+      }
+
+      const int columnStart = mcuX * mcuWidth;
+      const int columns = std::min(mcuWidth, srcWidth - columnStart);
+      for (int y = 0; y < rows; y++) {
+        uint16_t* rowSum = buffers.rowSums + y * outWidth;
+        const uint16_t* offsets = buffers.mcuOffsets + y * mcuWidth;
+        const uint16_t* columnOf = resampler.getColumnTable() + columnStart;
+        for (int x = 0; x < columns; x++) {
+          const int offset = offsets[x];
+          const uint8_t gray =
+              grayscale ? info.m_pMCUBufR[offset]
+                        : static_cast<uint8_t>((info.m_pMCUBufR[offset] * 77 + info.m_pMCUBufG[offset] * 150 +
+                                                info.m_pMCUBufB[offset] * 29) >>
+                                               8);
+          rowSum[columnOf[x]] += gray;
+        }
+      }
+    }
+
+    for (int y = 0; y < rows; y++) {
+      if (!resampler.pushRowSums(buffers.rowSums + y * outWidth, onRow)) {
+        return false;
+      }
+    }
+  }
+
+  return resampler.finish(onRow);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <GrayResampler.h>
+#include <picojpeg.h>
+
+#include <cstdint>
+
+// Decodes a JPEG with picojpeg straight to grayscale rows of the output size. Downscaling starts in the DCT domain:
+// DC only (one pixel per block) at 1/8 and below, only the low frequency coefficients at 1/4 and 1/2. The rest is
+// area averaging through GrayResampler, so large sources are neither fully transformed nor point sampled.
+// Shared by the cover/thumbnail BMP converter and the in-book image decoder.
+class JpegScaledDecoder {
+ public:
+  // Gets each output row top to bottom, outWidth gray values (0 = black). Return false to stop decoding.
+  using RowCallback = GrayResampler::RowCallback;
+
+  // Call after pjpeg_decode_init() succeeded with reduce = 0. Returns false on a decode error, a failed allocation
+  // or if the callback stopped it. dcOnly decodes one pixel per block whatever the output size, blown up by repeating
+  // pixels: a blocky preview for a fraction of the time.
+  static bool decode(const pjpeg_image_info_t& info, int outWidth, int outHeight, const RowCallback& onRow,
+                     bool dcOnly = false);
+
+  // picojpeg reduce mode for scaling the image to outWidth x outHeight
+  static uint8_t getReduceMode(const pjpeg_image_info_t& info, int outWidth, int outHeight);
+};
@@ -4,6 +4,7 @@
 
 class Print;
 class ZipFile;
+struct BmpOutput;
 
 class JpegToBmpConverter {
   static unsigned char jpegReadCallback(unsigned char* pBuf, unsigned char buf_size,
@@ -17,4 +18,6 @@ class JpegToBmpConverter {
   static bool jpegFileToBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
   // Convert to 1-bit BMP (black and white only, no grays) for fast home screen rendering
   static bool jpegFileTo1BitBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
+  // Decode once and write every output (e.g. cover and thumbnails), each scaled and dithered on its own
+  static bool jpegFileToBmpStreams(FsFile& jpegFile, const BmpOutput* outputs, int count);
 };
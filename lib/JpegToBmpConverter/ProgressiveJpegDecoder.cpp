@@ -0,0 +1,755 @@
+#include "ProgressiveJpegDecoder.h"
+
+#include <Logging.h>
+#include <picojpeg.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+enum Marker : uint8_t {
+  M_SOF0 = 0xC0,
+  M_SOF1 = 0xC1,
+  M_SOF2 = 0xC2,
+  M_DHT = 0xC4,
+  M_RST0 = 0xD0,
+  M_RST7 = 0xD7,
+  M_SOI = 0xD8,
+  M_EOI = 0xD9,
+  M_SOS = 0xDA,
+  M_DQT = 0xDB,
+  M_DRI = 0xDD,
+};
+
+bool isRestartMarker(const int marker) { return marker >= M_RST0 && marker <= M_RST7; }
+
+bool isOtherFrameMarker(const int marker) {
+  // SOF3, SOF5-7, SOF9-11, SOF13-15: lossless, hierarchical and arithmetic coded frames
+  return marker >= 0xC3 && marker <= 0xCF && marker != M_DHT && marker != 0xC8 && marker != 0xCC;
+}
+
+// Natural (row major) index of each zigzag position
+constexpr uint8_t ZIGZAG_TO_NATURAL[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                           12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                           35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                           58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Zigzag positions needed for the k x k lowest frequencies: 1, 2x2, 4x4 and 8x8
+int getStoredCount(const int size) {
+  switch (size) {
+    case 1:
+      return 1;
+    case 2:
+      return 5;
+    case 4:
+      return 25;
+    default:
+      return 64;
+  }
+}
+
+// cos(m * pi / 16) in 2.13 fixed point
+int cos16(int m) {
+  static constexpr int16_t COS[9] = {8192, 8035, 7568, 6811, 5793, 4551, 3135, 1598, 0};
+  m &= 31;
+  if (m > 16) m = 32 - m;
+  return m <= 8 ? COS[m] : -COS[16 - m];
+}
+
+int clampCoefficient(const int value) { return value < -2048 ? -2048 : (value > 2047 ? 2047 : value); }
+}  // namespace
+
+bool ProgressiveJpegDecoder::handlesPicojpegStatus(const uint8_t status) {
+  return status == PJPG_UNSUPPORTED_MODE || status == PJPG_NOT_SINGLE_SCAN || status == PJPG_UNSUPPORTED_SAMP_FACTORS;
+}
+
+ProgressiveJpegDecoder::ProgressiveJpegDecoder(FsFile& file) : file(file) {}
+
+ProgressiveJpegDecoder::~ProgressiveJpegDecoder() { free(coefficients); }
+
+int ProgressiveJpegDecoder::readByte() {
+  if (bufferPos >= bufferLen) {
+    const int count = file.read(buffer, sizeof(buffer));
+    if (count <= 0) {
+      return -1;
+    }
+    bufferLen = count;
+    bufferPos = 0;
+  }
+  return buffer[bufferPos++];
+}
+
+bool ProgressiveJpegDecoder::readU16(uint16_t& value) {
+  const int high = readByte();
+  const int low = readByte();
+  if (high < 0 || low < 0) return false;
+  value = static_cast<uint16_t>((high << 8) | low);
+  return true;
+}
+
+bool ProgressiveJpegDecoder::skipBytes(int count) {
+  while (count-- > 0) {
+    if (readByte() < 0) return false;
+  }
+  return true;
+}
+
+int ProgressiveJpegDecoder::findMarker() {
+  int byte = readByte();
+  for (;;) {
+    while (byte >= 0 && byte != 0xFF) {
+      byte = readByte();
+    }
+    if (byte < 0) return M_EOI;
+    // Any number of 0xFF fill bytes may precede the marker; 0xFF00 is stuffed data
+    do {
+      byte = readByte();
+    } while (byte == 0xFF);
+    if (byte < 0) return M_EOI;
+    if (byte != 0) return byte;
+    byte = readByte();
+  }
+}
+
+int ProgressiveJpegDecoder::nextMarker() {
+  if (pendingMarker >= 0) {
+    const int marker = pendingMarker;
+    pendingMarker = -1;
+    return marker;
+  }
+  return findMarker();
+}
+
+bool ProgressiveJpegDecoder::skipSegment() {
+  uint16_t length;
+  return readU16(length) && length >= 2 && skipBytes(length - 2);
+}
+
+bool ProgressiveJpegDecoder::readQuantTables() {
+  uint16_t length;
+  if (!readU16(length) || length < 2) return false;
+  int remaining = length - 2;
+  while (remaining > 0) {
+    const int info = readByte();
+    if (info < 0) return false;
+    const bool wide = (info >> 4) != 0;
+    uint16_t* table = quant[info & 3];
+    for (int i = 0; i < 64; i++) {
+      if (wide) {
+        if (!readU16(table[i])) return false;
+      } else {
+        const int value = readByte();
+        if (value < 0) return false;
+        table[i] = value;
+      }
+    }
+    remaining -= 1 + (wide ? 128 : 64);
+  }
+  return remaining == 0;
+}
+
+bool ProgressiveJpegDecoder::readHuffmanTables() {
+  uint16_t length;
+  if (!readU16(length) || length < 2) return false;
+  int remaining = length - 2;
+  while (remaining > 0) {
+    const int info = readByte();
+    if (info < 0) return false;
+    HuffmanTable& table = (info >> 4) ? acTables[info & 3] : dcTables[info & 3];
+
+    uint8_t counts[17] = {};
+    int total = 0;
+    for (int len = 1; len <= 16; len++) {
+      const int count = readByte();
+      if (count < 0) return false;
+      counts[len] = count;
+      total += count;
+    }
+    if (total > 256) {
+      LOG_ERR("PJPG", "Bad Huffman table (%d codes)", total);
+      return false;
+    }
+    for (int i = 0; i < total; i++) {
+      const int value = readByte();
+      if (value < 0) return false;
+      table.values[i] = value;
+    }
+    remaining -= 17 + total;
+
+    // Canonical codes, plus a lookup on the next 8 bits for the short ones
+    memset(table.fastLength, 0, sizeof(table.fastLength));
+    int code = 0;
+    int index = 0;
+    for (int len = 1; len <= 16; len++) {
+      table.valueOffset[len] = index - code;
+      for (int i = 0; i < counts[len]; i++, index++, code++) {
+        if (len <= 8) {
+          const int first = code << (8 - len);
+          for (int j = 0; j < (1 << (8 - len)); j++) {
+            table.fastLength[first + j] = len;
+            table.fastValue[first + j] = table.values[index];
+          }
+        }
+      }
+      table.maxCode[len] = counts[len] ? code - 1 : -1;
+      code <<= 1;
+    }
+    table.defined = true;
+  }
+  return remaining == 0;
+}
+
+bool ProgressiveJpegDecoder::readFrame(const uint8_t marker) {
+  uint16_t length, frameHeight, frameWidth;
+  if (!readU16(length)) return false;
+  const int precision = readByte();
+  if (precision < 0 || !readU16(frameHeight) || !readU16(frameWidth)) return false;
+  const int count = readByte();
+  if (precision != 8 || count < 0) {
+    LOG_ERR("PJPG", "Unsupported sample precision: %d", precision);
+    return false;
+  }
+  if (count != 1 && count != 3) {
+    LOG_ERR("PJPG", "Unsupported component count: %d", count);
+    return false;
+  }
+  if (frameWidth == 0 || frameHeight == 0) {
+    LOG_ERR("PJPG", "Missing image size");
+    return false;
+  }
+
+  progressive = marker == M_SOF2;
+  width = frameWidth;
+  height = frameHeight;
+  componentCount = count;
+  maxH = 1;
+  maxV = 1;
+  for (int i = 0; i < count; i++) {
+    const int id = readByte();
+    const int sampling = readByte();
+    const int table = readByte();
+    if (id < 0 || sampling < 0 || table < 0) return false;
+    Component& component = components[i];
+    component.id = id;
+    component.h = count == 1 ? 1 : sampling >> 4;
+    component.v = count == 1 ? 1 : sampling & 15;
+    component.quantTable = table & 3;
+    if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4) {
+      LOG_ERR("PJPG", "Bad sampling factors: %d", sampling);
+      return false;
+    }
+    maxH = std::max(maxH, static_cast<int>(component.h));
+    maxV = std::max(maxV, static_cast<int>(component.v));
+  }
+
+  mcusWide = (width + 8 * maxH - 1) / (8 * maxH);
+  mcusHigh = (height + 8 * maxV - 1) / (8 * maxV);
+  for (int i = 0; i < count; i++) {
+    Component& component = components[i];
+    const int componentWidth = (width * component.h + maxH - 1) / maxH;
+    const int componentHeight = (height * component.v + maxV - 1) / maxV;
+    component.blocksWide = (componentWidth + 7) / 8;
+    component.blocksHigh = (componentHeight + 7) / 8;
+  }
+  return true;
+}
+
+bool ProgressiveJpegDecoder::readRestartInterval() {
+  uint16_t length, interval;
+  if (!readU16(length) || length != 4 || !readU16(interval)) return false;
+  restartInterval = interval;
+  return true;
+}
+
+bool ProgressiveJpegDecoder::readScanHeader(Scan& scan) {
+  uint16_t length;
+  const bool ok = readU16(length);
+  const int count = readByte();
+  if (!ok || count < 1 || count > componentCount) return false;
+  scan.count = count;
+  for (int i = 0; i < count; i++) {
+    const int id = readByte();
+    const int tables = readByte();
+    if (id < 0 || tables < 0) return false;
+    int index = -1;
+    for (int c = 0; c < componentCount; c++) {
+      if (components[c].id == id) index = c;
+    }
+    if (index < 0) {
+      LOG_ERR("PJPG", "Scan references unknown component %d", id);
+      return false;
+    }
+    scan.components[i] = index;
+    components[index].dcTable = (tables >> 4) & 3;
+    components[index].acTable = tables & 3;
+  }
+  const int start = readByte();
+  const int end = readByte();
+  const int approx = readByte();
+  if (start < 0 || end < 0 || approx < 0) return false;
+  scan.spectralStart = progressive ? start : 0;
+  scan.spectralEnd = progressive ? end : 63;
+  scan.approxHigh = progressive ? approx >> 4 : 0;
+  scan.approxLow = progressive ? approx & 15 : 0;
+  if (scan.spectralStart > scan.spectralEnd || scan.spectralEnd > 63 || (scan.spectralStart > 0 && count != 1)) {
+    LOG_ERR("PJPG", "Bad scan: spectral %d-%d over %d components", start, end, count);
+    return false;
+  }
+  return true;
+}
+
+bool ProgressiveJpegDecoder::readHeader() {
+  int marker = findMarker();
+  if (marker != M_SOI) {
+    LOG_ERR("PJPG", "Not a JPEG file");
+    return false;
+  }
+  for (;;) {
+    marker = findMarker();
+    switch (marker) {
+      case M_SOF0:
+      case M_SOF1:
+      case M_SOF2:
+        return readFrame(marker);
+      case M_DQT:
+        if (!readQuantTables()) return false;
+        break;
+      case M_DHT:
+        if (!readHuffmanTables()) return false;
+        break;
+      case M_DRI:
+        if (!readRestartInterval()) return false;
+        break;
+      case M_EOI:
+      case M_SOS:
+        LOG_ERR("PJPG", "No frame header");
+        return false;
+      default:
+        if (isOtherFrameMarker(marker)) {
+          LOG_ERR("PJPG", "Unsupported JPEG frame type: 0x%02X", marker);
+          return false;
+        }
+        if (!skipSegment()) return false;
+        break;
+    }
+  }
+}
+
+void ProgressiveJpegDecoder::fillBits() {
+  while (bitCount <= 24) {
+    int byte = 0;
+    if (pendingMarker < 0) {
+      byte = readByte();
+      if (byte < 0) {
+        pendingMarker = M_EOI;
+        byte = 0;
+      } else if (byte == 0xFF) {
+        int next = readByte();
+        while (next == 0xFF) {
+          next = readByte();
+        }
+        if (next == 0) {
+          byte = 0xFF;
+        } else {
+          // End of the entropy coded segment: the decoder sees zeros from here
+          pendingMarker = next < 0 ? M_EOI : next;
+          byte = 0;
+        }
+      }
+    }
+    bitBuffer = (bitBuffer << 8) | byte;
+    bitCount += 8;
+  }
+}
+
+int ProgressiveJpegDecoder::getBits(const int count) {
+  if (count == 0) return 0;
+  if (bitCount < count) fillBits();
+  bitCount -= count;
+  return static_cast<int>((bitBuffer >> bitCount) & ((1u << count) - 1));
+}
+
+int ProgressiveJpegDecoder::getBit() { return getBits(1); }
+
+int ProgressiveJpegDecoder::decodeHuffman(const HuffmanTable& table) {
+  if (bitCount < 16) fillBits();
+  const int look = (bitBuffer >> (bitCount - 8)) & 0xFF;
+  if (table.fastLength[look]) {
+    bitCount -= table.fastLength[look];
+    return table.fastValue[look];
+  }
+  for (int len = 9; len <= 16; len++) {
+    const int code = static_cast<int>((bitBuffer >> (bitCount - len)) & ((1u << len) - 1));
+    if (code <= table.maxCode[len]) {
+      bitCount -= len;
+      return table.values[(table.valueOffset[len] + code) & 0xFF];
+    }
+  }
+  // Corrupt data: drop a byte and carry on, the image just gets garbled
+  bitCount -= 8;
+  return 0;
+}
+
+int ProgressiveJpegDecoder::extend(const int value, const int bits) {
+  return value < (1 << (bits - 1)) ? value - (1 << bits) + 1 : value;
+}
+
+void ProgressiveJpegDecoder::decodeDcFirst(Component& component, int16_t* block, const int stored,
+                                           const int approxLow) {
+  const int bits = decodeHuffman(dcTables[component.dcTable]);
+  const int diff = bits ? extend(getBits(bits), bits) : 0;
+  component.dcPrediction += diff;
+  if (stored > 0) {
+    block[0] = static_cast<int16_t>(component.dcPrediction * (1 << approxLow));
+  }
+}
+
+void ProgressiveJpegDecoder::decodeDcRefine(int16_t* block, const int stored, const int approxLow) {
+  if (getBit() && stored > 0) {
+    block[0] |= static_cast<int16_t>(1 << approxLow);
+  }
+}
+
+void ProgressiveJpegDecoder::decodeAcFirst(const Component& component, int16_t* block, const int stored,
+                                           const int start, const int end, const int approxLow) {
+  if (eobRun > 0) {
+    eobRun--;
+    return;
+  }
+  const HuffmanTable& table = acTables[component.acTable];
+  for (int k = start; k <= end; k++) {
+    const int symbol = decodeHuffman(table);
+    const int run = symbol >> 4;
+    const int bits = symbol & 15;
+    if (bits == 0) {
+      if (run < 15) {
+        // End of band, for this block and the next eobRun blocks
+        eobRun = (1 << run) - 1 + getBits(run);
+        return;
+      }
+      k += 15;  // 16 zeros
+      continue;
+    }
+    k += run;
+    const int value = extend(getBits(bits), bits);
+    if (k < stored) {
+      block[k] = static_cast<int16_t>(value * (1 << approxLow));
+    }
+  }
+}
+
+void ProgressiveJpegDecoder::decodeAcRefine(const Component& component, int16_t* block, const int start,
+                                            const int end, const int approxLow) {
+  // Only called when the whole band is stored: refinement bits follow every coefficient that is already non-zero
+  const int positive = 1 << approxLow;
+  const int negative = -1 * (1 << approxLow);
+  const auto refine = [&](int16_t& coefficient) {
+    if (getBit() && (coefficient & positive) == 0) {
+      coefficient = static_cast<int16_t>(coefficient + (coefficient >= 0 ? positive : negative));
+    }
+  };
+
+  int k = start;
+  if (eobRun == 0) {
+    const HuffmanTable& table = acTables[component.acTable];
+    for (; k <= end; k++) {
+      const int symbol = decodeHuffman(table);
+      int run = symbol >> 4;
+      const int bits = symbol & 15;
+      int value = 0;
+      if (bits) {
+        // A newly non-zero coefficient, always +-1 at this bit position
+        value = getBit() ? positive : negative;
+      } else if (run != 15) {
+        eobRun = (1 << run) + getBits(run);
+        break;
+      }
+      // Skip run zero coefficients, refining the non-zero ones on the way
+      for (; k <= end; k++) {
+        if (block[k] != 0) {
+          refine(block[k]);
+        } else if (--run < 0) {
+          break;
+        }
+      }
+      if (value && k <= end) {
+        block[k] = static_cast<int16_t>(value);
+      }
+    }
+  }
+  if (eobRun > 0) {
+    for (; k <= end; k++) {
+      if (block[k] != 0) refine(block[k]);
+    }
+    eobRun--;
+  }
+}
+
+void ProgressiveJpegDecoder::decodeBlock(const Scan& scan, Component& component, int16_t* block, const int stored) {
+  if (!progressive) {
+    decodeDcFirst(component, block, stored, 0);
+    decodeAcFirst(component, block, stored, 1, 63, 0);
+  } else if (scan.spectralStart == 0) {
+    if (scan.approxHigh == 0) {
+      decodeDcFirst(component, block, stored, scan.approxLow);
+    } else {
+      decodeDcRefine(block, stored, scan.approxLow);
+    }
+  } else if (scan.approxHigh == 0) {
+    decodeAcFirst(component, block, stored, scan.spectralStart, scan.spectralEnd, scan.approxLow);
+  } else {
+    decodeAcRefine(component, block, scan.spectralStart, scan.spectralEnd, scan.approxLow);
+  }
+}
+
+bool ProgressiveJpegDecoder::shouldDecode(const Scan& scan) const {
+  // DC scans and sequential scans hold luma data for every block: always decoded
+  if (!progressive || scan.spectralStart == 0) return true;
+  // Progressive AC scans have a single component
+  if (scan.components[0] != 0) return false;
+  if (scan.spectralStart >= storedCount) return false;
+  // Refinement past the stored coefficients needs the ones that are not stored
+  return scan.approxHigh == 0 || scan.spectralEnd < storedCount;
+}
+
+void ProgressiveJpegDecoder::skipScan() {
+  int marker = findMarker();
+  while (isRestartMarker(marker)) {
+    marker = findMarker();
+  }
+  pendingMarker = marker;
+}
+
+bool ProgressiveJpegDecoder::restart() {
+  bitBuffer = 0;
+  bitCount = 0;
+  const int marker = nextMarker();
+  if (!isRestartMarker(marker)) {
+    LOG_ERR("PJPG", "Expected a restart marker, got 0x%02X", marker);
+    pendingMarker = marker;
+    return false;
+  }
+  for (int c = 0; c < componentCount; c++) {
+    components[c].dcPrediction = 0;
+  }
+  eobRun = 0;
+  return true;
+}
+
+bool ProgressiveJpegDecoder::decodeScan(const Scan& scan) {
+  if (!shouldDecode(scan)) {
+    skipScan();
+    return true;
+  }
+  for (int c = 0; c < componentCount; c++) {
+    if (!dcTables[components[c].dcTable].defined && (scan.spectralStart == 0 && scan.approxHigh == 0)) {
+      LOG_ERR("PJPG", "Scan uses an undefined DC table");
+      return false;
+    }
+  }
+  bitBuffer = 0;
+  bitCount = 0;
+  eobRun = 0;
+  for (int c = 0; c < componentCount; c++) {
+    components[c].dcPrediction = 0;
+  }
+
+  const auto blockAt = [&](const int componentIndex, const int blockX, const int blockY) -> int16_t* {
+    if (componentIndex != 0) return nullptr;
+    return coefficients + (static_cast<size_t>(blockY) * lumaBlocksPerLine + blockX) * storedCount;
+  };
+  // A restart marker follows every restartInterval MCUs, except after the last one
+  const int mcuCount = scan.count == 1 ? components[scan.components[0]].blocksWide *
+                                             components[scan.components[0]].blocksHigh
+                                       : mcusWide * mcusHigh;
+  int mcusDone = 0;
+  const auto nextMcu = [&]() {
+    mcusDone++;
+    if (restartInterval == 0 || mcusDone % restartInterval != 0 || mcusDone == mcuCount) return true;
+    return restart();
+  };
+
+  if (scan.count == 1) {
+    // Non-interleaved: one block per MCU over the component's own size
+    const int index = scan.components[0];
+    Component& component = components[index];
+    const int stored = index == 0 ? storedCount : 0;
+    for (int by = 0; by < component.blocksHigh; by++) {
+      for (int bx = 0; bx < component.blocksWide; bx++) {
+        int16_t* block = blockAt(index, bx, by);
+        decodeBlock(scan, component, block, stored);
+        // Lost sync: keep what was decoded and go on with the next marker
+        if (!nextMcu()) return true;
+      }
+    }
+  } else {
+    for (int mcuY = 0; mcuY < mcusHigh; mcuY++) {
+      for (int mcuX = 0; mcuX < mcusWide; mcuX++) {
+        for (int i = 0; i < scan.count; i++) {
+          const int index = scan.components[i];
+          Component& component = components[index];
+          const int stored = index == 0 ? storedCount : 0;
+          for (int v = 0; v < component.v; v++) {
+            for (int h = 0; h < component.h; h++) {
+              int16_t* block = blockAt(index, mcuX * component.h + h, mcuY * component.v + v);
+              decodeBlock(scan, component, block, stored);
+            }
+          }
+        }
+        // Lost sync: keep what was decoded and go on with the next marker
+        if (!nextMcu()) return true;
+      }
+    }
+  }
+
+  if (pendingMarker < 0) {
+    pendingMarker = findMarker();
+  }
+  while (isRestartMarker(pendingMarker)) {
+    pendingMarker = findMarker();
+  }
+  return true;
+}
+
+bool ProgressiveJpegDecoder::emitImage(const int reducedSize, const int outWidth, const int outHeight,
+                                       const RowCallback& onRow) {
+  const Component& luma = components[0];
+  const int lumaWidth = (width * luma.h + maxH - 1) / maxH;
+  const int lumaHeight = (height * luma.v + maxV - 1) / maxV;
+  const int reducedWidth = (lumaWidth * reducedSize + 7) / 8;
+  const int reducedHeight = (lumaHeight * reducedSize + 7) / 8;
+
+  GrayResampler resampler;
+  if (!resampler.begin(reducedWidth, reducedHeight, outWidth, outHeight)) {
+    return false;
+  }
+  const int stride = luma.blocksWide * reducedSize;
+  auto* rows = static_cast<uint8_t*>(malloc(static_cast<size_t>(stride) * reducedSize));
+  if (!rows) {
+    LOG_ERR("PJPG", "Failed to allocate %d byte row buffer", stride * reducedSize);
+    return false;
+  }
+
+  // 1-D inverse DCT weights of the reduced size: C(u) * cos((2x + 1) * u * pi / (2 * size)), 2.13 fixed point
+  int weights[8][8];
+  int zigzagOf[64];
+  for (int x = 0; x < reducedSize; x++) {
+    for (int u = 0; u < reducedSize; u++) {
+      weights[x][u] = u == 0 ? cos16(4) : cos16((2 * x + 1) * u * (8 / reducedSize));
+    }
+  }
+  for (int i = 0; i < 64; i++) {
+    zigzagOf[ZIGZAG_TO_NATURAL[i]] = i;
+  }
+  const uint16_t* table = quant[luma.quantTable];
+
+  bool ok = true;
+  for (int by = 0; by < luma.blocksHigh && ok; by++) {
+    for (int bx = 0; bx < luma.blocksWide; bx++) {
+      const int16_t* block = coefficients + (static_cast<size_t>(by) * lumaBlocksPerLine + bx) * storedCount;
+      int rowPass[8][8];
+      for (int v = 0; v < reducedSize; v++) {
+        int dequantized[8];
+        for (int u = 0; u < reducedSize; u++) {
+          const int zigzag = zigzagOf[v * 8 + u];
+          dequantized[u] = clampCoefficient(block[zigzag] * table[zigzag]);
+        }
+        for (int x = 0; x < reducedSize; x++) {
+          int sum = 0;
+          for (int u = 0; u < reducedSize; u++) {
+            sum += dequantized[u] * weights[x][u];
+          }
+          rowPass[v][x] = (sum + (1 << 12)) >> 13;
+        }
+      }
+      for (int y = 0; y < reducedSize; y++) {
+        uint8_t* out = rows + y * stride + bx * reducedSize;
+        for (int x = 0; x < reducedSize; x++) {
+          int sum = 0;
+          for (int v = 0; v < reducedSize; v++) {
+            sum += rowPass[v][x] * weights[y][v];
+          }
+          // Two 1/2 factors of the 2-D transform, then the level shift
+          const int value = ((sum + (1 << 14)) >> 15) + 128;
+          out[x] = value < 0 ? 0 : (value > 255 ? 255 : value);
+        }
+      }
+    }
+    for (int y = 0; y < reducedSize && ok; y++) {
+      if (by * reducedSize + y < reducedHeight) {
+        ok = resampler.pushRow(rows + y * stride, onRow);
+      }
+    }
+  }
+  free(rows);
+  return ok && resampler.finish(onRow);
+}
+
+bool ProgressiveJpegDecoder::decode(const int outWidth, const int outHeight, const RowCallback& onRow) {
+  if (width == 0 || outWidth <= 0 || outHeight <= 0) {
+    return false;
+  }
+
+  // Frequencies the output needs, like JpegScaledDecoder's reduce modes
+  const auto shrinksBy = [&](const int factor) { return outWidth * factor <= width && outHeight * factor <= height; };
+  int reducedSize = shrinksBy(8) ? 1 : (shrinksBy(4) ? 2 : (shrinksBy(2) ? 4 : 8));
+
+  const Component& luma = components[0];
+  lumaBlocksPerLine = componentCount == 1 ? luma.blocksWide : mcusWide * luma.h;
+  const int lumaBlockRows = componentCount == 1 ? luma.blocksHigh : mcusHigh * luma.v;
+  const size_t blockCount = static_cast<size_t>(lumaBlocksPerLine) * lumaBlockRows;
+  while (reducedSize > 1 && blockCount * getStoredCount(reducedSize) * sizeof(int16_t) > COEFFICIENT_BUDGET) {
+    reducedSize /= 2;
+  }
+  storedCount = getStoredCount(reducedSize);
+  const size_t bytes = blockCount * storedCount * sizeof(int16_t);
+  if (bytes > COEFFICIENT_BUDGET) {
+    LOG_ERR("PJPG", "Image too large for progressive decoding: %dx%d", width, height);
+    return false;
+  }
+  coefficients = static_cast<int16_t*>(calloc(blockCount * storedCount, sizeof(int16_t)));
+  if (!coefficients) {
+    LOG_ERR("PJPG", "Failed to allocate %d bytes of coefficients", static_cast<int>(bytes));
+    return false;
+  }
+  LOG_DBG("PJPG", "Decoding %s JPEG %dx%d at 1/%d, %d coefficients per block (%d bytes)",
+          progressive ? "progressive" : "multi-scan", width, height, 8 / reducedSize, storedCount,
+          static_cast<int>(bytes));
+
+  int scans = 0;
+  for (;;) {
+    const int marker = nextMarker();
+    bool ok = true;
+    switch (marker) {
+      case M_EOI:
+        if (scans == 0) {
+          LOG_ERR("PJPG", "No scans in file");
+          return false;
+        }
+        return emitImage(reducedSize, outWidth, outHeight, onRow);
+      case M_SOS: {
+        Scan scan;
+        ok = readScanHeader(scan) && decodeScan(scan);
+        scans++;
+        break;
+      }
+      case M_DQT:
+        ok = readQuantTables();
+        break;
+      case M_DHT:
+        ok = readHuffmanTables();
+        break;
+      case M_DRI:
+        ok = readRestartInterval();
+        break;
+      default:
+        ok = isRestartMarker(marker) || skipSegment();
+        break;
+    }
+    if (!ok) {
+      LOG_ERR("PJPG", "Failed at marker 0x%02X after %d scans", marker, scans);
+      return false;
+    }
+  }
+}
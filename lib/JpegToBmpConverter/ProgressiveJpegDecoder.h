@@ -0,0 +1,138 @@
+#pragma once
+
+#include <GrayResampler.h>
+#include <HalStorage.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Decoder for the JPEGs picojpeg rejects: progressive (SOF2) files, and baseline files with more than one scan or
+// unusual sampling factors. Used as a fallback by both JPEG converters, with the same row output as
+// JpegScaledDecoder.
+//
+// Progressive files have to keep the coefficients of the whole image until the last scan, so memory is bounded by
+// keeping less of them:
+// - only the luma component is stored (the output is gray); chroma is decoded where it shares a scan with luma,
+//   and skipped otherwise,
+// - only the low frequencies the output size needs are stored (DC at 1/8, 2x2 at 1/4, 4x4 at 1/2), and an inverse
+//   DCT of that reduced size produces the image,
+// - if that does not fit in COEFFICIENT_BUDGET, fewer frequencies are kept, down to DC only.
+// AC refinement scans that reach past the stored frequencies are skipped, so those coefficients stay at the
+// precision of their first scan. That costs a little accuracy, which the 2-bit output does not show.
+class ProgressiveJpegDecoder {
+ public:
+  using RowCallback = GrayResampler::RowCallback;
+
+  static constexpr size_t COEFFICIENT_BUDGET = 96 * 1024;
+
+  // True for the picojpeg init errors this decoder handles
+  static bool handlesPicojpegStatus(uint8_t status);
+
+  // file must be positioned at the start of the JPEG
+  explicit ProgressiveJpegDecoder(FsFile& file);
+  ~ProgressiveJpegDecoder();
+  ProgressiveJpegDecoder(const ProgressiveJpegDecoder&) = delete;
+  ProgressiveJpegDecoder& operator=(const ProgressiveJpegDecoder&) = delete;
+
+  // Reads the markers up to the frame header. Returns false if the file is not a JPEG this decoder supports.
+  bool readHeader();
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  // Decodes every scan, then emits the image area averaged to outWidth x outHeight, gray rows top to bottom.
+  // Call after readHeader().
+  bool decode(int outWidth, int outHeight, const RowCallback& onRow);
+
+ private:
+  struct HuffmanTable {
+    bool defined = false;
+    uint8_t fastLength[256];  // Length of the code starting with this byte, 0 if longer than 8 bits
+    uint8_t fastValue[256];
+    int32_t maxCode[17];  // Largest code of each length, -1 if there is none
+    int32_t valueOffset[17];
+    uint8_t values[256];
+  };
+
+  struct Component {
+    uint8_t id = 0;
+    uint8_t h = 1;
+    uint8_t v = 1;
+    uint8_t quantTable = 0;
+    uint8_t dcTable = 0;
+    uint8_t acTable = 0;
+    int dcPrediction = 0;
+    int blocksWide = 0;  // Blocks covering the component's own size
+    int blocksHigh = 0;
+  };
+
+  struct Scan {
+    int count = 0;
+    int components[4] = {};
+    int spectralStart = 0;
+    int spectralEnd = 63;
+    int approxHigh = 0;
+    int approxLow = 0;
+  };
+
+  static constexpr int MAX_COMPONENTS = 3;
+
+  FsFile& file;
+  uint8_t buffer[512];
+  int bufferPos = 0;
+  int bufferLen = 0;
+  uint32_t bitBuffer = 0;
+  int bitCount = 0;
+  int pendingMarker = -1;  // Marker met inside entropy coded data
+
+  uint16_t quant[4][64] = {};  // Zigzag order
+  HuffmanTable dcTables[4];
+  HuffmanTable acTables[4];
+
+  bool progressive = false;
+  int width = 0;
+  int height = 0;
+  int componentCount = 0;
+  Component components[MAX_COMPONENTS];
+  int maxH = 1;
+  int maxV = 1;
+  int mcusWide = 0;
+  int mcusHigh = 0;
+  int restartInterval = 0;
+
+  // Stored luma coefficients: storedCount per block in zigzag order, blocks padded to whole MCUs
+  int16_t* coefficients = nullptr;
+  int storedCount = 0;
+  int lumaBlocksPerLine = 0;
+  int eobRun = 0;
+
+  int readByte();
+  bool readU16(uint16_t& value);
+  bool skipBytes(int count);
+  int findMarker();
+  int nextMarker();
+
+  bool readQuantTables();
+  bool readHuffmanTables();
+  bool readFrame(uint8_t marker);
+  bool readRestartInterval();
+  bool readScanHeader(Scan& scan);
+  bool skipSegment();
+
+  void fillBits();
+  int getBits(int count);
+  int getBit();
+  int decodeHuffman(const HuffmanTable& table);
+  static int extend(int value, int bits);
+
+  bool shouldDecode(const Scan& scan) const;
+  bool decodeScan(const Scan& scan);
+  void skipScan();
+  void decodeBlock(const Scan& scan, Component& component, int16_t* block, int stored);
+  void decodeDcFirst(Component& component, int16_t* block, int stored, int approxLow);
+  void decodeDcRefine(int16_t* block, int stored, int approxLow);
+  void decodeAcFirst(const Component& component, int16_t* block, int stored, int start, int end, int approxLow);
+  void decodeAcRefine(const Component& component, int16_t* block, int start, int end, int approxLow);
+  bool restart();
+
+  bool emitImage(int reducedSize, int outWidth, int outHeight, const RowCallback& onRow);
+};
@@ -34,6 +34,14 @@ void legacyDeobfuscate(std::string& data) {
 }
 }  // namespace
 
+KOReaderCredentialStore& KOReaderCredentialStore::getInstance() {
+  if (!instance.loaded) {
+    instance.loaded = true;
+    instance.loadFromFile();
+  }
+  return instance;
+}
+
 bool KOReaderCredentialStore::saveToFile() const {
   Storage.mkdir("/.crosspoint");
   return JsonSettingsIO::saveKOReader(*this, KOREADER_FILE_JSON);
@@ -27,6 +27,7 @@ class KOReaderCredentialStore {
   std::string password;
   std::string serverUrl;                                            // Custom sync server URL (empty = default)
   DocumentMatchMethod matchMethod = DocumentMatchMethod::FILENAME;  // Default to filename for compatibility
+  bool loaded = false;
 
   // Private constructor for singleton
   KOReaderCredentialStore() = default;
@@ -41,8 +42,9 @@ class KOReaderCredentialStore {
   KOReaderCredentialStore(const KOReaderCredentialStore&) = delete;
   KOReaderCredentialStore& operator=(const KOReaderCredentialStore&) = delete;
 
-  // Get singleton instance
-  static KOReaderCredentialStore& getInstance() { return instance; }
+  // Get singleton instance. The credentials are only needed once sync is used, so the file is read on first access
+  // rather than at boot.
+  static KOReaderCredentialStore& getInstance();
 
   // Save/load from SD card
   bool saveToFile() const;
@@ -3,6 +3,7 @@
 #include <HalStorage.h>
 #include <Logging.h>
 #include <MD5Builder.h>
+#include <Serialization.h>
 
 namespace {
 // Extract filename from path (everything after last '/')
@@ -94,3 +95,51 @@ std::string KOReaderDocumentId::calculate(const std::string& filePath) {
 
   return result;
 }
+
+std::string KOReaderDocumentId::calculateCached(const std::string& filePath, const std::string& cachePath) {
+  uint32_t fileSize = 0;
+  uint16_t modifyDate = 0, modifyTime = 0;
+  {
+    FsFile file;
+    if (!Storage.openFileForRead("KODoc", filePath, file)) {
+      LOG_DBG("KODoc", "Failed to open file: %s", filePath.c_str());
+      return "";
+    }
+    fileSize = static_cast<uint32_t>(file.fileSize());
+    file.getModifyDateTime(&modifyDate, &modifyTime);
+    file.close();
+  }
+
+  const std::string idCachePath = cachePath + "/koreader_id.bin";
+  FsFile cache;
+  if (Storage.exists(idCachePath.c_str()) && Storage.openFileForRead("KODoc", idCachePath, cache)) {
+    uint8_t version = 0;
+    uint32_t cachedSize = 0;
+    uint16_t cachedDate = 0, cachedTime = 0;
+    std::string hash;
+    serialization::readPod(cache, version);
+    serialization::readPod(cache, cachedSize);
+    serialization::readPod(cache, cachedDate);
+    serialization::readPod(cache, cachedTime);
+    if (version == CACHE_FILE_VERSION && cachedSize == fileSize && cachedDate == modifyDate &&
+        cachedTime == modifyTime) {
+      serialization::readString(cache, hash);
+    }
+    cache.close();
+    if (hash.size() == 32) {
+      LOG_DBG("KODoc", "Cached hash: %s", hash.c_str());
+      return hash;
+    }
+  }
+
+  std::string hash = calculate(filePath);
+  if (!hash.empty() && Storage.openFileForWrite("KODoc", idCachePath, cache)) {
+    serialization::writePod(cache, CACHE_FILE_VERSION);
+    serialization::writePod(cache, fileSize);
+    serialization::writePod(cache, modifyDate);
+    serialization::writePod(cache, modifyTime);
+    serialization::writeString(cache, hash);
+    cache.close();
+  }
+  return hash;
+}
@@ -24,6 +24,17 @@ class KOReaderDocumentId {
    */
   static std::string calculate(const std::string& filePath);
 
+  /**
+   * Same as calculate(), but remembers the hash in the book's cache directory keyed by the file's size and
+   * modification time. Later calls for an unchanged file only open it for its directory entry instead of
+   * seeking to and reading the sampled chunks.
+   *
+   * @param filePath Path to the file
+   * @param cachePath Book cache directory (must exist)
+   * @return 32-character lowercase hex string, or empty string on failure
+   */
+  static std::string calculateCached(const std::string& filePath, const std::string& cachePath);
+
   /**
    * Calculate document hash from filename only (filename-based sync mode).
    * This is simpler and works when files have the same name across devices.
@@ -40,6 +51,8 @@ class KOReaderDocumentId {
   // Number of offsets to try (i = -1 to 10, so 12 offsets)
   static constexpr int OFFSET_COUNT = 12;
 
+  static constexpr uint8_t CACHE_FILE_VERSION = 1;
+
   // Calculate offset for index i: 1024 << (2*i)
   static size_t getOffset(int i);
 };
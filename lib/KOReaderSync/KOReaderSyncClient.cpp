@@ -26,6 +26,31 @@ void addAuthHeaders(HTTPClient& http) {
 }
 
 bool isHttpsUrl(const std::string& url) { return url.rfind("https://", 0) == 0; }
+
+// Build JSON body (timestamp not required per API spec)
+std::string progressBody(const KOReaderProgress& progress) {
+  JsonDocument doc;
+  doc["document"] = progress.document;
+  doc["progress"] = progress.progress;
+  doc["percentage"] = progress.percentage;
+  doc["device"] = DEVICE_NAME;
+  doc["device_id"] = DEVICE_ID;
+
+  std::string body;
+  serializeJson(doc, body);
+  return body;
+}
+
+KOReaderSyncClient::Error updateResult(const int httpCode) {
+  if (httpCode == 200 || httpCode == 202) {
+    return KOReaderSyncClient::OK;
+  } else if (httpCode == 401) {
+    return KOReaderSyncClient::AUTH_FAILED;
+  } else if (httpCode < 0) {
+    return KOReaderSyncClient::NETWORK_ERROR;
+  }
+  return KOReaderSyncClient::SERVER_ERROR;
+}
 }  // namespace
 
 KOReaderSyncClient::Error KOReaderSyncClient::authenticate() {
@@ -151,16 +176,7 @@ KOReaderSyncClient::Error KOReaderSyncClient::updateProgress(const KOReaderProgr
   addAuthHeaders(http);
   http.addHeader("Content-Type", "application/json");
 
-  // Build JSON body (timestamp not required per API spec)
-  JsonDocument doc;
-  doc["document"] = progress.document;
-  doc["progress"] = progress.progress;
-  doc["percentage"] = progress.percentage;
-  doc["device"] = DEVICE_NAME;
-  doc["device_id"] = DEVICE_ID;
-
-  std::string body;
-  serializeJson(doc, body);
+  const std::string body = progressBody(progress);
 
   LOG_DBG("KOSync", "Request body: %s", body.c_str());
 
@@ -169,14 +185,50 @@ KOReaderSyncClient::Error KOReaderSyncClient::updateProgress(const KOReaderProgr
 
   LOG_DBG("KOSync", "Update progress response: %d", httpCode);
 
-  if (httpCode == 200 || httpCode == 202) {
-    return OK;
-  } else if (httpCode == 401) {
-    return AUTH_FAILED;
-  } else if (httpCode < 0) {
-    return NETWORK_ERROR;
+  return updateResult(httpCode);
+}
+
+KOReaderSyncClient::Error KOReaderSyncClient::updateProgressBatch(const std::vector<KOReaderProgress>& batch,
+                                                                  size_t& sent) {
+  sent = 0;
+  if (!KOREADER_STORE.hasCredentials()) {
+    LOG_DBG("KOSync", "No credentials configured");
+    return NO_CREDENTIALS;
   }
-  return SERVER_ERROR;
+
+  std::string url = KOREADER_STORE.getBaseUrl() + "/syncs/progress";
+  LOG_DBG("KOSync", "Updating progress of %zu documents: %s", batch.size(), url.c_str());
+
+  // The same HTTPClient and client objects across requests keep the connection (and its TLS session) open
+  HTTPClient http;
+  http.setReuse(true);
+  std::unique_ptr<WiFiClientSecure> secureClient;
+  WiFiClient plainClient;
+  if (isHttpsUrl(url)) {
+    secureClient.reset(new WiFiClientSecure);
+    secureClient->setInsecure();
+  }
+
+  for (const auto& progress : batch) {
+    if (secureClient) {
+      http.begin(*secureClient, url.c_str());
+    } else {
+      http.begin(plainClient, url.c_str());
+    }
+    addAuthHeaders(http);
+    http.addHeader("Content-Type", "application/json");
+
+    const int httpCode = http.PUT(progressBody(progress).c_str());
+    http.end();
+    LOG_DBG("KOSync", "Update progress response for %s: %d", progress.document.c_str(), httpCode);
+
+    const Error error = updateResult(httpCode);
+    if (error != OK) {
+      return error;
+    }
+    sent++;
+  }
+  return OK;
 }
 
 const char* KOReaderSyncClient::errorString(Error error) {
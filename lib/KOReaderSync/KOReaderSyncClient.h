@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 
 /**
  * Progress data from KOReader sync server.
@@ -52,6 +53,15 @@ class KOReaderSyncClient {
    */
   static Error updateProgress(const KOReaderProgress& progress);
 
+  /**
+   * Upload several documents' progress over one kept-alive connection, in order.
+   * Stops at the first failure.
+   * @param batch The progress updates to upload
+   * @param sent Output: how many of them the server accepted
+   * @return OK if all were accepted, otherwise the error of the first one that failed
+   */
+  static Error updateProgressBatch(const std::vector<KOReaderProgress>& batch, size_t& sent);
+
   /**
    * Get human-readable error message.
    */
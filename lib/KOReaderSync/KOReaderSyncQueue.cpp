@@ -0,0 +1,122 @@
+#include "KOReaderSyncQueue.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+
+KOReaderSyncQueue KOReaderSyncQueue::instance;
+
+namespace {
+constexpr uint8_t QUEUE_FILE_VERSION = 1;
+constexpr char QUEUE_FILE[] = "/.crosspoint/kosync_queue.bin";
+}  // namespace
+
+void KOReaderSyncQueue::load() {
+  if (loaded) {
+    return;
+  }
+  loaded = true;
+  pending.clear();
+
+  FsFile file;
+  if (!Storage.exists(QUEUE_FILE) || !Storage.openFileForRead("KOQ", QUEUE_FILE, file)) {
+    return;
+  }
+
+  uint8_t version = 0;
+  uint8_t count = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, count);
+  if (version != QUEUE_FILE_VERSION) {
+    LOG_DBG("KOQ", "Unknown queue version %u, dropping", version);
+    file.close();
+    return;
+  }
+
+  pending.reserve(std::min<size_t>(count, MAX_PENDING));
+  for (uint8_t i = 0; i < count && i < MAX_PENDING; i++) {
+    KOReaderProgress progress{};
+    serialization::readString(file, progress.document);
+    serialization::readString(file, progress.progress);
+    serialization::readPod(file, progress.percentage);
+    pending.push_back(std::move(progress));
+  }
+  file.close();
+  LOG_DBG("KOQ", "Loaded %zu queued positions", pending.size());
+}
+
+bool KOReaderSyncQueue::save() const {
+  if (pending.empty()) {
+    return !Storage.exists(QUEUE_FILE) || Storage.remove(QUEUE_FILE);
+  }
+
+  FsFile file;
+  Storage.mkdir("/.crosspoint");
+  if (!Storage.openFileForWrite("KOQ", QUEUE_FILE, file)) {
+    return false;
+  }
+  serialization::writePod(file, QUEUE_FILE_VERSION);
+  serialization::writePod(file, static_cast<uint8_t>(pending.size()));
+  for (const auto& progress : pending) {
+    serialization::writeString(file, progress.document);
+    serialization::writeString(file, progress.progress);
+    serialization::writePod(file, progress.percentage);
+  }
+  file.close();
+  return true;
+}
+
+void KOReaderSyncQueue::record(const std::string& documentHash, const std::string& progress, const float percentage) {
+  load();
+
+  const auto existing = std::find_if(pending.begin(), pending.end(), [&documentHash](const KOReaderProgress& entry) {
+    return entry.document == documentHash;
+  });
+  if (existing != pending.end()) {
+    if (existing->progress == progress) {
+      return;
+    }
+    pending.erase(existing);
+  } else if (pending.size() >= MAX_PENDING) {
+    // The oldest position is the least likely to still matter
+    pending.erase(pending.begin());
+  }
+
+  KOReaderProgress entry{};
+  entry.document = documentHash;
+  entry.progress = progress;
+  entry.percentage = percentage;
+  pending.push_back(std::move(entry));
+  save();
+  LOG_DBG("KOQ", "Queued position %.2f%% of %s", percentage * 100, documentHash.c_str());
+}
+
+bool KOReaderSyncQueue::empty() {
+  load();
+  return pending.empty();
+}
+
+KOReaderSyncClient::Error KOReaderSyncQueue::flush() {
+  load();
+  if (pending.empty()) {
+    return KOReaderSyncClient::OK;
+  }
+
+  size_t sent = 0;
+  const auto result = KOReaderSyncClient::updateProgressBatch(pending, sent);
+  // A server error belongs to that one document (e.g. a rejected body); retrying it would block the rest forever
+  if (result == KOReaderSyncClient::SERVER_ERROR && sent < pending.size()) {
+    LOG_ERR("KOQ", "Server rejected position of %s, dropping it", pending[sent].document.c_str());
+    sent++;
+  }
+  LOG_DBG("KOQ", "Flushed %zu of %zu queued positions: %s", sent, pending.size(),
+          KOReaderSyncClient::errorString(result));
+
+  if (sent > 0) {
+    pending.erase(pending.begin(), pending.begin() + sent);
+    save();
+  }
+  return result;
+}
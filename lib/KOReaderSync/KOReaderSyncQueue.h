@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "KOReaderSyncClient.h"
+
+/**
+ * Reading positions waiting to be uploaded to the KOReader sync server, kept on the SD card.
+ *
+ * Closing a book records its position here instead of going online. The queue is flushed in one go whenever WiFi
+ * is up anyway (or brought up briefly before sleeping), so many books share one connection and reading never waits
+ * on the network. Only the latest position of each document is kept.
+ */
+class KOReaderSyncQueue {
+ private:
+  static KOReaderSyncQueue instance;
+  std::vector<KOReaderProgress> pending;
+  bool loaded = false;
+
+  static constexpr size_t MAX_PENDING = 16;
+
+  KOReaderSyncQueue() = default;
+
+  void load();
+  bool save() const;
+
+ public:
+  KOReaderSyncQueue(const KOReaderSyncQueue&) = delete;
+  KOReaderSyncQueue& operator=(const KOReaderSyncQueue&) = delete;
+
+  static KOReaderSyncQueue& getInstance() { return instance; }
+
+  // Queue a document's position, replacing an older one for the same document
+  void record(const std::string& documentHash, const std::string& progress, float percentage);
+
+  bool empty();
+
+  // Upload everything queued; requires WiFi. Accepted entries leave the queue, the rest stay for next time.
+  KOReaderSyncClient::Error flush();
+};
+
+// Helper macro to access the sync queue
+#define KOREADER_SYNC_QUEUE KOReaderSyncQueue::getInstance()
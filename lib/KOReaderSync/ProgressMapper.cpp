@@ -16,8 +16,8 @@ KOReaderPosition ProgressMapper::toKOReader(const std::shared_ptr<Epub>& epub, c
   // Calculate overall book progress (0.0-1.0)
   result.percentage = epub->calculateProgress(pos.spineIndex, intraSpineProgress);
 
-  // Generate XPath with estimated paragraph position based on page
-  result.xpath = generateXPath(pos.spineIndex, pos.pageNumber, pos.totalPages);
+  // Point at the page's first block when its landmark is known
+  result.xpath = generateXPath(pos.spineIndex, pos.landmark);
 
   // Get chapter info for logging
   const int tocIndex = epub->getTocIndexForSpineIndex(pos.spineIndex);
@@ -100,15 +100,35 @@ CrossPointPosition ProgressMapper::toCrossPoint(const std::shared_ptr<Epub>& epu
     }
   }
 
+  // The reader resolves this against the section's landmark table for the exact page
+  result.landmark = extractLandmark(koPos.xpath, result.spineIndex);
+
   LOG_DBG("ProgressMapper", "KOReader -> CrossPoint: %.2f%% at %s -> spine=%d, page=%d", koPos.percentage * 100,
           koPos.xpath.c_str(), result.spineIndex, result.pageNumber);
 
   return result;
 }
 
-std::string ProgressMapper::generateXPath(int spineIndex, int pageNumber, int totalPages) {
+std::string ProgressMapper::generateXPath(int spineIndex, const std::string& landmark) {
   // Use 0-based DocFragment indices for KOReader
-  // Use a simple xpath pointing to the DocFragment - KOReader will use the percentage for fine positioning within it
-  // Avoid specifying paragraph numbers as they may not exist in the target document
-  return "/body/DocFragment[" + std::to_string(spineIndex) + "]/body";
+  // Without a landmark, point at the DocFragment - KOReader will use the percentage for fine positioning within it
+  return "/body/DocFragment[" + std::to_string(spineIndex) + "]/body" + landmark;
+}
+
+std::string ProgressMapper::extractLandmark(const std::string& xpath, int spineIndex) {
+  const std::string prefix = "/body/DocFragment[" + std::to_string(spineIndex) + "]/body";
+  if (xpath.compare(0, prefix.size(), prefix) != 0) {
+    return "";
+  }
+  std::string landmark = xpath.substr(prefix.size());
+  // Drop the text node and character offset ("/text().42", "/text()[2].42", ".42")
+  const size_t textPos = landmark.find("/text()");
+  if (textPos != std::string::npos) {
+    landmark.resize(textPos);
+  }
+  const size_t dotPos = landmark.find('.');
+  if (dotPos != std::string::npos) {
+    landmark.resize(dotPos);
+  }
+  return landmark;
 }
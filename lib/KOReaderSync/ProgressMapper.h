@@ -11,6 +11,9 @@ struct CrossPointPosition {
   int spineIndex;  // Current spine item (chapter) index
   int pageNumber;  // Current page within the spine item
   int totalPages;  // Total pages in the current spine item
+  // DOM path below <body> of the page's first block (see Section::getPageLandmark), empty if unknown.
+  // When set, it pins the page exactly and pageNumber is only an estimate.
+  std::string landmark;
 };
 
 /**
@@ -27,9 +30,9 @@ struct KOReaderPosition {
  * CrossPoint tracks position as (spineIndex, pageNumber).
  * KOReader uses XPath-like strings + percentage.
  *
- * Since CrossPoint discards HTML structure during parsing, we generate
- * synthetic XPath strings based on spine index, using percentage as the
- * primary sync mechanism.
+ * Section builds record the DOM path of each page's first block, so the
+ * XPath can point at the page's block; the spine index and percentage are
+ * used where no such landmark is available.
  */
 class ProgressMapper {
  public:
@@ -60,8 +63,14 @@ class ProgressMapper {
  private:
   /**
    * Generate XPath for KOReader compatibility.
-   * Format: /body/DocFragment[spineIndex+1]/body
-   * Since CrossPoint doesn't preserve HTML structure, we rely on percentage for positioning.
+   * Format: /body/DocFragment[spineIndex]/body followed by the page's landmark, if known.
+   * Without a landmark KOReader relies on the percentage for positioning within the fragment.
    */
-  static std::string generateXPath(int spineIndex, int pageNumber, int totalPages);
+  static std::string generateXPath(int spineIndex, const std::string& landmark);
+
+  /**
+   * Extract the DOM path below <body> from an XPath for the given spine item, dropping any text node suffix.
+   * Returns an empty string if the XPath points into another DocFragment or carries no path.
+   */
+  static std::string extractLandmark(const std::string& xpath, int spineIndex);
 };
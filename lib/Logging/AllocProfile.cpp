@@ -0,0 +1,259 @@
+#include "AllocProfile.h"
+
+#ifdef ENABLE_ALLOC_PROFILE
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstring>
+
+#include "Logging.h"
+
+namespace {
+// Tasks that can have a scope open at the same time (main loop, render task, background workers)
+constexpr size_t MAX_TASKS = 6;
+constexpr size_t HISTORY_SIZE = 16;
+constexpr size_t PHASE_LABEL_SIZE = 32;
+
+struct TaskTag {
+  TaskHandle_t task;
+  const char* tag;
+};
+
+struct FreeBlockSample {
+  const char* label;
+  uint32_t timeMs;
+  uint32_t freeHeap;
+  uint32_t maxAlloc;
+};
+
+portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+// Slot 0 collects everything allocated outside a scope. Slots are never reused, so indices are stable.
+allocprof::TagStats stats[allocprof::MAX_TAGS] = {{"other", 0, 0, 0}};
+size_t tagCount = 1;
+TaskTag taskTags[MAX_TASKS];
+uint32_t liveBytes = 0;
+uint32_t peakLiveBytes = 0;
+
+FreeBlockSample history[HISTORY_SIZE];
+uint32_t historyCount = 0;
+
+allocprof::TagStats phaseStart[allocprof::MAX_TAGS];
+char phaseLabel[PHASE_LABEL_SIZE] = "";
+uint32_t phaseStartMs = 0;
+
+// Callers hold statsLock
+TaskTag* taskSlot(const TaskHandle_t task) {
+  for (auto& slot : taskTags) {
+    if (slot.task == task) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// Callers hold statsLock
+size_t tagIndex(const char* tag) {
+  for (size_t i = 0; i < tagCount; i++) {
+    if (stats[i].tag == tag || strcmp(stats[i].tag, tag) == 0) {
+      return i;
+    }
+  }
+  if (tagCount == allocprof::MAX_TAGS) {
+    return 0;
+  }
+  stats[tagCount] = {tag, 0, 0, 0};
+  return tagCount++;
+}
+
+void recordAlloc(const size_t requested, const size_t usable) {
+  portENTER_CRITICAL(&statsLock);
+  const TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  const TaskTag* slot = task ? taskSlot(task) : nullptr;
+  allocprof::TagStats& tag = stats[slot ? tagIndex(slot->tag) : 0];
+  tag.count++;
+  tag.bytes += requested;
+  if (requested <= allocprof::SMALL_ALLOC_BYTES) {
+    tag.smallCount++;
+  }
+  liveBytes += usable;
+  if (liveBytes > peakLiveBytes) {
+    peakLiveBytes = liveBytes;
+  }
+  portEXIT_CRITICAL(&statsLock);
+}
+
+void recordFree(const size_t usable) {
+  portENTER_CRITICAL(&statsLock);
+  liveBytes = usable > liveBytes ? 0 : liveBytes - usable;
+  portEXIT_CRITICAL(&statsLock);
+}
+
+void copyStats(allocprof::TagStats* out) {
+  portENTER_CRITICAL(&statsLock);
+  memcpy(out, stats, sizeof(stats));
+  portEXIT_CRITICAL(&statsLock);
+}
+
+void sampleFreeBlock(const char* label) {
+  const FreeBlockSample sample = {label, millis(), static_cast<uint32_t>(heap_caps_get_free_size(MALLOC_CAP_8BIT)),
+                                  static_cast<uint32_t>(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT))};
+  portENTER_CRITICAL(&statsLock);
+  history[historyCount++ % HISTORY_SIZE] = sample;
+  portEXIT_CRITICAL(&statsLock);
+}
+
+void report(const char* label, const allocprof::TagStats* start, const uint32_t elapsedMs) {
+  allocprof::TagStats now[allocprof::MAX_TAGS];
+  copyStats(now);
+  uint32_t totalCount = 0;
+  uint32_t totalBytes = 0;
+  for (size_t i = 0; i < allocprof::MAX_TAGS && now[i].tag; i++) {
+    totalCount += now[i].count - start[i].count;
+    totalBytes += now[i].bytes - start[i].bytes;
+  }
+  LOG_INF("ALC", "%s: %lu allocs, %lu bytes in %lu ms, max alloc %lu", label, static_cast<unsigned long>(totalCount),
+          static_cast<unsigned long>(totalBytes), static_cast<unsigned long>(elapsedMs),
+          static_cast<unsigned long>(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)));
+  for (size_t i = 0; i < allocprof::MAX_TAGS && now[i].tag; i++) {
+    const uint32_t count = now[i].count - start[i].count;
+    if (count == 0) {
+      continue;
+    }
+    LOG_INF("ALC", "  %-16s %6lu allocs %8lu bytes %6lu small", now[i].tag, static_cast<unsigned long>(count),
+            static_cast<unsigned long>(now[i].bytes - start[i].bytes),
+            static_cast<unsigned long>(now[i].smallCount - start[i].smallCount));
+  }
+  sampleFreeBlock(label);
+}
+}  // namespace
+
+allocprof::Scope::Scope(const char* tag) : previous(nullptr) {
+  const TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&statsLock);
+  TaskTag* slot = taskSlot(task);
+  if (!slot) {
+    slot = taskSlot(nullptr);
+    if (slot) {
+      slot->task = task;
+    }
+  }
+  if (slot) {
+    previous = slot->tag;
+    slot->tag = tag;
+  }
+  portEXIT_CRITICAL(&statsLock);
+}
+
+allocprof::Scope::~Scope() {
+  portENTER_CRITICAL(&statsLock);
+  TaskTag* slot = taskSlot(xTaskGetCurrentTaskHandle());
+  if (slot) {
+    slot->tag = previous;
+    if (!previous) {
+      slot->task = nullptr;
+    }
+  }
+  portEXIT_CRITICAL(&statsLock);
+}
+
+allocprof::Session::Session(const char* label) : label(label), startUs(micros()) { copyStats(start); }
+
+allocprof::Session::~Session() { report(label, start, (micros() - startUs) / 1000); }
+
+void allocprof::startPhase(const char* label) {
+  if (phaseLabel[0] != '\0') {
+    report(phaseLabel, phaseStart, millis() - phaseStartMs);
+  }
+  strncpy(phaseLabel, label, sizeof(phaseLabel) - 1);
+  phaseLabel[sizeof(phaseLabel) - 1] = '\0';
+  phaseStartMs = millis();
+  copyStats(phaseStart);
+}
+
+void allocprof::dump(Print& out) {
+  TagStats now[MAX_TAGS];
+  copyStats(now);
+  portENTER_CRITICAL(&statsLock);
+  const uint32_t live = liveBytes;
+  const uint32_t peak = peakLiveBytes;
+  const uint32_t samples = historyCount;
+  FreeBlockSample recent[HISTORY_SIZE];
+  memcpy(recent, history, sizeof(history));
+  portEXIT_CRITICAL(&statsLock);
+
+  out.printf("Live %lu bytes, peak %lu, free %lu, max alloc %lu\n", static_cast<unsigned long>(live),
+             static_cast<unsigned long>(peak), static_cast<unsigned long>(heap_caps_get_free_size(MALLOC_CAP_8BIT)),
+             static_cast<unsigned long>(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)));
+  out.printf("%-16s %8s %10s %8s\n", "tag", "allocs", "bytes", "small");
+  for (size_t i = 0; i < MAX_TAGS && now[i].tag; i++) {
+    out.printf("%-16s %8lu %10lu %8lu\n", now[i].tag, static_cast<unsigned long>(now[i].count),
+               static_cast<unsigned long>(now[i].bytes), static_cast<unsigned long>(now[i].smallCount));
+  }
+
+  const uint32_t shown = samples < HISTORY_SIZE ? samples : HISTORY_SIZE;
+  out.printf("Largest free block history (oldest first):\n");
+  for (uint32_t i = samples - shown; i < samples; i++) {
+    const FreeBlockSample& sample = recent[i % HISTORY_SIZE];
+    out.printf("%10lu ms %8lu free %8lu max  %s\n", static_cast<unsigned long>(sample.timeMs),
+               static_cast<unsigned long>(sample.freeHeap), static_cast<unsigned long>(sample.maxAlloc),
+               sample.label);
+  }
+}
+
+// Linker wraps (-Wl,--wrap=...) route every allocation in the image through these
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(const size_t size) {
+  void* ptr = __real_malloc(size);
+  if (ptr) {
+    recordAlloc(size, heap_caps_get_allocated_size(ptr));
+  }
+  return ptr;
+}
+
+void* __wrap_calloc(const size_t count, const size_t size) {
+  void* ptr = __real_calloc(count, size);
+  if (ptr) {
+    recordAlloc(count * size, heap_caps_get_allocated_size(ptr));
+  }
+  return ptr;
+}
+
+void* __wrap_realloc(void* ptr, const size_t size) {
+  const size_t previousSize = ptr ? heap_caps_get_allocated_size(ptr) : 0;
+  void* resized = __real_realloc(ptr, size);
+  if (resized) {
+    recordFree(previousSize);
+    recordAlloc(size, heap_caps_get_allocated_size(resized));
+  } else if (size == 0) {
+    recordFree(previousSize);
+  }
+  return resized;
+}
+
+void __wrap_free(void* ptr) {
+  if (ptr) {
+    recordFree(heap_caps_get_allocated_size(ptr));
+  }
+  __real_free(ptr);
+}
+}
+
+#else
+
+// Without the profiler the macros compile out; these keep direct callers linking
+allocprof::Scope::Scope(const char*) : previous(nullptr) {}
+allocprof::Scope::~Scope() = default;
+allocprof::Session::Session(const char* label) : label(label), start{}, startUs(0) {}
+allocprof::Session::~Session() = default;
+void allocprof::startPhase(const char*) {}
+void allocprof::dump(Print& out) { out.printf("Allocation profiling is only available in the alloc_profile build\n"); }
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Print.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Allocation profiler for the alloc_profile build (pio run -e alloc_profile). That build defines ENABLE_ALLOC_PROFILE
+and links with --wrap for malloc, calloc, realloc and free, so every heap allocation (including operator new and
+std::string growth) passes through a counter before reaching the real allocator.
+
+Allocations are attributed to the innermost ALLOC_SCOPE open on the calling task, or to "other":
+
+    void ParsedText::layoutAndExtractLines(...) {
+      ALLOC_SCOPE("text.layout");
+      ...
+    }
+
+For each tag the profiler counts allocations, bytes requested and small (<= 32 byte) allocations, which are the
+ones that fragment the heap. ALLOC_SESSION logs what the tags allocated while it was open, ALLOC_PHASE logs the
+previous phase and starts a new one (the activity manager starts one per activity). The largest free block is
+sampled whenever a session or phase ends and kept as a short history.
+
+Tags must be string literals (only the pointer is stored). Without ENABLE_ALLOC_PROFILE the macros compile out.
+*/
+
+namespace allocprof {
+
+constexpr size_t MAX_TAGS = 24;
+constexpr size_t SMALL_ALLOC_BYTES = 32;
+
+struct TagStats {
+  const char* tag;
+  uint32_t count;
+  uint32_t bytes;
+  uint32_t smallCount;
+};
+
+// Attributes allocations made by the current task to tag until it goes out of scope. Scopes nest.
+class Scope {
+ public:
+  explicit Scope(const char* tag);
+  ~Scope();
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  const char* previous;
+};
+
+// Logs the allocations made while it was open, per tag, when it closes
+class Session {
+ public:
+  explicit Session(const char* label);
+  ~Session();
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+ private:
+  const char* label;
+  TagStats start[MAX_TAGS];
+  uint32_t startUs;
+};
+
+// Log the allocations since the previous phase began under that phase's label, then start a new one
+void startPhase(const char* label);
+
+// Print the totals per tag, current and peak live bytes and the largest free block history
+void dump(Print& out);
+
+}  // namespace allocprof
+
+#ifdef ENABLE_ALLOC_PROFILE
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+#define ALLOC_SCOPE(tag) allocprof::Scope ALLOC_CONCAT(allocScope_, __LINE__)(tag)
+#define ALLOC_SESSION(label) allocprof::Session ALLOC_CONCAT(allocSession_, __LINE__)(label)
+#define ALLOC_PHASE(label) allocprof::startPhase(label)
+#else
+#define ALLOC_SCOPE(tag)
+#define ALLOC_SESSION(label)
+#define ALLOC_PHASE(label)
+#endif
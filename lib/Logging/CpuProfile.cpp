@@ -0,0 +1,135 @@
+#include "CpuProfile.h"
+
+#ifdef ENABLE_CPU_PROFILE
+
+#include <driver/gptimer.h>
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <riscv/rvruntime-frames.h>
+
+#include "Logging.h"
+
+namespace {
+constexpr uint32_t TIMER_RESOLUTION_HZ = 1000000;
+// Linear probing gives up after this many slots; the sample is counted as dropped
+constexpr uint32_t MAX_PROBES = 8;
+
+struct Bucket {
+  uint32_t pc;
+  uint32_t caller;
+  uint32_t count;
+};
+
+Bucket buckets[CPU_PROFILE_SLOTS];
+volatile uint32_t sampleCount = 0;
+volatile uint32_t droppedCount = 0;
+gptimer_handle_t timer = nullptr;
+
+// On entry to an interrupt the port stores the interrupted task's registers on its stack and saves that stack
+// pointer as the task's pxTopOfStack, the first word of the TCB. Interrupts that nest inside another handler are
+// attributed to the task the outer handler interrupted.
+bool IRAM_ATTR sample(gptimer_handle_t, const gptimer_alarm_event_data_t*, void*) {
+  const auto* frame = *reinterpret_cast<RvExcFrame* const*>(xTaskGetCurrentTaskHandle());
+  if (!frame) {
+    return false;
+  }
+  const uint32_t pc = frame->mepc;
+  const uint32_t caller = frame->ra;
+  sampleCount = sampleCount + 1;
+
+  uint32_t slot = ((pc >> 1) ^ (caller * 2654435761u)) % CPU_PROFILE_SLOTS;
+  for (uint32_t probe = 0; probe < MAX_PROBES; probe++) {
+    Bucket& bucket = buckets[slot];
+    if (bucket.count == 0) {
+      bucket.pc = pc;
+      bucket.caller = caller;
+      bucket.count = 1;
+      return false;
+    }
+    if (bucket.pc == pc && bucket.caller == caller) {
+      bucket.count++;
+      return false;
+    }
+    slot = (slot + 1) % CPU_PROFILE_SLOTS;
+  }
+  droppedCount = droppedCount + 1;
+  return false;
+}
+
+// The histogram is only touched by the interrupt while the timer runs; readers stop it around their access
+void pause() { gptimer_stop(timer); }
+void resume() { gptimer_start(timer); }
+}  // namespace
+
+void cpuprof::begin() {
+  if (timer) {
+    return;
+  }
+  const gptimer_config_t config = {
+      .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+      .direction = GPTIMER_COUNT_UP,
+      .resolution_hz = TIMER_RESOLUTION_HZ,
+  };
+  const gptimer_alarm_config_t alarm = {
+      .alarm_count = TIMER_RESOLUTION_HZ / CPU_PROFILE_HZ,
+      .reload_count = 0,
+      .flags = {.auto_reload_on_alarm = true},
+  };
+  const gptimer_event_callbacks_t callbacks = {.on_alarm = sample};
+  if (gptimer_new_timer(&config, &timer) != ESP_OK) {
+    LOG_ERR("PRF", "No hardware timer left for the profiler");
+    timer = nullptr;
+    return;
+  }
+  if (gptimer_set_alarm_action(timer, &alarm) != ESP_OK ||
+      gptimer_register_event_callbacks(timer, &callbacks, nullptr) != ESP_OK || gptimer_enable(timer) != ESP_OK ||
+      gptimer_start(timer) != ESP_OK) {
+    LOG_ERR("PRF", "Failed to start the profiler timer");
+    gptimer_del_timer(timer);
+    timer = nullptr;
+    return;
+  }
+  LOG_INF("PRF", "Sampling at %d Hz into %d slots", CPU_PROFILE_HZ, CPU_PROFILE_SLOTS);
+}
+
+void cpuprof::dump(Print& out) {
+  if (!timer) {
+    out.printf("Profiler not running\n");
+    return;
+  }
+  // Printing the whole table takes a while; stopping the timer keeps the counts consistent and keeps the dump
+  // itself out of the profile
+  pause();
+  out.printf("PROFILE_START samples=%lu dropped=%lu hz=%d\n", static_cast<unsigned long>(sampleCount),
+             static_cast<unsigned long>(droppedCount), CPU_PROFILE_HZ);
+  for (const Bucket& bucket : buckets) {
+    if (bucket.count > 0) {
+      out.printf("%08lx %08lx %lu\n", static_cast<unsigned long>(bucket.pc), static_cast<unsigned long>(bucket.caller),
+                 static_cast<unsigned long>(bucket.count));
+    }
+  }
+  out.printf("PROFILE_END\n");
+  resume();
+}
+
+void cpuprof::clear() {
+  if (!timer) {
+    return;
+  }
+  pause();
+  for (Bucket& bucket : buckets) {
+    bucket = {};
+  }
+  sampleCount = 0;
+  droppedCount = 0;
+  resume();
+}
+
+#else
+
+void cpuprof::begin() {}
+void cpuprof::dump(Print& out) { out.printf("CPU profiling is only available in the cpu_profile build\n"); }
+void cpuprof::clear() {}
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Print.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Sampling CPU profiler for the cpu_profile build (pio run -e cpu_profile), which defines ENABLE_CPU_PROFILE. A
+hardware timer interrupts the CPU CPU_PROFILE_HZ times a second and counts the interrupted program counter, together
+with the return address register at that moment, in a fixed RAM histogram. Unlike trace spans this covers code
+nobody instrumented: the glyph blitters, uzlib and expat show up by where the cycles actually go.
+
+The return address is the caller only while the sampled function hasn't called anything yet (leaf functions and
+function prologues); deeper in a function it is whatever was called last. Profiles are therefore flat with a
+best-effort caller, good for "which functions" rather than full call trees. Samples taken while the CPU idles land
+in the idle task.
+
+CMD:PROFILE prints the histogram as raw addresses between PROFILE_START and PROFILE_END lines, CMD:PROFILE_CLEAR
+starts over. scripts/debugging_monitor.py --elf firmware.elf symbolizes a captured dump into a flat profile and a
+folded-stack file for flame graph tools.
+
+Without ENABLE_CPU_PROFILE, begin() does nothing and dump() says so.
+*/
+
+#ifndef CPU_PROFILE_HZ
+// Off the 1 kHz FreeRTOS tick, so sampling doesn't lock step with tick-driven work
+#define CPU_PROFILE_HZ 997
+#endif
+
+#ifndef CPU_PROFILE_SLOTS
+#define CPU_PROFILE_SLOTS 1024
+#endif
+
+namespace cpuprof {
+
+// Start sampling; call once from setup()
+void begin();
+
+// Print the histogram (one "pc caller count" line per distinct sample, in hex except the count)
+void dump(Print& out);
+
+// Forget all samples, e.g. before reproducing a slow operation
+void clear();
+
+}  // namespace cpuprof
@@ -0,0 +1,204 @@
+#include "FrameCapture.h"
+
+#include <PackBits.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include "Logging.h"
+#include "Trace.h"
+
+// Frames are stored whole in a byte ring so each can be handed to the consumer as one contiguous message. A frame
+// that doesn't fit behind the newest one starts over at the front of the ring if the oldest unsent frame leaves
+// room there. Producers compress under the mutex; consumers only take it to look at and retire the oldest frame,
+// which is never overwritten while it is being sent.
+namespace {
+constexpr size_t MAX_QUEUED_FRAMES = 16;
+constexpr uint32_t SERIAL_TASK_STACK_SIZE = 3072;
+
+struct Record {
+  uint32_t offset;
+  uint32_t size;
+};
+
+std::atomic<framecap::Sink> sinkInUse{framecap::SINK_NONE};
+// Everything below is guarded by the mutex
+uint8_t* ring = nullptr;
+Record records[MAX_QUEUED_FRAMES];
+size_t firstRecord = 0;
+size_t recordCount = 0;
+uint32_t writeOffset = 0;  // End of the newest frame
+bool peeked = false;       // The oldest frame is being sent
+uint32_t sequence = 0;
+uint32_t droppedFrames = 0;
+TaskHandle_t serialTask = nullptr;
+
+SemaphoreHandle_t mutex() {
+  static SemaphoreHandle_t handle = xSemaphoreCreateMutex();
+  return handle;
+}
+
+class Guard {
+ public:
+  Guard() { xSemaphoreTake(mutex(), portMAX_DELAY); }
+  ~Guard() { xSemaphoreGive(mutex()); }
+  Guard(const Guard&) = delete;
+  Guard& operator=(const Guard&) = delete;
+};
+
+// Offset of a contiguous free range of size bytes, or -1 if the unsent frames leave none
+int32_t reserve(const size_t size) {
+  if (size > FRAME_CAPTURE_BUFFER_SIZE || recordCount == MAX_QUEUED_FRAMES) {
+    return -1;
+  }
+  if (recordCount == 0) {
+    return 0;
+  }
+  const uint32_t readOffset = records[firstRecord].offset;
+  if (writeOffset > readOffset) {
+    if (FRAME_CAPTURE_BUFFER_SIZE - writeOffset >= size) {
+      return static_cast<int32_t>(writeOffset);
+    }
+    return size <= readOffset ? 0 : -1;
+  }
+  return readOffset - writeOffset >= size ? static_cast<int32_t>(writeOffset) : -1;
+}
+
+// Caller holds the mutex
+void freeRingIfIdle() {
+  if (sinkInUse == framecap::SINK_NONE && !peeked) {
+    free(ring);
+    ring = nullptr;
+    recordCount = 0;
+  }
+}
+
+void serialLoop(void*) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    while (framecap::peek(framecap::SINK_SERIAL, data, size)) {
+      {
+        LogSerialLock lock;
+        logSerial.printf("FRAME:%u\n", static_cast<unsigned>(size));
+        logSerial.write(data, size);
+      }
+      framecap::release();
+    }
+  }
+}
+}  // namespace
+
+bool framecap::start(const Sink sink) {
+  if (sink == SINK_NONE) {
+    stop();
+    return true;
+  }
+  Guard guard;
+  if (!ring) {
+    ring = static_cast<uint8_t*>(malloc(FRAME_CAPTURE_BUFFER_SIZE));
+    if (!ring) {
+      LOG_ERR("CAP", "Not enough memory for the %d byte capture ring", FRAME_CAPTURE_BUFFER_SIZE);
+      return false;
+    }
+    firstRecord = 0;
+    recordCount = 0;
+    writeOffset = 0;
+    sequence = 0;
+    droppedFrames = 0;
+  }
+  if (sink == SINK_SERIAL && !serialTask &&
+      xTaskCreate(serialLoop, "FrameCapture", SERIAL_TASK_STACK_SIZE, nullptr, 1, &serialTask) != pdPASS) {
+    LOG_ERR("CAP", "Failed to start the serial capture task");
+    serialTask = nullptr;
+    freeRingIfIdle();
+    return false;
+  }
+  sinkInUse = sink;
+  LOG_INF("CAP", "Capturing frames to %s", sink == SINK_SERIAL ? "serial" : "WebSocket");
+  return true;
+}
+
+void framecap::stop() {
+  Guard guard;
+  if (sinkInUse == SINK_NONE) {
+    return;
+  }
+  sinkInUse = SINK_NONE;
+  // A frame being sent stays until it is released
+  recordCount = peeked ? 1 : 0;
+  freeRingIfIdle();
+  LOG_INF("CAP", "Frame capture stopped, %lu frames dropped", static_cast<unsigned long>(droppedFrames));
+}
+
+framecap::Sink framecap::activeSink() { return sinkInUse.load(std::memory_order_relaxed); }
+
+void framecap::capture(const Plane plane, const uint8_t* data, const size_t size, const uint16_t width,
+                       const uint16_t height) {
+  if (sinkInUse.load(std::memory_order_relaxed) == SINK_NONE) {
+    return;
+  }
+  const uint32_t timestamp = trace::now();
+  const size_t payloadSize = packbits::encode(data, size, nullptr);
+  Sink sink;
+  {
+    Guard guard;
+    sink = sinkInUse;
+    if (sink == SINK_NONE || !ring) {
+      return;
+    }
+    const uint32_t frameSequence = sequence++;
+    const int32_t offset = reserve(sizeof(FrameHeader) + payloadSize);
+    if (offset < 0) {
+      droppedFrames++;
+      return;
+    }
+    FrameHeader header = {};
+    memcpy(header.magic, "CPFR", sizeof(header.magic));
+    header.sequence = frameSequence;
+    header.timestampUs = timestamp;
+    header.dropped = droppedFrames;
+    header.payloadSize = payloadSize;
+    header.width = width;
+    header.height = height;
+    header.plane = plane;
+    memcpy(ring + offset, &header, sizeof(header));
+    packbits::encode(data, size, ring + offset + sizeof(header));
+
+    const uint32_t frameSize = sizeof(header) + payloadSize;
+    records[(firstRecord + recordCount) % MAX_QUEUED_FRAMES] = {static_cast<uint32_t>(offset), frameSize};
+    recordCount++;
+    writeOffset = offset + frameSize;
+  }
+  if (sink == SINK_SERIAL) {
+    xTaskNotifyGive(serialTask);
+  }
+}
+
+bool framecap::peek(const Sink sink, const uint8_t*& data, size_t& size) {
+  Guard guard;
+  if (sinkInUse != sink || recordCount == 0) {
+    return false;
+  }
+  const Record& record = records[firstRecord];
+  data = ring + record.offset;
+  size = record.size;
+  peeked = true;
+  return true;
+}
+
+void framecap::release() {
+  Guard guard;
+  if (!peeked) {
+    return;
+  }
+  peeked = false;
+  firstRecord = (firstRecord + 1) % MAX_QUEUED_FRAMES;
+  recordCount--;
+  freeRingIfIdle();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Frame capture for visual latency measurements and regression screenshots. While a capture runs, every plane sent to
+the panel (the BW frame at each refresh, the two anti-aliasing planes as they are loaded) is PackBits-compressed
+with a timestamp into a RAM ring and streamed out by a consumer, so the drawing task pays for the compression only:
+
+  - Serial: CMD:CAPTURE starts, CMD:CAPTURE_STOP stops. A background task writes each frame as a "FRAME:<bytes>"
+    line followed by that many bytes. scripts/debugging_monitor.py saves them under frames/.
+  - WebSocket: a client of the web server's WebSocket port sends "CAPTURE" (answered with "CAPTURING") and gets one
+    binary message per frame until it sends "CAPTURE_STOP" or disconnects.
+
+Each frame is a FrameHeader followed by the compressed plane. A text page compresses to a few KB; frames that don't
+fit in the ring while the consumer catches up are dropped, which shows as a gap in the sequence numbers and in the
+dropped count of the next header. The ring is only allocated while a capture runs; without one, the panel calls
+pay a single atomic load.
+*/
+
+#ifndef FRAME_CAPTURE_BUFFER_SIZE
+#define FRAME_CAPTURE_BUFFER_SIZE 32768
+#endif
+
+namespace framecap {
+
+enum Plane : uint8_t {
+  PLANE_BW,        // The frame buffer at a BW refresh (full or window)
+  PLANE_GRAY_LSB,  // Anti-aliasing planes, as loaded into the controller before a gray refresh
+  PLANE_GRAY_MSB,
+};
+
+enum Sink : uint8_t { SINK_NONE, SINK_SERIAL, SINK_WEBSOCKET };
+
+// Little endian, as the device lays it out
+struct __attribute__((packed)) FrameHeader {
+  char magic[4];         // "CPFR"
+  uint32_t sequence;     // Counts every captured plane, dropped ones included
+  uint32_t timestampUs;  // trace::now() when the plane reached the panel
+  uint32_t dropped;      // Planes dropped since the capture started
+  uint32_t payloadSize;  // Compressed bytes following the header
+  uint16_t width;        // Panel pixels, one bit each, rows of width / 8 bytes
+  uint16_t height;
+  uint8_t plane;
+  uint8_t reserved[3];
+};
+
+// Start capturing into sink, replacing the sink of a capture already running. False if the ring can't be allocated.
+bool start(Sink sink);
+void stop();
+Sink activeSink();
+
+// Called by HalDisplay with each plane it sends to the panel
+void capture(Plane plane, const uint8_t* data, size_t size, uint16_t width, uint16_t height);
+
+// The oldest frame not yet sent, for the consumer of sink; false if there is none. The frame stays valid until
+// release(), which the consumer calls once it has been sent.
+bool peek(Sink sink, const uint8_t*& data, size_t& size);
+void release();
+
+}  // namespace framecap
@@ -1,29 +1,59 @@
 #include "Logging.h"
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+// Log lines are formatted by the caller into a ring of fixed-size slots and written to the serial port by a
+// low-priority drain task, so a LOG_* call costs a snprintf and never waits on the USB host. Producers claim slots
+// with a compare-and-swap on the head, the drain task is the only consumer. Lines that find the ring full are
+// dropped and counted; the count is reported in the log once there is room again.
+namespace {
+constexpr size_t SLOT_COUNT = 16;
+constexpr size_t LINE_LENGTH = 256;
+constexpr uint32_t DRAIN_TASK_STACK_SIZE = 3072;
+
+struct Slot {
+  std::atomic<bool> ready{false};
+  uint16_t length = 0;
+  char text[LINE_LENGTH];
+};
+
+Slot slots[SLOT_COUNT];
+std::atomic<uint32_t> head{0};  // next slot to claim
+std::atomic<uint32_t> tail{0};  // next slot to write out
+std::atomic<uint32_t> droppedLines{0};
+uint32_t reportedDrops = 0;  // guarded by serialMutex
+
+std::atomic<bool> drainStarted{false};
+std::atomic<TaskHandle_t> drainTask{nullptr};
+// Held while the serial port is written, by the drain task, logFlush() and LogSerialLock
+SemaphoreHandle_t serialMutex = nullptr;
+
 // Since logging can take a large amount of flash, we want to make the format string as short as possible.
-// This logPrintf prepend the timestamp, level and origin to the user-provided message, so that the user only needs to
+// This prepends the timestamp, level and origin to the user-provided message, so that the user only needs to
 // provide the format string for the message itself.
-void logPrintf(const char* level, const char* origin, const char* format, ...) {
-  if (!logSerial) {
-    return;  // Serial not initialized, skip logging
-  }
-  va_list args;
-  va_start(args, format);
-  char buf[256];
+size_t formatLine(char* buf, const size_t size, const char* level, const char* origin, const char* format,
+                  va_list args) {
   char* c = buf;
   // add the timestamp
   {
     unsigned long ms = millis();
-    int len = snprintf(c, sizeof(buf), "[%lu] ", ms);
+    int len = snprintf(c, size, "[%lu] ", ms);
     if (len < 0) {
-      return;  // encoding error, skip logging
+      return 0;  // encoding error, skip logging
     }
     c += len;
   }
   // add the level
   {
     const char* p = level;
-    size_t remaining = sizeof(buf) - (c - buf);
+    size_t remaining = size - (c - buf);
     while (*p && remaining > 1) {
       *c++ = *p++;
       remaining--;
@@ -34,14 +64,121 @@ void logPrintf(const char* level, const char* origin, const char* format, ...) {
   }
   // add the origin
   {
-    int len = snprintf(c, sizeof(buf) - (c - buf), "[%s] ", origin);
+    int len = snprintf(c, size - (c - buf), "[%s] ", origin);
     if (len < 0) {
-      return;  // encoding error, skip logging
+      return 0;  // encoding error, skip logging
     }
-    c += len;
+    c += std::min<size_t>(len, size - 1 - (c - buf));
   }
   // add the user message
-  vsnprintf(c, sizeof(buf) - (c - buf), format, args);
+  const int len = vsnprintf(c, size - (c - buf), format, args);
+  if (len < 0) {
+    return 0;
+  }
+  return std::min<size_t>(c - buf + len, size - 1);
+}
+
+// Writes out the published lines in order, stopping at a slot whose producer is still formatting it. Caller holds
+// serialMutex.
+void drainSlots() {
+  uint32_t index = tail.load(std::memory_order_relaxed);
+  for (Slot* slot = &slots[index % SLOT_COUNT]; slot->ready.load(std::memory_order_acquire);
+       slot = &slots[index % SLOT_COUNT]) {
+    logSerial.write(reinterpret_cast<const uint8_t*>(slot->text), slot->length);
+    slot->ready.store(false, std::memory_order_relaxed);
+    tail.store(++index, std::memory_order_release);
+  }
+  const uint32_t drops = droppedLines.load(std::memory_order_relaxed);
+  if (drops != reportedDrops) {
+    logSerial.printf("[%lu] [ERR] [LOG] %lu lines dropped\n", millis(),
+                     static_cast<unsigned long>(drops - reportedDrops));
+    reportedDrops = drops;
+  }
+}
+
+void drainLoop(void*) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    xSemaphoreTake(serialMutex, portMAX_DELAY);
+    drainSlots();
+    xSemaphoreGive(serialMutex);
+  }
+}
+
+// The first line logged starts the drain task. Returns false if it couldn't be started, then lines go out directly.
+bool startDrain() {
+  if (drainTask) {
+    return true;
+  }
+  if (drainStarted.exchange(true)) {
+    return false;  // another task is starting it, this line goes out directly (HWCDC writes are thread-safe)
+  }
+  serialMutex = xSemaphoreCreateMutex();
+  TaskHandle_t task = nullptr;
+  if (!serialMutex || xTaskCreate(drainLoop, "LogDrain", DRAIN_TASK_STACK_SIZE, nullptr, 1, &task) != pdPASS) {
+    if (serialMutex) {
+      vSemaphoreDelete(serialMutex);
+      serialMutex = nullptr;
+    }
+    drainStarted = false;
+    return false;
+  }
+  drainTask = task;
+  return true;
+}
+}  // namespace
+
+void logPrintf(const char* level, const char* origin, const char* format, ...) {
+  if (!logSerial) {
+    return;  // Serial not initialized, skip logging
+  }
+  va_list args;
+  va_start(args, format);
+
+  if (!startDrain()) {
+    char buf[LINE_LENGTH];
+    const size_t length = formatLine(buf, sizeof(buf), level, origin, format, args);
+    va_end(args);
+    logSerial.write(reinterpret_cast<const uint8_t*>(buf), length);
+    return;
+  }
+
+  uint32_t index = head.load(std::memory_order_relaxed);
+  do {
+    if (index - tail.load(std::memory_order_acquire) >= SLOT_COUNT) {
+      va_end(args);
+      droppedLines.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  } while (!head.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+  Slot& slot = slots[index % SLOT_COUNT];
+  slot.length = static_cast<uint16_t>(formatLine(slot.text, sizeof(slot.text), level, origin, format, args));
   va_end(args);
-  logSerial.print(buf);
+  slot.ready.store(true, std::memory_order_release);
+  xTaskNotifyGive(drainTask);
+}
+
+void logFlush() {
+  if (!drainTask) {
+    return;
+  }
+  xSemaphoreTake(serialMutex, portMAX_DELAY);
+  drainSlots();
+  logSerial.flush();
+  xSemaphoreGive(serialMutex);
+}
+
+LogSerialLock::LogSerialLock() : held(drainTask.load() != nullptr) {
+  if (held) {
+    xSemaphoreTake(serialMutex, portMAX_DELAY);
+    // Lines logged before the raw output still come first
+    drainSlots();
+  }
+}
+
+LogSerialLock::~LogSerialLock() {
+  if (held) {
+    xSemaphoreGive(serialMutex);
+  }
 }
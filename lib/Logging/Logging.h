@@ -13,7 +13,8 @@ Define LOG_LEVEL to control log verbosity:
 If not defined, defaults to 0
 
 If you have a legitimate need for raw Serial access (e.g., binary data,
-special formatting), use the underlying logSerial object directly:
+special formatting), use the underlying logSerial object directly, holding a LogSerialLock:
+    LogSerialLock lock;
     logSerial.printf("Special case: %d\n", value);
     logSerial.write(binaryData, length);
 
@@ -27,7 +28,24 @@ won't trigger deprecation warnings.
 
 static HWCDC& logSerial = Serial;
 
+// Lines are queued and written out by a background task (see Logging.cpp); when the queue is full they are dropped
+// and counted
 void logPrintf(const char* level, const char* origin, const char* format, ...);
+// Write out the queued lines now; call before the chip restarts or goes to sleep
+void logFlush();
+
+// Keeps queued log lines off the serial port while raw output goes through logSerial, so it isn't interleaved.
+// Lines queued before it are written out first.
+class LogSerialLock {
+ public:
+  LogSerialLock();
+  ~LogSerialLock();
+  LogSerialLock(const LogSerialLock&) = delete;
+  LogSerialLock& operator=(const LogSerialLock&) = delete;
+
+ private:
+  bool held;
+};
 
 #ifdef ENABLE_SERIAL_LOG
 #if LOG_LEVEL >= 0
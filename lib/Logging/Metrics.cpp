@@ -0,0 +1,37 @@
+#include "Metrics.h"
+
+namespace metrics {
+
+std::atomic<uint32_t> counters[COUNTER_COUNT] = {};
+HistogramData histograms[HISTOGRAM_COUNT] = {};
+
+void observe(const Histogram histogram, const uint32_t ms) {
+  HistogramData& data = histograms[histogram];
+  size_t bucket = 0;
+  while (bucket < BUCKET_COUNT - 1 && ms > BUCKET_BOUNDS_MS[bucket]) {
+    bucket++;
+  }
+  data.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  data.count.fetch_add(1, std::memory_order_relaxed);
+  data.sumMs.fetch_add(ms, std::memory_order_relaxed);
+  uint32_t max = data.maxMs.load(std::memory_order_relaxed);
+  while (ms > max && !data.maxMs.compare_exchange_weak(max, ms, std::memory_order_relaxed)) {
+  }
+}
+
+const char* name(const Counter counter) {
+  static constexpr const char* NAMES[COUNTER_COUNT] = {
+      "font_group_hits",   "font_group_misses", "section_cache_hits", "section_builds",    "section_relayouts",
+      "zip_lookups",       "inflated_bytes",    "sd_read_ops",        "sd_read_bytes",     "sd_write_ops",
+      "sd_write_bytes",    "path_cache_hits",   "path_cache_misses",  "open_cache_hits",   "open_cache_misses",
+      "uploads",           "upload_bytes",      "upload_ms",          "pool_leases",       "pool_fallbacks",
+  };
+  return counter < COUNTER_COUNT ? NAMES[counter] : "unknown";
+}
+
+const char* name(const Histogram histogram) {
+  static constexpr const char* NAMES[HISTOGRAM_COUNT] = {"page_turn_ms", "refresh_ms", "gray_refresh_ms"};
+  return histogram < HISTOGRAM_COUNT ? NAMES[histogram] : "unknown";
+}
+
+}  // namespace metrics
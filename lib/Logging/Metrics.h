@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Always-on runtime counters and latency histograms, read out by the web server's /api/metrics so devices on the bench
+can be compared without a serial cable:
+
+    metrics::add(metrics::ZIP_LOOKUPS);
+    metrics::add(metrics::SD_READ_BYTES, n);
+    metrics::observe(metrics::REFRESH_MS, millis() - start);
+
+Counting is one relaxed atomic add, cheap enough for per-glyph and per-card-call paths. Counters are 32 bits and
+wrap (byte counters after 4 GiB); they only ever grow between reboots, so scrapers should look at differences.
+*/
+
+namespace metrics {
+
+enum Counter : uint8_t {
+  FONT_GROUP_HITS,    // Glyph lookups served by a decompressed group or the glyph cache
+  FONT_GROUP_MISSES,  // Glyph lookups that inflated a group
+  SECTION_CACHE_HITS,
+  SECTION_BUILDS,
+  SECTION_RELAYOUTS,  // Sections cut from the lines of another viewport height, see SectionFlow
+  ZIP_LOOKUPS,  // Entry lookups in an EPUB's ZIP directory
+  INFLATED_BYTES,
+  SD_READ_OPS,  // Card calls, after HalFile's buffering
+  SD_READ_BYTES,
+  SD_WRITE_OPS,
+  SD_WRITE_BYTES,
+  PATH_CACHE_HITS,  // Storage.exists() answered without the card
+  PATH_CACHE_MISSES,
+  OPEN_CACHE_HITS,  // Read-only opens that reused a parked handle
+  OPEN_CACHE_MISSES,
+  UPLOADS,  // Completed web and WebSocket uploads
+  UPLOAD_BYTES,
+  UPLOAD_MS,
+  POOL_LEASES,  // Large buffers served by a slab reserved at boot, see BufferPool
+  POOL_FALLBACKS,
+  COUNTER_COUNT
+};
+
+enum Histogram : uint8_t {
+  PAGE_TURN_MS,     // Button press to the end of the reader's render
+  REFRESH_MS,       // BW panel refreshes
+  GRAY_REFRESH_MS,  // Anti-aliasing refreshes
+  HISTOGRAM_COUNT
+};
+
+// Upper bounds (ms) of the histogram buckets; a last bucket takes everything slower
+constexpr uint32_t BUCKET_BOUNDS_MS[] = {50, 100, 200, 300, 500, 750, 1000, 1500, 2500};
+constexpr size_t BUCKET_COUNT = sizeof(BUCKET_BOUNDS_MS) / sizeof(BUCKET_BOUNDS_MS[0]) + 1;
+
+struct HistogramData {
+  std::atomic<uint32_t> buckets[BUCKET_COUNT];
+  std::atomic<uint32_t> count;
+  std::atomic<uint32_t> sumMs;
+  std::atomic<uint32_t> maxMs;
+};
+
+extern std::atomic<uint32_t> counters[COUNTER_COUNT];
+extern HistogramData histograms[HISTOGRAM_COUNT];
+
+inline void add(const Counter counter, const uint32_t amount = 1) {
+  counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+inline uint32_t get(const Counter counter) { return counters[counter].load(std::memory_order_relaxed); }
+
+void observe(Histogram histogram, uint32_t ms);
+
+// JSON field names, e.g. "font_group_hits"
+const char* name(Counter counter);
+const char* name(Histogram histogram);
+
+}  // namespace metrics
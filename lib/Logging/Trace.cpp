@@ -0,0 +1,119 @@
+#include "Trace.h"
+
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+trace::Event events[TRACE_CAPACITY];
+std::atomic<uint32_t> recorded{0};
+
+uint32_t nowUs() { return static_cast<uint32_t>(esp_timer_get_time()); }
+
+constexpr size_t MAX_INTERNED = 16;
+constexpr size_t INTERNED_LENGTH = 24;
+char interned[MAX_INTERNED][INTERNED_LENGTH];
+size_t internedCount = 0;
+
+void recordEvent(const char* name, const uint32_t startUs, const uint32_t durationUs) {
+  const uint32_t slot = recorded.fetch_add(1) % TRACE_CAPACITY;
+  events[slot] = {name, startUs, durationUs, static_cast<uint32_t>(heap_caps_get_free_size(MALLOC_CAP_8BIT)),
+                  static_cast<uint32_t>(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT))};
+}
+
+constexpr size_t MAX_SUMMARY_NAMES = 32;
+
+struct Summary {
+  const char* name;
+  uint32_t count;
+  uint64_t totalUs;
+  uint32_t maxUs;
+};
+}  // namespace
+
+trace::Span::Span(const char* name) : name(name), startUs(nowUs()) {}
+
+trace::Span::~Span() { recordEvent(name, startUs, nowUs() - startUs); }
+
+uint32_t trace::now() { return nowUs(); }
+
+void trace::record(const char* name, const uint32_t startUs) {
+#ifndef DISABLE_TRACE
+  recordEvent(name, startUs, nowUs() - startUs);
+#endif
+}
+
+const char* trace::intern(const char* name) {
+  for (size_t i = 0; i < internedCount; i++) {
+    if (strncmp(interned[i], name, INTERNED_LENGTH - 1) == 0) {
+      return interned[i];
+    }
+  }
+  if (internedCount == MAX_INTERNED) {
+    return nullptr;
+  }
+  char* copy = interned[internedCount++];
+  strncpy(copy, name, INTERNED_LENGTH - 1);
+  copy[INTERNED_LENGTH - 1] = '\0';
+  return copy;
+}
+
+size_t trace::snapshot(Event* out, const size_t maxEvents) {
+  const uint32_t total = recorded.load();
+  size_t count = total < TRACE_CAPACITY ? total : TRACE_CAPACITY;
+  if (count > maxEvents) {
+    count = maxEvents;
+  }
+  // Spans recorded while copying may overwrite the oldest entries; a dump is a best-effort view
+  const uint32_t first = total - count;
+  for (size_t i = 0; i < count; i++) {
+    out[i] = events[(first + i) % TRACE_CAPACITY];
+  }
+  return count;
+}
+
+void trace::dump(Print& out) {
+  const uint32_t total = recorded.load();
+  const uint32_t count = total < TRACE_CAPACITY ? total : TRACE_CAPACITY;
+  out.printf("%lu spans recorded, showing the last %lu\n", static_cast<unsigned long>(total),
+             static_cast<unsigned long>(count));
+  out.printf("%10s %10s %8s %8s  %s\n", "start_ms", "dur_us", "free", "maxalloc", "name");
+
+  Summary summaries[MAX_SUMMARY_NAMES] = {};
+  size_t summaryCount = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const Event event = events[(total - count + i) % TRACE_CAPACITY];
+    out.printf("%10lu %10lu %8lu %8lu  %s\n", static_cast<unsigned long>(event.startUs / 1000),
+               static_cast<unsigned long>(event.durationUs), static_cast<unsigned long>(event.freeHeap),
+               static_cast<unsigned long>(event.maxAlloc), event.name);
+
+    size_t s = 0;
+    while (s < summaryCount && strcmp(summaries[s].name, event.name) != 0) {
+      s++;
+    }
+    if (s == summaryCount) {
+      if (summaryCount == MAX_SUMMARY_NAMES) {
+        continue;
+      }
+      summaries[summaryCount++] = {event.name, 0, 0, 0};
+    }
+    summaries[s].count++;
+    summaries[s].totalUs += event.durationUs;
+    if (event.durationUs > summaries[s].maxUs) {
+      summaries[s].maxUs = event.durationUs;
+    }
+  }
+
+  out.printf("%-20s %6s %10s %10s %10s\n", "name", "count", "total_us", "avg_us", "max_us");
+  for (size_t s = 0; s < summaryCount; s++) {
+    const Summary& summary = summaries[s];
+    out.printf("%-20s %6lu %10llu %10llu %10lu\n", summary.name, static_cast<unsigned long>(summary.count),
+               static_cast<unsigned long long>(summary.totalUs),
+               static_cast<unsigned long long>(summary.totalUs / summary.count),
+               static_cast<unsigned long>(summary.maxUs));
+  }
+}
+
+void trace::clear() { recorded = 0; }
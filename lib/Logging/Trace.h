@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Print.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Lightweight performance tracing. A scoped span records its name, start time, duration, and the free heap and
+largest allocatable block when it ends, into a fixed ring of the most recent TRACE_CAPACITY spans:
+
+    void Section::createSectionFile(...) {
+      TRACE("sect.build");
+      ...
+    }
+
+Names must be string literals (only the pointer is stored). Spans nest; each is recorded when it closes, so an
+enclosing span follows the spans inside it. Recording costs two timer reads and two heap queries, so spans belong
+around whole phases (a chapter build, a page render, a panel refresh), not per-glyph work.
+
+Spans that don't fit a scope, such as the time from a button press to the end of the refresh it caused, are
+recorded with trace::record from a start time taken with trace::now(). Labels built at run time (per-activity names)
+go through trace::intern first, which keeps a copy that outlives the caller.
+
+Define DISABLE_TRACE to compile the spans out entirely.
+*/
+
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY 128
+#endif
+
+namespace trace {
+
+struct Event {
+  const char* name;
+  uint32_t startUs;  // esp_timer time when the span opened (wraps after ~71 minutes)
+  uint32_t durationUs;
+  uint32_t freeHeap;  // At close
+  uint32_t maxAlloc;  // Largest free block at close
+};
+
+class Span {
+ public:
+  explicit Span(const char* name);
+  ~Span();
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+ private:
+  const char* name;
+  uint32_t startUs;
+};
+
+// Current trace clock, in the same timebase as Event::startUs
+uint32_t now();
+
+// Record a span named name that opened at startUs (from now()) and closes now
+void record(const char* name, uint32_t startUs);
+
+// A copy of name that stays valid for the rest of the run, for labels that aren't literals. Copies are kept in a
+// small fixed table; returns nullptr once it is full. Not thread safe: intern from one task only.
+const char* intern(const char* name);
+
+// Copy up to maxEvents of the recorded spans into out, oldest first. Returns the number copied.
+size_t snapshot(Event* out, size_t maxEvents);
+
+// Print the recorded spans oldest first, one per line, followed by a per-name summary (count, total, max)
+void dump(Print& out);
+
+// Forget all recorded spans, e.g. before reproducing a slow operation
+void clear();
+
+}  // namespace trace
+
+#ifdef DISABLE_TRACE
+#define TRACE(name)
+#else
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE(name) trace::Span TRACE_CONCAT(traceSpan_, __LINE__)(name)
+#endif
@@ -25,6 +25,9 @@ OpdsParser::~OpdsParser() {
 size_t OpdsParser::write(uint8_t c) { return write(&c, 1); }
 
 size_t OpdsParser::write(const uint8_t* xmlData, const size_t length) {
+  if (windowFull) {
+    return 0;
+  }
   if (errorOccured) {
     return length;
   }
@@ -52,6 +55,10 @@ size_t OpdsParser::write(const uint8_t* xmlData, const size_t length) {
     memcpy(buf, currentPos, toRead);
 
     if (XML_ParseBuffer(parser, static_cast<int>(toRead), 0) == XML_STATUS_ERROR) {
+      if (windowFull) {
+        // Stopped from addEntry(); nothing after the window is wanted
+        return 0;
+      }
       errorOccured = true;
       LOG_DBG("OPDS", "Parse error at line %lu: %s", XML_GetCurrentLineNumber(parser),
               XML_ErrorString(XML_GetErrorCode(parser)));
@@ -67,6 +74,9 @@ size_t OpdsParser::write(const uint8_t* xmlData, const size_t length) {
 }
 
 void OpdsParser::flush() {
+  if (windowFull || !parser) {
+    return;
+  }
   if (XML_Parse(parser, nullptr, 0, XML_TRUE) != XML_STATUS_OK) {
     errorOccured = true;
     XML_ParserFree(parser);
@@ -85,6 +95,31 @@ void OpdsParser::clear() {
   inAuthor = false;
   inAuthorName = false;
   inId = false;
+  nextHref.clear();
+  entriesSeen = 0;
+  entriesKept = 0;
+  windowFull = false;
+}
+
+void OpdsParser::setWindow(const size_t skip, const size_t limit) {
+  windowSkip = skip;
+  windowLimit = limit;
+}
+
+void OpdsParser::addEntry() {
+  if (entriesSeen++ < windowSkip) {
+    return;
+  }
+  if (entryHandler) {
+    entryHandler(std::move(currentEntry));
+  } else {
+    entries.push_back(std::move(currentEntry));
+  }
+  entriesKept++;
+  if (windowLimit > 0 && entriesKept >= windowLimit) {
+    windowFull = true;
+    XML_StopParser(parser, XML_FALSE);
+  }
 }
 
 std::vector<OpdsEntry> OpdsParser::getBooks() const {
@@ -116,7 +151,17 @@ void XMLCALL OpdsParser::startElement(void* userData, const XML_Char* name, cons
     return;
   }
 
-  if (!self->inEntry) return;
+  if (!self->inEntry) {
+    // Feed-level pagination link
+    if (strcmp(name, "link") == 0 || strstr(name, ":link") != nullptr) {
+      const char* rel = findAttribute(atts, "rel");
+      const char* href = findAttribute(atts, "href");
+      if (rel && href && strcmp(rel, "next") == 0) {
+        self->nextHref = href;
+      }
+    }
+    return;
+  }
 
   // Check for title element
   if (strcmp(name, "title") == 0 || strstr(name, ":title") != nullptr) {
@@ -158,6 +203,10 @@ void XMLCALL OpdsParser::startElement(void* userData, const XML_Char* name, cons
         self->currentEntry.type = OpdsEntryType::BOOK;
         self->currentEntry.href = href;
       }
+      // Cover thumbnail (the full size "opds-spec.org/image" link is too big to be worth decoding for a list)
+      else if (rel && strcmp(rel, "http://opds-spec.org/image/thumbnail") == 0) {
+        self->currentEntry.thumbnailHref = href;
+      }
       // Check for navigation link (subsection or no rel specified with atom+xml type)
       else if (type && strstr(type, "application/atom+xml") != nullptr) {
         // Only set navigation link if we don't already have an epub link
@@ -177,7 +226,7 @@ void XMLCALL OpdsParser::endElement(void* userData, const XML_Char* name) {
   if (strcmp(name, "entry") == 0 || strstr(name, ":entry") != nullptr) {
     // Only add entry if it has required fields (title and href)
     if (!self->currentEntry.title.empty() && !self->currentEntry.href.empty()) {
-      self->entries.push_back(self->currentEntry);
+      self->addEntry();
     }
     self->inEntry = false;
     self->currentEntry = OpdsEntry{};
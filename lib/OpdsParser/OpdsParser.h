@@ -2,6 +2,7 @@
 #include <Print.h>
 #include <expat.h>
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,7 @@ struct OpdsEntry {
   std::string author;  // Only for books
   std::string href;    // Navigation URL or epub download URL
   std::string id;
+  std::string thumbnailHref;  // Cover thumbnail image, if the feed has one
 };
 
 // Legacy alias for backward compatibility
@@ -79,6 +81,24 @@ class OpdsParser final : public Print {
    */
   void clear();
 
+  /**
+   * Only keep entries skip .. skip + limit - 1 (in feed order). Skipped entries are parsed but never stored; once
+   * limit entries are kept the parser stops and write() returns 0, so a streaming download ends early.
+   * A limit of 0 keeps everything.
+   */
+  void setWindow(size_t skip, size_t limit);
+
+  /**
+   * Hand each kept entry to handler as soon as it is complete instead of collecting it in getEntries().
+   */
+  void setEntryHandler(std::function<void(OpdsEntry&&)> handler) { entryHandler = std::move(handler); }
+
+  // True if the window filled up, i.e. the feed has more entries than were kept
+  bool hasMoreEntries() const { return windowFull; }
+
+  // href of the feed's rel="next" link (the server's next page), empty if none was seen
+  const std::string& getNextHref() const { return nextHref; }
+
  private:
   // Expat callbacks
   static void XMLCALL startElement(void* userData, const XML_Char* name, const XML_Char** atts);
@@ -88,8 +108,17 @@ class OpdsParser final : public Print {
   // Helper to find attribute value
   static const char* findAttribute(const XML_Char** atts, const char* name);
 
+  void addEntry();
+
   XML_Parser parser = nullptr;
   std::vector<OpdsEntry> entries;
+  std::function<void(OpdsEntry&&)> entryHandler;
+  std::string nextHref;
+  size_t windowSkip = 0;
+  size_t windowLimit = 0;
+  size_t entriesSeen = 0;
+  size_t entriesKept = 0;
+  bool windowFull = false;
   OpdsEntry currentEntry;
   std::string currentText;
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+PackBits run-length coding, as in TIFF and MacPaint. A control byte n < 128 is followed by n + 1 literal bytes, n > 128
+by one byte repeated 257 - n times, and 128 is skipped. Used for the copies of the frame buffer the renderer keeps
+(page-ahead frame, cached screens, wake frame, the packed BW snapshot), for the frames FrameCapture sends out and by
+XTCZ pages (XtcPageDecoder), so scripts/debugging_monitor.py and page generators decode the same format.
+*/
+namespace packbits {
+
+// Largest encoding of size bytes: one control byte per 128 literals
+constexpr size_t maxEncodedSize(const size_t size) { return size + (size + 127) / 128; }
+
+// Returns the encoded size; with out == nullptr only measures it, so callers can allocate the exact amount first
+inline size_t encode(const uint8_t* in, const size_t size, uint8_t* out) {
+  size_t o = 0;
+  size_t i = 0;
+  while (i < size) {
+    size_t run = 1;
+    while (i + run < size && run < 128 && in[i + run] == in[i]) {
+      run++;
+    }
+    if (run > 1) {
+      if (out) {
+        out[o] = static_cast<uint8_t>(257 - run);
+        out[o + 1] = in[i];
+      }
+      o += 2;
+      i += run;
+      continue;
+    }
+    // Literals until the next run of three, which is cheaper as a run even in the middle of literals
+    const size_t start = i;
+    while (i < size && i - start < 128 && !(i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2])) {
+      i++;
+    }
+    const size_t length = i - start;
+    if (out) {
+      out[o] = static_cast<uint8_t>(length - 1);
+      memcpy(out + o + 1, in + start, length);
+    }
+    o += 1 + length;
+  }
+  return o;
+}
+
+// Decodes into out, which holds capacity bytes. Returns the bytes produced; decoding stops early at a control byte
+// whose data is cut off or doesn't fit, so anything short of the expected size means corrupt data.
+inline size_t decode(const uint8_t* in, const size_t size, uint8_t* out, const size_t capacity) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < size) {
+    const uint8_t control = in[i++];
+    if (control < 128) {
+      const size_t count = control + 1;
+      if (i + count > size || o + count > capacity) {
+        break;
+      }
+      memcpy(out + o, in + i, count);
+      i += count;
+      o += count;
+    } else if (control > 128) {
+      const size_t count = 257 - control;
+      if (i >= size || o + count > capacity) {
+        break;
+      }
+      memset(out + o, in[i++], count);
+      o += count;
+    }
+  }
+  return o;
+}
+
+}  // namespace packbits
@@ -3,6 +3,7 @@
 #include <HalStorage.h>
 
 class Print;
+struct BmpOutput;
 
 class PngToBmpConverter {
   static bool pngFileToBmpStreamInternal(FsFile& pngFile, Print& bmpOut, int targetWidth, int targetHeight, bool oneBit,
@@ -12,4 +13,6 @@ class PngToBmpConverter {
   static bool pngFileToBmpStream(FsFile& pngFile, Print& bmpOut, bool crop = true);
   static bool pngFileToBmpStreamWithSize(FsFile& pngFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
   static bool pngFileTo1BitBmpStreamWithSize(FsFile& pngFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
+  // Decode once and write every output (e.g. cover and thumbnails), each scaled and dithered on its own
+  static bool pngFileToBmpStreams(FsFile& pngFile, const BmpOutput* outputs, int count);
 };
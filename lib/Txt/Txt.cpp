@@ -1,8 +1,22 @@
 #include "Txt.h"
 
+#include <BmpRowWriter.h>
 #include <FsHelpers.h>
 #include <JpegToBmpConverter.h>
 #include <Logging.h>
+#include <PngToBmpConverter.h>
+#include <Serialization.h>
+
+#include <cstdlib>
+
+namespace {
+constexpr size_t DETECT_SAMPLE_SIZE = 4096;
+constexpr size_t TRANSCODE_CHUNK_SIZE = 2048;
+
+// Transcoded content file magic and version
+constexpr uint32_t CONTENT_MAGIC = 0x54585455;  // "TXTU"
+constexpr uint8_t CONTENT_VERSION = 1;          // Increment when the conversion changes
+}  // namespace
 
 Txt::Txt(std::string path, std::string cacheBasePath)
     : filepath(std::move(path)), cacheBasePath(std::move(cacheBasePath)) {
@@ -27,11 +41,181 @@ bool Txt::load() {
     return false;
   }
 
-  fileSize = file.size();
+  const size_t sourceSize = file.size();
+  size_t bomLength = 0;
+  encoding = detectEncoding(file, sourceSize, bomLength);
+
+  if (encoding == TxtEncoding::Utf8) {
+    contentPath = filepath;
+    fileSize = sourceSize;
+  } else if (!loadTranscodedContent(sourceSize) && !transcodeContent(file, sourceSize, bomLength)) {
+    file.close();
+    return false;
+  }
   file.close();
 
   loaded = true;
-  LOG_DBG("TXT", "Loaded TXT file: %s (%zu bytes)", filepath.c_str(), fileSize);
+  LOG_DBG("TXT", "Loaded TXT file: %s (%zu bytes, encoding %d)", filepath.c_str(), fileSize,
+          static_cast<int>(encoding));
+  return true;
+}
+
+TxtEncoding Txt::detectEncoding(FsFile& file, const size_t sourceSize, size_t& bomLength) const {
+  bomLength = 0;
+  auto* sample = static_cast<uint8_t*>(malloc(DETECT_SAMPLE_SIZE));
+  if (!sample) {
+    LOG_ERR("TXT", "Failed to allocate %zu bytes", DETECT_SAMPLE_SIZE);
+    return TxtEncoding::Utf8;
+  }
+
+  int length = file.read(sample, DETECT_SAMPLE_SIZE);
+  if (length <= 0) {
+    free(sample);
+    return TxtEncoding::Utf8;
+  }
+  TxtEncoding detected = TxtTranscoder::detect(sample, length, static_cast<size_t>(length) == sourceSize, bomLength);
+
+  // A plain ASCII start (a licence or title page) says nothing yet, so also look at the middle of the file
+  bool ascii = bomLength == 0;
+  for (int i = 0; ascii && i < length; i++) {
+    ascii = sample[i] < 0x80;
+  }
+  if (ascii && sourceSize > DETECT_SAMPLE_SIZE && file.seek(sourceSize / 2)) {
+    length = file.read(sample, DETECT_SAMPLE_SIZE);
+    // Start at a character boundary
+    int start = 0;
+    while (start < length && start < 3 && (sample[start] & 0xC0) == 0x80) {
+      start++;
+    }
+    size_t unused;
+    if (length > start) {
+      detected = TxtTranscoder::detect(sample + start, length - start,
+                                       sourceSize / 2 + static_cast<size_t>(length) == sourceSize, unused);
+    }
+  }
+
+  free(sample);
+  file.seek(0);
+  return detected;
+}
+
+bool Txt::loadTranscodedContent(const size_t sourceSize) {
+  // content.bin describes content.txt and is only written once the conversion is complete:
+  // - uint32_t: magic "TXTU"
+  // - uint8_t: version
+  // - uint32_t: source file size (to validate the copy)
+  // - uint8_t: source encoding
+  // - uint32_t: content size
+  contentPath = cachePath + "/content.txt";
+  FsFile f;
+  if (!Storage.openFileForRead("TXT", cachePath + "/content.bin", f)) {
+    return false;
+  }
+
+  uint32_t magic = 0;
+  uint8_t version = 0;
+  uint32_t cachedSourceSize = 0;
+  uint8_t cachedEncoding = 0;
+  uint32_t contentSize = 0;
+  serialization::readPod(f, magic);
+  serialization::readPod(f, version);
+  serialization::readPod(f, cachedSourceSize);
+  serialization::readPod(f, cachedEncoding);
+  serialization::readPod(f, contentSize);
+  f.close();
+
+  if (magic != CONTENT_MAGIC || version != CONTENT_VERSION || cachedSourceSize != sourceSize ||
+      cachedEncoding != static_cast<uint8_t>(encoding)) {
+    LOG_DBG("TXT", "UTF-8 copy is stale, converting again");
+    return false;
+  }
+
+  FsFile content;
+  if (!Storage.openFileForRead("TXT", contentPath, content)) {
+    return false;
+  }
+  const size_t size = content.size();
+  content.close();
+  if (size != contentSize) {
+    LOG_DBG("TXT", "UTF-8 copy size mismatch, converting again");
+    return false;
+  }
+
+  fileSize = contentSize;
+  return true;
+}
+
+bool Txt::transcodeContent(FsFile& source, const size_t sourceSize, const size_t bomLength) {
+  LOG_DBG("TXT", "Converting %zu bytes (encoding %d) to UTF-8", sourceSize, static_cast<int>(encoding));
+  const unsigned long start = millis();
+
+  setupCacheDir();
+  const std::string metaPath = cachePath + "/content.bin";
+  contentPath = cachePath + "/content.txt";
+  // An old description must not outlive the copy it describes
+  if (Storage.exists(metaPath.c_str())) {
+    Storage.remove(metaPath.c_str());
+  }
+
+  auto* in = static_cast<uint8_t*>(malloc(TRANSCODE_CHUNK_SIZE));
+  auto* out = static_cast<uint8_t*>(malloc(TxtTranscoder::maxOutput(TRANSCODE_CHUNK_SIZE)));
+  if (!in || !out) {
+    LOG_ERR("TXT", "Failed to allocate conversion buffers");
+    free(in);
+    free(out);
+    return false;
+  }
+
+  FsFile dst;
+  if (!source.seek(bomLength) || !Storage.openFileForWrite("TXT", contentPath, dst)) {
+    LOG_ERR("TXT", "Failed to create UTF-8 copy");
+    free(in);
+    free(out);
+    return false;
+  }
+
+  TxtTranscoder transcoder(encoding);
+  size_t contentSize = 0;
+  bool success = true;
+  while (success) {
+    const int bytesRead = source.read(in, TRANSCODE_CHUNK_SIZE);
+    if (bytesRead < 0) {
+      success = false;
+      break;
+    }
+    const size_t written = bytesRead > 0 ? transcoder.convert(in, bytesRead, out) : transcoder.finish(out);
+    if (written > 0 && dst.write(out, written) != written) {
+      success = false;
+      break;
+    }
+    contentSize += written;
+    if (bytesRead == 0) {
+      break;
+    }
+  }
+  dst.close();
+  free(in);
+  free(out);
+
+  if (!success) {
+    LOG_ERR("TXT", "Failed to write UTF-8 copy");
+    Storage.remove(contentPath.c_str());
+    return false;
+  }
+
+  FsFile meta;
+  if (!Storage.openFileForWrite("TXT", metaPath, meta)) {
+    return false;
+  }
+  serialization::writePod(meta, CONTENT_MAGIC);
+  serialization::writePod(meta, CONTENT_VERSION);
+  serialization::writePod(meta, static_cast<uint32_t>(sourceSize));
+  serialization::writePod(meta, static_cast<uint8_t>(encoding));
+  serialization::writePod(meta, static_cast<uint32_t>(contentSize));
+  meta.close();
+
+  fileSize = contentSize;
+  LOG_DBG("TXT", "Converted to %zu bytes of UTF-8 in %lu ms", contentSize, millis() - start);
   return true;
 }
 
@@ -118,6 +302,7 @@ bool Txt::generateCoverBmp() const {
       (len >= 4 && (coverImagePath.substr(len - 4) == ".jpg" || coverImagePath.substr(len - 4) == ".JPG")) ||
       (len >= 5 && (coverImagePath.substr(len - 5) == ".jpeg" || coverImagePath.substr(len - 5) == ".JPEG"));
   const bool isBmp = len >= 4 && (coverImagePath.substr(len - 4) == ".bmp" || coverImagePath.substr(len - 4) == ".BMP");
+  const bool isPng = len >= 4 && (coverImagePath.substr(len - 4) == ".png" || coverImagePath.substr(len - 4) == ".PNG");
 
   if (isBmp) {
     // Copy BMP file to cache
@@ -141,32 +326,33 @@ bool Txt::generateCoverBmp() const {
     return true;
   }
 
-  if (isJpg) {
-    // Convert JPG/JPEG to BMP (same approach as Epub)
-    LOG_DBG("TXT", "Generating BMP from JPG cover image");
-    FsFile coverJpg, coverBmp;
-    if (!Storage.openFileForRead("TXT", coverImagePath, coverJpg)) {
+  if (isJpg || isPng) {
+    // Convert JPG/JPEG/PNG to BMP through the same cover pipeline as Epub
+    LOG_DBG("TXT", "Generating BMP from %s cover image", isJpg ? "JPG" : "PNG");
+    FsFile coverImage, coverBmp;
+    if (!Storage.openFileForRead("TXT", coverImagePath, coverImage)) {
       return false;
     }
     if (!Storage.openFileForWrite("TXT", getCoverBmpPath(), coverBmp)) {
-      coverJpg.close();
+      coverImage.close();
       return false;
     }
-    const bool success = JpegToBmpConverter::jpegFileToBmpStream(coverJpg, coverBmp);
-    coverJpg.close();
+    const BmpOutput output = BmpOutput::cover(coverBmp, true);
+    const bool success = isJpg ? JpegToBmpConverter::jpegFileToBmpStreams(coverImage, &output, 1)
+                               : PngToBmpConverter::pngFileToBmpStreams(coverImage, &output, 1);
+    coverImage.close();
     coverBmp.close();
 
     if (!success) {
-      LOG_ERR("TXT", "Failed to generate BMP from JPG cover image");
+      LOG_ERR("TXT", "Failed to generate BMP from cover image");
       Storage.remove(getCoverBmpPath().c_str());
     } else {
-      LOG_DBG("TXT", "Generated BMP from JPG cover image");
+      LOG_DBG("TXT", "Generated BMP from cover image");
     }
     return success;
   }
 
-  // PNG files are not supported (would need a PNG decoder)
-  LOG_ERR("TXT", "Cover image format not supported (only BMP/JPG/JPEG)");
+  LOG_ERR("TXT", "Cover image format not supported");
   return false;
 }
 
@@ -176,7 +362,7 @@ bool Txt::readContent(uint8_t* buffer, size_t offset, size_t length) const {
   }
 
   FsFile file;
-  if (!Storage.openFileForRead("TXT", filepath, file)) {
+  if (!Storage.openFileForRead("TXT", contentPath, file)) {
     return false;
   }
 
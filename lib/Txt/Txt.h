@@ -5,12 +5,20 @@
 #include <memory>
 #include <string>
 
+#include "TxtEncoding.h"
+
 class Txt {
   std::string filepath;
   std::string cacheBasePath;
   std::string cachePath;
+  std::string contentPath;  // The file itself when it is UTF-8, else its UTF-8 copy in the cache
   bool loaded = false;
-  size_t fileSize = 0;
+  size_t fileSize = 0;  // Of the UTF-8 content
+  TxtEncoding encoding = TxtEncoding::Utf8;
+
+  TxtEncoding detectEncoding(FsFile& file, size_t sourceSize, size_t& bomLength) const;
+  bool loadTranscodedContent(size_t sourceSize);
+  bool transcodeContent(FsFile& source, size_t sourceSize, size_t bomLength);
 
  public:
   explicit Txt(std::string path, std::string cacheBasePath);
@@ -19,7 +27,10 @@ class Txt {
   [[nodiscard]] const std::string& getPath() const { return filepath; }
   [[nodiscard]] const std::string& getCachePath() const { return cachePath; }
   [[nodiscard]] std::string getTitle() const;
+  // Path and size of the UTF-8 text all reading and pagination works on
+  [[nodiscard]] const std::string& getContentPath() const { return contentPath; }
   [[nodiscard]] size_t getFileSize() const { return fileSize; }
+  [[nodiscard]] TxtEncoding getEncoding() const { return encoding; }
 
   void setupCacheDir() const;
 
@@ -0,0 +1,195 @@
+#include "TxtEncoding.h"
+
+namespace {
+constexpr uint32_t REPLACEMENT_CHAR = 0xFFFD;
+
+// 0x80 - 0xBF, 0xC0 - 0xFF are U+0410 - U+044F
+constexpr uint16_t CP1251_HIGH[64] = {
+    0x0402, 0x0403, 0x201A, 0x0453, 0x201E, 0x2026, 0x2020, 0x2021, 0x20AC, 0x2030, 0x0409, 0x2039, 0x040A,
+    0x040C, 0x040B, 0x040F, 0x0452, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0xFFFD, 0x2122,
+    0x0459, 0x203A, 0x045A, 0x045C, 0x045B, 0x045F, 0x00A0, 0x040E, 0x045E, 0x0408, 0x00A4, 0x0490, 0x00A6,
+    0x00A7, 0x0401, 0x00A9, 0x0404, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x0407, 0x00B0, 0x00B1, 0x0406, 0x0456,
+    0x0491, 0x00B5, 0x00B6, 0x00B7, 0x0451, 0x2116, 0x0454, 0x00BB, 0x0458, 0x0405, 0x0455, 0x0457};
+
+// 0x80 - 0x9F, 0xA0 - 0xFF match Latin-1
+constexpr uint16_t CP1252_HIGH[32] = {0x20AC, 0xFFFD, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+                                      0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0xFFFD, 0x017D, 0xFFFD,
+                                      0xFFFD, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+                                      0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0xFFFD, 0x017E, 0x0178};
+
+size_t putUtf8(uint32_t cp, uint8_t* out) {
+  if (cp < 0x80) {
+    out[0] = cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = 0xC0 | (cp >> 6);
+    out[1] = 0x80 | (cp & 0x3F);
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = 0xE0 | (cp >> 12);
+    out[1] = 0x80 | ((cp >> 6) & 0x3F);
+    out[2] = 0x80 | (cp & 0x3F);
+    return 3;
+  }
+  out[0] = 0xF0 | (cp >> 18);
+  out[1] = 0x80 | ((cp >> 12) & 0x3F);
+  out[2] = 0x80 | ((cp >> 6) & 0x3F);
+  out[3] = 0x80 | (cp & 0x3F);
+  return 4;
+}
+
+// Length of the UTF-8 sequence starting with lead, 0 if it cannot start one
+int utf8SequenceLength(const uint8_t lead) {
+  if (lead < 0x80) return 1;
+  if (lead >= 0xC2 && lead <= 0xDF) return 2;
+  if (lead >= 0xE0 && lead <= 0xEF) return 3;
+  if (lead >= 0xF0 && lead <= 0xF4) return 4;
+  return 0;
+}
+}  // namespace
+
+TxtEncoding TxtTranscoder::detect(const uint8_t* sample, const size_t length, const bool sampleEnd,
+                                  size_t& bomLength) {
+  bomLength = 0;
+  if (length >= 3 && sample[0] == 0xEF && sample[1] == 0xBB && sample[2] == 0xBF) {
+    bomLength = 3;
+    return TxtEncoding::Utf8;
+  }
+  if (length >= 2 && sample[0] == 0xFF && sample[1] == 0xFE) {
+    bomLength = 2;
+    return TxtEncoding::Utf16Le;
+  }
+  if (length >= 2 && sample[0] == 0xFE && sample[1] == 0xFF) {
+    bomLength = 2;
+    return TxtEncoding::Utf16Be;
+  }
+
+  // Text in UTF-16 without a byte order mark still has a zero byte in every ASCII character
+  size_t evenZeros = 0;
+  size_t oddZeros = 0;
+  for (size_t i = 0; i + 1 < length; i += 2) {
+    evenZeros += sample[i] == 0;
+    oddZeros += sample[i + 1] == 0;
+  }
+  const size_t units = length / 2;
+  if (units > 0 && oddZeros > units / 4 && evenZeros < units / 16) {
+    return TxtEncoding::Utf16Le;
+  }
+  if (units > 0 && evenZeros > units / 4 && oddZeros < units / 16) {
+    return TxtEncoding::Utf16Be;
+  }
+
+  size_t highBytes = 0;
+  size_t highRuns = 0;  // High bytes next to another high byte
+  bool validUtf8 = true;
+  for (size_t i = 0; i < length;) {
+    const int sequence = utf8SequenceLength(sample[i]);
+    bool valid = sequence > 0;
+    for (int k = 1; valid && k < sequence; k++) {
+      if (i + k >= length) {
+        valid = !sampleEnd;  // Cut off by the end of the sample
+        break;
+      }
+      valid = (sample[i + k] & 0xC0) == 0x80;
+    }
+    if (!valid) {
+      validUtf8 = false;
+    }
+
+    if (sample[i] >= 0x80) {
+      highBytes++;
+      if ((i > 0 && sample[i - 1] >= 0x80) || (i + 1 < length && sample[i + 1] >= 0x80)) {
+        highRuns++;
+      }
+    }
+    i += valid ? sequence : 1;
+  }
+
+  if (validUtf8) {
+    return TxtEncoding::Utf8;
+  }
+  return highRuns * 2 >= highBytes ? TxtEncoding::Cp1251 : TxtEncoding::Cp1252;
+}
+
+uint32_t TxtTranscoder::singleByteCodepoint(const TxtEncoding encoding, const uint8_t byte) {
+  if (byte < 0x80) {
+    return byte;
+  }
+  if (encoding == TxtEncoding::Cp1251) {
+    return byte < 0xC0 ? CP1251_HIGH[byte - 0x80] : 0x0410 + (byte - 0xC0);
+  }
+  return byte < 0xA0 ? CP1252_HIGH[byte - 0x80] : byte;
+}
+
+size_t TxtTranscoder::putUtf16Unit(const uint16_t unit, uint8_t* out) {
+  size_t written = 0;
+  if (pendingSurrogate) {
+    if (unit >= 0xDC00 && unit <= 0xDFFF) {
+      const uint32_t cp = 0x10000 + ((pendingSurrogate - 0xD800) << 10) + (unit - 0xDC00);
+      pendingSurrogate = 0;
+      return putUtf8(cp, out);
+    }
+    written += putUtf8(REPLACEMENT_CHAR, out);
+    pendingSurrogate = 0;
+  }
+
+  if (unit >= 0xD800 && unit <= 0xDBFF) {
+    pendingSurrogate = unit;
+  } else if (unit >= 0xDC00 && unit <= 0xDFFF) {
+    written += putUtf8(REPLACEMENT_CHAR, out + written);
+  } else if (unit != 0) {  // A null character would end the line strings early
+    written += putUtf8(unit, out + written);
+  }
+  return written;
+}
+
+size_t TxtTranscoder::convert(const uint8_t* in, const size_t length, uint8_t* out) {
+  size_t written = 0;
+  switch (encoding) {
+    case TxtEncoding::Utf8:
+      for (size_t i = 0; i < length; i++) {
+        out[i] = in[i];
+      }
+      return length;
+
+    case TxtEncoding::Utf16Le:
+    case TxtEncoding::Utf16Be: {
+      const bool littleEndian = encoding == TxtEncoding::Utf16Le;
+      size_t i = 0;
+      if (pendingByte >= 0 && length > 0) {
+        const uint8_t first = pendingByte;
+        pendingByte = -1;
+        written += putUtf16Unit(littleEndian ? first | in[0] << 8 : first << 8 | in[0], out);
+        i = 1;
+      }
+      for (; i + 1 < length; i += 2) {
+        const uint16_t unit = littleEndian ? in[i] | in[i + 1] << 8 : in[i] << 8 | in[i + 1];
+        written += putUtf16Unit(unit, out + written);
+      }
+      if (i < length) {
+        pendingByte = in[i];
+      }
+      return written;
+    }
+
+    case TxtEncoding::Cp1251:
+    case TxtEncoding::Cp1252:
+      for (size_t i = 0; i < length; i++) {
+        written += putUtf8(singleByteCodepoint(encoding, in[i]), out + written);
+      }
+      return written;
+  }
+  return written;
+}
+
+size_t TxtTranscoder::finish(uint8_t* out) {
+  size_t written = 0;
+  if (pendingSurrogate || pendingByte >= 0) {
+    written = putUtf8(REPLACEMENT_CHAR, out);
+  }
+  pendingSurrogate = 0;
+  pendingByte = -1;
+  return written;
+}
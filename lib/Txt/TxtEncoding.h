@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class TxtEncoding : uint8_t { Utf8, Utf16Le, Utf16Be, Cp1251, Cp1252 };
+
+// Detects the encoding of a text file and converts it to UTF-8 in chunks
+class TxtTranscoder {
+ public:
+  // Most UTF-8 bytes a convert() call can produce for length input bytes
+  static constexpr size_t maxOutput(const size_t length) { return length * 3 + 4; }
+
+  // Guess the encoding from a sample of the file. A byte order mark decides directly and its length is returned
+  // in bomLength; otherwise null bytes mean UTF-16, valid multi-byte sequences UTF-8, and other high bytes one of
+  // the Windows code pages (Cyrillic when they come in runs, Western when they are scattered between ASCII).
+  // sampleEnd is false when the sample stops before the end of the file, so a sequence cut off there is accepted.
+  static TxtEncoding detect(const uint8_t* sample, size_t length, bool sampleEnd, size_t& bomLength);
+
+  // Unicode code point of a byte in one of the single-byte code pages (Cp1251 or Cp1252)
+  static uint32_t singleByteCodepoint(TxtEncoding encoding, uint8_t byte);
+
+  explicit TxtTranscoder(const TxtEncoding encoding) : encoding(encoding) {}
+
+  // Convert the next length bytes into out, which must hold maxOutput(length) bytes. A code unit or surrogate pair
+  // split between calls is completed by the next one. Returns the number of bytes written.
+  size_t convert(const uint8_t* in, size_t length, uint8_t* out);
+
+  // Flush what is left of an incomplete sequence at the end of the input
+  size_t finish(uint8_t* out);
+
+ private:
+  TxtEncoding encoding;
+  int pendingByte = -1;            // First byte of a UTF-16 code unit split between calls
+  uint16_t pendingSurrogate = 0;   // High surrogate waiting for its low half
+
+  size_t putUtf16Unit(uint16_t unit, uint8_t* out);
+};
@@ -0,0 +1,369 @@
+#include "TxtPageBuilder.h"
+
+#include <Epub/hyphenation/Hyphenator.h>
+#include <GfxRenderer.h>
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr size_t MAX_WORD_BYTES = 200;     // Longer runs are added as attached pieces, like the EPUB parser does
+constexpr size_t MAX_PENDING_WORDS = 750;  // Longer paragraphs are laid out early, all but their last line
+
+bool isSpace(const char c) { return c == ' ' || c == '\t'; }
+bool isContinuationByte(const char c) { return (static_cast<uint8_t>(c) & 0xC0) == 0x80; }
+
+// A line of three or more '-', '*' or '_' (spaces allowed), drawn as a blank line
+bool isMarkdownRule(const char* text, const size_t length) {
+  size_t marks = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] == text[0] && (text[i] == '-' || text[i] == '*' || text[i] == '_')) {
+      marks++;
+    } else if (!isSpace(text[i])) {
+      return false;
+    }
+  }
+  return marks >= 3;
+}
+}  // namespace
+
+TxtPageBuilder::TxtPageBuilder(const GfxRenderer& renderer, TxtReadWindow& window, const size_t contentSize,
+                               const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                               const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                               const uint16_t viewportHeight, const bool hyphenationEnabled, const bool markdown)
+    : renderer(renderer),
+      window(window),
+      contentSize(contentSize),
+      fontId(fontId),
+      lineHeight(static_cast<int>(renderer.getLineHeight(fontId) * lineCompression)),
+      extraParagraphSpacing(extraParagraphSpacing),
+      viewportWidth(viewportWidth),
+      viewportHeight(viewportHeight),
+      hyphenationEnabled(hyphenationEnabled),
+      markdown(markdown) {
+  blockStyle.textAlignDefined = true;
+  blockStyle.alignment = paragraphAlignment == static_cast<uint8_t>(CssTextAlign::None)
+                             ? CssTextAlign::Justify
+                             : static_cast<CssTextAlign>(paragraphAlignment);
+}
+
+const char* TxtPageBuilder::guessLanguage(const char* sample, const size_t length) {
+  size_t latin = 0;
+  size_t cyrillic = 0;
+  for (size_t i = 0; i < length; i++) {
+    const auto c = static_cast<uint8_t>(sample[i]);
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+      latin++;
+    } else if (c == 0xD0 || c == 0xD1) {  // Lead byte of U+0400 - U+047F
+      cyrillic++;
+    }
+  }
+  return cyrillic > latin ? "ru" : "en";
+}
+
+void TxtPageBuilder::begin(const TxtPageStart& start, PageCallback onPage) {
+  this->onPage = std::move(onPage);
+  paragraph.reset();
+  currentPage.reset();
+  nextY = 0;
+  sourceOffset = start.paragraphOffset;
+  paragraphOffset = start.paragraphOffset;
+  lineInParagraph = 0;
+  paragraphTextBytes = 0;
+  linesToSkip = start.lineInParagraph;
+  attachNext = false;
+  finished = false;
+
+  if (hyphenationEnabled) {
+    const size_t length = std::min(READ_CHUNK_SIZE, contentSize);
+    const char* sample = length > 0 ? window.read(0, length) : nullptr;
+    Hyphenator::setPreferredLanguage(sample ? guessLanguage(sample, length) : "en");
+  }
+}
+
+bool TxtPageBuilder::step() {
+  if (finished) {
+    return false;
+  }
+
+  if (sourceOffset >= contentSize) {
+    if (paragraph) {
+      finishParagraph();
+    }
+    if (currentPage && !currentPage->elements.empty()) {
+      completePage({static_cast<uint32_t>(contentSize), 0, static_cast<uint32_t>(contentSize)});
+    }
+    finished = true;
+    return false;
+  }
+
+  const size_t length = std::min(READ_CHUNK_SIZE, contentSize - sourceOffset);
+  const char* chunk = window.read(sourceOffset, length);
+  if (!chunk) {
+    // Keep the pages laid out so far, the rest of the file can't be read
+    LOG_ERR("TXP", "Failed to read text at %zu", sourceOffset);
+    sourceOffset = contentSize;
+    return true;
+  }
+
+  // A paragraph ends at the next newline. Without one in reach, lay out what is there up to the last space and
+  // continue the paragraph with the next step.
+  size_t segmentLength;
+  size_t consumed;
+  bool paragraphEnds = true;
+  if (const auto* newline = static_cast<const char*>(memchr(chunk, '\n', length))) {
+    segmentLength = newline - chunk;
+    consumed = segmentLength + 1;
+  } else if (sourceOffset + length >= contentSize) {
+    segmentLength = consumed = length;
+  } else {
+    paragraphEnds = false;
+    segmentLength = length;
+    while (segmentLength > 0 && !isSpace(chunk[segmentLength - 1])) {
+      segmentLength--;
+    }
+    if (segmentLength == 0) {
+      // A single run of 4KB without spaces: cut it at a character boundary
+      segmentLength = length - 1;
+      while (segmentLength > 1 && isContinuationByte(chunk[segmentLength])) {
+        segmentLength--;
+      }
+    }
+    consumed = segmentLength;
+  }
+  if (paragraphEnds && segmentLength > 0 && chunk[segmentLength - 1] == '\r') {
+    segmentLength--;
+  }
+
+  const char* text = chunk;
+  size_t textLength = segmentLength;
+  if (!paragraph) {
+    paragraph.reset(new ParsedText(extraParagraphSpacing, hyphenationEnabled, blockStyle, &arenas));
+    paragraphOffset = sourceOffset;
+    lineInParagraph = 0;
+    paragraphTextBytes = 0;
+    attachNext = false;
+    if (markdown) {
+      applyMarkdownLineStart(text, textLength);
+    }
+  }
+  addWords(text, textLength);
+  attachNext = !paragraphEnds && segmentLength > 0 && !isSpace(chunk[segmentLength - 1]);
+  sourceOffset += consumed;
+
+  if (paragraphEnds) {
+    finishParagraph();
+  } else if (paragraph->size() > MAX_PENDING_WORDS) {
+    layout(false);
+  }
+  return true;
+}
+
+void TxtPageBuilder::addWords(const char* text, const size_t length) {
+  size_t pos = 0;
+  bool attach = attachNext;
+  while (pos < length) {
+    if (isSpace(text[pos])) {
+      attach = false;
+      pos++;
+      continue;
+    }
+
+    size_t end = pos;
+    while (end < length && !isSpace(text[end])) {
+      end++;
+    }
+    while (pos < end) {
+      size_t pieceEnd = end;
+      if (pieceEnd - pos > MAX_WORD_BYTES) {
+        pieceEnd = pos + MAX_WORD_BYTES;
+        while (pieceEnd > pos + 1 && isContinuationByte(text[pieceEnd])) {
+          pieceEnd--;
+        }
+      }
+      if (markdown) {
+        addMarkdownWord(text + pos, pieceEnd - pos, attach);
+      } else {
+        paragraph->addWord(text + pos, pieceEnd - pos, EpdFontFamily::REGULAR, false, attach);
+      }
+      attach = true;
+      pos = pieceEnd;
+    }
+  }
+}
+
+void TxtPageBuilder::applyMarkdownLineStart(const char*& text, size_t& length) {
+  lineStyle = EpdFontFamily::REGULAR;
+  markdownBold = false;
+  markdownItalic = false;
+
+  size_t pos = 0;
+  while (pos < length && isSpace(text[pos])) {
+    pos++;
+  }
+  const char* line = text + pos;
+  const size_t lineLength = length - pos;
+
+  if (isMarkdownRule(line, lineLength) || (lineLength >= 3 && (strncmp(line, "```", 3) == 0 ||
+                                                               strncmp(line, "~~~", 3) == 0))) {
+    length = 0;
+    return;
+  }
+
+  BlockStyle style = blockStyle;
+  size_t skip = 0;
+  size_t hashes = 0;
+  while (hashes < lineLength && hashes < 6 && line[hashes] == '#') {
+    hashes++;
+  }
+  if (hashes > 0 && (hashes == lineLength || isSpace(line[hashes]))) {
+    // Heading
+    lineStyle = EpdFontFamily::BOLD;
+    style.alignment = CssTextAlign::Left;
+    style.textIndentDefined = true;
+    skip = hashes;
+  } else if (lineLength > 0 && line[0] == '>') {
+    // Quote
+    lineStyle = EpdFontFamily::ITALIC;
+    style.marginLeft = static_cast<int16_t>(lineHeight);
+    skip = 1;
+  } else if (lineLength >= 2 && (line[0] == '-' || line[0] == '*' || line[0] == '+') && isSpace(line[1])) {
+    // Bullet list item, drawn with a bullet
+    style.alignment = CssTextAlign::Left;
+    style.textIndentDefined = true;
+    style.marginLeft = static_cast<int16_t>(lineHeight / 2);
+    paragraph->addWord("\xe2\x80\xa2", 3, EpdFontFamily::REGULAR);
+    skip = 2;
+  } else {
+    // Numbered list item, the number is kept
+    size_t digits = 0;
+    while (digits < lineLength && line[digits] >= '0' && line[digits] <= '9') {
+      digits++;
+    }
+    if (digits > 0 && digits + 1 < lineLength && (line[digits] == '.' || line[digits] == ')') &&
+        isSpace(line[digits + 1])) {
+      style.alignment = CssTextAlign::Left;
+      style.textIndentDefined = true;
+      style.marginLeft = static_cast<int16_t>(lineHeight / 2);
+    }
+  }
+  paragraph->setBlockStyle(style);
+  text = line + skip;
+  length = lineLength - skip;
+}
+
+void TxtPageBuilder::addMarkdownWord(const char* text, const size_t length, bool attach) {
+  char piece[MAX_WORD_BYTES];
+  size_t pieceLength = 0;
+  const auto flush = [&]() {
+    if (pieceLength == 0) {
+      return;
+    }
+    auto style = static_cast<uint8_t>(lineStyle);
+    if (markdownBold) style |= EpdFontFamily::BOLD;
+    if (markdownItalic) style |= EpdFontFamily::ITALIC;
+    paragraph->addWord(piece, pieceLength, static_cast<EpdFontFamily::Style>(style), false, attach);
+    attach = true;
+    pieceLength = 0;
+  };
+
+  // Links and images keep their text: "[text](url)" and "![alt](src)"
+  size_t pos = 0;
+  if (length >= 2 && text[0] == '!' && text[1] == '[') {
+    pos = 1;
+  }
+  if (pos < length && text[pos] == '[') {
+    pos++;
+  }
+  size_t end = length;
+  for (size_t i = pos; i + 1 < length; i++) {
+    if (text[i] == ']' && text[i + 1] == '(') {
+      end = i;
+      break;
+    }
+  }
+
+  for (size_t i = pos; i < end; i++) {
+    const char c = text[i];
+    if ((c == '*' || c == '_') && i + 1 < end && text[i + 1] == c) {
+      flush();
+      markdownBold = !markdownBold;
+      i++;
+    } else if (c == '*' || (c == '_' && (i == pos || i + 1 == end))) {
+      // An underscore inside a word (snake_case) is text
+      flush();
+      markdownItalic = !markdownItalic;
+    } else if (c != '`') {
+      // Pieces are cut between characters, never inside one
+      if (pieceLength + 4 > sizeof(piece) && !isContinuationByte(c)) {
+        flush();
+      }
+      piece[pieceLength++] = c;
+    }
+  }
+  flush();
+}
+
+void TxtPageBuilder::layout(const bool includeLastLine) {
+  paragraph->layoutAndExtractLines(
+      renderer, fontId, viewportWidth, [this](ArenaPtr<TextBlock> line) { addLine(std::move(line)); },
+      includeLastLine);
+}
+
+void TxtPageBuilder::finishParagraph() {
+  if (paragraph->isEmpty()) {
+    // An empty line
+    if (!currentPage) {
+      currentPage.reset(new Page());
+      nextY = 0;
+    }
+    nextY += lineHeight;
+  } else {
+    layout(true);
+    if (extraParagraphSpacing) {
+      nextY += lineHeight / 2;
+    }
+  }
+  paragraph.reset();
+}
+
+void TxtPageBuilder::addLine(ArenaPtr<TextBlock> line) {
+  uint32_t lineBytes = 0;
+  for (size_t i = 0; i < line->wordCount(); i++) {
+    lineBytes += line->getWordLen(i) + 1;
+  }
+
+  if (linesToSkip > 0) {
+    // Already on a page before the one layout started at. Nothing else holds lines yet, so the line arena can be
+    // recycled as if a page had been completed.
+    linesToSkip--;
+    lineInParagraph++;
+    paragraphTextBytes += lineBytes;
+    arenas.pageCompleted();
+    return;
+  }
+
+  if (!currentPage) {
+    currentPage.reset(new Page());
+    nextY = 0;
+  } else if (nextY + lineHeight > viewportHeight) {
+    const uint32_t textOffset = std::min<uint32_t>(paragraphOffset + paragraphTextBytes, sourceOffset);
+    completePage({paragraphOffset, lineInParagraph, textOffset});
+    currentPage.reset(new Page());
+    nextY = 0;
+  }
+
+  const int16_t xOffset = line->getBlockStyle().leftInset();
+  currentPage->addGlyphGroups(renderer, fontId, *line, xOffset, nextY);
+  currentPage->elements.push_back(std::make_shared<PageLine>(std::move(line), xOffset, nextY));
+  nextY += lineHeight;
+  lineInParagraph++;
+  paragraphTextBytes += lineBytes;
+}
+
+void TxtPageBuilder::completePage(const TxtPageStart& nextStart) {
+  onPage(std::move(currentPage), nextStart);
+  currentPage.reset();
+  arenas.pageCompleted();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Epub/Page.h>
+#include <Epub/ParsedText.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "TxtReadWindow.h"
+
+class GfxRenderer;
+
+// Where a page starts in the text. Layout always restarts at a paragraph, so a page is found again by laying out
+// its paragraph from the beginning and dropping the lines that went to earlier pages.
+struct TxtPageStart {
+  uint32_t paragraphOffset = 0;  // Byte offset of the paragraph holding the page's first line
+  uint32_t lineInParagraph = 0;  // Lines of that paragraph on earlier pages
+  uint32_t textOffset = 0;       // Approximate byte offset of the page's first line, for progress
+};
+
+// Lays out UTF-8 text into the same Pages EPUB sections are made of. Every line of the file is a paragraph, laid
+// out by ParsedText with the reader's alignment and hyphenation settings; empty lines leave a blank line. Work is
+// done one paragraph at a time, so it can be spread over a background task and resumed from any page start.
+// In Markdown mode headings, quotes, list items and emphasis are rendered and their markup is dropped; markup is
+// only read within a line, so a page start stays a valid resume point.
+class TxtPageBuilder {
+ public:
+  // Receives each finished page and where the page after it starts (the end of the text after the last page)
+  using PageCallback = std::function<void(std::unique_ptr<Page> page, const TxtPageStart& nextStart)>;
+
+  // Largest read from the window, which must be allocated with at least this capacity
+  static constexpr size_t READ_CHUNK_SIZE = 4096;
+
+  TxtPageBuilder(const GfxRenderer& renderer, TxtReadWindow& window, size_t contentSize, int fontId,
+                 float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment, uint16_t viewportWidth,
+                 uint16_t viewportHeight, bool hyphenationEnabled, bool markdown = false);
+
+  // Start laying out at the given page
+  void begin(const TxtPageStart& start, PageCallback onPage);
+
+  // Lay out the next paragraph, or the next piece of a long one, handing every page it completes to the callback.
+  // Returns false once the last page has been handed over.
+  bool step();
+
+  // Hyphenation language for the text, from the script of the given sample (Cyrillic or else English)
+  static const char* guessLanguage(const char* sample, size_t length);
+
+ private:
+  const GfxRenderer& renderer;
+  TxtReadWindow& window;
+  const size_t contentSize;
+  const int fontId;
+  const int lineHeight;
+  const bool extraParagraphSpacing;
+  const uint16_t viewportWidth;
+  const uint16_t viewportHeight;
+  const bool hyphenationEnabled;
+  const bool markdown;
+  BlockStyle blockStyle;
+
+  PageCallback onPage;
+  SectionBuildArenas arenas;
+  std::unique_ptr<ParsedText> paragraph;
+  std::unique_ptr<Page> currentPage;
+  int nextY = 0;
+  size_t sourceOffset = 0;         // Next byte to read
+  uint32_t paragraphOffset = 0;    // Start of the paragraph being laid out
+  uint32_t lineInParagraph = 0;    // Lines extracted from it so far
+  uint32_t paragraphTextBytes = 0; // Bytes of those lines, roughly
+  uint32_t linesToSkip = 0;        // Lines of the first paragraph that belong to pages before the start
+  bool attachNext = false;         // The last piece ended inside a word
+  bool finished = false;
+  // Markdown state of the current line
+  EpdFontFamily::Style lineStyle = EpdFontFamily::REGULAR;
+  bool markdownBold = false;
+  bool markdownItalic = false;
+
+  void addWords(const char* text, size_t length);
+  // Apply and strip the block markup at the start of a Markdown line (heading, quote, list item, rule)
+  void applyMarkdownLineStart(const char*& text, size_t& length);
+  void addMarkdownWord(const char* text, size_t length, bool attach);
+  void layout(bool includeLastLine);
+  void finishParagraph();
+  void addLine(ArenaPtr<TextBlock> line);
+  void completePage(const TxtPageStart& nextStart);
+};
@@ -0,0 +1,72 @@
+#include "TxtReadWindow.h"
+
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+bool TxtReadWindow::allocate(const std::string& path, const size_t capacity) {
+  release();
+
+  if (!Storage.openFileForRead("TXT", path, file)) {
+    return false;
+  }
+
+  buffer = BufferPool::lease(capacity + 1);
+  if (!buffer) {
+    LOG_ERR("TXT", "Failed to allocate %zu byte read window", capacity + 1);
+    file.close();
+    return false;
+  }
+
+  this->capacity = capacity;
+  windowStart = 0;
+  windowLength = 0;
+  return true;
+}
+
+void TxtReadWindow::release() {
+  buffer.release();
+  if (file) {
+    file.close();
+  }
+  capacity = 0;
+  windowLength = 0;
+}
+
+const char* TxtReadWindow::read(const size_t offset, const size_t length) {
+  if (!buffer || length == 0 || length > capacity) {
+    return nullptr;
+  }
+  uint8_t* bytes = buffer.data();
+
+  // The window always starts at the last requested offset, so a read further on keeps the bytes both share
+  size_t kept = 0;
+  if (offset >= windowStart && offset < windowStart + windowLength) {
+    kept = std::min(windowStart + windowLength - offset, length);
+    if (offset > windowStart) {
+      memmove(bytes, bytes + (offset - windowStart), kept);
+    }
+  }
+  windowStart = offset;
+  windowLength = kept;
+
+  if (kept < length) {
+    const size_t readFrom = offset + kept;
+    if (file.position() != readFrom && !file.seek(readFrom)) {
+      LOG_ERR("TXT", "Failed to seek to %zu", readFrom);
+      windowLength = 0;
+      return nullptr;
+    }
+    const int bytesRead = file.read(bytes + kept, length - kept);
+    if (bytesRead != static_cast<int>(length - kept)) {
+      LOG_ERR("TXT", "Short read at %zu: %d of %zu bytes", readFrom, bytesRead, length - kept);
+      windowLength = 0;
+      return nullptr;
+    }
+    windowLength = length;
+  }
+
+  bytes[length] = '\0';
+  return reinterpret_cast<const char*>(bytes);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <BufferPool.h>
+#include <HalStorage.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Keeps the text file open with a buffer over the most recently read range. Reading forward from inside that range
+// moves the overlap to the front of the buffer and only reads the rest from the SD card, so paginating page after
+// page reads each byte about once instead of once per page that overlaps it.
+// Not thread safe, every task reading the file needs its own window.
+class TxtReadWindow {
+ public:
+  TxtReadWindow() = default;
+  ~TxtReadWindow() { release(); }
+
+  TxtReadWindow(const TxtReadWindow&) = delete;
+  TxtReadWindow& operator=(const TxtReadWindow&) = delete;
+
+  // Open the file and allocate a buffer for reads of up to capacity bytes
+  bool allocate(const std::string& path, size_t capacity);
+
+  // Close the file and free the buffer
+  void release();
+  bool isAllocated() const { return static_cast<bool>(buffer); }
+
+  // Returns length bytes of the file from offset followed by a NUL, or nullptr if they could not be read.
+  // The data stays valid until the next read().
+  const char* read(size_t offset, size_t length);
+
+ private:
+  FsFile file;
+  BufferLease buffer;
+  size_t capacity = 0;
+  size_t windowStart = 0;
+  size_t windowLength = 0;
+};
@@ -1,5 +1,7 @@
 #include "Utf8.h"
 
+#include <cstring>
+
 int utf8CodepointLen(const unsigned char c) {
   if (c < 0x80) return 1;          // 0xxxxxxx
   if ((c >> 5) == 0x6) return 2;   // 110xxxxx
@@ -8,11 +10,7 @@ int utf8CodepointLen(const unsigned char c) {
   return 1;                        // fallback for invalid
 }
 
-uint32_t utf8NextCodepoint(const unsigned char** string) {
-  if (**string == 0) {
-    return 0;
-  }
-
+uint32_t utf8NextCodepointMultibyte(const unsigned char** string) {
   const int bytes = utf8CodepointLen(**string);
   const uint8_t* chr = *string;
   *string += bytes;
@@ -30,6 +28,49 @@ uint32_t utf8NextCodepoint(const unsigned char** string) {
   return cp;
 }
 
+size_t utf8DecodeSpan(const unsigned char** string, uint32_t* out, const size_t capacity, uint32_t* byteOffsets) {
+  const unsigned char* start = *string;
+  const unsigned char* p = start;
+  size_t count = 0;
+  while (count < capacity) {
+    // Four ASCII bytes, none of them the terminator: no byte has its top bit set and none is zero. Only aligned
+    // words are read, like strlen() does, so a read past the terminator stays in the word holding it.
+    if ((reinterpret_cast<uintptr_t>(p) & 3) == 0 && capacity - count >= 4) {
+      uint32_t word;
+      memcpy(&word, p, sizeof(word));
+      if (((word | ((word - 0x01010101u) & ~word)) & 0x80808080u) == 0) {
+        for (int i = 0; i < 4; i++) {
+          if (byteOffsets) {
+            byteOffsets[count] = static_cast<uint32_t>(p - start);
+          }
+          out[count++] = *p++;
+        }
+        continue;
+      }
+    }
+    if (*p == 0) {
+      break;
+    }
+    if (byteOffsets) {
+      byteOffsets[count] = static_cast<uint32_t>(p - start);
+    }
+    out[count++] = utf8NextCodepoint(&p);
+  }
+  *string = p;
+  return count;
+}
+
+Utf8Codepoints::Utf8Codepoints(const char* text) {
+  // A codepoint takes at least one byte
+  const size_t length = strlen(text);
+  if (length > INLINE_CAPACITY) {
+    heapBuffer.reset(new uint32_t[length]);
+    data = heapBuffer.get();
+  }
+  const auto* bytes = reinterpret_cast<const unsigned char*>(text);
+  count = utf8DecodeSpan(&bytes, data, length);
+}
+
 size_t utf8RemoveLastChar(std::string& str) {
   if (str.empty()) return 0;
   size_t pos = str.size() - 1;
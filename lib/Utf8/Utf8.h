@@ -1,10 +1,50 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #define REPLACEMENT_GLYPH 0xFFFD
 
-uint32_t utf8NextCodepoint(const unsigned char** string);
+// Multi-byte sequences, see utf8NextCodepoint()
+uint32_t utf8NextCodepointMultibyte(const unsigned char** string);
+
+// Decode the codepoint at *string and advance past it; 0 (without advancing) at the terminating NUL
+inline uint32_t utf8NextCodepoint(const unsigned char** string) {
+  const unsigned char c = **string;
+  if (c < 0x80) {
+    *string += c != 0;
+    return c;
+  }
+  return utf8NextCodepointMultibyte(string);
+}
+
+// Decode codepoints from *string into out until the terminating NUL or until capacity of them are written, and
+// advance *string past them. ASCII runs are taken four bytes at a time. byteOffsets, if given, receives where each
+// codepoint starts relative to *string on entry. Returns the number of codepoints written.
+size_t utf8DecodeSpan(const unsigned char** string, uint32_t* out, size_t capacity, uint32_t* byteOffsets = nullptr);
+
+// All codepoints of a NUL-terminated string, decoded in one utf8DecodeSpan() call so measuring and drawing loops walk
+// a plain array. A word fits the inline buffer; longer text gets one from the heap.
+class Utf8Codepoints {
+ public:
+  explicit Utf8Codepoints(const char* text);
+
+  Utf8Codepoints(const Utf8Codepoints&) = delete;
+  Utf8Codepoints& operator=(const Utf8Codepoints&) = delete;
+
+  const uint32_t* begin() const { return data; }
+  const uint32_t* end() const { return data + count; }
+  size_t size() const { return count; }
+
+ private:
+  static constexpr size_t INLINE_CAPACITY = 48;
+  uint32_t inlineBuffer[INLINE_CAPACITY];
+  std::unique_ptr<uint32_t[]> heapBuffer;
+  uint32_t* data = inlineBuffer;
+  size_t count = 0;
+};
+
 // Remove the last UTF-8 codepoint from a std::string and return the new size.
 size_t utf8RemoveLastChar(std::string& str);
 // Truncate string by removing N UTF-8 codepoints from the end.
@@ -7,6 +7,7 @@
 
 #include "Xtc.h"
 
+#include <BmpRowWriter.h>
 #include <HalStorage.h>
 #include <Logging.h>
 
@@ -112,66 +113,9 @@ const std::vector<xtc::ChapterInfo>& Xtc::getChapters() const {
 
 std::string Xtc::getCoverBmpPath() const { return cachePath + "/cover.bmp"; }
 
-bool Xtc::generateCoverBmp() const {
-  // Already generated
-  if (Storage.exists(getCoverBmpPath().c_str())) {
-    return true;
-  }
-
-  if (!loaded || !parser) {
-    LOG_ERR("XTC", "Cannot generate cover BMP, file not loaded");
-    return false;
-  }
-
-  if (parser->getPageCount() == 0) {
-    LOG_ERR("XTC", "No pages in XTC file");
-    return false;
-  }
-
-  // Setup cache directory
-  setupCacheDir();
-
-  // Get first page info for cover
-  xtc::PageInfo pageInfo;
-  if (!parser->getPageInfo(0, pageInfo)) {
-    LOG_DBG("XTC", "Failed to get first page info");
-    return false;
-  }
-
-  // Get bit depth
-  const uint8_t bitDepth = parser->getBitDepth();
-
-  // Allocate buffer for page data
-  // XTG (1-bit): Row-major, ((width+7)/8) * height bytes
-  // XTH (2-bit): Two bit planes, column-major, ((width * height + 7) / 8) * 2 bytes
-  size_t bitmapSize;
-  if (bitDepth == 2) {
-    bitmapSize = ((static_cast<size_t>(pageInfo.width) * pageInfo.height + 7) / 8) * 2;
-  } else {
-    bitmapSize = ((pageInfo.width + 7) / 8) * pageInfo.height;
-  }
-  uint8_t* pageBuffer = static_cast<uint8_t*>(malloc(bitmapSize));
-  if (!pageBuffer) {
-    LOG_ERR("XTC", "Failed to allocate page buffer (%lu bytes)", bitmapSize);
-    return false;
-  }
-
-  // Load first page (cover)
-  size_t bytesRead = const_cast<xtc::XtcParser*>(parser.get())->loadPage(0, pageBuffer, bitmapSize);
-  if (bytesRead == 0) {
-    LOG_ERR("XTC", "Failed to load cover page");
-    free(pageBuffer);
-    return false;
-  }
-
-  // Create BMP file
-  FsFile coverBmp;
-  if (!Storage.openFileForWrite("XTC", getCoverBmpPath(), coverBmp)) {
-    LOG_DBG("XTC", "Failed to create cover BMP file");
-    free(pageBuffer);
-    return false;
-  }
-
+namespace {
+// Writes the cover page as a 1-bit BMP at its own size: 1-bit pages as they are, 2-bit pages with every gray as black
+bool writeCoverBmp(FsFile& coverBmp, const uint8_t* page, const xtc::PageInfo& pageInfo, const uint8_t bitDepth) {
   // Write BMP header
   // BMP file header (14 bytes)
   const uint32_t rowSize = ((pageInfo.width + 31) / 32) * 4;  // Row size aligned to 4 bytes
@@ -230,15 +174,13 @@ bool Xtc::generateCoverBmp() const {
     // - First plane: Bit1, Second plane: Bit2
     // - Pixel value = (bit1 << 1) | bit2
     const size_t planeSize = (static_cast<size_t>(pageInfo.width) * pageInfo.height + 7) / 8;
-    const uint8_t* plane1 = pageBuffer;                 // Bit1 plane
-    const uint8_t* plane2 = pageBuffer + planeSize;     // Bit2 plane
+    const uint8_t* plane1 = page;                 // Bit1 plane
+    const uint8_t* plane2 = page + planeSize;     // Bit2 plane
     const size_t colBytes = (pageInfo.height + 7) / 8;  // Bytes per column
 
     // Allocate a row buffer for 1-bit output
     uint8_t* rowBuffer = static_cast<uint8_t*>(malloc(dstRowSize));
     if (!rowBuffer) {
-      free(pageBuffer);
-      coverBmp.close();
       return false;
     }
 
@@ -283,7 +225,7 @@ bool Xtc::generateCoverBmp() const {
 
     for (uint16_t y = 0; y < pageInfo.height; y++) {
       // Write source row
-      coverBmp.write(pageBuffer + y * srcRowSize, srcRowSize);
+      coverBmp.write(page + y * srcRowSize, srcRowSize);
 
       // Pad to 4-byte boundary
       uint8_t padding[4] = {0, 0, 0, 0};
@@ -294,24 +236,60 @@ bool Xtc::generateCoverBmp() const {
     }
   }
 
-  coverBmp.close();
-  free(pageBuffer);
-
-  LOG_DBG("XTC", "Generated cover BMP: %s", getCoverBmpPath().c_str());
   return true;
 }
 
+// One row of a cover page as 8-bit gray, for scaling
+void getPageGrayRow(const uint8_t* page, const xtc::PageInfo& pageInfo, const uint8_t bitDepth, const int y,
+                    uint8_t* gray) {
+  if (bitDepth == 2) {
+    // XTH 2-bit mode: two column-major bit planes, columns right to left, MSB = topmost pixel
+    const size_t planeSize = (static_cast<size_t>(pageInfo.width) * pageInfo.height + 7) / 8;
+    const size_t colBytes = (pageInfo.height + 7) / 8;
+    const uint8_t* plane1 = page + y / 8;
+    const uint8_t* plane2 = plane1 + planeSize;
+    const int bitInByte = 7 - (y % 8);
+    for (int x = 0; x < pageInfo.width; x++) {
+      const size_t byteOffset = (pageInfo.width - 1 - x) * colBytes;
+      const uint8_t pixelValue = ((plane1[byteOffset] >> bitInByte) & 1) << 1 | ((plane2[byteOffset] >> bitInByte) & 1);
+      // pixelValue: 0=white, 1=light gray, 2=dark gray, 3=black (XTC polarity)
+      gray[x] = (3 - pixelValue) * 85;
+    }
+    return;
+  }
+  // 1-bit mode, XTC polarity: 0=black, 1=white
+  const uint8_t* row = page + static_cast<size_t>(y) * ((pageInfo.width + 7) / 8);
+  for (int x = 0; x < pageInfo.width; x++) {
+    gray[x] = (row[x / 8] >> (7 - (x % 8))) & 1 ? 255 : 0;
+  }
+}
+}  // namespace
+
+bool Xtc::generateCoverBmp() const { return generateCoverBmps(true, {}); }
+
 std::string Xtc::getThumbBmpPath() const { return cachePath + "/thumb_[HEIGHT].bmp"; }
 std::string Xtc::getThumbBmpPath(int height) const { return cachePath + "/thumb_" + std::to_string(height) + ".bmp"; }
 
-bool Xtc::generateThumbBmp(int height) const {
-  // Already generated
-  if (Storage.exists(getThumbBmpPath(height).c_str())) {
+bool Xtc::generateThumbBmp(int height) const { return generateCoverBmps(false, {height}); }
+
+bool Xtc::generateCoverBmps(const bool cover, const std::vector<int>& thumbHeights) const {
+  // Only the files not generated yet are written
+  const bool writeCover = cover && !Storage.exists(getCoverBmpPath().c_str());
+  std::vector<int> heights;
+  for (const int height : thumbHeights) {
+    if (!Storage.exists(getThumbBmpPath(height).c_str())) {
+      heights.push_back(height);
+    }
+  }
+  if (!writeCover && heights.empty()) {
     return true;
   }
+  if (heights.size() > BmpOutputSet::MAX_OUTPUTS) {
+    heights.resize(BmpOutputSet::MAX_OUTPUTS);
+  }
 
   if (!loaded || !parser) {
-    LOG_ERR("XTC", "Cannot generate thumb BMP, file not loaded");
+    LOG_ERR("XTC", "Cannot generate cover BMP, file not loaded");
     return false;
   }
 
@@ -333,45 +311,9 @@ bool Xtc::generateThumbBmp(int height) const {
   // Get bit depth
   const uint8_t bitDepth = parser->getBitDepth();
 
-  // Calculate target dimensions for thumbnail (fit within 240x400 Continue Reading card)
-  int THUMB_TARGET_WIDTH = height * 0.6;
-  int THUMB_TARGET_HEIGHT = height;
-
-  // Calculate scale factor
-  float scaleX = static_cast<float>(THUMB_TARGET_WIDTH) / pageInfo.width;
-  float scaleY = static_cast<float>(THUMB_TARGET_HEIGHT) / pageInfo.height;
-  float scale = (scaleX > scaleY) ? scaleX : scaleY;  // for cropping
-
-  // Only scale down, never up
-  if (scale >= 1.0f) {
-    // Page is already small enough, just use cover.bmp
-    // Copy cover.bmp to thumb.bmp
-    if (generateCoverBmp()) {
-      FsFile src, dst;
-      if (Storage.openFileForRead("XTC", getCoverBmpPath(), src)) {
-        if (Storage.openFileForWrite("XTC", getThumbBmpPath(height), dst)) {
-          uint8_t buffer[512];
-          while (src.available()) {
-            size_t bytesRead = src.read(buffer, sizeof(buffer));
-            dst.write(buffer, bytesRead);
-          }
-          dst.close();
-        }
-        src.close();
-      }
-      LOG_DBG("XTC", "Copied cover to thumb (no scaling needed)");
-      return Storage.exists(getThumbBmpPath(height).c_str());
-    }
-    return false;
-  }
-
-  uint16_t thumbWidth = static_cast<uint16_t>(pageInfo.width * scale);
-  uint16_t thumbHeight = static_cast<uint16_t>(pageInfo.height * scale);
-
-  LOG_DBG("XTC", "Generating thumb BMP: %dx%d -> %dx%d (scale: %.3f)", pageInfo.width, pageInfo.height, thumbWidth,
-          thumbHeight, scale);
-
   // Allocate buffer for page data
+  // XTG (1-bit): Row-major, ((width+7)/8) * height bytes
+  // XTH (2-bit): Two bit planes, column-major, ((width * height + 7) / 8) * 2 bytes
   size_t bitmapSize;
   if (bitDepth == 2) {
     bitmapSize = ((static_cast<size_t>(pageInfo.width) * pageInfo.height + 7) / 8) * 2;
@@ -384,182 +326,73 @@ bool Xtc::generateThumbBmp(int height) const {
     return false;
   }
 
-  // Load first page (cover)
+  // Load first page (cover) once for every output
   size_t bytesRead = const_cast<xtc::XtcParser*>(parser.get())->loadPage(0, pageBuffer, bitmapSize);
   if (bytesRead == 0) {
-    LOG_ERR("XTC", "Failed to load cover page for thumb");
-    free(pageBuffer);
-    return false;
-  }
-
-  // Create thumbnail BMP file - use 1-bit format for fast home screen rendering (no gray passes)
-  FsFile thumbBmp;
-  if (!Storage.openFileForWrite("XTC", getThumbBmpPath(height), thumbBmp)) {
-    LOG_DBG("XTC", "Failed to create thumb BMP file");
+    LOG_ERR("XTC", "Failed to load cover page");
     free(pageBuffer);
     return false;
   }
 
-  // Write 1-bit BMP header for fast home screen rendering
-  const uint32_t rowSize = (thumbWidth + 31) / 32 * 4;  // 1 bit per pixel, aligned to 4 bytes
-  const uint32_t imageSize = rowSize * thumbHeight;
-  const uint32_t fileSize = 14 + 40 + 8 + imageSize;  // 8 bytes for 2-color palette
-
-  // File header
-  thumbBmp.write('B');
-  thumbBmp.write('M');
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&fileSize), 4);
-  uint32_t reserved = 0;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&reserved), 4);
-  uint32_t dataOffset = 14 + 40 + 8;  // 1-bit palette has 2 colors (8 bytes)
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&dataOffset), 4);
-
-  // DIB header
-  uint32_t dibHeaderSize = 40;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&dibHeaderSize), 4);
-  int32_t widthVal = thumbWidth;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&widthVal), 4);
-  int32_t heightVal = -static_cast<int32_t>(thumbHeight);  // Negative for top-down
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&heightVal), 4);
-  uint16_t planes = 1;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&planes), 2);
-  uint16_t bitsPerPixel = 1;  // 1-bit for black and white
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&bitsPerPixel), 2);
-  uint32_t compression = 0;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&compression), 4);
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&imageSize), 4);
-  int32_t ppmX = 2835;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&ppmX), 4);
-  int32_t ppmY = 2835;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&ppmY), 4);
-  uint32_t colorsUsed = 2;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&colorsUsed), 4);
-  uint32_t colorsImportant = 2;
-  thumbBmp.write(reinterpret_cast<const uint8_t*>(&colorsImportant), 4);
-
-  // Color palette (2 colors for 1-bit: black and white)
-  uint8_t palette[8] = {
-      0x00, 0x00, 0x00, 0x00,  // Color 0: Black
-      0xFF, 0xFF, 0xFF, 0x00   // Color 1: White
-  };
-  thumbBmp.write(palette, 8);
-
-  // Allocate row buffer for 1-bit output
-  uint8_t* rowBuffer = static_cast<uint8_t*>(malloc(rowSize));
-  if (!rowBuffer) {
-    free(pageBuffer);
-    thumbBmp.close();
-    return false;
+  bool success = true;
+  if (writeCover) {
+    FsFile coverBmp;
+    if (!Storage.openFileForWrite("XTC", getCoverBmpPath(), coverBmp)) {
+      LOG_DBG("XTC", "Failed to create cover BMP file");
+      success = false;
+    } else {
+      success = writeCoverBmp(coverBmp, pageBuffer, pageInfo, bitDepth);
+      coverBmp.close();
+      if (success) {
+        LOG_DBG("XTC", "Generated cover BMP: %s", getCoverBmpPath().c_str());
+      } else {
+        Storage.remove(getCoverBmpPath().c_str());
+      }
+    }
   }
 
-  // Fixed-point scale factor (16.16)
-  uint32_t scaleInv_fp = static_cast<uint32_t>(65536.0f / scale);
-
-  // Pre-calculate plane info for 2-bit mode
-  const size_t planeSize = (bitDepth == 2) ? ((static_cast<size_t>(pageInfo.width) * pageInfo.height + 7) / 8) : 0;
-  const uint8_t* plane1 = (bitDepth == 2) ? pageBuffer : nullptr;
-  const uint8_t* plane2 = (bitDepth == 2) ? pageBuffer + planeSize : nullptr;
-  const size_t colBytes = (bitDepth == 2) ? ((pageInfo.height + 7) / 8) : 0;
-  const size_t srcRowBytes = (bitDepth == 1) ? ((pageInfo.width + 7) / 8) : 0;
-
-  for (uint16_t dstY = 0; dstY < thumbHeight; dstY++) {
-    memset(rowBuffer, 0xFF, rowSize);  // Start with all white (bit 1)
-
-    // Calculate source Y range with bounds checking
-    uint32_t srcYStart = (static_cast<uint32_t>(dstY) * scaleInv_fp) >> 16;
-    uint32_t srcYEnd = (static_cast<uint32_t>(dstY + 1) * scaleInv_fp) >> 16;
-    if (srcYStart >= pageInfo.height) srcYStart = pageInfo.height - 1;
-    if (srcYEnd > pageInfo.height) srcYEnd = pageInfo.height;
-    if (srcYEnd <= srcYStart) srcYEnd = srcYStart + 1;
-    if (srcYEnd > pageInfo.height) srcYEnd = pageInfo.height;
-
-    for (uint16_t dstX = 0; dstX < thumbWidth; dstX++) {
-      // Calculate source X range with bounds checking
-      uint32_t srcXStart = (static_cast<uint32_t>(dstX) * scaleInv_fp) >> 16;
-      uint32_t srcXEnd = (static_cast<uint32_t>(dstX + 1) * scaleInv_fp) >> 16;
-      if (srcXStart >= pageInfo.width) srcXStart = pageInfo.width - 1;
-      if (srcXEnd > pageInfo.width) srcXEnd = pageInfo.width;
-      if (srcXEnd <= srcXStart) srcXEnd = srcXStart + 1;
-      if (srcXEnd > pageInfo.width) srcXEnd = pageInfo.width;
-
-      // Area averaging: sum grayscale values (0-255 range)
-      uint32_t graySum = 0;
-      uint32_t totalCount = 0;
-
-      for (uint32_t srcY = srcYStart; srcY < srcYEnd && srcY < pageInfo.height; srcY++) {
-        for (uint32_t srcX = srcXStart; srcX < srcXEnd && srcX < pageInfo.width; srcX++) {
-          uint8_t grayValue = 255;  // Default: white
-
-          if (bitDepth == 2) {
-            // XTH 2-bit mode: pixel value 0-3
-            // Bounds check for column index
-            if (srcX < pageInfo.width) {
-              const size_t colIndex = pageInfo.width - 1 - srcX;
-              const size_t byteInCol = srcY / 8;
-              const size_t bitInByte = 7 - (srcY % 8);
-              const size_t byteOffset = colIndex * colBytes + byteInCol;
-              // Bounds check for buffer access
-              if (byteOffset < planeSize) {
-                const uint8_t bit1 = (plane1[byteOffset] >> bitInByte) & 1;
-                const uint8_t bit2 = (plane2[byteOffset] >> bitInByte) & 1;
-                const uint8_t pixelValue = (bit1 << 1) | bit2;
-                // Convert 2-bit (0-3) to grayscale: 0=black, 3=white
-                // pixelValue: 0=white, 1=light gray, 2=dark gray, 3=black (XTC polarity)
-                grayValue = (3 - pixelValue) * 85;  // 0->255, 1->170, 2->85, 3->0
-              }
-            }
-          } else {
-            // 1-bit mode
-            const size_t byteIdx = srcY * srcRowBytes + srcX / 8;
-            const size_t bitIdx = 7 - (srcX % 8);
-            // Bounds check for buffer access
-            if (byteIdx < bitmapSize) {
-              const uint8_t pixelBit = (pageBuffer[byteIdx] >> bitIdx) & 1;
-              // XTC 1-bit polarity: 0=black, 1=white (same as BMP palette)
-              grayValue = pixelBit ? 255 : 0;
-            }
-          }
-
-          graySum += grayValue;
-          totalCount++;
-        }
+  // Thumbnails: 1-bit for fast home screen rendering (no gray passes), scaled from gray rows of the page
+  if (!heights.empty()) {
+    const int count = static_cast<int>(heights.size());
+    FsFile thumbFiles[BmpOutputSet::MAX_OUTPUTS];
+    BmpOutput outputs[BmpOutputSet::MAX_OUTPUTS];
+    bool thumbsOk = true;
+    for (int i = 0; i < count && thumbsOk; i++) {
+      outputs[i] = BmpOutput::thumbnail(thumbFiles[i], heights[i]);
+      // Only scale down, never up: a page already small enough keeps its size
+      if (outputs[i].targetWidth >= pageInfo.width && outputs[i].targetHeight >= pageInfo.height) {
+        outputs[i].targetWidth = 0;
+        outputs[i].targetHeight = 0;
       }
+      thumbsOk = Storage.openFileForWrite("XTC", getThumbBmpPath(heights[i]), thumbFiles[i]);
+    }
 
-      // Calculate average grayscale and quantize to 1-bit with noise dithering
-      uint8_t avgGray = (totalCount > 0) ? static_cast<uint8_t>(graySum / totalCount) : 255;
-
-      // Hash-based noise dithering for 1-bit output
-      uint32_t hash = static_cast<uint32_t>(dstX) * 374761393u + static_cast<uint32_t>(dstY) * 668265263u;
-      hash = (hash ^ (hash >> 13)) * 1274126177u;
-      const int threshold = static_cast<int>(hash >> 24);           // 0-255
-      const int adjustedThreshold = 128 + ((threshold - 128) / 2);  // Range: 64-192
-
-      // Quantize to 1-bit: 0=black, 1=white
-      uint8_t oneBit = (avgGray >= adjustedThreshold) ? 1 : 0;
-
-      // Pack 1-bit value into row buffer (MSB first, 8 pixels per byte)
-      const size_t byteIndex = dstX / 8;
-      const size_t bitOffset = 7 - (dstX % 8);
-      // Bounds check for row buffer access
-      if (byteIndex < rowSize) {
-        if (oneBit) {
-          rowBuffer[byteIndex] |= (1 << bitOffset);  // Set bit for white
-        } else {
-          rowBuffer[byteIndex] &= ~(1 << bitOffset);  // Clear bit for black
-        }
-      }
+    BmpOutputSet outputSet(outputs, count);
+    auto* grayRow = static_cast<uint8_t*>(malloc(pageInfo.width));
+    thumbsOk = thumbsOk && grayRow && outputSet.begin(pageInfo.width, pageInfo.height, false);
+    for (int y = 0; y < pageInfo.height && thumbsOk; y++) {
+      getPageGrayRow(pageBuffer, pageInfo, bitDepth, y, grayRow);
+      thumbsOk = outputSet.pushRow(y, grayRow);
     }
+    thumbsOk = thumbsOk && outputSet.finish();
+    free(grayRow);
 
-    // Write row (already padded to 4-byte boundary by rowSize)
-    thumbBmp.write(rowBuffer, rowSize);
+    for (int i = 0; i < count; i++) {
+      if (thumbFiles[i]) {
+        thumbFiles[i].close();
+        if (!thumbsOk) Storage.remove(getThumbBmpPath(heights[i]).c_str());
+      }
+    }
+    if (thumbsOk) {
+      LOG_DBG("XTC", "Generated %d thumb BMP(s) from %dx%d cover", count, pageInfo.width, pageInfo.height);
+    } else {
+      LOG_ERR("XTC", "Failed to generate thumb BMPs");
+    }
+    success = success && thumbsOk;
   }
 
-  free(rowBuffer);
-  thumbBmp.close();
   free(pageBuffer);
-
-  LOG_DBG("XTC", "Generated thumb BMP (%dx%d): %s", thumbWidth, thumbHeight, getThumbBmpPath(height).c_str());
-  return true;
+  return success;
 }
 
 uint32_t Xtc::getPageCount() const {
@@ -598,7 +431,7 @@ size_t Xtc::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSize) con
 }
 
 xtc::XtcError Xtc::loadPageStreaming(uint32_t pageIndex,
-                                     std::function<void(const uint8_t* data, size_t size, size_t offset)> callback,
+                                     FunctionRef<void(const uint8_t* data, size_t size, size_t offset)> callback,
                                      size_t chunkSize) const {
   if (!loaded || !parser) {
     return xtc::XtcError::FILE_NOT_FOUND;
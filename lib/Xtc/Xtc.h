@@ -67,6 +67,8 @@ class Xtc {
   std::string getThumbBmpPath() const;
   std::string getThumbBmpPath(int height) const;
   bool generateThumbBmp(int height) const;
+  // Writes the missing ones of the cover and the thumbnails of each height from a single load of the first page
+  bool generateCoverBmps(bool cover, const std::vector<int>& thumbHeights) const;
 
   // Page access
   uint32_t getPageCount() const;
@@ -87,12 +89,12 @@ class Xtc {
    * Load page with streaming callback
    * @param pageIndex Page index
    * @param callback Callback for each chunk
-   * @param chunkSize Chunk size
+   * @param chunkSize Chunk size, 0 for the SD card profile's read chunk
    * @return Error code
    */
   xtc::XtcError loadPageStreaming(uint32_t pageIndex,
-                                  std::function<void(const uint8_t* data, size_t size, size_t offset)> callback,
-                                  size_t chunkSize = 1024) const;
+                                  FunctionRef<void(const uint8_t* data, size_t size, size_t offset)> callback,
+                                  size_t chunkSize = 0) const;
 
   // Progress calculation
   uint8_t calculateProgress(uint32_t currentPage) const;
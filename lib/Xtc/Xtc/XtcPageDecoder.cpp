@@ -0,0 +1,159 @@
+/**
+ * XtcPageDecoder.cpp
+ *
+ * Compressed page data decoding
+ * XTC ebook support for CrossPoint Reader
+ */
+
+#include "XtcPageDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xtc {
+
+namespace {
+constexpr size_t LZ4_MIN_MATCH = 4;
+
+// LZ4 length: 15 in the token nibble continues with bytes until one is below 255
+bool readLz4Length(PageReader& in, size_t& length) {
+  if (length != 15) {
+    return true;
+  }
+  uint8_t extra;
+  do {
+    if (!in.readByte(extra)) {
+      return false;
+    }
+    length += extra;
+  } while (extra == 255);
+  return true;
+}
+}  // namespace
+
+PageReader::PageReader(FsFile& file, const size_t storedSize, uint8_t* buffer, const size_t bufferSize)
+    : file(file), buffer(buffer), bufferSize(bufferSize), remaining(storedSize) {}
+
+bool PageReader::refill() {
+  if (remaining == 0) {
+    return false;
+  }
+  const size_t toRead = std::min(bufferSize, remaining);
+  const size_t bytesRead = file.read(buffer, toRead);
+  if (bytesRead == 0) {
+    remaining = 0;
+    return false;
+  }
+  remaining -= bytesRead;
+  pos = 0;
+  filled = bytesRead;
+  return true;
+}
+
+bool PageReader::readByte(uint8_t& out) {
+  if (pos == filled && !refill()) {
+    return false;
+  }
+  out = buffer[pos++];
+  return true;
+}
+
+bool PageReader::read(uint8_t* dest, size_t len) {
+  while (len > 0) {
+    if (pos == filled && !refill()) {
+      return false;
+    }
+    const size_t count = std::min(len, filled - pos);
+    memcpy(dest, buffer + pos, count);
+    pos += count;
+    dest += count;
+    len -= count;
+  }
+  return true;
+}
+
+size_t RleDecoder::read(uint8_t* dest, const size_t len) {
+  size_t produced = 0;
+  while (produced < len) {
+    if (runLeft > 0) {
+      const size_t count = std::min(runLeft, len - produced);
+      memset(dest + produced, runValue, count);
+      runLeft -= count;
+      produced += count;
+      continue;
+    }
+    if (literalLeft > 0) {
+      const size_t count = std::min(literalLeft, len - produced);
+      if (!in.read(dest + produced, count)) {
+        break;
+      }
+      literalLeft -= count;
+      produced += count;
+      continue;
+    }
+
+    // 0-127: the next n+1 bytes literally, 129-255: the next byte 257-n times, 128: nothing
+    uint8_t control;
+    if (!in.readByte(control)) {
+      break;
+    }
+    if (control < 128) {
+      literalLeft = control + 1;
+    } else if (control > 128) {
+      if (!in.readByte(runValue)) {
+        break;
+      }
+      runLeft = 257 - control;
+    }
+  }
+  return produced;
+}
+
+bool decodeLz4Page(PageReader& in, uint8_t* dest, const size_t size) {
+  size_t produced = 0;
+  while (true) {
+    uint8_t token;
+    if (!in.readByte(token)) {
+      return false;
+    }
+
+    size_t literals = token >> 4;
+    if (!readLz4Length(in, literals) || literals > size - produced || !in.read(dest + produced, literals)) {
+      return false;
+    }
+    produced += literals;
+
+    // The last sequence has no match
+    if (in.atEnd()) {
+      return produced == size;
+    }
+
+    uint8_t offsetBytes[2];
+    if (!in.read(offsetBytes, sizeof(offsetBytes))) {
+      return false;
+    }
+    const size_t offset = offsetBytes[0] | (offsetBytes[1] << 8);
+    size_t matchLength = token & 0x0F;
+    if (offset == 0 || offset > produced || !readLz4Length(in, matchLength)) {
+      return false;
+    }
+    matchLength += LZ4_MIN_MATCH;
+    if (matchLength > size - produced) {
+      return false;
+    }
+
+    uint8_t* out = dest + produced;
+    const uint8_t* match = out - offset;
+    if (offset >= matchLength) {
+      memcpy(out, match, matchLength);
+    } else {
+      // Overlapping match repeats the last offset bytes (offset 1 is a run of one byte)
+      for (size_t i = 0; i < matchLength; i++) {
+        out[i] = match[i];
+      }
+    }
+    produced += matchLength;
+  }
+}
+
+}  // namespace xtc
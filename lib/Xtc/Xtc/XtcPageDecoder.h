@@ -0,0 +1,63 @@
+/**
+ * XtcPageDecoder.h
+ *
+ * Decoders for compressed XTG/XTH page data (see PageCompression)
+ * XTC ebook support for CrossPoint Reader
+ */
+
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xtc {
+
+/**
+ * Buffered reader over the stored bytes of one page, refilled from the file a chunk at a time.
+ * Never reads past the page, so a corrupt page fails instead of decoding its neighbour.
+ */
+class PageReader {
+ public:
+  PageReader(FsFile& file, size_t storedSize, uint8_t* buffer, size_t bufferSize);
+
+  bool readByte(uint8_t& out);
+  bool read(uint8_t* dest, size_t len);
+  bool atEnd() const { return pos == filled && remaining == 0; }
+
+ private:
+  bool refill();
+
+  FsFile& file;
+  uint8_t* buffer;
+  size_t bufferSize;
+  size_t remaining;  // Stored bytes not yet read from the file
+  size_t pos = 0;
+  size_t filled = 0;
+};
+
+/**
+ * PackBits run-length decoder. Resumable, so a page can be produced one chunk at a time.
+ */
+class RleDecoder {
+ public:
+  explicit RleDecoder(PageReader& in) : in(in) {}
+
+  // Decodes up to len bytes; fewer only at the end of the data or on corrupt data
+  size_t read(uint8_t* dest, size_t len);
+
+ private:
+  PageReader& in;
+  size_t runLeft = 0;
+  size_t literalLeft = 0;
+  uint8_t runValue = 0;
+};
+
+/**
+ * Decodes an LZ4 block into a whole page. Matches refer back up to 64 KB into the output, so unlike RLE this
+ * can't produce a page a chunk at a time. Returns false unless exactly size bytes were produced.
+ */
+bool decodeLz4Page(PageReader& in, uint8_t* dest, size_t size);
+
+}  // namespace xtc
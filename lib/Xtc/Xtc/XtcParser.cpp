@@ -13,6 +13,8 @@
 
 #include <cstring>
 
+#include "XtcPageDecoder.h"
+
 namespace xtc {
 
 XtcParser::XtcParser()
@@ -20,6 +22,7 @@ XtcParser::XtcParser()
       m_defaultWidth(DISPLAY_WIDTH),
       m_defaultHeight(DISPLAY_HEIGHT),
       m_bitDepth(1),
+      m_compressedPages(false),
       m_hasChapters(false),
       m_lastError(XtcError::OK) {
   memset(&m_header, 0, sizeof(m_header));
@@ -89,10 +92,11 @@ void XtcParser::close() {
     m_file.close();
     m_isOpen = false;
   }
-  m_pageTable.clear();
+  clearPageWindows();
   m_chapters.clear();
   m_title.clear();
   m_hasChapters = false;
+  m_compressedPages = false;
   memset(&m_header, 0, sizeof(m_header));
 }
 
@@ -111,6 +115,7 @@ XtcError XtcParser::readHeader() {
 
   // Determine bit depth from file magic
   m_bitDepth = (m_header.magic == XTCH_MAGIC) ? 2 : 1;
+  m_compressedPages = (m_header.flags & XTC_FLAG_COMPRESSED_PAGES) != 0;
 
   // Check version
   // Currently, version 1.0 is the only valid version, however some generators are swapping the bytes around, so we
@@ -127,9 +132,9 @@ XtcError XtcParser::readHeader() {
     return XtcError::CORRUPTED_HEADER;
   }
 
-  LOG_DBG("XTC", "Header: magic=0x%08X (%s), ver=%u.%u, pages=%u, bitDepth=%u", m_header.magic,
+  LOG_DBG("XTC", "Header: magic=0x%08X (%s), ver=%u.%u, pages=%u, bitDepth=%u, compressed=%d", m_header.magic,
           (m_header.magic == XTCH_MAGIC) ? "XTCH" : "XTC", m_header.versionMajor, m_header.versionMinor,
-          m_header.pageCount, m_bitDepth);
+          m_header.pageCount, m_bitDepth, m_compressedPages);
 
   return XtcError::OK;
 }
@@ -169,38 +174,70 @@ XtcError XtcParser::readPageTable() {
     return XtcError::CORRUPTED_HEADER;
   }
 
-  // Seek to page table
-  if (!m_file.seek(m_header.pageTableOffset)) {
-    LOG_DBG("XTC", "Failed to seek to page table at %llu", m_header.pageTableOffset);
+  // Only check that the table is there; entries are read when a page is used
+  const uint64_t tableEnd =
+      m_header.pageTableOffset + static_cast<uint64_t>(m_header.pageCount) * sizeof(PageTableEntry);
+  if (tableEnd > m_file.size()) {
+    LOG_DBG("XTC", "Page table at %llu (%u entries) runs past the end of the file", m_header.pageTableOffset,
+            m_header.pageCount);
+    return XtcError::CORRUPTED_HEADER;
+  }
+
+  clearPageWindows();
+
+  // Default dimensions come from the first page
+  const PageTableEntry* first = findPageEntry(0);
+  if (!first) {
     return XtcError::READ_ERROR;
   }
+  m_defaultWidth = first->width;
+  m_defaultHeight = first->height;
 
-  m_pageTable.resize(m_header.pageCount);
+  LOG_DBG("XTC", "Page table at %llu, %u entries", m_header.pageTableOffset, m_header.pageCount);
+  return XtcError::OK;
+}
 
-  // Read page table entries
-  for (uint16_t i = 0; i < m_header.pageCount; i++) {
-    PageTableEntry entry;
-    size_t bytesRead = m_file.read(reinterpret_cast<uint8_t*>(&entry), sizeof(PageTableEntry));
-    if (bytesRead != sizeof(PageTableEntry)) {
-      LOG_DBG("XTC", "Failed to read page table entry %u", i);
-      return XtcError::READ_ERROR;
-    }
+void XtcParser::clearPageWindows() {
+  for (auto& window : m_pageWindows) {
+    window.count = 0;
+  }
+  m_pageWindowClock = 0;
+}
 
-    m_pageTable[i].offset = static_cast<uint32_t>(entry.dataOffset);
-    m_pageTable[i].size = entry.dataSize;
-    m_pageTable[i].width = entry.width;
-    m_pageTable[i].height = entry.height;
-    m_pageTable[i].bitDepth = m_bitDepth;
+const PageTableEntry* XtcParser::findPageEntry(const uint32_t pageIndex) {
+  if (pageIndex >= m_header.pageCount) {
+    return nullptr;
+  }
 
-    // Update default dimensions from first page
-    if (i == 0) {
-      m_defaultWidth = entry.width;
-      m_defaultHeight = entry.height;
+  PageWindow* victim = &m_pageWindows[0];
+  for (auto& window : m_pageWindows) {
+    if (window.count > 0 && pageIndex >= window.firstPage && pageIndex < window.firstPage + window.count) {
+      window.lastUse = ++m_pageWindowClock;
+      return &window.entries[pageIndex - window.firstPage];
+    }
+    if (window.count == 0 || (victim->count > 0 && window.lastUse < victim->lastUse)) {
+      victim = &window;
     }
   }
 
-  LOG_DBG("XTC", "Read %u page table entries", m_header.pageCount);
-  return XtcError::OK;
+  // Fixed-stride records: the window holding the page starts at a multiple of its size
+  const uint32_t firstPage = pageIndex - pageIndex % PAGE_WINDOW_ENTRIES;
+  const uint32_t remaining = m_header.pageCount - firstPage;
+  const uint16_t count = remaining < PAGE_WINDOW_ENTRIES ? remaining : PAGE_WINDOW_ENTRIES;
+  const int bytes = count * static_cast<int>(sizeof(PageTableEntry));
+
+  victim->count = 0;
+  if (!m_file.seek(m_header.pageTableOffset + static_cast<uint64_t>(firstPage) * sizeof(PageTableEntry)) ||
+      m_file.read(reinterpret_cast<uint8_t*>(victim->entries), bytes) != bytes) {
+    LOG_DBG("XTC", "Failed to read page table entries %lu-%lu", firstPage, firstPage + count - 1);
+    m_lastError = XtcError::READ_ERROR;
+    return nullptr;
+  }
+
+  victim->firstPage = firstPage;
+  victim->count = count;
+  victim->lastUse = ++m_pageWindowClock;
+  return &victim->entries[pageIndex - firstPage];
 }
 
 XtcError XtcParser::readChapters() {
@@ -219,13 +256,8 @@ XtcError XtcParser::readChapters() {
     return XtcError::OK;
   }
 
-  uint64_t chapterOffset = 0;
-  if (!m_file.seek(0x30)) {
-    return XtcError::READ_ERROR;
-  }
-  if (m_file.read(reinterpret_cast<uint8_t*>(&chapterOffset), sizeof(chapterOffset)) != sizeof(chapterOffset)) {
-    return XtcError::READ_ERROR;
-  }
+  // 32 bits: the byte after it holds the header flags
+  const uint64_t chapterOffset = m_header.chapterOffset;
 
   if (chapterOffset == 0) {
     return XtcError::OK;
@@ -309,11 +341,17 @@ XtcError XtcParser::readChapters() {
   return XtcError::OK;
 }
 
-bool XtcParser::getPageInfo(uint32_t pageIndex, PageInfo& info) const {
-  if (pageIndex >= m_pageTable.size()) {
+bool XtcParser::getPageInfo(uint32_t pageIndex, PageInfo& info) {
+  const PageTableEntry* entry = findPageEntry(pageIndex);
+  if (!entry) {
     return false;
   }
-  info = m_pageTable[pageIndex];
+  info.offset = static_cast<uint32_t>(entry->dataOffset);
+  info.size = entry->dataSize;
+  info.width = entry->width;
+  info.height = entry->height;
+  info.bitDepth = m_bitDepth;
+  info.padding = 0;
   return true;
 }
 
@@ -328,7 +366,11 @@ size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSiz
     return 0;
   }
 
-  const PageInfo& page = m_pageTable[pageIndex];
+  PageInfo page;
+  if (!getPageInfo(pageIndex, page)) {
+    m_lastError = XtcError::READ_ERROR;
+    return 0;
+  }
 
   // Seek to page data
   if (!m_file.seek(page.offset)) {
@@ -373,6 +415,11 @@ size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSiz
     return 0;
   }
 
+  if (pageCompression(pageHeader) != PAGE_COMPRESSION_NONE) {
+    m_lastError = decodePage(pageHeader, buffer, bitmapSize);
+    return m_lastError == XtcError::OK ? bitmapSize : 0;
+  }
+
   // Read bitmap data
   size_t bytesRead = m_file.read(buffer, bitmapSize);
   if (bytesRead != bitmapSize) {
@@ -386,7 +433,7 @@ size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSiz
 }
 
 XtcError XtcParser::loadPageStreaming(uint32_t pageIndex,
-                                      std::function<void(const uint8_t* data, size_t size, size_t offset)> callback,
+                                      FunctionRef<void(const uint8_t* data, size_t size, size_t offset)> callback,
                                       size_t chunkSize) {
   if (!m_isOpen) {
     return XtcError::FILE_NOT_FOUND;
@@ -396,7 +443,10 @@ XtcError XtcParser::loadPageStreaming(uint32_t pageIndex,
     return XtcError::PAGE_OUT_OF_RANGE;
   }
 
-  const PageInfo& page = m_pageTable[pageIndex];
+  PageInfo page;
+  if (!getPageInfo(pageIndex, page)) {
+    return XtcError::READ_ERROR;
+  }
 
   // Seek to page data
   if (!m_file.seek(page.offset)) {
@@ -422,9 +472,33 @@ XtcError XtcParser::loadPageStreaming(uint32_t pageIndex,
   }
 
   // Read in chunks
+  if (chunkSize == 0) {
+    chunkSize = Storage.profile().readChunk;
+  }
   std::vector<uint8_t> chunk(chunkSize);
   size_t totalRead = 0;
 
+  const uint8_t compression = pageCompression(pageHeader);
+  if (compression == PAGE_COMPRESSION_RLE) {
+    std::vector<uint8_t> input(Storage.profile().readChunk);
+    PageReader reader(m_file, pageHeader.dataSize, input.data(), input.size());
+    RleDecoder rle(reader);
+    while (totalRead < bitmapSize) {
+      const size_t toDecode = std::min(chunkSize, bitmapSize - totalRead);
+      if (rle.read(chunk.data(), toDecode) != toDecode) {
+        LOG_DBG("XTC", "Failed to decompress page %u", pageIndex);
+        return XtcError::DECOMPRESSION_ERROR;
+      }
+      callback(chunk.data(), toDecode, totalRead);
+      totalRead += toDecode;
+    }
+    return XtcError::OK;
+  }
+  if (compression != PAGE_COMPRESSION_NONE) {
+    LOG_DBG("XTC", "Page %u (compression %u) can't be streamed", pageIndex, compression);
+    return XtcError::DECOMPRESSION_ERROR;
+  }
+
   while (totalRead < bitmapSize) {
     size_t toRead = std::min(chunkSize, bitmapSize - totalRead);
     size_t bytesRead = m_file.read(chunk.data(), toRead);
@@ -440,6 +514,36 @@ XtcError XtcParser::loadPageStreaming(uint32_t pageIndex,
   return XtcError::OK;
 }
 
+uint8_t XtcParser::pageCompression(const XtgPageHeader& pageHeader) const {
+  return m_compressedPages ? pageHeader.compression : PAGE_COMPRESSION_NONE;
+}
+
+XtcError XtcParser::decodePage(const XtgPageHeader& pageHeader, uint8_t* buffer, const size_t bitmapSize) {
+  std::vector<uint8_t> input(Storage.profile().readChunk);
+  PageReader reader(m_file, pageHeader.dataSize, input.data(), input.size());
+
+  bool decoded = false;
+  switch (pageHeader.compression) {
+    case PAGE_COMPRESSION_RLE: {
+      RleDecoder rle(reader);
+      decoded = rle.read(buffer, bitmapSize) == bitmapSize;
+      break;
+    }
+    case PAGE_COMPRESSION_LZ4:
+      decoded = decodeLz4Page(reader, buffer, bitmapSize);
+      break;
+    default:
+      LOG_DBG("XTC", "Unsupported page compression: %u", pageHeader.compression);
+      return XtcError::DECOMPRESSION_ERROR;
+  }
+
+  if (!decoded) {
+    LOG_DBG("XTC", "Failed to decompress page (%lu bytes stored, %u expected)", pageHeader.dataSize, bitmapSize);
+    return XtcError::DECOMPRESSION_ERROR;
+  }
+  return XtcError::OK;
+}
+
 bool XtcParser::isValidXtcFile(const char* filepath) {
   FsFile file;
   if (!Storage.openFileForRead("XTC", filepath, file)) {
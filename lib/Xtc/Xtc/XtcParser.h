@@ -7,9 +7,9 @@
 
 #pragma once
 
+#include <FunctionRef.h>
 #include <HalStorage.h>
 
-#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -40,12 +40,13 @@ class XtcParser {
   uint16_t getWidth() const { return m_defaultWidth; }
   uint16_t getHeight() const { return m_defaultHeight; }
   uint8_t getBitDepth() const { return m_bitDepth; }  // 1 = XTC/XTG, 2 = XTCH/XTH
+  bool hasCompressedPages() const { return m_compressedPages; }  // XTCZ: see XTC_FLAG_COMPRESSED_PAGES
 
-  // Page information
-  bool getPageInfo(uint32_t pageIndex, PageInfo& info) const;
+  // Page information (reads the page table on demand)
+  bool getPageInfo(uint32_t pageIndex, PageInfo& info);
 
   /**
-   * Load page bitmap (raw 1-bit data, skipping XTG header)
+   * Load page bitmap (raw 1-bit data, skipping XTG header), decompressing XTCZ pages
    *
    * @param pageIndex Page index (0-based)
    * @param buffer Output buffer (caller allocated)
@@ -56,16 +57,17 @@ class XtcParser {
 
   /**
    * Streaming page load
-   * Memory-efficient method that reads page data in chunks.
+   * Memory-efficient method that reads page data in chunks. RLE pages are decoded chunk by chunk; LZ4 pages
+   * need the whole page as their history and fail with DECOMPRESSION_ERROR here, use loadPage for them.
    *
    * @param pageIndex Page index
    * @param callback Callback function to receive data chunks
-   * @param chunkSize Chunk size (default: 1024 bytes)
+   * @param chunkSize Chunk size (default: the SD card profile's read chunk)
    * @return Error code
    */
   XtcError loadPageStreaming(uint32_t pageIndex,
-                             std::function<void(const uint8_t* data, size_t size, size_t offset)> callback,
-                             size_t chunkSize = 1024);
+                             FunctionRef<void(const uint8_t* data, size_t size, size_t offset)> callback,
+                             size_t chunkSize = 0);
 
   // Get title/author from metadata
   std::string getTitle() const { return m_title; }
@@ -81,25 +83,43 @@ class XtcParser {
   XtcError getLastError() const { return m_lastError; }
 
  private:
+  // Page table entries are read on demand, a window of consecutive entries at a time, so that opening a book and
+  // the memory it keeps are the same for any page count. Two windows, the least recently used one refilled.
+  static constexpr uint16_t PAGE_WINDOW_ENTRIES = 32;
+  static constexpr int PAGE_WINDOW_COUNT = 2;
+
+  struct PageWindow {
+    uint32_t firstPage = 0;
+    uint16_t count = 0;  // 0 while empty
+    uint32_t lastUse = 0;
+    PageTableEntry entries[PAGE_WINDOW_ENTRIES];
+  };
+
   FsFile m_file;
   bool m_isOpen;
   XtcHeader m_header;
-  std::vector<PageInfo> m_pageTable;
+  PageWindow m_pageWindows[PAGE_WINDOW_COUNT];
+  uint32_t m_pageWindowClock = 0;
   std::vector<ChapterInfo> m_chapters;
   std::string m_title;
   std::string m_author;
   uint16_t m_defaultWidth;
   uint16_t m_defaultHeight;
   uint8_t m_bitDepth;  // 1 = XTC/XTG (1-bit), 2 = XTCH/XTH (2-bit)
+  bool m_compressedPages;
   bool m_hasChapters;
   XtcError m_lastError;
 
   // Internal helper functions
   XtcError readHeader();
   XtcError readPageTable();
+  const PageTableEntry* findPageEntry(uint32_t pageIndex);
+  void clearPageWindows();
   XtcError readTitle();
   XtcError readAuthor();
   XtcError readChapters();
+  uint8_t pageCompression(const XtgPageHeader& pageHeader) const;
+  XtcError decodePage(const XtgPageHeader& pageHeader, uint8_t* buffer, size_t bitmapSize);
 };
 
 }  // namespace xtc
@@ -27,6 +27,19 @@ constexpr uint32_t XTG_MAGIC = 0x00475458;  // "XTG\0" for 1-bit page data
 // "XTH\0" = 0x58, 0x54, 0x48, 0x00
 constexpr uint32_t XTH_MAGIC = 0x00485458;  // "XTH\0" for 2-bit page data
 
+// XtcHeader::flags
+// Pages may be compressed, as given by each page header's compression byte ("XTCZ"). Without this flag the
+// compression byte is ignored and pages are read raw, as generators never had to fill it in.
+constexpr uint8_t XTC_FLAG_COMPRESSED_PAGES = 0x01;
+
+// XtgPageHeader::compression of pages in a file flagged XTC_FLAG_COMPRESSED_PAGES. dataSize is then the stored
+// size; the bitmap keeps the size its width and height give.
+enum PageCompression : uint8_t {
+  PAGE_COMPRESSION_NONE = 0,
+  PAGE_COMPRESSION_RLE = 1,  // PackBits: n < 128 copies n+1 bytes, n > 128 repeats the next byte 257-n times
+  PAGE_COMPRESSION_LZ4 = 2,  // One LZ4 block (no frame)
+};
+
 // XTeink X4 display resolution
 constexpr uint16_t DISPLAY_WIDTH = 480;
 constexpr uint16_t DISPLAY_HEIGHT = 800;
@@ -48,7 +61,8 @@ struct XtcHeader {
   uint64_t dataOffset;       // 0x20: First page data offset
   uint64_t thumbOffset;      // 0x28: Thumbnail offset
   uint32_t chapterOffset;    // 0x30: Chapter data offset
-  uint32_t padding;          // 0x34: Padding to 56 bytes
+  uint8_t flags;             // 0x34: XTC_FLAG_* bits (0 if unused)
+  uint8_t padding[3];        // 0x35: Padding to 56 bytes
 };
 #pragma pack(pop)
 
@@ -70,8 +84,8 @@ struct XtgPageHeader {
   uint16_t width;       // 0x04: Image width (pixels)
   uint16_t height;      // 0x06: Image height (pixels)
   uint8_t colorMode;    // 0x08: Color mode (0=monochrome)
-  uint8_t compression;  // 0x09: Compression (0=uncompressed)
-  uint32_t dataSize;    // 0x0A: Image data size (bytes)
+  uint8_t compression;  // 0x09: Compression (PageCompression, 0=uncompressed)
+  uint32_t dataSize;    // 0x0A: Image data size (bytes, as stored)
   uint64_t md5;         // 0x0E: MD5 checksum (first 8 bytes, optional)
   // Followed by bitmap data at offset 0x16 (22)
   //
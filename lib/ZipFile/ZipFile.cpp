@@ -3,8 +3,13 @@
 #include <HalStorage.h>
 #include <InflateReader.h>
 #include <Logging.h>
+#include <Metrics.h>
+#include <Trace.h>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
 
 struct ZipInflateCtx {
   InflateReader reader;  // Must be first — callback casts uzlib_uncomp* to ZipInflateCtx*
@@ -17,6 +22,10 @@ struct ZipInflateCtx {
 namespace {
 constexpr uint16_t ZIP_METHOD_STORED = 0;
 constexpr uint16_t ZIP_METHOD_DEFLATED = 8;
+// Stored entries are copied in whole SD sectors: once the file position is sector aligned, SdFat reads straight
+// into the caller's buffer instead of going through its sector cache
+constexpr size_t SD_SECTOR_SIZE = 512;
+constexpr size_t STORED_COPY_CHUNK = 8 * SD_SECTOR_SIZE;
 
 int zipReadCallback(uzlib_uncomp* uncomp) {
   auto* ctx = reinterpret_cast<ZipInflateCtx*>(uncomp);
@@ -90,7 +99,146 @@ bool ZipFile::loadAllFileStatSlims() {
   return true;
 }
 
+bool ZipFile::openIndex() {
+  if (indexChecked) {
+    return indexFile.isOpen();
+  }
+  indexChecked = true;
+
+  // Opened read/write so resolved data offsets can be patched into the records
+  if (Storage.exists(indexPath.c_str()) && (indexFile = Storage.open(indexPath.c_str(), O_RDWR))) {
+    IndexHeader header = {};
+    if (indexFile.read(&header, sizeof(header)) == sizeof(header) && header.version == INDEX_VERSION &&
+        header.zipSize == file.size() && header.centralDirOffset == zipDetails.centralDirOffset &&
+        header.totalEntries == zipDetails.totalEntries &&
+        indexFile.size() == sizeof(header) + sizeof(IndexRecord) * header.recordCount) {
+      indexRecordCount = header.recordCount;
+      return true;
+    }
+    LOG_DBG("ZIP", "Stale central directory index, rebuilding");
+    indexFile.close();
+  }
+
+  // Leave it to the linear scan while the cache directory doesn't exist yet (e.g. before a book is first indexed)
+  const size_t lastSlash = indexPath.find_last_of('/');
+  if (lastSlash != std::string::npos && lastSlash > 0 && !Storage.exists(indexPath.substr(0, lastSlash).c_str())) {
+    return false;
+  }
+
+  if (!buildIndex()) {
+    return false;
+  }
+  indexFile = Storage.open(indexPath.c_str(), O_RDWR);
+  return indexFile.isOpen();
+}
+
+bool ZipFile::buildIndex() {
+  const uint32_t start = millis();
+  auto* records = static_cast<IndexRecord*>(malloc(sizeof(IndexRecord) * zipDetails.totalEntries));
+  if (!records) {
+    LOG_ERR("ZIP", "Not enough memory to index %u entries", zipDetails.totalEntries);
+    return false;
+  }
+
+  file.seek(zipDetails.centralDirOffset);
+  uint16_t count = 0;
+  uint32_t sig;
+  char itemName[256];
+  while (count < zipDetails.totalEntries && file.available()) {
+    file.read(&sig, 4);
+    if (sig != 0x02014b50) break;  // End of list
+
+    IndexRecord record = {};
+    file.seekCur(6);
+    file.read(&record.method, 2);
+    file.seekCur(8);
+    file.read(&record.compressedSize, 4);
+    file.read(&record.uncompressedSize, 4);
+    uint16_t nameLen, m, k;
+    file.read(&nameLen, 2);
+    file.read(&m, 2);
+    file.read(&k, 2);
+    file.seekCur(8);
+    file.read(&record.localHeaderOffset, 4);
+    if (nameLen < 256) {
+      file.read(itemName, nameLen);
+      record.hash = fnvHash64(itemName, nameLen);
+      record.nameLen = nameLen;
+      records[count++] = record;
+    } else {
+      // Name too long, the linear scan can't match it either
+      file.seekCur(nameLen);
+    }
+    file.seekCur(m + k);
+  }
+
+  std::sort(records, records + count, [](const IndexRecord& a, const IndexRecord& b) {
+    return a.hash < b.hash || (a.hash == b.hash && a.nameLen < b.nameLen);
+  });
+
+  // Built next to the index and renamed into place: a ZipFile of the same book on another task may be reading the
+  // current one, and must never see it truncated or half written
+  const std::string tmpPath = indexPath + ".tmp";
+  FsFile out;
+  if (!Storage.openFileForWrite("ZIP", tmpPath, out)) {
+    free(records);
+    return false;
+  }
+  const IndexHeader header = {INDEX_VERSION, static_cast<uint32_t>(file.size()), zipDetails.centralDirOffset,
+                              zipDetails.totalEntries, count};
+  const size_t recordsBytes = sizeof(IndexRecord) * count;
+  bool written = out.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+                 out.write(reinterpret_cast<const uint8_t*>(records), recordsBytes) == recordsBytes;
+  written = out.close() && written;
+  free(records);
+
+  if (!written || (Storage.exists(indexPath.c_str()) && !Storage.remove(indexPath.c_str())) ||
+      !Storage.rename(tmpPath.c_str(), indexPath.c_str())) {
+    LOG_ERR("ZIP", "Failed to write central directory index");
+    Storage.remove(tmpPath.c_str());
+    return false;
+  }
+  indexRecordCount = count;
+  LOG_DBG("ZIP", "Indexed %u entries in %lu ms", count, millis() - start);
+  return true;
+}
+
+bool ZipFile::lookupIndex(const char* filename, FileStatSlim* fileStat) {
+  lastIndexSlot = -1;
+  const size_t nameLen = strlen(filename);
+  const uint64_t hash = fnvHash64(filename, nameLen);
+
+  uint16_t lo = 0;
+  uint16_t hi = indexRecordCount;
+  IndexRecord record = {};
+  while (lo < hi) {
+    const uint16_t mid = lo + (hi - lo) / 2;
+    if (!indexFile.seek(sizeof(IndexHeader) + sizeof(IndexRecord) * mid) ||
+        indexFile.read(&record, sizeof(record)) != sizeof(record)) {
+      LOG_ERR("ZIP", "Failed to read central directory index");
+      return false;
+    }
+    if (record.hash == hash && record.nameLen == nameLen) {
+      fileStat->method = record.method;
+      fileStat->compressedSize = record.compressedSize;
+      fileStat->uncompressedSize = record.uncompressedSize;
+      fileStat->localHeaderOffset = record.localHeaderOffset;
+      fileStat->dataOffset = record.dataOffset;
+      lastIndexSlot = mid;
+      lastIndexHeaderOffset = record.localHeaderOffset;
+      return true;
+    }
+    if (record.hash < hash || (record.hash == hash && record.nameLen < nameLen)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
 bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
+  metrics::add(metrics::ZIP_LOOKUPS);
   if (!fileStatSlimCache.empty()) {
     const auto it = fileStatSlimCache.find(filename);
     if (it != fileStatSlimCache.end()) {
@@ -112,6 +260,14 @@ bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
     return false;
   }
 
+  if (!indexPath.empty() && openIndex()) {
+    const bool found = lookupIndex(filename, fileStat);
+    if (!wasOpen) {
+      close();
+    }
+    return found;
+  }
+
   // Phase 1: Try scanning from cursor position first
   uint32_t startPos = lastCentralDirPosValid ? lastCentralDirPos : zipDetails.centralDirOffset;
   bool wrapped = false;
@@ -181,6 +337,10 @@ bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
 }
 
 long ZipFile::getDataOffset(const FileStatSlim& fileStat) {
+  if (fileStat.dataOffset != 0) {
+    return fileStat.dataOffset;
+  }
+
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
     return -1;
@@ -193,24 +353,32 @@ long ZipFile::getDataOffset(const FileStatSlim& fileStat) {
 
   file.seek(fileOffset);
   const size_t read = file.read(pLocalHeader, localHeaderSize);
-  if (!wasOpen) {
-    close();
-  }
 
+  long dataOffset = -1;
   if (read != localHeaderSize) {
     LOG_ERR("ZIP", "Something went wrong reading the local header");
-    return -1;
-  }
-
-  if (pLocalHeader[0] + (pLocalHeader[1] << 8) + (pLocalHeader[2] << 16) + (pLocalHeader[3] << 24) !=
-      0x04034b50 /* ZIP local file header signature */) {
+  } else if (pLocalHeader[0] + (pLocalHeader[1] << 8) + (pLocalHeader[2] << 16) + (pLocalHeader[3] << 24) !=
+             0x04034b50 /* ZIP local file header signature */) {
     LOG_ERR("ZIP", "Not a valid zip file header");
-    return -1;
+  } else {
+    const uint16_t filenameLength = pLocalHeader[26] + (pLocalHeader[27] << 8);
+    const uint16_t extraOffset = pLocalHeader[28] + (pLocalHeader[29] << 8);
+    dataOffset = fileOffset + localHeaderSize + filenameLength + extraOffset;
+
+    // Remember it in the index so the next read of this entry can seek straight to the data. Skipped if the file no
+    // longer has the size validated in openIndex(), as another task has rebuilt it meanwhile.
+    if (indexFile && lastIndexSlot >= 0 && lastIndexHeaderOffset == fileStat.localHeaderOffset &&
+        indexFile.size() == sizeof(IndexHeader) + sizeof(IndexRecord) * indexRecordCount &&
+        indexFile.seek(sizeof(IndexHeader) + sizeof(IndexRecord) * lastIndexSlot + offsetof(IndexRecord, dataOffset))) {
+      const auto resolved = static_cast<uint32_t>(dataOffset);
+      indexFile.write(reinterpret_cast<const uint8_t*>(&resolved), sizeof(resolved));
+    }
   }
 
-  const uint16_t filenameLength = pLocalHeader[26] + (pLocalHeader[27] << 8);
-  const uint16_t extraOffset = pLocalHeader[28] + (pLocalHeader[29] << 8);
-  return fileOffset + localHeaderSize + filenameLength + extraOffset;
+  if (!wasOpen) {
+    close();
+  }
+  return dataOffset;
 }
 
 bool ZipFile::loadZipDetails() {
@@ -292,6 +460,10 @@ bool ZipFile::close() {
   if (file) {
     file.close();
   }
+  if (indexFile) {
+    indexFile.close();
+  }
+  indexChecked = false;
   lastCentralDirPos = 0;
   lastCentralDirPosValid = false;
   return true;
@@ -324,6 +496,14 @@ int ZipFile::fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector
     return 0;
   }
 
+  if (!indexPath.empty() && openIndex()) {
+    const int matched = fillSizesFromIndex(targets, sizes);
+    if (!wasOpen) {
+      close();
+    }
+    return matched;
+  }
+
   file.seek(zipDetails.centralDirOffset);
 
   int matched = 0;
@@ -381,7 +561,42 @@ int ZipFile::fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector
   return matched;
 }
 
+int ZipFile::fillSizesFromIndex(const std::vector<SizeTarget>& targets, std::vector<uint32_t>& sizes) {
+  // Targets and index records are both sorted by (hash, len), so one merge pass over the index matches them all
+  constexpr uint16_t RECORDS_PER_READ = 16;
+  IndexRecord records[RECORDS_PER_READ];
+  const auto before = [](const uint64_t hashA, const uint16_t lenA, const uint64_t hashB, const uint16_t lenB) {
+    return hashA < hashB || (hashA == hashB && lenA < lenB);
+  };
+
+  int matched = 0;
+  auto target = targets.begin();
+  indexFile.seek(sizeof(IndexHeader));
+  for (uint16_t first = 0; first < indexRecordCount && target != targets.end(); first += RECORDS_PER_READ) {
+    const uint16_t count = std::min<uint16_t>(RECORDS_PER_READ, indexRecordCount - first);
+    if (indexFile.read(records, sizeof(IndexRecord) * count) != static_cast<int>(sizeof(IndexRecord) * count)) {
+      LOG_ERR("ZIP", "Failed to read central directory index");
+      break;
+    }
+    for (uint16_t i = 0; i < count && target != targets.end(); i++) {
+      const IndexRecord& record = records[i];
+      while (target != targets.end() && before(target->hash, target->len, record.hash, record.nameLen)) {
+        ++target;
+      }
+      while (target != targets.end() && target->hash == record.hash && target->len == record.nameLen) {
+        if (target->index < sizes.size()) {
+          sizes[target->index] = record.uncompressedSize;
+          matched++;
+        }
+        ++target;
+      }
+    }
+  }
+  return matched;
+}
+
 uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const bool trailingNullByte) {
+  TRACE("zip.inflate");
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
     return nullptr;
@@ -484,6 +699,7 @@ uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const boo
 }
 
 bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t chunkSize) {
+  TRACE("zip.inflate");
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
     return false;
@@ -491,11 +707,17 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
 
   FileStatSlim fileStat = {};
   if (!loadFileStatSlim(filename, &fileStat)) {
+    if (!wasOpen) {
+      close();
+    }
     return false;
   }
 
   const long fileOffset = getDataOffset(fileStat);
   if (fileOffset < 0) {
+    if (!wasOpen) {
+      close();
+    }
     return false;
   }
 
@@ -504,8 +726,9 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
   const auto inflatedDataSize = fileStat.uncompressedSize;
 
   if (fileStat.method == ZIP_METHOD_STORED) {
-    // no deflation, just read content
-    const auto buffer = static_cast<uint8_t*>(malloc(chunkSize));
+    // no deflation, copy the content in sector multiples (the caller's chunk size only matters for inflating)
+    const size_t copyChunk = std::min<size_t>(std::max(chunkSize, STORED_COPY_CHUNK), inflatedDataSize);
+    const auto buffer = static_cast<uint8_t*>(malloc(std::max<size_t>(copyChunk, 1)));
     if (!buffer) {
       LOG_ERR("ZIP", "Failed to allocate memory for buffer");
       if (!wasOpen) {
@@ -515,8 +738,10 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
     }
 
     size_t remaining = inflatedDataSize;
+    // Read up to the next sector boundary first so every following read is aligned
+    size_t toRead = std::min(remaining, SD_SECTOR_SIZE - static_cast<size_t>(fileOffset) % SD_SECTOR_SIZE);
     while (remaining > 0) {
-      const size_t dataRead = file.read(buffer, remaining < chunkSize ? remaining : chunkSize);
+      const size_t dataRead = file.read(buffer, toRead);
       if (dataRead == 0) {
         LOG_ERR("ZIP", "Could not read more bytes");
         free(buffer);
@@ -526,8 +751,16 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
         return false;
       }
 
-      out.write(buffer, dataRead);
+      if (out.write(buffer, dataRead) != dataRead) {
+        LOG_ERR("ZIP", "Failed to write all output bytes to stream");
+        free(buffer);
+        if (!wasOpen) {
+          close();
+        }
+        return false;
+      }
       remaining -= dataRead;
+      toRead = std::min(remaining, copyChunk);
     }
 
     if (!wasOpen) {
@@ -628,3 +861,139 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
   LOG_ERR("ZIP", "Unsupported compression method");
   return false;
 }
+
+size_t ZipFile::readFilePrefix(const char* filename, uint8_t* dest, const size_t maxLen) {
+  TRACE("zip.prefix");
+  const bool wasOpen = isOpen();
+  if (!wasOpen && !open()) {
+    return 0;
+  }
+
+  FileStatSlim fileStat = {};
+  const long fileOffset = loadFileStatSlim(filename, &fileStat) ? getDataOffset(fileStat) : -1;
+  if (fileOffset < 0) {
+    if (!wasOpen) {
+      close();
+    }
+    return 0;
+  }
+  file.seek(fileOffset);
+
+  const size_t wanted = std::min(maxLen, static_cast<size_t>(fileStat.uncompressedSize));
+  size_t produced = 0;
+  if (fileStat.method == ZIP_METHOD_STORED) {
+    const int dataRead = file.read(dest, wanted);
+    produced = dataRead > 0 ? static_cast<size_t>(dataRead) : 0;
+  } else if (fileStat.method == ZIP_METHOD_DEFLATED) {
+    // One-shot inflate into dest: back-references within the prefix resolve against dest itself, so no 32KB window
+    // is needed. Compressed input is pulled in small reads, as a few hundred bytes cover most headers.
+    constexpr size_t PREFIX_READ_SIZE = 256;
+    uint8_t readBuffer[PREFIX_READ_SIZE];
+    ZipInflateCtx ctx;
+    ctx.file = &file;
+    ctx.fileRemaining = fileStat.compressedSize;
+    ctx.readBuf = readBuffer;
+    ctx.readBufSize = PREFIX_READ_SIZE;
+    ctx.reader.init(false);
+    ctx.reader.setReadCallback(zipReadCallback);
+    if (ctx.reader.readAtMost(dest, wanted, &produced) == InflateStatus::Error) {
+      LOG_ERR("ZIP", "Failed to inflate prefix of %s", filename);
+      produced = 0;
+    }
+  } else {
+    LOG_ERR("ZIP", "Unsupported compression method");
+  }
+
+  if (!wasOpen) {
+    close();
+  }
+  return produced;
+}
+
+bool ZipEntryReader::open(const char* filename, const size_t readBufferSize) {
+  close();
+  if (!zip.open()) {
+    return false;
+  }
+
+  ZipFile::FileStatSlim fileStat = {};
+  if (!zip.loadFileStatSlim(filename, &fileStat)) {
+    zip.close();
+    return false;
+  }
+  if (fileStat.method != ZIP_METHOD_STORED && fileStat.method != ZIP_METHOD_DEFLATED) {
+    LOG_ERR("ZIP", "Unsupported compression method");
+    zip.close();
+    return false;
+  }
+
+  const long fileOffset = zip.getDataOffset(fileStat);
+  if (fileOffset < 0) {
+    zip.close();
+    return false;
+  }
+  zip.file.seek(fileOffset);
+
+  if (fileStat.method == ZIP_METHOD_DEFLATED) {
+    ctx = new (std::nothrow) ZipInflateCtx();
+    if (ctx) {
+      ctx->readBuf = static_cast<uint8_t*>(malloc(readBufferSize));
+    }
+    if (!ctx || !ctx->readBuf || !ctx->reader.init(true)) {
+      LOG_ERR("ZIP", "Failed to allocate inflate state for entry reader");
+      close();
+      return false;
+    }
+    ctx->file = &zip.file;
+    ctx->fileRemaining = fileStat.compressedSize;
+    ctx->readBufSize = readBufferSize;
+    ctx->reader.setReadCallback(zipReadCallback);
+  }
+
+  method = fileStat.method;
+  uncompressedSize = fileStat.uncompressedSize;
+  remaining = uncompressedSize;
+  opened = true;
+  return true;
+}
+
+void ZipEntryReader::close() {
+  if (ctx) {
+    free(ctx->readBuf);
+    delete ctx;  // reader destructor frees the ring buffer
+    ctx = nullptr;
+  }
+  zip.close();
+  opened = false;
+  remaining = 0;
+}
+
+int ZipEntryReader::read(uint8_t* dest, const size_t maxLen) {
+  if (!opened) {
+    return -1;
+  }
+  const size_t toProduce = std::min(maxLen, remaining);
+  if (toProduce == 0) {
+    return 0;
+  }
+
+  size_t produced = 0;
+  if (method == ZIP_METHOD_STORED) {
+    const int read = zip.file.read(dest, toProduce);
+    if (read <= 0) {
+      LOG_ERR("ZIP", "Could not read more bytes");
+      return -1;
+    }
+    produced = static_cast<size_t>(read);
+  } else {
+    // Never ask for more than the entry's remaining size, so Done only comes with the last bytes
+    const InflateStatus status = ctx->reader.readAtMost(dest, toProduce, &produced);
+    if (status == InflateStatus::Error || (status == InflateStatus::Done && produced != remaining)) {
+      LOG_ERR("ZIP", "Decompression failed (%zu bytes left)", remaining);
+      return -1;
+    }
+  }
+
+  remaining -= produced;
+  return static_cast<int>(produced);
+}
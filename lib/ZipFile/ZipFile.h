@@ -3,15 +3,21 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+struct ZipInflateCtx;
+
 class ZipFile {
+  friend class ZipEntryReader;
+
  public:
   struct FileStatSlim {
     uint16_t method;             // Compression method
     uint32_t compressedSize;     // Compressed size
     uint32_t uncompressedSize;   // Uncompressed size
     uint32_t localHeaderOffset;  // Offset of local file header
+    uint32_t dataOffset;         // Start of the entry data if already known from the index, else 0
   };
 
   struct ZipDetails {
@@ -38,8 +44,37 @@ class ZipFile {
   }
 
  private:
+  // On-disk central directory index (see setIndexPath): header followed by records sorted by (hash, nameLen)
+  struct IndexHeader {
+    uint32_t version;
+    uint32_t zipSize;  // Archive size and directory location, to notice a replaced file
+    uint32_t centralDirOffset;
+    uint16_t totalEntries;
+    uint16_t recordCount;
+  };
+
+  struct IndexRecord {
+    uint64_t hash;  // fnvHash64 of the entry name
+    uint16_t nameLen;
+    uint16_t method;
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+    uint32_t localHeaderOffset;
+    uint32_t dataOffset;  // Filled in the first time the local header is read, 0 until then
+    uint32_t reserved;
+  };
+  static_assert(sizeof(IndexRecord) == 32, "Index records are read and patched in place");
+
+  static constexpr uint32_t INDEX_VERSION = 2;
+
   const std::string& filePath;
+  std::string indexPath;
   FsFile file;
+  FsFile indexFile;
+  uint16_t indexRecordCount = 0;
+  int32_t lastIndexSlot = -1;  // Record of the last index hit, where a resolved data offset gets written back
+  uint32_t lastIndexHeaderOffset = 0;
+  bool indexChecked = false;
   ZipDetails zipDetails = {0, 0, false};
   std::unordered_map<std::string, FileStatSlim> fileStatSlimCache;
 
@@ -48,12 +83,23 @@ class ZipFile {
   bool lastCentralDirPosValid = false;
 
   bool loadFileStatSlim(const char* filename, FileStatSlim* fileStat);
+  bool openIndex();
+  bool buildIndex();
+  bool lookupIndex(const char* filename, FileStatSlim* fileStat);
+  int fillSizesFromIndex(const std::vector<SizeTarget>& targets, std::vector<uint32_t>& sizes);
   long getDataOffset(const FileStatSlim& fileStat);
   bool loadZipDetails();
 
  public:
-  explicit ZipFile(const std::string& filePath) : filePath(filePath) {}
+  explicit ZipFile(const std::string& filePath, std::string indexPath = "")
+      : filePath(filePath), indexPath(std::move(indexPath)) {}
   ~ZipFile() = default;
+  // With an index path, the first lookup writes a sorted index of the central directory to that file (if it is
+  // missing or stale), and all lookups binary-search it instead of scanning the directory.
+  void setIndexPath(std::string path) {
+    indexPath = std::move(path);
+    indexChecked = false;
+  }
   // Zip file can be opened and closed by hand in order to allow for quick calculation of inflated file size
   // It is NOT recommended to pre-open it for any kind of inflation due to memory constraints
   bool isOpen() const { return !!file; }
@@ -61,7 +107,8 @@ class ZipFile {
   bool close();
   bool loadAllFileStatSlims();
   bool getInflatedFileSize(const char* filename, size_t* size);
-  // Batch lookup: scan ZIP central dir once and fill sizes for matching targets.
+  // Batch lookup: scan ZIP central dir (or merge against the index, if there is one) once and fill sizes for
+  // matching targets.
   // targets must be sorted by (hash, len). sizes[target.index] receives uncompressedSize.
   // Returns number of targets matched.
   int fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector<uint32_t>& sizes);
@@ -69,4 +116,41 @@ class ZipFile {
   // These functions will open and close the zip as needed
   uint8_t* readFileToMemory(const char* filename, size_t* size = nullptr, bool trailingNullByte = false);
   bool readFileToStream(const char* filename, Print& out, size_t chunkSize);
+  // Inflate only the first maxLen bytes of an entry into dest, e.g. to read a file header without the rest of the
+  // entry. Needs no inflate window. Returns the number of bytes produced, 0 on error.
+  size_t readFilePrefix(const char* filename, uint8_t* dest, size_t maxLen);
+};
+
+// Pull-based reader for a single entry: the caller asks for inflated bytes as it needs them, so an entry can be fed
+// straight into a parser without going through a temporary file. Uses its own handle on the archive, which stays
+// open until close() or destruction.
+class ZipEntryReader {
+ public:
+  explicit ZipEntryReader(const std::string& zipPath, std::string indexPath = "")
+      : zip(zipPath, std::move(indexPath)) {}
+  ~ZipEntryReader() { close(); }
+
+  ZipEntryReader(const ZipEntryReader&) = delete;
+  ZipEntryReader& operator=(const ZipEntryReader&) = delete;
+
+  // Deflated entries need the 32KB inflate window plus a readBufferSize input buffer for as long as the reader is
+  // open. Returns false if the entry is missing, uses an unsupported method or the buffers can't be allocated.
+  bool open(const char* filename, size_t readBufferSize = 1024);
+  void close();
+
+  // Inflate up to maxLen bytes into dest. Returns the number of bytes produced (0 once the entry is exhausted) or
+  // -1 on a read/decompression error.
+  int read(uint8_t* dest, size_t maxLen);
+
+  bool isOpen() const { return opened; }
+  bool isDone() const { return remaining == 0; }
+  size_t size() const { return uncompressedSize; }
+
+ private:
+  ZipFile zip;
+  ZipInflateCtx* ctx = nullptr;  // Only for deflated entries
+  bool opened = false;
+  uint16_t method = 0;
+  size_t uncompressedSize = 0;
+  size_t remaining = 0;
 };
@@ -61,6 +61,8 @@
 #include "nametab.h"
 #include "xmltok.h"
 
+#include <HotPath.h>
+
 #ifdef XML_DTD
 #define IGNORE_SECTION_TOK_VTABLE , PREFIX(ignoreSectionTok)
 #else
@@ -268,6 +270,8 @@ static int PTRCALL sb_charMatches(const ENCODING* enc, const char* p, int c) {
 #endif
 
 #define PREFIX(ident) normal_##ident
+/* Only the UTF-8 tokenizer runs hot; the UTF-16 copies below stay in flash */
+#define PREFIX_HOT HOT_PATH
 #define XML_TOK_IMPL_C
 #include "xmltok_impl.c"
 #undef XML_TOK_IMPL_C
@@ -704,6 +708,8 @@ static int PTRFASTCALL little2_isNmstrtMin(const ENCODING* enc, const char* p) {
 
 #undef PREFIX
 #define PREFIX(ident) little2_##ident
+#undef PREFIX_HOT
+#define PREFIX_HOT
 #define MINBPC(enc) 2
 /* CHAR_MATCHES is guaranteed to have MINBPC bytes available. */
 #define BYTE_TYPE(enc, p) LITTLE2_BYTE_TYPE(enc, p)
@@ -906,6 +912,7 @@ static const struct normal_encoding internal_big2_encoding = {{VTABLE, 2, 0, 1},
 #endif
 
 #undef PREFIX
+#undef PREFIX_HOT
 
 static int FASTCALL streqci(const char* s1, const char* s2) {
   for (;;) {
@@ -406,7 +406,7 @@ static int PTRCALL PREFIX(cdataSectionTok)(const ENCODING* enc, const char* ptr,
 
 /* ptr points to character following "</" */
 
-static int PTRCALL PREFIX(scanEndTag)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
+static int PTRCALL PREFIX_HOT PREFIX(scanEndTag)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
   REQUIRE_CHAR(enc, ptr, end);
   switch (BYTE_TYPE(enc, ptr)) {
     CHECK_NMSTRT_CASES(enc, ptr, end, nextTokPtr)
@@ -539,7 +539,7 @@ static int PTRCALL PREFIX(scanRef)(const ENCODING* enc, const char* ptr, const c
 
 /* ptr points to character following first character of attribute name */
 
-static int PTRCALL PREFIX(scanAtts)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
+static int PTRCALL PREFIX_HOT PREFIX(scanAtts)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
 #ifdef XML_NS
   int hadColon = 0;
 #endif
@@ -686,7 +686,7 @@ static int PTRCALL PREFIX(scanAtts)(const ENCODING* enc, const char* ptr, const
 
 /* ptr points to character following "<" */
 
-static int PTRCALL PREFIX(scanLt)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
+static int PTRCALL PREFIX_HOT PREFIX(scanLt)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
 #ifdef XML_NS
   int hadColon;
 #endif
@@ -782,7 +782,7 @@ static int PTRCALL PREFIX(scanLt)(const ENCODING* enc, const char* ptr, const ch
   return XML_TOK_PARTIAL;
 }
 
-static int PTRCALL PREFIX(contentTok)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
+static int PTRCALL PREFIX_HOT PREFIX(contentTok)(const ENCODING* enc, const char* ptr, const char* end, const char** nextTokPtr) {
   if (ptr >= end) return XML_TOK_NONE;
   if (MINBPC(enc) > 1) {
     size_t n = end - ptr;
@@ -1432,7 +1432,7 @@ static int PTRCALL PREFIX(isPublicId)(const ENCODING* enc, const char* ptr, cons
    first attsMax attributes are stored in atts.
 */
 
-static int PTRCALL PREFIX(getAtts)(const ENCODING* enc, const char* ptr, int attsMax, ATTRIBUTE* atts) {
+static int PTRCALL PREFIX_HOT PREFIX(getAtts)(const ENCODING* enc, const char* ptr, int attsMax, ATTRIBUTE* atts) {
   enum { other, inName, inValue } state = inName;
   int nAtts = 0;
   int open = 0; /* defined when state == inValue;
@@ -1,8 +1,37 @@
+#include <FrameCapture.h>
 #include <HalDisplay.h>
 #include <HalGPIO.h>
+#include <Logging.h>
+#include <Metrics.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <atomic>
 
 #define SD_SPI_MISO 7
 
+namespace {
+struct RefreshRequest {
+  HalDisplay::RefreshToken token;
+  bool turnOffScreen;
+};
+
+constexpr uint32_t REFRESH_TASK_STACK_SIZE = 4096;
+// One queued refresh behind the running one; a third caller blocks until a slot frees up
+constexpr UBaseType_t REFRESH_QUEUE_LENGTH = 1;
+
+QueueHandle_t refreshQueue = nullptr;
+std::atomic<HalDisplay::RefreshToken> issuedRefreshes{0};
+std::atomic<HalDisplay::RefreshToken> completedRefreshes{0};
+
+// Hands a plane on its way to the panel to a running frame capture
+void captureFrame(const framecap::Plane plane, const uint8_t* buffer) {
+  framecap::capture(plane, buffer, HalDisplay::BUFFER_SIZE, HalDisplay::DISPLAY_WIDTH, HalDisplay::DISPLAY_HEIGHT);
+}
+}  // namespace
+
 HalDisplay::HalDisplay() : einkDisplay(EPD_SCLK, EPD_MOSI, EPD_CS, EPD_DC, EPD_RST, EPD_BUSY) {}
 
 HalDisplay::~HalDisplay() {}
@@ -34,25 +63,107 @@ EInkDisplay::RefreshMode convertRefreshMode(HalDisplay::RefreshMode mode) {
 }
 
 void HalDisplay::displayBuffer(HalDisplay::RefreshMode mode, bool turnOffScreen) {
+  waitForRefreshes();
+  captureFrame(framecap::PLANE_BW, getFrameBuffer());
+  const unsigned long start = millis();
   einkDisplay.displayBuffer(convertRefreshMode(mode), turnOffScreen);
+  metrics::observe(metrics::REFRESH_MS, millis() - start);
+}
+
+void HalDisplay::displayWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool turnOffScreen) {
+  if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT || w == 0 || h == 0) {
+    return;
+  }
+  // The controller addresses RAM in whole bytes along x
+  const uint16_t x0 = x & ~7;
+  const uint16_t x1 = std::min<uint16_t>(DISPLAY_WIDTH, (x + w + 7) & ~7);
+  const uint16_t y1 = std::min<uint16_t>(DISPLAY_HEIGHT, y + h);
+  waitForRefreshes();
+  captureFrame(framecap::PLANE_BW, getFrameBuffer());
+  einkDisplay.displayWindow(x0, y, x1 - x0, y1 - y, turnOffScreen);
 }
 
 void HalDisplay::refreshDisplay(HalDisplay::RefreshMode mode, bool turnOffScreen) {
+  waitForRefreshes();
   einkDisplay.refreshDisplay(convertRefreshMode(mode), turnOffScreen);
 }
 
-void HalDisplay::deepSleep() { einkDisplay.deepSleep(); }
+void HalDisplay::deepSleep() {
+  waitForRefreshes();
+  einkDisplay.deepSleep();
+}
 
 uint8_t* HalDisplay::getFrameBuffer() const { return einkDisplay.getFrameBuffer(); }
 
 void HalDisplay::copyGrayscaleBuffers(const uint8_t* lsbBuffer, const uint8_t* msbBuffer) {
+  waitForRefreshes();
+  captureFrame(framecap::PLANE_GRAY_LSB, lsbBuffer);
+  captureFrame(framecap::PLANE_GRAY_MSB, msbBuffer);
   einkDisplay.copyGrayscaleBuffers(lsbBuffer, msbBuffer);
 }
 
-void HalDisplay::copyGrayscaleLsbBuffers(const uint8_t* lsbBuffer) { einkDisplay.copyGrayscaleLsbBuffers(lsbBuffer); }
+void HalDisplay::copyGrayscaleLsbBuffers(const uint8_t* lsbBuffer) {
+  waitForRefreshes();
+  captureFrame(framecap::PLANE_GRAY_LSB, lsbBuffer);
+  einkDisplay.copyGrayscaleLsbBuffers(lsbBuffer);
+}
+
+void HalDisplay::copyGrayscaleMsbBuffers(const uint8_t* msbBuffer) {
+  waitForRefreshes();
+  captureFrame(framecap::PLANE_GRAY_MSB, msbBuffer);
+  einkDisplay.copyGrayscaleMsbBuffers(msbBuffer);
+}
+
+void HalDisplay::cleanupGrayscaleBuffers(const uint8_t* bwBuffer) {
+  waitForRefreshes();
+  einkDisplay.cleanupGrayscaleBuffers(bwBuffer);
+}
+
+void HalDisplay::displayGrayBuffer(bool turnOffScreen) {
+  waitForRefreshes();
+  const unsigned long start = millis();
+  einkDisplay.displayGrayBuffer(turnOffScreen);
+  metrics::observe(metrics::GRAY_REFRESH_MS, millis() - start);
+}
+
+HalDisplay::RefreshToken HalDisplay::displayGrayBufferAsync(const bool turnOffScreen) {
+  // The task lives as long as the display, it is only started once something refreshes asynchronously
+  if (!refreshQueue) {
+    refreshQueue = xQueueCreate(REFRESH_QUEUE_LENGTH, sizeof(RefreshRequest));
+    if (refreshQueue &&
+        xTaskCreate(&HalDisplay::refreshTask, "DisplayRefresh", REFRESH_TASK_STACK_SIZE, this, 1, nullptr) != pdPASS) {
+      vQueueDelete(refreshQueue);
+      refreshQueue = nullptr;
+    }
+    if (!refreshQueue) {
+      LOG_ERR("DSP", "Failed to start display refresh task, refreshing synchronously");
+      displayGrayBuffer(turnOffScreen);
+      return completedRefreshes;
+    }
+  }
 
-void HalDisplay::copyGrayscaleMsbBuffers(const uint8_t* msbBuffer) { einkDisplay.copyGrayscaleMsbBuffers(msbBuffer); }
+  const RefreshRequest request{++issuedRefreshes, turnOffScreen};
+  xQueueSend(refreshQueue, &request, portMAX_DELAY);
+  return request.token;
+}
 
-void HalDisplay::cleanupGrayscaleBuffers(const uint8_t* bwBuffer) { einkDisplay.cleanupGrayscaleBuffers(bwBuffer); }
+void HalDisplay::waitForRefresh(const RefreshToken token) {
+  while (static_cast<int32_t>(completedRefreshes - token) < 0) {
+    delay(1);
+  }
+}
 
-void HalDisplay::displayGrayBuffer(bool turnOffScreen) { einkDisplay.displayGrayBuffer(turnOffScreen); }
+void HalDisplay::waitForRefreshes() { waitForRefresh(issuedRefreshes); }
+
+void HalDisplay::refreshTask(void* param) {
+  auto* self = static_cast<HalDisplay*>(param);
+  RefreshRequest request;
+  while (true) {
+    if (xQueueReceive(refreshQueue, &request, portMAX_DELAY) == pdTRUE) {
+      const unsigned long start = millis();
+      self->einkDisplay.displayGrayBuffer(request.turnOffScreen);
+      metrics::observe(metrics::GRAY_REFRESH_MS, millis() - start);
+      completedRefreshes = request.token;
+    }
+  }
+}
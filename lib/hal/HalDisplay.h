@@ -34,6 +34,9 @@ class HalDisplay {
                             bool fromProgmem = false) const;
 
   void displayBuffer(RefreshMode mode = RefreshMode::FAST_REFRESH, bool turnOffScreen = false);
+  // Fast partial refresh of a rectangle in physical panel coordinates. The x range is widened to whole bytes
+  // and the rectangle is clipped to the panel.
+  void displayWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h, bool turnOffScreen = false);
   void refreshDisplay(RefreshMode mode = RefreshMode::FAST_REFRESH, bool turnOffScreen = false);
 
   // Power management
@@ -49,6 +52,17 @@ class HalDisplay {
 
   void displayGrayBuffer(bool turnOffScreen = false);
 
+  // Asynchronous gray refresh: the refresh and the wait for the panel run on a display task, and the call returns
+  // as soon as it is queued. The planes are already in controller RAM, so the frame buffer is free to draw into
+  // right away. Every other call that talks to the panel first waits for queued refreshes, so calls stay in order.
+  using RefreshToken = uint32_t;
+  RefreshToken displayGrayBufferAsync(bool turnOffScreen = false);
+  // Block until the refresh behind token is done
+  static void waitForRefresh(RefreshToken token);
+
  private:
   EInkDisplay einkDisplay;
+
+  static void refreshTask(void* param);
+  static void waitForRefreshes();
 };
@@ -7,19 +7,56 @@ void HalGPIO::begin() {
   pinMode(UART0_RXD, INPUT);
 }
 
-void HalGPIO::update() { inputMgr.update(); }
+void HalGPIO::update() {
+  inputMgr.update();
+  if (scripted) {
+    scriptedPrevious = scriptedState;
+    scriptedState = scriptedMask;
+    if (scriptedState & ~scriptedPrevious) {
+      scriptedPressMs = millis();
+    } else if (scriptedPrevious & ~scriptedState) {
+      scriptedReleaseMs = millis();
+    }
+  }
+}
 
-bool HalGPIO::isPressed(uint8_t buttonIndex) const { return inputMgr.isPressed(buttonIndex); }
+void HalGPIO::setScriptedState(const bool enabled, const uint8_t mask) {
+  if (enabled && !scripted) {
+    scriptedState = scriptedPrevious = 0;
+  }
+  scripted = enabled;
+  scriptedMask = mask;
+}
 
-bool HalGPIO::wasPressed(uint8_t buttonIndex) const { return inputMgr.wasPressed(buttonIndex); }
+bool HalGPIO::wasHardwarePressed() const { return inputMgr.wasAnyPressed(); }
 
-bool HalGPIO::wasAnyPressed() const { return inputMgr.wasAnyPressed(); }
+bool HalGPIO::isPressed(uint8_t buttonIndex) const {
+  return scripted ? (scriptedState >> buttonIndex) & 1 : inputMgr.isPressed(buttonIndex);
+}
 
-bool HalGPIO::wasReleased(uint8_t buttonIndex) const { return inputMgr.wasReleased(buttonIndex); }
+bool HalGPIO::wasPressed(uint8_t buttonIndex) const {
+  return scripted ? ((scriptedState & ~scriptedPrevious) >> buttonIndex) & 1 : inputMgr.wasPressed(buttonIndex);
+}
 
-bool HalGPIO::wasAnyReleased() const { return inputMgr.wasAnyReleased(); }
+bool HalGPIO::wasAnyPressed() const {
+  return scripted ? (scriptedState & ~scriptedPrevious) != 0 : inputMgr.wasAnyPressed();
+}
 
-unsigned long HalGPIO::getHeldTime() const { return inputMgr.getHeldTime(); }
+bool HalGPIO::wasReleased(uint8_t buttonIndex) const {
+  return scripted ? ((scriptedPrevious & ~scriptedState) >> buttonIndex) & 1 : inputMgr.wasReleased(buttonIndex);
+}
+
+bool HalGPIO::wasAnyReleased() const {
+  return scripted ? (scriptedPrevious & ~scriptedState) != 0 : inputMgr.wasAnyReleased();
+}
+
+unsigned long HalGPIO::getHeldTime() const {
+  if (scripted) {
+    // After a release, how long the button was held, as the real buttons report it
+    return (scriptedState ? millis() : scriptedReleaseMs) - scriptedPressMs;
+  }
+  return inputMgr.getHeldTime();
+}
 
 bool HalGPIO::isUsbConnected() const {
   // U0RXD/GPIO20 reads HIGH when USB is connected
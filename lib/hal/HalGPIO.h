@@ -38,6 +38,13 @@ class HalGPIO {
   bool wasAnyReleased() const;
   unsigned long getHeldTime() const;
 
+  // Scripted input, for replaying a recorded session (see MappedInputManager::startReplay). While on, the buttons
+  // read as the given mask (bit n = button index n) as of the next update() instead of the hardware.
+  void setScriptedState(bool enabled, uint8_t mask = 0);
+  bool isScripted() const { return scripted; }
+  // A real button was pressed at the last update(), also while the input is scripted
+  bool wasHardwarePressed() const;
+
   // Check if USB is connected
   bool isUsbConnected() const;
 
@@ -53,4 +60,12 @@ class HalGPIO {
   static constexpr uint8_t BTN_UP = 4;
   static constexpr uint8_t BTN_DOWN = 5;
   static constexpr uint8_t BTN_POWER = 6;
+
+ private:
+  bool scripted = false;
+  uint8_t scriptedMask = 0;  // Applied at the next update()
+  uint8_t scriptedState = 0;
+  uint8_t scriptedPrevious = 0;
+  unsigned long scriptedPressMs = 0;
+  unsigned long scriptedReleaseMs = 0;
 };
@@ -2,54 +2,73 @@
 
 #include <Logging.h>
 #include <WiFi.h>
+#include <driver/gpio.h>
 #include <esp_sleep.h>
 
-#include <cassert>
+#include <algorithm>
+#include <cstdlib>
 
 #include "HalGPIO.h"
 
 HalPowerManager powerManager;  // Singleton instance
 
-void HalPowerManager::begin() {
+namespace {
+const BatteryMonitor battery(BAT_GPIO0);
+// A new sample moves the battery filter a quarter of the way
+constexpr int32_t BATTERY_FILTER_DIVISOR = 4;
+// How far (in 1/16 percent) the filter has to leave the published percentage before it changes
+constexpr int32_t BATTERY_HYSTERESIS = 20;
+}  // namespace
+
+void HalPowerManager::begin(const HalGPIO& gpio) {
   pinMode(BAT_GPIO0, INPUT);
   normalFreq = getCpuFrequencyMhz();
-  modeMutex = xSemaphoreCreateMutex();
-  assert(modeMutex != nullptr);
+  currentFreq = normalFreq;
+  batteryOnUsb = gpio.isUsbConnected();
+  sampleBattery(true);
 }
 
-void HalPowerManager::setPowerSaving(bool enabled) {
+void HalPowerManager::setPowerSaving(const bool enabled) {
   if (normalFreq <= 0) {
     return;  // invalid state
   }
 
-  auto wifiMode = WiFi.getMode();
-  if (wifiMode != WIFI_MODE_NULL) {
-    // Wifi is active, force disabling power saving
-    enabled = false;
+  // Note: lockCount may change right after this read; a Lock taken meanwhile calls setPowerSaving(false) itself, and
+  // the main loop re-evaluates on its next pass
+  int targetFreq = normalFreq;
+  if (enabled && lockCount.load() == 0) {
+    targetFreq = WiFi.getMode() != WIFI_MODE_NULL ? std::min(WIFI_MIN_FREQ, normalFreq) : LOW_POWER_FREQ;
+  }
+  if (targetFreq == currentFreq) {
+    return;
   }
 
-  // Note: We don't use mutex here to avoid too much overhead,
-  // it's not very important if we read a slightly stale value for currentLockMode
-  const LockMode mode = currentLockMode;
-
-  if (mode == None && enabled && !isLowPower) {
-    LOG_DBG("PWR", "Going to low-power mode");
-    if (!setCpuFrequencyMhz(LOW_POWER_FREQ)) {
-      LOG_DBG("PWR", "Failed to set CPU frequency = %d MHz", LOW_POWER_FREQ);
-      return;
-    }
-    isLowPower = true;
+  LOG_DBG("PWR", "CPU frequency %d -> %d MHz", currentFreq, targetFreq);
+  if (!setCpuFrequencyMhz(targetFreq)) {
+    LOG_DBG("PWR", "Failed to set CPU frequency = %d MHz", targetFreq);
+    return;
+  }
+  currentFreq = targetFreq;
+}
 
-  } else if ((!enabled || mode != None) && isLowPower) {
-    LOG_DBG("PWR", "Restoring normal CPU frequency");
-    if (!setCpuFrequencyMhz(normalFreq)) {
-      LOG_DBG("PWR", "Failed to set CPU frequency = %d MHz", normalFreq);
-      return;
-    }
-    isLowPower = false;
+bool HalPowerManager::idleWait(HalGPIO& gpio, const unsigned long ms) {
+  if (lockCount.load() > 0 || WiFi.getMode() != WIFI_MODE_NULL || gpio.isUsbConnected()) {
+    delay(ms);
+    return false;
   }
 
-  // Otherwise, no change needed
+  const auto powerPin = static_cast<gpio_num_t>(InputManager::POWER_BUTTON_PIN);
+  esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(ms) * 1000);
+  gpio_wakeup_enable(powerPin, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  const esp_err_t err = esp_light_sleep_start();
+  gpio_wakeup_disable(powerPin);
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  if (err != ESP_OK) {
+    delay(ms);
+    return false;
+  }
+  return true;
 }
 
 void HalPowerManager::startDeepSleep(HalGPIO& gpio) const {
@@ -60,36 +79,77 @@ void HalPowerManager::startDeepSleep(HalGPIO& gpio) const {
   }
   // Arm the wakeup trigger *after* the button is released
   esp_deep_sleep_enable_gpio_wakeup(1ULL << InputManager::POWER_BUTTON_PIN, ESP_GPIO_WAKEUP_GPIO_LOW);
-  // Enter Deep Sleep
+  // Enter Deep Sleep, with the last log lines out first
+  logFlush();
   esp_deep_sleep_start();
 }
 
-uint16_t HalPowerManager::getBatteryPercentage() const {
-  static const BatteryMonitor battery = BatteryMonitor(BAT_GPIO0);
-  return battery.readPercentage();
-}
+void HalPowerManager::updateNetworkProfile() {
+  if (WiFi.getMode() == WIFI_MODE_NULL) {
+    networkProfile = NetworkProfile::Unset;  // Applied afresh once the radio is back
+    return;
+  }
 
-HalPowerManager::Lock::Lock() {
-  xSemaphoreTake(powerManager.modeMutex, portMAX_DELAY);
-  // Current limitation: only one lock at a time
-  if (powerManager.currentLockMode != None) {
-    LOG_ERR("PWR", "Lock already held, ignore");
-    valid = false;
+  // Note: like lockCount, transferCount may change right after this read; that transfer's own update follows
+  const NetworkProfile target = transferCount.load() > 0 ? NetworkProfile::Throughput : NetworkProfile::Idle;
+  if (target == networkProfile) {
+    return;
+  }
+
+  if (target == NetworkProfile::Throughput) {
+    WiFi.setSleep(WIFI_PS_NONE);
+    WiFi.setTxPower(WIFI_POWER_19_5dBm);
   } else {
-    powerManager.currentLockMode = NormalSpeed;
-    valid = true;
+    // The TX power stays: the radio sleeps nearly all the time, and a lower power could lose a weak link
+    WiFi.setSleep(WIFI_PS_MAX_MODEM);
   }
-  xSemaphoreGive(powerManager.modeMutex);
-  if (valid) {
-    // Immediately restore normal CPU frequency if currently in low-power mode
-    powerManager.setPowerSaving(false);
+  LOG_DBG("PWR", "Network profile: %s", target == NetworkProfile::Throughput ? "throughput" : "idle");
+  networkProfile = target;
+}
+
+void HalPowerManager::updateBattery(const HalGPIO& gpio) {
+  const bool onUsb = gpio.isUsbConnected();
+  if (onUsb != batteryOnUsb) {
+    batteryOnUsb = onUsb;
+    sampleBattery(true);
+  } else if (millis() - batterySampledAt >= BATTERY_SAMPLE_MS) {
+    sampleBattery(false);
   }
 }
 
-HalPowerManager::Lock::~Lock() {
-  xSemaphoreTake(powerManager.modeMutex, portMAX_DELAY);
-  if (valid) {
-    powerManager.currentLockMode = None;
+void HalPowerManager::sampleBattery(const bool reset) {
+  const int32_t sample = static_cast<int32_t>(battery.readPercentage()) * 16;
+  batterySampledAt = millis();
+  if (reset || batteryFiltered < 0) {
+    batteryFiltered = sample;
+  } else {
+    batteryFiltered += (sample - batteryFiltered) / BATTERY_FILTER_DIVISOR;
   }
-  xSemaphoreGive(powerManager.modeMutex);
+
+  const int32_t published = static_cast<int32_t>(batteryPercent) * 16;
+  if (reset || std::abs(batteryFiltered - published) > BATTERY_HYSTERESIS) {
+    const auto percent = static_cast<uint16_t>(std::min<int32_t>(100, (batteryFiltered + 8) / 16));
+    if (percent != batteryPercent) {
+      batteryPercent = percent;
+      batteryRevision++;
+    }
+  }
+}
+
+HalPowerManager::Lock::Lock() {
+  powerManager.lockCount++;
+  // Immediately restore normal CPU frequency if currently in low-power mode
+  powerManager.setPowerSaving(false);
+}
+
+HalPowerManager::Lock::~Lock() { powerManager.lockCount--; }
+
+HalPowerManager::NetworkTransfer::NetworkTransfer() {
+  powerManager.transferCount++;
+  powerManager.updateNetworkProfile();
+}
+
+HalPowerManager::NetworkTransfer::~NetworkTransfer() {
+  powerManager.transferCount--;
+  powerManager.updateNetworkProfile();
 }
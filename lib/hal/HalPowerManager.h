@@ -5,6 +5,7 @@
 #include <Logging.h>
 #include <freertos/semphr.h>
 
+#include <atomic>
 #include <cassert>
 
 #include "HalGPIO.h"
@@ -13,36 +14,66 @@ class HalPowerManager;
 extern HalPowerManager powerManager;  // Singleton
 
 class HalPowerManager {
-  int normalFreq = 0;  // MHz
-  bool isLowPower = false;
+  int normalFreq = 0;   // MHz
+  int currentFreq = 0;  // MHz
+  std::atomic<int> lockCount{0};
+  std::atomic<int> transferCount{0};
+  enum class NetworkProfile : uint8_t { Unset, Idle, Throughput };
+  NetworkProfile networkProfile = NetworkProfile::Unset;
+  // Battery reading, filtered in 1/16 percent steps; the published percentage only moves once the filter has left
+  // it by more than a point, so a reading on the edge doesn't flip the status bar back and forth
+  int32_t batteryFiltered = -1;
+  std::atomic<uint16_t> batteryPercent{0};
+  std::atomic<uint32_t> batteryRevision{0};
+  unsigned long batterySampledAt = 0;
+  bool batteryOnUsb = false;
 
-  enum LockMode { None, NormalSpeed };
-  LockMode currentLockMode = None;
-  SemaphoreHandle_t modeMutex = nullptr;  // Protect access to currentLockMode
+  void sampleBattery(bool reset);
 
  public:
-  static constexpr int LOW_POWER_FREQ = 10;                    // MHz
+  static constexpr int LOW_POWER_FREQ = 10;  // MHz
+  // WiFi needs the 80 MHz APB clock, so with the radio on this is as low as the CPU may go
+  static constexpr int WIFI_MIN_FREQ = 80;                     // MHz
   static constexpr unsigned long IDLE_POWER_SAVING_MS = 3000;  // ms
+  // The battery drains by well under a percent a minute, so it is sampled this rarely
+  static constexpr unsigned long BATTERY_SAMPLE_MS = 30000;  // ms
 
-  void begin();
+  void begin(const HalGPIO& gpio);
 
-  // Control CPU frequency for power saving
+  // Control CPU frequency for power saving. Enabled drops to the lowest frequency the radio allows unless a Lock is
+  // held; disabled (on user input) goes back to full speed.
   void setPowerSaving(bool enabled);
 
+  // Wait up to ms in light sleep instead of delay() when nothing needs the CPU: no Lock held (so no render or
+  // background work), WiFi off (the radio doesn't survive light sleep) and USB unplugged (USB serial would drop).
+  // The power button wakes it early; the other buttons are ADC-read and are polled after the timer wake, just as
+  // they are after a delay(). Falls back to delay() when sleeping isn't allowed. Returns true if it slept.
+  bool idleWait(HalGPIO& gpio, unsigned long ms);
+
   // Setup wake up GPIO and enter deep sleep
-  // Should be called inside main loop() to handle the currentLockMode
+  // Should be called inside main loop()
   void startDeepSleep(HalGPIO& gpio) const;
 
-  // Get battery percentage (range 0-100)
-  uint16_t getBatteryPercentage() const;
+  // Radio power profile while WiFi is on. Throughput (any NetworkTransfer held) turns modem sleep off and the TX
+  // power to full; Idle uses maximum modem sleep, so the radio wakes only every listen interval and a session
+  // waiting for a client costs little. Sessions call this once the connection is up; transfers then switch it.
+  // Nothing happens with WiFi off.
+  void updateNetworkProfile();
+
+  // Take a battery sample when one is due: every BATTERY_SAMPLE_MS, and straight away when USB is plugged in or out,
+  // which moves the voltage at once. Called from the main loop, so no ADC read happens while a screen is drawn.
+  void updateBattery(const HalGPIO& gpio);
+
+  // Battery percentage (range 0-100) as of the last sample
+  uint16_t getBatteryPercentage() const { return batteryPercent; }
+  // Bumped whenever getBatteryPercentage() changes; screens showing the battery compare it to redraw only then
+  uint32_t getBatteryRevision() const { return batteryRevision; }
 
   // RAII helper class to manage power saving locks
   // Usage: create an instance of Lock in a scope to disable power saving, for example when running a task that needs
-  // full performance. When the Lock instance is destroyed (goes out of scope), power saving will be re-enabled.
+  // full performance (rendering, indexing, decoding). When the Lock instance is destroyed (goes out of scope), power
+  // saving will be re-enabled once no other Lock is held. Any number of tasks may hold one at the same time.
   class Lock {
-    friend class HalPowerManager;
-    bool valid = false;
-
    public:
     explicit Lock();
     ~Lock();
@@ -53,4 +84,21 @@ class HalPowerManager {
     Lock(Lock&&) = delete;
     Lock& operator=(Lock&&) = delete;
   };
+
+  // RAII helper for a network transfer (upload, download, OTA): the radio runs the Throughput profile and the CPU
+  // full speed while any instance exists, and goes back to Idle when the last one is destroyed.
+  class NetworkTransfer {
+   public:
+    explicit NetworkTransfer();
+    ~NetworkTransfer();
+
+    // Non-copyable and non-movable
+    NetworkTransfer(const NetworkTransfer&) = delete;
+    NetworkTransfer& operator=(const NetworkTransfer&) = delete;
+    NetworkTransfer(NetworkTransfer&&) = delete;
+    NetworkTransfer& operator=(NetworkTransfer&&) = delete;
+
+   private:
+    Lock lock;
+  };
 };
@@ -3,37 +3,357 @@
 
 #include <FS.h>  // need to be included before SdFat.h for compatibility with FS.h's File class
 #include <Logging.h>
+#include <Metrics.h>
 #include <SDCardManager.h>
+#include <freertos/task.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
 #define SDCard SDCardManager::getInstance()
 
+namespace {
+// How long a lower class keeps off the card after a higher class used it, to cover the gaps between the reads of
+// one page render
+constexpr uint32_t GRACE_MS = 10;
+// Upper bound on deferring, so a reader busy for seconds can't starve background work completely
+constexpr uint32_t MAX_DEFER_MS = 200;
+
+thread_local HalStorage::IoClass currentIoClass = HalStorage::IoClass::Interactive;
+
+// Card self-test. The profile lives on the card it describes, so swapping cards swaps profiles.
+constexpr char PROFILE_FILE[] = "/.crosspoint/sd_profile.bin";
+constexpr char PROFILE_TEST_FILE[] = "/.crosspoint/.sd_profile_test";
+constexpr uint8_t PROFILE_FILE_VERSION = 1;
+constexpr uint16_t PROFILE_BLOCK_SIZES[] = {512, 1024, 2048, 4096, 8192};
+constexpr size_t PROFILE_BLOCK_COUNT = sizeof(PROFILE_BLOCK_SIZES) / sizeof(PROFILE_BLOCK_SIZES[0]);
+constexpr size_t PROFILE_MAX_BLOCK = 8192;
+constexpr size_t PROFILE_TEST_BYTES = 64 * 1024;  // Sequential bytes per block size
+constexpr int PROFILE_RANDOM_OPS = 16;
+// The smallest size within this share of the best throughput wins; larger chunks cost RAM at every call site
+constexpr uint32_t PROFILE_GOOD_ENOUGH_PERCENT = 90;
+
+struct BlockTiming {
+  uint32_t seqReadUs;
+  uint32_t seqWriteUs;
+  uint32_t randomReadUs;  // Per operation
+  uint32_t randomWriteUs;
+};
+
+// Index of the smallest block size whose time for the same amount of data is within PROFILE_GOOD_ENOUGH_PERCENT
+// of the fastest one
+size_t pickBlock(const BlockTiming* timings, uint32_t BlockTiming::*field) {
+  uint32_t best = UINT32_MAX;
+  for (size_t i = 0; i < PROFILE_BLOCK_COUNT; i++) {
+    best = std::min(best, timings[i].*field);
+  }
+  for (size_t i = 0; i < PROFILE_BLOCK_COUNT; i++) {
+    if (static_cast<uint64_t>(timings[i].*field) * PROFILE_GOOD_ENOUGH_PERCENT <= static_cast<uint64_t>(best) * 100) {
+      return i;
+    }
+  }
+  return PROFILE_BLOCK_COUNT - 1;
+}
+
+uint16_t kbPerSecond(const size_t bytes, const uint32_t us) {
+  return us == 0 ? 0 : static_cast<uint16_t>(std::min<uint64_t>(UINT16_MAX, bytes * 1000000ULL / 1024 / us));
+}
+
+uint16_t clampUs(const uint32_t us) { return static_cast<uint16_t>(std::min<uint32_t>(UINT16_MAX, us)); }
+
+// Longer paths are never cached
+constexpr size_t PATH_KEY_SIZE = 256;
+
+// The same path spelled with doubled or trailing slashes maps to one key. False if path doesn't fit.
+bool pathKey(const char* path, char* key) {
+  size_t length = 0;
+  for (const char* c = path; *c; c++) {
+    if (*c == '/' && length > 0 && key[length - 1] == '/') {
+      continue;
+    }
+    if (length == PATH_KEY_SIZE - 1) {
+      return false;
+    }
+    key[length++] = *c;
+  }
+  if (length > 1 && key[length - 1] == '/') {
+    length--;
+  }
+  key[length] = '\0';
+  return true;
+}
+
+uint32_t hashKey(const char* key) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (const char* c = key; *c; c++) {
+    hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+  }
+  return hash;
+}
+
+// True if one path is the other, or a directory containing it
+bool pathsOverlap(const std::string& a, const char* b, const size_t bLength) {
+  const size_t shorter = std::min(a.size(), bLength);
+  if (a.compare(0, shorter, b, shorter) != 0) {
+    return false;
+  }
+  if (a.size() == bLength) {
+    return true;
+  }
+  const char next = a.size() > bLength ? a[bLength] : b[a.size()];
+  return next == '/' || shorter == 1;  // shorter == 1: the root contains everything
+}
+
+// Handles of read-only files their callers have closed, by path key. Only touched with the storage lock held.
+constexpr size_t PARKED_FILE_COUNT = 4;
+
+struct ParkedFile {
+  std::string path;
+  FsFile file;
+  uint32_t lastUse = 0;
+};
+
+ParkedFile parkedFiles[PARKED_FILE_COUNT];
+uint32_t parkClock = 0;
+
+bool takeParkedFile(const char* key, FsFile& file) {
+  for (ParkedFile& parked : parkedFiles) {
+    if (!parked.path.empty() && parked.path == key) {
+      parked.path.clear();
+      file = std::move(parked.file);
+      parked.file.close();  // SdFat's FsFile copies on move; the parked copy mustn't stay open as well
+      if (file.seekSet(0)) {
+        return true;
+      }
+      file.close();
+      return false;
+    }
+  }
+  return false;
+}
+
+void parkFile(const std::string& key, FsFile&& file) {
+  ParkedFile* slot = &parkedFiles[0];
+  for (ParkedFile& parked : parkedFiles) {
+    if (parked.path == key) {
+      // Both handles of a file opened twice came back; one is enough
+      file.close();
+      return;
+    }
+    if (parked.path.empty() || parked.lastUse < slot->lastUse) {
+      slot = &parked;
+    }
+  }
+  if (!slot->path.empty()) {
+    slot->file.close();
+  }
+  slot->path = key;
+  slot->file = std::move(file);
+  file.close();
+  slot->lastUse = ++parkClock;
+}
+
+void closeParkedFiles(const char* key, const size_t keyLength) {
+  for (ParkedFile& parked : parkedFiles) {
+    if (!parked.path.empty() && (!key || pathsOverlap(parked.path, key, keyLength))) {
+      parked.path.clear();
+      parked.file.close();
+    }
+  }
+}
+
+bool isReadOnly(const oflag_t oflag) { return (oflag & O_ACCMODE) == O_RDONLY && !(oflag & (O_CREAT | O_TRUNC)); }
+}  // namespace
+
 HalStorage HalStorage::instance;
 
+HalStorage::IoClassScope::IoClassScope(const IoClass ioClass) : previous(currentIoClass) { currentIoClass = ioClass; }
+
+HalStorage::IoClassScope::~IoClassScope() { currentIoClass = previous; }
+
 HalStorage::HalStorage() {
   storageMutex = xSemaphoreCreateMutex();
   assert(storageMutex != nullptr);
+  pathCacheMutex = xSemaphoreCreateMutex();
+  assert(pathCacheMutex != nullptr);
 }
 
 // begin() and ready() are only called from setup, no need to acquire mutex for them
 
-bool HalStorage::begin() { return SDCard.begin(); }
+bool HalStorage::begin(const bool profileCard) {
+  forgetAllPaths();  // A different card may have been inserted
+  if (!SDCard.begin()) {
+    return false;
+  }
+  if (profileCard && !loadProfile()) {
+    measureProfile();
+  }
+  return true;
+}
 
 bool HalStorage::ready() const { return SDCard.ready(); }
 
 // For the rest of the methods, we acquire the mutex to ensure thread safety
 
+bool HalStorage::higherClassActive(const int level) const {
+  const uint32_t now = millis();
+  for (int i = 0; i < level; i++) {
+    if (waiting[i] > 0 || now - lastUseMs[i] < GRACE_MS) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void HalStorage::acquire() {
+  const int level = static_cast<int>(currentIoClass);
+  waiting[level]++;
+  if (level > 0) {
+    const uint32_t start = millis();
+    while (higherClassActive(level) && millis() - start < MAX_DEFER_MS) {
+      vTaskDelay(1);
+    }
+  }
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  waiting[level]--;
+  holderClass = level;
+}
+
+void HalStorage::release() {
+  lastUseMs[holderClass] = millis();
+  xSemaphoreGive(storageMutex);
+}
+
 class HalStorage::StorageLock {
  public:
-  StorageLock() { xSemaphoreTake(HalStorage::getInstance().storageMutex, portMAX_DELAY); }
-  ~StorageLock() { xSemaphoreGive(HalStorage::getInstance().storageMutex); }
+  StorageLock() { HalStorage::getInstance().acquire(); }
+  ~StorageLock() { HalStorage::getInstance().release(); }
 };
 
 #define HAL_STORAGE_WRAPPED_CALL(method, ...) \
   HalStorage::StorageLock lock;               \
   return SDCard.method(__VA_ARGS__);
 
+// For calls that create, remove or rename path
+#define HAL_STORAGE_MUTATING_CALL(path, method, ...) \
+  HalStorage::StorageLock lock;                      \
+  forgetPath(path);                                  \
+  return SDCard.method(__VA_ARGS__);
+
+// Only called from begin(), before any other task uses the card
+bool HalStorage::loadProfile() {
+  FsFile file = SDCard.open(PROFILE_FILE, O_RDONLY);
+  if (!file.isOpen()) {
+    return false;
+  }
+  uint8_t version = 0;
+  StorageProfile loaded;
+  const bool ok = file.read(&version, sizeof(version)) == sizeof(version) && version == PROFILE_FILE_VERSION &&
+                  file.read(&loaded, sizeof(loaded)) == sizeof(loaded) && loaded.readChunk > 0 &&
+                  loaded.readChunk <= PROFILE_MAX_BLOCK && loaded.writeChunk > 0 &&
+                  loaded.writeChunk <= PROFILE_MAX_BLOCK;
+  file.close();
+  if (!ok) {
+    LOG_DBG("HAL", "Ignoring stale SD profile");
+    return false;
+  }
+  storageProfile = loaded;
+  LOG_INF("HAL", "SD profile: read %u B chunks (%u KB/s), write %u B chunks (%u KB/s)", storageProfile.readChunk,
+          storageProfile.readKBps, storageProfile.writeChunk, storageProfile.writeKBps);
+  return true;
+}
+
+bool HalStorage::measureProfile() {
+  StorageLock lock;
+  auto* block = static_cast<uint8_t*>(malloc(PROFILE_MAX_BLOCK));
+  if (!block) {
+    LOG_ERR("HAL", "No memory for the SD self-test");
+    return false;
+  }
+  memset(block, 0xA5, PROFILE_MAX_BLOCK);
+  // The lock is held to the end, so dropping the directory's entries now also covers the files written below
+  forgetPath("/.crosspoint");
+  SDCard.mkdir("/.crosspoint", true);
+
+  BlockTiming timings[PROFILE_BLOCK_COUNT] = {};
+  bool ok = true;
+  uint32_t seed = 1;  // Same offsets on every run, so cards are compared like for like
+  for (size_t i = 0; i < PROFILE_BLOCK_COUNT && ok; i++) {
+    const size_t size = PROFILE_BLOCK_SIZES[i];
+    const size_t blocks = PROFILE_TEST_BYTES / size;
+    FsFile file = SDCard.open(PROFILE_TEST_FILE, O_RDWR | O_CREAT | O_TRUNC);
+    if (!file.isOpen()) {
+      ok = false;
+      break;
+    }
+
+    uint32_t start = micros();
+    for (size_t n = 0; n < blocks && ok; n++) {
+      ok = file.write(block, size) == size;
+    }
+    file.flush();
+    timings[i].seqWriteUs = micros() - start;
+
+    file.seekSet(0);
+    start = micros();
+    for (size_t n = 0; n < blocks && ok; n++) {
+      ok = file.read(block, size) == static_cast<int>(size);
+    }
+    timings[i].seqReadUs = micros() - start;
+
+    start = micros();
+    for (int op = 0; op < PROFILE_RANDOM_OPS && ok; op++) {
+      seed = seed * 1103515245 + 12345;
+      ok = file.seekSet((seed >> 8) % blocks * size) && file.read(block, size) == static_cast<int>(size);
+    }
+    timings[i].randomReadUs = (micros() - start) / PROFILE_RANDOM_OPS;
+
+    start = micros();
+    for (int op = 0; op < PROFILE_RANDOM_OPS && ok; op++) {
+      seed = seed * 1103515245 + 12345;
+      ok = file.seekSet((seed >> 8) % blocks * size) && file.write(block, size) == size;
+    }
+    file.flush();
+    timings[i].randomWriteUs = (micros() - start) / PROFILE_RANDOM_OPS;
+
+    file.close();
+    LOG_DBG("HAL", "SD %5u B: seq read %lu us, seq write %lu us, random read %lu us, random write %lu us",
+            static_cast<unsigned>(size), static_cast<unsigned long>(timings[i].seqReadUs),
+            static_cast<unsigned long>(timings[i].seqWriteUs), static_cast<unsigned long>(timings[i].randomReadUs),
+            static_cast<unsigned long>(timings[i].randomWriteUs));
+  }
+  SDCard.remove(PROFILE_TEST_FILE);
+  free(block);
+  if (!ok) {
+    LOG_ERR("HAL", "SD self-test failed, keeping the default I/O sizes");
+    return false;
+  }
+
+  const size_t read = pickBlock(timings, &BlockTiming::seqReadUs);
+  const size_t write = pickBlock(timings, &BlockTiming::seqWriteUs);
+  storageProfile.readChunk = PROFILE_BLOCK_SIZES[read];
+  storageProfile.writeChunk = PROFILE_BLOCK_SIZES[write];
+  storageProfile.readKBps = kbPerSecond(PROFILE_TEST_BYTES, timings[read].seqReadUs);
+  storageProfile.writeKBps = kbPerSecond(PROFILE_TEST_BYTES, timings[write].seqWriteUs);
+  storageProfile.randomReadUs = clampUs(timings[read].randomReadUs);
+  storageProfile.randomWriteUs = clampUs(timings[write].randomWriteUs);
+  LOG_INF("HAL", "SD profile: read %u B chunks (%u KB/s), write %u B chunks (%u KB/s)", storageProfile.readChunk,
+          storageProfile.readKBps, storageProfile.writeChunk, storageProfile.writeKBps);
+
+  FsFile file = SDCard.open(PROFILE_FILE, O_WRONLY | O_CREAT | O_TRUNC);
+  if (!file.isOpen()) {
+    LOG_ERR("HAL", "Could not save the SD profile");
+    return true;
+  }
+  file.write(&PROFILE_FILE_VERSION, sizeof(PROFILE_FILE_VERSION));
+  file.write(&storageProfile, sizeof(storageProfile));
+  file.close();
+  return true;
+}
+
 std::vector<String> HalStorage::listFiles(const char* path, int maxFiles) {
   HAL_STORAGE_WRAPPED_CALL(listFiles, path, maxFiles);
 }
@@ -41,7 +361,7 @@ std::vector<String> HalStorage::listFiles(const char* path, int maxFiles) {
 String HalStorage::readFile(const char* path) { HAL_STORAGE_WRAPPED_CALL(readFile, path); }
 
 bool HalStorage::readFileToStream(const char* path, Print& out, size_t chunkSize) {
-  HAL_STORAGE_WRAPPED_CALL(readFileToStream, path, out, chunkSize);
+  HAL_STORAGE_WRAPPED_CALL(readFileToStream, path, out, chunkSize > 0 ? chunkSize : storageProfile.readChunk);
 }
 
 size_t HalStorage::readFileToBuffer(const char* path, char* buffer, size_t bufferSize, size_t maxBytes) {
@@ -49,17 +369,255 @@ size_t HalStorage::readFileToBuffer(const char* path, char* buffer, size_t buffe
 }
 
 bool HalStorage::writeFile(const char* path, const String& content) {
-  HAL_STORAGE_WRAPPED_CALL(writeFile, path, content);
+  HAL_STORAGE_MUTATING_CALL(path, writeFile, path, content);
 }
 
-bool HalStorage::ensureDirectoryExists(const char* path) { HAL_STORAGE_WRAPPED_CALL(ensureDirectoryExists, path); }
+bool HalStorage::ensureDirectoryExists(const char* path) {
+  HAL_STORAGE_MUTATING_CALL(path, ensureDirectoryExists, path);
+}
 
 class HalFile::Impl {
  public:
   Impl(FsFile&& fsFile) : file(std::move(fsFile)) {}
+  ~Impl() {
+    if (writeLength > 0 || openedParkable) {
+      HalStorage::StorageLock lock;
+      flushWrites();
+      park();
+    }
+    free(buffer);
+  }
+
   FsFile file;
+
+  // Read-only files are parked for reuse when they are closed (see HalStorage::open). While open they sit in a list,
+  // so that a change to their path can take the parking back: the handle would still describe the old file. The
+  // list and parkKey are guarded by the storage lock.
+  static Impl* parkable;
+  Impl* nextParkable = nullptr;
+  std::string parkKey;          // Empty once the handle must not be parked
+  bool openedParkable = false;  // Only touched by the owner, so the destructor can check it before locking
+
+  void makeParkable(const char* key) {
+    parkKey = key;
+    openedParkable = true;
+    nextParkable = parkable;
+    parkable = this;
+  }
+
+  // Leave the list, parking the handle if that is still allowed. Returns whether it was parked.
+  bool park() {
+    if (!openedParkable) {
+      return false;
+    }
+    openedParkable = false;
+    for (Impl** link = &parkable; *link; link = &(*link)->nextParkable) {
+      if (*link == this) {
+        *link = nextParkable;
+        break;
+      }
+    }
+    const bool parked = !parkKey.empty() && file.isOpen();
+    if (parked) {
+      parkFile(parkKey, std::move(file));
+    }
+    parkKey.clear();
+    return parked;
+  }
+
+  // Open files at or below key (all with nullptr) will be closed for real
+  static void forgetParkable(const char* key, const size_t keyLength) {
+    for (Impl* impl = parkable; impl; impl = impl->nextParkable) {
+      if (!key || pathsOverlap(impl->parkKey, key, keyLength)) {
+        impl->parkKey.clear();
+      }
+    }
+  }
+
+  // Optional buffer (setBufferSize). It holds either read-ahead data or pending writes, never both. The methods
+  // below must be called with the storage lock held.
+  uint8_t* buffer = nullptr;
+  size_t bufferSize = 0;
+  size_t readPos = 0;      // Next unread byte of the read-ahead window
+  size_t readLength = 0;   // Valid bytes in the read-ahead window
+  size_t writeLength = 0;  // Bytes waiting to be written
+
+  // Byte range set by restrictTo(), in offsets of the underlying file; windowEnd is 0 when there is none
+  size_t windowStart = 0;
+  size_t windowEnd = 0;
+
+  // Card calls, counted for /api/metrics
+  int cardRead(void* buf, const size_t count) {
+    const int n = file.read(buf, count);
+    metrics::add(metrics::SD_READ_OPS);
+    if (n > 0) {
+      metrics::add(metrics::SD_READ_BYTES, n);
+    }
+    return n;
+  }
+
+  size_t cardWrite(const void* buf, const size_t count) {
+    const size_t n = file.write(buf, count);
+    metrics::add(metrics::SD_WRITE_OPS);
+    metrics::add(metrics::SD_WRITE_BYTES, n);
+    return n;
+  }
+
+  bool flushWrites() {
+    if (writeLength == 0) {
+      return true;
+    }
+    const size_t written = cardWrite(buffer, writeLength);
+    const bool ok = written == writeLength;
+    if (!ok) {
+      LOG_ERR("HAL", "Buffered write failed: expected %u, wrote %u", static_cast<unsigned>(writeLength),
+              static_cast<unsigned>(written));
+    }
+    writeLength = 0;
+    return ok;
+  }
+
+  // Move the underlying file position back to the logical one and forget the read-ahead window
+  void dropReadAhead() {
+    if (readPos < readLength) {
+      file.seekCur(-static_cast<int64_t>(readLength - readPos));
+    }
+    readPos = readLength = 0;
+  }
+
+  size_t logicalPosition() { return file.position() - (readLength - readPos) + writeLength; }
+
+  // Bytes of count that lie before the end of the range set by restrictTo()
+  size_t clampToWindow(const size_t count) {
+    if (windowEnd == 0) {
+      return count;
+    }
+    const size_t position = logicalPosition();
+    return position < windowEnd ? std::min(count, windowEnd - position) : 0;
+  }
+
+  bool seekTo(const size_t offset) {
+    // The underlying file sits at the end of the read-ahead window, so a target inside it needs no card access
+    const size_t windowEnd = file.position();
+    if (readLength > 0 && offset <= windowEnd && offset >= windowEnd - readLength) {
+      readPos = readLength - (windowEnd - offset);
+      return true;
+    }
+    readPos = readLength = 0;
+    flushWrites();
+    return file.seekSet(offset);
+  }
+
+  int read(void* buf, const size_t count) {
+    if (!flushWrites()) {
+      return -1;
+    }
+    auto* out = static_cast<uint8_t*>(buf);
+    size_t done = 0;
+    while (done < count) {
+      if (readPos == readLength) {
+        // Reads at least as large as the window go straight to the caller's memory
+        const bool direct = count - done >= bufferSize;
+        const int n = direct ? cardRead(out + done, count - done) : cardRead(buffer, bufferSize);
+        if (n <= 0) {
+          return done > 0 ? static_cast<int>(done) : n;
+        }
+        if (direct) {
+          done += n;
+          continue;
+        }
+        readPos = 0;
+        readLength = n;
+      }
+      const size_t chunk = std::min(count - done, readLength - readPos);
+      memcpy(out + done, buffer + readPos, chunk);
+      readPos += chunk;
+      done += chunk;
+    }
+    return static_cast<int>(done);
+  }
+
+  size_t write(const void* buf, const size_t count) {
+    dropReadAhead();
+    if (writeLength + count > bufferSize && !flushWrites()) {
+      return 0;
+    }
+    if (count >= bufferSize) {
+      return cardWrite(buf, count);
+    }
+    memcpy(buffer + writeLength, buf, count);
+    writeLength += count;
+    return count;
+  }
 };
 
+HalFile::Impl* HalFile::Impl::parkable = nullptr;
+
+void HalStorage::forgetPath(const char* path) {
+  char key[PATH_KEY_SIZE];
+  if (!pathKey(path, key)) {
+    forgetAllPaths();
+    return;
+  }
+  const size_t keyLength = strlen(key);
+  closeParkedFiles(key, keyLength);
+  HalFile::Impl::forgetParkable(key, keyLength);
+  xSemaphoreTake(pathCacheMutex, portMAX_DELAY);
+  for (PathCacheEntry& entry : pathCache) {
+    if (!entry.path.empty() && pathsOverlap(entry.path, key, keyLength)) {
+      entry.path.clear();
+    }
+  }
+  xSemaphoreGive(pathCacheMutex);
+}
+
+void HalStorage::forgetAllPaths() {
+  closeParkedFiles(nullptr, 0);
+  HalFile::Impl::forgetParkable(nullptr, 0);
+  xSemaphoreTake(pathCacheMutex, portMAX_DELAY);
+  for (PathCacheEntry& entry : pathCache) {
+    entry.path.clear();
+  }
+  xSemaphoreGive(pathCacheMutex);
+}
+
+void HalStorage::invalidate(const char* path) {
+  StorageLock lock;
+  forgetPath(path);
+}
+
+bool HalFile::setBufferSize(const size_t bufferSize) {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  if (impl->buffer) {
+    impl->dropReadAhead();
+    impl->flushWrites();
+    free(impl->buffer);
+    impl->buffer = nullptr;
+    impl->bufferSize = 0;
+  }
+  if (bufferSize == 0) {
+    return true;
+  }
+  impl->buffer = static_cast<uint8_t*>(malloc(bufferSize));
+  if (!impl->buffer) {
+    LOG_DBG("HAL", "No memory for a %u byte file buffer", static_cast<unsigned>(bufferSize));
+    return false;
+  }
+  impl->bufferSize = bufferSize;
+  return true;
+}
+
+bool HalFile::restrictTo(const size_t offset, const size_t length) {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  impl->flushWrites();
+  impl->readPos = impl->readLength = 0;
+  impl->windowStart = offset;
+  impl->windowEnd = offset + length;
+  return impl->file.seekSet(offset);
+}
+
 HalFile::HalFile() = default;
 
 HalFile::HalFile(std::unique_ptr<Impl> impl) : impl(std::move(impl)) {}
@@ -72,25 +630,83 @@ HalFile& HalFile::operator=(HalFile&&) = default;
 
 HalFile HalStorage::open(const char* path, const oflag_t oflag) {
   StorageLock lock;  // ensure thread safety for the duration of this function
+  char key[PATH_KEY_SIZE];
+  if (isReadOnly(oflag) && pathKey(path, key)) {
+    FsFile fsFile;
+    if (takeParkedFile(key, fsFile)) {
+      metrics::add(metrics::OPEN_CACHE_HITS);
+    } else {
+      metrics::add(metrics::OPEN_CACHE_MISSES);
+      fsFile = SDCard.open(path, oflag);
+    }
+    HalFile file(std::make_unique<HalFile::Impl>(std::move(fsFile)));
+    if (file.isOpen()) {
+      file.impl->makeParkable(key);
+    }
+    return file;
+  }
+  if (!isReadOnly(oflag)) {
+    forgetPath(path);
+  }
   return HalFile(std::make_unique<HalFile::Impl>(SDCard.open(path, oflag)));
 }
 
-bool HalStorage::mkdir(const char* path, const bool pFlag) { HAL_STORAGE_WRAPPED_CALL(mkdir, path, pFlag); }
-
-bool HalStorage::exists(const char* path) { HAL_STORAGE_WRAPPED_CALL(exists, path); }
+bool HalStorage::mkdir(const char* path, const bool pFlag) { HAL_STORAGE_MUTATING_CALL(path, mkdir, path, pFlag); }
+
+bool HalStorage::exists(const char* path) {
+  char key[PATH_KEY_SIZE];
+  if (!pathKey(path, key)) {
+    HAL_STORAGE_WRAPPED_CALL(exists, path);
+  }
+  PathCacheEntry& entry = pathCache[hashKey(key) % PATH_CACHE_SIZE];
+  xSemaphoreTake(pathCacheMutex, portMAX_DELAY);
+  const bool hit = entry.path == key;
+  const bool cached = entry.exists;
+  xSemaphoreGive(pathCacheMutex);
+  if (hit) {
+    metrics::add(metrics::PATH_CACHE_HITS);
+    return cached;
+  }
+
+  metrics::add(metrics::PATH_CACHE_MISSES);
+  StorageLock lock;
+  const bool found = SDCard.exists(path);
+  // Still under the storage lock, so nothing can have changed the path since the probe
+  xSemaphoreTake(pathCacheMutex, portMAX_DELAY);
+  entry.path = key;
+  entry.exists = found;
+  xSemaphoreGive(pathCacheMutex);
+  return found;
+}
 
-bool HalStorage::remove(const char* path) { HAL_STORAGE_WRAPPED_CALL(remove, path); }
+bool HalStorage::remove(const char* path) { HAL_STORAGE_MUTATING_CALL(path, remove, path); }
 bool HalStorage::rename(const char* oldPath, const char* newPath) {
-  HAL_STORAGE_WRAPPED_CALL(rename, oldPath, newPath);
+  StorageLock lock;
+  forgetPath(oldPath);
+  forgetPath(newPath);
+  return SDCard.rename(oldPath, newPath);
 }
 
-bool HalStorage::rmdir(const char* path) { HAL_STORAGE_WRAPPED_CALL(rmdir, path); }
+bool HalStorage::rmdir(const char* path) { HAL_STORAGE_MUTATING_CALL(path, rmdir, path); }
 
 bool HalStorage::openFileForRead(const char* moduleName, const char* path, HalFile& file) {
+  file = HalFile();  // Release the previous handle first, its destructor may flush buffered writes under the lock
   StorageLock lock;  // ensure thread safety for the duration of this function
+  char key[PATH_KEY_SIZE];
+  const bool parkable = pathKey(path, key);
   FsFile fsFile;
-  bool ok = SDCard.openFileForRead(moduleName, path, fsFile);
+  bool ok;
+  if (parkable && takeParkedFile(key, fsFile)) {
+    metrics::add(metrics::OPEN_CACHE_HITS);
+    ok = true;
+  } else {
+    metrics::add(metrics::OPEN_CACHE_MISSES);
+    ok = SDCard.openFileForRead(moduleName, path, fsFile);
+  }
   file = HalFile(std::make_unique<HalFile::Impl>(std::move(fsFile)));
+  if (ok && parkable) {
+    file.impl->makeParkable(key);
+  }
   return ok;
 }
 
@@ -103,7 +719,9 @@ bool HalStorage::openFileForRead(const char* moduleName, const String& path, Hal
 }
 
 bool HalStorage::openFileForWrite(const char* moduleName, const char* path, HalFile& file) {
+  file = HalFile();  // Release the previous handle first, its destructor may flush buffered writes under the lock
   StorageLock lock;  // ensure thread safety for the duration of this function
+  forgetPath(path);
   FsFile fsFile;
   bool ok = SDCard.openFileForWrite(moduleName, path, fsFile);
   file = HalFile(std::make_unique<HalFile::Impl>(std::move(fsFile)));
@@ -118,7 +736,7 @@ bool HalStorage::openFileForWrite(const char* moduleName, const String& path, Ha
   return openFileForWrite(moduleName, path.c_str(), file);
 }
 
-bool HalStorage::removeDir(const char* path) { HAL_STORAGE_WRAPPED_CALL(removeDir, path); }
+bool HalStorage::removeDir(const char* path) { HAL_STORAGE_MUTATING_CALL(path, removeDir, path); }
 
 // HalFile implementation
 // Allow doing file operations while ensuring thread safety via HalStorage's mutex.
@@ -133,23 +751,116 @@ bool HalStorage::removeDir(const char* path) { HAL_STORAGE_WRAPPED_CALL(removeDi
   assert(impl != nullptr);                 \
   return impl->file.method(__VA_ARGS__);
 
-void HalFile::flush() { HAL_FILE_WRAPPED_CALL(flush, ); }
+// Calls that depend on the logical position go through the buffer when one is set
+#define HAL_FILE_SETTLED_CALL(method, ...) \
+  HalStorage::StorageLock lock;            \
+  assert(impl != nullptr);                 \
+  if (impl->buffer) {                      \
+    impl->dropReadAhead();                 \
+    impl->flushWrites();                   \
+  }                                        \
+  return impl->file.method(__VA_ARGS__);
+
+void HalFile::flush() { HAL_FILE_SETTLED_CALL(flush, ); }
 size_t HalFile::getName(char* name, size_t len) { HAL_FILE_WRAPPED_CALL(getName, name, len); }
-size_t HalFile::size() { HAL_FILE_FORWARD_CALL(size, ); }          // already thread-safe, no need to wrap
-size_t HalFile::fileSize() { HAL_FILE_FORWARD_CALL(fileSize, ); }  // already thread-safe, no need to wrap
-bool HalFile::seek(size_t pos) { HAL_FILE_WRAPPED_CALL(seekSet, pos); }
-bool HalFile::seekCur(int64_t offset) { HAL_FILE_WRAPPED_CALL(seekCur, offset); }
-bool HalFile::seekSet(size_t offset) { HAL_FILE_WRAPPED_CALL(seekSet, offset); }
-int HalFile::available() const { HAL_FILE_WRAPPED_CALL(available, ); }
-size_t HalFile::position() const { HAL_FILE_WRAPPED_CALL(position, ); }
-int HalFile::read(void* buf, size_t count) { HAL_FILE_WRAPPED_CALL(read, buf, count); }
-int HalFile::read() { HAL_FILE_WRAPPED_CALL(read, ); }
-size_t HalFile::write(const void* buf, size_t count) { HAL_FILE_WRAPPED_CALL(write, buf, count); }
-size_t HalFile::write(uint8_t b) { HAL_FILE_WRAPPED_CALL(write, b); }
-bool HalFile::rename(const char* newPath) { HAL_FILE_WRAPPED_CALL(rename, newPath); }
+size_t HalFile::size() {
+  if (impl && impl->windowEnd > 0) {
+    return impl->windowEnd - impl->windowStart;
+  }
+  // Without pending writes this is already thread-safe, no need to wrap
+  if (impl && impl->writeLength > 0) {
+    HAL_FILE_SETTLED_CALL(size, );
+  }
+  HAL_FILE_FORWARD_CALL(size, );
+}
+size_t HalFile::fileSize() {
+  if (impl && impl->windowEnd > 0) {
+    return impl->windowEnd - impl->windowStart;
+  }
+  if (impl && impl->writeLength > 0) {
+    HAL_FILE_SETTLED_CALL(fileSize, );
+  }
+  HAL_FILE_FORWARD_CALL(fileSize, );
+}
+bool HalFile::seek(size_t pos) { return seekSet(pos); }
+bool HalFile::seekCur(int64_t offset) {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  if (impl->buffer) {
+    return impl->seekTo(impl->logicalPosition() + offset);
+  }
+  return impl->file.seekCur(offset);
+}
+bool HalFile::seekSet(size_t offset) {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  offset += impl->windowStart;
+  if (impl->buffer) {
+    return impl->seekTo(offset);
+  }
+  return impl->file.seekSet(offset);
+}
+int HalFile::available() const {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  if (impl->windowEnd > 0) {
+    impl->flushWrites();
+    return static_cast<int>(impl->clampToWindow(SIZE_MAX));
+  }
+  if (!impl->buffer) {
+    return impl->file.available();
+  }
+  impl->flushWrites();
+  return impl->file.available() + static_cast<int>(impl->readLength - impl->readPos);
+}
+size_t HalFile::position() const {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  return (impl->buffer ? impl->logicalPosition() : impl->file.position()) - impl->windowStart;
+}
+int HalFile::read(void* buf, size_t count) {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  count = impl->clampToWindow(count);
+  return impl->buffer ? impl->read(buf, count) : impl->cardRead(buf, count);
+}
+int HalFile::read() {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  uint8_t b;
+  return impl->clampToWindow(1) == 1 && impl->read(&b, 1) == 1 ? b : -1;
+}
+size_t HalFile::write(const void* buf, size_t count) {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  return impl->buffer ? impl->write(buf, count) : impl->cardWrite(buf, count);
+}
+size_t HalFile::write(uint8_t b) { return write(&b, 1); }
+bool HalFile::rename(const char* newPath) {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  // The file doesn't know its own path, so the old one can't be singled out
+  Storage.forgetAllPaths();
+  return impl->file.rename(newPath);
+}
+bool HalFile::preAllocate(size_t length) { HAL_FILE_SETTLED_CALL(preAllocate, length); }
+bool HalFile::truncate(size_t length) { HAL_FILE_SETTLED_CALL(truncate, length); }
+bool HalFile::getModifyDateTime(uint16_t* pdate, uint16_t* ptime) {
+  HAL_FILE_WRAPPED_CALL(getModifyDateTime, pdate, ptime);
+}
 bool HalFile::isDirectory() const { HAL_FILE_FORWARD_CALL(isDirectory, ); }  // already thread-safe, no need to wrap
 void HalFile::rewindDirectory() { HAL_FILE_WRAPPED_CALL(rewindDirectory, ); }
-bool HalFile::close() { HAL_FILE_WRAPPED_CALL(close, ); }
+bool HalFile::close() {
+  HalStorage::StorageLock lock;
+  assert(impl != nullptr);
+  // Pending writes go out first; the buffer itself stays until the handle is destroyed or reopened
+  const bool flushed = !impl->buffer || impl->flushWrites();
+  impl->readPos = impl->readLength = 0;
+  if (impl->park()) {
+    return flushed;
+  }
+  return impl->file.close() && flushed;
+}
 HalFile HalFile::openNextFile() {
   HalStorage::StorageLock lock;
   assert(impl != nullptr);
@@ -4,24 +4,61 @@
 #include <common/FsApiConstants.h>  // for oflag_t
 #include <freertos/semphr.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 
 class HalFile;
 
+// I/O sizes suited to the inserted card, picked by the self-test in HalStorage::begin(). Until a card has been
+// measured (or when the test fails) these are the sizes the firmware always used.
+struct StorageProfile {
+  uint16_t readChunk = 1024;   // Sequential reads: streaming a file out, reading pages of a book file
+  uint16_t writeChunk = 1024;  // Sequential writes: extracting zip entries to files, uploads
+  // Measured at the chosen sizes, for the log; 0 when not measured
+  uint16_t readKBps = 0;
+  uint16_t writeKBps = 0;
+  uint16_t randomReadUs = 0;   // One readChunk at a random offset
+  uint16_t randomWriteUs = 0;  // One writeChunk at a random offset
+};
+
 class HalStorage {
  public:
+  // Priority classes for card access, highest first. Calls are still serialized one at a time, but a lower class
+  // holds off while a higher one is waiting for the card or used it within the last few milliseconds. A burst of
+  // page-render reads then runs back to back instead of interleaving with cache-building writes.
+  enum class IoClass : uint8_t { Interactive, Prefetch, Background };
+
+  // Puts the calling task's storage calls in ioClass until the scope ends. Tasks start out Interactive.
+  class IoClassScope {
+   public:
+    explicit IoClassScope(IoClass ioClass);
+    ~IoClassScope();
+    IoClassScope(const IoClassScope&) = delete;
+    IoClassScope& operator=(const IoClassScope&) = delete;
+
+   private:
+    IoClass previous;
+  };
+
   HalStorage();
-  bool begin();
+  // Mount the card. With profileCard, also load the card's StorageProfile, running the self-test first if the card
+  // hasn't been measured yet (a fraction of a second, once per card).
+  bool begin(bool profileCard = true);
   bool ready() const;
+  const StorageProfile& profile() const { return storageProfile; }
+  // Benchmark sequential and random reads and writes at a few block sizes, keep the sizes that reach close to the
+  // card's best throughput and persist them on the card. Returns false (keeping the current profile) on failure.
+  bool measureProfile();
   std::vector<String> listFiles(const char* path = "/", int maxFiles = 200);
   // Read the entire file at `path` into a String. Returns empty string on failure.
   String readFile(const char* path);
   // Low-memory helpers:
   // Stream the file contents to a `Print` (e.g. `Serial`, or any `Print`-derived object).
   // Returns true on success, false on failure.
-  bool readFileToStream(const char* path, Print& out, size_t chunkSize = 256);
+  // A chunkSize of 0 uses the profile's readChunk.
+  bool readFileToStream(const char* path, Print& out, size_t chunkSize = 0);
   // Read up to `bufferSize-1` bytes into `buffer`, null-terminating it. Returns bytes read.
   size_t readFileToBuffer(const char* path, char* buffer, size_t bufferSize, size_t maxBytes = 0);
   // Write a string to `path` on the SD card. Overwrites existing file.
@@ -30,8 +67,15 @@ class HalStorage {
   // Ensure a directory exists, creating it if necessary. Returns true on success.
   bool ensureDirectoryExists(const char* path);
 
+  // Read-only opens (here and in openFileForRead) reuse a handle kept open from an earlier open of the same path
+  // when there is one, rewound to the start. Closing such a file parks its handle for the next open instead of
+  // closing it; the few most recently used stay open, so the book, its section and its CSS cache are reopened
+  // without walking the FAT directories again.
   HalFile open(const char* path, const oflag_t oflag = O_RDONLY);
   bool mkdir(const char* path, const bool pFlag = true);
+  // Answers from a small cache of recently probed paths when it can. Every call here and in HalFile that creates,
+  // removes or renames something invalidates the paths it touches, so the cache can't go stale as long as all
+  // card access goes through HalStorage.
   bool exists(const char* path);
   bool remove(const char* path);
   bool rename(const char* oldPath, const char* newPath);
@@ -44,16 +88,47 @@ class HalStorage {
   bool openFileForWrite(const char* moduleName, const std::string& path, HalFile& file);
   bool openFileForWrite(const char* moduleName, const String& path, HalFile& file);
   bool removeDir(const char* path);
+  // Drop the cached existence and parked handles of path and everything below it. HalStorage's own calls do this
+  // themselves; this is for changes made to the card some other way.
+  void invalidate(const char* path);
 
   static HalStorage& getInstance() { return instance; }
 
   class StorageLock;  // private class, used internally
 
  private:
+  friend class HalFile;
   static HalStorage instance;
 
+  static constexpr int IO_CLASS_COUNT = 3;
+
   bool initialized = false;
+  StorageProfile storageProfile;
   SemaphoreHandle_t storageMutex = nullptr;
+  // Per class: tasks waiting for the mutex, and when a call in that class last released it
+  std::atomic<uint8_t> waiting[IO_CLASS_COUNT] = {};
+  std::atomic<uint32_t> lastUseMs[IO_CLASS_COUNT] = {};
+  int holderClass = 0;  // Only touched while holding storageMutex
+
+  // exists() results by normalized path, direct-mapped on the path hash. Written with storageMutex held, so an
+  // entry always matches the card; read under pathCacheMutex only, so a hit doesn't wait for the card.
+  struct PathCacheEntry {
+    std::string path;
+    bool exists = false;
+  };
+  static constexpr size_t PATH_CACHE_SIZE = 64;
+  PathCacheEntry pathCache[PATH_CACHE_SIZE];
+  SemaphoreHandle_t pathCacheMutex = nullptr;
+
+  bool loadProfile();
+  bool higherClassActive(int level) const;
+  void acquire();
+  void release();
+  // Drop the cached existence of path, everything below it and its parent directories, and close the parked
+  // handles among them. Callers hold storageMutex, and call these before changing the card so no parked handle is
+  // open on a file being removed or rewritten.
+  void forgetPath(const char* path);
+  void forgetAllPaths();
 };
 
 #define Storage HalStorage::getInstance()
@@ -72,6 +147,18 @@ class HalFile : public Print {
   HalFile(const HalFile&) = delete;
   HalFile& operator=(const HalFile&) = delete;
 
+  // Opt-in buffering for callers that read or write a file in small pieces (serialization::readPod and friends).
+  // Reads are served from a read-ahead window of bufferSize bytes and small writes collect in it until it fills,
+  // so most calls cost a memcpy instead of a locked SdFat call. Seeks inside the read window don't touch the
+  // card. Pending writes go out on flush(), close(), a seek, a read, size() or destruction, so a write error may
+  // only show up there. Pass 0 to switch back to unbuffered access. Returns false if the buffer can't be
+  // allocated, in which case the file stays unbuffered.
+  static constexpr size_t DEFAULT_BUFFER_SIZE = 1024;
+  bool setBufferSize(size_t bufferSize);
+  // Make the file look like the length bytes at offset, for reading one entry of a container file: positions,
+  // seeks, size() and available() count from offset and reads stop at its end. Rewinds to the start of the range.
+  bool restrictTo(size_t offset, size_t length);
+
   void flush();
   size_t getName(char* name, size_t len);
   size_t size();
@@ -86,6 +173,12 @@ class HalFile : public Print {
   size_t write(const void* buf, size_t count);
   size_t write(uint8_t b) override;
   bool rename(const char* newPath);
+  // Reserve a contiguous run of clusters for a newly created, still empty file. The file size becomes `length`
+  // until truncate() trims it to what was actually written.
+  bool preAllocate(size_t length);
+  bool truncate(size_t length);
+  // FAT modification date and time (see FS_DATE / FS_TIME in SdFat)
+  bool getModifyDateTime(uint16_t* pdate, uint16_t* ptime);
   bool isDirectory() const;
   void rewindDirectory();
   bool close();
@@ -223,6 +223,7 @@ static pjpeg_need_bytes_callback_t g_pNeedBytesCallback;
 static void* g_pCallback_data;
 static uint8 gCallbackStatus;
 static uint8 gReduce;
+static uint8 gKeepCoeffs;  // Low pass reduce modes: coefficients kept per block row and column
 //------------------------------------------------------------------------------
 static void fillInBuf(void) {
   unsigned char status;
@@ -1941,7 +1942,7 @@ static uint8 decodeNextMCU(void) {
 
     compACTab = gCompACTab[componentID];
 
-    if (gReduce) {
+    if (gReduce == PJPG_REDUCE_DC) {
       // Decode, but throw out the AC coefficients in reduce mode.
       for (k = 1; k < 64; k++) {
         s = huffDecode(compACTab ? &gHuffTab3 : &gHuffTab2, compACTab ? gHuffVal3 : gHuffVal2);
@@ -1997,7 +1998,10 @@ static uint8 decodeNextMCU(void) {
 
           ac = huffExtend(extraBits, s);
 
-          gCoeffBuf[ZAG[k]] = ac * pQ[k];
+          if (((ZAG[k] & 7) < gKeepCoeffs) && ((ZAG[k] >> 3) < gKeepCoeffs))
+            gCoeffBuf[ZAG[k]] = ac * pQ[k];
+          else
+            gCoeffBuf[ZAG[k]] = 0;
         } else {
           if (r == 15) {
             if ((k + 16) > 64) return PJPG_DECODE_ERROR;
@@ -2038,6 +2042,11 @@ unsigned char pjpeg_decode_mcu(void) {
   return 0;
 }
 //------------------------------------------------------------------------------
+void pjpeg_set_reduce(unsigned char reduce) {
+  gReduce = reduce;
+  gKeepCoeffs = (reduce == PJPG_REDUCE_LOW_2X2) ? 2 : (reduce == PJPG_REDUCE_LOW_4X4) ? 4 : 8;
+}
+//------------------------------------------------------------------------------
 unsigned char pjpeg_decode_init(pjpeg_image_info_t* pInfo, pjpeg_need_bytes_callback_t pNeed_bytes_callback,
                                 void* pCallback_data, unsigned char reduce) {
   uint8 status;
@@ -2057,7 +2066,7 @@ unsigned char pjpeg_decode_init(pjpeg_image_info_t* pInfo, pjpeg_need_bytes_call
   g_pNeedBytesCallback = pNeed_bytes_callback;
   g_pCallback_data = pCallback_data;
   gCallbackStatus = 0;
-  gReduce = reduce;
+  pjpeg_set_reduce(reduce);
 
   status = init();
   if ((status) || (gCallbackStatus)) return gCallbackStatus ? gCallbackStatus : status;
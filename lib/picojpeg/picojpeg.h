@@ -112,6 +112,15 @@ typedef unsigned char (*pjpeg_need_bytes_callback_t)(unsigned char* pBuf, unsign
 unsigned char pjpeg_decode_init(pjpeg_image_info_t* pInfo, pjpeg_need_bytes_callback_t pNeed_bytes_callback,
                                 void* pCallback_data, unsigned char reduce);
 
+// Reduce modes. PJPG_REDUCE_DC is the reduce flag of pjpeg_decode_init(): one pixel per 8x8 block. The low pass
+// modes still decode full size blocks but keep only the lowest 2x2 or 4x4 DCT coefficients of each one: the AC
+// coefficients above are not dequantized, the IDCT rows left empty are short circuited, and the pixels come out
+// band limited for downscaling by 1/4 or 1/2.
+enum { PJPG_REDUCE_NONE = 0, PJPG_REDUCE_DC = 1, PJPG_REDUCE_LOW_2X2 = 2, PJPG_REDUCE_LOW_4X4 = 3 };
+
+// Changes the reduce mode in between pjpeg_decode_init() and the first pjpeg_decode_mcu(). Not thread safe.
+void pjpeg_set_reduce(unsigned char reduce);
+
 // Decompresses the file's next MCU. Returns 0 on success, PJPG_NO_MORE_BLOCKS if no more blocks are available, or an
 // error code. Must be called a total of m_MCUSPerRow*m_MCUSPerCol times to completely decompress the image. Not thread
 // safe.
@@ -35,6 +35,7 @@
 #include <assert.h>
 #include <string.h>
 #include "tinf.h"
+#include <HotPath.h>
 
 #define UZLIB_DUMP_ARRAY(heading, arr, size) \
     { \
@@ -127,8 +128,9 @@ static void tinf_build_fixed_trees(TINF_TREE *lt, TINF_TREE *dt)
 {
    int i;
 
-   /* build fixed length tree */
-   for (i = 0; i < 7; ++i) lt->table[i] = 0;
+   /* build fixed length tree (clearing the counts a dynamic tree left
+      above length 9, which the lookup table builder would pick up) */
+   for (i = 0; i < 16; ++i) lt->table[i] = 0;
 
    lt->table[7] = 24;
    lt->table[8] = 152;
@@ -140,7 +142,7 @@ static void tinf_build_fixed_trees(TINF_TREE *lt, TINF_TREE *dt)
    for (i = 0; i < 112; ++i) lt->trans[24 + 144 + 8 + i] = 144 + i;
 
    /* build fixed distance tree */
-   for (i = 0; i < 5; ++i) dt->table[i] = 0;
+   for (i = 0; i < 16; ++i) dt->table[i] = 0;
 
    dt->table[5] = 32;
 
@@ -186,6 +188,47 @@ static void tinf_build_tree(TINF_TREE *t, const unsigned char *lengths, unsigned
    }
 }
 
+#if UZLIB_CONF_FAST_LIT_BITS > 0
+/* given a tree, fill a primary lookup table of 2^bits entries: every
+   code up to bits long gets (symbol << 4) | length at each index whose
+   low bits are the code (codes are read LSB first, so bit-reversed),
+   and the rest stay 0, meaning a longer code that must be walked */
+static void tinf_build_fast(const TINF_TREE *t, unsigned short *fast, unsigned int bits)
+{
+   unsigned int len, i, code = 0, idx = 0;
+
+   memset(fast, 0, sizeof(*fast) << bits);
+
+   /* canonical codes: consecutive within a length, in trans order */
+   for (len = 1; len <= bits; ++len)
+   {
+      for (i = 0; i < t->table[len]; ++i, ++code)
+      {
+         unsigned short entry = (unsigned short)(t->trans[idx++] << 4 | len);
+         unsigned int rev = 0, c = code, j;
+
+         for (j = 0; j < len; ++j, c >>= 1) rev = rev << 1 | (c & 1);
+         for (j = rev; j < (1u << bits); j += 1u << len) fast[j] = entry;
+      }
+      code <<= 1;
+   }
+}
+#endif
+
+/* rebuild the lookup tables, if the application supplied them, after
+   the trees changed */
+static void tinf_build_fast_tables(TINF_DATA *d)
+{
+#if UZLIB_CONF_FAST_LIT_BITS > 0
+   if (d->fast_table) {
+      tinf_build_fast(&d->ltree, d->fast_table, UZLIB_CONF_FAST_LIT_BITS);
+      tinf_build_fast(&d->dtree, d->fast_table + (1 << UZLIB_CONF_FAST_LIT_BITS), UZLIB_CONF_FAST_DIST_BITS);
+   }
+#else
+   (void)d;
+#endif
+}
+
 /* ---------------------- *
  * -- decode functions -- *
  * ---------------------- */
@@ -216,12 +259,70 @@ unsigned char uzlib_get_byte(TINF_DATA *d)
     return 0;
 }
 
+/* top up the bit buffer to more than 24 bits, with one word load while
+   the input buffer holds a word; at the end of input it stays short,
+   and the bits above bitcount read as zeros */
+static void tinf_refill(TINF_DATA *d)
+{
+   if (d->bitcount > 24) return;
+
+   if (d->source_limit - d->source >= 4)
+   {
+      const unsigned char *s = d->source;
+      uint32_t word = s[0] | (uint32_t)s[1] << 8 | (uint32_t)s[2] << 16 | (uint32_t)s[3] << 24;
+      unsigned int bytes = (32 - d->bitcount) >> 3;
+
+      d->tag |= word << d->bitcount;
+      d->bitcount += bytes * 8;
+      /* keep the bits above bitcount clear */
+      if (d->bitcount < 32) d->tag &= ((uint32_t)1 << d->bitcount) - 1;
+      d->source += bytes;
+      return;
+   }
+
+   while (d->bitcount <= 24 && !d->eof)
+   {
+      uint32_t c = uzlib_get_byte(d);
+      if (d->eof) break;
+      d->tag |= c << d->bitcount;
+      d->bitcount += 8;
+   }
+}
+
+/* drop num bits from the bit buffer */
+static void tinf_consume(TINF_DATA *d, unsigned int num)
+{
+   if (num > d->bitcount)
+   {
+      /* the bits were past the end of input */
+      d->overrun = true;
+      num = d->bitcount;
+   }
+   d->tag >>= num;
+   d->bitcount -= num;
+}
+
+/* get the next byte at a byte boundary: first the whole bytes left in
+   the bit buffer, then from the input */
+static unsigned char tinf_get_aligned_byte(TINF_DATA *d)
+{
+   if (d->bitcount >= 8)
+   {
+      unsigned char c = (unsigned char)d->tag;
+      d->tag >>= 8;
+      d->bitcount -= 8;
+      return c;
+   }
+   return uzlib_get_byte(d);
+}
+
 uint32_t tinf_get_le_uint32(TINF_DATA *d)
 {
     uint32_t val = 0;
     int i;
+    tinf_consume(d, d->bitcount & 7);
     for (i = 4; i--;) {
-        val = val >> 8 | ((uint32_t)uzlib_get_byte(d)) << 24;
+        val = val >> 8 | ((uint32_t)tinf_get_aligned_byte(d)) << 24;
     }
     return val;
 }
@@ -230,59 +331,48 @@ uint32_t tinf_get_be_uint32(TINF_DATA *d)
 {
     uint32_t val = 0;
     int i;
+    tinf_consume(d, d->bitcount & 7);
     for (i = 4; i--;) {
-        val = val << 8 | uzlib_get_byte(d);
+        val = val << 8 | tinf_get_aligned_byte(d);
     }
     return val;
 }
 
-/* get one bit from source stream */
-static int tinf_getbit(TINF_DATA *d)
-{
-   unsigned int bit;
-
-   /* check if tag is empty */
-   if (!d->bitcount--)
-   {
-      /* load next tag */
-      d->tag = uzlib_get_byte(d);
-      d->bitcount = 7;
-   }
-
-   /* shift bit out of tag */
-   bit = d->tag & 0x01;
-   d->tag >>= 1;
-
-   return bit;
-}
-
 /* read a num bit value from a stream and add base */
 static unsigned int tinf_read_bits(TINF_DATA *d, int num, int base)
 {
-   unsigned int val = 0;
+   unsigned int val;
 
-   /* read num bits */
-   if (num)
-   {
-      unsigned int limit = 1 << (num);
-      unsigned int mask;
+   if (d->bitcount < (unsigned int)num) tinf_refill(d);
 
-      for (mask = 1; mask < limit; mask *= 2)
-         if (tinf_getbit(d)) val += mask;
-   }
+   val = d->tag & (((uint32_t)1 << num) - 1);
+   tinf_consume(d, num);
 
    return val + base;
 }
 
-/* given a data stream and a tree, decode a symbol */
+/* get one bit from source stream */
+static int tinf_getbit(TINF_DATA *d)
+{
+   return tinf_read_bits(d, 1, 0);
+}
+
+/* given a data stream and a tree, decode a symbol by walking its code
+   bit by bit */
 static int tinf_decode_symbol(TINF_DATA *d, TINF_TREE *t)
 {
    int sum = 0, cur = 0, len = 0;
+   uint32_t tag;
+
+   /* the longest code fits in a refilled buffer */
+   tinf_refill(d);
+   tag = d->tag;
 
    /* get more bits while code value is above sum */
    do {
 
-      cur = 2*cur + tinf_getbit(d);
+      cur = 2*cur + (tag & 1);
+      tag >>= 1;
 
       if (++len == TINF_ARRAY_SIZE(t->table)) {
          return TINF_DATA_ERROR;
@@ -293,6 +383,8 @@ static int tinf_decode_symbol(TINF_DATA *d, TINF_TREE *t)
 
    } while (cur >= 0);
 
+   tinf_consume(d, len);
+
    sum += cur;
    #if UZLIB_CONF_PARANOID_CHECKS
    if (sum < 0 || sum >= TINF_ARRAY_SIZE(t->trans)) {
@@ -303,6 +395,30 @@ static int tinf_decode_symbol(TINF_DATA *d, TINF_TREE *t)
    return t->trans[sum];
 }
 
+/* given a data stream, a tree and its lookup table (or NULL), decode a
+   symbol, with a single lookup when its code is in the table */
+static inline int tinf_decode(TINF_DATA *d, TINF_TREE *t, const unsigned short *fast, unsigned int bits)
+{
+#if UZLIB_CONF_FAST_LIT_BITS > 0
+   if (fast)
+   {
+      unsigned int entry;
+
+      tinf_refill(d);
+      entry = fast[d->tag & ((1u << bits) - 1)];
+      if (entry)
+      {
+         tinf_consume(d, entry & 15);
+         return entry >> 4;
+      }
+   }
+#else
+   (void)fast;
+   (void)bits;
+#endif
+   return tinf_decode_symbol(d, t);
+}
+
 /* given a data stream, decode dynamic trees from it */
 static int tinf_decode_trees(TINF_DATA *d, TINF_TREE *lt, TINF_TREE *dt)
 {
@@ -403,23 +519,93 @@ static int tinf_decode_trees(TINF_DATA *d, TINF_TREE *lt, TINF_TREE *dt)
  * -- block inflate functions -- *
  * ----------------------------- */
 
-/* given a stream and two trees, inflate next chunk of output (a byte or more) */
-static int tinf_inflate_block_data(TINF_DATA *d, TINF_TREE *lt, TINF_TREE *dt)
+/* copy as much of the current match as the output buffer takes */
+static void HOT_PATH tinf_copy_match(TINF_DATA *d)
 {
-    if (d->curlen == 0) {
+    unsigned int len = d->curlen, room = d->dest_limit - d->dest;
+    unsigned char *dest = d->dest;
+
+    if (len > room) {
+        len = room;
+    }
+    d->curlen -= len;
+
+    if (d->dict_ring) {
+        unsigned char *ring = d->dict_ring;
+        unsigned int size = d->dict_size, idx = d->dict_idx, off = d->lzOff;
+
+        /* in runs that wrap around neither end of the ring; copying
+           forwards byte by byte also repeats overlapping matches */
+        while (len) {
+            unsigned int run = len, i;
+            if (run > size - off) run = size - off;
+            if (run > size - idx) run = size - idx;
+            for (i = 0; i < run; ++i) {
+                unsigned char c = ring[off + i];
+                ring[idx + i] = c;
+                dest[i] = c;
+            }
+            dest += run;
+            len -= run;
+            if ((off += run) == size) off = 0;
+            if ((idx += run) == size) idx = 0;
+        }
+        d->dict_idx = idx;
+        d->lzOff = off;
+    } else {
+        const unsigned char *src = dest + d->lzOff;
+        #if UZLIB_CONF_USE_MEMCPY
+        /* copy as much as possible, in one memcpy() call, unless the
+           match overlaps itself */
+        if (src + len <= dest) {
+            memcpy(dest, src, len);
+            dest += len;
+            len = 0;
+        }
+        #endif
+        while (len--) {
+            *dest++ = *src++;
+        }
+    }
+    d->dest = dest;
+}
+
+/* given a stream and two trees, inflate until the output buffer is full
+   or the block ends */
+static int HOT_PATH tinf_inflate_block_data(TINF_DATA *d, TINF_TREE *lt, TINF_TREE *dt)
+{
+    const unsigned short *lfast = NULL, *dfast = NULL;
+
+#if UZLIB_CONF_FAST_LIT_BITS > 0
+    if (d->fast_table) {
+        lfast = d->fast_table;
+        dfast = d->fast_table + (1 << UZLIB_CONF_FAST_LIT_BITS);
+    }
+#endif
+
+    for (;;) {
         unsigned int offs;
-        int dist;
-        int sym = tinf_decode_symbol(d, lt);
+        int sym, dist;
+
+        /* finish the match the previous call ran out of room for */
+        if (d->curlen) {
+            tinf_copy_match(d);
+        }
+        if (d->dest >= d->dest_limit) {
+            return TINF_OK;
+        }
+
+        sym = tinf_decode(d, lt, lfast, UZLIB_CONF_FAST_LIT_BITS);
         //printf("huff sym: %02x\n", sym);
 
-        if (d->eof) {
+        if (sym < 0 || d->overrun) {
             return TINF_DATA_ERROR;
         }
 
         /* literal byte */
         if (sym < 256) {
             TINF_PUT(d, sym);
-            return TINF_OK;
+            continue;
         }
 
         /* end of block */
@@ -436,13 +622,16 @@ static int tinf_inflate_block_data(TINF_DATA *d, TINF_TREE *lt, TINF_TREE *dt)
         /* possibly get more bits from length code */
         d->curlen = tinf_read_bits(d, length_bits[sym], length_base[sym]);
 
-        dist = tinf_decode_symbol(d, dt);
-        if (dist >= 30) {
+        dist = tinf_decode(d, dt, dfast, UZLIB_CONF_FAST_DIST_BITS);
+        if (dist < 0 || dist >= 30) {
             return TINF_DATA_ERROR;
         }
 
         /* possibly get more bits from distance code */
         offs = tinf_read_bits(d, dist_bits[dist], dist_base[dist]);
+        if (d->overrun) {
+            return TINF_DATA_ERROR;
+        }
 
         /* calculate and validate actual LZ offset to use */
         if (d->dict_ring) {
@@ -471,63 +660,69 @@ static int tinf_inflate_block_data(TINF_DATA *d, TINF_TREE *lt, TINF_TREE *dt)
             d->lzOff = -offs;
         }
     }
-
-    /* copy next byte from dict substring */
-    if (d->dict_ring) {
-        TINF_PUT(d, d->dict_ring[d->lzOff]);
-        if ((unsigned)++d->lzOff == d->dict_size) {
-            d->lzOff = 0;
-        }
-    } else {
-        #if UZLIB_CONF_USE_MEMCPY
-        /* copy as much as possible, in one memcpy() call */
-        unsigned int to_copy = d->curlen, dest_len = d->dest_limit - d->dest;
-        if (to_copy > dest_len) {
-            to_copy = dest_len;
-        }
-        memcpy(d->dest, d->dest + d->lzOff, to_copy);
-        d->dest += to_copy;
-        d->curlen -= to_copy;
-        return TINF_OK;
-        #else
-        d->dest[0] = d->dest[d->lzOff];
-        d->dest++;
-        #endif
-    }
-    d->curlen--;
-    return TINF_OK;
 }
 
-/* inflate next byte from uncompressed block of data */
+/* inflate an uncompressed block until the output buffer is full or the
+   block ends */
 static int tinf_inflate_uncompressed_block(TINF_DATA *d)
 {
     if (d->curlen == 0) {
         unsigned int length, invlength;
 
+        /* the block starts on a byte boundary */
+        tinf_consume(d, d->bitcount & 7);
+
         /* get length */
-        length = uzlib_get_byte(d);
-        length += 256 * uzlib_get_byte(d);
+        length = tinf_get_aligned_byte(d);
+        length += 256 * tinf_get_aligned_byte(d);
         /* get one's complement of length */
-        invlength = uzlib_get_byte(d);
-        invlength += 256 * uzlib_get_byte(d);
+        invlength = tinf_get_aligned_byte(d);
+        invlength += 256 * tinf_get_aligned_byte(d);
         /* check length */
         if (length != (~invlength & 0x0000ffff)) return TINF_DATA_ERROR;
 
         /* increment length to properly return TINF_DONE below, without
            producing data at the same time */
         d->curlen = length + 1;
-
-        /* make sure we start next block on a byte boundary */
-        d->bitcount = 0;
     }
 
-    if (--d->curlen == 0) {
-        return TINF_DONE;
-    }
+    for (;;) {
+        unsigned int len = d->curlen - 1, room = d->dest_limit - d->dest;
 
-    unsigned char c = uzlib_get_byte(d);
-    TINF_PUT(d, c);
-    return TINF_OK;
+        if (len == 0) {
+            d->curlen = 0;
+            return TINF_DONE;
+        }
+        if (room == 0) {
+            return TINF_OK;
+        }
+        if (len > room) {
+            len = room;
+        }
+
+        if (d->bitcount == 0 && d->source < d->source_limit) {
+            /* bit buffer drained: copy straight from the input buffer */
+            unsigned int avail = d->source_limit - d->source;
+            if (len > avail) {
+                len = avail;
+            }
+            if (d->dict_ring) {
+                unsigned int i;
+                for (i = 0; i < len; ++i) {
+                    TINF_PUT(d, d->source[i]);
+                }
+            } else {
+                memcpy(d->dest, d->source, len);
+                d->dest += len;
+            }
+            d->source += len;
+        } else {
+            unsigned char c = tinf_get_aligned_byte(d);
+            TINF_PUT(d, c);
+            len = 1;
+        }
+        d->curlen -= len;
+    }
 }
 
 /* ---------------------- *
@@ -552,7 +747,9 @@ void uzlib_init(void)
 void uzlib_uncompress_init(TINF_DATA *d, void *dict, unsigned int dictLen)
 {
    d->eof = 0;
+   d->tag = 0;
    d->bitcount = 0;
+   d->overrun = false;
    d->bfinal = 0;
    d->btype = -1;
    d->dict_size = dictLen;
@@ -584,12 +781,14 @@ next_blk:
             if (d->btype == 1 && old_btype != 1) {
                 /* build fixed huffman trees */
                 tinf_build_fixed_trees(&d->ltree, &d->dtree);
+                tinf_build_fast_tables(d);
             } else if (d->btype == 2) {
                 /* decode trees from stream */
                 res = tinf_decode_trees(d, &d->ltree, &d->dtree);
                 if (res != TINF_OK) {
                     return res;
                 }
+                tinf_build_fast_tables(d);
             }
         }
 
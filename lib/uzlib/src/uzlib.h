@@ -92,8 +92,11 @@ struct uzlib_uncomp {
        source_limit fields, thus allowing for buffered operation. */
     int (*source_read_cb)(struct uzlib_uncomp *uncomp);
 
-    unsigned int tag;
+    /* Bit buffer: the next bitcount input bits, LSB first (up to 32) */
+    uint32_t tag;
     unsigned int bitcount;
+    /* Set when decoding needed bits past the end of input */
+    bool overrun;
 
     /* Destination (output) buffer start */
     unsigned char *dest_start;
@@ -117,8 +120,18 @@ struct uzlib_uncomp {
 
     TINF_TREE ltree; /* dynamic length/symbol tree */
     TINF_TREE dtree; /* dynamic distance tree */
+
+    /* Optional Huffman lookup tables, UZLIB_FAST_TABLE_ENTRIES long, or
+       NULL to decode by walking the code trees only */
+    unsigned short *fast_table;
 };
 
+#if UZLIB_CONF_FAST_LIT_BITS > 0
+#define UZLIB_FAST_TABLE_ENTRIES ((1 << UZLIB_CONF_FAST_LIT_BITS) + (1 << UZLIB_CONF_FAST_DIST_BITS))
+#else
+#define UZLIB_FAST_TABLE_ENTRIES 0
+#endif
+
 #include "tinf_compat.h"
 
 #define TINF_PUT(d, c) \
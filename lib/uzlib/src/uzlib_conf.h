@@ -29,4 +29,20 @@
 #define UZLIB_CONF_USE_MEMCPY 0
 #endif
 
+#ifndef UZLIB_CONF_FAST_LIT_BITS
+/* Width in bits of the primary lookup table for literal/length codes
+   (0 disables the lookup tables). A code up to this long is decoded with
+   a single table lookup, longer ones with a canonical code walk. The
+   tables aren't part of struct uzlib_uncomp: the application supplies
+   UZLIB_FAST_TABLE_ENTRIES unsigned shorts through ->fast_table (or
+   leaves it NULL to decode without them), so this sets the memory
+   budget: 2 bytes per entry, 2.5KB with the defaults. */
+#define UZLIB_CONF_FAST_LIT_BITS 10
+#endif
+
+#ifndef UZLIB_CONF_FAST_DIST_BITS
+/* Width in bits of the primary lookup table for distance codes. */
+#define UZLIB_CONF_FAST_DIST_BITS 8
+#endif
+
 #endif /* UZLIB_CONF_H_INCLUDED */
@@ -1,6 +1,7 @@
 import os
 import re
 import gzip
+import hashlib
 
 SRC_DIR = "src"
 
@@ -44,7 +45,9 @@ for root, _, files in os.walk(SRC_DIR):
 
             # Compress with gzip (compresslevel 9 is maximum compression)
             # IMPORTANT: we don't use brotli because Firefox doesn't support brotli with insecured context (only supported on HTTPS)
-            compressed = gzip.compress(minified.encode('utf-8'), compresslevel=9)
+            # mtime=0 keeps the output byte-identical across builds, so the ETag only changes with the content
+            compressed = gzip.compress(minified.encode('utf-8'), compresslevel=9, mtime=0)
+            etag = hashlib.sha1(compressed).hexdigest()[:16]
 
             base_name = f"{os.path.splitext(file)[0]}Html"
             header_path = os.path.join(root, f"{base_name}.generated.h")
@@ -66,6 +69,7 @@ for root, _, files in os.walk(SRC_DIR):
                 h.write(f"}};\n\n")
                 h.write(f"constexpr size_t {base_name}CompressedSize = {len(compressed)};\n")
                 h.write(f"constexpr size_t {base_name}OriginalSize = {len(minified)};\n")
+                h.write(f"constexpr char {base_name}ETag[] = \"\\\"{etag}\\\"\";\n")
 
             print(f"Generated: {header_path}")
             print(f"  Original: {len(html_content)} bytes")
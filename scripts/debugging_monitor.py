@@ -11,6 +11,8 @@ Features:
 - Interactive memory usage graphing with matplotlib
 - Command input interface for sending commands to the ESP32 device
 - Screenshot capture and processing (1-bit black/white format)
+- CPU profile capture (CMD:PROFILE in the cpu_profile build), symbolized against firmware.elf
+- Frame capture (CMD:CAPTURE / CMD:CAPTURE_STOP): every plane sent to the panel, saved under frames/
 - Graceful shutdown handling with Ctrl-C signal processing
 - Configurable filtering and suppression of log messages
 - Thread-safe operation with coordinated shutdown events
@@ -18,6 +20,9 @@ Features:
 Usage:
     python debugging_monitor.py [port] [options]
 
+With --elf, profiles dumped by the device are turned into a flat profile and a folded-stack file (for flamegraph.pl
+or speedscope). A dump saved earlier is symbolized without a device with --profile profile.txt --elf firmware.elf.
+
 The script will open a matplotlib window showing memory usage over time and provide
 an interactive command prompt for sending commands to the device. Press Ctrl-C or
 close the graph window to exit gracefully.
@@ -27,12 +32,15 @@ from __future__ import annotations
 
 import argparse
 import glob
+import os
 import platform
 import re
 import signal
+import struct
+import subprocess
 import sys
 import threading
-from collections import deque
+from collections import Counter, deque
 from datetime import datetime
 
 # Try to import potentially missing packages
@@ -195,6 +203,144 @@ def parse_memory_line(line: str) -> tuple[int | None, int | None, int | None]:
     )
 
 
+def parse_profile(lines: list[str]) -> list[tuple[int, int, int]]:
+    """
+    Parses the body of a CMD:PROFILE dump: one "pc caller count" line per sample bucket, addresses in hex.
+    Returns: [(pc, caller, count)]
+    """
+    samples = []
+    for line in lines:
+        parts = line.split()
+        if len(parts) != 3:
+            continue
+        try:
+            samples.append((int(parts[0], 16), int(parts[1], 16), int(parts[2])))
+        except ValueError:
+            continue
+    return samples
+
+
+def symbolize(addresses: set[int], elf: str, addr2line: str) -> dict[int, str]:
+    """
+    Maps code addresses to function names with addr2line. Addresses outside the firmware image (ROM code) keep
+    their hex value.
+    """
+    ordered = sorted(addresses)
+    names = {address: f"0x{address:08x}" for address in ordered}
+    if not ordered:
+        return names
+    try:
+        result = subprocess.run(
+            [addr2line, "-f", "-C", "-e", elf] + [f"0x{address:x}" for address in ordered],
+            capture_output=True,
+            text=True,
+            check=True,
+        )
+    except (OSError, subprocess.CalledProcessError) as e:
+        print(f"{Fore.RED}addr2line failed ({e}), keeping raw addresses{Style.RESET_ALL}")
+        return names
+    # Two output lines per address: function, then file:line
+    output = result.stdout.splitlines()
+    for address, function in zip(ordered, output[0::2]):
+        if function and function != "??":
+            names[address] = function
+    return names
+
+
+def write_profile_reports(samples: list[tuple[int, int, int]], elf: str, addr2line: str, base: str) -> None:
+    """
+    Writes <base>_flat.txt (samples per function, most first) and <base>.folded ("caller;function count" lines
+    for flame graph tools), and prints the top of the flat profile.
+    """
+    # The return address points after the call; one byte back lands inside the call instruction
+    names = symbolize({pc for pc, _, _ in samples} | {caller - 1 for _, caller, _ in samples if caller}, elf,
+                      addr2line)
+    total = sum(count for _, _, count in samples)
+    if total == 0:
+        print(f"{Fore.YELLOW}Profile has no samples{Style.RESET_ALL}")
+        return
+    flat: Counter[str] = Counter()
+    folded: Counter[str] = Counter()
+    for pc, caller, count in samples:
+        function = names[pc]
+        flat[function] += count
+        if caller:
+            folded[f"{names[caller - 1]};{function}"] += count
+        else:
+            folded[function] += count
+
+    with open(f"{base}_flat.txt", "w", encoding="utf-8") as f:
+        for function, count in flat.most_common():
+            f.write(f"{count:8d} {100.0 * count / total:6.2f}%  {function}\n")
+    with open(f"{base}.folded", "w", encoding="utf-8") as f:
+        for stack, count in folded.most_common():
+            f.write(f"{stack} {count}\n")
+
+    print(f"{Fore.GREEN}{total} samples, {len(flat)} functions; wrote {base}_flat.txt and {base}.folded"
+          f"{Style.RESET_ALL}")
+    for function, count in flat.most_common(20):
+        print(f"{count:8d} {100.0 * count / total:6.2f}%  {function}")
+
+
+def save_profile(lines: list[str], header: str, kwargs: dict[str, str]) -> None:
+    """
+    Saves a captured CMD:PROFILE dump to profile.txt and, with --elf, symbolizes it.
+    """
+    with open("profile.txt", "w", encoding="utf-8") as f:
+        f.write(header + "\n")
+        f.write("\n".join(lines) + "\n")
+    print(f"{Fore.GREEN}Profile saved to profile.txt ({header}){Style.RESET_ALL}")
+    elf = kwargs.get("elf", "")
+    if elf:
+        write_profile_reports(parse_profile(lines), elf, kwargs.get("addr2line", ""), "profile")
+
+
+FRAME_HEADER = struct.Struct("<4sIIIIHHB3x")
+FRAME_PLANES = ["bw", "lsb", "msb"]
+
+
+def unpack_bits(data: bytes) -> bytes:
+    """
+    Decodes PackBits: a control byte n < 128 is followed by n + 1 literal bytes, n > 128 by one byte repeated
+    257 - n times.
+    """
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        n = data[i]
+        i += 1
+        if n < 128:
+            out += data[i : i + n + 1]
+            i += n + 1
+        elif n > 128:
+            out += bytes([data[i]]) * (257 - n)
+            i += 1
+    return bytes(out)
+
+
+def save_frame(record: bytes) -> None:
+    """
+    Saves one captured frame (FrameCapture.h) as frames/<sequence>_<plane>.bmp and appends its timestamp to
+    frames/index.csv, so page turn latencies can be read off the timestamps of consecutive frames.
+    """
+    magic, sequence, timestamp_us, dropped, payload_size, width, height, plane = FRAME_HEADER.unpack_from(record)
+    if magic != b"CPFR":
+        print(f"{Fore.RED}Frame with bad magic skipped{Style.RESET_ALL}")
+        return
+    pixels = unpack_bits(record[FRAME_HEADER.size : FRAME_HEADER.size + payload_size])
+    plane_name = FRAME_PLANES[plane] if plane < len(FRAME_PLANES) else str(plane)
+    os.makedirs("frames", exist_ok=True)
+    base = f"frames/{sequence:06d}_{plane_name}"
+    if Image and len(pixels) == width * height // 8:
+        # Same landscape layout as screenshots
+        Image.frombytes("1", (width, height), pixels).transpose(Image.ROTATE_270).save(base + ".bmp")
+    else:
+        with open(base + ".raw", "wb") as f:
+            f.write(pixels)
+    with open("frames/index.csv", "a", encoding="utf-8") as f:
+        f.write(f"{sequence},{plane_name},{timestamp_us},{dropped}\n")
+
+
 def serial_worker(ser, kwargs: dict[str, str]) -> None:
     """
     Runs in a background thread. Handles reading serial data, printing to console,
@@ -222,10 +368,23 @@ def serial_worker(ser, kwargs: dict[str, str]) -> None:
     expecting_screenshot = False
     screenshot_size = 0
     screenshot_data = b""
+    frame_size = 0
+    frame_data = b""
+    profile_header = ""
+    profile_lines: list[str] | None = None
 
     try:
         while not shutdown_event.is_set():
-            if expecting_screenshot:
+            if frame_size:
+                data = ser.read(frame_size - len(frame_data))
+                if not data:
+                    continue
+                frame_data += data
+                if len(frame_data) == frame_size:
+                    save_frame(frame_data)
+                    frame_size = 0
+                    frame_data = b""
+            elif expecting_screenshot:
                 data = ser.read(screenshot_size - len(screenshot_data))
                 if not data:
                     continue
@@ -264,6 +423,20 @@ def serial_worker(ser, kwargs: dict[str, str]) -> None:
                         continue
                     elif clean_line == "SCREENSHOT_END":
                         continue  # ignore
+                    elif clean_line.startswith("FRAME:"):
+                        frame_size = int(clean_line.split(":")[1])
+                        continue
+                    elif clean_line.startswith("PROFILE_START"):
+                        profile_header = clean_line
+                        profile_lines = []
+                        continue
+                    elif clean_line == "PROFILE_END" and profile_lines is not None:
+                        save_profile(profile_lines, profile_header, kwargs)
+                        profile_lines = None
+                        continue
+                    elif profile_lines is not None:
+                        profile_lines.append(clean_line)
+                        continue
 
                     # Add PC timestamp
                     pc_time = datetime.now().strftime("%H:%M:%S")
@@ -429,7 +602,33 @@ def main() -> None:
         default="",
         help="Suppress lines containing this keyword (case-insensitive)",
     )
+    parser.add_argument(
+        "--elf",
+        type=str,
+        default="",
+        help="firmware.elf of the running build, to symbolize CPU profiles (cpu_profile build)",
+    )
+    parser.add_argument(
+        "--addr2line",
+        type=str,
+        default="riscv32-esp-elf-addr2line",
+        help="addr2line of the ESP32-C3 toolchain (default: riscv32-esp-elf-addr2line on the PATH)",
+    )
+    parser.add_argument(
+        "--profile",
+        type=str,
+        default="",
+        help="Symbolize a saved CMD:PROFILE dump (needs --elf) and exit instead of monitoring",
+    )
     args = parser.parse_args()
+    if args.profile:
+        if not args.elf:
+            print(f"{Fore.RED}Error: --profile needs --elf{Style.RESET_ALL}")
+            sys.exit(1)
+        with open(args.profile, encoding="utf-8") as f:
+            samples = parse_profile(f.read().splitlines())
+        write_profile_reports(samples, args.elf, args.addr2line, args.profile.rsplit(".", 1)[0])
+        return
     port = args.port
     if port is None:
         port_list = get_auto_detected_port()
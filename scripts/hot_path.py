@@ -0,0 +1,109 @@
+"""
+PlatformIO extra script for [env:hot_path], see lib/HotPath/HotPath.h.
+
+- Builds the translation units that hold the HOT_PATH functions at -O2 instead of the framework's -Os, so their inner
+  loops get unrolled and inlined; everything else keeps its size-optimized build.
+- After linking, reports what ended up in IRAM: each HOT_PATH function with its size, their total against the budget
+  set by custom_hot_path_iram_budget, and the whole .iram0.text section. Fails the build when the hot functions
+  outgrow the budget, since every byte of IRAM is a byte less heap.
+
+Compare a hot_path build against default by running CMD:BENCH on both; run_NNN.csv names the firmware of each run.
+"""
+
+import os
+import subprocess
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+# Translation units built at -O2
+HOT_SOURCES = {"GfxRenderer.cpp", "ParsedText.cpp", "tinflate.c", "xmltok.c"}
+
+# Functions marked HOT_PATH, matched against the demangled symbol names
+HOT_FUNCTIONS = [
+    "GfxRenderer::drawPixel",
+    "renderCharImpl",
+    "blitGlyph",
+    "ParsedText::computeLineBreaks",
+    "tinf_inflate_block_data",
+    "tinf_copy_match",
+    "normal_contentTok",
+    "normal_scanLt",
+    "normal_scanAtts",
+    "normal_scanEndTag",
+    "normal_getAtts",
+]
+
+DEFAULT_BUDGET = 16 * 1024
+
+
+def strip_optimization(flags):
+    return [flag for flag in flags if not (isinstance(flag, str) and flag.startswith("-O"))]
+
+
+def optimize_hot_source(env, node):
+    if os.path.basename(node.get_path()) not in HOT_SOURCES:
+        return node
+    return env.Object(
+        node,
+        CCFLAGS=strip_optimization(env["CCFLAGS"]) + ["-O2"],
+        CFLAGS=strip_optimization(env.get("CFLAGS", [])),
+        CXXFLAGS=strip_optimization(env.get("CXXFLAGS", [])),
+    )
+
+
+def run_tool(env, tool, *args):
+    result = subprocess.run([tool, *args], capture_output=True, text=True, env=env["ENV"])
+    if result.returncode != 0:
+        raise RuntimeError(f"{tool} failed: {result.stderr.strip()}")
+    return result.stdout
+
+
+def section_range(env, elf, name):
+    for line in run_tool(env, env.subst("$SIZETOOL"), "-A", elf).splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[0] == name:
+            return int(parts[2]), int(parts[1])
+    return None
+
+
+def report_iram(target, source, env):
+    elf = str(target[0])
+    nm = env.subst("$CC")[: -len("gcc")] + "nm"
+    budget = int(env.GetProjectOption("custom_hot_path_iram_budget", str(DEFAULT_BUDGET)), 0)
+
+    iram = section_range(env, elf, ".iram0.text")
+    if not iram:
+        print("hot_path: no .iram0.text section in the firmware")
+        env.Exit(1)
+    start, size = iram
+
+    placed = []
+    missing = set(HOT_FUNCTIONS)
+    for line in run_tool(env, nm, "-S", "-C", "--defined-only", elf).splitlines():
+        parts = line.split(maxsplit=3)
+        if len(parts) < 4 or parts[2] not in "tT":
+            continue
+        name = parts[3]
+        match = next((hot for hot in HOT_FUNCTIONS if hot in name), None)
+        if not match:
+            continue
+        address = int(parts[0], 16)
+        if start <= address < start + size:
+            placed.append((int(parts[1], 16), name))
+            missing.discard(match)
+
+    total = sum(symbol_size for symbol_size, _ in placed)
+    print(f"hot_path: {total} of {budget} bytes of IRAM budget in {len(placed)} function(s)")
+    for symbol_size, name in sorted(placed, reverse=True):
+        print(f"  {symbol_size:6d}  {name}")
+    print(f"hot_path: .iram0.text is {size} bytes in total")
+    # Inlined into a caller (then it runs from IRAM as part of it), or the HOT_PATH attribute is gone
+    for name in sorted(missing):
+        print(f"hot_path: warning: {name} is not in IRAM")
+    if total > budget:
+        print(f"hot_path: hot functions exceed custom_hot_path_iram_budget by {total - budget} bytes")
+        env.Exit(1)
+
+
+env.AddBuildMiddleware(optimize_hot_source)
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report_iram)
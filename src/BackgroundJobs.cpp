@@ -0,0 +1,124 @@
+#include "BackgroundJobs.h"
+
+#include <Arduino.h>
+#include <HalPowerManager.h>
+#include <HalStorage.h>
+#include <Logging.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+
+#include "activities/RenderLock.h"
+
+BackgroundJobs BackgroundJobs::instance;
+
+namespace {
+constexpr uint32_t WORKER_STACK_SIZE = 8192;  // Section builds run on it, and layout runs deep
+
+SemaphoreHandle_t mutex() {
+  static SemaphoreHandle_t handle = xSemaphoreCreateMutex();
+  return handle;
+}
+
+class Guard {
+ public:
+  Guard() { xSemaphoreTake(mutex(), portMAX_DELAY); }
+  ~Guard() { xSemaphoreGive(mutex()); }
+  Guard(const Guard&) = delete;
+  Guard& operator=(const Guard&) = delete;
+};
+}  // namespace
+
+bool BackgroundJobs::submit(BackgroundJob& job, const BackgroundJob::Priority priority) {
+  Guard guard;
+  if (std::find(queue.begin(), queue.end(), &job) != queue.end()) {
+    return false;
+  }
+  job.priority = priority;
+  job.cancelled = false;
+  queue.push_back(&job);
+
+  if (!workerRunning) {
+    workerRunning = true;
+    const BaseType_t created = xTaskCreate(
+        [](void* param) {
+          static_cast<BackgroundJobs*>(param)->run();
+          vTaskDelete(nullptr);
+        },
+        "BgJobs", WORKER_STACK_SIZE, this, 0, nullptr);
+    if (created != pdPASS) {
+      LOG_ERR("JOB", "Failed to create worker task");
+      workerRunning = false;
+      queue.pop_back();
+      return false;
+    }
+  }
+  return true;
+}
+
+void BackgroundJobs::cancel(BackgroundJob& job) {
+  job.cancelled = true;
+  while (true) {
+    {
+      Guard guard;
+      if (current != &job) {
+        queue.erase(std::remove(queue.begin(), queue.end(), &job), queue.end());
+        return;
+      }
+    }
+    delay(5);
+  }
+}
+
+bool BackgroundJobs::isQueued(const BackgroundJob& job) const {
+  Guard guard;
+  return std::find(queue.begin(), queue.end(), &job) != queue.end();
+}
+
+bool BackgroundJobs::getCurrent(const char*& name, int& progress) const {
+  Guard guard;
+  if (!current) {
+    return false;
+  }
+  name = current->name;
+  progress = current->progress;
+  return true;
+}
+
+BackgroundJob* BackgroundJobs::takeNext() {
+  Guard guard;
+  // The first of the highest priority, so equal jobs keep their order
+  BackgroundJob* next = nullptr;
+  for (auto* job : queue) {
+    if (!next || job->priority > next->priority) {
+      next = job;
+    }
+  }
+  current = next;
+  if (!next) {
+    workerRunning = false;
+  }
+  return next;
+}
+
+void BackgroundJobs::run() {
+  HalStorage::IoClassScope ioClass(HalStorage::IoClass::Background);
+  HalPowerManager::Lock powerLock;
+
+  while (auto* job = takeNext()) {
+    // Stand aside while a page is being rendered, jobs read and write the same caches
+    while (RenderLock::peek() && !job->cancelled) {
+      delay(5);
+    }
+    const bool more = !job->cancelled && job->step();
+
+    Guard guard;
+    if (!more) {
+      LOG_DBG("JOB", "%s %s", job->name, job->cancelled ? "cancelled" : "done");
+      queue.erase(std::remove(queue.begin(), queue.end(), job), queue.end());
+    }
+    current = nullptr;
+  }
+}
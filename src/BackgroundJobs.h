@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Work that runs in the background while the UI stays responsive: laying out the rest of a book, indexing a library,
+// warming caches. A job does its work in short steps; between steps the worker checks for cancellation, picks the
+// most urgent job and stands aside while a page is rendered.
+class BackgroundJob {
+ public:
+  // Higher runs first; jobs of the same priority run in the order they were submitted
+  enum class Priority : uint8_t { Low, Normal, High };
+
+  explicit BackgroundJob(const char* name) : name(name) {}
+  virtual ~BackgroundJob() = default;
+
+  BackgroundJob(const BackgroundJob&) = delete;
+  BackgroundJob& operator=(const BackgroundJob&) = delete;
+
+  const char* getName() const { return name; }
+  // Set once the job is cancelled; a long step should check it and return early
+  bool isCancelled() const { return cancelled; }
+  // Share of the work done (0-100), for a progress line; -1 while it isn't known
+  int getProgress() const { return progress; }
+
+ protected:
+  // One slice of the work, on the worker task. Return true while there is more to do. Keep it short (tens of
+  // milliseconds) so a cancel or a more urgent job doesn't wait long. A cancelled job gets no further step.
+  virtual bool step() = 0;
+
+  void setProgress(const size_t done, const size_t total) {
+    progress = total > 0 ? static_cast<int>(static_cast<uint64_t>(done) * 100 / total) : -1;
+  }
+
+ private:
+  friend class BackgroundJobs;
+
+  const char* name;
+  Priority priority = Priority::Normal;
+  std::atomic<bool> cancelled{false};
+  std::atomic<int> progress{-1};
+};
+
+// The single worker task running every BackgroundJob. It runs at priority 0, below both the main loop and the render
+// task, so jobs only get the CPU while the device waits for input, and never while the render task holds its lock.
+// While it has work the worker holds a HalPowerManager::Lock, does its storage I/O in the background class and keeps
+// the device from auto sleep (see ActivityManager::preventAutoSleep); it exits once the queue is empty.
+//
+// Jobs are owned by whoever submits them. The owner must cancel() a job before destroying it, unless it has seen the
+// job finish.
+class BackgroundJobs {
+  static BackgroundJobs instance;
+
+ public:
+  static BackgroundJobs& getInstance() { return instance; }
+
+  // Queue a job; false if it is already queued or the worker couldn't be started
+  bool submit(BackgroundJob& job, BackgroundJob::Priority priority = BackgroundJob::Priority::Normal);
+  // Drop a job and wait until the worker has let go of it; a step under way runs to its end. Nothing happens if the
+  // job isn't queued.
+  void cancel(BackgroundJob& job);
+  bool isQueued(const BackgroundJob& job) const;
+  // Any job queued or running
+  bool isBusy() const { return workerRunning; }
+  // Job being worked on and its progress, for a status line. False when idle.
+  bool getCurrent(const char*& name, int& progress) const;
+
+ private:
+  // Guarded by a mutex: jobs are submitted and cancelled from the main loop while the worker takes them
+  std::vector<BackgroundJob*> queue;
+  BackgroundJob* current = nullptr;
+  std::atomic<bool> workerRunning{false};
+
+  // Most urgent queued job, made current; nullptr (and the worker marked as stopped) once there is none
+  BackgroundJob* takeNext();
+  void run();
+};
+
+#define BACKGROUND_JOBS BackgroundJobs::getInstance()
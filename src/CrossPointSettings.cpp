@@ -4,10 +4,12 @@
 #include <JsonSettingsIO.h>
 #include <Logging.h>
 #include <Serialization.h>
+#include <SettingsSnapshot.h>
 
 #include <cstring>
 #include <string>
 
+#include "SdFontStore.h"
 #include "fontIds.h"
 
 // Initialize the static instance
@@ -26,6 +28,7 @@ constexpr uint8_t SETTINGS_FILE_VERSION = 1;
 constexpr char SETTINGS_FILE_BIN[] = "/.crosspoint/settings.bin";
 constexpr char SETTINGS_FILE_JSON[] = "/.crosspoint/settings.json";
 constexpr char SETTINGS_FILE_BAK[] = "/.crosspoint/settings.bin.bak";
+constexpr char SETTINGS_FILE_SNAPSHOT[] = "/.crosspoint/settings.snap";
 
 // Convert legacy front button layout into explicit logical->hardware mapping.
 void applyLegacyFrontButtonLayout(CrossPointSettings& settings) {
@@ -78,11 +81,20 @@ void CrossPointSettings::validateFrontButtonMapping(CrossPointSettings& settings
 
 bool CrossPointSettings::saveToFile() const {
   Storage.mkdir("/.crosspoint");
-  return JsonSettingsIO::saveSettings(*this, SETTINGS_FILE_JSON);
+  SettingsSnapshot::invalidate(SETTINGS_FILE_SNAPSHOT);
+  if (!JsonSettingsIO::saveSettings(*this, SETTINGS_FILE_JSON)) {
+    return false;
+  }
+  SettingsSnapshot::saveSettings(*this, SETTINGS_FILE_JSON, SETTINGS_FILE_SNAPSHOT);
+  return true;
 }
 
 bool CrossPointSettings::loadFromFile() {
-  // Try JSON first
+  if (SettingsSnapshot::loadSettings(*this, SETTINGS_FILE_JSON, SETTINGS_FILE_SNAPSHOT)) {
+    return true;
+  }
+
+  // Then JSON, which also refreshes the snapshot for the next boot
   if (Storage.exists(SETTINGS_FILE_JSON)) {
     String json = Storage.readFile(SETTINGS_FILE_JSON);
     if (!json.isEmpty()) {
@@ -94,6 +106,8 @@ bool CrossPointSettings::loadFromFile() {
         } else {
           LOG_ERR("CPS", "Failed to resave settings after format update");
         }
+      } else if (result) {
+        SettingsSnapshot::saveSettings(*this, SETTINGS_FILE_JSON, SETTINGS_FILE_SNAPSHOT);
       }
       return result;
     }
@@ -293,8 +307,30 @@ int CrossPointSettings::getRefreshFrequency() const {
   }
 }
 
+uint32_t CrossPointSettings::getReadingCacheLimitBytes() const {
+  switch (readingCacheLimit) {
+    case CACHE_UNLIMITED:
+    default:
+      return 0;
+    case CACHE_256_MB:
+      return 256UL * 1024 * 1024;
+    case CACHE_512_MB:
+      return 512UL * 1024 * 1024;
+    case CACHE_1_GB:
+      return 1024UL * 1024 * 1024;
+    case CACHE_2_GB:
+      return 2048UL * 1024 * 1024;
+  }
+}
+
 int CrossPointSettings::getReaderFontId() const {
   switch (fontFamily) {
+    case SD_CARD:
+      // SD card fonts come in one size; the size setting only applies to the Bookerly fallback
+      if (const int sdFontId = SD_FONTS.getFontId()) {
+        return sdFontId;
+      }
+      [[fallthrough]];
     case BOOKERLY:
     default:
       switch (fontSize) {
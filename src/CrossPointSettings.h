@@ -92,7 +92,8 @@ class CrossPointSettings {
   enum SIDE_BUTTON_LAYOUT { PREV_NEXT = 0, NEXT_PREV = 1, SIDE_BUTTON_LAYOUT_COUNT };
 
   // Font family options
-  enum FONT_FAMILY { BOOKERLY = 0, NOTOSANS = 1, OPENDYSLEXIC = 2, FONT_FAMILY_COUNT };
+  // SD_CARD reads /fonts/<sdFontName> (see SdFontStore) and falls back to Bookerly when that fails
+  enum FONT_FAMILY { BOOKERLY = 0, NOTOSANS = 1, OPENDYSLEXIC = 2, SD_CARD = 3, FONT_FAMILY_COUNT };
   // Font size options
   enum FONT_SIZE { SMALL = 0, MEDIUM = 1, LARGE = 2, EXTRA_LARGE = 3, FONT_SIZE_COUNT };
   enum LINE_COMPRESSION { TIGHT = 0, NORMAL = 1, WIDE = 2, LINE_COMPRESSION_COUNT };
@@ -131,6 +132,17 @@ class CrossPointSettings {
   // Hide battery percentage
   enum HIDE_BATTERY_PERCENTAGE { HIDE_NEVER = 0, HIDE_READER = 1, HIDE_ALWAYS = 2, HIDE_BATTERY_PERCENTAGE_COUNT };
 
+  // SD space the books' rebuildable caches (chapter layouts, extracted images) may take before the least recently
+  // read books lose theirs
+  enum READING_CACHE_LIMIT {
+    CACHE_UNLIMITED = 0,
+    CACHE_256_MB = 1,
+    CACHE_512_MB = 2,
+    CACHE_1_GB = 3,
+    CACHE_2_GB = 4,
+    READING_CACHE_LIMIT_COUNT
+  };
+
   // UI Theme
   enum UI_THEME { CLASSIC = 0, LYRA = 1, LYRA_3_COVERS = 2 };
 
@@ -182,6 +194,8 @@ class CrossPointSettings {
   char opdsServerUrl[128] = "";
   char opdsUsername[64] = "";
   char opdsPassword[64] = "";
+  // Folder under /fonts used by the SD_CARD font family; empty picks the first one
+  char sdFontName[32] = "";
   // Hide battery percentage
   uint8_t hideBatteryPercentage = HIDE_NEVER;
   // Long-press chapter skip on side buttons
@@ -192,6 +206,10 @@ class CrossPointSettings {
   uint8_t fadingFix = 0;
   // Use book's embedded CSS styles for EPUB rendering (1 = enabled, 0 = disabled)
   uint8_t embeddedStyle = 1;
+  // Render the next page into a compressed spare buffer after each page turn (1 = enabled, 0 = disabled)
+  uint8_t pageAheadRender = 0;
+  // Reading cache budget, see BookCacheIndex
+  uint8_t readingCacheLimit = CACHE_UNLIMITED;
 
   ~CrossPointSettings() = default;
 
@@ -218,6 +236,8 @@ class CrossPointSettings {
   float getReaderLineCompression() const;
   unsigned long getSleepTimeoutMs() const;
   int getRefreshFrequency() const;
+  // 0 when unlimited
+  uint32_t getReadingCacheLimitBytes() const;
 };
 
 // Helper macro to access settings
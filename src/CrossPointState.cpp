@@ -4,27 +4,42 @@
 #include <JsonSettingsIO.h>
 #include <Logging.h>
 #include <Serialization.h>
+#include <SettingsSnapshot.h>
 
 namespace {
 constexpr uint8_t STATE_FILE_VERSION = 4;
 constexpr char STATE_FILE_BIN[] = "/.crosspoint/state.bin";
 constexpr char STATE_FILE_JSON[] = "/.crosspoint/state.json";
 constexpr char STATE_FILE_BAK[] = "/.crosspoint/state.bin.bak";
+constexpr char STATE_FILE_SNAPSHOT[] = "/.crosspoint/state.snap";
 }  // namespace
 
 CrossPointState CrossPointState::instance;
 
 bool CrossPointState::saveToFile() const {
   Storage.mkdir("/.crosspoint");
-  return JsonSettingsIO::saveState(*this, STATE_FILE_JSON);
+  SettingsSnapshot::invalidate(STATE_FILE_SNAPSHOT);
+  if (!JsonSettingsIO::saveState(*this, STATE_FILE_JSON)) {
+    return false;
+  }
+  SettingsSnapshot::saveState(*this, STATE_FILE_JSON, STATE_FILE_SNAPSHOT);
+  return true;
 }
 
 bool CrossPointState::loadFromFile() {
-  // Try JSON first
+  if (SettingsSnapshot::loadState(*this, STATE_FILE_JSON, STATE_FILE_SNAPSHOT)) {
+    return true;
+  }
+
+  // Then JSON, which also refreshes the snapshot for the next boot
   if (Storage.exists(STATE_FILE_JSON)) {
     String json = Storage.readFile(STATE_FILE_JSON);
     if (!json.isEmpty()) {
-      return JsonSettingsIO::loadState(*this, json.c_str());
+      if (!JsonSettingsIO::loadState(*this, json.c_str())) {
+        return false;
+      }
+      SettingsSnapshot::saveState(*this, STATE_FILE_JSON, STATE_FILE_SNAPSHOT);
+      return true;
     }
   }
 
@@ -5,6 +5,7 @@
 #include <Logging.h>
 #include <ObfuscationUtils.h>
 
+#include <cstdio>
 #include <cstring>
 
 #include "CrossPointSettings.h"
@@ -119,12 +120,15 @@ bool JsonSettingsIO::saveSettings(const CrossPointSettings& s, const char* path)
   doc["opdsServerUrl"] = s.opdsServerUrl;
   doc["opdsUsername"] = s.opdsUsername;
   doc["opdsPassword_obf"] = obfuscation::obfuscateToBase64(s.opdsPassword);
+  doc["sdFontName"] = s.sdFontName;
   doc["hideBatteryPercentage"] = s.hideBatteryPercentage;
   doc["longPressChapterSkip"] = s.longPressChapterSkip;
   doc["hyphenationEnabled"] = s.hyphenationEnabled;
   doc["uiTheme"] = s.uiTheme;
   doc["fadingFix"] = s.fadingFix;
   doc["embeddedStyle"] = s.embeddedStyle;
+  doc["pageAheadRender"] = s.pageAheadRender;
+  doc["readingCacheLimit"] = s.readingCacheLimit;
   doc["statusBarChapterPageCount"] = s.statusBarChapterPageCount;
   doc["statusBarBookProgressPercentage"] = s.statusBarBookProgressPercentage;
   doc["statusBarProgressBar"] = s.statusBarProgressBar;
@@ -186,11 +190,18 @@ bool JsonSettingsIO::loadSettings(CrossPointSettings& s, const char* json, bool*
   s.uiTheme = doc["uiTheme"] | (uint8_t)S::LYRA;
   s.fadingFix = doc["fadingFix"] | (uint8_t)0;
   s.embeddedStyle = doc["embeddedStyle"] | (uint8_t)1;
+  s.pageAheadRender = doc["pageAheadRender"] | (uint8_t)0;
+  s.readingCacheLimit =
+      clamp(doc["readingCacheLimit"] | (uint8_t)S::CACHE_UNLIMITED, S::READING_CACHE_LIMIT_COUNT, S::CACHE_UNLIMITED);
 
   const char* url = doc["opdsServerUrl"] | "";
   strncpy(s.opdsServerUrl, url, sizeof(s.opdsServerUrl) - 1);
   s.opdsServerUrl[sizeof(s.opdsServerUrl) - 1] = '\0';
 
+  const char* sdFont = doc["sdFontName"] | "";
+  strncpy(s.sdFontName, sdFont, sizeof(s.sdFontName) - 1);
+  s.sdFontName[sizeof(s.sdFontName) - 1] = '\0';
+
   const char* user = doc["opdsUsername"] | "";
   strncpy(s.opdsUsername, user, sizeof(s.opdsUsername) - 1);
   s.opdsUsername[sizeof(s.opdsUsername) - 1] = '\0';
@@ -269,6 +280,13 @@ bool JsonSettingsIO::saveWifi(const WifiCredentialStore& store, const char* path
     JsonObject obj = arr.add<JsonObject>();
     obj["ssid"] = cred.ssid;
     obj["password_obf"] = obfuscation::obfuscateToBase64(cred.password);
+    if (cred.channel > 0) {
+      char bssid[18];
+      snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x", cred.bssid[0], cred.bssid[1], cred.bssid[2],
+               cred.bssid[3], cred.bssid[4], cred.bssid[5]);
+      obj["bssid"] = bssid;
+      obj["channel"] = cred.channel;
+    }
   }
 
   String json;
@@ -299,6 +317,12 @@ bool JsonSettingsIO::loadWifi(WifiCredentialStore& store, const char* json, bool
       cred.password = obj["password"] | std::string("");
       if (!cred.password.empty() && needsResave) *needsResave = true;
     }
+    unsigned int bssid[6];
+    if (sscanf(obj["bssid"] | "", "%x:%x:%x:%x:%x:%x", &bssid[0], &bssid[1], &bssid[2], &bssid[3], &bssid[4],
+               &bssid[5]) == 6) {
+      for (int i = 0; i < 6; i++) cred.bssid[i] = static_cast<uint8_t>(bssid[i]);
+      cred.channel = obj["channel"] | 0;
+    }
     store.credentials.push_back(cred);
   }
 
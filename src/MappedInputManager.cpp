@@ -1,6 +1,13 @@
 #include "MappedInputManager.h"
 
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
 #include "CrossPointSettings.h"
+#include "activities/RenderLock.h"
 
 namespace {
 using ButtonIndex = uint8_t;
@@ -15,43 +22,259 @@ constexpr SideLayoutMap kSideLayouts[] = {
     {HalGPIO::BTN_UP, HalGPIO::BTN_DOWN},
     {HalGPIO::BTN_DOWN, HalGPIO::BTN_UP},
 };
+
+// Input script button names, by physical button index
+constexpr const char* kScriptButtons[] = {"BACK", "CONFIRM", "LEFT", "RIGHT", "UP", "DOWN", "POWER"};
+// Idle time after the last event of a replay before it counts as done, so the screen it leads to is drawn
+constexpr unsigned long REPLAY_SETTLE_MS = 500;
 }  // namespace
 
-bool MappedInputManager::mapButton(const Button button, bool (HalGPIO::*fn)(uint8_t) const) const {
+uint8_t MappedInputManager::physicalButton(const Button button) const {
   const auto sideLayout = static_cast<CrossPointSettings::SIDE_BUTTON_LAYOUT>(SETTINGS.sideButtonLayout);
   const auto& side = kSideLayouts[sideLayout];
 
   switch (button) {
     case Button::Back:
       // Logical Back maps to user-configured front button.
-      return (gpio.*fn)(SETTINGS.frontButtonBack);
+      return SETTINGS.frontButtonBack;
     case Button::Confirm:
       // Logical Confirm maps to user-configured front button.
-      return (gpio.*fn)(SETTINGS.frontButtonConfirm);
+      return SETTINGS.frontButtonConfirm;
     case Button::Left:
       // Logical Left maps to user-configured front button.
-      return (gpio.*fn)(SETTINGS.frontButtonLeft);
+      return SETTINGS.frontButtonLeft;
     case Button::Right:
       // Logical Right maps to user-configured front button.
-      return (gpio.*fn)(SETTINGS.frontButtonRight);
+      return SETTINGS.frontButtonRight;
     case Button::Up:
       // Side buttons remain fixed for Up/Down.
-      return (gpio.*fn)(HalGPIO::BTN_UP);
+      return HalGPIO::BTN_UP;
     case Button::Down:
       // Side buttons remain fixed for Up/Down.
-      return (gpio.*fn)(HalGPIO::BTN_DOWN);
+      return HalGPIO::BTN_DOWN;
     case Button::Power:
       // Power button bypasses remapping.
-      return (gpio.*fn)(HalGPIO::BTN_POWER);
+      return HalGPIO::BTN_POWER;
     case Button::PageBack:
       // Reader page navigation uses side buttons and can be swapped via settings.
-      return (gpio.*fn)(side.pageBack);
+      return side.pageBack;
     case Button::PageForward:
       // Reader page navigation uses side buttons and can be swapped via settings.
-      return (gpio.*fn)(side.pageForward);
+      return side.pageForward;
+  }
+
+  return BUTTON_COUNT;
+}
+
+bool MappedInputManager::mapButton(const Button button, bool (HalGPIO::*fn)(uint8_t) const) const {
+  const uint8_t physical = physicalButton(button);
+  return physical < BUTTON_COUNT && (gpio.*fn)(physical);
+}
+
+void MappedInputManager::update() {
+  if (replaying) {
+    advanceReplay(millis());
+  }
+  gpio.update();
+  if (replaying && gpio.wasHardwarePressed()) {
+    LOG_INF("INP", "Replay stopped by a button press");
+    stopReplay();
+  }
+
+  const unsigned long now = millis();
+  if (recordFile) {
+    recordEvents(now);
+  }
+  for (uint8_t button = 0; button < BUTTON_COUNT; button++) {
+    if (gpio.wasPressed(button)) {
+      queuePress(button, false, now);
+      nextRepeatMs[button] = now + REPEAT_DELAY_MS;
+      repeatIntervalMs[button] = REPEAT_START_INTERVAL_MS;
+    } else if (!gpio.isPressed(button)) {
+      repeatIntervalMs[button] = 0;
+    } else if (repeatIntervalMs[button] != 0 && static_cast<long>(now - nextRepeatMs[button]) >= 0) {
+      queuePress(button, true, now);
+      // Speed up by a quarter per repeat, so a long hold pages quickly without overshooting a short one
+      repeatIntervalMs[button] = std::max(REPEAT_MIN_INTERVAL_MS, repeatIntervalMs[button] * 3 / 4);
+      nextRepeatMs[button] = now + repeatIntervalMs[button];
+    }
+  }
+}
+
+void MappedInputManager::queuePress(const uint8_t button, const bool repeat, const unsigned long now) {
+  if (pressCount == PRESS_QUEUE_SIZE) {
+    // Drop the oldest
+    std::copy(presses + 1, presses + pressCount, presses);
+    pressCount--;
   }
+  presses[pressCount++] = {now, button, repeat};
+}
 
-  return false;
+int MappedInputManager::takePresses(const Button button, const bool repeat) {
+  const uint8_t physical = physicalButton(button);
+  const unsigned long now = millis();
+  int taken = 0;
+  size_t kept = 0;
+  for (size_t i = 0; i < pressCount; i++) {
+    const Press& press = presses[i];
+    if (now - press.timeMs > MAX_PRESS_AGE_MS) {
+      continue;
+    }
+    if (press.button == physical) {
+      if (repeat || !press.repeat) {
+        taken++;
+      }
+      continue;
+    }
+    presses[kept++] = press;
+  }
+  pressCount = kept;
+  return taken;
+}
+
+void MappedInputManager::clearPresses() { pressCount = 0; }
+
+bool MappedInputManager::startRecording(const std::string& path) {
+  stopRecording();
+  if (replaying) {
+    return false;
+  }
+  const size_t slash = path.rfind('/');
+  if (slash != std::string::npos && slash > 0) {
+    Storage.ensureDirectoryExists(path.substr(0, slash).c_str());
+  }
+  if (!Storage.openFileForWrite("INP", path, recordFile)) {
+    return false;
+  }
+  recordFile.setBufferSize(FsFile::DEFAULT_BUFFER_SIZE);
+  static constexpr char header[] = "# <ms since the event before> <button> <down|up>\n";
+  recordFile.write(header, sizeof(header) - 1);
+  lastRecordedMs = millis();
+  LOG_INF("INP", "Recording input to %s", path.c_str());
+  return true;
+}
+
+void MappedInputManager::stopRecording() {
+  if (!recordFile) {
+    return;
+  }
+  recordFile.close();
+  LOG_INF("INP", "Recording stopped");
+}
+
+void MappedInputManager::recordEvents(const unsigned long now) {
+  for (uint8_t button = 0; button < BUTTON_COUNT; button++) {
+    const bool down = gpio.wasPressed(button);
+    if (!down && !gpio.wasReleased(button)) {
+      continue;
+    }
+    char line[32];
+    const int length = snprintf(line, sizeof(line), "%lu %s %s\n", now - lastRecordedMs, kScriptButtons[button],
+                                down ? "down" : "up");
+    recordFile.write(line, length);
+    lastRecordedMs = now;
+  }
+}
+
+bool MappedInputManager::startReplay(const std::string& path) {
+  stopReplay();
+  stopRecording();
+  const String text = Storage.readFile(path.c_str());
+  if (text.isEmpty()) {
+    LOG_ERR("INP", "No input script at %s", path.c_str());
+    return false;
+  }
+
+  script.clear();
+  const char* pos = text.c_str();
+  int lineNumber = 0;
+  while (*pos) {
+    const char* end = strchr(pos, '\n');
+    const size_t length = end ? end - pos : strlen(pos);
+    char line[64];
+    snprintf(line, sizeof(line), "%.*s", static_cast<int>(length), pos);
+    pos += length + (end ? 1 : 0);
+    lineNumber++;
+    if (line[0] == '#' || line[strspn(line, " \t\r")] == '\0') {
+      continue;
+    }
+
+    unsigned long gap = 0;
+    char name[16] = "";
+    char action[8] = "";
+    ScriptEvent event{};
+    event.button = BUTTON_COUNT;
+    if (sscanf(line, "%lu %15s %7s", &gap, name, action) == 3) {
+      for (uint8_t button = 0; button < BUTTON_COUNT; button++) {
+        if (strcasecmp(name, kScriptButtons[button]) == 0) {
+          event.button = button;
+        }
+      }
+    }
+    event.down = strcasecmp(action, "down") == 0;
+    if (event.button == BUTTON_COUNT || (!event.down && strcasecmp(action, "up") != 0)) {
+      LOG_ERR("INP", "Bad event on line %d of %s", lineNumber, path.c_str());
+      script.clear();
+      return false;
+    }
+    if (script.size() == MAX_SCRIPT_EVENTS) {
+      LOG_ERR("INP", "Input script longer than %zu events, the rest is ignored", MAX_SCRIPT_EVENTS);
+      break;
+    }
+    event.gapMs = gap;
+    script.push_back(event);
+  }
+  if (script.empty()) {
+    return false;
+  }
+
+  scriptPos = 0;
+  scriptMask = 0;
+  waitStartMs = replayStartMs = millis();
+  replaying = true;
+  gpio.setScriptedState(true);
+  clearPresses();
+  LOG_INF("INP", "Replaying %zu events from %s", script.size(), path.c_str());
+  return true;
+}
+
+void MappedInputManager::stopReplay() {
+  if (!replaying) {
+    return;
+  }
+  replaying = false;
+  script.clear();
+  script.shrink_to_fit();
+  gpio.setScriptedState(false);
+}
+
+void MappedInputManager::advanceReplay(const unsigned long now) {
+  // Waits only count while nothing is being drawn
+  if (RenderLock::peek()) {
+    waitStartMs = now;
+    return;
+  }
+  if (scriptPos == script.size()) {
+    if (now - waitStartMs >= REPLAY_SETTLE_MS) {
+      LOG_INF("INP", "Replay finished in %lu ms", waitStartMs - replayStartMs);
+      stopReplay();
+    }
+    return;
+  }
+
+  // One event per update, so a press and its release are seen in separate loop passes
+  const ScriptEvent& event = script[scriptPos];
+  if (now - waitStartMs < event.gapMs) {
+    return;
+  }
+  if (event.down) {
+    scriptMask |= 1 << event.button;
+  } else {
+    scriptMask &= ~(1 << event.button);
+  }
+  gpio.setScriptedState(true, scriptMask);
+  scriptPos++;
+  waitStartMs = now;
 }
 
 bool MappedInputManager::wasPressed(const Button button) const { return mapButton(button, &HalGPIO::wasPressed); }
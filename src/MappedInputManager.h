@@ -1,6 +1,10 @@
 #pragma once
 
 #include <HalGPIO.h>
+#include <HalStorage.h>
+
+#include <string>
+#include <vector>
 
 class MappedInputManager {
  public:
@@ -15,7 +19,8 @@ class MappedInputManager {
 
   explicit MappedInputManager(HalGPIO& gpio) : gpio(gpio) {}
 
-  void update() const { gpio.update(); }
+  // Poll the buttons, and queue the presses they saw with their time (see takePresses)
+  void update();
   bool wasPressed(Button button) const;
   bool wasReleased(Button button) const;
   bool isPressed(Button button) const;
@@ -26,8 +31,66 @@ class MappedInputManager {
   // Returns the raw front button index that was pressed this frame (or -1 if none).
   int getPressedFrontButton() const;
 
+  // Number of presses of button queued since it was last taken, removing them. Unlike wasPressed, presses are kept
+  // across loop() iterations, so a caller that was busy can act on all of them in one step (the reader turns N pages
+  // at once). With repeat, holding the button also counts as pressing it again: first after REPEAT_DELAY_MS, then at
+  // a rate that speeds up the longer it is held. Presses older than MAX_PRESS_AGE_MS are dropped.
+  int takePresses(Button button, bool repeat = false);
+  // Forget the queued presses, so a new screen doesn't act on presses meant for the previous one
+  void clearPresses();
+
+  // Input scripts, for repeatable performance runs (serial CMD:REC, CMD:PLAY). A script is a text file of button
+  // events, one per line: the milliseconds since the event before, the physical button (BACK, CONFIRM, LEFT, RIGHT,
+  // UP, DOWN, POWER) and "down" or "up"; lines starting with '#' are comments. Recording writes every press and
+  // release to path until stopRecording(). Replaying feeds the events to the buttons in place of the hardware; the
+  // wait before an event only runs while nothing is being rendered, so a slower card or build doesn't make a press
+  // land on a screen that isn't up yet. Any real button press ends a replay.
+  bool startRecording(const std::string& path);
+  void stopRecording();
+  bool startReplay(const std::string& path);
+  void stopReplay();
+  bool isReplaying() const { return replaying; }
+
  private:
+  static constexpr uint8_t BUTTON_COUNT = HalGPIO::BTN_POWER + 1;
+  static constexpr size_t PRESS_QUEUE_SIZE = 16;
+  static constexpr unsigned long MAX_PRESS_AGE_MS = 1000;
+  static constexpr unsigned long REPEAT_DELAY_MS = 500;
+  static constexpr unsigned long REPEAT_START_INTERVAL_MS = 300;
+  static constexpr unsigned long REPEAT_MIN_INTERVAL_MS = 80;
+
+  struct Press {
+    unsigned long timeMs;
+    uint8_t button;  // Physical button index
+    bool repeat;
+  };
+
   HalGPIO& gpio;
+  Press presses[PRESS_QUEUE_SIZE] = {};
+  size_t pressCount = 0;  // Queued presses, oldest first
+  unsigned long nextRepeatMs[BUTTON_COUNT] = {};
+  unsigned long repeatIntervalMs[BUTTON_COUNT] = {};
 
+  uint8_t physicalButton(Button button) const;
   bool mapButton(Button button, bool (HalGPIO::*fn)(uint8_t) const) const;
+  void queuePress(uint8_t button, bool repeat, unsigned long now);
+
+  struct ScriptEvent {
+    uint32_t gapMs;
+    uint8_t button;
+    bool down;
+  };
+  static constexpr size_t MAX_SCRIPT_EVENTS = 4096;
+
+  FsFile recordFile;
+  unsigned long lastRecordedMs = 0;
+  std::vector<ScriptEvent> script;
+  size_t scriptPos = 0;
+  uint8_t scriptMask = 0;
+  unsigned long waitStartMs = 0;  // When the gap before the next event started counting
+  unsigned long replayStartMs = 0;
+  bool replaying = false;
+
+  void recordEvents(unsigned long now);
+  void advanceReplay(unsigned long now);
 };
@@ -0,0 +1,223 @@
+#include "ProgressJournal.h"
+
+#include <Arduino.h>
+#include <HalPowerManager.h>
+#include <HalStorage.h>
+#include <Logging.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+constexpr char JOURNAL_FILE[] = "/.crosspoint/progress.jnl";
+// Record: magic, path length, data length, path, data, FNV-1a of everything before it
+constexpr uint8_t RECORD_MAGIC = 0xA7;
+constexpr size_t RECORD_OVERHEAD = 3 + sizeof(uint32_t);
+// A position goes to the journal after this many turns, or on the first turn (or main loop pass) this long after the
+// last record; a crash loses at most that much reading
+constexpr uint8_t JOURNAL_EVERY_TURNS = 8;
+constexpr unsigned long JOURNAL_INTERVAL_MS = 30000;
+// Past this size the journal is folded into the position file and started over
+constexpr size_t MAX_JOURNAL_BYTES = 4096;
+// Below this charge every position goes straight to its file, the next turn may be the last
+constexpr uint16_t LOW_BATTERY_PERCENT = 5;
+
+SemaphoreHandle_t mutex() {
+  static SemaphoreHandle_t handle = xSemaphoreCreateMutex();
+  return handle;
+}
+
+class Guard {
+ public:
+  Guard() { xSemaphoreTake(mutex(), portMAX_DELAY); }
+  ~Guard() { xSemaphoreGive(mutex()); }
+  Guard(const Guard&) = delete;
+  Guard& operator=(const Guard&) = delete;
+};
+
+uint32_t checksum(const uint8_t* bytes, const size_t size) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+bool writePositionFile(const std::string& path, const uint8_t* data, const size_t size) {
+  FsFile f;
+  if (!Storage.openFileForWrite("PRJ", path, f)) {
+    LOG_ERR("PRJ", "Could not save progress to %s", path.c_str());
+    return false;
+  }
+  const bool ok = f.write(data, size) == size;
+  f.close();
+  return ok;
+}
+}  // namespace
+
+ProgressJournal ProgressJournal::instance;
+
+void ProgressJournal::save(const std::string& path, const uint8_t* data, const size_t size) {
+  if (size == 0 || size > MAX_DATA_SIZE || path.size() > UINT8_MAX) {
+    return;
+  }
+  Guard guard;
+  if (path != pendingPath && (newerThanFile || journalBytes > 0)) {
+    // The journal only ever holds the book being read
+    writeThrough();
+  }
+  if (path == pendingPath && size == pendingSize && memcmp(data, pendingData, size) == 0) {
+    return;
+  }
+  pendingPath = path;
+  memcpy(pendingData, data, size);
+  pendingSize = size;
+  newerThanJournal = true;
+  newerThanFile = true;
+  turnsSinceJournal++;
+
+  if (powerManager.getBatteryPercentage() <= LOW_BATTERY_PERCENT) {
+    writeThrough();
+  } else if (turnsSinceJournal >= JOURNAL_EVERY_TURNS || millis() - lastJournalMs >= JOURNAL_INTERVAL_MS) {
+    appendToJournal();
+  }
+}
+
+size_t ProgressJournal::load(const std::string& path, uint8_t* data, const size_t capacity) {
+  {
+    Guard guard;
+    if (path == pendingPath && pendingSize > 0) {
+      const size_t size = std::min<size_t>(capacity, pendingSize);
+      memcpy(data, pendingData, size);
+      return size;
+    }
+  }
+  FsFile f;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("PRJ", path, f)) {
+    return 0;
+  }
+  const int size = f.read(data, capacity);
+  f.close();
+  return size > 0 ? size : 0;
+}
+
+void ProgressJournal::loop() {
+  Guard guard;
+  if (newerThanJournal && millis() - lastJournalMs >= JOURNAL_INTERVAL_MS) {
+    appendToJournal();
+  }
+}
+
+void ProgressJournal::flush() {
+  Guard guard;
+  writeThrough();
+}
+
+void ProgressJournal::appendToJournal() {
+  static_assert(sizeof(record) == RECORD_OVERHEAD + UINT8_MAX + MAX_DATA_SIZE, "record holds the largest record");
+  size_t length = 0;
+  record[length++] = RECORD_MAGIC;
+  record[length++] = pendingPath.size();
+  record[length++] = pendingSize;
+  memcpy(record + length, pendingPath.data(), pendingPath.size());
+  length += pendingPath.size();
+  memcpy(record + length, pendingData, pendingSize);
+  length += pendingSize;
+  const uint32_t hash = checksum(record, length);
+  memcpy(record + length, &hash, sizeof(hash));
+  length += sizeof(hash);
+
+  FsFile f = Storage.open(JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND);
+  const bool ok = f && f.write(record, length) == length;
+  if (f) {
+    f.close();
+  }
+  lastJournalMs = millis();
+  turnsSinceJournal = 0;
+  if (!ok) {
+    LOG_ERR("PRJ", "Could not append to the progress journal");
+    writeThrough();
+    return;
+  }
+  newerThanJournal = false;
+  journalBytes += length;
+  if (journalBytes >= MAX_JOURNAL_BYTES) {
+    writeThrough();
+  }
+}
+
+void ProgressJournal::writeThrough() {
+  // The book's cache (and its position file with it) may have been cleared since the last write
+  if (pendingSize > 0 && (newerThanFile || !Storage.exists(pendingPath.c_str())) &&
+      writePositionFile(pendingPath, pendingData, pendingSize)) {
+    newerThanFile = false;
+    LOG_DBG("PRJ", "Progress saved to %s", pendingPath.c_str());
+  }
+  newerThanJournal = false;
+  turnsSinceJournal = 0;
+  // Only drop the journal once the file has what it holds
+  if (journalBytes > 0 && !newerThanFile) {
+    Storage.remove(JOURNAL_FILE);
+    journalBytes = 0;
+  }
+}
+
+void ProgressJournal::recover() {
+  FsFile f;
+  if (!Storage.exists(JOURNAL_FILE) || !Storage.openFileForRead("PRJ", JOURNAL_FILE, f)) {
+    return;
+  }
+  const size_t size = std::min<size_t>(f.size(), MAX_JOURNAL_BYTES + RECORD_OVERHEAD + UINT8_MAX + MAX_DATA_SIZE);
+  auto* journal = size > 0 ? static_cast<uint8_t*>(malloc(size)) : nullptr;
+  if (size > 0 && !journal) {
+    f.close();
+    LOG_ERR("PRJ", "Not enough memory to replay the progress journal");
+    return;
+  }
+  const bool read = size > 0 && f.read(journal, size) == static_cast<int>(size);
+  f.close();
+
+  // Last intact record of each book; a record torn by the power cut ends the journal
+  struct Position {
+    std::string path;
+    std::vector<uint8_t> data;
+  };
+  std::vector<Position> positions;
+  size_t offset = 0;
+  while (read && offset + RECORD_OVERHEAD <= size && journal[offset] == RECORD_MAGIC) {
+    const size_t pathLength = journal[offset + 1];
+    const size_t dataLength = journal[offset + 2];
+    const size_t length = RECORD_OVERHEAD + pathLength + dataLength;
+    uint32_t hash;
+    if (dataLength == 0 || dataLength > MAX_DATA_SIZE || offset + length > size) {
+      break;
+    }
+    memcpy(&hash, journal + offset + length - sizeof(hash), sizeof(hash));
+    if (hash != checksum(journal + offset, length - sizeof(hash))) {
+      break;
+    }
+    std::string path(reinterpret_cast<const char*>(journal + offset + 3), pathLength);
+    const uint8_t* data = journal + offset + 3 + pathLength;
+    auto it = std::find_if(positions.begin(), positions.end(), [&](const Position& p) { return p.path == path; });
+    if (it == positions.end()) {
+      it = positions.insert(positions.end(), {std::move(path), {}});
+    }
+    it->data.assign(data, data + dataLength);
+    offset += length;
+  }
+  free(journal);
+
+  for (const Position& position : positions) {
+    // Skip books whose cache has been cleared since
+    const std::string dir = position.path.substr(0, position.path.rfind('/'));
+    if (Storage.exists(dir.c_str())) {
+      writePositionFile(position.path, position.data.data(), position.data.size());
+    }
+  }
+  Storage.remove(JOURNAL_FILE);
+  LOG_INF("PRJ", "Recovered %u reading position(s) from the progress journal", static_cast<unsigned>(positions.size()));
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Reading positions of all readers. Each book keeps its position in its cache directory (progress.bin, in the
+// reader's own format), but rewriting that file on every page turn costs a directory update and a sector erase per
+// turn. Readers hand their position to save() instead. It is kept in RAM and only every few turns, or after a while
+// without one, appended as a small record to a journal shared by all books. flush() writes the latest position to
+// the book's file and empties the journal; readers call it when they close, and it runs before sleep and when the
+// battery is nearly flat. After a crash or power loss, recover() at boot replays the last intact record of each book
+// into its file.
+class ProgressJournal {
+  static ProgressJournal instance;
+
+ public:
+  static constexpr size_t MAX_DATA_SIZE = 16;
+
+  static ProgressJournal& getInstance() { return instance; }
+
+  // Latest position of the book whose position file is at path
+  void save(const std::string& path, const uint8_t* data, size_t size);
+  // Position of the book whose position file is at path, unsaved changes included. Returns the bytes read, 0 if
+  // there is none.
+  size_t load(const std::string& path, uint8_t* data, size_t capacity);
+  // Journal a pending position whose turn interval has run out; called from the main loop
+  void loop();
+  // Write the pending position to its file and drop the journal
+  void flush();
+  // Apply the journal left by a session that ended without flush(); once at boot
+  void recover();
+
+ private:
+  // Guarded by a mutex: readers save from the render task, loop() runs on the main one
+  std::string pendingPath;
+  uint8_t pendingData[MAX_DATA_SIZE] = {};
+  uint8_t pendingSize = 0;
+  bool newerThanJournal = false;
+  bool newerThanFile = false;
+  uint8_t turnsSinceJournal = 0;
+  unsigned long lastJournalMs = 0;
+  size_t journalBytes = 0;
+  // appendToJournal() builds its record here rather than on the caller's stack; the magic, the two lengths and the
+  // checksum come on top of the longest path and position
+  uint8_t record[3 + sizeof(uint32_t) + UINT8_MAX + MAX_DATA_SIZE] = {};
+
+  void appendToJournal();
+  void writeThrough();
+};
+
+#define PROGRESS_JOURNAL ProgressJournal::getInstance()
@@ -1,14 +1,18 @@
 #include "RecentBooksStore.h"
 
 #include <Epub.h>
+#include <Fb2.h>
 #include <HalStorage.h>
 #include <JsonSettingsIO.h>
 #include <Logging.h>
 #include <Serialization.h>
+#include <SettingsSnapshot.h>
 #include <Xtc.h>
 
 #include <algorithm>
 
+#include "components/UITheme.h"
+#include "util/LibraryIndex.h"
 #include "util/StringUtils.h"
 
 namespace {
@@ -16,6 +20,7 @@ constexpr uint8_t RECENT_BOOKS_FILE_VERSION = 3;
 constexpr char RECENT_BOOKS_FILE_BIN[] = "/.crosspoint/recent.bin";
 constexpr char RECENT_BOOKS_FILE_JSON[] = "/.crosspoint/recent.json";
 constexpr char RECENT_BOOKS_FILE_BAK[] = "/.crosspoint/recent.bin.bak";
+constexpr char RECENT_BOOKS_FILE_SNAPSHOT[] = "/.crosspoint/recent.snap";
 constexpr int MAX_RECENT_BOOKS = 10;
 }  // namespace
 
@@ -39,6 +44,12 @@ void RecentBooksStore::addBook(const std::string& path, const std::string& title
   }
 
   saveToFile();
+
+  // The library index keeps every opened book, not just the last few
+  const int thumbHeight = UITheme::getInstance().getMetrics().homeCoverHeight;
+  LibraryIndex::bookOpened(
+      path, title, author,
+      !coverBmpPath.empty() && Storage.exists(UITheme::getCoverThumbPath(coverBmpPath, thumbHeight).c_str()));
 }
 
 void RecentBooksStore::updateBook(const std::string& path, const std::string& title, const std::string& author,
@@ -56,7 +67,12 @@ void RecentBooksStore::updateBook(const std::string& path, const std::string& ti
 
 bool RecentBooksStore::saveToFile() const {
   Storage.mkdir("/.crosspoint");
-  return JsonSettingsIO::saveRecentBooks(*this, RECENT_BOOKS_FILE_JSON);
+  SettingsSnapshot::invalidate(RECENT_BOOKS_FILE_SNAPSHOT);
+  if (!JsonSettingsIO::saveRecentBooks(*this, RECENT_BOOKS_FILE_JSON)) {
+    return false;
+  }
+  SettingsSnapshot::saveRecentBooks(*this, RECENT_BOOKS_FILE_JSON, RECENT_BOOKS_FILE_SNAPSHOT);
+  return true;
 }
 
 RecentBook RecentBooksStore::getDataFromBook(std::string path) const {
@@ -82,6 +98,12 @@ RecentBook RecentBooksStore::getDataFromBook(std::string path) const {
     if (xtc.load()) {
       return RecentBook{path, xtc.getTitle(), xtc.getAuthor(), xtc.getThumbBmpPath()};
     }
+  } else if (StringUtils::checkFileExtension(lastBookFileName, ".fb2")) {
+    // The book index is only built on open, so this is the title of a book that was read before
+    Fb2 fb2(path, "/.crosspoint");
+    if (fb2.load()) {
+      return RecentBook{path, fb2.getTitle(), fb2.getAuthor(), ""};
+    }
   } else if (StringUtils::checkFileExtension(lastBookFileName, ".txt") ||
              StringUtils::checkFileExtension(lastBookFileName, ".md")) {
     return RecentBook{path, lastBookFileName, "", ""};
@@ -90,11 +112,19 @@ RecentBook RecentBooksStore::getDataFromBook(std::string path) const {
 }
 
 bool RecentBooksStore::loadFromFile() {
-  // Try JSON first
+  if (SettingsSnapshot::loadRecentBooks(*this, RECENT_BOOKS_FILE_JSON, RECENT_BOOKS_FILE_SNAPSHOT)) {
+    return true;
+  }
+
+  // Then JSON, which also refreshes the snapshot for the next boot
   if (Storage.exists(RECENT_BOOKS_FILE_JSON)) {
     String json = Storage.readFile(RECENT_BOOKS_FILE_JSON);
     if (!json.isEmpty()) {
-      return JsonSettingsIO::loadRecentBooks(*this, json.c_str());
+      if (!JsonSettingsIO::loadRecentBooks(*this, json.c_str())) {
+        return false;
+      }
+      SettingsSnapshot::saveRecentBooks(*this, RECENT_BOOKS_FILE_JSON, RECENT_BOOKS_FILE_SNAPSHOT);
+      return true;
     }
   }
 
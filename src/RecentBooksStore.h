@@ -15,6 +15,9 @@ class RecentBooksStore;
 namespace JsonSettingsIO {
 bool loadRecentBooks(RecentBooksStore& store, const char* json);
 }  // namespace JsonSettingsIO
+namespace SettingsSnapshot {
+bool loadRecentBooks(RecentBooksStore& store, const char* jsonPath, const char* path);
+}  // namespace SettingsSnapshot
 
 class RecentBooksStore {
   // Static instance
@@ -23,6 +26,7 @@ class RecentBooksStore {
   std::vector<RecentBook> recentBooks;
 
   friend bool JsonSettingsIO::loadRecentBooks(RecentBooksStore&, const char*);
+  friend bool SettingsSnapshot::loadRecentBooks(RecentBooksStore&, const char*, const char*);
 
  public:
   ~RecentBooksStore() = default;
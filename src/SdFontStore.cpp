@@ -0,0 +1,100 @@
+#include "SdFontStore.h"
+
+#include <GfxRenderer.h>
+#include <HalStorage.h>
+#include <Logging.h>
+
+#include "CrossPointSettings.h"
+#include "activities/RenderLock.h"
+
+namespace {
+// Indexed by EpdFontFamily::Style
+constexpr const char* STYLE_FILES[] = {"regular", "bold", "italic", "bolditalic"};
+}  // namespace
+
+SdFontStore SdFontStore::instance;
+
+std::string SdFontStore::resolveName() const {
+  if (SETTINGS.fontFamily != CrossPointSettings::SD_CARD) {
+    return "";
+  }
+  if (SETTINGS.sdFontName[0] != '\0') {
+    return SETTINGS.sdFontName;
+  }
+
+  // No folder chosen: take the first one, so copying a single font over is all it takes
+  HalFile root = Storage.open(FONTS_DIR);
+  if (!root || !root.isDirectory()) {
+    return "";
+  }
+  char name[64];
+  for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
+    const bool isDirectory = file.isDirectory();
+    file.getName(name, sizeof(name));
+    if (isDirectory && name[0] != '.') {
+      return name;
+    }
+  }
+  return "";
+}
+
+void SdFontStore::sync() {
+  if (!renderer) {
+    return;
+  }
+  const std::string name = resolveName();
+  if (name == loadedName) {
+    return;
+  }
+  // The render task may be drawing with the family that is about to be freed
+  RenderLock lock;
+  unload();
+  if (!name.empty() && load(name)) {
+    loadedName = name;
+  }
+}
+
+bool SdFontStore::load(const std::string& name) {
+  const std::string dir = std::string(FONTS_DIR) + "/" + name + "/";
+  uint32_t idSum = 0;
+  for (int style = 0; style < STYLE_COUNT; style++) {
+    const std::string path = dir + STYLE_FILES[style] + SdFont::EXTENSION;
+    // Only the regular style is required, the others are optional
+    if (style > 0 && !Storage.exists(path.c_str())) {
+      continue;
+    }
+    files[style].reset(new SdFont());
+    if (!files[style]->load(path)) {
+      if (style == 0) {
+        LOG_ERR("SDF", "No usable regular style in %s, using the builtin font", dir.c_str());
+        unload();
+        return false;
+      }
+      files[style].reset();
+      continue;
+    }
+    fonts[style].reset(new EpdFont(files[style]->getData()));
+    idSum += files[style]->getContentHash();
+  }
+
+  // A sum of content hashes like the builtin ids in fontIds.h, so an updated font gets a new id
+  fontId = static_cast<int>(idSum);
+  if (fontId == 0) {
+    fontId = 1;
+  }
+  renderer->insertFont(fontId, EpdFontFamily(fonts[0].get(), fonts[1].get(), fonts[2].get(), fonts[3].get()));
+  LOG_INF("SDF", "Font family %s loaded as id %d", name.c_str(), fontId);
+  return true;
+}
+
+void SdFontStore::unload() {
+  if (fontId != 0) {
+    renderer->removeFont(fontId);
+    fontId = 0;
+  }
+  for (int style = 0; style < STYLE_COUNT; style++) {
+    fonts[style].reset();
+    files[style].reset();
+  }
+  loadedName.clear();
+}
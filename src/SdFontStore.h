@@ -0,0 +1,46 @@
+#pragma once
+#include <EpdFont.h>
+#include <SdFont.h>
+
+#include <memory>
+#include <string>
+
+class GfxRenderer;
+
+// Reader font family loaded from /fonts/<name>/ on the SD card: regular.epdfont (required), bold.epdfont,
+// italic.epdfont and bolditalic.epdfont, as written by `fontconvert.py --binary`. Missing styles fall back the way
+// EpdFontFamily falls back for builtin fonts.
+class SdFontStore {
+  // Static instance
+  static SdFontStore instance;
+
+  static constexpr int STYLE_COUNT = 4;
+
+  GfxRenderer* renderer = nullptr;
+  std::string loadedName;
+  int fontId = 0;
+  std::unique_ptr<SdFont> files[STYLE_COUNT];
+  std::unique_ptr<EpdFont> fonts[STYLE_COUNT];
+
+  std::string resolveName() const;
+  bool load(const std::string& name);
+  void unload();
+
+ public:
+  static constexpr char FONTS_DIR[] = "/fonts";
+
+  // Get singleton instance
+  static SdFontStore& getInstance() { return instance; }
+
+  void begin(GfxRenderer& gfxRenderer) { renderer = &gfxRenderer; }
+
+  // Loads, swaps or drops the family to match the font settings. Call after the settings change.
+  void sync();
+
+  // Renderer font id of the loaded family, 0 when none is loaded. Derived from the file contents, so section caches
+  // built with another version of the font are not reused.
+  int getFontId() const { return fontId; }
+};
+
+// Helper macro to access the SD card font store
+#define SD_FONTS SdFontStore::getInstance()
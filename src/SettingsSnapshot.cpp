@@ -0,0 +1,334 @@
+#include "SettingsSnapshot.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <ObfuscationUtils.h>
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CrossPointSettings.h"
+#include "CrossPointState.h"
+#include "RecentBooksStore.h"
+
+namespace {
+constexpr uint32_t SNAPSHOT_MAGIC = 0x4E535043;  // "CPSN"
+// Bump when a payload layout changes without a firmware version change (e.g. in development builds)
+constexpr uint8_t SNAPSHOT_VERSION = 2;
+constexpr size_t MAX_SNAPSHOT_SIZE = 8 * 1024;
+constexpr size_t CHECKSUM_SIZE = sizeof(uint32_t);
+
+constexpr uint32_t FNV_OFFSET_BASIS = 2166136261u;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+uint32_t fnv(const char* data, const size_t length) {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+struct JsonStamp {
+  uint32_t size = 0;
+  uint16_t date = 0;
+  uint16_t time = 0;
+
+  bool operator==(const JsonStamp& other) const {
+    return size == other.size && date == other.date && time == other.time;
+  }
+};
+
+bool stampOf(const char* jsonPath, JsonStamp& stamp) {
+  FsFile file = Storage.open(jsonPath);
+  if (!file) {
+    return false;
+  }
+  stamp.size = file.size();
+  file.getModifyDateTime(&stamp.date, &stamp.time);
+  return true;
+}
+
+class Writer {
+ public:
+  std::string data;
+
+  template <typename T>
+  void field(const T& value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  void field(const std::string& value) {
+    field(static_cast<uint32_t>(value.size()));
+    data.append(value);
+  }
+};
+
+class Reader {
+ public:
+  Reader(const char* data, const size_t length) : cursor(data), remaining(length) {}
+
+  bool ok = true;
+
+  const char* position() const { return cursor; }
+  size_t left() const { return remaining; }
+
+  template <typename T>
+  void field(T& value) {
+    if (!take(sizeof(T))) {
+      return;
+    }
+    memcpy(&value, cursor - sizeof(T), sizeof(T));
+  }
+  void field(std::string& value) {
+    uint32_t length = 0;
+    field(length);
+    if (ok && take(length)) {
+      value.assign(cursor - length, length);
+    }
+  }
+
+ private:
+  const char* cursor;
+  size_t remaining;
+
+  bool take(const size_t length) {
+    if (!ok || length > remaining) {
+      ok = false;
+      return false;
+    }
+    cursor += length;
+    remaining -= length;
+    return true;
+  }
+};
+
+bool writeSnapshot(const char* path, const char* jsonPath, const std::string& payload) {
+  JsonStamp stamp;
+  if (!stampOf(jsonPath, stamp)) {
+    return false;
+  }
+
+  Writer out;
+  out.data.reserve(payload.size() + 64);
+  out.field(SNAPSHOT_MAGIC);
+  out.field(SNAPSHOT_VERSION);
+  out.field(std::string(CROSSPOINT_VERSION));
+  out.field(stamp.size);
+  out.field(stamp.date);
+  out.field(stamp.time);
+  out.data.append(payload);
+  out.field(fnv(out.data.data(), out.data.size()));
+
+  FsFile file;
+  if (!Storage.openFileForWrite("SNP", path, file)) {
+    return false;
+  }
+  const bool written = file.write(out.data.data(), out.data.size()) == out.data.size();
+  file.close();
+  if (!written) {
+    LOG_ERR("SNP", "Failed to write %s", path);
+    Storage.remove(path);
+  }
+  return written;
+}
+
+// Fills payload with the snapshot body if the snapshot is intact and still matches its JSON file
+bool readSnapshot(const char* path, const char* jsonPath, std::string& payload) {
+  FsFile file = Storage.open(path);
+  if (!file) {
+    return false;
+  }
+  const size_t size = file.size();
+  if (size <= CHECKSUM_SIZE || size > MAX_SNAPSHOT_SIZE) {
+    return false;
+  }
+  std::string data(size, '\0');
+  const bool read = file.read(&data[0], size) == static_cast<int>(size);
+  file.close();
+  if (!read) {
+    return false;
+  }
+
+  uint32_t checksum;
+  memcpy(&checksum, data.data() + size - CHECKSUM_SIZE, CHECKSUM_SIZE);
+  if (checksum != fnv(data.data(), size - CHECKSUM_SIZE)) {
+    LOG_DBG("SNP", "Checksum mismatch in %s", path);
+    return false;
+  }
+
+  Reader in(data.data(), size - CHECKSUM_SIZE);
+  uint32_t magic = 0;
+  uint8_t version = 0;
+  std::string firmware;
+  JsonStamp stored;
+  in.field(magic);
+  in.field(version);
+  in.field(firmware);
+  in.field(stored.size);
+  in.field(stored.date);
+  in.field(stored.time);
+  if (!in.ok || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || firmware != CROSSPOINT_VERSION) {
+    return false;
+  }
+
+  JsonStamp current;
+  if (!stampOf(jsonPath, current) || !(current == stored)) {
+    LOG_DBG("SNP", "%s is newer than its snapshot", jsonPath);
+    return false;
+  }
+
+  payload.assign(in.position(), in.left());
+  return true;
+}
+
+// Single field list for both directions. The OPDS password is handled separately so it is never stored in clear.
+template <typename Io, typename Settings>
+void settingsFields(Io& io, Settings& s) {
+  io.field(s.sleepScreen);
+  io.field(s.sleepScreenCoverMode);
+  io.field(s.sleepScreenCoverFilter);
+  io.field(s.statusBar);
+  io.field(s.statusBarChapterPageCount);
+  io.field(s.statusBarBookProgressPercentage);
+  io.field(s.statusBarProgressBar);
+  io.field(s.statusBarProgressBarThickness);
+  io.field(s.statusBarTitle);
+  io.field(s.statusBarBattery);
+  io.field(s.extraParagraphSpacing);
+  io.field(s.textAntiAliasing);
+  io.field(s.shortPwrBtn);
+  io.field(s.orientation);
+  io.field(s.sideButtonLayout);
+  io.field(s.frontButtonBack);
+  io.field(s.frontButtonConfirm);
+  io.field(s.frontButtonLeft);
+  io.field(s.frontButtonRight);
+  io.field(s.fontFamily);
+  io.field(s.fontSize);
+  io.field(s.lineSpacing);
+  io.field(s.paragraphAlignment);
+  io.field(s.sleepTimeout);
+  io.field(s.refreshFrequency);
+  io.field(s.hyphenationEnabled);
+  io.field(s.screenMargin);
+  io.field(s.opdsServerUrl);
+  io.field(s.opdsUsername);
+  io.field(s.hideBatteryPercentage);
+  io.field(s.longPressChapterSkip);
+  io.field(s.uiTheme);
+  io.field(s.fadingFix);
+  io.field(s.embeddedStyle);
+  io.field(s.pageAheadRender);
+  io.field(s.readingCacheLimit);
+  io.field(s.sdFontName);
+}
+
+template <typename Io, typename State>
+void stateFields(Io& io, State& s) {
+  io.field(s.openEpubPath);
+  io.field(s.lastSleepImage);
+  io.field(s.readerActivityLoadCount);
+  io.field(s.lastSleepFromReader);
+}
+}  // namespace
+
+void SettingsSnapshot::invalidate(const char* path) { Storage.remove(path); }
+
+// ---- CrossPointSettings ----
+
+bool SettingsSnapshot::saveSettings(const CrossPointSettings& s, const char* jsonPath, const char* path) {
+  Writer out;
+  settingsFields(out, s);
+  std::string password = s.opdsPassword;
+  obfuscation::xorTransform(password);
+  out.field(password);
+  return writeSnapshot(path, jsonPath, out.data);
+}
+
+bool SettingsSnapshot::loadSettings(CrossPointSettings& s, const char* jsonPath, const char* path) {
+  std::string payload;
+  if (!readSnapshot(path, jsonPath, payload)) {
+    return false;
+  }
+
+  Reader in(payload.data(), payload.size());
+  settingsFields(in, s);
+  std::string password;
+  in.field(password);
+  if (!in.ok) {
+    return false;
+  }
+  obfuscation::xorTransform(password);
+  strncpy(s.opdsPassword, password.c_str(), sizeof(s.opdsPassword) - 1);
+  s.opdsPassword[sizeof(s.opdsPassword) - 1] = '\0';
+  s.opdsServerUrl[sizeof(s.opdsServerUrl) - 1] = '\0';
+  s.opdsUsername[sizeof(s.opdsUsername) - 1] = '\0';
+  s.sdFontName[sizeof(s.sdFontName) - 1] = '\0';
+  LOG_DBG("CPS", "Settings loaded from snapshot");
+  return true;
+}
+
+// ---- CrossPointState ----
+
+bool SettingsSnapshot::saveState(const CrossPointState& s, const char* jsonPath, const char* path) {
+  Writer out;
+  stateFields(out, s);
+  return writeSnapshot(path, jsonPath, out.data);
+}
+
+bool SettingsSnapshot::loadState(CrossPointState& s, const char* jsonPath, const char* path) {
+  std::string payload;
+  if (!readSnapshot(path, jsonPath, payload)) {
+    return false;
+  }
+
+  Reader in(payload.data(), payload.size());
+  stateFields(in, s);
+  return in.ok;
+}
+
+// ---- RecentBooksStore ----
+
+bool SettingsSnapshot::saveRecentBooks(const RecentBooksStore& store, const char* jsonPath, const char* path) {
+  Writer out;
+  const auto& books = store.getBooks();
+  out.field(static_cast<uint8_t>(books.size()));
+  for (const auto& book : books) {
+    out.field(book.path);
+    out.field(book.title);
+    out.field(book.author);
+    out.field(book.coverBmpPath);
+  }
+  return writeSnapshot(path, jsonPath, out.data);
+}
+
+bool SettingsSnapshot::loadRecentBooks(RecentBooksStore& store, const char* jsonPath, const char* path) {
+  std::string payload;
+  if (!readSnapshot(path, jsonPath, payload)) {
+    return false;
+  }
+
+  Reader in(payload.data(), payload.size());
+  uint8_t count = 0;
+  in.field(count);
+  std::vector<RecentBook> books;
+  books.reserve(count);
+  for (uint8_t i = 0; i < count && in.ok; i++) {
+    RecentBook book;
+    in.field(book.path);
+    in.field(book.title);
+    in.field(book.author);
+    in.field(book.coverBmpPath);
+    books.push_back(std::move(book));
+  }
+  if (!in.ok) {
+    return false;
+  }
+
+  store.recentBooks = std::move(books);
+  LOG_DBG("RBS", "Recent books loaded from snapshot (%d entries)", store.getCount());
+  return true;
+}
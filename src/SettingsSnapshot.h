@@ -0,0 +1,29 @@
+#pragma once
+
+class CrossPointSettings;
+class CrossPointState;
+class RecentBooksStore;
+
+// Binary snapshots of the stores read at every boot, kept next to their JSON files. Loading one is a single small
+// read with no JSON document on the heap. The JSON stays the editable source of truth: a snapshot records the size
+// and FAT timestamp of the JSON file it was written with, plus the firmware version, and is ignored when any of
+// them differ or its checksum fails. An edited JSON file or a firmware update therefore goes through the JSON path
+// once, which rewrites the snapshot.
+namespace SettingsSnapshot {
+
+// Call before rewriting the JSON file, so an interrupted save can't leave a snapshot that still looks current
+void invalidate(const char* path);
+
+// CrossPointSettings
+bool saveSettings(const CrossPointSettings& s, const char* jsonPath, const char* path);
+bool loadSettings(CrossPointSettings& s, const char* jsonPath, const char* path);
+
+// CrossPointState
+bool saveState(const CrossPointState& s, const char* jsonPath, const char* path);
+bool loadState(CrossPointState& s, const char* jsonPath, const char* path);
+
+// RecentBooksStore
+bool saveRecentBooks(const RecentBooksStore& store, const char* jsonPath, const char* path);
+bool loadRecentBooks(RecentBooksStore& store, const char* jsonPath, const char* path);
+
+}  // namespace SettingsSnapshot
@@ -6,6 +6,8 @@
 #include <ObfuscationUtils.h>
 #include <Serialization.h>
 
+#include <cstring>
+
 // Initialize the static instance
 WifiCredentialStore WifiCredentialStore::instance;
 
@@ -152,6 +154,24 @@ const WifiCredential* WifiCredentialStore::findCredential(const std::string& ssi
 
 bool WifiCredentialStore::hasSavedCredential(const std::string& ssid) const { return findCredential(ssid) != nullptr; }
 
+void WifiCredentialStore::setLastAccessPoint(const std::string& ssid, const uint8_t* bssid, const int32_t channel) {
+  const auto cred = find_if(credentials.begin(), credentials.end(),
+                            [&ssid](const WifiCredential& cred) { return cred.ssid == ssid; });
+  if (cred == credentials.end()) {
+    return;
+  }
+  const uint8_t none[6] = {};
+  if (!bssid) {
+    bssid = none;
+  }
+  if (cred->channel == channel && memcmp(cred->bssid, bssid, sizeof(cred->bssid)) == 0) {
+    return;
+  }
+  memcpy(cred->bssid, bssid, sizeof(cred->bssid));
+  cred->channel = channel;
+  saveToFile();
+}
+
 void WifiCredentialStore::setLastConnectedSsid(const std::string& ssid) {
   if (lastConnectedSsid != ssid) {
     lastConnectedSsid = ssid;
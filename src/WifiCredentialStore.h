@@ -1,10 +1,14 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 
 struct WifiCredential {
   std::string ssid;
   std::string password;  // Plaintext in memory; obfuscated with hardware key on disk
+  // Access point of the last successful connection, so reconnecting can skip the all-channel scan
+  uint8_t bssid[6] = {};
+  int32_t channel = 0;  // 0 = not known yet
 };
 
 class WifiCredentialStore;
@@ -51,6 +55,8 @@ class WifiCredentialStore {
   bool addCredential(const std::string& ssid, const std::string& password);
   bool removeCredential(const std::string& ssid);
   const WifiCredential* findCredential(const std::string& ssid) const;
+  // Remember (or with channel 0, forget) the access point a saved network was last reached through
+  void setLastAccessPoint(const std::string& ssid, const uint8_t* bssid, int32_t channel);
 
   // Get all stored credentials (for UI display)
   const std::vector<WifiCredential>& getCredentials() const { return credentials; }
@@ -6,6 +6,7 @@
 #include <string>
 #include <utility>
 
+#include "ActivityArena.h"
 #include "ActivityManager.h"  // for using the ActivityManager singleton
 #include "ActivityResult.h"
 #include "GfxRenderer.h"
@@ -22,6 +23,7 @@ class Activity {
 
   ActivityResultHandler resultHandler;
   ActivityResult result;
+  ActivityArena::Mark arenaMark;  // Where the activity arena stood when this activity started
 
  public:
   explicit Activity(std::string name, GfxRenderer& renderer, MappedInputManager& mappedInput)
@@ -0,0 +1,60 @@
+#include "ActivityArena.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+namespace {
+SemaphoreHandle_t mutex() {
+  static SemaphoreHandle_t handle = xSemaphoreCreateMutex();
+  return handle;
+}
+
+class Guard {
+ public:
+  Guard() { xSemaphoreTake(mutex(), portMAX_DELAY); }
+  ~Guard() { xSemaphoreGive(mutex()); }
+  Guard(const Guard&) = delete;
+  Guard& operator=(const Guard&) = delete;
+};
+}  // namespace
+
+ActivityArena ActivityArena::instance;
+
+void* ActivityArena::allocate(const size_t bytes, const size_t align) {
+  Guard guard;
+  return arena.allocate(bytes, align);
+}
+
+bool ActivityArena::deallocate(void* ptr, const size_t bytes) {
+  Guard guard;
+  if (!ptr || !arena.owns(ptr)) {
+    return false;
+  }
+  arena.deallocate(ptr, bytes);
+  return true;
+}
+
+ActivityArena::Mark ActivityArena::mark() {
+  Guard guard;
+  return arena.mark();
+}
+
+void ActivityArena::rewind(const Mark& mark) {
+  Guard guard;
+  if (!mark.block) {
+    arena.release();
+    return;
+  }
+  arena.rewind(mark);
+  arena.trim();
+}
+
+void ActivityArena::release() {
+  Guard guard;
+  arena.release();
+}
+
+size_t ActivityArena::getAllocatedBytes() {
+  Guard guard;
+  return arena.getAllocatedBytes();
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <Epub/LayoutArena.h>
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*
+Arena for the containers activities fill while they are on screen (list rows, scanned networks, feed history), so
+their many small allocations come out of a few 4 KB blocks instead of being scattered over the heap. The
+ActivityManager marks the arena when an activity starts and rewinds it when that activity exits, handing the blocks
+taken since back to the heap; once no activity is left (every replaceActivity()) the arena is empty. Leaving a menu
+therefore returns the heap to the shape it had before, and the reader starts on a heap that the screens before it
+haven't broken up.
+
+Activities use it through ActivityAllocator / ActivityVector for their member containers:
+
+    ActivityVector<WifiNetworkInfo> networks;
+
+Only the activity on screen may allocate from it, from onEnter() on: an activity further down the stack growing its
+containers would take memory above the mark of the one on top, which that one's exit would free. Access is guarded
+by a mutex, so loop() and render() may both grow containers.
+*/
+class ActivityArena {
+  static ActivityArena instance;
+
+ public:
+  using Mark = LayoutArena::Mark;
+
+  static ActivityArena& getInstance() { return instance; }
+
+  // Returns nullptr only if a new backing block could not be allocated
+  void* allocate(size_t bytes, size_t align);
+  // Returns false if ptr isn't from the arena; otherwise gives it back if it is the most recent allocation
+  bool deallocate(void* ptr, size_t bytes);
+
+  // Called by the ActivityManager around each activity's lifetime
+  Mark mark();
+  void rewind(const Mark& mark);
+  void release();
+
+  size_t getAllocatedBytes();
+
+ private:
+  LayoutArena arena;
+};
+
+#define ACTIVITY_ARENA ActivityArena::getInstance()
+
+// std allocator on the activity arena; falls back to operator new when the heap has no room for another block
+template <typename T>
+class ActivityAllocator {
+ public:
+  using value_type = T;
+
+  ActivityAllocator() noexcept = default;
+  template <typename U>
+  ActivityAllocator(const ActivityAllocator<U>&) noexcept {}
+
+  T* allocate(const size_t n) {
+    if (void* ptr = ACTIVITY_ARENA.allocate(n * sizeof(T), alignof(T))) {
+      return static_cast<T*>(ptr);
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, const size_t n) noexcept {
+    if (!ACTIVITY_ARENA.deallocate(ptr, n * sizeof(T))) {
+      ::operator delete(ptr);
+    }
+  }
+
+  template <typename U>
+  bool operator==(const ActivityAllocator<U>&) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const ActivityAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+template <typename T>
+using ActivityVector = std::vector<T, ActivityAllocator<T>>;
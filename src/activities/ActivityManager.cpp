@@ -1,7 +1,14 @@
 #include "ActivityManager.h"
 
+#include <AllocProfile.h>
 #include <HalPowerManager.h>
+#include <Metrics.h>
+#include <Trace.h>
 
+#include <cstdio>
+
+#include "ActivityArena.h"
+#include "BackgroundJobs.h"
 #include "boot_sleep/BootActivity.h"
 #include "boot_sleep/SleepActivity.h"
 #include "browser/OpdsBookBrowserActivity.h"
@@ -10,7 +17,9 @@
 #include "home/RecentBooksActivity.h"
 #include "network/CrossPointWebServerActivity.h"
 #include "reader/ReaderActivity.h"
+#include "settings/PrepareLibraryActivity.h"
 #include "settings/SettingsActivity.h"
+#include "util/BenchmarkActivity.h"
 #include "util/FullScreenMessageActivity.h"
 
 void ActivityManager::begin() {
@@ -30,23 +39,60 @@ void ActivityManager::renderTaskTrampoline(void* param) {
 
 void ActivityManager::renderTaskLoop() {
   while (true) {
+    // Clears the whole count, so every update requested while the previous render ran is served by this one
     ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    const uint32_t inputUs = pendingInputUs.exchange(0);
     // Acquire the lock before reading currentActivity to avoid a TOCTOU race
     // where the main task deletes the activity between the null-check and render().
     RenderLock lock;
     if (currentActivity) {
       HalPowerManager::Lock powerLock;  // Ensure we don't go into low-power mode while rendering
+      const char* latencyName = inputUs != 0 ? latencyTraceName() : nullptr;
+      // render() may hand the lock back early, after which currentActivity can change
+      const bool pageTurn = currentActivity->isReaderActivity();
       currentActivity->render(std::move(lock));
+      if (latencyName) {
+        trace::record(latencyName, inputUs);
+        if (pageTurn) {
+          metrics::observe(metrics::PAGE_TURN_MS, (trace::now() - inputUs) / 1000);
+        }
+      }
     }
   }
 }
 
+const char* ActivityManager::latencyTraceName() const {
+  char label[24];
+  snprintf(label, sizeof(label), "in.%s", currentActivity->name.c_str());
+  const char* name = trace::intern(label);
+  return name ? name : "in.other";
+}
+
+void ActivityManager::notifyRenderTask() {
+  if (inputStartUs != 0) {
+    // Keep the oldest press if the render task hasn't picked up the previous one yet
+    uint32_t none = 0;
+    pendingInputUs.compare_exchange_strong(none, inputStartUs);
+    inputStartUs = 0;
+  }
+  if (renderTaskHandle) {
+    xTaskNotify(renderTaskHandle, 1, eIncrement);
+  }
+}
+
 void ActivityManager::loop() {
+  inputStartUs = mappedInput.wasAnyPressed() ? trace::now() : 0;
+
   if (currentActivity) {
     // Note: do not hold a lock here, the loop() method must be responsible for acquire one if needed
     currentActivity->loop();
   }
 
+  if (pendingAction != PendingAction::None) {
+    // Presses queued for the screen being left shouldn't act on the next one
+    mappedInput.clearPresses();
+  }
+
   while (pendingAction != PendingAction::None) {
     if (pendingAction == PendingAction::Pop) {
       RenderLock lock;
@@ -73,6 +119,7 @@ void ActivityManager::loop() {
       } else {
         currentActivity = std::move(stackActivities.back());
         stackActivities.pop_back();
+        ALLOC_PHASE(currentActivity->name.c_str());
         LOG_DBG("ACT", "Popped from activity stack, new size = %zu", stackActivities.size());
         // Handle result if necessary
         if (currentActivity->resultHandler) {
@@ -106,6 +153,10 @@ void ActivityManager::loop() {
           stackActivities.back()->onExit();
           stackActivities.pop_back();
         }
+        // No activity is left to hold anything in the arena
+        ACTIVITY_ARENA.release();
+        // The next screen may need the heap the last book is holding on to
+        ReaderActivity::trimWarmBook();
       } else if (pendingAction == PendingAction::Push) {
         // Move current activity to stack
         stackActivities.push_back(std::move(currentActivity));
@@ -113,6 +164,8 @@ void ActivityManager::loop() {
       }
       pendingAction = PendingAction::None;
       currentActivity = std::move(pendingActivity);
+      currentActivity->arenaMark = ACTIVITY_ARENA.mark();
+      ALLOC_PHASE(currentActivity->name.c_str());
 
       lock.unlock();  // onEnter may acquire its own lock
       currentActivity->onEnter();
@@ -126,17 +179,20 @@ void ActivityManager::loop() {
     requestedUpdate = false;
     // Using direct notification to signal the render task to update
     // Increment counter so multiple rapid calls won't be lost
-    if (renderTaskHandle) {
-      xTaskNotify(renderTaskHandle, 1, eIncrement);
-    }
+    notifyRenderTask();
   }
+  // A press that didn't lead to a render isn't measured
+  inputStartUs = 0;
 }
 
 void ActivityManager::exitActivity(const RenderLock& lock) {
   // Note: lock must be held by the caller
   if (currentActivity) {
+    const ActivityArena::Mark arenaMark = currentActivity->arenaMark;
     currentActivity->onExit();
     currentActivity.reset();
+    // Hand back what the activity took from the arena, its containers are gone with it
+    ACTIVITY_ARENA.rewind(arenaMark);
   }
 }
 
@@ -150,11 +206,15 @@ void ActivityManager::replaceActivity(std::unique_ptr<Activity>&& newActivity) {
   } else {
     // No current activity, safe to launch immediately
     currentActivity = std::move(newActivity);
+    ACTIVITY_ARENA.release();
+    currentActivity->arenaMark = ACTIVITY_ARENA.mark();
+    ALLOC_PHASE(currentActivity->name.c_str());
     currentActivity->onEnter();
   }
 }
 
 void ActivityManager::goToFileTransfer() {
+  ReaderActivity::releaseWarmBook();
   replaceActivity(std::make_unique<CrossPointWebServerActivity>(renderer, mappedInput));
 }
 
@@ -169,6 +229,7 @@ void ActivityManager::goToRecentBooks() {
 }
 
 void ActivityManager::goToBrowser() {
+  ReaderActivity::releaseWarmBook();
   replaceActivity(std::make_unique<OpdsBookBrowserActivity>(renderer, mappedInput));
 }
 
@@ -177,16 +238,23 @@ void ActivityManager::goToReader(std::string path) {
 }
 
 void ActivityManager::goToSleep() {
+  ReaderActivity::releaseWarmBook();
   replaceActivity(std::make_unique<SleepActivity>(renderer, mappedInput));
   loop();  // Important: sleep screen must be rendered immediately, the caller will go to sleep right after this returns
 }
 
 void ActivityManager::goToBoot() { replaceActivity(std::make_unique<BootActivity>(renderer, mappedInput)); }
 
+void ActivityManager::goToPrepareLibrary(std::vector<std::string> books) {
+  replaceActivity(std::make_unique<PrepareLibraryActivity>(renderer, mappedInput, true, std::move(books)));
+}
+
 void ActivityManager::goToFullScreenMessage(std::string message, EpdFontFamily::Style style) {
   replaceActivity(std::make_unique<FullScreenMessageActivity>(renderer, mappedInput, std::move(message), style));
 }
 
+void ActivityManager::goToBenchmark() { replaceActivity(std::make_unique<BenchmarkActivity>(renderer, mappedInput)); }
+
 void ActivityManager::goHome() { replaceActivity(std::make_unique<HomeActivity>(renderer, mappedInput)); }
 
 void ActivityManager::pushActivity(std::unique_ptr<Activity>&& activity) {
@@ -208,7 +276,10 @@ void ActivityManager::popActivity() {
   pendingAction = PendingAction::Pop;
 }
 
-bool ActivityManager::preventAutoSleep() const { return currentActivity && currentActivity->preventAutoSleep(); }
+bool ActivityManager::preventAutoSleep() const {
+  // Background jobs would be lost with the RAM at deep sleep, the device stays awake until they are done
+  return (currentActivity && currentActivity->preventAutoSleep()) || BACKGROUND_JOBS.isBusy();
+}
 
 bool ActivityManager::isReaderActivity() const { return currentActivity && currentActivity->isReaderActivity(); }
 
@@ -216,9 +287,7 @@ bool ActivityManager::skipLoopDelay() const { return currentActivity && currentA
 
 void ActivityManager::requestUpdate(bool immediate) {
   if (immediate) {
-    if (renderTaskHandle) {
-      xTaskNotify(renderTaskHandle, 1, eIncrement);
-    }
+    notifyRenderTask();
   } else {
     // Deferring the update until current loop is finished
     // This is to avoid multiple updates being requested in the same loop
@@ -4,6 +4,7 @@
 #include <freertos/semphr.h>
 #include <freertos/task.h>
 
+#include <atomic>
 #include <cassert>
 #include <memory>
 #include <string>
@@ -58,6 +59,16 @@ class ActivityManager {
   // This variable must only be set by the main loop, to avoid race conditions
   bool requestedUpdate = false;
 
+  // Input-to-refresh latency. A button press seen by loop() is handed to the render task when the loop requests an
+  // update; the render task then records the time from the press until its render (refresh included) finished as a
+  // trace span named after the activity ("in.Home"). Updates requested while a render is running collapse into one
+  // render of the latest state (the task notification count is taken as a whole), so a burst of presses is measured
+  // from the oldest press that hasn't been rendered yet.
+  uint32_t inputStartUs = 0;                 // Press being handled by the current loop(), main loop only
+  std::atomic<uint32_t> pendingInputUs{0};  // Oldest press not covered by a render yet
+  void notifyRenderTask();
+  const char* latencyTraceName() const;
+
  public:
   explicit ActivityManager(GfxRenderer& renderer, MappedInputManager& mappedInput)
       : renderer(renderer), mappedInput(mappedInput), renderingMutex(xSemaphoreCreateMutex()) {
@@ -81,7 +92,11 @@ class ActivityManager {
   void goToReader(std::string path);
   void goToSleep();
   void goToBoot();
+  // Empty books prepares the whole library
+  void goToPrepareLibrary(std::vector<std::string> books = {});
   void goToFullScreenMessage(std::string message, EpdFontFamily::Style style = EpdFontFamily::REGULAR);
+  // Hidden debug screen, only reachable over serial (CMD:BENCH)
+  void goToBenchmark();
   void goHome();
 
   // This will move current activity to stack instead of deleting it
@@ -25,6 +25,7 @@ struct MenuResult {
 
 struct ChapterResult {
   int spineIndex = 0;
+  std::string anchor;  // Element id within the spine item, empty for its start
 };
 
 struct PercentResult {
@@ -38,6 +39,7 @@ struct PageResult {
 struct SyncResult {
   int spineIndex = 0;
   int page = 0;
+  std::string landmark;  // DOM path of the synced block, resolves to the exact page once the section is loaded
 };
 
 enum class NetworkMode;
@@ -50,8 +52,14 @@ struct FootnoteResult {
   std::string href;
 };
 
+struct SearchResult {
+  int spineIndex = 0;
+  int page = -1;  // -1 when only the position within the chapter is known
+  float spineProgress = 0;
+};
+
 using ResultVariant = std::variant<std::monostate, WifiResult, KeyboardResult, MenuResult, ChapterResult, PercentResult,
-                                   PageResult, SyncResult, NetworkModeResult, FootnoteResult>;
+                                   PageResult, SyncResult, NetworkModeResult, FootnoteResult, SearchResult>;
 
 struct ActivityResult {
   bool isCancelled = false;
@@ -1,6 +1,7 @@
 #include "SleepActivity.h"
 
 #include <Epub.h>
+#include <Fb2.h>
 #include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <I18n.h>
@@ -12,6 +13,7 @@
 #include "components/UITheme.h"
 #include "fontIds.h"
 #include "images/Logo120.h"
+#include "util/SleepFrameCache.h"
 #include "util/StringUtils.h"
 
 void SleepActivity::onEnter() {
@@ -37,78 +39,78 @@ void SleepActivity::renderCustomSleepScreen() const {
   if (dir && dir.isDirectory()) {
     std::vector<std::string> files;
     char name[500];
-    // collect all valid BMP files
+    // Collect BMP names only. The chosen file's headers are checked when it is drawn, and not at all once its
+    // frames are cached, so a large folder doesn't mean opening every image on every sleep.
     for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
       if (file.isDirectory()) {
         file.close();
         continue;
       }
       file.getName(name, sizeof(name));
+      file.close();
       auto filename = std::string(name);
       if (filename[0] == '.') {
-        file.close();
         continue;
       }
 
-      if (filename.substr(filename.length() - 4) != ".bmp") {
+      if (!StringUtils::checkFileExtension(filename, ".bmp")) {
         LOG_DBG("SLP", "Skipping non-.bmp file name: %s", name);
-        file.close();
-        continue;
-      }
-      Bitmap bitmap(file);
-      if (bitmap.parseHeaders() != BmpReaderError::Ok) {
-        LOG_DBG("SLP", "Skipping invalid BMP file: %s", name);
-        file.close();
         continue;
       }
       files.emplace_back(filename);
-      file.close();
     }
-    const auto numFiles = files.size();
-    if (numFiles > 0) {
+    dir.close();
+
+    while (!files.empty()) {
+      const auto numFiles = files.size();
       // Generate a random number between 1 and numFiles
       auto randomFileIndex = random(numFiles);
       // If we picked the same image as last time, reroll
       while (numFiles > 1 && randomFileIndex == APP_STATE.lastSleepImage) {
         randomFileIndex = random(numFiles);
       }
-      APP_STATE.lastSleepImage = randomFileIndex;
-      APP_STATE.saveToFile();
-      const auto filename = "/sleep/" + files[randomFileIndex];
-      FsFile file;
-      if (Storage.openFileForRead("SLP", filename, file)) {
-        LOG_DBG("SLP", "Randomly loading: /sleep/%s", files[randomFileIndex].c_str());
-        delay(100);
-        Bitmap bitmap(file, true);
-        if (bitmap.parseHeaders() == BmpReaderError::Ok) {
-          renderBitmapSleepScreen(bitmap);
-          file.close();
-          dir.close();
-          return;
-        }
-        file.close();
+      LOG_DBG("SLP", "Randomly loading: /sleep/%s", files[randomFileIndex].c_str());
+      if (renderImageSleepScreen("/sleep/" + files[randomFileIndex])) {
+        APP_STATE.lastSleepImage = randomFileIndex;
+        APP_STATE.saveToFile();
+        return;
       }
+      LOG_DBG("SLP", "Skipping invalid BMP file: %s", files[randomFileIndex].c_str());
+      files.erase(files.begin() + randomFileIndex);
     }
   }
   if (dir) dir.close();
 
   // Look for sleep.bmp on the root of the sd card to determine if we should
   // render a custom sleep screen instead of the default.
-  FsFile file;
-  if (Storage.openFileForRead("SLP", "/sleep.bmp", file)) {
-    Bitmap bitmap(file, true);
-    if (bitmap.parseHeaders() == BmpReaderError::Ok) {
-      LOG_DBG("SLP", "Loading: /sleep.bmp");
-      renderBitmapSleepScreen(bitmap);
-      file.close();
-      return;
-    }
-    file.close();
+  if (Storage.exists("/sleep.bmp") && renderImageSleepScreen("/sleep.bmp")) {
+    return;
   }
 
   renderDefaultSleepScreen();
 }
 
+bool SleepActivity::renderImageSleepScreen(const std::string& imagePath) const {
+  const std::string slot = SleepFrameCache::imageSlot(imagePath);
+  if (SleepFrameCache::show(renderer, slot.c_str(), imagePath)) {
+    return true;
+  }
+
+  FsFile file;
+  if (!Storage.openFileForRead("SLP", imagePath, file)) {
+    return false;
+  }
+  Bitmap bitmap(file, true);
+  if (bitmap.parseHeaders() != BmpReaderError::Ok) {
+    file.close();
+    return false;
+  }
+  LOG_DBG("SLP", "Loading: %s", imagePath.c_str());
+  renderBitmapSleepScreen(bitmap, slot.c_str(), imagePath);
+  file.close();
+  return true;
+}
+
 void SleepActivity::renderDefaultSleepScreen() const {
   const auto pageWidth = renderer.getScreenWidth();
   const auto pageHeight = renderer.getScreenHeight();
@@ -126,7 +128,8 @@ void SleepActivity::renderDefaultSleepScreen() const {
   renderer.displayBuffer(HalDisplay::HALF_REFRESH);
 }
 
-void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap) const {
+void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap, const char* cacheSlot,
+                                            const std::string& sourcePath) const {
   int x, y;
   const auto pageWidth = renderer.getScreenWidth();
   const auto pageHeight = renderer.getScreenHeight();
@@ -167,6 +170,7 @@ void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap) const {
   }
 
   LOG_DBG("SLP", "drawing to %d x %d", x, y);
+  SleepFrameCache::Recorder recorder(renderer, cacheSlot, sourcePath);
   renderer.clearScreen();
 
   const bool hasGreyscale = bitmap.hasGreyscale() &&
@@ -178,6 +182,7 @@ void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap) const {
     renderer.invertScreen();
   }
 
+  recorder.addPlane();
   renderer.displayBuffer(HalDisplay::HALF_REFRESH);
 
   if (hasGreyscale) {
@@ -185,17 +190,20 @@ void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap) const {
     renderer.clearScreen(0x00);
     renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
     renderer.drawBitmap(bitmap, x, y, pageWidth, pageHeight, cropX, cropY);
+    recorder.addPlane();
     renderer.copyGrayscaleLsbBuffers();
 
     bitmap.rewindToData();
     renderer.clearScreen(0x00);
     renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
     renderer.drawBitmap(bitmap, x, y, pageWidth, pageHeight, cropX, cropY);
+    recorder.addPlane();
     renderer.copyGrayscaleMsbBuffers();
 
     renderer.displayGrayBuffer();
     renderer.setRenderMode(GfxRenderer::BW);
   }
+  recorder.commit();
 }
 
 void SleepActivity::renderCoverSleepScreen() const {
@@ -213,6 +221,11 @@ void SleepActivity::renderCoverSleepScreen() const {
     return (this->*renderNoCoverSleepScreen)();
   }
 
+  // The cached cover is keyed to the book file, so a hit skips loading the book as well as decoding its cover
+  if (SleepFrameCache::show(renderer, SleepFrameCache::COVER_SLOT, APP_STATE.openEpubPath)) {
+    return;
+  }
+
   std::string coverBmpPath;
   bool cropped = SETTINGS.sleepScreenCoverMode == CrossPointSettings::SLEEP_SCREEN_COVER_MODE::CROP;
 
@@ -246,6 +259,20 @@ void SleepActivity::renderCoverSleepScreen() const {
     }
 
     coverBmpPath = lastTxt.getCoverBmpPath();
+  } else if (StringUtils::checkFileExtension(APP_STATE.openEpubPath, ".fb2")) {
+    // Handle FB2 file - the cover is embedded in the book as a base64 <binary>
+    Fb2 lastFb2(APP_STATE.openEpubPath, "/.crosspoint");
+    if (!lastFb2.load()) {
+      LOG_ERR("SLP", "Failed to load last FB2");
+      return (this->*renderNoCoverSleepScreen)();
+    }
+
+    if (!lastFb2.generateCoverBmp()) {
+      LOG_ERR("SLP", "No cover image found for FB2 file");
+      return (this->*renderNoCoverSleepScreen)();
+    }
+
+    coverBmpPath = lastFb2.getCoverBmpPath();
   } else if (StringUtils::checkFileExtension(APP_STATE.openEpubPath, ".epub")) {
     // Handle EPUB file
     Epub lastEpub(APP_STATE.openEpubPath, "/.crosspoint");
@@ -270,7 +297,7 @@ void SleepActivity::renderCoverSleepScreen() const {
     Bitmap bitmap(file);
     if (bitmap.parseHeaders() == BmpReaderError::Ok) {
       LOG_DBG("SLP", "Rendering sleep cover: %s", coverBmpPath.c_str());
-      renderBitmapSleepScreen(bitmap);
+      renderBitmapSleepScreen(bitmap, SleepFrameCache::COVER_SLOT, APP_STATE.openEpubPath);
       file.close();
       return;
     }
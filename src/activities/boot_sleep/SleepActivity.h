@@ -1,4 +1,6 @@
 #pragma once
+#include <string>
+
 #include "../Activity.h"
 
 class Bitmap;
@@ -13,6 +15,9 @@ class SleepActivity final : public Activity {
   void renderDefaultSleepScreen() const;
   void renderCustomSleepScreen() const;
   void renderCoverSleepScreen() const;
-  void renderBitmapSleepScreen(const Bitmap& bitmap) const;
+  // Draw the BMP at imagePath, or its cached frames. False if it isn't a usable BMP.
+  bool renderImageSleepScreen(const std::string& imagePath) const;
+  // Draws the bitmap and records the result in cacheSlot of SleepFrameCache, keyed to sourcePath
+  void renderBitmapSleepScreen(const Bitmap& bitmap, const char* cacheSlot, const std::string& sourcePath) const;
   void renderBlankSleepScreen() const;
 };
@@ -2,22 +2,29 @@
 
 #include <Epub.h>
 #include <GfxRenderer.h>
+#include <HalStorage.h>
 #include <I18n.h>
 #include <Logging.h>
 #include <OpdsStream.h>
 #include <WiFi.h>
 
+#include <algorithm>
+
 #include "CrossPointSettings.h"
 #include "MappedInputManager.h"
 #include "activities/network/WifiSelectionActivity.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
 #include "network/HttpDownloader.h"
+#include "network/OpdsFeedCache.h"
+#include "network/OpdsThumbnails.h"
 #include "util/StringUtils.h"
 #include "util/UrlUtils.h"
 
 namespace {
 constexpr int PAGE_ITEMS = 23;
+// Entries parsed per window: the screen being shown plus one page to scroll into before the next fetch
+constexpr size_t WINDOW_ENTRIES = PAGE_ITEMS * 2;
 }  // namespace
 
 void OpdsBookBrowserActivity::onEnter() {
@@ -26,6 +33,8 @@ void OpdsBookBrowserActivity::onEnter() {
   state = BrowserState::CHECK_WIFI;
   entries.clear();
   navigationHistory.clear();
+  windowHistory.clear();
+  hasNextWindow = false;
   currentPath = "";  // Root path - user provides full URL in settings
   selectorIndex = 0;
   errorMessage.clear();
@@ -39,11 +48,15 @@ void OpdsBookBrowserActivity::onEnter() {
 void OpdsBookBrowserActivity::onExit() {
   Activity::onExit();
 
+  // Drop the catalog connection kept open between requests before the network goes away
+  HttpDownloader::closeConnection();
+
   // Turn off WiFi when exiting
   WiFi.mode(WIFI_OFF);
 
   entries.clear();
   navigationHistory.clear();
+  windowHistory.clear();
 }
 
 void OpdsBookBrowserActivity::loop() {
@@ -113,25 +126,47 @@ void OpdsBookBrowserActivity::loop() {
 
     // Handle navigation
     if (!entries.empty()) {
+      // Stepping past either end of the window loads the neighbouring one instead of wrapping, when there is one
       buttonNavigator.onNextRelease([this] {
+        if (hasNextWindow && selectorIndex == static_cast<int>(entries.size()) - 1) {
+          loadNextWindow();
+          return;
+        }
         selectorIndex = ButtonNavigator::nextIndex(selectorIndex, entries.size());
         requestUpdate();
       });
 
       buttonNavigator.onPreviousRelease([this] {
+        if (!windowHistory.empty() && selectorIndex == 0) {
+          loadPreviousWindow();
+          return;
+        }
         selectorIndex = ButtonNavigator::previousIndex(selectorIndex, entries.size());
         requestUpdate();
       });
 
       buttonNavigator.onNextContinuous([this] {
+        if (hasNextWindow && selectorIndex / PAGE_ITEMS == (static_cast<int>(entries.size()) - 1) / PAGE_ITEMS) {
+          loadNextWindow();
+          return;
+        }
         selectorIndex = ButtonNavigator::nextPageIndex(selectorIndex, entries.size(), PAGE_ITEMS);
         requestUpdate();
       });
 
       buttonNavigator.onPreviousContinuous([this] {
+        if (!windowHistory.empty() && selectorIndex < PAGE_ITEMS) {
+          loadPreviousWindow();
+          return;
+        }
         selectorIndex = ButtonNavigator::previousPageIndex(selectorIndex, entries.size(), PAGE_ITEMS);
         requestUpdate();
       });
+
+      // One thumbnail per pass, so buttons are still read between downloads
+      if (state == BrowserState::BROWSING) {
+        fetchNextThumbnail();
+      }
     }
   }
 }
@@ -202,9 +237,19 @@ void OpdsBookBrowserActivity::render(RenderLock&&) {
   }
 
   const auto pageStartIndex = selectorIndex / PAGE_ITEMS * PAGE_ITEMS;
-  renderer.fillRect(0, 60 + (selectorIndex % PAGE_ITEMS) * 30 - 2, pageWidth - 1, 30);
+  const size_t pageEndIndex = std::min(entries.size(), static_cast<size_t>(pageStartIndex + PAGE_ITEMS));
 
-  for (size_t i = pageStartIndex; i < entries.size() && i < static_cast<size_t>(pageStartIndex + PAGE_ITEMS); i++) {
+  // Covers take a column on the right of pages that have any, shown for the selected entry
+  bool pageHasThumbnails = false;
+  for (size_t i = pageStartIndex; i < pageEndIndex && !pageHasThumbnails; i++) {
+    pageHasThumbnails = !entries[i].thumbnailHref.empty();
+  }
+  constexpr int thumbWidth = OpdsThumbnails::THUMB_HEIGHT * 3 / 5;
+  const int listWidth = pageHasThumbnails ? pageWidth - thumbWidth - 20 : pageWidth;
+
+  renderer.fillRect(0, 60 + (selectorIndex % PAGE_ITEMS) * 30 - 2, listWidth - 1, 30);
+
+  for (size_t i = pageStartIndex; i < pageEndIndex; i++) {
     const auto& entry = entries[i];
 
     // Format display text with type indicator
@@ -219,58 +264,183 @@ void OpdsBookBrowserActivity::render(RenderLock&&) {
       }
     }
 
-    auto item = renderer.truncatedText(UI_10_FONT_ID, displayText.c_str(), renderer.getScreenWidth() - 40);
+    auto item = renderer.truncatedText(UI_10_FONT_ID, displayText.c_str(), listWidth - 40);
     renderer.drawText(UI_10_FONT_ID, 20, 60 + (i % PAGE_ITEMS) * 30, item.c_str(),
                       i != static_cast<size_t>(selectorIndex));
   }
 
+  const auto& selected = entries[selectorIndex];
+  FsFile file;
+  if (!selected.thumbnailHref.empty() &&
+      Storage.openFileForRead("OPDS", OpdsThumbnails::pathFor(thumbnailUrl(selected)), file)) {
+    // Empty files mark thumbnails that couldn't be decoded
+    Bitmap bitmap(file);
+    if (file.size() > 0 && bitmap.parseHeaders() == BmpReaderError::Ok) {
+      const int x = pageWidth - thumbWidth - 10;
+      renderer.drawBitmap(bitmap, x, 60, thumbWidth, OpdsThumbnails::THUMB_HEIGHT);
+      renderer.drawRect(x, 60, thumbWidth, OpdsThumbnails::THUMB_HEIGHT);
+    }
+    file.close();
+  }
+
   renderer.displayBuffer();
 }
 
+std::string OpdsBookBrowserActivity::thumbnailUrl(const OpdsEntry& entry) const {
+  return UrlUtils::buildUrl(SETTINGS.opdsServerUrl, entry.thumbnailHref);
+}
+
+void OpdsBookBrowserActivity::fetchNextThumbnail() {
+  const int page = selectorIndex / PAGE_ITEMS;
+  if (page != thumbnailPage) {
+    // Only the page on screen is fetched; pages scrolled past are dropped from the queue
+    thumbnailPage = page;
+    thumbnailQueue.clear();
+    const size_t pageEnd = std::min(entries.size(), static_cast<size_t>((page + 1) * PAGE_ITEMS));
+    for (size_t i = page * PAGE_ITEMS; i < pageEnd; i++) {
+      if (!entries[i].thumbnailHref.empty() && !OpdsThumbnails::isCached(thumbnailUrl(entries[i]))) {
+        thumbnailQueue.push_back(i);
+      }
+    }
+  }
+  if (thumbnailQueue.empty()) {
+    return;
+  }
+
+  const size_t index = thumbnailQueue.front();
+  thumbnailQueue.erase(thumbnailQueue.begin());
+  if (index < entries.size() && OpdsThumbnails::fetch(thumbnailUrl(entries[index])) &&
+      index == static_cast<size_t>(selectorIndex)) {
+    requestUpdate();
+  }
+}
+
 void OpdsBookBrowserActivity::fetchFeed(const std::string& path) {
+  windowHistory.clear();
+  fetchWindow(FeedWindow{path, 0}, false);
+}
+
+bool OpdsBookBrowserActivity::fetchWindow(const FeedWindow& window, const bool selectLast) {
   const char* serverUrl = SETTINGS.opdsServerUrl;
   if (strlen(serverUrl) == 0) {
     state = BrowserState::ERROR;
     errorMessage = tr(STR_NO_SERVER_URL);
     requestUpdate();
-    return;
+    return false;
   }
 
-  std::string url = UrlUtils::buildUrl(serverUrl, path);
-  LOG_DBG("OPDS", "Fetching: %s", url.c_str());
+  std::string url = UrlUtils::buildUrl(serverUrl, window.path);
+  LOG_DBG("OPDS", "Fetching: %s (skipping %u)", url.c_str(), static_cast<unsigned>(window.skip));
+
+  {
+    RenderLock lock(*this);
+    entries.clear();
+    entries.reserve(WINDOW_ENTRIES);
+    selectorIndex = 0;
+  }
+  hasNextWindow = false;
+  thumbnailQueue.clear();
+  thumbnailPage = -1;
 
   OpdsParser parser;
+  parser.setWindow(window.skip, WINDOW_ENTRIES);
+  // Entries reach the list as they are parsed, and the first screen is drawn while the rest of the window is still
+  // arriving. When scrolling back the selection lands on the last entry, so that draw waits for the whole window.
+  parser.setEntryHandler([this, selectLast](OpdsEntry&& entry) {
+    {
+      RenderLock lock(*this);
+      entries.push_back(std::move(entry));
+    }
+    if (!selectLast && entries.size() == static_cast<size_t>(PAGE_ITEMS)) {
+      state = BrowserState::BROWSING;
+      requestUpdate();
+    }
+  });
 
+  HttpDownloader::CacheValidators validators;
+  const bool cached = OpdsFeedCache::readValidators(url, window.skip, validators);
+  HttpDownloader::FetchResult result;
   {
     OpdsParserStream stream{parser};
-    if (!HttpDownloader::fetchUrl(url, stream)) {
+    result = HttpDownloader::fetchUrlIfModified(url, stream, validators);
+  }
+
+  OpdsFeedCache::Continuation continuation;
+  bool fromCache = false;
+  if (result == HttpDownloader::FETCH_NOT_MODIFIED || (result == HttpDownloader::FETCH_FAILED && cached)) {
+    // Unchanged on the server, or the server can't be reached: show the copy parsed last time
+    RenderLock lock(*this);
+    fromCache = OpdsFeedCache::load(url, window.skip, entries, continuation);
+    if (!fromCache) {
+      entries.clear();
+    }
+  }
+
+  if (!fromCache) {
+    if (result != HttpDownloader::FETCH_OK) {
       state = BrowserState::ERROR;
       errorMessage = tr(STR_FETCH_FEED_FAILED);
       requestUpdate();
-      return;
+      return false;
+    }
+    if (!parser) {
+      state = BrowserState::ERROR;
+      errorMessage = tr(STR_PARSE_FEED_FAILED);
+      requestUpdate();
+      return false;
     }
+    continuation.hasMoreEntries = parser.hasMoreEntries();
+    continuation.nextHref = parser.getNextHref();
+    OpdsFeedCache::save(url, window.skip, validators, entries, continuation);
+  } else {
+    LOG_DBG("OPDS", "Using cached feed (%s)",
+            result == HttpDownloader::FETCH_NOT_MODIFIED ? "not modified" : "offline");
   }
 
-  if (!parser) {
-    state = BrowserState::ERROR;
-    errorMessage = tr(STR_PARSE_FEED_FAILED);
-    requestUpdate();
-    return;
+  currentWindow = window;
+  if (continuation.hasMoreEntries) {
+    // The window filled before the document ended; the rest is reached by fetching it again further along
+    nextWindow = FeedWindow{window.path, window.skip + entries.size()};
+    hasNextWindow = true;
+  } else if (!continuation.nextHref.empty()) {
+    nextWindow = FeedWindow{continuation.nextHref, 0};
+    hasNextWindow = true;
   }
-
-  entries = std::move(parser).getEntries();
-  LOG_DBG("OPDS", "Found %d entries", entries.size());
-  selectorIndex = 0;
+  LOG_DBG("OPDS", "Found %d entries%s", entries.size(), hasNextWindow ? ", more available" : "");
 
   if (entries.empty()) {
     state = BrowserState::ERROR;
     errorMessage = tr(STR_NO_ENTRIES);
     requestUpdate();
-    return;
+    return false;
   }
 
+  if (selectLast) {
+    selectorIndex = static_cast<int>(entries.size()) - 1;
+  }
   state = BrowserState::BROWSING;
   requestUpdate();
+  return true;
+}
+
+void OpdsBookBrowserActivity::loadNextWindow() {
+  windowHistory.push_back(currentWindow);
+  const FeedWindow window = nextWindow;
+
+  state = BrowserState::LOADING;
+  statusMessage = tr(STR_LOADING);
+  requestUpdate(true);
+  fetchWindow(window, false);
+}
+
+void OpdsBookBrowserActivity::loadPreviousWindow() {
+  const FeedWindow window = windowHistory.back();
+  windowHistory.pop_back();
+
+  state = BrowserState::LOADING;
+  statusMessage = tr(STR_LOADING);
+  requestUpdate(true);
+  fetchWindow(window, true);
 }
 
 void OpdsBookBrowserActivity::navigateToEntry(const OpdsEntry& entry) {
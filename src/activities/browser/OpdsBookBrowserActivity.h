@@ -36,8 +36,22 @@ class OpdsBookBrowserActivity final : public Activity {
   ButtonNavigator buttonNavigator;
   BrowserState state = BrowserState::LOADING;
   std::vector<OpdsEntry> entries;
-  std::vector<std::string> navigationHistory;  // Stack of previous feed paths for back navigation
-  std::string currentPath;                     // Current feed path being displayed
+  ActivityVector<std::string> navigationHistory;  // Stack of previous feed paths for back navigation
+  std::string currentPath;                        // Current feed path being displayed
+
+  // Only a window of a feed's entries is held at a time. A window is a feed path plus the number of leading entries
+  // to skip, which covers both long single-document feeds and feeds the server pages with rel="next".
+  struct FeedWindow {
+    std::string path;
+    size_t skip = 0;
+  };
+  FeedWindow currentWindow;
+  FeedWindow nextWindow;                 // Where the entries after this window come from, if hasNextWindow
+  bool hasNextWindow = false;
+  ActivityVector<FeedWindow> windowHistory;  // Earlier windows of the current feed, for scrolling back
+
+  ActivityVector<size_t> thumbnailQueue;  // Entries on the shown page whose thumbnails still have to be fetched
+  int thumbnailPage = -1;              // Page of the window the queue was built for
   int selectorIndex = 0;
   std::string errorMessage;
   std::string statusMessage;
@@ -48,6 +62,11 @@ class OpdsBookBrowserActivity final : public Activity {
   void launchWifiSelection();
   void onWifiSelectionComplete(bool connected);
   void fetchFeed(const std::string& path);
+  bool fetchWindow(const FeedWindow& window, bool selectLast);
+  void loadNextWindow();
+  void loadPreviousWindow();
+  void fetchNextThumbnail();
+  std::string thumbnailUrl(const OpdsEntry& entry) const;
   void navigateToEntry(const OpdsEntry& entry);
   void navigateBack();
   void downloadBook(const OpdsEntry& book);
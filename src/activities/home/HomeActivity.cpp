@@ -17,6 +17,7 @@
 #include "RecentBooksStore.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
+#include "util/ScreenCache.h"
 #include "util/StringUtils.h"
 
 int HomeActivity::getMenuItemCount() const {
@@ -50,7 +51,12 @@ void HomeActivity::loadRecentBooks(int maxBooks) {
   }
 }
 
-void HomeActivity::loadRecentCovers(int coverHeight) {
+namespace {
+constexpr char SCREEN_NAME[] = "home";
+}  // namespace
+
+// Returns true if any thumbnail had to be generated, which also puts a progress popup on screen
+bool HomeActivity::loadRecentCovers(int coverHeight) {
   recentsLoading = true;
   bool showingLoading = false;
   Rect popupRect;
@@ -106,6 +112,34 @@ void HomeActivity::loadRecentCovers(int coverHeight) {
 
   recentsLoaded = true;
   recentsLoading = false;
+  return showingLoading;
+}
+
+bool HomeActivity::coverThumbsExist(const int coverHeight) const {
+  for (const RecentBook& book : recentBooks) {
+    if (!book.coverBmpPath.empty() &&
+        !Storage.exists(UITheme::getCoverThumbPath(book.coverBmpPath, coverHeight).c_str())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Everything the composed screen shows except the battery, which is redrawn over a cached frame. The strings cover
+// the language, the OPDS entry and the button layout.
+uint32_t HomeActivity::screenKey(const std::vector<const char*>& menuItems,
+                                 const MappedInputManager::Labels& labels) const {
+  ScreenCache::Key key;
+  key.add(CROSSPOINT_VERSION).add(static_cast<uint32_t>(SETTINGS.uiTheme));
+  key.add(static_cast<uint32_t>(renderer.getOrientation()));
+  for (const RecentBook& book : recentBooks) {
+    key.add(book.path).add(book.title).add(book.author).add(book.coverBmpPath);
+  }
+  for (const char* item : menuItems) {
+    key.add(item);
+  }
+  key.add(labels.btn1).add(labels.btn2).add(labels.btn3).add(labels.btn4);
+  return key.get();
 }
 
 void HomeActivity::onEnter() {
@@ -140,12 +174,12 @@ bool HomeActivity::storeCoverBuffer() {
   freeCoverBuffer();
 
   const size_t bufferSize = GfxRenderer::getBufferSize();
-  coverBuffer = static_cast<uint8_t*>(malloc(bufferSize));
+  coverBuffer = BufferPool::lease(bufferSize);
   if (!coverBuffer) {
     return false;
   }
 
-  memcpy(coverBuffer, frameBuffer, bufferSize);
+  memcpy(coverBuffer.data(), frameBuffer, bufferSize);
   return true;
 }
 
@@ -160,15 +194,12 @@ bool HomeActivity::restoreCoverBuffer() {
   }
 
   const size_t bufferSize = GfxRenderer::getBufferSize();
-  memcpy(frameBuffer, coverBuffer, bufferSize);
+  memcpy(frameBuffer, coverBuffer.data(), bufferSize);
   return true;
 }
 
 void HomeActivity::freeCoverBuffer() {
-  if (coverBuffer) {
-    free(coverBuffer);
-    coverBuffer = nullptr;
-  }
+  coverBuffer.release();
   coverBufferStored = false;
 }
 
@@ -215,15 +246,7 @@ void HomeActivity::render(RenderLock&&) {
   const auto& metrics = UITheme::getInstance().getMetrics();
   const auto pageWidth = renderer.getScreenWidth();
   const auto pageHeight = renderer.getScreenHeight();
-
-  renderer.clearScreen();
-  bool bufferRestored = coverBufferStored && restoreCoverBuffer();
-
-  GUI.drawHeader(renderer, Rect{0, metrics.topPadding, pageWidth, metrics.homeTopPadding}, nullptr);
-
-  GUI.drawRecentBookCover(renderer, Rect{0, metrics.homeTopPadding, pageWidth, metrics.homeCoverTileHeight},
-                          recentBooks, selectorIndex, coverRendered, coverBufferStored, bufferRestored,
-                          std::bind(&HomeActivity::storeCoverBuffer, this));
+  const Rect headerRect{0, metrics.topPadding, pageWidth, metrics.homeTopPadding};
 
   // Build menu items dynamically
   std::vector<const char*> menuItems = {tr(STR_BROWSE_FILES), tr(STR_MENU_RECENT_BOOKS), tr(STR_FILE_TRANSFER),
@@ -235,6 +258,28 @@ void HomeActivity::render(RenderLock&&) {
     menuItems.insert(menuItems.begin() + 2, tr(STR_OPDS_BROWSER));
     menuIcons.insert(menuIcons.begin() + 2, Library);
   }
+  const auto labels = mappedInput.mapLabels("", tr(STR_SELECT), tr(STR_DIR_UP), tr(STR_DIR_DOWN));
+  const uint32_t key = screenKey(menuItems, labels);
+
+  // Coming back to an unchanged Home: show the stored screen. Thumbnails deleted since (cleared book caches) have
+  // to be generated again, so those cases take the normal path.
+  if (!firstRenderDone && coverThumbsExist(metrics.homeCoverHeight) && ScreenCache::load(renderer, SCREEN_NAME, key)) {
+    GUI.drawHeader(renderer, headerRect, nullptr);
+    renderer.displayBuffer();
+    firstRenderDone = true;
+    recentsLoaded = true;
+    screenCached = true;
+    return;
+  }
+
+  renderer.clearScreen();
+  bool bufferRestored = coverBufferStored && restoreCoverBuffer();
+
+  GUI.drawHeader(renderer, headerRect, nullptr);
+
+  GUI.drawRecentBookCover(renderer, Rect{0, metrics.homeTopPadding, pageWidth, metrics.homeCoverTileHeight},
+                          recentBooks, selectorIndex, coverRendered, coverBufferStored, bufferRestored,
+                          std::bind(&HomeActivity::storeCoverBuffer, this));
 
   GUI.drawButtonMenu(
       renderer,
@@ -245,7 +290,6 @@ void HomeActivity::render(RenderLock&&) {
       [&menuItems](int index) { return std::string(menuItems[index]); },
       [&menuIcons](int index) { return menuIcons[index]; });
 
-  const auto labels = mappedInput.mapLabels("", tr(STR_SELECT), tr(STR_DIR_UP), tr(STR_DIR_DOWN));
   GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
 
   renderer.displayBuffer();
@@ -255,7 +299,14 @@ void HomeActivity::render(RenderLock&&) {
     requestUpdate();
   } else if (!recentsLoaded && !recentsLoading) {
     recentsLoading = true;
-    loadRecentCovers(metrics.homeCoverHeight);
+    // Unless thumbnails had to be generated (which redraws), the screen just shown is complete
+    if (!loadRecentCovers(metrics.homeCoverHeight) && selectorIndex == 0) {
+      ScreenCache::save(renderer, SCREEN_NAME, key);
+      screenCached = true;
+    }
+  } else if (recentsLoaded && !screenCached && selectorIndex == 0) {
+    ScreenCache::save(renderer, SCREEN_NAME, key);
+    screenCached = true;
   }
 }
 
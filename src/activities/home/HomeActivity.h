@@ -1,4 +1,6 @@
 #pragma once
+#include <BufferPool.h>
+
 #include <functional>
 #include <vector>
 
@@ -18,7 +20,8 @@ class HomeActivity final : public Activity {
   bool hasOpdsUrl = false;
   bool coverRendered = false;      // Track if cover has been rendered once
   bool coverBufferStored = false;  // Track if cover buffer is stored
-  uint8_t* coverBuffer = nullptr;  // HomeActivity's own buffer for cover image
+  bool screenCached = false;       // The screen cache holds the screen as currently composed
+  BufferLease coverBuffer;         // HomeActivity's own buffer for cover image
   std::vector<RecentBook> recentBooks;
   void onSelectBook(const std::string& path);
   void onMyLibraryOpen();
@@ -32,7 +35,9 @@ class HomeActivity final : public Activity {
   bool restoreCoverBuffer();  // Restore frame buffer from stored cover
   void freeCoverBuffer();     // Free the stored cover buffer
   void loadRecentBooks(int maxBooks);
-  void loadRecentCovers(int coverHeight);
+  bool loadRecentCovers(int coverHeight);
+  bool coverThumbsExist(int coverHeight) const;
+  uint32_t screenKey(const std::vector<const char*>& menuItems, const MappedInputManager::Labels& labels) const;
 
  public:
   explicit HomeActivity(GfxRenderer& renderer, MappedInputManager& mappedInput)
@@ -11,97 +11,16 @@
 #include "MappedInputManager.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
+#include "util/LibraryIndex.h"
 #include "util/StringUtils.h"
 
 namespace {
 constexpr unsigned long GO_HOME_MS = 1000;
 }  // namespace
 
-void sortFileList(std::vector<std::string>& strs) {
-  std::sort(begin(strs), end(strs), [](const std::string& str1, const std::string& str2) {
-    // Directories first
-    bool isDir1 = str1.back() == '/';
-    bool isDir2 = str2.back() == '/';
-    if (isDir1 != isDir2) return isDir1;
-
-    // Start naive natural sort
-    const char* s1 = str1.c_str();
-    const char* s2 = str2.c_str();
-
-    // Iterate while both strings have characters
-    while (*s1 && *s2) {
-      // Check if both are at the start of a number
-      if (isdigit(*s1) && isdigit(*s2)) {
-        // Skip leading zeros and track them
-        const char* start1 = s1;
-        const char* start2 = s2;
-        while (*s1 == '0') s1++;
-        while (*s2 == '0') s2++;
-
-        // Count digits to compare lengths first
-        int len1 = 0, len2 = 0;
-        while (isdigit(s1[len1])) len1++;
-        while (isdigit(s2[len2])) len2++;
-
-        // Different length so return smaller integer value
-        if (len1 != len2) return len1 < len2;
-
-        // Same length so compare digit by digit
-        for (int i = 0; i < len1; i++) {
-          if (s1[i] != s2[i]) return s1[i] < s2[i];
-        }
-
-        // Numbers equal so advance pointers
-        s1 += len1;
-        s2 += len2;
-      } else {
-        // Regular case-insensitive character comparison
-        char c1 = tolower(*s1);
-        char c2 = tolower(*s2);
-        if (c1 != c2) return c1 < c2;
-        s1++;
-        s2++;
-      }
-    }
-
-    // One string is prefix of other
-    return *s1 == '\0' && *s2 != '\0';
-  });
-}
-
 void MyLibraryActivity::loadFiles() {
-  files.clear();
-
-  auto root = Storage.open(basepath.c_str());
-  if (!root || !root.isDirectory()) {
-    if (root) root.close();
-    return;
-  }
-
-  root.rewindDirectory();
-
-  char name[500];
-  for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
-    file.getName(name, sizeof(name));
-    if (name[0] == '.' || strcmp(name, "System Volume Information") == 0) {
-      file.close();
-      continue;
-    }
-
-    if (file.isDirectory()) {
-      files.emplace_back(std::string(name) + "/");
-    } else {
-      auto filename = std::string(name);
-      if (StringUtils::checkFileExtension(filename, ".epub") || StringUtils::checkFileExtension(filename, ".xtch") ||
-          StringUtils::checkFileExtension(filename, ".xtc") || StringUtils::checkFileExtension(filename, ".txt") ||
-          StringUtils::checkFileExtension(filename, ".md") || StringUtils::checkFileExtension(filename, ".bmp")) {
-        files.emplace_back(filename);
-      }
-    }
-    file.close();
-  }
-  root.close();
-  sortFileList(files);
+  RenderLock lock(*this);
+  files.open(basepath);
 }
 
 void MyLibraryActivity::onEnter() {
@@ -115,6 +34,7 @@ void MyLibraryActivity::onEnter() {
 
 void MyLibraryActivity::onExit() {
   Activity::onExit();
+  RenderLock lock(*this);
   files.clear();
 }
 
@@ -141,7 +61,12 @@ void MyLibraryActivity::loop() {
   if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
     if (files.empty()) return;
 
-    const std::string& entry = files[selectorIndex];
+    std::string entry;
+    {
+      RenderLock lock(*this);
+      entry = files.get(selectorIndex);
+    }
+    if (entry.empty()) return;
     bool isDirectory = (entry.back() == '/');
 
     if (mappedInput.getHeldTime() >= GO_HOME_MS && !isDirectory) {
@@ -156,6 +81,7 @@ void MyLibraryActivity::loop() {
           clearFileMetadata(fullPath);
           if (Storage.remove(fullPath.c_str())) {
             LOG_DBG("MyLibrary", "Deleted successfully");
+            LibraryIndex::bookRemoved(fullPath);
             loadFiles();
             if (files.empty()) {
               selectorIndex = 0;
@@ -205,7 +131,10 @@ void MyLibraryActivity::loop() {
 
         const auto pos = oldPath.find_last_of('/');
         const std::string dirName = oldPath.substr(pos + 1) + "/";
-        selectorIndex = findEntry(dirName);
+        {
+          RenderLock lock(*this);
+          selectorIndex = files.find(dirName);
+        }
 
         requestUpdate();
       } else {
@@ -225,18 +154,44 @@ void MyLibraryActivity::loop() {
     requestUpdate();
   });
 
-  buttonNavigator.onNextContinuous([this, listSize, pageItems] {
-    selectorIndex = ButtonNavigator::nextPageIndex(static_cast<int>(selectorIndex), listSize, pageItems);
+  // Held buttons step through the initial letters of a long listing, one page at a time otherwise
+  const JumpIndex& jumps = files.getJumpIndex();
+  const bool jumpByLetter = jumps.usable() && listSize > pageItems;
+  buttonNavigator.onNextContinuous([this, &jumps, jumpByLetter, listSize, pageItems] {
+    if (jumpByLetter) {
+      RenderLock lock(*this);
+      selectorIndex = jumps.nextGroupRow(static_cast<int>(selectorIndex));
+      jumpLabel = jumps.labelOf(static_cast<int>(selectorIndex));
+    } else {
+      selectorIndex = ButtonNavigator::nextPageIndex(static_cast<int>(selectorIndex), listSize, pageItems);
+    }
     requestUpdate();
   });
 
-  buttonNavigator.onPreviousContinuous([this, listSize, pageItems] {
-    selectorIndex = ButtonNavigator::previousPageIndex(static_cast<int>(selectorIndex), listSize, pageItems);
+  buttonNavigator.onPreviousContinuous([this, &jumps, jumpByLetter, listSize, pageItems] {
+    if (jumpByLetter) {
+      RenderLock lock(*this);
+      selectorIndex = jumps.previousGroupRow(static_cast<int>(selectorIndex));
+      jumpLabel = jumps.labelOf(static_cast<int>(selectorIndex));
+    } else {
+      selectorIndex = ButtonNavigator::previousPageIndex(static_cast<int>(selectorIndex), listSize, pageItems);
+    }
     requestUpdate();
   });
+
+  if (!jumpLabel.empty() && !ButtonNavigator::isNavigationHeld()) {
+    {
+      RenderLock lock(*this);
+      jumpLabel.clear();
+    }
+    requestUpdate();
+  }
 }
 
 std::string getFileName(std::string filename) {
+  if (filename.empty()) {
+    return filename;
+  }
   if (filename.back() == '/') {
     return filename.substr(0, filename.length() - 1);
   }
@@ -261,8 +216,8 @@ void MyLibraryActivity::render(RenderLock&&) {
   } else {
     GUI.drawList(
         renderer, Rect{0, contentTop, pageWidth, contentHeight}, files.size(), selectorIndex,
-        [this](int index) { return getFileName(files[index]); }, nullptr,
-        [this](int index) { return UITheme::getFileIcon(files[index]); });
+        [this](int index) { return getFileName(files.get(index)); }, nullptr,
+        [this](int index) { return UITheme::getFileIcon(files.get(index)); });
   }
 
   // Help text
@@ -270,11 +225,10 @@ void MyLibraryActivity::render(RenderLock&&) {
                                             tr(STR_DIR_DOWN));
   GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
 
+  if (!jumpLabel.empty()) {
+    // Shows the page as well
+    GUI.drawPopup(renderer, jumpLabel.c_str());
+    return;
+  }
   renderer.displayBuffer();
 }
-
-size_t MyLibraryActivity::findEntry(const std::string& name) const {
-  for (size_t i = 0; i < files.size(); i++)
-    if (files[i] == name) return i;
-  return 0;
-}
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "../Activity.h"
 #include "RecentBooksStore.h"
 #include "util/ButtonNavigator.h"
+#include "util/DirectoryListing.h"
 
 class MyLibraryActivity final : public Activity {
  private:
@@ -17,14 +18,15 @@ class MyLibraryActivity final : public Activity {
   ButtonNavigator buttonNavigator;
 
   size_t selectorIndex = 0;
+  // Label of the group the last held jump landed in, shown until the button is let go
+  std::string jumpLabel;
 
   // Files state
   std::string basepath = "/";
-  std::vector<std::string> files;
+  DirectoryListing files;  // Rows are read on demand, access under the render lock
 
   // Data loading
   void loadFiles();
-  size_t findEntry(const std::string& name) const;
 
  public:
   explicit MyLibraryActivity(GfxRenderer& renderer, MappedInputManager& mappedInput, std::string initialPath = "/")
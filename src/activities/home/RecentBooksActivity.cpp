@@ -6,6 +6,7 @@
 
 #include <algorithm>
 
+#include "../util/KeyboardEntryActivity.h"
 #include "MappedInputManager.h"
 #include "RecentBooksStore.h"
 #include "components/UITheme.h"
@@ -13,54 +14,145 @@
 #include "util/StringUtils.h"
 
 namespace {
-constexpr unsigned long GO_HOME_MS = 1000;
+constexpr size_t MAX_FILTER_LENGTH = 32;
 }  // namespace
 
-void RecentBooksActivity::loadRecentBooks() {
-  recentBooks.clear();
+void RecentBooksActivity::seedFromRecentBooks() {
+  // Books opened before there was a library index are only in the recent list
+  const bool hasRecent = library.open() && library.size(LibraryIndex::Order::RECENT) > 0;
+  library.close();
+  if (hasRecent) {
+    return;
+  }
   const auto& books = RECENT_BOOKS.getBooks();
-  recentBooks.reserve(books.size());
+  for (auto it = books.rbegin(); it != books.rend(); ++it) {
+    if (Storage.exists(it->path.c_str())) {
+      LibraryIndex::bookOpened(it->path, it->title, it->author, false);
+    }
+  }
+}
+
+void RecentBooksActivity::loadBooks() {
+  RenderLock lock(*this);
+  cachedRow = SIZE_MAX;
+  firstRow = 0;
+  bookCount = 0;
+  if (!library.open()) {
+    return;
+  }
+  if (filter.empty()) {
+    bookCount = library.size(order);
+  } else {
+    size_t lastRow;
+    library.findTitlePrefix(filter, firstRow, lastRow);
+    bookCount = lastRow - firstRow;
+  }
+}
 
-  for (const auto& book : books) {
-    // Skip if file no longer exists
-    if (!Storage.exists(book.path.c_str())) {
-      continue;
+const LibraryIndex::Book& RecentBooksActivity::getBook(const size_t row) {
+  // A drawn row asks for its title, subtitle, icon and value in turn
+  if (row != cachedRow) {
+    cachedRow = row;
+    if (!library.get(order, firstRow + row, cachedBook)) {
+      cachedBook = {};
     }
-    recentBooks.push_back(book);
   }
+  return cachedBook;
 }
 
 void RecentBooksActivity::onEnter() {
   Activity::onEnter();
 
-  // Load data
-  loadRecentBooks();
+  seedFromRecentBooks();
+  loadBooks();
 
-  selectorIndex = 0;
+  selectorIndex = bookCount > 0 ? CONTROL_ROWS : SORT_ROW;
   requestUpdate();
 }
 
 void RecentBooksActivity::onExit() {
   Activity::onExit();
-  recentBooks.clear();
+  RenderLock lock(*this);
+  library.close();
+  cachedBook = {};
+}
+
+void RecentBooksActivity::onControlSelected() {
+  if (selectorIndex == SORT_ROW) {
+    switch (order) {
+      case LibraryIndex::Order::RECENT:
+        order = LibraryIndex::Order::TITLE;
+        break;
+      case LibraryIndex::Order::TITLE:
+        order = LibraryIndex::Order::AUTHOR;
+        break;
+      case LibraryIndex::Order::AUTHOR:
+      default:
+        order = LibraryIndex::Order::RECENT;
+        break;
+    }
+    // The filter is a title prefix, only the title order has its matches together
+    filter.clear();
+    loadBooks();
+    requestUpdate();
+    return;
+  }
+
+  startActivityForResult(
+      std::make_unique<KeyboardEntryActivity>(renderer, mappedInput, tr(STR_FILTER_BY_TITLE), filter,
+                                              MAX_FILTER_LENGTH, false),
+      [this](const ActivityResult& result) {
+        if (!result.isCancelled) {
+          filter = std::get<KeyboardResult>(result.data).text;
+          if (!filter.empty()) {
+            order = LibraryIndex::Order::TITLE;
+          }
+          loadBooks();
+          selectorIndex = bookCount > 0 ? CONTROL_ROWS : FILTER_ROW;
+        }
+        requestUpdate();
+      });
 }
 
 void RecentBooksActivity::loop() {
   const int pageItems = UITheme::getInstance().getNumberOfItemsPerPage(renderer, true, false, true, true);
 
   if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
-    if (!recentBooks.empty() && selectorIndex < static_cast<int>(recentBooks.size())) {
-      LOG_DBG("RBA", "Selected recent book: %s", recentBooks[selectorIndex].path.c_str());
-      onSelectBook(recentBooks[selectorIndex].path);
+    if (selectorIndex < CONTROL_ROWS) {
+      onControlSelected();
       return;
     }
+    std::string path;
+    {
+      RenderLock lock(*this);
+      path = getBook(selectorIndex - CONTROL_ROWS).path;
+    }
+    if (path.empty()) {
+      return;
+    }
+    if (!Storage.exists(path.c_str())) {
+      // Deleted or moved behind the device's back (e.g. with the card in a computer)
+      LOG_DBG("RBA", "Dropping missing book: %s", path.c_str());
+      {
+        RenderLock lock(*this);
+        library.close();
+      }
+      LibraryIndex::bookRemoved(path);
+      loadBooks();
+      selectorIndex = bookCount > 0 ? std::min(selectorIndex, CONTROL_ROWS + bookCount - 1) : SORT_ROW;
+      requestUpdate();
+      return;
+    }
+    LOG_DBG("RBA", "Selected book: %s", path.c_str());
+    onSelectBook(path);
+    return;
   }
 
   if (mappedInput.wasReleased(MappedInputManager::Button::Back)) {
     onGoHome();
   }
 
-  int listSize = static_cast<int>(recentBooks.size());
+  int listSize = static_cast<int>(CONTROL_ROWS + bookCount);
 
   buttonNavigator.onNextRelease([this, listSize] {
     selectorIndex = ButtonNavigator::nextIndex(static_cast<int>(selectorIndex), listSize);
@@ -83,6 +175,43 @@ void RecentBooksActivity::loop() {
   });
 }
 
+std::string RecentBooksActivity::getRowTitle(const size_t row) {
+  if (row == SORT_ROW) {
+    return tr(STR_SORT_BY);
+  }
+  if (row == FILTER_ROW) {
+    return tr(STR_FILTER_BY_TITLE);
+  }
+  return getBook(row - CONTROL_ROWS).title;
+}
+
+std::string RecentBooksActivity::getRowSubtitle(const size_t row) {
+  if (row < CONTROL_ROWS) {
+    return "";
+  }
+  const auto& book = getBook(row - CONTROL_ROWS);
+  return book.series.empty() ? book.author : book.author + " - " + book.series;
+}
+
+std::string RecentBooksActivity::getRowValue(const size_t row) {
+  if (row == SORT_ROW) {
+    switch (order) {
+      case LibraryIndex::Order::TITLE:
+        return tr(STR_TITLE);
+      case LibraryIndex::Order::AUTHOR:
+        return tr(STR_AUTHOR);
+      case LibraryIndex::Order::RECENT:
+      default:
+        return tr(STR_RECENTLY_READ);
+    }
+  }
+  if (row == FILTER_ROW) {
+    return filter.empty() ? tr(STR_NONE_OPT) : filter;
+  }
+  const auto& book = getBook(row - CONTROL_ROWS);
+  return book.lastOpened > 0 ? std::to_string(book.progress) + "%" : "";
+}
+
 void RecentBooksActivity::render(RenderLock&&) {
   renderer.clearScreen();
 
@@ -90,23 +219,33 @@ void RecentBooksActivity::render(RenderLock&&) {
   const auto pageHeight = renderer.getScreenHeight();
   const auto& metrics = UITheme::getInstance().getMetrics();
 
-  GUI.drawHeader(renderer, Rect{0, metrics.topPadding, pageWidth, metrics.headerHeight}, tr(STR_MENU_RECENT_BOOKS));
+  GUI.drawHeader(renderer, Rect{0, metrics.topPadding, pageWidth, metrics.headerHeight},
+                 order == LibraryIndex::Order::RECENT ? tr(STR_MENU_RECENT_BOOKS) : tr(STR_BOOKS));
 
   const int contentTop = metrics.topPadding + metrics.headerHeight + metrics.verticalSpacing;
   const int contentHeight = pageHeight - contentTop - metrics.buttonHintsHeight - metrics.verticalSpacing;
 
-  // Recent tab
-  if (recentBooks.empty()) {
-    renderer.drawText(UI_10_FONT_ID, metrics.contentSidePadding, contentTop + 20, tr(STR_NO_RECENT_BOOKS));
-  } else {
-    GUI.drawList(
-        renderer, Rect{0, contentTop, pageWidth, contentHeight}, recentBooks.size(), selectorIndex,
-        [this](int index) { return recentBooks[index].title; }, [this](int index) { return recentBooks[index].author; },
-        [this](int index) { return UITheme::getFileIcon(recentBooks[index].path); });
+  GUI.drawList(
+      renderer, Rect{0, contentTop, pageWidth, contentHeight}, static_cast<int>(CONTROL_ROWS + bookCount),
+      static_cast<int>(selectorIndex), [this](int index) { return getRowTitle(index); },
+      [this](int index) { return getRowSubtitle(index); },
+      [this](int index) {
+        const auto row = static_cast<size_t>(index);
+        if (row == SORT_ROW) return Settings;
+        if (row == FILTER_ROW) return Library;
+        return UITheme::getFileIcon(getBook(row - CONTROL_ROWS).path);
+      },
+      [this](int index) { return getRowValue(index); });
+
+  if (bookCount == 0) {
+    const int emptyTop = contentTop + CONTROL_ROWS * metrics.listWithSubtitleRowHeight + 20;
+    renderer.drawText(UI_10_FONT_ID, metrics.contentSidePadding, emptyTop,
+                      order == LibraryIndex::Order::RECENT ? tr(STR_NO_RECENT_BOOKS) : tr(STR_NO_BOOKS_FOUND));
   }
 
   // Help text
-  const auto labels = mappedInput.mapLabels(tr(STR_HOME), tr(STR_OPEN), tr(STR_DIR_UP), tr(STR_DIR_DOWN));
+  const auto labels = mappedInput.mapLabels(tr(STR_HOME), selectorIndex < CONTROL_ROWS ? tr(STR_SELECT) : tr(STR_OPEN),
+                                            tr(STR_DIR_UP), tr(STR_DIR_DOWN));
   GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
 
   renderer.displayBuffer();
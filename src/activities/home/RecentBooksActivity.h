@@ -1,6 +1,7 @@
 #pragma once
 #include <I18n.h>
 
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -8,18 +9,40 @@
 #include "../Activity.h"
 #include "RecentBooksStore.h"
 #include "util/ButtonNavigator.h"
+#include "util/LibraryIndex.h"
 
+// Books of the library index: the ones being read, most recent first, or every indexed book by title or author,
+// optionally filtered to the titles starting with some text. Two rows above the books switch the order and set the
+// filter. Rows are read from the index as they are drawn, so long lists cost no memory.
 class RecentBooksActivity final : public Activity {
  private:
+  static constexpr size_t SORT_ROW = 0;
+  static constexpr size_t FILTER_ROW = 1;
+  static constexpr size_t CONTROL_ROWS = 2;
+
   ButtonNavigator buttonNavigator;
 
   size_t selectorIndex = 0;
 
-  // Recent tab state
-  std::vector<RecentBook> recentBooks;
+  LibraryIndex::Order order = LibraryIndex::Order::RECENT;
+  std::string filter;  // Title prefix; setting one switches to the title order
+
+  // Listed books are rows [firstRow, firstRow + bookCount) of the order; access under the render lock
+  LibraryIndex library;
+  size_t firstRow = 0;
+  size_t bookCount = 0;
+  size_t cachedRow = SIZE_MAX;
+  LibraryIndex::Book cachedBook;
 
   // Data loading
-  void loadRecentBooks();
+  void seedFromRecentBooks();
+  void loadBooks();
+  const LibraryIndex::Book& getBook(size_t row);
+
+  void onControlSelected();
+  std::string getRowTitle(size_t row);
+  std::string getRowSubtitle(size_t row);
+  std::string getRowValue(size_t row);
 
  public:
   explicit RecentBooksActivity(GfxRenderer& renderer, MappedInputManager& mappedInput)
@@ -4,10 +4,10 @@
 #include <GfxRenderer.h>
 #include <I18n.h>
 #include <WiFi.h>
-#include <esp_task_wdt.h>
 
 #include "MappedInputManager.h"
 #include "WifiSelectionActivity.h"
+#include "activities/reader/EpubReaderActivity.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
 
@@ -22,7 +22,6 @@ void CalibreConnectActivity::onEnter() {
   state = CalibreConnectState::WIFI_SELECTION;
   connectedIP.clear();
   connectedSSID.clear();
-  lastHandleClientTime = 0;
   lastProgressReceived = 0;
   lastProgressTotal = 0;
   currentUploadName.clear();
@@ -83,6 +82,13 @@ void CalibreConnectActivity::startWebServer() {
   webServer->begin();
 
   if (webServer->isRunning()) {
+    {
+      // The layout math switches the renderer to the reader orientation for a moment
+      RenderLock lock(*this);
+      const auto layout = EpubReaderActivity::getLayoutParams(renderer);
+      webServer->setReaderLayout(layout);
+      cacheWarmer.start(*webServer, layout);
+    }
     state = CalibreConnectState::SERVER_RUNNING;
     requestUpdate();
   } else {
@@ -92,6 +98,7 @@ void CalibreConnectActivity::startWebServer() {
 }
 
 void CalibreConnectActivity::stopWebServer() {
+  cacheWarmer.stop();
   if (webServer) {
     webServer->stop();
     webServer.reset();
@@ -104,28 +111,7 @@ void CalibreConnectActivity::loop() {
   }
 
   if (webServer && webServer->isRunning()) {
-    const unsigned long timeSinceLastHandleClient = millis() - lastHandleClientTime;
-    if (lastHandleClientTime > 0 && timeSinceLastHandleClient > 100) {
-      LOG_DBG("CAL", "WARNING: %lu ms gap since last handleClient", timeSinceLastHandleClient);
-    }
-
-    esp_task_wdt_reset();
-    constexpr int MAX_ITERATIONS = 80;
-    for (int i = 0; i < MAX_ITERATIONS && webServer->isRunning(); i++) {
-      webServer->handleClient();
-      if ((i & 0x07) == 0x07) {
-        esp_task_wdt_reset();
-      }
-      if ((i & 0x0F) == 0x0F) {
-        yield();
-        if (mappedInput.wasPressed(MappedInputManager::Button::Back)) {
-          exitRequested = true;
-          break;
-        }
-      }
-    }
-    lastHandleClientTime = millis();
-
+    // The server task handles the requests; just follow its upload progress for the status screen
     const auto status = webServer->getWsUploadStatus();
     bool changed = false;
     if (status.inProgress) {
@@ -4,6 +4,7 @@
 #include <memory>
 #include <string>
 
+#include "UploadCacheWarmer.h"
 #include "activities/Activity.h"
 #include "network/CrossPointWebServer.h"
 
@@ -17,9 +18,10 @@ class CalibreConnectActivity final : public Activity {
   CalibreConnectState state = CalibreConnectState::WIFI_SELECTION;
 
   std::unique_ptr<CrossPointWebServer> webServer;
+  // Prepares received books while the link is idle
+  UploadCacheWarmer cacheWarmer{renderer};
   std::string connectedIP;
   std::string connectedSSID;
-  unsigned long lastHandleClientTime = 0;
   size_t lastProgressReceived = 0;
   size_t lastProgressTotal = 0;
   std::string currentUploadName;
@@ -41,6 +43,5 @@ class CalibreConnectActivity final : public Activity {
   void onExit() override;
   void loop() override;
   void render(RenderLock&&) override;
-  bool skipLoopDelay() override { return webServer && webServer->isRunning(); }
   bool preventAutoSleep() override { return webServer && webServer->isRunning(); }
 };
@@ -3,18 +3,21 @@
 #include <DNSServer.h>
 #include <ESPmDNS.h>
 #include <GfxRenderer.h>
+#include <HalGPIO.h>
 #include <I18n.h>
 #include <WiFi.h>
-#include <esp_task_wdt.h>
 
 #include <cstddef>
 
 #include "MappedInputManager.h"
 #include "NetworkModeSelectionActivity.h"
 #include "WifiSelectionActivity.h"
+#include "activities/ActivityManager.h"
 #include "activities/network/CalibreConnectActivity.h"
+#include "activities/reader/EpubReaderActivity.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
+#include "network/SyncQueueFlusher.h"
 #include "util/QrUtils.h"
 
 namespace {
@@ -32,6 +35,8 @@ DNSServer* dnsServer = nullptr;
 constexpr uint16_t DNS_PORT = 53;
 }  // namespace
 
+extern HalGPIO gpio;  // Defined in main.cpp
+
 void CrossPointWebServerActivity::onEnter() {
   Activity::onEnter();
 
@@ -41,9 +46,9 @@ void CrossPointWebServerActivity::onEnter() {
   state = WebServerActivityState::MODE_SELECTION;
   networkMode = NetworkMode::JOIN_NETWORK;
   isApMode = false;
+  syncQueueFlushed = false;
   connectedIP.clear();
   connectedSSID.clear();
-  lastHandleClientTime = 0;
   requestUpdate();
 
   // Launch network mode selection subactivity
@@ -248,6 +253,14 @@ void CrossPointWebServerActivity::startWebServer() {
     state = WebServerActivityState::SERVER_RUNNING;
     LOG_DBG("WEBACT", "Web server started successfully");
 
+    {
+      // The layout math switches the renderer to the reader orientation for a moment
+      RenderLock lock(*this);
+      const auto layout = EpubReaderActivity::getLayoutParams(renderer);
+      webServer->setReaderLayout(layout);
+      cacheWarmer.start(*webServer, layout);
+    }
+
     // Force an immediate render since we're transitioning from a subactivity
     // that had its own rendering task. We need to make sure our display is shown.
     requestUpdate();
@@ -260,6 +273,7 @@ void CrossPointWebServerActivity::startWebServer() {
 }
 
 void CrossPointWebServerActivity::stopWebServer() {
+  cacheWarmer.stop();
   if (webServer && webServer->isRunning()) {
     LOG_DBG("WEBACT", "Stopping web server...");
     webServer->stop();
@@ -268,6 +282,18 @@ void CrossPointWebServerActivity::stopWebServer() {
   webServer.reset();
 }
 
+void CrossPointWebServerActivity::exitServer() {
+  // Books the warmer didn't get to, with the charger in: build their caches now rather than on first open
+  cacheWarmer.stop();
+  std::vector<std::string> books = cacheWarmer.takePending();
+  if (!books.empty() && gpio.isUsbConnected()) {
+    LOG_DBG("WEBACT", "%zu received books still unprepared on USB power, preparing them", books.size());
+    activityManager.goToPrepareLibrary(std::move(books));
+    return;
+  }
+  onGoHome();
+}
+
 void CrossPointWebServerActivity::loop() {
   // Handle different states
   if (state == WebServerActivityState::SERVER_RUNNING) {
@@ -297,46 +323,15 @@ void CrossPointWebServerActivity::loop() {
       }
     }
 
-    // Handle web server requests - maximize throughput with watchdog safety
-    if (webServer && webServer->isRunning()) {
-      const unsigned long timeSinceLastHandleClient = millis() - lastHandleClientTime;
-
-      // Log if there's a significant gap between handleClient calls (>100ms)
-      if (lastHandleClientTime > 0 && timeSinceLastHandleClient > 100) {
-        LOG_DBG("WEBACT", "WARNING: %lu ms gap since last handleClient", timeSinceLastHandleClient);
-      }
-
-      // Reset watchdog BEFORE processing - HTTP header parsing can be slow
-      esp_task_wdt_reset();
-
-      // Process HTTP requests in tight loop for maximum throughput
-      // More iterations = more data processed per main loop cycle
-      constexpr int MAX_ITERATIONS = 500;
-      for (int i = 0; i < MAX_ITERATIONS && webServer->isRunning(); i++) {
-        webServer->handleClient();
-        // Reset watchdog every 32 iterations
-        if ((i & 0x1F) == 0x1F) {
-          esp_task_wdt_reset();
-        }
-        // Yield and check for exit button every 64 iterations
-        if ((i & 0x3F) == 0x3F) {
-          yield();
-          // Force trigger an update of which buttons are being pressed so be have accurate state
-          // for back button checking
-          mappedInput.update();
-          // Check for exit button inside loop for responsiveness
-          if (mappedInput.wasPressed(MappedInputManager::Button::Back)) {
-            onGoHome();
-            return;
-          }
-        }
-      }
-      lastHandleClientTime = millis();
+    // Already online: send the queued KOReader positions once, while the web server keeps serving on its task
+    if (!isApMode && !syncQueueFlushed) {
+      syncQueueFlushed = true;
+      SyncQueueFlusher::flushIfConnected();
     }
 
-    // Handle exit on Back button (also check outside loop)
+    // Requests are served by the web server's own task; only the exit button is handled here
     if (mappedInput.wasPressed(MappedInputManager::Button::Back)) {
-      onGoHome();
+      exitServer();
       return;
     }
   }
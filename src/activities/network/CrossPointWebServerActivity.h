@@ -5,6 +5,7 @@
 #include <string>
 
 #include "NetworkModeSelectionActivity.h"
+#include "UploadCacheWarmer.h"
 #include "activities/Activity.h"
 #include "network/CrossPointWebServer.h"
 
@@ -24,7 +25,7 @@ enum class WebServerActivityState {
  * - For STA mode: Launches WifiSelectionActivity to connect to an existing network
  * - For AP mode: Creates an Access Point that clients can connect to
  * - Starts the CrossPointWebServer when connected
- * - Handles client requests in its loop() function
+ * - Leaves request handling to the server's own task, so redraws never stall a transfer
  * - Cleans up the server and shuts down WiFi on exit
  */
 class CrossPointWebServerActivity final : public Activity {
@@ -33,17 +34,18 @@ class CrossPointWebServerActivity final : public Activity {
   // Network mode
   NetworkMode networkMode = NetworkMode::JOIN_NETWORK;
   bool isApMode = false;
+  // Queued KOReader positions go out once per session, as soon as the server is up on a joined network
+  bool syncQueueFlushed = false;
 
   // Web server - owned by this activity
   std::unique_ptr<CrossPointWebServer> webServer;
+  // Prepares received books while the link is idle
+  UploadCacheWarmer cacheWarmer{renderer};
 
   // Server status
   std::string connectedIP;
   std::string connectedSSID;  // For STA mode: network name, For AP mode: AP name
 
-  // Performance monitoring
-  unsigned long lastHandleClientTime = 0;
-
   void renderServerRunning() const;
 
   void onNetworkModeSelected(NetworkMode mode);
@@ -51,6 +53,7 @@ class CrossPointWebServerActivity final : public Activity {
   void startAccessPoint();
   void startWebServer();
   void stopWebServer();
+  void exitServer();
 
  public:
   explicit CrossPointWebServerActivity(GfxRenderer& renderer, MappedInputManager& mappedInput)
@@ -59,6 +62,5 @@ class CrossPointWebServerActivity final : public Activity {
   void onExit() override;
   void loop() override;
   void render(RenderLock&&) override;
-  bool skipLoopDelay() override { return webServer && webServer->isRunning(); }
   bool preventAutoSleep() override { return webServer && webServer->isRunning(); }
 };
@@ -0,0 +1,79 @@
+#include "UploadCacheWarmer.h"
+
+#include <Arduino.h>
+#include <Logging.h>
+
+#include <algorithm>
+
+#include "activities/RenderLock.h"
+#include "activities/settings/BookPreparer.h"
+#include "network/CrossPointWebServer.h"
+
+void UploadCacheWarmer::start(const CrossPointWebServer& server, const SectionPrefetcher::LayoutParams& params) {
+  if (BACKGROUND_JOBS.isQueued(*this)) {
+    return;
+  }
+
+  this->server = &server;
+  this->params = params;
+  // Behind anything the reader submits; the worker's priority 0 already keeps it below the web server
+  if (!BACKGROUND_JOBS.submit(*this, Priority::Low)) {
+    LOG_ERR("UCW", "Failed to start warmer job");
+  }
+}
+
+void UploadCacheWarmer::stop() { BACKGROUND_JOBS.cancel(*this); }
+
+std::vector<std::string> UploadCacheWarmer::takePending() {
+  std::vector<std::string> books(pending.begin(), pending.end());
+  pending.clear();
+  if (server) {
+    for (auto& book : server->takeUploadedBooks()) {
+      if (std::find(books.begin(), books.end(), book) == books.end()) {
+        books.push_back(std::move(book));
+      }
+    }
+  }
+  return books;
+}
+
+bool UploadCacheWarmer::canWork() const {
+  // Parsing a book with the WiFi stack up is tight; leave it for after the session rather than starve the server
+  return !server->isTransferActive(QUIET_MS) && ESP.getFreeHeap() >= MIN_FREE_HEAP;
+}
+
+bool UploadCacheWarmer::shouldAbort() const {
+  // Stand aside while a screen is drawn so the render task gets the SD card to itself
+  while (!isCancelled() && RenderLock::peek()) {
+    delay(5);
+  }
+  return isCancelled() || server->isTransferActive(0);
+}
+
+bool UploadCacheWarmer::step() {
+  for (auto& book : server->takeUploadedBooks()) {
+    // A book sent again while queued is prepared once, in its new place in line
+    pending.erase(std::remove(pending.begin(), pending.end(), book), pending.end());
+    pending.push_back(std::move(book));
+  }
+
+  // Runs until stop(); an idle step sleeps so the worker doesn't spin while the screen is up
+  if (pending.empty() || !canWork()) {
+    delay(POLL_MS);
+    return true;
+  }
+
+  // Uploads stay Interactive, the worker's Background class keeps these reads below them
+  BookPreparer preparer(renderer, params, [this]() { return shouldAbort(); });
+  const std::string& path = pending.front();
+  const unsigned long start = millis();
+  const bool prepared = preparer.prepare(path);
+  if (preparer.aborted()) {
+    // Stays at the front; sections built so far are reused on the next attempt
+    LOG_DBG("UCW", "Paused %s", path.c_str());
+    return true;
+  }
+  LOG_DBG("UCW", "%s %s in %lu ms", prepared ? "Prepared" : "Failed to prepare", path.c_str(), millis() - start);
+  pending.pop_front();
+  return true;
+}
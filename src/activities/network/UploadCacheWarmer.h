@@ -0,0 +1,47 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "BackgroundJobs.h"
+#include "activities/reader/SectionPrefetcher.h"
+
+class CrossPointWebServer;
+class GfxRenderer;
+
+// Builds the caches of books received by the web server while the transfer screen is up, so they open instantly
+// afterwards. Runs as a background job, one book per step, and only while the link is quiet: whenever upload data
+// arrives the book in progress is put back at the front of the queue and picked up again once the transfer is over.
+class UploadCacheWarmer final : public BackgroundJob {
+ public:
+  explicit UploadCacheWarmer(GfxRenderer& renderer) : BackgroundJob("UploadWarmer"), renderer(renderer) {}
+  ~UploadCacheWarmer() { stop(); }
+
+  UploadCacheWarmer(const UploadCacheWarmer&) = delete;
+  UploadCacheWarmer& operator=(const UploadCacheWarmer&) = delete;
+
+  // params must be taken under the render lock, see EpubReaderActivity::getLayoutParams
+  void start(const CrossPointWebServer& server, const SectionPrefetcher::LayoutParams& params);
+  // Cancel the job; blocks until the worker has finished its current section
+  void stop();
+  // After stop(): books received but not prepared yet, including any the server still holds
+  std::vector<std::string> takePending();
+
+ protected:
+  bool step() override;
+
+ private:
+  static constexpr uint32_t MIN_FREE_HEAP = 64 * 1024;
+  // How long the link has to be idle before the card is used for anything else
+  static constexpr unsigned long QUIET_MS = 3000;
+  static constexpr unsigned long POLL_MS = 500;
+
+  GfxRenderer& renderer;
+  const CrossPointWebServer* server = nullptr;
+  SectionPrefetcher::LayoutParams params;
+  std::deque<std::string> pending;  // Owned by the worker while the job is queued
+
+  bool canWork() const;
+  bool shouldAbort() const;
+};
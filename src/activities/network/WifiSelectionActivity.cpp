@@ -4,8 +4,9 @@
 #include <I18n.h>
 #include <Logging.h>
 #include <WiFi.h>
+#include <esp_wifi.h>
 
-#include <map>
+#include <algorithm>
 
 #include "MappedInputManager.h"
 #include "WifiCredentialStore.h"
@@ -13,6 +14,16 @@
 #include "components/UITheme.h"
 #include "fontIds.h"
 
+namespace {
+// Last complete scan. A plain vector rather than the activity arena, which is rewound when the activity exits.
+struct ScanCache {
+  std::vector<WifiNetworkInfo> networks;
+  unsigned long takenAt = 0;
+  bool valid = false;
+};
+ScanCache scanCache;
+}  // namespace
+
 void WifiSelectionActivity::onEnter() {
   Activity::onEnter();
 
@@ -35,6 +46,8 @@ void WifiSelectionActivity::onEnter() {
   savePromptSelection = 0;
   forgetPromptSelection = 0;
   autoConnecting = false;
+  fastConnecting = false;
+  fastConnectFailed = false;
 
   // Cache MAC address for display
   uint8_t mac[6];
@@ -66,8 +79,8 @@ void WifiSelectionActivity::onEnter() {
     }
   }
 
-  // Fallback to scanning
-  startWifiScan();
+  // Fallback to the network list
+  showNetworkList();
 }
 
 void WifiSelectionActivity::onExit() {
@@ -77,6 +90,9 @@ void WifiSelectionActivity::onExit() {
 
   // Stop any ongoing WiFi scan
   LOG_DBG("WIFI", "Deleting WiFi scan...");
+  if (scanChannel > 0) {
+    stopWifiScan();
+  }
   WiFi.scanDelete();
   LOG_DBG("WIFI", "Free heap after scanDelete: %d bytes", ESP.getFreeHeap());
 
@@ -87,10 +103,30 @@ void WifiSelectionActivity::onExit() {
   LOG_DBG("WIFI", "Free heap at onExit end: %d bytes", ESP.getFreeHeap());
 }
 
+void WifiSelectionActivity::showNetworkList() {
+  if (!scanCache.valid || millis() - scanCache.takenAt > SCAN_CACHE_TTL_MS) {
+    startWifiScan();
+    return;
+  }
+
+  LOG_DBG("WIFI", "Showing the scan from %lu ms ago", millis() - scanCache.takenAt);
+  autoConnecting = false;
+  networks.assign(scanCache.networks.begin(), scanCache.networks.end());
+  // Credentials may have been saved or forgotten since
+  for (auto& network : networks) {
+    network.hasSavedPassword = WIFI_STORE.hasSavedCredential(network.ssid);
+  }
+  sortNetworks();
+  selectedNetworkIndex = 0;
+  state = WifiSelectionState::NETWORK_LIST;
+  requestUpdate();
+}
+
 void WifiSelectionActivity::startWifiScan() {
   autoConnecting = false;
   state = WifiSelectionState::SCANNING;
   networks.clear();
+  selectedNetworkIndex = 0;
   requestUpdate();
 
   // Set WiFi mode to station
@@ -98,8 +134,19 @@ void WifiSelectionActivity::startWifiScan() {
   WiFi.disconnect();
   delay(100);
 
-  // Start async scan
-  WiFi.scanNetworks(true);  // true = async scan
+  scanChannel = 1;
+  startChannelScan();
+}
+
+void WifiSelectionActivity::startChannelScan() {
+  // Async, active scan of one channel, hidden networks left out
+  WiFi.scanNetworks(true, false, false, SCAN_MS_PER_CHANNEL, scanChannel);
+}
+
+void WifiSelectionActivity::stopWifiScan() {
+  esp_wifi_scan_stop();
+  WiFi.scanDelete();
+  scanChannel = 0;
 }
 
 void WifiSelectionActivity::processWifiScanResults() {
@@ -111,16 +158,37 @@ void WifiSelectionActivity::processWifiScanResults() {
   }
 
   if (scanResult == WIFI_SCAN_FAILED) {
-    state = WifiSelectionState::NETWORK_LIST;
+    LOG_DBG("WIFI", "Scan of channel %u failed", scanChannel);
+  } else {
+    // The list is on screen while it grows
+    RenderLock lock(*this);
+    mergeScanResults(scanResult);
+  }
+  WiFi.scanDelete();
+
+  if (scanChannel < SCAN_CHANNELS) {
+    scanChannel++;
+    startChannelScan();
     requestUpdate();
     return;
   }
 
-  // Scan complete, process results
-  // Use a map to deduplicate networks by SSID, keeping the strongest signal
-  std::map<std::string, WifiNetworkInfo> uniqueNetworks;
+  // Scan complete; an empty one (radio trouble, or really nothing in range) isn't worth keeping
+  scanChannel = 0;
+  if (!networks.empty()) {
+    scanCache.networks.assign(networks.begin(), networks.end());
+    scanCache.takenAt = millis();
+    scanCache.valid = true;
+  }
+  state = WifiSelectionState::NETWORK_LIST;
+  requestUpdate();
+}
+
+void WifiSelectionActivity::mergeScanResults(const int16_t count) {
+  // Keep the selection on the same network while the list grows and reorders
+  const std::string selected = selectedNetworkIndex < networks.size() ? networks[selectedNetworkIndex].ssid : "";
 
-  for (int i = 0; i < scanResult; i++) {
+  for (int i = 0; i < count; i++) {
     std::string ssid = WiFi.SSID(i).c_str();
     const int32_t rssi = WiFi.RSSI(i);
 
@@ -129,38 +197,40 @@ void WifiSelectionActivity::processWifiScanResults() {
       continue;
     }
 
-    // Check if we've already seen this SSID
-    auto it = uniqueNetworks.find(ssid);
-    if (it == uniqueNetworks.end() || rssi > it->second.rssi) {
-      // New network or stronger signal than existing entry
+    // Deduplicate networks by SSID, keeping the strongest signal
+    auto it = std::find_if(networks.begin(), networks.end(),
+                           [&ssid](const WifiNetworkInfo& network) { return network.ssid == ssid; });
+    if (it == networks.end()) {
       WifiNetworkInfo network;
-      network.ssid = ssid;
+      network.ssid = std::move(ssid);
       network.rssi = rssi;
       network.isEncrypted = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
       network.hasSavedPassword = WIFI_STORE.hasSavedCredential(network.ssid);
-      uniqueNetworks[ssid] = network;
+      networks.push_back(std::move(network));
+    } else if (rssi > it->rssi) {
+      it->rssi = rssi;
+      it->isEncrypted = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
     }
   }
 
-  // Convert map to vector
-  networks.clear();
-  for (const auto& pair : uniqueNetworks) {
-    // cppcheck-suppress useStlAlgorithm
-    networks.push_back(pair.second);
+  sortNetworks();
+  selectedNetworkIndex = 0;
+  for (size_t i = 0; i < networks.size(); i++) {
+    if (networks[i].ssid == selected) {
+      selectedNetworkIndex = i;
+      break;
+    }
   }
+}
 
-  // Sort: saved-password networks first, then by signal strength (strongest first)
+void WifiSelectionActivity::sortNetworks() {
+  // Saved-password networks first, then by signal strength (strongest first)
   std::sort(networks.begin(), networks.end(), [](const WifiNetworkInfo& a, const WifiNetworkInfo& b) {
     if (a.hasSavedPassword != b.hasSavedPassword) {
       return a.hasSavedPassword;
     }
     return a.rssi > b.rssi;
   });
-
-  WiFi.scanDelete();
-  state = WifiSelectionState::NETWORK_LIST;
-  selectedNetworkIndex = 0;
-  requestUpdate();
 }
 
 void WifiSelectionActivity::selectNetwork(const int index) {
@@ -170,6 +240,7 @@ void WifiSelectionActivity::selectNetwork(const int index) {
 
   const auto& network = networks[index];
   selectedSSID = network.ssid;
+  fastConnectFailed = false;
   selectedRequiresPassword = network.isEncrypted;
   usedSavedPassword = false;
   enteredPassword.clear();
@@ -224,10 +295,14 @@ void WifiSelectionActivity::attemptConnection() {
   String hostname = "CrossPoint-Reader-" + mac;
   WiFi.setHostname(hostname.c_str());
 
-  if (selectedRequiresPassword && !enteredPassword.empty()) {
-    WiFi.begin(selectedSSID.c_str(), enteredPassword.c_str());
+  const char* password = selectedRequiresPassword && !enteredPassword.empty() ? enteredPassword.c_str() : nullptr;
+  const auto* cred = usedSavedPassword || !selectedRequiresPassword ? WIFI_STORE.findCredential(selectedSSID) : nullptr;
+  fastConnecting = cred && cred->channel > 0 && !fastConnectFailed;
+  if (fastConnecting) {
+    LOG_DBG("WIFI", "Fast connect to %s on channel %d", selectedSSID.c_str(), cred->channel);
+    WiFi.begin(selectedSSID.c_str(), password, cred->channel, cred->bssid);
   } else {
-    WiFi.begin(selectedSSID.c_str());
+    WiFi.begin(selectedSSID.c_str(), password);
   }
 }
 
@@ -245,12 +320,15 @@ void WifiSelectionActivity::checkConnectionStatus() {
     snprintf(ipStr, sizeof(ipStr), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
     connectedIP = ipStr;
     autoConnecting = false;
+    LOG_DBG("WIFI", "Connected in %lu ms%s", millis() - connectionStartTime, fastConnecting ? " (fast)" : "");
+    fastConnecting = false;
 
     // Save this as the last connected network - SD card operations need lock as
     // we use SPI for both
     {
       RenderLock lock(*this);
       WIFI_STORE.setLastConnectedSsid(selectedSSID);
+      WIFI_STORE.setLastAccessPoint(selectedSSID, WiFi.BSSID(), WiFi.channel());
     }
 
     // If we entered a new password, ask if user wants to save it
@@ -269,6 +347,16 @@ void WifiSelectionActivity::checkConnectionStatus() {
     return;
   }
 
+  if (fastConnecting && (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL ||
+                         millis() - connectionStartTime > FAST_CONNECT_TIMEOUT_MS)) {
+    // The access point moved channel, or another one of the network is in range now
+    LOG_DBG("WIFI", "Fast connect failed, connecting with a scan");
+    WiFi.disconnect();
+    fastConnectFailed = true;
+    attemptConnection();
+    return;
+  }
+
   if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL) {
     connectionError = tr(STR_ERROR_GENERAL_FAILURE);
     if (status == WL_NO_SSID_AVAIL) {
@@ -290,9 +378,33 @@ void WifiSelectionActivity::checkConnectionStatus() {
 }
 
 void WifiSelectionActivity::loop() {
-  // Check scan progress
+  // Check scan progress; the networks found so far can already be picked
   if (state == WifiSelectionState::SCANNING) {
     processWifiScanResults();
+    if (state != WifiSelectionState::SCANNING) {
+      return;
+    }
+    if (mappedInput.wasPressed(MappedInputManager::Button::Back)) {
+      stopWifiScan();
+      onComplete(false);
+      return;
+    }
+    if (networks.empty()) {
+      return;
+    }
+    if (mappedInput.wasPressed(MappedInputManager::Button::Confirm)) {
+      stopWifiScan();
+      selectNetwork(selectedNetworkIndex);
+      return;
+    }
+    buttonNavigator.onNext([this] {
+      selectedNetworkIndex = ButtonNavigator::nextIndex(selectedNetworkIndex, networks.size());
+      requestUpdate();
+    });
+    buttonNavigator.onPrevious([this] {
+      selectedNetworkIndex = ButtonNavigator::previousIndex(selectedNetworkIndex, networks.size());
+      requestUpdate();
+    });
     return;
   }
 
@@ -356,18 +468,12 @@ void WifiSelectionActivity::loop() {
         RenderLock lock(*this);
         // User chose "Forget network" - forget the network
         WIFI_STORE.removeCredential(selectedSSID);
-        // Update the network list to reflect the change
-        const auto network = find_if(networks.begin(), networks.end(),
-                                     [this](const WifiNetworkInfo& net) { return net.ssid == selectedSSID; });
-        if (network != networks.end()) {
-          network->hasSavedPassword = false;
-        }
       }
       // Go back to network list (whether Cancel or Forget network was selected)
-      startWifiScan();
+      showNetworkList();
     } else if (mappedInput.wasPressed(MappedInputManager::Button::Back)) {
       // Skip forgetting, go back to network list
-      startWifiScan();
+      showNetworkList();
     }
     return;
   }
@@ -488,7 +594,11 @@ void WifiSelectionActivity::render(RenderLock&&) {
       renderConnecting();
       break;
     case WifiSelectionState::SCANNING:
-      renderConnecting();  // Reuse connecting screen with different message
+      if (networks.empty()) {
+        renderConnecting();  // Reuse connecting screen with different message
+      } else {
+        renderNetworkList();
+      }
       break;
     case WifiSelectionState::NETWORK_LIST:
       renderNetworkList();
@@ -537,14 +647,19 @@ void WifiSelectionActivity::renderNetworkList() const {
         });
   }
 
+  // While the scan runs, its progress takes the place of the legend
+  const bool scanning = state == WifiSelectionState::SCANNING;
+  char scanProgress[48];
+  snprintf(scanProgress, sizeof(scanProgress), "%s %u/%u", tr(STR_SCANNING), scanChannel, SCAN_CHANNELS);
   GUI.drawHelpText(renderer,
                    Rect{0, pageHeight - metrics.buttonHintsHeight - metrics.contentSidePadding - 15, pageWidth, 20},
-                   tr(STR_NETWORK_LEGEND));
+                   scanning ? scanProgress : tr(STR_NETWORK_LEGEND));
 
   const bool hasSavedPassword = !networks.empty() && networks[selectedNetworkIndex].hasSavedPassword;
-  const char* forgetLabel = hasSavedPassword ? tr(STR_FORGET_BUTTON) : "";
+  const char* forgetLabel = hasSavedPassword && !scanning ? tr(STR_FORGET_BUTTON) : "";
 
-  const auto labels = mappedInput.mapLabels(tr(STR_BACK), tr(STR_CONNECT), forgetLabel, tr(STR_RETRY));
+  const auto labels =
+      mappedInput.mapLabels(tr(STR_BACK), tr(STR_CONNECT), forgetLabel, scanning ? "" : tr(STR_RETRY));
   GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
 }
 
@@ -554,7 +669,9 @@ void WifiSelectionActivity::renderConnecting() const {
   const auto top = (pageHeight - height) / 2;
 
   if (state == WifiSelectionState::SCANNING) {
-    renderer.drawCenteredText(UI_10_FONT_ID, top, tr(STR_SCANNING));
+    char scanProgress[48];
+    snprintf(scanProgress, sizeof(scanProgress), "%s %u/%u", tr(STR_SCANNING), scanChannel, SCAN_CHANNELS);
+    renderer.drawCenteredText(UI_10_FONT_ID, top, scanProgress);
   } else {
     renderer.drawCenteredText(UI_12_FONT_ID, top - 40, tr(STR_CONNECTING), true, EpdFontFamily::BOLD);
 
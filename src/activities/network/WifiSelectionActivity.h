@@ -21,7 +21,7 @@ struct WifiNetworkInfo {
 // WiFi selection states
 enum class WifiSelectionState {
   AUTO_CONNECTING,    // Trying to connect to the last known network
-  SCANNING,           // Scanning for networks
+  SCANNING,           // Scanning for networks, one channel at a time; found networks are listed meanwhile
   NETWORK_LIST,       // Displaying available networks
   PASSWORD_ENTRY,     // Entering password for selected network
   CONNECTING,         // Attempting to connect
@@ -47,7 +47,7 @@ class WifiSelectionActivity final : public Activity {
 
   WifiSelectionState state = WifiSelectionState::SCANNING;
   size_t selectedNetworkIndex = 0;
-  std::vector<WifiNetworkInfo> networks;
+  ActivityVector<WifiNetworkInfo> networks;
 
   // Selected network for connection
   std::string selectedSSID;
@@ -80,6 +80,12 @@ class WifiSelectionActivity final : public Activity {
   static constexpr unsigned long CONNECTION_TIMEOUT_MS = 15000;
   unsigned long connectionStartTime = 0;
 
+  // A saved network is first joined on the access point and channel that worked last time, which skips the scan
+  // of every channel. If that doesn't connect quickly, the normal connect (with its scan) follows.
+  static constexpr unsigned long FAST_CONNECT_TIMEOUT_MS = 3000;
+  bool fastConnecting = false;
+  bool fastConnectFailed = false;
+
   void renderNetworkList() const;
   void renderPasswordEntry() const;
   void renderConnecting() const;
@@ -88,8 +94,21 @@ class WifiSelectionActivity final : public Activity {
   void renderConnectionFailed() const;
   void renderForgetPrompt() const;
 
+  // Networks are scanned one channel at a time, so the list fills in while the scan runs. A complete scan is kept
+  // for SCAN_CACHE_TTL_MS: entering the screen again within that time (from another network activity, or after
+  // forgetting a network) shows it at once. Retry always scans.
+  static constexpr uint8_t SCAN_CHANNELS = 13;
+  static constexpr uint32_t SCAN_MS_PER_CHANNEL = 300;
+  static constexpr unsigned long SCAN_CACHE_TTL_MS = 60000;
+  uint8_t scanChannel = 0;  // Channel being scanned, 0 while no scan runs
+
+  void showNetworkList();
   void startWifiScan();
+  void startChannelScan();
+  void stopWifiScan();
   void processWifiScanResults();
+  void mergeScanResults(int16_t count);
+  void sortNetworks();
   void selectNetwork(int index);
   void attemptConnection();
   void checkConnectionStatus();
@@ -1,25 +1,38 @@
 #include "EpubReaderActivity.h"
 
+#include <Epub/FootnoteStore.h>
 #include <Epub/Page.h>
 #include <Epub/blocks/TextBlock.h>
+#include <Epub/parsers/XmlParserPool.h>
 #include <FsHelpers.h>
 #include <GfxRenderer.h>
+#include <HalPowerManager.h>
 #include <HalStorage.h>
 #include <I18n.h>
 #include <Logging.h>
+#include <Trace.h>
+
+#include <algorithm>
 
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "EpubReaderChapterSelectionActivity.h"
+#include "EpubReaderDictionaryActivity.h"
 #include "EpubReaderFootnotesActivity.h"
 #include "EpubReaderPercentSelectionActivity.h"
+#include "EpubReaderSearchActivity.h"
 #include "KOReaderCredentialStore.h"
+#include "KOReaderDocumentId.h"
 #include "KOReaderSyncActivity.h"
+#include "KOReaderSyncQueue.h"
 #include "MappedInputManager.h"
+#include "ProgressJournal.h"
 #include "QrDisplayActivity.h"
 #include "RecentBooksStore.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
+#include "util/BookCacheIndex.h"
+#include "util/LibraryIndex.h"
 #include "util/ScreenshotUtil.h"
 
 namespace {
@@ -28,6 +41,17 @@ constexpr unsigned long skipChapterMs = 700;
 constexpr unsigned long goHomeMs = 1000;
 // pages per minute, first item is 1 to prevent division by zero if accessed
 const std::vector<int> PAGE_TURN_LABELS = {1, 1, 3, 6, 12};
+// Upper bound for a compressed pre-rendered page; dense pages that don't compress below this are not kept
+constexpr size_t MAX_PRERENDERED_FRAME_SIZE = 24 * 1024;
+// Pre-rendering transiently holds two compressed frames, leave plenty of room for everything else
+constexpr uint32_t MIN_FREE_HEAP_FOR_PRERENDER = 96 * 1024;
+// Pages with fewer glyphs than this (a chapter title, the end of a chapter) draw about as fast as a stored frame is
+// restored, so they aren't rendered ahead
+constexpr uint16_t LIGHT_PAGE_GLYPHS = 200;
+// A following page that isn't rendered ahead but uses this many glyph groups gets them inflated ahead instead
+constexpr uint8_t HEAVY_PAGE_FONT_GROUPS = 6;
+// Images covering 1/n of the screen leave ghosts a fast refresh of the next page doesn't clear
+constexpr uint32_t GHOSTING_IMAGE_SCREEN_SHARE = 4;
 
 int clampPercent(int percent) {
   if (percent < 0) {
@@ -39,9 +63,10 @@ int clampPercent(int percent) {
   return percent;
 }
 
-// Apply the logical reader orientation to the renderer.
+}  // namespace
+
 // This centralizes orientation mapping so we don't duplicate switch logic elsewhere.
-void applyReaderOrientation(GfxRenderer& renderer, const uint8_t orientation) {
+void EpubReaderActivity::applyReaderOrientation(GfxRenderer& renderer, const uint8_t orientation) {
   switch (orientation) {
     case CrossPointSettings::ORIENTATION::PORTRAIT:
       renderer.setOrientation(GfxRenderer::Orientation::Portrait);
@@ -60,10 +85,36 @@ void applyReaderOrientation(GfxRenderer& renderer, const uint8_t orientation) {
   }
 }
 
-}  // namespace
+SectionPrefetcher::LayoutParams EpubReaderActivity::getLayoutParams(GfxRenderer& renderer) {
+  const auto previousOrientation = renderer.getOrientation();
+  applyReaderOrientation(renderer, SETTINGS.orientation);
+
+  // Same margins as render()
+  int orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft;
+  renderer.getOrientedViewableTRBL(&orientedMarginTop, &orientedMarginRight, &orientedMarginBottom,
+                                   &orientedMarginLeft);
+  orientedMarginTop += SETTINGS.screenMargin;
+  orientedMarginLeft += SETTINGS.screenMargin;
+  orientedMarginRight += SETTINGS.screenMargin;
+  orientedMarginBottom += std::max<int>(SETTINGS.screenMargin, UITheme::getInstance().getStatusBarHeight());
+
+  SectionPrefetcher::LayoutParams params;
+  params.fontId = SETTINGS.getReaderFontId();
+  params.lineCompression = SETTINGS.getReaderLineCompression();
+  params.extraParagraphSpacing = SETTINGS.extraParagraphSpacing;
+  params.paragraphAlignment = SETTINGS.paragraphAlignment;
+  params.viewportWidth = renderer.getScreenWidth() - orientedMarginLeft - orientedMarginRight;
+  params.viewportHeight = renderer.getScreenHeight() - orientedMarginTop - orientedMarginBottom;
+  params.hyphenationEnabled = SETTINGS.hyphenationEnabled;
+  params.embeddedStyle = SETTINGS.embeddedStyle;
+
+  renderer.setOrientation(previousOrientation);
+  return params;
+}
 
 void EpubReaderActivity::onEnter() {
   Activity::onEnter();
+  batteryRevision = powerManager.getBatteryRevision();
 
   if (!epub) {
     return;
@@ -75,20 +126,23 @@ void EpubReaderActivity::onEnter() {
 
   epub->setupCacheDir();
 
-  FsFile f;
-  if (Storage.openFileForRead("ERS", epub->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[6];
-    int dataSize = f.read(data, 6);
-    if (dataSize == 4 || dataSize == 6) {
+  {
+    uint8_t data[14];
+    const size_t dataSize = PROGRESS_JOURNAL.load(epub->getCachePath() + "/progress.bin", data, sizeof(data));
+    if (dataSize == 4 || dataSize == 6 || dataSize == 14) {
       currentSpineIndex = data[0] + (data[1] << 8);
       nextPageNumber = data[2] + (data[3] << 8);
       cachedSpineIndex = currentSpineIndex;
       LOG_DBG("ERS", "Loaded cache: %d, %d", currentSpineIndex, nextPageNumber);
     }
-    if (dataSize == 6) {
+    if (dataSize == 6 || dataSize == 14) {
       cachedChapterTotalPageCount = data[4] + (data[5] << 8);
     }
-    f.close();
+    if (dataSize == 14) {
+      memcpy(&cachedAnchor.paragraph, data + 6, sizeof(cachedAnchor.paragraph));
+      memcpy(&cachedAnchor.word, data + 10, sizeof(cachedAnchor.word));
+      hasCachedAnchor = true;
+    }
   }
   // We may want a better condition to detect if we are opening for the first time.
   // This will trigger if the book is re-opened at Chapter 0.
@@ -100,10 +154,9 @@ void EpubReaderActivity::onEnter() {
     }
   }
 
-  // Save current epub as last opened epub and add to recent books
-  APP_STATE.openEpubPath = epub->getPath();
-  APP_STATE.saveToFile();
-  RECENT_BOOKS.addBook(epub->getPath(), epub->getTitle(), epub->getAuthor(), epub->getThumbBmpPath());
+  // Saving this book as last opened and adding it to recent books happens after the first page is shown
+  openBookkeepingPending = true;
+  dictionaryDir = Dictionary::findInstalled();
 
   // Trigger first update
   requestUpdate();
@@ -111,13 +164,32 @@ void EpubReaderActivity::onEnter() {
 
 void EpubReaderActivity::onExit() {
   Activity::onExit();
+  // Before the orientation changes, the job decodes for the current one
+  BACKGROUND_JOBS.cancel(imageRefineJob);
 
   // Reset orientation back to portrait for the rest of the UI
   renderer.setOrientation(GfxRenderer::Orientation::Portrait);
 
+  sectionPrefetcher.cancel();
+  renderer.clearFontCache();
+  // Chapter builds are done; the rest of the UI doesn't parse XML often enough to keep a parser resident
+  XmlParserPool::trim();
+
+  queueSyncPosition();
+  PROGRESS_JOURNAL.flush();
+  if (section) {
+    LibraryIndex::setProgress(epub->getPath(), getBookProgressPercent());
+  }
+
+  if (openBookkeepingPending) {
+    // Left before the first page was drawn; still resume here next time
+    openBookkeepingPending = false;
+    APP_STATE.openEpubPath = epub->getPath();
+  }
   APP_STATE.readerActivityLoadCount = 0;
   APP_STATE.saveToFile();
   section.reset();
+  BookCacheIndex::bookClosed(epub->getCachePath());
   epub.reset();
 }
 
@@ -128,6 +200,20 @@ void EpubReaderActivity::loop() {
     return;
   }
 
+  // A new battery reading goes into the status bar of the page on screen, without drawing the page again. The page
+  // rendered ahead carries the old reading in its status bar, so it is dropped.
+  if (batteryRevision != powerManager.getBatteryRevision() && section && !RenderLock::peek()) {
+    batteryRevision = powerManager.getBatteryRevision();
+    RenderLock lock(*this);
+    invalidatePrerenderedPage();
+    GUI.refreshStatusBarBattery(renderer);
+  }
+
+  if (imageRefineJob.refined.exchange(false)) {
+    imageRefreshPending = true;
+    requestUpdate();
+  }
+
   if (automaticPageTurnActive) {
     if (mappedInput.wasReleased(MappedInputManager::Button::Confirm) ||
         mappedInput.wasReleased(MappedInputManager::Button::Back)) {
@@ -158,15 +244,10 @@ void EpubReaderActivity::loop() {
   if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
     const int currentPage = section ? section->currentPage + 1 : 0;
     const int totalPages = section ? section->pageCount : 0;
-    float bookProgress = 0.0f;
-    if (epub->getBookSize() > 0 && section && section->pageCount > 0) {
-      const float chapterProgress = static_cast<float>(section->currentPage) / static_cast<float>(section->pageCount);
-      bookProgress = epub->calculateProgress(currentSpineIndex, chapterProgress) * 100.0f;
-    }
-    const int bookProgressPercent = clampPercent(static_cast<int>(bookProgress + 0.5f));
+    const int bookProgressPercent = getBookProgressPercent();
     startActivityForResult(std::make_unique<EpubReaderMenuActivity>(
                                renderer, mappedInput, epub->getTitle(), currentPage, totalPages, bookProgressPercent,
-                               SETTINGS.orientation, !currentPageFootnotes.empty()),
+                               SETTINGS.orientation, !currentPageFootnotes.empty(), !dictionaryDir.empty()),
                            [this](const ActivityResult& result) {
                              // Always apply orientation change even if the menu was cancelled
                              const auto& menu = std::get<MenuResult>(result.data);
@@ -194,21 +275,27 @@ void EpubReaderActivity::loop() {
     return;
   }
 
-  // When long-press chapter skip is disabled, turn pages on press instead of release.
+  // When long-press chapter skip is disabled, turn pages on press instead of release. Presses are taken from the
+  // queue, so those made while a page was rendering are turned in one step, and holding a button keeps turning.
   const bool usePressForPageTurn = !SETTINGS.longPressChapterSkip;
-  const bool prevTriggered = usePressForPageTurn ? (mappedInput.wasPressed(MappedInputManager::Button::PageBack) ||
-                                                    mappedInput.wasPressed(MappedInputManager::Button::Left))
-                                                 : (mappedInput.wasReleased(MappedInputManager::Button::PageBack) ||
-                                                    mappedInput.wasReleased(MappedInputManager::Button::Left));
   const bool powerPageTurn = SETTINGS.shortPwrBtn == CrossPointSettings::SHORT_PWRBTN::PAGE_TURN &&
                              mappedInput.wasReleased(MappedInputManager::Button::Power);
-  const bool nextTriggered = usePressForPageTurn
-                                 ? (mappedInput.wasPressed(MappedInputManager::Button::PageForward) || powerPageTurn ||
-                                    mappedInput.wasPressed(MappedInputManager::Button::Right))
-                                 : (mappedInput.wasReleased(MappedInputManager::Button::PageForward) || powerPageTurn ||
-                                    mappedInput.wasReleased(MappedInputManager::Button::Right));
+  int pageSteps = powerPageTurn ? 1 : 0;
+  if (usePressForPageTurn) {
+    pageSteps += mappedInput.takePresses(MappedInputManager::Button::PageForward, true) +
+                 mappedInput.takePresses(MappedInputManager::Button::Right, true) -
+                 mappedInput.takePresses(MappedInputManager::Button::PageBack, true) -
+                 mappedInput.takePresses(MappedInputManager::Button::Left, true);
+  } else if (mappedInput.wasReleased(MappedInputManager::Button::PageBack) ||
+             mappedInput.wasReleased(MappedInputManager::Button::Left)) {
+    pageSteps = -1;
+  } else if (mappedInput.wasReleased(MappedInputManager::Button::PageForward) ||
+             mappedInput.wasReleased(MappedInputManager::Button::Right)) {
+    pageSteps = 1;
+  }
+  const bool nextTriggered = pageSteps > 0;
 
-  if (!prevTriggered && !nextTriggered) {
+  if (pageSteps == 0) {
     return;
   }
 
@@ -241,11 +328,7 @@ void EpubReaderActivity::loop() {
     return;
   }
 
-  if (prevTriggered) {
-    pageTurn(false);
-  } else {
-    pageTurn(true);
-  }
+  pageTurn(nextTriggered, nextTriggered ? pageSteps : -pageSteps);
 }
 
 // Translate an absolute percent into a spine index plus a normalized position
@@ -319,17 +402,31 @@ void EpubReaderActivity::onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction
       startActivityForResult(
           std::make_unique<EpubReaderChapterSelectionActivity>(renderer, mappedInput, epub, path, spineIdx),
           [this](const ActivityResult& result) {
-            if (!result.isCancelled && currentSpineIndex != std::get<ChapterResult>(result.data).spineIndex) {
+            if (result.isCancelled) {
+              return;
+            }
+            const auto& chapter = std::get<ChapterResult>(result.data);
+            if (currentSpineIndex != chapter.spineIndex || !chapter.anchor.empty()) {
               RenderLock lock(*this);
-              currentSpineIndex = std::get<ChapterResult>(result.data).spineIndex;
+              currentSpineIndex = chapter.spineIndex;
               nextPageNumber = 0;
+              pendingAnchorId = chapter.anchor;
               section.reset();
             }
           });
       break;
     }
     case EpubReaderMenuActivity::MenuAction::FOOTNOTES: {
-      startActivityForResult(std::make_unique<EpubReaderFootnotesActivity>(renderer, mappedInput, currentPageFootnotes),
+      const auto previewFn = [this](const FootnoteEntry& note, std::string& text) {
+        const char* fragment = strchr(note.href, '#');
+        if (!fragment) {
+          return false;
+        }
+        const int spineIndex = note.href[0] == '#' ? currentSpineIndex : epub->resolveHrefToSpineIndex(note.href);
+        return spineIndex >= 0 && FootnoteStore::find(epub->getFootnoteStorePath(spineIndex), fragment + 1, text);
+      };
+      startActivityForResult(std::make_unique<EpubReaderFootnotesActivity>(renderer, mappedInput, currentPageFootnotes,
+                                                                           previewFn),
                              [this](const ActivityResult& result) {
                                if (!result.isCancelled) {
                                  const auto& footnoteResult = std::get<FootnoteResult>(result.data);
@@ -339,13 +436,49 @@ void EpubReaderActivity::onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction
                              });
       break;
     }
-    case EpubReaderMenuActivity::MenuAction::GO_TO_PERCENT: {
-      float bookProgress = 0.0f;
-      if (epub && epub->getBookSize() > 0 && section && section->pageCount > 0) {
-        const float chapterProgress = static_cast<float>(section->currentPage) / static_cast<float>(section->pageCount);
-        bookProgress = epub->calculateProgress(currentSpineIndex, chapterProgress) * 100.0f;
+    case EpubReaderMenuActivity::MenuAction::SEARCH: {
+      // The search task reads the same zip and section files as the prefetcher
+      sectionPrefetcher.cancel();
+      startActivityForResult(std::make_unique<EpubReaderSearchActivity>(renderer, mappedInput, epub, prefetchParams),
+                             [this](const ActivityResult& result) {
+                               if (result.isCancelled) {
+                                 requestUpdate();
+                                 return;
+                               }
+                               const auto& searchResult = std::get<SearchResult>(result.data);
+                               RenderLock lock(*this);
+                               currentSpineIndex = searchResult.spineIndex;
+                               if (searchResult.page >= 0) {
+                                 nextPageNumber = searchResult.page;
+                               } else {
+                                 nextPageNumber = 0;
+                                 pendingSpineProgress = searchResult.spineProgress;
+                                 pendingPercentJump = true;
+                               }
+                               section.reset();
+                             });
+      break;
+    }
+    case EpubReaderMenuActivity::MenuAction::LOOK_UP_WORD: {
+      // Words of the current page in reading order, each once, as they are looked up
+      std::vector<std::string> words;
+      if (section && section->currentPage >= 0 && section->currentPage < section->pageCount) {
+        if (const auto p = section->loadPageFromSectionFile()) {
+          p->forEachWord([&words](const char* word, const size_t len) {
+            std::string form = Dictionary::lookupForm(word, len);
+            if (!form.empty() && std::find(words.begin(), words.end(), form) == words.end()) {
+              words.push_back(std::move(form));
+            }
+          });
+        }
       }
-      const int initialPercent = clampPercent(static_cast<int>(bookProgress + 0.5f));
+      startActivityForResult(
+          std::make_unique<EpubReaderDictionaryActivity>(renderer, mappedInput, dictionaryDir, std::move(words)),
+          [this](const ActivityResult&) { requestUpdate(); });
+      break;
+    }
+    case EpubReaderMenuActivity::MenuAction::GO_TO_PERCENT: {
+      const int initialPercent = getBookProgressPercent();
       startActivityForResult(
           std::make_unique<EpubReaderPercentSelectionActivity>(renderer, mappedInput, initialPercent),
           [this](const ActivityResult& result) {
@@ -359,19 +492,7 @@ void EpubReaderActivity::onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction
       if (section && section->currentPage >= 0 && section->currentPage < section->pageCount) {
         auto p = section->loadPageFromSectionFile();
         if (p) {
-          std::string fullText;
-          for (const auto& el : p->elements) {
-            if (el->getTag() == TAG_PageLine) {
-              const auto& line = static_cast<const PageLine&>(*el);
-              if (line.getBlock()) {
-                const auto& words = line.getBlock()->getWords();
-                for (const auto& w : words) {
-                  if (!fullText.empty()) fullText += " ";
-                  fullText += w;
-                }
-              }
-            }
-          }
+          const std::string fullText = p->getText();
           if (!fullText.empty()) {
             startActivityForResult(std::make_unique<QrDisplayActivity>(renderer, mappedInput, fullText),
                                    [this](const ActivityResult& result) {});
@@ -394,10 +515,14 @@ void EpubReaderActivity::onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction
           uint16_t backupSpine = currentSpineIndex;
           uint16_t backupPage = section->currentPage;
           uint16_t backupPageCount = section->pageCount;
+          PageAnchor backupAnchor;
+          section->getPageAnchor(backupPage, backupAnchor);
           section.reset();
+          sectionPrefetcher.cancel();
           epub->clearCache();
           epub->setupCacheDir();
-          saveProgress(backupSpine, backupPage, backupPageCount);
+          saveProgress(backupSpine, backupPage, backupPageCount, backupAnchor);
+          PROGRESS_JOURNAL.flush();
         }
       }
       onGoHome();
@@ -415,16 +540,29 @@ void EpubReaderActivity::onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction
       if (KOREADER_STORE.hasCredentials()) {
         const int currentPage = section ? section->currentPage : 0;
         const int totalPages = section ? section->pageCount : 0;
+        std::string landmark;
+        if (section) {
+          section->getPageLandmark(currentPage, landmark);
+        }
         startActivityForResult(
             std::make_unique<KOReaderSyncActivity>(renderer, mappedInput, epub, epub->getPath(), currentSpineIndex,
-                                                   currentPage, totalPages),
+                                                   currentPage, totalPages, std::move(landmark)),
             [this](const ActivityResult& result) {
               if (!result.isCancelled) {
                 const auto& sync = std::get<SyncResult>(result.data);
-                if (currentSpineIndex != sync.spineIndex || (section && section->currentPage != sync.page)) {
+                const bool sameSpine = currentSpineIndex == sync.spineIndex;
+                int syncPage = sync.page;
+                if (section && sameSpine && !sync.landmark.empty()) {
+                  const int landmarkPage = section->getPageForLandmark(sync.landmark);
+                  if (landmarkPage >= 0) {
+                    syncPage = landmarkPage;
+                  }
+                }
+                if (currentSpineIndex != sync.spineIndex || (section && section->currentPage != syncPage)) {
                   RenderLock lock(*this);
                   currentSpineIndex = sync.spineIndex;
-                  nextPageNumber = sync.page;
+                  nextPageNumber = syncPage;
+                  pendingLandmark = sameSpine ? std::string() : sync.landmark;
                   section.reset();
                 }
               }
@@ -444,11 +582,7 @@ void EpubReaderActivity::applyOrientation(const uint8_t orientation) {
   // Preserve current reading position so we can restore after reflow.
   {
     RenderLock lock(*this);
-    if (section) {
-      cachedSpineIndex = currentSpineIndex;
-      cachedChapterTotalPageCount = section->pageCount;
-      nextPageNumber = section->currentPage;
-    }
+    cacheCurrentPosition();
 
     // Persist the selection so the reader keeps the new orientation on next launch.
     SETTINGS.orientation = orientation;
@@ -459,6 +593,7 @@ void EpubReaderActivity::applyOrientation(const uint8_t orientation) {
 
     // Reset section to force re-layout in the new orientation.
     section.reset();
+    sectionPrefetcher.cancel();
   }
 }
 
@@ -478,36 +613,39 @@ void EpubReaderActivity::toggleAutoPageTurn(const uint8_t selectedPageTurnOption
   if (statusBarHeight == 0 || statusBarHeight == UITheme::getInstance().getProgressBarHeight()) {
     // Preserve current reading position so we can restore after reflow.
     RenderLock lock(*this);
-    if (section) {
-      cachedSpineIndex = currentSpineIndex;
-      cachedChapterTotalPageCount = section->pageCount;
-      nextPageNumber = section->currentPage;
-    }
+    cacheCurrentPosition();
     section.reset();
   }
 }
 
-void EpubReaderActivity::pageTurn(bool isForwardTurn) {
+void EpubReaderActivity::pageTurn(bool isForwardTurn, const int pages) {
   if (isForwardTurn) {
-    if (section->currentPage < section->pageCount - 1) {
-      section->currentPage++;
+    if (section->currentPage + pages < section->pageCount) {
+      section->currentPage += pages;
+    } else if (sectionBuilding) {
+      // The rest of the chapter isn't laid out yet; don't skip it
+      return;
     } else {
       // We don't want to delete the section mid-render, so grab the semaphore
       {
         RenderLock lock(*this);
-        nextPageNumber = 0;
+        // Pages left over past this chapter's end carry into the next one; only that section is loaded
+        nextPageNumber = section->currentPage + pages - section->pageCount;
         currentSpineIndex++;
         section.reset();
       }
     }
   } else {
-    if (section->currentPage > 0) {
-      section->currentPage--;
+    if (section->currentPage >= pages) {
+      section->currentPage -= pages;
+    } else if (section->currentPage > 0 && currentSpineIndex == 0) {
+      section->currentPage = 0;
     } else if (currentSpineIndex > 0) {
       // We don't want to delete the section mid-render, so grab the semaphore
       {
         RenderLock lock(*this);
         nextPageNumber = UINT16_MAX;
+        nextPageFromEnd = pages - section->currentPage - 1;
         currentSpineIndex--;
         section.reset();
       }
@@ -519,6 +657,24 @@ void EpubReaderActivity::pageTurn(bool isForwardTurn) {
 
 // TODO: Failure handling
 void EpubReaderActivity::render(RenderLock&& lock) {
+  if (imageRefreshPending) {
+    imageRefreshPending = false;
+    if (refreshRefinedImages()) {
+      return;
+    }
+  }
+  renderPage();
+
+  // Two SD writes that would otherwise sit between opening (or waking into) the book and its first page
+  if (openBookkeepingPending && epub) {
+    openBookkeepingPending = false;
+    APP_STATE.openEpubPath = epub->getPath();
+    APP_STATE.saveToFile();
+    RECENT_BOOKS.addBook(epub->getPath(), epub->getTitle(), epub->getAuthor(), epub->getThumbBmpPath());
+  }
+}
+
+void EpubReaderActivity::renderPage() {
   if (!epub) {
     return;
   }
@@ -565,10 +721,32 @@ void EpubReaderActivity::render(RenderLock&& lock) {
     const auto filepath = epub->getSpineItem(currentSpineIndex).href;
     LOG_DBG("ERS", "Loading file: %s, index: %d", filepath.c_str(), currentSpineIndex);
     section = std::unique_ptr<Section>(new Section(epub, currentSpineIndex, renderer));
+    // Decompressed glyph groups stay cached across the pages of a section, start afresh for the new one
+    renderer.clearFontCache();
+    invalidatePrerenderedPage();
 
     const uint16_t viewportWidth = renderer.getScreenWidth() - orientedMarginLeft - orientedMarginRight;
     const uint16_t viewportHeight = renderer.getScreenHeight() - orientedMarginTop - orientedMarginBottom;
 
+    // The prefetcher may already be paginating this chapter; finish its build here instead of starting over, and
+    // stop anything else it was doing so it doesn't compete with the foreground build.
+    if (sectionPrefetcher.isBuilding(currentSpineIndex)) {
+      GUI.drawPopup(renderer, tr(STR_INDEXING));
+      sectionPrefetcher.takeOver(currentSpineIndex);
+    }
+    sectionPrefetcher.cancel();
+
+    prefetchParams.fontId = SETTINGS.getReaderFontId();
+    prefetchParams.lineCompression = SETTINGS.getReaderLineCompression();
+    prefetchParams.extraParagraphSpacing = SETTINGS.extraParagraphSpacing;
+    prefetchParams.paragraphAlignment = SETTINGS.paragraphAlignment;
+    prefetchParams.viewportWidth = viewportWidth;
+    prefetchParams.viewportHeight = viewportHeight;
+    prefetchParams.hyphenationEnabled = SETTINGS.hyphenationEnabled;
+    prefetchParams.embeddedStyle = SETTINGS.embeddedStyle;
+    prefetchPending = true;
+
+    bool earlyPageShown = false;
     if (!section->loadSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
                                   SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
                                   viewportHeight, SETTINGS.hyphenationEnabled, SETTINGS.embeddedStyle)) {
@@ -576,9 +754,30 @@ void EpubReaderActivity::render(RenderLock&& lock) {
 
       const auto popupFn = [this]() { GUI.drawPopup(renderer, tr(STR_INDEXING)); };
 
-      if (!section->createSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
-                                      SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
-                                      viewportHeight, SETTINGS.hyphenationEnabled, SETTINGS.embeddedStyle, popupFn)) {
+      // Unless the page to open at has to be searched for in the finished chapter, show it as soon as it is laid
+      // out. A saved position only needs its page to still start at the saved word.
+      const bool checkAnchor = cachedChapterTotalPageCount > 0 && currentSpineIndex == cachedSpineIndex;
+      int earlyPage = -1;
+      if (nextPageNumber != UINT16_MAX && pendingLandmark.empty() && pendingAnchorId.empty() && !pendingPercentJump &&
+          (!checkAnchor || hasCachedAnchor)) {
+        earlyPage = nextPageNumber;
+      }
+      const auto pageReadyFn = [&](const int pageIndex, const Page& page) {
+        if (pageIndex != earlyPage || (checkAnchor && page.anchor != cachedAnchor)) {
+          return;
+        }
+        section->currentPage = pageIndex;
+        showEarlyPage(page, orientedMarginTop, orientedMarginLeft);
+        earlyPageShown = true;
+      };
+
+      sectionBuilding = true;
+      const bool built = section->createSectionFile(
+          SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(), SETTINGS.extraParagraphSpacing,
+          SETTINGS.paragraphAlignment, viewportWidth, viewportHeight, SETTINGS.hyphenationEnabled,
+          SETTINGS.embeddedStyle, popupFn, nullptr, pageReadyFn);
+      sectionBuilding = false;
+      if (!built) {
         LOG_ERR("ERS", "Failed to persist page data to SD");
         section.reset();
         return;
@@ -587,21 +786,62 @@ void EpubReaderActivity::render(RenderLock&& lock) {
       LOG_DBG("ERS", "Cache found, skipping build...");
     }
 
-    if (nextPageNumber == UINT16_MAX) {
-      section->currentPage = section->pageCount - 1;
+    // Sections record their counts as they are loaded or built, so keep reading until every one is known
+    if (!bookPages.isComplete() || bookPagesLayoutKey != section->getLayoutKey()) {
+      bookPagesLayoutKey = section->getLayoutKey();
+      bookPages.load(epub->getPageCountsPath(), bookPagesLayoutKey, epub->getSpineItemsCount());
+    }
+
+    if (earlyPageShown) {
+      // Already on screen while the rest was built, and maybe turned from since
+      section->currentPage = std::min<int>(section->currentPage, std::max(0, section->pageCount - 1));
+      cachedChapterTotalPageCount = 0;
+      hasCachedAnchor = false;
+    } else if (nextPageNumber == UINT16_MAX) {
+      section->currentPage = std::max(0, section->pageCount - 1 - nextPageFromEnd);
+    } else if (nextPageNumber > 0 && nextPageNumber >= section->pageCount) {
+      // A multi-page turn that runs past a short chapter stops at its last page rather than building the next one
+      section->currentPage = std::max(0, section->pageCount - 1);
     } else {
       section->currentPage = nextPageNumber;
     }
+    nextPageFromEnd = 0;
 
-    // handles changes in reader settings and reset to approximate position based on cached progress
+    // handles changes in reader settings and reset to the cached position in the new layout
     if (cachedChapterTotalPageCount > 0) {
-      // only goes to relative position if spine index matches cached value
-      if (currentSpineIndex == cachedSpineIndex && section->pageCount != cachedChapterTotalPageCount) {
+      // only repositions if spine index matches cached value
+      if (currentSpineIndex == cachedSpineIndex && hasCachedAnchor) {
+        // The saved page still starts at the same word unless the layout changed; only search if it doesn't
+        PageAnchor pageAnchor;
+        if (!section->getPageAnchor(section->currentPage, pageAnchor) || pageAnchor != cachedAnchor) {
+          section->currentPage = section->getPageForAnchor(cachedAnchor);
+        }
+      } else if (currentSpineIndex == cachedSpineIndex && section->pageCount != cachedChapterTotalPageCount) {
+        // Progress saved before anchors existed: approximate from the relative position
         float progress = static_cast<float>(section->currentPage) / static_cast<float>(cachedChapterTotalPageCount);
         int newPage = static_cast<int>(progress * section->pageCount);
         section->currentPage = newPage;
       }
       cachedChapterTotalPageCount = 0;  // resets to 0 to prevent reading cached progress again
+      hasCachedAnchor = false;
+    }
+
+    if (!pendingLandmark.empty()) {
+      const int landmarkPage = section->getPageForLandmark(pendingLandmark);
+      if (landmarkPage >= 0) {
+        section->currentPage = landmarkPage;
+      }
+      pendingLandmark.clear();
+    }
+
+    if (!pendingAnchorId.empty()) {
+      const int anchorPage = section->getPageForId(pendingAnchorId);
+      if (anchorPage >= 0) {
+        section->currentPage = anchorPage;
+      } else {
+        LOG_DBG("ERS", "Id #%s not in section %d", pendingAnchorId.c_str(), currentSpineIndex);
+      }
+      pendingAnchorId.clear();
     }
 
     if (pendingPercentJump && section->pageCount > 0) {
@@ -651,43 +891,189 @@ void EpubReaderActivity::render(RenderLock&& lock) {
     currentPageFootnotes = std::move(p->footnotes);
 
     const auto start = millis();
-    renderContents(std::move(p), orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
-    LOG_DBG("ERS", "Rendered page in %dms", millis() - start);
-    renderer.clearFontCache();
+    const bool frameReady = restorePrerenderedPage();
+    renderContents(std::move(p), orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft,
+                   frameReady);
+    LOG_DBG("ERS", "Rendered page in %dms%s", millis() - start, frameReady ? " (pre-rendered)" : "");
+  }
+  // Saving the progress and rendering the next page ahead don't need the panel, so they run while the
+  // anti-aliasing refresh is still going
+  {
+    PageAnchor anchor;
+    section->getPageAnchor(section->currentPage, anchor);
+    saveProgress(currentSpineIndex, section->currentPage, section->pageCount, anchor);
   }
-  saveProgress(currentSpineIndex, section->currentPage, section->pageCount);
+  prerenderNextPage(orientedMarginTop, orientedMarginLeft);
+  finishGrayRefresh();
 
   if (pendingScreenshot) {
     pendingScreenshot = false;
     ScreenshotUtil::takeScreenshot(renderer);
   }
+
+  // Now that the page is on screen, paginate the following chapter (and the previous one, for backwards
+  // navigation) in the background so crossing the chapter boundary doesn't stall on indexing.
+  if (prefetchPending) {
+    prefetchPending = false;
+    sectionPrefetcher.start(epub, currentSpineIndex + 1, currentSpineIndex - 1, prefetchParams);
+  }
 }
 
-void EpubReaderActivity::saveProgress(int spineIndex, int currentPage, int pageCount) {
-  FsFile f;
-  if (Storage.openFileForWrite("ERS", epub->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[6];
-    data[0] = currentSpineIndex & 0xFF;
-    data[1] = (currentSpineIndex >> 8) & 0xFF;
-    data[2] = currentPage & 0xFF;
-    data[3] = (currentPage >> 8) & 0xFF;
-    data[4] = pageCount & 0xFF;
-    data[5] = (pageCount >> 8) & 0xFF;
-    f.write(data, 6);
-    f.close();
-    LOG_DBG("ERS", "Progress saved: Chapter %d, Page %d", spineIndex, currentPage);
-  } else {
-    LOG_ERR("ERS", "Could not save progress!");
+void EpubReaderActivity::showEarlyPage(const Page& page, const int orientedMarginTop, const int orientedMarginLeft) {
+  // Black and white and without the status bar, which needs the chapter's page count; the full render follows once
+  // the chapter is built
+  renderer.clearScreen();
+  page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+  renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+  LOG_DBG("ERS", "Showed page %d before the section was built", section->currentPage);
+}
+
+void EpubReaderActivity::queueSyncPosition() const {
+  if (!epub || !section || !KOREADER_STORE.hasCredentials()) {
+    return;
+  }
+
+  // The document hash is cached next to the book after the first sync, so this stays cheap on every close
+  const std::string documentHash = KOREADER_STORE.getMatchMethod() == DocumentMatchMethod::FILENAME
+                                       ? KOReaderDocumentId::calculateFromFilename(epub->getPath())
+                                       : KOReaderDocumentId::calculateCached(epub->getPath(), epub->getCachePath());
+  if (documentHash.empty()) {
+    return;
+  }
+
+  CrossPointPosition position = {currentSpineIndex, section->currentPage, section->pageCount, ""};
+  section->getPageLandmark(section->currentPage, position.landmark);
+  const KOReaderPosition koPosition = ProgressMapper::toKOReader(epub, position);
+  KOREADER_SYNC_QUEUE.record(documentHash, koPosition.xpath, koPosition.percentage);
+}
+
+void EpubReaderActivity::saveProgress(int spineIndex, int currentPage, int pageCount, const PageAnchor& anchor) {
+  uint8_t data[14];
+  data[0] = currentSpineIndex & 0xFF;
+  data[1] = (currentSpineIndex >> 8) & 0xFF;
+  data[2] = currentPage & 0xFF;
+  data[3] = (currentPage >> 8) & 0xFF;
+  data[4] = pageCount & 0xFF;
+  data[5] = (pageCount >> 8) & 0xFF;
+  memcpy(data + 6, &anchor.paragraph, sizeof(anchor.paragraph));
+  memcpy(data + 10, &anchor.word, sizeof(anchor.word));
+  PROGRESS_JOURNAL.save(epub->getCachePath() + "/progress.bin", data, sizeof(data));
+  LOG_DBG("ERS", "Progress: Chapter %d, Page %d", spineIndex, currentPage);
+}
+
+int EpubReaderActivity::getBookProgressPercent() const {
+  float bookProgress = 0.0f;
+  if (epub->getBookSize() > 0 && section && section->pageCount > 0) {
+    const float chapterProgress = static_cast<float>(section->currentPage) / static_cast<float>(section->pageCount);
+    bookProgress = epub->calculateProgress(currentSpineIndex, chapterProgress) * 100.0f;
+  }
+  return clampPercent(static_cast<int>(bookProgress + 0.5f));
+}
+
+void EpubReaderActivity::cacheCurrentPosition() {
+  if (!section) {
+    return;
+  }
+  cachedSpineIndex = currentSpineIndex;
+  cachedChapterTotalPageCount = section->pageCount;
+  nextPageNumber = section->currentPage;
+  hasCachedAnchor = section->getPageAnchor(section->currentPage, cachedAnchor);
+}
+bool EpubReaderActivity::restorePrerenderedPage() {
+  if (prerenderedFrame.empty() || prerenderedSpineIndex != currentSpineIndex ||
+      prerenderedPage != section->currentPage) {
+    return false;
+  }
+  const bool restored = renderer.restoreCompressedFrame(prerenderedFrame);
+  invalidatePrerenderedPage();
+  return restored;
+}
+
+// Runs after the current page is on screen: draws the following page, keeps a compressed copy of it for the next
+// forward turn and puts the current page back into the frame buffer (popups are drawn on top of it). The page's cost
+// record decides whether that pays off; a heavy page that isn't drawn ahead gets its glyph groups inflated instead.
+void EpubReaderActivity::prerenderNextPage(const int orientedMarginTop, const int orientedMarginLeft) {
+  invalidatePrerenderedPage();
+  const int nextPage = section->currentPage + 1;
+  PageCost cost;
+  if (nextPage >= section->pageCount || !section->getPageCost(nextPage, cost)) {
+    return;
+  }
+  // Image pages take the double fast refresh path in renderContents and always redraw, so don't bother; neither with
+  // light pages
+  if (!SETTINGS.pageAheadRender || cost.hasImages() || cost.glyphs < LIGHT_PAGE_GLYPHS) {
+    if (cost.fontGroups >= HEAVY_PAGE_FONT_GROUPS) {
+      if (const auto page = section->loadPageFromSectionFile(nextPage)) {
+        page->prefetchGlyphs(renderer, SETTINGS.getReaderFontId());
+      }
+    }
+    return;
+  }
+  if (ESP.getFreeHeap() < MIN_FREE_HEAP_FOR_PRERENDER) {
+    LOG_DBG("ERS", "Skipping pre-render, low heap (%u bytes)", ESP.getFreeHeap());
+    return;
+  }
+
+  std::vector<uint8_t> currentFrame;
+  if (!renderer.storeCompressedFrame(currentFrame, MAX_PRERENDERED_FRAME_SIZE)) {
+    return;
   }
+
+  const auto start = millis();
+  if (const auto page = section->loadPageFromSectionFile(nextPage)) {
+    renderer.clearScreen();
+    page->prefetchGlyphs(renderer, SETTINGS.getReaderFontId());
+    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+    renderStatusBar(nextPage);
+    if (renderer.storeCompressedFrame(prerenderedFrame, MAX_PRERENDERED_FRAME_SIZE)) {
+      prerenderedSpineIndex = currentSpineIndex;
+      prerenderedPage = nextPage;
+      LOG_DBG("ERS", "Pre-rendered page %d in %dms (%zu bytes)", nextPage, millis() - start,
+              prerenderedFrame.size());
+    }
+  }
+
+  renderer.restoreCompressedFrame(currentFrame);
+}
+
+void EpubReaderActivity::invalidatePrerenderedPage() {
+  prerenderedFrame.clear();
+  prerenderedFrame.shrink_to_fit();
+  prerenderedSpineIndex = -1;
+  prerenderedPage = -1;
 }
+
+void EpubReaderActivity::finishGrayRefresh() {
+  if (!grayRefreshPending) {
+    return;
+  }
+  grayRefreshPending = false;
+  // Waits for the refresh, then syncs the controller with the restored BW frame
+  renderer.cleanupGrayscaleWithFrameBuffer();
+}
+
 void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int orientedMarginTop,
                                         const int orientedMarginRight, const int orientedMarginBottom,
-                                        const int orientedMarginLeft) {
-  // Force special handling for pages with images when anti-aliasing is on
-  bool imagePageWithAA = page->hasImages() && SETTINGS.textAntiAliasing;
-
-  page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
-  renderStatusBar();
+                                        const int orientedMarginLeft, const bool frameReady) {
+  // A page-ahead frame has its images drawn in full, they were decoded for it
+  const bool imagePreviews =
+      !frameReady && page->hasImages() && queueImageRefine(*page, orientedMarginTop, orientedMarginLeft);
+  // Force special handling for pages with images when anti-aliasing is on; previews are 1-bit, they don't need it
+  bool imagePageWithAA = page->hasImages() && SETTINGS.textAntiAliasing && !imagePreviews;
+
+  // Inflate the page's glyph groups in one go, the grayscale passes below reuse them
+  page->prefetchGlyphs(renderer, SETTINGS.getReaderFontId());
+  // Large images on the page before leave ghosts behind, which take a half refresh to clear
+  const uint32_t screenArea = static_cast<uint32_t>(renderer.getScreenWidth()) * renderer.getScreenHeight();
+  const bool clearImageGhosts = shownImageArea * GHOSTING_IMAGE_SCREEN_SHARE >= screenArea;
+  shownImageArea = page->getCost().imageArea;
+
+  // frameReady: the BW frame was restored from the page-ahead cache, only the refresh is left to do
+  if (!frameReady) {
+    TRACE("page.render");
+    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop, imagePreviews);
+    renderStatusBar();
+  }
   if (imagePageWithAA) {
     // Double FAST_REFRESH with selective image blanking (pablohc's technique):
     // HALF_REFRESH sets particles too firmly for the grayscale LUT to adjust.
@@ -707,53 +1093,150 @@ void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int or
       renderer.displayBuffer(HalDisplay::HALF_REFRESH);
     }
     // Double FAST_REFRESH handles ghosting for image pages; don't count toward full refresh cadence
-  } else if (pagesUntilFullRefresh <= 1) {
+  } else if (pagesUntilFullRefresh <= 1 || clearImageGhosts) {
     renderer.displayBuffer(HalDisplay::HALF_REFRESH);
     pagesUntilFullRefresh = SETTINGS.getRefreshFrequency();
   } else {
-    renderer.displayBuffer();
+    renderer.displayBuffer(HalDisplay::FAST_REFRESH);
     pagesUntilFullRefresh--;
   }
 
+  renderGrayPasses(*page, orientedMarginTop, orientedMarginLeft, imagePreviews);
+}
+
+void EpubReaderActivity::renderGrayPasses(const Page& page, const int orientedMarginTop, const int orientedMarginLeft,
+                                          const bool imagePreviews) {
   // Save bw buffer to reset buffer state after grayscale data sync
-  renderer.storeBwBuffer();
+  const bool bwStored = renderer.storeBwBuffer();
+
+  // grayscale rendering; pages without anti-aliased text or images (1-bit fonts, blank pages) would look the same
+  // after it, so they skip the passes and the refresh
+  if (SETTINGS.textAntiAliasing && page.hasGrayContent()) {
+    // Text-only pages decode every glyph once for both planes; images still need the separate passes
+    if (!page.hasImages() && renderer.beginGrayscalePlanes()) {
+      TRACE("page.gray");
+      page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+      renderer.endGrayscalePlanes();
+    } else {
+      TRACE("page.gray");
+      renderer.clearScreen(0x00);
+      renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
+      page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop, imagePreviews);
+      renderer.copyGrayscaleLsbBuffers();
+
+      // Render and copy to MSB buffer
+      renderer.clearScreen(0x00);
+      renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
+      page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop, imagePreviews);
+      renderer.copyGrayscaleMsbBuffers();
+    }
 
-  // grayscale rendering
-  // TODO: Only do this if font supports it
-  if (SETTINGS.textAntiAliasing) {
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
-    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
-    renderer.copyGrayscaleLsbBuffers();
+    // display grayscale part; the refresh runs on the display task, the planes are already in controller RAM
+    renderer.displayGrayBufferAsync();
+    renderer.setRenderMode(GfxRenderer::BW);
+    // Without a stored BW frame there is nothing to sync the controller with afterwards
+    grayRefreshPending = bwStored;
+  }
 
-    // Render and copy to MSB buffer
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
-    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
-    renderer.copyGrayscaleMsbBuffers();
+  // restore the bw data; with a gray refresh running, the controller is synced by finishGrayRefresh()
+  renderer.restoreBwBuffer(!grayRefreshPending);
+}
 
-    // display grayscale part
-    renderer.displayGrayBuffer();
-    renderer.setRenderMode(GfxRenderer::BW);
+bool EpubReaderActivity::queueImageRefine(const Page& page, const int orientedMarginTop,
+                                          const int orientedMarginLeft) {
+  // Still decoding the images of another page: these are decoded right away, as they would wait for it anyway
+  if (BACKGROUND_JOBS.isQueued(imageRefineJob)) {
+    return false;
+  }
+  auto images = page.getUncachedImages(renderer);
+  if (images.empty()) {
+    return false;
   }
+  imageRefineJob.images = std::move(images);
+  imageRefineJob.next = 0;
+  imageRefineJob.decoded = 0;
+  imageRefineJob.spineIndex = currentSpineIndex;
+  imageRefineJob.page = section->currentPage;
+  imageRefineJob.marginTop = orientedMarginTop;
+  imageRefineJob.marginLeft = orientedMarginLeft;
+  imageRefineJob.refined = false;
+  // Ahead of other background work, the page on screen is waiting for it
+  return BACKGROUND_JOBS.submit(imageRefineJob, BackgroundJob::Priority::High);
+}
 
-  // restore the bw data
-  renderer.restoreBwBuffer();
+bool EpubReaderActivity::ImageRefineJob::step() {
+  if (images[next].prerender(renderer)) {
+    decoded++;
+  }
+  next++;
+  setProgress(next, images.size());
+  if (next < images.size()) {
+    return true;
+  }
+  // Drop the copies, the page is loaded again for the redraw
+  images.clear();
+  images.shrink_to_fit();
+  refined = decoded > 0;
+  return false;
+}
+
+bool EpubReaderActivity::refreshRefinedImages() {
+  // Anything else waiting to be shown needs the full render
+  if (!section || currentSpineIndex != imageRefineJob.spineIndex || section->currentPage != imageRefineJob.page ||
+      pendingPercentJump || !pendingAnchorId.empty() || !pendingLandmark.empty()) {
+    return false;
+  }
+  auto page = section->loadPageFromSectionFile();
+  if (!page) {
+    return false;
+  }
+
+  const auto start = millis();
+  renderer.clearScreen();
+  page->prefetchGlyphs(renderer, SETTINGS.getReaderFontId());
+  page->render(renderer, SETTINGS.getReaderFontId(), imageRefineJob.marginLeft, imageRefineJob.marginTop);
+  renderStatusBar();
+  // Only the tiles that differ are refreshed, so the text around the images stays put
+  renderer.displayBuffer();
+  renderGrayPasses(*page, imageRefineJob.marginTop, imageRefineJob.marginLeft, false);
+  finishGrayRefresh();
+  LOG_DBG("ERS", "Redrew decoded images in %dms", millis() - start);
+  return true;
 }
 
-void EpubReaderActivity::renderStatusBar() const {
-  // Calculate progress in book
-  const int currentPage = section->currentPage + 1;
+void EpubReaderActivity::renderStatusBar(const int pageIndex) const {
+  const int currentPage = pageIndex + 1;
   const float pageCount = section->pageCount;
-  const float sectionChapterProg = (pageCount > 0) ? (static_cast<float>(currentPage) / pageCount) : 0;
-  const float bookProgress = epub->calculateProgress(currentSpineIndex, sectionChapterProg) * 100;
+  StatusBarModel& model = statusBarModel;
+
+  // Book progress only depends on the position
+  if (model.spineIndex != currentSpineIndex || model.pageIndex != pageIndex || model.pageCount != section->pageCount) {
+    if (bookPages.isComplete() && bookPages.totalPages() > 0) {
+      // Every section's page count is known: exact page of the book
+      const uint32_t bookPage = bookPages.pagesBefore(currentSpineIndex) + currentPage;
+      model.bookProgress = static_cast<float>(bookPage) * 100 / static_cast<float>(bookPages.totalPages());
+    } else {
+      const float sectionChapterProg = (pageCount > 0) ? (static_cast<float>(currentPage) / pageCount) : 0;
+      model.bookProgress = epub->calculateProgress(currentSpineIndex, sectionChapterProg) * 100;
+    }
+  }
 
-  std::string title;
+  // The title only changes with the chapter, the title setting or the auto page turn state
+  const bool titleStale = model.spineIndex != currentSpineIndex || model.titleMode != SETTINGS.statusBarTitle ||
+                          model.autoTurn != automaticPageTurnActive || model.autoTurnDuration != pageTurnDuration;
+  model.spineIndex = currentSpineIndex;
+  model.pageIndex = pageIndex;
+  model.pageCount = section->pageCount;
+  model.titleMode = SETTINGS.statusBarTitle;
+  model.autoTurn = automaticPageTurnActive;
+  model.autoTurnDuration = pageTurnDuration;
 
   int textYOffset = 0;
 
   if (automaticPageTurnActive) {
-    title = tr(STR_AUTO_TURN_ENABLED) + std::to_string(60 * 1000 / pageTurnDuration);
+    if (titleStale) {
+      model.title = tr(STR_AUTO_TURN_ENABLED) + std::to_string(60 * 1000 / pageTurnDuration);
+    }
 
     // calculates textYOffset when rendering title in status bar
     const uint8_t statusBarHeight = UITheme::getInstance().getStatusBarHeight();
@@ -763,19 +1246,23 @@ void EpubReaderActivity::renderStatusBar() const {
       textYOffset += UITheme::getInstance().getMetrics().statusBarVerticalMargin;
     }
 
+  } else if (!titleStale) {
+    // Keep the cached title
   } else if (SETTINGS.statusBarTitle == CrossPointSettings::STATUS_BAR_TITLE::CHAPTER_TITLE) {
-    title = tr(STR_UNNAMED);
+    model.title = tr(STR_UNNAMED);
     const int tocIndex = epub->getTocIndexForSpineIndex(currentSpineIndex);
     if (tocIndex != -1) {
       const auto tocItem = epub->getTocItem(tocIndex);
-      title = tocItem.title;
+      model.title = tocItem.title;
     }
 
   } else if (SETTINGS.statusBarTitle == CrossPointSettings::STATUS_BAR_TITLE::BOOK_TITLE) {
-    title = epub->getTitle();
+    model.title = epub->getTitle();
+  } else {
+    model.title.clear();
   }
 
-  GUI.drawStatusBar(renderer, bookProgress, currentPage, pageCount, title, 0, textYOffset);
+  GUI.drawStatusBar(renderer, model.bookProgress, currentPage, pageCount, model.title, 0, textYOffset);
 }
 
 void EpubReaderActivity::navigateToHref(const std::string& hrefStr, const bool savePosition) {
@@ -790,6 +1277,20 @@ void EpubReaderActivity::navigateToHref(const std::string& hrefStr, const bool s
 
   // Check for same-file anchor reference (#anchor only)
   bool sameFile = !hrefStr.empty() && hrefStr[0] == '#';
+  const size_t hashPos = hrefStr.find('#');
+  const std::string fragment = hashPos == std::string::npos ? std::string() : hrefStr.substr(hashPos + 1);
+
+  // Target in the loaded section: the id table gives the page directly
+  if (sameFile && section) {
+    const int anchorPage = section->getPageForId(fragment);
+    {
+      RenderLock lock(*this);
+      section->currentPage = anchorPage >= 0 ? anchorPage : 0;
+    }
+    requestUpdate();
+    LOG_DBG("ERS", "Navigated to page %d for href: %s", section->currentPage, hrefStr.c_str());
+    return;
+  }
 
   int targetSpineIndex;
   if (sameFile) {
@@ -809,6 +1310,7 @@ void EpubReaderActivity::navigateToHref(const std::string& hrefStr, const bool s
     RenderLock lock(*this);
     currentSpineIndex = targetSpineIndex;
     nextPageNumber = 0;
+    pendingAnchorId = fragment;
     section.reset();
   }
   requestUpdate();
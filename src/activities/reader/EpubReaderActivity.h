@@ -1,9 +1,15 @@
 #pragma once
 #include <Epub.h>
 #include <Epub/FootnoteEntry.h>
+#include <Epub/Page.h>
 #include <Epub/Section.h>
+#include <Epub/SectionPageCounts.h>
 
+#include <atomic>
+
+#include "BackgroundJobs.h"
 #include "EpubReaderMenuActivity.h"
+#include "SectionPrefetcher.h"
 #include "activities/Activity.h"
 
 class EpubReaderActivity final : public Activity {
@@ -11,9 +17,23 @@ class EpubReaderActivity final : public Activity {
   std::unique_ptr<Section> section = nullptr;
   int currentSpineIndex = 0;
   int nextPageNumber = 0;
+  // With nextPageNumber == UINT16_MAX: how many pages before the last one to open the section at, for a multi-page
+  // turn back across a chapter start
+  int nextPageFromEnd = 0;
   int pagesUntilFullRefresh = 0;
+  // Area covered by the images of the page shown last, see PageCost
+  uint32_t shownImageArea = 0;
+  // HalPowerManager::getBatteryRevision() as shown in the status bar
+  uint32_t batteryRevision = 0;
   int cachedSpineIndex = 0;
   int cachedChapterTotalPageCount = 0;
+  // First word of the saved page, used to find the same spot again after the chapter is laid out differently
+  PageAnchor cachedAnchor;
+  bool hasCachedAnchor = false;
+  // Element id (#fragment) to open the next loaded section at, from a TOC entry, footnote or internal link
+  std::string pendingAnchorId;
+  // KOReader sync landmark (DOM path) to open the next loaded section at
+  std::string pendingLandmark;
   unsigned long lastPageTurnTime = 0UL;
   unsigned long pageTurnDuration = 0UL;
   // Signals that the next render should reposition within the newly loaded section
@@ -25,8 +45,20 @@ class EpubReaderActivity final : public Activity {
   bool skipNextButtonCheck = false;  // Skip button processing for one frame after subactivity exit
   bool automaticPageTurnActive = false;
 
+  // Background pagination of the neighbouring chapters, kicked off once per loaded section
+  SectionPrefetcher sectionPrefetcher;
+  SectionPrefetcher::LayoutParams prefetchParams;
+  bool prefetchPending = false;
+  // Recording the book as last opened waits until its first page is on screen
+  bool openBookkeepingPending = false;
+  // Set while the render task lays out the current section. The page to open at may already be on screen, see
+  // showEarlyPage(); turns stay within the pages built so far.
+  std::atomic<bool> sectionBuilding{false};
+
   // Footnote support
   std::vector<FootnoteEntry> currentPageFootnotes;
+  // Folder of the installed dictionary, empty when there is none
+  std::string dictionaryDir;
   struct SavedPosition {
     int spineIndex;
     int pageNumber;
@@ -35,27 +67,107 @@ class EpubReaderActivity final : public Activity {
   SavedPosition savedPositions[MAX_FOOTNOTE_DEPTH] = {};
   int footnoteDepth = 0;
 
+  // Status bar values for the page on screen; recomputed only when the page or the title source changes
+  struct StatusBarModel {
+    int spineIndex = -1;
+    int pageIndex = -1;
+    int pageCount = -1;
+    uint8_t titleMode = 0xFF;
+    bool autoTurn = false;
+    unsigned long autoTurnDuration = 0;
+    float bookProgress = 0.0f;
+    std::string title;
+  };
+  mutable StatusBarModel statusBarModel;
+  // Page counts of all sections under the current layout; once complete, book progress is counted in pages
+  SectionPageCounts bookPages;
+  uint32_t bookPagesLayoutKey = 0;
+
+  // Page-ahead render cache: BW frame of the following page, PackBits-compressed
+  std::vector<uint8_t> prerenderedFrame;
+  int prerenderedSpineIndex = -1;
+  int prerenderedPage = -1;
+  // The anti-aliasing refresh of the page shown last is still running on the display task, and the controller
+  // hasn't got the BW frame back yet (see finishGrayRefresh())
+  bool grayRefreshPending = false;
+
+  // Images without a decoded copy (a section laid out in another orientation, a cleared image cache) are first drawn
+  // as quick previews so the page turn doesn't wait for them. This job decodes them in the background; the page is
+  // then redrawn, and only the changed area refreshed.
+  class ImageRefineJob final : public BackgroundJob {
+    GfxRenderer& renderer;
+
+   public:
+    std::vector<ImageBlock> images;
+    size_t next = 0;
+    size_t decoded = 0;
+    // Page the previews are on and where it was drawn
+    int spineIndex = -1;
+    int page = -1;
+    int marginTop = 0;
+    int marginLeft = 0;
+    // Set by the job once some preview can be replaced
+    std::atomic<bool> refined{false};
+
+    explicit ImageRefineJob(GfxRenderer& renderer) : BackgroundJob("ImageRefine"), renderer(renderer) {}
+
+   protected:
+    bool step() override;
+  };
+  ImageRefineJob imageRefineJob;
+  bool imageRefreshPending = false;
+
+  void renderPage();
+  void showEarlyPage(const Page& page, int orientedMarginTop, int orientedMarginLeft);
   void renderContents(std::unique_ptr<Page> page, int orientedMarginTop, int orientedMarginRight,
-                      int orientedMarginBottom, int orientedMarginLeft);
-  void renderStatusBar() const;
-  void saveProgress(int spineIndex, int currentPage, int pageCount);
+                      int orientedMarginBottom, int orientedMarginLeft, bool frameReady = false);
+  void renderStatusBar() const { renderStatusBar(section->currentPage); }
+  void renderStatusBar(int pageIndex) const;
+  bool restorePrerenderedPage();
+  void prerenderNextPage(int orientedMarginTop, int orientedMarginLeft);
+  void invalidatePrerenderedPage();
+  void finishGrayRefresh();
+  // Anti-aliasing passes and refresh for the page in the frame buffer, which is on the panel already
+  void renderGrayPasses(const Page& page, int orientedMarginTop, int orientedMarginLeft, bool imagePreviews);
+  // Hand the page's undecoded images to imageRefineJob; true if they are to be drawn as previews
+  bool queueImageRefine(const Page& page, int orientedMarginTop, int orientedMarginLeft);
+  // Redraw the page on screen once imageRefineJob has decoded its images; false if it is no longer on screen
+  bool refreshRefinedImages();
+  void saveProgress(int spineIndex, int currentPage, int pageCount, const PageAnchor& anchor);
+  // Queue the current position for the next KOReader sync, when sync is set up
+  void queueSyncPosition() const;
+  // Position in the whole book, 0-100
+  int getBookProgressPercent() const;
+  // Remember the current page so the next section load can restore it, even under a different layout
+  void cacheCurrentPosition();
   // Jump to a percentage of the book (0-100), mapping it to spine and page.
   void jumpToPercent(int percent);
   void onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction action);
   void applyOrientation(uint8_t orientation);
   void toggleAutoPageTurn(uint8_t selectedPageTurnOption);
-  void pageTurn(bool isForwardTurn);
+  // Turns several pages in one step; running past either end of the section moves to the neighbouring chapter
+  void pageTurn(bool isForwardTurn, int pages = 1);
 
   // Footnote navigation
   void navigateToHref(const std::string& href, bool savePosition = false);
   void restoreSavedPosition();
 
  public:
-  explicit EpubReaderActivity(GfxRenderer& renderer, MappedInputManager& mappedInput, std::unique_ptr<Epub> epub)
-      : Activity("EpubReader", renderer, mappedInput), epub(std::move(epub)) {}
+  explicit EpubReaderActivity(GfxRenderer& renderer, MappedInputManager& mappedInput, std::shared_ptr<Epub> epub)
+      : Activity("EpubReader", renderer, mappedInput),
+        epub(std::move(epub)),
+        sectionPrefetcher(renderer),
+        imageRefineJob(renderer) {}
   void onEnter() override;
   void onExit() override;
   void loop() override;
   void render(RenderLock&& lock) override;
   bool isReaderActivity() const override { return true; }
+
+  // Layout the reader would paginate with under the current settings (with the automatic page turn off), so
+  // sections can be built ahead of time from outside the reader. Leaves the renderer orientation untouched.
+  static SectionPrefetcher::LayoutParams getLayoutParams(GfxRenderer& renderer);
+
+  // Apply the logical reader orientation (CrossPointSettings::ORIENTATION) to the renderer
+  static void applyReaderOrientation(GfxRenderer& renderer, uint8_t orientation);
 };
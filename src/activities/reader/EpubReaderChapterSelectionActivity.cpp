@@ -3,10 +3,18 @@
 #include <GfxRenderer.h>
 #include <I18n.h>
 
+#include <algorithm>
+
 #include "MappedInputManager.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
 
+namespace {
+// TOCs longer than this many pages get jump stops, this many of them
+constexpr int JUMP_MIN_PAGES = 3;
+constexpr uint32_t JUMP_STOPS = 20;
+}  // namespace
+
 int EpubReaderChapterSelectionActivity::getTotalItems() const { return epub->getTocItemsCount(); }
 
 int EpubReaderChapterSelectionActivity::getPageItems() const {
@@ -37,11 +45,70 @@ void EpubReaderChapterSelectionActivity::onEnter() {
     selectorIndex = 0;
   }
 
+  // Build the top-level jump index from the compact levels table rather than decoding every entry
+  topLevelIndices.clear();
+  std::vector<uint8_t> levels;
+  if (epub->getTocLevels(levels) && !levels.empty()) {
+    const uint8_t topLevel = *std::min_element(levels.begin(), levels.end());
+    if (std::any_of(levels.begin(), levels.end(), [topLevel](const uint8_t level) { return level != topLevel; })) {
+      for (size_t i = 0; i < levels.size(); i++) {
+        if (levels[i] == topLevel) {
+          topLevelIndices.push_back(static_cast<uint16_t>(i));
+        }
+      }
+    }
+  }
+  windowStart = -1;
+
+  jumps.clear();
+  jumpLabel.clear();
+  if (getTotalItems() > JUMP_MIN_PAGES * getPageItems()) {
+    jumps.buildEven(getTotalItems(), JUMP_STOPS);
+  }
+
   // Trigger first update
   requestUpdate();
 }
 
-void EpubReaderChapterSelectionActivity::onExit() { Activity::onExit(); }
+void EpubReaderChapterSelectionActivity::onExit() {
+  Activity::onExit();
+  windowRows.clear();
+  windowRows.shrink_to_fit();
+  windowTitles.clear();
+  windowTitles.shrink_to_fit();
+  topLevelIndices.clear();
+  topLevelIndices.shrink_to_fit();
+  jumps.clear();
+}
+
+int EpubReaderChapterSelectionActivity::nextTopLevelIndex(const int index) const {
+  const auto it = std::upper_bound(topLevelIndices.begin(), topLevelIndices.end(), index);
+  return it != topLevelIndices.end() ? *it : topLevelIndices.front();
+}
+
+int EpubReaderChapterSelectionActivity::previousTopLevelIndex(const int index) const {
+  const auto it = std::lower_bound(topLevelIndices.begin(), topLevelIndices.end(), index);
+  return it != topLevelIndices.begin() ? *(it - 1) : topLevelIndices.back();
+}
+
+void EpubReaderChapterSelectionActivity::loadWindow(const int first, const int count, const int contentX,
+                                                    const int contentWidth) {
+  if (first == windowStart && contentWidth == windowContentWidth && static_cast<int>(windowRows.size()) == count) {
+    return;
+  }
+
+  if (!epub->getTocItems(first, count, windowRows)) {
+    windowRows.clear();
+  }
+  windowTitles.resize(windowRows.size());
+  for (size_t i = 0; i < windowRows.size(); i++) {
+    // Indent per TOC level while keeping content within the gutter-safe region.
+    const int indentSize = contentX + 20 + (windowRows[i].level - 1) * 15;
+    windowTitles[i] = renderer.truncatedText(UI_10_FONT_ID, windowRows[i].title.c_str(), contentWidth - 40 - indentSize);
+  }
+  windowStart = first;
+  windowContentWidth = contentWidth;
+}
 
 void EpubReaderChapterSelectionActivity::loop() {
   const int pageItems = getPageItems();
@@ -55,7 +122,7 @@ void EpubReaderChapterSelectionActivity::loop() {
       setResult(std::move(result));
       finish();
     } else {
-      setResult(ChapterResult{newSpineIndex});
+      setResult(ChapterResult{newSpineIndex, epub->getTocItem(selectorIndex).anchor});
       finish();
     }
   } else if (mappedInput.wasReleased(MappedInputManager::Button::Back)) {
@@ -65,25 +132,68 @@ void EpubReaderChapterSelectionActivity::loop() {
     finish();
   }
 
-  buttonNavigator.onNextRelease([this, totalItems] {
-    selectorIndex = ButtonNavigator::nextIndex(selectorIndex, totalItems);
-    requestUpdate();
-  });
-
-  buttonNavigator.onPreviousRelease([this, totalItems] {
-    selectorIndex = ButtonNavigator::previousIndex(selectorIndex, totalItems);
-    requestUpdate();
-  });
+  if (!topLevelIndices.empty()) {
+    // Nested TOC: Left/Right jump between top-level chapters, the side buttons step through every entry
+    buttonNavigator.onRelease({MappedInputManager::Button::Right}, [this] {
+      selectorIndex = nextTopLevelIndex(selectorIndex);
+      requestUpdate();
+    });
+
+    buttonNavigator.onRelease({MappedInputManager::Button::Left}, [this] {
+      selectorIndex = previousTopLevelIndex(selectorIndex);
+      requestUpdate();
+    });
+
+    buttonNavigator.onRelease({MappedInputManager::Button::Down}, [this, totalItems] {
+      selectorIndex = ButtonNavigator::nextIndex(selectorIndex, totalItems);
+      requestUpdate();
+    });
+
+    buttonNavigator.onRelease({MappedInputManager::Button::Up}, [this, totalItems] {
+      selectorIndex = ButtonNavigator::previousIndex(selectorIndex, totalItems);
+      requestUpdate();
+    });
+  } else {
+    buttonNavigator.onNextRelease([this, totalItems] {
+      selectorIndex = ButtonNavigator::nextIndex(selectorIndex, totalItems);
+      requestUpdate();
+    });
+
+    buttonNavigator.onPreviousRelease([this, totalItems] {
+      selectorIndex = ButtonNavigator::previousIndex(selectorIndex, totalItems);
+      requestUpdate();
+    });
+  }
 
   buttonNavigator.onNextContinuous([this, totalItems, pageItems] {
-    selectorIndex = ButtonNavigator::nextPageIndex(selectorIndex, totalItems, pageItems);
+    if (jumps.usable()) {
+      RenderLock lock(*this);
+      selectorIndex = jumps.nextGroupRow(selectorIndex);
+      jumpLabel = jumps.labelOf(selectorIndex);
+    } else {
+      selectorIndex = ButtonNavigator::nextPageIndex(selectorIndex, totalItems, pageItems);
+    }
     requestUpdate();
   });
 
   buttonNavigator.onPreviousContinuous([this, totalItems, pageItems] {
-    selectorIndex = ButtonNavigator::previousPageIndex(selectorIndex, totalItems, pageItems);
+    if (jumps.usable()) {
+      RenderLock lock(*this);
+      selectorIndex = jumps.previousGroupRow(selectorIndex);
+      jumpLabel = jumps.labelOf(selectorIndex);
+    } else {
+      selectorIndex = ButtonNavigator::previousPageIndex(selectorIndex, totalItems, pageItems);
+    }
     requestUpdate();
   });
+
+  if (!jumpLabel.empty() && !ButtonNavigator::isNavigationHeld()) {
+    {
+      RenderLock lock(*this);
+      jumpLabel.clear();
+    }
+    requestUpdate();
+  }
 }
 
 void EpubReaderChapterSelectionActivity::render(RenderLock&&) {
@@ -114,24 +224,26 @@ void EpubReaderChapterSelectionActivity::render(RenderLock&&) {
   // Highlight only the content area, not the hint gutters.
   renderer.fillRect(contentX, 60 + contentY + (selectorIndex % pageItems) * 30 - 2, contentWidth - 1, 30);
 
-  for (int i = 0; i < pageItems; i++) {
-    int itemIndex = pageStartIndex + i;
-    if (itemIndex >= totalItems) break;
-    const int displayY = 60 + contentY + i * 30;
+  loadWindow(pageStartIndex, std::min(pageItems, totalItems - pageStartIndex), contentX, contentWidth);
+  for (size_t i = 0; i < windowRows.size(); i++) {
+    const int itemIndex = pageStartIndex + static_cast<int>(i);
+    const int displayY = 60 + contentY + static_cast<int>(i) * 30;
     const bool isSelected = (itemIndex == selectorIndex);
 
-    auto item = epub->getTocItem(itemIndex);
-
-    // Indent per TOC level while keeping content within the gutter-safe region.
-    const int indentSize = contentX + 20 + (item.level - 1) * 15;
-    const std::string chapterName =
-        renderer.truncatedText(UI_10_FONT_ID, item.title.c_str(), contentWidth - 40 - indentSize);
-
-    renderer.drawText(UI_10_FONT_ID, indentSize, displayY, chapterName.c_str(), !isSelected);
+    const int indentSize = contentX + 20 + (windowRows[i].level - 1) * 15;
+    renderer.drawText(UI_10_FONT_ID, indentSize, displayY, windowTitles[i].c_str(), !isSelected);
   }
 
-  const auto labels = mappedInput.mapLabels(tr(STR_BACK), tr(STR_SELECT), tr(STR_DIR_UP), tr(STR_DIR_DOWN));
+  const auto labels = topLevelIndices.empty()
+                          ? mappedInput.mapLabels(tr(STR_BACK), tr(STR_SELECT), tr(STR_DIR_UP), tr(STR_DIR_DOWN))
+                          : mappedInput.mapLabels(tr(STR_BACK), tr(STR_SELECT), tr(STR_PREV_CHAPTER),
+                                                  tr(STR_NEXT_CHAPTER));
   GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
 
+  if (!jumpLabel.empty()) {
+    // Shows the page as well
+    GUI.drawPopup(renderer, jumpLabel.c_str());
+    return;
+  }
   renderer.displayBuffer();
 }
@@ -2,9 +2,12 @@
 #include <Epub.h>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "../Activity.h"
 #include "util/ButtonNavigator.h"
+#include "util/JumpIndex.h"
 
 class EpubReaderChapterSelectionActivity final : public Activity {
   std::shared_ptr<Epub> epub;
@@ -13,6 +16,25 @@ class EpubReaderChapterSelectionActivity final : public Activity {
   int currentSpineIndex = 0;
   int selectorIndex = 0;
 
+  // One screen of TOC rows, read in a single sequential pass and truncated once per window
+  std::vector<BookMetadataCache::TocEntry> windowRows;
+  ActivityVector<std::string> windowTitles;
+  int windowStart = -1;
+  int windowContentWidth = -1;
+
+  // Indices of the shallowest TOC level, for jumping between top-level chapters with Left/Right. Empty when the
+  // TOC is flat, in which case Left/Right keep moving one entry at a time.
+  ActivityVector<uint16_t> topLevelIndices;
+
+  // Stops evenly spaced through a TOC several pages long (titles aren't sorted, so no letters here); held buttons
+  // jump between them instead of paging. The label of the last stop is shown until the button is let go.
+  JumpIndex jumps;
+  std::string jumpLabel;
+
+  void loadWindow(int first, int count, int contentX, int contentWidth);
+  int nextTopLevelIndex(int index) const;
+  int previousTopLevelIndex(int index) const;
+
   // Number of items that fit on a page, derived from logical screen height.
   // This adapts automatically when switching between portrait and landscape.
   int getPageItems() const;
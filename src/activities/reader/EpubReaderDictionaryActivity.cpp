@@ -0,0 +1,193 @@
+#include "EpubReaderDictionaryActivity.h"
+
+#include <GfxRenderer.h>
+#include <I18n.h>
+
+#include <algorithm>
+
+#include "MappedInputManager.h"
+#include "components/UITheme.h"
+#include "fontIds.h"
+
+namespace {
+constexpr int START_Y = 50;
+constexpr int LINE_HEIGHT = 36;
+constexpr int MARGIN_LEFT = 20;
+constexpr int MAX_DEFINITION_LINES = 200;
+
+// Wraps every paragraph of text on its own
+std::vector<std::string> wrapParagraphs(const GfxRenderer& renderer, const std::string& text, const int width,
+                                        const int maxLines) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  while (start <= text.size() && static_cast<int>(lines.size()) < maxLines) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const std::string paragraph = text.substr(start, end - start);
+    if (paragraph.empty()) {
+      lines.emplace_back();
+    } else {
+      auto wrapped =
+          renderer.wrappedText(UI_10_FONT_ID, paragraph.c_str(), width, maxLines - static_cast<int>(lines.size()));
+      lines.insert(lines.end(), wrapped.begin(), wrapped.end());
+    }
+    start = end + 1;
+  }
+  return lines;
+}
+}  // namespace
+
+void EpubReaderDictionaryActivity::onEnter() {
+  Activity::onEnter();
+  selectedIndex = 0;
+  requestUpdate();
+}
+
+void EpubReaderDictionaryActivity::onExit() { Activity::onExit(); }
+
+void EpubReaderDictionaryActivity::loop() {
+  if (mappedInput.wasReleased(MappedInputManager::Button::Back)) {
+    if (showingDefinition) {
+      showingDefinition = false;
+      requestUpdate();
+      return;
+    }
+    ActivityResult result;
+    result.isCancelled = true;
+    setResult(std::move(result));
+    finish();
+    return;
+  }
+
+  if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
+    if (!showingDefinition && found && definitionIndex == selectedIndex) {
+      showingDefinition = true;
+      definitionPage = 0;
+      requestUpdate();
+    }
+    return;
+  }
+
+  const int count = static_cast<int>(words.size());
+  buttonNavigator.onNext([this, count] {
+    if (showingDefinition) {
+      if (definitionPage + 1 < definitionPageCount) {
+        definitionPage++;
+        requestUpdate();
+      }
+    } else if (count > 0) {
+      selectedIndex = ButtonNavigator::nextIndex(selectedIndex, count);
+      requestUpdate();
+    }
+  });
+
+  buttonNavigator.onPrevious([this, count] {
+    if (showingDefinition) {
+      if (definitionPage > 0) {
+        definitionPage--;
+        requestUpdate();
+      }
+    } else if (count > 0) {
+      selectedIndex = ButtonNavigator::previousIndex(selectedIndex, count);
+      requestUpdate();
+    }
+  });
+}
+
+void EpubReaderDictionaryActivity::updateDefinition() {
+  if (definitionIndex == selectedIndex) {
+    return;
+  }
+  definitionIndex = selectedIndex;
+  found = selectedIndex >= 0 && selectedIndex < static_cast<int>(words.size()) &&
+          dictionary.lookup(words[selectedIndex], definition);
+  if (!found) {
+    definition = tr(STR_NO_DEFINITION);
+  }
+}
+
+void EpubReaderDictionaryActivity::render(RenderLock&&) {
+  if (!opened) {
+    opened = true;
+    dictionary.open(dictionaryDir, [this] { GUI.drawPopup(renderer, tr(STR_INDEXING)); });
+  }
+
+  renderer.clearScreen();
+  if (!dictionary.isOpen() || words.empty()) {
+    renderer.drawCenteredText(UI_12_FONT_ID, 15, tr(STR_DICTIONARY), true, EpdFontFamily::BOLD);
+    renderer.drawCenteredText(UI_10_FONT_ID, 90,
+                              dictionary.isOpen() ? tr(STR_NO_WORDS_ON_PAGE) : tr(STR_DICTIONARY_ERROR));
+    const auto labels = mappedInput.mapLabels(tr(STR_BACK), "", "", "");
+    GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+    renderer.displayBuffer();
+    return;
+  }
+
+  updateDefinition();
+  if (showingDefinition) {
+    renderDefinition();
+  } else {
+    renderList();
+  }
+  renderer.displayBuffer();
+}
+
+void EpubReaderDictionaryActivity::renderList() {
+  const int screenWidth = renderer.getScreenWidth();
+  renderer.drawCenteredText(UI_12_FONT_ID, 15, dictionary.getName().c_str(), true, EpdFontFamily::BOLD);
+
+  const int previewLineHeight = renderer.getLineHeight(UI_10_FONT_ID);
+  const auto previewLines = wrapParagraphs(renderer, definition, screenWidth - 2 * MARGIN_LEFT, MAX_PREVIEW_LINES);
+  const int listBottom = renderer.getScreenHeight() - UITheme::getInstance().getMetrics().buttonHintsHeight -
+                         static_cast<int>(previewLines.size()) * previewLineHeight - LINE_HEIGHT / 2;
+
+  const int visibleCount = std::max(1, (listBottom - START_Y) / LINE_HEIGHT);
+  if (selectedIndex < scrollOffset) scrollOffset = selectedIndex;
+  if (selectedIndex >= scrollOffset + visibleCount) scrollOffset = selectedIndex - visibleCount + 1;
+
+  for (int i = scrollOffset; i < static_cast<int>(words.size()) && i < scrollOffset + visibleCount; i++) {
+    const int y = START_Y + (i - scrollOffset) * LINE_HEIGHT;
+    const bool isSelected = (i == selectedIndex);
+    if (isSelected) {
+      renderer.fillRect(0, y, screenWidth, LINE_HEIGHT, true);
+    }
+    renderer.drawText(UI_10_FONT_ID, MARGIN_LEFT, y + 4, words[i].c_str(), !isSelected);
+  }
+
+  const int previewTop = START_Y + visibleCount * LINE_HEIGHT + LINE_HEIGHT / 4;
+  renderer.drawLine(MARGIN_LEFT, previewTop, screenWidth - MARGIN_LEFT, previewTop);
+  int y = previewTop + LINE_HEIGHT / 4;
+  for (const auto& line : previewLines) {
+    renderer.drawText(UI_10_FONT_ID, MARGIN_LEFT, y, line.c_str());
+    y += previewLineHeight;
+  }
+
+  const auto labels = mappedInput.mapLabels(tr(STR_BACK), found ? tr(STR_SELECT) : "", tr(STR_DIR_UP),
+                                            tr(STR_DIR_DOWN));
+  GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+}
+
+void EpubReaderDictionaryActivity::renderDefinition() {
+  const int screenWidth = renderer.getScreenWidth();
+  renderer.drawCenteredText(UI_12_FONT_ID, 15, words[selectedIndex].c_str(), true, EpdFontFamily::BOLD);
+
+  const int lineHeight = renderer.getLineHeight(UI_10_FONT_ID);
+  const int bottom = renderer.getScreenHeight() - UITheme::getInstance().getMetrics().buttonHintsHeight;
+  const int linesPerPage = std::max(1, (bottom - START_Y) / lineHeight);
+  const auto lines = wrapParagraphs(renderer, definition, screenWidth - 2 * MARGIN_LEFT, MAX_DEFINITION_LINES);
+  definitionPageCount = std::max(1, (static_cast<int>(lines.size()) + linesPerPage - 1) / linesPerPage);
+  definitionPage = std::min(definitionPage, definitionPageCount - 1);
+
+  int y = START_Y;
+  const int first = definitionPage * linesPerPage;
+  for (int i = first; i < static_cast<int>(lines.size()) && i < first + linesPerPage; i++) {
+    renderer.drawText(UI_10_FONT_ID, MARGIN_LEFT, y, lines[i].c_str());
+    y += lineHeight;
+  }
+
+  const auto labels = mappedInput.mapLabels(tr(STR_BACK), "", definitionPage > 0 ? tr(STR_DIR_UP) : "",
+                                            definitionPage + 1 < definitionPageCount ? tr(STR_DIR_DOWN) : "");
+  GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+}
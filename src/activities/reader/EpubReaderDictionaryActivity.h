@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Dictionary.h>
+
+#include <string>
+#include <vector>
+
+#include "../Activity.h"
+#include "util/ButtonNavigator.h"
+
+// Word lookup from the reader: lists the words of the current page, with the definition of the selected one under
+// the list; Confirm shows the whole definition a screen at a time. The dictionary is opened on the first render,
+// since its index may have to be built then.
+class EpubReaderDictionaryActivity final : public Activity {
+ public:
+  explicit EpubReaderDictionaryActivity(GfxRenderer& renderer, MappedInputManager& mappedInput,
+                                        std::string dictionaryDir, std::vector<std::string> words)
+      : Activity("EpubReaderDictionary", renderer, mappedInput),
+        dictionaryDir(std::move(dictionaryDir)),
+        words(std::move(words)) {}
+
+  void onEnter() override;
+  void onExit() override;
+  void loop() override;
+  void render(RenderLock&&) override;
+
+ private:
+  static constexpr int MAX_PREVIEW_LINES = 8;
+
+  void renderList();
+  void renderDefinition();
+  // Looks up the selected word unless its definition is there already
+  void updateDefinition();
+
+  std::string dictionaryDir;
+  std::vector<std::string> words;
+  Dictionary dictionary;
+  bool opened = false;
+
+  int selectedIndex = 0;
+  int scrollOffset = 0;
+  int definitionIndex = -1;  // Word definition belongs to
+  bool found = false;
+  std::string definition;
+
+  bool showingDefinition = false;
+  int definitionPage = 0;
+  int definitionPageCount = 1;
+  ButtonNavigator buttonNavigator;
+};
@@ -67,7 +67,25 @@ void EpubReaderFootnotesActivity::render(RenderLock&&) {
   const int screenWidth = renderer.getScreenWidth();
   constexpr int marginLeft = 20;
 
-  const int visibleCount = std::max(1, (renderer.getScreenHeight() - startY) / lineHeight);
+  // Text captured when the target chapter was indexed, shown without opening it
+  if (previewFn && previewIndex != selectedIndex) {
+    previewText.clear();
+    if (selectedIndex >= 0 && selectedIndex < static_cast<int>(footnotes.size())) {
+      previewFn(footnotes[selectedIndex], previewText);
+    }
+    previewIndex = selectedIndex;
+  }
+  int listBottom = renderer.getScreenHeight();
+  std::vector<std::string> previewLines;
+  const int previewLineHeight = renderer.getLineHeight(UI_10_FONT_ID);
+  if (!previewText.empty()) {
+    previewLines =
+        renderer.wrappedText(UI_10_FONT_ID, previewText.c_str(), screenWidth - 2 * marginLeft, MAX_PREVIEW_LINES);
+    listBottom -= UITheme::getInstance().getMetrics().buttonHintsHeight +
+                  static_cast<int>(previewLines.size()) * previewLineHeight + lineHeight / 2;
+  }
+
+  const int visibleCount = std::max(1, (listBottom - startY) / lineHeight);
   if (selectedIndex < scrollOffset) scrollOffset = selectedIndex;
   if (selectedIndex >= scrollOffset + visibleCount) scrollOffset = selectedIndex - visibleCount + 1;
 
@@ -87,6 +105,16 @@ void EpubReaderFootnotesActivity::render(RenderLock&&) {
     renderer.drawText(UI_10_FONT_ID, marginLeft, y + 4, label.c_str(), !isSelected);
   }
 
+  if (!previewLines.empty()) {
+    const int previewTop = startY + visibleCount * lineHeight + lineHeight / 4;
+    renderer.drawLine(marginLeft, previewTop, screenWidth - marginLeft, previewTop);
+    int y = previewTop + lineHeight / 4;
+    for (const auto& line : previewLines) {
+      renderer.drawText(UI_10_FONT_ID, marginLeft, y, line.c_str());
+      y += previewLineHeight;
+    }
+  }
+
   const auto labels = mappedInput.mapLabels(tr(STR_BACK), tr(STR_SELECT), "", "");
   GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
 
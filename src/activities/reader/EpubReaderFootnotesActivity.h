@@ -4,6 +4,7 @@
 
 #include <cstring>
 #include <functional>
+#include <string>
 #include <vector>
 
 #include "../Activity.h"
@@ -11,9 +12,12 @@
 
 class EpubReaderFootnotesActivity final : public Activity {
  public:
+  // Fills in the stored text of a footnote, for the preview under the list
+  using PreviewFn = std::function<bool(const FootnoteEntry&, std::string&)>;
+
   explicit EpubReaderFootnotesActivity(GfxRenderer& renderer, MappedInputManager& mappedInput,
-                                       const std::vector<FootnoteEntry>& footnotes)
-      : Activity("EpubReaderFootnotes", renderer, mappedInput), footnotes(footnotes) {}
+                                       const std::vector<FootnoteEntry>& footnotes, PreviewFn previewFn = nullptr)
+      : Activity("EpubReaderFootnotes", renderer, mappedInput), footnotes(footnotes), previewFn(std::move(previewFn)) {}
 
   void onEnter() override;
   void onExit() override;
@@ -21,7 +25,12 @@ class EpubReaderFootnotesActivity final : public Activity {
   void render(RenderLock&&) override;
 
  private:
+  static constexpr int MAX_PREVIEW_LINES = 8;
+
   const std::vector<FootnoteEntry>& footnotes;
+  PreviewFn previewFn;
+  int previewIndex = -1;  // Footnote previewText belongs to
+  std::string previewText;
   int selectedIndex = 0;
   int scrollOffset = 0;
   ButtonNavigator buttonNavigator;
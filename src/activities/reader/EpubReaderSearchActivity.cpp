@@ -0,0 +1,280 @@
+#include "EpubReaderSearchActivity.h"
+
+#include <Epub/Section.h>
+#include <GfxRenderer.h>
+#include <HalPowerManager.h>
+#include <I18n.h>
+#include <ZipFile.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "MappedInputManager.h"
+#include "components/UITheme.h"
+#include "fontIds.h"
+#include "activities/util/KeyboardEntryActivity.h"
+
+int EpubReaderSearchActivity::getPageItems() const {
+  constexpr int lineHeight = 30;
+  const bool isPortraitInverted = renderer.getOrientation() == GfxRenderer::Orientation::PortraitInverted;
+  const int startY = 75 + (isPortraitInverted ? 50 : 0);
+  return std::max(1, (renderer.getScreenHeight() - startY - lineHeight) / lineHeight);
+}
+
+void EpubReaderSearchActivity::onEnter() {
+  Activity::onEnter();
+  promptForQuery();
+}
+
+void EpubReaderSearchActivity::onExit() {
+  stopSearch();
+  Activity::onExit();
+}
+
+void EpubReaderSearchActivity::promptForQuery() {
+  startActivityForResult(std::make_unique<KeyboardEntryActivity>(renderer, mappedInput, tr(STR_SEARCH), query,
+                                                                 ChapterTextSearcher::MAX_QUERY_LENGTH, false),
+                         [this](const ActivityResult& result) {
+                           if (result.isCancelled) {
+                             if (query.empty()) {
+                               ActivityResult cancelled;
+                               cancelled.isCancelled = true;
+                               setResult(std::move(cancelled));
+                               finish();
+                             }
+                             return;
+                           }
+                           query = std::get<KeyboardResult>(result.data).text;
+                           startSearch();
+                         });
+}
+
+void EpubReaderSearchActivity::startSearch() {
+  stopSearch();
+  {
+    RenderLock lock(*this);
+    matches.clear();
+    selectorIndex = 0;
+  }
+  chaptersSearched = 0;
+
+  if (!ChapterTextSearcher(query).isValid() || !epub) {
+    return;
+  }
+
+  abortRequested = false;
+  running = true;
+  // Same low priority as the section prefetcher: only runs while the UI is idle
+  const BaseType_t created = xTaskCreate(
+      [](void* param) {
+        auto* self = static_cast<EpubReaderSearchActivity*>(param);
+        self->run();
+        vTaskDelete(nullptr);
+      },
+      "EpubSearch", TASK_STACK_SIZE, this, 0, nullptr);
+
+  if (created != pdPASS) {
+    LOG_ERR("SRC", "Failed to create search task");
+    running = false;
+  }
+}
+
+void EpubReaderSearchActivity::stopSearch() {
+  if (!running) {
+    return;
+  }
+  abortRequested = true;
+  while (running) {
+    delay(5);
+  }
+}
+
+bool EpubReaderSearchActivity::shouldAbort() const {
+  // Stand aside while the list is being drawn so the render task gets the SD card to itself
+  while (!abortRequested && RenderLock::peek()) {
+    delay(5);
+  }
+  return abortRequested;
+}
+
+void EpubReaderSearchActivity::run() {
+  HalPowerManager::Lock powerLock;
+  const uint32_t start = millis();
+  const int spineCount = epub->getSpineItemsCount();
+  ChapterTextSearcher searcher(query);
+  std::vector<Match> chapterMatches;
+  size_t totalMatches = 0;
+
+  for (int spineIndex = 0; spineIndex < spineCount && totalMatches < MAX_MATCHES; spineIndex++) {
+    if (shouldAbort()) {
+      break;
+    }
+
+    ZipEntryReader reader(epub->getPath(), epub->getZipIndexPath());
+    if (!epub->openItemReader(epub->getSpineItem(spineIndex).href, reader)) {
+      LOG_ERR("SRC", "Could not open spine item %d", spineIndex);
+      chaptersSearched = spineIndex + 1;
+      continue;
+    }
+
+    chapterMatches.clear();
+    const bool searched = searcher.search(
+        reader,
+        [&](const ChapterTextSearcher::Hit& hit) {
+          if (totalMatches + chapterMatches.size() >= MAX_MATCHES) {
+            return;
+          }
+          Match match = {static_cast<int16_t>(spineIndex), -1, static_cast<float>(hit.textOffset), {}};
+          strncpy(match.snippet, hit.snippet, sizeof(match.snippet) - 1);
+          chapterMatches.push_back(match);
+        },
+        [this]() { return shouldAbort(); });
+    reader.close();
+    if (!searched && abortRequested) {
+      break;
+    }
+
+    if (!chapterMatches.empty()) {
+      // Offsets become fractions of the chapter text; a section cache for the current layout turns them into pages
+      const float textLength = static_cast<float>(std::max<uint32_t>(1, searcher.getTextLength()));
+      Section section(epub, spineIndex, renderer);
+      const bool paginated = section.loadSectionFile(params.fontId, params.lineCompression,
+                                                     params.extraParagraphSpacing, params.paragraphAlignment,
+                                                     params.viewportWidth, params.viewportHeight,
+                                                     params.hyphenationEnabled, params.embeddedStyle);
+      for (auto& match : chapterMatches) {
+        match.progress /= textLength;
+        if (paginated) {
+          match.page = static_cast<int16_t>(section.getPageForProgress(match.progress));
+        }
+      }
+
+      RenderLock lock;
+      matches.insert(matches.end(), chapterMatches.begin(), chapterMatches.end());
+      totalMatches = matches.size();
+    }
+    chaptersSearched = spineIndex + 1;
+    matchesChanged = true;
+  }
+
+  LOG_DBG("SRC", "Search for \"%s\" found %zu matches in %lu ms", query.c_str(), totalMatches, millis() - start);
+  matchesChanged = true;
+  running = false;
+}
+
+void EpubReaderSearchActivity::loop() {
+  if (matchesChanged.exchange(false)) {
+    requestUpdate();
+  }
+
+  if (mappedInput.wasReleased(MappedInputManager::Button::Back)) {
+    stopSearch();
+    ActivityResult result;
+    result.isCancelled = true;
+    setResult(std::move(result));
+    finish();
+    return;
+  }
+
+  size_t matchCount;
+  {
+    RenderLock lock(*this);
+    matchCount = matches.size();
+  }
+
+  if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
+    if (matchCount == 0) {
+      // Nothing to pick (yet): edit the query instead
+      if (!running) {
+        promptForQuery();
+      }
+      return;
+    }
+    stopSearch();
+    const Match match = matches[selectorIndex];
+    setResult(SearchResult{match.spineIndex, match.page, match.progress});
+    finish();
+    return;
+  }
+
+  const int totalItems = static_cast<int>(matchCount);
+  const int pageItems = getPageItems();
+  if (totalItems == 0) {
+    return;
+  }
+
+  buttonNavigator.onNextRelease([this, totalItems] {
+    selectorIndex = ButtonNavigator::nextIndex(selectorIndex, totalItems);
+    requestUpdate();
+  });
+
+  buttonNavigator.onPreviousRelease([this, totalItems] {
+    selectorIndex = ButtonNavigator::previousIndex(selectorIndex, totalItems);
+    requestUpdate();
+  });
+
+  buttonNavigator.onNextContinuous([this, totalItems, pageItems] {
+    selectorIndex = ButtonNavigator::nextPageIndex(selectorIndex, totalItems, pageItems);
+    requestUpdate();
+  });
+
+  buttonNavigator.onPreviousContinuous([this, totalItems, pageItems] {
+    selectorIndex = ButtonNavigator::previousPageIndex(selectorIndex, totalItems, pageItems);
+    requestUpdate();
+  });
+}
+
+void EpubReaderSearchActivity::render(RenderLock&&) {
+  renderer.clearScreen();
+
+  const auto pageWidth = renderer.getScreenWidth();
+  const auto orientation = renderer.getOrientation();
+  // Same hint gutters as the chapter selection screen
+  const bool isLandscapeCw = orientation == GfxRenderer::Orientation::LandscapeClockwise;
+  const bool isLandscapeCcw = orientation == GfxRenderer::Orientation::LandscapeCounterClockwise;
+  const bool isPortraitInverted = orientation == GfxRenderer::Orientation::PortraitInverted;
+  const int hintGutterWidth = (isLandscapeCw || isLandscapeCcw) ? 30 : 0;
+  const int contentX = isLandscapeCw ? hintGutterWidth : 0;
+  const int contentWidth = pageWidth - hintGutterWidth;
+  const int contentY = isPortraitInverted ? 50 : 0;
+  const int pageItems = getPageItems();
+  const int totalItems = static_cast<int>(matches.size());
+
+  const std::string title = renderer.truncatedText(
+      UI_12_FONT_ID, (std::string(tr(STR_SEARCH)) + ": " + query).c_str(), contentWidth - 40, EpdFontFamily::BOLD);
+  const int titleX =
+      contentX + (contentWidth - renderer.getTextWidth(UI_12_FONT_ID, title.c_str(), EpdFontFamily::BOLD)) / 2;
+  renderer.drawText(UI_12_FONT_ID, titleX, 15 + contentY, title.c_str(), true, EpdFontFamily::BOLD);
+
+  std::string status;
+  if (running) {
+    status = std::string(tr(STR_SEARCHING)) + " " + std::to_string(chaptersSearched) + "/" +
+             std::to_string(epub->getSpineItemsCount());
+  } else if (totalItems == 0) {
+    status = tr(STR_SEARCH_NO_MATCHES);
+  } else {
+    status = std::to_string(totalItems) + tr(STR_SEARCH_MATCHES);
+  }
+  renderer.drawCenteredText(UI_10_FONT_ID, 45 + contentY, status.c_str());
+
+  if (totalItems > 0) {
+    selectorIndex = std::min(selectorIndex, totalItems - 1);
+    const int pageStartIndex = selectorIndex / pageItems * pageItems;
+    renderer.fillRect(contentX, 75 + contentY + (selectorIndex % pageItems) * 30 - 2, contentWidth - 1, 30);
+
+    for (int i = 0; i < pageItems && pageStartIndex + i < totalItems; i++) {
+      const Match& match = matches[pageStartIndex + i];
+      const bool isSelected = pageStartIndex + i == selectorIndex;
+      const std::string snippet = renderer.truncatedText(UI_10_FONT_ID, match.snippet, contentWidth - 40);
+      renderer.drawText(UI_10_FONT_ID, contentX + 20, 75 + contentY + i * 30, snippet.c_str(), !isSelected);
+    }
+  }
+
+  const auto labels = mappedInput.mapLabels(tr(STR_BACK), totalItems > 0 ? tr(STR_SELECT) : tr(STR_SEARCH),
+                                            tr(STR_DIR_UP), tr(STR_DIR_DOWN));
+  GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+
+  renderer.displayBuffer();
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Epub.h>
+#include <Epub/parsers/ChapterTextSearcher.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Activity.h"
+#include "SectionPrefetcher.h"
+#include "util/ButtonNavigator.h"
+
+// Full-text search over the spine. Asks for a query, then streams every chapter through ChapterTextSearcher on a
+// background task; matches show up in the list as each chapter finishes. Chapters that already have a section
+// cache for the current layout get an exact page from its page table, others are opened at the matching fraction.
+class EpubReaderSearchActivity final : public Activity {
+ public:
+  struct Match {
+    int16_t spineIndex;
+    int16_t page;  // -1 when the chapter isn't paginated yet, see progress
+    float progress;
+    char snippet[ChapterTextSearcher::SNIPPET_SIZE];
+  };
+
+  explicit EpubReaderSearchActivity(GfxRenderer& renderer, MappedInputManager& mappedInput,
+                                    const std::shared_ptr<Epub>& epub, const SectionPrefetcher::LayoutParams& params)
+      : Activity("EpubReaderSearch", renderer, mappedInput), epub(epub), params(params) {}
+
+  void onEnter() override;
+  void onExit() override;
+  void loop() override;
+  void render(RenderLock&&) override;
+  bool preventAutoSleep() override { return running; }
+
+ private:
+  static constexpr size_t MAX_MATCHES = 100;
+  static constexpr uint32_t TASK_STACK_SIZE = 8192;
+
+  std::shared_ptr<Epub> epub;
+  SectionPrefetcher::LayoutParams params;
+  ButtonNavigator buttonNavigator;
+  std::string query;
+  int selectorIndex = 0;
+
+  // Written by the worker under the render lock
+  std::vector<Match> matches;
+  std::atomic<bool> running{false};
+  std::atomic<bool> abortRequested{false};
+  std::atomic<bool> matchesChanged{false};
+  std::atomic<int> chaptersSearched{0};
+
+  void promptForQuery();
+  void startSearch();
+  void stopSearch();
+  bool shouldAbort() const;
+  void run();
+  int getPageItems() const;
+};
@@ -0,0 +1,328 @@
+#include "Fb2ReaderActivity.h"
+
+#include <Epub/Page.h>
+#include <GfxRenderer.h>
+#include <HalPowerManager.h>
+#include <HalStorage.h>
+#include <I18n.h>
+#include <Logging.h>
+
+#include "CrossPointSettings.h"
+#include "CrossPointState.h"
+#include "MappedInputManager.h"
+#include "ProgressJournal.h"
+#include "RecentBooksStore.h"
+#include "activities/RenderLock.h"
+#include "components/UITheme.h"
+#include "fontIds.h"
+#include "util/LibraryIndex.h"
+
+namespace {
+constexpr unsigned long skipChapterMs = 700;
+constexpr unsigned long goHomeMs = 1000;
+}  // namespace
+
+void Fb2ReaderActivity::onEnter() {
+  Activity::onEnter();
+  batteryRevision = powerManager.getBatteryRevision();
+
+  if (!fb2) {
+    return;
+  }
+
+  // Configure screen orientation based on settings
+  switch (SETTINGS.orientation) {
+    case CrossPointSettings::ORIENTATION::PORTRAIT:
+      renderer.setOrientation(GfxRenderer::Orientation::Portrait);
+      break;
+    case CrossPointSettings::ORIENTATION::LANDSCAPE_CW:
+      renderer.setOrientation(GfxRenderer::Orientation::LandscapeClockwise);
+      break;
+    case CrossPointSettings::ORIENTATION::INVERTED:
+      renderer.setOrientation(GfxRenderer::Orientation::PortraitInverted);
+      break;
+    case CrossPointSettings::ORIENTATION::LANDSCAPE_CCW:
+      renderer.setOrientation(GfxRenderer::Orientation::LandscapeCounterClockwise);
+      break;
+    default:
+      break;
+  }
+
+  fb2->setupCacheDir();
+  loadProgress();
+
+  // Save current book as last opened file and add to recent books
+  APP_STATE.openEpubPath = fb2->getPath();
+  APP_STATE.saveToFile();
+  RECENT_BOOKS.addBook(fb2->getPath(), fb2->getTitle(), fb2->getAuthor(), "");
+
+  // Trigger first update
+  requestUpdate();
+}
+
+void Fb2ReaderActivity::onExit() {
+  Activity::onExit();
+
+  // Reset orientation back to portrait for the rest of the UI
+  renderer.setOrientation(GfxRenderer::Orientation::Portrait);
+  renderer.clearFontCache();
+
+  PROGRESS_JOURNAL.flush();
+  if (section) {
+    LibraryIndex::setProgress(fb2->getPath(), static_cast<int>(getBookProgress() + 0.5f));
+  }
+  APP_STATE.readerActivityLoadCount = 0;
+  APP_STATE.saveToFile();
+  section.reset();
+  fb2.reset();
+}
+
+void Fb2ReaderActivity::loop() {
+  if (!fb2) {
+    finish();
+    return;
+  }
+
+  // A new battery reading goes into the status bar of the page on screen, without drawing the page again
+  if (batteryRevision != powerManager.getBatteryRevision() && section && !RenderLock::peek()) {
+    batteryRevision = powerManager.getBatteryRevision();
+    RenderLock lock(*this);
+    GUI.refreshStatusBarBattery(renderer);
+  }
+
+  // Long press BACK (1s+) goes to file selection
+  if (mappedInput.isPressed(MappedInputManager::Button::Back) && mappedInput.getHeldTime() >= goHomeMs) {
+    activityManager.goToMyLibrary(fb2->getPath());
+    return;
+  }
+
+  // Short press BACK goes directly to home
+  if (mappedInput.wasReleased(MappedInputManager::Button::Back) && mappedInput.getHeldTime() < goHomeMs) {
+    onGoHome();
+    return;
+  }
+
+  // When long-press chapter skip is disabled, turn pages on press instead of release.
+  const bool usePressForPageTurn = !SETTINGS.longPressChapterSkip;
+  const bool prevTriggered = usePressForPageTurn ? (mappedInput.wasPressed(MappedInputManager::Button::PageBack) ||
+                                                    mappedInput.wasPressed(MappedInputManager::Button::Left))
+                                                 : (mappedInput.wasReleased(MappedInputManager::Button::PageBack) ||
+                                                    mappedInput.wasReleased(MappedInputManager::Button::Left));
+  const bool powerPageTurn = SETTINGS.shortPwrBtn == CrossPointSettings::SHORT_PWRBTN::PAGE_TURN &&
+                             mappedInput.wasReleased(MappedInputManager::Button::Power);
+  const bool nextTriggered = usePressForPageTurn
+                                 ? (mappedInput.wasPressed(MappedInputManager::Button::PageForward) || powerPageTurn ||
+                                    mappedInput.wasPressed(MappedInputManager::Button::Right))
+                                 : (mappedInput.wasReleased(MappedInputManager::Button::PageForward) || powerPageTurn ||
+                                    mappedInput.wasReleased(MappedInputManager::Button::Right));
+
+  if (!prevTriggered && !nextTriggered) {
+    return;
+  }
+
+  const bool skipChapter = SETTINGS.longPressChapterSkip && mappedInput.getHeldTime() > skipChapterMs;
+  if (skipChapter) {
+    const int target = nextTriggered ? currentSectionIndex + 1 : currentSectionIndex - 1;
+    if (target < 0 || target >= fb2->getSectionCount()) {
+      return;
+    }
+    {
+      RenderLock lock(*this);
+      nextPageNumber = 0;
+      currentSectionIndex = target;
+      section.reset();
+    }
+    requestUpdate();
+    return;
+  }
+
+  pageTurn(nextTriggered);
+}
+
+void Fb2ReaderActivity::pageTurn(const bool forward) {
+  if (!section) {
+    requestUpdate();
+    return;
+  }
+
+  if (forward) {
+    if (section->currentPage < section->pageCount - 1) {
+      section->currentPage++;
+    } else if (currentSectionIndex < fb2->getSectionCount() - 1) {
+      RenderLock lock(*this);
+      nextPageNumber = 0;
+      currentSectionIndex++;
+      section.reset();
+    } else {
+      return;
+    }
+  } else {
+    if (section->currentPage > 0) {
+      section->currentPage--;
+    } else if (currentSectionIndex > 0) {
+      RenderLock lock(*this);
+      nextPageNumber = UINT16_MAX;
+      currentSectionIndex--;
+      section.reset();
+    } else {
+      return;
+    }
+  }
+  requestUpdate();
+}
+
+void Fb2ReaderActivity::render(RenderLock&&) {
+  if (!fb2) {
+    return;
+  }
+
+  renderer.getOrientedViewableTRBL(&orientedMarginTop, &orientedMarginRight, &orientedMarginBottom,
+                                   &orientedMarginLeft);
+  orientedMarginTop += SETTINGS.screenMargin;
+  orientedMarginLeft += SETTINGS.screenMargin;
+  orientedMarginRight += SETTINGS.screenMargin;
+  orientedMarginBottom += std::max<int>(SETTINGS.screenMargin, UITheme::getInstance().getStatusBarHeight());
+
+  if (!section) {
+    LOG_DBG("FRS", "Loading section %d", currentSectionIndex);
+    section.reset(new Fb2Section(*fb2, currentSectionIndex, renderer));
+    // Decompressed glyph groups stay cached across the pages of a section, start afresh for the new one
+    renderer.clearFontCache();
+
+    const uint16_t viewportWidth = renderer.getScreenWidth() - orientedMarginLeft - orientedMarginRight;
+    const uint16_t viewportHeight = renderer.getScreenHeight() - orientedMarginTop - orientedMarginBottom;
+    if (!section->loadSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
+                                  SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
+                                  viewportHeight, SETTINGS.hyphenationEnabled)) {
+      LOG_DBG("FRS", "Cache not found, building...");
+      const auto popupFn = [this]() { GUI.drawPopup(renderer, tr(STR_INDEXING)); };
+      if (!section->createSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
+                                      SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
+                                      viewportHeight, SETTINGS.hyphenationEnabled, popupFn)) {
+        LOG_ERR("FRS", "Failed to persist page data to SD");
+        section.reset();
+        renderer.clearScreen();
+        renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_MEMORY_ERROR), true, EpdFontFamily::BOLD);
+        renderer.displayBuffer();
+        return;
+      }
+    }
+
+    section->currentPage = nextPageNumber == UINT16_MAX ? section->pageCount - 1 : nextPageNumber;
+    if (section->currentPage >= section->pageCount) {
+      section->currentPage = std::max(0, section->pageCount - 1);
+    }
+  }
+
+  renderer.clearScreen();
+  if (section->pageCount == 0) {
+    renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_EMPTY_CHAPTER), true, EpdFontFamily::BOLD);
+    renderStatusBar();
+    renderer.displayBuffer();
+    return;
+  }
+
+  const auto page = section->loadPageFromSectionFile();
+  if (!page) {
+    LOG_ERR("FRS", "Failed to load page from SD - clearing section cache");
+    section->clearCache();
+    section.reset();
+    renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_MEMORY_ERROR), true, EpdFontFamily::BOLD);
+    renderer.displayBuffer();
+    return;
+  }
+
+  renderPage(*page);
+  nextPageNumber = section->currentPage;
+  saveProgress();
+}
+
+void Fb2ReaderActivity::renderPage(const Page& page) {
+  const int fontId = SETTINGS.getReaderFontId();
+  // Inflate the page's glyph groups in one go, the grayscale passes below reuse them
+  page.prefetchGlyphs(renderer, fontId);
+
+  // First pass: BW rendering
+  page.render(renderer, fontId, orientedMarginLeft, orientedMarginTop);
+  renderStatusBar();
+
+  if (pagesUntilFullRefresh <= 1) {
+    renderer.displayBuffer(HalDisplay::HALF_REFRESH);
+    pagesUntilFullRefresh = SETTINGS.getRefreshFrequency();
+  } else {
+    renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+    pagesUntilFullRefresh--;
+  }
+
+  // Grayscale rendering pass (for anti-aliased fonts), skipped when the page has nothing it would draw
+  if (SETTINGS.textAntiAliasing && page.hasGrayContent()) {
+    renderer.storeBwBuffer();
+
+    if (renderer.beginGrayscalePlanes()) {
+      page.render(renderer, fontId, orientedMarginLeft, orientedMarginTop);
+      renderer.endGrayscalePlanes();
+    } else {
+      renderer.clearScreen(0x00);
+      renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
+      page.render(renderer, fontId, orientedMarginLeft, orientedMarginTop);
+      renderer.copyGrayscaleLsbBuffers();
+
+      renderer.clearScreen(0x00);
+      renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
+      page.render(renderer, fontId, orientedMarginLeft, orientedMarginTop);
+      renderer.copyGrayscaleMsbBuffers();
+    }
+
+    renderer.displayGrayBuffer();
+    renderer.setRenderMode(GfxRenderer::BW);
+    renderer.restoreBwBuffer();
+  }
+}
+
+float Fb2ReaderActivity::getBookProgress() const {
+  const int pageCount = section ? section->pageCount : 0;
+  const int currentPage = section ? section->currentPage + 1 : 0;
+  const float sectionRead = pageCount > 0 ? static_cast<float>(currentPage) / pageCount : 0.0f;
+  return fb2->calculateProgress(currentSectionIndex, sectionRead) * 100.0f;
+}
+
+void Fb2ReaderActivity::renderStatusBar() const {
+  const int pageCount = section ? section->pageCount : 0;
+  const int currentPage = section ? section->currentPage + 1 : 0;
+  const float progress = getBookProgress();
+
+  std::string title;
+  if (SETTINGS.statusBarTitle == CrossPointSettings::STATUS_BAR_TITLE::CHAPTER_TITLE) {
+    title = fb2->getSection(currentSectionIndex).title;
+    if (title.empty()) {
+      title = tr(STR_UNNAMED);
+    }
+  } else if (SETTINGS.statusBarTitle == CrossPointSettings::STATUS_BAR_TITLE::BOOK_TITLE) {
+    title = fb2->getTitle();
+  }
+  GUI.drawStatusBar(renderer, progress, currentPage, pageCount, title);
+}
+
+void Fb2ReaderActivity::saveProgress() const {
+  uint8_t data[4];
+  data[0] = currentSectionIndex & 0xFF;
+  data[1] = (currentSectionIndex >> 8) & 0xFF;
+  data[2] = section->currentPage & 0xFF;
+  data[3] = (section->currentPage >> 8) & 0xFF;
+  PROGRESS_JOURNAL.save(fb2->getCachePath() + "/progress.bin", data, sizeof(data));
+}
+
+void Fb2ReaderActivity::loadProgress() {
+  {
+    uint8_t data[4];
+    if (PROGRESS_JOURNAL.load(fb2->getCachePath() + "/progress.bin", data, sizeof(data)) == 4) {
+      currentSectionIndex = data[0] + (data[1] << 8);
+      nextPageNumber = data[2] + (data[3] << 8);
+      if (currentSectionIndex >= fb2->getSectionCount()) {
+        currentSectionIndex = 0;
+        nextPageNumber = 0;
+      }
+      LOG_DBG("FRS", "Loaded progress: section %d, page %d", currentSectionIndex, nextPageNumber);
+    }
+  }
+}
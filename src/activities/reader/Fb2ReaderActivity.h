@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Fb2.h>
+#include <Fb2Section.h>
+
+#include <memory>
+
+#include "activities/Activity.h"
+
+class Page;
+
+// Reader for FB2 books. Each top level section is laid out once into its page cache (see Fb2Section) and then read
+// like an EPUB chapter, so page turns only deserialize a single page.
+class Fb2ReaderActivity final : public Activity {
+  std::unique_ptr<Fb2> fb2;
+  std::unique_ptr<Fb2Section> section;
+  int currentSectionIndex = 0;
+  int nextPageNumber = 0;
+  int pagesUntilFullRefresh = 0;
+  // HalPowerManager::getBatteryRevision() as shown in the status bar
+  uint32_t batteryRevision = 0;
+
+  // Margins of the page being shown, from render()
+  int orientedMarginTop = 0;
+  int orientedMarginRight = 0;
+  int orientedMarginBottom = 0;
+  int orientedMarginLeft = 0;
+
+  void pageTurn(bool forward);
+  void renderPage(const Page& page);
+  void renderStatusBar() const;
+  // Percent of the book read
+  float getBookProgress() const;
+  void saveProgress() const;
+  void loadProgress();
+
+ public:
+  explicit Fb2ReaderActivity(GfxRenderer& renderer, MappedInputManager& mappedInput, std::unique_ptr<Fb2> fb2)
+      : Activity("Fb2Reader", renderer, mappedInput), fb2(std::move(fb2)) {}
+  void onEnter() override;
+  void onExit() override;
+  void loop() override;
+  void render(RenderLock&&) override;
+  bool isReaderActivity() const override { return true; }
+};
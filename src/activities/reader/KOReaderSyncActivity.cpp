@@ -1,6 +1,7 @@
 #include "KOReaderSyncActivity.h"
 
 #include <GfxRenderer.h>
+#include <HalPowerManager.h>
 #include <I18n.h>
 #include <Logging.h>
 #include <WiFi.h>
@@ -81,14 +82,42 @@ void KOReaderSyncActivity::onWifiSelectionComplete(const bool success) {
   performSync();
 }
 
-void KOReaderSyncActivity::performSync() {
+void KOReaderSyncActivity::startDocumentHash() {
+  hashStarted = true;
   // Calculate document hash based on user's preferred method
   if (KOREADER_STORE.getMatchMethod() == DocumentMatchMethod::FILENAME) {
     documentHash = KOReaderDocumentId::calculateFromFilename(epubPath);
-  } else {
-    documentHash = KOReaderDocumentId::calculate(epubPath);
+    hashReady = true;
+    return;
+  }
+
+  const auto hashTask = [](void* param) {
+    auto* self = static_cast<KOReaderSyncActivity*>(param);
+    {
+      HalPowerManager::Lock powerLock;
+      self->documentHash = KOReaderDocumentId::calculateCached(self->epubPath, self->epub->getCachePath());
+    }
+    self->hashReady = true;
+    vTaskDelete(nullptr);
+  };
+  if (xTaskCreate(hashTask, "KOHashTask", 4096, this, 1, nullptr) != pdPASS) {
+    documentHash = KOReaderDocumentId::calculateCached(epubPath, epub->getCachePath());
+    hashReady = true;
+  }
+}
+
+bool KOReaderSyncActivity::waitForDocumentHash() {
+  if (!hashStarted) {
+    startDocumentHash();
+  }
+  while (!hashReady) {
+    delay(10);
   }
-  if (documentHash.empty()) {
+  return !documentHash.empty();
+}
+
+void KOReaderSyncActivity::performSync() {
+  if (!waitForDocumentHash()) {
     {
       RenderLock lock(*this);
       state = SYNC_FAILED;
@@ -136,7 +165,7 @@ void KOReaderSyncActivity::performSync() {
   remotePosition = ProgressMapper::toCrossPoint(epub, koPos, currentSpineIndex, totalPagesInSpine);
 
   // Calculate local progress in KOReader format (for display)
-  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine};
+  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine, currentLandmark};
   localProgress = ProgressMapper::toKOReader(epub, localPos);
 
   {
@@ -162,7 +191,7 @@ void KOReaderSyncActivity::performUpload() {
   requestUpdateAndWait();
 
   // Convert current position to KOReader format
-  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine};
+  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine, currentLandmark};
   KOReaderPosition koPos = ProgressMapper::toKOReader(epub, localPos);
 
   KOReaderProgress progress;
@@ -201,6 +230,9 @@ void KOReaderSyncActivity::onEnter() {
     return;
   }
 
+  // Hash the document while WiFi connects and NTP syncs
+  startDocumentHash();
+
   // Check if already connected (e.g. from settings page auth)
   if (WiFi.status() == WL_CONNECTED) {
     LOG_DBG("KOSync", "Already connected to WiFi");
@@ -235,6 +267,11 @@ void KOReaderSyncActivity::onEnter() {
 void KOReaderSyncActivity::onExit() {
   Activity::onExit();
 
+  // The hash task writes into this activity
+  if (hashStarted) {
+    waitForDocumentHash();
+  }
+
   wifiOff();
 }
 
@@ -378,7 +415,7 @@ void KOReaderSyncActivity::loop() {
     if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
       if (selectedOption == 0) {
         // Wifi will be turned off in onExit()
-        setResult(SyncResult{remotePosition.spineIndex, remotePosition.pageNumber});
+        setResult(SyncResult{remotePosition.spineIndex, remotePosition.pageNumber, remotePosition.landmark});
         finish();
       } else if (selectedOption == 1) {
         // Upload local progress
@@ -397,14 +434,7 @@ void KOReaderSyncActivity::loop() {
 
   if (state == NO_REMOTE_PROGRESS) {
     if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
-      // Calculate hash if not done yet
-      if (documentHash.empty()) {
-        if (KOREADER_STORE.getMatchMethod() == DocumentMatchMethod::FILENAME) {
-          documentHash = KOReaderDocumentId::calculateFromFilename(epubPath);
-        } else {
-          documentHash = KOReaderDocumentId::calculate(epubPath);
-        }
-      }
+      waitForDocumentHash();
       performUpload();
     }
 
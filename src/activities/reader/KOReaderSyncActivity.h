@@ -1,6 +1,7 @@
 #pragma once
 #include <Epub.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 
@@ -22,13 +23,14 @@ class KOReaderSyncActivity final : public Activity {
  public:
   explicit KOReaderSyncActivity(GfxRenderer& renderer, MappedInputManager& mappedInput,
                                 const std::shared_ptr<Epub>& epub, const std::string& epubPath, int currentSpineIndex,
-                                int currentPage, int totalPagesInSpine)
+                                int currentPage, int totalPagesInSpine, std::string currentLandmark = "")
       : Activity("KOReaderSync", renderer, mappedInput),
         epub(epub),
         epubPath(epubPath),
         currentSpineIndex(currentSpineIndex),
         currentPage(currentPage),
         totalPagesInSpine(totalPagesInSpine),
+        currentLandmark(std::move(currentLandmark)),
         remoteProgress{},
         remotePosition{},
         localProgress{} {}
@@ -57,10 +59,14 @@ class KOReaderSyncActivity final : public Activity {
   int currentSpineIndex;
   int currentPage;
   int totalPagesInSpine;
+  std::string currentLandmark;
 
   State state = WIFI_SELECTION;
   std::string statusMessage;
   std::string documentHash;
+  // documentHash is computed by a background task started in onEnter, overlapping the WiFi connection
+  std::atomic<bool> hashStarted{false};
+  std::atomic<bool> hashReady{false};
 
   // Remote progress data
   bool hasRemoteProgress = false;
@@ -73,6 +79,9 @@ class KOReaderSyncActivity final : public Activity {
   // Selection in result screen (0=Apply, 1=Upload)
   int selectedOption = 0;
 
+  void startDocumentHash();
+  // Block until the background hash is done; false if it could not be computed
+  bool waitForDocumentHash();
   void onWifiSelectionComplete(bool success);
   void performSync();
   void performUpload();
@@ -1,10 +1,13 @@
 #include "ReaderActivity.h"
 
+#include <Arduino.h>
 #include <HalStorage.h>
 
 #include "CrossPointSettings.h"
 #include "Epub.h"
 #include "EpubReaderActivity.h"
+#include "Fb2.h"
+#include "Fb2ReaderActivity.h"
 #include "Txt.h"
 #include "TxtReaderActivity.h"
 #include "Xtc.h"
@@ -13,6 +16,22 @@
 #include "activities/util/FullScreenMessageActivity.h"
 #include "util/StringUtils.h"
 
+std::shared_ptr<Epub> ReaderActivity::warmEpub;
+bool ReaderActivity::warmEpubSkipsCss = false;
+
+void ReaderActivity::releaseWarmBook() {
+  if (warmEpub) {
+    LOG_DBG("READER", "Releasing warm book %s", warmEpub->getPath().c_str());
+    warmEpub.reset();
+  }
+}
+
+void ReaderActivity::trimWarmBook() {
+  if (warmEpub && ESP.getFreeHeap() < WARM_BOOK_MIN_FREE_HEAP) {
+    releaseWarmBook();
+  }
+}
+
 std::string ReaderActivity::extractFolderPath(const std::string& filePath) {
   const auto lastSlash = filePath.find_last_of('/');
   if (lastSlash == std::string::npos || lastSlash == 0) {
@@ -26,20 +45,36 @@ bool ReaderActivity::isXtcFile(const std::string& path) {
 }
 
 bool ReaderActivity::isTxtFile(const std::string& path) {
-  return StringUtils::checkFileExtension(path, ".txt") ||
-         StringUtils::checkFileExtension(path, ".md");  // Treat .md as txt files (until we have a markdown reader)
+  // Markdown is read by the TXT reader, which renders its markup (see TxtPageBuilder)
+  return StringUtils::checkFileExtension(path, ".txt") || StringUtils::checkFileExtension(path, ".md");
 }
 
+bool ReaderActivity::isFb2File(const std::string& path) { return StringUtils::checkFileExtension(path, ".fb2"); }
+
 bool ReaderActivity::isBmpFile(const std::string& path) { return StringUtils::checkFileExtension(path, ".bmp"); }
 
-std::unique_ptr<Epub> ReaderActivity::loadEpub(const std::string& path) {
+std::shared_ptr<Epub> ReaderActivity::loadEpub(const std::string& path) {
   if (!Storage.exists(path.c_str())) {
     LOG_ERR("READER", "File does not exist: %s", path.c_str());
     return nullptr;
   }
 
-  auto epub = std::unique_ptr<Epub>(new Epub(path, "/.crosspoint"));
-  if (epub->load(true, SETTINGS.embeddedStyle == 0)) {
+  const bool skipCss = SETTINGS.embeddedStyle == 0;
+  // The book's cache may have been cleared (or the book replaced, which clears it) since it was loaded
+  if (warmEpub && warmEpub->getPath() == path && warmEpubSkipsCss == skipCss &&
+      Storage.exists((warmEpub->getCachePath() + "/book.bin").c_str())) {
+    LOG_DBG("READER", "Reusing warm book %s", path.c_str());
+    return warmEpub;
+  }
+  // Free the previous book before loading the next one
+  releaseWarmBook();
+
+  auto epub = std::make_shared<Epub>(path, "/.crosspoint");
+  if (epub->load(true, skipCss)) {
+    if (ESP.getFreeHeap() >= WARM_BOOK_MIN_FREE_HEAP) {
+      warmEpub = epub;
+      warmEpubSkipsCss = skipCss;
+    }
     return epub;
   }
 
@@ -77,13 +112,28 @@ std::unique_ptr<Txt> ReaderActivity::loadTxt(const std::string& path) {
   return nullptr;
 }
 
+std::unique_ptr<Fb2> ReaderActivity::loadFb2(const std::string& path) {
+  if (!Storage.exists(path.c_str())) {
+    LOG_ERR("READER", "File does not exist: %s", path.c_str());
+    return nullptr;
+  }
+
+  auto fb2 = std::unique_ptr<Fb2>(new Fb2(path, "/.crosspoint"));
+  if (fb2->load()) {
+    return fb2;
+  }
+
+  LOG_ERR("READER", "Failed to load FB2");
+  return nullptr;
+}
+
 void ReaderActivity::goToLibrary(const std::string& fromBookPath) {
   // If coming from a book, start in that book's folder; otherwise start from root
   auto initialPath = fromBookPath.empty() ? "/" : extractFolderPath(fromBookPath);
   activityManager.goToMyLibrary(std::move(initialPath));
 }
 
-void ReaderActivity::onGoToEpubReader(std::unique_ptr<Epub> epub) {
+void ReaderActivity::onGoToEpubReader(std::shared_ptr<Epub> epub) {
   const auto epubPath = epub->getPath();
   currentBookPath = epubPath;
   activityManager.replaceActivity(std::make_unique<EpubReaderActivity>(renderer, mappedInput, std::move(epub)));
@@ -105,6 +155,12 @@ void ReaderActivity::onGoToTxtReader(std::unique_ptr<Txt> txt) {
   activityManager.replaceActivity(std::make_unique<TxtReaderActivity>(renderer, mappedInput, std::move(txt)));
 }
 
+void ReaderActivity::onGoToFb2Reader(std::unique_ptr<Fb2> fb2) {
+  const auto fb2Path = fb2->getPath();
+  currentBookPath = fb2Path;
+  activityManager.replaceActivity(std::make_unique<Fb2ReaderActivity>(renderer, mappedInput, std::move(fb2)));
+}
+
 void ReaderActivity::onEnter() {
   Activity::onEnter();
 
@@ -130,6 +186,13 @@ void ReaderActivity::onEnter() {
       return;
     }
     onGoToTxtReader(std::move(txt));
+  } else if (isFb2File(initialBookPath)) {
+    auto fb2 = loadFb2(initialBookPath);
+    if (!fb2) {
+      onGoBack();
+      return;
+    }
+    onGoToFb2Reader(std::move(fb2));
   } else {
     auto epub = loadEpub(initialBookPath);
     if (!epub) {
@@ -5,24 +5,33 @@
 #include "activities/home/MyLibraryActivity.h"
 
 class Epub;
+class Fb2;
 class Xtc;
 class Txt;
 
 class ReaderActivity final : public Activity {
   std::string initialBookPath;
   std::string currentBookPath;  // Track current book path for navigation
-  static std::unique_ptr<Epub> loadEpub(const std::string& path);
+  // Last EPUB opened, kept loaded after its reader closes so going Home and back (or through the library to the same
+  // book) doesn't read book.bin and the CSS cache again. Dropped when another book opens, when free heap runs below
+  // WARM_BOOK_MIN_FREE_HEAP, and before screens that need the heap (file transfer, OPDS) or sleep.
+  static std::shared_ptr<Epub> warmEpub;
+  static bool warmEpubSkipsCss;
+  static std::shared_ptr<Epub> loadEpub(const std::string& path);
   static std::unique_ptr<Xtc> loadXtc(const std::string& path);
   static std::unique_ptr<Txt> loadTxt(const std::string& path);
+  static std::unique_ptr<Fb2> loadFb2(const std::string& path);
   static bool isXtcFile(const std::string& path);
   static bool isTxtFile(const std::string& path);
+  static bool isFb2File(const std::string& path);
   static bool isBmpFile(const std::string& path);
 
   static std::string extractFolderPath(const std::string& filePath);
   void goToLibrary(const std::string& fromBookPath = "");
-  void onGoToEpubReader(std::unique_ptr<Epub> epub);
+  void onGoToEpubReader(std::shared_ptr<Epub> epub);
   void onGoToXtcReader(std::unique_ptr<Xtc> xtc);
   void onGoToTxtReader(std::unique_ptr<Txt> txt);
+  void onGoToFb2Reader(std::unique_ptr<Fb2> fb2);
   void onGoToBmpViewer(const std::string& path);
 
   void onGoBack();
@@ -32,4 +41,9 @@ class ReaderActivity final : public Activity {
       : Activity("Reader", renderer, mappedInput), initialBookPath(std::move(initialBookPath)) {}
   void onEnter() override;
   bool isReaderActivity() const override { return true; }
+
+  static constexpr uint32_t WARM_BOOK_MIN_FREE_HEAP = 80 * 1024;
+  static void releaseWarmBook();
+  // Release the warm book if free heap is below WARM_BOOK_MIN_FREE_HEAP
+  static void trimWarmBook();
 };
@@ -0,0 +1,106 @@
+#include "SectionPrefetcher.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+
+void SectionPrefetcher::start(const std::shared_ptr<Epub>& epub, const int primarySpineIndex,
+                              const int secondarySpineIndex, const LayoutParams& params) {
+  if (!epub || BACKGROUND_JOBS.isQueued(*this)) {
+    return;
+  }
+
+  if (ESP.getFreeHeap() < MIN_FREE_HEAP) {
+    LOG_DBG("SPF", "Skipping prefetch, low heap (%u bytes)", ESP.getFreeHeap());
+    return;
+  }
+
+  const int spineCount = epub->getSpineItemsCount();
+  targets[0] = (primarySpineIndex >= 0 && primarySpineIndex < spineCount) ? primarySpineIndex : -1;
+  targets[1] = (secondarySpineIndex >= 0 && secondarySpineIndex < spineCount) ? secondarySpineIndex : -1;
+  if (targets[0] < 0 && targets[1] < 0) {
+    return;
+  }
+
+  this->epub = epub;
+  this->params = params;
+  nextTarget = 0;
+  if (!BACKGROUND_JOBS.submit(*this)) {
+    LOG_ERR("SPF", "Failed to start prefetch job");
+    this->epub.reset();
+  }
+}
+
+void SectionPrefetcher::cancel() {
+  BACKGROUND_JOBS.cancel(*this);
+  // Destroying the section drops its unfinished build
+  section.reset();
+  activeSpineIndex = -1;
+  epub.reset();
+}
+
+void SectionPrefetcher::takeOver(const int spineIndex) {
+  BACKGROUND_JOBS.cancel(*this);
+  if (!section || activeSpineIndex != spineIndex) {
+    return;
+  }
+  Section::BuildStep result;
+  do {
+    result = section->stepSectionFile();
+  } while (result == Section::BuildStep::More);
+  endBuild(result == Section::BuildStep::Done);
+}
+
+bool SectionPrefetcher::step() {
+  // Page turns read the same card; let their reads go first
+  HalStorage::IoClassScope ioClass(HalStorage::IoClass::Prefetch);
+
+  if (section) {
+    const Section::BuildStep result = section->stepSectionFile();
+    if (result != Section::BuildStep::More) {
+      endBuild(result == Section::BuildStep::Done);
+    }
+    return true;
+  }
+
+  while (nextTarget < MAX_TARGETS) {
+    const int spineIndex = targets[nextTarget++];
+    if (spineIndex >= 0) {
+      startBuild(spineIndex);
+      return true;
+    }
+  }
+  epub.reset();
+  return false;
+}
+
+void SectionPrefetcher::startBuild(const int spineIndex) {
+  section.reset(new Section(epub, spineIndex, renderer));
+  if (section->loadSectionFile(params.fontId, params.lineCompression, params.extraParagraphSpacing,
+                               params.paragraphAlignment, params.viewportWidth, params.viewportHeight,
+                               params.hyphenationEnabled, params.embeddedStyle)) {
+    LOG_DBG("SPF", "Spine %d already cached", spineIndex);
+    section.reset();
+    return;
+  }
+
+  buildStart = millis();
+  activeSpineIndex = spineIndex;
+  // A section salvaged or cut from another layout is done right away, a parsed one continues in the next steps
+  const Section::BuildStep result = section->beginSectionFile(
+      params.fontId, params.lineCompression, params.extraParagraphSpacing, params.paragraphAlignment,
+      params.viewportWidth, params.viewportHeight, params.hyphenationEnabled, params.embeddedStyle);
+  if (result != Section::BuildStep::More) {
+    endBuild(result == Section::BuildStep::Done);
+  }
+}
+
+void SectionPrefetcher::endBuild(const bool built) {
+  if (built) {
+    LOG_DBG("SPF", "Prefetched spine %d (%d pages) in %lu ms", activeSpineIndex.load(), section->pageCount,
+            millis() - buildStart);
+  } else {
+    LOG_ERR("SPF", "Failed to prefetch spine %d", activeSpineIndex.load());
+  }
+  section.reset();
+  activeSpineIndex = -1;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <Epub.h>
+#include <Epub/Section.h>
+
+#include <atomic>
+#include <memory>
+
+#include "BackgroundJobs.h"
+
+class GfxRenderer;
+
+// Builds section cache files for neighbouring spine items as a background job, so that crossing a chapter boundary
+// only has to load an already paginated section instead of showing the indexing popup. Each step parses one buffer
+// of a chapter. The foreground must call takeOver()/cancel() before touching a section file itself.
+class SectionPrefetcher final : public BackgroundJob {
+ public:
+  struct LayoutParams {
+    int fontId = 0;
+    float lineCompression = 1.0f;
+    bool extraParagraphSpacing = false;
+    uint8_t paragraphAlignment = 0;
+    uint16_t viewportWidth = 0;
+    uint16_t viewportHeight = 0;
+    bool hyphenationEnabled = false;
+    bool embeddedStyle = false;
+  };
+
+  explicit SectionPrefetcher(GfxRenderer& renderer) : BackgroundJob("SectionPrefetch"), renderer(renderer) {}
+  ~SectionPrefetcher() override { cancel(); }
+
+  // Start building the given spine items (in order) in the background. Indices outside the spine are skipped and
+  // items that already have a matching cache file are left untouched. Does nothing if the job is already queued.
+  void start(const std::shared_ptr<Epub>& epub, int primarySpineIndex, int secondarySpineIndex,
+             const LayoutParams& params);
+
+  // Drop the job; a build in progress is abandoned and its partial output removed
+  void cancel();
+
+  // If the job is building the given spine index, finish that build on the calling task, so a foreground load can
+  // reuse its output. The rest of the job is dropped.
+  void takeOver(int spineIndex);
+
+  bool isBuilding(const int spineIndex) const { return activeSpineIndex == spineIndex; }
+
+ protected:
+  bool step() override;
+
+ private:
+  static constexpr int MAX_TARGETS = 2;
+  static constexpr uint32_t MIN_FREE_HEAP = 64 * 1024;
+
+  GfxRenderer& renderer;
+  // Owned by the worker while the job is queued
+  std::shared_ptr<Epub> epub;
+  LayoutParams params;
+  int targets[MAX_TARGETS] = {-1, -1};
+  int nextTarget = MAX_TARGETS;
+  std::unique_ptr<Section> section;
+  unsigned long buildStart = 0;
+  std::atomic<int> activeSpineIndex{-1};
+
+  void startBuild(int spineIndex);
+  void endBuild(bool built);
+};
@@ -1,29 +1,47 @@
 #include "TxtReaderActivity.h"
 
 #include <GfxRenderer.h>
+#include <HalPowerManager.h>
 #include <HalStorage.h>
 #include <I18n.h>
 #include <Serialization.h>
-#include <Utf8.h>
 
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "MappedInputManager.h"
+#include "ProgressJournal.h"
 #include "RecentBooksStore.h"
+#include "activities/RenderLock.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
+#include "util/LibraryIndex.h"
+#include "util/StringUtils.h"
 
 namespace {
 constexpr unsigned long goHomeMs = 1000;
-constexpr size_t CHUNK_SIZE = 8 * 1024;  // 8KB chunk for reading
 
 // Cache file magic and version
 constexpr uint32_t CACHE_MAGIC = 0x54585449;  // "TXTI"
-constexpr uint8_t CACHE_VERSION = 2;          // Increment when cache format changes
+constexpr uint8_t CACHE_VERSION = 7;          // Increment when cache format changes
+
+// Background indexing
+constexpr size_t INDEX_CHECKPOINT_PAGES = 100;  // Write the partial index every this many new pages
+
+// Holds a FreeRTOS mutex for the duration of a scope
+class MutexLock {
+  SemaphoreHandle_t mutex;
+
+ public:
+  explicit MutexLock(SemaphoreHandle_t mutex) : mutex(mutex) { xSemaphoreTake(mutex, portMAX_DELAY); }
+  ~MutexLock() { xSemaphoreGive(mutex); }
+  MutexLock(const MutexLock&) = delete;
+  MutexLock& operator=(const MutexLock&) = delete;
+};
 }  // namespace
 
 void TxtReaderActivity::onEnter() {
   Activity::onEnter();
+  batteryRevision = powerManager.getBatteryRevision();
 
   if (!txt) {
     return;
@@ -48,6 +66,12 @@ void TxtReaderActivity::onEnter() {
   }
 
   txt->setupCacheDir();
+  indexMutex = xSemaphoreCreateMutex();
+
+  // Text read window for the layout task, kept for the whole session
+  if (!indexWindow.allocate(txt->getContentPath(), TxtPageBuilder::READ_CHUNK_SIZE)) {
+    LOG_ERR("TRS", "Failed to set up read window");
+  }
 
   // Save current txt as last opened file and add to recent books
   auto filePath = txt->getPath();
@@ -66,14 +90,41 @@ void TxtReaderActivity::onExit() {
   // Reset orientation back to portrait for the rest of the UI
   renderer.setOrientation(GfxRenderer::Orientation::Portrait);
 
-  pageOffsets.clear();
-  currentPageLines.clear();
+  // Keep what was indexed this session so the next open continues from there
+  stopIndexing();
+  if (initialized && static_cast<size_t>(totalPages) > checkpointPages) {
+    savePageIndexCache();
+  }
+  if (initialized) {
+    LibraryIndex::setProgress(txt->getPath(), static_cast<int>(getBookProgress() + 0.5f));
+  }
+  if (indexMutex) {
+    vSemaphoreDelete(indexMutex);
+    indexMutex = nullptr;
+  }
+  builder.reset();
+  indexWindow.release();
+  if (pagesFile) {
+    pagesFile.close();
+  }
+
+  pageTable.clear();
+  pageTable.shrink_to_fit();
+  renderer.clearFontCache();
+  PROGRESS_JOURNAL.flush();
   APP_STATE.readerActivityLoadCount = 0;
   APP_STATE.saveToFile();
   txt.reset();
 }
 
 void TxtReaderActivity::loop() {
+  // A new battery reading goes into the status bar of the page on screen, without drawing the page again
+  if (batteryRevision != powerManager.getBatteryRevision() && initialized && !RenderLock::peek()) {
+    batteryRevision = powerManager.getBatteryRevision();
+    RenderLock lock(*this);
+    GUI.refreshStatusBarBattery(renderer);
+  }
+
   // Long press BACK (1s+) goes to file selection
   if (mappedInput.isPressed(MappedInputManager::Button::Back) && mappedInput.getHeldTime() >= goHomeMs) {
     activityManager.goToMyLibrary(txt ? txt->getPath() : "");
@@ -121,7 +172,10 @@ void TxtReaderActivity::initializeReader() {
   // Store current settings for cache validation
   cachedFontId = SETTINGS.getReaderFontId();
   cachedScreenMargin = SETTINGS.screenMargin;
+  cachedLineCompression = SETTINGS.getReaderLineCompression();
+  cachedExtraParagraphSpacing = SETTINGS.extraParagraphSpacing;
   cachedParagraphAlignment = SETTINGS.paragraphAlignment;
+  cachedHyphenationEnabled = SETTINGS.hyphenationEnabled;
 
   // Calculate viewport dimensions
   renderer.getOrientedViewableTRBL(&cachedOrientedMarginTop, &cachedOrientedMarginRight, &cachedOrientedMarginBottom,
@@ -133,191 +187,133 @@ void TxtReaderActivity::initializeReader() {
       std::max(cachedScreenMargin, static_cast<uint8_t>(UITheme::getInstance().getStatusBarHeight()));
 
   viewportWidth = renderer.getScreenWidth() - cachedOrientedMarginLeft - cachedOrientedMarginRight;
-  const int viewportHeight = renderer.getScreenHeight() - cachedOrientedMarginTop - cachedOrientedMarginBottom;
-  const int lineHeight = renderer.getLineHeight(cachedFontId);
-
-  linesPerPage = viewportHeight / lineHeight;
-  if (linesPerPage < 1) linesPerPage = 1;
-
-  LOG_DBG("TRS", "Viewport: %dx%d, lines per page: %d", viewportWidth, viewportHeight, linesPerPage);
-
-  // Try to load cached page index first
-  if (!loadPageIndexCache()) {
-    // Cache not found, build page index
-    buildPageIndex();
-    // Save to cache for next time
-    savePageIndexCache();
+  viewportHeight = renderer.getScreenHeight() - cachedOrientedMarginTop - cachedOrientedMarginBottom;
+  LOG_DBG("TRS", "Viewport: %dx%d", viewportWidth, viewportHeight);
+
+  // Pages known from the last session, if any
+  const std::string pagesPath = txt->getCachePath() + "/pages.bin";
+  pagesFile = Storage.open(pagesPath.c_str(), O_RDWR | O_CREAT);
+  if (!pagesFile) {
+    LOG_ERR("TRS", "Failed to open %s", pagesPath.c_str());
+  }
+  if (!pagesFile || !loadPageIndexCache()) {
+    pageTable.clear();
+    pagesEnd = 0;
+    resumeStart = TxtPageStart();
+    totalPages = 0;
+    indexedBytes = 0;
+    indexComplete = !pagesFile;
+    checkpointPages = 0;
+  }
+
+  if (!indexComplete) {
+    builder.reset(new TxtPageBuilder(renderer, indexWindow, txt->getFileSize(), cachedFontId, cachedLineCompression,
+                                     cachedExtraParagraphSpacing, cachedParagraphAlignment, viewportWidth,
+                                     viewportHeight, cachedHyphenationEnabled,
+                                     StringUtils::checkFileExtension(txt->getPath(), ".md")));
+    builder->begin(resumeStart, [this](std::unique_ptr<Page> page, const TxtPageStart& nextStart) {
+      onPageBuilt(std::move(page), nextStart);
+    });
   }
 
   // Load saved progress
   loadProgress();
 
-  initialized = true;
-}
-
-void TxtReaderActivity::buildPageIndex() {
-  pageOffsets.clear();
-  pageOffsets.push_back(0);  // First page starts at offset 0
-
-  size_t offset = 0;
-  const size_t fileSize = txt->getFileSize();
-
-  LOG_DBG("TRS", "Building page index for %zu bytes...", fileSize);
-
-  GUI.drawPopup(renderer, tr(STR_INDEXING));
-
-  while (offset < fileSize) {
-    std::vector<std::string> tempLines;
-    size_t nextOffset = offset;
-
-    if (!loadPageAtOffset(offset, tempLines, nextOffset)) {
-      break;
-    }
-
-    if (nextOffset <= offset) {
-      // No progress made, avoid infinite loop
-      break;
-    }
-
-    offset = nextOffset;
-    if (offset < fileSize) {
-      pageOffsets.push_back(offset);
-    }
-
-    // Yield to other tasks periodically
-    if (pageOffsets.size() % 20 == 0) {
-      vTaskDelay(1);
+  // Only the first open of a book, or a saved page past the checkpoint, has to wait for layout
+  if (!indexComplete && currentPage >= totalPages) {
+    GUI.drawPopup(renderer, tr(STR_INDEXING));
+    while (currentPage >= totalPages && indexNextStep()) {
     }
   }
+  if (currentPage >= totalPages) {
+    currentPage = std::max(0, totalPages - 1);
+  }
 
-  totalPages = pageOffsets.size();
-  LOG_DBG("TRS", "Built page index: %d pages", totalPages);
+  initialized = true;
+  startIndexing();
 }
 
-bool TxtReaderActivity::loadPageAtOffset(size_t offset, std::vector<std::string>& outLines, size_t& nextOffset) {
-  outLines.clear();
-  const size_t fileSize = txt->getFileSize();
-
-  if (offset >= fileSize) {
-    return false;
-  }
-
-  // Read a chunk from file
-  size_t chunkSize = std::min(CHUNK_SIZE, fileSize - offset);
-  auto* buffer = static_cast<uint8_t*>(malloc(chunkSize + 1));
-  if (!buffer) {
-    LOG_ERR("TRS", "Failed to allocate %zu bytes", chunkSize);
+bool TxtReaderActivity::indexNextStep() {
+  if (indexComplete || !indexWindow.isAllocated()) {
     return false;
   }
 
-  if (!txt->readContent(buffer, offset, chunkSize)) {
-    free(buffer);
+  if (!builder->step()) {
+    indexComplete = true;
+    LOG_DBG("TRS", "Page layout complete: %d pages", static_cast<int>(totalPages));
     return false;
   }
-  buffer[chunkSize] = '\0';
-
-  // Parse lines from buffer
-  size_t pos = 0;
-
-  while (pos < chunkSize && static_cast<int>(outLines.size()) < linesPerPage) {
-    // Find end of line
-    size_t lineEnd = pos;
-    while (lineEnd < chunkSize && buffer[lineEnd] != '\n') {
-      lineEnd++;
-    }
-
-    // Check if we have a complete line
-    bool lineComplete = (lineEnd < chunkSize) || (offset + lineEnd >= fileSize);
+  return true;
+}
 
-    if (!lineComplete && static_cast<int>(outLines.size()) > 0) {
-      // Incomplete line and we already have some lines, stop here
-      break;
+void TxtReaderActivity::onPageBuilt(std::unique_ptr<Page> page, const TxtPageStart& nextStart) {
+  {
+    MutexLock lock(indexMutex);
+    if (!pagesFile.seek(pagesEnd) || !page->serialize(pagesFile)) {
+      // Stop here, the pages written so far stay readable
+      LOG_ERR("TRS", "Failed to write page %d", static_cast<int>(totalPages));
+      indexComplete = true;
+      return;
     }
+    pageTable.push_back({pagesEnd, resumeStart});
+    pagesEnd = pagesFile.position();
+    totalPages = pageTable.size();
+  }
+  resumeStart = nextStart;
+  indexedBytes = nextStart.textOffset;
+}
 
-    // Calculate the actual length of line content in the buffer (excluding newline)
-    size_t lineContentLen = lineEnd - pos;
-
-    // Check for carriage return
-    bool hasCR = (lineContentLen > 0 && buffer[pos + lineContentLen - 1] == '\r');
-    size_t displayLen = hasCR ? lineContentLen - 1 : lineContentLen;
-
-    // Extract line content for display (without CR/LF)
-    std::string line(reinterpret_cast<char*>(buffer + pos), displayLen);
-
-    // Track position within this source line (in bytes from pos)
-    size_t lineBytePos = 0;
-
-    // Word wrap if needed
-    while (!line.empty() && static_cast<int>(outLines.size()) < linesPerPage) {
-      int lineWidth = renderer.getTextWidth(cachedFontId, line.c_str());
-
-      if (lineWidth <= viewportWidth) {
-        outLines.push_back(line);
-        lineBytePos = displayLen;  // Consumed entire display content
-        line.clear();
-        break;
-      }
-
-      // Find break point
-      size_t breakPos = line.length();
-      while (breakPos > 0 && renderer.getTextWidth(cachedFontId, line.substr(0, breakPos).c_str()) > viewportWidth) {
-        // Try to break at space
-        size_t spacePos = line.rfind(' ', breakPos - 1);
-        if (spacePos != std::string::npos && spacePos > 0) {
-          breakPos = spacePos;
-        } else {
-          // Break at character boundary for UTF-8
-          breakPos--;
-          // Make sure we don't break in the middle of a UTF-8 sequence
-          while (breakPos > 0 && (line[breakPos] & 0xC0) == 0x80) {
-            breakPos--;
-          }
-        }
-      }
-
-      if (breakPos == 0) {
-        breakPos = 1;
-      }
-
-      outLines.push_back(line.substr(0, breakPos));
+void TxtReaderActivity::startIndexing() {
+  if (indexComplete || !indexWindow.isAllocated()) {
+    return;
+  }
+  LOG_DBG("TRS", "Laying out from page %d (offset %zu of %zu)", static_cast<int>(totalPages),
+          static_cast<size_t>(indexedBytes), txt->getFileSize());
+  BACKGROUND_JOBS.submit(indexJob);
+}
 
-      // Skip space at break point
-      size_t skipChars = breakPos;
-      if (breakPos < line.length() && line[breakPos] == ' ') {
-        skipChars++;
-      }
-      lineBytePos += skipChars;
-      line = line.substr(skipChars);
-    }
+void TxtReaderActivity::stopIndexing() { BACKGROUND_JOBS.cancel(indexJob); }
 
-    // Determine how much of the source buffer we consumed
-    if (line.empty()) {
-      // Fully consumed this source line, move past the newline
-      pos = lineEnd + 1;
-    } else {
-      // Partially consumed - page is full mid-line
-      // Move pos to where we stopped in the line (NOT past the line)
-      pos = pos + lineBytePos;
-      break;
+bool TxtReaderActivity::runIndexStep() {
+  if (!indexNextStep()) {
+    if (indexComplete) {
+      savePageIndexCache();
     }
+    return false;
   }
-
-  // Ensure we make progress even if calculations go wrong
-  if (pos == 0 && !outLines.empty()) {
-    // Fallback: at minimum, consume something to avoid infinite loop
-    pos = 1;
+  if (static_cast<size_t>(totalPages) >= checkpointPages + INDEX_CHECKPOINT_PAGES) {
+    savePageIndexCache();
   }
+  return true;
+}
 
-  nextOffset = offset + pos;
+bool TxtReaderActivity::IndexJob::step() {
+  const bool more = reader.runIndexStep();
+  setProgress(reader.indexedBytes, reader.txt->getFileSize());
+  return more;
+}
 
-  // Make sure we don't go past the file
-  if (nextOffset > fileSize) {
-    nextOffset = fileSize;
+std::unique_ptr<Page> TxtReaderActivity::loadPage(const int page) {
+  MutexLock lock(indexMutex);
+  if (page < 0 || page >= static_cast<int>(pageTable.size()) || !pagesFile.seek(pageTable[page].dataOffset)) {
+    return nullptr;
   }
+  return Page::deserialize(pagesFile);
+}
 
-  free(buffer);
+uint32_t TxtReaderActivity::getPageTextOffset(const int page) const {
+  MutexLock lock(indexMutex);
+  return page >= 0 && page < static_cast<int>(pageTable.size()) ? pageTable[page].start.textOffset : 0;
+}
 
-  return !outLines.empty();
+int TxtReaderActivity::getEstimatedPageCount() const {
+  const size_t indexed = indexedBytes;
+  if (indexComplete || indexed == 0) {
+    return totalPages;
+  }
+  // Assume the rest of the file paginates like the part laid out so far
+  const auto estimate = static_cast<int>(static_cast<uint64_t>(totalPages) * txt->getFileSize() / indexed);
+  return std::max(estimate, static_cast<int>(totalPages));
 }
 
 void TxtReaderActivity::render(RenderLock&&) {
@@ -330,7 +326,14 @@ void TxtReaderActivity::render(RenderLock&&) {
     initializeReader();
   }
 
-  if (pageOffsets.empty()) {
+  if (!indexWindow.isAllocated()) {
+    renderer.clearScreen();
+    renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_MEMORY_ERROR), true, EpdFontFamily::BOLD);
+    renderer.displayBuffer();
+    return;
+  }
+
+  if (totalPages == 0) {
     renderer.clearScreen();
     renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_EMPTY_FILE), true, EpdFontFamily::BOLD);
     renderer.displayBuffer();
@@ -341,85 +344,57 @@ void TxtReaderActivity::render(RenderLock&&) {
   if (currentPage < 0) currentPage = 0;
   if (currentPage >= totalPages) currentPage = totalPages - 1;
 
-  // Load current page content
-  size_t offset = pageOffsets[currentPage];
-  size_t nextOffset;
-  currentPageLines.clear();
-  loadPageAtOffset(offset, currentPageLines, nextOffset);
+  const auto page = loadPage(currentPage);
+  if (!page) {
+    LOG_ERR("TRS", "Failed to load page %d", currentPage);
+    renderer.clearScreen();
+    renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_MEMORY_ERROR), true, EpdFontFamily::BOLD);
+    renderer.displayBuffer();
+    return;
+  }
 
   renderer.clearScreen();
-  renderPage();
-  renderer.clearFontCache();
+  renderPage(*page);
 
   // Save progress
   saveProgress();
 }
 
-void TxtReaderActivity::renderPage() {
-  const int lineHeight = renderer.getLineHeight(cachedFontId);
-  const int contentWidth = viewportWidth;
-
-  // Render text lines with alignment
-  auto renderLines = [&]() {
-    int y = cachedOrientedMarginTop;
-    for (const auto& line : currentPageLines) {
-      if (!line.empty()) {
-        int x = cachedOrientedMarginLeft;
-
-        // Apply text alignment
-        switch (cachedParagraphAlignment) {
-          case CrossPointSettings::LEFT_ALIGN:
-          default:
-            // x already set to left margin
-            break;
-          case CrossPointSettings::CENTER_ALIGN: {
-            int textWidth = renderer.getTextWidth(cachedFontId, line.c_str());
-            x = cachedOrientedMarginLeft + (contentWidth - textWidth) / 2;
-            break;
-          }
-          case CrossPointSettings::RIGHT_ALIGN: {
-            int textWidth = renderer.getTextWidth(cachedFontId, line.c_str());
-            x = cachedOrientedMarginLeft + contentWidth - textWidth;
-            break;
-          }
-          case CrossPointSettings::JUSTIFIED:
-            // For plain text, justified is treated as left-aligned
-            // (true justification would require word spacing adjustments)
-            break;
-        }
-
-        renderer.drawText(cachedFontId, x, y, line.c_str());
-      }
-      y += lineHeight;
-    }
-  };
+void TxtReaderActivity::renderPage(const Page& page) {
+  // Inflate the page's glyph groups in one go, the grayscale passes below reuse them
+  page.prefetchGlyphs(renderer, cachedFontId);
 
   // First pass: BW rendering
-  renderLines();
+  page.render(renderer, cachedFontId, cachedOrientedMarginLeft, cachedOrientedMarginTop);
   renderStatusBar();
 
   if (pagesUntilFullRefresh <= 1) {
     renderer.displayBuffer(HalDisplay::HALF_REFRESH);
     pagesUntilFullRefresh = SETTINGS.getRefreshFrequency();
   } else {
-    renderer.displayBuffer();
+    renderer.displayBuffer(HalDisplay::FAST_REFRESH);
     pagesUntilFullRefresh--;
   }
 
-  // Grayscale rendering pass (for anti-aliased fonts)
-  if (SETTINGS.textAntiAliasing) {
+  // Grayscale rendering pass (for anti-aliased fonts), skipped when the page has nothing it would draw
+  if (SETTINGS.textAntiAliasing && page.hasGrayContent()) {
     // Save BW buffer for restoration after grayscale pass
     renderer.storeBwBuffer();
 
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
-    renderLines();
-    renderer.copyGrayscaleLsbBuffers();
-
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
-    renderLines();
-    renderer.copyGrayscaleMsbBuffers();
+    if (renderer.beginGrayscalePlanes()) {
+      page.render(renderer, cachedFontId, cachedOrientedMarginLeft, cachedOrientedMarginTop);
+      renderer.endGrayscalePlanes();
+    } else {
+      renderer.clearScreen(0x00);
+      renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
+      page.render(renderer, cachedFontId, cachedOrientedMarginLeft, cachedOrientedMarginTop);
+      renderer.copyGrayscaleLsbBuffers();
+
+      renderer.clearScreen(0x00);
+      renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
+      page.render(renderer, cachedFontId, cachedOrientedMarginLeft, cachedOrientedMarginTop);
+      renderer.copyGrayscaleMsbBuffers();
+    }
 
     renderer.displayGrayBuffer();
     renderer.setRenderMode(GfxRenderer::BW);
@@ -429,58 +404,62 @@ void TxtReaderActivity::renderPage() {
   }
 }
 
+float TxtReaderActivity::getBookProgress() const {
+  // Until the index is complete the page count is an estimate, so progress comes from the position in the file
+  if (indexComplete) {
+    return totalPages > 0 ? (currentPage + 1) * 100.0f / totalPages : 0;
+  }
+  return getPageTextOffset(currentPage) * 100.0f / txt->getFileSize();
+}
+
 void TxtReaderActivity::renderStatusBar() const {
-  const float progress = totalPages > 0 ? (currentPage + 1) * 100.0f / totalPages : 0;
+  const int pageCount = getEstimatedPageCount();
+  const float progress = getBookProgress();
   std::string title;
   if (SETTINGS.statusBarTitle != CrossPointSettings::STATUS_BAR_TITLE::HIDE_TITLE) {
     title = txt->getTitle();
   }
-  GUI.drawStatusBar(renderer, progress, currentPage + 1, totalPages, title);
+  GUI.drawStatusBar(renderer, progress, currentPage + 1, pageCount, title);
 }
 
 void TxtReaderActivity::saveProgress() const {
-  FsFile f;
-  if (Storage.openFileForWrite("TRS", txt->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[4];
-    data[0] = currentPage & 0xFF;
-    data[1] = (currentPage >> 8) & 0xFF;
-    data[2] = 0;
-    data[3] = 0;
-    f.write(data, 4);
-    f.close();
-  }
+  uint8_t data[4];
+  data[0] = currentPage & 0xFF;
+  data[1] = (currentPage >> 8) & 0xFF;
+  data[2] = 0;
+  data[3] = 0;
+  PROGRESS_JOURNAL.save(txt->getCachePath() + "/progress.bin", data, sizeof(data));
 }
 
 void TxtReaderActivity::loadProgress() {
-  FsFile f;
-  if (Storage.openFileForRead("TRS", txt->getCachePath() + "/progress.bin", f)) {
+  {
     uint8_t data[4];
-    if (f.read(data, 4) == 4) {
+    if (PROGRESS_JOURNAL.load(txt->getCachePath() + "/progress.bin", data, sizeof(data)) == 4) {
       currentPage = data[0] + (data[1] << 8);
-      if (currentPage >= totalPages) {
+      // Pages past the index are clamped once it has been extended as far as it will go
+      if (indexComplete && currentPage >= totalPages) {
         currentPage = totalPages - 1;
       }
       if (currentPage < 0) {
         currentPage = 0;
       }
-      LOG_DBG("TRS", "Loaded progress: page %d/%d", currentPage, totalPages);
+      LOG_DBG("TRS", "Loaded progress: page %d/%d", currentPage, static_cast<int>(totalPages));
     }
-    f.close();
   }
 }
 
 bool TxtReaderActivity::loadPageIndexCache() {
-  // Cache file format (using serialization module):
+  // Cache file format (using serialization module), describing the page records in pages.bin:
   // - uint32_t: magic "TXTI"
   // - uint8_t: cache version
   // - uint32_t: file size (to validate cache)
-  // - int32_t: viewport width
-  // - int32_t: lines per page
-  // - int32_t: font ID (to invalidate cache on font change)
-  // - int32_t: screen margin (to invalidate cache on margin change)
-  // - uint8_t: paragraph alignment (to invalidate cache on alignment change)
+  // - int32_t: font ID, float: line compression, uint8_t: extra paragraph spacing, uint8_t: paragraph alignment,
+  //   uint8_t: hyphenation, uint16_t: viewport width, uint16_t: viewport height (the layout settings)
+  // - uint8_t: index complete (0 for a checkpoint of a partial index, layout continues from the resume start)
+  // - uint32_t: end of the page records in pages.bin
+  // - 3 * uint32_t: resume start (paragraph offset, line in paragraph, text offset)
   // - uint32_t: total pages count
-  // - N * uint32_t: page offsets
+  // - N * (uint32_t page record offset + 3 * uint32_t page start)
 
   std::string cachePath = txt->getCachePath() + "/index.bin";
   FsFile f;
@@ -514,66 +493,81 @@ bool TxtReaderActivity::loadPageIndexCache() {
     return false;
   }
 
-  int32_t cachedWidth;
-  serialization::readPod(f, cachedWidth);
-  if (cachedWidth != viewportWidth) {
-    LOG_DBG("TRS", "Cache viewport width mismatch, rebuilding");
-    f.close();
-    return false;
-  }
-
-  int32_t cachedLines;
-  serialization::readPod(f, cachedLines);
-  if (cachedLines != linesPerPage) {
-    LOG_DBG("TRS", "Cache lines per page mismatch, rebuilding");
-    f.close();
-    return false;
-  }
-
   int32_t fontId;
-  serialization::readPod(f, fontId);
-  if (fontId != cachedFontId) {
-    LOG_DBG("TRS", "Cache font ID mismatch (%d != %d), rebuilding", fontId, cachedFontId);
-    f.close();
-    return false;
-  }
-
-  int32_t margin;
-  serialization::readPod(f, margin);
-  if (margin != cachedScreenMargin) {
-    LOG_DBG("TRS", "Cache screen margin mismatch, rebuilding");
-    f.close();
-    return false;
-  }
-
+  float lineCompression;
+  uint8_t extraParagraphSpacing;
   uint8_t alignment;
+  uint8_t hyphenation;
+  uint16_t width;
+  uint16_t height;
+  serialization::readPod(f, fontId);
+  serialization::readPod(f, lineCompression);
+  serialization::readPod(f, extraParagraphSpacing);
   serialization::readPod(f, alignment);
-  if (alignment != cachedParagraphAlignment) {
-    LOG_DBG("TRS", "Cache paragraph alignment mismatch, rebuilding");
+  serialization::readPod(f, hyphenation);
+  serialization::readPod(f, width);
+  serialization::readPod(f, height);
+  if (fontId != cachedFontId || lineCompression != cachedLineCompression ||
+      (extraParagraphSpacing != 0) != cachedExtraParagraphSpacing || alignment != cachedParagraphAlignment ||
+      (hyphenation != 0) != cachedHyphenationEnabled || width != viewportWidth || height != viewportHeight) {
+    LOG_DBG("TRS", "Cache layout settings mismatch, rebuilding");
     f.close();
     return false;
   }
 
+  uint8_t complete;
+  uint32_t dataEnd;
+  TxtPageStart resume;
   uint32_t numPages;
+  serialization::readPod(f, complete);
+  serialization::readPod(f, dataEnd);
+  serialization::readPod(f, resume.paragraphOffset);
+  serialization::readPod(f, resume.lineInParagraph);
+  serialization::readPod(f, resume.textOffset);
   serialization::readPod(f, numPages);
+  if (numPages == 0 || dataEnd > pagesFile.size()) {
+    LOG_DBG("TRS", "Cache has no pages or they are missing, rebuilding");
+    f.close();
+    return false;
+  }
 
-  // Read page offsets
-  pageOffsets.clear();
-  pageOffsets.reserve(numPages);
-
+  // Read page table
+  pageTable.clear();
+  pageTable.reserve(numPages);
   for (uint32_t i = 0; i < numPages; i++) {
-    uint32_t offset;
-    serialization::readPod(f, offset);
-    pageOffsets.push_back(offset);
+    PageEntry entry;
+    serialization::readPod(f, entry.dataOffset);
+    serialization::readPod(f, entry.start.paragraphOffset);
+    serialization::readPod(f, entry.start.lineInParagraph);
+    serialization::readPod(f, entry.start.textOffset);
+    if (entry.dataOffset >= dataEnd) {
+      LOG_DBG("TRS", "Cache page %u out of range, rebuilding", static_cast<unsigned>(i));
+      f.close();
+      pageTable.clear();
+      return false;
+    }
+    pageTable.push_back(entry);
   }
 
   f.close();
-  totalPages = pageOffsets.size();
-  LOG_DBG("TRS", "Loaded page index cache: %d pages", totalPages);
+  pagesEnd = dataEnd;
+  resumeStart = resume;
+  totalPages = pageTable.size();
+  indexedBytes = resume.textOffset;
+  indexComplete = complete != 0;
+  checkpointPages = pageTable.size();
+  LOG_DBG("TRS", "Loaded page index cache: %d pages%s", static_cast<int>(totalPages),
+          indexComplete ? "" : " (partial)");
   return true;
 }
 
-void TxtReaderActivity::savePageIndexCache() const {
+void TxtReaderActivity::savePageIndexCache() {
+  // The page records must be on the card before an index refers to them
+  {
+    MutexLock lock(indexMutex);
+    pagesFile.flush();
+  }
+
   std::string cachePath = txt->getCachePath() + "/index.bin";
   FsFile f;
   if (!Storage.openFileForWrite("TRS", cachePath, f)) {
@@ -585,18 +579,34 @@ void TxtReaderActivity::savePageIndexCache() const {
   serialization::writePod(f, CACHE_MAGIC);
   serialization::writePod(f, CACHE_VERSION);
   serialization::writePod(f, static_cast<uint32_t>(txt->getFileSize()));
-  serialization::writePod(f, static_cast<int32_t>(viewportWidth));
-  serialization::writePod(f, static_cast<int32_t>(linesPerPage));
   serialization::writePod(f, static_cast<int32_t>(cachedFontId));
-  serialization::writePod(f, static_cast<int32_t>(cachedScreenMargin));
+  serialization::writePod(f, cachedLineCompression);
+  serialization::writePod(f, static_cast<uint8_t>(cachedExtraParagraphSpacing ? 1 : 0));
   serialization::writePod(f, cachedParagraphAlignment);
-  serialization::writePod(f, static_cast<uint32_t>(pageOffsets.size()));
-
-  // Write page offsets
-  for (size_t offset : pageOffsets) {
-    serialization::writePod(f, static_cast<uint32_t>(offset));
+  serialization::writePod(f, static_cast<uint8_t>(cachedHyphenationEnabled ? 1 : 0));
+  serialization::writePod(f, viewportWidth);
+  serialization::writePod(f, viewportHeight);
+  serialization::writePod(f, static_cast<uint8_t>(indexComplete ? 1 : 0));
+
+  // Called from the layout task (the only one that appends) or once it has stopped, so no lock is needed
+  serialization::writePod(f, pagesEnd);
+  serialization::writePod(f, resumeStart.paragraphOffset);
+  serialization::writePod(f, resumeStart.lineInParagraph);
+  serialization::writePod(f, resumeStart.textOffset);
+  const size_t numPages = pageTable.size();
+  serialization::writePod(f, static_cast<uint32_t>(numPages));
+
+  // Write page table
+  for (size_t i = 0; i < numPages; i++) {
+    const PageEntry& entry = pageTable[i];
+    serialization::writePod(f, entry.dataOffset);
+    serialization::writePod(f, entry.start.paragraphOffset);
+    serialization::writePod(f, entry.start.lineInParagraph);
+    serialization::writePod(f, entry.start.textOffset);
   }
 
   f.close();
-  LOG_DBG("TRS", "Saved page index cache: %d pages", totalPages);
+  checkpointPages = numPages;
+  LOG_DBG("TRS", "Saved page index cache: %u pages%s", static_cast<unsigned>(numPages),
+          indexComplete ? "" : " (partial)");
 }
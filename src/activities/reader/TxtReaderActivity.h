@@ -1,43 +1,91 @@
 #pragma once
 
 #include <Txt.h>
+#include <TxtPageBuilder.h>
+#include <TxtReadWindow.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
+#include <atomic>
+#include <memory>
 #include <vector>
 
+#include "BackgroundJobs.h"
 #include "CrossPointSettings.h"
 #include "activities/Activity.h"
 
 class TxtReaderActivity final : public Activity {
+  // A laid out page: its record in the pages file and where it starts in the text
+  struct PageEntry {
+    uint32_t dataOffset;
+    TxtPageStart start;
+  };
+
   std::unique_ptr<Txt> txt;
 
   int currentPage = 0;
-  int totalPages = 1;
+  std::atomic<int> totalPages{0};  // Pages laid out so far
   int pagesUntilFullRefresh = 0;
-
-  // Streaming text reader - stores file offsets for each page
-  std::vector<size_t> pageOffsets;  // File offset for start of each page
-  std::vector<std::string> currentPageLines;
-  int linesPerPage = 0;
-  int viewportWidth = 0;
+  // HalPowerManager::getBatteryRevision() as shown in the status bar
+  uint32_t batteryRevision = 0;
   bool initialized = false;
 
+  // Pages are laid out by TxtPageBuilder into pages.bin, in the same Page format as EPUB sections. Pages known from
+  // the last session are shown right away and the rest is laid out by a background task while reading. Only the
+  // layout task appends to pageTable and pagesFile; other tasks use them under indexMutex.
+  SemaphoreHandle_t indexMutex = nullptr;
+  std::vector<PageEntry> pageTable;
+  FsFile pagesFile;
+  uint32_t pagesEnd = 0;     // End of the last page record
+  TxtPageStart resumeStart;  // Start of the page being laid out
+  TxtReadWindow indexWindow;
+  std::unique_ptr<TxtPageBuilder> builder;
+  std::atomic<bool> indexComplete{false};
+  std::atomic<size_t> indexedBytes{0};  // Start of the page being laid out
+  size_t checkpointPages = 0;           // Pages in the index file
+
+  // Lays out the rest of the book on the background worker, one page per step
+  class IndexJob final : public BackgroundJob {
+    TxtReaderActivity& reader;
+
+   public:
+    explicit IndexJob(TxtReaderActivity& reader) : BackgroundJob("TxtIndex"), reader(reader) {}
+
+   protected:
+    bool step() override;
+  };
+  IndexJob indexJob{*this};
+
   // Cached settings for cache validation (different fonts/margins require re-indexing)
   int cachedFontId = 0;
   uint8_t cachedScreenMargin = 0;
+  float cachedLineCompression = 1.0f;
+  bool cachedExtraParagraphSpacing = false;
   uint8_t cachedParagraphAlignment = CrossPointSettings::LEFT_ALIGN;
+  bool cachedHyphenationEnabled = false;
+  uint16_t viewportWidth = 0;
+  uint16_t viewportHeight = 0;
   int cachedOrientedMarginTop = 0;
   int cachedOrientedMarginRight = 0;
   int cachedOrientedMarginBottom = 0;
   int cachedOrientedMarginLeft = 0;
 
-  void renderPage();
+  void renderPage(const Page& page);
   void renderStatusBar() const;
 
   void initializeReader();
-  bool loadPageAtOffset(size_t offset, std::vector<std::string>& outLines, size_t& nextOffset);
-  void buildPageIndex();
+  bool indexNextStep();
+  void onPageBuilt(std::unique_ptr<Page> page, const TxtPageStart& nextStart);
+  void startIndexing();
+  void stopIndexing();
+  bool runIndexStep();
+  std::unique_ptr<Page> loadPage(int page);
+  uint32_t getPageTextOffset(int page) const;
+  int getEstimatedPageCount() const;
+  // Percent of the book read
+  float getBookProgress() const;
   bool loadPageIndexCache();
-  void savePageIndexCache() const;
+  void savePageIndexCache();
   void saveProgress() const;
   void loadProgress();
 
@@ -0,0 +1,160 @@
+#include "XtcPageBlitter.h"
+
+#include <HalDisplay.h>
+
+namespace {
+constexpr int PANEL_WIDTH = HalDisplay::DISPLAY_WIDTH;
+constexpr int PANEL_HEIGHT = HalDisplay::DISPLAY_HEIGHT;
+constexpr int PANEL_ROW_BYTES = HalDisplay::DISPLAY_WIDTH_BYTES;
+constexpr int PANEL_COLUMN_BYTES = PANEL_HEIGHT / 8;
+static_assert(PANEL_WIDTH % 8 == 0 && PANEL_HEIGHT % 8 == 0, "Panel does not split into 8x8 bit blocks");
+
+// Frame buffer bits of one pass from a byte of each plane: set = white in BW, left alone in the gray passes.
+// XTG stores white as 1 already. XTH pixels are (plane1 << 1) | plane2: 0 = white, 1 = dark, 2 = light, 3 = black.
+struct XtgBw {
+  static uint8_t apply(const uint8_t a, uint8_t /*b*/) { return a; }
+};
+struct XthBw {
+  static uint8_t apply(const uint8_t a, const uint8_t b) { return ~(a | b); }
+};
+struct XthLsb {
+  static uint8_t apply(const uint8_t a, const uint8_t b) { return ~a & b; }  // Dark gray only
+};
+struct XthMsb {
+  static uint8_t apply(const uint8_t a, const uint8_t b) { return a ^ b; }  // Light and dark gray
+};
+
+inline uint8_t reverseBits(uint8_t b) {
+  b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+  b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+  return (b & 0xAA) >> 1 | (b & 0x55) << 1;
+}
+
+// 8x8 bit matrix transpose (Hacker's Delight, transpose8): bit 7 - c of in[r] becomes bit 7 - r of out[c]
+inline void transpose8(const uint8_t* in, uint8_t* out) {
+  uint32_t x = static_cast<uint32_t>(in[0]) << 24 | in[1] << 16 | in[2] << 8 | in[3];
+  uint32_t y = static_cast<uint32_t>(in[4]) << 24 | in[5] << 16 | in[6] << 8 | in[7];
+  uint32_t t = (x ^ (x >> 7)) & 0x00AA00AA;
+  x = x ^ t ^ (t << 7);
+  t = (y ^ (y >> 7)) & 0x00AA00AA;
+  y = y ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC;
+  x = x ^ t ^ (t << 14);
+  t = (y ^ (y >> 14)) & 0x0000CCCC;
+  y = y ^ t ^ (t << 14);
+  t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+  y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+  x = t;
+  out[0] = x >> 24;
+  out[1] = x >> 16;
+  out[2] = x >> 8;
+  out[3] = x;
+  out[4] = y >> 24;
+  out[5] = y >> 16;
+  out[6] = y >> 8;
+  out[7] = y;
+}
+
+// Page line i is panel row i, or panel row PANEL_HEIGHT - 1 - i read backwards when flipped
+template <typename Op>
+void copyRows(uint8_t* frameBuffer, const uint8_t* plane1, const uint8_t* plane2, const bool flip) {
+  for (int row = 0; row < PANEL_HEIGHT; row++) {
+    const uint8_t* a = plane1 + row * PANEL_ROW_BYTES;
+    const uint8_t* b = plane2 + row * PANEL_ROW_BYTES;
+    if (flip) {
+      uint8_t* dst = frameBuffer + (PANEL_HEIGHT - row) * PANEL_ROW_BYTES - 1;
+      for (int i = 0; i < PANEL_ROW_BYTES; i++) {
+        *dst-- = reverseBits(Op::apply(a[i], b[i]));
+      }
+    } else {
+      uint8_t* dst = frameBuffer + row * PANEL_ROW_BYTES;
+      for (int i = 0; i < PANEL_ROW_BYTES; i++) {
+        dst[i] = Op::apply(a[i], b[i]);
+      }
+    }
+  }
+}
+
+// Page line i is panel column i with its first pixel at the bottom, or when flipped panel column PANEL_WIDTH - 1 - i
+// with its first pixel at the top. Eight lines are turned into eight panel row bytes at a time.
+template <typename Op>
+void transposeColumns(uint8_t* frameBuffer, const uint8_t* plane1, const uint8_t* plane2, const bool flip) {
+  uint8_t in[8];
+  uint8_t out[8];
+  for (int column = 0; column < PANEL_WIDTH; column += 8) {
+    // Panel byte holding these 8 columns; flipped, the last of the lines is its leftmost pixel
+    const int panelByte = (flip ? PANEL_WIDTH - 8 - column : column) / 8;
+    for (int i = 0; i < PANEL_COLUMN_BYTES; i++) {
+      for (int r = 0; r < 8; r++) {
+        const int offset = (flip ? column + 7 - r : column + r) * PANEL_COLUMN_BYTES + i;
+        in[r] = Op::apply(plane1[offset], plane2[offset]);
+      }
+      transpose8(in, out);
+      for (int c = 0; c < 8; c++) {
+        const int pixel = i * 8 + c;
+        const int row = flip ? pixel : PANEL_HEIGHT - 1 - pixel;
+        frameBuffer[row * PANEL_ROW_BYTES + panelByte] = out[c];
+      }
+    }
+  }
+}
+
+template <typename Op>
+void blitPlanes(uint8_t* frameBuffer, const uint8_t* plane1, const uint8_t* plane2, const bool transpose,
+                const bool flip) {
+  if (transpose) {
+    transposeColumns<Op>(frameBuffer, plane1, plane2, flip);
+  } else {
+    copyRows<Op>(frameBuffer, plane1, plane2, flip);
+  }
+}
+}  // namespace
+
+bool XtcPageBlitter::fillsScreen(const GfxRenderer& renderer, const uint16_t pageWidth, const uint16_t pageHeight) {
+  return pageWidth == renderer.getScreenWidth() && pageHeight == renderer.getScreenHeight();
+}
+
+void XtcPageBlitter::blit(const GfxRenderer& renderer, const uint8_t* page, const uint8_t bitDepth,
+                          const GfxRenderer::RenderMode pass) {
+  // XTG lines are logical rows (MSB leftmost), XTH lines logical columns from right to left (MSB topmost). Rows are
+  // panel rows in landscape and columns from the right are panel rows in portrait; the other pairings land on panel
+  // columns. Either way the inverted orientation of the pair is the same layout turned by 180 degrees.
+  bool transpose = false;
+  bool flip = false;
+  switch (renderer.getOrientation()) {
+    case GfxRenderer::Portrait:
+      transpose = bitDepth != 2;
+      break;
+    case GfxRenderer::LandscapeClockwise:
+      transpose = bitDepth == 2;
+      flip = bitDepth != 2;
+      break;
+    case GfxRenderer::PortraitInverted:
+      transpose = bitDepth != 2;
+      flip = true;
+      break;
+    case GfxRenderer::LandscapeCounterClockwise:
+      transpose = bitDepth == 2;
+      flip = bitDepth == 2;
+      break;
+  }
+
+  uint8_t* frameBuffer = renderer.getFrameBuffer();
+  if (bitDepth != 2) {
+    blitPlanes<XtgBw>(frameBuffer, page, page, transpose, flip);
+    return;
+  }
+
+  const uint8_t* plane2 = page + HalDisplay::BUFFER_SIZE;
+  switch (pass) {
+    case GfxRenderer::GRAYSCALE_LSB:
+      blitPlanes<XthLsb>(frameBuffer, page, plane2, transpose, flip);
+      break;
+    case GfxRenderer::GRAYSCALE_MSB:
+      blitPlanes<XthMsb>(frameBuffer, page, plane2, transpose, flip);
+      break;
+    default:
+      blitPlanes<XthBw>(frameBuffer, page, plane2, transpose, flip);
+      break;
+  }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <GfxRenderer.h>
+
+#include <cstdint>
+
+// Fast path for XTC pages that exactly cover the screen: the page's bit planes are written into the frame buffer
+// whole instead of pixel by pixel. Depending on the format and orientation, page lines are either panel rows, which
+// are copied byte for byte (bit reversed when upside down), or panel columns, which are rotated into place 8x8 bits
+// at a time.
+class XtcPageBlitter {
+ public:
+  // True if pages of this size cover the whole screen in the renderer's current orientation
+  static bool fillsScreen(const GfxRenderer& renderer, uint16_t pageWidth, uint16_t pageHeight);
+
+  // Overwrite the frame buffer with one pass of the page, marking the same pixels as the per-pixel renderer: BW for
+  // both formats, GRAYSCALE_LSB and GRAYSCALE_MSB for the gray levels of 2-bit pages. Only for pages that
+  // fillsScreen().
+  static void blit(const GfxRenderer& renderer, const uint8_t* page, uint8_t bitDepth, GfxRenderer::RenderMode pass);
+};
@@ -0,0 +1,180 @@
+#include "XtcPageCache.h"
+
+#include <HalPowerManager.h>
+#include <HalStorage.h>
+#include <Logging.h>
+
+#include "activities/RenderLock.h"
+
+bool XtcPageCache::allocate(const std::shared_ptr<Xtc>& xtc) {
+  release();
+  if (!xtc) {
+    return false;
+  }
+
+  // XTG (1-bit): Row-major, ((width+7)/8) * height bytes
+  // XTH (2-bit): Two bit planes, column-major, ((width * height + 7) / 8) * 2 bytes
+  const uint16_t pageWidth = xtc->getPageWidth();
+  const uint16_t pageHeight = xtc->getPageHeight();
+  if (xtc->getBitDepth() == 2) {
+    pageSize = ((static_cast<size_t>(pageWidth) * pageHeight + 7) / 8) * 2;
+  } else {
+    pageSize = ((pageWidth + 7) / 8) * static_cast<size_t>(pageHeight);
+  }
+
+  slots[0].buffer = BufferPool::lease(pageSize);
+  if (!slots[0].buffer) {
+    LOG_ERR("XPC", "Failed to allocate page buffer (%lu bytes)", static_cast<unsigned long>(pageSize));
+    return false;
+  }
+  this->xtc = xtc;
+  slotCount = 1;
+
+  // The spare buffer is only an optimisation, so unless a pool slab is free don't let it take the heap the rest of
+  // the reader needs
+  slots[1].buffer = BufferPool::lease(pageSize, ESP.getFreeHeap() >= pageSize + MIN_FREE_HEAP);
+  if (!slots[1].buffer) {
+    LOG_DBG("XPC", "No heap for a spare page buffer, prefetch disabled");
+    return true;
+  }
+  slotCount = 2;
+
+  stopRequested = false;
+  taskRunning = true;
+  // Priority 0 keeps the worker below both the main loop and the render task, so it only reads while the reader
+  // is idle waiting for input.
+  const BaseType_t created = xTaskCreate(
+      [](void* param) {
+        auto* self = static_cast<XtcPageCache*>(param);
+        self->run();
+        vTaskDelete(nullptr);
+      },
+      "XtcPagePrefetch", TASK_STACK_SIZE, this, 0, &taskHandle);
+
+  if (created != pdPASS) {
+    LOG_ERR("XPC", "Failed to create prefetch task");
+    taskHandle = nullptr;
+    taskRunning = false;
+    slots[1].buffer.release();
+    slotCount = 1;
+  }
+
+  LOG_DBG("XPC", "%d page buffers of %lu bytes", slotCount, static_cast<unsigned long>(pageSize));
+  return true;
+}
+
+void XtcPageCache::release() {
+  if (taskHandle) {
+    waitForWorker(false);
+    stopRequested = true;
+    xTaskNotifyGive(taskHandle);
+    while (taskRunning) {
+      delay(5);
+    }
+    taskHandle = nullptr;
+  }
+
+  for (auto& slot : slots) {
+    slot.buffer.release();
+    slot.page = -1;
+  }
+  slotCount = 0;
+  currentSlot = 0;
+  xtc.reset();
+}
+
+const uint8_t* XtcPageCache::getPage(const uint32_t page) {
+  if (slotCount == 0) {
+    return nullptr;
+  }
+
+  // Let a read of this very page finish, cancel one of any other page
+  waitForWorker(requestedPage == static_cast<int32_t>(page));
+
+  for (int i = 0; i < slotCount; i++) {
+    if (slots[i].page == static_cast<int32_t>(page)) {
+      currentSlot = i;
+      return slots[i].buffer.data();
+    }
+  }
+
+  // Miss: load into the spare buffer so the page on screen stays cached for a turn back
+  const int slot = spareSlot();
+  if (!loadInto(slots[slot], page)) {
+    return nullptr;
+  }
+  currentSlot = slot;
+  return slots[slot].buffer.data();
+}
+
+void XtcPageCache::prefetch(const uint32_t page) {
+  if (slotCount < 2 || !taskHandle || busy || page >= xtc->getPageCount()) {
+    return;
+  }
+
+  const int slot = spareSlot();
+  if (slots[currentSlot].page == static_cast<int32_t>(page) || slots[slot].page == static_cast<int32_t>(page)) {
+    return;
+  }
+
+  slots[slot].page = -1;
+  requestedPage = static_cast<int32_t>(page);
+  abortRequested = false;
+  busy = true;
+  xTaskNotifyGive(taskHandle);
+}
+
+bool XtcPageCache::loadInto(Slot& slot, const uint32_t page) {
+  slot.page = -1;
+  if (xtc->loadPage(page, slot.buffer.data(), pageSize) == 0) {
+    return false;
+  }
+  slot.page = static_cast<int32_t>(page);
+  return true;
+}
+
+void XtcPageCache::waitForWorker(const bool wanted) {
+  if (!busy) {
+    return;
+  }
+  if (!wanted) {
+    abortRequested = true;
+  }
+  // The foreground waits from inside render(), so the worker must not stand aside for the render lock meanwhile
+  foregroundWaiting = true;
+  while (busy) {
+    delay(1);
+  }
+  foregroundWaiting = false;
+}
+
+void XtcPageCache::run() {
+  HalStorage::IoClassScope ioClass(HalStorage::IoClass::Prefetch);
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (stopRequested) {
+      break;
+    }
+    if (!busy) {
+      continue;
+    }
+
+    // Stand aside while a page is being rendered so the render task gets the SD card to itself
+    while (!abortRequested && !foregroundWaiting && RenderLock::peek()) {
+      delay(5);
+    }
+
+    if (!abortRequested) {
+      HalPowerManager::Lock powerLock;
+      const uint32_t start = millis();
+      if (loadInto(slots[spareSlot()], requestedPage)) {
+        LOG_DBG("XPC", "Prefetched page %ld in %lu ms", static_cast<long>(requestedPage), millis() - start);
+      } else {
+        LOG_DBG("XPC", "Failed to prefetch page %ld", static_cast<long>(requestedPage));
+      }
+    }
+    busy = false;
+  }
+
+  taskRunning = false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <BufferPool.h>
+#include <Xtc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Two page buffers for the XTC reader, allocated once per book: one holds the page on screen, the other is filled
+// with the page the reader is expected to turn to next by a low-priority background task. A page turn onto a
+// prefetched page then only has to convert memory that is already loaded instead of waiting on the SD card.
+// Falls back to a single buffer with synchronous loads when there is not enough heap for two.
+// Every access to the book file goes through this class, so the foreground and the worker never read it at once.
+class XtcPageCache {
+ public:
+  XtcPageCache() = default;
+  ~XtcPageCache() { release(); }
+
+  XtcPageCache(const XtcPageCache&) = delete;
+  XtcPageCache& operator=(const XtcPageCache&) = delete;
+
+  // Allocate the buffers for the book's page size and start the worker. Returns false if not even one page
+  // buffer could be allocated.
+  bool allocate(const std::shared_ptr<Xtc>& xtc);
+
+  // Stop the worker and free the buffers
+  void release();
+  bool isAllocated() const { return slotCount > 0; }
+
+  // Returns the buffer holding the given page, loading it on a miss, or nullptr if the page could not be loaded.
+  // The buffer stays valid until the next getPage() call.
+  const uint8_t* getPage(uint32_t page);
+
+  // Start reading the given page into the spare buffer in the background. Does nothing without a spare buffer.
+  void prefetch(uint32_t page);
+
+ private:
+  struct Slot {
+    BufferLease buffer;
+    int32_t page = -1;  // -1 while empty or being filled
+  };
+
+  static constexpr int SLOT_COUNT = 2;
+  static constexpr uint32_t TASK_STACK_SIZE = 4096;
+  static constexpr uint32_t MIN_FREE_HEAP = 32 * 1024;  // Left free after the spare buffer
+
+  std::shared_ptr<Xtc> xtc;
+  size_t pageSize = 0;
+  Slot slots[SLOT_COUNT];
+  int slotCount = 0;
+  int currentSlot = 0;
+
+  TaskHandle_t taskHandle = nullptr;
+  int32_t requestedPage = -1;  // Page the worker reads into the spare slot, owned by the worker while busy
+  std::atomic<bool> busy{false};
+  std::atomic<bool> abortRequested{false};
+  std::atomic<bool> foregroundWaiting{false};
+  std::atomic<bool> stopRequested{false};
+  std::atomic<bool> taskRunning{false};
+
+  int spareSlot() const { return slotCount > 1 ? 1 - currentSlot : currentSlot; }
+  bool loadInto(Slot& slot, uint32_t page);
+  void waitForWorker(bool wanted);
+  void run();
+};
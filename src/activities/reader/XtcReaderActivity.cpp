@@ -15,10 +15,13 @@
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "MappedInputManager.h"
+#include "ProgressJournal.h"
 #include "RecentBooksStore.h"
+#include "XtcPageBlitter.h"
 #include "XtcReaderChapterSelectionActivity.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
+#include "util/LibraryIndex.h"
 
 namespace {
 constexpr unsigned long skipPageMs = 700;
@@ -34,6 +37,9 @@ void XtcReaderActivity::onEnter() {
 
   xtc->setupCacheDir();
 
+  // Page buffers live as long as the book is open; a failure here shows up as a memory error on the page
+  pageCache.allocate(xtc);
+
   // Load saved progress
   loadProgress();
 
@@ -49,6 +55,13 @@ void XtcReaderActivity::onEnter() {
 void XtcReaderActivity::onExit() {
   Activity::onExit();
 
+  // Stops the prefetch task before the book file is closed
+  pageCache.release();
+
+  PROGRESS_JOURNAL.flush();
+  if (xtc && xtc->getPageCount() > 0) {
+    LibraryIndex::setProgress(xtc->getPath(), static_cast<int>((currentPage + 1) * 100 / xtc->getPageCount()));
+  }
   APP_STATE.readerActivityLoadCount = 0;
   APP_STATE.saveToFile();
   xtc.reset();
@@ -109,6 +122,7 @@ void XtcReaderActivity::loop() {
   const int skipAmount = skipPages ? 10 : 1;
 
   if (prevTriggered) {
+    turnDirection = -1;
     if (currentPage >= static_cast<uint32_t>(skipAmount)) {
       currentPage -= skipAmount;
     } else {
@@ -116,6 +130,7 @@ void XtcReaderActivity::loop() {
     }
     requestUpdate();
   } else if (nextTriggered) {
+    turnDirection = 1;
     currentPage += skipAmount;
     if (currentPage >= xtc->getPageCount()) {
       currentPage = xtc->getPageCount();  // Allow showing "End of book"
@@ -140,6 +155,11 @@ void XtcReaderActivity::render(RenderLock&&) {
 
   renderPage();
   saveProgress();
+
+  // Read the page most likely to be turned to next while this one is on screen
+  if (turnDirection > 0 || currentPage > 0) {
+    pageCache.prefetch(currentPage + turnDirection);
+  }
 }
 
 void XtcReaderActivity::renderPage() {
@@ -147,42 +167,27 @@ void XtcReaderActivity::renderPage() {
   const uint16_t pageHeight = xtc->getPageHeight();
   const uint8_t bitDepth = xtc->getBitDepth();
 
-  // Calculate buffer size for one page
-  // XTG (1-bit): Row-major, ((width+7)/8) * height bytes
-  // XTH (2-bit): Two bit planes, column-major, ((width * height + 7) / 8) * 2 bytes
-  size_t pageBufferSize;
-  if (bitDepth == 2) {
-    pageBufferSize = ((static_cast<size_t>(pageWidth) * pageHeight + 7) / 8) * 2;
-  } else {
-    pageBufferSize = ((pageWidth + 7) / 8) * pageHeight;
-  }
-
-  // Allocate page buffer
-  uint8_t* pageBuffer = static_cast<uint8_t*>(malloc(pageBufferSize));
-  if (!pageBuffer) {
-    LOG_ERR("XTR", "Failed to allocate page buffer (%lu bytes)", pageBufferSize);
+  // Page buffers are allocated once in onEnter()
+  if (!pageCache.isAllocated()) {
     renderer.clearScreen();
     renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_MEMORY_ERROR), true, EpdFontFamily::BOLD);
     renderer.displayBuffer();
     return;
   }
 
-  // Load page data
-  size_t bytesRead = xtc->loadPage(currentPage, pageBuffer, pageBufferSize);
-  if (bytesRead == 0) {
+  // Served from memory when the page was prefetched after the previous turn
+  const uint8_t* pageBuffer = pageCache.getPage(currentPage);
+  if (!pageBuffer) {
     LOG_ERR("XTR", "Failed to load page %lu", currentPage);
-    free(pageBuffer);
     renderer.clearScreen();
     renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_PAGE_LOAD_ERROR), true, EpdFontFamily::BOLD);
     renderer.displayBuffer();
     return;
   }
 
-  // Clear screen first
-  renderer.clearScreen();
-
-  // Copy page bitmap using GfxRenderer's drawPixel
-  // XTC/XTCH pages are pre-rendered with status bar included, so render full page
+  // XTC/XTCH pages are pre-rendered with status bar included, so render full page. Pages that cover the screen
+  // exactly have their planes written into the frame buffer whole; others are copied pixel by pixel.
+  const bool blitPage = XtcPageBlitter::fillsScreen(renderer, pageWidth, pageHeight);
   const uint16_t maxSrcY = pageHeight;
 
   if (bitDepth == 2) {
@@ -209,83 +214,84 @@ void XtcReaderActivity::renderPage() {
       return (bit1 << 1) | bit2;
     };
 
+    // One pass into the frame buffer:
+    // - BW: all non-white pixels black
+    // - GRAYSCALE_LSB: mark DARK gray only (XTH value 1)
+    // - GRAYSCALE_MSB: mark LIGHT AND DARK gray (XTH value 1 or 2)
+    // In LUT: 0 bit = apply gray effect, 1 bit = untouched
+    auto drawPass = [&](const GfxRenderer::RenderMode pass) {
+      if (blitPage) {
+        XtcPageBlitter::blit(renderer, pageBuffer, bitDepth, pass);
+        return;
+      }
+      renderer.clearScreen(pass == GfxRenderer::BW ? 0xFF : 0x00);
+      for (uint16_t y = 0; y < pageHeight; y++) {
+        for (uint16_t x = 0; x < pageWidth; x++) {
+          const uint8_t pv = getPixelValue(x, y);
+          if (pass == GfxRenderer::BW) {
+            if (pv >= 1) {
+              renderer.drawPixel(x, y, true);
+            }
+          } else if (pv == 1 || (pass == GfxRenderer::GRAYSCALE_MSB && pv == 2)) {
+            renderer.drawPixel(x, y, false);
+          }
+        }
+      }
+    };
+
     // Optimized grayscale rendering without storeBwBuffer (saves 48KB peak memory)
     // Flow: BW display → LSB/MSB passes → grayscale display → re-render BW for next frame
 
-    // Count pixel distribution for debugging
-    uint32_t pixelCounts[4] = {0, 0, 0, 0};
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        pixelCounts[getPixelValue(x, y)]++;
-      }
-    }
-    LOG_DBG("XTR", "Pixel distribution: White=%lu, DarkGrey=%lu, LightGrey=%lu, Black=%lu", pixelCounts[0],
-            pixelCounts[1], pixelCounts[2], pixelCounts[3]);
-
-    // Pass 1: BW buffer - draw all non-white pixels as black
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        if (getPixelValue(x, y) >= 1) {
-          renderer.drawPixel(x, y, true);
+    if (!blitPage) {
+      // Count pixel distribution for debugging
+      uint32_t pixelCounts[4] = {0, 0, 0, 0};
+      for (uint16_t y = 0; y < pageHeight; y++) {
+        for (uint16_t x = 0; x < pageWidth; x++) {
+          pixelCounts[getPixelValue(x, y)]++;
         }
       }
+      LOG_DBG("XTR", "Pixel distribution: White=%lu, DarkGrey=%lu, LightGrey=%lu, Black=%lu", pixelCounts[0],
+              pixelCounts[1], pixelCounts[2], pixelCounts[3]);
     }
 
+    // Pass 1: BW buffer
+    drawPass(GfxRenderer::BW);
+
     // Display BW with conditional refresh based on pagesUntilFullRefresh
     if (pagesUntilFullRefresh <= 1) {
       renderer.displayBuffer(HalDisplay::HALF_REFRESH);
       pagesUntilFullRefresh = SETTINGS.getRefreshFrequency();
     } else {
-      renderer.displayBuffer();
+      renderer.displayBuffer(HalDisplay::FAST_REFRESH);
       pagesUntilFullRefresh--;
     }
 
-    // Pass 2: LSB buffer - mark DARK gray only (XTH value 1)
-    // In LUT: 0 bit = apply gray effect, 1 bit = untouched
-    renderer.clearScreen(0x00);
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        if (getPixelValue(x, y) == 1) {  // Dark grey only
-          renderer.drawPixel(x, y, false);
-        }
-      }
-    }
+    // Pass 2: LSB buffer
+    drawPass(GfxRenderer::GRAYSCALE_LSB);
     renderer.copyGrayscaleLsbBuffers();
 
-    // Pass 3: MSB buffer - mark LIGHT AND DARK gray (XTH value 1 or 2)
-    // In LUT: 0 bit = apply gray effect, 1 bit = untouched
-    renderer.clearScreen(0x00);
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        const uint8_t pv = getPixelValue(x, y);
-        if (pv == 1 || pv == 2) {  // Dark grey or Light grey
-          renderer.drawPixel(x, y, false);
-        }
-      }
-    }
+    // Pass 3: MSB buffer
+    drawPass(GfxRenderer::GRAYSCALE_MSB);
     renderer.copyGrayscaleMsbBuffers();
 
     // Display grayscale overlay
     renderer.displayGrayBuffer();
 
     // Pass 4: Re-render BW to framebuffer (restore for next frame, instead of restoreBwBuffer)
-    renderer.clearScreen();
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        if (getPixelValue(x, y) >= 1) {
-          renderer.drawPixel(x, y, true);
-        }
-      }
-    }
+    drawPass(GfxRenderer::BW);
 
     // Cleanup grayscale buffers with current frame buffer
     renderer.cleanupGrayscaleWithFrameBuffer();
 
-    free(pageBuffer);
-
-    LOG_DBG("XTR", "Rendered page %lu/%lu (2-bit grayscale)", currentPage + 1, xtc->getPageCount());
+    LOG_DBG("XTR", "Rendered page %lu/%lu (2-bit grayscale%s)", currentPage + 1, xtc->getPageCount(),
+            blitPage ? ", blit" : "");
     return;
+  } else if (blitPage) {
+    // 1-bit mode: XTC stores white as 1 like the frame buffer, so the page replaces it
+    XtcPageBlitter::blit(renderer, pageBuffer, bitDepth, GfxRenderer::BW);
   } else {
+    renderer.clearScreen();
+
     // 1-bit mode: 8 pixels per byte, MSB first
     const size_t srcRowBytes = (pageWidth + 7) / 8;  // 60 bytes for 480 width
 
@@ -303,10 +309,8 @@ void XtcReaderActivity::renderPage() {
         }
       }
     }
+    // White pixels are already cleared by clearScreen()
   }
-  // White pixels are already cleared by clearScreen()
-
-  free(pageBuffer);
 
   // XTC pages already have status bar pre-rendered, no need to add our own
 
@@ -315,7 +319,7 @@ void XtcReaderActivity::renderPage() {
     renderer.displayBuffer(HalDisplay::HALF_REFRESH);
     pagesUntilFullRefresh = SETTINGS.getRefreshFrequency();
   } else {
-    renderer.displayBuffer();
+    renderer.displayBuffer(HalDisplay::FAST_REFRESH);
     pagesUntilFullRefresh--;
   }
 
@@ -323,23 +327,18 @@ void XtcReaderActivity::renderPage() {
 }
 
 void XtcReaderActivity::saveProgress() const {
-  FsFile f;
-  if (Storage.openFileForWrite("XTR", xtc->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[4];
-    data[0] = currentPage & 0xFF;
-    data[1] = (currentPage >> 8) & 0xFF;
-    data[2] = (currentPage >> 16) & 0xFF;
-    data[3] = (currentPage >> 24) & 0xFF;
-    f.write(data, 4);
-    f.close();
-  }
+  uint8_t data[4];
+  data[0] = currentPage & 0xFF;
+  data[1] = (currentPage >> 8) & 0xFF;
+  data[2] = (currentPage >> 16) & 0xFF;
+  data[3] = (currentPage >> 24) & 0xFF;
+  PROGRESS_JOURNAL.save(xtc->getCachePath() + "/progress.bin", data, sizeof(data));
 }
 
 void XtcReaderActivity::loadProgress() {
-  FsFile f;
-  if (Storage.openFileForRead("XTR", xtc->getCachePath() + "/progress.bin", f)) {
+  {
     uint8_t data[4];
-    if (f.read(data, 4) == 4) {
+    if (PROGRESS_JOURNAL.load(xtc->getCachePath() + "/progress.bin", data, sizeof(data)) == 4) {
       currentPage = data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
       LOG_DBG("XTR", "Loaded progress: page %lu", currentPage);
 
@@ -348,6 +347,5 @@ void XtcReaderActivity::loadProgress() {
         currentPage = 0;
       }
     }
-    f.close();
   }
 }
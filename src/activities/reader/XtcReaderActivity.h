@@ -9,13 +9,16 @@
 
 #include <Xtc.h>
 
+#include "XtcPageCache.h"
 #include "activities/Activity.h"
 
 class XtcReaderActivity final : public Activity {
   std::shared_ptr<Xtc> xtc;
+  XtcPageCache pageCache;
 
   uint32_t currentPage = 0;
   int pagesUntilFullRefresh = 0;
+  int turnDirection = 1;  // Direction of the last page turn, the page prefetched next
 
   void renderPage();
   void saveProgress() const;
@@ -0,0 +1,104 @@
+#include "BookPreparer.h"
+
+#include <Epub.h>
+#include <Epub/Section.h>
+#include <Epub/parsers/XmlParserPool.h>
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Txt.h>
+#include <Xtc.h>
+
+#include <memory>
+
+#include "CrossPointSettings.h"
+#include "components/UITheme.h"
+#include "util/LibraryIndex.h"
+#include "util/StringUtils.h"
+
+bool BookPreparer::isBookFile(const std::string& path) {
+  return StringUtils::checkFileExtension(path, ".epub") || StringUtils::checkFileExtension(path, ".xtch") ||
+         StringUtils::checkFileExtension(path, ".xtc") || StringUtils::checkFileExtension(path, ".txt");
+}
+
+// Parses of the next book reuse the pooled parser; after the last one it is only memory
+BookPreparer::~BookPreparer() { XmlParserPool::trim(); }
+
+bool BookPreparer::checkAbort() {
+  if (shouldAbort()) {
+    wasAborted = true;
+  }
+  return wasAborted;
+}
+
+bool BookPreparer::prepareEpub(const std::string& path) {
+  const auto epub = std::make_shared<Epub>(path, "/.crosspoint");
+  if (!epub->load(true, false)) {
+    LOG_ERR("PLIB", "Failed to load %s", path.c_str());
+    return false;
+  }
+
+  // Missing covers aren't an error, plenty of books don't have one. Sleep cover and thumbnail share one decode.
+  const bool cropped = SETTINGS.sleepScreenCoverMode == CrossPointSettings::SLEEP_SCREEN_COVER_MODE::CROP;
+  const int thumbHeight = UITheme::getInstance().getMetrics().homeCoverHeight;
+  epub->generateCoverBmps(!cropped, cropped, {thumbHeight});
+  LibraryIndex::bookPrepared({path, epub->getTitle(), epub->getAuthor(), epub->getLanguage(), epub->getSeries(), 0, 0,
+                              Storage.exists(epub->getThumbBmpPath(thumbHeight).c_str())});
+
+  bool ok = true;
+  for (int spineIndex = 0; spineIndex < epub->getSpineItemsCount(); spineIndex++) {
+    if (checkAbort()) {
+      return false;
+    }
+
+    Section section(epub, spineIndex, renderer);
+    if (section.loadSectionFile(params.fontId, params.lineCompression, params.extraParagraphSpacing,
+                                params.paragraphAlignment, params.viewportWidth, params.viewportHeight,
+                                params.hyphenationEnabled, params.embeddedStyle)) {
+      continue;
+    }
+    if (!section.createSectionFile(params.fontId, params.lineCompression, params.extraParagraphSpacing,
+                                   params.paragraphAlignment, params.viewportWidth, params.viewportHeight,
+                                   params.hyphenationEnabled, params.embeddedStyle, nullptr,
+                                   [this]() { return checkAbort(); })) {
+      if (wasAborted) {
+        return false;
+      }
+      LOG_ERR("PLIB", "Failed to build spine %d of %s", spineIndex, path.c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool BookPreparer::prepare(const std::string& path) {
+  wasAborted = false;
+
+  if (StringUtils::checkFileExtension(path, ".epub")) {
+    return prepareEpub(path);
+  }
+
+  if (StringUtils::checkFileExtension(path, ".xtc") || StringUtils::checkFileExtension(path, ".xtch")) {
+    Xtc xtc(path, "/.crosspoint");
+    if (!xtc.load()) {
+      LOG_ERR("PLIB", "Failed to load %s", path.c_str());
+      return false;
+    }
+    const int thumbHeight = UITheme::getInstance().getMetrics().homeCoverHeight;
+    xtc.generateCoverBmps(true, {thumbHeight});
+    LibraryIndex::bookPrepared(
+        {path, xtc.getTitle(), xtc.getAuthor(), "", "", 0, 0, Storage.exists(xtc.getThumbBmpPath(thumbHeight).c_str())});
+    return true;
+  }
+
+  // Plain text is paginated by its reader on open; only the sleep cover can be prepared here
+  Txt txt(path, "/.crosspoint");
+  if (!txt.load()) {
+    LOG_ERR("PLIB", "Failed to load %s", path.c_str());
+    return false;
+  }
+  if (!txt.generateCoverBmp()) {
+    LOG_DBG("PLIB", "No cover for %s", path.c_str());
+  }
+  LibraryIndex::bookPrepared({path, txt.getTitle()});
+  return true;
+}
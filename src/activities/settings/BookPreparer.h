@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "activities/reader/SectionPrefetcher.h"
+
+class GfxRenderer;
+
+// Builds every cache a book needs to open instantly: book.bin and the CSS rules, the sleep screen cover, the home
+// screen thumbnail and, for EPUBs, the sections for the given reader layout. Caches that already match are only
+// loaded, so preparing a book twice is cheap. Runs on whichever task calls it; shouldAbort is polled between
+// sections and may block to pause the work.
+class BookPreparer {
+ public:
+  BookPreparer(GfxRenderer& renderer, const SectionPrefetcher::LayoutParams& params,
+               std::function<bool()> shouldAbort)
+      : renderer(renderer), params(params), shouldAbort(std::move(shouldAbort)) {}
+  ~BookPreparer();
+
+  static bool isBookFile(const std::string& path);
+
+  // False if the book couldn't be fully prepared or shouldAbort() stopped it; aborted() tells the two apart
+  bool prepare(const std::string& path);
+  bool aborted() const { return wasAborted; }
+
+ private:
+  GfxRenderer& renderer;
+  const SectionPrefetcher::LayoutParams params;
+  const std::function<bool()> shouldAbort;
+  bool wasAborted = false;
+
+  bool prepareEpub(const std::string& path);
+  bool checkAbort();
+};
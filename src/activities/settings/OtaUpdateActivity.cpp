@@ -85,14 +85,8 @@ void OtaUpdateActivity::render(RenderLock&&) {
   const auto top = (pageHeight - height) / 2;
 
   float updaterProgress = 0;
-  if (state == UPDATE_IN_PROGRESS) {
-    LOG_DBG("OTA", "Update progress: %d / %d", updater.getProcessedSize(), updater.getTotalSize());
+  if (state == UPDATE_IN_PROGRESS && updater.getTotalSize() > 0) {
     updaterProgress = static_cast<float>(updater.getProcessedSize()) / static_cast<float>(updater.getTotalSize());
-    // Only update every 2% at the most
-    if (static_cast<int>(updaterProgress * 50) == lastUpdaterPercentage / 2) {
-      return;
-    }
-    lastUpdaterPercentage = static_cast<int>(updaterProgress * 100);
   }
 
   if (state == CHECKING_FOR_UPDATE) {
@@ -139,9 +133,30 @@ void OtaUpdateActivity::render(RenderLock&&) {
 }
 
 void OtaUpdateActivity::loop() {
-  // TODO @ngxson : refactor this logic later
-  if (updater.getRender()) {
+  if (state == UPDATE_IN_PROGRESS) {
+    if (updater.isInstalling()) {
+      // The download runs in its own task; redraw every 2% at the most
+      const auto total = updater.getTotalSize();
+      const unsigned int percentage =
+          total > 0 ? static_cast<unsigned int>(updater.getProcessedSize() * 100 / total) : 0;
+      if (percentage / 2 != lastUpdaterPercentage / 2) {
+        LOG_DBG("OTA", "Update progress: %d / %d", updater.getProcessedSize(), total);
+        lastUpdaterPercentage = percentage;
+        requestUpdate();
+      }
+      return;
+    }
+
+    const auto res = updater.getInstallResult();
+    if (res != OtaUpdater::OK) {
+      LOG_DBG("OTA", "Update failed: %d", res);
+    }
+    {
+      RenderLock lock(*this);
+      state = res == OtaUpdater::OK ? FINISHED : FAILED;
+    }
     requestUpdate();
+    return;
   }
 
   if (state == WAITING_CONFIRMATION) {
@@ -151,22 +166,11 @@ void OtaUpdateActivity::loop() {
         RenderLock lock(*this);
         state = UPDATE_IN_PROGRESS;
       }
+      lastUpdaterPercentage = UNINITIALIZED_PERCENTAGE;
       requestUpdateAndWait();
-      const auto res = updater.installUpdate();
-
-      if (res != OtaUpdater::OK) {
-        LOG_DBG("OTA", "Update failed: %d", res);
-        {
-          RenderLock lock(*this);
-          state = FAILED;
-        }
-        requestUpdate();
-        return;
-      }
-
-      {
+      if (!updater.startInstall()) {
         RenderLock lock(*this);
-        state = FINISHED;
+        state = FAILED;
       }
       requestUpdate();
     }
@@ -193,6 +197,7 @@ void OtaUpdateActivity::loop() {
   }
 
   if (state == SHUTTING_DOWN) {
+    logFlush();
     ESP.restart();
   }
 }
@@ -0,0 +1,303 @@
+#include "PrepareLibraryActivity.h"
+
+#include <GfxRenderer.h>
+#include <HalGPIO.h>
+#include <HalStorage.h>
+#include <I18n.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "BookPreparer.h"
+#include "MappedInputManager.h"
+#include "activities/ActivityManager.h"
+#include "activities/reader/EpubReaderActivity.h"
+#include "components/UITheme.h"
+#include "fontIds.h"
+
+extern HalGPIO gpio;  // Defined in main.cpp
+
+namespace {
+constexpr char RESUME_FILE[] = "/.crosspoint/prepare_library.bin";
+}  // namespace
+
+void PrepareLibraryActivity::onEnter() {
+  Activity::onEnter();
+
+  {
+    // The layout math switches the renderer to the reader orientation for a moment
+    RenderLock lock(*this);
+    params = EpubReaderActivity::getLayoutParams(renderer);
+  }
+
+  state = WARNING;
+  if (autoStarted) {
+    start();
+  }
+  requestUpdate();
+}
+
+void PrepareLibraryActivity::onExit() {
+  stop();
+  Activity::onExit();
+}
+
+void PrepareLibraryActivity::start() {
+  {
+    RenderLock lock(*this);
+    state = PREPARING;
+    currentBook.clear();
+  }
+  booksDone = 0;
+  totalBooks = 0;
+  failedCount = 0;
+  pendingDirs.clear();
+  books.clear();
+  nextBook = 0;
+  startMs = millis();
+  if (onlyBooks.empty()) {
+    pendingDirs.push_back("/");
+  } else {
+    books = onlyBooks;
+    listBooks();
+  }
+
+  if (!BACKGROUND_JOBS.submit(prepareJob)) {
+    LOG_ERR("PLIB", "Failed to start prepare job");
+    RenderLock lock(*this);
+    state = DONE;
+  }
+}
+
+void PrepareLibraryActivity::stop() { BACKGROUND_JOBS.cancel(prepareJob); }
+
+void PrepareLibraryActivity::close() {
+  stop();
+  if (autoStarted) {
+    onGoHome();
+  } else {
+    finish();
+  }
+}
+
+bool PrepareLibraryActivity::shouldAbort() const {
+  // Stand aside while the progress screen is being drawn so the render task gets the SD card to itself
+  while (!prepareJob.isCancelled() && RenderLock::peek()) {
+    delay(5);
+  }
+  return prepareJob.isCancelled();
+}
+
+void PrepareLibraryActivity::scanNextDirectory() {
+  const std::string dir = std::move(pendingDirs.back());
+  pendingDirs.pop_back();
+
+  auto root = Storage.open(dir.c_str());
+  if (!root || !root.isDirectory()) {
+    if (root) root.close();
+    return;
+  }
+
+  char name[500];
+  for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
+    file.getName(name, sizeof(name));
+    // Hidden entries include the /.crosspoint cache itself
+    if (name[0] == '.' || strcmp(name, "System Volume Information") == 0) {
+      file.close();
+      continue;
+    }
+
+    std::string path = dir;
+    if (path.back() != '/') path += '/';
+    path += name;
+
+    if (file.isDirectory()) {
+      pendingDirs.push_back(std::move(path));
+    } else if (BookPreparer::isBookFile(path)) {
+      books.push_back(std::move(path));
+    }
+    file.close();
+  }
+  root.close();
+
+  if (pendingDirs.empty()) {
+    // Stable order so the resume point means the same thing on the next run
+    std::sort(books.begin(), books.end());
+    listBooks();
+  }
+}
+
+void PrepareLibraryActivity::listBooks() {
+  totalBooks = static_cast<int>(books.size());
+  firstIndex = onlyBooks.empty() ? loadResumeIndex() : 0;
+  LOG_DBG("PLIB", "Preparing %zu books, starting at %zu", books.size(), firstIndex);
+  progressChanged = true;
+}
+
+size_t PrepareLibraryActivity::loadResumeIndex() const {
+  FsFile file;
+  if (!Storage.exists(RESUME_FILE) || !Storage.openFileForRead("PLIB", RESUME_FILE, file)) {
+    return 0;
+  }
+
+  uint8_t version;
+  std::string lastPath;
+  serialization::readPod(file, version);
+  if (version == RESUME_FILE_VERSION) {
+    serialization::readString(file, lastPath);
+  }
+  file.close();
+
+  if (lastPath.empty()) {
+    return 0;
+  }
+  // Books sorting before the resume point are revisited at the end; whatever they already have is skipped quickly
+  const auto it = std::upper_bound(books.begin(), books.end(), lastPath);
+  return it == books.end() ? 0 : static_cast<size_t>(it - books.begin());
+}
+
+void PrepareLibraryActivity::saveResumePoint(const std::string& path) const {
+  FsFile file;
+  if (!Storage.openFileForWrite("PLIB", RESUME_FILE, file)) {
+    return;
+  }
+  serialization::writePod(file, RESUME_FILE_VERSION);
+  serialization::writeString(file, path);
+  file.close();
+}
+
+bool PrepareLibraryActivity::step() {
+  // The library is scanned a directory per step, then prepared a book per step
+  if (!pendingDirs.empty()) {
+    scanNextDirectory();
+    return true;
+  }
+
+  const size_t bookCount = books.size();
+  if (nextBook < bookCount) {
+    const std::string& path = books[(firstIndex + nextBook) % bookCount];
+    {
+      RenderLock lock;
+      const size_t slash = path.find_last_of('/');
+      currentBook = slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+    progressChanged = true;
+
+    BookPreparer preparer(renderer, params, [this]() { return shouldAbort(); });
+    if (!preparer.prepare(path)) {
+      if (preparer.aborted()) {
+        return false;
+      }
+      failedCount++;
+    }
+    if (onlyBooks.empty()) {
+      saveResumePoint(path);
+    }
+    booksDone = static_cast<int>(++nextBook);
+    progressChanged = true;
+    return true;
+  }
+
+  if (onlyBooks.empty()) {
+    Storage.remove(RESUME_FILE);
+  }
+  LOG_DBG("PLIB", "Prepared %d/%zu books (%d failed) in %lu ms", booksDone.load(), bookCount, failedCount.load(),
+          millis() - startMs);
+
+  {
+    RenderLock lock;
+    state = DONE;
+  }
+  progressChanged = true;
+  return false;
+}
+
+bool PrepareLibraryActivity::PrepareJob::step() {
+  const bool more = activity.step();
+  setProgress(activity.booksDone, activity.totalBooks);
+  return more;
+}
+
+void PrepareLibraryActivity::loop() {
+  if (progressChanged.exchange(false)) {
+    requestUpdate();
+  }
+
+  if (state == WARNING) {
+    if (mappedInput.wasPressed(MappedInputManager::Button::Confirm)) {
+      start();
+      requestUpdate();
+    }
+    if (mappedInput.wasPressed(MappedInputManager::Button::Back)) {
+      close();
+    }
+    return;
+  }
+
+  if (state == PREPARING) {
+    // Only keep going on charger power when nobody asked for the run
+    if (autoStarted && !gpio.isUsbConnected()) {
+      LOG_DBG("PLIB", "USB power removed, stopping");
+      close();
+      return;
+    }
+    if (mappedInput.wasPressed(MappedInputManager::Button::Back)) {
+      close();
+    }
+    return;
+  }
+
+  if (mappedInput.wasPressed(MappedInputManager::Button::Back) ||
+      (autoStarted && mappedInput.wasPressed(MappedInputManager::Button::Confirm))) {
+    close();
+  }
+}
+
+void PrepareLibraryActivity::render(RenderLock&&) {
+  const auto& metrics = UITheme::getInstance().getMetrics();
+  const auto pageWidth = renderer.getScreenWidth();
+  const auto pageHeight = renderer.getScreenHeight();
+
+  renderer.clearScreen();
+
+  GUI.drawHeader(renderer, Rect{0, metrics.topPadding, pageWidth, metrics.headerHeight}, tr(STR_PREPARE_LIBRARY));
+
+  if (state == WARNING) {
+    renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 - 40, tr(STR_PREPARE_LIBRARY_WARNING_1), true);
+    renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 - 10, tr(STR_PREPARE_LIBRARY_WARNING_2), true,
+                              EpdFontFamily::BOLD);
+
+    const auto labels = mappedInput.mapLabels(tr(STR_CANCEL), tr(STR_CONFIRM), "", "");
+    GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+    renderer.displayBuffer();
+    return;
+  }
+
+  const std::string countText = std::to_string(booksDone) + " / " + std::to_string(totalBooks);
+
+  if (state == PREPARING) {
+    renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 - 40, tr(STR_PREPARING_LIBRARY), true,
+                              EpdFontFamily::BOLD);
+    renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 - 10, countText.c_str());
+    const std::string book = renderer.truncatedText(UI_10_FONT_ID, currentBook.c_str(), pageWidth - 40);
+    renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 + 20, book.c_str());
+
+    const auto labels = mappedInput.mapLabels(tr(STR_CANCEL), "", "", "");
+    GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+    renderer.displayBuffer();
+    return;
+  }
+
+  renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 - 20, tr(STR_LIBRARY_PREPARED), true, EpdFontFamily::BOLD);
+  std::string resultText = countText + " " + std::string(tr(STR_BOOKS_PREPARED));
+  if (failedCount > 0) {
+    resultText += ", " + std::to_string(failedCount) + " " + std::string(tr(STR_FAILED_LOWER));
+  }
+  renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 + 10, resultText.c_str());
+
+  const auto labels = mappedInput.mapLabels(tr(STR_BACK), "", "", "");
+  GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+  renderer.displayBuffer();
+}
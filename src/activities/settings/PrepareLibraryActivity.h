@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "BackgroundJobs.h"
+#include "activities/Activity.h"
+#include "activities/reader/SectionPrefetcher.h"
+
+// Builds every cache a book needs to open instantly (see BookPreparer), for all books on the SD card. The work runs
+// as a background job behind a progress screen, a directory or a book per step. The last finished book is recorded
+// after each one, so an interrupted run carries on from there the next time.
+class PrepareLibraryActivity final : public Activity {
+ public:
+  // autoStarted: launched after a file transfer session rather than from settings. Starts without asking, stops
+  // when USB power goes away and returns to the home screen when done. A non-empty onlyBooks limits the run to
+  // those books (the ones just received) and skips the library scan and the resume point.
+  explicit PrepareLibraryActivity(GfxRenderer& renderer, MappedInputManager& mappedInput, bool autoStarted = false,
+                                  std::vector<std::string> onlyBooks = {})
+      : Activity("PrepareLibrary", renderer, mappedInput),
+        autoStarted(autoStarted),
+        onlyBooks(std::move(onlyBooks)) {}
+
+  void onEnter() override;
+  void onExit() override;
+  void loop() override;
+  void render(RenderLock&&) override;
+
+ private:
+  enum State { WARNING, PREPARING, DONE };
+
+  static constexpr uint8_t RESUME_FILE_VERSION = 1;
+
+  const bool autoStarted;
+  const std::vector<std::string> onlyBooks;
+  State state = WARNING;
+  SectionPrefetcher::LayoutParams params;
+  // Owned by the worker while the job is queued
+  std::vector<std::string> pendingDirs;
+  std::vector<std::string> books;
+  size_t firstIndex = 0;
+  size_t nextBook = 0;
+  unsigned long startMs = 0;
+
+  std::atomic<bool> progressChanged{false};
+  std::atomic<int> booksDone{0};
+  std::atomic<int> totalBooks{0};
+  std::atomic<int> failedCount{0};
+  std::string currentBook;  // Written by the worker under the render lock
+
+  class PrepareJob final : public BackgroundJob {
+    PrepareLibraryActivity& activity;
+
+   public:
+    explicit PrepareJob(PrepareLibraryActivity& activity) : BackgroundJob("PrepareLibrary"), activity(activity) {}
+
+   protected:
+    bool step() override;
+  };
+  PrepareJob prepareJob{*this};
+
+  void start();
+  void stop();
+  void close();
+  bool shouldAbort() const;
+  bool step();
+
+  void scanNextDirectory();
+  void listBooks();
+  size_t loadResumeIndex() const;
+  void saveResumePoint(const std::string& path) const;
+};
@@ -20,6 +20,7 @@ enum class SettingAction {
   OPDSBrowser,
   Network,
   ClearCache,
+  PrepareLibrary,
   CheckForUpdates,
   Language,
 };
@@ -142,11 +143,11 @@ class SettingsActivity final : public Activity {
   int settingsCount = 0;
 
   // Per-category settings derived from shared list + device-only actions
-  std::vector<SettingInfo> displaySettings;
-  std::vector<SettingInfo> readerSettings;
-  std::vector<SettingInfo> controlsSettings;
-  std::vector<SettingInfo> systemSettings;
-  const std::vector<SettingInfo>* currentSettings = nullptr;
+  ActivityVector<SettingInfo> displaySettings;
+  ActivityVector<SettingInfo> readerSettings;
+  ActivityVector<SettingInfo> controlsSettings;
+  ActivityVector<SettingInfo> systemSettings;
+  const ActivityVector<SettingInfo>* currentSettings = nullptr;
 
   static constexpr int categoryCount = 4;
   static const StrId categoryNames[categoryCount];
@@ -0,0 +1,543 @@
+#include "BenchmarkActivity.h"
+
+#include <AllocProfile.h>
+#include <Epub/Page.h>
+#include <Epub/Section.h>
+#include <Epub/hyphenation/HyphenationCommon.h>
+#include <Epub/hyphenation/LanguageRegistry.h>
+#include <GfxRenderer.h>
+#include <HalPowerManager.h>
+#include <HalStorage.h>
+#include <I18n.h>
+#include <Logging.h>
+#include <Xtc.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "CrossPointSettings.h"
+#include "MappedInputManager.h"
+#include "activities/reader/EpubReaderActivity.h"
+#include "activities/reader/XtcPageBlitter.h"
+#include "components/UITheme.h"
+#include "fontIds.h"
+
+namespace {
+constexpr int MAX_CSV_RUNS = 1000;
+
+// Result only keeps the suite name's pointer, so each hyphenation language has its literal here
+struct HyphenationSuite {
+  const char* tag;
+  const char* suite;
+};
+constexpr HyphenationSuite HYPH_SUITES[] = {{"en", "hyph.en"}, {"fr", "hyph.fr"}, {"de", "hyph.de"}, {"ru", "hyph.ru"},
+                                            {"es", "hyph.es"}, {"it", "hyph.it"}, {"uk", "hyph.uk"}};
+
+uint32_t elapsedSince(const uint32_t startUs) { return micros() - startUs; }
+}  // namespace
+
+void BenchmarkActivity::Result::add(const uint32_t elapsedUs) {
+  runs++;
+  totalUs += elapsedUs;
+  maxUs = std::max(maxUs, elapsedUs);
+  minFreeHeap = std::min<uint32_t>(minFreeHeap, ESP.getFreeHeap());
+  minMaxAlloc = std::min<uint32_t>(minMaxAlloc, ESP.getMaxAllocHeap());
+}
+
+void BenchmarkActivity::onEnter() {
+  Activity::onEnter();
+
+  state = STARTING;
+  results.clear();
+  notes.clear();
+  csvPath.clear();
+  requestUpdate();
+}
+
+void BenchmarkActivity::loop() {
+  if (state == STARTING) {
+    // Show the running screen before the suites take over the display
+    {
+      RenderLock lock(*this);
+      state = RUNNING;
+    }
+    requestUpdateAndWait();
+
+    runSuites();
+    writeCsv();
+
+    {
+      RenderLock lock(*this);
+      state = DONE;
+    }
+    requestUpdate();
+    return;
+  }
+
+  if (state == DONE && mappedInput.wasPressed(MappedInputManager::Button::Back)) {
+    finish();
+  }
+}
+
+void BenchmarkActivity::runSuites() {
+  HalPowerManager::Lock powerLock;
+  // The suites draw straight into the frame buffer, keep the render task out until they are done
+  RenderLock lock(*this);
+
+  params = EpubReaderActivity::getLayoutParams(renderer);
+  EpubReaderActivity::applyReaderOrientation(renderer, SETTINGS.orientation);
+  int marginRight, marginBottom;
+  renderer.getOrientedViewableTRBL(&marginTop, &marginRight, &marginBottom, &marginLeft);
+  marginTop += SETTINGS.screenMargin;
+  marginLeft += SETTINGS.screenMargin;
+
+  const std::string epubPath = std::string(BENCH_DIR) + "/bench.epub";
+  if (Storage.exists(epubPath.c_str())) {
+    runSdRead(epubPath);
+    runEpubSuites(epubPath);
+  } else {
+    notes.emplace_back("No bench.epub, EPUB suites skipped");
+  }
+
+  std::string xtcPath = std::string(BENCH_DIR) + "/bench.xtc";
+  if (!Storage.exists(xtcPath.c_str())) {
+    xtcPath += "h";
+  }
+  if (Storage.exists(xtcPath.c_str())) {
+    runXtcSweep(xtcPath);
+  } else {
+    notes.emplace_back("No bench.xtc, XTC sweep skipped");
+  }
+
+  runHyphenation();
+
+  renderer.setOrientation(GfxRenderer::Orientation::Portrait);
+}
+
+void BenchmarkActivity::runSdRead(const std::string& path) {
+  FsFile file;
+  if (!Storage.openFileForRead("BENCH", path, file)) {
+    notes.emplace_back("sd.read: open failed");
+    return;
+  }
+  auto* chunk = static_cast<uint8_t*>(malloc(SD_READ_CHUNK));
+  if (!chunk) {
+    file.close();
+    notes.emplace_back("sd.read: out of memory");
+    return;
+  }
+
+  Result result("sd.read");
+  size_t total = 0;
+  while (total < SD_READ_LIMIT) {
+    const uint32_t start = micros();
+    const int read = file.read(chunk, SD_READ_CHUNK);
+    if (read <= 0) {
+      break;
+    }
+    result.add(elapsedSince(start));
+    total += read;
+  }
+  free(chunk);
+  file.close();
+  results.push_back(result);
+}
+
+bool BenchmarkActivity::loadOrBuildSection(Section& section) const {
+  return section.loadSectionFile(params.fontId, params.lineCompression, params.extraParagraphSpacing,
+                                 params.paragraphAlignment, params.viewportWidth, params.viewportHeight,
+                                 params.hyphenationEnabled, params.embeddedStyle) ||
+         section.createSectionFile(params.fontId, params.lineCompression, params.extraParagraphSpacing,
+                                   params.paragraphAlignment, params.viewportWidth, params.viewportHeight,
+                                   params.hyphenationEnabled, params.embeddedStyle);
+}
+
+// Same passes as the reader's page render, minus the status bar and the page-ahead cache
+void BenchmarkActivity::renderPage(const Page& page, const bool antiAliased) {
+  page.prefetchGlyphs(renderer, params.fontId);
+  renderer.clearScreen();
+  page.render(renderer, params.fontId, marginLeft, marginTop);
+  renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+  if (!antiAliased) {
+    return;
+  }
+
+  renderer.storeBwBuffer();
+  if (!page.hasImages() && renderer.beginGrayscalePlanes()) {
+    page.render(renderer, params.fontId, marginLeft, marginTop);
+    renderer.endGrayscalePlanes();
+  } else {
+    renderer.clearScreen(0x00);
+    renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
+    page.render(renderer, params.fontId, marginLeft, marginTop);
+    renderer.copyGrayscaleLsbBuffers();
+    renderer.clearScreen(0x00);
+    renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
+    page.render(renderer, params.fontId, marginLeft, marginTop);
+    renderer.copyGrayscaleMsbBuffers();
+  }
+  renderer.displayGrayBuffer();
+  renderer.setRenderMode(GfxRenderer::BW);
+  renderer.restoreBwBuffer();
+}
+
+void BenchmarkActivity::runEpubSuites(const std::string& path) {
+  Result open("epub.open");
+  const auto epub = std::make_shared<Epub>(path, "/.crosspoint");
+  const uint32_t openStart = micros();
+  if (!epub->load(true, false) || epub->getSpineItemsCount() == 0) {
+    notes.emplace_back("bench.epub failed to load");
+    return;
+  }
+  open.add(elapsedSince(openStart));
+  results.push_back(open);
+
+  // The largest chapter is the indexing worst case and has the most pages to turn
+  int spineIndex = 0;
+  size_t largest = 0;
+  for (int i = 0; i < epub->getSpineItemsCount(); i++) {
+    const size_t size = epub->getCumulativeSpineItemSize(i) - (i > 0 ? epub->getCumulativeSpineItemSize(i - 1) : 0);
+    if (size > largest) {
+      largest = size;
+      spineIndex = i;
+    }
+  }
+
+  Section section(epub, spineIndex, renderer);
+  Result index("index");
+  for (int run = 0; run < INDEX_RUNS; run++) {
+    section.clearCache();
+    const uint32_t start = micros();
+    if (!section.createSectionFile(params.fontId, params.lineCompression, params.extraParagraphSpacing,
+                                   params.paragraphAlignment, params.viewportWidth, params.viewportHeight,
+                                   params.hyphenationEnabled, params.embeddedStyle)) {
+      notes.emplace_back("index: section build failed");
+      return;
+    }
+    index.add(elapsedSince(start));
+  }
+  results.push_back(index);
+  LOG_INF("BENCH", "Indexed spine %d: %u pages", spineIndex, section.pageCount);
+  if (section.pageCount == 0) {
+    notes.emplace_back("index: chapter has no pages");
+    return;
+  }
+
+  // A turn is what the reader does for a page that isn't cached: load, lay out the glyphs, draw, refresh
+  Result next("turn.next");
+  Result prev("turn.prev");
+  for (int turn = 0; turn < PAGE_TURNS * 2; turn++) {
+    const bool forward = turn < PAGE_TURNS;
+    const int step = turn % section.pageCount;
+    const int pageIndex = forward ? step : section.pageCount - 1 - step;
+    const uint32_t start = micros();
+    const auto page = section.loadPageFromSectionFile(pageIndex);
+    if (!page) {
+      notes.emplace_back("turn: page load failed");
+      return;
+    }
+    renderPage(*page, false);
+    (forward ? next : prev).add(elapsedSince(start));
+  }
+  results.push_back(next);
+  results.push_back(prev);
+
+  Result aaOff("aa.off");
+  Result aaOn("aa.on");
+  for (int pageIndex = 0; pageIndex < std::min<int>(AA_PAGES, section.pageCount); pageIndex++) {
+    const auto page = section.loadPageFromSectionFile(pageIndex);
+    if (!page) {
+      continue;
+    }
+    uint32_t start = micros();
+    renderPage(*page, false);
+    aaOff.add(elapsedSince(start));
+    start = micros();
+    renderPage(*page, true);
+    aaOn.add(elapsedSince(start));
+  }
+  results.push_back(aaOff);
+  results.push_back(aaOn);
+
+  runImagePages(epub);
+}
+
+void BenchmarkActivity::runImagePages(const std::shared_ptr<Epub>& epub) {
+  // Collect up to IMAGE_RENDERS image pages, in reading order, then render them round robin
+  struct PageRef {
+    int spineIndex;
+    int pageIndex;
+  };
+  std::vector<PageRef> imagePages;
+  for (int spineIndex = 0; spineIndex < epub->getSpineItemsCount(); spineIndex++) {
+    if (imagePages.size() >= IMAGE_RENDERS) {
+      break;
+    }
+    Section section(epub, spineIndex, renderer);
+    if (!loadOrBuildSection(section)) {
+      continue;
+    }
+    for (int pageIndex = 0; pageIndex < section.pageCount && imagePages.size() < IMAGE_RENDERS; pageIndex++) {
+      const auto page = section.loadPageFromSectionFile(pageIndex);
+      if (page && page->hasImages()) {
+        imagePages.push_back({spineIndex, pageIndex});
+      }
+    }
+  }
+  if (imagePages.empty()) {
+    notes.emplace_back("No image pages, image suite skipped");
+    return;
+  }
+
+  Result result("image");
+  std::unique_ptr<Section> section;
+  int sectionSpine = -1;
+  for (size_t render = 0; render < IMAGE_RENDERS; render++) {
+    const PageRef& ref = imagePages[render % imagePages.size()];
+    const uint32_t start = micros();
+    // Crossing into another chapter opens its section, as a page turn across a chapter boundary would
+    if (sectionSpine != ref.spineIndex) {
+      section.reset(new Section(epub, ref.spineIndex, renderer));
+      sectionSpine = ref.spineIndex;
+      if (!loadOrBuildSection(*section)) {
+        notes.emplace_back("image: section load failed");
+        return;
+      }
+    }
+    const auto page = section->loadPageFromSectionFile(ref.pageIndex);
+    if (!page) {
+      notes.emplace_back("image: page load failed");
+      return;
+    }
+    renderPage(*page, SETTINGS.textAntiAliasing);
+    result.add(elapsedSince(start));
+  }
+  results.push_back(result);
+}
+
+void BenchmarkActivity::runXtcSweep(const std::string& path) {
+  const auto xtc = std::make_shared<Xtc>(path, "/.crosspoint");
+  if (!xtc->load() || xtc->getPageCount() == 0) {
+    notes.emplace_back("bench.xtc failed to load");
+    return;
+  }
+  const uint16_t pageWidth = xtc->getPageWidth();
+  const uint16_t pageHeight = xtc->getPageHeight();
+  const uint8_t bitDepth = xtc->getBitDepth();
+  const size_t pageSize = bitDepth == 2 ? ((static_cast<size_t>(pageWidth) * pageHeight + 7) / 8) * 2
+                                        : ((pageWidth + 7) / 8) * static_cast<size_t>(pageHeight);
+  auto* buffer = static_cast<uint8_t*>(malloc(pageSize));
+  if (!buffer) {
+    notes.emplace_back("xtc: out of memory");
+    return;
+  }
+
+  // XTC pages are drawn in the portrait frame they were rendered for
+  renderer.setOrientation(GfxRenderer::Orientation::Portrait);
+  const bool blit = XtcPageBlitter::fillsScreen(renderer, pageWidth, pageHeight);
+  if (!blit) {
+    notes.emplace_back("xtc: pages don't fill the screen, only loads timed");
+  }
+
+  Result load("xtc.load");
+  Result show("xtc.show");
+  for (uint32_t pageIndex = 0; pageIndex < std::min(XTC_SWEEP_PAGES, xtc->getPageCount()); pageIndex++) {
+    uint32_t start = micros();
+    if (xtc->loadPage(pageIndex, buffer, pageSize) == 0) {
+      notes.emplace_back("xtc: page load failed");
+      break;
+    }
+    load.add(elapsedSince(start));
+    if (blit) {
+      start = micros();
+      XtcPageBlitter::blit(renderer, buffer, bitDepth, GfxRenderer::BW);
+      renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+      show.add(elapsedSince(start));
+    }
+  }
+  free(buffer);
+  results.push_back(load);
+  if (show.runs > 0) {
+    results.push_back(show);
+  }
+}
+
+// Times the Liang engine alone, one result per pass over a word list. In the alloc_profile build each language's
+// session also logs the engine's allocations under "hyph.liang".
+void BenchmarkActivity::runHyphenation() {
+  auto* text = static_cast<char*>(malloc(HYPH_WORDS_BYTES));
+  if (!text) {
+    notes.emplace_back("hyph: out of memory");
+    return;
+  }
+
+  bool anyList = false;
+  for (const HyphenationSuite& language : HYPH_SUITES) {
+    const LanguageHyphenator* hyphenator = getLanguageHyphenatorForPrimaryTag(language.tag);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/hyph-%s.txt", BENCH_DIR, language.tag);
+    if (!hyphenator || !Storage.exists(path)) {
+      continue;
+    }
+    anyList = true;
+
+    size_t length = Storage.readFileToBuffer(path, text, HYPH_WORDS_BYTES);
+    if (length == HYPH_WORDS_BYTES - 1) {
+      // Longer than the buffer, drop the line that got cut off
+      while (length > 0 && text[length - 1] != '\n') {
+        length--;
+      }
+    }
+    // Pack the words to the front of the buffer, each null-terminated: one per line, anything after a '|' dropped
+    char* end = text;
+    for (size_t pos = 0; pos < length;) {
+      const size_t lineEnd = std::find(text + pos, text + length, '\n') - text;
+      size_t wordEnd = std::find(text + pos, text + lineEnd, '|') - text;
+      while (wordEnd > pos && (text[wordEnd - 1] == '\r' || text[wordEnd - 1] == ' ')) {
+        wordEnd--;
+      }
+      if (wordEnd > pos && text[pos] != '#') {
+        memmove(end, text + pos, wordEnd - pos);
+        end += wordEnd - pos;
+        *end++ = '\0';
+      }
+      pos = lineEnd + 1;
+    }
+    if (end == text) {
+      notes.emplace_back(std::string(language.suite) + ": no words");
+      continue;
+    }
+
+    hyphenator->prepare();
+    Result result(language.suite);
+    uint32_t words = 0;
+    {
+      ALLOC_SESSION(language.suite);
+      for (int pass = 0; pass < HYPH_PASSES; pass++) {
+        uint32_t passUs = 0;
+        for (const char* word = text; word < end; word += strlen(word) + 1) {
+          auto cps = collectCodepoints(word);
+          trimSurroundingPunctuationAndFootnote(cps);
+          const uint32_t start = micros();
+          {
+            ALLOC_SCOPE("hyph.liang");
+            hyphenator->breakIndexes(cps);
+          }
+          passUs += elapsedSince(start);
+          if (pass == 0) {
+            words++;
+          }
+        }
+        result.add(passUs);
+      }
+    }
+    results.push_back(result);
+
+    char note[64];
+    snprintf(note, sizeof(note), "%s: %lu words, %lu words/s", language.suite, static_cast<unsigned long>(words),
+             static_cast<unsigned long>(result.totalUs ? words * 1000000ULL * HYPH_PASSES / result.totalUs : 0));
+    notes.emplace_back(note);
+  }
+  free(text);
+
+  if (!anyList) {
+    notes.emplace_back("No hyph-<tag>.txt, hyphenation suites skipped");
+  }
+}
+
+std::string BenchmarkActivity::configSummary() const {
+  char summary[96];
+  snprintf(summary, sizeof(summary), "font=%d aa=%u hyph=%d orient=%u margin=%u align=%u css=%d", params.fontId,
+           SETTINGS.textAntiAliasing, params.hyphenationEnabled, SETTINGS.orientation, SETTINGS.screenMargin,
+           params.paragraphAlignment, params.embeddedStyle);
+  return summary;
+}
+
+void BenchmarkActivity::writeCsv() {
+  Storage.mkdir(BENCH_DIR);
+  char path[64];
+  int run = 1;
+  for (; run < MAX_CSV_RUNS; run++) {
+    snprintf(path, sizeof(path), "%s/run_%03d.csv", BENCH_DIR, run);
+    if (!Storage.exists(path)) {
+      break;
+    }
+  }
+  FsFile file;
+  if (run == MAX_CSV_RUNS || !Storage.openFileForWrite("BENCH", path, file)) {
+    notes.emplace_back("Could not write the CSV");
+    return;
+  }
+
+  // One self-describing row per suite, so runs from different devices can simply be concatenated
+  const std::string config = configSummary();
+  file.print("firmware,config,suite,runs,total_ms,avg_ms,max_ms,min_free_heap,min_max_alloc\n");
+  for (const Result& result : results) {
+    if (result.runs == 0) {
+      continue;
+    }
+    char row[192];
+    snprintf(row, sizeof(row), "%s,%s,%s,%lu,%.1f,%.2f,%.2f,%lu,%lu\n", CROSSPOINT_VERSION, config.c_str(),
+             result.suite, static_cast<unsigned long>(result.runs), result.totalUs / 1000.0,
+             result.totalUs / 1000.0 / result.runs, result.maxUs / 1000.0,
+             static_cast<unsigned long>(result.minFreeHeap), static_cast<unsigned long>(result.minMaxAlloc));
+    file.print(row);
+    LOG_INF("BENCH", "%s", row);
+  }
+  file.close();
+  csvPath = path;
+}
+
+void BenchmarkActivity::render(RenderLock&&) {
+  const auto& metrics = UITheme::getInstance().getMetrics();
+  const auto pageWidth = renderer.getScreenWidth();
+  const auto pageHeight = renderer.getScreenHeight();
+
+  renderer.clearScreen();
+  GUI.drawHeader(renderer, Rect{0, metrics.topPadding, pageWidth, metrics.headerHeight}, "Benchmark");
+
+  if (state != DONE) {
+    renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2, "Running, the screen will flash...", true,
+                              EpdFontFamily::BOLD);
+    renderer.displayBuffer();
+    return;
+  }
+
+  const int lineHeight = renderer.getLineHeight(UI_10_FONT_ID) + 4;
+  const int columns[] = {metrics.contentSidePadding, pageWidth / 3, pageWidth / 2, pageWidth * 3 / 4};
+  int y = metrics.topPadding + metrics.headerHeight + metrics.verticalSpacing;
+  const char* headings[] = {"Suite", "Avg ms", "Max ms", "Min free"};
+  for (int column = 0; column < 4; column++) {
+    renderer.drawText(UI_10_FONT_ID, columns[column], y, headings[column], true, EpdFontFamily::BOLD);
+  }
+  y += lineHeight;
+
+  char cell[24];
+  for (const Result& result : results) {
+    if (result.runs == 0) {
+      continue;
+    }
+    renderer.drawText(UI_10_FONT_ID, columns[0], y, result.suite);
+    snprintf(cell, sizeof(cell), "%.1f", result.totalUs / 1000.0 / result.runs);
+    renderer.drawText(UI_10_FONT_ID, columns[1], y, cell);
+    snprintf(cell, sizeof(cell), "%.1f", result.maxUs / 1000.0);
+    renderer.drawText(UI_10_FONT_ID, columns[2], y, cell);
+    snprintf(cell, sizeof(cell), "%luK", static_cast<unsigned long>(result.minFreeHeap / 1024));
+    renderer.drawText(UI_10_FONT_ID, columns[3], y, cell);
+    y += lineHeight;
+  }
+
+  y += lineHeight / 2;
+  for (const std::string& note : notes) {
+    renderer.drawText(UI_10_FONT_ID, columns[0], y, note.c_str());
+    y += lineHeight;
+  }
+  if (!csvPath.empty()) {
+    renderer.drawText(UI_10_FONT_ID, columns[0], y, ("Saved to " + csvPath).c_str());
+  }
+
+  const auto labels = mappedInput.mapLabels(tr(STR_BACK), "", "", "");
+  GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
+  renderer.displayBuffer();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Epub.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "activities/Activity.h"
+#include "activities/reader/SectionPrefetcher.h"
+
+class Page;
+class Section;
+
+// Hidden debug screen (serial CMD:BENCH) that runs fixed suites against the books in /.crosspoint/bench/: SD read
+// throughput, indexing the largest chapter of bench.epub, page turns forward and back, image pages, a page with and
+// without anti-aliasing, a page sweep of bench.xtc (or bench.xtch), and hyphenation throughput over the word lists
+// hyph-<tag>.txt (e.g. hyph-de.txt; one word per line, so test/hyphenation_eval's test data can be copied as is).
+// The same files on every card give numbers that compare across SD cards, settings and firmware builds. Results are
+// shown on screen and appended as a new run_NNN.csv next to the books. Suites whose book is missing are skipped.
+class BenchmarkActivity final : public Activity {
+ public:
+  explicit BenchmarkActivity(GfxRenderer& renderer, MappedInputManager& mappedInput)
+      : Activity("Benchmark", renderer, mappedInput) {}
+
+  void onEnter() override;
+  void loop() override;
+  void render(RenderLock&&) override;
+  bool preventAutoSleep() override { return state == RUNNING; }
+  bool skipLoopDelay() override { return state == RUNNING; }
+
+ private:
+  struct Result {
+    const char* suite;
+    uint32_t runs = 0;
+    uint64_t totalUs = 0;
+    uint32_t maxUs = 0;
+    uint32_t minFreeHeap = UINT32_MAX;
+    uint32_t minMaxAlloc = UINT32_MAX;
+
+    explicit Result(const char* suite) : suite(suite) {}
+    void add(uint32_t elapsedUs);
+  };
+
+  enum State { STARTING, RUNNING, DONE };
+
+  static constexpr char BENCH_DIR[] = "/.crosspoint/bench";
+  static constexpr int INDEX_RUNS = 3;
+  static constexpr int PAGE_TURNS = 100;  // In each direction
+  static constexpr size_t IMAGE_RENDERS = 20;
+  static constexpr int AA_PAGES = 10;
+  static constexpr uint32_t XTC_SWEEP_PAGES = 50;
+  static constexpr size_t SD_READ_CHUNK = 4096;
+  static constexpr size_t SD_READ_LIMIT = 2 * 1024 * 1024;
+  static constexpr size_t HYPH_WORDS_BYTES = 16 * 1024;  // Of each word list, about 1500 words
+  static constexpr int HYPH_PASSES = 5;
+
+  State state = STARTING;
+  std::vector<Result> results;
+  std::vector<std::string> notes;  // Skipped suites and failures, shown under the results
+  std::string csvPath;
+
+  SectionPrefetcher::LayoutParams params;
+  int marginTop = 0;
+  int marginLeft = 0;
+
+  void runSuites();
+  void runSdRead(const std::string& path);
+  void runEpubSuites(const std::string& path);
+  void runImagePages(const std::shared_ptr<Epub>& epub);
+  void runXtcSweep(const std::string& path);
+  void runHyphenation();
+  bool loadOrBuildSection(Section& section) const;
+  void renderPage(const Page& page, bool antiAliased);
+  void writeCsv();
+  std::string configSummary() const;
+};
@@ -75,11 +75,11 @@ std::string UITheme::getCoverThumbPath(std::string coverBmpPath, int coverHeight
 }
 
 UIIcon UITheme::getFileIcon(std::string filename) {
-  if (filename.back() == '/') {
+  if (!filename.empty() && filename.back() == '/') {
     return Folder;
   }
   if (StringUtils::checkFileExtension(filename, ".epub") || StringUtils::checkFileExtension(filename, ".xtch") ||
-      StringUtils::checkFileExtension(filename, ".xtc")) {
+      StringUtils::checkFileExtension(filename, ".xtc") || StringUtils::checkFileExtension(filename, ".fb2")) {
     return Book;
   }
   if (StringUtils::checkFileExtension(filename, ".txt") || StringUtils::checkFileExtension(filename, ".md")) {
@@ -5,6 +5,7 @@
 #include <HalStorage.h>
 #include <Logging.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 
@@ -625,7 +626,36 @@ void BaseTheme::fillPopupProgress(const GfxRenderer& renderer, const Rect& layou
 
   renderer.fillRect(barX, barY, fillWidth, barHeight, true);
 
-  renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+  renderer.displayBuffer();
+}
+
+// Where drawStatusBar() puts the battery
+Rect BaseTheme::statusBarBatteryRect(const GfxRenderer& renderer, const int paddingBottom) {
+  const auto metrics = UITheme::getInstance().getMetrics();
+  int orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft;
+  renderer.getOrientedViewableTRBL(&orientedMarginTop, &orientedMarginRight, &orientedMarginBottom,
+                                   &orientedMarginLeft);
+  const int textY =
+      renderer.getScreenHeight() - UITheme::getInstance().getStatusBarHeight() - orientedMarginBottom - paddingBottom - 4;
+  return Rect{metrics.statusBarHorizontalMargin + orientedMarginLeft + 1, textY, metrics.batteryWidth,
+              metrics.batteryHeight};
+}
+
+void BaseTheme::refreshStatusBarBattery(GfxRenderer& renderer, const int paddingBottom) const {
+  if (!SETTINGS.statusBarBattery) {
+    return;
+  }
+  const bool showPercentage =
+      SETTINGS.hideBatteryPercentage == CrossPointSettings::HIDE_BATTERY_PERCENTAGE::HIDE_NEVER;
+  const Rect rect = statusBarBatteryRect(renderer, paddingBottom);
+  // Icon, and the percentage beside it at its widest
+  const int width =
+      rect.width + (showPercentage ? batteryPercentSpacing + renderer.getTextWidth(SMALL_FONT_ID, "100%") : 0) + 1;
+  const int height = std::max(renderer.getTextHeight(SMALL_FONT_ID), rect.height + 6);
+
+  renderer.fillRect(rect.x, rect.y, width, height, false);
+  GUI.drawBatteryLeft(renderer, rect, showPercentage);
+  renderer.displayWindow(rect.x, rect.y, width, height);
 }
 
 void BaseTheme::drawStatusBar(GfxRenderer& renderer, const float bookProgress, const int currentPage,
@@ -681,10 +711,7 @@ void BaseTheme::drawStatusBar(GfxRenderer& renderer, const float bookProgress, c
   const bool showBatteryPercentage =
       SETTINGS.hideBatteryPercentage == CrossPointSettings::HIDE_BATTERY_PERCENTAGE::HIDE_NEVER;
   if (SETTINGS.statusBarBattery) {
-    GUI.drawBatteryLeft(renderer,
-                        Rect{metrics.statusBarHorizontalMargin + orientedMarginLeft + 1, textY, metrics.batteryWidth,
-                             metrics.batteryHeight},
-                        showBatteryPercentage);
+    GUI.drawBatteryLeft(renderer, statusBarBatteryRect(renderer, paddingBottom), showBatteryPercentage);
   }
 
   // Draw Title
@@ -704,16 +731,32 @@ void BaseTheme::drawStatusBar(GfxRenderer& renderer, const float bookProgress, c
     int titleMarginLeftAdjusted = std::max(titleMarginLeft, titleMarginRight);
     int availableTitleSpace = rendererableScreenWidth - 2 * titleMarginLeftAdjusted;
 
-    int titleWidth;
-    titleWidth = renderer.getTextWidth(SMALL_FONT_ID, title.c_str());
+    // The same title is drawn on every page of a chapter, so remember its measurement and truncation
+    static std::string lastTitle;
+    static int lastTitleWidth = 0;
+    static std::string lastTruncated;
+    static int lastTruncatedSpace = -1;
+    static int lastTruncatedWidth = 0;
+    if (title != lastTitle) {
+      lastTitle = title;
+      lastTitleWidth = renderer.getTextWidth(SMALL_FONT_ID, title.c_str());
+      lastTruncatedSpace = -1;
+    }
+
+    int titleWidth = lastTitleWidth;
     if (titleWidth > availableTitleSpace) {
       // Not enough space to center on the screen, center it within the remaining space instead
       availableTitleSpace = rendererableScreenWidth - titleMarginLeft - titleMarginRight;
       titleMarginLeftAdjusted = titleMarginLeft;
     }
     if (titleWidth > availableTitleSpace) {
-      title = renderer.truncatedText(SMALL_FONT_ID, title.c_str(), availableTitleSpace);
-      titleWidth = renderer.getTextWidth(SMALL_FONT_ID, title.c_str());
+      if (availableTitleSpace != lastTruncatedSpace) {
+        lastTruncatedSpace = availableTitleSpace;
+        lastTruncated = renderer.truncatedText(SMALL_FONT_ID, title.c_str(), availableTitleSpace);
+        lastTruncatedWidth = renderer.getTextWidth(SMALL_FONT_ID, lastTruncated.c_str());
+      }
+      title = lastTruncated;
+      titleWidth = lastTruncatedWidth;
     }
 
     renderer.drawText(SMALL_FONT_ID,
@@ -138,7 +138,13 @@ class BaseTheme {
   virtual void drawStatusBar(GfxRenderer& renderer, const float bookProgress, const int currentPage,
                              const int pageCount, std::string title, const int paddingBottom = 0,
                              const int textYOffset = 0) const;
+  // Redraw only the battery of the status bar on screen and refresh that corner of the panel, for a battery reading
+  // that changed while the page stayed up. The frame buffer must still hold the page.
+  virtual void refreshStatusBarBattery(GfxRenderer& renderer, int paddingBottom = 0) const;
   virtual void drawHelpText(const GfxRenderer& renderer, Rect rect, const char* label) const;
   virtual void drawTextField(const GfxRenderer& renderer, Rect rect, const int textWidth) const;
   virtual void drawKeyboardKey(const GfxRenderer& renderer, Rect rect, const char* label, const bool isSelected) const;
+
+ protected:
+  static Rect statusBarBatteryRect(const GfxRenderer& renderer, int paddingBottom);
 };
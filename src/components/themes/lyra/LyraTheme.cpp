@@ -582,7 +582,7 @@ void LyraTheme::fillPopupProgress(const GfxRenderer& renderer, const Rect& layou
 
   renderer.fillRect(barX, barY, fillWidth, barHeight, false);
 
-  renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+  renderer.displayBuffer();
 }
 
 void LyraTheme::drawTextField(const GfxRenderer& renderer, Rect rect, const int textWidth) const {
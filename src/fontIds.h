@@ -1,6 +1,15 @@
 // The contents of this file are generated by ./lib/EpdFont/scripts/build-font-ids.sh
 #pragma once
 
+// Reader fonts, full or the subset the build selects (see builtinFonts/all.h). The IDs differ, so section caches
+// laid out with one set of glyphs are never reused with another.
+#if defined(FONT_SUBSET_LATIN)
+#include <builtinFonts/subsets/latin/fontIds.h>
+#elif defined(FONT_SUBSET_CYRILLIC)
+#include <builtinFonts/subsets/cyrillic/fontIds.h>
+#elif defined(FONT_SUBSET_VIETNAMESE)
+#include <builtinFonts/subsets/vietnamese/fontIds.h>
+#else
 #define BOOKERLY_12_FONT_ID (-1905494168)
 #define BOOKERLY_14_FONT_ID (1233852315)
 #define BOOKERLY_16_FONT_ID (1588566790)
@@ -13,6 +22,8 @@
 #define OPENDYSLEXIC_10_FONT_ID (-1374689004)
 #define OPENDYSLEXIC_12_FONT_ID (-795539541)
 #define OPENDYSLEXIC_14_FONT_ID (-1676627620)
+#endif
+
 #define UI_10_FONT_ID (-1246724383)
 #define UI_12_FONT_ID (-359249323)
 #define SMALL_FONT_ID (1073217904)
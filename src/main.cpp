@@ -1,6 +1,10 @@
+#include <AllocProfile.h>
 #include <Arduino.h>
+#include <BufferPool.h>
+#include <CpuProfile.h>
 #include <Epub.h>
 #include <FontDecompressor.h>
+#include <FrameCapture.h>
 #include <GfxRenderer.h>
 #include <HalDisplay.h>
 #include <HalGPIO.h>
@@ -9,21 +13,25 @@
 #include <I18n.h>
 #include <Logging.h>
 #include <SPI.h>
+#include <Trace.h>
 #include <builtinFonts/all.h>
 
 #include <cstring>
 
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
-#include "KOReaderCredentialStore.h"
 #include "MappedInputManager.h"
+#include "ProgressJournal.h"
 #include "RecentBooksStore.h"
+#include "SdFontStore.h"
 #include "activities/Activity.h"
 #include "activities/ActivityManager.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
+#include "network/SyncQueueFlusher.h"
 #include "util/ButtonNavigator.h"
 #include "util/ScreenshotUtil.h"
+#include "util/WakeFrame.h"
 
 HalDisplay display;
 HalGPIO gpio;
@@ -125,6 +133,22 @@ EpdFontFamily ui12FontFamily(&ui12RegularFont, &ui12BoldFont);
 unsigned long t1 = 0;
 unsigned long t2 = 0;
 
+// Logs the time spent in each boot step since the previous one, so a slow subsystem shows up in the serial log
+class BootTimer {
+ public:
+  BootTimer() : last(millis()), start(last) {}
+  void step(const char* name) {
+    const unsigned long now = millis();
+    LOG_DBG("BOOT", "%s: %lu ms", name, now - last);
+    last = now;
+  }
+  void done() const { LOG_DBG("BOOT", "Setup took %lu ms", millis() - start); }
+
+ private:
+  unsigned long last;
+  const unsigned long start;
+};
+
 // Verify power button press duration on wake-up from deep sleep
 // Pre-condition: isWakeupByPowerButton() == true
 void verifyPowerButtonDuration() {
@@ -182,8 +206,16 @@ void enterDeepSleep() {
   HalPowerManager::Lock powerLock;  // Ensure we are at normal CPU frequency for sleep preparation
   APP_STATE.lastSleepFromReader = activityManager.isReaderActivity();
   APP_STATE.saveToFile();
+  if (APP_STATE.lastSleepFromReader && !APP_STATE.openEpubPath.empty()) {
+    // The frame buffer still holds the page being read; the sleep screen is drawn over it next
+    WakeFrame::save(renderer, APP_STATE.openEpubPath);
+  }
 
   activityManager.goToSleep();
+  // The reader flushed its position when it closed; this covers one that didn't get to
+  PROGRESS_JOURNAL.flush();
+  // The sleep screen is up and the reader has queued its position; upload what's pending in one short session
+  SyncQueueFlusher::flushBeforeSleep();
 
   display.deepSleep();
   LOG_DBG("MAIN", "Power button press calibration value: %lu ms", t2 - t1);
@@ -221,14 +253,25 @@ void setupDisplayAndFonts() {
   renderer.insertFont(UI_10_FONT_ID, ui10FontFamily);
   renderer.insertFont(UI_12_FONT_ID, ui12FontFamily);
   renderer.insertFont(SMALL_FONT_ID, smallFontFamily);
+  renderer.enableGlyphAtlas(UI_10_FONT_ID);
+  renderer.enableGlyphAtlas(UI_12_FONT_ID);
+  renderer.enableGlyphAtlas(SMALL_FONT_ID);
   LOG_DBG("MAIN", "Fonts setup");
 }
 
 void setup() {
   t1 = millis();
+  BootTimer bootTimer;
 
   gpio.begin();
-  powerManager.begin();
+  powerManager.begin(gpio);
+
+  // Reserve the slabs for large buffers while the heap is still unfragmented: the streaming inflate window (chapter
+  // streams hold it for a whole section build), one frame for the BW snapshot of gray renders, the home cover or an
+  // XTC page, and two small ones for image cache and TXT read windows. Anything beyond them falls back to malloc.
+  BufferPool::reserve(BufferPool::WINDOW_SLAB, 1);
+  BufferPool::reserve(BufferPool::FRAME_SLAB, 1);
+  BufferPool::reserve(BufferPool::SMALL_SLAB, 2);
 
   // Only start serial if USB connected
   if (gpio.isUsbConnected()) {
@@ -239,6 +282,8 @@ void setup() {
       delay(10);
     }
   }
+  // Sampling profiler (cpu_profile build only), from here on so boot shows up too
+  cpuprof::begin();
 
   // SD Card Initialization
   // We need 6 open files concurrently when parsing a new chapter
@@ -248,12 +293,14 @@ void setup() {
     activityManager.goToFullScreenMessage("SD card error", EpdFontFamily::BOLD);
     return;
   }
+  bootTimer.step("Storage");
 
   SETTINGS.loadFromFile();
   I18N.loadSettings();
-  KOREADER_STORE.loadFromFile();
+  // KOREADER_STORE reads its file on first use
   UITheme::getInstance().reload();
   ButtonNavigator::setMappedInputManager(mappedInputManager);
+  bootTimer.step("Settings");
 
   switch (gpio.getWakeupReason()) {
     case HalGPIO::WakeupReason::PowerButton:
@@ -276,26 +323,38 @@ void setup() {
   // First serial output only here to avoid timing inconsistencies for power button press duration verification
   LOG_DBG("MAIN", "Starting CrossPoint version " CROSSPOINT_VERSION);
 
-  setupDisplayAndFonts();
+  bootTimer.step("Wakeup check");
 
-  activityManager.goToBoot();
+  setupDisplayAndFonts();
+  SD_FONTS.begin(renderer);
+  SD_FONTS.sync();
+  bootTimer.step("Display and fonts");
 
   APP_STATE.loadFromFile();
   RECENT_BOOKS.loadFromFile();
+  PROGRESS_JOURNAL.recover();
+  bootTimer.step("App state");
 
   // Boot to home screen if no book is open, last sleep was not from reader, back button is held, or reader activity
   // crashed (indicated by readerActivityLoadCount > 0)
   if (APP_STATE.openEpubPath.empty() || !APP_STATE.lastSleepFromReader ||
       mappedInputManager.isPressed(MappedInputManager::Button::Back) || APP_STATE.readerActivityLoadCount > 0) {
+    activityManager.goToBoot();
     activityManager.goHome();
   } else {
-    // Clear app state to avoid getting into a boot loop if the epub doesn't load
+    // Waking into a book skips the boot screen: the sleep screen stays up until the saved page replaces it, which
+    // saves a full refresh before the first line of text
     const auto path = APP_STATE.openEpubPath;
+    // Put the page from before sleep back on the panel while the reader loads behind it
+    WakeFrame::show(renderer, path);
+    // Clear app state to avoid getting into a boot loop if the epub doesn't load
     APP_STATE.openEpubPath = "";
     APP_STATE.readerActivityLoadCount++;
     APP_STATE.saveToFile();
     activityManager.goToReader(path);
   }
+  bootTimer.step("First activity");
+  bootTimer.done();
 
   // Ensure we're not still holding the power button before leaving setup
   waitForPowerRelease();
@@ -306,7 +365,7 @@ void loop() {
   const unsigned long loopStartTime = millis();
   static unsigned long lastMemPrint = 0;
 
-  gpio.update();
+  mappedInputManager.update();
 
   renderer.setFadingFix(SETTINGS.fadingFix);
 
@@ -323,19 +382,60 @@ void loop() {
     if (line.startsWith("CMD:")) {
       String cmd = line.substring(4);
       cmd.trim();
+      // Replies are raw output, queued log lines mustn't land in the middle of them
+      LogSerialLock serialLock;
       if (cmd == "SCREENSHOT") {
         logSerial.printf("SCREENSHOT_START:%d\n", HalDisplay::BUFFER_SIZE);
         uint8_t* buf = display.getFrameBuffer();
         logSerial.write(buf, HalDisplay::BUFFER_SIZE);
         logSerial.printf("SCREENSHOT_END\n");
+      } else if (cmd == "CAPTURE") {
+        framecap::start(framecap::SINK_SERIAL);
+      } else if (cmd == "CAPTURE_STOP") {
+        framecap::stop();
+      } else if (cmd == "TRACE") {
+        trace::dump(logSerial);
+      } else if (cmd == "TRACE_CLEAR") {
+        trace::clear();
+      } else if (cmd == "ALLOC") {
+        allocprof::dump(logSerial);
+      } else if (cmd == "PROFILE") {
+        cpuprof::dump(logSerial);
+      } else if (cmd == "PROFILE_CLEAR") {
+        cpuprof::clear();
+      } else if (cmd == "BENCH") {
+        activityManager.goToBenchmark();
+      } else if (cmd == "REC_STOP") {
+        mappedInputManager.stopRecording();
+      } else if (cmd.startsWith("REC ")) {
+        mappedInputManager.startRecording(std::string("/.crosspoint/scripts/") + cmd.substring(4).c_str() + ".txt");
+      } else if (cmd == "PLAY_STOP") {
+        mappedInputManager.stopReplay();
+      } else if (cmd.startsWith("PLAY ")) {
+        // The trace then covers just the scripted run
+        if (mappedInputManager.startReplay(std::string("/.crosspoint/scripts/") + cmd.substring(5).c_str() + ".txt")) {
+          trace::clear();
+        }
+      } else if (cmd == "SDPROFILE") {
+        Storage.measureProfile();
+        const StorageProfile& profile = Storage.profile();
+        logSerial.printf("SD read %u B chunks %u KB/s, %u us random; write %u B chunks %u KB/s, %u us random\n",
+                         profile.readChunk, profile.readKBps, profile.randomReadUs, profile.writeChunk,
+                         profile.writeKBps, profile.randomWriteUs);
       }
     }
   }
 
-  // Check for any user activity (button press or release) or active background work
+  // Check for any user activity (button press or release) or active background work. Only input restores full
+  // speed; background work that needs it holds a HalPowerManager::Lock, and waiting on the network doesn't.
   static unsigned long lastActivityTime = millis();
-  if (gpio.wasAnyPressed() || gpio.wasAnyReleased() || activityManager.preventAutoSleep()) {
-    lastActivityTime = millis();         // Reset inactivity timer
+  static unsigned long lastInputTime = millis();
+  const bool userInput = gpio.wasAnyPressed() || gpio.wasAnyReleased();
+  if (userInput || activityManager.preventAutoSleep()) {
+    lastActivityTime = millis();  // Reset inactivity timer
+  }
+  if (userInput) {
+    lastInputTime = millis();
     powerManager.setPowerSaving(false);  // Restore normal CPU frequency on user activity
   }
 
@@ -371,6 +471,9 @@ void loop() {
     return;
   }
 
+  powerManager.updateBattery(gpio);
+  PROGRESS_JOURNAL.loop();
+
   const unsigned long activityStartTime = millis();
   activityManager.loop();
   const unsigned long activityDuration = millis() - activityStartTime;
@@ -390,10 +493,12 @@ void loop() {
     powerManager.setPowerSaving(false);  // Make sure we're at full performance when skipLoopDelay is requested
     yield();                             // Give FreeRTOS a chance to run tasks, but return immediately
   } else {
-    if (millis() - lastActivityTime >= HalPowerManager::IDLE_POWER_SAVING_MS) {
-      // If we've been inactive for a while, increase the delay to save power
+    if (millis() - lastInputTime >= HalPowerManager::IDLE_POWER_SAVING_MS) {
       powerManager.setPowerSaving(true);  // Lower CPU frequency after extended inactivity
-      delay(50);
+    }
+    if (millis() - lastActivityTime >= HalPowerManager::IDLE_POWER_SAVING_MS) {
+      // If we've been inactive for a while, increase the delay and sleep through it where possible to save power
+      powerManager.idleWait(gpio, 50);
     } else {
       // Short delay to prevent tight loop while still being responsive
       delay(10);
@@ -0,0 +1,271 @@
+#include "CalibreBookIndex.h"
+
+#include <Epub.h>
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+#include <esp_task_wdt.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "util/StringUtils.h"
+
+namespace {
+constexpr char INDEX_FILE[] = "/.crosspoint/calibre_books.bin";
+constexpr char INDEX_TMP_FILE[] = "/.crosspoint/calibre_books.tmp";
+constexpr uint8_t INDEX_VERSION = 1;
+constexpr uint32_t MAX_STRING_LENGTH = 500;
+constexpr uint32_t MAX_ENTRIES = 20000;
+constexpr uint32_t FNV_OFFSET_BASIS = 2166136261u;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+struct Entry {
+  std::string lpath;
+  std::string uuid;
+  uint32_t modified = 0;  // FAT date in the high half, time in the low half
+  uint32_t size = 0;
+};
+
+// Where an entry of the previous index starts, found by the hash of its lpath
+struct Slot {
+  uint32_t hash;
+  uint32_t offset;
+};
+
+uint32_t fnv(const void* data, const size_t length, uint32_t hash = FNV_OFFSET_BASIS) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+uint32_t hashPath(const std::string& lpath) { return fnv(lpath.data(), lpath.size()); }
+
+bool isIndexedBook(const std::string& name) {
+  return StringUtils::checkFileExtension(name, ".epub") || StringUtils::checkFileExtension(name, ".xtch") ||
+         StringUtils::checkFileExtension(name, ".xtc") || StringUtils::checkFileExtension(name, ".txt") ||
+         StringUtils::checkFileExtension(name, ".md") || StringUtils::checkFileExtension(name, ".fb2");
+}
+
+// serialization::readString trusts the length prefix; a torn write must not turn into a huge allocation
+bool readString(FsFile& file, std::string& s) {
+  uint32_t len = 0;
+  serialization::readPod(file, len);
+  if (len > MAX_STRING_LENGTH) {
+    return false;
+  }
+  s.resize(len);
+  return len == 0 || file.read(&s[0], len) == static_cast<int>(len);
+}
+
+bool readEntry(FsFile& file, Entry& entry) {
+  if (!readString(file, entry.lpath) || !readString(file, entry.uuid)) {
+    return false;
+  }
+  serialization::readPod(file, entry.modified);
+  serialization::readPod(file, entry.size);
+  return true;
+}
+
+void writeEntry(FsFile& file, const Entry& entry) {
+  serialization::writeString(file, entry.lpath);
+  serialization::writeString(file, entry.uuid);
+  serialization::writePod(file, entry.modified);
+  serialization::writePod(file, entry.size);
+}
+
+bool openIndex(FsFile& file, uint32_t& count, uint32_t& generation) {
+  if (!Storage.exists(INDEX_FILE) || !Storage.openFileForRead("CBI", INDEX_FILE, file)) {
+    return false;
+  }
+  uint8_t version = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, count);
+  serialization::readPod(file, generation);
+  if (version != INDEX_VERSION || count > MAX_ENTRIES) {
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+// One pass over the previous index to note where each entry starts. 8 bytes per book instead of the entries
+// themselves, so a large library doesn't have to fit in RAM; matches are read back from the file when needed.
+std::vector<Slot> loadSlots(FsFile& file, const uint32_t count) {
+  std::vector<Slot> slots;
+  slots.reserve(count);
+  Entry entry;
+  for (uint32_t i = 0; i < count; i++) {
+    const auto offset = static_cast<uint32_t>(file.position());
+    if (!readEntry(file, entry)) {
+      break;
+    }
+    slots.push_back({hashPath(entry.lpath), offset});
+  }
+  std::sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) { return a.hash < b.hash; });
+  return slots;
+}
+
+// The previous entry for lpath, if it is still accurate for a file of this size and modification time
+bool findUnchanged(FsFile& previous, const std::vector<Slot>& slots, const Entry& current, Entry& match) {
+  const uint32_t hash = hashPath(current.lpath);
+  auto it = std::lower_bound(slots.begin(), slots.end(), hash,
+                             [](const Slot& slot, const uint32_t value) { return slot.hash < value; });
+  for (; it != slots.end() && it->hash == hash; ++it) {
+    if (previous.seekSet(it->offset) && readEntry(previous, match) && match.lpath == current.lpath) {
+      return match.size == current.size && match.modified == current.modified;
+    }
+  }
+  return false;
+}
+
+std::string readUuid(const std::string& path) {
+  if (!StringUtils::checkFileExtension(path, ".epub")) {
+    return "";
+  }
+  Epub epub(path, "/.crosspoint");
+  // Only an existing cache is used; building one here would turn a listing into a library-wide indexing run
+  if (!Storage.exists((epub.getCachePath() + "/book.bin").c_str()) || !epub.load(false, true)) {
+    return "";
+  }
+  return epub.getUuid();
+}
+
+void formatTag(String& etag, const uint32_t generation, const uint32_t count) {
+  char tag[32];
+  snprintf(tag, sizeof(tag), "\"%08lx-%lu\"", static_cast<unsigned long>(generation),
+           static_cast<unsigned long>(count));
+  etag = tag;
+}
+}  // namespace
+
+bool CalibreBookIndex::refresh(String& etag) {
+  const unsigned long start = millis();
+
+  FsFile previous;
+  uint32_t previousCount = 0, previousGeneration = 0;
+  std::vector<Slot> slots;
+  if (openIndex(previous, previousCount, previousGeneration)) {
+    slots = loadSlots(previous, previousCount);
+  }
+
+  FsFile out;
+  Storage.mkdir("/.crosspoint");
+  if (!Storage.openFileForWrite("CBI", INDEX_TMP_FILE, out)) {
+    if (previous) previous.close();
+    return false;
+  }
+  // Placeholder header, rewritten once the count and generation are known
+  serialization::writePod(out, INDEX_VERSION);
+  serialization::writePod(out, static_cast<uint32_t>(0));
+  serialization::writePod(out, static_cast<uint32_t>(0));
+
+  uint32_t count = 0;
+  uint32_t generation = FNV_OFFSET_BASIS;
+  size_t reused = 0;
+  std::vector<std::string> pendingDirs{"/"};
+  char name[500];
+  Entry current, match;
+  while (!pendingDirs.empty() && count < MAX_ENTRIES) {
+    const std::string dir = std::move(pendingDirs.back());
+    pendingDirs.pop_back();
+    FsFile root = Storage.open(dir.c_str());
+    if (!root || !root.isDirectory()) {
+      if (root) root.close();
+      continue;
+    }
+
+    for (auto file = root.openNextFile(); file && count < MAX_ENTRIES; file = root.openNextFile()) {
+      file.getName(name, sizeof(name));
+      // Hidden entries include the /.crosspoint cache itself
+      if (name[0] == '.' || strcmp(name, "System Volume Information") == 0) {
+        file.close();
+        continue;
+      }
+
+      std::string path = dir;
+      if (path.back() != '/') path += '/';
+      path += name;
+
+      if (file.isDirectory()) {
+        pendingDirs.push_back(std::move(path));
+      } else if (isIndexedBook(path)) {
+        uint16_t date = 0, time = 0;
+        file.getModifyDateTime(&date, &time);
+        current.lpath.assign(path, 1, std::string::npos);
+        current.modified = static_cast<uint32_t>(date) << 16 | time;
+        current.size = static_cast<uint32_t>(file.size());
+        // A book indexed before its cache was built is looked at again until it has a uuid
+        if (previous && findUnchanged(previous, slots, current, match) && !match.uuid.empty()) {
+          current.uuid = std::move(match.uuid);
+          reused++;
+        } else {
+          current.uuid = readUuid(path);
+        }
+
+        writeEntry(out, current);
+        generation = fnv(current.lpath.data(), current.lpath.size(), generation);
+        generation = fnv(current.uuid.data(), current.uuid.size(), generation);
+        generation = fnv(&current.modified, sizeof(current.modified), generation);
+        generation = fnv(&current.size, sizeof(current.size), generation);
+        count++;
+      }
+      file.close();
+    }
+    root.close();
+    esp_task_wdt_reset();
+  }
+  if (previous) previous.close();
+
+  const bool ok = out.seekSet(sizeof(INDEX_VERSION));
+  serialization::writePod(out, count);
+  serialization::writePod(out, generation);
+  out.close();
+  if (!ok || (Storage.exists(INDEX_FILE) && !Storage.remove(INDEX_FILE)) ||
+      !Storage.rename(INDEX_TMP_FILE, INDEX_FILE)) {
+    LOG_ERR("CBI", "Failed to replace the book index");
+    Storage.remove(INDEX_TMP_FILE);
+    return false;
+  }
+
+  formatTag(etag, generation, count);
+  LOG_DBG("CBI", "Indexed %lu books (%u unchanged) in %lu ms", static_cast<unsigned long>(count),
+          static_cast<unsigned>(reused), millis() - start);
+  return true;
+}
+
+void CalibreBookIndex::writeJson(ChunkedWriter& out) {
+  out.print('[');
+  FsFile file;
+  uint32_t count = 0, generation = 0;
+  if (openIndex(file, count, generation)) {
+    Entry entry;
+    char modified[32];
+    for (uint32_t i = 0; i < count && readEntry(file, entry); i++) {
+      // FAT keeps local time without a zone; it is reported as UTC, which is what the device clock is set to
+      const auto date = static_cast<uint16_t>(entry.modified >> 16);
+      const auto time = static_cast<uint16_t>(entry.modified);
+      snprintf(modified, sizeof(modified), "%04u-%02u-%02uT%02u:%02u:%02u+00:00", 1980u + (date >> 9),
+               (date >> 5) & 0x0Fu, date & 0x1Fu, time >> 11, (time >> 5) & 0x3Fu, (time & 0x1Fu) * 2);
+
+      if (i > 0) out.print(',');
+      out.print("{\"lpath\":");
+      out.printJsonString(entry.lpath.c_str());
+      out.print(",\"uuid\":");
+      out.printJsonString(entry.uuid.c_str());
+      out.print(",\"last_modified\":\"");
+      out.print(modified);
+      out.print("\",\"size\":");
+      out.printNumber(entry.size);
+      out.print('}');
+      if (i % 64 == 63) esp_task_wdt_reset();
+    }
+    file.close();
+  }
+  out.print(']');
+}
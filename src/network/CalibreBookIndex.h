@@ -0,0 +1,21 @@
+#pragma once
+
+#include <WString.h>
+
+#include "network/ChunkedWriter.h"
+
+// Persistent map from each book's lpath (its path on the card, without the leading slash) to its Calibre uuid,
+// modification time and size, kept in /.crosspoint/calibre_books.bin. The Calibre plugin fetches it in one
+// request and then only sends the books that are missing or changed, instead of comparing the library file by file.
+// A refresh walks the card but reuses every entry whose size and modification time are unchanged; uuids of new
+// or changed EPUBs come from their book.bin, so books whose cache hasn't been built yet are listed without one.
+namespace CalibreBookIndex {
+
+// Bring the index up to date with the card. etag receives a quoted tag that changes whenever any entry does.
+// Returns false if the index can't be written.
+bool refresh(String& etag);
+
+// Stream the index as a JSON array of {"lpath","uuid","last_modified","size"} objects
+void writeJson(ChunkedWriter& out);
+
+}  // namespace CalibreBookIndex
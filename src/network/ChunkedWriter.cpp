@@ -0,0 +1,82 @@
+#include "ChunkedWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+ChunkedWriter::ChunkedWriter(WebServer& server) : server(server) {
+  buffer = static_cast<char*>(malloc(BUFFER_SIZE));
+}
+
+ChunkedWriter::~ChunkedWriter() { free(buffer); }
+
+void ChunkedWriter::print(const char* text, size_t textLength) {
+  if (!buffer) {
+    send(text, textLength);
+    return;
+  }
+
+  while (textLength > 0) {
+    if (length == BUFFER_SIZE) {
+      flush();
+    }
+    const size_t toCopy = std::min(textLength, BUFFER_SIZE - length);
+    memcpy(buffer + length, text, toCopy);
+    length += toCopy;
+    text += toCopy;
+    textLength -= toCopy;
+  }
+}
+
+void ChunkedWriter::print(const char* text) { print(text, strlen(text)); }
+
+void ChunkedWriter::print(const char c) { print(&c, 1); }
+
+void ChunkedWriter::printNumber(const uint64_t value) {
+  char digits[24];
+  const int written = snprintf(digits, sizeof(digits), "%llu", static_cast<unsigned long long>(value));
+  print(digits, written);
+}
+
+void ChunkedWriter::printJsonString(const char* text) {
+  print('"');
+  const char* runStart = text;
+  for (const char* p = text; *p; p++) {
+    const auto c = static_cast<unsigned char>(*p);
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      continue;
+    }
+    print(runStart, p - runStart);
+    if (c == '"' || c == '\\') {
+      const char escaped[2] = {'\\', static_cast<char>(c)};
+      print(escaped, sizeof(escaped));
+    } else {
+      char escaped[7];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      print(escaped, 6);
+    }
+    runStart = p + 1;
+  }
+  print(runStart);
+  print('"');
+}
+
+void ChunkedWriter::send(const char* data, const size_t size) {
+  server.sendContent(data, size);
+  if (tee && !teeError && tee->write(data, size) != size) {
+    teeError = true;
+  }
+}
+
+void ChunkedWriter::flush() {
+  if (buffer && length > 0) {
+    send(buffer, length);
+    length = 0;
+  }
+}
+
+void ChunkedWriter::end() {
+  flush();
+  server.sendContent("");
+}
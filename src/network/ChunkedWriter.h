@@ -0,0 +1,46 @@
+#pragma once
+
+#include <HalStorage.h>
+#include <WebServer.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Coalesces a chunked (CONTENT_LENGTH_UNKNOWN) response into fixed-size chunks. A listing with thousands of
+// entries then goes out as a few dozen socket writes instead of one or two per entry, and nothing per entry is
+// heap allocated. The caller sends the status line and headers first; end() terminates the response.
+class ChunkedWriter {
+ public:
+  static constexpr size_t BUFFER_SIZE = 1024;
+
+  explicit ChunkedWriter(WebServer& server);
+  ~ChunkedWriter();
+
+  ChunkedWriter(const ChunkedWriter&) = delete;
+  ChunkedWriter& operator=(const ChunkedWriter&) = delete;
+
+  void print(const char* text);
+  void print(const char* text, size_t length);
+  void print(char c);
+  void printNumber(uint64_t value);
+  // Quoted JSON string with the required escapes
+  void printJsonString(const char* text);
+
+  // Also append everything sent from now on to file, e.g. to cache a generated response. Pass nullptr to stop.
+  void setTee(FsFile* file) { tee = file; }
+  bool teeFailed() const { return teeError; }
+
+  // Send whatever is buffered as one chunk
+  void flush();
+  // Flush and send the terminating empty chunk
+  void end();
+
+ private:
+  WebServer& server;
+  char* buffer = nullptr;  // Falls back to unbuffered sends if the allocation fails
+  size_t length = 0;
+  FsFile* tee = nullptr;
+  bool teeError = false;
+
+  void send(const char* data, size_t size);
+};
@@ -1,21 +1,34 @@
 #include "CrossPointWebServer.h"
 
 #include <ArduinoJson.h>
+#include <BufferPool.h>
 #include <Epub.h>
+#include <FrameCapture.h>
 #include <FsHelpers.h>
+#include <HalPowerManager.h>
 #include <HalStorage.h>
 #include <Logging.h>
+#include <Metrics.h>
+#include <Trace.h>
 #include <WiFi.h>
 #include <esp_task_wdt.h>
+#include <freertos/task.h>
 
 #include <algorithm>
 
 #include "CrossPointSettings.h"
+#include "SdFontStore.h"
 #include "SettingsList.h"
+#include "CalibreBookIndex.h"
+#include "ChunkedWriter.h"
+#include "FileResponse.h"
 #include "WebDAVHandler.h"
 #include "html/FilesPageHtml.generated.h"
+#include "html/FontsPageHtml.generated.h"
 #include "html/HomePageHtml.generated.h"
 #include "html/SettingsPageHtml.generated.h"
+#include "util/DirectoryListing.h"
+#include "util/LibraryIndex.h"
 #include "util/StringUtils.h"
 
 namespace {
@@ -25,22 +38,62 @@ const char* HIDDEN_ITEMS[] = {"System Volume Information", "XTCache"};
 constexpr size_t HIDDEN_ITEMS_COUNT = sizeof(HIDDEN_ITEMS) / sizeof(HIDDEN_ITEMS[0]);
 constexpr uint16_t UDP_PORTS[] = {54982, 48123, 39001, 44044, 59678};
 constexpr uint16_t LOCAL_UDP_PORT = 8134;
+constexpr uint32_t TASK_STACK_SIZE = 8192;
+constexpr UBaseType_t TASK_PRIORITY = 1;
+// Where test/build_preindex_wasm.sh's output is copied to on the card
+constexpr char PREINDEX_DIR[] = "/.crosspoint/preindex";
+
+bool isHiddenItem(const char* name) {
+  // Items starting with "." are always hidden
+  if (name[0] == '.') {
+    return true;
+  }
+  for (size_t i = 0; i < HIDDEN_ITEMS_COUNT; i++) {
+    if (strcmp(name, HIDDEN_ITEMS[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool hasEpubExtension(const char* name) {
+  const size_t length = strlen(name);
+  return length >= 5 && strcasecmp(name + length - 5, ".epub") == 0;
+}
 
 // Static pointer for WebSocket callback (WebSocketsServer requires C-style callback)
 CrossPointWebServer* wsInstance = nullptr;
 
 // WebSocket upload state
-FsFile wsUploadFile;
+UploadWriter wsUploadWriter;
 String wsUploadFileName;
 String wsUploadPath;
 size_t wsUploadSize = 0;
 size_t wsUploadReceived = 0;
 unsigned long wsUploadStartTime = 0;
 bool wsUploadInProgress = false;
+size_t wsLastProgressSent = 0;
+// Set when a file in a batch fails: its remaining frames are still in flight and are dropped until the next START
+bool wsDiscarding = false;
 String wsLastCompleteName;
 size_t wsLastCompleteSize = 0;
 unsigned long wsLastCompleteAt = 0;
 
+// Uploads finished since begin(), over any transport
+size_t completedUploadCount = 0;
+// Book files received and not yet taken for cache warming, guarded by statusMutex
+std::vector<std::string> uploadedBooks;
+// millis() when upload data last arrived
+std::atomic<unsigned long> lastTransferAt{0};
+// Radio held at full throughput from the first transfer data until the transfer has been quiet this long
+constexpr unsigned long NETWORK_QUIET_MS = 3000;
+std::unique_ptr<HalPowerManager::NetworkTransfer> networkTransfer;
+
+bool isBookFile(const String& path) {
+  return StringUtils::checkFileExtension(path, ".epub") || StringUtils::checkFileExtension(path, ".xtch") ||
+         StringUtils::checkFileExtension(path, ".xtc") || StringUtils::checkFileExtension(path, ".txt");
+}
+
 // Helper function to clear epub cache after upload
 void clearEpubCacheIfNeeded(const String& filePath) {
   // Only clear cache for .epub files
@@ -50,6 +103,19 @@ void clearEpubCacheIfNeeded(const String& filePath) {
   }
 }
 
+// Moving a book keeps its cache (sections, progress, cover) by re-keying it to the new path instead of clearing it
+void moveEpubCacheIfNeeded(const String& fromPath, const String& toPath) {
+  LibraryIndex::bookMoved(fromPath.c_str(), toPath.c_str());
+  if (!StringUtils::checkFileExtension(fromPath, ".epub")) {
+    return;
+  }
+  if (StringUtils::checkFileExtension(toPath, ".epub")) {
+    Epub(fromPath.c_str(), "/.crosspoint").moveCache(toPath.c_str());
+  } else {
+    clearEpubCacheIfNeeded(fromPath);
+  }
+}
+
 String normalizeWebPath(const String& inputPath) {
   if (inputPath.isEmpty() || inputPath == "/") {
     return "/";
@@ -68,6 +134,12 @@ String normalizeWebPath(const String& inputPath) {
   return result;
 }
 
+// A path relative to a book's cache directory that stays inside it
+bool isCacheFileName(const String& name) {
+  return !name.isEmpty() && name.length() < 128 && !name.startsWith("/") && name.indexOf("..") < 0 &&
+         name.indexOf('\\') < 0;
+}
+
 bool isProtectedItemName(const String& name) {
   if (name.startsWith(".")) {
     return true;
@@ -85,9 +157,14 @@ bool isProtectedItemName(const String& name) {
 // - HomePageHtml (from html/HomePage.html)
 // - FilesPageHeaderHtml (from html/FilesPageHeader.html)
 // - FilesPageFooterHtml (from html/FilesPageFooter.html)
-CrossPointWebServer::CrossPointWebServer() {}
+CrossPointWebServer::CrossPointWebServer() : statusMutex(xSemaphoreCreateMutex()) {}
 
-CrossPointWebServer::~CrossPointWebServer() { stop(); }
+CrossPointWebServer::~CrossPointWebServer() {
+  stop();
+  if (statusMutex) {
+    vSemaphoreDelete(statusMutex);
+  }
+}
 
 void CrossPointWebServer::begin() {
   if (running) {
@@ -107,6 +184,8 @@ void CrossPointWebServer::begin() {
 
   // Store AP mode flag for later use (e.g., in handleStatus)
   apMode = isInApMode;
+  completedUploadCount = 0;
+  uploadedBooks.clear();
 
   LOG_DBG("WEB", "[MEM] Free heap before begin: %d bytes", ESP.getFreeHeap());
   LOG_DBG("WEB", "Network mode: %s", apMode ? "AP" : "STA");
@@ -114,12 +193,9 @@ void CrossPointWebServer::begin() {
   LOG_DBG("WEB", "Creating web server on port %d...", port);
   server.reset(new WebServer(port));
 
-  // Disable WiFi sleep to improve responsiveness and prevent 'unreachable' errors.
-  // This is critical for reliable web server operation on ESP32.
-  WiFi.setSleep(false);
-
-  // Note: WebServer class doesn't have setNoDelay() in the standard ESP32 library.
-  // We rely on disabling WiFi sleep for responsiveness.
+  // Idle, the radio sleeps between beacons (pages and listings still answer within a beacon interval); transfers
+  // switch it to full throughput through noteTransferActivity()
+  powerManager.updateNetworkProfile();
 
   LOG_DBG("WEB", "[MEM] Free heap after WebServer allocation: %d bytes", ESP.getFreeHeap());
 
@@ -135,6 +211,9 @@ void CrossPointWebServer::begin() {
 
   server->on("/api/status", HTTP_GET, [this] { handleStatus(); });
   server->on("/api/files", HTTP_GET, [this] { handleFileListData(); });
+  server->on("/api/calibre/books", HTTP_GET, [this] { handleCalibreBooks(); });
+  server->on("/api/trace", HTTP_GET, [this] { handleTrace(); });
+  server->on("/api/metrics", HTTP_GET, [this] { handleMetrics(); });
   server->on("/download", HTTP_GET, [this] { handleDownload(); });
 
   // Upload endpoint with special handling for multipart form data
@@ -152,6 +231,15 @@ void CrossPointWebServer::begin() {
   // Delete file/folder endpoint
   server->on("/delete", HTTP_POST, [this] { handleDelete(); });
 
+  // Font converter, runs in the browser and uploads through /mkdir and /upload
+  server->on("/fonts", HTTP_GET, [this] { handleFontsPage(); });
+
+  // In-browser pre-indexing: the layout to build with, the module doing it and the caches it built
+  server->on("/api/layout", HTTP_GET, [this] { handleLayout(); });
+  server->on("/api/cache", HTTP_POST, [this] { handleUploadPost(upload); }, [this] { handleCacheUpload(upload); });
+  server->on("/preindex.js", HTTP_GET, [this] { handlePreindexModule("preindex.js", "application/javascript"); });
+  server->on("/preindex.wasm", HTTP_GET, [this] { handlePreindexModule("preindex.wasm", "application/wasm"); });
+
   // Settings endpoints
   server->on("/settings", HTTP_GET, [this] { handleSettingsPage(); });
   server->on("/api/settings", HTTP_GET, [this] { handleGetSettings(); });
@@ -160,10 +248,11 @@ void CrossPointWebServer::begin() {
   server->onNotFound([this] { handleNotFound(); });
   LOG_DBG("WEB", "[MEM] Free heap after route setup: %d bytes", ESP.getFreeHeap());
 
-  // Collect WebDAV headers and register handler
-  const char* davHeaders[] = {"Depth", "Destination", "Overwrite", "If", "Lock-Token", "Timeout"};
-  server->collectHeaders(davHeaders, 6);
-  server->addHandler(new WebDAVHandler());  // Note: WebDAVHandler will be deleted by WebServer when server is stopped
+  // Collect WebDAV headers (plus the listing validator and download ranges) and register handler
+  const char* davHeaders[] = {"Depth",   "Destination",   "Overwrite", "If",      "Lock-Token",
+                              "Timeout", "If-None-Match", "Range",     "If-Range"};
+  server->collectHeaders(davHeaders, sizeof(davHeaders) / sizeof(davHeaders[0]));
+  server->addHandler(new WebDAVHandler(*this));  // Note: WebDAVHandler will be deleted by WebServer when server is stopped
   LOG_DBG("WEB", "WebDAV handler initialized");
 
   server->begin();
@@ -180,6 +269,11 @@ void CrossPointWebServer::begin() {
   LOG_DBG("WEB", "Discovery UDP %s on port %d", udpActive ? "enabled" : "failed", LOCAL_UDP_PORT);
 
   running = true;
+  if (!startTask()) {
+    LOG_ERR("WEB", "Failed to create web server task");
+    stop();
+    return;
+  }
 
   LOG_DBG("WEB", "Web server started on port %d", port);
   // Show the correct IP based on network mode
@@ -191,21 +285,26 @@ void CrossPointWebServer::begin() {
 
 void CrossPointWebServer::stop() {
   if (!running || !server) {
-    LOG_DBG("WEB", "stop() called but already stopped (running=%d, server=%p)", running, server.get());
+    LOG_DBG("WEB", "stop() called but already stopped (running=%d, server=%p)", running.load(), server.get());
     return;
   }
 
   LOG_DBG("WEB", "STOP INITIATED - setting running=false first");
   running = false;  // Set this FIRST to prevent handleClient from using server
+  // Let the request being served finish; everything below then runs with nothing else touching the servers
+  stopTask();
 
   LOG_DBG("WEB", "[MEM] Free heap before stop: %d bytes", ESP.getFreeHeap());
 
   // Close any in-progress WebSocket upload
-  if (wsUploadInProgress && wsUploadFile) {
-    wsUploadFile.close();
+  if (wsUploadInProgress && wsUploadWriter.isOpen()) {
+    wsUploadWriter.abort();
     wsUploadInProgress = false;
   }
 
+  stopFrameCapture();
+  networkTransfer.reset();
+
   // Stop WebSocket server
   if (wsServer) {
     LOG_DBG("WEB", "Stopping WebSocket server...");
@@ -220,9 +319,6 @@ void CrossPointWebServer::stop() {
     udpActive = false;
   }
 
-  // Brief delay to allow any in-flight handleClient() calls to complete
-  delay(20);
-
   server->stop();
   LOG_DBG("WEB", "[MEM] Free heap after server->stop(): %d bytes", ESP.getFreeHeap());
 
@@ -238,6 +334,48 @@ void CrossPointWebServer::stop() {
   LOG_DBG("WEB", "[MEM] Free heap final: %d bytes", ESP.getFreeHeap());
 }
 
+bool CrossPointWebServer::startTask() {
+  stopRequested = false;
+  taskRunning = true;
+  // Same stack as the loop task the handlers used to run on. Same priority too, so screen redraws and requests
+  // share the CPU instead of one waiting for the other.
+  const BaseType_t created = xTaskCreate(
+      [](void* param) {
+        static_cast<CrossPointWebServer*>(param)->run();
+        vTaskDelete(nullptr);
+      },
+      "WebServer", TASK_STACK_SIZE, this, TASK_PRIORITY, nullptr);
+  if (created != pdPASS) {
+    taskRunning = false;
+    return false;
+  }
+  return true;
+}
+
+void CrossPointWebServer::stopTask() {
+  if (!taskRunning) {
+    return;
+  }
+  stopRequested = true;
+  while (taskRunning) {
+    esp_task_wdt_reset();
+    delay(5);
+  }
+}
+
+void CrossPointWebServer::run() {
+  // Uploads and listings reset the watchdog as they go; subscribe so those resets cover this task
+  esp_task_wdt_add(nullptr);
+  while (!stopRequested) {
+    esp_task_wdt_reset();
+    handleClient();
+    // Block for a tick between passes: lwIP queues packets meanwhile, and the idle task gets to run
+    vTaskDelay(1);
+  }
+  esp_task_wdt_delete(nullptr);
+  taskRunning = false;
+}
+
 void CrossPointWebServer::handleClient() {
   static unsigned long lastDebugPrint = 0;
 
@@ -263,6 +401,11 @@ void CrossPointWebServer::handleClient() {
   // Handle WebSocket events
   if (wsServer) {
     wsServer->loop();
+    sendCapturedFrames();
+  }
+
+  if (networkTransfer && !isTransferActive(NETWORK_QUIET_MS)) {
+    networkTransfer.reset();
   }
 
   // Respond to discovery broadcasts
@@ -290,6 +433,7 @@ void CrossPointWebServer::handleClient() {
 
 CrossPointWebServer::WsUploadStatus CrossPointWebServer::getWsUploadStatus() const {
   WsUploadStatus status;
+  xSemaphoreTake(statusMutex, portMAX_DELAY);
   status.inProgress = wsUploadInProgress;
   status.received = wsUploadReceived;
   status.total = wsUploadSize;
@@ -297,16 +441,64 @@ CrossPointWebServer::WsUploadStatus CrossPointWebServer::getWsUploadStatus() con
   status.lastCompleteName = wsLastCompleteName.c_str();
   status.lastCompleteSize = wsLastCompleteSize;
   status.lastCompleteAt = wsLastCompleteAt;
+  xSemaphoreGive(statusMutex);
   return status;
 }
 
-static void sendHtmlContent(WebServer* server, const char* data, size_t len) {
+size_t CrossPointWebServer::getCompletedUploadCount() const { return completedUploadCount; }
+
+void CrossPointWebServer::recordCompletedUpload(const String& path) const {
+  xSemaphoreTake(statusMutex, portMAX_DELAY);
+  completedUploadCount++;
+  if (isBookFile(path) &&
+      std::find(uploadedBooks.begin(), uploadedBooks.end(), path.c_str()) == uploadedBooks.end()) {
+    uploadedBooks.emplace_back(path.c_str());
+  }
+  xSemaphoreGive(statusMutex);
+}
+
+std::vector<std::string> CrossPointWebServer::takeUploadedBooks() const {
+  std::vector<std::string> books;
+  xSemaphoreTake(statusMutex, portMAX_DELAY);
+  books.swap(uploadedBooks);
+  xSemaphoreGive(statusMutex);
+  return books;
+}
+
+void CrossPointWebServer::noteTransferActivity() const {
+  lastTransferAt = millis();
+  // Only called from the server task, which is also the one releasing it in handleClient()
+  if (!networkTransfer) {
+    networkTransfer.reset(new HalPowerManager::NetworkTransfer());
+  }
+}
+
+bool CrossPointWebServer::isTransferActive(const unsigned long quietMs) const {
+  return wsUploadInProgress || millis() - lastTransferAt < quietMs;
+}
+
+void CrossPointWebServer::setReaderLayout(const SectionPrefetcher::LayoutParams& params) {
+  xSemaphoreTake(statusMutex, portMAX_DELAY);
+  readerLayout = params;
+  hasReaderLayout = true;
+  xSemaphoreGive(statusMutex);
+}
+
+// Pages are gzipped at build time and only change with the firmware, so browsers keep them and revalidate with
+// If-None-Match; a match costs a bodiless 304 instead of the page
+static void sendHtmlContent(WebServer* server, const char* data, size_t len, const char* etag) {
+  server->sendHeader("ETag", etag);
+  server->sendHeader("Cache-Control", "no-cache");
+  if (server->header("If-None-Match") == etag) {
+    server->send(304);
+    return;
+  }
   server->sendHeader("Content-Encoding", "gzip");
   server->send_P(200, "text/html", data, len);
 }
 
 void CrossPointWebServer::handleRoot() const {
-  sendHtmlContent(server.get(), HomePageHtml, sizeof(HomePageHtml));
+  sendHtmlContent(server.get(), HomePageHtml, HomePageHtmlCompressedSize, HomePageHtmlETag);
   LOG_DBG("WEB", "Served root page");
 }
 
@@ -333,64 +525,6 @@ void CrossPointWebServer::handleStatus() const {
   server->send(200, "application/json", json);
 }
 
-void CrossPointWebServer::scanFiles(const char* path, const std::function<void(FileInfo)>& callback) const {
-  FsFile root = Storage.open(path);
-  if (!root) {
-    LOG_DBG("WEB", "Failed to open directory: %s", path);
-    return;
-  }
-
-  if (!root.isDirectory()) {
-    LOG_DBG("WEB", "Not a directory: %s", path);
-    root.close();
-    return;
-  }
-
-  LOG_DBG("WEB", "Scanning files in: %s", path);
-
-  FsFile file = root.openNextFile();
-  char name[500];
-  while (file) {
-    file.getName(name, sizeof(name));
-    auto fileName = String(name);
-
-    // Skip hidden items (starting with ".")
-    bool shouldHide = fileName.startsWith(".");
-
-    // Check against explicitly hidden items list
-    if (!shouldHide) {
-      for (size_t i = 0; i < HIDDEN_ITEMS_COUNT; i++) {
-        if (fileName.equals(HIDDEN_ITEMS[i])) {
-          shouldHide = true;
-          break;
-        }
-      }
-    }
-
-    if (!shouldHide) {
-      FileInfo info;
-      info.name = fileName;
-      info.isDirectory = file.isDirectory();
-
-      if (info.isDirectory) {
-        info.size = 0;
-        info.isEpub = false;
-      } else {
-        info.size = file.size();
-        info.isEpub = isEpubFile(info.name);
-      }
-
-      callback(info);
-    }
-
-    file.close();
-    yield();               // Yield to allow WiFi and other tasks to process during long scans
-    esp_task_wdt_reset();  // Reset watchdog to prevent timeout on large directories
-    file = root.openNextFile();
-  }
-  root.close();
-}
-
 bool CrossPointWebServer::isEpubFile(const String& filename) const {
   String lower = filename;
   lower.toLowerCase();
@@ -398,7 +532,7 @@ bool CrossPointWebServer::isEpubFile(const String& filename) const {
 }
 
 void CrossPointWebServer::handleFileList() const {
-  sendHtmlContent(server.get(), FilesPageHtml, sizeof(FilesPageHtml));
+  sendHtmlContent(server.get(), FilesPageHtml, FilesPageHtmlCompressedSize, FilesPageHtmlETag);
 }
 
 void CrossPointWebServer::handleFileListData() const {
@@ -416,39 +550,202 @@ void CrossPointWebServer::handleFileListData() const {
     }
   }
 
+  // With limit= the response is one page, {"entries":[...],"more":bool,"cursor":n}; without it the plain array of
+  // everything. Passing the returned cursor back resumes at the directory position where the page ended, so each
+  // page costs only its own entries; offset= works too but walks past the skipped ones again.
+  const bool paged = server->hasArg("limit");
+  const size_t offset = server->hasArg("offset") ? std::max<long>(0, server->arg("offset").toInt()) : 0;
+  const size_t limit = paged ? std::max<long>(1, server->arg("limit").toInt()) : SIZE_MAX;
+  const long cursor = server->hasArg("cursor") ? server->arg("cursor").toInt() : -1;
+
+  // The directory fingerprint changes with any add, remove, rename or resize, so it makes a cheap validator:
+  // a browser revalidating an unchanged folder gets a 304 without a single entry being opened
+  uint32_t fingerprint, dirBytes;
+  String etag;
+  if (DirectoryListing::fingerprintDirectory(currentPath.c_str(), fingerprint, dirBytes)) {
+    char tag[32];
+    snprintf(tag, sizeof(tag), "\"%08lx-%lu\"", static_cast<unsigned long>(fingerprint),
+             static_cast<unsigned long>(dirBytes));
+    etag = tag;
+    if (server->header("If-None-Match") == etag) {
+      server->send(304);
+      return;
+    }
+  }
+
+  FsFile root = Storage.open(currentPath.c_str());
+  const bool isDirectory = root && root.isDirectory();
+  if (!isDirectory) {
+    LOG_DBG("WEB", "Not a directory: %s", currentPath.c_str());
+    if (root) root.close();
+  }
+
+  if (!etag.isEmpty()) {
+    server->sendHeader("ETag", etag);
+    server->sendHeader("Cache-Control", "no-cache");
+  }
   server->setContentLength(CONTENT_LENGTH_UNKNOWN);
   server->send(200, "application/json", "");
-  server->sendContent("[");
-  char output[512];
-  constexpr size_t outputSize = sizeof(output);
-  bool seenFirst = false;
-  JsonDocument doc;
+  ChunkedWriter out(*server);
+  out.print(paged ? "{\"entries\":[" : "[");
+
+  size_t index = 0;
+  size_t sent = 0;
+  bool more = false;
+  size_t nextCursor = 0;
+  if (isDirectory) {
+    const bool resumed = cursor > 0 && root.seekSet(cursor);
+    char name[500];
+    while (true) {
+      const size_t entryPosition = root.position();
+      auto file = root.openNextFile();
+      if (!file) {
+        break;
+      }
+      file.getName(name, sizeof(name));
+      if (!isHiddenItem(name)) {
+        if (sent == limit) {
+          // One entry past the page is enough to know there is another; the rest of the folder is never read
+          more = true;
+          nextCursor = entryPosition;
+          file.close();
+          break;
+        }
+        if (resumed || index >= offset) {
+          const bool isDir = file.isDirectory();
+          if (sent > 0) out.print(',');
+          out.print("{\"name\":");
+          out.printJsonString(name);
+          out.print(",\"size\":");
+          out.printNumber(isDir ? 0 : file.size());
+          out.print(",\"isDirectory\":");
+          out.print(isDir ? "true" : "false");
+          out.print(",\"isEpub\":");
+          out.print(!isDir && hasEpubExtension(name) ? "true" : "false");
+          out.print('}');
+          sent++;
+        }
+        index++;
+      }
 
-  scanFiles(currentPath.c_str(), [this, &output, &doc, seenFirst](const FileInfo& info) mutable {
-    doc.clear();
-    doc["name"] = info.name;
-    doc["size"] = info.size;
-    doc["isDirectory"] = info.isDirectory;
-    doc["isEpub"] = info.isEpub;
+      file.close();
+      yield();               // Yield to allow WiFi and other tasks to process during long scans
+      esp_task_wdt_reset();  // Reset watchdog to prevent timeout on large directories
+    }
+    root.close();
+  }
 
-    const size_t written = serializeJson(doc, output, outputSize);
-    if (written >= outputSize) {
-      // JSON output truncated; skip this entry to avoid sending malformed JSON
-      LOG_DBG("WEB", "Skipping file entry with oversized JSON for name: %s", info.name.c_str());
-      return;
+  if (paged) {
+    out.print("],\"more\":");
+    out.print(more ? "true" : "false");
+    if (more) {
+      out.print(",\"cursor\":");
+      out.printNumber(nextCursor);
     }
+    out.print('}');
+  } else {
+    out.print(']');
+  }
+  out.end();
+  LOG_DBG("WEB", "Served %u entries from %s (offset %u)", static_cast<unsigned>(sent), currentPath.c_str(),
+          static_cast<unsigned>(offset));
+}
 
-    if (seenFirst) {
-      server->sendContent(",");
-    } else {
-      seenFirst = true;
+void CrossPointWebServer::handleCalibreBooks() const {
+  // Revalidating an unchanged library costs the directory walk but not a single book entry on the wire
+  String etag;
+  if (!CalibreBookIndex::refresh(etag)) {
+    server->send(500, "text/plain", "Failed to index books");
+    return;
+  }
+  if (server->header("If-None-Match") == etag) {
+    server->send(304);
+    return;
+  }
+
+  server->sendHeader("ETag", etag);
+  server->sendHeader("Cache-Control", "no-cache");
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, "application/json", "");
+  ChunkedWriter out(*server);
+  CalibreBookIndex::writeJson(out);
+  out.end();
+}
+
+void CrossPointWebServer::handleTrace() const {
+  // Copy first so the ring isn't read while spans recorded by the chunked sends below overwrite it
+  auto* events = static_cast<trace::Event*>(malloc(TRACE_CAPACITY * sizeof(trace::Event)));
+  if (!events) {
+    server->send(500, "text/plain", "Out of memory");
+    return;
+  }
+  const size_t count = trace::snapshot(events, TRACE_CAPACITY);
+
+  server->sendHeader("Cache-Control", "no-cache");
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, "application/json", "");
+  ChunkedWriter out(*server);
+  out.print('[');
+  for (size_t i = 0; i < count; i++) {
+    const trace::Event& event = events[i];
+    out.print(i == 0 ? "{\"name\":" : ",{\"name\":");
+    out.printJsonString(event.name);
+    out.print(",\"start_us\":");
+    out.printNumber(event.startUs);
+    out.print(",\"duration_us\":");
+    out.printNumber(event.durationUs);
+    out.print(",\"free_heap\":");
+    out.printNumber(event.freeHeap);
+    out.print(",\"max_alloc\":");
+    out.printNumber(event.maxAlloc);
+    out.print('}');
+  }
+  out.print(']');
+  out.end();
+  free(events);
+}
+
+void CrossPointWebServer::handleMetrics() const {
+  JsonDocument doc;
+  doc["version"] = CROSSPOINT_VERSION;
+  doc["uptime"] = millis() / 1000;
+  doc["freeHeap"] = ESP.getFreeHeap();
+  doc["minFreeHeap"] = ESP.getMinFreeHeap();
+  doc["maxAlloc"] = ESP.getMaxAllocHeap();
+  doc["poolSlabsInUse"] = BufferPool::slabsInUse();
+  doc["poolPeakSlabsInUse"] = BufferPool::peakSlabsInUse();
+
+  JsonObject counters = doc["counters"].to<JsonObject>();
+  for (uint8_t i = 0; i < metrics::COUNTER_COUNT; i++) {
+    const auto counter = static_cast<metrics::Counter>(i);
+    counters[metrics::name(counter)] = metrics::get(counter);
+  }
+  const uint32_t uploadMs = metrics::get(metrics::UPLOAD_MS);
+  doc["uploadKBps"] = uploadMs > 0 ? metrics::get(metrics::UPLOAD_BYTES) / 1.024f / uploadMs : 0.0f;
+
+  // Prometheus-style buckets: counts per upper bound (ms), the last one unbounded
+  JsonObject histograms = doc["histograms"].to<JsonObject>();
+  for (uint8_t i = 0; i < metrics::HISTOGRAM_COUNT; i++) {
+    const auto histogram = static_cast<metrics::Histogram>(i);
+    const metrics::HistogramData& data = metrics::histograms[histogram];
+    JsonObject entry = histograms[metrics::name(histogram)].to<JsonObject>();
+    JsonArray bounds = entry["le"].to<JsonArray>();
+    for (const uint32_t bound : metrics::BUCKET_BOUNDS_MS) {
+      bounds.add(bound);
     }
-    server->sendContent(output);
-  });
-  server->sendContent("]");
-  // End of streamed response, empty chunk to signal client
-  server->sendContent("");
-  LOG_DBG("WEB", "Served file listing page for path: %s", currentPath.c_str());
+    JsonArray buckets = entry["buckets"].to<JsonArray>();
+    for (const auto& bucket : data.buckets) {
+      buckets.add(bucket.load());
+    }
+    entry["count"] = data.count.load();
+    entry["sum"] = data.sumMs.load();
+    entry["max"] = data.maxMs.load();
+  }
+
+  String json;
+  serializeJson(doc, json);
+  server->sendHeader("Cache-Control", "no-cache");
+  server->send(200, "application/json", json);
 }
 
 void CrossPointWebServer::handleDownload() const {
@@ -505,38 +802,14 @@ void CrossPointWebServer::handleDownload() const {
     filename = nameBuf;
   }
 
-  server->setContentLength(file.size());
   server->sendHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
-  server->send(200, contentType.c_str(), "");
-
-  NetworkClient client = server->client();
-  client.write(file);
+  noteTransferActivity();
+  FileResponse::send(*server, file, contentType.c_str());
   file.close();
 }
 
 // Diagnostic counters for upload performance analysis
 static unsigned long uploadStartTime = 0;
-static unsigned long totalWriteTime = 0;
-static size_t writeCount = 0;
-
-static bool flushUploadBuffer(CrossPointWebServer::UploadState& state) {
-  if (state.bufferPos > 0 && state.file) {
-    esp_task_wdt_reset();  // Reset watchdog before potentially slow SD write
-    const unsigned long writeStart = millis();
-    const size_t written = state.file.write(state.buffer.data(), state.bufferPos);
-    totalWriteTime += millis() - writeStart;
-    writeCount++;
-    esp_task_wdt_reset();  // Reset watchdog after SD write
-
-    if (written != state.bufferPos) {
-      LOG_DBG("WEB", "[UPLOAD] Buffer flush failed: expected %d, wrote %d", state.bufferPos, written);
-      state.bufferPos = 0;
-      return false;
-    }
-    state.bufferPos = 0;
-  }
-  return true;
-}
 
 void CrossPointWebServer::handleUpload(UploadState& state) const {
   static size_t lastLoggedSize = 0;
@@ -562,9 +835,6 @@ void CrossPointWebServer::handleUpload(UploadState& state) const {
     state.error = "";
     uploadStartTime = millis();
     lastLoggedSize = 0;
-    state.bufferPos = 0;
-    totalWriteTime = 0;
-    writeCount = 0;
 
     // Get upload path from query parameter (defaults to root if not specified)
     // Note: We use query parameter instead of form data because multipart form
@@ -601,7 +871,7 @@ void CrossPointWebServer::handleUpload(UploadState& state) const {
 
     // Open file for writing - this can be slow due to FAT cluster allocation
     esp_task_wdt_reset();
-    if (!Storage.openFileForWrite("WEB", filePath, state.file)) {
+    if (!state.writer.begin("WEB", filePath)) {
       state.error = "Failed to create file on SD card";
       LOG_DBG("WEB", "[UPLOAD] FAILED to create file: %s", filePath.c_str());
       return;
@@ -610,29 +880,13 @@ void CrossPointWebServer::handleUpload(UploadState& state) const {
 
     LOG_DBG("WEB", "[UPLOAD] File created successfully: %s", filePath.c_str());
   } else if (upload.status == UPLOAD_FILE_WRITE) {
-    if (state.file && state.error.isEmpty()) {
-      // Buffer incoming data and flush when buffer is full
-      // This reduces SD card write operations and improves throughput
-      const uint8_t* data = upload.buf;
-      size_t remaining = upload.currentSize;
-
-      while (remaining > 0) {
-        const size_t space = UploadState::UPLOAD_BUFFER_SIZE - state.bufferPos;
-        const size_t toCopy = (remaining < space) ? remaining : space;
-
-        memcpy(state.buffer.data() + state.bufferPos, data, toCopy);
-        state.bufferPos += toCopy;
-        data += toCopy;
-        remaining -= toCopy;
-
-        // Flush buffer when full
-        if (state.bufferPos >= UploadState::UPLOAD_BUFFER_SIZE) {
-          if (!flushUploadBuffer(state)) {
-            state.error = "Failed to write to SD card - disk may be full";
-            state.file.close();
-            return;
-          }
-        }
+    if (state.writer.isOpen() && state.error.isEmpty()) {
+      noteTransferActivity();
+      // The writer copies the chunk into its ring and returns; the SD write happens on its own task
+      if (!state.writer.write(upload.buf, upload.currentSize)) {
+        state.error = "Failed to write to SD card - disk may be full";
+        state.writer.abort();
+        return;
       }
 
       state.size += upload.currentSize;
@@ -642,39 +896,43 @@ void CrossPointWebServer::handleUpload(UploadState& state) const {
         const unsigned long elapsed = millis() - uploadStartTime;
         const float kbps = (elapsed > 0) ? (state.size / 1024.0) / (elapsed / 1000.0) : 0;
         LOG_DBG("WEB", "[UPLOAD] %d bytes (%.1f KB), %.1f KB/s, %d writes", state.size, state.size / 1024.0, kbps,
-                writeCount);
+                state.writer.getWriteCount());
         lastLoggedSize = state.size;
       }
     }
   } else if (upload.status == UPLOAD_FILE_END) {
-    if (state.file) {
-      // Flush any remaining buffered data
-      if (!flushUploadBuffer(state)) {
+    if (state.writer.isOpen()) {
+      // Flush any remaining buffered data and wait for the writer to drain
+      if (!state.writer.finish()) {
         state.error = "Failed to write final data to SD card";
       }
-      state.file.close();
 
       if (state.error.isEmpty()) {
         state.success = true;
         const unsigned long elapsed = millis() - uploadStartTime;
         const float avgKbps = (elapsed > 0) ? (state.size / 1024.0) / (elapsed / 1000.0) : 0;
+        // Writes overlap receiving, so this is how busy the card was rather than time added to the upload
+        const unsigned long totalWriteTime = state.writer.getWriteTimeMs();
         const float writePercent = (elapsed > 0) ? (totalWriteTime * 100.0 / elapsed) : 0;
         LOG_DBG("WEB", "[UPLOAD] Complete: %s (%d bytes in %lu ms, avg %.1f KB/s)", state.fileName.c_str(), state.size,
                 elapsed, avgKbps);
-        LOG_DBG("WEB", "[UPLOAD] Diagnostics: %d writes, total write time: %lu ms (%.1f%%)", writeCount, totalWriteTime,
-                writePercent);
+        metrics::add(metrics::UPLOADS);
+        metrics::add(metrics::UPLOAD_BYTES, state.size);
+        metrics::add(metrics::UPLOAD_MS, elapsed);
+        LOG_DBG("WEB", "[UPLOAD] Diagnostics: %d writes, total write time: %lu ms (%.1f%%)",
+                state.writer.getWriteCount(), totalWriteTime, writePercent);
 
         // Clear epub cache to prevent stale metadata issues when overwriting files
         String filePath = state.path;
         if (!filePath.endsWith("/")) filePath += "/";
         filePath += state.fileName;
         clearEpubCacheIfNeeded(filePath);
+        recordCompletedUpload(filePath);
       }
     }
   } else if (upload.status == UPLOAD_FILE_ABORTED) {
-    state.bufferPos = 0;  // Discard buffered data
-    if (state.file) {
-      state.file.close();
+    if (state.writer.isOpen()) {
+      state.writer.abort();  // Discards buffered data
       // Try to delete the incomplete file
       String filePath = state.path;
       if (!filePath.endsWith("/")) filePath += "/";
@@ -814,11 +1072,11 @@ void CrossPointWebServer::handleRename() const {
     return;
   }
 
-  clearEpubCacheIfNeeded(itemPath);
   const bool success = file.rename(newPath.c_str());
   file.close();
 
   if (success) {
+    moveEpubCacheIfNeeded(itemPath, newPath);
     LOG_DBG("WEB", "Renamed file: %s -> %s", itemPath.c_str(), newPath.c_str());
     server->send(200, "text/plain", "Renamed successfully");
   } else {
@@ -907,11 +1165,12 @@ void CrossPointWebServer::handleMove() const {
     return;
   }
 
-  clearEpubCacheIfNeeded(itemPath);
+  // Same volume, so this only rewrites directory entries; the data itself never moves
   const bool success = file.rename(newPath.c_str());
   file.close();
 
   if (success) {
+    moveEpubCacheIfNeeded(itemPath, newPath);
     LOG_DBG("WEB", "Moved file: %s -> %s", itemPath.c_str(), newPath.c_str());
     server->send(200, "text/plain", "Moved successfully");
   } else {
@@ -1012,6 +1271,9 @@ void CrossPointWebServer::handleDelete() const {
       if (f) f.close();
       success = Storage.remove(itemPath.c_str());
       clearEpubCacheIfNeeded(itemPath);
+      if (success) {
+        LibraryIndex::bookRemoved(itemPath.c_str());
+      }
     }
 
     if (!success) {
@@ -1027,8 +1289,144 @@ void CrossPointWebServer::handleDelete() const {
   }
 }
 
+void CrossPointWebServer::handleFontsPage() const {
+  sendHtmlContent(server.get(), FontsPageHtml, FontsPageHtmlCompressedSize, FontsPageHtmlETag);
+  LOG_DBG("WEB", "Served fonts page");
+}
+
+void CrossPointWebServer::handleLayout() const {
+  if (!server->hasArg("path")) {
+    server->send(400, "text/plain", "Missing path");
+    return;
+  }
+
+  xSemaphoreTake(statusMutex, portMAX_DELAY);
+  const SectionPrefetcher::LayoutParams params = readerLayout;
+  const bool hasLayout = hasReaderLayout;
+  xSemaphoreGive(statusMutex);
+  if (!hasLayout) {
+    server->send(404, "text/plain", "No reader layout");
+    return;
+  }
+
+  String path = server->arg("path");
+  if (!path.startsWith("/")) {
+    path = "/" + path;
+  }
+
+  JsonDocument doc;
+  // The cache key is std::hash of the path, which only the device computes the way it reads it back
+  doc["cachePath"] = Epub(path.c_str(), "/.crosspoint").getCachePath();
+  doc["fontId"] = params.fontId;
+  doc["lineCompression"] = params.lineCompression;
+  doc["extraParagraphSpacing"] = params.extraParagraphSpacing;
+  doc["paragraphAlignment"] = params.paragraphAlignment;
+  doc["viewportWidth"] = params.viewportWidth;
+  doc["viewportHeight"] = params.viewportHeight;
+  doc["hyphenationEnabled"] = params.hyphenationEnabled;
+  doc["embeddedStyle"] = params.embeddedStyle;
+
+  String json;
+  serializeJson(doc, json);
+  server->sendHeader("Cache-Control", "no-cache");
+  server->send(200, "application/json", json);
+}
+
+void CrossPointWebServer::handleCacheUpload(UploadState& state) const {
+  esp_task_wdt_reset();
+  if (!running || !server) {
+    return;
+  }
+
+  const HTTPUpload& upload = server->upload();
+  // Written beside the final name and renamed once complete, so the cache warmer never opens half a file
+  const String partPath = state.path + ".part";
+
+  if (upload.status == UPLOAD_FILE_START) {
+    state.fileName = server->arg("file");
+    state.path = "";
+    state.size = 0;
+    state.success = false;
+    state.error = "";
+
+    String book = server->arg("book");
+    if (!book.startsWith("/")) {
+      book = "/" + book;
+    }
+    if (!isEpubFile(book) || !Storage.exists(book.c_str())) {
+      state.error = "Unknown book";
+      return;
+    }
+    if (!isCacheFileName(state.fileName)) {
+      state.error = "Invalid cache file name";
+      return;
+    }
+
+    state.path = String(Epub(book.c_str(), "/.crosspoint").getCachePath().c_str()) + "/" + state.fileName;
+    Storage.mkdir(state.path.substring(0, state.path.lastIndexOf('/')).c_str());
+    esp_task_wdt_reset();
+    if (!state.writer.begin("WEB", state.path + ".part")) {
+      state.error = "Failed to create file on SD card";
+      LOG_DBG("WEB", "[CACHE] FAILED to create file: %s", state.path.c_str());
+    }
+  } else if (upload.status == UPLOAD_FILE_WRITE) {
+    if (state.writer.isOpen() && state.error.isEmpty()) {
+      noteTransferActivity();
+      if (!state.writer.write(upload.buf, upload.currentSize)) {
+        state.error = "Failed to write to SD card - disk may be full";
+        state.writer.abort();
+        Storage.remove(partPath.c_str());
+        return;
+      }
+      state.size += upload.currentSize;
+    }
+  } else if (upload.status == UPLOAD_FILE_END) {
+    if (state.writer.isOpen()) {
+      if (!state.writer.finish()) {
+        state.error = "Failed to write final data to SD card";
+      }
+      if (state.error.isEmpty()) {
+        if (Storage.exists(state.path.c_str())) {
+          Storage.remove(state.path.c_str());
+        }
+        if (Storage.rename(partPath.c_str(), state.path.c_str())) {
+          state.success = true;
+          LOG_DBG("WEB", "[CACHE] Stored %s (%d bytes)", state.path.c_str(), state.size);
+        } else {
+          state.error = "Failed to store cache file";
+        }
+      }
+      if (!state.success) {
+        Storage.remove(partPath.c_str());
+      }
+    }
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    if (state.writer.isOpen()) {
+      state.writer.abort();
+      Storage.remove(partPath.c_str());
+    }
+    state.error = "Upload aborted";
+  }
+}
+
+void CrossPointWebServer::handlePreindexModule(const char* name, const char* contentType) const {
+  const String path = String(PREINDEX_DIR) + "/" + name;
+  if (!Storage.exists(path.c_str())) {
+    server->send(404, "text/plain", "Pre-indexer not installed");
+    return;
+  }
+  FsFile file = Storage.open(path.c_str());
+  if (!file) {
+    server->send(500, "text/plain", "Failed to open file");
+    return;
+  }
+  noteTransferActivity();
+  FileResponse::send(*server, file, contentType);
+  file.close();
+}
+
 void CrossPointWebServer::handleSettingsPage() const {
-  sendHtmlContent(server.get(), SettingsPageHtml, sizeof(SettingsPageHtml));
+  sendHtmlContent(server.get(), SettingsPageHtml, SettingsPageHtmlCompressedSize, SettingsPageHtmlETag);
   LOG_DBG("WEB", "Served settings page");
 }
 
@@ -1184,11 +1582,37 @@ void CrossPointWebServer::handlePostSettings() {
   }
 
   SETTINGS.saveToFile();
+  SD_FONTS.sync();
 
   LOG_DBG("WEB", "Applied %d setting(s)", applied);
   server->send(200, "text/plain", String("Applied ") + String(applied) + " setting(s)");
 }
 
+void CrossPointWebServer::sendCapturedFrames() {
+  if (captureClient < 0) {
+    return;
+  }
+  // A few frames per pass, so a page turn's planes go out together without starving the HTTP server
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  for (int sent = 0; sent < MAX_CAPTURE_FRAMES_PER_PASS && framecap::peek(framecap::SINK_WEBSOCKET, data, size);
+       sent++) {
+    wsServer->sendBIN(captureClient, data, size);
+    framecap::release();
+  }
+}
+
+void CrossPointWebServer::stopFrameCapture() {
+  if (captureClient < 0) {
+    return;
+  }
+  // Another sink may have taken the capture over since
+  if (framecap::activeSink() == framecap::SINK_WEBSOCKET) {
+    framecap::stop();
+  }
+  captureClient = -1;
+}
+
 // WebSocket callback trampoline
 void CrossPointWebServer::wsEventCallback(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
   if (wsInstance) {
@@ -1202,13 +1626,50 @@ void CrossPointWebServer::wsEventCallback(uint8_t num, WStype_t type, uint8_t* p
 //   2. Client sends BINARY messages with file data chunks
 //   3. Server sends TEXT "PROGRESS:<received>:<total>" after each chunk
 //   4. Server sends TEXT "DONE" or "ERROR:<message>" when complete
+// A batch repeats 1-2 for every file on the same connection without waiting for DONE. Each file still gets
+// exactly one DONE or ERROR, in order, and the frames left of a failed file are dropped until the next START.
+// A client sending "CAPTURE" instead gets a binary message per captured frame (FrameCapture.h) until "CAPTURE_STOP".
+void CrossPointWebServer::completeWsUpload(const uint8_t num) {
+  const bool written = wsUploadWriter.finish();
+  wsUploadInProgress = false;
+  wsLastProgressSent = 0;
+  if (!written) {
+    wsServer->sendTXT(num, "ERROR:Write failed - disk full?");
+    return;
+  }
+
+  xSemaphoreTake(statusMutex, portMAX_DELAY);
+  wsLastCompleteName = wsUploadFileName;
+  wsLastCompleteSize = wsUploadSize;
+  wsLastCompleteAt = millis();
+  xSemaphoreGive(statusMutex);
+
+  unsigned long elapsed = millis() - wsUploadStartTime;
+  float kbps = (elapsed > 0) ? (wsUploadSize / 1024.0) / (elapsed / 1000.0) : 0;
+
+  LOG_DBG("WS", "Upload complete: %s (%d bytes in %lu ms, %.1f KB/s)", wsUploadFileName.c_str(), wsUploadSize,
+          elapsed, kbps);
+  metrics::add(metrics::UPLOADS);
+  metrics::add(metrics::UPLOAD_BYTES, wsUploadSize);
+  metrics::add(metrics::UPLOAD_MS, elapsed);
+
+  // Clear epub cache to prevent stale metadata issues when overwriting files
+  String filePath = wsUploadPath;
+  if (!filePath.endsWith("/")) filePath += "/";
+  filePath += wsUploadFileName;
+  clearEpubCacheIfNeeded(filePath);
+  recordCompletedUpload(filePath);
+
+  wsServer->sendTXT(num, "DONE");
+}
+
 void CrossPointWebServer::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
   switch (type) {
     case WStype_DISCONNECTED:
       LOG_DBG("WS", "Client %u disconnected", num);
       // Clean up any in-progress upload
-      if (wsUploadInProgress && wsUploadFile) {
-        wsUploadFile.close();
+      if (wsUploadInProgress && wsUploadWriter.isOpen()) {
+        wsUploadWriter.abort();
         // Delete incomplete file
         String filePath = wsUploadPath;
         if (!filePath.endsWith("/")) filePath += "/";
@@ -1217,6 +1678,10 @@ void CrossPointWebServer::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t*
         LOG_DBG("WS", "Deleted incomplete upload: %s", filePath.c_str());
       }
       wsUploadInProgress = false;
+      wsDiscarding = false;
+      if (num == captureClient) {
+        stopFrameCapture();
+      }
       break;
 
     case WStype_CONNECTED: {
@@ -1229,16 +1694,37 @@ void CrossPointWebServer::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t*
       String msg = String((char*)payload);
       LOG_DBG("WS", "Text from client %u: %s", num, msg.c_str());
 
+      if (msg == "CAPTURE") {
+        if (!framecap::start(framecap::SINK_WEBSOCKET)) {
+          wsServer->sendTXT(num, "ERROR:Not enough memory to capture");
+          return;
+        }
+        captureClient = num;
+        wsServer->sendTXT(num, "CAPTURING");
+        return;
+      }
+      if (msg == "CAPTURE_STOP") {
+        if (num == captureClient) {
+          stopFrameCapture();
+        }
+        return;
+      }
+
       if (msg.startsWith("START:")) {
+        // A new file begins; anything left of a failed previous one has been dropped by now
+        wsDiscarding = false;
+        wsLastProgressSent = 0;
         // Parse: START:<filename>:<size>:<path>
         int firstColon = msg.indexOf(':', 6);
         int secondColon = msg.indexOf(':', firstColon + 1);
 
         if (firstColon > 0 && secondColon > 0) {
+          xSemaphoreTake(statusMutex, portMAX_DELAY);
           wsUploadFileName = msg.substring(6, firstColon);
           wsUploadSize = msg.substring(firstColon + 1, secondColon).toInt();
-          wsUploadPath = msg.substring(secondColon + 1);
           wsUploadReceived = 0;
+          xSemaphoreGive(statusMutex);
+          wsUploadPath = msg.substring(secondColon + 1);
           wsUploadStartTime = millis();
 
           // Ensure path is valid
@@ -1263,73 +1749,59 @@ void CrossPointWebServer::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t*
 
           // Open file for writing
           esp_task_wdt_reset();
-          if (!Storage.openFileForWrite("WS", filePath, wsUploadFile)) {
+          if (!wsUploadWriter.begin("WS", filePath, wsUploadSize)) {
             wsServer->sendTXT(num, "ERROR:Failed to create file");
             wsUploadInProgress = false;
+            wsDiscarding = true;
             return;
           }
           esp_task_wdt_reset();
 
           wsUploadInProgress = true;
           wsServer->sendTXT(num, "READY");
+          // No data frames follow an empty file
+          if (wsUploadSize == 0) {
+            completeWsUpload(num);
+          }
         } else {
           wsServer->sendTXT(num, "ERROR:Invalid START format");
+          wsDiscarding = true;
         }
       }
       break;
     }
 
     case WStype_BIN: {
-      if (!wsUploadInProgress || !wsUploadFile) {
-        wsServer->sendTXT(num, "ERROR:No upload in progress");
+      if (!wsUploadInProgress || !wsUploadWriter.isOpen()) {
+        if (!wsDiscarding) {
+          wsServer->sendTXT(num, "ERROR:No upload in progress");
+        }
         return;
       }
 
-      // Write binary data directly to file
-      esp_task_wdt_reset();
-      size_t written = wsUploadFile.write(payload, length);
+      // Hand the frame to the writer task; only blocks if the card has fallen a whole ring behind
+      noteTransferActivity();
       esp_task_wdt_reset();
-
-      if (written != length) {
-        wsUploadFile.close();
+      if (!wsUploadWriter.write(payload, length)) {
+        wsUploadWriter.abort();
         wsUploadInProgress = false;
+        wsDiscarding = true;
         wsServer->sendTXT(num, "ERROR:Write failed - disk full?");
         return;
       }
 
-      wsUploadReceived += written;
+      wsUploadReceived += length;
 
-      // Send progress update (every 64KB or at end)
-      static size_t lastProgressSent = 0;
-      if (wsUploadReceived - lastProgressSent >= 65536 || wsUploadReceived >= wsUploadSize) {
+      // Send progress update (every 64KB or at end); batch clients use these as acks for their send window
+      if (wsUploadReceived - wsLastProgressSent >= 65536 || wsUploadReceived >= wsUploadSize) {
         String progress = "PROGRESS:" + String(wsUploadReceived) + ":" + String(wsUploadSize);
         wsServer->sendTXT(num, progress);
-        lastProgressSent = wsUploadReceived;
+        wsLastProgressSent = wsUploadReceived;
       }
 
       // Check if upload complete
       if (wsUploadReceived >= wsUploadSize) {
-        wsUploadFile.close();
-        wsUploadInProgress = false;
-
-        wsLastCompleteName = wsUploadFileName;
-        wsLastCompleteSize = wsUploadSize;
-        wsLastCompleteAt = millis();
-
-        unsigned long elapsed = millis() - wsUploadStartTime;
-        float kbps = (elapsed > 0) ? (wsUploadSize / 1024.0) / (elapsed / 1000.0) : 0;
-
-        LOG_DBG("WS", "Upload complete: %s (%d bytes in %lu ms, %.1f KB/s)", wsUploadFileName.c_str(), wsUploadSize,
-                elapsed, kbps);
-
-        // Clear epub cache to prevent stale metadata issues when overwriting files
-        String filePath = wsUploadPath;
-        if (!filePath.endsWith("/")) filePath += "/";
-        filePath += wsUploadFileName;
-        clearEpubCacheIfNeeded(filePath);
-
-        wsServer->sendTXT(num, "DONE");
-        lastProgressSent = 0;
+        completeWsUpload(num);
       }
       break;
     }
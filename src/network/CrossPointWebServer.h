@@ -4,18 +4,16 @@
 #include <NetworkUdp.h>
 #include <WebServer.h>
 #include <WebSocketsServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 
-// Structure to hold file information
-struct FileInfo {
-  String name;
-  size_t size;
-  bool isEpub;
-  bool isDirectory;
-};
+#include "UploadWriter.h"
+#include "activities/reader/SectionPrefetcher.h"
 
 class CrossPointWebServer {
  public:
@@ -31,59 +29,87 @@ class CrossPointWebServer {
 
   // Used by POST upload handler
   struct UploadState {
-    FsFile file;
+    // Batches the small HTTP chunks into large SD writes on a background task
+    UploadWriter writer;
     String fileName;
     String path = "/";
     size_t size = 0;
     bool success = false;
     String error = "";
-
-    // Upload write buffer - batches small writes into larger SD card operations
-    // 4KB is a good balance: large enough to reduce syscall overhead, small enough
-    // to keep individual write times short and avoid watchdog issues
-    static constexpr size_t UPLOAD_BUFFER_SIZE = 4096;  // 4KB buffer
-    std::vector<uint8_t> buffer;
-    size_t bufferPos = 0;
-
-    UploadState() { buffer.resize(UPLOAD_BUFFER_SIZE); }
   } upload;
 
   CrossPointWebServer();
   ~CrossPointWebServer();
 
-  // Start the web server (call after WiFi is connected)
+  // Start the web server (call after WiFi is connected). Requests are served by a dedicated task from then on, so
+  // the caller's loop only needs to poll the status getters below.
   void begin();
 
-  // Stop the web server
+  // Stop the serving task and the web server
   void stop();
 
-  // Call this periodically to handle client requests
-  void handleClient();
-
   // Check if server is running
   bool isRunning() const { return running; }
 
   WsUploadStatus getWsUploadStatus() const;
 
+  // Number of files received since the server was started
+  size_t getCompletedUploadCount() const;
+
+  // Called by the upload paths (HTTP, WebSocket and WebDAV) when a file has been stored completely. Book files are
+  // kept until takeUploadedBooks() so their caches can be built.
+  void recordCompletedUpload(const String& path) const;
+  // Book files received since the previous call, oldest first
+  std::vector<std::string> takeUploadedBooks() const;
+
+  // Called as upload data arrives and before a file download, so background work can keep off the card while a
+  // transfer is running. Also switches the radio to its throughput profile until the transfer has gone quiet.
+  void noteTransferActivity() const;
+  // True while a WebSocket upload is open or any transfer data moved less than quietMs ago
+  bool isTransferActive(unsigned long quietMs) const;
+
+  // Layout the reader builds sections with. Published at /api/layout so the file manager can lay a book out in the
+  // browser before uploading it (see test/preindex); until it is set, books are left to the device.
+  void setReaderLayout(const SectionPrefetcher::LayoutParams& params);
+
   // Get the port number
   uint16_t getPort() const { return port; }
 
  private:
   std::unique_ptr<WebServer> server = nullptr;
   std::unique_ptr<WebSocketsServer> wsServer = nullptr;
-  bool running = false;
+  std::atomic<bool> running{false};
+  std::atomic<bool> taskRunning{false};
+  std::atomic<bool> stopRequested{false};
+  // Guards the WebSocket upload names, which the serving task writes while the UI reads them
+  SemaphoreHandle_t statusMutex = nullptr;
   bool apMode = false;  // true when running in AP mode, false for STA mode
   uint16_t port = 80;
   uint16_t wsPort = 81;  // WebSocket port
   NetworkUDP udp;
   bool udpActive = false;
+  // Guarded by statusMutex, set from the activity while the serving task may read it
+  SectionPrefetcher::LayoutParams readerLayout;
+  bool hasReaderLayout = false;
+
+  bool startTask();
+  void stopTask();
+  void run();
+  // One pass over the HTTP server, the WebSocket server and the discovery socket
+  void handleClient();
 
   // WebSocket upload state
   void onWebSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
   static void wsEventCallback(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
+  // Close the finished WebSocket upload and answer DONE, or ERROR if the last writes failed
+  void completeWsUpload(uint8_t num);
+
+  // WebSocket client receiving frame captures (see FrameCapture.h), or -1
+  int captureClient = -1;
+  static constexpr int MAX_CAPTURE_FRAMES_PER_PASS = 4;
+  void sendCapturedFrames();
+  void stopFrameCapture();
 
-  // File scanning
-  void scanFiles(const char* path, const std::function<void(FileInfo)>& callback) const;
   String formatFileSize(size_t bytes) const;
   bool isEpubFile(const String& filename) const;
 
@@ -93,6 +119,11 @@ class CrossPointWebServer {
   void handleStatus() const;
   void handleFileList() const;
   void handleFileListData() const;
+  // lpath, uuid, modification time and size of every book, for the Calibre plugin's library comparison
+  void handleCalibreBooks() const;
+  // Most recent performance trace spans, oldest first
+  void handleTrace() const;
+  void handleMetrics() const;
   void handleDownload() const;
   void handleUpload(UploadState& state) const;
   void handleUploadPost(UploadState& state) const;
@@ -100,6 +131,13 @@ class CrossPointWebServer {
   void handleRename() const;
   void handleMove() const;
   void handleDelete() const;
+  void handleFontsPage() const;
+  // Reader layout and cache path of a book, for laying it out in the browser
+  void handleLayout() const;
+  // A file of a book's cache built in the browser, written under the book's cache path
+  void handleCacheUpload(UploadState& state) const;
+  // The pre-indexer module, when it has been copied to the card
+  void handlePreindexModule(const char* name, const char* contentType) const;
 
   // Settings handlers
   void handleSettingsPage() const;
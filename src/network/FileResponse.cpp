@@ -0,0 +1,165 @@
+#include "FileResponse.h"
+
+#include <Logging.h>
+#include <esp_task_wdt.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr size_t CHUNK_SIZE = 16 * 1024;
+constexpr size_t FALLBACK_CHUNK_SIZE = 2048;
+constexpr size_t SECTOR_SIZE = 512;
+
+enum class RangeResult { None, Valid, Unsatisfiable };
+
+// Parses a single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range. Multiple ranges and malformed
+// headers yield None, which means the whole file is sent, as RFC 9110 allows.
+RangeResult parseRange(const String& header, const size_t size, size_t& first, size_t& last) {
+  if (!header.startsWith("bytes=") || header.indexOf(',') >= 0) {
+    return RangeResult::None;
+  }
+  const char* spec = header.c_str() + 6;
+  const char* dash = strchr(spec, '-');
+  if (!dash) {
+    return RangeResult::None;
+  }
+
+  char* end;
+  if (dash == spec) {
+    // Suffix range: the last N bytes
+    const unsigned long suffix = strtoul(dash + 1, &end, 10);
+    if (end == dash + 1 || *end) {
+      return RangeResult::None;
+    }
+    if (suffix == 0 || size == 0) {
+      return RangeResult::Unsatisfiable;
+    }
+    first = suffix >= size ? 0 : size - suffix;
+    last = size - 1;
+    return RangeResult::Valid;
+  }
+
+  first = strtoul(spec, &end, 10);
+  if (end != dash) {
+    return RangeResult::None;
+  }
+  if (dash[1] == '\0') {
+    last = SIZE_MAX;
+  } else {
+    last = strtoul(dash + 1, &end, 10);
+    if (*end || last < first) {
+      return RangeResult::None;
+    }
+  }
+  if (first >= size) {
+    return RangeResult::Unsatisfiable;
+  }
+  last = std::min(last, size - 1);
+  return RangeResult::Valid;
+}
+}  // namespace
+
+String FileResponse::etag(FsFile& file) {
+  uint16_t date = 0, time = 0;
+  file.getModifyDateTime(&date, &time);
+  char tag[32];
+  snprintf(tag, sizeof(tag), "\"%lx-%04x%04x\"", static_cast<unsigned long>(file.size()), date, time);
+  return tag;
+}
+
+void FileResponse::sendBytes(WebServer& server, FsFile& file, const size_t length) {
+  const size_t offset = file.position();
+  size_t chunkSize = CHUNK_SIZE;
+  auto* buffer = static_cast<uint8_t*>(malloc(chunkSize));
+  if (!buffer) {
+    chunkSize = FALLBACK_CHUNK_SIZE;
+    buffer = static_cast<uint8_t*>(malloc(chunkSize));
+    if (!buffer) {
+      LOG_ERR("WEB", "No memory for download buffer");
+      return;
+    }
+  }
+
+  NetworkClient client = server.client();
+  const unsigned long start = millis();
+  size_t remaining = length;
+  // The first read ends on a sector boundary so every later one covers whole, aligned sectors
+  size_t toRead = std::min(remaining, chunkSize - offset % SECTOR_SIZE);
+  while (remaining > 0) {
+    const int bytesRead = file.read(buffer, toRead);
+    if (bytesRead <= 0) {
+      LOG_ERR("WEB", "Download read failed with %u bytes left", static_cast<unsigned>(remaining));
+      break;
+    }
+
+    size_t sent = 0;
+    while (sent < static_cast<size_t>(bytesRead)) {
+      // write() already retries until the socket accepts data or times out, so 0 means the client is gone
+      const size_t written = client.write(buffer + sent, bytesRead - sent);
+      if (written == 0) {
+        break;
+      }
+      sent += written;
+    }
+    if (sent < static_cast<size_t>(bytesRead)) {
+      LOG_DBG("WEB", "Client went away with %u bytes left", static_cast<unsigned>(remaining));
+      break;
+    }
+
+    remaining -= bytesRead;
+    toRead = std::min(remaining, chunkSize);
+    esp_task_wdt_reset();
+  }
+  free(buffer);
+
+  const unsigned long elapsed = millis() - start;
+  LOG_DBG("WEB", "Sent %u bytes in %lu ms (%.1f KB/s)", static_cast<unsigned>(length - remaining), elapsed,
+          elapsed > 0 ? (length - remaining) / 1024.0 / (elapsed / 1000.0) : 0.0);
+}
+
+void FileResponse::send(WebServer& server, FsFile& file, const char* contentType, const bool headersOnly) {
+  const size_t size = file.size();
+  const String etag = FileResponse::etag(file);
+  size_t first = 0;
+  size_t last = size > 0 ? size - 1 : 0;
+  bool partial = false;
+
+  if (server.hasHeader("Range")) {
+    // If-Range: resume only when the client's partial copy is still current. FAT timestamps can't be matched
+    // against an HTTP date reliably, so anything but our own ETag gets the whole file.
+    const String ifRange = server.header("If-Range");
+    if (ifRange.isEmpty() || ifRange == etag) {
+      switch (parseRange(server.header("Range"), size, first, last)) {
+        case RangeResult::Valid:
+          partial = true;
+          break;
+        case RangeResult::Unsatisfiable:
+          server.sendHeader("Content-Range", "bytes */" + String(size));
+          server.send(416, "text/plain", "Range Not Satisfiable");
+          return;
+        case RangeResult::None:
+          break;
+      }
+    }
+  }
+
+  const size_t length = size > 0 ? last - first + 1 : 0;
+  server.sendHeader("Accept-Ranges", "bytes");
+  server.sendHeader("ETag", etag);
+  if (partial) {
+    server.sendHeader("Content-Range", "bytes " + String(first) + "-" + String(last) + "/" + String(size));
+  }
+  server.setContentLength(length);
+  server.send(partial ? 206 : 200, contentType, "");
+
+  if (headersOnly || length == 0) {
+    return;
+  }
+  if (first > 0 && !file.seekSet(first)) {
+    LOG_ERR("WEB", "Failed to seek to %u for range request", static_cast<unsigned>(first));
+    return;
+  }
+  sendBytes(server, file, length);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <HalStorage.h>
+#include <WebServer.h>
+
+// Serves an open file over HTTP in large chunks written straight to the client socket, with single-range support
+// (Range / If-Range, 206 and 416 responses) so download managers and sync tools can resume and split transfers.
+// The ETag is derived from the file's size and FAT modification time, so it changes whenever the file does.
+// Requires the server to collect the "Range" and "If-Range" headers.
+namespace FileResponse {
+
+// Send status, headers and (unless headersOnly, for HEAD) the requested bytes of file. Extra headers such as
+// Content-Disposition must be added with sendHeader() beforehand. The file is left open.
+void send(WebServer& server, FsFile& file, const char* contentType, bool headersOnly = false);
+
+// Write length bytes from the file's current position to the client socket, for callers that sent their own headers
+void sendBytes(WebServer& server, FsFile& file, size_t length);
+
+// Quoted entity tag for the file's current contents, as sent with GET responses
+String etag(FsFile& file);
+
+}  // namespace FileResponse
@@ -1,12 +1,15 @@
 #include "HttpDownloader.h"
 
 #include <HTTPClient.h>
+#include <HalPowerManager.h>
 #include <Logging.h>
 #include <NetworkClient.h>
 #include <NetworkClientSecure.h>
 #include <StreamString.h>
 #include <base64.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <memory>
 #include <utility>
@@ -15,81 +18,204 @@
 #include "util/UrlUtils.h"
 
 namespace {
+constexpr int MAX_ATTEMPTS = 4;
+constexpr unsigned long RETRY_DELAY_MS = 1000;
+constexpr size_t WRITE_BUFFER_SIZE = 16 * 1024;
+
+// Kept open between requests. HTTPClient holds on to a keep-alive socket after end() only as long as the same
+// HTTPClient and client objects are used for the next begin(), so both live here.
+struct Connection {
+  std::unique_ptr<NetworkClient> client;
+  HTTPClient http;
+  std::string origin;  // Scheme, host and port the client is connected to
+};
+std::unique_ptr<Connection> connection;
+
+HTTPClient& beginRequest(const std::string& url) {
+  const std::string origin = UrlUtils::extractHost(url);
+  if (connection && connection->origin != origin) {
+    HttpDownloader::closeConnection();
+  }
+  if (!connection) {
+    connection.reset(new Connection());
+    if (UrlUtils::isHttpsUrl(url)) {
+      auto* secureClient = new NetworkClientSecure();
+      secureClient->setInsecure();
+      connection->client.reset(secureClient);
+    } else {
+      connection->client.reset(new NetworkClient());
+    }
+    connection->origin = origin;
+  }
+
+  HTTPClient& http = connection->http;
+  http.begin(*connection->client, url.c_str());
+  http.setReuse(true);
+  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+  http.addHeader("User-Agent", "CrossPoint-ESP32-" CROSSPOINT_VERSION);
+
+  // Add Basic HTTP auth if credentials are configured
+  if (strlen(SETTINGS.opdsUsername) > 0 && strlen(SETTINGS.opdsPassword) > 0) {
+    std::string credentials = std::string(SETTINGS.opdsUsername) + ":" + SETTINGS.opdsPassword;
+    String encoded = base64::encode(credentials.c_str());
+    http.addHeader("Authorization", "Basic " + encoded);
+  }
+  return http;
+}
+
+// Collects the body into large blocks before writing, so the card sees a few big writes instead of one per TCP
+// segment. Falls back to writing straight through if the buffer can't be allocated.
 class FileWriteStream final : public Stream {
  public:
-  FileWriteStream(FsFile& file, size_t total, HttpDownloader::ProgressCallback progress)
-      : file_(file), total_(total), progress_(std::move(progress)) {}
+  FileWriteStream(FsFile& file, size_t offset, size_t total, HttpDownloader::ProgressCallback progress)
+      : file_(file), offset_(offset), total_(total), progress_(std::move(progress)) {
+    buffer_ = static_cast<uint8_t*>(malloc(WRITE_BUFFER_SIZE));
+  }
+  ~FileWriteStream() override { free(buffer_); }
 
   size_t write(uint8_t byte) override { return write(&byte, 1); }
 
   size_t write(const uint8_t* buffer, size_t size) override {
-    // Write-through stream for HTTPClient::writeToStream with progress tracking.
-    const size_t written = file_.write(buffer, size);
-    if (written != size) {
-      writeOk_ = false;
+    if (!writeOk_) {
+      return 0;
+    }
+    if (!buffer_) {
+      writeThrough(buffer, size);
+    } else {
+      size_t remaining = size;
+      while (remaining > 0) {
+        const size_t toCopy = std::min(remaining, WRITE_BUFFER_SIZE - used_);
+        memcpy(buffer_ + used_, buffer, toCopy);
+        used_ += toCopy;
+        buffer += toCopy;
+        remaining -= toCopy;
+        if (used_ == WRITE_BUFFER_SIZE) {
+          flushBuffer();
+        }
+      }
     }
-    downloaded_ += written;
+    received_ += size;
     if (progress_ && total_ > 0) {
-      progress_(downloaded_, total_);
+      progress_(offset_ + received_, total_);
     }
-    return written;
+    return writeOk_ ? size : 0;
   }
 
   int available() override { return 0; }
   int read() override { return -1; }
   int peek() override { return -1; }
-  void flush() override { file_.flush(); }
+  void flush() override {
+    flushBuffer();
+    file_.flush();
+  }
 
-  size_t downloaded() const { return downloaded_; }
+  size_t received() const { return received_; }
   bool ok() const { return writeOk_; }
 
  private:
   FsFile& file_;
-  size_t total_;
-  size_t downloaded_ = 0;
+  const size_t offset_;  // Bytes already in the file from an earlier attempt
+  const size_t total_;
+  size_t received_ = 0;
+  uint8_t* buffer_ = nullptr;
+  size_t used_ = 0;
   bool writeOk_ = true;
   HttpDownloader::ProgressCallback progress_;
-};
-}  // namespace
 
-bool HttpDownloader::fetchUrl(const std::string& url, Stream& outContent) {
-  // Use NetworkClientSecure for HTTPS, regular NetworkClient for HTTP
-  std::unique_ptr<NetworkClient> client;
-  if (UrlUtils::isHttpsUrl(url)) {
-    auto* secureClient = new NetworkClientSecure();
-    secureClient->setInsecure();
-    client.reset(secureClient);
-  } else {
-    client.reset(new NetworkClient());
+  void writeThrough(const uint8_t* data, const size_t size) {
+    if (file_.write(data, size) != size) {
+      writeOk_ = false;
+    }
   }
-  HTTPClient http;
 
-  LOG_DBG("HTTP", "Fetching: %s", url.c_str());
+  void flushBuffer() {
+    if (used_ > 0 && writeOk_) {
+      writeThrough(buffer_, used_);
+    }
+    used_ = 0;
+  }
+};
 
-  http.begin(*client, url.c_str());
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-  http.addHeader("User-Agent", "CrossPoint-ESP32-" CROSSPOINT_VERSION);
+// Total length from "Content-Range: bytes first-last/total", or 0 if absent or unknown ("*")
+size_t parseContentRangeTotal(const String& header, size_t& first) {
+  if (!header.startsWith("bytes ")) {
+    return 0;
+  }
+  first = strtoul(header.c_str() + 6, nullptr, 10);
+  const int slash = header.indexOf('/');
+  return slash < 0 ? 0 : strtoul(header.c_str() + slash + 1, nullptr, 10);
+}
+}  // namespace
 
-  // Add Basic HTTP auth if credentials are configured
-  if (strlen(SETTINGS.opdsUsername) > 0 && strlen(SETTINGS.opdsPassword) > 0) {
-    std::string credentials = std::string(SETTINGS.opdsUsername) + ":" + SETTINGS.opdsPassword;
-    String encoded = base64::encode(credentials.c_str());
-    http.addHeader("Authorization", "Basic " + encoded);
+void HttpDownloader::closeConnection() {
+  if (!connection) {
+    return;
   }
+  connection->http.end();
+  connection->client->stop();
+  connection.reset();
+}
 
-  const int httpCode = http.GET();
+bool HttpDownloader::fetchUrl(const std::string& url, Stream& outContent) {
+  CacheValidators validators;
+  return fetchUrlIfModified(url, outContent, validators) == FETCH_OK;
+}
+
+HttpDownloader::FetchResult HttpDownloader::fetchUrlIfModified(const std::string& url, Stream& outContent,
+                                                               CacheValidators& validators) {
+  LOG_DBG("HTTP", "Fetching: %s", url.c_str());
+  HalPowerManager::NetworkTransfer transfer;
+
+  const auto sendRequest = [&url, &validators]() -> HTTPClient& {
+    HTTPClient& http = beginRequest(url);
+    const char* responseHeaders[] = {"ETag", "Last-Modified"};
+    http.collectHeaders(responseHeaders, sizeof(responseHeaders) / sizeof(responseHeaders[0]));
+    if (!validators.etag.empty()) {
+      http.addHeader("If-None-Match", validators.etag.c_str());
+    }
+    if (!validators.lastModified.empty()) {
+      http.addHeader("If-Modified-Since", validators.lastModified.c_str());
+    }
+    return http;
+  };
+
+  HTTPClient* http = &sendRequest();
+  int httpCode = http->GET();
+  if (httpCode < 0) {
+    // Also what a kept connection the server has since closed looks like; try once more on a fresh one
+    http->end();
+    closeConnection();
+    http = &sendRequest();
+    httpCode = http->GET();
+  }
+  if (httpCode == HTTP_CODE_NOT_MODIFIED && !validators.empty()) {
+    http->end();
+    LOG_DBG("HTTP", "Not modified");
+    return FETCH_NOT_MODIFIED;
+  }
   if (httpCode != HTTP_CODE_OK) {
     LOG_ERR("HTTP", "Fetch failed: %d", httpCode);
-    http.end();
-    return false;
+    http->end();
+    if (httpCode < 0) {
+      closeConnection();
+    }
+    return FETCH_FAILED;
   }
 
-  http.writeToStream(&outContent);
+  validators.etag = http->header("ETag").c_str();
+  validators.lastModified = http->header("Last-Modified").c_str();
 
-  http.end();
+  const int written = http->writeToStream(&outContent);
+
+  http->end();
+  if (written < 0) {
+    // Either the transfer broke or the stream stopped accepting data (e.g. a parser that has all it wants). Both
+    // leave part of the body unread, so this connection can't carry another request.
+    closeConnection();
+  }
 
   LOG_DBG("HTTP", "Fetch success");
-  return true;
+  return FETCH_OK;
 }
 
 bool HttpDownloader::fetchUrl(const std::string& url, std::string& outContent) {
@@ -101,96 +227,178 @@ bool HttpDownloader::fetchUrl(const std::string& url, std::string& outContent) {
   return true;
 }
 
-HttpDownloader::DownloadError HttpDownloader::downloadToFile(const std::string& url, const std::string& destPath,
-                                                             ProgressCallback progress) {
-  // Use NetworkClientSecure for HTTPS, regular NetworkClient for HTTP
-  std::unique_ptr<NetworkClient> client;
-  if (UrlUtils::isHttpsUrl(url)) {
-    auto* secureClient = new NetworkClientSecure();
-    secureClient->setInsecure();
-    client.reset(secureClient);
-  } else {
-    client.reset(new NetworkClient());
+HttpDownloader::DownloadError HttpDownloader::downloadAttempt(const std::string& url, const std::string& partPath,
+                                                              std::string& validator,
+                                                              const ProgressCallback& progress, bool& retryable) {
+  retryable = false;
+
+  size_t existing = 0;
+  if (Storage.exists(partPath.c_str())) {
+    FsFile part = Storage.open(partPath.c_str());
+    if (part) {
+      existing = part.size();
+      part.close();
+    }
   }
-  HTTPClient http;
 
-  LOG_DBG("HTTP", "Downloading: %s", url.c_str());
-  LOG_DBG("HTTP", "Destination: %s", destPath.c_str());
-
-  http.begin(*client, url.c_str());
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-  http.addHeader("User-Agent", "CrossPoint-ESP32-" CROSSPOINT_VERSION);
-
-  // Add Basic HTTP auth if credentials are configured
-  if (strlen(SETTINGS.opdsUsername) > 0 && strlen(SETTINGS.opdsPassword) > 0) {
-    std::string credentials = std::string(SETTINGS.opdsUsername) + ":" + SETTINGS.opdsPassword;
-    String encoded = base64::encode(credentials.c_str());
-    http.addHeader("Authorization", "Basic " + encoded);
+  HTTPClient& http = beginRequest(url);
+  const char* responseHeaders[] = {"Content-Range", "ETag", "Last-Modified"};
+  http.collectHeaders(responseHeaders, sizeof(responseHeaders) / sizeof(responseHeaders[0]));
+  if (existing > 0) {
+    http.addHeader("Range", "bytes=" + String(existing) + "-");
+    // Only take a partial response if the file hasn't changed since the part was fetched
+    if (!validator.empty()) {
+      http.addHeader("If-Range", validator.c_str());
+    }
+    LOG_DBG("HTTP", "Resuming at %zu bytes", existing);
   }
 
   const int httpCode = http.GET();
-  if (httpCode != HTTP_CODE_OK) {
+  if (httpCode < 0) {
+    LOG_ERR("HTTP", "Download request failed: %d", httpCode);
+    http.end();
+    closeConnection();
+    retryable = true;
+    return HTTP_ERROR;
+  }
+  if (httpCode == HTTP_CODE_RANGE_NOT_SATISFIABLE && existing > 0) {
+    // The part is no prefix of what the server has now; start over
+    LOG_DBG("HTTP", "Part file rejected, restarting");
+    http.end();
+    Storage.remove(partPath.c_str());
+    retryable = true;
+    return HTTP_ERROR;
+  }
+  if (httpCode != HTTP_CODE_OK && httpCode != HTTP_CODE_PARTIAL_CONTENT) {
     LOG_ERR("HTTP", "Download failed: %d", httpCode);
     http.end();
     return HTTP_ERROR;
   }
 
+  if (http.hasHeader("ETag")) {
+    validator = http.header("ETag").c_str();
+  } else if (http.hasHeader("Last-Modified")) {
+    validator = http.header("Last-Modified").c_str();
+  }
+
   const int64_t reportedLength = http.getSize();
   const size_t contentLength = reportedLength > 0 ? static_cast<size_t>(reportedLength) : 0;
-  if (contentLength > 0) {
-    LOG_DBG("HTTP", "Content-Length: %zu", contentLength);
+  size_t offset = 0;
+  size_t expectedTotal = contentLength;
+  if (httpCode == HTTP_CODE_PARTIAL_CONTENT) {
+    size_t first = 0;
+    expectedTotal = parseContentRangeTotal(http.header("Content-Range"), first);
+    if (first != existing) {
+      LOG_ERR("HTTP", "Server resumed at %zu, expected %zu", first, existing);
+      http.end();
+      Storage.remove(partPath.c_str());
+      retryable = true;
+      return HTTP_ERROR;
+    }
+    offset = existing;
+  }
+  if (expectedTotal > 0) {
+    LOG_DBG("HTTP", "Content-Length: %zu (from %zu)", expectedTotal, offset);
   } else {
     LOG_DBG("HTTP", "Content-Length: unknown");
   }
 
-  // Remove existing file if present
-  if (Storage.exists(destPath.c_str())) {
-    Storage.remove(destPath.c_str());
-  }
-
-  // Open file for writing
-  FsFile file;
-  if (!Storage.openFileForWrite("HTTP", destPath.c_str(), file)) {
+  FsFile file = Storage.open(partPath.c_str(), O_RDWR | O_CREAT);
+  if (!file) {
     LOG_ERR("HTTP", "Failed to open file for writing");
     http.end();
     return FILE_ERROR;
   }
+  // A full response replaces whatever an earlier attempt left behind. No preallocation: after a power cut the part
+  // file's size must still say how much of it is real.
+  if ((offset > 0 && !file.seekSet(offset)) || (offset == 0 && !file.truncate(0))) {
+    LOG_ERR("HTTP", "Failed to position part file");
+    file.close();
+    http.end();
+    return FILE_ERROR;
+  }
 
   // Let HTTPClient handle chunked decoding and stream body bytes into the file.
-  FileWriteStream fileStream(file, contentLength, progress);
+  FileWriteStream fileStream(file, offset, expectedTotal, progress);
   const int writeResult = http.writeToStream(&fileStream);
-
+  // Keep what did arrive: it's where the next attempt continues from
+  fileStream.flush();
+  const size_t written = offset + fileStream.received();
+  if (!file.truncate(written)) {
+    LOG_ERR("HTTP", "Failed to trim part file to %zu bytes", written);
+  }
   file.close();
   http.end();
 
-  if (writeResult < 0) {
-    LOG_ERR("HTTP", "writeToStream error: %d", writeResult);
-    Storage.remove(destPath.c_str());
-    return HTTP_ERROR;
-  }
-
-  const size_t downloaded = fileStream.downloaded();
-  LOG_DBG("HTTP", "Downloaded %zu bytes", downloaded);
-
-  // Guard against partial writes even if HTTPClient completes.
   if (!fileStream.ok()) {
     LOG_ERR("HTTP", "Write failed during download");
-    Storage.remove(destPath.c_str());
     return FILE_ERROR;
   }
 
-  if (contentLength == 0 && downloaded == 0) {
+  LOG_DBG("HTTP", "Downloaded %zu bytes, file now %zu bytes", fileStream.received(), written);
+
+  if (writeResult < 0) {
+    LOG_ERR("HTTP", "writeToStream error: %d", writeResult);
+    // A dead keep-alive socket must not be handed to the retry
+    closeConnection();
+    retryable = true;
+    return HTTP_ERROR;
+  }
+
+  if (expectedTotal == 0 && written == 0) {
     LOG_ERR("HTTP", "Download failed: no data received");
-    Storage.remove(destPath.c_str());
     return HTTP_ERROR;
   }
 
   // Verify download size if known
-  if (contentLength > 0 && downloaded != contentLength) {
-    LOG_ERR("HTTP", "Size mismatch: got %zu, expected %zu", downloaded, contentLength);
-    Storage.remove(destPath.c_str());
+  if (expectedTotal > 0 && written != expectedTotal) {
+    LOG_ERR("HTTP", "Size mismatch: got %zu, expected %zu", written, expectedTotal);
+    closeConnection();
+    retryable = written < expectedTotal;
+    if (!retryable) {
+      Storage.remove(partPath.c_str());
+    }
     return HTTP_ERROR;
   }
 
   return OK;
 }
+
+HttpDownloader::DownloadError HttpDownloader::downloadToFile(const std::string& url, const std::string& destPath,
+                                                             ProgressCallback progress) {
+  LOG_DBG("HTTP", "Downloading: %s", url.c_str());
+  LOG_DBG("HTTP", "Destination: %s", destPath.c_str());
+  HalPowerManager::NetworkTransfer transfer;
+
+  const std::string partPath = destPath + ".part";
+  std::string validator;
+  DownloadError result = HTTP_ERROR;
+  for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++) {
+    bool retryable = false;
+    result = downloadAttempt(url, partPath, validator, progress, retryable);
+    if (result == OK || !retryable) {
+      break;
+    }
+    LOG_DBG("HTTP", "Attempt %d failed, retrying", attempt);
+    delay(RETRY_DELAY_MS * attempt);
+  }
+
+  if (result != OK) {
+    // A partial body is kept so trying again later resumes; anything else is of no use
+    if (result == FILE_ERROR) {
+      Storage.remove(partPath.c_str());
+    }
+    return result;
+  }
+
+  // Remove existing file if present
+  if (Storage.exists(destPath.c_str())) {
+    Storage.remove(destPath.c_str());
+  }
+  if (!Storage.rename(partPath.c_str(), destPath.c_str())) {
+    LOG_ERR("HTTP", "Failed to move %s into place", partPath.c_str());
+    Storage.remove(partPath.c_str());
+    return FILE_ERROR;
+  }
+  return OK;
+}
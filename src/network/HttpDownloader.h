@@ -6,12 +6,27 @@
 
 /**
  * HTTP client utility for fetching content and downloading files.
- * Wraps NetworkClientSecure and HTTPClient for HTTPS requests.
+ * Wraps NetworkClientSecure and HTTPClient for HTTPS requests. The connection is kept open between requests to the
+ * same server, so browsing a catalog and downloading from it pays for one TLS handshake; closeConnection() frees it.
  */
 class HttpDownloader {
  public:
   using ProgressCallback = std::function<void(size_t downloaded, size_t total)>;
 
+  // Validators of a cached response. Sent as If-None-Match / If-Modified-Since and replaced by the response's own.
+  struct CacheValidators {
+    std::string etag;
+    std::string lastModified;
+
+    bool empty() const { return etag.empty() && lastModified.empty(); }
+  };
+
+  enum FetchResult {
+    FETCH_OK = 0,
+    FETCH_NOT_MODIFIED,
+    FETCH_FAILED,
+  };
+
   enum DownloadError {
     OK = 0,
     HTTP_ERROR,
@@ -29,8 +44,17 @@ class HttpDownloader {
 
   static bool fetchUrl(const std::string& url, Stream& stream);
 
+  /**
+   * Conditional GET: with validators set, a server that still has the same content answers 304 and nothing is
+   * written to stream. On a 200 the body goes to stream and validators are replaced with the response's.
+   */
+  static FetchResult fetchUrlIfModified(const std::string& url, Stream& stream, CacheValidators& validators);
+
   /**
    * Download a file to the SD card.
+   * The body goes to destPath + ".part" and is renamed into place once its length checks out. A dropped connection
+   * is retried with a Range request that continues where the part file ends; a part file left by an earlier
+   * failed call is continued the same way.
    * @param url The URL to download
    * @param destPath The destination path on SD card
    * @param progress Optional progress callback
@@ -38,4 +62,14 @@ class HttpDownloader {
    */
   static DownloadError downloadToFile(const std::string& url, const std::string& destPath,
                                       ProgressCallback progress = nullptr);
+
+  /**
+   * Close the connection kept open for reuse and free its buffers (about 40KB for TLS).
+   * Call when leaving the screen that makes the requests.
+   */
+  static void closeConnection();
+
+ private:
+  static DownloadError downloadAttempt(const std::string& url, const std::string& partPath, std::string& validator,
+                                       const ProgressCallback& progress, bool& retryable);
 };
@@ -0,0 +1,130 @@
+#include "OpdsFeedCache.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <functional>
+
+namespace {
+constexpr char CACHE_DIR[] = "/.crosspoint/opds";
+constexpr uint8_t CACHE_VERSION = 2;
+constexpr uint32_t MAX_STRING_LENGTH = 2048;
+constexpr uint32_t MAX_ENTRIES = 1024;
+
+std::string cachePath(const std::string& url, const size_t skip) {
+  return std::string(CACHE_DIR) + "/" + std::to_string(std::hash<std::string>{}(url)) + "-" + std::to_string(skip) +
+         ".bin";
+}
+
+// serialization::readString trusts the length prefix; a torn write must not turn into a huge allocation
+bool readString(FsFile& file, std::string& s) {
+  uint32_t len = 0;
+  serialization::readPod(file, len);
+  if (len > MAX_STRING_LENGTH) {
+    return false;
+  }
+  s.resize(len);
+  return len == 0 || file.read(&s[0], len) == static_cast<int>(len);
+}
+
+// Opens the cache file and reads its header. The URL is stored too, so a hash collision reads as a miss.
+bool openCache(const std::string& url, const size_t skip, FsFile& file, HttpDownloader::CacheValidators& validators) {
+  const std::string path = cachePath(url, skip);
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("OPDC", path, file)) {
+    return false;
+  }
+
+  uint8_t version = 0;
+  std::string cachedUrl;
+  serialization::readPod(file, version);
+  if (version != CACHE_VERSION || !readString(file, cachedUrl) || cachedUrl != url ||
+      !readString(file, validators.etag) || !readString(file, validators.lastModified)) {
+    file.close();
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+bool OpdsFeedCache::readValidators(const std::string& url, const size_t skip,
+                                   HttpDownloader::CacheValidators& validators) {
+  FsFile file;
+  if (!openCache(url, skip, file, validators)) {
+    return false;
+  }
+  file.close();
+  return !validators.empty();
+}
+
+bool OpdsFeedCache::load(const std::string& url, const size_t skip, std::vector<OpdsEntry>& entries,
+                         Continuation& continuation) {
+  FsFile file;
+  HttpDownloader::CacheValidators validators;
+  if (!openCache(url, skip, file, validators)) {
+    return false;
+  }
+
+  uint8_t hasMore = 0;
+  uint32_t count = 0;
+  serialization::readPod(file, hasMore);
+  bool ok = readString(file, continuation.nextHref);
+  serialization::readPod(file, count);
+  ok = ok && count <= MAX_ENTRIES;
+  continuation.hasMoreEntries = hasMore != 0;
+
+  if (ok) {
+    entries.reserve(entries.size() + count);
+  }
+  for (uint32_t i = 0; ok && i < count; i++) {
+    uint8_t type = 0;
+    serialization::readPod(file, type);
+    OpdsEntry& entry = entries.emplace_back();
+    entry.type = type == static_cast<uint8_t>(OpdsEntryType::BOOK) ? OpdsEntryType::BOOK : OpdsEntryType::NAVIGATION;
+    ok = readString(file, entry.title) && readString(file, entry.author) && readString(file, entry.href) &&
+         readString(file, entry.id) && readString(file, entry.thumbnailHref);
+  }
+  file.close();
+
+  if (!ok) {
+    LOG_ERR("OPDC", "Damaged cache entry for %s", url.c_str());
+    Storage.remove(cachePath(url, skip).c_str());
+  }
+  return ok;
+}
+
+void OpdsFeedCache::save(const std::string& url, const size_t skip, const HttpDownloader::CacheValidators& validators,
+                         const std::vector<OpdsEntry>& entries, const Continuation& continuation) {
+  const std::string path = cachePath(url, skip);
+  if (validators.empty()) {
+    // Nothing to revalidate with; make sure an older copy isn't served for the new content
+    if (Storage.exists(path.c_str())) {
+      Storage.remove(path.c_str());
+    }
+    return;
+  }
+
+  FsFile file;
+  Storage.mkdir(CACHE_DIR);
+  if (!Storage.openFileForWrite("OPDC", path, file)) {
+    return;
+  }
+
+  serialization::writePod(file, CACHE_VERSION);
+  serialization::writeString(file, url);
+  serialization::writeString(file, validators.etag);
+  serialization::writeString(file, validators.lastModified);
+  serialization::writePod(file, static_cast<uint8_t>(continuation.hasMoreEntries ? 1 : 0));
+  serialization::writeString(file, continuation.nextHref);
+  serialization::writePod(file, static_cast<uint32_t>(entries.size()));
+  for (const auto& entry : entries) {
+    serialization::writePod(file, static_cast<uint8_t>(entry.type));
+    serialization::writeString(file, entry.title);
+    serialization::writeString(file, entry.author);
+    serialization::writeString(file, entry.href);
+    serialization::writeString(file, entry.id);
+    serialization::writeString(file, entry.thumbnailHref);
+  }
+  file.close();
+  LOG_DBG("OPDC", "Cached %u entries of %s", static_cast<unsigned>(entries.size()), url.c_str());
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <OpdsParser.h>
+
+#include <string>
+#include <vector>
+
+#include "network/HttpDownloader.h"
+
+// Parsed OPDS feed windows kept in /.crosspoint/opds, keyed by feed URL and window offset, together with the
+// validators of the response they were parsed from. Revisiting a catalog then costs one conditional GET, and on a
+// 304 the entries are read back from here instead of being downloaded and parsed again.
+namespace OpdsFeedCache {
+
+// Where the entries after a cached window come from, as recorded when it was parsed
+struct Continuation {
+  bool hasMoreEntries = false;  // The window filled before the document ended
+  std::string nextHref;         // The feed's rel="next" link
+};
+
+// Validators of the cached window, to revalidate it with. Returns false if there is no usable cache entry.
+bool readValidators(const std::string& url, size_t skip, HttpDownloader::CacheValidators& validators);
+
+// Append the cached window's entries to entries. Returns false if the entry is missing or damaged.
+bool load(const std::string& url, size_t skip, std::vector<OpdsEntry>& entries, Continuation& continuation);
+
+// Replace the cached window. Windows whose response carried no validators are not stored.
+void save(const std::string& url, size_t skip, const HttpDownloader::CacheValidators& validators,
+          const std::vector<OpdsEntry>& entries, const Continuation& continuation);
+
+}  // namespace OpdsFeedCache
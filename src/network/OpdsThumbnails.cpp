@@ -0,0 +1,84 @@
+#include "OpdsThumbnails.h"
+
+#include <BmpRowWriter.h>
+#include <HalStorage.h>
+#include <JpegToBmpConverter.h>
+#include <Logging.h>
+#include <PngToBmpConverter.h>
+
+#include <functional>
+
+#include "network/HttpDownloader.h"
+
+namespace {
+constexpr char THUMBS_DIR[] = "/.crosspoint/opds/thumbs";
+constexpr char DOWNLOAD_PATH[] = "/.crosspoint/opds/thumbs/.image";
+
+enum class ImageType { Unknown, Jpeg, Png };
+
+// Servers often send thumbnails without an extension in the URL, so go by the file's magic bytes
+ImageType sniffImage(FsFile& file) {
+  uint8_t magic[4] = {};
+  const int bytesRead = file.read(magic, sizeof(magic));
+  file.seekSet(0);
+  if (bytesRead >= 2 && magic[0] == 0xFF && magic[1] == 0xD8) {
+    return ImageType::Jpeg;
+  }
+  if (bytesRead >= 4 && magic[0] == 0x89 && magic[1] == 'P' && magic[2] == 'N' && magic[3] == 'G') {
+    return ImageType::Png;
+  }
+  return ImageType::Unknown;
+}
+
+void writeEmptyMarker(const std::string& path) {
+  FsFile marker;
+  if (Storage.openFileForWrite("OPDT", path, marker)) {
+    marker.close();
+  }
+}
+}  // namespace
+
+std::string OpdsThumbnails::pathFor(const std::string& url) {
+  return std::string(THUMBS_DIR) + "/" + std::to_string(std::hash<std::string>{}(url)) + ".bmp";
+}
+
+bool OpdsThumbnails::isCached(const std::string& url) { return Storage.exists(pathFor(url).c_str()); }
+
+bool OpdsThumbnails::fetch(const std::string& url) {
+  const std::string path = pathFor(url);
+  Storage.mkdir(THUMBS_DIR);
+
+  const auto result = HttpDownloader::downloadToFile(url, DOWNLOAD_PATH);
+  if (result != HttpDownloader::OK) {
+    LOG_ERR("OPDT", "Thumbnail download failed: %s", url.c_str());
+    // Network trouble isn't recorded, so the thumbnail is tried again next time the page is shown
+    return false;
+  }
+
+  FsFile image;
+  if (!Storage.openFileForRead("OPDT", DOWNLOAD_PATH, image)) {
+    return false;
+  }
+
+  bool success = false;
+  const ImageType type = sniffImage(image);
+  if (type == ImageType::Unknown) {
+    LOG_DBG("OPDT", "Unsupported thumbnail format: %s", url.c_str());
+  } else {
+    FsFile bmp;
+    if (Storage.openFileForWrite("OPDT", path, bmp)) {
+      const BmpOutput output = BmpOutput::thumbnail(bmp, THUMB_HEIGHT);
+      success = type == ImageType::Jpeg ? JpegToBmpConverter::jpegFileToBmpStreams(image, &output, 1)
+                                        : PngToBmpConverter::pngFileToBmpStreams(image, &output, 1);
+      bmp.close();
+    }
+  }
+  image.close();
+  Storage.remove(DOWNLOAD_PATH);
+
+  if (!success) {
+    Storage.remove(path.c_str());
+    writeEmptyMarker(path);
+  }
+  return success;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Cover thumbnails of OPDS entries, downloaded once and kept in /.crosspoint/opds/thumbs as 1-bit BMPs of
+// THUMB_HEIGHT, named by a hash of the image URL. The image is scaled through the same converters as book covers.
+// Thumbnails that can't be fetched or decoded are recorded as empty files, so each URL is only ever tried once.
+namespace OpdsThumbnails {
+
+constexpr int THUMB_HEIGHT = 180;
+
+// Where the thumbnail for this (absolute) image URL is, or will be, stored
+std::string pathFor(const std::string& url);
+
+// True once the URL has been fetched, whether or not that produced an image
+bool isCached(const std::string& url);
+
+// Download and convert the image. Uses HttpDownloader's kept-alive connection, so a page of thumbnails from the
+// catalog server costs one connection. Returns true if a usable thumbnail is now stored.
+bool fetch(const std::string& url);
+
+}  // namespace OpdsThumbnails
@@ -1,14 +1,25 @@
 #include "OtaUpdater.h"
 
 #include <ArduinoJson.h>
+#include <HalPowerManager.h>
 #include <Logging.h>
+#include <freertos/task.h>
+
+#include <cstdlib>
 
 #include "esp_http_client.h"
-#include "esp_https_ota.h"
-#include "esp_wifi.h"
+#include "esp_ota_ops.h"
 
 namespace {
 constexpr char latestReleaseUrl[] = "https://api.github.com/repos/crosspoint-reader/crosspoint-reader/releases/latest";
+constexpr size_t DOWNLOAD_BUFFER_SIZE = 4096;
+constexpr int MAX_ATTEMPTS = 5;
+constexpr unsigned long RETRY_DELAY_MS = 2000;
+// Release assets redirect to a CDN, which may redirect again
+constexpr int MAX_REDIRECTS = 5;
+// TLS handshakes run on the calling task's stack
+constexpr uint32_t INSTALL_TASK_STACK_SIZE = 8192;
+constexpr UBaseType_t INSTALL_TASK_PRIORITY = 1;
 
 /* This is buffer and size holder to keep upcoming data from latestReleaseUrl */
 char* local_buf;
@@ -23,10 +34,6 @@ extern "C" {
 extern esp_err_t esp_crt_bundle_attach(void* conf);
 }
 
-esp_err_t http_client_set_header_cb(esp_http_client_handle_t http_client) {
-  return esp_http_client_set_header(http_client, "User-Agent", "CrossPoint-ESP32-" CROSSPOINT_VERSION);
-}
-
 esp_err_t event_handler(esp_http_client_event_t* event) {
   /* We do interested in only HTTP_EVENT_ON_DATA event only */
   if (event->event_id != HTTP_EVENT_ON_DATA) return ESP_OK;
@@ -200,15 +207,36 @@ bool OtaUpdater::isUpdateNewer() const {
 
 const std::string& OtaUpdater::getLatestVersion() const { return latestVersion; }
 
-OtaUpdater::OtaUpdaterError OtaUpdater::installUpdate() {
-  if (!isUpdateNewer()) {
-    return UPDATE_OLDER_ERROR;
+OtaUpdater::~OtaUpdater() {
+  // The task writes to this object; it can't be left running past it
+  while (installing) {
+    delay(10);
   }
+}
 
-  esp_https_ota_handle_t ota_handle = NULL;
-  esp_err_t esp_err;
-  /* Signal for OtaUpdateActivity */
-  render = false;
+bool OtaUpdater::startInstall() {
+  if (installing) {
+    return false;
+  }
+  installing = true;
+  const BaseType_t created = xTaskCreate(
+      [](void* param) {
+        auto* self = static_cast<OtaUpdater*>(param);
+        self->installResult = self->installUpdate();
+        self->installing = false;
+        vTaskDelete(nullptr);
+      },
+      "OtaInstall", INSTALL_TASK_STACK_SIZE, this, INSTALL_TASK_PRIORITY, nullptr);
+  if (created != pdPASS) {
+    LOG_ERR("OTA", "Failed to start install task");
+    installing = false;
+    return false;
+  }
+  return true;
+}
+
+OtaUpdater::OtaUpdaterError OtaUpdater::downloadAttempt(esp_ota_handle_t otaHandle, char* buffer, bool& retryable) {
+  retryable = false;
 
   esp_http_client_config_t client_config = {
       .url = otaUrl.c_str(),
@@ -224,46 +252,146 @@ OtaUpdater::OtaUpdaterError OtaUpdater::installUpdate() {
       .keep_alive_enable = true,
   };
 
-  esp_https_ota_config_t ota_config = {
-      .http_config = &client_config,
-      .http_client_init_cb = http_client_set_header_cb,
-  };
+  esp_http_client_handle_t client_handle = esp_http_client_init(&client_config);
+  if (!client_handle) {
+    LOG_ERR("OTA", "HTTP Client Handle Failed");
+    return INTERNAL_UPDATE_ERROR;
+  }
+  /* esp_http_client_close will be called inside cleanup as well */
+  struct ClientCleaner {
+    esp_http_client_handle_t handle;
+    ~ClientCleaner() { esp_http_client_cleanup(handle); }
+  } clientCleaner = {client_handle};
+
+  esp_http_client_set_header(client_handle, "User-Agent", "CrossPoint-ESP32-" CROSSPOINT_VERSION);
+  const size_t offset = processedSize;
+  if (offset > 0) {
+    const std::string range = "bytes=" + std::to_string(offset) + "-";
+    esp_http_client_set_header(client_handle, "Range", range.c_str());
+  }
+
+  int status = 0;
+  for (int redirects = 0;; redirects++) {
+    const esp_err_t esp_err = esp_http_client_open(client_handle, 0);
+    if (esp_err != ESP_OK) {
+      LOG_ERR("OTA", "esp_http_client_open Failed: %s", esp_err_to_name(esp_err));
+      retryable = true;
+      return HTTP_ERROR;
+    }
+    if (esp_http_client_fetch_headers(client_handle) < 0) {
+      LOG_ERR("OTA", "esp_http_client_fetch_headers Failed");
+      retryable = true;
+      return HTTP_ERROR;
+    }
+    status = esp_http_client_get_status_code(client_handle);
+    if (status < 300 || status >= 400 || redirects == MAX_REDIRECTS) {
+      break;
+    }
+    esp_http_client_flush_response(client_handle, nullptr);
+    esp_http_client_set_redirection(client_handle);
+  }
+
+  if (offset > 0 && status != 206) {
+    // What is already in the partition can't be rewound, so a server that ignores Range ends the update
+    LOG_ERR("OTA", "Server can't resume at %u bytes (status %d)", static_cast<unsigned>(offset), status);
+    return HTTP_ERROR;
+  }
+  if (offset == 0 && status != 200) {
+    LOG_ERR("OTA", "Firmware download failed with status %d", status);
+    retryable = status >= 500;
+    return HTTP_ERROR;
+  }
 
-  /* For better timing and connectivity, we disable power saving for WiFi */
-  esp_wifi_set_ps(WIFI_PS_NONE);
+  while (true) {
+    const int bytesRead = esp_http_client_read(client_handle, buffer, DOWNLOAD_BUFFER_SIZE);
+    if (bytesRead < 0) {
+      LOG_ERR("OTA", "Firmware read failed at %u bytes", static_cast<unsigned>(processedSize.load()));
+      retryable = true;
+      return HTTP_ERROR;
+    }
+    if (bytesRead == 0) {
+      break;
+    }
+    const esp_err_t esp_err = esp_ota_write(otaHandle, buffer, bytesRead);
+    if (esp_err != ESP_OK) {
+      LOG_ERR("OTA", "esp_ota_write Failed: %s", esp_err_to_name(esp_err));
+      return INTERNAL_UPDATE_ERROR;
+    }
+    processedSize += bytesRead;
+  }
 
-  esp_err = esp_https_ota_begin(&ota_config, &ota_handle);
+  if (!esp_http_client_is_complete_data_received(client_handle) ||
+      (totalSize > 0 && processedSize != totalSize)) {
+    // The connection ended early; continue from here on a new one
+    LOG_ERR("OTA", "Connection closed at %u of %u bytes", static_cast<unsigned>(processedSize.load()),
+            static_cast<unsigned>(totalSize));
+    retryable = processedSize < totalSize || totalSize == 0;
+    return HTTP_ERROR;
+  }
+  return OK;
+}
+
+OtaUpdater::OtaUpdaterError OtaUpdater::installUpdate() {
+  if (!isUpdateNewer()) {
+    return UPDATE_OLDER_ERROR;
+  }
+
+  const esp_partition_t* partition = esp_ota_get_next_update_partition(nullptr);
+  if (!partition) {
+    LOG_ERR("OTA", "No OTA partition to update");
+    return INTERNAL_UPDATE_ERROR;
+  }
+
+  esp_ota_handle_t ota_handle = 0;
+  // Sequential writes erase each sector as it is reached instead of the whole partition up front
+  esp_err_t esp_err = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
   if (esp_err != ESP_OK) {
-    LOG_DBG("OTA", "HTTP OTA Begin Failed: %s", esp_err_to_name(esp_err));
+    LOG_ERR("OTA", "esp_ota_begin Failed: %s", esp_err_to_name(esp_err));
     return INTERNAL_UPDATE_ERROR;
   }
 
-  do {
-    esp_err = esp_https_ota_perform(ota_handle);
-    processedSize = esp_https_ota_get_image_len_read(ota_handle);
-    /* Sent signal to  OtaUpdateActivity */
-    render = true;
-    delay(100);  // TODO: should we replace this with something better?
-  } while (esp_err == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+  auto* buffer = static_cast<char*>(malloc(DOWNLOAD_BUFFER_SIZE));
+  if (!buffer) {
+    LOG_ERR("OTA", "No memory for download buffer");
+    esp_ota_abort(ota_handle);
+    return OOM_ERROR;
+  }
+
+  processedSize = 0;
+
+  OtaUpdaterError result = HTTP_ERROR;
+  {
+    // Radio awake at full power for the download; back to modem sleep once it ends
+    HalPowerManager::NetworkTransfer transfer;
+    for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++) {
+      bool retryable = false;
+      result = downloadAttempt(ota_handle, buffer, retryable);
+      if (result == OK || !retryable || attempt == MAX_ATTEMPTS) {
+        break;
+      }
+      LOG_DBG("OTA", "Resuming at %u bytes (attempt %d of %d)", static_cast<unsigned>(processedSize.load()),
+              attempt + 1, MAX_ATTEMPTS);
+      delay(RETRY_DELAY_MS * attempt);
+    }
+  }
 
-  /* Return back to default power saving for WiFi in case of failing */
-  esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+  free(buffer);
 
-  if (esp_err != ESP_OK) {
-    LOG_ERR("OTA", "esp_https_ota_perform Failed: %s", esp_err_to_name(esp_err));
-    esp_https_ota_finish(ota_handle);
-    return HTTP_ERROR;
+  if (result != OK) {
+    esp_ota_abort(ota_handle);
+    return result;
   }
 
-  if (!esp_https_ota_is_complete_data_received(ota_handle)) {
-    LOG_ERR("OTA", "esp_https_ota_is_complete_data_received Failed: %s", esp_err_to_name(esp_err));
-    esp_https_ota_finish(ota_handle);
+  /* Validates the image header, segment checksums and the appended SHA-256 before anything can boot it */
+  esp_err = esp_ota_end(ota_handle);
+  if (esp_err != ESP_OK) {
+    LOG_ERR("OTA", "esp_ota_end Failed: %s", esp_err_to_name(esp_err));
     return INTERNAL_UPDATE_ERROR;
   }
 
-  esp_err = esp_https_ota_finish(ota_handle);
+  esp_err = esp_ota_set_boot_partition(partition);
   if (esp_err != ESP_OK) {
-    LOG_ERR("OTA", "esp_https_ota_finish Failed: %s", esp_err_to_name(esp_err));
+    LOG_ERR("OTA", "esp_ota_set_boot_partition Failed: %s", esp_err_to_name(esp_err));
     return INTERNAL_UPDATE_ERROR;
   }
 
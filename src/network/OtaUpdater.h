@@ -1,5 +1,8 @@
 #pragma once
 
+#include <esp_ota_ops.h>
+
+#include <atomic>
 #include <functional>
 #include <string>
 
@@ -8,9 +11,8 @@ class OtaUpdater {
   std::string latestVersion;
   std::string otaUrl;
   size_t otaSize = 0;
-  size_t processedSize = 0;
+  std::atomic<size_t> processedSize{0};
   size_t totalSize = 0;
-  bool render = false;
 
  public:
   enum OtaUpdaterError {
@@ -29,11 +31,30 @@ class OtaUpdater {
 
   size_t getTotalSize() const { return totalSize; }
 
-  bool getRender() const { return render; }
-
   OtaUpdater() = default;
+  ~OtaUpdater();
   bool isUpdateNewer() const;
   const std::string& getLatestVersion() const;
   OtaUpdaterError checkForUpdate();
+
+  /**
+   * Download the image straight into the next OTA partition and make it the boot partition. Blocks until done.
+   * A dropped connection is resumed with a Range request from the last byte written, so a flaky network doesn't
+   * restart a large download. The image is verified by esp_ota_end() before it is marked bootable.
+   */
   OtaUpdaterError installUpdate();
+
+  /**
+   * Run installUpdate() in a background task so the caller can keep drawing progress from getProcessedSize().
+   * Returns false if the task couldn't be started. Poll isInstalling() and then read getInstallResult().
+   */
+  bool startInstall();
+  bool isInstalling() const { return installing; }
+  OtaUpdaterError getInstallResult() const { return installResult; }
+
+ private:
+  std::atomic<bool> installing{false};
+  std::atomic<OtaUpdaterError> installResult{OK};
+
+  OtaUpdaterError downloadAttempt(esp_ota_handle_t otaHandle, char* buffer, bool& retryable);
 };
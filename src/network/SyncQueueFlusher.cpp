@@ -0,0 +1,61 @@
+#include "SyncQueueFlusher.h"
+
+#include <KOReaderCredentialStore.h>
+#include <KOReaderSyncQueue.h>
+#include <Logging.h>
+#include <WiFi.h>
+
+#include "WifiCredentialStore.h"
+
+namespace {
+constexpr unsigned long CONNECT_TIMEOUT_MS = 6000;
+// A TLS session needs about 40KB on top of what the caller is using
+constexpr uint32_t MIN_FREE_HEAP = 64 * 1024;
+
+bool shouldFlush() { return KOREADER_STORE.hasCredentials() && !KOREADER_SYNC_QUEUE.empty(); }
+}  // namespace
+
+void SyncQueueFlusher::flushIfConnected() {
+  if (WiFi.status() != WL_CONNECTED || !shouldFlush()) {
+    return;
+  }
+  if (ESP.getFreeHeap() < MIN_FREE_HEAP) {
+    LOG_DBG("SYNCQ", "Not enough heap to sync now (%u bytes free)", static_cast<unsigned>(ESP.getFreeHeap()));
+    return;
+  }
+  KOREADER_SYNC_QUEUE.flush();
+}
+
+void SyncQueueFlusher::flushBeforeSleep() {
+  if (!shouldFlush()) {
+    return;
+  }
+
+  WIFI_STORE.loadFromFile();
+  const auto* cred = WIFI_STORE.findCredential(WIFI_STORE.getLastConnectedSsid());
+  if (!cred) {
+    return;
+  }
+
+  const unsigned long start = millis();
+  WiFi.mode(WIFI_STA);
+  const char* password = cred->password.empty() ? nullptr : cred->password.c_str();
+  if (cred->channel > 0) {
+    WiFi.begin(cred->ssid.c_str(), password, cred->channel, cred->bssid);
+  } else {
+    WiFi.begin(cred->ssid.c_str(), password);
+  }
+  while (WiFi.status() != WL_CONNECTED && millis() - start < CONNECT_TIMEOUT_MS) {
+    delay(50);
+  }
+
+  if (WiFi.status() == WL_CONNECTED) {
+    LOG_DBG("SYNCQ", "Connected for sync in %lu ms", millis() - start);
+    KOREADER_SYNC_QUEUE.flush();
+  } else {
+    LOG_DBG("SYNCQ", "%s not reachable, keeping positions queued", cred->ssid.c_str());
+  }
+
+  WiFi.disconnect(false);
+  WiFi.mode(WIFI_OFF);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Uploads the reading positions queued in KOReaderSyncQueue in one batch, piggybacking on a WiFi session that is
+// up anyway, or bringing one up briefly on the way to sleep.
+namespace SyncQueueFlusher {
+
+// Flush over the current station connection, if there is one and enough heap for a TLS session
+void flushIfConnected();
+
+// Join the last used network on its remembered channel, flush and switch WiFi off again. Gives up quickly when the
+// network isn't in range, so sleeping away from it costs little. Does nothing with an empty queue.
+void flushBeforeSleep();
+
+}  // namespace SyncQueueFlusher
@@ -0,0 +1,233 @@
+#include "UploadWriter.h"
+
+#include <Logging.h>
+#include <esp_task_wdt.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr uint32_t TASK_STACK_SIZE = 4096;
+// Same priority as the loop task that services the sockets, so the two share the CPU while the card is busy
+constexpr UBaseType_t TASK_PRIORITY = 1;
+}  // namespace
+
+bool UploadWriter::begin(const char* moduleName, const String& path, const size_t expectedSize) {
+  abort();
+
+  if (!Storage.openFileForWrite(moduleName, path, file)) {
+    return false;
+  }
+
+  // Not fatal: without a contiguous run free the card still accepts the file, just cluster by cluster
+  preAllocated = expectedSize > 0 && file.preAllocate(expectedSize);
+  if (expectedSize > 0 && !preAllocated) {
+    LOG_DBG("UPW", "No contiguous extent for %u bytes, allocating as written", static_cast<unsigned>(expectedSize));
+  }
+
+  writeFailed = false;
+  bytesWritten = 0;
+  writeCount = 0;
+  writeTimeMs = 0;
+  currentPos = 0;
+
+  threaded = startTask();
+  if (!threaded) {
+    LOG_DBG("UPW", "Writer task unavailable, writing synchronously");
+    // Cards that write faster in larger blocks get them (see StorageProfile)
+    const size_t size = std::max<size_t>(FALLBACK_BUFFER_SIZE, Storage.profile().writeChunk);
+    storage = static_cast<uint8_t*>(malloc(size));
+    if (!storage) {
+      LOG_ERR("UPW", "Failed to allocate upload buffer");
+      file.close();
+      return false;
+    }
+    bufferSize = size;
+    current = storage;
+  }
+
+  active = true;
+  return true;
+}
+
+bool UploadWriter::startTask() {
+  storage = static_cast<uint8_t*>(malloc(BUFFER_SIZE * BUFFER_COUNT));
+  if (!storage) {
+    return false;
+  }
+
+  freeQueue = xQueueCreate(BUFFER_COUNT, sizeof(uint8_t*));
+  // One extra slot for the stop marker, so submitting never blocks
+  fullQueue = xQueueCreate(BUFFER_COUNT + 1, sizeof(Block));
+  if (!freeQueue || !fullQueue) {
+    releaseBuffers();
+    return false;
+  }
+  for (int i = 0; i < BUFFER_COUNT; i++) {
+    uint8_t* buffer = storage + i * BUFFER_SIZE;
+    xQueueSend(freeQueue, &buffer, 0);
+  }
+  bufferSize = BUFFER_SIZE;
+  current = nullptr;
+
+  taskRunning = true;
+  const BaseType_t created = xTaskCreate(
+      [](void* param) {
+        static_cast<UploadWriter*>(param)->run();
+        vTaskDelete(nullptr);
+      },
+      "UploadWriter", TASK_STACK_SIZE, this, TASK_PRIORITY, nullptr);
+  if (created != pdPASS) {
+    taskRunning = false;
+    releaseBuffers();
+    return false;
+  }
+  return true;
+}
+
+void UploadWriter::run() {
+  Block block;
+  while (xQueueReceive(fullQueue, &block, portMAX_DELAY) == pdTRUE && block.data) {
+    // After a failure keep cycling buffers back so the receiver never deadlocks; it sees writeFailed instead
+    if (!writeFailed) {
+      writeBlock(block.data, block.length);
+    }
+    xQueueSend(freeQueue, &block.data, portMAX_DELAY);
+  }
+  taskRunning = false;
+}
+
+bool UploadWriter::writeBlock(const uint8_t* data, const size_t length) {
+  const unsigned long start = millis();
+  const size_t written = file.write(data, length);
+  writeTimeMs += millis() - start;
+  writeCount++;
+
+  if (written != length) {
+    LOG_ERR("UPW", "SD write failed: expected %u, wrote %u", static_cast<unsigned>(length),
+            static_cast<unsigned>(written));
+    writeFailed = true;
+    return false;
+  }
+  bytesWritten += written;
+  return true;
+}
+
+bool UploadWriter::acquireBuffer() {
+  while (xQueueReceive(freeQueue, &current, pdMS_TO_TICKS(100)) != pdTRUE) {
+    // The card is a whole ring behind; keep the caller's watchdog fed while it catches up
+    esp_task_wdt_reset();
+  }
+  currentPos = 0;
+  return !writeFailed;
+}
+
+bool UploadWriter::submitCurrent() {
+  if (currentPos == 0) {
+    return !writeFailed;
+  }
+
+  if (!threaded) {
+    esp_task_wdt_reset();
+    const bool ok = writeBlock(current, currentPos);
+    esp_task_wdt_reset();
+    currentPos = 0;
+    return ok;
+  }
+
+  const Block block{current, currentPos};
+  xQueueSend(fullQueue, &block, portMAX_DELAY);
+  current = nullptr;
+  currentPos = 0;
+  return !writeFailed;
+}
+
+bool UploadWriter::write(const uint8_t* data, size_t length) {
+  if (!active || writeFailed) {
+    return false;
+  }
+
+  while (length > 0) {
+    if (!current && !acquireBuffer()) {
+      return false;
+    }
+    const size_t toCopy = std::min(length, bufferSize - currentPos);
+    memcpy(current + currentPos, data, toCopy);
+    currentPos += toCopy;
+    data += toCopy;
+    length -= toCopy;
+
+    if (currentPos == bufferSize && !submitCurrent()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void UploadWriter::stopTask() {
+  if (!taskRunning) {
+    return;
+  }
+  const Block stop{nullptr, 0};
+  xQueueSend(fullQueue, &stop, portMAX_DELAY);
+  while (taskRunning) {
+    esp_task_wdt_reset();
+    delay(1);
+  }
+}
+
+bool UploadWriter::finish() {
+  if (!active) {
+    return false;
+  }
+
+  bool ok = submitCurrent();
+  if (threaded) {
+    stopTask();
+  }
+  ok = ok && !writeFailed;
+
+  esp_task_wdt_reset();
+  // The reserved extent set the file size up front; drop whatever the client promised but never sent
+  if (preAllocated && !file.truncate(bytesWritten)) {
+    LOG_ERR("UPW", "Failed to trim preallocated file to %u bytes", static_cast<unsigned>(bytesWritten.load()));
+    ok = false;
+  }
+  file.close();
+  releaseBuffers();
+  active = false;
+  return ok;
+}
+
+void UploadWriter::abort() {
+  if (!active) {
+    return;
+  }
+
+  // Make the task skip whatever is still queued; the caller is about to delete the file
+  writeFailed = true;
+  currentPos = 0;
+  if (threaded) {
+    stopTask();
+  }
+  file.close();
+  releaseBuffers();
+  active = false;
+}
+
+void UploadWriter::releaseBuffers() {
+  if (freeQueue) {
+    vQueueDelete(freeQueue);
+    freeQueue = nullptr;
+  }
+  if (fullQueue) {
+    vQueueDelete(fullQueue);
+    fullQueue = nullptr;
+  }
+  free(storage);
+  storage = nullptr;
+  current = nullptr;
+  bufferSize = 0;
+  threaded = false;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <HalStorage.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include <atomic>
+
+// Streams an incoming upload to the SD card through a ring of buffers drained by a dedicated writer task, so the
+// network side keeps receiving while the card is busy with the previous buffer. The receiver only blocks once the
+// card has fallen a whole ring behind. Shared by the HTTP form upload, the WebSocket upload and WebDAV PUT.
+//
+// If the ring or the task cannot be allocated, the writer degrades to a single buffer flushed synchronously from
+// write(), which is how uploads behaved before.
+class UploadWriter {
+ public:
+  // Multiple of the 512 byte sector size, and no smaller than the largest StorageProfile::writeChunk
+  static constexpr size_t BUFFER_SIZE = 8 * 1024;
+  static constexpr int BUFFER_COUNT = 3;
+  static constexpr size_t FALLBACK_BUFFER_SIZE = 4096;
+
+  UploadWriter() = default;
+  ~UploadWriter() { abort(); }
+
+  UploadWriter(const UploadWriter&) = delete;
+  UploadWriter& operator=(const UploadWriter&) = delete;
+
+  // Create (truncate) the file at path and start the writer task. Returns false if the file could not be opened.
+  // When the client announced the upload size, expectedSize reserves one contiguous extent up front so streaming
+  // writes don't extend the FAT chain cluster by cluster; the file is trimmed to the bytes received in finish().
+  bool begin(const char* moduleName, const String& path, size_t expectedSize = 0);
+
+  // Queue data for writing. Blocks only while every buffer is waiting on the card. Returns false once any write
+  // has failed; the caller should then abort() and remove the file.
+  bool write(const uint8_t* data, size_t length);
+
+  // Write out everything still buffered, stop the task and close the file. Returns true if every byte was written.
+  bool finish();
+
+  // Stop the task and close the file, discarding buffered data. The partial file is left for the caller to remove.
+  void abort();
+
+  bool isOpen() const { return active; }
+  size_t getBytesWritten() const { return bytesWritten; }
+  size_t getWriteCount() const { return writeCount; }
+  unsigned long getWriteTimeMs() const { return writeTimeMs; }
+
+ private:
+  struct Block {
+    uint8_t* data;
+    size_t length;  // 0 with a null data pointer tells the task to exit
+  };
+
+  FsFile file;
+  uint8_t* storage = nullptr;  // malloc'd ring (or the single fallback buffer)
+  size_t bufferSize = 0;
+  QueueHandle_t freeQueue = nullptr;
+  QueueHandle_t fullQueue = nullptr;
+  bool active = false;
+  bool threaded = false;
+  bool preAllocated = false;
+  uint8_t* current = nullptr;
+  size_t currentPos = 0;
+
+  std::atomic<bool> taskRunning{false};
+  std::atomic<bool> writeFailed{false};
+  std::atomic<size_t> bytesWritten{0};
+  std::atomic<size_t> writeCount{0};
+  std::atomic<unsigned long> writeTimeMs{0};
+
+  bool startTask();
+  void stopTask();
+  void releaseBuffers();
+  bool acquireBuffer();
+  bool submitCurrent();
+  bool writeBlock(const uint8_t* data, size_t length);
+  void run();
+};
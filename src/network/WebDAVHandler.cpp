@@ -4,8 +4,18 @@
 #include <FsHelpers.h>
 #include <HalStorage.h>
 #include <Logging.h>
+#include <Serialization.h>
 #include <esp_task_wdt.h>
 
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "ChunkedWriter.h"
+#include "CrossPointWebServer.h"
+#include "FileResponse.h"
+#include "util/DirectoryListing.h"
+#include "util/LibraryIndex.h"
 #include "util/StringUtils.h"
 
 namespace {
@@ -16,6 +26,60 @@ constexpr size_t HIDDEN_ITEMS_COUNT = sizeof(HIDDEN_ITEMS) / sizeof(HIDDEN_ITEMS
 // ESP32 doesn't have real-time clock set by default, so we use a fixed epoch date
 // as a fallback. The date is not critical for WebDAV Class 1 operations.
 const char* FIXED_DATE = "Thu, 01 Jan 2024 00:00:00 GMT";
+
+constexpr char MULTISTATUS_OPEN[] =
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<D:multistatus xmlns:D=\"DAV:\">\n";
+constexpr char MULTISTATUS_CLOSE[] = "</D:multistatus>\n";
+
+constexpr size_t COPY_CHUNK_SIZE = 8 * 1024;
+
+constexpr char PROPFIND_CACHE_DIR[] = "/.crosspoint/dav";
+constexpr uint8_t PROPFIND_CACHE_VERSION = 1;
+// version, directory fingerprint, directory bytes
+constexpr size_t PROPFIND_CACHE_HEADER_SIZE = sizeof(uint8_t) + 2 * sizeof(uint32_t);
+
+struct MimeType {
+  const char* extension;
+  const char* type;
+};
+constexpr MimeType MIME_TYPES[] = {
+    {".epub", "application/epub+zip"},
+    {".pdf", "application/pdf"},
+    {".txt", "text/plain"},
+    {".html", "text/html"},
+    {".htm", "text/html"},
+    {".css", "text/css"},
+    {".js", "application/javascript"},
+    {".json", "application/json"},
+    {".xml", "application/xml"},
+    {".jpg", "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".png", "image/png"},
+    {".gif", "image/gif"},
+    {".svg", "image/svg+xml"},
+    {".zip", "application/zip"},
+    {".gz", "application/gzip"},
+};
+
+const char* mimeTypeFor(const char* path) {
+  const size_t pathLength = strlen(path);
+  for (const auto& mime : MIME_TYPES) {
+    const size_t extensionLength = strlen(mime.extension);
+    if (pathLength >= extensionLength && strcasecmp(path + pathLength - extensionLength, mime.extension) == 0) {
+      return mime.type;
+    }
+  }
+  return "application/octet-stream";
+}
+
+bool isHiddenName(const char* name) {
+  if (name[0] == '.') return true;
+  for (size_t i = 0; i < HIDDEN_ITEMS_COUNT; i++) {
+    if (strcmp(name, HIDDEN_ITEMS[i]) == 0) return true;
+  }
+  return false;
+}
 }  // namespace
 
 // ── RequestHandler interface ─────────────────────────────────────────────────
@@ -65,7 +129,7 @@ void WebDAVHandler::raw(WebServer& server, const String& uri, HTTPRaw& raw) {
       }
     }
 
-    if (_putFile) _putFile.close();
+    _putWriter.abort();
     _putExisted = Storage.exists(_putPath.c_str());
 
     if (_putExisted) {
@@ -81,20 +145,26 @@ void WebDAVHandler::raw(WebServer& server, const String& uri, HTTPRaw& raw) {
     // Write to a temp file to avoid destroying the original on failed upload
     String tempPath = _putPath + ".davtmp";
     Storage.remove(tempPath.c_str());
-    _putOk = Storage.openFileForWrite("DAV", tempPath, _putFile);
+    // Content-Length is known before the body arrives, so the whole file can be laid out contiguously
+    const size_t contentLength = server.clientContentLength();
+    _putOk = _putWriter.begin("DAV", tempPath, contentLength);
     LOG_DBG("DAV", "PUT START: %s", _putPath.c_str());
 
   } else if (raw.status == RAW_WRITE) {
-    if (_putFile && _putOk) {
+    if (_putWriter.isOpen() && _putOk) {
+      owner.noteTransferActivity();
       esp_task_wdt_reset();
-      size_t written = _putFile.write(raw.buf, raw.currentSize);
-      if (written != raw.currentSize) {
+      if (!_putWriter.write(raw.buf, raw.currentSize)) {
         _putOk = false;
       }
     }
 
   } else if (raw.status == RAW_END) {
-    if (_putFile) _putFile.close();
+    if (_putWriter.isOpen()) {
+      // Waits for the writer task to drain the last buffers
+      const bool written = _putWriter.finish();
+      _putOk = _putOk && written;
+    }
     if (_putOk) {
       String tempPath = _putPath + ".davtmp";
       if (_putExisted) Storage.remove(_putPath.c_str());
@@ -110,7 +180,7 @@ void WebDAVHandler::raw(WebServer& server, const String& uri, HTTPRaw& raw) {
     LOG_DBG("DAV", "PUT END: %u bytes, ok=%d", raw.totalSize, _putOk);
 
   } else if (raw.status == RAW_ABORTED) {
-    if (_putFile) _putFile.close();
+    _putWriter.abort();
     String tempPath = _putPath + ".davtmp";
     Storage.remove(tempPath.c_str());
     _putOk = false;
@@ -190,111 +260,182 @@ void WebDAVHandler::handlePropfind(WebServer& s) {
       // Root should always work — send minimal response
       s.setContentLength(CONTENT_LENGTH_UNKNOWN);
       s.send(207, "application/xml; charset=\"utf-8\"", "");
-      s.sendContent(
-          "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
-          "<D:multistatus xmlns:D=\"DAV:\">\n");
-      sendPropEntry(s, "/", true, 0, FIXED_DATE);
-      s.sendContent("</D:multistatus>\n");
-      s.sendContent("");
+      ChunkedWriter out(s);
+      out.print(MULTISTATUS_OPEN);
+      writePropEntry(out, "/", true, 0, "");
+      out.print(MULTISTATUS_CLOSE);
+      out.end();
       return;
     }
     s.send(500, "text/plain", "Failed to open");
     return;
   }
 
-  bool isDir = root.isDirectory();
+  if (!root.isDirectory()) {
+    s.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    s.send(207, "application/xml; charset=\"utf-8\"", "");
+    ChunkedWriter out(s);
+    out.print(MULTISTATUS_OPEN);
+    writePropEntry(out, path.c_str(), false, root.size(), FileResponse::etag(root).c_str());
+    root.close();
+    out.print(MULTISTATUS_CLOSE);
+    out.end();
+    return;
+  }
+
+  // A Depth: 1 listing only changes when the directory's own entries do, so it is cached on the card and validated
+  // against the directory fingerprint; clients that PROPFIND the same folder over and over get a file copy
+  uint32_t fingerprint = 0, dirBytes = 0;
+  const bool cacheable =
+      depth == 1 && DirectoryListing::fingerprintDirectory(path.c_str(), fingerprint, dirBytes);
+  const std::string cachePath = cacheable ? propfindCachePath(path) : std::string();
+  if (cacheable && sendCachedPropfind(s, cachePath, fingerprint, dirBytes)) {
+    root.close();
+    return;
+  }
 
   s.setContentLength(CONTENT_LENGTH_UNKNOWN);
   s.send(207, "application/xml; charset=\"utf-8\"", "");
-  s.sendContent(
-      "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
-      "<D:multistatus xmlns:D=\"DAV:\">\n");
+  ChunkedWriter out(s);
+
+  FsFile cache;
+  const std::string tempCachePath = cachePath + ".tmp";
+  if (cacheable) {
+    Storage.mkdir(PROPFIND_CACHE_DIR);
+    if (Storage.openFileForWrite("DAV", tempCachePath, cache)) {
+      serialization::writePod(cache, PROPFIND_CACHE_VERSION);
+      serialization::writePod(cache, fingerprint);
+      serialization::writePod(cache, dirBytes);
+      out.setTee(&cache);
+    }
+  }
 
-  // Entry for the resource itself
-  if (isDir) {
-    sendPropEntry(s, path, true, 0, FIXED_DATE);
-  } else {
-    sendPropEntry(s, path, false, root.size(), FIXED_DATE);
-    root.close();
-    s.sendContent("</D:multistatus>\n");
-    s.sendContent("");
-    return;
-  }
-
-  // If depth > 0 and it's a directory, list children
-  if (depth > 0) {
-    FsFile file = root.openNextFile();
-    char name[500];
-    while (file) {
-      file.getName(name, sizeof(name));
-      String fileName(name);
-
-      // Skip hidden/protected items
-      bool shouldHide = fileName.startsWith(".");
-      if (!shouldHide) {
-        for (size_t i = 0; i < HIDDEN_ITEMS_COUNT; i++) {
-          if (fileName.equals(HIDDEN_ITEMS[i])) {
-            shouldHide = true;
-            break;
-          }
-        }
-      }
+  out.print(MULTISTATUS_OPEN);
+  writePropEntry(out, path.c_str(), true, 0, "");
+  if (depth != 0) {
+    writeChildren(out, root, path.c_str(), depth == DEPTH_INFINITY);
+  }
+  root.close();
+  out.print(MULTISTATUS_CLOSE);
+  out.end();
+
+  if (cache) {
+    cache.close();
+    if (out.teeFailed()) {
+      Storage.remove(tempCachePath.c_str());
+    } else {
+      Storage.remove(cachePath.c_str());
+      Storage.rename(tempCachePath.c_str(), cachePath.c_str());
+    }
+  }
+}
+
+std::string WebDAVHandler::propfindCachePath(const String& path) {
+  return std::string(PROPFIND_CACHE_DIR) + "/" + std::to_string(std::hash<std::string>{}(path.c_str())) + ".xml";
+}
+
+bool WebDAVHandler::sendCachedPropfind(WebServer& s, const std::string& cachePath, const uint32_t fingerprint,
+                                       const uint32_t dirBytes) const {
+  FsFile cache;
+  if (!Storage.exists(cachePath.c_str()) || !Storage.openFileForRead("DAV", cachePath, cache)) {
+    return false;
+  }
+
+  uint8_t version;
+  uint32_t cachedFingerprint, cachedDirBytes;
+  serialization::readPod(cache, version);
+  serialization::readPod(cache, cachedFingerprint);
+  serialization::readPod(cache, cachedDirBytes);
+  const size_t size = cache.size();
+  if (version != PROPFIND_CACHE_VERSION || cachedFingerprint != fingerprint || cachedDirBytes != dirBytes ||
+      size <= PROPFIND_CACHE_HEADER_SIZE) {
+    cache.close();
+    return false;
+  }
 
-      if (!shouldHide) {
-        String childPath = path;
-        if (!childPath.endsWith("/")) childPath += "/";
-        childPath += fileName;
+  LOG_DBG("DAV", "PROPFIND served from cache");
+  s.setContentLength(size - PROPFIND_CACHE_HEADER_SIZE);
+  s.send(207, "application/xml; charset=\"utf-8\"", "");
+  FileResponse::sendBytes(s, cache, size - PROPFIND_CACHE_HEADER_SIZE);
+  cache.close();
+  return true;
+}
 
-        if (file.isDirectory()) {
-          sendPropEntry(s, childPath, true, 0, FIXED_DATE);
-        } else {
-          sendPropEntry(s, childPath, false, file.size(), FIXED_DATE);
-        }
+void WebDAVHandler::writeChildren(ChunkedWriter& out, FsFile& dir, const char* dirPath, const bool recursive) const {
+  // Walked iteratively: each level keeps its directory handle open so the walk resumes where it left off, and
+  // levels are capped so handles, path and stack stay bounded however deep the tree goes. Directories below the
+  // cap are still reported, just not descended into.
+  // Level 0 is the caller's directory, which the caller closes
+  struct Level {
+    FsFile dir;
+    size_t pathLength;
+  };
+  Level levels[MAX_WALK_DEPTH];
+  std::string path = dirPath;
+  levels[0].pathLength = path.size();
+  int top = 0;
+
+  char name[500];
+  while (top >= 0) {
+    FsFile& current = top == 0 ? dir : levels[top].dir;
+    FsFile file = current.openNextFile();
+    if (!file) {
+      if (top > 0) current.close();
+      top--;
+      if (top >= 0) {
+        path.resize(levels[top].pathLength);
       }
+      continue;
+    }
 
-      file.close();
-      yield();
-      esp_task_wdt_reset();
-      file = root.openNextFile();
+    file.getName(name, sizeof(name));
+    if (!isHiddenName(name)) {
+      if (path.empty() || path.back() != '/') path += '/';
+      path += name;
+
+      const bool isDir = file.isDirectory();
+      writePropEntry(out, path.c_str(), isDir, isDir ? 0 : file.size(),
+                     isDir ? "" : FileResponse::etag(file).c_str());
+      if (isDir && recursive && top + 1 < MAX_WALK_DEPTH) {
+        top++;
+        levels[top] = {std::move(file), path.size()};
+      } else {
+        path.resize(levels[top].pathLength);
+      }
     }
-  }
 
-  root.close();
-  s.sendContent("</D:multistatus>\n");
-  s.sendContent("");
+    if (file) file.close();
+    yield();
+    esp_task_wdt_reset();
+  }
 }
 
-void WebDAVHandler::sendPropEntry(WebServer& s, const String& path, bool isDir, size_t size,
-                                  const String& lastModified) const {
-  String href;
-  urlEncodePath(path, href);
+void WebDAVHandler::writePropEntry(ChunkedWriter& out, const char* path, const bool isDir, const size_t size,
+                                   const char* etag) const {
+  out.print("<D:response><D:href>");
+  writeEncodedPath(out, path);
   // Ensure directory hrefs end with /
-  if (isDir && !href.endsWith("/")) href += "/";
-
-  String xml = "<D:response><D:href>";
-  xml += href;
-  xml += "</D:href><D:propstat><D:prop>";
+  if (isDir && path[strlen(path) - 1] != '/') out.print('/');
+  out.print("</D:href><D:propstat><D:prop>");
 
   if (isDir) {
-    xml += "<D:resourcetype><D:collection/></D:resourcetype>";
+    out.print("<D:resourcetype><D:collection/></D:resourcetype>");
   } else {
-    xml += "<D:resourcetype/>";
-    xml += "<D:getcontentlength>";
-    xml += String(size);
-    xml += "</D:getcontentlength>";
-    String mime = getMimeType(path);
-    xml += "<D:getcontenttype>";
-    xml += mime;
-    xml += "</D:getcontenttype>";
+    out.print("<D:resourcetype/><D:getcontentlength>");
+    out.printNumber(size);
+    out.print("</D:getcontentlength><D:getcontenttype>");
+    out.print(mimeTypeFor(path));
+    out.print("</D:getcontenttype>");
+    if (etag[0] != '\0') {
+      out.print("<D:getetag>");
+      out.print(etag);
+      out.print("</D:getetag>");
+    }
   }
 
-  xml += "<D:getlastmodified>";
-  xml += lastModified;
-  xml += "</D:getlastmodified>";
-
-  xml += "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>\n";
-
-  s.sendContent(xml);
+  out.print("<D:getlastmodified>");
+  out.print(FIXED_DATE);
+  out.print("</D:getlastmodified></D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>\n");
 }
 
 // ── GET ──────────────────────────────────────────────────────────────────────
@@ -326,11 +467,8 @@ void WebDAVHandler::handleGet(WebServer& s) {
   }
 
   String contentType = getMimeType(path);
-  s.setContentLength(file.size());
-  s.send(200, contentType.c_str(), "");
-
-  NetworkClient client = s.client();
-  client.write(file);
+  owner.noteTransferActivity();
+  FileResponse::send(s, file, contentType.c_str());
   file.close();
 }
 
@@ -363,8 +501,7 @@ void WebDAVHandler::handleHead(WebServer& s) {
   }
 
   String contentType = getMimeType(path);
-  s.setContentLength(file.size());
-  s.send(200, contentType.c_str(), "");
+  FileResponse::send(s, file, contentType.c_str(), true);
   file.close();
 }
 
@@ -388,6 +525,7 @@ void WebDAVHandler::handlePut(WebServer& s) {
   }
 
   clearEpubCacheIfNeeded(path);
+  owner.recordCompletedUpload(path);
   s.send(_putExisted ? 204 : 201);
   LOG_DBG("DAV", "PUT complete: %s", path.c_str());
 }
@@ -438,6 +576,7 @@ void WebDAVHandler::handleDelete(WebServer& s) {
     file.close();
     clearEpubCacheIfNeeded(path);
     if (Storage.remove(path.c_str())) {
+      LibraryIndex::bookRemoved(path.c_str());
       s.send(204);
     } else {
       s.send(500, "text/plain", "Failed to delete file");
@@ -536,7 +675,15 @@ void WebDAVHandler::handleMove(WebServer& s) {
   }
 
   if (dstExists) {
-    Storage.remove(dstPath.c_str());
+    // Overwrite replaces a collection too, which remove() alone can't delete
+    FsFile existing = Storage.open(dstPath.c_str());
+    const bool existingIsDir = existing && existing.isDirectory();
+    if (existing) existing.close();
+    clearEpubCacheIfNeeded(dstPath);
+    if (existingIsDir ? !Storage.removeDir(dstPath.c_str()) : !Storage.remove(dstPath.c_str())) {
+      s.send(500, "text/plain", "Failed to replace destination");
+      return;
+    }
   }
 
   FsFile file = Storage.open(srcPath.c_str());
@@ -545,11 +692,13 @@ void WebDAVHandler::handleMove(WebServer& s) {
     return;
   }
 
-  clearEpubCacheIfNeeded(srcPath);
+  // Source and destination are on the same volume, so a move of a file or a whole folder only rewrites
+  // directory entries; no data is copied
   bool success = file.rename(dstPath.c_str());
   file.close();
 
   if (success) {
+    moveEpubCacheIfNeeded(srcPath, dstPath);
     s.send(dstExists ? 204 : 201);
   } else {
     s.send(500, "text/plain", "Move failed");
@@ -616,32 +765,48 @@ void WebDAVHandler::handleCopy(WebServer& s) {
   }
 
   if (dstExists) {
+    clearEpubCacheIfNeeded(dstPath);
     Storage.remove(dstPath.c_str());
   }
 
-  FsFile dstFile;
-  if (!Storage.openFileForWrite("DAV", dstPath, dstFile)) {
+  auto* buf = static_cast<uint8_t*>(malloc(COPY_CHUNK_SIZE));
+  if (!buf) {
+    srcFile.close();
+    s.send(507, "text/plain", "Not enough memory to copy");
+    return;
+  }
+
+  // Reads here overlap with the writer task flushing the previous chunks, and the destination gets one contiguous
+  // extent up front since its size is known
+  const size_t srcSize = srcFile.size();
+  UploadWriter writer;
+  if (!writer.begin("DAV", dstPath, srcSize)) {
+    free(buf);
     srcFile.close();
     s.send(500, "text/plain", "Failed to create destination");
     return;
   }
 
-  // Streaming copy with 4KB buffer on stack
-  uint8_t buf[4096];
+  const unsigned long start = millis();
   bool copyOk = true;
-  while (srcFile.available()) {
+  size_t copied = 0;
+  while (copied < srcSize) {
     esp_task_wdt_reset();
-    int bytesRead = srcFile.read(buf, sizeof(buf));
-    if (bytesRead <= 0) break;
-    size_t written = dstFile.write(buf, bytesRead);
-    if (written != (size_t)bytesRead) {
+    const int bytesRead = srcFile.read(buf, COPY_CHUNK_SIZE);
+    if (bytesRead <= 0 || !writer.write(buf, bytesRead)) {
       copyOk = false;
       break;
     }
+    copied += bytesRead;
   }
-
+  free(buf);
   srcFile.close();
-  dstFile.close();
+  if (copyOk) {
+    copyOk = writer.finish();
+  } else {
+    writer.abort();
+  }
+  LOG_DBG("DAV", "Copied %u bytes in %lu ms", static_cast<unsigned>(copied), millis() - start);
 
   if (copyOk) {
     s.send(dstExists ? 204 : 201);
@@ -733,31 +898,24 @@ String WebDAVHandler::getDestinationPath(WebServer& s) const {
   return result;
 }
 
-void WebDAVHandler::urlEncodePath(const String& path, String& out) const {
-  out = "";
-  for (unsigned int i = 0; i < path.length(); i++) {
-    char c = path.charAt(i);
-    if (c == '/') {
-      out += '/';
-    } else if (c == ' ') {
-      out += "%20";
-    } else if (c == '%') {
-      out += "%25";
-    } else if (c == '#') {
-      out += "%23";
-    } else if (c == '?') {
-      out += "%3F";
-    } else if (c == '&') {
-      out += "%26";
-    } else if ((uint8_t)c > 127) {
-      // Encode non-ASCII bytes
-      char hex[4];
-      snprintf(hex, sizeof(hex), "%%%02X", (uint8_t)c);
-      out += hex;
-    } else {
-      out += c;
+void WebDAVHandler::writeEncodedPath(ChunkedWriter& out, const char* path) {
+  // Besides URL-reserved characters, anything that isn't safe in XML text is escaped, so the href needs no further
+  // entity encoding
+  const char* runStart = path;
+  for (const char* p = path; *p; p++) {
+    const auto c = static_cast<uint8_t>(*p);
+    const bool escape = c <= ' ' || c > 126 || c == '%' || c == '#' || c == '?' || c == '&' || c == '<' ||
+                        c == '>' || c == '"';
+    if (!escape) {
+      continue;
     }
+    out.print(runStart, p - runStart);
+    char hex[4];
+    snprintf(hex, sizeof(hex), "%%%02X", c);
+    out.print(hex, 3);
+    runStart = p + 1;
   }
+  out.print(runStart);
 }
 
 bool WebDAVHandler::isProtectedPath(const String& path) const {
@@ -790,7 +948,8 @@ int WebDAVHandler::getDepth(WebServer& s) const {
   String depth = s.header("Depth");
   if (depth == "0") return 0;
   if (depth == "1") return 1;
-  // "infinity" or missing → treat as 1 (Class 1 servers don't need to support infinity)
+  if (depth.equalsIgnoreCase("infinity")) return DEPTH_INFINITY;
+  // Missing → treat as 1; RFC 4918 says infinity, but a client that didn't ask rarely wants the whole card walked
   return 1;
 }
 
@@ -800,6 +959,17 @@ bool WebDAVHandler::getOverwrite(WebServer& s) const {
   return true;  // Default is T
 }
 
+void WebDAVHandler::moveEpubCacheIfNeeded(const String& fromPath, const String& toPath) const {
+  LibraryIndex::bookMoved(fromPath.c_str(), toPath.c_str());
+  // Re-key the moved book's cache rather than clearing it, so it doesn't have to be indexed again
+  if (!StringUtils::checkFileExtension(fromPath, ".epub")) return;
+  if (StringUtils::checkFileExtension(toPath, ".epub")) {
+    Epub(fromPath.c_str(), "/.crosspoint").moveCache(toPath.c_str());
+  } else {
+    clearEpubCacheIfNeeded(fromPath);
+  }
+}
+
 void WebDAVHandler::clearEpubCacheIfNeeded(const String& path) const {
   if (StringUtils::checkFileExtension(path, ".epub")) {
     Epub(path.c_str(), "/.crosspoint").clearCache();
@@ -807,22 +977,4 @@ void WebDAVHandler::clearEpubCacheIfNeeded(const String& path) const {
   }
 }
 
-String WebDAVHandler::getMimeType(const String& path) const {
-  if (StringUtils::checkFileExtension(path, ".epub")) return "application/epub+zip";
-  if (StringUtils::checkFileExtension(path, ".pdf")) return "application/pdf";
-  if (StringUtils::checkFileExtension(path, ".txt")) return "text/plain";
-  if (StringUtils::checkFileExtension(path, ".html") || StringUtils::checkFileExtension(path, ".htm"))
-    return "text/html";
-  if (StringUtils::checkFileExtension(path, ".css")) return "text/css";
-  if (StringUtils::checkFileExtension(path, ".js")) return "application/javascript";
-  if (StringUtils::checkFileExtension(path, ".json")) return "application/json";
-  if (StringUtils::checkFileExtension(path, ".xml")) return "application/xml";
-  if (StringUtils::checkFileExtension(path, ".jpg") || StringUtils::checkFileExtension(path, ".jpeg"))
-    return "image/jpeg";
-  if (StringUtils::checkFileExtension(path, ".png")) return "image/png";
-  if (StringUtils::checkFileExtension(path, ".gif")) return "image/gif";
-  if (StringUtils::checkFileExtension(path, ".svg")) return "image/svg+xml";
-  if (StringUtils::checkFileExtension(path, ".zip")) return "application/zip";
-  if (StringUtils::checkFileExtension(path, ".gz")) return "application/gzip";
-  return "application/octet-stream";
-}
+String WebDAVHandler::getMimeType(const String& path) const { return mimeTypeFor(path.c_str()); }
@@ -3,8 +3,18 @@
 #include <HalStorage.h>
 #include <WebServer.h>
 
+#include "UploadWriter.h"
+
+#include <string>
+
+class ChunkedWriter;
+class CrossPointWebServer;
+
 class WebDAVHandler : public RequestHandler {
  public:
+  // owner is told about PUT traffic and finished uploads, like the server's own upload paths
+  explicit WebDAVHandler(const CrossPointWebServer& owner) : owner(owner) {}
+
   // RequestHandler interface
   bool canHandle(WebServer& server, HTTPMethod method, const String& uri) override;
   bool canRaw(WebServer& server, const String& uri) override;
@@ -12,8 +22,14 @@ class WebDAVHandler : public RequestHandler {
   bool handle(WebServer& server, HTTPMethod method, const String& uri) override;
 
  private:
+  static constexpr int DEPTH_INFINITY = -1;
+  // Directory levels held open by a Depth: infinity walk; deeper folders are listed but not descended into
+  static constexpr int MAX_WALK_DEPTH = 8;
+
+  const CrossPointWebServer& owner;
+
   // PUT streaming state (raw() is called in chunks)
-  FsFile _putFile;
+  UploadWriter _putWriter;
   String _putPath;
   bool _putOk = false;
   bool _putExisted = false;
@@ -34,11 +50,15 @@ class WebDAVHandler : public RequestHandler {
   // Utilities
   String getRequestPath(WebServer& s) const;
   String getDestinationPath(WebServer& s) const;
-  void urlEncodePath(const String& path, String& out) const;
+  static void writeEncodedPath(ChunkedWriter& out, const char* path);
   bool isProtectedPath(const String& path) const;
   int getDepth(WebServer& s) const;
   bool getOverwrite(WebServer& s) const;
   void clearEpubCacheIfNeeded(const String& path) const;
-  void sendPropEntry(WebServer& s, const String& href, bool isDir, size_t size, const String& lastModified) const;
+  void moveEpubCacheIfNeeded(const String& fromPath, const String& toPath) const;
+  void writePropEntry(ChunkedWriter& out, const char* path, bool isDir, size_t size, const char* etag) const;
+  void writeChildren(ChunkedWriter& out, FsFile& dir, const char* dirPath, bool recursive) const;
+  static std::string propfindCachePath(const String& path);
+  bool sendCachedPropfind(WebServer& s, const std::string& cachePath, uint32_t fingerprint, uint32_t dirBytes) const;
   String getMimeType(const String& path) const;
 };
@@ -0,0 +1,234 @@
+#include "BookCacheIndex.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "CrossPointSettings.h"
+
+namespace {
+constexpr char CACHE_ROOT[] = "/.crosspoint";
+constexpr char INDEX_PATH[] = "/.crosspoint/cache_index.bin";
+constexpr uint8_t INDEX_VERSION = 1;
+constexpr uint32_t MAX_ENTRIES = 4096;
+constexpr uint32_t MAX_NAME_LENGTH = 64;
+
+struct Entry {
+  std::string name;  // Directory under CACHE_ROOT
+  uint32_t lastRead = 0;
+  uint32_t bytes = 0;
+  bool seen = false;
+};
+
+struct Index {
+  uint32_t clock = 0;
+  std::vector<Entry> entries;
+
+  Entry& get(const std::string& name) {
+    for (auto& entry : entries) {
+      if (entry.name == name) {
+        return entry;
+      }
+    }
+    entries.push_back({name});
+    return entries.back();
+  }
+};
+
+void load(Index& index) {
+  FsFile file;
+  if (!Storage.exists(INDEX_PATH) || !Storage.openFileForRead("BCI", INDEX_PATH, file)) {
+    return;
+  }
+  uint8_t version = 0;
+  uint32_t count = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, index.clock);
+  serialization::readPod(file, count);
+  if (version != INDEX_VERSION || count > MAX_ENTRIES) {
+    index.clock = 0;
+    return;
+  }
+  index.entries.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t nameLength = 0;
+    serialization::readPod(file, nameLength);
+    if (nameLength == 0 || nameLength > MAX_NAME_LENGTH) {
+      break;
+    }
+    Entry entry;
+    entry.name.resize(nameLength);
+    if (file.read(&entry.name[0], nameLength) != static_cast<int>(nameLength)) {
+      break;
+    }
+    serialization::readPod(file, entry.lastRead);
+    serialization::readPod(file, entry.bytes);
+    index.entries.push_back(std::move(entry));
+  }
+}
+
+void save(const Index& index) {
+  const std::string tmpPath = std::string(INDEX_PATH) + ".tmp";
+  FsFile file;
+  if (!Storage.openFileForWrite("BCI", tmpPath, file)) {
+    return;
+  }
+  serialization::writePod(file, INDEX_VERSION);
+  serialization::writePod(file, index.clock);
+  serialization::writePod(file, static_cast<uint32_t>(index.entries.size()));
+  for (const auto& entry : index.entries) {
+    serialization::writeString(file, entry.name);
+    serialization::writePod(file, entry.lastRead);
+    serialization::writePod(file, entry.bytes);
+  }
+  if (!file.close()) {
+    Storage.remove(tmpPath.c_str());
+    return;
+  }
+  Storage.remove(INDEX_PATH);
+  if (!Storage.rename(tmpPath.c_str(), INDEX_PATH)) {
+    LOG_ERR("BCI", "Failed to store cache index");
+    Storage.remove(tmpPath.c_str());
+  }
+}
+
+bool isImageFile(const char* name) { return strncmp(name, "img_", 4) == 0; }
+
+// Total size of the files under dirPath, or only of the extracted images (and their pixel caches) directly in it
+// with imagesOnly
+uint64_t directoryBytes(const std::string& dirPath, const bool imagesOnly) {
+  auto dir = Storage.open(dirPath.c_str());
+  if (!dir || !dir.isDirectory()) {
+    return 0;
+  }
+  uint64_t total = 0;
+  char name[128];
+  for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
+    file.getName(name, sizeof(name));
+    if (file.isDirectory()) {
+      // Section files sit in one directory per layout
+      if (!imagesOnly) {
+        total += directoryBytes(dirPath + "/" + name, false);
+      }
+    } else if (!imagesOnly || isImageFile(name)) {
+      total += file.size();
+    }
+    file.close();
+  }
+  dir.close();
+  return total;
+}
+
+// Chapter layouts and extracted images: everything a book cache can lose and rebuild as it is read
+uint32_t rebuildableBytes(const std::string& cachePath) {
+  const uint64_t total = directoryBytes(cachePath + "/sections", false) + directoryBytes(cachePath, true);
+  return static_cast<uint32_t>(std::min<uint64_t>(total, UINT32_MAX));
+}
+
+void evict(const std::string& cachePath) {
+  Storage.removeDir((cachePath + "/sections").c_str());
+
+  // Collect first: removing entries while iterating the directory skips some of them
+  std::vector<std::string> images;
+  auto dir = Storage.open(cachePath.c_str());
+  if (dir && dir.isDirectory()) {
+    char name[128];
+    for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
+      file.getName(name, sizeof(name));
+      if (!file.isDirectory() && isImageFile(name)) {
+        images.emplace_back(name);
+      }
+      file.close();
+    }
+  }
+  if (dir) {
+    dir.close();
+  }
+  for (const auto& image : images) {
+    Storage.remove((cachePath + "/" + image).c_str());
+  }
+}
+
+// Adds book caches the index doesn't know yet (built before it existed) as read longest ago, and drops entries whose
+// cache was deleted
+void syncWithCacheRoot(Index& index) {
+  auto root = Storage.open(CACHE_ROOT);
+  if (!root || !root.isDirectory()) {
+    if (root) {
+      root.close();
+    }
+    return;
+  }
+  std::vector<std::string> unknown;
+  char name[128];
+  for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
+    file.getName(name, sizeof(name));
+    if (file.isDirectory() && strncmp(name, "epub_", 5) == 0 && strlen(name) <= MAX_NAME_LENGTH) {
+      const auto it = std::find_if(index.entries.begin(), index.entries.end(),
+                                   [&](const Entry& entry) { return entry.name == name; });
+      if (it != index.entries.end()) {
+        it->seen = true;
+      } else {
+        unknown.emplace_back(name);
+      }
+    }
+    file.close();
+  }
+  root.close();
+
+  index.entries.erase(std::remove_if(index.entries.begin(), index.entries.end(),
+                                     [](const Entry& entry) { return !entry.seen; }),
+                      index.entries.end());
+  for (auto& name : unknown) {
+    Entry entry;
+    entry.bytes = rebuildableBytes(std::string(CACHE_ROOT) + "/" + name);
+    entry.name = std::move(name);
+    index.entries.push_back(std::move(entry));
+  }
+}
+}  // namespace
+
+void BookCacheIndex::bookClosed(const std::string& cachePath) {
+  const size_t slash = cachePath.rfind('/');
+  const std::string name = slash == std::string::npos ? cachePath : cachePath.substr(slash + 1);
+  if (name.empty() || name.size() > MAX_NAME_LENGTH) {
+    return;
+  }
+
+  Index index;
+  load(index);
+  const uint32_t budget = SETTINGS.getReadingCacheLimitBytes();
+  if (budget > 0) {
+    syncWithCacheRoot(index);
+  }
+  Entry& current = index.get(name);
+  current.lastRead = ++index.clock;
+  current.bytes = rebuildableBytes(cachePath);
+
+  if (budget > 0) {
+    uint64_t total = 0;
+    for (const auto& entry : index.entries) {
+      total += entry.bytes;
+    }
+    if (total > budget) {
+      std::sort(index.entries.begin(), index.entries.end(),
+                [](const Entry& a, const Entry& b) { return a.lastRead < b.lastRead; });
+      // The book just read is last in the order and is never evicted, even if it alone is over the budget
+      for (size_t i = 0; i + 1 < index.entries.size() && total > budget; i++) {
+        Entry& entry = index.entries[i];
+        if (entry.bytes == 0) {
+          continue;
+        }
+        LOG_DBG("BCI", "Evicting %lu bytes of %s", static_cast<unsigned long>(entry.bytes), entry.name.c_str());
+        evict(std::string(CACHE_ROOT) + "/" + entry.name);
+        total -= entry.bytes;
+        entry.bytes = 0;
+      }
+    }
+  }
+  save(index);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+// Reading order and cache size of every book cached under /.crosspoint, kept in one small index file. It lets the
+// reading cache stay within the SD budget set in the settings: when the books' rebuildable data (chapter layouts and
+// extracted images, which dominate a book cache and are regenerated on demand) goes over the budget, that data is
+// dropped from the least recently read books first. Cheap data that is slow to rebuild or can't be rebuilt at all
+// (book.bin, the CSS and ZIP indexes, covers, thumbnails and reading progress) is always kept, so an evicted book
+// still shows up on the home screen and reopens where it was left.
+class BookCacheIndex {
+ public:
+  // Mark the book cached in cachePath as the most recently read one, re-measure its rebuildable data and, with a
+  // budget set, evict other books until the total fits. Call when the book is closed, so no chapter file is open.
+  static void bookClosed(const std::string& cachePath);
+};
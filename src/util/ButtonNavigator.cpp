@@ -73,6 +73,14 @@ bool ButtonNavigator::shouldNavigateContinuously() const {
   return buttonHeldLongEnough && navigationIntervalElapsed;
 }
 
+bool ButtonNavigator::isNavigationHeld() {
+  if (!mappedInput) return false;
+  const auto isHeld = [](const MappedInputManager::Button button) { return mappedInput->isPressed(button); };
+  const Buttons next = getNextButtons();
+  const Buttons previous = getPreviousButtons();
+  return std::any_of(next.begin(), next.end(), isHeld) || std::any_of(previous.begin(), previous.end(), isHeld);
+}
+
 int ButtonNavigator::nextIndex(const int currentIndex, const int totalItems) {
   if (totalItems <= 0) return 0;
 
@@ -0,0 +1,328 @@
+#include "DirectoryListing.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "util/StringUtils.h"
+
+namespace {
+constexpr char LISTINGS_DIR[] = "/.crosspoint/listings";
+constexpr uint32_t MAX_NAME_LENGTH = 500;
+constexpr size_t FINGERPRINT_CHUNK_SIZE = 512;
+constexpr uint32_t FNV_OFFSET_BASIS = 2166136261u;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+const std::string EMPTY_NAME;
+
+bool isListedFile(const std::string& filename) {
+  return StringUtils::checkFileExtension(filename, ".epub") || StringUtils::checkFileExtension(filename, ".xtch") ||
+         StringUtils::checkFileExtension(filename, ".xtc") || StringUtils::checkFileExtension(filename, ".txt") ||
+         StringUtils::checkFileExtension(filename, ".md") || StringUtils::checkFileExtension(filename, ".fb2") ||
+         StringUtils::checkFileExtension(filename, ".bmp");
+}
+
+void sortFileList(std::vector<std::string>& strs) {
+  std::sort(begin(strs), end(strs), [](const std::string& str1, const std::string& str2) {
+    // Directories first
+    bool isDir1 = str1.back() == '/';
+    bool isDir2 = str2.back() == '/';
+    if (isDir1 != isDir2) return isDir1;
+
+    // Start naive natural sort
+    const char* s1 = str1.c_str();
+    const char* s2 = str2.c_str();
+
+    // Iterate while both strings have characters
+    while (*s1 && *s2) {
+      // Check if both are at the start of a number
+      if (isdigit(*s1) && isdigit(*s2)) {
+        // Skip leading zeros and track them
+        const char* start1 = s1;
+        const char* start2 = s2;
+        while (*s1 == '0') s1++;
+        while (*s2 == '0') s2++;
+
+        // Count digits to compare lengths first
+        int len1 = 0, len2 = 0;
+        while (isdigit(s1[len1])) len1++;
+        while (isdigit(s2[len2])) len2++;
+
+        // Different length so return smaller integer value
+        if (len1 != len2) return len1 < len2;
+
+        // Same length so compare digit by digit
+        for (int i = 0; i < len1; i++) {
+          if (s1[i] != s2[i]) return s1[i] < s2[i];
+        }
+
+        // Numbers equal so advance pointers
+        s1 += len1;
+        s2 += len2;
+      } else {
+        // Regular case-insensitive character comparison
+        char c1 = tolower(*s1);
+        char c2 = tolower(*s2);
+        if (c1 != c2) return c1 < c2;
+        s1++;
+        s2++;
+      }
+    }
+
+    // One string is prefix of other
+    return *s1 == '\0' && *s2 != '\0';
+  });
+}
+}  // namespace
+
+bool DirectoryListing::fingerprintDirectory(const std::string& dirPath, uint32_t& fingerprint, uint32_t& dirBytes) {
+  auto dir = Storage.open(dirPath.c_str());
+  if (!dir || !dir.isDirectory()) {
+    if (dir) dir.close();
+    return false;
+  }
+
+  // Reading a directory as a file yields its raw entries (names, sizes, timestamps), so a single sequential read
+  // notices any change without opening every entry the way openNextFile() does
+  uint8_t buffer[FINGERPRINT_CHUNK_SIZE];
+  fingerprint = FNV_OFFSET_BASIS;
+  dirBytes = 0;
+  int bytesRead;
+  while ((bytesRead = dir.read(buffer, sizeof(buffer))) > 0) {
+    for (int i = 0; i < bytesRead; i++) {
+      fingerprint = (fingerprint ^ buffer[i]) * FNV_PRIME;
+    }
+    dirBytes += bytesRead;
+  }
+  dir.close();
+  return true;
+}
+
+bool DirectoryListing::open(const std::string& dirPath) {
+  clear();
+
+  uint32_t fingerprint, dirBytes;
+  if (!fingerprintDirectory(dirPath, fingerprint, dirBytes)) {
+    LOG_ERR("DIRL", "Cannot open directory %s", dirPath.c_str());
+    return false;
+  }
+
+  cachePath = std::string(LISTINGS_DIR) + "/" + std::to_string(std::hash<std::string>{}(dirPath)) + ".bin";
+  if (loadCache(fingerprint, dirBytes)) {
+    return true;
+  }
+  return build(dirPath, fingerprint, dirBytes);
+}
+
+void DirectoryListing::clear() {
+  cachePath.clear();
+  count = 0;
+  windowStart = 0;
+  window.clear();
+  jumps.clear();
+}
+
+void DirectoryListing::buildJumps(const std::vector<std::string>& entries) {
+  // Folders come first and are sorted on their own, so a letter may start a group twice
+  jumps.clear();
+  char previous = 0;
+  bool previousIsDir = false;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const char initial = JumpIndex::initialOf(entries[i]);
+    const bool isDir = entries[i].back() == '/';
+    if (i == 0 || initial != previous || isDir != previousIsDir) {
+      const char label[] = {initial, '\0'};
+      jumps.add(i, label);
+    }
+    previous = initial;
+    previousIsDir = isDir;
+  }
+}
+
+bool DirectoryListing::loadCache(const uint32_t fingerprint, const uint32_t dirBytes) {
+  FsFile file;
+  if (!Storage.exists(cachePath.c_str()) || !Storage.openFileForRead("DIRL", cachePath, file)) {
+    return false;
+  }
+
+  uint8_t version;
+  uint32_t cachedFingerprint, cachedDirBytes, cachedCount, jumpOffset;
+  serialization::readPod(file, version);
+  serialization::readPod(file, cachedFingerprint);
+  serialization::readPod(file, cachedDirBytes);
+  serialization::readPod(file, cachedCount);
+  serialization::readPod(file, jumpOffset);
+  bool valid = version == CACHE_VERSION && cachedFingerprint == fingerprint && cachedDirBytes == dirBytes &&
+               file.size() >= HEADER_SIZE + cachedCount * sizeof(uint32_t) && file.seek(jumpOffset);
+
+  std::vector<JumpIndex::Group> groups;
+  uint16_t groupCount = 0;
+  if (valid) {
+    serialization::readPod(file, groupCount);
+    valid = groupCount <= MAX_JUMP_GROUPS;
+  }
+  for (uint16_t i = 0; valid && i < groupCount; i++) {
+    JumpIndex::Group group{};
+    uint8_t initial;
+    serialization::readPod(file, group.firstRow);
+    serialization::readPod(file, initial);
+    group.label[0] = static_cast<char>(initial);
+    valid = group.firstRow < cachedCount && (groups.empty() || group.firstRow > groups.back().firstRow);
+    groups.push_back(group);
+  }
+  file.close();
+
+  if (!valid) {
+    LOG_DBG("DIRL", "Listing cache stale, rebuilding");
+    return false;
+  }
+  jumps.setGroups(std::move(groups));
+
+  count = cachedCount;
+  windowStart = 0;
+  return true;
+}
+
+bool DirectoryListing::build(const std::string& dirPath, const uint32_t fingerprint, const uint32_t dirBytes) {
+  const uint32_t start = millis();
+  std::vector<std::string> entries;
+
+  auto root = Storage.open(dirPath.c_str());
+  if (!root || !root.isDirectory()) {
+    if (root) root.close();
+    cachePath.clear();
+    return false;
+  }
+
+  char name[MAX_NAME_LENGTH];
+  for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
+    file.getName(name, sizeof(name));
+    if (name[0] == '.' || strcmp(name, "System Volume Information") == 0) {
+      file.close();
+      continue;
+    }
+
+    if (file.isDirectory()) {
+      entries.emplace_back(std::string(name) + "/");
+    } else {
+      auto filename = std::string(name);
+      if (isListedFile(filename)) {
+        entries.emplace_back(std::move(filename));
+      }
+    }
+    file.close();
+  }
+  root.close();
+  sortFileList(entries);
+  count = entries.size();
+  buildJumps(entries);
+
+  // Offset table first so any row can be reached with two seeks
+  FsFile file;
+  Storage.mkdir(LISTINGS_DIR);
+  if (!Storage.openFileForWrite("DIRL", cachePath, file)) {
+    // Still usable, just not persisted: keep everything in the window
+    cachePath.clear();
+    window = std::move(entries);
+    return true;
+  }
+
+  // The jump table goes after the names
+  uint32_t jumpOffset = HEADER_SIZE + count * sizeof(uint32_t);
+  for (const auto& entry : entries) {
+    jumpOffset += sizeof(uint32_t) + entry.size();
+  }
+
+  serialization::writePod(file, CACHE_VERSION);
+  serialization::writePod(file, fingerprint);
+  serialization::writePod(file, dirBytes);
+  serialization::writePod(file, count);
+  serialization::writePod(file, jumpOffset);
+  uint32_t offset = HEADER_SIZE + count * sizeof(uint32_t);
+  for (const auto& entry : entries) {
+    serialization::writePod(file, offset);
+    offset += sizeof(uint32_t) + entry.size();
+  }
+  for (const auto& entry : entries) {
+    serialization::writeString(file, entry);
+  }
+  const auto& groups = jumps.getGroups();
+  const auto groupCount = static_cast<uint16_t>(std::min<size_t>(groups.size(), MAX_JUMP_GROUPS));
+  serialization::writePod(file, groupCount);
+  for (uint16_t i = 0; i < groupCount; i++) {
+    serialization::writePod(file, groups[i].firstRow);
+    serialization::writePod(file, static_cast<uint8_t>(groups[i].label[0]));
+  }
+  file.close();
+
+  LOG_DBG("DIRL", "Listed %u entries of %s in %lu ms", static_cast<unsigned>(count), dirPath.c_str(), millis() - start);
+  // The first page is what gets drawn next
+  entries.resize(std::min<size_t>(entries.size(), WINDOW_SIZE));
+  window = std::move(entries);
+  windowStart = 0;
+  return true;
+}
+
+void DirectoryListing::loadWindow(const size_t first) {
+  // Without a cache file everything is already in the window
+  if (cachePath.empty()) {
+    return;
+  }
+  window.clear();
+  windowStart = first;
+
+  FsFile file;
+  if (!Storage.openFileForRead("DIRL", cachePath, file)) {
+    return;
+  }
+
+  uint32_t offset;
+  if (!file.seek(HEADER_SIZE + first * sizeof(uint32_t))) {
+    file.close();
+    return;
+  }
+  serialization::readPod(file, offset);
+  if (!file.seek(offset)) {
+    file.close();
+    return;
+  }
+
+  const size_t last = std::min<size_t>(count, first + WINDOW_SIZE);
+  window.reserve(last - first);
+  for (size_t i = first; i < last; i++) {
+    uint32_t len;
+    serialization::readPod(file, len);
+    if (len == 0 || len > MAX_NAME_LENGTH) {
+      LOG_ERR("DIRL", "Corrupt listing cache entry %u", static_cast<unsigned>(i));
+      break;
+    }
+    std::string& name = window.emplace_back();
+    name.resize(len);
+    file.read(&name[0], len);
+  }
+  file.close();
+}
+
+const std::string& DirectoryListing::get(const size_t index) {
+  if (index >= count) {
+    return EMPTY_NAME;
+  }
+  if (index < windowStart || index >= windowStart + window.size()) {
+    loadWindow(index / WINDOW_SIZE * WINDOW_SIZE);
+    if (index < windowStart || index >= windowStart + window.size()) {
+      return EMPTY_NAME;
+    }
+  }
+  return window[index - windowStart];
+}
+
+size_t DirectoryListing::find(const std::string& name) {
+  for (size_t i = 0; i < count; i++) {
+    if (get(i) == name) return i;
+  }
+  return 0;
+}
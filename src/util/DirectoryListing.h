@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "JumpIndex.h"
+
+// Sorted listing of the folders and books in one SD card directory, kept in /.crosspoint/listings so reopening a
+// large folder doesn't enumerate and sort it again. The cache is validated against a hash of the directory's raw
+// entries, which changes whenever anything in it is added, removed or renamed (on the device or elsewhere).
+// Names stay in the cache file; only a window of rows around the ones being drawn is held in memory. The cache also
+// keeps where each initial letter starts (separately for folders and files), for jumping through long listings.
+class DirectoryListing {
+ public:
+  // Validate (or rebuild) the cache for the directory. Returns false if the directory can't be read, in which
+  // case the listing is empty.
+  bool open(const std::string& dirPath);
+  void clear();
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  // Folder names end in '/'. Returns an empty string if the row can't be read.
+  const std::string& get(size_t index);
+  // Index of the entry with this name, or 0 if it isn't listed
+  size_t find(const std::string& name);
+  const JumpIndex& getJumpIndex() const { return jumps; }
+
+  // Hash of the directory's raw entries; changes whenever anything in it is added, removed, renamed or resized.
+  // Also used by the web server as a listing ETag.
+  static bool fingerprintDirectory(const std::string& dirPath, uint32_t& fingerprint, uint32_t& dirBytes);
+
+ private:
+  static constexpr uint8_t CACHE_VERSION = 2;
+  static constexpr size_t WINDOW_SIZE = 32;
+  // version, fingerprint, directory bytes, entry count, jump table offset
+  static constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + 4 * sizeof(uint32_t);
+  static constexpr uint32_t MAX_JUMP_GROUPS = 128;
+
+  std::string cachePath;
+  uint32_t count = 0;
+  size_t windowStart = 0;
+  std::vector<std::string> window;
+  JumpIndex jumps;
+
+  void buildJumps(const std::vector<std::string>& entries);
+
+  bool loadCache(uint32_t fingerprint, uint32_t dirBytes);
+  bool build(const std::string& dirPath, uint32_t fingerprint, uint32_t dirBytes);
+  void loadWindow(size_t first);
+};
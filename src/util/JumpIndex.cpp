@@ -0,0 +1,64 @@
+#include "JumpIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+char JumpIndex::initialOf(const std::string& name) {
+  const auto first = name.empty() ? 0 : static_cast<uint8_t>(name[0]);
+  return first < 0x80 && isalpha(first) ? static_cast<char>(toupper(first)) : '#';
+}
+
+void JumpIndex::add(const uint32_t firstRow, const char* label) {
+  if (!groups.empty() && groups.back().firstRow >= firstRow) {
+    return;
+  }
+  Group group{};
+  group.firstRow = firstRow;
+  strncpy(group.label, label, LABEL_SIZE - 1);
+  groups.push_back(group);
+}
+
+void JumpIndex::buildEven(const uint32_t totalRows, const uint32_t groupCount) {
+  groups.clear();
+  if (totalRows == 0 || groupCount == 0) {
+    return;
+  }
+  for (uint32_t i = 0; i < groupCount; i++) {
+    char label[LABEL_SIZE];
+    snprintf(label, sizeof(label), "%u%%", static_cast<unsigned>(i * 100 / groupCount));
+    add(static_cast<uint32_t>(static_cast<uint64_t>(totalRows) * i / groupCount), label);
+  }
+}
+
+int JumpIndex::groupOf(const int row) const {
+  const auto it = std::upper_bound(groups.begin(), groups.end(), row, [](const int value, const Group& group) {
+    return value < static_cast<int>(group.firstRow);
+  });
+  return static_cast<int>(it - groups.begin()) - 1;
+}
+
+int JumpIndex::nextGroupRow(const int row) const {
+  if (groups.empty()) {
+    return row;
+  }
+  const int next = groupOf(row) + 1;
+  return static_cast<int>(groups[next < static_cast<int>(groups.size()) ? next : 0].firstRow);
+}
+
+int JumpIndex::previousGroupRow(const int row) const {
+  if (groups.empty()) {
+    return row;
+  }
+  int group = groupOf(row);
+  if (group >= 0 && static_cast<int>(groups[group].firstRow) == row) {
+    group--;
+  }
+  return static_cast<int>(groups[group >= 0 ? group : groups.size() - 1].firstRow);
+}
+
+const char* JumpIndex::labelOf(const int row) const {
+  const int group = groupOf(row);
+  return group >= 0 ? groups[group].label : "";
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// First row of every group of a long list, with a short label for each: the initial letters of a sorted listing, or
+// evenly spaced stops through a list with no order of its own. Holding a navigation button steps from group to group
+// instead of page to page, so any row of a list of thousands is a handful of jumps away.
+class JumpIndex {
+ public:
+  static constexpr size_t LABEL_SIZE = 6;
+
+  struct Group {
+    uint32_t firstRow;
+    char label[LABEL_SIZE];  // NUL-terminated
+  };
+
+  // Label of a name in a sorted listing: its first letter in upper case, '#' for anything but an ASCII letter
+  static char initialOf(const std::string& name);
+
+  void clear() { groups.clear(); }
+  // Groups must be added in row order; a row already starting a group is ignored
+  void add(uint32_t firstRow, const char* label);
+  // groupCount stops spread evenly over totalRows, labelled with how far through the list they are ("40%")
+  void buildEven(uint32_t totalRows, uint32_t groupCount);
+
+  // Jumping is only worth it with more than one group
+  bool usable() const { return groups.size() > 1; }
+  const std::vector<Group>& getGroups() const { return groups; }
+  void setGroups(std::vector<Group> newGroups) { groups = std::move(newGroups); }
+
+  // First row of the next group, wrapping to the first one
+  int nextGroupRow(int row) const;
+  // First row of row's group, or of the previous group when row is already there; wraps to the last one
+  int previousGroupRow(int row) const;
+  // Label of the group row is in, empty if there are no groups
+  const char* labelOf(int row) const;
+
+ private:
+  std::vector<Group> groups;
+
+  // Index of the group row is in, -1 before the first
+  int groupOf(int row) const;
+};
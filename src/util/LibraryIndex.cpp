@@ -0,0 +1,573 @@
+#include "LibraryIndex.h"
+
+#include <Logging.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+namespace {
+constexpr char RECORDS_PATH[] = "/.crosspoint/library.bin";
+constexpr char ORDER_PATH[] = "/.crosspoint/library.ord";
+constexpr char ORDER_TMP_PATH[] = "/.crosspoint/library.ord.tmp";
+constexpr uint8_t ORDER_VERSION = 1;
+constexpr uint32_t MAX_BOOKS = UINT16_MAX;
+
+constexpr uint8_t FLAG_HAS_THUMB = 0x01;
+
+struct Record {
+  char path[232];  // All text fields NUL-terminated, cut on a UTF-8 character boundary
+  char title[128];
+  char author[64];
+  char series[56];
+  char language[16];
+  uint32_t fileSize;
+  uint32_t fileModified;  // FAT date << 16 | FAT time
+  uint32_t lastOpened;
+  uint8_t progress;
+  uint8_t flags;
+  uint8_t reserved[2];
+};
+static_assert(sizeof(Record) == 512, "Records must fill a sector");
+
+struct OrderHeader {
+  uint8_t version;
+  uint8_t reserved[3];
+  uint32_t count;
+  uint32_t recentCount;
+  uint32_t clock;  // lastOpened of the most recently opened book
+};
+
+// Orders in the order file, one after the other; RECENT only has recentCount rows
+enum Section : uint8_t { PATH, TITLE, AUTHOR, RECENT, SECTION_COUNT };
+
+Section sectionOf(const LibraryIndex::Order order) {
+  switch (order) {
+    case LibraryIndex::Order::AUTHOR:
+      return AUTHOR;
+    case LibraryIndex::Order::RECENT:
+      return RECENT;
+    case LibraryIndex::Order::TITLE:
+    default:
+      return TITLE;
+  }
+}
+
+SemaphoreHandle_t mutex() {
+  static SemaphoreHandle_t handle = xSemaphoreCreateMutex();
+  return handle;
+}
+
+class Guard {
+ public:
+  Guard() { xSemaphoreTake(mutex(), portMAX_DELAY); }
+  ~Guard() { xSemaphoreGive(mutex()); }
+  Guard(const Guard&) = delete;
+  Guard& operator=(const Guard&) = delete;
+};
+
+template <size_t N>
+void copyField(char (&field)[N], const std::string& value) {
+  size_t len = std::min(value.size(), N - 1);
+  // Don't leave half a UTF-8 sequence behind
+  if (len < value.size()) {
+    while (len > 0 && (static_cast<uint8_t>(value[len]) & 0xC0) == 0x80) {
+      len--;
+    }
+  }
+  memset(field, 0, N);
+  memcpy(field, value.data(), len);
+}
+
+// Case-insensitive for ASCII, byte order for everything else
+int compareText(const char* a, const char* b) {
+  while (*a && tolower(static_cast<uint8_t>(*a)) == tolower(static_cast<uint8_t>(*b))) {
+    a++;
+    b++;
+  }
+  return tolower(static_cast<uint8_t>(*a)) - tolower(static_cast<uint8_t>(*b));
+}
+
+// Like compareText, on the first prefixLen bytes only: 0 when text starts with prefix
+int comparePrefix(const char* text, const char* prefix, const size_t prefixLen) {
+  for (size_t i = 0; i < prefixLen; i++) {
+    const int diff = tolower(static_cast<uint8_t>(text[i])) - tolower(static_cast<uint8_t>(prefix[i]));
+    if (diff != 0 || text[i] == '\0') {
+      return diff;
+    }
+  }
+  return 0;
+}
+
+int compare(const Section section, const Record& a, const Record& b) {
+  int result = 0;
+  switch (section) {
+    case TITLE:
+      result = compareText(a.title, b.title);
+      break;
+    case AUTHOR:
+      result = compareText(a.author, b.author);
+      if (result == 0) {
+        result = compareText(a.title, b.title);
+      }
+      break;
+    case RECENT:
+      // Most recent first
+      if (a.lastOpened != b.lastOpened) {
+        return a.lastOpened > b.lastOpened ? -1 : 1;
+      }
+      break;
+    default:
+      break;
+  }
+  return result != 0 ? result : strcmp(a.path, b.path);
+}
+
+bool fingerprint(const std::string& path, uint32_t& fileSize, uint32_t& fileModified) {
+  FsFile file;
+  if (!Storage.openFileForRead("LIB", path, file)) {
+    return false;
+  }
+  uint16_t date = 0;
+  uint16_t time = 0;
+  fileSize = file.size();
+  file.getModifyDateTime(&date, &time);
+  fileModified = static_cast<uint32_t>(date) << 16 | time;
+  file.close();
+  return true;
+}
+
+std::string fileTitle(const std::string& path) {
+  const size_t slash = path.find_last_of('/');
+  std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+  const size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos && dot > 0) {
+    name.resize(dot);
+  }
+  return name;
+}
+
+// The whole index for a writer: the orders in memory, the records read one at a time as the binary searches need them
+class Store {
+ public:
+  uint32_t clock = 0;
+
+  ~Store() {
+    if (records) {
+      records.close();
+    }
+  }
+
+  bool load();
+  bool save();
+  uint32_t count() const { return orders[PATH].size(); }
+
+  bool read(uint16_t slot, Record& record);
+  bool write(uint16_t slot, const Record& record);
+  // Slot of the book at path, false if it isn't indexed
+  bool find(const char* path, uint16_t& slot);
+
+  // (Re)write the record and put it where it belongs in every order
+  bool put(uint16_t slot, const Record& record);
+  bool remove(uint16_t slot);
+
+ private:
+  FsFile records;
+  std::vector<uint16_t> orders[SECTION_COUNT];
+
+  void erase(uint16_t slot);
+  bool insert(Section section, uint16_t slot, const Record& record);
+};
+
+bool Store::load() {
+  Storage.mkdir("/.crosspoint");
+  records = Storage.open(RECORDS_PATH, O_RDWR | O_CREAT);
+  if (!records) {
+    LOG_ERR("LIB", "Cannot open %s", RECORDS_PATH);
+    return false;
+  }
+  const uint32_t slots = records.size() / sizeof(Record);
+
+  FsFile file;
+  if (!Storage.exists(ORDER_PATH) || !Storage.openFileForRead("LIB", ORDER_PATH, file)) {
+    return true;
+  }
+  OrderHeader header{};
+  bool ok = file.read(&header, sizeof(header)) == sizeof(header) && header.version == ORDER_VERSION &&
+            header.count <= slots && header.recentCount <= header.count;
+  for (int section = 0; ok && section < SECTION_COUNT; section++) {
+    auto& order = orders[section];
+    order.resize(section == RECENT ? header.recentCount : header.count);
+    const int bytes = static_cast<int>(order.size() * sizeof(uint16_t));
+    ok = file.read(order.data(), bytes) == bytes &&
+         std::all_of(order.begin(), order.end(), [&](const uint16_t slot) { return slot < header.count; });
+  }
+  file.close();
+
+  if (!ok) {
+    // Everything in it can be gathered again, as books are prepared or opened
+    LOG_ERR("LIB", "Library index unreadable, starting over");
+    for (auto& order : orders) {
+      order.clear();
+    }
+    return true;
+  }
+  clock = header.clock;
+  return true;
+}
+
+bool Store::save() {
+  FsFile file;
+  if (!Storage.openFileForWrite("LIB", ORDER_TMP_PATH, file)) {
+    return false;
+  }
+  OrderHeader header{};
+  header.version = ORDER_VERSION;
+  header.count = count();
+  header.recentCount = orders[RECENT].size();
+  header.clock = clock;
+  bool ok = file.write(&header, sizeof(header)) == sizeof(header);
+  for (const auto& order : orders) {
+    const size_t bytes = order.size() * sizeof(uint16_t);
+    ok = ok && file.write(order.data(), bytes) == bytes;
+  }
+  file.close();
+
+  if (!ok || (Storage.exists(ORDER_PATH) && !Storage.remove(ORDER_PATH)) || !Storage.rename(ORDER_TMP_PATH, ORDER_PATH)) {
+    LOG_ERR("LIB", "Failed to save library index");
+    Storage.remove(ORDER_TMP_PATH);
+    return false;
+  }
+  return true;
+}
+
+bool Store::read(const uint16_t slot, Record& record) {
+  return records.seek(static_cast<size_t>(slot) * sizeof(Record)) &&
+         records.read(&record, sizeof(Record)) == sizeof(Record);
+}
+
+bool Store::write(const uint16_t slot, const Record& record) {
+  return records.seek(static_cast<size_t>(slot) * sizeof(Record)) &&
+         records.write(&record, sizeof(Record)) == sizeof(Record);
+}
+
+bool Store::find(const char* path, uint16_t& slot) {
+  const auto& order = orders[PATH];
+  size_t lo = 0;
+  size_t hi = order.size();
+  Record record;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (!read(order[mid], record)) {
+      return false;
+    }
+    const int result = strcmp(record.path, path);
+    if (result == 0) {
+      slot = order[mid];
+      return true;
+    }
+    if (result < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
+void Store::erase(const uint16_t slot) {
+  for (auto& order : orders) {
+    const auto it = std::find(order.begin(), order.end(), slot);
+    if (it != order.end()) {
+      order.erase(it);
+    }
+  }
+}
+
+bool Store::insert(const Section section, const uint16_t slot, const Record& record) {
+  auto& order = orders[section];
+  size_t lo = 0;
+  size_t hi = order.size();
+  Record other;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (!read(order[mid], other)) {
+      return false;
+    }
+    if (compare(section, other, record) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  order.insert(order.begin() + lo, slot);
+  return true;
+}
+
+bool Store::put(const uint16_t slot, const Record& record) {
+  if (!write(slot, record)) {
+    LOG_ERR("LIB", "Failed to write library record %u", slot);
+    return false;
+  }
+  erase(slot);
+  for (int section = 0; section < SECTION_COUNT; section++) {
+    if (section == RECENT && record.lastOpened == 0) {
+      continue;
+    }
+    if (!insert(static_cast<Section>(section), slot, record)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Store::remove(const uint16_t slot) {
+  erase(slot);
+  // The last record fills the hole, so records stay contiguous
+  const uint16_t last = count();
+  if (slot != last) {
+    Record record;
+    if (!read(last, record) || !write(slot, record)) {
+      return false;
+    }
+    for (auto& order : orders) {
+      std::replace(order.begin(), order.end(), last, slot);
+    }
+  }
+  if (!save()) {
+    return false;
+  }
+  records.truncate(static_cast<size_t>(last) * sizeof(Record));
+  return true;
+}
+
+// Record of the book at path for a writer to change: the indexed one, or a new one at the end. False if the book
+// can't be indexed.
+bool prepareRecord(Store& store, const std::string& path, uint16_t& slot, Record& record) {
+  if (path.size() >= sizeof(Record::path)) {
+    LOG_DBG("LIB", "Path too long to index: %s", path.c_str());
+    return false;
+  }
+  uint32_t fileSize;
+  uint32_t fileModified;
+  if (!fingerprint(path, fileSize, fileModified)) {
+    return false;
+  }
+
+  if (store.find(path.c_str(), slot)) {
+    if (!store.read(slot, record)) {
+      return false;
+    }
+    if (record.fileSize != fileSize || record.fileModified != fileModified) {
+      // Another book under the same name; its reader caches were cleared along with the old one
+      record.progress = 0;
+      record.fileSize = fileSize;
+      record.fileModified = fileModified;
+    }
+    return true;
+  }
+
+  if (store.count() >= MAX_BOOKS) {
+    return false;
+  }
+  slot = store.count();
+  memset(&record, 0, sizeof(record));
+  copyField(record.path, path);
+  copyField(record.title, fileTitle(path));
+  record.fileSize = fileSize;
+  record.fileModified = fileModified;
+  return true;
+}
+}  // namespace
+
+void LibraryIndex::bookPrepared(const Book& book) {
+  Guard guard;
+  Store store;
+  uint16_t slot;
+  Record record;
+  if (!store.load() || !prepareRecord(store, book.path, slot, record)) {
+    return;
+  }
+
+  const Record before = record;
+  if (!book.title.empty()) {
+    copyField(record.title, book.title);
+  }
+  copyField(record.author, book.author);
+  copyField(record.language, book.language);
+  copyField(record.series, book.series);
+  record.flags = book.hasThumb ? record.flags | FLAG_HAS_THUMB : record.flags & ~FLAG_HAS_THUMB;
+
+  // Preparing a book again is common (every upload hook run, every library preparation); leave the files alone then
+  if (slot < store.count() && memcmp(&before, &record, sizeof(Record)) == 0) {
+    return;
+  }
+  if (store.put(slot, record)) {
+    store.save();
+  }
+}
+
+void LibraryIndex::bookOpened(const std::string& path, const std::string& title, const std::string& author,
+                              const bool hasThumb) {
+  Guard guard;
+  Store store;
+  uint16_t slot;
+  Record record;
+  if (!store.load() || !prepareRecord(store, path, slot, record)) {
+    return;
+  }
+
+  if (!title.empty()) {
+    copyField(record.title, title);
+  }
+  if (!author.empty()) {
+    copyField(record.author, author);
+  }
+  if (hasThumb) {
+    record.flags |= FLAG_HAS_THUMB;
+  }
+  record.lastOpened = ++store.clock;
+  if (store.put(slot, record)) {
+    store.save();
+  }
+}
+
+void LibraryIndex::setProgress(const std::string& path, const int percent) {
+  Guard guard;
+  Store store;
+  uint16_t slot;
+  Record record;
+  if (!store.load() || !store.find(path.c_str(), slot) || !store.read(slot, record)) {
+    return;
+  }
+  const auto progress = static_cast<uint8_t>(std::max(0, std::min(100, percent)));
+  if (record.progress != progress) {
+    // No order depends on progress, the record alone changes
+    record.progress = progress;
+    store.write(slot, record);
+  }
+}
+
+void LibraryIndex::bookRemoved(const std::string& path) {
+  Guard guard;
+  Store store;
+  uint16_t slot;
+  if (store.load() && store.find(path.c_str(), slot)) {
+    store.remove(slot);
+  }
+}
+
+void LibraryIndex::bookMoved(const std::string& fromPath, const std::string& toPath) {
+  Guard guard;
+  Store store;
+  uint16_t slot;
+  if (!store.load()) {
+    return;
+  }
+  // Whatever was indexed at the destination has just been replaced
+  if (store.find(toPath.c_str(), slot) && !store.remove(slot)) {
+    return;
+  }
+  Record record;
+  if (!store.find(fromPath.c_str(), slot) || !store.read(slot, record)) {
+    return;
+  }
+  if (toPath.size() >= sizeof(Record::path)) {
+    store.remove(slot);
+    return;
+  }
+  copyField(record.path, toPath);
+  if (store.put(slot, record)) {
+    store.save();
+  }
+}
+
+bool LibraryIndex::open() {
+  close();
+  Guard guard;
+  if (!Storage.exists(ORDER_PATH) || !Storage.exists(RECORDS_PATH) ||
+      !Storage.openFileForRead("LIB", ORDER_PATH, orderFile)) {
+    return false;
+  }
+  OrderHeader header{};
+  if (orderFile.read(&header, sizeof(header)) != sizeof(header) || header.version != ORDER_VERSION ||
+      !Storage.openFileForRead("LIB", RECORDS_PATH, recordsFile) ||
+      recordsFile.size() < static_cast<size_t>(header.count) * sizeof(Record)) {
+    close();
+    return false;
+  }
+  count = header.count;
+  recentCount = header.recentCount;
+  return true;
+}
+
+void LibraryIndex::close() {
+  if (orderFile) {
+    orderFile.close();
+  }
+  if (recordsFile) {
+    recordsFile.close();
+  }
+  count = 0;
+  recentCount = 0;
+}
+
+size_t LibraryIndex::size(const Order order) const { return order == Order::RECENT ? recentCount : count; }
+
+bool LibraryIndex::readSlot(const Order order, const size_t row, uint16_t& slot) {
+  if (row >= size(order)) {
+    return false;
+  }
+  const size_t offset = sizeof(OrderHeader) + (sectionOf(order) * static_cast<size_t>(count) + row) * sizeof(uint16_t);
+  return orderFile.seek(offset) && orderFile.read(&slot, sizeof(slot)) == sizeof(slot) && slot < count;
+}
+
+bool LibraryIndex::get(const Order order, const size_t row, Book& book) {
+  uint16_t slot;
+  Record record;
+  if (!readSlot(order, row, slot) || !recordsFile.seek(static_cast<size_t>(slot) * sizeof(Record)) ||
+      recordsFile.read(&record, sizeof(Record)) != sizeof(Record)) {
+    return false;
+  }
+  book.path = record.path;
+  book.title = record.title;
+  book.author = record.author;
+  book.language = record.language;
+  book.series = record.series;
+  book.lastOpened = record.lastOpened;
+  book.progress = record.progress;
+  book.hasThumb = record.flags & FLAG_HAS_THUMB;
+  return true;
+}
+
+void LibraryIndex::findTitlePrefix(const std::string& prefix, size_t& first, size_t& last) {
+  const auto titleAt = [this](const size_t row, Record& record) {
+    uint16_t slot;
+    return readSlot(Order::TITLE, row, slot) && recordsFile.seek(static_cast<size_t>(slot) * sizeof(Record)) &&
+           recordsFile.read(&record, sizeof(Record)) == sizeof(Record);
+  };
+  // First row not before the prefix, then the first row after it
+  const auto bound = [&](const bool upper) {
+    size_t lo = 0;
+    size_t hi = count;
+    Record record;
+    while (lo < hi) {
+      const size_t mid = (lo + hi) / 2;
+      if (!titleAt(mid, record)) {
+        return lo;
+      }
+      const int result = comparePrefix(record.title, prefix.c_str(), prefix.size());
+      if (result < 0 || (upper && result == 0)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  };
+  first = bound(false);
+  last = std::max(first, bound(true));
+}
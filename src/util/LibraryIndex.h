@@ -0,0 +1,69 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Title, author, language, series, cover thumbnail and reading state of every book the device has prepared or
+// opened, so lists of books can be shown, sorted and filtered without opening a single one of them.
+//
+// Books are fixed-size records in /.crosspoint/library.bin, one 512-byte sector each, in no particular order. Next to
+// them, /.crosspoint/library.ord holds the record numbers sorted by path, by title and by author, and those of the
+// books that were opened, most recent first. Any row of any order is then two seeks away however large the library
+// is, and a title prefix is a binary search. Writers keep the orders sorted by binary search as well, reading only the
+// records they compare against; the order file (two bytes per book per order) is the only thing rewritten whole.
+//
+// The index is fed by BookPreparer (upload hook and library preparation), RecentBooksStore (a book was opened) and the
+// readers (progress on close); file deletes and moves drop or re-key their entry. Each record keeps the size and
+// modification time of its file, so a book replaced under the same name is told apart and starts over at 0%.
+class LibraryIndex {
+ public:
+  enum class Order : uint8_t { TITLE, AUTHOR, RECENT };
+
+  struct Book {
+    std::string path;
+    std::string title;
+    std::string author;
+    std::string language;
+    std::string series;
+    uint32_t lastOpened = 0;  // Larger is more recent, 0 if never opened
+    uint8_t progress = 0;     // Percent
+    bool hasThumb = false;
+  };
+
+  // Writers; safe to call from any task. Books whose path doesn't fit a record aren't indexed.
+
+  // Metadata of a book whose caches were just built. Cheap when the book is indexed already and unchanged.
+  static void bookPrepared(const Book& book);
+  // The book was opened: it becomes the most recent one. Title and author replace the indexed ones when set.
+  static void bookOpened(const std::string& path, const std::string& title, const std::string& author, bool hasThumb);
+  static void setProgress(const std::string& path, int percent);
+  static void bookRemoved(const std::string& path);
+  static void bookMoved(const std::string& fromPath, const std::string& toPath);
+
+  LibraryIndex() = default;
+  ~LibraryIndex() { close(); }
+  LibraryIndex(const LibraryIndex&) = delete;
+  LibraryIndex& operator=(const LibraryIndex&) = delete;
+
+  // Reading: open() snapshots the index until close(); writers must not run in between (the library views call
+  // them only after closing)
+  bool open();
+  void close();
+
+  // RECENT only counts the books that were opened
+  size_t size(Order order) const;
+  bool get(Order order, size_t row, Book& book);
+  // Rows [first, last) of the title order whose title starts with prefix, ignoring ASCII case
+  void findTitlePrefix(const std::string& prefix, size_t& first, size_t& last);
+
+ private:
+  FsFile recordsFile;
+  FsFile orderFile;
+  uint32_t count = 0;
+  uint32_t recentCount = 0;
+
+  bool readSlot(Order order, size_t row, uint16_t& slot);
+};
@@ -0,0 +1,83 @@
+#include "ScreenCache.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+constexpr char CACHE_DIR[] = "/.crosspoint/screens";
+constexpr uint8_t CACHE_VERSION = 2;
+// Menus with a few cover thumbnails compress to 10-20KB; anything larger isn't worth the SD time
+constexpr size_t MAX_FRAME_SIZE = 32 * 1024;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+std::string screenPath(const char* screen) { return std::string(CACHE_DIR) + "/" + screen + ".bin"; }
+}  // namespace
+
+ScreenCache::Key& ScreenCache::Key::add(const char* value) { return add(value, value ? strlen(value) : 0); }
+
+ScreenCache::Key& ScreenCache::Key::add(const void* data, const size_t size) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  // Separator, so ("ab", "c") and ("a", "bc") differ
+  hash = (hash ^ 0xFF) * FNV_PRIME;
+  return *this;
+}
+
+bool ScreenCache::load(const GfxRenderer& renderer, const char* screen, const uint32_t key) {
+  const std::string path = screenPath(screen);
+  FsFile file;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("SCC", path, file)) {
+    return false;
+  }
+
+  const auto start = millis();
+  uint8_t version = 0;
+  uint32_t cachedKey = 0;
+  uint32_t frameSize = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, cachedKey);
+  serialization::readPod(file, frameSize);
+  if (version != CACHE_VERSION || cachedKey != key || frameSize == 0 || frameSize > MAX_FRAME_SIZE) {
+    LOG_DBG("SCC", "Cached %s screen is stale", screen);
+    return false;
+  }
+  std::vector<uint8_t> frame(frameSize);
+  const bool ok = file.read(frame.data(), frameSize) == static_cast<int>(frameSize);
+  file.close();
+  if (!ok || !renderer.restoreCompressedFrame(frame)) {
+    return false;
+  }
+  LOG_DBG("SCC", "Loaded cached %s screen (%u bytes) in %lu ms", screen, frameSize, millis() - start);
+  return true;
+}
+
+void ScreenCache::save(const GfxRenderer& renderer, const char* screen, const uint32_t key) {
+  const std::string path = screenPath(screen);
+  std::vector<uint8_t> frame;
+  if (!renderer.storeCompressedFrame(frame, MAX_FRAME_SIZE)) {
+    Storage.remove(path.c_str());
+    return;
+  }
+
+  Storage.mkdir(CACHE_DIR);
+  FsFile file;
+  if (!Storage.openFileForWrite("SCC", path, file)) {
+    return;
+  }
+  serialization::writePod(file, CACHE_VERSION);
+  serialization::writePod(file, key);
+  serialization::writePod(file, static_cast<uint32_t>(frame.size()));
+  const bool ok = file.write(frame.data(), frame.size()) == frame.size();
+  file.close();
+  if (!ok) {
+    Storage.remove(path.c_str());
+    return;
+  }
+  LOG_DBG("SCC", "Cached %s screen (%zu bytes)", screen, frame.size());
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <GfxRenderer.h>
+
+#include <cstdint>
+#include <string>
+
+// Fully composed UI screens, kept PackBits-compressed under /.crosspoint/screens (one file per screen). A screen is
+// stored with a key over everything it shows, and only a frame whose key matches the current state is loaded, so
+// returning to an unchanged screen costs one small file read instead of redrawing it (for Home: decoding the cover
+// thumbnails and probing the SD card for each of them).
+//
+// Parts that change on their own, like the battery level, are not meant to go into the key: callers redraw them
+// over the loaded frame.
+class ScreenCache {
+ public:
+  // FNV-1a over the state a screen depends on
+  class Key {
+   public:
+    Key& add(const std::string& value) { return add(value.data(), value.size()); }
+    Key& add(const char* value);
+    Key& add(uint32_t value) { return add(&value, sizeof(value)); }
+    uint32_t get() const { return hash; }
+
+   private:
+    uint32_t hash = 2166136261u;
+    Key& add(const void* data, size_t size);
+  };
+
+  // Load the stored frame of screen into the frame buffer, without displaying it. Returns false if there is none
+  // for key, in which case the frame buffer must be redrawn.
+  static bool load(const GfxRenderer& renderer, const char* screen, uint32_t key);
+  // Store the frame buffer as screen in state key. Frames that don't compress well are not stored.
+  static void save(const GfxRenderer& renderer, const char* screen, uint32_t key);
+};
@@ -0,0 +1,166 @@
+#include "SleepFrameCache.h"
+
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <cstdio>
+
+#include "CrossPointSettings.h"
+
+namespace {
+constexpr char CACHE_DIR[] = "/.crosspoint/sleep_frames";
+constexpr uint8_t CACHE_VERSION = 1;
+constexpr uint32_t MAX_PATH_LENGTH = 500;
+
+constexpr uint32_t FNV_OFFSET_BASIS = 2166136261u;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+// Everything a cached screen depends on besides the pixels
+struct EntryKey {
+  uint32_t sourceSize = 0;
+  uint16_t sourceDate = 0;
+  uint16_t sourceTime = 0;
+  uint8_t orientation = 0;
+  uint8_t coverMode = 0;
+  uint8_t coverFilter = 0;
+
+  bool operator==(const EntryKey& other) const {
+    return sourceSize == other.sourceSize && sourceDate == other.sourceDate && sourceTime == other.sourceTime &&
+           orientation == other.orientation && coverMode == other.coverMode && coverFilter == other.coverFilter;
+  }
+};
+
+bool currentKey(const GfxRenderer& renderer, const std::string& sourcePath, EntryKey& key) {
+  FsFile source = Storage.open(sourcePath.c_str());
+  if (!source) {
+    return false;
+  }
+  key.sourceSize = source.size();
+  source.getModifyDateTime(&key.sourceDate, &key.sourceTime);
+  source.close();
+  key.orientation = static_cast<uint8_t>(renderer.getOrientation());
+  key.coverMode = SETTINGS.sleepScreenCoverMode;
+  key.coverFilter = SETTINGS.sleepScreenCoverFilter;
+  return true;
+}
+
+std::string slotPath(const char* slot) { return std::string(CACHE_DIR) + "/" + slot + ".bin"; }
+}  // namespace
+
+std::string SleepFrameCache::imageSlot(const std::string& imagePath) {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (const char c : imagePath) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= FNV_PRIME;
+  }
+  char slot[12];
+  snprintf(slot, sizeof(slot), "img_%08lx", static_cast<unsigned long>(hash));
+  return slot;
+}
+
+bool SleepFrameCache::show(GfxRenderer& renderer, const char* slot, const std::string& sourcePath) {
+  const std::string path = slotPath(slot);
+  FsFile file;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("SFC", path, file)) {
+    return false;
+  }
+
+  uint8_t version = 0;
+  uint32_t pathLength = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, pathLength);
+  if (version != CACHE_VERSION || pathLength > MAX_PATH_LENGTH) {
+    return false;
+  }
+  std::string cachedPath(pathLength, '\0');
+  if (pathLength > 0 && file.read(&cachedPath[0], pathLength) != static_cast<int>(pathLength)) {
+    return false;
+  }
+  EntryKey cachedKey;
+  serialization::readPod(file, cachedKey);
+
+  EntryKey key;
+  if (cachedPath != sourcePath || !currentKey(renderer, sourcePath, key) || !(key == cachedKey)) {
+    LOG_DBG("SFC", "Cached sleep screen in %s is stale", slot);
+    return false;
+  }
+
+  const size_t planeBytes = file.size() - file.position();
+  if (planeBytes != HalDisplay::BUFFER_SIZE && planeBytes != 3 * HalDisplay::BUFFER_SIZE) {
+    return false;
+  }
+
+  const auto start = millis();
+  uint8_t* frameBuffer = renderer.getFrameBuffer();
+  if (file.read(frameBuffer, HalDisplay::BUFFER_SIZE) != static_cast<int>(HalDisplay::BUFFER_SIZE)) {
+    return false;
+  }
+  renderer.displayBuffer(HalDisplay::HALF_REFRESH);
+
+  if (planeBytes > HalDisplay::BUFFER_SIZE) {
+    if (file.read(frameBuffer, HalDisplay::BUFFER_SIZE) == static_cast<int>(HalDisplay::BUFFER_SIZE)) {
+      renderer.copyGrayscaleLsbBuffers();
+      if (file.read(frameBuffer, HalDisplay::BUFFER_SIZE) == static_cast<int>(HalDisplay::BUFFER_SIZE)) {
+        renderer.copyGrayscaleMsbBuffers();
+        renderer.displayGrayBuffer();
+      }
+    }
+  }
+  LOG_DBG("SFC", "Showed cached sleep screen %s in %lu ms", slot, millis() - start);
+  return true;
+}
+
+SleepFrameCache::Recorder::Recorder(const GfxRenderer& renderer, const char* slot, const std::string& sourcePath)
+    : renderer(renderer), path(slotPath(slot)) {
+  EntryKey key;
+  if (sourcePath.size() > MAX_PATH_LENGTH || !currentKey(renderer, sourcePath, key)) {
+    failed = true;
+    return;
+  }
+
+  Storage.mkdir(CACHE_DIR);
+  if (!Storage.openFileForWrite("SFC", path + ".tmp", file)) {
+    failed = true;
+    return;
+  }
+  serialization::writePod(file, CACHE_VERSION);
+  serialization::writeString(file, sourcePath);
+  serialization::writePod(file, key);
+}
+
+SleepFrameCache::Recorder::~Recorder() {
+  if (file) {
+    file.close();
+    Storage.remove((path + ".tmp").c_str());
+  }
+}
+
+void SleepFrameCache::Recorder::addPlane() {
+  if (failed) {
+    return;
+  }
+  if (file.write(renderer.getFrameBuffer(), HalDisplay::BUFFER_SIZE) != HalDisplay::BUFFER_SIZE) {
+    LOG_ERR("SFC", "Failed to write sleep screen plane");
+    failed = true;
+    return;
+  }
+  planeCount++;
+}
+
+void SleepFrameCache::Recorder::commit() {
+  if (failed || (planeCount != 1 && planeCount != 3)) {
+    return;
+  }
+  const std::string tmpPath = path + ".tmp";
+  if (!file.close()) {
+    Storage.remove(tmpPath.c_str());
+    return;
+  }
+  Storage.remove(path.c_str());
+  if (!Storage.rename(tmpPath.c_str(), path.c_str())) {
+    LOG_ERR("SFC", "Failed to store sleep screen %s", path.c_str());
+    Storage.remove(tmpPath.c_str());
+    return;
+  }
+  LOG_DBG("SFC", "Cached sleep screen with %u plane(s) in %s", planeCount, path.c_str());
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <GfxRenderer.h>
+#include <HalStorage.h>
+
+#include <string>
+
+// Sleep screens baked into panel-native frames under /.crosspoint/sleep_frames. The first time an image (or a
+// book's cover) is used as the sleep screen, its planes are recorded as they are drawn: the black and white frame
+// and, for grayscale images, the LSB and MSB planes. Later sleeps push those planes straight to the panel, skipping
+// the BMP decode, scaling and dithering and, for covers, loading the book and generating its cover BMP.
+//
+// An entry belongs to a slot (one file) and remembers the source file's size and FAT timestamp and the orientation
+// and sleep screen settings it was drawn with. Any difference makes it stale and the screen is drawn normally.
+class SleepFrameCache {
+ public:
+  // Slot for the cover of the current book. There is only one, so covers of finished books don't pile up.
+  static constexpr char COVER_SLOT[] = "cover";
+  // Slot for a custom sleep image, one per image
+  static std::string imageSlot(const std::string& imagePath);
+
+  // Show the cached screen for sourcePath. Returns false, with nothing drawn, if there is no current entry.
+  static bool show(GfxRenderer& renderer, const char* slot, const std::string& sourcePath);
+
+  // Records the planes of a sleep screen while it is drawn. Call addPlane() with each plane in the frame buffer
+  // (black and white first, then LSB and MSB), then commit(). An uncommitted recording is discarded.
+  class Recorder {
+   public:
+    Recorder(const GfxRenderer& renderer, const char* slot, const std::string& sourcePath);
+    ~Recorder();
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    void addPlane();
+    void commit();
+
+   private:
+    const GfxRenderer& renderer;
+    std::string path;
+    FsFile file;
+    uint8_t planeCount = 0;
+    bool failed = false;
+  };
+};
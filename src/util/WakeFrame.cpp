@@ -0,0 +1,74 @@
+#include "WakeFrame.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <vector>
+
+namespace {
+constexpr char WAKE_FRAME_FILE[] = "/.crosspoint/wake_frame.bin";
+constexpr uint8_t WAKE_FRAME_VERSION = 2;
+// Text pages compress to 5-20KB; pages with large images aren't worth the SD time and are skipped
+constexpr size_t MAX_FRAME_SIZE = 32 * 1024;
+constexpr uint32_t MAX_PATH_LENGTH = 500;
+}  // namespace
+
+void WakeFrame::save(const GfxRenderer& renderer, const std::string& bookPath) {
+  const auto start = millis();
+  std::vector<uint8_t> frame;
+  if (!renderer.storeCompressedFrame(frame, MAX_FRAME_SIZE)) {
+    Storage.remove(WAKE_FRAME_FILE);
+    return;
+  }
+
+  FsFile file;
+  if (!Storage.openFileForWrite("WKF", WAKE_FRAME_FILE, file)) {
+    return;
+  }
+  serialization::writePod(file, WAKE_FRAME_VERSION);
+  serialization::writeString(file, bookPath);
+  serialization::writePod(file, static_cast<uint32_t>(frame.size()));
+  const bool ok = file.write(frame.data(), frame.size()) == frame.size();
+  file.close();
+  if (!ok) {
+    Storage.remove(WAKE_FRAME_FILE);
+    return;
+  }
+  LOG_DBG("WKF", "Saved wake frame (%zu bytes) in %lu ms", frame.size(), millis() - start);
+}
+
+bool WakeFrame::show(const GfxRenderer& renderer, const std::string& bookPath) {
+  FsFile file;
+  if (!Storage.exists(WAKE_FRAME_FILE) || !Storage.openFileForRead("WKF", WAKE_FRAME_FILE, file)) {
+    return false;
+  }
+
+  uint8_t version = 0;
+  uint32_t pathLength = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, pathLength);
+  bool ok = version == WAKE_FRAME_VERSION && pathLength <= MAX_PATH_LENGTH;
+  std::string path;
+  if (ok) {
+    path.resize(pathLength);
+    ok = pathLength == 0 || file.read(&path[0], pathLength) == static_cast<int>(pathLength);
+  }
+  uint32_t frameSize = 0;
+  serialization::readPod(file, frameSize);
+  std::vector<uint8_t> frame;
+  if (ok && path == bookPath && frameSize > 0 && frameSize <= MAX_FRAME_SIZE) {
+    frame.resize(frameSize);
+    ok = file.read(frame.data(), frameSize) == static_cast<int>(frameSize);
+  } else {
+    ok = false;
+  }
+  file.close();
+  Storage.remove(WAKE_FRAME_FILE);
+
+  if (!ok || !renderer.restoreCompressedFrame(frame)) {
+    return false;
+  }
+  renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+  return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <GfxRenderer.h>
+
+#include <string>
+
+// The reader page that was on screen when the device went to sleep, kept PackBits-compressed in
+// /.crosspoint/wake_frame.bin. Waking into the same book pushes it to the panel with a fast refresh before the
+// reader has loaded anything, so the wait for the first page shrinks to one panel refresh. The reader's own
+// render follows and replaces it (adding the gray levels when anti-aliasing is on).
+class WakeFrame {
+ public:
+  // Store the frame buffer, which must hold the reader's current page, for bookPath
+  static void save(const GfxRenderer& renderer, const std::string& bookPath);
+  // Show the stored frame if it belongs to bookPath. The file is consumed either way, so a stale page is never
+  // shown twice. Returns true if the frame went to the panel.
+  static bool show(const GfxRenderer& renderer, const std::string& bookPath);
+};
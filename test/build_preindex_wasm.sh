@@ -0,0 +1,145 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Builds the in-browser pre-indexer (test/preindex/Preindex.cpp) from the firmware's layout code with emscripten.
+# Copy build/preindex/preindex.js and preindex.wasm to /.crosspoint/preindex/ on the card; the file manager then
+# lays out EPUBs in the browser before uploading them.
+#
+#   test/build_preindex_wasm.sh                   # for the default firmware
+#   test/build_preindex_wasm.sh latin             # for a font subset build (latin, cyrillic or vietnamese)
+#   test/build_preindex_wasm.sh --native [subset] # a host binary, to check a layout without a browser
+#
+# The module has to match the firmware: a subset build registers its fonts under other IDs, and the device throws
+# away section files whose format version it doesn't know.
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+NATIVE=""
+if [[ "${1:-}" == "--native" ]]; then
+  NATIVE=1
+  shift
+fi
+SUBSET="${1:-}"
+BUILD_DIR="$ROOT_DIR/build/preindex${NATIVE:+_native}${SUBSET:+_$SUBSET}"
+
+if [[ -n "$NATIVE" ]]; then
+  CXX=c++
+  CC=cc
+else
+  command -v em++ >/dev/null || {
+    echo "em++ not found; install and activate the emscripten SDK" >&2
+    exit 1
+  }
+  CXX=em++
+  CC=emcc
+fi
+
+mkdir -p "$BUILD_DIR/obj"
+
+# Same sources as the layout benchmark, with the counting heap swapped out
+CXX_SOURCES=(
+  "$ROOT_DIR/test/preindex/Preindex.cpp"
+  "$ROOT_DIR/test/preindex/PreindexHeap.cpp"
+  "$ROOT_DIR/test/layout_bench/host/HostPlatform.cpp"
+  "$ROOT_DIR/test/layout_bench/host/PngToFramebufferConverter.cpp"
+  "$ROOT_DIR/test/layout_bench/host/SDCardManager.cpp"
+  "$ROOT_DIR/lib/hal/HalStorage.cpp"
+  "$ROOT_DIR/lib/Logging/Logging.cpp"
+  "$ROOT_DIR/lib/Logging/Metrics.cpp"
+  "$ROOT_DIR/lib/BufferPool/BufferPool.cpp"
+  "$ROOT_DIR/lib/Epub/Epub.cpp"
+)
+while IFS= read -r source; do
+  CXX_SOURCES+=("$source")
+done < <(
+  cd "$ROOT_DIR" &&
+    find lib/Epub/Epub lib/GfxRenderer lib/EpdFont lib/ZipFile lib/InflateReader lib/FsHelpers lib/Utf8 \
+      lib/JpegToBmpConverter lib/PngToBmpConverter -maxdepth 2 -name '*.cpp' \
+      ! -name PngToFramebufferConverter.cpp | sort | sed "s|^|$ROOT_DIR/|"
+)
+
+C_SOURCES=(
+  "$ROOT_DIR/lib/expat/xmlparse.c"
+  "$ROOT_DIR/lib/expat/xmlrole.c"
+  "$ROOT_DIR/lib/expat/xmltok.c"
+  "$ROOT_DIR/lib/uzlib/src/tinflate.c"
+  "$ROOT_DIR/lib/picojpeg/picojpeg.c"
+)
+
+INCLUDES=(
+  -I"$ROOT_DIR/test/layout_bench/host"
+  -I"$ROOT_DIR/test/layout_bench"
+  -I"$ROOT_DIR/src"
+  -I"$ROOT_DIR/lib/hal"
+  -I"$ROOT_DIR/lib/Logging"
+  -I"$ROOT_DIR/lib/BufferPool"
+  -I"$ROOT_DIR/lib/FunctionRef"
+  -I"$ROOT_DIR/lib/HotPath"
+  -I"$ROOT_DIR/lib/PackBits"
+  -I"$ROOT_DIR/lib/Epub"
+  -I"$ROOT_DIR/lib/GfxRenderer"
+  -I"$ROOT_DIR/lib/EpdFont"
+  -I"$ROOT_DIR/lib/ZipFile"
+  -I"$ROOT_DIR/lib/InflateReader"
+  -I"$ROOT_DIR/lib/uzlib/src"
+  -I"$ROOT_DIR/lib/expat"
+  -I"$ROOT_DIR/lib/FsHelpers"
+  -I"$ROOT_DIR/lib/Serialization"
+  -I"$ROOT_DIR/lib/Utf8"
+  -I"$ROOT_DIR/lib/JpegToBmpConverter"
+  -I"$ROOT_DIR/lib/PngToBmpConverter"
+  -I"$ROOT_DIR/lib/picojpeg"
+)
+
+DEFINES=(
+  -DXML_GE=0
+  -DXML_CONTEXT_BYTES=1024
+  -DEINK_DISPLAY_SINGLE_BUFFER_MODE=1
+  -DDISABLE_TRACE
+)
+case "$SUBSET" in
+  "") ;;
+  latin) DEFINES+=(-DFONT_SUBSET_LATIN) ;;
+  cyrillic) DEFINES+=(-DFONT_SUBSET_CYRILLIC) ;;
+  vietnamese) DEFINES+=(-DFONT_SUBSET_VIETNAMESE) ;;
+  *)
+    echo "Unknown font subset: $SUBSET" >&2
+    exit 2
+    ;;
+esac
+
+CFLAGS=(-O2 -MMD -ffunction-sections "${DEFINES[@]}" "${INCLUDES[@]}")
+CXXFLAGS=(-std=gnu++2a -O2 -MMD -ffunction-sections "${DEFINES[@]}" "${INCLUDES[@]}")
+if [[ -n "$NATIVE" ]]; then
+  LDFLAGS=(-Wl,--gc-sections)
+  OUTPUT="$BUILD_DIR/preindex"
+else
+  # The page loads the module with createPreindex(), writes the book into its FS and calls preindex through ccall
+  LDFLAGS=(-O2 -sMODULARIZE -sEXPORT_NAME=createPreindex -sEXPORTED_FUNCTIONS=_preindex
+    -sEXPORTED_RUNTIME_METHODS=FS,ccall -sALLOW_MEMORY_GROWTH -sENVIRONMENT=web)
+  OUTPUT="$BUILD_DIR/preindex.js"
+fi
+
+# An object is current when it is newer than its source and every header the compiler listed for it
+is_current() {
+  local object="$1" dependency
+  [[ -f "$object" && -f "${object%.o}.d" ]] || return 1
+  for dependency in $(sed -e 's/^[^:]*://' -e 's/\\$//' "${object%.o}.d"); do
+    [[ "$object" -nt "$dependency" ]] || return 1
+  done
+}
+
+OBJECTS=()
+for source in "${CXX_SOURCES[@]}" "${C_SOURCES[@]}"; do
+  object="$BUILD_DIR/obj/$(echo "${source#"$ROOT_DIR"/}" | tr '/' '_').o"
+  OBJECTS+=("$object")
+  if is_current "$object"; then
+    continue
+  fi
+  case "$source" in
+    *.c) "$CC" "${CFLAGS[@]}" -c "$source" -o "$object" ;;
+    *) "$CXX" "${CXXFLAGS[@]}" -c "$source" -o "$object" ;;
+  esac
+done
+
+"$CXX" "${OBJECTS[@]}" "${LDFLAGS[@]}" -o "$OUTPUT"
+echo "Built $OUTPUT"
@@ -2,10 +2,14 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <new>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -14,6 +18,21 @@
 #include "lib/Epub/Epub/hyphenation/LanguageHyphenator.h"
 #include "lib/Epub/Epub/hyphenation/LanguageRegistry.h"
 
+// Heap allocations made through operator new, counted for the throughput mode's allocations per word
+namespace {
+size_t allocationCount = 0;
+}
+
+void* operator new(const size_t size) {
+  allocationCount++;
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
 struct TestCase {
   std::string word;
   std::string hyphenated;
@@ -302,7 +321,121 @@ void printResults(const std::string& language, const std::vector<TestCase>& test
   }
 }
 
+// One word per line; anything after a '|' is ignored, so the test data files double as word lists
+std::vector<std::string> loadWordList(const std::string& filename) {
+  std::vector<std::string> words;
+  std::ifstream file(filename);
+
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open file " << filename << std::endl;
+    return words;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    words.push_back(line.substr(0, line.find('|')));
+  }
+
+  return words;
+}
+
+struct ThroughputOptions {
+  std::string language = "all";
+  std::string wordsFile;  // Defaults to the language's test data
+  int passes = 20;
+};
+
+// Times the Liang engine alone: words are split into codepoints up front, and each language's trie is prepared the
+// way the reader prepares it when a book picks that language
+int runThroughput(const ThroughputOptions& options) {
+  if (!options.wordsFile.empty() && options.language == "all") {
+    std::cerr << "--words needs a language" << std::endl;
+    return 1;
+  }
+
+  bool matched = false;
+  for (const auto& entry : getLanguageEntries()) {
+    if (options.language != "all" && options.language != entry.cliName) {
+      continue;
+    }
+    matched = true;
+
+    std::string wordsFile = options.wordsFile;
+    if (wordsFile.empty()) {
+      for (const auto& config : kSupportedLanguages) {
+        if (config.cliName == entry.cliName) {
+          wordsFile = config.testDataFile;
+        }
+      }
+    }
+    if (wordsFile.empty()) {
+      std::cerr << "No word list for " << entry.cliName << ", pass one with --words. Skipping." << std::endl;
+      continue;
+    }
+
+    std::vector<std::vector<CodepointInfo>> words;
+    for (const auto& word : loadWordList(wordsFile)) {
+      auto cps = collectCodepoints(word);
+      trimSurroundingPunctuationAndFootnote(cps);
+      words.push_back(std::move(cps));
+    }
+    if (words.empty()) {
+      std::cerr << "No words loaded for " << entry.cliName << ". Skipping." << std::endl;
+      continue;
+    }
+
+    entry.hyphenator->prepare();
+    // Untimed pass, so the first timed one doesn't pay for cold caches
+    size_t breaks = 0;
+    for (const auto& cps : words) {
+      breaks += entry.hyphenator->breakIndexes(cps).size();
+    }
+
+    breaks = 0;
+    const size_t allocationsBefore = allocationCount;
+    const auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < options.passes; pass++) {
+      for (const auto& cps : words) {
+        breaks += entry.hyphenator->breakIndexes(cps).size();
+      }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const size_t allocations = allocationCount - allocationsBefore;
+
+    // Breaks per pass as a sanity check: a trie or cache change that keeps the speed but changes it is a bug
+    const double totalWords = static_cast<double>(words.size()) * options.passes;
+    std::cout << entry.cliName << ": " << words.size() << " words x " << options.passes << " passes, "
+              << static_cast<long long>(totalWords / seconds) << " words/s, " << std::fixed << std::setprecision(2)
+              << allocations / totalWords << " allocations/word, " << breaks / options.passes << " breaks"
+              << std::defaultfloat << std::endl;
+  }
+
+  if (!matched) {
+    std::cerr << "Unknown language: " << options.language << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "--throughput") {
+    ThroughputOptions options;
+    for (int i = 2; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--words" && i + 1 < argc) {
+        options.wordsFile = argv[++i];
+      } else if (arg == "--passes" && i + 1 < argc) {
+        options.passes = std::max(1, std::atoi(argv[++i]));
+      } else {
+        options.language = arg;
+      }
+    }
+    return runThroughput(options);
+  }
+
   const bool summaryMode = argc <= 1;
   const std::string languageSelection = summaryMode ? "all" : argv[1];
 
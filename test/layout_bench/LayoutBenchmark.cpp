@@ -0,0 +1,258 @@
+// Host benchmark for the EPUB layout pipeline: opens each book, paginates every chapter, then loads and renders
+// its pages into a headless frame buffer, timing each phase and counting its heap allocations. Storage is a
+// directory on the host (see host/HostStorage.h), so the real HalStorage and cache formats are exercised.
+//
+//   test/run_layout_bench.sh                      # every book in test/epubs
+//   test/run_layout_bench.sh --csv book.epub      # machine-readable rows, e.g. to compare against a baseline
+
+#include <Epub.h>
+#include <Epub/Page.h>
+#include <Epub/Section.h>
+#include <FontDecompressor.h>
+#include <GfxRenderer.h>
+#include <HalDisplay.h>
+#include <HalStorage.h>
+#include <builtinFonts/bookerly_14_bold.h>
+#include <builtinFonts/bookerly_14_bolditalic.h>
+#include <builtinFonts/bookerly_14_italic.h>
+#include <builtinFonts/bookerly_14_regular.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "host/HostHeap.h"
+#include "host/HostStorage.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr int FONT_ID = 1;
+// Reader defaults: Bookerly 14, normal spacing, justified, extra paragraph spacing, embedded styles, margin 5
+constexpr float LINE_COMPRESSION = 1.0f;
+constexpr bool EXTRA_PARAGRAPH_SPACING = true;
+constexpr uint8_t PARAGRAPH_ALIGNMENT = 0;
+constexpr bool EMBEDDED_STYLE = true;
+constexpr int SCREEN_MARGIN = 5;
+constexpr int STATUS_BAR_HEIGHT = 30;
+constexpr char CACHE_DIR[] = "/.crosspoint";
+
+enum Phase { EPUB_LOAD, EPUB_OPEN, SECTION_BUILD, PAGE_LOAD, PAGE_RENDER, PHASE_COUNT };
+constexpr const char* PHASE_NAMES[PHASE_COUNT] = {"epub.load", "epub.open", "sect.build", "page.load", "page.render"};
+
+struct PhaseStats {
+  uint32_t calls = 0;
+  uint64_t totalUs = 0;
+  uint64_t maxUs = 0;
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+  size_t peakBytes = 0;  // Highest live heap above what was live when a call started
+
+  void add(const PhaseStats& other) {
+    calls += other.calls;
+    totalUs += other.totalUs;
+    maxUs = std::max(maxUs, other.maxUs);
+    allocations += other.allocations;
+    bytes += other.bytes;
+    peakBytes = std::max(peakBytes, other.peakBytes);
+  }
+};
+
+struct Options {
+  bool csv = false;
+  bool hyphenation = false;
+  int maxPagesPerSection = -1;
+  std::vector<std::string> books;
+};
+
+// Times one call and attributes its allocations and peak heap to the phase
+template <typename Fn>
+auto measure(PhaseStats& stats, Fn&& fn) {
+  const hostheap::Counters before = hostheap::read();
+  hostheap::resetPeak();
+  const auto start = std::chrono::steady_clock::now();
+  auto result = fn();
+  const auto elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  const hostheap::Counters after = hostheap::read();
+
+  stats.calls++;
+  stats.totalUs += elapsed;
+  stats.maxUs = std::max<uint64_t>(stats.maxUs, elapsed);
+  stats.allocations += after.allocations - before.allocations;
+  stats.bytes += after.bytes - before.bytes;
+  stats.peakBytes = std::max(stats.peakBytes, after.peakLive - before.live);
+  return result;
+}
+
+bool benchmarkBook(const std::string& hostPath, GfxRenderer& renderer, const Options& options,
+                   PhaseStats (&stats)[PHASE_COUNT], int& sectionCount, int& pageCount) {
+  const std::string cardPath = "/" + fs::path(hostPath).filename().string();
+  std::error_code error;
+  fs::copy_file(hostPath, hoststorage::hostPath(cardPath.c_str()),
+                fs::copy_options::overwrite_existing, error);
+  if (error) {
+    fprintf(stderr, "Cannot copy %s: %s\n", hostPath.c_str(), error.message().c_str());
+    return false;
+  }
+
+  auto epub = std::make_shared<Epub>(cardPath, CACHE_DIR);
+  if (!measure(stats[EPUB_LOAD], [&] { return epub->load(true, false); })) {
+    fprintf(stderr, "Failed to load %s\n", hostPath.c_str());
+    return false;
+  }
+  // Opening again reads the metadata cache just built, as every later visit to the book does
+  epub = std::make_shared<Epub>(cardPath, CACHE_DIR);
+  if (!measure(stats[EPUB_OPEN], [&] { return epub->load(false, false); })) {
+    fprintf(stderr, "Failed to reopen %s\n", hostPath.c_str());
+    return false;
+  }
+
+  int marginTop, marginRight, marginBottom, marginLeft;
+  renderer.getOrientedViewableTRBL(&marginTop, &marginRight, &marginBottom, &marginLeft);
+  marginTop += SCREEN_MARGIN;
+  marginLeft += SCREEN_MARGIN;
+  marginRight += SCREEN_MARGIN;
+  marginBottom += std::max(SCREEN_MARGIN, STATUS_BAR_HEIGHT);
+  const uint16_t viewportWidth = renderer.getScreenWidth() - marginLeft - marginRight;
+  const uint16_t viewportHeight = renderer.getScreenHeight() - marginTop - marginBottom;
+
+  for (int spineIndex = 0; spineIndex < epub->getSpineItemsCount(); spineIndex++) {
+    Section section(epub, spineIndex, renderer);
+    renderer.clearFontCache();
+    const bool built = measure(stats[SECTION_BUILD], [&] {
+      return section.createSectionFile(FONT_ID, LINE_COMPRESSION, EXTRA_PARAGRAPH_SPACING, PARAGRAPH_ALIGNMENT,
+                                       viewportWidth, viewportHeight, options.hyphenation, EMBEDDED_STYLE);
+    });
+    if (!built) {
+      fprintf(stderr, "Failed to build section %d of %s\n", spineIndex, hostPath.c_str());
+      continue;
+    }
+    sectionCount++;
+
+    const int pages = options.maxPagesPerSection < 0 ? section.pageCount
+                                                     : std::min<int>(section.pageCount, options.maxPagesPerSection);
+    for (int pageIndex = 0; pageIndex < pages; pageIndex++) {
+      std::unique_ptr<Page> page =
+          measure(stats[PAGE_LOAD], [&] { return section.loadPageFromSectionFile(pageIndex); });
+      if (!page) {
+        fprintf(stderr, "Failed to load page %d of section %d\n", pageIndex, spineIndex);
+        continue;
+      }
+      measure(stats[PAGE_RENDER], [&] {
+        renderer.clearScreen();
+        page->render(renderer, FONT_ID, marginLeft, marginTop);
+        return true;
+      });
+      pageCount++;
+    }
+  }
+  return true;
+}
+
+void printStats(const std::string& book, const PhaseStats (&stats)[PHASE_COUNT], const bool csv) {
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    const PhaseStats& s = stats[phase];
+    if (s.calls == 0) {
+      continue;
+    }
+    if (csv) {
+      printf("%s,%s,%u,%llu,%llu,%llu,%llu,%zu\n", book.c_str(), PHASE_NAMES[phase], s.calls,
+             static_cast<unsigned long long>(s.totalUs), static_cast<unsigned long long>(s.maxUs),
+             static_cast<unsigned long long>(s.allocations), static_cast<unsigned long long>(s.bytes), s.peakBytes);
+    } else {
+      printf("%-28s %-12s %6u %10.1f %9.0f %9llu %10llu %8.1f %8.1f\n", book.c_str(), PHASE_NAMES[phase], s.calls,
+             s.totalUs / 1000.0, static_cast<double>(s.totalUs) / s.calls, static_cast<unsigned long long>(s.maxUs),
+             static_cast<unsigned long long>(s.allocations), s.bytes / 1024.0, s.peakBytes / 1024.0);
+    }
+  }
+}
+
+bool parseOptions(const int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--csv") {
+      options.csv = true;
+    } else if (arg == "--hyphenation") {
+      options.hyphenation = true;
+    } else if (arg == "--pages" && i + 1 < argc) {
+      options.maxPagesPerSection = std::stoi(argv[++i]);
+    } else if (arg.rfind("--", 0) == 0) {
+      fprintf(stderr, "Usage: %s [--csv] [--hyphenation] [--pages N] [book.epub ...]\n", argv[0]);
+      return false;
+    } else {
+      options.books.push_back(arg);
+    }
+  }
+  if (options.books.empty()) {
+    for (const auto& entry : fs::directory_iterator("test/epubs")) {
+      if (entry.path().extension() == ".epub") {
+        options.books.push_back(entry.path().string());
+      }
+    }
+    std::sort(options.books.begin(), options.books.end());
+  }
+  return !options.books.empty();
+}
+}  // namespace
+
+int main(const int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    return 2;
+  }
+
+  // A fresh card for every run, so every cache is built from scratch
+  const fs::path cardRoot = fs::temp_directory_path() / "crosspoint_layout_bench";
+  fs::remove_all(cardRoot);
+  fs::create_directories(cardRoot);
+  hoststorage::setRoot(cardRoot.string());
+  Storage.begin(false);  // The host disk has nothing to profile
+
+  static HalDisplay display;
+  static GfxRenderer renderer(display);
+  static FontDecompressor fontDecompressor;
+  static EpdFont regular(&bookerly_14_regular);
+  static EpdFont bold(&bookerly_14_bold);
+  static EpdFont italic(&bookerly_14_italic);
+  static EpdFont boldItalic(&bookerly_14_bolditalic);
+  display.begin();
+  renderer.begin();
+  renderer.setOrientation(GfxRenderer::Portrait);
+  fontDecompressor.init();
+  renderer.setFontDecompressor(&fontDecompressor);
+  renderer.insertFont(FONT_ID, EpdFontFamily(&regular, &bold, &italic, &boldItalic));
+
+  if (options.csv) {
+    printf("book,phase,calls,total_us,max_us,allocs,alloc_bytes,peak_bytes\n");
+  } else {
+    printf("%-28s %-12s %6s %10s %9s %9s %10s %8s %8s\n", "book", "phase", "calls", "total_ms", "avg_us", "max_us",
+           "allocs", "alloc_kb", "peak_kb");
+  }
+
+  PhaseStats totals[PHASE_COUNT];
+  int failures = 0;
+  for (const std::string& book : options.books) {
+    PhaseStats stats[PHASE_COUNT];
+    int sections = 0;
+    int pages = 0;
+    if (!benchmarkBook(book, renderer, options, stats, sections, pages)) {
+      failures++;
+      continue;
+    }
+    printStats(fs::path(book).filename().string(), stats, options.csv);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+      totals[phase].add(stats[phase]);
+    }
+    if (!options.csv) {
+      fprintf(stderr, "%s: %d sections, %d pages\n", book.c_str(), sections, pages);
+    }
+  }
+  printStats("TOTAL", totals, options.csv);
+
+  fs::remove_all(cardRoot);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core used by the layout pipeline
+#include <HardwareSerial.h>
+#include <Print.h>
+#include <WString.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*reinterpret_cast<const uint8_t*>(address))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+class EspClass {
+ public:
+  uint32_t getFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getHeapSize();
+};
+
+extern EspClass ESP;
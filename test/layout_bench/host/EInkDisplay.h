@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Host stand-in for the panel driver. Only the geometry is needed; HalDisplay keeps a plain frame buffer.
+class EInkDisplay {
+ public:
+  static constexpr uint16_t DISPLAY_WIDTH = 800;
+  static constexpr uint16_t DISPLAY_HEIGHT = 480;
+};
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in: HalStorage.cpp includes FS.h ahead of SDCardManager.h on the device; nothing is needed here
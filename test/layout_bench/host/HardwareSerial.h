@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Print.h>
+
+// Host stand-in for the USB CDC serial port; writes go to stderr
+class HWCDC : public Print {
+ public:
+  void begin(unsigned long) {}
+  operator bool() const { return true; }
+  int available() { return 0; }
+  size_t write(uint8_t b) override { return fputc(b, stderr) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, const size_t size) override { return fwrite(buffer, 1, size, stderr); }
+  using Print::write;
+};
+
+extern HWCDC Serial;
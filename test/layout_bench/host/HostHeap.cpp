@@ -0,0 +1,89 @@
+#include "HostHeap.h"
+
+#include <malloc.h>
+
+#include <new>
+
+namespace {
+hostheap::Counters counters = {};
+
+void recordAlloc(void* ptr, const size_t requested) {
+  counters.allocations++;
+  counters.bytes += requested;
+  counters.live += malloc_usable_size(ptr);
+  if (counters.live > counters.peakLive) {
+    counters.peakLive = counters.live;
+  }
+}
+
+void recordFree(void* ptr) {
+  const size_t size = malloc_usable_size(ptr);
+  counters.live = size > counters.live ? 0 : counters.live - size;
+}
+}  // namespace
+
+hostheap::Counters hostheap::read() { return counters; }
+
+void hostheap::resetPeak() { counters.peakLive = counters.live; }
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(const size_t size) {
+  void* ptr = __real_malloc(size);
+  if (ptr) {
+    recordAlloc(ptr, size);
+  }
+  return ptr;
+}
+
+void* __wrap_calloc(const size_t count, const size_t size) {
+  void* ptr = __real_calloc(count, size);
+  if (ptr) {
+    recordAlloc(ptr, count * size);
+  }
+  return ptr;
+}
+
+void* __wrap_realloc(void* ptr, const size_t size) {
+  if (ptr) {
+    recordFree(ptr);
+  }
+  void* resized = __real_realloc(ptr, size);
+  if (resized) {
+    recordAlloc(resized, size);
+  } else if (ptr && size != 0) {
+    // Failed realloc leaves the old block in place
+    counters.live += malloc_usable_size(ptr);
+  }
+  return resized;
+}
+
+void __wrap_free(void* ptr) {
+  if (ptr) {
+    recordFree(ptr);
+  }
+  __real_free(ptr);
+}
+}
+
+// libstdc++'s operator new calls malloc from inside the shared library, which --wrap can't see
+void* operator new(const size_t size) {
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void* operator new[](const size_t size) { return operator new(size); }
+void* operator new(const size_t size, const std::nothrow_t&) noexcept { return malloc(size ? size : 1); }
+void* operator new[](const size_t size, const std::nothrow_t&) noexcept { return malloc(size ? size : 1); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
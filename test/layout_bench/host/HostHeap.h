@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap accounting for the benchmark. The build links with --wrap for malloc, calloc, realloc and free and routes
+// operator new and delete through malloc, so every allocation made by the pipeline is counted.
+namespace hostheap {
+
+// Roughly what the ESP32-C3 has left for the heap; ESP.getFreeHeap() reports this minus the live bytes so the
+// pipeline's low-memory checks behave as on the device
+constexpr size_t DEVICE_HEAP_SIZE = 300 * 1024;
+
+struct Counters {
+  uint64_t allocations;
+  uint64_t bytes;   // Requested, summed over all allocations
+  size_t live;      // Currently allocated
+  size_t peakLive;  // Highest live since the last resetPeak()
+};
+
+Counters read();
+// Start a new peak measurement from the current live bytes
+void resetPeak();
+
+}  // namespace hostheap
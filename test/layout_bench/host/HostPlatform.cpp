@@ -0,0 +1,96 @@
+// Host implementations of the Arduino, ESP and FreeRTOS calls used by the layout pipeline
+
+#include <Arduino.h>
+#include <HalDisplay.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "HostHeap.h"
+
+HWCDC Serial;
+EspClass ESP;
+
+namespace {
+const auto startTime = std::chrono::steady_clock::now();
+}
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(const unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+uint32_t EspClass::getHeapSize() { return hostheap::DEVICE_HEAP_SIZE; }
+
+uint32_t EspClass::getFreeHeap() {
+  const size_t live = hostheap::read().live;
+  return live < hostheap::DEVICE_HEAP_SIZE ? hostheap::DEVICE_HEAP_SIZE - live : 0;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  const size_t peak = hostheap::read().peakLive;
+  return peak < hostheap::DEVICE_HEAP_SIZE ? hostheap::DEVICE_HEAP_SIZE - peak : 0;
+}
+
+// No fragmentation model on the host
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+
+// ---- FreeRTOS ----
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::recursive_mutex(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t) {
+  static_cast<std::recursive_mutex*>(semaphore)->lock();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  static_cast<std::recursive_mutex*>(semaphore)->unlock();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete static_cast<std::recursive_mutex*>(semaphore); }
+
+void vTaskDelay(const TickType_t ticks) { delay(ticks); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+
+BaseType_t xTaskCreate(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, TaskHandle_t*) { return pdFALSE; }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t) { return pdTRUE; }
+
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+
+// ---- HalDisplay: a frame buffer and nothing else ----
+
+namespace {
+uint8_t frameBuffer[HalDisplay::BUFFER_SIZE];
+}
+
+HalDisplay::HalDisplay() = default;
+HalDisplay::~HalDisplay() = default;
+void HalDisplay::begin() {}
+void HalDisplay::clearScreen(const uint8_t color) const { memset(frameBuffer, color, sizeof(frameBuffer)); }
+void HalDisplay::drawImage(const uint8_t*, uint16_t, uint16_t, uint16_t, uint16_t, bool) const {}
+void HalDisplay::drawImageTransparent(const uint8_t*, uint16_t, uint16_t, uint16_t, uint16_t, bool) const {}
+void HalDisplay::displayBuffer(RefreshMode, bool) {}
+void HalDisplay::displayWindow(uint16_t, uint16_t, uint16_t, uint16_t, bool) {}
+void HalDisplay::refreshDisplay(RefreshMode, bool) {}
+void HalDisplay::deepSleep() {}
+uint8_t* HalDisplay::getFrameBuffer() const { return frameBuffer; }
+void HalDisplay::copyGrayscaleBuffers(const uint8_t*, const uint8_t*) {}
+void HalDisplay::copyGrayscaleLsbBuffers(const uint8_t*) {}
+void HalDisplay::copyGrayscaleMsbBuffers(const uint8_t*) {}
+void HalDisplay::cleanupGrayscaleBuffers(const uint8_t*) {}
+void HalDisplay::displayGrayBuffer(bool) {}
+HalDisplay::RefreshToken HalDisplay::displayGrayBufferAsync(bool) { return 0; }
+void HalDisplay::waitForRefresh(RefreshToken) {}
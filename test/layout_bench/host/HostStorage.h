@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// Host directory that stands in for the SD card root. Kept apart from SDCardManager.h, whose FsFile clashes with
+// the FsFile alias HalStorage.h gives everyone else.
+namespace hoststorage {
+void setRoot(const std::string& directory);
+// Host path of a card path such as "/books/a.epub"
+std::string hostPath(const char* path);
+}  // namespace hoststorage
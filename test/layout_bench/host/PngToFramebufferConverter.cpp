@@ -0,0 +1,14 @@
+// Host stand-in: PNGdec isn't vendored, so PNG images are skipped (treated as unreadable) in the benchmark
+#include <Epub/converters/PngToFramebufferConverter.h>
+
+bool PngToFramebufferConverter::getDimensionsStatic(const std::string&, ImageDimensions&) { return false; }
+
+bool PngToFramebufferConverter::decodeSource(ImageSource&, GfxRenderer&, const RenderConfig&) { return false; }
+
+bool PngToFramebufferConverter::supportsFormat(const std::string& extension) {
+  std::string ext = extension;
+  for (auto& c : ext) {
+    c = tolower(c);
+  }
+  return ext == ".png";
+}
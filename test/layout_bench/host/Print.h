@@ -0,0 +1,43 @@
+#pragma once
+
+#include <WString.h>
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Host stand-in for Arduino's Print
+class Print {
+ public:
+  virtual ~Print() = default;
+
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    while (written < size && write(buffer[written])) {
+      written++;
+    }
+    return written;
+  }
+  size_t write(const char* buffer, const size_t size) { return write(reinterpret_cast<const uint8_t*>(buffer), size); }
+  size_t write(const char* text) { return text ? write(text, strlen(text)) : 0; }
+  virtual void flush() {}
+
+  size_t print(const char* text) { return write(text); }
+  size_t print(const char c) { return write(static_cast<uint8_t>(c)); }
+  size_t println(const char* text = "") { return print(text) + print('\n'); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length <= 0) {
+      return 0;
+    }
+    return write(buffer, static_cast<size_t>(length) < sizeof(buffer) ? length : sizeof(buffer) - 1);
+  }
+};
@@ -0,0 +1,320 @@
+#include "SDCardManager.h"
+
+#include <Logging.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ctime>
+#include <filesystem>
+#include <utility>
+
+#include "HostStorage.h"
+
+namespace fs = std::filesystem;
+
+FsFile::FsFile(FsFile&& other) noexcept { *this = std::move(other); }
+
+FsFile& FsFile::operator=(FsFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    file = std::exchange(other.file, nullptr);
+    dir = std::exchange(other.dir, nullptr);
+    path = std::move(other.path);
+  }
+  return *this;
+}
+
+void FsFile::flush() {
+  if (file) {
+    fflush(file);
+  }
+}
+
+size_t FsFile::getName(char* name, const size_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  const std::string base = fs::path(path).filename().string();
+  const size_t length = std::min(base.size(), len - 1);
+  memcpy(name, base.data(), length);
+  name[length] = '\0';
+  return length;
+}
+
+size_t FsFile::size() {
+  if (!file) {
+    return 0;
+  }
+  fflush(file);
+  struct stat info {};
+  return fstat(fileno(file), &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+}
+
+bool FsFile::seekSet(const size_t offset) { return file && fseek(file, static_cast<long>(offset), SEEK_SET) == 0; }
+
+bool FsFile::seekCur(const int64_t offset) { return file && fseek(file, static_cast<long>(offset), SEEK_CUR) == 0; }
+
+int FsFile::available() {
+  if (!file) {
+    return 0;
+  }
+  const size_t total = size();
+  const size_t current = position();
+  return current < total ? static_cast<int>(total - current) : 0;
+}
+
+size_t FsFile::position() { return file ? static_cast<size_t>(ftell(file)) : 0; }
+
+int FsFile::read(void* buf, const size_t count) {
+  if (!file) {
+    return -1;
+  }
+  const size_t n = fread(buf, 1, count, file);
+  return n == 0 && ferror(file) ? -1 : static_cast<int>(n);
+}
+
+int FsFile::read() {
+  if (!file) {
+    return -1;
+  }
+  const int c = fgetc(file);
+  return c == EOF ? -1 : c;
+}
+
+size_t FsFile::write(const void* buf, const size_t count) { return file ? fwrite(buf, 1, count, file) : 0; }
+
+bool FsFile::rename(const char* newPath) {
+  if (!file) {
+    return false;
+  }
+  fflush(file);
+  auto& card = SDCardManager::getInstance();
+  if (::rename(card.hostPath(path.c_str()).c_str(), card.hostPath(newPath).c_str()) != 0) {
+    return false;
+  }
+  path = newPath;
+  return true;
+}
+
+bool FsFile::preAllocate(const size_t length) {
+  if (!file) {
+    return false;
+  }
+  fflush(file);
+  return ftruncate(fileno(file), static_cast<off_t>(length)) == 0;
+}
+
+bool FsFile::truncate(const size_t length) {
+  if (!file) {
+    return false;
+  }
+  fflush(file);
+  return ftruncate(fileno(file), static_cast<off_t>(length)) == 0 && fseek(file, 0, SEEK_END) == 0;
+}
+
+bool FsFile::getModifyDateTime(uint16_t* pdate, uint16_t* ptime) {
+  struct stat info {};
+  if (stat(SDCardManager::getInstance().hostPath(path.c_str()).c_str(), &info) != 0) {
+    return false;
+  }
+  struct tm local {};
+  localtime_r(&info.st_mtime, &local);
+  // FAT encoding, as SdFat's FS_DATE / FS_TIME
+  *pdate = static_cast<uint16_t>(((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+  *ptime = static_cast<uint16_t>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+  return true;
+}
+
+void FsFile::rewindDirectory() {
+  if (dir) {
+    rewinddir(dir);
+  }
+}
+
+bool FsFile::close() {
+  bool ok = true;
+  if (file) {
+    ok = fclose(file) == 0;
+    file = nullptr;
+  }
+  if (dir) {
+    closedir(dir);
+    dir = nullptr;
+  }
+  return ok;
+}
+
+FsFile FsFile::openNextFile() {
+  if (!dir) {
+    return {};
+  }
+  while (const dirent* entry = readdir(dir)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    const std::string child = (path == "/" ? "" : path) + "/" + entry->d_name;
+    return SDCardManager::getInstance().open(child.c_str(), O_RDONLY);
+  }
+  return {};
+}
+
+SDCardManager& SDCardManager::getInstance() {
+  static SDCardManager instance;
+  return instance;
+}
+
+std::string SDCardManager::hostPath(const char* path) const {
+  std::string result = root;
+  if (path[0] != '/') {
+    result += '/';
+  }
+  return result + path;
+}
+
+std::vector<String> SDCardManager::listFiles(const char* path, const int maxFiles) {
+  std::vector<String> names;
+  std::error_code error;
+  for (const auto& entry : fs::directory_iterator(hostPath(path), error)) {
+    if (static_cast<int>(names.size()) >= maxFiles) {
+      break;
+    }
+    names.emplace_back(entry.path().filename().string());
+  }
+  return names;
+}
+
+String SDCardManager::readFile(const char* path) {
+  FsFile file = open(path, O_RDONLY);
+  if (!file || file.isDirectory()) {
+    return {};
+  }
+  std::string content(file.size(), '\0');
+  const int n = file.read(content.data(), content.size());
+  content.resize(n > 0 ? n : 0);
+  return String(content);
+}
+
+bool SDCardManager::readFileToStream(const char* path, Print& out, const size_t chunkSize) {
+  FsFile file = open(path, O_RDONLY);
+  if (!file || file.isDirectory()) {
+    return false;
+  }
+  std::vector<uint8_t> chunk(chunkSize);
+  int n;
+  while ((n = file.read(chunk.data(), chunk.size())) > 0) {
+    out.write(chunk.data(), n);
+  }
+  return n == 0;
+}
+
+size_t SDCardManager::readFileToBuffer(const char* path, char* buffer, const size_t bufferSize,
+                                       const size_t maxBytes) {
+  if (bufferSize == 0) {
+    return 0;
+  }
+  FsFile file = open(path, O_RDONLY);
+  if (!file || file.isDirectory()) {
+    buffer[0] = '\0';
+    return 0;
+  }
+  size_t limit = bufferSize - 1;
+  if (maxBytes > 0 && maxBytes < limit) {
+    limit = maxBytes;
+  }
+  const int n = file.read(buffer, limit);
+  const size_t length = n > 0 ? n : 0;
+  buffer[length] = '\0';
+  return length;
+}
+
+bool SDCardManager::writeFile(const char* path, const String& content) {
+  FsFile file;
+  if (!openFileForWrite("SD", path, file)) {
+    return false;
+  }
+  const bool ok = file.write(content.c_str(), content.length()) == content.length();
+  return file.close() && ok;
+}
+
+FsFile SDCardManager::open(const char* path, const oflag_t oflag) {
+  FsFile result;
+  result.path = path;
+  const std::string host = hostPath(path);
+
+  std::error_code error;
+  if (fs::is_directory(host, error)) {
+    result.dir = opendir(host.c_str());
+    return result;
+  }
+
+  const bool exists = fs::exists(host, error);
+  if (!exists && !(oflag & O_CREAT)) {
+    return result;
+  }
+  const char* mode = "rb";
+  if ((oflag & O_TRUNC) || !exists) {
+    mode = (oflag & O_ACCMODE) == O_RDONLY ? "rb" : "w+b";
+  } else if ((oflag & O_ACCMODE) != O_RDONLY) {
+    mode = "r+b";
+  }
+  result.file = fopen(host.c_str(), mode);
+  if (result.file && (oflag & O_APPEND)) {
+    fseek(result.file, 0, SEEK_END);
+  }
+  return result;
+}
+
+bool SDCardManager::mkdir(const char* path, const bool pFlag) {
+  std::error_code error;
+  const std::string host = hostPath(path);
+  if (fs::is_directory(host, error)) {
+    return true;
+  }
+  return pFlag ? fs::create_directories(host, error) : fs::create_directory(host, error);
+}
+
+bool SDCardManager::exists(const char* path) {
+  std::error_code error;
+  return fs::exists(hostPath(path), error);
+}
+
+bool SDCardManager::remove(const char* path) {
+  std::error_code error;
+  const std::string host = hostPath(path);
+  return !fs::is_directory(host, error) && fs::remove(host, error);
+}
+
+bool SDCardManager::rename(const char* oldPath, const char* newPath) {
+  return ::rename(hostPath(oldPath).c_str(), hostPath(newPath).c_str()) == 0;
+}
+
+bool SDCardManager::rmdir(const char* path) { return ::rmdir(hostPath(path).c_str()) == 0; }
+
+bool SDCardManager::openFileForRead(const char* moduleName, const char* path, FsFile& file) {
+  file = open(path, O_RDONLY);
+  if (!file || file.isDirectory()) {
+    LOG_ERR(moduleName, "Failed to open %s for reading", path);
+    file = FsFile();
+    return false;
+  }
+  return true;
+}
+
+bool SDCardManager::openFileForWrite(const char* moduleName, const char* path, FsFile& file) {
+  file = open(path, O_RDWR | O_CREAT | O_TRUNC);
+  if (!file || file.isDirectory()) {
+    LOG_ERR(moduleName, "Failed to open %s for writing", path);
+    file = FsFile();
+    return false;
+  }
+  return true;
+}
+
+bool SDCardManager::removeDir(const char* path) {
+  std::error_code error;
+  return fs::remove_all(hostPath(path), error) > 0;
+}
+
+void hoststorage::setRoot(const std::string& directory) { SDCardManager::getInstance().setRoot(directory); }
+
+std::string hoststorage::hostPath(const char* path) { return SDCardManager::getInstance().hostPath(path); }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+#include <common/FsApiConstants.h>
+#include <dirent.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Host stand-in for the SDK's SD card manager. Paths are resolved below a directory on the host (setRoot), so the
+// real HalStorage, with its locking and buffering, runs unchanged on top of stdio.
+class FsFile {
+ public:
+  FsFile() = default;
+  ~FsFile() { close(); }
+  FsFile(FsFile&& other) noexcept;
+  FsFile& operator=(FsFile&& other) noexcept;
+  FsFile(const FsFile&) = delete;
+  FsFile& operator=(const FsFile&) = delete;
+
+  void flush();
+  size_t getName(char* name, size_t len);
+  size_t size();
+  size_t fileSize() { return size(); }
+  bool seekSet(size_t offset);
+  bool seekCur(int64_t offset);
+  int available();
+  size_t position();
+  int read(void* buf, size_t count);
+  int read();
+  size_t write(const void* buf, size_t count);
+  size_t write(uint8_t b) { return write(&b, 1); }
+  bool rename(const char* newPath);
+  bool preAllocate(size_t length);
+  bool truncate(size_t length);
+  bool getModifyDateTime(uint16_t* pdate, uint16_t* ptime);
+  bool isDirectory() const { return dir != nullptr; }
+  void rewindDirectory();
+  bool close();
+  FsFile openNextFile();
+  bool isOpen() const { return file != nullptr || dir != nullptr; }
+  operator bool() const { return isOpen(); }
+
+ private:
+  friend class SDCardManager;
+  FILE* file = nullptr;
+  DIR* dir = nullptr;
+  std::string path;  // Card path, e.g. "/books/a.epub"
+};
+
+class SDCardManager {
+ public:
+  static SDCardManager& getInstance();
+
+  // Host directory that stands in for the card root
+  void setRoot(const std::string& directory) { root = directory; }
+  std::string hostPath(const char* path) const;
+
+  bool begin() { return !root.empty(); }
+  bool ready() { return !root.empty(); }
+  std::vector<String> listFiles(const char* path, int maxFiles);
+  String readFile(const char* path);
+  bool readFileToStream(const char* path, Print& out, size_t chunkSize);
+  size_t readFileToBuffer(const char* path, char* buffer, size_t bufferSize, size_t maxBytes);
+  bool writeFile(const char* path, const String& content);
+  bool ensureDirectoryExists(const char* path) { return mkdir(path, true); }
+  FsFile open(const char* path, oflag_t oflag);
+  bool mkdir(const char* path, bool pFlag);
+  bool exists(const char* path);
+  bool remove(const char* path);
+  bool rename(const char* oldPath, const char* newPath);
+  bool rmdir(const char* path);
+  bool openFileForRead(const char* moduleName, const char* path, FsFile& file);
+  bool openFileForWrite(const char* moduleName, const char* path, FsFile& file);
+  bool removeDir(const char* path);
+
+ private:
+  std::string root;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+// Host stand-in for Arduino's String, only as much as the layout pipeline's headers need
+class String {
+ public:
+  String() = default;
+  String(const char* text) : value(text ? text : "") {}
+  String(const std::string& text) : value(text) {}
+
+  const char* c_str() const { return value.c_str(); }
+  unsigned int length() const { return value.size(); }
+  bool isEmpty() const { return value.empty(); }
+  bool operator==(const String& other) const { return value == other.value; }
+  String& operator+=(const String& other) {
+    value += other.value;
+    return *this;
+  }
+  friend String operator+(String lhs, const String& rhs) { return lhs += rhs; }
+
+ private:
+  std::string value;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for FreeRTOS. The benchmark is single threaded; semaphores are plain mutexes.
+#include <cstdint>
+
+typedef void* SemaphoreHandle_t;
+typedef void* TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
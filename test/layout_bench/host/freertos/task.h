@@ -0,0 +1,12 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+typedef void (*TaskFunction_t)(void*);
+// No tasks on the host: creation fails, so callers take their synchronous fallback
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* createdTask);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
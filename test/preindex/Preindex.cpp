@@ -0,0 +1,168 @@
+// Lays out a book off the device and leaves the caches the reader would build for it: the book's metadata cache and a
+// section file for every chapter, at the device's cache path and with its reader layout (GET /api/layout). Built to
+// WebAssembly by test/build_preindex_wasm.sh, the file manager runs it in the browser on an EPUB before uploading it
+// and then uploads the caches next to it, so the book opens without being indexed on the device. Storage is a
+// directory standing in for the card (see layout_bench/host/HostStorage.h); in the browser that is MEMFS.
+//
+// Natively, for checking a layout against the device:
+//   preindex <card dir> <card path of the epub> <cache path> <fontId> <lineCompression> <extraParagraphSpacing>
+//            <paragraphAlignment> <viewportWidth> <viewportHeight> <hyphenation> <embeddedStyle>
+
+#include <Epub.h>
+#include <Epub/Section.h>
+#include <FontDecompressor.h>
+#include <GfxRenderer.h>
+#include <HalDisplay.h>
+#include <HalStorage.h>
+#include <builtinFonts/all.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "fontIds.h"
+#include "host/HostStorage.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE
+#endif
+
+namespace {
+// Card root inside the module's file system; the page writes the book under it and reads the caches back
+constexpr char CARD_ROOT[] = "/card";
+
+enum Result { OK = 0, NO_RENDERER = 1, UNKNOWN_FONT = 2, LOAD_FAILED = 3, SECTION_FAILED = 4 };
+
+struct Family {
+  int id;
+  const EpdFontData* regular;
+  const EpdFontData* bold;
+  const EpdFontData* italic;
+  const EpdFontData* boldItalic;
+};
+
+// Reader fonts under the IDs the firmware registers them with (see setupDisplayAndFonts in main.cpp). Fonts loaded
+// from the card aren't known here, books laid out with one are left to the device.
+const Family READER_FONTS[] = {
+    {BOOKERLY_12_FONT_ID, &bookerly_12_regular, &bookerly_12_bold, &bookerly_12_italic, &bookerly_12_bolditalic},
+    {BOOKERLY_14_FONT_ID, &bookerly_14_regular, &bookerly_14_bold, &bookerly_14_italic, &bookerly_14_bolditalic},
+    {BOOKERLY_16_FONT_ID, &bookerly_16_regular, &bookerly_16_bold, &bookerly_16_italic, &bookerly_16_bolditalic},
+    {BOOKERLY_18_FONT_ID, &bookerly_18_regular, &bookerly_18_bold, &bookerly_18_italic, &bookerly_18_bolditalic},
+    {NOTOSANS_12_FONT_ID, &notosans_12_regular, &notosans_12_bold, &notosans_12_italic, &notosans_12_bolditalic},
+    {NOTOSANS_14_FONT_ID, &notosans_14_regular, &notosans_14_bold, &notosans_14_italic, &notosans_14_bolditalic},
+    {NOTOSANS_16_FONT_ID, &notosans_16_regular, &notosans_16_bold, &notosans_16_italic, &notosans_16_bolditalic},
+    {NOTOSANS_18_FONT_ID, &notosans_18_regular, &notosans_18_bold, &notosans_18_italic, &notosans_18_bolditalic},
+    {OPENDYSLEXIC_8_FONT_ID, &opendyslexic_8_regular, &opendyslexic_8_bold, &opendyslexic_8_italic,
+     &opendyslexic_8_bolditalic},
+    {OPENDYSLEXIC_10_FONT_ID, &opendyslexic_10_regular, &opendyslexic_10_bold, &opendyslexic_10_italic,
+     &opendyslexic_10_bolditalic},
+    {OPENDYSLEXIC_12_FONT_ID, &opendyslexic_12_regular, &opendyslexic_12_bold, &opendyslexic_12_italic,
+     &opendyslexic_12_bolditalic},
+    {OPENDYSLEXIC_14_FONT_ID, &opendyslexic_14_regular, &opendyslexic_14_bold, &opendyslexic_14_italic,
+     &opendyslexic_14_bolditalic},
+};
+
+GfxRenderer* setupRenderer() {
+  static HalDisplay display;
+  static GfxRenderer renderer(display);
+  static FontDecompressor fontDecompressor;
+  static std::vector<std::unique_ptr<EpdFont>> fonts;
+  static bool ready = false;
+  if (ready) {
+    return &renderer;
+  }
+
+  display.begin();
+  renderer.begin();
+  renderer.setOrientation(GfxRenderer::Portrait);
+  if (!fontDecompressor.init()) {
+    return nullptr;
+  }
+  renderer.setFontDecompressor(&fontDecompressor);
+  for (const Family& family : READER_FONTS) {
+    EpdFont* styles[4];
+    const EpdFontData* data[4] = {family.regular, family.bold, family.italic, family.boldItalic};
+    for (int i = 0; i < 4; i++) {
+      fonts.emplace_back(new EpdFont(data[i]));
+      styles[i] = fonts.back().get();
+    }
+    renderer.insertFont(family.id, EpdFontFamily(styles[0], styles[1], styles[2], styles[3]));
+  }
+
+#ifdef __EMSCRIPTEN__
+  hoststorage::setRoot(CARD_ROOT);
+#endif
+  Storage.begin(false);
+  ready = true;
+  return &renderer;
+}
+
+bool isReaderFont(const int fontId) {
+  for (const Family& family : READER_FONTS) {
+    if (family.id == fontId) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+// Build the caches of the book at epubPath (a card path) into cachePath. Returns a Result; the caches written before
+// a failure stay, the device picks up whatever is complete.
+extern "C" EMSCRIPTEN_KEEPALIVE int preindex(const char* epubPath, const char* cachePath, const int fontId,
+                                             const float lineCompression, const int extraParagraphSpacing,
+                                             const int paragraphAlignment, const int viewportWidth,
+                                             const int viewportHeight, const int hyphenation,
+                                             const int embeddedStyle) {
+  GfxRenderer* renderer = setupRenderer();
+  if (!renderer) {
+    return NO_RENDERER;
+  }
+  if (!isReaderFont(fontId)) {
+    return UNKNOWN_FONT;
+  }
+
+  auto epub = std::make_shared<Epub>(epubPath, Epub::CacheAt{cachePath});
+  if (!epub->load(true, false)) {
+    return LOAD_FAILED;
+  }
+
+  int result = OK;
+  for (int spineIndex = 0; spineIndex < epub->getSpineItemsCount(); spineIndex++) {
+    Section section(epub, spineIndex, *renderer);
+    if (section.loadSectionFile(fontId, lineCompression, extraParagraphSpacing != 0,
+                                static_cast<uint8_t>(paragraphAlignment), viewportWidth, viewportHeight,
+                                hyphenation != 0, embeddedStyle != 0)) {
+      continue;
+    }
+    if (!section.createSectionFile(fontId, lineCompression, extraParagraphSpacing != 0,
+                                   static_cast<uint8_t>(paragraphAlignment), viewportWidth, viewportHeight,
+                                   hyphenation != 0, embeddedStyle != 0)) {
+      result = SECTION_FAILED;
+    }
+  }
+  return result;
+}
+
+#ifndef __EMSCRIPTEN__
+int main(const int argc, char** argv) {
+  if (argc != 12) {
+    fprintf(stderr,
+            "Usage: %s <card dir> <epub> <cache path> <fontId> <lineCompression> <extraParagraphSpacing> "
+            "<paragraphAlignment> <viewportWidth> <viewportHeight> <hyphenation> <embeddedStyle>\n",
+            argv[0]);
+    return 2;
+  }
+  hoststorage::setRoot(argv[1]);
+  const int result = preindex(argv[2], argv[3], std::atoi(argv[4]), std::strtof(argv[5], nullptr), std::atoi(argv[6]),
+                              std::atoi(argv[7]), std::atoi(argv[8]), std::atoi(argv[9]), std::atoi(argv[10]),
+                              std::atoi(argv[11]));
+  if (result != OK) {
+    fprintf(stderr, "preindex failed: %d\n", result);
+  }
+  return result;
+}
+#endif
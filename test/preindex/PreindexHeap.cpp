@@ -0,0 +1,7 @@
+#include "host/HostHeap.h"
+
+// The pre-indexer counts nothing. HostHeap.cpp relies on the linker's --wrap, which WebAssembly's linker lacks, so
+// this stands in for it; the platform shim only needs the live bytes for ESP.getFreeHeap().
+hostheap::Counters hostheap::read() { return {}; }
+
+void hostheap::resetPeak() {}
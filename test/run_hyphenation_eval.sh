@@ -1,6 +1,11 @@
 #!/usr/bin/env bash
 set -euo pipefail
 
+# test/run_hyphenation_eval.sh [language]      accuracy against the test data, every language by default
+# test/run_hyphenation_eval.sh --throughput [language] [--words FILE] [--passes N]
+#                                             words/s and allocations per word of the Liang engine; ukrainian has
+#                                             no test data and needs --words (one word per line)
+
 ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
 BUILD_DIR="$ROOT_DIR/build/hyphenation_eval"
 BINARY="$BUILD_DIR/HyphenationEvaluationTest"
@@ -9,6 +14,7 @@ mkdir -p "$BUILD_DIR"
 
 SOURCES=(
   "$ROOT_DIR/test/hyphenation_eval/HyphenationEvaluationTest.cpp"
+  "$ROOT_DIR/lib/Epub/Epub/LayoutArena.cpp"
   "$ROOT_DIR/lib/Epub/Epub/hyphenation/Hyphenator.cpp"
   "$ROOT_DIR/lib/Epub/Epub/hyphenation/LanguageRegistry.cpp"
   "$ROOT_DIR/lib/Epub/Epub/hyphenation/LiangHyphenation.cpp"
@@ -0,0 +1,106 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+# Set LAYOUT_BENCH_LOG_LEVEL (0-2) to see the firmware's serial log on stderr; logging skews the timings
+LOG_LEVEL="${LAYOUT_BENCH_LOG_LEVEL:-}"
+BUILD_DIR="$ROOT_DIR/build/layout_bench${LOG_LEVEL:+_log$LOG_LEVEL}"
+BINARY="$BUILD_DIR/LayoutBenchmark"
+
+mkdir -p "$BUILD_DIR/obj"
+
+CXX_SOURCES=(
+  "$ROOT_DIR/test/layout_bench/LayoutBenchmark.cpp"
+  "$ROOT_DIR/test/layout_bench/host/HostHeap.cpp"
+  "$ROOT_DIR/test/layout_bench/host/HostPlatform.cpp"
+  "$ROOT_DIR/test/layout_bench/host/PngToFramebufferConverter.cpp"
+  "$ROOT_DIR/test/layout_bench/host/SDCardManager.cpp"
+  "$ROOT_DIR/lib/hal/HalStorage.cpp"
+  "$ROOT_DIR/lib/Logging/Logging.cpp"
+  "$ROOT_DIR/lib/Logging/Metrics.cpp"
+  "$ROOT_DIR/lib/BufferPool/BufferPool.cpp"
+  "$ROOT_DIR/lib/Epub/Epub.cpp"
+)
+# The device's PNG decoder comes from a PlatformIO package; the host build uses the stand-in above
+while IFS= read -r source; do
+  CXX_SOURCES+=("$source")
+done < <(
+  cd "$ROOT_DIR" &&
+    find lib/Epub/Epub lib/GfxRenderer lib/EpdFont lib/ZipFile lib/InflateReader lib/FsHelpers lib/Utf8 \
+      lib/JpegToBmpConverter lib/PngToBmpConverter -maxdepth 2 -name '*.cpp' \
+      ! -name PngToFramebufferConverter.cpp | sort | sed "s|^|$ROOT_DIR/|"
+)
+
+C_SOURCES=(
+  "$ROOT_DIR/lib/expat/xmlparse.c"
+  "$ROOT_DIR/lib/expat/xmlrole.c"
+  "$ROOT_DIR/lib/expat/xmltok.c"
+  "$ROOT_DIR/lib/uzlib/src/tinflate.c"
+  "$ROOT_DIR/lib/picojpeg/picojpeg.c"
+)
+
+INCLUDES=(
+  -I"$ROOT_DIR/test/layout_bench/host"
+  -I"$ROOT_DIR/test/layout_bench"
+  -I"$ROOT_DIR/lib/hal"
+  -I"$ROOT_DIR/lib/Logging"
+  -I"$ROOT_DIR/lib/BufferPool"
+  -I"$ROOT_DIR/lib/FunctionRef"
+  -I"$ROOT_DIR/lib/HotPath"
+  -I"$ROOT_DIR/lib/PackBits"
+  -I"$ROOT_DIR/lib/Epub"
+  -I"$ROOT_DIR/lib/GfxRenderer"
+  -I"$ROOT_DIR/lib/EpdFont"
+  -I"$ROOT_DIR/lib/ZipFile"
+  -I"$ROOT_DIR/lib/InflateReader"
+  -I"$ROOT_DIR/lib/uzlib/src"
+  -I"$ROOT_DIR/lib/expat"
+  -I"$ROOT_DIR/lib/FsHelpers"
+  -I"$ROOT_DIR/lib/Serialization"
+  -I"$ROOT_DIR/lib/Utf8"
+  -I"$ROOT_DIR/lib/JpegToBmpConverter"
+  -I"$ROOT_DIR/lib/PngToBmpConverter"
+  -I"$ROOT_DIR/lib/picojpeg"
+)
+
+# Same feature flags as the firmware; tracing and the allocation profiler stay off, the harness counts on its own
+DEFINES=(
+  -DXML_GE=0
+  -DXML_CONTEXT_BYTES=1024
+  -DEINK_DISPLAY_SINGLE_BUFFER_MODE=1
+  -DDISABLE_TRACE
+)
+if [[ -n "$LOG_LEVEL" ]]; then
+  DEFINES+=(-DENABLE_SERIAL_LOG -DLOG_LEVEL="$LOG_LEVEL")
+fi
+
+CFLAGS=(-O2 -MMD -ffunction-sections "${DEFINES[@]}" "${INCLUDES[@]}")
+CXXFLAGS=(-std=gnu++2a -O2 -MMD -ffunction-sections "${DEFINES[@]}" "${INCLUDES[@]}")
+LDFLAGS=(-Wl,--gc-sections -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free)
+
+# An object is current when it is newer than its source and every header the compiler listed for it
+is_current() {
+  local object="$1" dependency
+  [[ -f "$object" && -f "${object%.o}.d" ]] || return 1
+  for dependency in $(sed -e 's/^[^:]*://' -e 's/\\$//' "${object%.o}.d"); do
+    [[ "$object" -nt "$dependency" ]] || return 1
+  done
+}
+
+OBJECTS=()
+for source in "${CXX_SOURCES[@]}" "${C_SOURCES[@]}"; do
+  object="$BUILD_DIR/obj/$(echo "${source#"$ROOT_DIR"/}" | tr '/' '_').o"
+  OBJECTS+=("$object")
+  if is_current "$object"; then
+    continue
+  fi
+  case "$source" in
+    *.c) cc "${CFLAGS[@]}" -c "$source" -o "$object" ;;
+    *) c++ "${CXXFLAGS[@]}" -c "$source" -o "$object" ;;
+  esac
+done
+
+c++ "${OBJECTS[@]}" "${LDFLAGS[@]}" -o "$BINARY"
+
+cd "$ROOT_DIR"
+"$BINARY" "$@"